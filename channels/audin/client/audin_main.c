@@ -91,6 +91,7 @@ typedef struct
 	wStream* data;
 	AUDIO_FORMAT* format;
 	UINT32 FramesPerPacket;
+	UINT32 opusFrameDuration;
 
 	FREERDP_DSP_CONTEXT* dsp_context;
 	wLog* log;
@@ -439,7 +440,19 @@ static BOOL audin_open_device(AUDIN_PLUGIN* audin, AUDIN_CHANNEL_CALLBACK* callb
 			return FALSE;
 	}
 
-	IFCALLRET(audin->device->SetFormat, error, audin->device, &format, audin->FramesPerPacket);
+	/* Opus is encoded in fixed frames, capture exactly one frame per period so
+	 * every captured packet is sent right away instead of waiting in the encoder */
+	UINT32 FramesPerPacket = audin->FramesPerPacket;
+	const UINT32 opusFrameDuration =
+	    (audin->format->wFormatTag == WAVE_FORMAT_OPUS) ? audin->opusFrameDuration : 0;
+
+	if (!freerdp_dsp_context_set_opus_framing(audin->dsp_context, opusFrameDuration, FALSE, 0))
+		return FALSE;
+
+	if (opusFrameDuration > 0)
+		FramesPerPacket = format.nSamplesPerSec * opusFrameDuration / 1000;
+
+	IFCALLRET(audin->device->SetFormat, error, audin->device, &format, FramesPerPacket);
 
 	if (error != CHANNEL_RC_OK)
 	{
@@ -890,6 +903,8 @@ BOOL audin_process_addin_args(AUDIN_PLUGIN* audin, const ADDIN_ARGV* args)
 		{ "format", COMMAND_LINE_VALUE_REQUIRED, "<format>", NULL, NULL, -1, NULL, "format" },
 		{ "rate", COMMAND_LINE_VALUE_REQUIRED, "<rate>", NULL, NULL, -1, NULL, "rate" },
 		{ "channel", COMMAND_LINE_VALUE_REQUIRED, "<channel>", NULL, NULL, -1, NULL, "channel" },
+		{ "opus-frame", COMMAND_LINE_VALUE_REQUIRED, "<ms>", NULL, NULL, -1, NULL,
+		  "opus frame duration, 10 or 20 ms, 0 to encode whatever was captured" },
 		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
 	};
 
@@ -957,6 +972,15 @@ BOOL audin_process_addin_args(AUDIN_PLUGIN* audin, const ADDIN_ARGV* args)
 			if ((errno != 0) || (val <= UINT16_MAX))
 				audin->fixed_format->nChannels = (UINT16)val;
 		}
+		CommandLineSwitchCase(arg, "opus-frame")
+		{
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || ((val != 0) && (val != 10) && (val != 20)))
+				return FALSE;
+
+			audin->opusFrameDuration = (UINT32)val;
+		}
 		CommandLineSwitchDefault(arg)
 		{
 		}
@@ -1038,6 +1062,8 @@ FREERDP_ENTRY_POINT(UINT VCAPITYPE audin_DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* p
 	if (!audin->dsp_context)
 		goto out;
 
+	audin->opusFrameDuration = 20;
+
 	audin->attached = TRUE;
 	audin->iface.Initialize = audin_plugin_initialize;
 	audin->iface.Connected = NULL;
@@ -28,18 +28,28 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/drdynvc.h>
+#include <freerdp/channels/echo.h>
+#include <freerdp/channels/rdpecam.h>
+#include <freerdp/channels/tsmf.h>
+#include <freerdp/channels/urbdrc.h>
 #include <freerdp/utils/drdynvc.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include "drdynvc_main.h"
 
 #define TAG CHANNELS_TAG("drdynvc.client")
 
+#define DRDYNVC_SEND_WINDOW 8
+
 static void dvcman_channel_free(DVCMAN_CHANNEL* channel);
 static UINT dvcman_channel_close(DVCMAN_CHANNEL* channel, BOOL perRequest, BOOL fromHashTableFn);
 static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr);
-static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const BYTE* data,
-                               UINT32 dataSize, BOOL* close);
+static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, UINT8 priority,
+                               const BYTE* data, UINT32 dataSize, BOOL* close);
 static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s);
+static UINT32 drdynvc_cblen_to_bytes(int cbLen);
+static UINT drdynvc_send_channel(drdynvcPlugin* drdynvc, UINT32 ChannelId, UINT8 priority,
+                                 wStream* s);
 
 static void dvcman_wtslistener_free(DVCMAN_LISTENER* listener)
 {
@@ -339,6 +349,11 @@ static IWTSVirtualChannelManager* dvcman_new(drdynvcPlugin* plugin)
 		goto fail;
 	obj = ArrayList_Object(dvcman->plugins);
 	obj->fnObjectFree = dvcman_plugin_terminate;
+
+	/* the arguments are owned by the settings */
+	dvcman->deferred = ArrayList_New(TRUE);
+	if (!dvcman->deferred)
+		goto fail;
 	return &dvcman->iface;
 fail:
 	dvcman_free(plugin, &dvcman->iface);
@@ -382,6 +397,34 @@ static UINT dvcman_load_addin(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager*
 	return ERROR_INVALID_FUNCTION;
 }
 
+typedef struct
+{
+	const char* addin;
+	const char* channel;
+} DVCMAN_DEFERRED_ADDIN;
+
+/* addins that do nothing until the server opens their channel, loading them is postponed */
+static const DVCMAN_DEFERRED_ADDIN dvcman_deferred_addins[] = {
+	{ ECHO_CHANNEL_NAME, ECHO_DVC_CHANNEL_NAME },
+	{ RDPECAM_CHANNEL_NAME, RDPECAM_CONTROL_DVC_CHANNEL_NAME },
+	{ TSMF_CHANNEL_NAME, TSMF_DVC_CHANNEL_NAME },
+	{ URBDRC_CHANNEL_NAME, URBDRC_CHANNEL_NAME },
+};
+
+static const char* dvcman_deferred_channel(const ADDIN_ARGV* args)
+{
+	if (!args || (args->argc < 1))
+		return NULL;
+
+	for (size_t x = 0; x < ARRAYSIZE(dvcman_deferred_addins); x++)
+	{
+		const DVCMAN_DEFERRED_ADDIN* cur = &dvcman_deferred_addins[x];
+		if (strcmp(cur->addin, args->argv[0]) == 0)
+			return cur->channel;
+	}
+	return NULL;
+}
+
 static void dvcman_channel_free(DVCMAN_CHANNEL* channel)
 {
 	if (!channel)
@@ -421,7 +464,7 @@ static UINT dvcchannel_send_close(DVCMAN_CHANNEL* channel)
 
 	Stream_Write_UINT8(s, (CLOSE_REQUEST_PDU << 4) | 0x02);
 	Stream_Write_UINT32(s, channel->channel_id);
-	return drdynvc_send(drdynvc, s);
+	return drdynvc_send_channel(drdynvc, channel->channel_id, channel->priority, s);
 }
 
 static void check_open_close_receive(DVCMAN_CHANNEL* channel)
@@ -558,6 +601,7 @@ static void dvcman_clear(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pCha
 	HashTable_Clear(dvcman->channelsById);
 	ArrayList_Clear(dvcman->plugins);
 	ArrayList_Clear(dvcman->plugin_names);
+	ArrayList_Clear(dvcman->deferred);
 	HashTable_Clear(dvcman->listeners);
 }
 static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr)
@@ -570,6 +614,7 @@ static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChan
 	HashTable_Free(dvcman->channelsById);
 	ArrayList_Free(dvcman->plugins);
 	ArrayList_Free(dvcman->plugin_names);
+	ArrayList_Free(dvcman->deferred);
 	HashTable_Free(dvcman->listeners);
 
 	StreamPool_Free(dvcman->pool);
@@ -581,14 +626,15 @@ static void dvcman_free(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChan
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT dvcman_init(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr)
+static UINT dvcman_init(drdynvcPlugin* drdynvc, IWTSVirtualChannelManager* pChannelMgr,
+                        size_t first)
 {
 	DVCMAN* dvcman = (DVCMAN*)pChannelMgr;
 	UINT error = CHANNEL_RC_OK;
 
 	WINPR_ASSERT(dvcman);
 	ArrayList_Lock(dvcman->plugins);
-	for (size_t i = 0; i < ArrayList_Count(dvcman->plugins); i++)
+	for (size_t i = first; i < ArrayList_Count(dvcman->plugins); i++)
 	{
 		IWTSPlugin* pPlugin = ArrayList_GetItem(dvcman->plugins, i);
 
@@ -606,6 +652,42 @@ fail:
 	return error;
 }
 
+/**
+ * Loads and initializes the deferred addin listening on \b ChannelName
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT dvcman_load_deferred(drdynvcPlugin* drdynvc, DVCMAN* dvcman, const char* ChannelName)
+{
+	const ADDIN_ARGV* args = NULL;
+
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(dvcman);
+
+	ArrayList_Lock(dvcman->deferred);
+	for (size_t i = 0; i < ArrayList_Count(dvcman->deferred); i++)
+	{
+		const ADDIN_ARGV* cur = ArrayList_GetItem(dvcman->deferred, i);
+		const char* channel = dvcman_deferred_channel(cur);
+		if (channel && (strcmp(channel, ChannelName) == 0))
+		{
+			args = cur;
+			ArrayList_RemoveAt(dvcman->deferred, i);
+			break;
+		}
+	}
+	ArrayList_Unlock(dvcman->deferred);
+
+	if (!args)
+		return ERROR_NOT_FOUND;
+
+	const size_t first = ArrayList_Count(dvcman->plugins);
+	const UINT error = dvcman_load_addin(drdynvc, &dvcman->iface, args, drdynvc->rdpcontext);
+	if (error != CHANNEL_RC_OK)
+		return error;
+	return dvcman_init(drdynvc, &dvcman->iface, first);
+}
+
 /**
  * Function description
  *
@@ -623,8 +705,8 @@ static UINT dvcman_write_channel(IWTSVirtualChannel* pChannel, ULONG cbSize, con
 		return CHANNEL_RC_BAD_CHANNEL;
 
 	EnterCriticalSection(&(channel->lock));
-	status =
-	    drdynvc_write_data(channel->dvcman->drdynvc, channel->channel_id, pBuffer, cbSize, &close);
+	status = drdynvc_write_data(channel->dvcman->drdynvc, channel->channel_id, channel->priority,
+	                            pBuffer, cbSize, &close);
 	LeaveCriticalSection(&(channel->lock));
 	/* Close delayed, it removes the channel struct */
 	if (close)
@@ -670,6 +752,8 @@ static DVCMAN_CHANNEL* dvcman_create_channel(drdynvcPlugin* drdynvc,
 
 	HashTable_Lock(dvcman->listeners);
 	listener = (DVCMAN_LISTENER*)HashTable_GetItemValue(dvcman->listeners, ChannelName);
+	if (!listener && (dvcman_load_deferred(drdynvc, dvcman, ChannelName) == CHANNEL_RC_OK))
+		listener = (DVCMAN_LISTENER*)HashTable_GetItemValue(dvcman->listeners, ChannelName);
 	if (!listener)
 	{
 		*res = ERROR_NOT_FOUND;
@@ -835,6 +919,7 @@ static UINT dvcman_receive_channel_data(DVCMAN_CHANNEL* channel, wStream* data,
 
 	WINPR_ASSERT(channel);
 	WINPR_ASSERT(channel->dvcman);
+	FREERDP_TRACEPOINT(dvc_data, 0, channel->channel_id);
 	if (channel->dvc_data)
 	{
 		drdynvcPlugin* drdynvc = channel->dvcman->drdynvc;
@@ -891,24 +976,15 @@ static UINT8 drdynvc_write_variable_uint(wStream* s, UINT32 val)
 	return cb;
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
+static UINT drdynvc_write_pdu(drdynvcPlugin* drdynvc, wStream* s)
 {
-	UINT status = 0;
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(s);
 
-	if (!drdynvc)
-		status = CHANNEL_RC_BAD_CHANNEL_HANDLE;
-	else
-	{
-		WINPR_ASSERT(drdynvc->channelEntryPoints.pVirtualChannelWriteEx);
-		status = drdynvc->channelEntryPoints.pVirtualChannelWriteEx(
-		    drdynvc->InitHandle, drdynvc->OpenHandle, Stream_Buffer(s),
-		    (UINT32)Stream_GetPosition(s), s);
-	}
+	WINPR_ASSERT(drdynvc->channelEntryPoints.pVirtualChannelWriteEx);
+	const UINT status = drdynvc->channelEntryPoints.pVirtualChannelWriteEx(
+	    drdynvc->InitHandle, drdynvc->OpenHandle, Stream_Buffer(s), (UINT32)Stream_GetPosition(s),
+	    s);
 
 	switch (status)
 	{
@@ -917,7 +993,7 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
 
 		case CHANNEL_RC_NOT_CONNECTED:
 			Stream_Release(s);
-			return CHANNEL_RC_OK;
+			return CHANNEL_RC_NOT_CONNECTED;
 
 		case CHANNEL_RC_BAD_CHANNEL_HANDLE:
 			Stream_Release(s);
@@ -933,13 +1009,377 @@ static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
 	}
 }
 
+/* MS-RDPEDYC 2.2.1.1.2 recommended values, the bandwidth of a class is inverse to its charge */
+static const UINT32 drdynvc_default_priority_charges[DRDYNVC_PRIORITY_CLASSES] = { 936, 3276,
+	                                                                               9362, 37449 };
+
+static UINT32 drdynvc_priority_charge(const drdynvcPlugin* drdynvc, size_t priority)
+{
+	int charge = 0;
+
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(priority < DRDYNVC_PRIORITY_CLASSES);
+
+	if (drdynvc->version >= 2)
+	{
+		switch (priority)
+		{
+			case 0:
+				charge = drdynvc->PriorityCharge0;
+				break;
+			case 1:
+				charge = drdynvc->PriorityCharge1;
+				break;
+			case 2:
+				charge = drdynvc->PriorityCharge2;
+				break;
+			default:
+				charge = drdynvc->PriorityCharge3;
+				break;
+		}
+	}
+
+	if (charge <= 0)
+		return drdynvc_default_priority_charges[priority];
+	return (UINT32)charge;
+}
+
+static void drdynvc_send_stream_free(void* obj)
+{
+	Stream_Release((wStream*)obj);
+}
+
+static void drdynvc_send_flow_free(void* obj)
+{
+	DRDYNVC_SEND_FLOW* flow = obj;
+
+	if (!flow)
+		return;
+
+	Queue_Free(flow->pdus);
+	free(flow);
+}
+
+static DRDYNVC_SEND_FLOW* drdynvc_send_flow_get(DRDYNVC_SEND_QUEUE* send, UINT32 ChannelId,
+                                                UINT8 priority)
+{
+	WINPR_ASSERT(send);
+	WINPR_ASSERT(priority < DRDYNVC_PRIORITY_CLASSES);
+
+	for (size_t x = 0; x < ARRAYSIZE(send->flows); x++)
+	{
+		for (size_t y = 0; y < ArrayList_Count(send->flows[x]); y++)
+		{
+			DRDYNVC_SEND_FLOW* flow = ArrayList_GetItem(send->flows[x], y);
+			if (flow->ChannelId == ChannelId)
+				return flow;
+		}
+	}
+
+	DRDYNVC_SEND_FLOW* flow = calloc(1, sizeof(DRDYNVC_SEND_FLOW));
+	if (!flow)
+		return NULL;
+
+	flow->ChannelId = ChannelId;
+	flow->pdus = Queue_New(FALSE, -1, -1);
+	if (!flow->pdus)
+	{
+		free(flow);
+		return NULL;
+	}
+	Queue_Object(flow->pdus)->fnObjectFree = drdynvc_send_stream_free;
+
+	/* an idle class does not save up bandwidth for later */
+	if ((ArrayList_Count(send->flows[priority]) == 0) && (send->pass[priority] < send->time))
+		send->pass[priority] = send->time;
+
+	if (!ArrayList_Append(send->flows[priority], flow))
+	{
+		drdynvc_send_flow_free(flow);
+		return NULL;
+	}
+	return flow;
+}
+
+static wStream* drdynvc_send_queue_next(drdynvcPlugin* drdynvc)
+{
+	WINPR_ASSERT(drdynvc);
+
+	DRDYNVC_SEND_QUEUE* send = drdynvc->send;
+	WINPR_ASSERT(send);
+
+	wStream* s = Queue_Dequeue(send->control);
+	if (s)
+		return s;
+
+	size_t priority = DRDYNVC_PRIORITY_CLASSES;
+	for (size_t x = 0; x < DRDYNVC_PRIORITY_CLASSES; x++)
+	{
+		if (ArrayList_Count(send->flows[x]) == 0)
+			continue;
+		if ((priority == DRDYNVC_PRIORITY_CLASSES) || (send->pass[x] < send->pass[priority]))
+			priority = x;
+	}
+	if (priority == DRDYNVC_PRIORITY_CLASSES)
+		return NULL;
+
+	/* the channels of a class take turns, one PDU each */
+	wArrayList* flows = send->flows[priority];
+	const size_t index = send->next[priority] % ArrayList_Count(flows);
+	DRDYNVC_SEND_FLOW* flow = ArrayList_GetItem(flows, index);
+	s = Queue_Dequeue(flow->pdus);
+	if (Queue_Count(flow->pdus) == 0)
+	{
+		ArrayList_RemoveAt(flows, index);
+		send->next[priority] = index;
+	}
+	else
+		send->next[priority] = index + 1;
+
+	send->time = send->pass[priority];
+	if (s)
+		send->pass[priority] +=
+		    Stream_GetPosition(s) * drdynvc_priority_charge(drdynvc, priority);
+	return s;
+}
+
+/* rewrite a DATA_FIRST or DATA PDU to its compressed counterpart */
+static wStream* drdynvc_compress_pdu(drdynvcPlugin* drdynvc, wStream* s)
+{
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(s);
+
+	DRDYNVC_SEND_QUEUE* send = drdynvc->send;
+	WINPR_ASSERT(send);
+
+	const BYTE* data = Stream_Buffer(s);
+	const size_t length = Stream_GetPosition(s);
+	const UINT8 Cmd = (data[0] & 0xf0) >> 4;
+	const UINT8 Sp = (data[0] & 0x0c) >> 2;
+	const UINT8 cbChId = (data[0] & 0x03) >> 0;
+
+	size_t header = 1 + drdynvc_cblen_to_bytes(cbChId);
+	UINT8 compressed = DATA_COMPRESSED_PDU;
+	if (Cmd == DATA_FIRST_PDU)
+	{
+		header += drdynvc_cblen_to_bytes(Sp);
+		compressed = DATA_FIRST_COMPRESSED_PDU;
+	}
+	else if (Cmd != DATA_PDU)
+		return s;
+
+	if (!send->compressor)
+	{
+		send->compressor = zgfx_context_new(TRUE);
+		if (!send->compressor ||
+		    !zgfx_set_history_size(send->compressor, ZGFX_HISTORY_SIZE_LITE) ||
+		    !zgfx_set_compression_level(send->compressor, ZGFX_COMPRESSION_LEVEL_FAST))
+			goto fail;
+	}
+
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	WINPR_ASSERT(dvcman);
+
+	wStream* out = StreamPool_Take(dvcman->pool, length + 1);
+	if (!out)
+		goto fail;
+
+	Stream_Write_UINT8(out, (UINT8)((compressed << 4) | (data[0] & 0x0f)));
+	Stream_Write(out, &data[1], header - 1);
+	if (!zgfx_compress_bulk(send->compressor, out, &data[header], (UINT32)(length - header)))
+	{
+		Stream_Release(out);
+		goto fail;
+	}
+
+	Stream_Release(s);
+	return out;
+
+fail:
+	/* the history of the peer is out of sync now, nothing more can be compressed */
+	WLog_Print(drdynvc->log, WLOG_ERROR, "failed to compress dynamic channel data");
+	Stream_Release(s);
+	return NULL;
+}
+
+static void drdynvc_send_queue_pump(drdynvcPlugin* drdynvc)
+{
+	WINPR_ASSERT(drdynvc);
+
+	DRDYNVC_SEND_QUEUE* send = drdynvc->send;
+	WINPR_ASSERT(send);
+
+	while (send->inFlight < DRDYNVC_SEND_WINDOW)
+	{
+		wStream* s = drdynvc_send_queue_next(drdynvc);
+		if (!s)
+			break;
+
+		if (send->compress)
+		{
+			s = drdynvc_compress_pdu(drdynvc, s);
+			if (!s)
+				continue;
+		}
+
+		send->inFlight++;
+		if (drdynvc_write_pdu(drdynvc, s) != CHANNEL_RC_OK)
+			send->inFlight--;
+	}
+}
+
+/* a PDU left the static channel, the next one can go */
+static void drdynvc_send_queue_complete(drdynvcPlugin* drdynvc)
+{
+	WINPR_ASSERT(drdynvc);
+
+	DRDYNVC_SEND_QUEUE* send = drdynvc->send;
+	if (!send)
+		return;
+
+	EnterCriticalSection(&send->lock);
+	if (send->inFlight > 0)
+		send->inFlight--;
+	drdynvc_send_queue_pump(drdynvc);
+	LeaveCriticalSection(&send->lock);
+}
+
+static void drdynvc_send_queue_clear(DRDYNVC_SEND_QUEUE* send)
+{
+	if (!send)
+		return;
+
+	EnterCriticalSection(&send->lock);
+	Queue_Clear(send->control);
+	for (size_t x = 0; x < DRDYNVC_PRIORITY_CLASSES; x++)
+	{
+		ArrayList_Clear(send->flows[x]);
+		send->next[x] = 0;
+		send->pass[x] = 0;
+	}
+	send->time = 0;
+	send->inFlight = 0;
+	send->compress = FALSE;
+	zgfx_context_free(send->compressor);
+	send->compressor = NULL;
+	LeaveCriticalSection(&send->lock);
+}
+
+static void drdynvc_send_queue_free(DRDYNVC_SEND_QUEUE* send)
+{
+	if (!send)
+		return;
+
+	for (size_t x = 0; x < DRDYNVC_PRIORITY_CLASSES; x++)
+		ArrayList_Free(send->flows[x]);
+	Queue_Free(send->control);
+	zgfx_context_free(send->compressor);
+	DeleteCriticalSection(&send->lock);
+	free(send);
+}
+
+static DRDYNVC_SEND_QUEUE* drdynvc_send_queue_new(void)
+{
+	DRDYNVC_SEND_QUEUE* send = calloc(1, sizeof(DRDYNVC_SEND_QUEUE));
+	if (!send)
+		return NULL;
+
+	InitializeCriticalSection(&send->lock);
+	send->control = Queue_New(FALSE, -1, -1);
+	if (!send->control)
+		goto fail;
+	Queue_Object(send->control)->fnObjectFree = drdynvc_send_stream_free;
+
+	for (size_t x = 0; x < DRDYNVC_PRIORITY_CLASSES; x++)
+	{
+		send->flows[x] = ArrayList_New(FALSE);
+		if (!send->flows[x])
+			goto fail;
+		ArrayList_Object(send->flows[x])->fnObjectFree = drdynvc_send_flow_free;
+	}
+	return send;
+
+fail:
+	drdynvc_send_queue_free(send);
+	return NULL;
+}
+
+static UINT drdynvc_send_enqueue(drdynvcPlugin* drdynvc, wQueue* queue, wStream* s)
+{
+	WINPR_ASSERT(drdynvc);
+	WINPR_ASSERT(drdynvc->send);
+
+	if (!queue || !Queue_Enqueue(queue, s))
+	{
+		Stream_Release(s);
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	drdynvc_send_queue_pump(drdynvc);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_send_channel(drdynvcPlugin* drdynvc, UINT32 ChannelId, UINT8 priority,
+                                 wStream* s)
+{
+	if (!drdynvc)
+	{
+		Stream_Release(s);
+		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+	}
+
+	if (!drdynvc->send)
+	{
+		const UINT status = drdynvc_write_pdu(drdynvc, s);
+		return (status == CHANNEL_RC_NOT_CONNECTED) ? CHANNEL_RC_OK : status;
+	}
+
+	EnterCriticalSection(&drdynvc->send->lock);
+	DRDYNVC_SEND_FLOW* flow =
+	    drdynvc_send_flow_get(drdynvc->send, ChannelId, priority % DRDYNVC_PRIORITY_CLASSES);
+	const UINT status = drdynvc_send_enqueue(drdynvc, flow ? flow->pdus : NULL, s);
+	LeaveCriticalSection(&drdynvc->send->lock);
+	return status;
+}
+
 /**
  * Function description
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const BYTE* data,
-                               UINT32 dataSize, BOOL* close)
+static UINT drdynvc_send(drdynvcPlugin* drdynvc, wStream* s)
+{
+	if (!drdynvc)
+	{
+		Stream_Release(s);
+		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
+	}
+
+	if (!drdynvc->send)
+	{
+		const UINT status = drdynvc_write_pdu(drdynvc, s);
+		return (status == CHANNEL_RC_NOT_CONNECTED) ? CHANNEL_RC_OK : status;
+	}
+
+	/* PDUs not belonging to a channel go first */
+	EnterCriticalSection(&drdynvc->send->lock);
+	const UINT status = drdynvc_send_enqueue(drdynvc, drdynvc->send->control, s);
+	LeaveCriticalSection(&drdynvc->send->lock);
+	return status;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, UINT8 priority,
+                               const BYTE* data, UINT32 dataSize, BOOL* close)
 {
 	wStream* data_out = NULL;
 	size_t pos = 0;
@@ -954,6 +1394,9 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 	dvcman = (DVCMAN*)drdynvc->channel_mgr;
 	WINPR_ASSERT(dvcman);
 
+	/* leave room for the bulk header in case the PDU is compressed later on */
+	const size_t chunk = (drdynvc->version >= 3) ? CHANNEL_CHUNK_LENGTH - 1 : CHANNEL_CHUNK_LENGTH;
+
 	WLog_Print(drdynvc->log, WLOG_TRACE, "write_data: ChannelId=%" PRIu32 " size=%" PRIu32 "",
 	           ChannelId, dataSize);
 	data_out = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
@@ -974,13 +1417,13 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 		*close = TRUE;
 		Stream_Release(data_out);
 	}
-	else if (dataSize <= CHANNEL_CHUNK_LENGTH - pos)
+	else if (dataSize <= chunk - pos)
 	{
 		Stream_SetPosition(data_out, 0);
 		Stream_Write_UINT8(data_out, (DATA_PDU << 4) | cbChId);
 		Stream_SetPosition(data_out, pos);
 		Stream_Write(data_out, data, dataSize);
-		status = drdynvc_send(drdynvc, data_out);
+		status = drdynvc_send_channel(drdynvc, ChannelId, priority, data_out);
 	}
 	else
 	{
@@ -994,15 +1437,14 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 		Stream_SetPosition(data_out, pos);
 
 		{
-			WINPR_ASSERT(pos <= CHANNEL_CHUNK_LENGTH);
-			const uint32_t chunkLength =
-			    CHANNEL_CHUNK_LENGTH - WINPR_ASSERTING_INT_CAST(uint32_t, pos);
+			WINPR_ASSERT(pos <= chunk);
+			const uint32_t chunkLength = WINPR_ASSERTING_INT_CAST(uint32_t, chunk - pos);
 			Stream_Write(data_out, data, chunkLength);
 
 			data += chunkLength;
 			dataSize -= chunkLength;
 		}
-		status = drdynvc_send(drdynvc, data_out);
+		status = drdynvc_send_channel(drdynvc, ChannelId, priority, data_out);
 
 		while (status == CHANNEL_RC_OK && dataSize > 0)
 		{
@@ -1023,14 +1465,14 @@ static UINT drdynvc_write_data(drdynvcPlugin* drdynvc, UINT32 ChannelId, const B
 
 			uint32_t chunkLength = dataSize;
 
-			WINPR_ASSERT(pos <= CHANNEL_CHUNK_LENGTH);
-			if (chunkLength > CHANNEL_CHUNK_LENGTH - pos)
-				chunkLength = CHANNEL_CHUNK_LENGTH - WINPR_ASSERTING_INT_CAST(uint32_t, pos);
+			WINPR_ASSERT(pos <= chunk);
+			if (chunkLength > chunk - pos)
+				chunkLength = WINPR_ASSERTING_INT_CAST(uint32_t, chunk - pos);
 
 			Stream_Write(data_out, data, chunkLength);
 			data += chunkLength;
 			dataSize -= chunkLength;
-			status = drdynvc_send(drdynvc, data_out);
+			status = drdynvc_send_channel(drdynvc, ChannelId, priority, data_out);
 		}
 	}
 
@@ -1174,7 +1616,6 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, UINT8 Sp, UIN
 	DVCMAN_CHANNEL* channel = NULL;
 	INT32 retStatus = 0;
 
-	WINPR_UNUSED(Sp);
 	if (!drdynvc)
 		return CHANNEL_RC_BAD_CHANNEL_HANDLE;
 
@@ -1247,7 +1688,11 @@ static UINT drdynvc_process_create_request(drdynvcPlugin* drdynvc, UINT8 Sp, UIN
 	}
 	Stream_Write_INT32(data_out, retStatus);
 
-	status = drdynvc_send(drdynvc, data_out);
+	/* the server assigns the priority class of the channel with the create request */
+	if (channel)
+		channel->priority = Sp % DRDYNVC_PRIORITY_CLASSES;
+
+	status = drdynvc_send_channel(drdynvc, ChannelId, Sp % DRDYNVC_PRIORITY_CLASSES, data_out);
 	if (status != CHANNEL_RC_OK)
 	{
 		WLog_Print(drdynvc->log, WLOG_ERROR, "VirtualChannelWriteEx failed with %s [%08" PRIX32 "]",
@@ -1308,10 +1753,21 @@ static UINT drdynvc_process_data_first(drdynvcPlugin* drdynvc, int Sp, int cbChI
 	if (channel->state != DVC_CHANNEL_RUNNING)
 		goto out;
 
-	status = dvcman_receive_channel_data_first(channel, Length);
+	if (Stream_GetRemainingLength(s) == Length)
+	{
+		/* not fragmented after all, hand it on without reassembly */
+		if (channel->dvc_data)
+			Stream_Release(channel->dvc_data);
+		channel->dvc_data = NULL;
+		status = dvcman_call_on_receive(channel, s);
+	}
+	else
+	{
+		status = dvcman_receive_channel_data_first(channel, Length);
 
-	if (status == CHANNEL_RC_OK)
-		status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
+		if (status == CHANNEL_RC_OK)
+			status = dvcman_receive_channel_data(channel, s, ThreadingFlags);
+	}
 
 	if (status != CHANNEL_RC_OK)
 		status = dvcman_channel_close(channel, FALSE, FALSE);
@@ -1365,6 +1821,69 @@ out:
 	return status;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT drdynvc_process_data_compressed(drdynvcPlugin* drdynvc, UINT8 Cmd, int Sp, int cbChId,
+                                            wStream* s, UINT32 ThreadingFlags)
+{
+	UINT status = ERROR_INVALID_DATA;
+
+	WINPR_ASSERT(drdynvc);
+
+	size_t header = drdynvc_cblen_to_bytes(cbChId);
+	if (Cmd == DATA_FIRST_COMPRESSED_PDU)
+		header += drdynvc_cblen_to_bytes(Sp);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, header))
+		return ERROR_INVALID_DATA;
+
+	if (!drdynvc->decompressor)
+	{
+		drdynvc->decompressor = zgfx_context_new(FALSE);
+		if (!drdynvc->decompressor ||
+		    !zgfx_set_history_size(drdynvc->decompressor, ZGFX_HISTORY_SIZE_LITE))
+			return CHANNEL_RC_NO_MEMORY;
+	}
+
+	/* the server can decompress as well, answer in kind */
+	if (drdynvc->send && !drdynvc->send->compress)
+	{
+		EnterCriticalSection(&drdynvc->send->lock);
+		drdynvc->send->compress = TRUE;
+		LeaveCriticalSection(&drdynvc->send->lock);
+	}
+
+	DVCMAN* dvcman = (DVCMAN*)drdynvc->channel_mgr;
+	WINPR_ASSERT(dvcman);
+
+	wStream* data = StreamPool_Take(dvcman->pool, CHANNEL_CHUNK_LENGTH);
+	if (!data)
+		return CHANNEL_RC_NO_MEMORY;
+
+	Stream_Write(data, Stream_ConstPointer(s), header);
+	Stream_Seek(s, header);
+	const size_t length = Stream_GetRemainingLength(s);
+	if ((length > UINT32_MAX) ||
+	    !zgfx_decompress_bulk(drdynvc->decompressor, Stream_ConstPointer(s), (UINT32)length, data))
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "failed to decompress dynamic channel data");
+		goto out;
+	}
+
+	Stream_SealLength(data);
+	Stream_SetPosition(data, 0);
+	if (Cmd == DATA_FIRST_COMPRESSED_PDU)
+		status = drdynvc_process_data_first(drdynvc, Sp, cbChId, data, ThreadingFlags);
+	else
+		status = drdynvc_process_data(drdynvc, Sp, cbChId, data, ThreadingFlags);
+
+out:
+	Stream_Release(data);
+	return status;
+}
+
 /**
  * Function description
  *
@@ -1434,6 +1953,10 @@ static UINT drdynvc_order_recv(drdynvcPlugin* drdynvc, wStream* s, UINT32 Thread
 		case CLOSE_REQUEST_PDU:
 			return drdynvc_process_close_request(drdynvc, Sp, cbChId, s);
 
+		case DATA_FIRST_COMPRESSED_PDU:
+		case DATA_COMPRESSED_PDU:
+			return drdynvc_process_data_compressed(drdynvc, Cmd, Sp, cbChId, s, ThreadingFlags);
+
 		default:
 			WLog_Print(drdynvc->log, WLOG_ERROR, "unknown drdynvc cmd 0x%x", Cmd);
 			return ERROR_INTERNAL_ERROR;
@@ -1457,6 +1980,25 @@ static UINT drdynvc_virtual_channel_event_data_received(drdynvcPlugin* drdynvc,
 		return CHANNEL_RC_OK;
 	}
 
+	/* pData is only valid during this call, the worker thread needs a copy */
+	if (!drdynvc->async && (dataFlags & CHANNEL_FLAG_FIRST) && (dataFlags & CHANNEL_FLAG_LAST))
+	{
+		wStream sbuffer = { 0 };
+
+		if (drdynvc->data_in)
+			Stream_Release(drdynvc->data_in);
+		drdynvc->data_in = NULL;
+
+		wStream* s = Stream_StaticConstInit(&sbuffer, pData, dataLength);
+		const UINT error = drdynvc_order_recv(drdynvc, s, TRUE);
+		if (error)
+		{
+			WLog_Print(drdynvc->log, WLOG_WARN,
+			           "drdynvc_order_recv failed with error %" PRIu32 "!", error);
+		}
+		return CHANNEL_RC_OK;
+	}
+
 	if (dataFlags & CHANNEL_FLAG_FIRST)
 	{
 		DVCMAN* mgr = (DVCMAN*)drdynvc->channel_mgr;
@@ -1551,6 +2093,8 @@ static void VCAPITYPE drdynvc_virtual_channel_open_event_ex(LPVOID lpUserParam,
 		{
 			wStream* s = (wStream*)pData;
 			Stream_Release(s);
+			if (drdynvc)
+				drdynvc_send_queue_complete(drdynvc);
 		}
 		break;
 
@@ -1664,6 +2208,14 @@ static UINT drdynvc_virtual_channel_event_initialized(drdynvcPlugin* drdynvc, LP
 
 	obj = MessageQueue_Object(drdynvc->queue);
 	obj->fnObjectFree = drdynvc_queue_object_free;
+
+	drdynvc->send = drdynvc_send_queue_new();
+	if (!drdynvc->send)
+	{
+		WLog_Print(drdynvc->log, WLOG_ERROR, "drdynvc_send_queue_new failed!");
+		goto error;
+	}
+
 	drdynvc->channel_mgr = dvcman_new(drdynvc);
 
 	if (!drdynvc->channel_mgr)
@@ -1717,13 +2269,27 @@ static UINT drdynvc_virtual_channel_event_connected(drdynvcPlugin* drdynvc, LPVO
 	{
 		const ADDIN_ARGV* args =
 		    freerdp_settings_get_pointer_array(settings, FreeRDP_DynamicChannelArray, index);
+		const char* channel = dvcman_deferred_channel(args);
+		if (channel)
+		{
+			WLog_Print(drdynvc->log, WLOG_DEBUG,
+			           "Deferring Dynamic Virtual Channel %s until the server opens %s",
+			           args->argv[0], channel);
+			if (!ArrayList_Append(((DVCMAN*)drdynvc->channel_mgr)->deferred, args))
+			{
+				error = ERROR_INTERNAL_ERROR;
+				goto error;
+			}
+			continue;
+		}
+
 		error = dvcman_load_addin(drdynvc, drdynvc->channel_mgr, args, drdynvc->rdpcontext);
 
 		if (CHANNEL_RC_OK != error)
 			goto error;
 	}
 
-	if ((error = dvcman_init(drdynvc, drdynvc->channel_mgr)))
+	if ((error = dvcman_init(drdynvc, drdynvc->channel_mgr, 0)))
 	{
 		WLog_Print(drdynvc->log, WLOG_ERROR, "dvcman_init failed with error %" PRIu32 "!", error);
 		goto error;
@@ -1800,6 +2366,8 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 		}
 	}
 
+	drdynvc_send_queue_clear(drdynvc->send);
+
 	WINPR_ASSERT(drdynvc->channelEntryPoints.pVirtualChannelCloseEx);
 	status = drdynvc->channelEntryPoints.pVirtualChannelCloseEx(drdynvc->InitHandle,
 	                                                            drdynvc->OpenHandle);
@@ -1811,6 +2379,7 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 	}
 
 	dvcman_clear(drdynvc, drdynvc->channel_mgr);
+	drdynvc_send_queue_clear(drdynvc->send);
 	if (drdynvc->queue)
 		MessageQueue_Clear(drdynvc->queue);
 	drdynvc->OpenHandle = 0;
@@ -1821,6 +2390,9 @@ static UINT drdynvc_virtual_channel_event_disconnected(drdynvcPlugin* drdynvc)
 		drdynvc->data_in = NULL;
 	}
 
+	zgfx_context_free(drdynvc->decompressor);
+	drdynvc->decompressor = NULL;
+
 	return status;
 }
 
@@ -1837,6 +2409,12 @@ static UINT drdynvc_virtual_channel_event_terminated(drdynvcPlugin* drdynvc)
 	MessageQueue_Free(drdynvc->queue);
 	drdynvc->queue = NULL;
 
+	/* the queued PDUs belong to the stream pool of the channel manager */
+	drdynvc_send_queue_free(drdynvc->send);
+	drdynvc->send = NULL;
+	zgfx_context_free(drdynvc->decompressor);
+	drdynvc->decompressor = NULL;
+
 	if (drdynvc->channel_mgr)
 	{
 		dvcman_free(drdynvc, drdynvc->channel_mgr);
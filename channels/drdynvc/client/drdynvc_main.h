@@ -33,6 +33,7 @@
 #include <freerdp/addin.h>
 #include <freerdp/channels/log.h>
 #include <freerdp/client/drdynvc.h>
+#include <freerdp/codec/zgfx.h>
 #include <freerdp/freerdp.h>
 
 typedef struct drdynvc_plugin drdynvcPlugin;
@@ -45,6 +46,7 @@ typedef struct
 
 	wArrayList* plugin_names;
 	wArrayList* plugins;
+	wArrayList* deferred; /* ADDIN_ARGV of addins loaded once the server opens their channel */
 
 	wHashTable* listeners;
 	wHashTable* channelsById;
@@ -92,6 +94,7 @@ typedef struct
 	wStream* dvc_data;
 	UINT32 dvc_data_length;
 	CRITICAL_SECTION lock;
+	UINT8 priority;
 } DVCMAN_CHANNEL;
 
 typedef enum
@@ -104,6 +107,35 @@ typedef enum
 	DRDYNVC_STATE_FINAL
 } DRDYNVC_STATE;
 
+#define DRDYNVC_PRIORITY_CLASSES 4
+
+/* PDUs of one channel waiting to be sent, in order */
+typedef struct
+{
+	UINT32 ChannelId;
+	wQueue* pdus;
+} DRDYNVC_SEND_FLOW;
+
+/**
+ * Only a few PDUs are handed to the static channel at a time, the rest waits here.
+ * Classes share the bandwidth by their priority charge, the channels of a class take turns.
+ * Data PDUs are compressed when they leave the queue, so the peer decompresses them in the
+ * order the history was built.
+ */
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	wQueue* control;
+	wArrayList* flows[DRDYNVC_PRIORITY_CLASSES];
+	size_t next[DRDYNVC_PRIORITY_CLASSES];
+	UINT64 pass[DRDYNVC_PRIORITY_CLASSES];
+	UINT64 time;
+	size_t inFlight;
+
+	BOOL compress;
+	ZGFX_CONTEXT* compressor;
+} DRDYNVC_SEND_QUEUE;
+
 struct drdynvc_plugin
 {
 	CHANNEL_DEF channelDef;
@@ -126,6 +158,8 @@ struct drdynvc_plugin
 	int PriorityCharge2;
 	int PriorityCharge3;
 	rdpContext* rdpcontext;
+	DRDYNVC_SEND_QUEUE* send;
+	ZGFX_CONTEXT* decompressor;
 
 	IWTSVirtualChannelManager* channel_mgr;
 };
@@ -0,0 +1,651 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/string.h>
+#include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#include <freerdp/channels/log.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "drive_cache.h"
+
+#define TAG CHANNELS_TAG("drive.client")
+
+/* Changes done through the channel itself are always seen, changes by others on the local
+ * filesystem are reported by inotify where available. The time to live covers everything
+ * else, e.g. network mounts changed by other machines. */
+#define DRIVE_CACHE_TTL_MS 2000
+#define DRIVE_CACHE_MAX_ENTRIES 65536
+#define DRIVE_CACHE_MAX_LISTINGS 256
+#define DRIVE_CACHE_MAX_LISTING 16384
+
+typedef struct
+{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	UINT64 expires;
+} DRIVE_CACHE_INFO;
+
+struct s_drive_cache
+{
+	CRITICAL_SECTION lock;
+	UINT64 generation;
+
+	/* path -> DRIVE_CACHE_INFO */
+	wHashTable* infos;
+	wArrayList* listings;
+
+#if defined(__linux__)
+	int fd;
+	/* watch descriptor -> directory */
+	wHashTable* watches;
+#endif
+};
+
+static WCHAR drive_cache_separator(void)
+{
+	return PathGetSeparatorW(PATH_STYLE_NATIVE);
+}
+
+static size_t drive_cache_parent_length(const WCHAR* path)
+{
+	const WCHAR* sep = _wcsrchr(path, drive_cache_separator());
+	return sep ? (size_t)(sep - path) : 0;
+}
+
+static WCHAR* drive_cache_child_path(const WCHAR* dir, size_t dirLength, const WCHAR* name)
+{
+	const size_t length = _wcslen(name);
+	WCHAR* path = calloc(dirLength + length + 2, sizeof(WCHAR));
+	if (!path)
+		return NULL;
+
+	memcpy(path, dir, dirLength * sizeof(WCHAR));
+	if ((dirLength == 0) || (path[dirLength - 1] != drive_cache_separator()))
+		path[dirLength++] = drive_cache_separator();
+	memcpy(&path[dirLength], name, length * sizeof(WCHAR));
+	return path;
+}
+
+static BOOL drive_cache_is_dot(const WCHAR* name)
+{
+	if (name[0] != '.')
+		return FALSE;
+	return (name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0'));
+}
+
+/* TRUE if path is dir itself or something below it */
+static BOOL drive_cache_is_below(const WCHAR* path, size_t pathLength, const WCHAR* dir,
+                                 size_t dirLength)
+{
+	if ((pathLength < dirLength) || (_wcsncmp(path, dir, dirLength) != 0))
+		return FALSE;
+	return (pathLength == dirLength) || (path[dirLength] == drive_cache_separator());
+}
+
+static UINT32 drive_cache_path_hash(const void* key)
+{
+	UINT32 hash = 2166136261u;
+
+	for (const WCHAR* cur = key; *cur; cur++)
+	{
+		hash ^= *cur;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static BOOL drive_cache_path_compare(const void* key1, const void* key2)
+{
+	return _wcscmp(key1, key2) == 0;
+}
+
+static void* drive_cache_path_clone(const void* key)
+{
+	return _wcsdup(key);
+}
+
+static void* drive_cache_info_clone(const void* value)
+{
+	DRIVE_CACHE_INFO* info = malloc(sizeof(DRIVE_CACHE_INFO));
+	if (info)
+		*info = *(const DRIVE_CACHE_INFO*)value;
+	return info;
+}
+
+void drive_cache_listing_release(DRIVE_CACHE_LISTING* listing)
+{
+	if (!listing || (InterlockedDecrement(&listing->refs) > 0))
+		return;
+
+	for (size_t x = 0; x < listing->count; x++)
+		free(listing->entries[x].name);
+	free(listing->entries);
+	free(listing->pattern);
+	free(listing);
+}
+
+static void drive_cache_listing_free(void* obj)
+{
+	drive_cache_listing_release(obj);
+}
+
+static void drive_cache_info_from_find_data(WIN32_FILE_ATTRIBUTE_DATA* info,
+                                            const WIN32_FIND_DATAW* data)
+{
+	info->dwFileAttributes = data->dwFileAttributes;
+	info->ftCreationTime = data->ftCreationTime;
+	info->ftLastAccessTime = data->ftLastAccessTime;
+	info->ftLastWriteTime = data->ftLastWriteTime;
+	info->nFileSizeHigh = data->nFileSizeHigh;
+	info->nFileSizeLow = data->nFileSizeLow;
+}
+
+static BOOL drive_cache_listing_add(DRIVE_CACHE_LISTING* listing, size_t* capacity,
+                                    const WIN32_FIND_DATAW* data)
+{
+	if (listing->count == *capacity)
+	{
+		const size_t count = (*capacity > 0) ? *capacity * 2 : 64;
+		DRIVE_CACHE_ENTRY* entries = realloc(listing->entries, count * sizeof(DRIVE_CACHE_ENTRY));
+		if (!entries)
+			return FALSE;
+		listing->entries = entries;
+		*capacity = count;
+	}
+
+	DRIVE_CACHE_ENTRY* entry = &listing->entries[listing->count];
+	entry->name = _wcsdup(data->cFileName);
+	if (!entry->name)
+		return FALSE;
+	drive_cache_info_from_find_data(&entry->info, data);
+	listing->count++;
+	return TRUE;
+}
+
+/* reads a whole directory in one go instead of one entry per request */
+static DRIVE_CACHE_LISTING* drive_cache_listing_read(const WCHAR* pattern, HANDLE* phFind)
+{
+	size_t capacity = 0;
+	WIN32_FIND_DATAW data = { 0 };
+
+	DRIVE_CACHE_LISTING* listing = calloc(1, sizeof(DRIVE_CACHE_LISTING));
+	if (!listing)
+		return NULL;
+
+	listing->refs = 1;
+	listing->wd = -1;
+	listing->pattern = _wcsdup(pattern);
+	if (!listing->pattern)
+		goto fail;
+	listing->dirLength = drive_cache_parent_length(pattern);
+
+	HANDLE hFind = FindFirstFileW(pattern, &data);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		listing->error = GetLastError();
+		return listing;
+	}
+
+	do
+	{
+		if (!drive_cache_listing_add(listing, &capacity, &data))
+		{
+			FindClose(hFind);
+			goto fail;
+		}
+
+		if (listing->count >= DRIVE_CACHE_MAX_LISTING)
+		{
+			*phFind = hFind;
+			return listing;
+		}
+	} while (FindNextFileW(hFind, &data));
+
+	listing->error = GetLastError();
+	FindClose(hFind);
+	return listing;
+
+fail:
+	drive_cache_listing_release(listing);
+	return NULL;
+}
+
+static BOOL drive_cache_listing_cacheable(const DRIVE_CACHE_LISTING* listing)
+{
+	switch (listing->error)
+	{
+		case ERROR_NO_MORE_FILES:
+		case ERROR_FILE_NOT_FOUND:
+		case ERROR_PATH_NOT_FOUND:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static void drive_cache_clear(DRIVE_CACHE* cache)
+{
+	WINPR_ASSERT(cache);
+
+	cache->generation++;
+	HashTable_Clear(cache->infos);
+	ArrayList_Clear(cache->listings);
+
+#if defined(__linux__)
+	if (cache->fd >= 0)
+	{
+		ULONG_PTR* keys = NULL;
+		const size_t count = HashTable_GetKeys(cache->watches, &keys);
+		for (size_t x = 0; x < count; x++)
+			(void)inotify_rm_watch(cache->fd, (int)keys[x]);
+		free(keys);
+	}
+	HashTable_Clear(cache->watches);
+#endif
+}
+
+static void drive_cache_invalidate_int(DRIVE_CACHE* cache, const WCHAR* path, BOOL recursive)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(path);
+
+	const size_t length = _wcslen(path);
+	const size_t parentLength = drive_cache_parent_length(path);
+
+	cache->generation++;
+	HashTable_Remove(cache->infos, path);
+
+	if (recursive)
+	{
+		ULONG_PTR* keys = NULL;
+		const size_t count = HashTable_GetKeys(cache->infos, &keys);
+		for (size_t x = 0; x < count; x++)
+		{
+			const WCHAR* key = (const WCHAR*)keys[x];
+			if (drive_cache_is_below(key, _wcslen(key), path, length))
+				HashTable_Remove(cache->infos, key);
+		}
+		free(keys);
+	}
+
+	for (size_t x = ArrayList_Count(cache->listings); x > 0; x--)
+	{
+		const DRIVE_CACHE_LISTING* listing = ArrayList_GetItem(cache->listings, x - 1);
+		if ((listing->dirLength == parentLength) &&
+		    (_wcsncmp(listing->pattern, path, parentLength) == 0))
+			ArrayList_RemoveAt(cache->listings, x - 1);
+		else if (recursive &&
+		         drive_cache_is_below(listing->pattern, listing->dirLength, path, length))
+			ArrayList_RemoveAt(cache->listings, x - 1);
+	}
+}
+
+#if defined(__linux__)
+static void drive_cache_watch(DRIVE_CACHE* cache, DRIVE_CACHE_LISTING* listing)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(listing);
+
+	if (cache->fd < 0)
+		return;
+
+	WCHAR* dir = calloc(listing->dirLength + 2, sizeof(WCHAR));
+	if (!dir)
+		return;
+
+	memcpy(dir, listing->pattern, listing->dirLength * sizeof(WCHAR));
+	if (listing->dirLength == 0)
+		dir[0] = drive_cache_separator();
+
+	char* name = ConvertWCharToUtf8Alloc(dir, NULL);
+	if (name)
+	{
+		const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM |
+		                      IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+		listing->wd = inotify_add_watch(cache->fd, name, mask);
+		free(name);
+	}
+
+	if ((listing->wd >= 0) &&
+	    !HashTable_Contains(cache->watches, (void*)(size_t)listing->wd))
+	{
+		if (HashTable_Insert(cache->watches, (void*)(size_t)listing->wd, dir))
+			dir = NULL;
+	}
+	free(dir);
+}
+
+static void drive_cache_event(DRIVE_CACHE* cache, const struct inotify_event* event)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(event);
+
+	if (event->mask & IN_Q_OVERFLOW)
+	{
+		drive_cache_clear(cache);
+		return;
+	}
+
+	const WCHAR* dir = HashTable_GetItemValue(cache->watches, (void*)(size_t)event->wd);
+	if (!dir)
+		return;
+
+	if ((event->len > 0) && (event->name[0] != '\0'))
+	{
+		size_t length = 0;
+		WCHAR* name = ConvertUtf8ToWCharAlloc(event->name, &length);
+		WCHAR* path = NULL;
+		if (name)
+			path = drive_cache_child_path(dir, _wcslen(dir), name);
+		if (path)
+			drive_cache_invalidate_int(cache, path, (event->mask & IN_ISDIR) != 0);
+		else
+			drive_cache_clear(cache);
+		free(path);
+		free(name);
+	}
+	else
+		drive_cache_invalidate_int(cache, dir, TRUE);
+
+	if (event->mask & IN_IGNORED)
+		HashTable_Remove(cache->watches, (void*)(size_t)event->wd);
+}
+
+static void drive_cache_poll(DRIVE_CACHE* cache)
+{
+	union
+	{
+		struct inotify_event event;
+		char data[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+	} buffer;
+
+	WINPR_ASSERT(cache);
+
+	if (cache->fd < 0)
+		return;
+
+	for (;;)
+	{
+		const ssize_t rc = read(cache->fd, buffer.data, sizeof(buffer.data));
+		if (rc <= 0)
+		{
+			if ((rc < 0) && (errno == EINTR))
+				continue;
+			return;
+		}
+
+		for (size_t offset = 0; offset + sizeof(struct inotify_event) <= (size_t)rc;)
+		{
+			const struct inotify_event* event =
+			    (const struct inotify_event*)(void*)&buffer.data[offset];
+			drive_cache_event(cache, event);
+			offset += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+#else
+static void drive_cache_poll(DRIVE_CACHE* cache)
+{
+	WINPR_UNUSED(cache);
+}
+#endif
+
+static DRIVE_CACHE_LISTING* drive_cache_find_listing(DRIVE_CACHE* cache, const WCHAR* pattern)
+{
+	WINPR_ASSERT(cache);
+
+	const UINT64 now = GetTickCount64();
+	for (size_t x = 0; x < ArrayList_Count(cache->listings); x++)
+	{
+		DRIVE_CACHE_LISTING* listing = ArrayList_GetItem(cache->listings, x);
+		if (_wcscmp(listing->pattern, pattern) != 0)
+			continue;
+
+		if (listing->expires > now)
+			return listing;
+
+		ArrayList_RemoveAt(cache->listings, x);
+		break;
+	}
+	return NULL;
+}
+
+static void drive_cache_put_listing(DRIVE_CACHE* cache, DRIVE_CACHE_LISTING* listing,
+                                    UINT64 generation)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(listing);
+
+	/* something changed while the directory was read */
+	if (cache->generation != generation)
+		return;
+
+	BOOL full = ArrayList_Count(cache->listings) >= DRIVE_CACHE_MAX_LISTINGS;
+#if defined(__linux__)
+	full |= HashTable_Count(cache->watches) >= DRIVE_CACHE_MAX_LISTINGS;
+#endif
+	if (full || (HashTable_Count(cache->infos) + listing->count > DRIVE_CACHE_MAX_ENTRIES))
+		drive_cache_clear(cache);
+
+#if defined(__linux__)
+	drive_cache_watch(cache, listing);
+#endif
+
+	listing->expires = GetTickCount64() + DRIVE_CACHE_TTL_MS;
+	InterlockedIncrement(&listing->refs);
+	if (!ArrayList_Append(cache->listings, listing))
+	{
+		InterlockedDecrement(&listing->refs);
+		return;
+	}
+
+	/* the metadata of the entries is queried right after a listing */
+	DRIVE_CACHE_INFO info = { 0 };
+	info.expires = listing->expires;
+	for (size_t x = 0; x < listing->count; x++)
+	{
+		const DRIVE_CACHE_ENTRY* entry = &listing->entries[x];
+		if (drive_cache_is_dot(entry->name))
+			continue;
+
+		WCHAR* path = drive_cache_child_path(listing->pattern, listing->dirLength, entry->name);
+		if (!path)
+			break;
+
+		info.info = entry->info;
+		const BOOL rc = HashTable_Insert(cache->infos, path, &info);
+		free(path);
+		if (!rc)
+			break;
+	}
+}
+
+DRIVE_CACHE_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern,
+                                             HANDLE* phFind)
+{
+	UINT64 generation = 0;
+
+	WINPR_ASSERT(pattern);
+	WINPR_ASSERT(phFind);
+
+	*phFind = INVALID_HANDLE_VALUE;
+	if (cache)
+	{
+		EnterCriticalSection(&cache->lock);
+		drive_cache_poll(cache);
+		DRIVE_CACHE_LISTING* listing = drive_cache_find_listing(cache, pattern);
+		if (listing)
+			InterlockedIncrement(&listing->refs);
+		generation = cache->generation;
+		LeaveCriticalSection(&cache->lock);
+
+		if (listing)
+			return listing;
+	}
+
+	DRIVE_CACHE_LISTING* listing = drive_cache_listing_read(pattern, phFind);
+	if (!listing || !cache || (*phFind != INVALID_HANDLE_VALUE) ||
+	    !drive_cache_listing_cacheable(listing))
+		return listing;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_poll(cache);
+	drive_cache_put_listing(cache, listing, generation);
+	LeaveCriticalSection(&cache->lock);
+	return listing;
+}
+
+BOOL drive_cache_get_info(DRIVE_CACHE* cache, const WCHAR* path, WIN32_FILE_ATTRIBUTE_DATA* info,
+                          UINT64* generation)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(path);
+	WINPR_ASSERT(info);
+	WINPR_ASSERT(generation);
+
+	if (!cache)
+		return FALSE;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_poll(cache);
+	const DRIVE_CACHE_INFO* cached = HashTable_GetItemValue(cache->infos, path);
+	if (cached && (cached->expires > GetTickCount64()))
+	{
+		*info = cached->info;
+		rc = TRUE;
+	}
+	*generation = cache->generation;
+	LeaveCriticalSection(&cache->lock);
+	return rc;
+}
+
+void drive_cache_put_info(DRIVE_CACHE* cache, const WCHAR* path,
+                          const WIN32_FILE_ATTRIBUTE_DATA* info, UINT64 generation)
+{
+	WINPR_ASSERT(path);
+	WINPR_ASSERT(info);
+
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_poll(cache);
+	if (cache->generation == generation)
+	{
+		if (HashTable_Count(cache->infos) >= DRIVE_CACHE_MAX_ENTRIES)
+			HashTable_Clear(cache->infos);
+
+		DRIVE_CACHE_INFO entry = { 0 };
+		entry.info = *info;
+		entry.expires = GetTickCount64() + DRIVE_CACHE_TTL_MS;
+		if (!HashTable_Insert(cache->infos, path, &entry))
+			WLog_WARN(TAG, "failed to cache file information");
+	}
+	LeaveCriticalSection(&cache->lock);
+}
+
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL recursive)
+{
+	if (!cache || !path)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	drive_cache_invalidate_int(cache, path, recursive);
+	LeaveCriticalSection(&cache->lock);
+}
+
+void drive_cache_free(DRIVE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+#if defined(__linux__)
+	if (cache->fd >= 0)
+		close(cache->fd);
+	HashTable_Free(cache->watches);
+#endif
+	ArrayList_Free(cache->listings);
+	HashTable_Free(cache->infos);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+DRIVE_CACHE* drive_cache_new(void)
+{
+	wObject* obj = NULL;
+	DRIVE_CACHE* cache = calloc(1, sizeof(DRIVE_CACHE));
+	if (!cache)
+		return NULL;
+
+#if defined(__linux__)
+	cache->fd = -1;
+#endif
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		free(cache);
+		return NULL;
+	}
+
+	cache->infos = HashTable_New(FALSE);
+	if (!cache->infos || !HashTable_SetHashFunction(cache->infos, drive_cache_path_hash))
+		goto fail;
+
+	obj = HashTable_KeyObject(cache->infos);
+	obj->fnObjectEquals = drive_cache_path_compare;
+	obj->fnObjectNew = drive_cache_path_clone;
+	obj->fnObjectFree = free;
+	obj = HashTable_ValueObject(cache->infos);
+	obj->fnObjectNew = drive_cache_info_clone;
+	obj->fnObjectFree = free;
+
+	cache->listings = ArrayList_New(FALSE);
+	if (!cache->listings)
+		goto fail;
+	ArrayList_Object(cache->listings)->fnObjectFree = drive_cache_listing_free;
+
+#if defined(__linux__)
+	cache->watches = HashTable_New(FALSE);
+	if (!cache->watches)
+		goto fail;
+	HashTable_ValueObject(cache->watches)->fnObjectFree = free;
+
+	/* without inotify only the time to live applies */
+	cache->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (cache->fd < 0)
+		WLog_DBG(TAG, "inotify not available [%d], using time based invalidation", errno);
+#endif
+
+	return cache;
+
+fail:
+	drive_cache_free(cache);
+	return NULL;
+}
@@ -0,0 +1,73 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * File System Virtual Channel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+#define FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/file.h>
+
+/* results of a directory search, immutable once created and shared by reference */
+typedef struct
+{
+	WCHAR* name;
+	WIN32_FILE_ATTRIBUTE_DATA info;
+} DRIVE_CACHE_ENTRY;
+
+typedef struct
+{
+	LONG refs;
+	WCHAR* pattern;
+	size_t dirLength;
+	DWORD error;
+	UINT64 expires;
+	int wd;
+
+	DRIVE_CACHE_ENTRY* entries;
+	size_t count;
+} DRIVE_CACHE_LISTING;
+
+typedef struct s_drive_cache DRIVE_CACHE;
+
+DRIVE_CACHE* drive_cache_new(void);
+void drive_cache_free(DRIVE_CACHE* cache);
+
+/** Returns the (cached) search results for pattern
+ *
+ *  Large directories are only read partially, the open search handle to continue with is
+ *  returned in phFind and the listing is not cached in that case.
+ *  A search that failed returns a listing without entries and the error code.
+ *  The cache might be NULL, then the directory is always read.
+ */
+DRIVE_CACHE_LISTING* drive_cache_get_listing(DRIVE_CACHE* cache, const WCHAR* pattern,
+                                             HANDLE* phFind);
+void drive_cache_listing_release(DRIVE_CACHE_LISTING* listing);
+
+/** Looks up the metadata of path, on a miss generation receives the value to pass to
+ *  drive_cache_put_info once the filesystem was queried.
+ */
+BOOL drive_cache_get_info(DRIVE_CACHE* cache, const WCHAR* path, WIN32_FILE_ATTRIBUTE_DATA* info,
+                          UINT64* generation);
+void drive_cache_put_info(DRIVE_CACHE* cache, const WCHAR* path,
+                          const WIN32_FILE_ATTRIBUTE_DATA* info, UINT64 generation);
+
+/** Drops everything cached about path and the listings of its parent directory, recursive
+ *  also drops everything below path.
+ */
+void drive_cache_invalidate(DRIVE_CACHE* cache, const WCHAR* path, BOOL recursive);
+
+#endif /* FREERDP_CHANNEL_DRIVE_CLIENT_CACHE_H */
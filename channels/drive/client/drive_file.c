@@ -44,6 +44,9 @@
 
 #include "drive_file.h"
 
+#define DRIVE_FILE_IO_BUFFER_SIZE (1024u * 1024u)
+#define DRIVE_FILE_SEQUENTIAL_THRESHOLD 2
+
 #ifdef WITH_DEBUG_RDPDR
 #define DEBUG_WSTR(msg, wstr)                                    \
 	do                                                           \
@@ -188,6 +191,91 @@ static BOOL drive_file_set_fullpath(DRIVE_FILE* file, const WCHAR* fullpath)
 	return TRUE;
 }
 
+static BOOL drive_file_set_position(DRIVE_FILE* file, UINT64 Offset)
+{
+	LARGE_INTEGER loffset = { 0 };
+
+	WINPR_ASSERT(file);
+
+	if (Offset > INT64_MAX)
+		return FALSE;
+
+	loffset.QuadPart = (LONGLONG)Offset;
+	return SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN);
+}
+
+static BOOL drive_file_read_at(DRIVE_FILE* file, UINT64 Offset, BYTE* buffer, UINT32* Length)
+{
+	DWORD read = 0;
+
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(Length);
+
+	if (!drive_file_set_position(file, Offset) ||
+	    !ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+		return FALSE;
+
+	*Length = read;
+	return TRUE;
+}
+
+static BOOL drive_file_write_at(DRIVE_FILE* file, UINT64 Offset, const BYTE* buffer,
+                                size_t Length)
+{
+	WINPR_ASSERT(file);
+
+	BOOL rc = drive_file_set_position(file, Offset);
+	while (rc && (Length > 0))
+	{
+		DWORD written = 0;
+		const DWORD chunk = (Length > UINT32_MAX) ? UINT32_MAX : (DWORD)Length;
+		if (!WriteFile(file->file_handle, buffer, chunk, &written, NULL))
+			rc = FALSE;
+
+		Length -= written;
+		buffer += written;
+	}
+
+	drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+	return rc;
+}
+
+static BOOL drive_file_ensure_io_buffer(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->io_buffer)
+		file->io_buffer = malloc(DRIVE_FILE_IO_BUFFER_SIZE);
+	return file->io_buffer != NULL;
+}
+
+/* writes out what write behind collected, read ahead data is kept */
+static BOOL drive_file_flush_pending(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->io_dirty)
+		return TRUE;
+
+	file->io_dirty = FALSE;
+	const size_t length = file->io_length;
+	file->io_length = 0;
+	return drive_file_write_at(file, file->io_offset, file->io_buffer, length);
+}
+
+/* clients read and write files in chunks of 64k at most, after a few consecutive ones the
+ * next are done in up to DRIVE_FILE_IO_BUFFER_SIZE large operations */
+static BOOL drive_file_is_sequential(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (file->offset == file->next_offset)
+		file->sequential++;
+	else
+		file->sequential = 0;
+	return file->sequential >= DRIVE_FILE_SEQUENTIAL_THRESHOLD;
+}
+
 static BOOL drive_file_init(DRIVE_FILE* file)
 {
 	UINT CreateDisposition = 0;
@@ -315,9 +403,10 @@ static BOOL drive_file_init(DRIVE_FILE* file)
 	return file->file_handle != INVALID_HANDLE_VALUE;
 }
 
-DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathWCharLength,
-                           UINT32 id, UINT32 DesiredAccess, UINT32 CreateDisposition,
-                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess)
+DRIVE_FILE* drive_file_new(DRIVE_CACHE* cache, const WCHAR* base_path, const WCHAR* path,
+                           UINT32 PathWCharLength, UINT32 id, UINT32 DesiredAccess,
+                           UINT32 CreateDisposition, UINT32 CreateOptions, UINT32 FileAttributes,
+                           UINT32 SharedAccess)
 {
 	if (!base_path || (!path && (PathWCharLength > 0)))
 		return NULL;
@@ -333,12 +422,16 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 	file->file_handle = INVALID_HANDLE_VALUE;
 	file->find_handle = INVALID_HANDLE_VALUE;
 	file->id = id;
+	file->cache = cache;
 	file->basepath = base_path;
 	file->FileAttributes = FileAttributes;
 	file->DesiredAccess = DesiredAccess;
 	file->CreateDisposition = CreateDisposition;
 	file->CreateOptions = CreateOptions;
 	file->SharedAccess = SharedAccess;
+	/* other handles must see the data, no buffering then */
+	file->shared_read = (SharedAccess & FILE_SHARE_READ) != 0;
+	file->shared_write = (SharedAccess & FILE_SHARE_WRITE) != 0;
 
 	WCHAR* p = drive_file_combine_fullpath(base_path, path, PathWCharLength);
 	(void)drive_file_set_fullpath(file, p);
@@ -352,16 +445,28 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 		return NULL;
 	}
 
+	/* anything but FILE_OPEN might have created or truncated it */
+	if (file->CreateDisposition != FILE_OPEN)
+		drive_cache_invalidate(file->cache, file->fullpath, FALSE);
+
 	return file;
 }
 
 BOOL drive_file_free(DRIVE_FILE* file)
 {
 	BOOL rc = FALSE;
+	BOOL flushed = TRUE;
 
 	if (!file)
 		return FALSE;
 
+	if (file->CreateOptions & FILE_DELETE_ON_CLOSE)
+		file->delete_pending = TRUE;
+
+	/* a failed write behind fails the close */
+	if (!file->delete_pending)
+		flushed = drive_file_flush_pending(file);
+
 	if (file->file_handle != INVALID_HANDLE_VALUE)
 	{
 		(void)CloseHandle(file->file_handle);
@@ -374,8 +479,8 @@ BOOL drive_file_free(DRIVE_FILE* file)
 		file->find_handle = INVALID_HANDLE_VALUE;
 	}
 
-	if (file->CreateOptions & FILE_DELETE_ON_CLOSE)
-		file->delete_pending = TRUE;
+	drive_cache_listing_release(file->listing);
+	file->listing = NULL;
 
 	if (file->delete_pending)
 	{
@@ -386,11 +491,13 @@ BOOL drive_file_free(DRIVE_FILE* file)
 		}
 		else if (!DeleteFileW(file->fullpath))
 			goto fail;
+		drive_cache_invalidate(file->cache, file->fullpath, file->is_dir);
 	}
 
-	rc = TRUE;
+	rc = flushed;
 fail:
 	DEBUG_WSTR("Free %s", file->fullpath);
+	free(file->io_buffer);
 	free(file->fullpath);
 	free(file);
 	return rc;
@@ -398,55 +505,122 @@ fail:
 
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
 {
-	LARGE_INTEGER loffset = { 0 };
-
 	if (!file)
 		return FALSE;
 
 	if (Offset > INT64_MAX)
 		return FALSE;
 
-	loffset.QuadPart = (LONGLONG)Offset;
-	return SetFilePointerEx(file->file_handle, loffset, NULL, FILE_BEGIN);
+	if (file->file_handle == INVALID_HANDLE_VALUE)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	/* done with the next read or write */
+	file->offset = Offset;
+	return TRUE;
 }
 
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 {
-	DWORD read = 0;
+	UINT32 done = 0;
 
 	if (!file || !buffer || !Length)
 		return FALSE;
 
 	DEBUG_WSTR("Read file %s", file->fullpath);
 
-	if (ReadFile(file->file_handle, buffer, *Length, &read, NULL))
+	if (!drive_file_flush_pending(file))
+		return FALSE;
+
+	const BOOL sequential = drive_file_is_sequential(file);
+	const UINT64 offset = file->offset;
+
+	if ((offset >= file->io_offset) && (offset - file->io_offset < file->io_length))
 	{
-		*Length = read;
-		return TRUE;
+		const size_t available = file->io_length - (size_t)(offset - file->io_offset);
+		done = (available < *Length) ? (UINT32)available : *Length;
+		memcpy(buffer, &file->io_buffer[offset - file->io_offset], done);
 	}
 
-	return FALSE;
+	if (done < *Length)
+	{
+		UINT32 length = *Length - done;
+
+		if (sequential && !file->shared_write && (length < DRIVE_FILE_IO_BUFFER_SIZE) &&
+		    drive_file_ensure_io_buffer(file))
+		{
+			UINT32 read = DRIVE_FILE_IO_BUFFER_SIZE;
+
+			file->io_length = 0;
+			if (!drive_file_read_at(file, offset + done, file->io_buffer, &read))
+				return FALSE;
+
+			file->io_offset = offset + done;
+			file->io_length = read;
+			if (length > read)
+				length = read;
+			memcpy(&buffer[done], file->io_buffer, length);
+		}
+		else if (!drive_file_read_at(file, offset + done, &buffer[done], &length))
+			return FALSE;
+
+		done += length;
+	}
+
+	file->offset = offset + done;
+	file->next_offset = file->offset;
+	*Length = done;
+	return TRUE;
 }
 
 BOOL drive_file_write(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length)
 {
-	DWORD written = 0;
+	BOOL rc = TRUE;
 
 	if (!file || !buffer)
 		return FALSE;
 
 	DEBUG_WSTR("Write file %s", file->fullpath);
 
-	while (Length > 0)
-	{
-		if (!WriteFile(file->file_handle, buffer, Length, &written, NULL))
-			return FALSE;
+	/* read ahead data is outdated now */
+	if (!file->io_dirty)
+		file->io_length = 0;
 
-		Length -= written;
-		buffer += written;
+	const BOOL sequential = drive_file_is_sequential(file);
+	const UINT64 offset = file->offset;
+
+	if (file->io_dirty && (offset == file->io_offset + file->io_length) &&
+	    (Length <= DRIVE_FILE_IO_BUFFER_SIZE - file->io_length))
+	{
+		memcpy(&file->io_buffer[file->io_length], buffer, Length);
+		file->io_length += Length;
+	}
+	else if (!drive_file_flush_pending(file))
+		rc = FALSE;
+	else if (sequential && !file->shared_read && (Length < DRIVE_FILE_IO_BUFFER_SIZE) &&
+	         drive_file_ensure_io_buffer(file))
+	{
+		memcpy(file->io_buffer, buffer, Length);
+		file->io_offset = offset;
+		file->io_length = Length;
+		file->io_dirty = TRUE;
 	}
+	else
+		rc = drive_file_write_at(file, offset, buffer, Length);
 
-	return TRUE;
+	file->offset = offset + Length;
+	file->next_offset = file->offset;
+	return rc;
+}
+
+BOOL drive_file_flush(DRIVE_FILE* file)
+{
+	if (!file)
+		return FALSE;
+
+	return drive_file_flush_pending(file);
 }
 
 static BOOL drive_file_query_from_handle_information(const DRIVE_FILE* file,
@@ -581,19 +755,52 @@ static BOOL drive_file_query_from_attributes(const DRIVE_FILE* file,
 	return TRUE;
 }
 
+static void drive_file_cache_information(const DRIVE_FILE* file,
+                                         const BY_HANDLE_FILE_INFORMATION* info, UINT64 generation)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attrib = { 0 };
+
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(info);
+
+	attrib.dwFileAttributes = info->dwFileAttributes;
+	attrib.ftCreationTime = info->ftCreationTime;
+	attrib.ftLastAccessTime = info->ftLastAccessTime;
+	attrib.ftLastWriteTime = info->ftLastWriteTime;
+	attrib.nFileSizeHigh = info->nFileSizeHigh;
+	attrib.nFileSizeLow = info->nFileSizeLow;
+	drive_cache_put_info(file->cache, file->fullpath, &attrib, generation);
+}
+
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
 {
 	BY_HANDLE_FILE_INFORMATION fileInformation = { 0 };
+	WIN32_FILE_ATTRIBUTE_DATA fileAttributes = { 0 };
+	UINT64 generation = 0;
 	BOOL status = 0;
 	HANDLE hFile = NULL;
 
 	if (!file || !output)
 		return FALSE;
 
+	/* sizes and times must include the writes not done yet */
+	if (!drive_file_flush_pending(file))
+		goto out_fail;
+
+	/* Explorer queries every entry of the listing it just read, the number of links for
+	 * FileStandardInformation is not part of the cached data */
+	if (drive_cache_get_info(file->cache, file->fullpath, &fileAttributes, &generation) &&
+	    ((FsInformationClass == FileBasicInformation) ||
+	     (FsInformationClass == FileAttributeTagInformation)))
+		return drive_file_query_from_attributes(file, &fileAttributes, FsInformationClass, output);
+
 	if ((file->file_handle != INVALID_HANDLE_VALUE) &&
 	    GetFileInformationByHandle(file->file_handle, &fileInformation))
+	{
+		drive_file_cache_information(file, &fileInformation, generation);
 		return drive_file_query_from_handle_information(file, &fileInformation, FsInformationClass,
 		                                                output);
+	}
 
 	hFile = CreateFileW(file->fullpath, 0, FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
 	                    FILE_ATTRIBUTE_NORMAL, NULL);
@@ -604,6 +811,7 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 		if (!status)
 			goto out_fail;
 
+		drive_file_cache_information(file, &fileInformation, generation);
 		if (!drive_file_query_from_handle_information(file, &fileInformation, FsInformationClass,
 		                                              output))
 			goto out_fail;
@@ -613,10 +821,10 @@ BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, w
 
 	/* If we failed before (i.e. if information for a drive is queried) fall back to
 	 * GetFileAttributesExW */
-	WIN32_FILE_ATTRIBUTE_DATA fileAttributes = { 0 };
 	if (!GetFileAttributesExW(file->fullpath, GetFileExInfoStandard, &fileAttributes))
 		goto out_fail;
 
+	drive_cache_put_info(file->cache, file->fullpath, &fileAttributes, generation);
 	if (!drive_file_query_from_attributes(file, &fileAttributes, FsInformationClass, output))
 		goto out_fail;
 
@@ -650,6 +858,10 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	if (!file || !input)
 		return FALSE;
 
+	if (!drive_file_flush_pending(file))
+		return FALSE;
+	file->io_length = 0;
+
 	switch (FsInformationClass)
 	{
 		case FileBasicInformation:
@@ -819,6 +1031,8 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 			                MOVEFILE_COPY_ALLOWED |
 			                    (ReplaceIfExists ? MOVEFILE_REPLACE_EXISTING : 0)))
 			{
+				drive_cache_invalidate(file->cache, file->fullpath, TRUE);
+				drive_cache_invalidate(file->cache, fullpath, TRUE);
 				const BOOL rc = drive_file_set_fullpath(file, fullpath);
 				free(fullpath);
 				if (!rc)
@@ -842,6 +1056,7 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 			return FALSE;
 	}
 
+	drive_cache_invalidate(file->cache, file->fullpath, FALSE);
 	return TRUE;
 }
 
@@ -972,6 +1187,57 @@ static BOOL drive_file_query_names_info(DRIVE_FILE* file, wStream* output, size_
 	return TRUE;
 }
 
+static void drive_file_release_search(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (file->find_handle != INVALID_HANDLE_VALUE)
+	{
+		FindClose(file->find_handle);
+		file->find_handle = INVALID_HANDLE_VALUE;
+	}
+
+	drive_cache_listing_release(file->listing);
+	file->listing = NULL;
+	file->listing_index = 0;
+}
+
+static BOOL drive_file_next_entry(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->listing)
+	{
+		SetLastError(ERROR_NO_MORE_FILES);
+		return FALSE;
+	}
+
+	if (file->listing_index < file->listing->count)
+	{
+		const DRIVE_CACHE_ENTRY* entry = &file->listing->entries[file->listing_index++];
+
+		file->find_data.dwFileAttributes = entry->info.dwFileAttributes;
+		file->find_data.ftCreationTime = entry->info.ftCreationTime;
+		file->find_data.ftLastAccessTime = entry->info.ftLastAccessTime;
+		file->find_data.ftLastWriteTime = entry->info.ftLastWriteTime;
+		file->find_data.nFileSizeHigh = entry->info.nFileSizeHigh;
+		file->find_data.nFileSizeLow = entry->info.nFileSizeLow;
+		size_t length = _wcslen(entry->name);
+		if (length >= ARRAYSIZE(file->find_data.cFileName))
+			length = ARRAYSIZE(file->find_data.cFileName) - 1;
+		memcpy(file->find_data.cFileName, entry->name, length * sizeof(WCHAR));
+		file->find_data.cFileName[length] = '\0';
+		return TRUE;
+	}
+
+	/* directories too large to be read at once continue with the search handle */
+	if (file->find_handle != INVALID_HANDLE_VALUE)
+		return FindNextFileW(file->find_handle, &file->find_data);
+
+	SetLastError((file->listing->error != 0) ? file->listing->error : ERROR_NO_MORE_FILES);
+	return FALSE;
+}
+
 BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYTE InitialQuery,
                                 const WCHAR* path, UINT32 PathWCharLength, wStream* output)
 {
@@ -984,19 +1250,19 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 
 	if (InitialQuery != 0)
 	{
-		/* release search handle */
-		if (file->find_handle != INVALID_HANDLE_VALUE)
-			FindClose(file->find_handle);
+		/* release the previous search */
+		drive_file_release_search(file);
 
 		ent_path = drive_file_combine_fullpath(file->basepath, path, PathWCharLength);
-		/* open new search handle and retrieve the first entry */
-		file->find_handle = FindFirstFileW(ent_path, &file->find_data);
-		free(ent_path);
-
-		if (file->find_handle == INVALID_HANDLE_VALUE)
+		if (!ent_path)
 			goto out_fail;
+
+		/* the whole listing is read (or taken from the cache) on the first query */
+		file->listing = drive_cache_get_listing(file->cache, ent_path, &file->find_handle);
+		free(ent_path);
 	}
-	else if (!FindNextFileW(file->find_handle, &file->find_data))
+
+	if (!drive_file_next_entry(file))
 		goto out_fail;
 
 	length = _wcslen(file->find_data.cFileName) * 2;
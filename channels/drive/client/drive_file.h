@@ -30,6 +30,8 @@
 #include <winpr/file.h>
 #include <freerdp/channels/log.h>
 
+#include "drive_cache.h"
+
 #define TAG CHANNELS_TAG("drive.client")
 
 typedef struct
@@ -39,6 +41,20 @@ typedef struct
 	HANDLE file_handle;
 	HANDLE find_handle;
 	WIN32_FIND_DATAW find_data;
+	DRIVE_CACHE* cache;
+	DRIVE_CACHE_LISTING* listing;
+	size_t listing_index;
+
+	/* read ahead data or, if io_dirty, writes not yet done */
+	UINT64 offset;
+	UINT64 next_offset;
+	UINT32 sequential;
+	BYTE* io_buffer;
+	UINT64 io_offset;
+	size_t io_length;
+	BOOL io_dirty;
+	BOOL shared_read;
+	BOOL shared_write;
 	const WCHAR* basepath;
 	WCHAR* fullpath;
 	BOOL delete_pending;
@@ -49,15 +65,17 @@ typedef struct
 	UINT32 CreateOptions;
 } DRIVE_FILE;
 
-DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathWCharLength,
-                           UINT32 id, UINT32 DesiredAccess, UINT32 CreateDisposition,
-                           UINT32 CreateOptions, UINT32 FileAttributes, UINT32 SharedAccess);
+DRIVE_FILE* drive_file_new(DRIVE_CACHE* cache, const WCHAR* base_path, const WCHAR* path,
+                           UINT32 PathWCharLength, UINT32 id, UINT32 DesiredAccess,
+                           UINT32 CreateDisposition, UINT32 CreateOptions, UINT32 FileAttributes,
+                           UINT32 SharedAccess);
 BOOL drive_file_free(DRIVE_FILE* file);
 
 BOOL drive_file_open(DRIVE_FILE* file);
 BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset);
 BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length);
 BOOL drive_file_write(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length);
+BOOL drive_file_flush(DRIVE_FILE* file);
 BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output);
 BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
                                 wStream* input);
@@ -46,6 +46,9 @@
 
 #include "drive_file.h"
 
+/* IRPs of different files are processed in parallel, the ones of a file in order */
+#define DRIVE_WORKER_THREADS 4
+
 typedef struct
 {
 	DEVICE device;
@@ -54,11 +57,17 @@ typedef struct
 	BOOL automount;
 	UINT32 PathLength;
 	wListDictionary* files;
+	DRIVE_CACHE* cache;
 
-	HANDLE thread;
+	HANDLE threads[DRIVE_WORKER_THREADS];
+	HANDLE stopEvent;
 	BOOL async;
 	wMessageQueue* IrpQueue;
 
+	/* FileId -> IRPs waiting for the one of that file currently queued or in progress */
+	CRITICAL_SECTION lock;
+	wListDictionary* pending;
+
 	DEVMAN* devman;
 
 	rdpContext* rdpcontext;
@@ -177,9 +186,12 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 		return ERROR_INVALID_DATA;
 
 	path = Stream_ConstPointer(irp->input);
+	EnterCriticalSection(&drive->lock);
 	FileId = irp->devman->id_sequence++;
-	file = drive_file_new(drive->path, path, PathLength / sizeof(WCHAR), FileId, DesiredAccess,
-	                      CreateDisposition, CreateOptions, FileAttributes, SharedAccess);
+	LeaveCriticalSection(&drive->lock);
+	file = drive_file_new(drive->cache, drive->path, path, PathLength / sizeof(WCHAR), FileId,
+	                      DesiredAccess, CreateDisposition, CreateOptions, FileAttributes,
+	                      SharedAccess);
 
 	if (!file)
 	{
@@ -749,6 +761,8 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 			break;
 
 		case IRP_MJ_LOCK_CONTROL:
+			/* whoever takes the lock expects to see what was written before */
+			(void)drive_file_flush(drive_get_file_by_id(drive, irp->FileId));
 			error = drive_process_irp_silent_ignore(drive, irp);
 			break;
 
@@ -787,6 +801,95 @@ static BOOL drive_poll_run(DRIVE_DEVICE* drive, IRP* irp)
 	return TRUE;
 }
 
+static void drive_irp_discard(void* obj)
+{
+	IRP* irp = obj;
+	if (!irp)
+		return;
+	WINPR_ASSERT(irp->Discard);
+	irp->Discard(irp);
+}
+
+static void drive_pending_free(void* obj)
+{
+	Queue_Free((wQueue*)obj);
+}
+
+/**
+ * Queues an IRP for the workers unless one of the same file is already queued or in
+ * progress, then it waits in drive->pending until that one is done.
+ */
+static BOOL drive_queue_irp(DRIVE_DEVICE* drive, IRP* irp)
+{
+	BOOL rc = FALSE;
+	wQueue* pending = NULL;
+	void* key = (void*)(size_t)irp->FileId;
+
+	WINPR_ASSERT(drive);
+	WINPR_ASSERT(irp);
+
+	/* a create has no file yet */
+	if (irp->MajorFunction == IRP_MJ_CREATE)
+		return MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL);
+
+	EnterCriticalSection(&drive->lock);
+	pending = ListDictionary_GetItemValue(drive->pending, key);
+	if (pending)
+	{
+		rc = Queue_Enqueue(pending, irp);
+		goto out;
+	}
+
+	pending = Queue_New(FALSE, -1, -1);
+	if (!pending)
+		goto out;
+
+	wObject* obj = Queue_Object(pending);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = drive_irp_discard;
+
+	if (!ListDictionary_Add(drive->pending, key, pending))
+	{
+		Queue_Free(pending);
+		goto out;
+	}
+
+	rc = MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL);
+	if (!rc)
+		ListDictionary_Remove(drive->pending, key);
+
+out:
+	LeaveCriticalSection(&drive->lock);
+	return rc;
+}
+
+/* hands the next IRP of the file to the workers */
+static BOOL drive_irp_done(DRIVE_DEVICE* drive, UINT32 MajorFunction, UINT32 FileId)
+{
+	BOOL rc = TRUE;
+	void* key = (void*)(size_t)FileId;
+
+	WINPR_ASSERT(drive);
+
+	if (MajorFunction == IRP_MJ_CREATE)
+		return TRUE;
+
+	EnterCriticalSection(&drive->lock);
+	wQueue* pending = ListDictionary_GetItemValue(drive->pending, key);
+	IRP* next = pending ? Queue_Dequeue(pending) : NULL;
+	if (next)
+	{
+		rc = MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)next, NULL);
+		if (!rc)
+			drive_irp_discard(next);
+	}
+	else
+		ListDictionary_Remove(drive->pending, key);
+	LeaveCriticalSection(&drive->lock);
+
+	return rc;
+}
+
 static DWORD WINAPI drive_thread_func(LPVOID arg)
 {
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
@@ -798,31 +901,42 @@ static DWORD WINAPI drive_thread_func(LPVOID arg)
 		goto fail;
 	}
 
+	HANDLE handles[] = { drive->stopEvent, MessageQueue_Event(drive->IrpQueue) };
+
 	while (1)
 	{
-		if (!MessageQueue_Wait(drive->IrpQueue))
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+		if (status == WAIT_OBJECT_0)
+			break;
+
+		if (status != WAIT_OBJECT_0 + 1)
 		{
-			WLog_ERR(TAG, "MessageQueue_Wait failed!");
+			WLog_ERR(TAG, "WaitForMultipleObjects failed with %" PRIu32 "!", status);
 			error = ERROR_INTERNAL_ERROR;
 			break;
 		}
 
-		if (MessageQueue_Size(drive->IrpQueue) < 1)
-			continue;
-
 		wMessage message = { 0 };
-		if (!MessageQueue_Peek(drive->IrpQueue, &message, TRUE))
-		{
-			WLog_ERR(TAG, "MessageQueue_Peek failed!");
+		if (MessageQueue_Peek(drive->IrpQueue, &message, TRUE) <= 0)
 			continue;
-		}
 
 		if (message.id == WMQ_QUIT)
 			break;
 
 		IRP* irp = (IRP*)message.wParam;
-		if (!drive_poll_run(drive, irp))
+		if (!irp)
+			continue;
+
+		/* the IRP is gone once completed */
+		const UINT32 MajorFunction = irp->MajorFunction;
+		const UINT32 FileId = irp->FileId;
+		const BOOL success = drive_poll_run(drive, irp);
+
+		if (!drive_irp_done(drive, MajorFunction, FileId) || !success)
+		{
+			error = ERROR_INTERNAL_ERROR;
 			break;
+		}
 	}
 
 fail:
@@ -848,7 +962,7 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 
 	if (drive->async)
 	{
-		if (!MessageQueue_Post(drive->IrpQueue, NULL, 0, (void*)irp, NULL))
+		if (!drive_queue_irp(drive, irp))
 		{
 			WLog_ERR(TAG, "MessageQueue_Post failed!");
 			return ERROR_INTERNAL_ERROR;
@@ -863,6 +977,26 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 	return CHANNEL_RC_OK;
 }
 
+static UINT drive_stop_threads(DRIVE_DEVICE* drive)
+{
+	WINPR_ASSERT(drive);
+
+	if (drive->stopEvent)
+		(void)SetEvent(drive->stopEvent);
+
+	for (size_t x = 0; x < ARRAYSIZE(drive->threads); x++)
+	{
+		if (drive->threads[x] && (WaitForSingleObject(drive->threads[x], INFINITE) == WAIT_FAILED))
+		{
+			const UINT error = GetLastError();
+			WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+			return error;
+		}
+	}
+
+	return CHANNEL_RC_OK;
+}
+
 static UINT drive_free_int(DRIVE_DEVICE* drive)
 {
 	UINT error = CHANNEL_RC_OK;
@@ -870,9 +1004,14 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	(void)CloseHandle(drive->thread);
+	for (size_t x = 0; x < ARRAYSIZE(drive->threads); x++)
+		(void)CloseHandle(drive->threads[x]);
+	(void)CloseHandle(drive->stopEvent);
+	ListDictionary_Free(drive->pending);
 	ListDictionary_Free(drive->files);
+	drive_cache_free(drive->cache);
 	MessageQueue_Free(drive->IrpQueue);
+	DeleteCriticalSection(&drive->lock);
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -892,13 +1031,9 @@ static UINT drive_free(DEVICE* device)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	if (MessageQueue_PostQuit(drive->IrpQueue, 0) &&
-	    (WaitForSingleObject(drive->thread, INFINITE) == WAIT_FAILED))
-	{
-		error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+	error = drive_stop_threads(drive);
+	if (error)
 		return error;
-	}
 
 	return drive_free_int(drive);
 }
@@ -919,11 +1054,7 @@ static void drive_message_free(void* obj)
 	if (msg->id != 0)
 		return;
 
-	IRP* irp = (IRP*)msg->wParam;
-	if (!irp)
-		return;
-	WINPR_ASSERT(irp->Discard);
-	irp->Discard(irp);
+	drive_irp_discard(msg->wParam);
 }
 
 /**
@@ -956,6 +1087,7 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		InitializeCriticalSection(&drive->lock);
 		drive->device.type = RDPDR_DTYP_FILESYSTEM;
 		drive->device.IRPRequest = drive_irp_request;
 		drive->device.Free = drive_free;
@@ -1017,6 +1149,24 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		}
 
 		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
+
+		drive->cache = drive_cache_new();
+		if (!drive->cache)
+		{
+			WLog_ERR(TAG, "drive_cache_new failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		drive->pending = ListDictionary_New(FALSE);
+		if (!drive->pending)
+		{
+			WLog_ERR(TAG, "ListDictionary_New failed!");
+			error = CHANNEL_RC_NO_MEMORY;
+			goto out_error;
+		}
+
+		ListDictionary_ValueObject(drive->pending)->fnObjectFree = drive_pending_free;
 		drive->IrpQueue = MessageQueue_New(NULL);
 
 		if (!drive->IrpQueue)
@@ -1040,19 +1190,30 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 		                                          FreeRDP_SynchronousStaticChannels);
 		if (drive->async)
 		{
-			if (!(drive->thread =
-			          CreateThread(NULL, 0, drive_thread_func, drive, CREATE_SUSPENDED, NULL)))
+			if (!(drive->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
 			{
-				WLog_ERR(TAG, "CreateThread failed!");
+				WLog_ERR(TAG, "CreateEvent failed!");
 				goto out_error;
 			}
 
-			ResumeThread(drive->thread);
+			for (size_t x = 0; x < ARRAYSIZE(drive->threads); x++)
+			{
+				if (!(drive->threads[x] = CreateThread(NULL, 0, drive_thread_func, drive,
+				                                       CREATE_SUSPENDED, NULL)))
+				{
+					WLog_ERR(TAG, "CreateThread failed!");
+					goto out_error;
+				}
+
+				ResumeThread(drive->threads[x]);
+			}
 		}
 	}
 
 	return CHANNEL_RC_OK;
 out_error:
+	if (drive)
+		(void)drive_stop_threads(drive);
 	drive_free_int(drive);
 	return error;
 }
@@ -39,6 +39,21 @@
 
 #define TAG CHANNELS_TAG("echo.server")
 
+#define ECHO_BENCHMARK_MAGIC 0x4d425246 /* FRBM */
+
+typedef struct
+{
+	UINT32 run;
+	UINT32 sent;
+	UINT32 received;
+	UINT32 invalid;
+	UINT64 bytes;
+	UINT64 last; /* ns timestamp of the last response */
+	UINT64* rtts;
+	BYTE* outstanding;
+	HANDLE event;
+} echo_benchmark;
+
 typedef struct
 {
 	echo_server_context context;
@@ -52,6 +67,9 @@ typedef struct
 
 	DWORD SessionId;
 
+	CRITICAL_SECTION lock;
+	echo_benchmark* benchmark;
+	UINT32 benchmarkRuns;
 } echo_server;
 
 /**
@@ -120,6 +138,44 @@ static UINT echo_server_open_channel(echo_server* echo)
 	return echo->echo_channel ? CHANNEL_RC_OK : ERROR_INTERNAL_ERROR;
 }
 
+/* Consumes the response if it belongs to the running benchmark */
+static BOOL echo_server_benchmark_response(echo_server* echo, const BYTE* buffer, UINT32 length)
+{
+	BOOL rc = FALSE;
+
+	if (length < ECHO_SERVER_BENCHMARK_HEADER_SIZE)
+		return FALSE;
+
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	const UINT32 magic = Stream_Get_UINT32(s);
+	const UINT32 run = Stream_Get_UINT32(s);
+	const UINT32 seq = Stream_Get_UINT32(s);
+	const UINT64 timestamp = Stream_Get_UINT64(s);
+	if (magic != ECHO_BENCHMARK_MAGIC)
+		return FALSE;
+
+	EnterCriticalSection(&echo->lock);
+	echo_benchmark* bench = echo->benchmark;
+	if (bench && (bench->run == run))
+	{
+		const UINT64 now = winpr_GetTickCount64NS();
+		if ((seq < bench->sent) && bench->outstanding[seq] && (timestamp <= now))
+		{
+			bench->outstanding[seq] = 0;
+			bench->rtts[bench->received++] = (now - timestamp) / 1000ull;
+			bench->bytes += length;
+			bench->last = now;
+		}
+		else
+			bench->invalid++;
+		(void)SetEvent(bench->event);
+		rc = TRUE;
+	}
+	LeaveCriticalSection(&echo->lock);
+	return rc;
+}
+
 static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 {
 	wStream* s = NULL;
@@ -205,6 +261,7 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 
 		if (ready)
 		{
+			echo->opened = TRUE;
 			IFCALLRET(echo->context.OpenResult, error, &echo->context, ECHO_SERVER_OPEN_RESULT_OK);
 
 			if (error)
@@ -264,6 +321,9 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 			break;
 		}
 
+		if (echo_server_benchmark_response(echo, Stream_Buffer(s), BytesReturned))
+			continue;
+
 		IFCALLRET(echo->context.Response, error, &echo->context, Stream_Buffer(s), BytesReturned);
 
 		if (error)
@@ -274,6 +334,7 @@ static DWORD WINAPI echo_server_thread_func(LPVOID arg)
 	}
 
 	Stream_Free(s, TRUE);
+	echo->opened = FALSE;
 	(void)WTSVirtualChannelClose(echo->echo_channel);
 	echo->echo_channel = NULL;
 out:
@@ -359,6 +420,157 @@ static BOOL echo_server_request(echo_server_context* context, const BYTE* buffer
 	return WTSVirtualChannelWrite(echo->echo_channel, cnv.pv, length, NULL);
 }
 
+static int echo_server_benchmark_compare(const void* a, const void* b)
+{
+	const UINT64 va = *(const UINT64*)a;
+	const UINT64 vb = *(const UINT64*)b;
+	if (va < vb)
+		return -1;
+	return (va > vb) ? 1 : 0;
+}
+
+static void echo_server_benchmark_result(const echo_benchmark* bench, UINT64 start,
+                                         ECHO_SERVER_BENCHMARK_RESULT* result)
+{
+	result->Sent = bench->sent;
+	result->Received = bench->received;
+	result->Invalid = bench->invalid;
+	result->Bytes = bench->bytes;
+	if (bench->received == 0)
+		return;
+
+	result->Duration = (bench->last - start) / 1000ull;
+	if (result->Duration > 0)
+		result->Throughput = bench->bytes * 1000000ull / result->Duration;
+
+	const size_t n = bench->received;
+	qsort(bench->rtts, n, sizeof(UINT64), echo_server_benchmark_compare);
+	result->RttMin = bench->rtts[0];
+	result->RttP50 = bench->rtts[(n - 1) * 50 / 100];
+	result->RttP90 = bench->rtts[(n - 1) * 90 / 100];
+	result->RttP99 = bench->rtts[(n - 1) * 99 / 100];
+	result->RttMax = bench->rtts[n - 1];
+}
+
+/* Waits until fewer than max requests are in flight, FALSE on timeout or close */
+static BOOL echo_server_benchmark_wait(echo_server* echo, echo_benchmark* bench, UINT32 max,
+                                       UINT32 timeout)
+{
+	for (;;)
+	{
+		EnterCriticalSection(&echo->lock);
+		const UINT32 inflight = bench->sent - bench->received;
+		LeaveCriticalSection(&echo->lock);
+
+		if (inflight < max)
+			return TRUE;
+		if (!echo->opened)
+			return FALSE;
+
+		HANDLE events[] = { bench->event, echo->stopEvent };
+		if (WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, timeout) != WAIT_OBJECT_0)
+			return FALSE;
+	}
+}
+
+static UINT echo_server_benchmark(echo_server_context* context,
+                                  const ECHO_SERVER_BENCHMARK_SETTINGS* settings,
+                                  ECHO_SERVER_BENCHMARK_RESULT* result)
+{
+	UINT error = CHANNEL_RC_NO_MEMORY;
+	echo_server* echo = (echo_server*)context;
+	echo_benchmark bench = { 0 };
+	wStream* s = NULL;
+
+	WINPR_ASSERT(echo);
+	if (!settings || !result || (settings->PayloadSize < ECHO_SERVER_BENCHMARK_HEADER_SIZE) ||
+	    (settings->Count == 0))
+		return ERROR_INVALID_PARAMETER;
+	if (!echo->opened)
+		return ERROR_INVALID_STATE;
+
+	*result = (ECHO_SERVER_BENCHMARK_RESULT){ 0 };
+	const UINT32 window = MAX(settings->Window, 1);
+	const UINT32 timeout = settings->Timeout ? settings->Timeout : 5000;
+
+	bench.rtts = calloc(settings->Count, sizeof(UINT64));
+	bench.outstanding = calloc(settings->Count, sizeof(BYTE));
+	bench.event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	s = Stream_New(NULL, settings->PayloadSize);
+	if (!bench.rtts || !bench.outstanding || !bench.event || !s)
+		goto out;
+
+	/* the pattern after the header lets the peer see corrupted payloads */
+	for (size_t x = ECHO_SERVER_BENCHMARK_HEADER_SIZE; x < settings->PayloadSize; x++)
+		Stream_Buffer(s)[x] = (BYTE)x;
+
+	EnterCriticalSection(&echo->lock);
+	if (echo->benchmark)
+	{
+		LeaveCriticalSection(&echo->lock);
+		error = ERROR_BUSY;
+		goto out;
+	}
+	bench.run = ++echo->benchmarkRuns;
+	echo->benchmark = &bench;
+	LeaveCriticalSection(&echo->lock);
+
+	error = CHANNEL_RC_OK;
+	const UINT64 start = winpr_GetTickCount64NS();
+	for (UINT32 seq = 0; seq < settings->Count; seq++)
+	{
+		if (settings->Rate > 0)
+		{
+			const UINT64 due = start + 1000000000ull * seq / settings->Rate;
+			const UINT64 now = winpr_GetTickCount64NS();
+			if (due > now)
+			{
+				if (WaitForSingleObject(echo->stopEvent, (DWORD)((due - now) / 1000000ull)) !=
+				    WAIT_TIMEOUT)
+					break;
+			}
+		}
+
+		if (!echo_server_benchmark_wait(echo, &bench, window, timeout))
+			break;
+
+		Stream_SetPosition(s, 0);
+		Stream_Write_UINT32(s, ECHO_BENCHMARK_MAGIC);
+		Stream_Write_UINT32(s, bench.run);
+		Stream_Write_UINT32(s, seq);
+		Stream_Write_UINT64(s, winpr_GetTickCount64NS());
+
+		EnterCriticalSection(&echo->lock);
+		bench.outstanding[seq] = 1;
+		bench.sent++;
+		LeaveCriticalSection(&echo->lock);
+
+		if (!WTSVirtualChannelWrite(echo->echo_channel, Stream_BufferAs(s, char),
+		                            settings->PayloadSize, NULL))
+		{
+			error = ERROR_INTERNAL_ERROR;
+			break;
+		}
+	}
+
+	/* responses still missing after the timeout count as lost */
+	(void)echo_server_benchmark_wait(echo, &bench, 1, timeout);
+
+	EnterCriticalSection(&echo->lock);
+	echo->benchmark = NULL;
+	LeaveCriticalSection(&echo->lock);
+
+	echo_server_benchmark_result(&bench, start, result);
+
+out:
+	Stream_Free(s, TRUE);
+	if (bench.event)
+		(void)CloseHandle(bench.event);
+	free(bench.outstanding);
+	free(bench.rtts);
+	return error;
+}
+
 echo_server_context* echo_server_context_new(HANDLE vcm)
 {
 	echo_server* echo = NULL;
@@ -366,10 +578,17 @@ echo_server_context* echo_server_context_new(HANDLE vcm)
 
 	if (echo)
 	{
+		if (!InitializeCriticalSectionAndSpinCount(&echo->lock, 4000))
+		{
+			free(echo);
+			return NULL;
+		}
+
 		echo->context.vcm = vcm;
 		echo->context.Open = echo_server_open;
 		echo->context.Close = echo_server_close;
 		echo->context.Request = echo_server_request;
+		echo->context.Benchmark = echo_server_benchmark;
 	}
 	else
 		WLog_ERR(TAG, "calloc failed!");
@@ -380,6 +599,9 @@ echo_server_context* echo_server_context_new(HANDLE vcm)
 void echo_server_context_free(echo_server_context* context)
 {
 	echo_server* echo = (echo_server*)context;
+	if (!echo)
+		return;
 	echo_server_close(context);
+	DeleteCriticalSection(&echo->lock);
 	free(echo);
 }
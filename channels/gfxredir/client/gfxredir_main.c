@@ -0,0 +1,691 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDPXXXX Remote App Graphics Redirection Virtual Channel Extension
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/stream.h>
+#include <winpr/string.h>
+#include <winpr/collections.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <freerdp/addin.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/client/gfxredir.h>
+#include <freerdp/channels/log.h>
+
+#define TAG CHANNELS_TAG("gfxredir.client")
+
+#include "gfxredir_main.h"
+#include <gfxredir_common.h>
+
+/* A shared memory section announced by the server, mapped read only */
+typedef struct
+{
+	UINT64 poolId;
+	UINT64 poolSize;
+	BYTE* data;
+#if defined(_WIN32)
+	HANDLE section;
+#endif
+} GFXREDIR_POOL;
+
+typedef struct
+{
+	GFXREDIR_CLIENT_BUFFER buffer;
+	GFXREDIR_POOL* pool;
+} GFXREDIR_BUFFER;
+
+typedef struct
+{
+	GENERIC_DYNVC_PLUGIN base;
+	GfxRedirClientContext* context;
+	wHashTable* pools;
+	wHashTable* buffers;
+} GFXREDIR_PLUGIN;
+
+static UINT32 gfxredir_id_hash(const void* v)
+{
+	const UINT64* id = (const UINT64*)v;
+	return (UINT32)((*id >> 32) + (*id & 0xffffffff));
+}
+
+static BOOL gfxredir_id_compare(const void* v1, const void* v2)
+{
+	const UINT64* id1 = (const UINT64*)v1;
+	const UINT64* id2 = (const UINT64*)v2;
+	return *id1 == *id2;
+}
+
+static void gfxredir_pool_free(void* obj)
+{
+	GFXREDIR_POOL* pool = (GFXREDIR_POOL*)obj;
+
+	if (!pool)
+		return;
+
+#if defined(_WIN32)
+	if (pool->data)
+		UnmapViewOfFile(pool->data);
+	if (pool->section)
+		(void)CloseHandle(pool->section);
+#else
+	if (pool->data)
+		munmap(pool->data, (size_t)pool->poolSize);
+#endif
+	free(pool);
+}
+
+/**
+ * Maps the section of the server. POSIX clients open the name with shm_open, names which are
+ * not plain shm_open names are rejected.
+ */
+static GFXREDIR_POOL* gfxredir_pool_new(wLog* log, UINT64 poolId, UINT64 poolSize,
+                                        const WCHAR* sectionName, size_t sectionNameLength)
+{
+	GFXREDIR_POOL* pool = calloc(1, sizeof(GFXREDIR_POOL));
+	if (!pool)
+		return NULL;
+
+	pool->poolId = poolId;
+	pool->poolSize = poolSize;
+
+	if ((poolSize == 0) || (poolSize > SIZE_MAX))
+		goto fail;
+
+#if defined(_WIN32)
+	WINPR_UNUSED(sectionNameLength);
+	pool->section = OpenFileMappingW(FILE_MAP_READ, FALSE, sectionName);
+	if (!pool->section)
+	{
+		WLog_Print(log, WLOG_ERROR, "OpenFileMapping for pool 0x%" PRIx64 " failed", poolId);
+		goto fail;
+	}
+
+	pool->data = MapViewOfFile(pool->section, FILE_MAP_READ, 0, 0, (SIZE_T)poolSize);
+	if (!pool->data)
+	{
+		WLog_Print(log, WLOG_ERROR, "MapViewOfFile for pool 0x%" PRIx64 " failed", poolId);
+		goto fail;
+	}
+#else
+	{
+		char* name = gfxredir_shm_name(sectionName, sectionNameLength);
+		if (!name)
+		{
+			WLog_Print(log, WLOG_ERROR, "invalid section name for pool 0x%" PRIx64, poolId);
+			goto fail;
+		}
+
+		const int fd = shm_open(name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC, 0);
+		if (fd < 0)
+		{
+			WLog_Print(log, WLOG_ERROR, "unable to open section %s for pool 0x%" PRIx64, name,
+			           poolId);
+			free(name);
+			goto fail;
+		}
+		free(name);
+
+		struct stat st = { 0 };
+		if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode))
+		{
+			WLog_Print(log, WLOG_ERROR, "section of pool 0x%" PRIx64 " is no shared memory",
+			           poolId);
+			close(fd);
+			goto fail;
+		}
+
+		if ((st.st_size < 0) || ((UINT64)st.st_size < poolSize))
+		{
+			WLog_Print(log, WLOG_ERROR, "section of pool 0x%" PRIx64 " is smaller than %" PRIu64,
+			           poolId, poolSize);
+			close(fd);
+			goto fail;
+		}
+
+		void* data = mmap(NULL, (size_t)poolSize, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			WLog_Print(log, WLOG_ERROR, "mmap for pool 0x%" PRIx64 " failed", poolId);
+			goto fail;
+		}
+		pool->data = data;
+	}
+#endif
+
+	return pool;
+fail:
+	gfxredir_pool_free(pool);
+	return NULL;
+}
+
+static void gfxredir_buffer_free(void* obj)
+{
+	free(obj);
+}
+
+static wHashTable* gfxredir_table_new(OBJECT_FREE_FN fnFree)
+{
+	wHashTable* table = HashTable_New(FALSE);
+	if (!table)
+		return NULL;
+
+	if (!HashTable_SetHashFunction(table, gfxredir_id_hash))
+		goto fail;
+	{
+		wObject* obj = HashTable_KeyObject(table);
+		obj->fnObjectEquals = gfxredir_id_compare;
+	}
+	{
+		wObject* obj = HashTable_ValueObject(table);
+		obj->fnObjectFree = fnFree;
+	}
+	return table;
+fail:
+	HashTable_Free(table);
+	return NULL;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_send_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStream* s)
+{
+	WINPR_ASSERT(callback);
+	WINPR_ASSERT(callback->channel);
+	WINPR_ASSERT(callback->channel->Write);
+
+	Stream_SealLength(s);
+	return callback->channel->Write(callback->channel, (ULONG)Stream_Length(s), Stream_Buffer(s),
+	                                NULL);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_send_caps_advertise(GENERIC_CHANNEL_CALLBACK* callback)
+{
+	BYTE buffer[GFXREDIR_HEADER_SIZE + GFXREDIR_CAPS_HEADER_SIZE + 4] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	const GFXREDIR_HEADER header = { .cmdId = GFXREDIR_CMDID_CAPS_ADVERTISE,
+		                             .length = sizeof(buffer) };
+
+	const UINT error = gfxredir_write_header(s, &header);
+	if (error)
+		return error;
+
+	Stream_Write_UINT32(s, GFXREDIR_CAPS_SIGNATURE);
+	Stream_Write_UINT32(s, GFXREDIR_CAPS_VERSION2_0);
+	Stream_Write_UINT32(s, GFXREDIR_CAPS_HEADER_SIZE + 4);
+	Stream_Write_UINT32(s, 0); /* supportedFeatures (4 bytes) */
+	return gfxredir_send_pdu(callback, s);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_send_present_buffer_ack(GENERIC_CHANNEL_CALLBACK* callback, UINT64 windowId,
+                                             UINT64 presentId)
+{
+	BYTE buffer[GFXREDIR_HEADER_SIZE + 16] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	const GFXREDIR_HEADER header = { .cmdId = GFXREDIR_CMDID_PRESENT_BUFFER_ACK,
+		                             .length = sizeof(buffer) };
+
+	const UINT error = gfxredir_write_header(s, &header);
+	if (error)
+		return error;
+
+	Stream_Write_UINT64(s, windowId);  /* windowId (8 bytes) */
+	Stream_Write_UINT64(s, presentId); /* presentId (8 bytes) */
+	return gfxredir_send_pdu(callback, s);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_caps_confirm_pdu(GFXREDIR_PLUGIN* gfxredir, wStream* s)
+{
+	WINPR_ASSERT(gfxredir);
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, s, GFXREDIR_CAPS_HEADER_SIZE))
+		return ERROR_INVALID_DATA;
+
+	const UINT32 signature = Stream_Get_UINT32(s);
+	const UINT32 version = Stream_Get_UINT32(s);
+	const UINT32 length = Stream_Get_UINT32(s);
+
+	if ((signature != GFXREDIR_CAPS_SIGNATURE) || (length < GFXREDIR_CAPS_HEADER_SIZE) ||
+	    !Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, s,
+	                                          length - GFXREDIR_CAPS_HEADER_SIZE))
+		return ERROR_INVALID_DATA;
+
+	Stream_Seek(s, length - GFXREDIR_CAPS_HEADER_SIZE);
+
+	if (version != GFXREDIR_CAPS_VERSION2_0)
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR, "unsupported caps version 0x%08" PRIx32,
+		           version);
+		return ERROR_NOT_SUPPORTED;
+	}
+
+	gfxredir->context->confirmedCapsVersion = version;
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_open_pool_pdu(GFXREDIR_PLUGIN* gfxredir, wStream* s)
+{
+	WINPR_ASSERT(gfxredir);
+
+	GFXREDIR_OPEN_POOL_PDU pdu = { 0 };
+	const UINT error = gfxredir_read_open_pool_pdu(s, &pdu);
+	if (error)
+		return error;
+
+	if (HashTable_Contains(gfxredir->pools, &pdu.poolId))
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR, "pool 0x%" PRIx64 " is already open",
+		           pdu.poolId);
+		return ERROR_INVALID_DATA;
+	}
+
+	GFXREDIR_POOL* pool = gfxredir_pool_new(gfxredir->base.log, pdu.poolId, pdu.poolSize,
+	                                        (const WCHAR*)pdu.sectionName, pdu.sectionNameLength);
+	if (!pool)
+		return ERROR_OPEN_FAILED;
+
+	if (!HashTable_Insert(gfxredir->pools, &pool->poolId, pool))
+	{
+		gfxredir_pool_free(pool);
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_close_pool_pdu(GFXREDIR_PLUGIN* gfxredir, wStream* s)
+{
+	WINPR_ASSERT(gfxredir);
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, s, 8))
+		return ERROR_INVALID_DATA;
+
+	const UINT64 poolId = Stream_Get_UINT64(s);
+
+	/* buffers must not outlive the mapping they point into */
+	ULONG_PTR* keys = NULL;
+	const size_t count = HashTable_GetKeys(gfxredir->buffers, &keys);
+	for (size_t x = 0; x < count; x++)
+	{
+		const GFXREDIR_BUFFER* buffer = HashTable_GetItemValue(gfxredir->buffers, (void*)keys[x]);
+		if (buffer && (buffer->pool->poolId == poolId))
+			HashTable_Remove(gfxredir->buffers, (void*)keys[x]);
+	}
+	free(keys);
+
+	if (!HashTable_Remove(gfxredir->pools, &poolId))
+		WLog_Print(gfxredir->base.log, WLOG_WARN, "unknown pool 0x%" PRIx64, poolId);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_create_buffer_pdu(GFXREDIR_PLUGIN* gfxredir, wStream* s)
+{
+	WINPR_ASSERT(gfxredir);
+
+	GFXREDIR_CREATE_BUFFER_PDU pdu = { 0 };
+	const UINT error = gfxredir_read_create_buffer_pdu(s, &pdu);
+	if (error)
+		return error;
+
+	GFXREDIR_POOL* pool = HashTable_GetItemValue(gfxredir->pools, &pdu.poolId);
+	if (!pool)
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR,
+		           "buffer 0x%" PRIx64 " in unknown pool 0x%" PRIx64, pdu.bufferId, pdu.poolId);
+		return ERROR_INVALID_DATA;
+	}
+
+	UINT32 format = 0;
+	switch (pdu.format)
+	{
+		case GFXREDIR_BUFFER_PIXEL_FORMAT_XRGB_8888:
+			format = PIXEL_FORMAT_BGRX32;
+			break;
+		case GFXREDIR_BUFFER_PIXEL_FORMAT_ARGB_8888:
+			format = PIXEL_FORMAT_BGRA32;
+			break;
+		default:
+			WLog_Print(gfxredir->base.log, WLOG_ERROR, "unsupported buffer format %" PRIu32,
+			           pdu.format);
+			return ERROR_INVALID_DATA;
+	}
+
+	if (!gfxredir_buffer_fits_pool(&pdu, pool->poolSize))
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR,
+		           "buffer 0x%" PRIx64 " does not fit into pool 0x%" PRIx64, pdu.bufferId,
+		           pdu.poolId);
+		return ERROR_INVALID_DATA;
+	}
+
+	GFXREDIR_BUFFER* buffer = calloc(1, sizeof(GFXREDIR_BUFFER));
+	if (!buffer)
+		return CHANNEL_RC_NO_MEMORY;
+
+	buffer->pool = pool;
+	buffer->buffer.poolId = pdu.poolId;
+	buffer->buffer.bufferId = pdu.bufferId;
+	buffer->buffer.data = &pool->data[pdu.offset];
+	buffer->buffer.stride = pdu.stride;
+	buffer->buffer.width = pdu.width;
+	buffer->buffer.height = pdu.height;
+	buffer->buffer.format = format;
+
+	HashTable_Remove(gfxredir->buffers, &pdu.bufferId);
+	if (!HashTable_Insert(gfxredir->buffers, &buffer->buffer.bufferId, buffer))
+	{
+		gfxredir_buffer_free(buffer);
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_destroy_buffer_pdu(GFXREDIR_PLUGIN* gfxredir, wStream* s)
+{
+	WINPR_ASSERT(gfxredir);
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, s, 8))
+		return ERROR_INVALID_DATA;
+
+	const UINT64 bufferId = Stream_Get_UINT64(s);
+	if (!HashTable_Remove(gfxredir->buffers, &bufferId))
+		WLog_Print(gfxredir->base.log, WLOG_WARN, "unknown buffer 0x%" PRIx64, bufferId);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_present_buffer_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStream* s)
+{
+	RECTANGLE_32 opaqueRects[GFXREDIR_MAX_OPAQUE_RECTS] = { 0 };
+	GFXREDIR_PRESENT_BUFFER_PDU pdu = { 0 };
+
+	WINPR_ASSERT(callback);
+	GFXREDIR_PLUGIN* gfxredir = (GFXREDIR_PLUGIN*)callback->plugin;
+	WINPR_ASSERT(gfxredir);
+
+	UINT error = gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects);
+	if (error)
+		return error;
+
+	const GFXREDIR_BUFFER* buffer = HashTable_GetItemValue(gfxredir->buffers, &pdu.bufferId);
+	if (!buffer)
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR, "present of unknown buffer 0x%" PRIx64,
+		           pdu.bufferId);
+		return ERROR_INVALID_DATA;
+	}
+
+	const GFXREDIR_CLIENT_BUFFER* cb = &buffer->buffer;
+	pdu.dirtyRect.left = MIN(pdu.dirtyRect.left, cb->width);
+	pdu.dirtyRect.top = MIN(pdu.dirtyRect.top, cb->height);
+	pdu.dirtyRect.width = MIN(pdu.dirtyRect.width, cb->width - pdu.dirtyRect.left);
+	pdu.dirtyRect.height = MIN(pdu.dirtyRect.height, cb->height - pdu.dirtyRect.top);
+
+	GfxRedirClientContext* context = gfxredir->context;
+	IFCALLRET(context->PresentBuffer, error, context, &pdu, cb);
+	if (error)
+	{
+		WLog_Print(gfxredir->base.log, WLOG_ERROR,
+		           "PresentBuffer for window 0x%" PRIx64 " failed with error %" PRIu32,
+		           pdu.windowId, error);
+		return error;
+	}
+
+	return gfxredir_send_present_buffer_ack(callback, pdu.windowId, pdu.presentId);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_recv_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStream* s)
+{
+	UINT error = CHANNEL_RC_OK;
+	GFXREDIR_HEADER header = { 0 };
+
+	WINPR_ASSERT(callback);
+	GFXREDIR_PLUGIN* gfxredir = (GFXREDIR_PLUGIN*)callback->plugin;
+	WINPR_ASSERT(gfxredir);
+
+	const size_t beg = Stream_GetPosition(s);
+
+	if ((error = gfxredir_read_header(s, &header)))
+		return error;
+
+	if ((header.length < GFXREDIR_HEADER_SIZE) ||
+	    !Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, s,
+	                                          header.length - GFXREDIR_HEADER_SIZE))
+		return ERROR_INVALID_DATA;
+
+	wStream sbuffer = { 0 };
+	wStream* body = Stream_StaticConstInit(&sbuffer, Stream_ConstPointer(s),
+	                                       header.length - GFXREDIR_HEADER_SIZE);
+
+	switch (header.cmdId)
+	{
+		case GFXREDIR_CMDID_CAPS_CONFIRM:
+			error = gfxredir_recv_caps_confirm_pdu(gfxredir, body);
+			break;
+
+		case GFXREDIR_CMDID_ERROR:
+			if (Stream_CheckAndLogRequiredLengthWLog(gfxredir->base.log, body, 4))
+				WLog_Print(gfxredir->base.log, WLOG_ERROR, "server error 0x%08" PRIx32,
+				           Stream_Get_UINT32(body));
+			break;
+
+		case GFXREDIR_CMDID_OPEN_POOL:
+			error = gfxredir_recv_open_pool_pdu(gfxredir, body);
+			break;
+
+		case GFXREDIR_CMDID_CLOSE_POOL:
+			error = gfxredir_recv_close_pool_pdu(gfxredir, body);
+			break;
+
+		case GFXREDIR_CMDID_CREATE_BUFFER:
+			error = gfxredir_recv_create_buffer_pdu(gfxredir, body);
+			break;
+
+		case GFXREDIR_CMDID_DESTROY_BUFFER:
+			error = gfxredir_recv_destroy_buffer_pdu(gfxredir, body);
+			break;
+
+		case GFXREDIR_CMDID_PRESENT_BUFFER:
+			error = gfxredir_recv_present_buffer_pdu(callback, body);
+			break;
+
+		default:
+			WLog_Print(gfxredir->base.log, WLOG_WARN, "Received unknown PDU type: %" PRIu32 "",
+			           header.cmdId);
+			break;
+	}
+
+	Stream_SetPosition(s, beg + header.length);
+	return error;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_on_data_received(IWTSVirtualChannelCallback* pChannelCallback, wStream* data)
+{
+	GENERIC_CHANNEL_CALLBACK* callback = (GENERIC_CHANNEL_CALLBACK*)pChannelCallback;
+
+	while (Stream_GetRemainingLength(data) > 0)
+	{
+		const UINT error = gfxredir_recv_pdu(callback, data);
+		if (error)
+			return error;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_on_open(IWTSVirtualChannelCallback* pChannelCallback)
+{
+	GENERIC_CHANNEL_CALLBACK* callback = (GENERIC_CHANNEL_CALLBACK*)pChannelCallback;
+	WINPR_ASSERT(callback);
+
+	return gfxredir_send_caps_advertise(callback);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT gfxredir_on_close(IWTSVirtualChannelCallback* pChannelCallback)
+{
+	GENERIC_CHANNEL_CALLBACK* callback = (GENERIC_CHANNEL_CALLBACK*)pChannelCallback;
+
+	if (callback)
+	{
+		GFXREDIR_PLUGIN* gfxredir = (GFXREDIR_PLUGIN*)callback->plugin;
+		if (gfxredir)
+		{
+			HashTable_Clear(gfxredir->buffers);
+			HashTable_Clear(gfxredir->pools);
+			gfxredir->context->confirmedCapsVersion = 0;
+		}
+	}
+
+	free(callback);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Channel Client Interface
+ */
+
+static const IWTSVirtualChannelCallback gfxredir_callbacks = { gfxredir_on_data_received,
+	                                                           gfxredir_on_open,
+	                                                           gfxredir_on_close, NULL };
+
+static UINT init_plugin_cb(GENERIC_DYNVC_PLUGIN* base, WINPR_ATTR_UNUSED rdpContext* rcontext,
+                           WINPR_ATTR_UNUSED rdpSettings* settings)
+{
+	GFXREDIR_PLUGIN* gfxredir = (GFXREDIR_PLUGIN*)base;
+
+	WINPR_ASSERT(base);
+
+	GfxRedirClientContext* context = calloc(1, sizeof(GfxRedirClientContext));
+	if (!context)
+	{
+		WLog_Print(base->log, WLOG_ERROR, "calloc failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	context->handle = (void*)gfxredir;
+	gfxredir->context = context;
+	gfxredir->base.iface.pInterface = (void*)context;
+
+	gfxredir->pools = gfxredir_table_new(gfxredir_pool_free);
+	gfxredir->buffers = gfxredir_table_new(gfxredir_buffer_free);
+	if (!gfxredir->pools || !gfxredir->buffers)
+	{
+		WLog_Print(base->log, WLOG_ERROR, "unable to allocate pools and buffers");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+static void terminate_plugin_cb(GENERIC_DYNVC_PLUGIN* base)
+{
+	GFXREDIR_PLUGIN* gfxredir = (GFXREDIR_PLUGIN*)base;
+
+	WINPR_ASSERT(gfxredir);
+
+	/* buffers first, they point into the pools */
+	HashTable_Free(gfxredir->buffers);
+	HashTable_Free(gfxredir->pools);
+	free(gfxredir->context);
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+FREERDP_ENTRY_POINT(UINT VCAPITYPE gfxredir_DVCPluginEntry(IDRDYNVC_ENTRY_POINTS* pEntryPoints))
+{
+	return freerdp_generic_DVCPluginEntry(pEntryPoints, TAG, GFXREDIR_DVC_CHANNEL_NAME,
+	                                      sizeof(GFXREDIR_PLUGIN), sizeof(GENERIC_CHANNEL_CALLBACK),
+	                                      &gfxredir_callbacks, init_plugin_cb, terminate_plugin_cb);
+}
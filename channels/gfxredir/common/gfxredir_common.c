@@ -22,6 +22,7 @@
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/stream.h>
+#include <winpr/string.h>
 #include <freerdp/channels/log.h>
 
 #define TAG CHANNELS_TAG("gfxredir.common")
@@ -56,3 +57,127 @@ UINT gfxredir_write_header(wStream* s, const GFXREDIR_HEADER* header)
 	Stream_Write_UINT32(s, header->length);
 	return CHANNEL_RC_OK;
 }
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT gfxredir_read_open_pool_pdu(wStream* s, GFXREDIR_OPEN_POOL_PDU* pdu)
+{
+	WINPR_ASSERT(pdu);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 20))
+		return ERROR_INVALID_DATA;
+
+	Stream_Read_UINT64(s, pdu->poolId);
+	Stream_Read_UINT64(s, pdu->poolSize);
+	Stream_Read_UINT32(s, pdu->sectionNameLength);
+
+	if ((pdu->sectionNameLength == 0) ||
+	    !Stream_CheckAndLogRequiredLengthOfSize(TAG, s, pdu->sectionNameLength, sizeof(WCHAR)))
+		return ERROR_INVALID_DATA;
+
+	pdu->sectionName = (const unsigned short*)Stream_ConstPointer(s);
+	Stream_Seek(s, sizeof(WCHAR) * pdu->sectionNameLength);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT gfxredir_read_create_buffer_pdu(wStream* s, GFXREDIR_CREATE_BUFFER_PDU* pdu)
+{
+	WINPR_ASSERT(pdu);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 40))
+		return ERROR_INVALID_DATA;
+
+	Stream_Read_UINT64(s, pdu->poolId);
+	Stream_Read_UINT64(s, pdu->bufferId);
+	Stream_Read_UINT64(s, pdu->offset);
+	Stream_Read_UINT32(s, pdu->stride);
+	Stream_Read_UINT32(s, pdu->width);
+	Stream_Read_UINT32(s, pdu->height);
+	Stream_Read_UINT32(s, pdu->format);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Reads a present, opaqueRects must hold GFXREDIR_MAX_OPAQUE_RECTS entries.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+UINT gfxredir_read_present_buffer_pdu(wStream* s, GFXREDIR_PRESENT_BUFFER_PDU* pdu,
+                                      RECTANGLE_32* opaqueRects)
+{
+	WINPR_ASSERT(pdu);
+	WINPR_ASSERT(opaqueRects);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 64))
+		return ERROR_INVALID_DATA;
+
+	Stream_Read_UINT64(s, pdu->timestamp);
+	Stream_Read_UINT64(s, pdu->presentId);
+	Stream_Read_UINT64(s, pdu->windowId);
+	Stream_Read_UINT64(s, pdu->bufferId);
+	Stream_Read_UINT32(s, pdu->orientation);
+	Stream_Read_UINT32(s, pdu->targetWidth);
+	Stream_Read_UINT32(s, pdu->targetHeight);
+	Stream_Read_UINT32(s, pdu->dirtyRect.left);
+	Stream_Read_UINT32(s, pdu->dirtyRect.top);
+	Stream_Read_UINT32(s, pdu->dirtyRect.width);
+	Stream_Read_UINT32(s, pdu->dirtyRect.height);
+	Stream_Read_UINT32(s, pdu->numOpaqueRects);
+
+	if (pdu->numOpaqueRects > GFXREDIR_MAX_OPAQUE_RECTS)
+		return ERROR_INVALID_DATA;
+
+	/* an empty list is sent as a single dummy rectangle */
+	const size_t rects = pdu->numOpaqueRects ? pdu->numOpaqueRects : 1;
+	if (!Stream_CheckAndLogRequiredLengthOfSize(TAG, s, rects, 16))
+		return ERROR_INVALID_DATA;
+
+	for (size_t x = 0; x < pdu->numOpaqueRects; x++)
+	{
+		Stream_Read_UINT32(s, opaqueRects[x].left);
+		Stream_Read_UINT32(s, opaqueRects[x].top);
+		Stream_Read_UINT32(s, opaqueRects[x].width);
+		Stream_Read_UINT32(s, opaqueRects[x].height);
+	}
+	if (pdu->numOpaqueRects == 0)
+		Stream_Seek(s, 16);
+	pdu->opaqueRects = opaqueRects;
+	return CHANNEL_RC_OK;
+}
+
+BOOL gfxredir_buffer_fits_pool(const GFXREDIR_CREATE_BUFFER_PDU* pdu, UINT64 poolSize)
+{
+	WINPR_ASSERT(pdu);
+
+	const UINT64 size = 1ull * pdu->stride * pdu->height;
+	return (pdu->stride >= 4ull * pdu->width) && (pdu->offset <= poolSize) &&
+	       (size <= poolSize - pdu->offset);
+}
+
+/**
+ * The section name is chosen by the server, only plain names are accepted. A '/' could make
+ * shm_open leave its namespace (or open arbitrary files on systems without one).
+ *
+ * @return the shm_open name with the leading '/', NULL if the name is not acceptable
+ */
+char* gfxredir_shm_name(const WCHAR* sectionName, size_t sectionNameLength)
+{
+	size_t length = 0;
+	char* name = ConvertWCharNToUtf8Alloc(sectionName, sectionNameLength, &length);
+	if (!name)
+		return NULL;
+
+	char* shmName = NULL;
+	if ((length == 0) || (length >= 255 /* NAME_MAX */) || strchr(name, '/'))
+		WLog_WARN(TAG, "rejecting section name '%s'", name);
+	else
+		winpr_asprintf(&shmName, &length, "/%s", name);
+
+	free(name);
+	return shmName;
+}
@@ -29,4 +29,13 @@
 FREERDP_LOCAL UINT gfxredir_read_header(wStream* s, GFXREDIR_HEADER* header);
 FREERDP_LOCAL UINT gfxredir_write_header(wStream* s, const GFXREDIR_HEADER* header);
 
+FREERDP_LOCAL UINT gfxredir_read_open_pool_pdu(wStream* s, GFXREDIR_OPEN_POOL_PDU* pdu);
+FREERDP_LOCAL UINT gfxredir_read_create_buffer_pdu(wStream* s, GFXREDIR_CREATE_BUFFER_PDU* pdu);
+FREERDP_LOCAL UINT gfxredir_read_present_buffer_pdu(wStream* s, GFXREDIR_PRESENT_BUFFER_PDU* pdu,
+                                                    RECTANGLE_32* opaqueRects);
+
+FREERDP_LOCAL BOOL gfxredir_buffer_fits_pool(const GFXREDIR_CREATE_BUFFER_PDU* pdu,
+                                             UINT64 poolSize);
+FREERDP_LOCAL char* gfxredir_shm_name(const WCHAR* sectionName, size_t sectionNameLength);
+
 #endif /* FREERDP_CHANNEL_GFXREDIR_COMMON_H */
@@ -0,0 +1,233 @@
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+
+#include <gfxredir_common.h>
+
+typedef struct
+{
+	const char* name;
+	const char* expected; /* NULL if the name must be rejected */
+} name_test;
+
+static BOOL test_section_names(void)
+{
+	char longName[300] = { 0 };
+	memset(longName, 'a', sizeof(longName) - 1);
+
+	const name_test tests[] = { { "weston-pool-1", "/weston-pool-1" },
+		                        { "", NULL },
+		                        { "/weston-pool-1", NULL },
+		                        { "../../etc/passwd", NULL },
+		                        { "/dev/zero", NULL },
+		                        { "pool/", NULL },
+		                        { longName, NULL } };
+
+	for (size_t x = 0; x < ARRAYSIZE(tests); x++)
+	{
+		size_t length = 0;
+		WCHAR* wname = ConvertUtf8ToWCharAlloc(tests[x].name, &length);
+		if (!wname)
+			return FALSE;
+
+		/* the length on the wire includes the terminator */
+		char* name = gfxredir_shm_name(wname, length + 1);
+		free(wname);
+
+		const BOOL rc = tests[x].expected ? (name && (strcmp(name, tests[x].expected) == 0))
+		                                  : (name == NULL);
+		free(name);
+		if (!rc)
+		{
+			(void)fprintf(stderr, "section name '%s' not handled\n", tests[x].name);
+			return FALSE;
+		}
+	}
+
+	/* a zero length name must not be read */
+	const WCHAR empty[] = { 0 };
+	char* name = gfxredir_shm_name(empty, 0);
+	free(name);
+	return name == NULL;
+}
+
+static BOOL test_open_pool(void)
+{
+	BYTE buffer[64] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	GFXREDIR_OPEN_POOL_PDU pdu = { 0 };
+
+	Stream_Write_UINT64(s, 0x1122334455667788ull);
+	Stream_Write_UINT64(s, 4096);
+	Stream_Write_UINT32(s, 5);
+	Stream_Write_UINT16(s, 'p');
+	Stream_Write_UINT16(s, 'o');
+	Stream_Write_UINT16(s, 'o');
+	Stream_Write_UINT16(s, 'l');
+	Stream_Write_UINT16(s, 0);
+	const size_t length = Stream_GetPosition(s);
+
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	if (gfxredir_read_open_pool_pdu(s, &pdu) != CHANNEL_RC_OK)
+		return FALSE;
+	if ((pdu.poolId != 0x1122334455667788ull) || (pdu.poolSize != 4096) ||
+	    (pdu.sectionNameLength != 5) || (Stream_GetRemainingLength(s) != 0))
+		return FALSE;
+
+	char* name = gfxredir_shm_name((const WCHAR*)pdu.sectionName, pdu.sectionNameLength);
+	const BOOL rc = name && (strcmp(name, "/pool") == 0);
+	free(name);
+	if (!rc)
+		return FALSE;
+
+	/* the name is longer than the PDU */
+	s = Stream_StaticConstInit(&sbuffer, buffer, length - 1);
+	if (gfxredir_read_open_pool_pdu(s, &pdu) == CHANNEL_RC_OK)
+		return FALSE;
+
+	/* no name at all */
+	Stream_SetPosition(Stream_StaticInit(&sbuffer, buffer, sizeof(buffer)), 16);
+	Stream_Write_UINT32(&sbuffer, 0);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	return gfxredir_read_open_pool_pdu(s, &pdu) != CHANNEL_RC_OK;
+}
+
+static BOOL test_create_buffer(void)
+{
+	BYTE buffer[40] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	GFXREDIR_CREATE_BUFFER_PDU pdu = { 0 };
+
+	Stream_Write_UINT64(s, 1);    /* poolId */
+	Stream_Write_UINT64(s, 2);    /* bufferId */
+	Stream_Write_UINT64(s, 1024); /* offset */
+	Stream_Write_UINT32(s, 256);  /* stride */
+	Stream_Write_UINT32(s, 64);   /* width */
+	Stream_Write_UINT32(s, 12);   /* height */
+	Stream_Write_UINT32(s, GFXREDIR_BUFFER_PIXEL_FORMAT_ARGB_8888);
+
+	s = Stream_StaticConstInit(&sbuffer, buffer, sizeof(buffer) - 1);
+	if (gfxredir_read_create_buffer_pdu(s, &pdu) == CHANNEL_RC_OK)
+		return FALSE;
+
+	s = Stream_StaticConstInit(&sbuffer, buffer, sizeof(buffer));
+	if (gfxredir_read_create_buffer_pdu(s, &pdu) != CHANNEL_RC_OK)
+		return FALSE;
+	if ((pdu.poolId != 1) || (pdu.bufferId != 2) || (pdu.offset != 1024) || (pdu.stride != 256) ||
+	    (pdu.width != 64) || (pdu.height != 12) ||
+	    (pdu.format != GFXREDIR_BUFFER_PIXEL_FORMAT_ARGB_8888))
+		return FALSE;
+
+	/* 1024 + 256 * 12 bytes */
+	if (!gfxredir_buffer_fits_pool(&pdu, 4096) || gfxredir_buffer_fits_pool(&pdu, 4095))
+		return FALSE;
+
+	GFXREDIR_CREATE_BUFFER_PDU bad = pdu;
+	bad.stride = 4 * bad.width - 1;
+	if (gfxredir_buffer_fits_pool(&bad, 1ull << 32))
+		return FALSE;
+
+	bad = pdu;
+	bad.offset = 4097;
+	if (gfxredir_buffer_fits_pool(&bad, 4096))
+		return FALSE;
+
+	/* must not wrap around */
+	bad = pdu;
+	bad.offset = UINT64_MAX - 16;
+	if (gfxredir_buffer_fits_pool(&bad, UINT64_MAX - 8))
+		return FALSE;
+
+	bad = pdu;
+	bad.stride = UINT32_MAX;
+	bad.height = UINT32_MAX;
+	return !gfxredir_buffer_fits_pool(&bad, UINT32_MAX);
+}
+
+static size_t write_present(wStream* s, UINT32 numOpaqueRects, size_t rects)
+{
+	Stream_SetPosition(s, 0);
+	Stream_Write_UINT64(s, 100); /* timestamp */
+	Stream_Write_UINT64(s, 7);   /* presentId */
+	Stream_Write_UINT64(s, 3);   /* windowId */
+	Stream_Write_UINT64(s, 2);   /* bufferId */
+	Stream_Write_UINT32(s, 0);   /* orientation */
+	Stream_Write_UINT32(s, 64);  /* targetWidth */
+	Stream_Write_UINT32(s, 12);  /* targetHeight */
+	Stream_Write_UINT32(s, 1);   /* dirtyRect */
+	Stream_Write_UINT32(s, 2);
+	Stream_Write_UINT32(s, 30);
+	Stream_Write_UINT32(s, 10);
+	Stream_Write_UINT32(s, numOpaqueRects);
+	for (size_t x = 0; x < rects; x++)
+	{
+		Stream_Write_UINT32(s, (UINT32)x);
+		Stream_Write_UINT32(s, 0);
+		Stream_Write_UINT32(s, 8);
+		Stream_Write_UINT32(s, 4);
+	}
+	return Stream_GetPosition(s);
+}
+
+static BOOL test_present_buffer(void)
+{
+	BYTE buffer[64 + 16 * (GFXREDIR_MAX_OPAQUE_RECTS + 1)] = { 0 };
+	RECTANGLE_32 opaqueRects[GFXREDIR_MAX_OPAQUE_RECTS] = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	GFXREDIR_PRESENT_BUFFER_PDU pdu = { 0 };
+
+	size_t length = write_present(s, 2, 2);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	if (gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects) != CHANNEL_RC_OK)
+		return FALSE;
+	if ((pdu.presentId != 7) || (pdu.windowId != 3) || (pdu.bufferId != 2) ||
+	    (pdu.dirtyRect.width != 30) || (pdu.numOpaqueRects != 2) ||
+	    (pdu.opaqueRects != opaqueRects) || (opaqueRects[1].left != 1) ||
+	    (Stream_GetRemainingLength(s) != 0))
+		return FALSE;
+
+	/* an empty list carries a dummy rectangle */
+	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	length = write_present(s, 0, 1);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	if ((gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects) != CHANNEL_RC_OK) ||
+	    (Stream_GetRemainingLength(s) != 0))
+		return FALSE;
+
+	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	length = write_present(s, 0, 0);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	if (gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects) == CHANNEL_RC_OK)
+		return FALSE;
+
+	/* more rectangles than announced in the PDU */
+	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	length = write_present(s, 3, 2);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	if (gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects) == CHANNEL_RC_OK)
+		return FALSE;
+
+	/* more rectangles than the protocol allows */
+	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	length = write_present(s, GFXREDIR_MAX_OPAQUE_RECTS + 1, GFXREDIR_MAX_OPAQUE_RECTS + 1);
+	s = Stream_StaticConstInit(&sbuffer, buffer, length);
+	return gfxredir_read_present_buffer_pdu(s, &pdu, opaqueRects) != CHANNEL_RC_OK;
+}
+
+int TestGfxRedirPdu(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_section_names())
+		return -1;
+	if (!test_open_pool())
+		return -2;
+	if (!test_create_buffer())
+		return -3;
+	if (!test_present_buffer())
+		return -4;
+	return 0;
+}
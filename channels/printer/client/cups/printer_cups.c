@@ -35,6 +35,10 @@
 #include <winpr/crt.h>
 #include <winpr/file.h>
 #include <winpr/string.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
 
 #include <freerdp/channels/rdpdr.h>
 
@@ -43,6 +47,9 @@
 #include <freerdp/channels/log.h>
 #define TAG CHANNELS_TAG("printer.client.cups")
 
+/* job data queued for the spool thread before IRP_MJ_WRITE completion is held back */
+#define PRINTER_CUPS_SPOOL_LIMIT (4ull * 1024ull * 1024ull)
+
 #if defined(__APPLE__)
 #include <errno.h>
 #include <sys/sysctl.h>
@@ -94,6 +101,17 @@ typedef struct
 
 	http_t* printjob_object;
 	int printjob_id;
+
+	/* job data is sent to CUPS by a spool thread, the device thread only queues it */
+	HANDLE thread;
+	HANDLE dataEvent;
+	HANDLE spaceEvent;
+	CRITICAL_SECTION lock;
+	wQueue* chunks;
+	wStreamPool* pool;
+	size_t queued;
+	BOOL closing;
+	BOOL failed;
 } rdpCupsPrintJob;
 
 typedef struct
@@ -129,19 +147,71 @@ static bool http_status_ok(http_status_t status)
 	}
 }
 
-static UINT write_printjob(rdpPrintJob* printjob, const BYTE* data, size_t size)
+static wStream* printer_cups_spool_next(rdpCupsPrintJob* cups_printjob, BOOL* done)
 {
-	rdpCupsPrintJob* cups_printjob = (rdpCupsPrintJob*)printjob;
+	wStream* s = NULL;
 
 	WINPR_ASSERT(cups_printjob);
+	WINPR_ASSERT(done);
 
-	http_status_t rc =
-	    cupsWriteRequestData(cups_printjob->printjob_object, (const char*)data, size);
-	if (!http_status_ok(rc))
-		WLog_WARN(TAG, "cupsWriteRequestData returned %s", httpStatus(rc));
+	EnterCriticalSection(&cups_printjob->lock);
+	s = Queue_Dequeue(cups_printjob->chunks);
+	if (s)
+	{
+		cups_printjob->queued -= Stream_Length(s);
+		if (cups_printjob->queued < PRINTER_CUPS_SPOOL_LIMIT)
+			(void)SetEvent(cups_printjob->spaceEvent);
+	}
+	else if (cups_printjob->closing)
+		*done = TRUE;
+	else
+		(void)ResetEvent(cups_printjob->dataEvent);
+	LeaveCriticalSection(&cups_printjob->lock);
+	return s;
+}
 
-	return CHANNEL_RC_OK;
+static DWORD WINAPI printer_cups_spool_thread(LPVOID arg)
+{
+	rdpCupsPrintJob* cups_printjob = arg;
+	BOOL done = FALSE;
+
+	WINPR_ASSERT(cups_printjob);
+
+	while (!done)
+	{
+		if (WaitForSingleObject(cups_printjob->dataEvent, INFINITE) != WAIT_OBJECT_0)
+			break;
+
+		wStream* s = printer_cups_spool_next(cups_printjob, &done);
+		if (!s)
+			continue;
+
+		/* after a failed write the remaining job data is only drained */
+		if (!cups_printjob->failed)
+		{
+			const http_status_t rc =
+			    cupsWriteRequestData(cups_printjob->printjob_object,
+			                         Stream_BufferAs(s, const char), Stream_Length(s));
+			if (!http_status_ok(rc))
+			{
+				WLog_WARN(TAG, "cupsWriteRequestData returned %s, discarding job %" PRIu32,
+				          httpStatus(rc), cups_printjob->printjob.id);
+				EnterCriticalSection(&cups_printjob->lock);
+				cups_printjob->failed = TRUE;
+				LeaveCriticalSection(&cups_printjob->lock);
+			}
+		}
+		Stream_Release(s);
+	}
+
+	/* wake a writer waiting for space in case the thread ended early */
+	EnterCriticalSection(&cups_printjob->lock);
+	cups_printjob->failed = TRUE;
+	(void)SetEvent(cups_printjob->spaceEvent);
+	LeaveCriticalSection(&cups_printjob->lock);
+	return 0;
 }
+
 /**
  * Function description
  *
@@ -149,7 +219,71 @@ static UINT write_printjob(rdpPrintJob* printjob, const BYTE* data, size_t size)
  */
 static UINT printer_cups_write_printjob(rdpPrintJob* printjob, const BYTE* data, size_t size)
 {
-	return write_printjob(printjob, data, size);
+	rdpCupsPrintJob* cups_printjob = (rdpCupsPrintJob*)printjob;
+
+	WINPR_ASSERT(cups_printjob);
+
+	if (size == 0)
+		return CHANNEL_RC_OK;
+
+	/* hold back completion of the write while the spool is full */
+	EnterCriticalSection(&cups_printjob->lock);
+	while (!cups_printjob->failed && (cups_printjob->queued >= PRINTER_CUPS_SPOOL_LIMIT))
+	{
+		(void)ResetEvent(cups_printjob->spaceEvent);
+		LeaveCriticalSection(&cups_printjob->lock);
+		if (WaitForSingleObject(cups_printjob->spaceEvent, INFINITE) != WAIT_OBJECT_0)
+			return ERROR_INTERNAL_ERROR;
+		EnterCriticalSection(&cups_printjob->lock);
+	}
+
+	UINT error = CHANNEL_RC_OK;
+	if (!cups_printjob->failed)
+	{
+		wStream* s = StreamPool_Take(cups_printjob->pool, size);
+		if (!s)
+			error = CHANNEL_RC_NO_MEMORY;
+		else
+		{
+			Stream_Write(s, data, size);
+			Stream_SealLength(s);
+			if (!Queue_Enqueue(cups_printjob->chunks, s))
+			{
+				Stream_Release(s);
+				error = CHANNEL_RC_NO_MEMORY;
+			}
+			else
+			{
+				cups_printjob->queued += size;
+				(void)SetEvent(cups_printjob->dataEvent);
+			}
+		}
+	}
+	LeaveCriticalSection(&cups_printjob->lock);
+	return error;
+}
+
+static void printer_cups_free_printjob(rdpCupsPrintJob* cups_printjob)
+{
+	if (!cups_printjob)
+		return;
+
+	if (cups_printjob->chunks)
+	{
+		wStream* s = NULL;
+		while ((s = Queue_Dequeue(cups_printjob->chunks)) != NULL)
+			Stream_Release(s);
+		Queue_Free(cups_printjob->chunks);
+	}
+	StreamPool_Free(cups_printjob->pool);
+	if (cups_printjob->dataEvent)
+		(void)CloseHandle(cups_printjob->dataEvent);
+	if (cups_printjob->spaceEvent)
+		(void)CloseHandle(cups_printjob->spaceEvent);
+	DeleteCriticalSection(&cups_printjob->lock);
+	if (cups_printjob->printjob_object)
+		httpClose(cups_printjob->printjob_object);
+	free(cups_printjob);
 }
 
 static void printer_cups_close_printjob(rdpPrintJob* printjob)
@@ -159,18 +293,29 @@ static void printer_cups_close_printjob(rdpPrintJob* printjob)
 
 	WINPR_ASSERT(cups_printjob);
 
+	if (cups_printjob->thread)
+	{
+		EnterCriticalSection(&cups_printjob->lock);
+		cups_printjob->closing = TRUE;
+		(void)SetEvent(cups_printjob->dataEvent);
+		LeaveCriticalSection(&cups_printjob->lock);
+
+		(void)WaitForSingleObject(cups_printjob->thread, INFINITE);
+		(void)CloseHandle(cups_printjob->thread);
+		cups_printjob->thread = NULL;
+	}
+
 	ipp_status_t rc = cupsFinishDocument(cups_printjob->printjob_object, printjob->printer->name);
 	if (rc != IPP_OK)
 		WLog_WARN(TAG, "cupsFinishDocument returned %s", ippErrorString(rc));
 
 	cups_printjob->printjob_id = 0;
-	httpClose(cups_printjob->printjob_object);
 
 	cups_printer = (rdpCupsPrinter*)printjob->printer;
 	WINPR_ASSERT(cups_printer);
 
 	cups_printer->printjob = NULL;
-	free(cups_printjob);
+	printer_cups_free_printjob(cups_printjob);
 }
 
 static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
@@ -196,6 +341,20 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 	cups_printjob->printjob.Write = printer_cups_write_printjob;
 	cups_printjob->printjob.Close = printer_cups_close_printjob;
 
+	if (!InitializeCriticalSectionAndSpinCount(&cups_printjob->lock, 4000))
+	{
+		free(cups_printjob);
+		return NULL;
+	}
+
+	cups_printjob->chunks = Queue_New(FALSE, -1, -1);
+	cups_printjob->pool = StreamPool_New(TRUE, 0);
+	cups_printjob->dataEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	cups_printjob->spaceEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (!cups_printjob->chunks || !cups_printjob->pool || !cups_printjob->dataEvent ||
+	    !cups_printjob->spaceEvent)
+		goto fail;
+
 	{
 		char buf[100] = { 0 };
 
@@ -205,8 +364,7 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 		if (!cups_printjob->printjob_object)
 		{
 			WLog_WARN(TAG, "httpConnect2 failed for '%s:%d", cupsServer(), ippPort());
-			free(cups_printjob);
-			return NULL;
+			goto fail;
 		}
 
 		printer_cups_get_printjob_name(buf, sizeof(buf), cups_printjob->printjob.id);
@@ -218,9 +376,7 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 		{
 			WLog_WARN(TAG, "cupsCreateJob failed for printer '%s', driver '%s'", printer->name,
 			          printer->driver);
-			httpClose(cups_printjob->printjob_object);
-			free(cups_printjob);
-			return NULL;
+			goto fail;
 		}
 
 		http_status_t rc = cupsStartDocument(cups_printjob->printjob_object, printer->name,
@@ -230,9 +386,21 @@ static rdpPrintJob* printer_cups_create_printjob(rdpPrinter* printer, UINT32 id)
 			          printer->name, printer->driver, httpStatus(rc));
 	}
 
+	cups_printjob->thread =
+	    CreateThread(NULL, 0, printer_cups_spool_thread, cups_printjob, 0, NULL);
+	if (!cups_printjob->thread)
+	{
+		WLog_WARN(TAG, "failed to start spool thread for printer '%s'", printer->name);
+		goto fail;
+	}
+
 	cups_printer->printjob = cups_printjob;
 
 	return &cups_printjob->printjob;
+
+fail:
+	printer_cups_free_printjob(cups_printjob);
+	return NULL;
 }
 
 static rdpPrintJob* printer_cups_find_printjob(rdpPrinter* printer, UINT32 id)
@@ -23,6 +23,8 @@
 #include <winpr/file.h>
 #include <winpr/pipe.h>
 #include <winpr/thread.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/svc.h>
@@ -31,17 +33,26 @@
 #include <freerdp/log.h>
 #define TAG CLIENT_TAG(RDP2TCP_DVC_CHANNEL_NAME)
 
+/* Reads from the addin are sized to fill many channel chunks at once, several of them are
+ * queued to the channel so the pipe is read while earlier data is still being sent. */
+#define RDP2TCP_READ_SIZE (64ULL * 1024ULL)
+#define RDP2TCP_MAX_WRITES 8
+
 typedef struct
 {
 	HANDLE hStdOutputRead;
 	HANDLE hStdInputWrite;
 	HANDLE hProcess;
 	HANDLE copyThread;
-	HANDLE writeComplete;
+	HANDLE writeThread;
+	HANDLE writeSlots; /* semaphore, one count per channel write that may be outstanding */
+	HANDLE resumed;    /* reset while the server suspended the channel */
+	HANDLE stopEvent;
+	wStreamPool* pool;
+	wMessageQueue* writeQueue; /* data for the addin, written by writeThread */
 	DWORD openHandle;
 	void* initHandle;
 	CHANNEL_ENTRY_POINTS_FREERDP_EX channelEntryPoints;
-	char buffer[16 * 1024];
 	char* commandline;
 } Plugin;
 
@@ -121,81 +132,159 @@ fail:
 	return rc;
 }
 
+static void closeChannel(Plugin* plugin)
+{
+	WINPR_ASSERT(plugin);
+	WINPR_ASSERT(plugin->channelEntryPoints.pVirtualChannelCloseEx);
+	plugin->channelEntryPoints.pVirtualChannelCloseEx(plugin->initHandle, plugin->openHandle);
+}
+
+/* Waits for the event, FALSE if the session is aborted or the channel terminated first */
+static BOOL waitOrAbort(Plugin* plugin, HANDLE event)
+{
+	HANDLE handles[] = { event, plugin->stopEvent,
+		                 freerdp_abort_event(plugin->channelEntryPoints.context) };
+	return WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
 static DWORD WINAPI copyThread(void* data)
 {
-	DWORD status = WAIT_OBJECT_0;
 	Plugin* plugin = (Plugin*)data;
-	size_t const bufsize = 16ULL * 1024ULL;
 
 	WINPR_ASSERT(plugin);
 
-	while (status == WAIT_OBJECT_0)
+	for (;;)
 	{
-		(void)ResetEvent(plugin->writeComplete);
+		/* back-pressure: stop reading from the addin while the server suspended the channel
+		 * or all write slots are in use, the addin then blocks on its full pipe */
+		if (!waitOrAbort(plugin, plugin->resumed) || !waitOrAbort(plugin, plugin->writeSlots))
+			break;
 
 		DWORD dwRead = 0;
-		char* buffer = calloc(bufsize, sizeof(char));
+		wStream* s = StreamPool_Take(plugin->pool, RDP2TCP_READ_SIZE);
 
-		if (!buffer)
+		if (!s)
 		{
-			(void)fprintf(stderr, "rdp2tcp copyThread: malloc failed\n");
-			goto fail;
+			WLog_ERR(TAG, "StreamPool_Take failed");
+			(void)ReleaseSemaphore(plugin->writeSlots, 1, NULL);
+			break;
 		}
 
-		// if (!ReadFile(plugin->hStdOutputRead, plugin->buffer, sizeof plugin->buffer, &dwRead,
-		// NULL))
-		if (!ReadFile(plugin->hStdOutputRead, buffer, bufsize, &dwRead, NULL))
+		const DWORD size = (DWORD)MIN(Stream_Capacity(s), UINT32_MAX);
+		if (!ReadFile(plugin->hStdOutputRead, Stream_Buffer(s), size, &dwRead, NULL) ||
+		    (dwRead == 0))
 		{
-			free(buffer);
-			goto fail;
+			Stream_Release(s);
+			(void)ReleaseSemaphore(plugin->writeSlots, 1, NULL);
+			break;
 		}
 
-		if (plugin->channelEntryPoints.pVirtualChannelWriteEx(
-		        plugin->initHandle, plugin->openHandle, buffer, dwRead, buffer) != CHANNEL_RC_OK)
+		/* the stream and its write slot are released with CHANNEL_EVENT_WRITE_COMPLETE */
+		const UINT rc = plugin->channelEntryPoints.pVirtualChannelWriteEx(
+		    plugin->initHandle, plugin->openHandle, Stream_Buffer(s), dwRead, s);
+		if (rc != CHANNEL_RC_OK)
 		{
-			free(buffer);
-			(void)fprintf(stderr, "rdp2tcp copyThread failed %i\n", (int)dwRead);
-			goto fail;
+			WLog_ERR(TAG, "pVirtualChannelWriteEx failed with %" PRIu32 "", rc);
+			Stream_Release(s);
+			(void)ReleaseSemaphore(plugin->writeSlots, 1, NULL);
+			break;
 		}
-
-		HANDLE handles[] = { plugin->writeComplete,
-			                 freerdp_abort_event(plugin->channelEntryPoints.context) };
-		status = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
 	}
 
-fail:
 	ExitThread(0);
 	return 0;
 }
 
-static void closeChannel(Plugin* plugin)
+static void writeQueueFree(void* obj)
+{
+	wMessage* msg = (wMessage*)obj;
+
+	if (!msg || (msg->id != 0))
+		return;
+
+	Stream_Release((wStream*)msg->wParam);
+}
+
+/* Writes to the addin outside of the channel thread, a slow addin must not stall the
+ * processing of other channels */
+static DWORD WINAPI writeThread(void* data)
 {
+	Plugin* plugin = (Plugin*)data;
+
 	WINPR_ASSERT(plugin);
-	WINPR_ASSERT(plugin->channelEntryPoints.pVirtualChannelCloseEx);
-	plugin->channelEntryPoints.pVirtualChannelCloseEx(plugin->initHandle, plugin->openHandle);
+
+	BOOL failed = FALSE;
+	while (MessageQueue_Wait(plugin->writeQueue))
+	{
+		wMessage message = { 0 };
+
+		if (!MessageQueue_Peek(plugin->writeQueue, &message, TRUE))
+			break;
+
+		if (message.id == WMQ_QUIT)
+			break;
+
+		wStream* s = (wStream*)message.wParam;
+		const BYTE* ptr = Stream_Buffer(s);
+		size_t len = Stream_GetPosition(s);
+
+		while (!failed && (len > 0))
+		{
+			DWORD dwWritten = 0;
+			if (!WriteFile(plugin->hStdInputWrite, ptr, (DWORD)MIN(len, UINT32_MAX), &dwWritten,
+			               NULL) ||
+			    (dwWritten == 0))
+			{
+				WLog_ERR(TAG, "failed to write to the addin");
+				closeChannel(plugin);
+				failed = TRUE;
+				break;
+			}
+			ptr += dwWritten;
+			len -= dwWritten;
+		}
+		Stream_Release(s);
+	}
+
+	ExitThread(0);
+	return 0;
 }
 
 static void dataReceived(Plugin* plugin, void* pData, UINT32 dataLength, UINT32 totalLength,
                          UINT32 dataFlags)
 {
-	DWORD dwWritten = 0;
-
 	WINPR_ASSERT(plugin);
 
 	if (dataFlags & CHANNEL_FLAG_SUSPEND)
+	{
+		(void)ResetEvent(plugin->resumed);
 		return;
+	}
 
 	if (dataFlags & CHANNEL_FLAG_RESUME)
+	{
+		(void)SetEvent(plugin->resumed);
 		return;
+	}
 
-	if (dataFlags & CHANNEL_FLAG_FIRST)
+	const size_t header = (dataFlags & CHANNEL_FLAG_FIRST) ? sizeof(totalLength) : 0;
+	wStream* s = StreamPool_Take(plugin->pool, header + dataLength);
+	if (!s)
 	{
-		if (!WriteFile(plugin->hStdInputWrite, &totalLength, sizeof(totalLength), &dwWritten, NULL))
-			closeChannel(plugin);
+		closeChannel(plugin);
+		return;
 	}
 
-	if (!WriteFile(plugin->hStdInputWrite, pData, dataLength, &dwWritten, NULL))
+	/* the addin expects the total length in host byte order before each message */
+	if (header > 0)
+		Stream_Write(s, &totalLength, sizeof(totalLength));
+	Stream_Write(s, pData, dataLength);
+
+	if (!MessageQueue_Post(plugin->writeQueue, NULL, 0, s, NULL))
+	{
+		Stream_Release(s);
 		closeChannel(plugin);
+	}
 }
 
 static void VCAPITYPE VirtualChannelOpenEventEx(LPVOID lpUserParam,
@@ -213,11 +302,9 @@ static void VCAPITYPE VirtualChannelOpenEventEx(LPVOID lpUserParam,
 			break;
 
 		case CHANNEL_EVENT_WRITE_CANCELLED:
-			free(pData);
-			break;
 		case CHANNEL_EVENT_WRITE_COMPLETE:
-			(void)SetEvent(plugin->writeComplete);
-			free(pData);
+			Stream_Release((wStream*)pData);
+			(void)ReleaseSemaphore(plugin->writeSlots, 1, NULL);
 			break;
 		default:
 			break;
@@ -229,14 +316,32 @@ static void channel_terminated(Plugin* plugin)
 	if (!plugin)
 		return;
 
+	if (plugin->writeThread)
+	{
+		(void)MessageQueue_PostQuit(plugin->writeQueue, 0);
+		(void)WaitForSingleObject(plugin->writeThread, INFINITE);
+		(void)CloseHandle(plugin->writeThread);
+	}
+
+	/* the addin exiting ends the read of the copy thread */
+	TerminateProcess(plugin->hProcess, 0);
 	if (plugin->copyThread)
+	{
+		(void)SetEvent(plugin->stopEvent);
+		(void)WaitForSingleObject(plugin->copyThread, INFINITE);
 		(void)CloseHandle(plugin->copyThread);
-	if (plugin->writeComplete)
-		(void)CloseHandle(plugin->writeComplete);
-
+	}
+	if (plugin->stopEvent)
+		(void)CloseHandle(plugin->stopEvent);
+	if (plugin->writeSlots)
+		(void)CloseHandle(plugin->writeSlots);
+	if (plugin->resumed)
+		(void)CloseHandle(plugin->resumed);
+
+	MessageQueue_Free(plugin->writeQueue);
+	StreamPool_Free(plugin->pool);
 	(void)CloseHandle(plugin->hStdInputWrite);
 	(void)CloseHandle(plugin->hStdOutputRead);
-	TerminateProcess(plugin->hProcess, 0);
 	(void)CloseHandle(plugin->hProcess);
 	free(plugin->commandline);
 	free(plugin);
@@ -245,8 +350,22 @@ static void channel_terminated(Plugin* plugin)
 static void channel_initialized(Plugin* plugin)
 {
 	WINPR_ASSERT(plugin);
-	WINPR_ASSERT(!plugin->writeComplete);
-	plugin->writeComplete = CreateEvent(NULL, TRUE, FALSE, NULL);
+	WINPR_ASSERT(!plugin->writeSlots);
+	plugin->writeSlots = CreateSemaphore(NULL, RDP2TCP_MAX_WRITES, RDP2TCP_MAX_WRITES, NULL);
+	plugin->resumed = CreateEvent(NULL, TRUE, TRUE, NULL);
+	plugin->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	plugin->pool = StreamPool_New(TRUE, RDP2TCP_READ_SIZE);
+	plugin->writeQueue = MessageQueue_New(NULL);
+	if (!plugin->writeSlots || !plugin->resumed || !plugin->stopEvent || !plugin->pool ||
+	    !plugin->writeQueue)
+	{
+		WLog_ERR(TAG, "failed to initialize the channel");
+		return;
+	}
+	MessageQueue_Object(plugin->writeQueue)->fnObjectFree = writeQueueFree;
+
+	WINPR_ASSERT(!plugin->writeThread);
+	plugin->writeThread = CreateThread(NULL, 0, writeThread, plugin, 0, NULL);
 
 	WINPR_ASSERT(!plugin->copyThread);
 	plugin->copyThread = CreateThread(NULL, 0, copyThread, plugin, 0, NULL);
@@ -2202,7 +2202,7 @@ static UINT rdpdr_virtual_channel_event_connected(rdpdrPlugin* rdpdr, LPVOID pDa
 
 	if (rdpdr->async)
 	{
-		rdpdr->queue = MessageQueue_New(NULL);
+		rdpdr->queue = MessageQueue_NewEx(NULL, WMQ_FLAG_SINGLE_CONSUMER);
 
 		if (!rdpdr->queue)
 		{
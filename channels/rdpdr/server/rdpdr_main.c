@@ -42,6 +42,9 @@
 #define RDPDR_HEADER_LENGTH 4
 #define RDPDR_CAPABILITY_HEADER_LENGTH 8
 
+/* default split of asynchronous reads, bounds the size of a single response message */
+#define RDPDR_SERVER_MAX_READ_CHUNK (1024 * 1024)
+
 struct s_rdpdr_server_private
 {
 	HANDLE Thread;
@@ -55,7 +58,9 @@ struct s_rdpdr_server_private
 
 	BOOL UserLoggedOnPdu;
 
-	wListDictionary* IrpList;
+	wHashTable* IrpList;
+	wObjectPool* IrpPool;
+	wStreamPool* RequestPool;
 	UINT32 NextCompletionId;
 
 	wHashTable* devicelist;
@@ -232,23 +237,73 @@ static const WCHAR* rdpdr_read_ustring(wLog* log, wStream* s, size_t bytelen)
 	return str;
 }
 
-static RDPDR_IRP* rdpdr_server_irp_new(void)
+static void rdpdr_server_irp_init(void* obj)
 {
-	RDPDR_IRP* irp = (RDPDR_IRP*)calloc(1, sizeof(RDPDR_IRP));
-	return irp;
+	RDPDR_IRP* irp = obj;
+	if (irp)
+		ZeroMemory(irp, sizeof(RDPDR_IRP));
 }
 
-static void rdpdr_server_irp_free(RDPDR_IRP* irp)
+static void* rdpdr_server_irp_alloc(WINPR_ATTR_UNUSED const void* val)
 {
-	free(irp);
+	return calloc(1, sizeof(RDPDR_IRP));
 }
 
-static BOOL rdpdr_server_enqueue_irp(RdpdrServerContext* context, RDPDR_IRP* irp)
+static RDPDR_IRP* rdpdr_server_irp_new(RdpdrServerContext* context)
 {
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
-	const uintptr_t key = irp->CompletionId + 1ull;
-	return ListDictionary_Add(context->priv->IrpList, (void*)key, irp);
+	return ObjectPool_Take(context->priv->IrpPool);
+}
+
+static void rdpdr_server_irp_free(RdpdrServerContext* context, RDPDR_IRP* irp)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	if (irp)
+		ObjectPool_Return(context->priv->IrpPool, irp);
+}
+
+static BOOL rdpdr_server_irp_free_h(WINPR_ATTR_UNUSED const void* key, void* value,
+                                    WINPR_ATTR_UNUSED void* arg)
+{
+	free(value);
+	return TRUE;
+}
+
+/**
+ * Assigns the next free completion id and registers the IRP. The server application may send
+ * requests from any thread while the channel thread completes others, ids still outstanding
+ * after a wrap around are skipped.
+ */
+static BOOL rdpdr_server_enqueue_irp_ex(RdpdrServerContext* context, RDPDR_IRP* irp,
+                                        UINT32* completionId)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	WINPR_ASSERT(irp);
+
+	RdpdrServerPrivate* priv = context->priv;
+	HashTable_Lock(priv->IrpList);
+
+	uintptr_t key = 0;
+	do
+	{
+		irp->CompletionId = priv->NextCompletionId++;
+		key = irp->CompletionId + 1ull;
+	} while ((key == 0) || HashTable_Contains(priv->IrpList, (void*)key));
+
+	if (completionId)
+		*completionId = irp->CompletionId;
+
+	const BOOL rc = HashTable_Insert(priv->IrpList, (void*)key, irp);
+	HashTable_Unlock(priv->IrpList);
+	return rc;
+}
+
+static BOOL rdpdr_server_enqueue_irp(RdpdrServerContext* context, RDPDR_IRP* irp)
+{
+	return rdpdr_server_enqueue_irp_ex(context, irp, NULL);
 }
 
 static RDPDR_IRP* rdpdr_server_dequeue_irp(RdpdrServerContext* context, UINT32 completionId)
@@ -258,10 +313,22 @@ static RDPDR_IRP* rdpdr_server_dequeue_irp(RdpdrServerContext* context, UINT32 c
 	WINPR_ASSERT(context->priv);
 
 	const uintptr_t key = completionId + 1ull;
-	irp = (RDPDR_IRP*)ListDictionary_Take(context->priv->IrpList, (void*)key);
+	HashTable_Lock(context->priv->IrpList);
+	irp = (RDPDR_IRP*)HashTable_GetItemValue(context->priv->IrpList, (void*)key);
+	if (irp)
+		HashTable_Remove(context->priv->IrpList, (void*)key);
+	HashTable_Unlock(context->priv->IrpList);
 	return irp;
 }
 
+/* device I/O requests are built in pooled streams, WTSVirtualChannelWrite copies them */
+static wStream* rdpdr_server_request_new(RdpdrServerContext* context, size_t size)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	return StreamPool_Take(context->priv->RequestPool, size);
+}
+
 static UINT rdpdr_seal_send_free_request(RdpdrServerContext* context, wStream* s)
 {
 	BOOL status = 0;
@@ -290,7 +357,7 @@ static UINT rdpdr_seal_send_free_request(RdpdrServerContext* context, wStream* s
 	winpr_HexLogDump(context->priv->log, WLOG_DEBUG, Stream_Buffer(s), Stream_Length(s));
 	status = WTSVirtualChannelWrite(context->priv->ChannelHandle, Stream_BufferAs(s, char),
 	                                (ULONG)length, &written);
-	Stream_Free(s, TRUE);
+	Stream_Release(s);
 	return status ? CHANNEL_RC_OK : ERROR_INTERNAL_ERROR;
 }
 
@@ -2177,6 +2244,8 @@ static DWORD WINAPI rdpdr_server_thread(LPVOID arg)
 			error = ERROR_INTERNAL_ERROR;
 			break;
 		}
+		/* large read responses arrive as one message, grow for it and not past it */
+		Stream_SetPosition(s, 0);
 		if (!Stream_EnsureRemainingCapacity(s, BytesReturned))
 		{
 			WLog_Print(context->priv->log, WLOG_ERROR, "Stream_EnsureRemainingCapacity failed!");
@@ -2369,11 +2438,11 @@ static UINT rdpdr_server_send_device_create_request(RdpdrServerContext* context,
 	           deviceId, path, desiredAccess, createOptions, createDisposition);
 	/* Compute the required Unicode size. */
 	pathLength = (strlen(path) + 1U) * sizeof(WCHAR);
-	s = Stream_New(NULL, 256U + pathLength);
+	s = rdpdr_server_request_new(context, 256U + pathLength);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
@@ -2391,7 +2460,7 @@ static UINT rdpdr_server_send_device_create_request(RdpdrServerContext* context,
 	if (Stream_Write_UTF16_String_From_UTF8(s, pathLength / sizeof(WCHAR), path,
 	                                        pathLength / sizeof(WCHAR), TRUE) < 0)
 	{
-		Stream_Free(s, TRUE);
+		Stream_Release(s);
 		return ERROR_INTERNAL_ERROR;
 	}
 	return rdpdr_seal_send_free_request(context, s);
@@ -2412,11 +2481,11 @@ static UINT rdpdr_server_send_device_close_request(RdpdrServerContext* context,
 	WLog_Print(context->priv->log, WLOG_DEBUG,
 	           "RdpdrServerSendDeviceCloseRequest: deviceId=%" PRIu32 ", fileId=%" PRIu32 "",
 	           deviceId, fileId);
-	s = Stream_New(NULL, 128);
+	s = rdpdr_server_request_new(context, 128);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
@@ -2432,7 +2501,7 @@ static UINT rdpdr_server_send_device_close_request(RdpdrServerContext* context,
  */
 static UINT rdpdr_server_send_device_read_request(RdpdrServerContext* context, UINT32 deviceId,
                                                   UINT32 fileId, UINT32 completionId, UINT32 length,
-                                                  UINT32 offset)
+                                                  UINT64 offset)
 {
 	wStream* s = NULL;
 	WINPR_ASSERT(context);
@@ -2440,21 +2509,20 @@ static UINT rdpdr_server_send_device_read_request(RdpdrServerContext* context, U
 
 	WLog_Print(context->priv->log, WLOG_DEBUG,
 	           "RdpdrServerSendDeviceReadRequest: deviceId=%" PRIu32 ", fileId=%" PRIu32
-	           ", length=%" PRIu32 ", offset=%" PRIu32 "",
+	           ", length=%" PRIu32 ", offset=%" PRIu64 "",
 	           deviceId, fileId, length, offset);
-	s = Stream_New(NULL, 128);
+	s = rdpdr_server_request_new(context, 128);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
 	rdpdr_server_write_device_iorequest(s, deviceId, fileId, completionId, IRP_MJ_READ, 0);
 	Stream_Write_UINT32(s, length); /* Length (4 bytes) */
-	Stream_Write_UINT32(s, offset); /* Offset (8 bytes) */
-	Stream_Write_UINT32(s, 0);
-	Stream_Zero(s, 20); /* Padding (20 bytes) */
+	Stream_Write_UINT64(s, offset); /* Offset (8 bytes) */
+	Stream_Zero(s, 20);             /* Padding (20 bytes) */
 	return rdpdr_seal_send_free_request(context, s);
 }
 
@@ -2465,7 +2533,7 @@ static UINT rdpdr_server_send_device_read_request(RdpdrServerContext* context, U
  */
 static UINT rdpdr_server_send_device_write_request(RdpdrServerContext* context, UINT32 deviceId,
                                                    UINT32 fileId, UINT32 completionId,
-                                                   const char* data, UINT32 length, UINT32 offset)
+                                                   const void* data, UINT32 length, UINT64 offset)
 {
 	wStream* s = NULL;
 	WINPR_ASSERT(context);
@@ -2473,22 +2541,21 @@ static UINT rdpdr_server_send_device_write_request(RdpdrServerContext* context,
 
 	WLog_Print(context->priv->log, WLOG_DEBUG,
 	           "RdpdrServerSendDeviceWriteRequest: deviceId=%" PRIu32 ", fileId=%" PRIu32
-	           ", length=%" PRIu32 ", offset=%" PRIu32 "",
+	           ", length=%" PRIu32 ", offset=%" PRIu64 "",
 	           deviceId, fileId, length, offset);
-	s = Stream_New(NULL, 64 + length);
+	s = rdpdr_server_request_new(context, 64ull + length);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
 	rdpdr_server_write_device_iorequest(s, deviceId, fileId, completionId, IRP_MJ_WRITE, 0);
 	Stream_Write_UINT32(s, length); /* Length (4 bytes) */
-	Stream_Write_UINT32(s, offset); /* Offset (8 bytes) */
-	Stream_Write_UINT32(s, 0);
-	Stream_Zero(s, 20);            /* Padding (20 bytes) */
-	Stream_Write(s, data, length); /* WriteData (variable) */
+	Stream_Write_UINT64(s, offset); /* Offset (8 bytes) */
+	Stream_Zero(s, 20);             /* Padding (20 bytes) */
+	Stream_Write(s, data, length);  /* WriteData (variable) */
 	return rdpdr_seal_send_free_request(context, s);
 }
 
@@ -2512,11 +2579,11 @@ static UINT rdpdr_server_send_device_query_directory_request(RdpdrServerContext*
 	           deviceId, fileId, path);
 	/* Compute the required Unicode size. */
 	pathLength = path ? (strlen(path) + 1) * sizeof(WCHAR) : 0;
-	s = Stream_New(NULL, 64 + pathLength);
+	s = rdpdr_server_request_new(context, 64 + pathLength);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
@@ -2534,7 +2601,7 @@ static UINT rdpdr_server_send_device_query_directory_request(RdpdrServerContext*
 		if (Stream_Write_UTF16_String_From_UTF8(s, pathLength / sizeof(WCHAR), path,
 		                                        pathLength / sizeof(WCHAR), TRUE) < 0)
 		{
-			Stream_Free(s, TRUE);
+			Stream_Release(s);
 			return ERROR_INTERNAL_ERROR;
 		}
 	}
@@ -2562,11 +2629,11 @@ static UINT rdpdr_server_send_device_file_rename_request(RdpdrServerContext* con
 	           deviceId, fileId, path);
 	/* Compute the required Unicode size. */
 	pathLength = path ? (strlen(path) + 1) * sizeof(WCHAR) : 0;
-	s = Stream_New(NULL, 64 + pathLength);
+	s = rdpdr_server_request_new(context, 64 + pathLength);
 
 	if (!s)
 	{
-		WLog_Print(context->priv->log, WLOG_ERROR, "Stream_New failed!");
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_request_new failed!");
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
@@ -2587,7 +2654,7 @@ static UINT rdpdr_server_send_device_file_rename_request(RdpdrServerContext* con
 		if (Stream_Write_UTF16_String_From_UTF8(s, pathLength / sizeof(WCHAR), path,
 		                                        pathLength / sizeof(WCHAR), TRUE) < 0)
 		{
-			Stream_Free(s, TRUE);
+			Stream_Release(s);
 			return ERROR_INTERNAL_ERROR;
 		}
 	}
@@ -2632,7 +2699,7 @@ static UINT rdpdr_server_drive_create_directory_callback2(RdpdrServerContext* co
 	/* Invoke the create directory completion routine. */
 	context->OnDriveCreateDirectoryComplete(context, irp->CallbackData, ioStatus);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -2659,7 +2726,7 @@ static UINT rdpdr_server_drive_create_directory_callback1(RdpdrServerContext* co
 		/* Invoke the create directory completion routine. */
 		context->OnDriveCreateDirectoryComplete(context, irp->CallbackData, ioStatus);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return CHANNEL_RC_OK;
 	}
 
@@ -2672,7 +2739,6 @@ static UINT rdpdr_server_drive_create_directory_callback1(RdpdrServerContext* co
 	           fileInformation2str(information));
 
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_create_directory_callback2;
 	irp->DeviceId = deviceId;
 	irp->FileId = fileId;
@@ -2680,7 +2746,7 @@ static UINT rdpdr_server_drive_create_directory_callback1(RdpdrServerContext* co
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -2701,7 +2767,7 @@ static UINT rdpdr_server_drive_create_directory(RdpdrServerContext* context, voi
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(callbackData);
 	WINPR_ASSERT(path);
-	irp = rdpdr_server_irp_new();
+	irp = rdpdr_server_irp_new(context);
 
 	if (!irp)
 	{
@@ -2709,7 +2775,6 @@ static UINT rdpdr_server_drive_create_directory(RdpdrServerContext* context, voi
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_create_directory_callback1;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -2719,7 +2784,7 @@ static UINT rdpdr_server_drive_create_directory(RdpdrServerContext* context, voi
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -2754,7 +2819,7 @@ static UINT rdpdr_server_drive_delete_directory_callback2(RdpdrServerContext* co
 	/* Invoke the delete directory completion routine. */
 	context->OnDriveDeleteDirectoryComplete(context, irp->CallbackData, ioStatus);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -2780,7 +2845,7 @@ static UINT rdpdr_server_drive_delete_directory_callback1(RdpdrServerContext* co
 		/* Invoke the delete directory completion routine. */
 		context->OnDriveDeleteFileComplete(context, irp->CallbackData, ioStatus);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return CHANNEL_RC_OK;
 	}
 
@@ -2793,7 +2858,6 @@ static UINT rdpdr_server_drive_delete_directory_callback1(RdpdrServerContext* co
 	           fileInformation2str(information));
 
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_delete_directory_callback2;
 	irp->DeviceId = deviceId;
 	irp->FileId = fileId;
@@ -2801,7 +2865,7 @@ static UINT rdpdr_server_drive_delete_directory_callback1(RdpdrServerContext* co
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -2817,7 +2881,7 @@ static UINT rdpdr_server_drive_delete_directory_callback1(RdpdrServerContext* co
 static UINT rdpdr_server_drive_delete_directory(RdpdrServerContext* context, void* callbackData,
                                                 UINT32 deviceId, const char* path)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -2828,7 +2892,6 @@ static UINT rdpdr_server_drive_delete_directory(RdpdrServerContext* context, voi
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_delete_directory_callback1;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -2838,7 +2901,7 @@ static UINT rdpdr_server_drive_delete_directory(RdpdrServerContext* context, voi
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -2903,13 +2966,12 @@ static UINT rdpdr_server_drive_query_directory_callback2(RdpdrServerContext* con
 		context->OnDriveQueryDirectoryComplete(context, irp->CallbackData, ioStatus,
 		                                       length > 0 ? &fdi : NULL);
 		/* Setup the IRP. */
-		irp->CompletionId = context->priv->NextCompletionId++;
 		irp->Callback = rdpdr_server_drive_query_directory_callback2;
 
 		if (!rdpdr_server_enqueue_irp(context, irp))
 		{
 			WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-			rdpdr_server_irp_free(irp);
+			rdpdr_server_irp_free(context, irp);
 			return ERROR_INTERNAL_ERROR;
 		}
 
@@ -2922,7 +2984,7 @@ static UINT rdpdr_server_drive_query_directory_callback2(RdpdrServerContext* con
 		/* Invoke the query directory completion routine. */
 		context->OnDriveQueryDirectoryComplete(context, irp->CallbackData, ioStatus, NULL);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 	}
 
 	return CHANNEL_RC_OK;
@@ -2950,7 +3012,7 @@ static UINT rdpdr_server_drive_query_directory_callback1(RdpdrServerContext* con
 		/* Invoke the query directory completion routine. */
 		context->OnDriveQueryDirectoryComplete(context, irp->CallbackData, ioStatus, NULL);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return CHANNEL_RC_OK;
 	}
 
@@ -2959,7 +3021,6 @@ static UINT rdpdr_server_drive_query_directory_callback1(RdpdrServerContext* con
 
 	const uint32_t fileId = Stream_Get_UINT32(s);
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_query_directory_callback2;
 	irp->DeviceId = deviceId;
 	irp->FileId = fileId;
@@ -2968,7 +3029,7 @@ static UINT rdpdr_server_drive_query_directory_callback1(RdpdrServerContext* con
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -2985,7 +3046,7 @@ static UINT rdpdr_server_drive_query_directory_callback1(RdpdrServerContext* con
 static UINT rdpdr_server_drive_query_directory(RdpdrServerContext* context, void* callbackData,
                                                UINT32 deviceId, const char* path)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -2996,7 +3057,6 @@ static UINT rdpdr_server_drive_query_directory(RdpdrServerContext* context, void
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_query_directory_callback1;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3006,7 +3066,7 @@ static UINT rdpdr_server_drive_query_directory(RdpdrServerContext* context, void
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3048,7 +3108,7 @@ static UINT rdpdr_server_drive_open_file_callback(RdpdrServerContext* context, w
 	/* Invoke the open file completion routine. */
 	context->OnDriveOpenFileComplete(context, irp->CallbackData, ioStatus, deviceId, fileId);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3061,7 +3121,7 @@ static UINT rdpdr_server_drive_open_file(RdpdrServerContext* context, void* call
                                          UINT32 deviceId, const char* path, UINT32 desiredAccess,
                                          UINT32 createDisposition)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -3072,7 +3132,6 @@ static UINT rdpdr_server_drive_open_file(RdpdrServerContext* context, void* call
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_open_file_callback;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3082,7 +3141,7 @@ static UINT rdpdr_server_drive_open_file(RdpdrServerContext* context, void* call
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3132,7 +3191,7 @@ static UINT rdpdr_server_drive_read_file_callback(RdpdrServerContext* context, w
 	/* Invoke the read file completion routine. */
 	context->OnDriveReadFileComplete(context, irp->CallbackData, ioStatus, buffer, length);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3145,7 +3204,7 @@ static UINT rdpdr_server_drive_read_file(RdpdrServerContext* context, void* call
                                          UINT32 deviceId, UINT32 fileId, UINT32 length,
                                          UINT32 offset)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -3156,7 +3215,6 @@ static UINT rdpdr_server_drive_read_file(RdpdrServerContext* context, void* call
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_read_file_callback;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3165,7 +3223,7 @@ static UINT rdpdr_server_drive_read_file(RdpdrServerContext* context, void* call
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3209,7 +3267,7 @@ static UINT rdpdr_server_drive_write_file_callback(RdpdrServerContext* context,
 	/* Invoke the write file completion routine. */
 	context->OnDriveWriteFileComplete(context, irp->CallbackData, ioStatus, length);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3222,7 +3280,7 @@ static UINT rdpdr_server_drive_write_file(RdpdrServerContext* context, void* cal
                                           UINT32 deviceId, UINT32 fileId, const char* buffer,
                                           UINT32 length, UINT32 offset)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -3233,7 +3291,6 @@ static UINT rdpdr_server_drive_write_file(RdpdrServerContext* context, void* cal
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_write_file_callback;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3242,7 +3299,7 @@ static UINT rdpdr_server_drive_write_file(RdpdrServerContext* context, void* cal
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3252,6 +3309,186 @@ static UINT rdpdr_server_drive_write_file(RdpdrServerContext* context, void* cal
 	                                              buffer, length, offset);
 }
 
+/*************************************************
+ * Drive Read/Write File, asynchronous
+ ************************************************/
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpdr_server_drive_read_file_ex_callback(RdpdrServerContext* context, wStream* s,
+                                                     RDPDR_IRP* irp, UINT32 deviceId,
+                                                     UINT32 completionId, UINT32 ioStatus)
+{
+	UINT32 length = 0;
+	const BYTE* buffer = NULL;
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	WINPR_ASSERT(irp);
+	WLog_Print(context->priv->log, WLOG_DEBUG,
+	           "RdpdrServerDriveReadFileExCallback: deviceId=%" PRIu32 ", completionId=%" PRIu32
+	           ", ioStatus=0x%" PRIx32 ", offset=%" PRIu64 "",
+	           deviceId, completionId, ioStatus, irp->Offset);
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(context->priv->log, s, 4))
+		goto fail;
+
+	Stream_Read_UINT32(s, length); /* Length (4 bytes) */
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(context->priv->log, s, length))
+		goto fail;
+
+	/* the data is handed out in place, large reads are not copied again */
+	if (length > 0)
+	{
+		buffer = Stream_ConstPointer(s);
+		Stream_Seek(s, length);
+	}
+
+	IFCALL(context->OnDriveReadFileExComplete, context, irp->CallbackData, completionId, ioStatus,
+	       irp->Offset, buffer, length);
+	rdpdr_server_irp_free(context, irp);
+	return CHANNEL_RC_OK;
+
+fail:
+	rdpdr_server_irp_free(context, irp);
+	return ERROR_INVALID_DATA;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpdr_server_drive_write_file_ex_callback(RdpdrServerContext* context, wStream* s,
+                                                      RDPDR_IRP* irp, UINT32 deviceId,
+                                                      UINT32 completionId, UINT32 ioStatus)
+{
+	UINT32 length = 0;
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	WINPR_ASSERT(irp);
+	WLog_Print(context->priv->log, WLOG_DEBUG,
+	           "RdpdrServerDriveWriteFileExCallback: deviceId=%" PRIu32 ", completionId=%" PRIu32
+	           ", ioStatus=0x%" PRIx32 ", offset=%" PRIu64 "",
+	           deviceId, completionId, ioStatus, irp->Offset);
+
+	if (!Stream_CheckAndLogRequiredLengthWLog(context->priv->log, s, 4))
+	{
+		rdpdr_server_irp_free(context, irp);
+		return ERROR_INVALID_DATA;
+	}
+
+	Stream_Read_UINT32(s, length); /* Length (4 bytes) */
+	Stream_SafeSeek(s, 1);         /* Padding (1 byte, optional) */
+
+	IFCALL(context->OnDriveWriteFileExComplete, context, irp->CallbackData, completionId,
+	       ioStatus, irp->Offset, length);
+	rdpdr_server_irp_free(context, irp);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Registers an IRP for one read or write and sends its request. A request that could not be
+ * sent is taken back, so it does not linger as outstanding.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpdr_server_drive_io_ex(RdpdrServerContext* context, void* callbackData,
+                                     UINT32 deviceId, UINT32 fileId, UINT64 offset,
+                                     const BYTE* buffer, UINT32 length, BOOL write)
+{
+	UINT32 completionId = 0;
+	UINT error = CHANNEL_RC_OK;
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+
+	if (!irp)
+	{
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_irp_new failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	irp->Callback = write ? rdpdr_server_drive_write_file_ex_callback
+	                      : rdpdr_server_drive_read_file_ex_callback;
+	irp->CallbackData = callbackData;
+	irp->DeviceId = deviceId;
+	irp->FileId = fileId;
+	irp->Offset = offset;
+
+	if (!rdpdr_server_enqueue_irp_ex(context, irp, &completionId))
+	{
+		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
+		rdpdr_server_irp_free(context, irp);
+		return ERROR_INTERNAL_ERROR;
+	}
+
+	/* the IRP belongs to the channel thread now, it may already be completed */
+	if (write)
+		error = rdpdr_server_send_device_write_request(context, deviceId, fileId, completionId,
+		                                               buffer, length, offset);
+	else
+		error = rdpdr_server_send_device_read_request(context, deviceId, fileId, completionId,
+		                                              length, offset);
+
+	if (error)
+		rdpdr_server_irp_free(context, rdpdr_server_dequeue_irp(context, completionId));
+	return error;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpdr_server_drive_read_file_ex(RdpdrServerContext* context, void* callbackData,
+                                            UINT32 deviceId, UINT32 fileId, UINT64 offset,
+                                            UINT32 length)
+{
+	WINPR_ASSERT(context);
+
+	const UINT32 chunk = (context->MaxReadChunkSize > 0) ? context->MaxReadChunkSize : length;
+
+	/* all chunks are outstanding at once, the client streams them back to back */
+	do
+	{
+		const UINT32 size = MIN(length, chunk);
+		const UINT error = rdpdr_server_drive_io_ex(context, callbackData, deviceId, fileId,
+		                                            offset, NULL, size, FALSE);
+		if (error)
+			return error;
+
+		offset += size;
+		length -= size;
+	} while (length > 0);
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpdr_server_drive_write_file_ex(RdpdrServerContext* context, void* callbackData,
+                                             UINT32 deviceId, UINT32 fileId, UINT64 offset,
+                                             const BYTE* buffer, UINT32 length)
+{
+	WINPR_ASSERT(buffer || (length == 0));
+	return rdpdr_server_drive_io_ex(context, callbackData, deviceId, fileId, offset, buffer,
+	                                length, TRUE);
+}
+
+static size_t rdpdr_server_get_outstanding_irps(RdpdrServerContext* context)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	return HashTable_Count(context->priv->IrpList);
+}
+
 /*************************************************
  * Drive Close File
  ************************************************/
@@ -3284,7 +3521,7 @@ static UINT rdpdr_server_drive_close_file_callback(RdpdrServerContext* context,
 	/* Invoke the close file completion routine. */
 	context->OnDriveCloseFileComplete(context, irp->CallbackData, ioStatus);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3296,7 +3533,7 @@ static UINT rdpdr_server_drive_close_file_callback(RdpdrServerContext* context,
 static UINT rdpdr_server_drive_close_file(RdpdrServerContext* context, void* callbackData,
                                           UINT32 deviceId, UINT32 fileId)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -3307,7 +3544,6 @@ static UINT rdpdr_server_drive_close_file(RdpdrServerContext* context, void* cal
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_close_file_callback;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3316,7 +3552,7 @@ static UINT rdpdr_server_drive_close_file(RdpdrServerContext* context, void* cal
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3350,7 +3586,7 @@ static UINT rdpdr_server_drive_delete_file_callback2(RdpdrServerContext* context
 	/* Invoke the delete file completion routine. */
 	context->OnDriveDeleteFileComplete(context, irp->CallbackData, ioStatus);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3376,7 +3612,7 @@ static UINT rdpdr_server_drive_delete_file_callback1(RdpdrServerContext* context
 		/* Invoke the close file completion routine. */
 		context->OnDriveDeleteFileComplete(context, irp->CallbackData, ioStatus);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return CHANNEL_RC_OK;
 	}
 
@@ -3389,7 +3625,6 @@ static UINT rdpdr_server_drive_delete_file_callback1(RdpdrServerContext* context
 	WLog_Print(context->priv->log, WLOG_DEBUG, "fileId [0x%08" PRIx32 "], information %s", fileId,
 	           fileInformation2str(information));
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_delete_file_callback2;
 	irp->DeviceId = deviceId;
 	irp->FileId = fileId;
@@ -3397,7 +3632,7 @@ static UINT rdpdr_server_drive_delete_file_callback1(RdpdrServerContext* context
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3413,7 +3648,7 @@ static UINT rdpdr_server_drive_delete_file_callback1(RdpdrServerContext* context
 static UINT rdpdr_server_drive_delete_file(RdpdrServerContext* context, void* callbackData,
                                            UINT32 deviceId, const char* path)
 {
-	RDPDR_IRP* irp = rdpdr_server_irp_new();
+	RDPDR_IRP* irp = rdpdr_server_irp_new(context);
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
 	WINPR_ASSERT(irp);
@@ -3424,7 +3659,6 @@ static UINT rdpdr_server_drive_delete_file(RdpdrServerContext* context, void* ca
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_delete_file_callback1;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3434,7 +3668,7 @@ static UINT rdpdr_server_drive_delete_file(RdpdrServerContext* context, void* ca
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3468,7 +3702,7 @@ static UINT rdpdr_server_drive_rename_file_callback3(RdpdrServerContext* context
 	           ", ioStatus=0x%" PRIx32 "",
 	           deviceId, completionId, ioStatus);
 	/* Destroy the IRP. */
-	rdpdr_server_irp_free(irp);
+	rdpdr_server_irp_free(context, irp);
 	return CHANNEL_RC_OK;
 }
 
@@ -3498,14 +3732,13 @@ static UINT rdpdr_server_drive_rename_file_callback2(RdpdrServerContext* context
 	/* Invoke the rename file completion routine. */
 	context->OnDriveRenameFileComplete(context, irp->CallbackData, ioStatus);
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_rename_file_callback3;
 	irp->DeviceId = deviceId;
 
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3536,7 +3769,7 @@ static UINT rdpdr_server_drive_rename_file_callback1(RdpdrServerContext* context
 		/* Invoke the rename file completion routine. */
 		context->OnDriveRenameFileComplete(context, irp->CallbackData, ioStatus);
 		/* Destroy the IRP. */
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return CHANNEL_RC_OK;
 	}
 
@@ -3549,7 +3782,6 @@ static UINT rdpdr_server_drive_rename_file_callback1(RdpdrServerContext* context
 	           fileInformation2str(information));
 
 	/* Setup the IRP. */
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_rename_file_callback2;
 	irp->DeviceId = deviceId;
 	irp->FileId = fileId;
@@ -3557,7 +3789,7 @@ static UINT rdpdr_server_drive_rename_file_callback1(RdpdrServerContext* context
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3578,7 +3810,7 @@ static UINT rdpdr_server_drive_rename_file(RdpdrServerContext* context, void* ca
 	RDPDR_IRP* irp = NULL;
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(context->priv);
-	irp = rdpdr_server_irp_new();
+	irp = rdpdr_server_irp_new(context);
 
 	if (!irp)
 	{
@@ -3586,7 +3818,6 @@ static UINT rdpdr_server_drive_rename_file(RdpdrServerContext* context, void* ca
 		return CHANNEL_RC_NO_MEMORY;
 	}
 
-	irp->CompletionId = context->priv->NextCompletionId++;
 	irp->Callback = rdpdr_server_drive_rename_file_callback1;
 	irp->CallbackData = callbackData;
 	irp->DeviceId = deviceId;
@@ -3598,7 +3829,7 @@ static UINT rdpdr_server_drive_rename_file(RdpdrServerContext* context, void* ca
 	if (!rdpdr_server_enqueue_irp(context, irp))
 	{
 		WLog_Print(context->priv->log, WLOG_ERROR, "rdpdr_server_enqueue_irp failed!");
-		rdpdr_server_irp_free(irp);
+		rdpdr_server_irp_free(context, irp);
 		return ERROR_INTERNAL_ERROR;
 	}
 
@@ -3613,7 +3844,11 @@ static void rdpdr_server_private_free(RdpdrServerPrivate* ctx)
 {
 	if (!ctx)
 		return;
-	ListDictionary_Free(ctx->IrpList);
+	if (ctx->IrpList)
+		HashTable_Foreach(ctx->IrpList, rdpdr_server_irp_free_h, NULL);
+	HashTable_Free(ctx->IrpList);
+	ObjectPool_Free(ctx->IrpPool);
+	StreamPool_Free(ctx->RequestPool);
 	HashTable_Free(ctx->devicelist);
 	free(ctx->ClientComputerName);
 	free(ctx);
@@ -3633,11 +3868,25 @@ static RdpdrServerPrivate* rdpdr_server_private_new(void)
 	priv->ClientId = g_ClientId++;
 	priv->UserLoggedOnPdu = TRUE;
 	priv->NextCompletionId = 1;
-	priv->IrpList = ListDictionary_New(TRUE);
+	priv->IrpList = HashTable_New(TRUE);
 
 	if (!priv->IrpList)
 		goto fail;
 
+	priv->IrpPool = ObjectPool_New(TRUE);
+	if (!priv->IrpPool)
+		goto fail;
+
+	wObject* irpobj = ObjectPool_Object(priv->IrpPool);
+	WINPR_ASSERT(irpobj);
+	irpobj->fnObjectInit = rdpdr_server_irp_init;
+	irpobj->fnObjectNew = rdpdr_server_irp_alloc;
+	irpobj->fnObjectFree = free;
+
+	priv->RequestPool = StreamPool_New(TRUE, 128);
+	if (!priv->RequestPool)
+		goto fail;
+
 	priv->devicelist = HashTable_New(FALSE);
 	if (!priv->devicelist)
 		goto fail;
@@ -3678,6 +3927,10 @@ RdpdrServerContext* rdpdr_server_context_new(HANDLE vcm)
 	context->DriveCloseFile = rdpdr_server_drive_close_file;
 	context->DriveDeleteFile = rdpdr_server_drive_delete_file;
 	context->DriveRenameFile = rdpdr_server_drive_rename_file;
+	context->DriveReadFileEx = rdpdr_server_drive_read_file_ex;
+	context->DriveWriteFileEx = rdpdr_server_drive_write_file_ex;
+	context->GetOutstandingIrps = rdpdr_server_get_outstanding_irps;
+	context->MaxReadChunkSize = RDPDR_SERVER_MAX_READ_CHUNK;
 	context->priv = rdpdr_server_private_new();
 	if (!context->priv)
 		goto fail;
@@ -36,6 +36,7 @@ typedef struct S_RDPDR_IRP
 	UINT32 CompletionId;
 	UINT32 DeviceId;
 	UINT32 FileId;
+	UINT64 Offset;
 	char PathName[256];
 	char ExtraBuffer[256];
 	void* CallbackData;
@@ -129,6 +129,14 @@ static UINT ecam_dev_sample_captured_callback(CameraDevice* dev, int streamIndex
 	if (!stream->streaming)
 		return CHANNEL_RC_OK;
 
+	/* Skip before encoding: an encoded frame that is not sent would break
+	 * the reference chain of the following ones and waste the CPU time */
+	if (stream->nSampleCredits == 0)
+	{
+		WLog_DBG(TAG, "Skip sample: no credits left");
+		return CHANNEL_RC_OK;
+	}
+
 	if (streamInputFormat(stream) != streamOutputFormat(stream))
 	{
 		if (!ecam_encoder_compress(stream, sample, size, &encodedSample, &encodedSize))
@@ -146,11 +154,6 @@ static UINT ecam_dev_sample_captured_callback(CameraDevice* dev, int streamIndex
 		encodedSize = size;
 	}
 
-	if (stream->nSampleCredits == 0)
-	{
-		WLog_DBG(TAG, "Skip sample: no credits left");
-		return CHANNEL_RC_OK;
-	}
 	stream->nSampleCredits--;
 
 	return ecam_dev_send_sample_response(dev, WINPR_ASSERTING_INT_CAST(size_t, streamIndex),
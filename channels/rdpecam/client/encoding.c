@@ -278,6 +278,24 @@ static BOOL ecam_init_sws_context(CameraDeviceStream* stream, enum AVPixelFormat
 	return TRUE;
 }
 
+/**
+ * Function description
+ * check if frames in pixFormat can be handed to the encoder without sws_scale,
+ * which is the case for NV12 with hardware and I420 with software encoding
+ *
+ * @return TRUE if no conversion is needed
+ */
+static BOOL ecam_encoder_direct_input(CameraDeviceStream* stream, enum AVPixelFormat pixFormat)
+{
+	WINPR_ASSERT(stream);
+
+	if (h264_context_get_option(stream->h264, H264_CONTEXT_OPTION_HW_ACCEL))
+		return pixFormat == AV_PIX_FMT_NV12;
+
+	/* full range YUVJ420P is passed on unchanged by sws_scale as well */
+	return (pixFormat == AV_PIX_FMT_YUV420P) || (pixFormat == AV_PIX_FMT_YUVJ420P);
+}
+
 /**
  * Function description
  *
@@ -355,6 +373,23 @@ static BOOL ecam_encoder_compress_h264(CameraDeviceStream* stream, const BYTE* s
 		}
 	}
 
+	/* planes already in the encoder layout are encoded in place */
+	if (ecam_encoder_direct_input(stream, pixFormat))
+	{
+		const BYTE* cYuvData[3] = { srcSlice[0], srcSlice[1], srcSlice[2] };
+		const UINT32 cYuvLineSizes[3] = { WINPR_ASSERTING_INT_CAST(UINT32, srcLineSizes[0]),
+			                              WINPR_ASSERTING_INT_CAST(UINT32, srcLineSizes[1]),
+			                              (pixFormat == AV_PIX_FMT_NV12)
+			                                  ? 0
+			                                  : WINPR_ASSERTING_INT_CAST(UINT32, srcLineSizes[2]) };
+
+		if (h264_compress_yuv(stream->h264, cYuvData, cYuvLineSizes, ppDstData, &dstSize) < 0)
+			return FALSE;
+
+		*pDstSize = dstSize;
+		return TRUE;
+	}
+
 	/* get buffers for YUV420P or NV12 */
 	if (h264_get_yuv_buffer(stream->h264, 0, size.width, size.height, yuvData, yuvLineSizes) < 0)
 		return FALSE;
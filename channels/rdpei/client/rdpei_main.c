@@ -68,6 +68,28 @@
 #define MAX_CONTACTS 64
 #define MAX_PEN_CONTACTS 4
 
+/* frames waiting for the next transmission, a full queue is sent right away */
+#define RDPEI_MAX_QUEUED_FRAMES 8
+
+/* bounds of the frame interval in ms, which follows the measured round trip time */
+#define RDPEI_FRAME_INTERVAL_MIN 8
+#define RDPEI_FRAME_INTERVAL_DEFAULT 20
+#define RDPEI_FRAME_INTERVAL_MAX 32
+
+typedef struct
+{
+	UINT64 time; /* microseconds */
+	RDPINPUT_TOUCH_FRAME frame;
+	RDPINPUT_CONTACT_DATA contacts[MAX_CONTACTS];
+} RDPEI_TOUCH_FRAME_ENTRY;
+
+typedef struct
+{
+	UINT64 time; /* microseconds */
+	RDPINPUT_PEN_FRAME frame;
+	RDPINPUT_PEN_CONTACT contacts[MAX_PEN_CONTACTS];
+} RDPEI_PEN_FRAME_ENTRY;
+
 typedef struct
 {
 	GENERIC_DYNVC_PLUGIN base;
@@ -77,14 +99,16 @@ typedef struct
 	UINT32 version;
 	UINT32 features; /* SC_READY_MULTIPEN_INJECTION_SUPPORTED */
 	UINT16 maxTouchContacts;
-	UINT64 currentFrameTime;
 	UINT64 previousFrameTime;
 	RDPINPUT_CONTACT_POINT contactPoints[MAX_CONTACTS];
+	RDPEI_TOUCH_FRAME_ENTRY touchFrames[RDPEI_MAX_QUEUED_FRAMES];
+	size_t touchFrameCount;
 
-	UINT64 currentPenFrameTime;
 	UINT64 previousPenFrameTime;
 	UINT16 maxPenContacts;
 	RDPINPUT_PEN_CONTACT_POINT penContactPoints[MAX_PEN_CONTACTS];
+	RDPEI_PEN_FRAME_ENTRY penFrames[RDPEI_MAX_QUEUED_FRAMES];
+	size_t penFrameCount;
 
 	CRITICAL_SECTION lock;
 	rdpContext* rdpcontext;
@@ -97,12 +121,13 @@ typedef struct
 	BOOL async;
 } RDPEI_PLUGIN;
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-static UINT rdpei_send_frame(RdpeiClientContext* context, RDPINPUT_TOUCH_FRAME* frame);
+static UINT rdpei_send_touch_event_pdu(GENERIC_CHANNEL_CALLBACK* callback, UINT64 encodeTime,
+                                       RDPEI_TOUCH_FRAME_ENTRY* frames, size_t count);
+
+static UINT64 rdpei_time_us(void)
+{
+	return winpr_GetTickCount64NS() / 1000ull;
+}
 
 #ifdef WITH_DEBUG_RDPEI
 static const char* rdpei_eventid_string(UINT16 event)
@@ -153,21 +178,20 @@ static RDPINPUT_CONTACT_POINT* rdpei_contact(RDPEI_PLUGIN* rdpei, INT32 external
 }
 
 /**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
+ * Moves the current state of all touch contacts to a new frame in the transmission queue.
+ * The frame is stamped with the time of its latest contact update.
  */
-static UINT rdpei_add_frame(RdpeiClientContext* context)
+static void rdpei_queue_touch_frame(RDPEI_PLUGIN* rdpei, UINT64 now)
 {
-	RDPEI_PLUGIN* rdpei = NULL;
-	RDPINPUT_TOUCH_FRAME frame = { 0 };
-	RDPINPUT_CONTACT_DATA contacts[MAX_CONTACTS] = { 0 };
+	WINPR_ASSERT(rdpei);
+	WINPR_ASSERT(rdpei->touchFrameCount < RDPEI_MAX_QUEUED_FRAMES);
 
-	if (!context || !context->handle)
-		return ERROR_INTERNAL_ERROR;
+	RDPEI_TOUCH_FRAME_ENTRY* entry = &rdpei->touchFrames[rdpei->touchFrameCount];
+	RDPINPUT_TOUCH_FRAME* frame = &entry->frame;
+	UINT64 time = 0;
 
-	rdpei = (RDPEI_PLUGIN*)context->handle;
-	frame.contacts = contacts;
+	*frame = (RDPINPUT_TOUCH_FRAME){ 0 };
+	frame->contacts = entry->contacts;
 
 	for (UINT16 i = 0; i < rdpei->maxTouchContacts; i++)
 	{
@@ -176,9 +200,11 @@ static UINT rdpei_add_frame(RdpeiClientContext* context)
 
 		if (contactPoint->dirty)
 		{
-			contacts[frame.contactCount] = *contact;
-			rdpei->contactPoints[i].dirty = FALSE;
-			frame.contactCount++;
+			entry->contacts[frame->contactCount] = *contact;
+			contactPoint->dirty = FALSE;
+			frame->contactCount++;
+			if (contactPoint->sampleTime > time)
+				time = contactPoint->sampleTime;
 		}
 		else if (contactPoint->active)
 		{
@@ -189,8 +215,8 @@ static UINT rdpei_add_frame(RdpeiClientContext* context)
 				contact->contactFlags |= RDPINPUT_CONTACT_FLAG_INCONTACT;
 			}
 
-			contacts[frame.contactCount] = *contact;
-			frame.contactCount++;
+			entry->contacts[frame->contactCount] = *contact;
+			frame->contactCount++;
 		}
 		if (contact->contactFlags & RDPINPUT_CONTACT_FLAG_UP)
 		{
@@ -200,16 +226,78 @@ static UINT rdpei_add_frame(RdpeiClientContext* context)
 		}
 	}
 
-	if (frame.contactCount > 0)
+	if (frame->contactCount == 0)
+		return;
+
+	entry->time = (time > 0) ? time : now;
+	rdpei->touchFrameCount++;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpei_send_touch_frames(RDPEI_PLUGIN* rdpei, UINT64 now)
+{
+	WINPR_ASSERT(rdpei);
+
+	const size_t count = rdpei->touchFrameCount;
+	rdpei->touchFrameCount = 0;
+
+	if (count == 0)
+		return CHANNEL_RC_OK;
+
+	if (!rdpei->base.listener_callback)
+		return ERROR_INTERNAL_ERROR;
+
+	GENERIC_CHANNEL_CALLBACK* callback = rdpei->base.listener_callback->channel_callback;
+
+	/* Just ignore the event if the channel is not connected */
+	if (!callback)
+		return CHANNEL_RC_OK;
+
+	/* The first frame ever transmitted has an offset of zero */
+	UINT64 previous = rdpei->previousFrameTime;
+	for (size_t x = 0; x < count; x++)
+	{
+		RDPEI_TOUCH_FRAME_ENTRY* entry = &rdpei->touchFrames[x];
+		entry->frame.frameOffset =
+		    ((previous > 0) && (entry->time > previous)) ? entry->time - previous : 0;
+		previous = entry->time;
+	}
+
+	const UINT64 oldest = rdpei->touchFrames[0].time;
+	const UINT64 encodeTime = (now > oldest) ? (now - oldest) / 1000ull : 0;
+	const UINT error = rdpei_send_touch_event_pdu(callback, encodeTime, rdpei->touchFrames, count);
+	if (error != CHANNEL_RC_OK)
+	{
+		WLog_Print(rdpei->base.log, WLOG_ERROR,
+		           "rdpei_send_touch_event_pdu failed with error %" PRIu32 "!", error);
+		return error;
+	}
+
+	rdpei->previousFrameTime = previous;
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpei_close_touch_frame(RDPEI_PLUGIN* rdpei, UINT64 now)
+{
+	WINPR_ASSERT(rdpei);
+
+	if (rdpei->touchFrameCount == RDPEI_MAX_QUEUED_FRAMES)
 	{
-		UINT error = rdpei_send_frame(context, &frame);
+		const UINT error = rdpei_send_touch_frames(rdpei, now);
 		if (error != CHANNEL_RC_OK)
-		{
-			WLog_Print(rdpei->base.log, WLOG_ERROR,
-			           "rdpei_send_frame failed with error %" PRIu32 "!", error);
 			return error;
-		}
 	}
+
+	rdpei_queue_touch_frame(rdpei, now);
 	return CHANNEL_RC_OK;
 }
 
@@ -354,60 +442,21 @@ static UINT rdpei_send_pen_event_pdu(GENERIC_CHANNEL_CALLBACK* callback, size_t
 	return status;
 }
 
-static UINT rdpei_send_pen_frame(RdpeiClientContext* context, RDPINPUT_PEN_FRAME* frame)
-{
-	const UINT64 currentTime = GetTickCount64();
-	RDPEI_PLUGIN* rdpei = NULL;
-	GENERIC_CHANNEL_CALLBACK* callback = NULL;
-	UINT error = 0;
-
-	if (!context)
-		return ERROR_INTERNAL_ERROR;
-	rdpei = (RDPEI_PLUGIN*)context->handle;
-	if (!rdpei || !rdpei->base.listener_callback)
-		return ERROR_INTERNAL_ERROR;
-	if (!rdpei || !rdpei->rdpcontext)
-		return ERROR_INTERNAL_ERROR;
-	if (freerdp_settings_get_bool(rdpei->rdpcontext->settings, FreeRDP_SuspendInput))
-		return CHANNEL_RC_OK;
-
-	callback = rdpei->base.listener_callback->channel_callback;
-	/* Just ignore the event if the channel is not connected */
-	if (!callback)
-		return CHANNEL_RC_OK;
-
-	if (!rdpei->previousPenFrameTime && !rdpei->currentPenFrameTime)
-	{
-		rdpei->currentPenFrameTime = currentTime;
-		frame->frameOffset = 0;
-	}
-	else
-	{
-		rdpei->currentPenFrameTime = currentTime;
-		frame->frameOffset = rdpei->currentPenFrameTime - rdpei->previousPenFrameTime;
-	}
-
-	const size_t off = WINPR_ASSERTING_INT_CAST(size_t, frame->frameOffset);
-	error = rdpei_send_pen_event_pdu(callback, off, frame, 1);
-	if (error)
-		return error;
-
-	rdpei->previousPenFrameTime = rdpei->currentPenFrameTime;
-	return error;
-}
-
-static UINT rdpei_add_pen_frame(RdpeiClientContext* context)
+/**
+ * Moves the current state of all pen contacts to a new frame in the transmission queue.
+ * The frame is stamped with the time of its latest pen sample.
+ */
+static void rdpei_queue_pen_frame(RDPEI_PLUGIN* rdpei, UINT64 now)
 {
-	RDPEI_PLUGIN* rdpei = NULL;
-	RDPINPUT_PEN_FRAME penFrame = { 0 };
-	RDPINPUT_PEN_CONTACT penContacts[MAX_PEN_CONTACTS] = { 0 };
-
-	if (!context || !context->handle)
-		return ERROR_INTERNAL_ERROR;
+	WINPR_ASSERT(rdpei);
+	WINPR_ASSERT(rdpei->penFrameCount < RDPEI_MAX_QUEUED_FRAMES);
 
-	rdpei = (RDPEI_PLUGIN*)context->handle;
+	RDPEI_PEN_FRAME_ENTRY* entry = &rdpei->penFrames[rdpei->penFrameCount];
+	RDPINPUT_PEN_FRAME* penFrame = &entry->frame;
+	UINT64 time = 0;
 
-	penFrame.contacts = penContacts;
+	*penFrame = (RDPINPUT_PEN_FRAME){ 0 };
+	penFrame->contacts = entry->contacts;
 
 	for (UINT16 i = 0; i < rdpei->maxPenContacts; i++)
 	{
@@ -415,8 +464,10 @@ static UINT rdpei_add_pen_frame(RdpeiClientContext* context)
 
 		if (contact->dirty)
 		{
-			penContacts[penFrame.contactCount++] = contact->data;
+			entry->contacts[penFrame->contactCount++] = contact->data;
 			contact->dirty = FALSE;
+			if (contact->sampleTime > time)
+				time = contact->sampleTime;
 		}
 		else if (contact->active)
 		{
@@ -427,7 +478,7 @@ static UINT rdpei_add_pen_frame(RdpeiClientContext* context)
 				contact->data.contactFlags |= RDPINPUT_CONTACT_FLAG_INCONTACT;
 			}
 
-			penContacts[penFrame.contactCount++] = contact->data;
+			entry->contacts[penFrame->contactCount++] = contact->data;
 		}
 		if (contact->data.contactFlags & RDPINPUT_CONTACT_FLAG_CANCELED)
 		{
@@ -436,21 +487,121 @@ static UINT rdpei_add_pen_frame(RdpeiClientContext* context)
 		}
 	}
 
-	if (penFrame.contactCount > 0)
-		return rdpei_send_pen_frame(context, &penFrame);
+	if (penFrame->contactCount == 0)
+		return;
+
+	entry->time = (time > 0) ? time : now;
+	rdpei->penFrameCount++;
+}
+
+static UINT rdpei_send_pen_frames(RDPEI_PLUGIN* rdpei, UINT64 now)
+{
+	WINPR_ASSERT(rdpei);
+
+	const size_t count = rdpei->penFrameCount;
+	rdpei->penFrameCount = 0;
+
+	if (count == 0)
+		return CHANNEL_RC_OK;
+
+	if (!rdpei->base.listener_callback || !rdpei->rdpcontext)
+		return ERROR_INTERNAL_ERROR;
+	if (freerdp_settings_get_bool(rdpei->rdpcontext->settings, FreeRDP_SuspendInput))
+		return CHANNEL_RC_OK;
+
+	GENERIC_CHANNEL_CALLBACK* callback = rdpei->base.listener_callback->channel_callback;
+	/* Just ignore the event if the channel is not connected */
+	if (!callback)
+		return CHANNEL_RC_OK;
+
+	RDPINPUT_PEN_FRAME frames[RDPEI_MAX_QUEUED_FRAMES] = { 0 };
+	UINT64 previous = rdpei->previousPenFrameTime;
+	for (size_t x = 0; x < count; x++)
+	{
+		const RDPEI_PEN_FRAME_ENTRY* entry = &rdpei->penFrames[x];
+		frames[x] = entry->frame;
+		frames[x].frameOffset =
+		    ((previous > 0) && (entry->time > previous)) ? entry->time - previous : 0;
+		previous = entry->time;
+	}
+
+	const UINT64 oldest = rdpei->penFrames[0].time;
+	const size_t encodeTime = (now > oldest) ? (size_t)((now - oldest) / 1000ull) : 0;
+	const UINT error = rdpei_send_pen_event_pdu(callback, encodeTime, frames, count);
+	if (error)
+		return error;
+
+	rdpei->previousPenFrameTime = previous;
+	return CHANNEL_RC_OK;
+}
+
+static UINT rdpei_close_pen_frame(RDPEI_PLUGIN* rdpei, UINT64 now)
+{
+	WINPR_ASSERT(rdpei);
+
+	if (rdpei->penFrameCount == RDPEI_MAX_QUEUED_FRAMES)
+	{
+		const UINT error = rdpei_send_pen_frames(rdpei, now);
+		if (error != CHANNEL_RC_OK)
+			return error;
+	}
+
+	rdpei_queue_pen_frame(rdpei, now);
 	return CHANNEL_RC_OK;
 }
 
 static UINT rdpei_update(wLog* log, RdpeiClientContext* context)
 {
-	UINT error = rdpei_add_frame(context);
+	if (!context || !context->handle)
+		return ERROR_INTERNAL_ERROR;
+
+	RDPEI_PLUGIN* rdpei = (RDPEI_PLUGIN*)context->handle;
+	const UINT64 now = rdpei_time_us();
+
+	rdpei_queue_touch_frame(rdpei, now);
+	UINT error = rdpei_send_touch_frames(rdpei, now);
 	if (error != CHANNEL_RC_OK)
 	{
-		WLog_Print(log, WLOG_ERROR, "rdpei_add_frame failed with error %" PRIu32 "!", error);
+		WLog_Print(log, WLOG_ERROR, "rdpei_send_touch_frames failed with error %" PRIu32 "!",
+		           error);
 		return error;
 	}
 
-	return rdpei_add_pen_frame(context);
+	rdpei_queue_pen_frame(rdpei, now);
+	return rdpei_send_pen_frames(rdpei, now);
+}
+
+/**
+ * Frames are sent every quarter of the round trip time, within fixed bounds. A fast link gets
+ * a high frame rate, a slow one fewer PDUs without adding much to the latency it already has.
+ */
+static UINT32 rdpei_frame_interval(const RDPEI_PLUGIN* rdpei)
+{
+	WINPR_ASSERT(rdpei);
+
+	const rdpAutoDetect* autodetect = rdpei->rdpcontext ? rdpei->rdpcontext->autodetect : NULL;
+	if (!autodetect || (autodetect->netCharAverageRTT == 0))
+		return RDPEI_FRAME_INTERVAL_DEFAULT;
+
+	const UINT32 interval = autodetect->netCharAverageRTT / 4;
+	if (interval < RDPEI_FRAME_INTERVAL_MIN)
+		return RDPEI_FRAME_INTERVAL_MIN;
+	if (interval > RDPEI_FRAME_INTERVAL_MAX)
+		return RDPEI_FRAME_INTERVAL_MAX;
+	return interval;
+}
+
+/* time in ms until the next frame is due */
+static DWORD rdpei_frame_delay(const RDPEI_PLUGIN* rdpei)
+{
+	WINPR_ASSERT(rdpei);
+
+	const UINT64 now = GetTickCount64();
+	const UINT64 interval = rdpei_frame_interval(rdpei);
+
+	if ((now < rdpei->lastPollEventTime) || (now - rdpei->lastPollEventTime >= interval))
+		return 0;
+	return (DWORD)(interval - (now - rdpei->lastPollEventTime));
 }
 
 static BOOL rdpei_poll_run_unlocked(rdpContext* context, void* userdata)
@@ -459,13 +610,10 @@ static BOOL rdpei_poll_run_unlocked(rdpContext* context, void* userdata)
 	WINPR_ASSERT(rdpei);
 	WINPR_ASSERT(context);
 
-	const UINT64 now = GetTickCount64();
-
-	/* Send an event every ~20ms */
-	if ((now < rdpei->lastPollEventTime) || (now - rdpei->lastPollEventTime < 20ULL))
+	if (rdpei_frame_delay(rdpei) > 0)
 		return TRUE;
 
-	rdpei->lastPollEventTime = now;
+	rdpei->lastPollEventTime = GetTickCount64();
 
 	const UINT error = rdpei_update(rdpei->base.log, rdpei->context);
 
@@ -473,9 +621,9 @@ static BOOL rdpei_poll_run_unlocked(rdpContext* context, void* userdata)
 
 	if (error != CHANNEL_RC_OK)
 	{
-		WLog_Print(rdpei->base.log, WLOG_ERROR, "rdpei_add_frame failed with error %" PRIu32 "!",
+		WLog_Print(rdpei->base.log, WLOG_ERROR, "rdpei_update failed with error %" PRIu32 "!",
 		           error);
-		setChannelError(context, error, "rdpei_add_frame reported an error");
+		setChannelError(context, error, "rdpei_update reported an error");
 		return FALSE;
 	}
 
@@ -516,7 +664,7 @@ static DWORD WINAPI rdpei_periodic_update(LPVOID arg)
 
 	while (rdpei->running)
 	{
-		status = WaitForSingleObject(rdpei->event, 20);
+		status = WaitForSingleObject(rdpei->event, rdpei_frame_interval(rdpei));
 
 		if (status == WAIT_FAILED)
 		{
@@ -526,6 +674,11 @@ static DWORD WINAPI rdpei_periodic_update(LPVOID arg)
 			break;
 		}
 
+		/* updates arriving before the frame is due are coalesced into it */
+		const DWORD delay = rdpei_frame_delay(rdpei);
+		if (delay > 0)
+			Sleep(delay);
+
 		if (!rdpei_poll_run(rdpei->rdpcontext, rdpei))
 			error = ERROR_INTERNAL_ERROR;
 	}
@@ -637,8 +790,8 @@ static UINT rdpei_write_touch_frame(wLog* log, wStream* s, RDPINPUT_TOUCH_FRAME*
 	 * the time offset from the previous frame (in microseconds).
 	 * If this is the first frame being transmitted then this field MUST be set to zero.
 	 */
-	rdpei_write_8byte_unsigned(s, frame->frameOffset *
-	                                  1000); /* frameOffset (EIGHT_BYTE_UNSIGNED_INTEGER) */
+	/* frameOffset (EIGHT_BYTE_UNSIGNED_INTEGER) */
+	rdpei_write_8byte_unsigned(s, frame->frameOffset);
 
 	if (!Stream_EnsureRemainingCapacity(s, (size_t)frame->contactCount * 64))
 	{
@@ -707,8 +860,8 @@ static UINT rdpei_write_touch_frame(wLog* log, wStream* s, RDPINPUT_TOUCH_FRAME*
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT rdpei_send_touch_event_pdu(GENERIC_CHANNEL_CALLBACK* callback,
-                                       RDPINPUT_TOUCH_FRAME* frame)
+static UINT rdpei_send_touch_event_pdu(GENERIC_CHANNEL_CALLBACK* callback, UINT64 encodeTime,
+                                       RDPEI_TOUCH_FRAME_ENTRY* frames, size_t count)
 {
 	UINT status = 0;
 
@@ -720,10 +873,13 @@ static UINT rdpei_send_touch_event_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	if (freerdp_settings_get_bool(rdpei->rdpcontext->settings, FreeRDP_SuspendInput))
 		return CHANNEL_RC_OK;
 
-	if (!frame)
+	if (!frames || (count == 0) || (count > UINT16_MAX) || (encodeTime > UINT32_MAX))
 		return ERROR_INTERNAL_ERROR;
 
-	size_t pduLength = 64ULL + (64ULL * frame->contactCount);
+	size_t pduLength = 64ULL;
+	for (size_t x = 0; x < count; x++)
+		pduLength += 64ULL * frames[x].frame.contactCount;
+
 	wStream* s = Stream_New(NULL, pduLength);
 
 	if (!s)
@@ -737,17 +893,19 @@ static UINT rdpei_send_touch_event_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	 * the time that has elapsed (in milliseconds) from when the oldest touch frame
 	 * was generated to when it was encoded for transmission by the client.
 	 */
-	rdpei_write_4byte_unsigned(
-	    s, (UINT32)frame->frameOffset); /* encodeTime (FOUR_BYTE_UNSIGNED_INTEGER) */
-	rdpei_write_2byte_unsigned(s, 1);   /* (frameCount) TWO_BYTE_UNSIGNED_INTEGER */
+	rdpei_write_4byte_unsigned(s, (UINT32)encodeTime); /* encodeTime (FOUR_BYTE_UNSIGNED_INTEGER) */
+	rdpei_write_2byte_unsigned(s, (UINT16)count);      /* (frameCount) TWO_BYTE_UNSIGNED_INTEGER */
 
-	status = rdpei_write_touch_frame(rdpei->base.log, s, frame);
-	if (status)
+	for (size_t x = 0; x < count; x++)
 	{
-		WLog_Print(rdpei->base.log, WLOG_ERROR,
-		           "rdpei_write_touch_frame failed with error %" PRIu32 "!", status);
-		Stream_Free(s, TRUE);
-		return status;
+		status = rdpei_write_touch_frame(rdpei->base.log, s, &frames[x].frame);
+		if (status)
+		{
+			WLog_Print(rdpei->base.log, WLOG_ERROR,
+			           "rdpei_write_touch_frame failed with error %" PRIu32 "!", status);
+			Stream_Free(s, TRUE);
+			return status;
+		}
 	}
 
 	Stream_SealLength(s);
@@ -985,46 +1143,6 @@ static UINT32 rdpei_get_features(RdpeiClientContext* context)
 	return rdpei->features;
 }
 
-/**
- * Function description
- *
- * @return 0 on success, otherwise a Win32 error code
- */
-UINT rdpei_send_frame(RdpeiClientContext* context, RDPINPUT_TOUCH_FRAME* frame)
-{
-	UINT64 currentTime = GetTickCount64();
-	RDPEI_PLUGIN* rdpei = (RDPEI_PLUGIN*)context->handle;
-	GENERIC_CHANNEL_CALLBACK* callback = NULL;
-	UINT error = 0;
-
-	callback = rdpei->base.listener_callback->channel_callback;
-
-	/* Just ignore the event if the channel is not connected */
-	if (!callback)
-		return CHANNEL_RC_OK;
-
-	if (!rdpei->previousFrameTime && !rdpei->currentFrameTime)
-	{
-		rdpei->currentFrameTime = currentTime;
-		frame->frameOffset = 0;
-	}
-	else
-	{
-		rdpei->currentFrameTime = currentTime;
-		frame->frameOffset = rdpei->currentFrameTime - rdpei->previousFrameTime;
-	}
-
-	if ((error = rdpei_send_touch_event_pdu(callback, frame)))
-	{
-		WLog_Print(rdpei->base.log, WLOG_ERROR,
-		           "rdpei_send_touch_event_pdu failed with error %" PRIu32 "!", error);
-		return error;
-	}
-
-	rdpei->previousFrameTime = rdpei->currentFrameTime;
-	return error;
-}
-
 /**
  * Function description
  *
@@ -1034,19 +1152,34 @@ static UINT rdpei_add_contact(RdpeiClientContext* context, const RDPINPUT_CONTAC
 {
 	RDPINPUT_CONTACT_POINT* contactPoint = NULL;
 	RDPEI_PLUGIN* rdpei = NULL;
+	UINT error = CHANNEL_RC_OK;
 	if (!context || !contact || !context->handle)
 		return ERROR_INTERNAL_ERROR;
 
 	rdpei = (RDPEI_PLUGIN*)context->handle;
+	if (contact->contactId >= MAX_CONTACTS)
+		return ERROR_INVALID_PARAMETER;
+
+	const UINT64 now = rdpei_time_us();
+	const UINT32 transitions =
+	    RDPINPUT_CONTACT_FLAG_DOWN | RDPINPUT_CONTACT_FLAG_UP | RDPINPUT_CONTACT_FLAG_CANCELED;
 
 	EnterCriticalSection(&rdpei->lock);
 	contactPoint = &rdpei->contactPoints[contact->contactId];
+
+	/* Motion replaces the pending motion of the same contact. A state change must not get
+	 * lost, so the frame holding the pending state is closed first. */
+	if (contactPoint->dirty && ((contactPoint->data.contactFlags != contact->contactFlags) ||
+	                            ((contact->contactFlags & transitions) != 0)))
+		error = rdpei_close_touch_frame(rdpei, now);
+
 	contactPoint->data = *contact;
 	contactPoint->dirty = TRUE;
+	contactPoint->sampleTime = now;
 	(void)SetEvent(rdpei->event);
 	LeaveCriticalSection(&rdpei->lock);
 
-	return CHANNEL_RC_OK;
+	return error;
 }
 
 static UINT rdpei_touch_process(RdpeiClientContext* context, INT32 externalId, UINT32 contactFlags,
@@ -1259,17 +1392,25 @@ static UINT rdpei_add_pen(RdpeiClientContext* context, INT32 externalId,
 
 	rdpei = (RDPEI_PLUGIN*)context->handle;
 
+	const UINT64 now = rdpei_time_us();
+	UINT error = CHANNEL_RC_OK;
+
 	EnterCriticalSection(&rdpei->lock);
 	contactPoint = rdpei_pen_contact(rdpei, externalId, TRUE);
 	if (contactPoint)
 	{
+		/* Every pen sample is transmitted, a pending one gets a frame of its own */
+		if (contactPoint->dirty)
+			error = rdpei_close_pen_frame(rdpei, now);
+
 		contactPoint->data = *contact;
 		contactPoint->dirty = TRUE;
+		contactPoint->sampleTime = now;
 		(void)SetEvent(rdpei->event);
 	}
 	LeaveCriticalSection(&rdpei->lock);
 
-	return CHANNEL_RC_OK;
+	return error;
 }
 
 static UINT rdpei_pen_process(RdpeiClientContext* context, INT32 externalId, UINT32 contactFlags,
@@ -1484,7 +1625,6 @@ static UINT init_plugin_cb(GENERIC_DYNVC_PLUGIN* base, rdpContext* rcontext, rdp
 	WINPR_UNUSED(settings);
 
 	rdpei->version = RDPINPUT_PROTOCOL_V300;
-	rdpei->currentFrameTime = 0;
 	rdpei->previousFrameTime = 0;
 	rdpei->maxTouchContacts = MAX_CONTACTS;
 	rdpei->maxPenContacts = MAX_PEN_CONTACTS;
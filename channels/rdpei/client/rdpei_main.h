@@ -64,6 +64,7 @@ typedef struct
 	BOOL active;
 	UINT32 contactId;
 	INT32 externalId;
+	UINT64 sampleTime;
 	RDPINPUT_CONTACT_DATA data;
 } RDPINPUT_CONTACT_POINT;
 
@@ -72,6 +73,7 @@ typedef struct
 	BOOL dirty;
 	BOOL active;
 	INT32 externalId;
+	UINT64 sampleTime;
 	RDPINPUT_PEN_CONTACT data;
 } RDPINPUT_PEN_CONTACT_POINT;
 
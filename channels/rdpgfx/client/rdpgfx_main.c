@@ -30,6 +30,7 @@
 #include <winpr/wlog.h>
 #include <winpr/print.h>
 #include <winpr/synch.h>
+#include <winpr/interlocked.h>
 #include <winpr/thread.h>
 #include <winpr/stream.h>
 #include <winpr/sysinfo.h>
@@ -38,6 +39,7 @@
 
 #include <freerdp/addin.h>
 #include <freerdp/channels/log.h>
+#include <freerdp/metrics.h>
 
 #include "rdpgfx_common.h"
 #include "rdpgfx_codec.h"
@@ -905,13 +907,19 @@ static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
 	for (int idx = 0; idx < count; idx++)
 	{
 		PERSISTENT_CACHE_ENTRY entry = { 0 };
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
+
+		/* a slot of 0 marks an entry the server did not import, do not load its bitmap */
+		const UINT16 cacheSlot = reply->cacheSlots[idx];
+		if (cacheSlot == 0)
+			continue;
+
+		if ((persistent_cache_seek_entry(persistent, idx) < 1) ||
+		    (persistent_cache_read_entry(persistent, &entry) < 1))
 		{
 			error = ERROR_INVALID_DATA;
 			goto fail;
 		}
 
-		const UINT16 cacheSlot = reply->cacheSlots[idx];
 		if (context && context->ImportCacheEntry)
 			context->ImportCacheEntry(context, cacheSlot, &entry);
 	}
@@ -992,13 +1000,14 @@ static UINT rdpgfx_recv_create_surface_pdu(GENERIC_CHANNEL_CALLBACK* callback, w
 	RdpgfxClientContext* context = gfx->context;
 	UINT error = CHANNEL_RC_OK;
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 7))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 7, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT16(s, pdu.surfaceId);  /* surfaceId (2 bytes) */
-	Stream_Read_UINT16(s, pdu.width);      /* width (2 bytes) */
-	Stream_Read_UINT16(s, pdu.height);     /* height (2 bytes) */
-	Stream_Read_UINT8(s, pdu.pixelFormat); /* RDPGFX_PIXELFORMAT (1 byte) */
+	pdu.surfaceId = StreamSpan_Get_UINT16(&span);  /* surfaceId (2 bytes) */
+	pdu.width = StreamSpan_Get_UINT16(&span);      /* width (2 bytes) */
+	pdu.height = StreamSpan_Get_UINT16(&span);     /* height (2 bytes) */
+	pdu.pixelFormat = StreamSpan_Get_UINT8(&span); /* RDPGFX_PIXELFORMAT (1 byte) */
 	DEBUG_RDPGFX(gfx->log,
 	             "RecvCreateSurfacePdu: surfaceId: %" PRIu16 " width: %" PRIu16 " height: %" PRIu16
 	             " pixelFormat: 0x%02" PRIX8 "",
@@ -1069,14 +1078,16 @@ static UINT rdpgfx_recv_start_frame_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStr
 	RdpgfxClientContext* context = gfx->context;
 	UINT error = CHANNEL_RC_OK;
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, RDPGFX_START_FRAME_PDU_SIZE))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, RDPGFX_START_FRAME_PDU_SIZE, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT32(s, pdu.timestamp); /* timestamp (4 bytes) */
-	Stream_Read_UINT32(s, pdu.frameId);   /* frameId (4 bytes) */
+	pdu.timestamp = StreamSpan_Get_UINT32(&span); /* timestamp (4 bytes) */
+	pdu.frameId = StreamSpan_Get_UINT32(&span);   /* frameId (4 bytes) */
 	DEBUG_RDPGFX(gfx->log, "RecvStartFramePdu: frameId: %" PRIu32 " timestamp: 0x%08" PRIX32 "",
 	             pdu.frameId, pdu.timestamp);
 	gfx->StartDecodingTime = GetTickCount64();
+	gfx->FrameReceiveTime = gfx->ReceiveTime;
 
 	if (context)
 	{
@@ -1106,15 +1117,28 @@ static UINT rdpgfx_recv_end_frame_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStrea
 	RdpgfxClientContext* context = gfx->context;
 	UINT error = CHANNEL_RC_OK;
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, RDPGFX_END_FRAME_PDU_SIZE))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, RDPGFX_END_FRAME_PDU_SIZE, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT32(s, pdu.frameId); /* frameId (4 bytes) */
+	pdu.frameId = StreamSpan_Get_UINT32(&span); /* frameId (4 bytes) */
 	DEBUG_RDPGFX(gfx->log, "RecvEndFramePdu: frameId: %" PRIu32 "", pdu.frameId);
 
+	/* frames received but not yet decoded, zero when PDUs are processed as they arrive */
+	UINT32 queueDepth = 0;
+	if (gfx->queue)
+	{
+		gfx->BufferEndFrames++;
+		const LONG queued =
+		    InterlockedCompareExchange(&gfx->QueuedFrames, 0, 0) - gfx->BufferEndFrames;
+		if (queued > 0)
+			queueDepth = (UINT32)queued;
+	}
+
 	const UINT64 start = GetTickCount64();
 	if (context)
 	{
+		context->FramesBehind = queueDepth;
 		IFCALLRET(context->EndFrame, error, context, &pdu);
 
 		if (error)
@@ -1128,6 +1152,15 @@ static UINT rdpgfx_recv_end_frame_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStrea
 	const UINT64 EndFrameTime = end - start;
 	gfx->TotalDecodedFrames++;
 
+	/* from the arrival of the frame until its output is updated */
+	if (gfx->rdpcontext && (end >= gfx->FrameReceiveTime))
+	{
+		rdpMetrics* metrics = gfx->rdpcontext->metrics;
+		(void)metrics_record(
+		    metrics, metrics_register(metrics, "gfx_frame_latency_us", FREERDP_METRIC_HISTOGRAM),
+		    (end - gfx->FrameReceiveTime) * 1000);
+	}
+
 	if (!gfx->sendFrameAcks)
 		return error;
 
@@ -1146,7 +1179,9 @@ static UINT rdpgfx_recv_end_frame_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStrea
 	}
 	else
 	{
-		ack.queueDepth = QUEUE_DEPTH_UNAVAILABLE;
+		/* A backlog tells the server to throttle. QUEUE_DEPTH_UNAVAILABLE is 0, which the
+		 * server reads as an empty queue as well. */
+		ack.queueDepth = queueDepth;
 
 		if ((error = rdpgfx_send_frame_acknowledge_pdu(context, &ack)))
 			WLog_Print(gfx->log, WLOG_ERROR,
@@ -1166,15 +1201,16 @@ static UINT rdpgfx_recv_end_frame_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStrea
 			if (freerdp_settings_get_bool(gfx->rdpcontext->settings, FreeRDP_GfxSendQoeAck))
 			{
 				RDPGFX_QOE_FRAME_ACKNOWLEDGE_PDU qoe = { 0 };
-				UINT64 diff = (GetTickCount64() - gfx->StartDecodingTime);
 
-				if (diff > 65000)
-					diff = 0;
+				/* Measured from the arrival of the frame, so the time the frame spent
+				 * waiting for the decoder is part of the reported latency. */
+				const UINT64 received = gfx->FrameReceiveTime;
+				UINT64 diff = (start > received) ? start - received : 0;
 
 				qoe.frameId = pdu.frameId;
-				qoe.timestamp = gfx->StartDecodingTime % UINT32_MAX;
-				qoe.timeDiffSE = WINPR_ASSERTING_INT_CAST(UINT16, diff);
-				qoe.timeDiffEDR = WINPR_ASSERTING_INT_CAST(UINT16, EndFrameTime);
+				qoe.timestamp = received % UINT32_MAX;
+				qoe.timeDiffSE = (UINT16)MIN(diff, UINT16_MAX);
+				qoe.timeDiffEDR = (UINT16)MIN(EndFrameTime, UINT16_MAX);
 
 				if ((error = rdpgfx_send_qoe_frame_acknowledge_pdu(context, &qoe)))
 					WLog_Print(gfx->log, WLOG_ERROR,
@@ -2005,6 +2041,178 @@ static UINT rdpgfx_recv_pdu(GENERIC_CHANNEL_CALLBACK* callback, wStream* s)
 	return error;
 }
 
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_recv_pdus(GENERIC_CHANNEL_CALLBACK* callback, const BYTE* data, size_t length)
+{
+	UINT error = CHANNEL_RC_OK;
+	WINPR_ASSERT(callback);
+	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)callback->plugin;
+	WINPR_ASSERT(gfx);
+
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+
+	if (!s)
+	{
+		WLog_Print(gfx->log, WLOG_ERROR, "calloc failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	while (Stream_GetPosition(s) < Stream_Length(s))
+	{
+		if ((error = rdpgfx_recv_pdu(callback, s)))
+		{
+			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_recv_pdu failed with error %" PRIu32 "!",
+			           error);
+			break;
+		}
+	}
+
+	return error;
+}
+
+/**
+ * Counts the frames completed by a buffer of PDUs, only the PDU headers are inspected.
+ */
+static LONG rdpgfx_count_end_frames(const BYTE* data, size_t length)
+{
+	LONG count = 0;
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+
+	while (Stream_GetRemainingLength(s) >= 8)
+	{
+		const size_t beg = Stream_GetPosition(s);
+		const UINT16 cmdId = Stream_Get_UINT16(s);
+		Stream_Seek_UINT16(s); /* flags (2 bytes) */
+		const UINT32 pduLength = Stream_Get_UINT32(s);
+
+		if (cmdId == RDPGFX_CMDID_ENDFRAME)
+			count++;
+
+		if ((pduLength < 8) || (pduLength > length - beg))
+			break;
+		Stream_SetPosition(s, beg + pduLength);
+	}
+
+	return count;
+}
+
+static void rdpgfx_queue_free(void* obj)
+{
+	wMessage* msg = obj;
+	if (!msg)
+		return;
+	if (msg->id != 0)
+		return;
+	free(msg->wParam);
+}
+
+/**
+ * Processes the decompressed PDUs in order of arrival. Decoding and presenting a frame happen
+ * here, so a slow codec does not hold up the dynamic channel the PDUs were received on.
+ */
+static DWORD WINAPI rdpgfx_decode_thread(LPVOID arg)
+{
+	RDPGFX_PLUGIN* gfx = arg;
+	WINPR_ASSERT(gfx);
+
+	while (TRUE)
+	{
+		wMessage message = { 0 };
+		HANDLE handles[] = { MessageQueue_Event(gfx->queue),
+			                 freerdp_abort_event(gfx->rdpcontext) };
+
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+		if (status != WAIT_OBJECT_0)
+			break;
+
+		if (MessageQueue_Peek(gfx->queue, &message, TRUE) < 1)
+			continue;
+
+		if (message.id == WMQ_QUIT)
+			break;
+
+		const size_t length = (size_t)message.lParam;
+		const LONG frames = rdpgfx_count_end_frames(message.wParam, length);
+
+		gfx->ReceiveTime = message.time;
+		gfx->BufferEndFrames = 0;
+		const UINT error = rdpgfx_recv_pdus(message.context, message.wParam, length);
+		if (error)
+			WLog_Print(gfx->log, WLOG_WARN, "rdpgfx_recv_pdus failed with error %" PRIu32 "!",
+			           error);
+		free(message.wParam);
+
+		/* frames of a malformed buffer are dropped from the backlog as well */
+		(void)InterlockedExchangeAdd(&gfx->QueuedFrames, -frames);
+		gfx->BufferEndFrames = 0;
+	}
+
+	ExitThread(CHANNEL_RC_OK);
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_start_decode_thread(RDPGFX_PLUGIN* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	const UINT32 flags = freerdp_settings_get_uint32(gfx->rdpcontext->settings,
+	                                                 FreeRDP_ThreadingFlags);
+	if (flags & THREADING_FLAGS_DISABLE_THREADS)
+		return CHANNEL_RC_OK;
+
+	wObject obj = { 0 };
+	obj.fnObjectFree = rdpgfx_queue_free;
+	gfx->queue = MessageQueue_NewEx(&obj, WMQ_FLAG_SINGLE_CONSUMER);
+	if (!gfx->queue)
+	{
+		WLog_Print(gfx->log, WLOG_ERROR, "MessageQueue_NewEx failed!");
+		return CHANNEL_RC_NO_MEMORY;
+	}
+
+	gfx->thread = CreateThread(NULL, 0, rdpgfx_decode_thread, gfx, 0, NULL);
+	if (!gfx->thread)
+	{
+		WLog_Print(gfx->log, WLOG_ERROR, "CreateThread failed!");
+		MessageQueue_Free(gfx->queue);
+		gfx->queue = NULL;
+		return CHANNEL_RC_INITIALIZATION_ERROR;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Lets the decode thread finish the PDUs already queued, unless the connection is aborted.
+ */
+static void rdpgfx_stop_decode_thread(RDPGFX_PLUGIN* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	if (gfx->queue)
+		MessageQueue_PostQuit(gfx->queue, 0);
+
+	if (gfx->thread)
+	{
+		(void)WaitForSingleObject(gfx->thread, INFINITE);
+		(void)CloseHandle(gfx->thread);
+		gfx->thread = NULL;
+	}
+
+	MessageQueue_Free(gfx->queue);
+	gfx->queue = NULL;
+}
+
 /**
  * Function description
  *
@@ -2031,26 +2239,24 @@ static UINT rdpgfx_on_data_received(IWTSVirtualChannelCallback* pChannelCallback
 		return ERROR_INTERNAL_ERROR;
 	}
 
-	wStream sbuffer = { 0 };
-	wStream* s = Stream_StaticConstInit(&sbuffer, pDstData, DstSize);
-
-	if (!s)
+	if (gfx->queue)
 	{
-		WLog_Print(gfx->log, WLOG_ERROR, "calloc failed!");
-		free(pDstData);
-		return CHANNEL_RC_NO_MEMORY;
-	}
+		const LONG frames = rdpgfx_count_end_frames(pDstData, DstSize);
+		(void)InterlockedExchangeAdd(&gfx->QueuedFrames, frames);
 
-	while (Stream_GetPosition(s) < Stream_Length(s))
-	{
-		if ((error = rdpgfx_recv_pdu(callback, s)))
+		/* the decode thread takes ownership of the buffer */
+		if (!MessageQueue_Post(gfx->queue, callback, 0, pDstData, (void*)(size_t)DstSize))
 		{
-			WLog_Print(gfx->log, WLOG_ERROR, "rdpgfx_recv_pdu failed with error %" PRIu32 "!",
-			           error);
-			break;
+			WLog_Print(gfx->log, WLOG_ERROR, "MessageQueue_Post failed!");
+			(void)InterlockedExchangeAdd(&gfx->QueuedFrames, -frames);
+			free(pDstData);
+			return ERROR_INTERNAL_ERROR;
 		}
+		return CHANNEL_RC_OK;
 	}
 
+	gfx->ReceiveTime = GetTickCount64();
+	error = rdpgfx_recv_pdus(callback, pDstData, DstSize);
 	free(pDstData);
 	return error;
 }
@@ -2080,6 +2286,13 @@ static UINT rdpgfx_on_open(IWTSVirtualChannelCallback* pChannelCallback)
 			           error);
 	}
 
+	if (!gfx->queue)
+	{
+		const UINT rc = rdpgfx_start_decode_thread(gfx);
+		if (rc)
+			return rc;
+	}
+
 	if (do_caps_advertise)
 		error = rdpgfx_send_supported_caps(callback);
 
@@ -2104,6 +2317,7 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	RdpgfxClientContext* context = gfx->context;
 
 	DEBUG_RDPGFX(gfx->log, "OnClose");
+	rdpgfx_stop_decode_thread(gfx);
 	error = rdpgfx_save_persistent_cache(gfx);
 
 	if (error)
@@ -2119,6 +2333,7 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 	free(callback);
 	gfx->UnacknowledgedFrames = 0;
 	gfx->TotalDecodedFrames = 0;
+	(void)InterlockedExchange(&gfx->QueuedFrames, 0);
 
 	if (context)
 	{
@@ -2136,6 +2351,7 @@ static void terminate_plugin_cb(GENERIC_DYNVC_PLUGIN* base)
 	RdpgfxClientContext* context = gfx->context;
 
 	DEBUG_RDPGFX(gfx->log, "Terminated");
+	rdpgfx_stop_decode_thread(gfx);
 	rdpgfx_client_context_free(context);
 }
 
@@ -42,6 +42,10 @@ typedef struct
 	UINT32 UnacknowledgedFrames;
 	UINT32 TotalDecodedFrames;
 	UINT64 StartDecodingTime;
+	UINT64 ReceiveTime;
+	UINT64 FrameReceiveTime;
+	volatile LONG QueuedFrames;
+	LONG BufferEndFrames;
 	BOOL suspendFrameAcks;
 	BOOL sendFrameAcks;
 
@@ -56,6 +60,9 @@ typedef struct
 	wLog* log;
 	RDPGFX_CAPSET ConnectionCaps;
 	RdpgfxClientContext* context;
+
+	wMessageQueue* queue;
+	HANDLE thread;
 } RDPGFX_PLUGIN;
 
 #endif /* FREERDP_CHANNEL_RDPGFX_CLIENT_MAIN_H */
@@ -40,12 +40,13 @@ UINT rdpgfx_read_header(wStream* s, RDPGFX_HEADER* header)
 	WINPR_ASSERT(s);
 	WINPR_ASSERT(header);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 8))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 8, &span))
 		return CHANNEL_RC_NO_MEMORY;
 
-	Stream_Read_UINT16(s, header->cmdId);     /* cmdId (2 bytes) */
-	Stream_Read_UINT16(s, header->flags);     /* flags (2 bytes) */
-	Stream_Read_UINT32(s, header->pduLength); /* pduLength (4 bytes) */
+	header->cmdId = StreamSpan_Get_UINT16(&span);     /* cmdId (2 bytes) */
+	header->flags = StreamSpan_Get_UINT16(&span);     /* flags (2 bytes) */
+	header->pduLength = StreamSpan_Get_UINT32(&span); /* pduLength (4 bytes) */
 
 	if (header->pduLength < 8)
 	{
@@ -86,11 +87,12 @@ UINT rdpgfx_read_point16(wStream* s, RDPGFX_POINT16* pt16)
 	WINPR_ASSERT(s);
 	WINPR_ASSERT(pt16);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 4))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 4, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT16(s, pt16->x); /* x (2 bytes) */
-	Stream_Read_UINT16(s, pt16->y); /* y (2 bytes) */
+	pt16->x = StreamSpan_Get_UINT16(&span); /* x (2 bytes) */
+	pt16->y = StreamSpan_Get_UINT16(&span); /* y (2 bytes) */
 	return CHANNEL_RC_OK;
 }
 
@@ -122,13 +124,14 @@ UINT rdpgfx_read_rect16(wStream* s, RECTANGLE_16* rect16)
 	WINPR_ASSERT(s);
 	WINPR_ASSERT(rect16);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 8))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 8, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT16(s, rect16->left);   /* left (2 bytes) */
-	Stream_Read_UINT16(s, rect16->top);    /* top (2 bytes) */
-	Stream_Read_UINT16(s, rect16->right);  /* right (2 bytes) */
-	Stream_Read_UINT16(s, rect16->bottom); /* bottom (2 bytes) */
+	rect16->left = StreamSpan_Get_UINT16(&span);   /* left (2 bytes) */
+	rect16->top = StreamSpan_Get_UINT16(&span);    /* top (2 bytes) */
+	rect16->right = StreamSpan_Get_UINT16(&span);  /* right (2 bytes) */
+	rect16->bottom = StreamSpan_Get_UINT16(&span); /* bottom (2 bytes) */
 	if (rect16->left >= rect16->right)
 		return ERROR_INVALID_DATA;
 	if (rect16->top >= rect16->bottom)
@@ -166,13 +169,14 @@ UINT rdpgfx_read_color32(wStream* s, RDPGFX_COLOR32* color32)
 	WINPR_ASSERT(s);
 	WINPR_ASSERT(color32);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 4))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 4, &span))
 		return ERROR_INVALID_DATA;
 
-	Stream_Read_UINT8(s, color32->B);  /* B (1 byte) */
-	Stream_Read_UINT8(s, color32->G);  /* G (1 byte) */
-	Stream_Read_UINT8(s, color32->R);  /* R (1 byte) */
-	Stream_Read_UINT8(s, color32->XA); /* XA (1 byte) */
+	color32->B = StreamSpan_Get_UINT8(&span);  /* B (1 byte) */
+	color32->G = StreamSpan_Get_UINT8(&span);  /* G (1 byte) */
+	color32->R = StreamSpan_Get_UINT8(&span);  /* R (1 byte) */
+	color32->XA = StreamSpan_Get_UINT8(&span); /* XA (1 byte) */
 	return CHANNEL_RC_OK;
 }
 
@@ -29,9 +29,12 @@
 #include <winpr/synch.h>
 #include <winpr/thread.h>
 #include <winpr/stream.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include <freerdp/channels/wtsvc.h>
 #include <freerdp/channels/log.h>
@@ -107,20 +110,21 @@ static INLINE BOOL rdpgfx_server_packet_complete_header(wStream* s, size_t start
 	return TRUE;
 }
 
+/* a batch larger than this is sent right away, the client handles it as any packet list */
+#define RDPGFX_BATCH_MAX_SIZE (4ull * 1024ull * 1024ull)
+
 /**
  * Function description
- * Send the stream for rdpgfx server packet.
- * The packet would be compressed according to [MS-RDPEGFX].
+ * Compress a packet list according to [MS-RDPEGFX] and write it as one DVC message.
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT rdpgfx_server_packet_send(RdpgfxServerContext* context, wStream* s)
+static UINT rdpgfx_server_packet_write(RdpgfxServerContext* context, const BYTE* pSrcData,
+                                       size_t SrcSize)
 {
 	UINT error = 0;
 	UINT32 flags = 0;
 	ULONG written = 0;
-	BYTE* pSrcData = Stream_Buffer(s);
-	const size_t SrcSize = Stream_GetPosition(s);
 	if (SrcSize > UINT32_MAX)
 		return ERROR_INTERNAL_ERROR;
 
@@ -165,6 +169,51 @@ static UINT rdpgfx_server_packet_send(RdpgfxServerContext* context, wStream* s)
 	error = CHANNEL_RC_OK;
 out:
 	Stream_Free(fs, TRUE);
+	return error;
+}
+
+static UINT rdpgfx_server_batch_flush(RdpgfxServerContext* context)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+
+	wStream* batch = context->priv->batch;
+	if (!batch || (Stream_GetPosition(batch) == 0))
+		return CHANNEL_RC_OK;
+
+	const UINT error =
+	    rdpgfx_server_packet_write(context, Stream_Buffer(batch), Stream_GetPosition(batch));
+	Stream_SetPosition(batch, 0);
+	return error;
+}
+
+/**
+ * Function description
+ * Send the stream for rdpgfx server packet.
+ * The packet would be compressed according to [MS-RDPEGFX].
+ * While a batch is active the packet is appended to the batch instead.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_server_packet_send(RdpgfxServerContext* context, wStream* s)
+{
+	UINT error = CHANNEL_RC_OK;
+	RdpgfxServerPrivate* priv = context->priv;
+
+	if (!priv->batching)
+		error = rdpgfx_server_packet_write(context, Stream_Buffer(s), Stream_GetPosition(s));
+	else if (!Stream_EnsureRemainingCapacity(priv->batch, Stream_GetPosition(s)))
+	{
+		WLog_Print(priv->log, WLOG_ERROR, "Stream_EnsureRemainingCapacity failed!");
+		error = CHANNEL_RC_NO_MEMORY;
+	}
+	else
+	{
+		Stream_Write(priv->batch, Stream_Buffer(s), Stream_GetPosition(s));
+		if (Stream_GetPosition(priv->batch) >= RDPGFX_BATCH_MAX_SIZE)
+			error = rdpgfx_server_batch_flush(context);
+	}
+
 	Stream_Free(s, TRUE);
 	return error;
 }
@@ -455,6 +504,48 @@ static INLINE BOOL rdpgfx_write_end_frame_pdu(wStream* s, const RDPGFX_END_FRAME
 	return TRUE;
 }
 
+/* remember when a frame was completed to measure the latency of its acknowledgement */
+static void rdpgfx_server_frame_sent(RdpgfxServerContext* context, UINT32 frameId)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+
+	const size_t index = frameId % ARRAYSIZE(context->priv->pendingFrames);
+	context->priv->pendingFrames[index].frameId = frameId;
+	context->priv->pendingFrames[index].sent = winpr_GetTickCount64NS();
+}
+
+static void rdpgfx_server_frame_acked(RdpgfxServerContext* context,
+                                      const RDPGFX_FRAME_ACKNOWLEDGE_PDU* pdu)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+	WINPR_ASSERT(pdu);
+
+	if (!context->rdpcontext)
+		return;
+
+	rdpMetrics* metrics = context->rdpcontext->metrics;
+	const size_t index = pdu->frameId % ARRAYSIZE(context->priv->pendingFrames);
+	const UINT64 sent = context->priv->pendingFrames[index].sent;
+	if ((sent != 0) && (context->priv->pendingFrames[index].frameId == pdu->frameId))
+	{
+		const UINT64 us = (winpr_GetTickCount64NS() - sent) / 1000;
+		const SSIZE_T id =
+		    metrics_register(metrics, "gfx_frame_ack_latency_us", FREERDP_METRIC_HISTOGRAM);
+		(void)metrics_record(metrics, id, us);
+		context->priv->pendingFrames[index].sent = 0;
+	}
+
+	if ((pdu->queueDepth != QUEUE_DEPTH_UNAVAILABLE) &&
+	    (pdu->queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT))
+	{
+		const SSIZE_T id =
+		    metrics_register(metrics, "gfx_client_queue_depth", FREERDP_METRIC_GAUGE);
+		(void)metrics_record(metrics, id, pdu->queueDepth);
+	}
+}
+
 /**
  * Function description
  *
@@ -497,6 +588,7 @@ static UINT rdpgfx_send_end_frame_pdu(RdpgfxServerContext* context, const RDPGFX
 	}
 
 	rdpgfx_write_end_frame_pdu(s, pdu);
+	rdpgfx_server_frame_sent(context, pdu->frameId);
 	return rdpgfx_server_single_packet_send(context, s);
 }
 
@@ -904,6 +996,7 @@ static UINT rdpgfx_send_surface_frame_command(RdpgfxServerContext* context,
 		if (!rdpgfx_write_end_frame_pdu(s, endFrame) ||
 		    !rdpgfx_server_packet_complete_header(s, position))
 			goto error;
+		rdpgfx_server_frame_sent(context, endFrame->frameId);
 	}
 
 	return rdpgfx_server_packet_send(context, s);
@@ -1215,6 +1308,9 @@ static UINT rdpgfx_recv_frame_acknowledge_pdu(RdpgfxServerContext* context, wStr
 	Stream_Read_UINT32(s, pdu.frameId);            /* frameId (4 bytes) */
 	Stream_Read_UINT32(s, pdu.totalFramesDecoded); /* totalFramesDecoded (4 bytes) */
 
+	FREERDP_TRACEPOINT(gfx_frame_ack, pdu.frameId, pdu.queueDepth);
+	rdpgfx_server_frame_acked(context, &pdu);
+
 	if (context)
 	{
 		IFCALLRET(context->FrameAcknowledge, error, context, &pdu);
@@ -1663,6 +1759,11 @@ BOOL rdpgfx_server_close(RdpgfxServerContext* context)
 	zgfx_context_free(priv->zgfx);
 	priv->zgfx = NULL;
 
+	/* a batch left open belongs to the closed channel */
+	priv->batching = FALSE;
+	if (priv->batch)
+		Stream_SetPosition(priv->batch, 0);
+
 	if (priv->rdpgfx_channel)
 	{
 		(void)WTSVirtualChannelClose(priv->rdpgfx_channel);
@@ -1776,7 +1877,10 @@ void rdpgfx_server_context_free(RdpgfxServerContext* context)
 	rdpgfx_server_close(context);
 
 	if (context->priv)
+	{
 		Stream_Free(context->priv->input_stream, TRUE);
+		Stream_Free(context->priv->batch, TRUE);
+	}
 
 	free(context->priv);
 	free(context);
@@ -1791,6 +1895,45 @@ HANDLE rdpgfx_server_get_event_handle(RdpgfxServerContext* context)
 	return context->priv->channelEvent;
 }
 
+BOOL rdpgfx_server_begin_batch(RdpgfxServerContext* context)
+{
+	WINPR_ASSERT(context);
+
+	RdpgfxServerPrivate* priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	if (priv->batching)
+	{
+		WLog_Print(priv->log, WLOG_ERROR, "a batch is already active");
+		return FALSE;
+	}
+
+	if (!priv->batch)
+	{
+		priv->batch = Stream_New(NULL, 4096);
+		if (!priv->batch)
+			return FALSE;
+	}
+
+	Stream_SetPosition(priv->batch, 0);
+	priv->batching = TRUE;
+	return TRUE;
+}
+
+UINT rdpgfx_server_end_batch(RdpgfxServerContext* context)
+{
+	WINPR_ASSERT(context);
+
+	RdpgfxServerPrivate* priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	if (!priv->batching)
+		return CHANNEL_RC_OK;
+
+	priv->batching = FALSE;
+	return rdpgfx_server_batch_flush(context);
+}
+
 /*
  * Handle rpdgfx messages - server side
  *
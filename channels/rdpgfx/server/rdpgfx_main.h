@@ -33,10 +33,17 @@ struct s_rdpgfx_server_private
 	void* rdpgfx_channel;
 	DWORD SessionId;
 	wStream* input_stream;
+	wStream* batch; /* packet list collected between rdpgfx_server_begin/end_batch */
+	BOOL batching;
 	BOOL isOpened;
 	BOOL isReady;
 	wLog* log;
 	RDPGFX_CAPSET activeCapSet;
+	struct
+	{
+		UINT32 frameId;
+		UINT64 sent;
+	} pendingFrames[16];
 };
 
 #endif /* FREERDP_CHANNEL_RDPGFX_SERVER_MAIN_H */
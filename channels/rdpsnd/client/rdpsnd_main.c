@@ -51,6 +51,10 @@
 #include "rdpsnd_common.h"
 #include "rdpsnd_main.h"
 
+/* Default for the maximum playback speed change in percent used to keep the
+ * device queue close to the configured latency, see rdpsnd_time_stretch */
+#define RDPSND_DEFAULT_STRETCH_PERCENT 4
+
 struct rdpsnd_plugin
 {
 	IWTSPlugin iface;
@@ -89,6 +93,8 @@ struct rdpsnd_plugin
 	UINT64 wArrivalTime;
 
 	UINT32 latency;
+	UINT32 stretchPercent;
+	UINT32 deviceLatency;
 	BOOL isOpen;
 	AUDIO_FORMAT* fixed_format;
 
@@ -437,6 +443,7 @@ static BOOL rdpsnd_ensure_device_is_open(rdpsndPlugin* rdpsnd, UINT16 wFormatNo,
 		rdpsnd->wCurrentFormatNo = wFormatNo;
 		rdpsnd->startPlayTime = 0;
 		rdpsnd->totalPlaySize = 0;
+		rdpsnd->deviceLatency = 0;
 	}
 
 	return rdpsnd_apply_volume(rdpsnd);
@@ -596,6 +603,71 @@ static BOOL rdpsnd_detect_overrun(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* form
 	}
 }
 
+/* Jitter on the network lets the device queue grow on bursts and run dry
+ * on gaps. Instead of dropping samples or playing silence, speed playback up
+ * while the device reports more than 1.5 times the configured latency and slow
+ * it down below half of it. This is done by dropping or repeating single PCM
+ * frames evenly spread over the block, which is not audible for changes of a
+ * few percent.
+ *
+ * @return the data to play, either data or the buffer of out
+ */
+static const BYTE* rdpsnd_time_stretch(rdpsndPlugin* rdpsnd, const AUDIO_FORMAT* format,
+                                       const BYTE* data, size_t* size, wStream* out)
+{
+	WINPR_ASSERT(rdpsnd);
+	WINPR_ASSERT(format);
+	WINPR_ASSERT(size);
+
+	const UINT32 target = rdpsnd->latency;
+	const UINT32 current = rdpsnd->deviceLatency;
+
+	if ((target == 0) || (rdpsnd->stretchPercent == 0) || (current == 0) || !out)
+		return data;
+
+	const BOOL faster = current > target + target / 2;
+	const BOOL slower = current < target / 2;
+	if (!faster && !slower)
+		return data;
+
+	const size_t frameSize = 2ull * format->nChannels;
+	if (frameSize == 0)
+		return data;
+
+	const size_t frames = *size / frameSize;
+	const size_t delta = frames * rdpsnd->stretchPercent / 100;
+	if (delta == 0)
+		return data;
+
+	const size_t outFrames = faster ? frames - delta : frames + delta;
+	Stream_SetPosition(out, 0);
+	if (!Stream_EnsureCapacity(out, outFrames * frameSize))
+		return data;
+
+	const size_t step = frames / delta;
+	for (size_t x = 0; x < frames; x++)
+	{
+		const BYTE* frame = &data[x * frameSize];
+		const BOOL adjust = ((x % step) == step - 1) && (x / step < delta);
+
+		if (faster && adjust)
+			continue;
+
+		Stream_Write(out, frame, frameSize);
+		if (slower && adjust)
+			Stream_Write(out, frame, frameSize);
+	}
+
+	WLog_Print(rdpsnd->log, WLOG_TRACE,
+	           "%s device latency %" PRIu32 " ms, target %" PRIu32 " ms: %s %" PRIuz " frames",
+	           rdpsnd_is_dyn_str(rdpsnd->dynamic), current, target,
+	           faster ? "dropped" : "repeated", delta);
+
+	Stream_SealLength(out);
+	*size = Stream_Length(out);
+	return Stream_Buffer(out);
+}
+
 static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 {
 	AUDIO_FORMAT* format = NULL;
@@ -629,29 +701,41 @@ static UINT rdpsnd_treat_wave(rdpsndPlugin* rdpsnd, wStream* s, size_t size)
 	if (rdpsnd->device && rdpsnd->attached && !rdpsnd_detect_overrun(rdpsnd, format, size))
 	{
 		UINT status = CHANNEL_RC_OK;
+		BOOL isPcm = FALSE;
+		const BYTE* pcm = data;
+		size_t pcmSize = size;
 		wStream* pcmData = StreamPool_Take(rdpsnd->pool, 4096);
+		wStream* stretchData = NULL;
 
 		if (rdpsnd->device->FormatSupported(rdpsnd->device, format))
-		{
-			if (rdpsnd->device->PlayEx)
-				latency = rdpsnd->device->PlayEx(rdpsnd->device, format, data, size);
-			else
-				latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, data, size);
-		}
+			isPcm = (format->wFormatTag == WAVE_FORMAT_PCM) && (format->wBitsPerSample == 16);
 		else if (freerdp_dsp_decode(rdpsnd->dsp_context, format, data, size, pcmData))
 		{
 			Stream_SealLength(pcmData);
+			pcm = Stream_Buffer(pcmData);
+			pcmSize = Stream_Length(pcmData);
+			isPcm = TRUE;
+		}
+		else
+			status = ERROR_INTERNAL_ERROR;
+
+		if ((status == CHANNEL_RC_OK) && isPcm && (rdpsnd->latency > 0))
+		{
+			stretchData = StreamPool_Take(rdpsnd->pool, pcmSize + pcmSize / 8);
+			pcm = rdpsnd_time_stretch(rdpsnd, format, pcm, &pcmSize, stretchData);
+		}
 
+		if (status == CHANNEL_RC_OK)
+		{
 			if (rdpsnd->device->PlayEx)
-				latency = rdpsnd->device->PlayEx(rdpsnd->device, format, Stream_Buffer(pcmData),
-				                                 Stream_Length(pcmData));
+				latency = rdpsnd->device->PlayEx(rdpsnd->device, format, pcm, pcmSize);
 			else
-				latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device,
-				                       Stream_Buffer(pcmData), Stream_Length(pcmData));
+				latency = IFCALLRESULT(0, rdpsnd->device->Play, rdpsnd->device, pcm, pcmSize);
+			rdpsnd->deviceLatency = latency;
 		}
-		else
-			status = ERROR_INTERNAL_ERROR;
 
+		if (stretchData)
+			Stream_Release(stretchData);
 		Stream_Release(pcmData);
 
 		if (status != CHANNEL_RC_OK)
@@ -906,6 +990,8 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 		{ "rate", COMMAND_LINE_VALUE_REQUIRED, "<rate>", NULL, NULL, -1, NULL, "rate" },
 		{ "channel", COMMAND_LINE_VALUE_REQUIRED, "<channel>", NULL, NULL, -1, NULL, "channel" },
 		{ "latency", COMMAND_LINE_VALUE_REQUIRED, "<latency>", NULL, NULL, -1, NULL, "latency" },
+		{ "stretch", COMMAND_LINE_VALUE_REQUIRED, "<percent>", NULL, NULL, -1, NULL,
+		  "maximum playback speed change to keep the latency, 0 to disable" },
 		{ "quality", COMMAND_LINE_VALUE_REQUIRED, "<quality mode>", NULL, NULL, -1, NULL,
 		  "quality mode" },
 		{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
@@ -975,6 +1061,15 @@ static UINT rdpsnd_process_addin_args(rdpsndPlugin* rdpsnd, const ADDIN_ARGV* ar
 
 				rdpsnd->latency = (UINT32)val;
 			}
+			CommandLineSwitchCase(arg, "stretch")
+			{
+				unsigned long val = strtoul(arg->Value, NULL, 0);
+
+				if ((errno != 0) || (val > 50))
+					return CHANNEL_RC_INITIALIZATION_ERROR;
+
+				rdpsnd->stretchPercent = (UINT32)val;
+			}
 			CommandLineSwitchCase(arg, "quality")
 			{
 				long wQualityMode = DYNAMIC_QUALITY;
@@ -1050,6 +1145,7 @@ static UINT rdpsnd_process_connect(rdpsndPlugin* rdpsnd)
 	UINT status = ERROR_INTERNAL_ERROR;
 	WINPR_ASSERT(rdpsnd);
 	rdpsnd->latency = 0;
+	rdpsnd->stretchPercent = RDPSND_DEFAULT_STRETCH_PERCENT;
 	args = (const ADDIN_ARGV*)rdpsnd->channelEntryPoints.pExtendedData;
 
 	if (args)
@@ -344,6 +344,7 @@ static UINT rdpsnd_server_select_format(RdpsndServerContext* context, UINT16 cli
 {
 	size_t bs = 0;
 	size_t out_buffer_size = 0;
+	UINT32 opusFrameDuration = 0;
 	AUDIO_FORMAT* format = NULL;
 	UINT error = CHANNEL_RC_OK;
 
@@ -360,6 +361,7 @@ static UINT rdpsnd_server_select_format(RdpsndServerContext* context, UINT16 cli
 	context->priv->src_bytes_per_sample = context->src_format->wBitsPerSample / 8;
 	context->priv->src_bytes_per_frame =
 	    context->priv->src_bytes_per_sample * context->src_format->nChannels;
+	context->priv->out_frame_align = 1;
 	context->selected_client_format = client_format_index;
 	format = &context->client_formats[client_format_index];
 
@@ -397,10 +399,33 @@ static UINT rdpsnd_server_select_format(RdpsndServerContext* context, UINT16 cli
 				context->priv->out_frames = bs;
 
 			break;
+
+		case WAVE_FORMAT_OPUS:
+			/* Low latency mode, send a fixed number of frames per PDU */
+			if (context->opusFrameDuration > 0)
+			{
+				opusFrameDuration = context->opusFrameDuration;
+				const UINT32 count = MIN(MAX(context->opusFramesPerPacket, 1),
+				                         RDPSND_OPUS_MAX_PACKET_DURATION / opusFrameDuration);
+				bs = 1ull * context->src_format->nSamplesPerSec * opusFrameDuration / 1000;
+				context->priv->out_frames = MAX(bs, 1) * count;
+				context->priv->out_frame_align = MAX(bs, 1);
+			}
+			break;
+
 		default:
 			break;
 	}
 
+	if (!freerdp_dsp_context_set_opus_framing(
+	        context->priv->dsp_context, opusFrameDuration, context->opusInbandFEC,
+	        context->opusInbandFEC ? RDPSND_OPUS_FEC_PACKET_LOSS : 0))
+	{
+		WLog_ERR(TAG, "invalid opus frame duration %" PRIu32 "ms", opusFrameDuration);
+		error = ERROR_INVALID_PARAMETER;
+		goto out;
+	}
+
 	context->priv->out_pending_frames = 0;
 	out_buffer_size = context->priv->out_frames * context->priv->src_bytes_per_frame;
 
@@ -473,13 +498,18 @@ static UINT rdpsnd_server_training(RdpsndServerContext* context, UINT16 timestam
 	return status ? CHANNEL_RC_OK : ERROR_INTERNAL_ERROR;
 }
 
-static BOOL rdpsnd_server_align_wave_pdu(wStream* s, UINT32 alignment)
+static BOOL rdpsnd_server_align_wave_pdu(wStream* s, const AUDIO_FORMAT* format)
 {
 	size_t size = 0;
+	const UINT32 alignment = format->nBlockAlign;
 	Stream_SealLength(s);
 	size = Stream_Length(s);
 
-	if ((size % alignment) != 0)
+	/* Opus packets derive the frame length from the packet size, padding would corrupt them */
+	if (format->wFormatTag == WAVE_FORMAT_OPUS)
+		return TRUE;
+
+	if ((alignment != 0) && ((size % alignment) != 0))
 	{
 		size_t offset = alignment - size % alignment;
 
@@ -533,8 +563,12 @@ static UINT rdpsnd_server_send_wave_pdu(RdpsndServerContext* context, UINT16 wTi
 	if (!freerdp_dsp_encode(context->priv->dsp_context, context->src_format, src, length, s))
 		return ERROR_INTERNAL_ERROR;
 
+	/* The encoder buffered everything, nothing to send yet */
+	if (Stream_GetPosition(s) == start)
+		goto out;
+
 	/* Set stream size */
-	if (!rdpsnd_server_align_wave_pdu(s, format->nBlockAlign))
+	if (!rdpsnd_server_align_wave_pdu(s, format))
 		return ERROR_INTERNAL_ERROR;
 
 	const size_t end = Stream_GetPosition(s);
@@ -626,14 +660,19 @@ static UINT rdpsnd_server_send_wave2_pdu(RdpsndServerContext* context, UINT16 fo
 	{
 		AUDIO_FORMAT* format = NULL;
 
+		const size_t start = Stream_GetPosition(s);
 		if (!freerdp_dsp_encode(context->priv->dsp_context, context->src_format, data, size, s))
 		{
 			error = ERROR_INTERNAL_ERROR;
 			goto out;
 		}
 
+		/* The encoder buffered everything, nothing to send yet */
+		if (Stream_GetPosition(s) == start)
+			goto out;
+
 		format = &context->client_formats[formatNo];
-		if (!rdpsnd_server_align_wave_pdu(s, format->nBlockAlign))
+		if (!rdpsnd_server_align_wave_pdu(s, format))
 		{
 			error = ERROR_INTERNAL_ERROR;
 			goto out;
@@ -680,6 +719,18 @@ static UINT rdpsnd_server_send_audio_pdu(RdpsndServerContext* context, UINT16 wT
 	if (context->selected_client_format >= context->num_client_formats)
 		return ERROR_INTERNAL_ERROR;
 
+	/* Fixed frame size encoders need the last partial frame padded with silence */
+	const size_t align = context->priv->out_frame_align;
+	if ((align > 1) && (context->priv->out_pending_frames % align) != 0)
+	{
+		const size_t pad = align - context->priv->out_pending_frames % align;
+		WINPR_ASSERT(context->priv->out_pending_frames + pad <= context->priv->out_frames);
+		ZeroMemory(context->priv->out_buffer +
+		               context->priv->out_pending_frames * context->priv->src_bytes_per_frame,
+		           pad * context->priv->src_bytes_per_frame);
+		context->priv->out_pending_frames += pad;
+	}
+
 	src = context->priv->out_buffer;
 	length = context->priv->out_pending_frames * context->priv->src_bytes_per_frame;
 
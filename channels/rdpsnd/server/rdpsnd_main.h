@@ -32,6 +32,11 @@
 
 #define TAG CHANNELS_TAG("rdpsnd.server")
 
+/* Longest packet an Opus decoder accepts, in ms */
+#define RDPSND_OPUS_MAX_PACKET_DURATION 120
+/* Packet loss in percent the Opus FEC is tuned for */
+#define RDPSND_OPUS_FEC_PACKET_LOSS 10
+
 struct s_rdpsnd_server_private
 {
 	BOOL ownThread;
@@ -50,6 +55,7 @@ struct s_rdpsnd_server_private
 	size_t out_buffer_size;
 	size_t out_frames;
 	size_t out_pending_frames;
+	size_t out_frame_align;
 	UINT32 src_bytes_per_sample;
 	UINT32 src_bytes_per_frame;
 	FREERDP_DSP_CONTEXT* dsp_context;
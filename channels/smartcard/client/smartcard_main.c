@@ -189,7 +189,7 @@ static void* smartcard_context_new(void* smartcard, SCARDCONTEXT hContext)
 
 	pContext->smartcard = smartcard;
 	pContext->hContext = hContext;
-	pContext->IrpQueue = MessageQueue_New(NULL);
+	pContext->IrpQueue = MessageQueue_NewEx(NULL, WMQ_FLAG_SINGLE_CONSUMER);
 
 	if (!pContext->IrpQueue)
 	{
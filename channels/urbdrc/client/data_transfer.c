@@ -851,7 +851,7 @@ static void urb_isoch_transfer_cb(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 		const UINT32 FunctionId = (OutputBufferSize == 0) ? URB_COMPLETION_NO_DATA : URB_COMPLETION;
 		if (!write_shared_message_header_with_functionid(out, InterfaceId, MessageId, FunctionId))
 		{
-			Stream_Free(out, TRUE);
+			Stream_Release(out);
 			return;
 		}
 
@@ -860,7 +860,7 @@ static void urb_isoch_transfer_cb(WINPR_ATTR_UNUSED IUDEVICE* pdev,
 		if (!write_urb_result_header(out, WINPR_ASSERTING_INT_CAST(uint16_t, 20 + packetSize),
 		                             status))
 		{
-			Stream_Free(out, TRUE);
+			Stream_Release(out);
 			return;
 		}
 
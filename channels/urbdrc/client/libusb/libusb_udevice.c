@@ -24,6 +24,7 @@
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/endian.h>
 #include <winpr/wtypes.h>
 #include <winpr/sysinfo.h>
 #include <winpr/collections.h>
@@ -66,6 +67,13 @@
 #define HAVE_STREAM_ID_API 1
 #endif
 
+/* Isochronous transfers are allocated with room for ISO_TRANSFER_POOL_PACKETS
+ * packets and recycled through UDEVICE::iso_transfers once completed. URBs with
+ * more packets get a transfer of their own. */
+#define ISO_TRANSFER_POOL_PACKETS 128
+#define ISO_TRANSFER_POOL_SIZE 32
+#define ISO_BUFFER_POOL_DEFAULT_SIZE 4096
+
 typedef struct
 {
 	wStream* data;
@@ -78,6 +86,7 @@ typedef struct
 	GENERIC_CHANNEL_CALLBACK* callback;
 	t_isoch_transfer_cb cb;
 	wArrayList* queue;
+	BOOL pooled;
 #if !defined(HAVE_STREAM_ID_API)
 	UINT32 streamID;
 #endif
@@ -202,11 +211,11 @@ const char* usb_interface_class_to_string(uint8_t class)
 	}
 }
 
-static ASYNC_TRANSFER_USER_DATA* async_transfer_user_data_new(IUDEVICE* idev, UINT32 MessageId,
-                                                              size_t offset, size_t BufferSize,
-                                                              const BYTE* data, size_t packetSize,
-                                                              BOOL NoAck, t_isoch_transfer_cb cb,
-                                                              GENERIC_CHANNEL_CALLBACK* callback)
+static ASYNC_TRANSFER_USER_DATA*
+async_transfer_user_data_new(IUDEVICE* idev, UINT32 MessageId, size_t offset, size_t BufferSize,
+                             const BYTE* data, size_t packetSize, BOOL NoAck,
+                             t_isoch_transfer_cb cb, GENERIC_CHANNEL_CALLBACK* callback,
+                             wStreamPool* pool)
 {
 	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
 	UDEVICE* pdev = (UDEVICE*)idev;
@@ -218,7 +227,10 @@ static ASYNC_TRANSFER_USER_DATA* async_transfer_user_data_new(IUDEVICE* idev, UI
 	if (!user_data)
 		return NULL;
 
-	user_data->data = Stream_New(NULL, offset + BufferSize + packetSize);
+	if (pool)
+		user_data->data = StreamPool_Take(pool, offset + BufferSize + packetSize);
+	else
+		user_data->data = Stream_New(NULL, offset + BufferSize + packetSize);
 
 	if (!user_data->data)
 	{
@@ -247,7 +259,8 @@ static void async_transfer_user_data_free(ASYNC_TRANSFER_USER_DATA* user_data)
 {
 	if (user_data)
 	{
-		Stream_Free(user_data->data, TRUE);
+		if (user_data->data)
+			Stream_Release(user_data->data);
 		free(user_data);
 	}
 }
@@ -257,6 +270,16 @@ static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
 	ASYNC_TRANSFER_USER_DATA* user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
 	const UINT32 streamID = stream_id_from_buffer(transfer);
 	wArrayList* list = user_data->queue;
+	wStream* out = NULL;
+	IUDEVICE* idev = user_data->idev;
+	GENERIC_CHANNEL_CALLBACK* callback = user_data->callback;
+	t_isoch_transfer_cb cb = user_data->cb;
+	const BOOL noack = user_data->noack;
+	const UINT32 MessageId = user_data->MessageId;
+	const UINT32 StartFrame = user_data->StartFrame;
+	const UINT32 OutputBufferSize = user_data->OutputBufferSize;
+	const UINT32 NumberOfPackets = WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets);
+	const int status = transfer->status;
 
 	ArrayList_Lock(list);
 	switch (transfer->status)
@@ -264,12 +287,12 @@ static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
 		case LIBUSB_TRANSFER_COMPLETED:
 		{
 			UINT32 index = 0;
+			size_t packetOffset = 0;
 			BYTE* dataStart = Stream_Pointer(user_data->data);
 			Stream_SetPosition(user_data->data,
 			                   40); /* TS_URB_ISOCH_TRANSFER_RESULT IsoPacket offset */
 
-			for (uint32_t i = 0; i < WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets);
-			     i++)
+			for (uint32_t i = 0; i < NumberOfPackets; i++)
 			{
 				const UINT32 act_len = transfer->iso_packet_desc[i].actual_length;
 				Stream_Write_UINT32(user_data->data, index);
@@ -280,8 +303,9 @@ static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
 					user_data->ErrorCount++;
 				else
 				{
-					const unsigned char* packetBuffer =
-					    libusb_get_iso_packet_buffer_simple(transfer, i);
+					/* Packet lengths may differ, so libusb_get_iso_packet_buffer_simple
+					 * can not be used here. */
+					const unsigned char* packetBuffer = transfer->buffer + packetOffset;
 					BYTE* data = dataStart + index;
 
 					if (data != packetBuffer)
@@ -289,6 +313,7 @@ static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
 
 					index += act_len;
 				}
+				packetOffset += transfer->iso_packet_desc[i].length;
 			}
 		}
 			/* fallthrough */
@@ -301,22 +326,32 @@ static void LIBUSB_CALL func_iso_callback(struct libusb_transfer* transfer)
 			WINPR_FALLTHROUGH
 		case LIBUSB_TRANSFER_ERROR:
 		{
-			const UINT32 InterfaceId =
-			    ((STREAM_ID_PROXY << 30) | user_data->idev->get_ReqCompletion(user_data->idev));
-
 			if (list_contains(list, streamID))
 			{
-				if (!user_data->noack)
+				const UINT32 ErrorCount = user_data->ErrorCount;
+
+				if (!noack)
 				{
-					const UINT32 RequestID = streamID & INTERFACE_ID_MASK;
-					user_data->cb(user_data->idev, user_data->callback, user_data->data,
-					              InterfaceId, user_data->noack, user_data->MessageId, RequestID,
-					              WINPR_ASSERTING_INT_CAST(uint32_t, transfer->num_iso_packets),
-					              transfer->status, user_data->StartFrame, user_data->ErrorCount,
-					              user_data->OutputBufferSize);
+					out = user_data->data;
 					user_data->data = NULL;
 				}
+
+				/* Returns the transfer and its buffer to the pools, user_data is gone after this */
 				ArrayList_Remove(list, transfer);
+				ArrayList_Unlock(list);
+
+				/* Send the completion without holding the request queue, so new
+				 * URBs for this device can be submitted in the meantime. */
+				if (out)
+				{
+					const UINT32 InterfaceId =
+					    ((STREAM_ID_PROXY << 30) | idev->get_ReqCompletion(idev));
+					const UINT32 RequestID = streamID & INTERFACE_ID_MASK;
+					cb(idev, callback, out, InterfaceId, noack, MessageId, RequestID,
+					   NumberOfPackets, WINPR_ASSERTING_INT_CAST(uint32_t, status), StartFrame,
+					   ErrorCount, OutputBufferSize);
+				}
+				return;
 			}
 		}
 		break;
@@ -1221,16 +1256,65 @@ static int libusb_udev_query_device_port_status(IUDEVICE* idev, UINT32* UsbdStat
 	return success;
 }
 
+static struct libusb_transfer* iso_transfer_take(UDEVICE* pdev, UINT32 NumberOfPackets,
+                                                 BOOL* pooled)
+{
+	struct libusb_transfer* transfer = NULL;
+
+	WINPR_ASSERT(pdev);
+	WINPR_ASSERT(pooled);
+
+	*pooled = FALSE;
+	if (NumberOfPackets > ISO_TRANSFER_POOL_PACKETS)
+		return libusb_alloc_transfer((int)NumberOfPackets);
+
+	*pooled = TRUE;
+	transfer = Queue_Dequeue(pdev->iso_transfers);
+	if (!transfer)
+		transfer = libusb_alloc_transfer(ISO_TRANSFER_POOL_PACKETS);
+	return transfer;
+}
+
+/* The server describes every packet by its offset into the transfer buffer
+ * (USBD_ISO_PACKET_DESCRIPTOR). Derive the packet lengths from these so that
+ * devices with varying packet sizes (e.g. audio at 44.1kHz) are served correctly.
+ * Fall back to equally sized packets if the offsets do not make sense. */
+static void iso_transfer_set_packet_lengths(struct libusb_transfer* transfer,
+                                            const BYTE* packetDescriptorData,
+                                            UINT32 NumberOfPackets, UINT32 BufferSize)
+{
+	BOOL valid = packetDescriptorData != NULL;
+
+	if (valid)
+		valid = winpr_Data_Get_UINT32(packetDescriptorData) == 0;
+
+	for (UINT32 i = 0; valid && (i < NumberOfPackets); i++)
+	{
+		const UINT32 offset = winpr_Data_Get_UINT32(&packetDescriptorData[12ULL * i]);
+		const UINT32 next = (i + 1 < NumberOfPackets)
+		                        ? winpr_Data_Get_UINT32(&packetDescriptorData[12ULL * (i + 1)])
+		                        : BufferSize;
+
+		if ((offset > next) || (next > BufferSize))
+			valid = FALSE;
+		else
+			transfer->iso_packet_desc[i].length = next - offset;
+	}
+
+	if (!valid)
+		libusb_set_iso_packet_lengths(transfer, BufferSize / NumberOfPackets);
+}
+
 static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK* callback,
                                       UINT32 MessageId, UINT32 RequestId, UINT32 EndpointAddress,
                                       WINPR_ATTR_UNUSED UINT32 TransferFlags, UINT32 StartFrame,
                                       UINT32 ErrorCount, BOOL NoAck,
-                                      WINPR_ATTR_UNUSED const BYTE* packetDescriptorData,
-                                      UINT32 NumberOfPackets, UINT32 BufferSize, const BYTE* Buffer,
+                                      const BYTE* packetDescriptorData, UINT32 NumberOfPackets,
+                                      UINT32 BufferSize, const BYTE* Buffer,
                                       t_isoch_transfer_cb cb, UINT32 Timeout)
 {
 	int rc = 0;
-	UINT32 iso_packet_size = 0;
+	BOOL pooled = FALSE;
 	UDEVICE* pdev = (UDEVICE*)idev;
 	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
 	struct libusb_transfer* iso_transfer = NULL;
@@ -1243,7 +1327,8 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 
 	urbdrc = pdev->urbdrc;
 	user_data = async_transfer_user_data_new(idev, MessageId, 48, BufferSize, Buffer,
-	                                         outSize + 1024, NoAck, cb, callback);
+	                                         outSize + 1024, NoAck, cb, callback,
+	                                         pdev->iso_buffers);
 
 	if (!user_data)
 		return -1;
@@ -1255,10 +1340,7 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 		Stream_Seek(user_data->data, (12ULL * NumberOfPackets));
 
 	if (NumberOfPackets > 0)
-	{
-		iso_packet_size = BufferSize / NumberOfPackets;
-		iso_transfer = libusb_alloc_transfer((int)NumberOfPackets);
-	}
+		iso_transfer = iso_transfer_take(pdev, NumberOfPackets, &pooled);
 
 	if (iso_transfer == NULL)
 	{
@@ -1269,6 +1351,7 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 		async_transfer_user_data_free(user_data);
 		return -1;
 	}
+	user_data->pooled = pooled;
 
 	/**  process URB_FUNCTION_IOSCH_TRANSFER */
 	libusb_fill_iso_transfer(
@@ -1276,7 +1359,8 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 	    Stream_Pointer(user_data->data), WINPR_ASSERTING_INT_CAST(int, BufferSize),
 	    WINPR_ASSERTING_INT_CAST(int, NumberOfPackets), func_iso_callback, user_data, Timeout);
 	set_stream_id_for_buffer(iso_transfer, streamID);
-	libusb_set_iso_packet_lengths(iso_transfer, iso_packet_size);
+	iso_transfer_set_packet_lengths(iso_transfer, packetDescriptorData, NumberOfPackets,
+	                                BufferSize);
 
 	if (!ArrayList_Append(pdev->request_queue, iso_transfer))
 	{
@@ -1288,7 +1372,10 @@ static int libusb_udev_isoch_transfer(IUDEVICE* idev, GENERIC_CHANNEL_CALLBACK*
 	}
 	rc = libusb_submit_transfer(iso_transfer);
 	if (log_libusb_result(urbdrc->log, WLOG_ERROR, "libusb_submit_transfer", rc))
+	{
+		ArrayList_Remove(pdev->request_queue, iso_transfer);
 		return -1;
+	}
 	return rc;
 }
 
@@ -1343,7 +1430,8 @@ static int libusb_udev_bulk_or_interrupt_transfer(IUDEVICE* idev,
 
 	urbdrc = pdev->urbdrc;
 	user_data =
-	    async_transfer_user_data_new(idev, MessageId, 36, BufferSize, data, 0, NoAck, cb, callback);
+	    async_transfer_user_data_new(idev, MessageId, 36, BufferSize, data, 0, NoAck, cb, callback,
+	                                 NULL);
 
 	if (!user_data)
 		return -1;
@@ -1540,6 +1628,8 @@ static void udev_free(IUDEVICE* idev)
 	/* release all interface and  attach kernel driver */
 	udev->iface.attach_kernel_driver(idev);
 	ArrayList_Free(udev->request_queue);
+	Queue_Free(udev->iso_transfers);
+	StreamPool_Free(udev->iso_buffers);
 	/* free the config descriptor that send from windows */
 	msusb_msconfig_free(udev->MsConfig);
 	libusb_unref_device(udev->libusb_dev);
@@ -1686,6 +1776,11 @@ static int udev_get_hub_handle(URBDRC_PLUGIN* urbdrc, libusb_context* ctx, UDEVI
 	return 0;
 }
 
+static void transfer_free(void* value)
+{
+	libusb_free_transfer((struct libusb_transfer*)value);
+}
+
 static void request_free(void* value)
 {
 	ASYNC_TRANSFER_USER_DATA* user_data = NULL;
@@ -1694,6 +1789,19 @@ static void request_free(void* value)
 		return;
 
 	user_data = (ASYNC_TRANSFER_USER_DATA*)transfer->user_data;
+	if (user_data && user_data->pooled)
+	{
+		UDEVICE* pdev = (UDEVICE*)user_data->idev;
+
+		async_transfer_user_data_free(user_data);
+		transfer->user_data = NULL;
+		if (pdev->iso_transfers && (Queue_Count(pdev->iso_transfers) < ISO_TRANSFER_POOL_SIZE) &&
+		    Queue_Enqueue(pdev->iso_transfers, transfer))
+			return;
+		libusb_free_transfer(transfer);
+		return;
+	}
+
 	async_transfer_user_data_free(user_data);
 	transfer->user_data = NULL;
 	libusb_free_transfer(transfer);
@@ -1804,6 +1912,15 @@ static IUDEVICE* udev_init(URBDRC_PLUGIN* urbdrc, libusb_context* context, LIBUS
 
 	ArrayList_Object(pdev->request_queue)->fnObjectFree = request_free;
 
+	pdev->iso_transfers = Queue_New(TRUE, ISO_TRANSFER_POOL_SIZE, 0);
+	if (!pdev->iso_transfers)
+		goto fail;
+	Queue_Object(pdev->iso_transfers)->fnObjectFree = transfer_free;
+
+	pdev->iso_buffers = StreamPool_New(TRUE, ISO_BUFFER_POOL_DEFAULT_SIZE);
+	if (!pdev->iso_buffers)
+		goto fail;
+
 	/* set config of windows */
 	pdev->MsConfig = msusb_msconfig_new();
 
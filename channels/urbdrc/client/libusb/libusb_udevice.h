@@ -22,6 +22,8 @@
 #define FREERDP_CHANNEL_URBDRC_CLIENT_LIBUSB_UDEVICE_H
 
 #include <winpr/windows.h>
+#include <winpr/collections.h>
+#include <winpr/stream.h>
 #include <libusb.h>
 
 #include "urbdrc_types.h"
@@ -63,6 +65,8 @@ typedef struct
 	LIBUSB_CONFIG_DESCRIPTOR* LibusbConfig;
 
 	wArrayList* request_queue;
+	wStreamPool* iso_buffers;
+	wQueue* iso_transfers;
 
 	URBDRC_PLUGIN* urbdrc;
 } UDEVICE;
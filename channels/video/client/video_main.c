@@ -81,16 +81,18 @@ typedef struct
 	UINT64 lastPublishTime, nextPublishTime;
 	volatile LONG refCounter;
 	VideoSurface* surface;
+	BOOL hwFrames; /* decoded frames stay in GPU memory and go to showHwFrame */
 } PresentationContext;
 
+/* A sample waiting for its publish time, it is decoded only then so the decoder writes
+ * straight to the surface (or keeps the frame on the GPU) instead of to a staging copy */
 typedef struct
 {
 	UINT64 publishTime;
 	UINT64 hnsDuration;
 	MAPPED_GEOMETRY* geometry;
-	UINT32 w, h;
-	UINT32 scanline;
-	BYTE* surfaceData;
+	BYTE* sample;
+	size_t sampleLength;
 	PresentationContext* presentation;
 } VideoFrame;
 
@@ -101,6 +103,7 @@ struct s_VideoClientContextPriv
 	GeometryClientContext* geometry;
 	wQueue* frames;
 	CRITICAL_SECTION framesLock;
+	CRITICAL_SECTION decodeLock;
 	wBufferPool* surfacePool;
 	UINT32 publishedFrames;
 	UINT32 droppedFrames;
@@ -163,6 +166,12 @@ static VideoClientContextPriv* VideoClientContextPriv_new(VideoClientContext* vi
 		goto fail;
 	}
 
+	if (!InitializeCriticalSectionAndSpinCount(&ret->decodeLock, 4 * 1000))
+	{
+		WLog_ERR(TAG, "unable to initialize decode lock");
+		goto fail;
+	}
+
 	ret->video = video;
 
 	/* don't set to unlimited so that we have the chance to send a feedback in
@@ -208,6 +217,15 @@ static PresentationContext* PresentationContext_new(VideoClientContext* video, B
 		WLog_ERR(TAG, "unable to create a h264 context");
 		goto fail;
 	}
+
+	/* a client that presents GPU frames itself spares the download and the composition */
+	if (video->showHwFrame)
+	{
+		if (!h264_context_set_option(ret->h264, H264_CONTEXT_OPTION_HW_FRAMES, TRUE))
+			goto fail;
+		ret->hwFrames = TRUE;
+	}
+
 	if (!h264_context_reset(ret->h264, width, height))
 		goto fail;
 
@@ -276,48 +294,50 @@ static void VideoFrame_free(VideoFrame** pframe)
 
 	mappedGeometryUnref(frame->geometry);
 
-	WINPR_ASSERT(frame->presentation);
-	WINPR_ASSERT(frame->presentation->video);
-	WINPR_ASSERT(frame->presentation->video->priv);
-	BufferPool_Return(frame->presentation->video->priv->surfacePool, frame->surfaceData);
-	PresentationContext_unref(&frame->presentation);
+	if (frame->presentation)
+	{
+		WINPR_ASSERT(frame->presentation->video);
+		WINPR_ASSERT(frame->presentation->video->priv);
+		BufferPool_Return(frame->presentation->video->priv->surfacePool, frame->sample);
+		PresentationContext_unref(&frame->presentation);
+	}
 	free(frame);
 	*pframe = NULL;
 }
 
 static VideoFrame* VideoFrame_new(VideoClientContextPriv* priv, PresentationContext* presentation,
-                                  MAPPED_GEOMETRY* geom)
+                                  MAPPED_GEOMETRY* geom, wStream* sample)
 {
 	VideoFrame* frame = NULL;
-	const VideoSurface* surface = NULL;
 
 	WINPR_ASSERT(priv);
 	WINPR_ASSERT(presentation);
-	WINPR_ASSERT(geom);
+	WINPR_ASSERT(sample);
 
-	surface = presentation->surface;
-	WINPR_ASSERT(surface);
+	const size_t length = Stream_Length(sample);
+	if ((length == 0) || (length > UINT32_MAX))
+		return NULL;
 
 	frame = calloc(1, sizeof(VideoFrame));
 	if (!frame)
 		goto fail;
 
-	mappedGeometryRef(geom);
+	if (geom)
+		mappedGeometryRef(geom);
 
 	frame->publishTime = presentation->lastPublishTime;
 	frame->geometry = geom;
-	frame->w = surface->alignedWidth;
-	frame->h = surface->alignedHeight;
-	frame->scanline = surface->scanline;
 
-	frame->surfaceData = BufferPool_Take(priv->surfacePool, 1ll * frame->scanline * frame->h);
-	if (!frame->surfaceData)
+	if (!PresentationContext_ref(presentation))
 		goto fail;
-
 	frame->presentation = presentation;
-	if (!PresentationContext_ref(frame->presentation))
+
+	frame->sample = BufferPool_Take(priv->surfacePool, WINPR_ASSERTING_INT_CAST(SSIZE_T, length));
+	if (!frame->sample)
 		goto fail;
 
+	memcpy(frame->sample, Stream_Buffer(sample), length);
+	frame->sampleLength = length;
 	return frame;
 
 fail:
@@ -346,6 +366,7 @@ void VideoClientContextPriv_free(VideoClientContextPriv* priv)
 	LeaveCriticalSection(&priv->framesLock);
 
 	DeleteCriticalSection(&priv->framesLock);
+	DeleteCriticalSection(&priv->decodeLock);
 
 	if (priv->currentPresentation)
 		PresentationContext_unref(&priv->currentPresentation);
@@ -677,54 +698,125 @@ static UINT video_control_send_client_notification(VideoClientContext* context,
 	return ret;
 }
 
-static void video_timer(VideoClientContext* video, UINT64 now)
+/* Decodes the frame to the surface, or leaves it in GPU memory for showHwFrame */
+static BOOL video_frame_decode(VideoFrame* frame)
 {
-	PresentationContext* presentation = NULL;
-	VideoClientContextPriv* priv = NULL;
-	VideoFrame* peekFrame = NULL;
-	VideoFrame* frame = NULL;
+	WINPR_ASSERT(frame);
+
+	PresentationContext* presentation = frame->presentation;
+	WINPR_ASSERT(presentation);
 
+	VideoSurface* surface = presentation->surface;
+	WINPR_ASSERT(surface);
+
+	const RECTANGLE_16 rect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, surface->alignedWidth),
+		                        WINPR_ASSERTING_INT_CAST(UINT16, surface->alignedHeight) };
+	const INT32 status =
+	    avc420_decompress(presentation->h264, frame->sample, (UINT32)frame->sampleLength,
+	                      surface->data, surface->format, surface->scanline, surface->alignedWidth,
+	                      surface->alignedHeight, &rect, 1);
+	return status >= 0;
+}
+
+static void video_frame_show(VideoClientContext* video, VideoFrame* frame)
+{
 	WINPR_ASSERT(video);
+	WINPR_ASSERT(frame);
 
-	priv = video->priv;
+	PresentationContext* presentation = frame->presentation;
+	WINPR_ASSERT(presentation);
+
+	if (presentation->hwFrames)
+	{
+		H264_DMABUF_FRAME hwFrame = { 0 };
+
+		/* without a hardware decoder the frame is in the surface as usual */
+		if (h264_context_get_dmabuf(presentation->h264, &hwFrame))
+		{
+			WINPR_ASSERT(video->showHwFrame);
+			if (video->showHwFrame(video, presentation->surface, &hwFrame,
+			                       presentation->ScaledWidth, presentation->ScaledHeight))
+				return;
+
+			/* this frame is lost, the following ones are decoded to the surface again */
+			WLog_WARN(TAG, "client can not show hardware frames, decoding to the surface");
+			presentation->hwFrames = FALSE;
+			(void)h264_context_set_option(presentation->h264, H264_CONTEXT_OPTION_HW_FRAMES,
+			                              FALSE);
+			return;
+		}
+	}
+
+	WINPR_ASSERT(video->showSurface);
+	video->showSurface(video, presentation->surface, presentation->ScaledWidth,
+	                   presentation->ScaledHeight);
+}
+
+/* Decodes the frames that are due (all queued ones if \b all is set) in order, later frames
+ * reference them, and shows the last one. */
+static void video_present(VideoClientContext* video, UINT64 now, BOOL all)
+{
+	WINPR_ASSERT(video);
+
+	VideoClientContextPriv* priv = video->priv;
 	WINPR_ASSERT(priv);
 
-	EnterCriticalSection(&priv->framesLock);
-	do
+	VideoFrame* frame = NULL;
+	size_t dropped = 0;
+
+	EnterCriticalSection(&priv->decodeLock);
+	for (;;)
 	{
-		peekFrame = (VideoFrame*)Queue_Peek(priv->frames);
-		if (!peekFrame)
-			break;
+		EnterCriticalSection(&priv->framesLock);
+		VideoFrame* peekFrame = (VideoFrame*)Queue_Peek(priv->frames);
+		if (peekFrame && (all || (peekFrame->publishTime <= now)))
+			Queue_Dequeue(priv->frames);
+		else
+			peekFrame = NULL;
+		LeaveCriticalSection(&priv->framesLock);
 
-		if (peekFrame->publishTime > now)
+		if (!peekFrame)
 			break;
 
 		if (frame)
 		{
 			WLog_DBG(TAG, "dropping frame @%" PRIu64, frame->publishTime);
 			priv->droppedFrames++;
+			dropped++;
 			VideoFrame_free(&frame);
 		}
+
+		if (!video_frame_decode(peekFrame))
+		{
+			VideoFrame_free(&peekFrame);
+			continue;
+		}
 		frame = peekFrame;
-		Queue_Dequeue(priv->frames);
-	} while (1);
-	LeaveCriticalSection(&priv->framesLock);
+	}
 
-	if (!frame)
-		goto treat_feedback;
+	if (frame)
+	{
+		if (dropped)
+			WLog_DBG(TAG, "showing frame (%" PRIuz " dropped)", dropped);
 
-	presentation = frame->presentation;
+		priv->publishedFrames++;
+		video_frame_show(video, frame);
+		VideoFrame_free(&frame);
+	}
+	LeaveCriticalSection(&priv->decodeLock);
+}
 
-	priv->publishedFrames++;
-	memcpy(presentation->surface->data, frame->surfaceData, 1ull * frame->scanline * frame->h);
+static void video_timer(VideoClientContext* video, UINT64 now)
+{
+	VideoClientContextPriv* priv = NULL;
 
-	WINPR_ASSERT(video->showSurface);
-	video->showSurface(video, presentation->surface, presentation->ScaledWidth,
-	                   presentation->ScaledHeight);
+	WINPR_ASSERT(video);
 
-	VideoFrame_free(&frame);
+	priv = video->priv;
+	WINPR_ASSERT(priv);
+
+	video_present(video, now, FALSE);
 
-treat_feedback:
 	if (priv->nextFeedbackTime < now)
 	{
 		/* we can compute some feedback only if we have some published frames and
@@ -811,7 +903,6 @@ static UINT video_VideoData(VideoClientContext* context, const TSMM_VIDEO_DATA*
 {
 	VideoClientContextPriv* priv = NULL;
 	PresentationContext* presentation = NULL;
-	int status = 0;
 
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(data);
@@ -843,102 +934,44 @@ static UINT video_VideoData(VideoClientContext* context, const TSMM_VIDEO_DATA*
 
 	if (data->CurrentPacketIndex == data->PacketsInSample)
 	{
-		VideoSurface* surface = presentation->surface;
-		H264_CONTEXT* h264 = presentation->h264;
-		UINT64 startTime = GetTickCount64();
-		UINT64 timeAfterH264 = 0;
-		MAPPED_GEOMETRY* geom = presentation->geometry;
-
-		const RECTANGLE_16 rect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, surface->alignedWidth),
-			                        WINPR_ASSERTING_INT_CAST(UINT16, surface->alignedHeight) };
+		const UINT64 now = GetTickCount64();
+
 		Stream_SealLength(presentation->currentSample);
 		Stream_SetPosition(presentation->currentSample, 0);
 
-		timeAfterH264 = GetTickCount64();
 		if (data->SampleNumber == 1)
 		{
-			presentation->lastPublishTime = startTime;
+			presentation->lastPublishTime = now;
 		}
 
 		presentation->lastPublishTime += (data->hnsDuration / 10000);
-		if (presentation->lastPublishTime <= timeAfterH264 + 10)
-		{
-			int dropped = 0;
-
-			const size_t len = Stream_Length(presentation->currentSample);
-			if (len > UINT32_MAX)
-				return CHANNEL_RC_OK;
 
-			/* if the frame is to be published in less than 10 ms, let's consider it's now */
-			status =
-			    avc420_decompress(h264, Stream_Pointer(presentation->currentSample), (UINT32)len,
-			                      surface->data, surface->format, surface->scanline,
-			                      surface->alignedWidth, surface->alignedHeight, &rect, 1);
-
-			if (status < 0)
-				return CHANNEL_RC_OK;
-
-			WINPR_ASSERT(context->showSurface);
-			context->showSurface(context, presentation->surface, presentation->ScaledWidth,
-			                     presentation->ScaledHeight);
-
-			priv->publishedFrames++;
-
-			/* cleanup previously scheduled frames */
-			EnterCriticalSection(&priv->framesLock);
-			while (Queue_Count(priv->frames) > 0)
-			{
-				VideoFrame* frame = Queue_Dequeue(priv->frames);
-				if (frame)
-				{
-					priv->droppedFrames++;
-					VideoFrame_free(&frame);
-					dropped++;
-				}
-			}
-			LeaveCriticalSection(&priv->framesLock);
-
-			if (dropped)
-				WLog_DBG(TAG, "showing frame (%d dropped)", dropped);
-		}
-		else
+		VideoFrame* frame = VideoFrame_new(priv, presentation, presentation->geometry,
+		                                   presentation->currentSample);
+		if (!frame)
 		{
-			const size_t len = Stream_Length(presentation->currentSample);
-			if (len > UINT32_MAX)
-				return CHANNEL_RC_OK;
-
-			BOOL enqueueResult = 0;
-			VideoFrame* frame = VideoFrame_new(priv, presentation, geom);
-			if (!frame)
-			{
-				WLog_ERR(TAG, "unable to create frame");
-				return CHANNEL_RC_NO_MEMORY;
-			}
-
-			status =
-			    avc420_decompress(h264, Stream_Pointer(presentation->currentSample), (UINT32)len,
-			                      frame->surfaceData, surface->format, surface->scanline,
-			                      surface->alignedWidth, surface->alignedHeight, &rect, 1);
-			if (status < 0)
-			{
-				VideoFrame_free(&frame);
-				return CHANNEL_RC_OK;
-			}
+			WLog_ERR(TAG, "unable to create frame");
+			return CHANNEL_RC_NO_MEMORY;
+		}
 
-			EnterCriticalSection(&priv->framesLock);
-			enqueueResult = Queue_Enqueue(priv->frames, frame);
-			LeaveCriticalSection(&priv->framesLock);
+		EnterCriticalSection(&priv->framesLock);
+		const BOOL enqueueResult = Queue_Enqueue(priv->frames, frame);
+		LeaveCriticalSection(&priv->framesLock);
 
-			if (!enqueueResult)
-			{
-				WLog_ERR(TAG, "unable to enqueue frame");
-				VideoFrame_free(&frame);
-				return CHANNEL_RC_NO_MEMORY;
-			}
-
-			// NOLINTNEXTLINE(clang-analyzer-unix.Malloc): Queue_Enqueue owns frame
-			WLog_DBG(TAG, "scheduling frame in %" PRIu32 " ms", (frame->publishTime - startTime));
+		if (!enqueueResult)
+		{
+			WLog_ERR(TAG, "unable to enqueue frame");
+			VideoFrame_free(&frame);
+			return CHANNEL_RC_NO_MEMORY;
 		}
+
+		/* if the frame is to be published in less than 10 ms, let's consider it's now and
+		 * catch up with the frames still scheduled before it */
+		if (presentation->lastPublishTime <= now + 10)
+			video_present(context, now, TRUE);
+		else
+			WLog_DBG(TAG, "scheduling frame in %" PRIu64 " ms",
+			         presentation->lastPublishTime - now);
 	}
 
 	return CHANNEL_RC_OK;
@@ -1091,8 +1124,8 @@ static UINT video_data_on_new_channel_connection(IWTSListenerCallback* pListener
 }
 
 static uint64_t timer_cb(WINPR_ATTR_UNUSED rdpContext* context, void* userdata,
-                         WINPR_ATTR_UNUSED FreeRDP_TimerID timerID, uint64_t timestamp,
-                         uint64_t interval)
+                         WINPR_ATTR_UNUSED FreeRDP_TimerID timerID,
+                         WINPR_ATTR_UNUSED uint64_t timestamp, uint64_t interval)
 {
 	VideoClientContext* video = userdata;
 	if (!video)
@@ -1100,7 +1133,8 @@ static uint64_t timer_cb(WINPR_ATTR_UNUSED rdpContext* context, void* userdata,
 	if (!video->timer)
 		return 0;
 
-	video->timer(video, timestamp);
+	/* frames are scheduled in GetTickCount64 milliseconds */
+	video->timer(video, GetTickCount64());
 
 	return interval;
 }
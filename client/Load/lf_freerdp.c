@@ -0,0 +1,544 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Load Generator
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/constants.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/utils/signal.h>
+
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/channels.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/cmdline.h>
+#include <freerdp/log.h>
+
+#include "lf_freerdp.h"
+
+#define TAG CLIENT_TAG("load")
+
+/* sessions are polled this often for input and the end of the test */
+#define LF_POLL_INTERVAL 100
+
+typedef struct
+{
+	UINT32 sessions;
+	UINT32 ramp;     /* milliseconds between two session starts */
+	UINT32 duration; /* seconds, 0 runs until all sessions ended */
+	const char* script;
+	BOOL skipDecode;
+} lfOptions;
+
+static COMMAND_LINE_ARGUMENT_A lf_args[] = {
+	{ "sessions", COMMAND_LINE_VALUE_REQUIRED, "<count>", "1", NULL, -1, NULL,
+	  "Number of concurrent sessions" },
+	{ "ramp", COMMAND_LINE_VALUE_REQUIRED, "<ms>", "0", NULL, -1, NULL,
+	  "Delay between starting two sessions" },
+	{ "duration", COMMAND_LINE_VALUE_REQUIRED, "<seconds>", "0", NULL, -1, NULL,
+	  "Disconnect all sessions after this time, 0 waits until the server ends them" },
+	{ "input-script", COMMAND_LINE_VALUE_REQUIRED, "<file>", NULL, NULL, -1, NULL,
+	  "Replay the input steps in <file> in a loop, one of 'wait <ms>', 'move <x> <y>', "
+	  "'click <x> <y>', 'key <scancode>' or 'text <string>' per line" },
+	{ "skip-decode", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
+	  "Only parse the graphics updates, do not decode them" },
+	{ NULL, 0, NULL, NULL, NULL, -1, NULL, NULL }
+};
+
+static BOOL lf_begin_paint(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+
+	rdpGdi* gdi = context->gdi;
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->primary);
+	WINPR_ASSERT(gdi->primary->hdc);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd->invalid);
+	gdi->primary->hdc->hwnd->invalid->null = TRUE;
+	return TRUE;
+}
+
+static BOOL lf_end_paint(rdpContext* context)
+{
+	lfContext* lf = (lfContext*)context;
+	WINPR_ASSERT(lf);
+
+	lf->paints++;
+	return TRUE;
+}
+
+static BOOL lf_desktop_resize(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+
+	rdpSettings* settings = context->settings;
+	WINPR_ASSERT(settings);
+
+	return gdi_resize(context->gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                  freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight));
+}
+
+static BOOL lf_pre_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+	WINPR_ASSERT(instance->context);
+
+	rdpSettings* settings = instance->context->settings;
+	WINPR_ASSERT(settings);
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_OsMajorType, OSMAJORTYPE_UNIX))
+		return FALSE;
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_OsMinorType, OSMINORTYPE_NATIVE_XSERVER))
+		return FALSE;
+
+	PubSub_SubscribeChannelConnected(instance->context->pubSub,
+	                                 freerdp_client_OnChannelConnectedEventHandler);
+	PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+	                                    freerdp_client_OnChannelDisconnectedEventHandler);
+	return TRUE;
+}
+
+static BOOL lf_post_connect(freerdp* instance)
+{
+	if (!gdi_init(instance, PIXEL_FORMAT_XRGB32))
+		return FALSE;
+
+	rdpContext* context = instance->context;
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->update);
+
+	context->update->BeginPaint = lf_begin_paint;
+	context->update->EndPaint = lf_end_paint;
+	context->update->DesktopResize = lf_desktop_resize;
+	return TRUE;
+}
+
+static void lf_post_disconnect(freerdp* instance)
+{
+	if (!instance || !instance->context)
+		return;
+
+	PubSub_UnsubscribeChannelConnected(instance->context->pubSub,
+	                                   freerdp_client_OnChannelConnectedEventHandler);
+	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
+	                                      freerdp_client_OnChannelDisconnectedEventHandler);
+	gdi_free(instance);
+}
+
+static BOOL lf_session_input(lfContext* lf, size_t* pos, UINT64* next, DWORD* timeout)
+{
+	WINPR_ASSERT(lf);
+	WINPR_ASSERT(pos);
+	WINPR_ASSERT(next);
+	WINPR_ASSERT(timeout);
+
+	if (!lf->script)
+		return TRUE;
+
+	const UINT64 now = GetTickCount64();
+	if (now >= *next)
+	{
+		UINT32 wait = 0;
+		if (!lf_script_run(lf->script, lf->common.context.input, pos, &wait))
+			return FALSE;
+		*next = now + wait;
+	}
+
+	if (*next - now < *timeout)
+		*timeout = (DWORD)(*next - now);
+	return TRUE;
+}
+
+static DWORD WINAPI lf_session_thread_proc(LPVOID arg)
+{
+	lfContext* lf = (lfContext*)arg;
+	WINPR_ASSERT(lf);
+
+	rdpContext* context = &lf->common.context;
+	freerdp* instance = context->instance;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	size_t pos = 0;
+	UINT64 next = 0;
+
+	const UINT64 start = GetTickCount64();
+	if (!freerdp_connect(instance))
+	{
+		lf->result = freerdp_get_last_error(context);
+		WLog_ERR(TAG, "[%" PRIuz "] connection failure 0x%08" PRIx32, lf->index, lf->result);
+		return lf->result;
+	}
+
+	const UINT64 connected = GetTickCount64();
+	lf->connected = TRUE;
+	lf->connectTime = connected - start;
+
+	while (!freerdp_shall_disconnect_context(context))
+	{
+		DWORD timeout = LF_POLL_INTERVAL;
+		if (!lf_session_input(lf, &pos, &next, &timeout))
+		{
+			WLog_ERR(TAG, "[%" PRIuz "] failed to send input", lf->index);
+			break;
+		}
+
+		const DWORD nCount = freerdp_get_event_handles(context, handles, ARRAYSIZE(handles));
+		if (nCount == 0)
+		{
+			WLog_ERR(TAG, "[%" PRIuz "] freerdp_get_event_handles failed", lf->index);
+			break;
+		}
+
+		const DWORD status = WaitForMultipleObjects(nCount, handles, FALSE, timeout);
+		if (status == WAIT_FAILED)
+		{
+			WLog_ERR(TAG, "[%" PRIuz "] WaitForMultipleObjects failed", lf->index);
+			break;
+		}
+
+		if (!freerdp_check_event_handles(context))
+		{
+			if (freerdp_get_last_error(context) == FREERDP_ERROR_SUCCESS)
+				WLog_ERR(TAG, "[%" PRIuz "] Failed to check FreeRDP event handles", lf->index);
+			break;
+		}
+	}
+
+	lf->runTime = GetTickCount64() - connected;
+	(void)freerdp_get_stats(context->rdp, &lf->inBytes, &lf->outBytes, NULL, NULL);
+	(void)metrics_get(context->metrics, "gfx_frame_latency_us", &lf->latency);
+
+	freerdp_disconnect(instance);
+	return lf->result;
+}
+
+static BOOL lf_client_new(freerdp* instance, rdpContext* context)
+{
+	if (!instance || !context)
+		return FALSE;
+
+	instance->PreConnect = lf_pre_connect;
+	instance->PostConnect = lf_post_connect;
+	instance->PostDisconnect = lf_post_disconnect;
+	return TRUE;
+}
+
+static int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_ASSERT(pEntryPoints);
+
+	ZeroMemory(pEntryPoints, sizeof(RDP_CLIENT_ENTRY_POINTS));
+	pEntryPoints->Version = RDP_CLIENT_INTERFACE_VERSION;
+	pEntryPoints->Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	pEntryPoints->ContextSize = sizeof(lfContext);
+	pEntryPoints->ClientNew = lf_client_new;
+	return 0;
+}
+
+static int lf_parse_uint(const COMMAND_LINE_ARGUMENT_A* arg, UINT32 min, UINT32 max,
+                         UINT32* value)
+{
+	WINPR_ASSERT(arg);
+	WINPR_ASSERT(value);
+
+	errno = 0;
+	char* end = NULL;
+	const unsigned long val = strtoul(arg->Value, &end, 0);
+	if ((errno != 0) || !end || (*end != '\0') || (end == arg->Value) || (val < min) ||
+	    (val > max))
+		return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+
+	*value = (UINT32)val;
+	return 0;
+}
+
+static int lf_handle_option(const COMMAND_LINE_ARGUMENT_A* arg, void* custom)
+{
+	lfOptions* options = custom;
+	WINPR_ASSERT(arg);
+	WINPR_ASSERT(options);
+
+	CommandLineSwitchStart(arg) CommandLineSwitchCase(arg, "sessions")
+	{
+		return lf_parse_uint(arg, 1, UINT16_MAX, &options->sessions);
+	}
+	CommandLineSwitchCase(arg, "ramp")
+	{
+		return lf_parse_uint(arg, 0, UINT32_MAX, &options->ramp);
+	}
+	CommandLineSwitchCase(arg, "duration")
+	{
+		return lf_parse_uint(arg, 0, UINT32_MAX / 1000, &options->duration);
+	}
+	CommandLineSwitchCase(arg, "input-script")
+	{
+		options->script = arg->Value;
+	}
+	CommandLineSwitchCase(arg, "skip-decode")
+	{
+		options->skipDecode = arg->Value != NULL;
+	}
+	CommandLineSwitchEnd(arg) return 0;
+}
+
+/* the upper bound of the histogram bucket containing the percentile, in milliseconds */
+static double lf_percentile(const FreeRDPMetricValue* value, UINT64 percent)
+{
+	WINPR_ASSERT(value);
+
+	if (value->count == 0)
+		return 0.0;
+
+	UINT64 seen = 0;
+	const UINT64 rank = (value->count * percent + 99) / 100;
+	for (size_t x = 0; x < ARRAYSIZE(value->buckets); x++)
+	{
+		seen += value->buckets[x];
+		if (seen >= rank)
+		{
+			if (x >= FREERDP_METRICS_HISTOGRAM_BUCKETS)
+				break;
+			const UINT64 bound = 1ull << x;
+			return (double)MIN(bound, value->max) / 1000.0;
+		}
+	}
+	return (double)value->max / 1000.0;
+}
+
+static void lf_print_row(const char* name, UINT64 connectTime, UINT64 paints, UINT64 runTime,
+                         UINT64 inBytes, UINT64 outBytes, const FreeRDPMetricValue* latency)
+{
+	const double seconds = (runTime > 0) ? (double)runTime / 1000.0 : 1.0;
+
+	printf("%-8s %10" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8.1f %10.1f %10.1f %8.1f %8.1f %8.1f\n",
+	       name, connectTime, paints, latency->count, (double)latency->count / seconds,
+	       (double)inBytes * 8.0 / 1000.0 / seconds, (double)outBytes * 8.0 / 1000.0 / seconds,
+	       lf_percentile(latency, 50), lf_percentile(latency, 90), lf_percentile(latency, 99));
+}
+
+static void lf_print_report(lfContext** sessions, size_t count)
+{
+	size_t connected = 0;
+	UINT64 connectTime = 0;
+	UINT64 paints = 0;
+	UINT64 runTime = 0;
+	UINT64 inBytes = 0;
+	UINT64 outBytes = 0;
+	FreeRDPMetricValue total = { 0 };
+
+	printf("%-8s %10s %8s %8s %8s %10s %10s %8s %8s %8s\n", "session", "connect", "paints",
+	       "frames", "fps", "kbit/s in", "kbit/s out", "p50 ms", "p90 ms", "p99 ms");
+	for (size_t x = 0; x < count; x++)
+	{
+		const lfContext* lf = sessions[x];
+		if (!lf->connected)
+		{
+			printf("%-8" PRIuz " failed 0x%08" PRIx32 "\n", x, lf->result);
+			continue;
+		}
+
+		char name[16] = { 0 };
+		(void)_snprintf(name, sizeof(name), "%" PRIuz, x);
+		lf_print_row(name, lf->connectTime, lf->paints, lf->runTime, lf->inBytes, lf->outBytes,
+		             &lf->latency);
+
+		connected++;
+		connectTime += lf->connectTime;
+		paints += lf->paints;
+		runTime = MAX(runTime, lf->runTime);
+		inBytes += lf->inBytes;
+		outBytes += lf->outBytes;
+
+		if (lf->latency.count > 0)
+		{
+			if ((total.count == 0) || (lf->latency.min < total.min))
+				total.min = lf->latency.min;
+			total.max = MAX(total.max, lf->latency.max);
+			total.count += lf->latency.count;
+			total.sum += lf->latency.sum;
+			for (size_t y = 0; y < ARRAYSIZE(total.buckets); y++)
+				total.buckets[y] += lf->latency.buckets[y];
+		}
+	}
+
+	if (connected == 0)
+		return;
+
+	lf_print_row("total", connectTime / connected, paints, runTime, inBytes, outBytes, &total);
+	printf("%" PRIuz " of %" PRIuz " sessions connected\n", connected, count);
+}
+
+static void lf_sessions_free(lfContext** sessions, size_t count)
+{
+	if (!sessions)
+		return;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		lfContext* lf = sessions[x];
+		if (!lf)
+			continue;
+
+		if (lf->thread)
+		{
+			(void)WaitForSingleObject(lf->thread, INFINITE);
+			(void)CloseHandle(lf->thread);
+			(void)freerdp_client_stop(&lf->common.context);
+		}
+		freerdp_client_context_free(&lf->common.context);
+	}
+	free((void*)sessions);
+}
+
+static BOOL lf_sessions_done(lfContext** sessions, size_t started)
+{
+	for (size_t x = 0; x < started; x++)
+	{
+		if (WaitForSingleObject(sessions[x]->thread, 0) != WAIT_OBJECT_0)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL lf_sessions_run(lfContext** sessions, size_t count, const lfOptions* options)
+{
+	WINPR_ASSERT(sessions);
+	WINPR_ASSERT(options);
+
+	BOOL rc = FALSE;
+	size_t started = 0;
+	const UINT64 start = GetTickCount64();
+	const UINT64 end = start + 1000ull * options->duration;
+
+	for (; started < count; started++)
+	{
+		lfContext* lf = sessions[started];
+		if (freerdp_client_start(&lf->common.context) != 0)
+			goto fail;
+
+		lf->thread = CreateThread(NULL, 0, lf_session_thread_proc, lf, 0, NULL);
+		if (!lf->thread)
+		{
+			(void)freerdp_client_stop(&lf->common.context);
+			goto fail;
+		}
+
+		if ((options->ramp > 0) && (started + 1 < count))
+			Sleep(options->ramp);
+	}
+
+	while (!lf_sessions_done(sessions, started))
+	{
+		if ((options->duration > 0) && (GetTickCount64() >= end))
+			break;
+		Sleep(LF_POLL_INTERVAL);
+	}
+	rc = TRUE;
+
+fail:
+	for (size_t x = 0; x < started; x++)
+		freerdp_abort_connect_context(&sessions[x]->common.context);
+	for (size_t x = 0; x < started; x++)
+		(void)WaitForSingleObject(sessions[x]->thread, INFINITE);
+	return rc;
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	lfOptions options = { 1, 0, 0, NULL, FALSE };
+	lfScript* script = NULL;
+	lfContext** sessions = NULL;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints = { 0 };
+
+	if (freerdp_handle_signals() != 0)
+		return -1;
+
+	RdpClientEntry(&clientEntryPoints);
+	rdpContext* context = freerdp_client_context_new(&clientEntryPoints);
+	if (!context)
+		return -1;
+
+	rdpSettings* settings = context->settings;
+	const int status = freerdp_client_settings_parse_command_line_arguments_ex(
+	    settings, argc, argv, FALSE, lf_args, ARRAYSIZE(lf_args) - 1, lf_handle_option, &options);
+	if (status)
+	{
+		rc = freerdp_client_settings_command_line_status_print_ex(settings, status, argc, argv,
+		                                                          lf_args);
+		goto fail;
+	}
+
+	/* the sessions run in parallel already, every codec starting a pool per session would only
+	 * oversubscribe the machine */
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_ThreadingFlags,
+	                                 THREADING_FLAGS_DISABLE_THREADS))
+		goto fail;
+	if (!freerdp_settings_set_bool(settings, FreeRDP_DeactivateClientDecoding,
+	                               options.skipDecode))
+		goto fail;
+
+	if (options.script)
+	{
+		script = lf_script_new(options.script);
+		if (!script)
+			goto fail;
+	}
+
+	sessions = (lfContext**)calloc(options.sessions, sizeof(lfContext*));
+	if (!sessions)
+		goto fail;
+
+	sessions[0] = (lfContext*)context;
+	context = NULL;
+	for (size_t x = 0; x < options.sessions; x++)
+	{
+		if (x > 0)
+		{
+			rdpContext* cur = freerdp_client_context_new(&clientEntryPoints);
+			if (!cur)
+				goto fail;
+			sessions[x] = (lfContext*)cur;
+			if (!freerdp_settings_copy(cur->settings, settings))
+				goto fail;
+		}
+		sessions[x]->index = x;
+		sessions[x]->script = script;
+	}
+
+	if (lf_sessions_run(sessions, options.sessions, &options))
+	{
+		lf_print_report(sessions, options.sessions);
+		rc = 0;
+	}
+
+fail:
+	lf_sessions_free(sessions, options.sessions);
+	freerdp_client_context_free(context);
+	lf_script_free(script);
+	return rc;
+}
@@ -0,0 +1,46 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Load Generator
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_LOAD_H
+#define FREERDP_CLIENT_LOAD_H
+
+#include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
+#include <freerdp/client.h>
+
+#include "lf_script.h"
+
+typedef struct
+{
+	rdpClientContext common;
+
+	size_t index;
+	const lfScript* script;
+	HANDLE thread;
+	DWORD result;
+
+	/* filled in by the session thread, read after it ended */
+	BOOL connected;
+	UINT64 connectTime; /* in milliseconds */
+	UINT64 runTime;     /* in milliseconds */
+	UINT64 paints;
+	UINT64 inBytes;
+	UINT64 outBytes;
+	FreeRDPMetricValue latency;
+} lfContext;
+
+#endif /* FREERDP_CLIENT_LOAD_H */
@@ -0,0 +1,243 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Load Generator Input Script
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/assert.h>
+#include <winpr/string.h>
+
+#include <freerdp/log.h>
+
+#include "lf_script.h"
+
+#define TAG CLIENT_TAG("load.script")
+
+typedef enum
+{
+	LF_STEP_WAIT,
+	LF_STEP_MOVE,
+	LF_STEP_CLICK,
+	LF_STEP_KEY,
+	LF_STEP_TEXT
+} lfStepType;
+
+typedef struct
+{
+	lfStepType type;
+	UINT32 a;
+	UINT32 b;
+	WCHAR* text;
+	size_t length;
+} lfStep;
+
+struct lf_script
+{
+	lfStep* steps;
+	size_t count;
+};
+
+static BOOL lf_script_parse_uint(const char* str, UINT32 max, UINT32* value, char** end)
+{
+	WINPR_ASSERT(value);
+
+	errno = 0;
+	char* next = NULL;
+	const unsigned long val = strtoul(str, &next, 0);
+	if ((errno != 0) || (next == str) || (val > max))
+		return FALSE;
+
+	*value = (UINT32)val;
+	if (end)
+		*end = next;
+	return TRUE;
+}
+
+static BOOL lf_script_parse_step(lfStep* step, char* line)
+{
+	WINPR_ASSERT(step);
+	WINPR_ASSERT(line);
+
+	char* args = strchr(line, ' ');
+	if (!args)
+		return FALSE;
+	*args++ = '\0';
+
+	char* end = NULL;
+	if (strcmp(line, "wait") == 0)
+	{
+		step->type = LF_STEP_WAIT;
+		return lf_script_parse_uint(args, UINT32_MAX, &step->a, NULL);
+	}
+	else if ((strcmp(line, "move") == 0) || (strcmp(line, "click") == 0))
+	{
+		step->type = (strcmp(line, "move") == 0) ? LF_STEP_MOVE : LF_STEP_CLICK;
+		if (!lf_script_parse_uint(args, UINT16_MAX, &step->a, &end))
+			return FALSE;
+		return lf_script_parse_uint(end, UINT16_MAX, &step->b, NULL);
+	}
+	else if (strcmp(line, "key") == 0)
+	{
+		step->type = LF_STEP_KEY;
+		return lf_script_parse_uint(args, UINT32_MAX, &step->a, NULL);
+	}
+	else if (strcmp(line, "text") == 0)
+	{
+		step->type = LF_STEP_TEXT;
+		step->text = ConvertUtf8ToWCharAlloc(args, &step->length);
+		return step->text != NULL;
+	}
+	return FALSE;
+}
+
+lfScript* lf_script_new(const char* file)
+{
+	WINPR_ASSERT(file);
+
+	BOOL waits = FALSE;
+	size_t lineno = 0;
+	char line[1024] = { 0 };
+	lfScript* script = calloc(1, sizeof(lfScript));
+	if (!script)
+		return NULL;
+
+	FILE* fp = winpr_fopen(file, "r");
+	if (!fp)
+	{
+		WLog_ERR(TAG, "failed to open input script %s", file);
+		goto fail;
+	}
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if ((line[0] == '\0') || (line[0] == '#'))
+			continue;
+
+		lfStep* steps = realloc(script->steps, sizeof(lfStep) * (script->count + 1));
+		if (!steps)
+			goto fail;
+		script->steps = steps;
+
+		lfStep* step = &script->steps[script->count];
+		memset(step, 0, sizeof(lfStep));
+		script->count++;
+		if (!lf_script_parse_step(step, line))
+		{
+			WLog_ERR(TAG, "%s:%" PRIuz ": invalid step", file, lineno);
+			goto fail;
+		}
+		if (step->type == LF_STEP_WAIT)
+			waits = TRUE;
+	}
+
+	/* the script is replayed in a loop, without a wait the sessions would only send input */
+	if (!waits)
+	{
+		WLog_ERR(TAG, "input script %s does not contain a wait step", file);
+		goto fail;
+	}
+
+	(void)fclose(fp);
+	return script;
+
+fail:
+	if (fp)
+		(void)fclose(fp);
+	lf_script_free(script);
+	return NULL;
+}
+
+void lf_script_free(lfScript* script)
+{
+	if (!script)
+		return;
+
+	for (size_t x = 0; x < script->count; x++)
+		free(script->steps[x].text);
+	free(script->steps);
+	free(script);
+}
+
+static BOOL lf_script_send_text(rdpInput* input, const lfStep* step)
+{
+	for (size_t x = 0; x < step->length; x++)
+	{
+		if (!freerdp_input_send_unicode_keyboard_event(input, 0, step->text[x]))
+			return FALSE;
+		if (!freerdp_input_send_unicode_keyboard_event(input, KBD_FLAGS_RELEASE, step->text[x]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL lf_script_send(rdpInput* input, const lfStep* step)
+{
+	const UINT16 x = (UINT16)step->a;
+	const UINT16 y = (UINT16)step->b;
+
+	switch (step->type)
+	{
+		case LF_STEP_MOVE:
+			return freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, x, y);
+		case LF_STEP_CLICK:
+			return freerdp_input_send_mouse_event(input, PTR_FLAGS_MOVE, x, y) &&
+			       freerdp_input_send_mouse_event(input, PTR_FLAGS_DOWN | PTR_FLAGS_BUTTON1, x,
+			                                      y) &&
+			       freerdp_input_send_mouse_event(input, PTR_FLAGS_BUTTON1, x, y);
+		case LF_STEP_KEY:
+			return freerdp_input_send_keyboard_event_ex(input, TRUE, FALSE, step->a) &&
+			       freerdp_input_send_keyboard_event_ex(input, FALSE, FALSE, step->a);
+		case LF_STEP_TEXT:
+			return lf_script_send_text(input, step);
+		case LF_STEP_WAIT:
+		default:
+			return TRUE;
+	}
+}
+
+BOOL lf_script_run(const lfScript* script, rdpInput* input, size_t* pos, UINT32* wait)
+{
+	WINPR_ASSERT(script);
+	WINPR_ASSERT(input);
+	WINPR_ASSERT(pos);
+	WINPR_ASSERT(wait);
+
+	for (size_t x = 0; x < script->count; x++)
+	{
+		const lfStep* step = &script->steps[*pos];
+		*pos = (*pos + 1) % script->count;
+
+		if (step->type == LF_STEP_WAIT)
+		{
+			*wait = step->a;
+			return TRUE;
+		}
+		if (!lf_script_send(input, step))
+			return FALSE;
+	}
+
+	*wait = 0;
+	return TRUE;
+}
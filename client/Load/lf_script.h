@@ -0,0 +1,46 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Load Generator Input Script
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_LOAD_SCRIPT_H
+#define FREERDP_CLIENT_LOAD_SCRIPT_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/input.h>
+
+/* A list of input steps replayed in a loop by every session.
+ * One step per line, empty lines and lines starting with # are ignored:
+ *
+ *   wait <ms>
+ *   move <x> <y>
+ *   click <x> <y>
+ *   key <scancode>
+ *   text <string>
+ */
+typedef struct lf_script lfScript;
+
+lfScript* lf_script_new(const char* file);
+void lf_script_free(lfScript* script);
+
+/**
+ * @brief lf_script_run Sends the steps starting at \b pos up to the next wait step.
+ * @param wait The milliseconds to wait before the next call
+ * @return \b TRUE if all input could be sent
+ */
+BOOL lf_script_run(const lfScript* script, rdpInput* input, size_t* pos, UINT32* wait);
+
+#endif /* FREERDP_CLIENT_LOAD_SCRIPT_H */
@@ -70,6 +70,8 @@
 
 #define SDL_TAG CLIENT_TAG("SDL")
 
+static constexpr Uint64 UPDATE_MAX_DEFER = 16; /* maximum delay in ms of an update by input */
+
 enum SDL_EXIT_CODE
 {
 	/* section 0-15: protocol-independent codes */
@@ -389,6 +391,7 @@ static BOOL sdl_draw_to_window(SdlContext* sdl, std::map<Uint32, SdlWindow>& win
 			return FALSE;
 	}
 
+	gdi_frame_presented(sdl->context()->gdi);
 	return TRUE;
 }
 
@@ -688,6 +691,11 @@ static BOOL sdl_create_windows(SdlContext* sdl)
 		if (!window.window())
 			return FALSE;
 
+		const auto renderer = SdlPref::instance()->get_string("SDL_Renderer", "default");
+		if ((renderer != "none") && !window.useRenderer(renderer))
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+			            "renderer %s not available, using the window surface", renderer.c_str());
+
 		if (freerdp_settings_get_bool(settings, FreeRDP_UseMultimon))
 		{
 			auto r = window.rect();
@@ -767,6 +775,7 @@ static int sdl_run(SdlContext* sdl)
 
 	sdl->initialized.set();
 
+	Uint64 updateDeferred = 0;
 	while (!shall_abort(sdl))
 	{
 		SDL_Event windowEvent = {};
@@ -911,12 +920,25 @@ static int sdl_run(SdlContext* sdl)
 				break;
 				case SDL_EVENT_USER_UPDATE:
 				{
-					std::vector<SDL_Rect> rectangles;
-					do
+					/* input queued meanwhile goes first, presents wait for vsync and would
+					 * delay it by up to a frame. Updates are deferred for a frame at most. */
+					const Uint64 now = SDL_GetTicks();
+					if (SDL_HasEvents(SDL_EVENT_KEY_DOWN, SDL_EVENT_FINGER_MOTION))
 					{
-						rectangles = sdl->pop();
+						if (updateDeferred == 0)
+							updateDeferred = now;
+						if ((now - updateDeferred < UPDATE_MAX_DEFER) &&
+						    sdl_push_user_event(SDL_EVENT_USER_UPDATE))
+							break;
+					}
+					updateDeferred = 0;
+
+					/* coalesce everything queued into a single present */
+					std::vector<SDL_Rect> rectangles;
+					for (auto rects = sdl->pop(); !rects.empty(); rects = sdl->pop())
+						rectangles.insert(rectangles.end(), rects.begin(), rects.end());
+					if (!rectangles.empty())
 						sdl_draw_to_window(sdl, sdl->windows, rectangles);
-					} while (!rectangles.empty());
 				}
 				break;
 				case SDL_EVENT_USER_CREATE_WINDOWS:
@@ -28,11 +28,26 @@
 
 #include <SDL3/SDL_mouse.h>
 
+/* cursors kept per pointer, one for each size the pointer was recently shown at */
+#define SDL_POINTER_MAX_CURSORS 4
+
 typedef struct
 {
-	rdpPointer pointer;
 	SDL_Cursor* cursor;
 	SDL_Surface* image;
+	INT32 x;
+	INT32 y;
+	INT32 w;
+	INT32 h;
+	float scale;
+	UINT64 lastUse;
+} sdlCursor;
+
+typedef struct
+{
+	rdpPointer pointer;
+	sdlCursor cursors[SDL_POINTER_MAX_CURSORS];
+	UINT64 uses;
 	size_t size;
 	void* data;
 } sdlPointer;
@@ -67,13 +82,19 @@ static BOOL sdl_Pointer_New(rdpContext* context, rdpPointer* pointer)
 	return TRUE;
 }
 
+static void sdl_Cursor_Clear(sdlCursor* cur)
+{
+	WINPR_ASSERT(cur);
+	SDL_DestroyCursor(cur->cursor);
+	SDL_DestroySurface(cur->image);
+	*cur = {};
+}
+
 static void sdl_Pointer_Clear(sdlPointer* ptr)
 {
 	WINPR_ASSERT(ptr);
-	SDL_DestroyCursor(ptr->cursor);
-	SDL_DestroySurface(ptr->image);
-	ptr->cursor = nullptr;
-	ptr->image = nullptr;
+	for (auto& cur : ptr->cursors)
+		sdl_Cursor_Clear(&cur);
 }
 
 static void sdl_Pointer_Free(rdpContext* context, rdpPointer* pointer)
@@ -102,11 +123,85 @@ static BOOL sdl_Pointer_Set(rdpContext* context, rdpPointer* pointer)
 	return sdl_push_user_event(SDL_EVENT_USER_POINTER_SET, pointer);
 }
 
-BOOL sdl_Pointer_Set_Process(SdlContext* sdl)
+static BOOL sdl_Pointer_CreateCursor(SdlContext* sdl, sdlPointer* ptr, sdlCursor* cur)
+{
+	WINPR_ASSERT(sdl);
+	WINPR_ASSERT(ptr);
+	WINPR_ASSERT(cur);
+
+	auto context = sdl->context();
+	rdpGdi* gdi = context->gdi;
+	WINPR_ASSERT(gdi);
+
+	cur->image = SDL_CreateSurface(cur->w, cur->h, sdl->sdl_pixel_format);
+	if (!cur->image)
+		return FALSE;
+
+	SDL_LockSurface(cur->image);
+	auto pixels = static_cast<BYTE*>(cur->image->pixels);
+	auto data = static_cast<const BYTE*>(ptr->data);
+	const BOOL rc = freerdp_image_scale(
+	    pixels, gdi->dstFormat, static_cast<UINT32>(cur->image->pitch), 0, 0,
+	    static_cast<UINT32>(cur->image->w), static_cast<UINT32>(cur->image->h), data,
+	    gdi->dstFormat, 0, 0, 0, ptr->pointer.width, ptr->pointer.height);
+	SDL_UnlockSurface(cur->image);
+	if (!rc)
+		return FALSE;
+
+	// create a cursor image in 100% display scale to trick SDL into creating the cursor with the
+	// correct size
+	auto normal =
+	    SDL_CreateSurface(static_cast<int>(static_cast<float>(cur->image->w) / cur->scale),
+	                      static_cast<int>(static_cast<float>(cur->image->h) / cur->scale),
+	                      cur->image->format);
+	assert(normal);
+	SDL_BlitSurfaceScaled(cur->image, nullptr, normal, nullptr,
+	                      SDL_ScaleMode::SDL_SCALEMODE_LINEAR);
+	SDL_AddSurfaceAlternateImage(normal, cur->image);
+
+	cur->cursor = SDL_CreateColorCursor(normal, cur->x, cur->y);
+	SDL_DestroySurface(normal);
+	return cur->cursor != nullptr;
+}
+
+/* Returns the cursor for the pointer at the given size, created on first use. The least
+ * recently used cursor makes room for a new size. */
+static SDL_Cursor* sdl_Pointer_GetCursor(SdlContext* sdl, sdlPointer* ptr, INT32 x, INT32 y,
+                                         INT32 w, INT32 h, float scale)
 {
-	INT32 w = 0;
-	INT32 h = 0;
+	WINPR_ASSERT(ptr);
+
+	sdlCursor* slot = &ptr->cursors[0];
+	for (auto& cur : ptr->cursors)
+	{
+		if (cur.cursor && (cur.x == x) && (cur.y == y) && (cur.w == w) && (cur.h == h) &&
+		    (cur.scale == scale))
+		{
+			cur.lastUse = ++ptr->uses;
+			return cur.cursor;
+		}
+
+		if (slot->cursor && (!cur.cursor || (cur.lastUse < slot->lastUse)))
+			slot = &cur;
+	}
+
+	sdl_Cursor_Clear(slot);
+	slot->x = x;
+	slot->y = y;
+	slot->w = w;
+	slot->h = h;
+	slot->scale = scale;
+	slot->lastUse = ++ptr->uses;
+	if (!sdl_Pointer_CreateCursor(sdl, ptr, slot))
+	{
+		sdl_Cursor_Clear(slot);
+		return nullptr;
+	}
+	return slot->cursor;
+}
 
+BOOL sdl_Pointer_Set_Process(SdlContext* sdl)
+{
 	WINPR_ASSERT(sdl);
 
 	auto context = sdl->context();
@@ -115,13 +210,10 @@ BOOL sdl_Pointer_Set_Process(SdlContext* sdl)
 	if (!ptr)
 		return TRUE;
 
-	rdpGdi* gdi = context->gdi;
-	WINPR_ASSERT(gdi);
-
 	auto x = static_cast<INT32>(pointer->xPos);
 	auto y = static_cast<INT32>(pointer->yPos);
-	auto sw = w = static_cast<INT32>(pointer->width);
-	auto sh = h = static_cast<INT32>(pointer->height);
+	auto sw = static_cast<INT32>(pointer->width);
+	auto sh = static_cast<INT32>(pointer->height);
 
 	SDL_Window* window = SDL_GetMouseFocus();
 	if (!window)
@@ -133,47 +225,25 @@ BOOL sdl_Pointer_Set_Process(SdlContext* sdl)
 	    !sdl_scale_coordinates(sdl, id, &sw, &sh, FALSE, FALSE))
 		return FALSE;
 
-	sdl_Pointer_Clear(ptr);
-
-	ptr->image = SDL_CreateSurface(sw, sh, sdl->sdl_pixel_format);
-	if (!ptr->image)
-		return FALSE;
-
-	SDL_LockSurface(ptr->image);
-	auto pixels = static_cast<BYTE*>(ptr->image->pixels);
-	auto data = static_cast<const BYTE*>(ptr->data);
-	const BOOL rc = freerdp_image_scale(
-	    pixels, gdi->dstFormat, static_cast<UINT32>(ptr->image->pitch), 0, 0,
-	    static_cast<UINT32>(ptr->image->w), static_cast<UINT32>(ptr->image->h), data,
-	    gdi->dstFormat, 0, 0, 0, static_cast<UINT32>(w), static_cast<UINT32>(h));
-	SDL_UnlockSurface(ptr->image);
-	if (!rc)
-		return FALSE;
-
-	// create a cursor image in 100% display scale to trick SDL into creating the cursor with the
-	// correct size
 	auto it = sdl->windows.begin();
 	if (it == sdl->windows.end())
 		return FALSE;
 
 	const auto hidpi_scale = SDL_GetWindowDisplayScale(it->second.window());
-	auto normal = SDL_CreateSurface(
-	    static_cast<int>(static_cast<float>(ptr->image->w) / hidpi_scale),
-	    static_cast<int>(static_cast<float>(ptr->image->h) / hidpi_scale), ptr->image->format);
-	assert(normal);
-	SDL_BlitSurfaceScaled(ptr->image, nullptr, normal, nullptr,
-	                      SDL_ScaleMode::SDL_SCALEMODE_LINEAR);
-	SDL_AddSurfaceAlternateImage(normal, ptr->image);
-
-	ptr->cursor = SDL_CreateColorCursor(normal, x, y);
-	if (!ptr->cursor)
+	SDL_Cursor* cursor = sdl_Pointer_GetCursor(sdl, ptr, x, y, sw, sh, hidpi_scale);
+	if (!cursor)
 		return FALSE;
 
-	SDL_DestroySurface(normal);
-
-	SDL_SetCursor(ptr->cursor);
+	SDL_SetCursor(cursor);
 	SDL_ShowCursor();
 	sdl->setHasCursor(true);
+
+	/* the display scale changed, the cursors for the old one are not shown again */
+	for (auto& cur : ptr->cursors)
+	{
+		if (cur.cursor && (cur.scale != hidpi_scale))
+			sdl_Cursor_Clear(&cur);
+	}
 	return TRUE;
 }
 
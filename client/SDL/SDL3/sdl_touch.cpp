@@ -108,13 +108,15 @@ static BOOL sdl_get_touch_scaled(SdlContext* sdl, const SDL_TouchFingerEvent* ev
 		return FALSE;
 
 	windowID = SDL_GetWindowID(window);
-	SDL_Surface* surface = SDL_GetWindowSurface(window);
-	if (!surface)
+	/* the window might present through a renderer, which excludes the window surface */
+	int w = 0;
+	int h = 0;
+	if (!SDL_GetWindowSizeInPixels(window, &w, &h))
 		return FALSE;
 
 	// TODO: Add the offset of the surface in the global coordinates
-	*px = static_cast<INT32>(ev->x * static_cast<float>(surface->w));
-	*py = static_cast<INT32>(ev->y * static_cast<float>(surface->h));
+	*px = static_cast<INT32>(ev->x * static_cast<float>(w));
+	*py = static_cast<INT32>(ev->y * static_cast<float>(h));
 	return sdl_scale_coordinates(sdl, windowID, px, py, local, TRUE);
 }
 
@@ -17,6 +17,10 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstring>
+
+#include <winpr/assert.h>
+
 #include "sdl_window.hpp"
 #include "sdl_utils.hpp"
 
@@ -51,13 +55,20 @@ SdlWindow::SdlWindow(const std::string& title, Sint32 startupX, Sint32 startupY,
 }
 
 SdlWindow::SdlWindow(SdlWindow&& other) noexcept
-    : _window(other._window), _offset_x(other._offset_x), _offset_y(other._offset_y)
+    : _window(other._window), _offset_x(other._offset_x), _offset_y(other._offset_y),
+      _renderer(other._renderer), _texture(other._texture), _frame(other._frame)
 {
 	other._window = nullptr;
+	other._renderer = nullptr;
+	other._texture = nullptr;
 }
 
 SdlWindow::~SdlWindow()
 {
+	if (_texture)
+		SDL_DestroyTexture(_texture);
+	if (_renderer)
+		SDL_DestroyRenderer(_renderer);
 	SDL_DestroyWindow(_window);
 }
 
@@ -199,8 +210,38 @@ void SdlWindow::minimize()
 	(void)SDL_SyncWindow(_window);
 }
 
+bool SdlWindow::useRenderer(const std::string& driver)
+{
+	if (!_window || _renderer)
+		return false;
+
+	/* the window surface and a renderer can not be used at the same time */
+	(void)SDL_DestroyWindowSurface(_window);
+	_renderer = SDL_CreateRenderer(_window, driver == "default" ? nullptr : driver.c_str());
+	if (!_renderer)
+	{
+		SDL_LogWarn(SDL_LOG_CATEGORY_RENDER, "SDL_CreateRenderer(%s): %s", driver.c_str(),
+		            SDL_GetError());
+		return false;
+	}
+
+	/* presents are paced by the display, updates queued meanwhile are merged */
+	if (!SDL_SetRenderVSync(_renderer, 1))
+		SDL_LogWarn(SDL_LOG_CATEGORY_RENDER, "SDL_SetRenderVSync: %s", SDL_GetError());
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_RENDER, "using renderer %s", SDL_GetRendererName(_renderer));
+	return true;
+}
+
 bool SdlWindow::fill(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 {
+	if (_renderer)
+	{
+		if (!SDL_SetRenderDrawColor(_renderer, r, g, b, a))
+			return false;
+		return SDL_RenderClear(_renderer);
+	}
+
 	auto surface = SDL_GetWindowSurface(_window);
 	if (!surface)
 		return false;
@@ -211,8 +252,77 @@ bool SdlWindow::fill(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
 	return true;
 }
 
+bool SdlWindow::upload(SDL_Surface* surface, const SDL_Rect& srcRect, const SDL_Rect& dstRect)
+{
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(_renderer);
+
+	const SDL_Rect bounds = { 0, 0, surface->w, surface->h };
+	SDL_Rect area = srcRect;
+	if (!_texture || (_texture->w != surface->w) || (_texture->h != surface->h) ||
+	    (_texture->format != surface->format))
+	{
+		if (_texture)
+			SDL_DestroyTexture(_texture);
+		_texture = SDL_CreateTexture(_renderer, surface->format, SDL_TEXTUREACCESS_STREAMING,
+		                             surface->w, surface->h);
+		if (!_texture)
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "SDL_CreateTexture: %s", SDL_GetError());
+			return false;
+		}
+		(void)SDL_SetTextureBlendMode(_texture, SDL_BLENDMODE_NONE);
+		(void)SDL_SetTextureScaleMode(_texture, SDL_SCALEMODE_LINEAR);
+
+		/* a new texture is empty, fill it completely */
+		area = bounds;
+	}
+
+	/* only the damaged area is transferred, scaling is done when presenting */
+	SDL_Rect rect = {};
+	if (SDL_GetRectIntersection(&area, &bounds, &rect))
+	{
+		void* data = nullptr;
+		int dstPitch = 0;
+		if (!SDL_LockTexture(_texture, &rect, &data, &dstPitch))
+		{
+			SDL_LogError(SDL_LOG_CATEGORY_RENDER, "SDL_LockTexture: %s", SDL_GetError());
+			return false;
+		}
+
+		const auto bpp = static_cast<size_t>(SDL_BYTESPERPIXEL(surface->format));
+		const auto srcStep = static_cast<size_t>(surface->pitch);
+		const auto dstStep = static_cast<size_t>(dstPitch);
+		const auto width = static_cast<size_t>(rect.w) * bpp;
+		auto src = static_cast<const Uint8*>(surface->pixels);
+		src += static_cast<size_t>(rect.y) * srcStep + static_cast<size_t>(rect.x) * bpp;
+		auto dst = static_cast<Uint8*>(data);
+		for (int y = 0; y < rect.h; y++)
+		{
+			memcpy(dst, src, width);
+			src += srcStep;
+			dst += dstStep;
+		}
+		SDL_UnlockTexture(_texture);
+	}
+
+	/* the whole frame is rendered on present, derive its position from the rectangle */
+	if ((srcRect.w > 0) && (srcRect.h > 0))
+	{
+		const float sx = static_cast<float>(dstRect.w) / static_cast<float>(srcRect.w);
+		const float sy = static_cast<float>(dstRect.h) / static_cast<float>(srcRect.h);
+		_frame = { static_cast<float>(dstRect.x) - static_cast<float>(srcRect.x) * sx,
+			       static_cast<float>(dstRect.y) - static_cast<float>(srcRect.y) * sy,
+			       static_cast<float>(surface->w) * sx, static_cast<float>(surface->h) * sy };
+	}
+	return true;
+}
+
 bool SdlWindow::blit(SDL_Surface* surface, const SDL_Rect& srcRect, SDL_Rect& dstRect)
 {
+	if (_renderer)
+		return surface && upload(surface, srcRect, dstRect);
+
 	auto screen = SDL_GetWindowSurface(_window);
 	if (!screen || !surface)
 		return false;
@@ -230,5 +340,15 @@ bool SdlWindow::blit(SDL_Surface* surface, const SDL_Rect& srcRect, SDL_Rect& ds
 
 void SdlWindow::updateSurface()
 {
+	if (_renderer)
+	{
+		/* the back buffer content is undefined after presenting, so draw the whole frame */
+		(void)SDL_SetRenderDrawColor(_renderer, 0, 0, 0, 0xff);
+		(void)SDL_RenderClear(_renderer);
+		if (_texture)
+			(void)SDL_RenderTexture(_renderer, _texture, nullptr, &_frame);
+		(void)SDL_RenderPresent(_renderer);
+		return;
+	}
 	SDL_UpdateWindowSurface(_window);
 }
@@ -57,6 +57,9 @@ class SdlWindow
 	void fullscreen(bool enter);
 	void minimize();
 
+	/* presents through an accelerated SDL renderer instead of the window surface */
+	bool useRenderer(const std::string& driver);
+
 	bool fill(Uint8 r = 0x00, Uint8 g = 0x00, Uint8 b = 0x00, Uint8 a = 0xff);
 	bool blit(SDL_Surface* surface, const SDL_Rect& src, SDL_Rect& dst);
 	void updateSurface();
@@ -64,8 +67,13 @@ class SdlWindow
   private:
 	static UINT32 orientaion_to_rdp(SDL_DisplayOrientation orientation);
 
+	bool upload(SDL_Surface* surface, const SDL_Rect& srcRect, const SDL_Rect& dstRect);
+
   private:
 	SDL_Window* _window = nullptr;
 	Sint32 _offset_x = 0;
 	Sint32 _offset_y = 0;
+	SDL_Renderer* _renderer = nullptr;
+	SDL_Texture* _texture = nullptr;
+	SDL_FRect _frame = {};
 };
@@ -160,6 +160,14 @@ void SdlPref::print_config_file_help(int version)
 	std::cout << "      Disconnects from the RDP session." << std::endl;
 	std::cout << "      Default SDL_SCANCODE_D." << std::endl;
 	std::cout << "      A string as defined at " << url << "/SDLScancodeLookup" << std::endl;
+	std::cout << std::endl;
+	std::cout << "    SDL_Renderer" << std::endl;
+	std::cout << "      Presents through an accelerated SDL renderer (SDL3 client only)."
+	          << std::endl;
+	std::cout << "      Default default, letting SDL choose the render driver." << std::endl;
+	std::cout << "      A render driver name like opengl or vulkan, none draws to the window "
+	             "surface on the CPU."
+	          << std::endl;
 #endif
 }
 
@@ -34,6 +34,9 @@
 #include "xf_cliprdr.h"
 #include "xf_disp.h"
 #include "xf_video.h"
+#if defined(CHANNEL_GFXREDIR_CLIENT)
+#include "xf_gfxredir.h"
+#endif
 
 void xf_OnChannelConnectedEventHandler(void* context, const ChannelConnectedEventArgs* e)
 {
@@ -79,6 +82,12 @@ void xf_OnChannelConnectedEventHandler(void* context, const ChannelConnectedEven
 		else
 			xf_video_control_init(xfc, (VideoClientContext*)e->pInterface);
 	}
+#if defined(CHANNEL_GFXREDIR_CLIENT)
+	else if (strcmp(e->name, GFXREDIR_DVC_CHANNEL_NAME) == 0)
+	{
+		xf_gfxredir_init(xfc, (GfxRedirClientContext*)e->pInterface);
+	}
+#endif
 	else
 		freerdp_client_OnChannelConnectedEventHandler(context, e);
 }
@@ -127,6 +136,12 @@ void xf_OnChannelDisconnectedEventHandler(void* context, const ChannelDisconnect
 		else
 			xf_video_control_uninit(xfc, (VideoClientContext*)e->pInterface);
 	}
+#if defined(CHANNEL_GFXREDIR_CLIENT)
+	else if (strcmp(e->name, GFXREDIR_DVC_CHANNEL_NAME) == 0)
+	{
+		xf_gfxredir_uninit(xfc, (GfxRedirClientContext*)e->pInterface);
+	}
+#endif
 	else
 		freerdp_client_OnChannelDisconnectedEventHandler(context, e);
 }
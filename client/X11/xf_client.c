@@ -437,6 +437,16 @@ static BOOL xf_end_paint(rdpContext* context)
 	xfContext* xfc = (xfContext*)context;
 	rdpGdi* gdi = context->gdi;
 
+	/* window state changes of this update, before the windows are painted */
+	if (xfc->railWindows)
+	{
+		xf_lock_x11(xfc);
+		const BOOL rc = xf_rail_flush(xfc);
+		xf_unlock_x11(xfc);
+		if (!rc)
+			return FALSE;
+	}
+
 	if (gdi->suppressOutput)
 		return TRUE;
 
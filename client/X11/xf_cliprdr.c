@@ -143,6 +143,12 @@ struct xf_clipboard
 	UINT32 lastSentNumFormats;
 	CliprdrFileContext* file;
 	BOOL isImageContent;
+
+	/* text requested ahead of a local paste, see xf_cliprdr_prefetch_text */
+	UINT32 prefetchFormatId;
+	BOOL prefetchStale;
+	BOOL prefetchDeferred;
+	BOOL prefetchRespond;
 };
 
 static const char mime_text_plain[] = "text/plain";
@@ -1630,7 +1636,14 @@ static BOOL xf_cliprdr_process_selection_request(xfClipboard* clipboard,
 				                         cformat->formatName);
 				clipboard->data_raw_format = rawTransfer;
 				delayRespond = TRUE;
-				xf_cliprdr_send_data_request(clipboard, formatId, cformat);
+
+				/* the text is already on its way, answer with the prefetch response */
+				if (!rawTransfer && !clipboard->prefetchStale &&
+				    (clipboard->prefetchFormatId != 0) &&
+				    (clipboard->prefetchFormatId == formatId))
+					clipboard->prefetchRespond = TRUE;
+				else
+					xf_cliprdr_send_data_request(clipboard, formatId, cformat);
 			}
 		}
 	}
@@ -1971,6 +1984,95 @@ static void xf_cliprdr_set_selection_owner(xfContext* xfc, xfClipboard* clipboar
 	XFlush(xfc->display);
 }
 
+/* Keep the data of a server format, later requests for it or any format converted from it
+ * are answered without asking the server again */
+static void xf_cliprdr_cache_raw_data(xfClipboard* clipboard, UINT32 srcFormatId,
+                                      const BYTE* data, size_t size)
+{
+	WINPR_ASSERT(clipboard);
+
+	/* Memory allocation failure is not fatal here as this is only a cached value. */
+	xfCachedData* cached_raw_data = xf_cached_data_new_copy(data, size);
+	if (!cached_raw_data)
+		WLog_WARN(TAG, "Failed to allocate cache entry");
+	else
+	{
+		if (!HashTable_Insert(clipboard->cachedRawData, (void*)(UINT_PTR)srcFormatId,
+		                      cached_raw_data))
+		{
+			WLog_WARN(TAG, "Failed to cache clipboard data");
+			xf_cached_data_free(cached_raw_data);
+		}
+	}
+}
+
+/* Fetch the text of a new server clipboard right away. The first paste and clipboard managers
+ * polling the new selection are then answered from the cache instead of a round trip each. */
+static void xf_cliprdr_prefetch_text(xfClipboard* clipboard)
+{
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(clipboard->xfc);
+
+	const rdpSettings* settings = clipboard->xfc->common.context.settings;
+	const UINT32 mask = freerdp_settings_get_uint32(settings, FreeRDP_ClipboardFeatureMask);
+	const UINT32 required = CLIPRDR_FLAG_PREFETCH_TEXT | CLIPRDR_FLAG_REMOTE_TO_LOCAL;
+
+	clipboard->prefetchDeferred = FALSE;
+	if ((mask & required) != required)
+		return;
+
+	/* responses carry no format, wait until the ones still due have arrived */
+	if (clipboard->respond || (clipboard->prefetchFormatId != 0))
+	{
+		clipboard->prefetchDeferred = TRUE;
+		return;
+	}
+
+	for (size_t x = 0; x < clipboard->numServerFormats; x++)
+	{
+		const CLIPRDR_FORMAT* format = &clipboard->serverFormats[x];
+		if (format->formatName || (format->formatId != CF_UNICODETEXT))
+			continue;
+
+		const xfCliprdrFormat* cformat =
+		    xf_cliprdr_get_client_format_by_id(clipboard, CF_UNICODETEXT);
+		if (!cformat)
+			return;
+
+		if (xf_cliprdr_send_data_request(clipboard, CF_UNICODETEXT, cformat) == CHANNEL_RC_OK)
+			clipboard->prefetchFormatId = CF_UNICODETEXT;
+		return;
+	}
+}
+
+/* A paste waiting for the prefetched text continues with the response, otherwise it is only
+ * cached. Returns TRUE if the response is consumed. */
+static BOOL xf_cliprdr_prefetch_response(xfClipboard* clipboard,
+                                         const CLIPRDR_FORMAT_DATA_RESPONSE* formatDataResponse)
+{
+	WINPR_ASSERT(clipboard);
+	WINPR_ASSERT(formatDataResponse);
+
+	const UINT32 formatId = clipboard->prefetchFormatId;
+	const BOOL stale = clipboard->prefetchStale;
+	const BOOL respond = clipboard->prefetchRespond;
+
+	clipboard->prefetchFormatId = 0;
+	clipboard->prefetchStale = FALSE;
+	clipboard->prefetchRespond = FALSE;
+
+	if (respond)
+		return FALSE;
+
+	if (!stale && (formatDataResponse->common.msgFlags == CB_RESPONSE_OK))
+		xf_cliprdr_cache_raw_data(clipboard, formatId, formatDataResponse->requestedFormatData,
+		                          formatDataResponse->common.dataLen);
+
+	if (clipboard->prefetchDeferred)
+		xf_cliprdr_prefetch_text(clipboard);
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -1994,10 +2096,16 @@ static UINT xf_cliprdr_server_format_list(CliprdrClientContext* context,
 
 	xf_lock_x11(xfc);
 
+	/* a response still due is for the previous format list */
+	const BOOL requestPending = clipboard->respond && !clipboard->prefetchRespond;
+
 	/* Clear the active SelectionRequest, as it is now invalid */
 	free(clipboard->respond);
 	clipboard->respond = NULL;
 
+	clipboard->prefetchStale = (clipboard->prefetchFormatId != 0);
+	clipboard->prefetchRespond = FALSE;
+
 	xf_clipboard_formats_free(clipboard);
 	xf_cliprdr_clear_cached_data(clipboard);
 	requested_format_free(&clipboard->requestedFormat);
@@ -2078,6 +2186,11 @@ static UINT xf_cliprdr_server_format_list(CliprdrClientContext* context,
 	else
 		xf_cliprdr_prepare_to_set_selection_owner(xfc, clipboard);
 
+	if (requestPending)
+		clipboard->prefetchDeferred = TRUE;
+	else
+		xf_cliprdr_prefetch_text(clipboard);
+
 out:
 	xf_unlock_x11(xfc);
 
@@ -2180,16 +2293,27 @@ xf_cliprdr_server_format_data_response(CliprdrClientContext* context,
 	size = formatDataResponse->common.dataLen;
 	data = formatDataResponse->requestedFormatData;
 
+	/* the prefetch was requested first, so it is answered first */
+	if ((clipboard->prefetchFormatId != 0) &&
+	    xf_cliprdr_prefetch_response(clipboard, formatDataResponse))
+		return CHANNEL_RC_OK;
+
 	if (formatDataResponse->common.msgFlags == CB_RESPONSE_FAIL)
 	{
 		WLog_WARN(TAG, "Format Data Response PDU msgFlags is CB_RESPONSE_FAIL");
 		free(clipboard->respond);
 		clipboard->respond = NULL;
+		if (clipboard->prefetchDeferred)
+			xf_cliprdr_prefetch_text(clipboard);
 		return CHANNEL_RC_OK;
 	}
 
 	if (!clipboard->respond)
+	{
+		if (clipboard->prefetchDeferred)
+			xf_cliprdr_prefetch_text(clipboard);
 		return CHANNEL_RC_OK;
+	}
 
 	pDstData = NULL;
 	DstSize = 0;
@@ -2336,24 +2460,10 @@ xf_cliprdr_server_format_data_response(CliprdrClientContext* context,
 	}
 
 	/* We have to copy the original data again, as pSrcData is now owned
-	 * by clipboard->system. Memory allocation failure is not fatal here
-	 * as this is only a cached value. */
-	{
-		// clipboard->cachedData owns cached_data
-		// NOLINTNEXTLINE(clang-analyzer-unix.Malloc
-		xfCachedData* cached_raw_data = xf_cached_data_new_copy(data, size);
-		if (!cached_raw_data)
-			WLog_WARN(TAG, "Failed to allocate cache entry");
-		else
-		{
-			if (!HashTable_Insert(clipboard->cachedRawData, (void*)(UINT_PTR)srcFormatId,
-			                      cached_raw_data))
-			{
-				WLog_WARN(TAG, "Failed to cache clipboard data");
-				xf_cached_data_free(cached_raw_data);
-			}
-		}
-	}
+	 * by clipboard->system. */
+	// clipboard->cachedData owns cached_data
+	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc
+	xf_cliprdr_cache_raw_data(clipboard, srcFormatId, data, size);
 
 	// clipboard->cachedRawData owns cached_raw_data
 	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
@@ -2372,6 +2482,8 @@ xf_cliprdr_server_format_data_response(CliprdrClientContext* context,
 	}
 	free(clipboard->respond);
 	clipboard->respond = NULL;
+	if (clipboard->prefetchDeferred)
+		xf_cliprdr_prefetch_text(clipboard);
 	return CHANNEL_RC_OK;
 }
 
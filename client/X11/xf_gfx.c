@@ -32,8 +32,187 @@
 
 #include <X11/Xutil.h>
 
+#if defined(WITH_XSHM)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
 #define TAG CLIENT_TAG("x11")
 
+#if defined(WITH_XSHM)
+static BOOL xf_shm_error = FALSE;
+
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	WINPR_UNUSED(display);
+	WINPR_UNUSED(event);
+
+	xf_shm_error = TRUE;
+	return 0;
+}
+
+static void xf_shm_buffer_free(xfContext* xfc, xfGfxShmBuffer* buffer)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(buffer);
+
+	if (buffer->attached)
+		XShmDetach(xfc->display, &buffer->info);
+	if (buffer->info.shmaddr && (buffer->info.shmaddr != (char*)-1))
+		(void)shmdt(buffer->info.shmaddr);
+	if (buffer->image)
+	{
+		buffer->image->data = NULL;
+		XDestroyImage(buffer->image);
+	}
+
+	memset(buffer, 0, sizeof(xfGfxShmBuffer));
+}
+
+static BOOL xf_shm_buffer_new(xfContext* xfc, xfGfxShmBuffer* buffer, const XImage* like)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(like);
+
+	buffer->image = XShmCreateImage(xfc->display, xfc->visual,
+	                                WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, NULL,
+	                                &buffer->info, WINPR_ASSERTING_INT_CAST(uint32_t, like->width),
+	                                WINPR_ASSERTING_INT_CAST(uint32_t, like->height));
+	if (!buffer->image || (buffer->image->bits_per_pixel != like->bits_per_pixel))
+		return FALSE;
+
+	const size_t size = 1ull * WINPR_ASSERTING_INT_CAST(size_t, buffer->image->bytes_per_line) *
+	                    WINPR_ASSERTING_INT_CAST(size_t, buffer->image->height);
+	buffer->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (buffer->info.shmid < 0)
+		return FALSE;
+
+	buffer->info.shmaddr = shmat(buffer->info.shmid, NULL, 0);
+	buffer->info.readOnly = True;
+	if (buffer->info.shmaddr == (char*)-1)
+	{
+		(void)shmctl(buffer->info.shmid, IPC_RMID, NULL);
+		return FALSE;
+	}
+	buffer->image->data = buffer->info.shmaddr;
+
+	/* attaching fails for remote displays, which must not end up in the default handler */
+	xf_lock_x11(xfc);
+	xf_shm_error = FALSE;
+	XErrorHandler handler = XSetErrorHandler(xf_shm_error_handler);
+	const Status status = XShmAttach(xfc->display, &buffer->info);
+	XSync(xfc->display, False);
+	XSetErrorHandler(handler);
+	buffer->attached = status && !xf_shm_error;
+	xf_unlock_x11(xfc);
+
+	/* the segment is released with the last detach */
+	(void)shmctl(buffer->info.shmid, IPC_RMID, NULL);
+	return buffer->attached;
+}
+
+static void xf_shm_free(xfContext* xfc, xfGfxSurface* surface)
+{
+	WINPR_ASSERT(surface);
+
+	for (size_t x = 0; x < ARRAYSIZE(surface->shm); x++)
+		xf_shm_buffer_free(xfc, &surface->shm[x]);
+	surface->shmEnabled = FALSE;
+}
+
+static void xf_shm_init(xfContext* xfc, xfGfxSurface* surface)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(surface->image);
+
+	if (!XShmQueryExtension(xfc->display))
+		return;
+
+	for (size_t x = 0; x < ARRAYSIZE(surface->shm); x++)
+	{
+		if (!xf_shm_buffer_new(xfc, &surface->shm[x], surface->image))
+		{
+			WLog_DBG(TAG, "MIT-SHM not usable, falling back to XPutImage");
+			xf_shm_free(xfc, surface);
+			return;
+		}
+	}
+	surface->shmEnabled = TRUE;
+}
+
+/* picks the segment for the next update, waiting only if the server may still read from it */
+static xfGfxShmBuffer* xf_shm_next(xfContext* xfc, xfGfxSurface* surface)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(surface);
+
+	if (!surface->shmEnabled)
+		return NULL;
+
+	surface->shmIndex = (surface->shmIndex + 1) % ARRAYSIZE(surface->shm);
+	xfGfxShmBuffer* buffer = &surface->shm[surface->shmIndex];
+
+	/* requests are processed in order, anything after the last put means it is done */
+	const unsigned long processed = LastKnownRequestProcessed(xfc->display);
+	if ((long)(processed - buffer->request) < 0)
+		XSync(xfc->display, False);
+	return buffer;
+}
+
+static void xf_shm_copy(const XImage* src, XImage* dst, UINT32 x, UINT32 y, UINT32 width,
+                        UINT32 height)
+{
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(dst);
+
+	const UINT32 w = WINPR_ASSERTING_INT_CAST(UINT32, dst->width);
+	const UINT32 h = WINPR_ASSERTING_INT_CAST(UINT32, dst->height);
+	if ((x >= w) || (y >= h))
+		return;
+
+	width = MIN(width, w - x);
+	height = MIN(height, h - y);
+
+	const size_t bpp = WINPR_ASSERTING_INT_CAST(size_t, src->bits_per_pixel) / 8;
+	const size_t srcStep = WINPR_ASSERTING_INT_CAST(size_t, src->bytes_per_line);
+	const size_t dstStep = WINPR_ASSERTING_INT_CAST(size_t, dst->bytes_per_line);
+	for (UINT32 line = y; line < y + height; line++)
+		memcpy(&dst->data[line * dstStep + x * bpp], &src->data[line * srcStep + x * bpp],
+		       width * bpp);
+}
+#endif
+
+static void xf_put_image(xfContext* xfc, xfGfxSurface* surface, void* shm, Drawable drawable,
+                         UINT32 nXSrc, UINT32 nYSrc, UINT32 nXDst, UINT32 nYDst, UINT32 width,
+                         UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(surface);
+
+#if defined(WITH_XSHM)
+	xfGfxShmBuffer* buffer = shm;
+	if (buffer)
+	{
+		xf_shm_copy(surface->image, buffer->image, nXSrc, nYSrc, width, height);
+		XShmPutImage(xfc->display, drawable, xfc->gc, buffer->image,
+		             WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
+		             WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
+		             width, height, False);
+		buffer->request = NextRequest(xfc->display) - 1;
+		return;
+	}
+#else
+	WINPR_UNUSED(shm);
+#endif
+
+	XPutImage(xfc->display, drawable, xfc->gc, surface->image,
+	          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
+	          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst), width,
+	          height);
+}
+
 static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
@@ -72,6 +251,12 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 	if (!(rects = region16_rects(&surface->gdi.invalidRegion, &nbRects)))
 		return CHANNEL_RC_OK;
 
+	void* shm = NULL;
+#if defined(WITH_XSHM)
+	if (nbRects > 0)
+		shm = xf_shm_next(xfc, surface);
+#endif
+
 	for (UINT32 x = 0; x < nbRects; x++)
 	{
 		const RECTANGLE_16* rect = &rects[x];
@@ -94,10 +279,8 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_put_image(xfc, surface, shm, xfc->primary, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			             dheight);
 			xf_lock_x11(xfc);
 			xf_rail_paint_surface(xfc, surface->gdi.windowId, rect);
 			xf_unlock_x11(xfc);
@@ -107,10 +290,8 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		    if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing) ||
 		        freerdp_settings_get_bool(settings, FreeRDP_MultiTouchGestures))
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_put_image(xfc, surface, shm, xfc->primary, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			             dheight);
 			xf_draw_screen(xfc, WINPR_ASSERTING_INT_CAST(int32_t, nXDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, nYDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, dwidth),
@@ -119,10 +300,8 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_put_image(xfc, surface, shm, xfc->drawable, nXSrc, nYSrc, nXDst, nYDst, dwidth,
+			             dheight);
 		}
 	}
 
@@ -130,7 +309,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 fail:
 	region16_clear(&surface->gdi.invalidRegion);
 	XSetClipMask(xfc->display, xfc->gc, None);
-	XSync(xfc->display, False);
+	/* shared segments are reused only once the server is done with them */
+	if (shm)
+		XFlush(xfc->display);
+	else
+		XSync(xfc->display, False);
 	return rc;
 }
 
@@ -184,6 +367,7 @@ static UINT xf_UpdateSurfaces(RdpgfxClientContext* context)
 
 	free(pSurfaceIds);
 	LeaveCriticalSection(&context->mux);
+	gdi_frame_presented(gdi);
 	return status;
 }
 
@@ -378,6 +562,10 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	surface->image->byte_order = LSBFirst;
 	surface->image->bitmap_bit_order = LSBFirst;
 
+#if defined(WITH_XSHM)
+	xf_shm_init(xfc, surface);
+#endif
+
 	region16_init(&surface->gdi.invalidRegion);
 
 	if (context->SetSurfaceData(context, surface->gdi.surfaceId, (void*)surface) != CHANNEL_RC_OK)
@@ -388,6 +576,9 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 
 	return CHANNEL_RC_OK;
 error_set_surface_data:
+#if defined(WITH_XSHM)
+	xf_shm_free(xfc, surface);
+#endif
 	surface->image->data = NULL;
 	XDestroyImage(surface->image);
 error_surface_image:
@@ -420,6 +611,10 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
+#endif
+#if defined(WITH_XSHM)
+		rdpGdi* gdi = (rdpGdi*)context->custom;
+		xf_shm_free((xfContext*)gdi->context, surface);
 #endif
 		surface->image->data = NULL;
 		XDestroyImage(surface->image);
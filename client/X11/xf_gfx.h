@@ -27,12 +27,30 @@
 
 #include <freerdp/gdi/gfx.h>
 
+#if defined(WITH_XSHM)
+#include <X11/extensions/XShm.h>
+
+typedef struct
+{
+	XShmSegmentInfo info;
+	XImage* image;
+	BOOL attached;
+	unsigned long request; /* the last put reading from the segment */
+} xfGfxShmBuffer;
+#endif
+
 struct xf_gfx_surface
 {
 	gdiGfxSurface gdi;
 	BYTE* stage;
 	UINT32 stageScanline;
 	XImage* image;
+#if defined(WITH_XSHM)
+	/* updates alternate between two shared segments instead of waiting for the server */
+	BOOL shmEnabled;
+	size_t shmIndex;
+	xfGfxShmBuffer shm[2];
+#endif
 };
 typedef struct xf_gfx_surface xfGfxSurface;
 
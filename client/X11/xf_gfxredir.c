@@ -0,0 +1,145 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 Remote App Graphics Redirection
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <X11/Xutil.h>
+
+#include <winpr/assert.h>
+#include <freerdp/codec/color.h>
+
+#include "xf_gfxredir.h"
+#include "xf_graphics.h"
+#include "xf_rail.h"
+#include "xf_window.h"
+
+#include <freerdp/log.h>
+#define TAG CLIENT_TAG("x11.gfxredir")
+
+/**
+ * Presents the dirty rectangle of a buffer straight from the shared memory the server
+ * rendered into. Only a buffer format the X server does not take is converted.
+ */
+static UINT xf_gfxredir_present_buffer(GfxRedirClientContext* gfxredir,
+                                       const GFXREDIR_PRESENT_BUFFER_PDU* presentBuffer,
+                                       const GFXREDIR_CLIENT_BUFFER* buffer)
+{
+	UINT rc = ERROR_INTERNAL_ERROR;
+	BYTE* converted = NULL;
+
+	WINPR_ASSERT(gfxredir);
+	WINPR_ASSERT(presentBuffer);
+	WINPR_ASSERT(buffer);
+
+	xfContext* xfc = (xfContext*)gfxredir->custom;
+	WINPR_ASSERT(xfc);
+
+	const RECTANGLE_32* rect = &presentBuffer->dirtyRect;
+	if ((rect->width == 0) || (rect->height == 0))
+		return CHANNEL_RC_OK;
+
+	const UINT32 format = xf_get_local_color_format(xfc, TRUE);
+	const BYTE* data = buffer->data;
+	UINT32 stride = buffer->stride;
+	UINT32 x = rect->left;
+	UINT32 y = rect->top;
+
+	if (!FreeRDPAreColorFormatsEqualNoAlpha(format, buffer->format))
+	{
+		stride = rect->width * FreeRDPGetBytesPerPixel(format);
+		converted = calloc(rect->height, stride);
+		if (!converted)
+			return CHANNEL_RC_NO_MEMORY;
+
+		if (!freerdp_image_copy_no_overlap(converted, format, stride, 0, 0, rect->width,
+		                                   rect->height, buffer->data, buffer->format,
+		                                   buffer->stride, rect->left, rect->top, NULL,
+		                                   FREERDP_FLIP_NONE))
+			goto out;
+
+		data = converted;
+		x = 0;
+		y = 0;
+	}
+
+	xf_lock_x11(xfc);
+
+	xfAppWindow* appWindow = xf_rail_get_window(xfc, presentBuffer->windowId);
+	if (!appWindow)
+	{
+		WLog_VRB(TAG, "Failed to find a window for id=0x%08" PRIx64, presentBuffer->windowId);
+		rc = CHANNEL_RC_OK;
+		goto unlock;
+	}
+
+	const UINT32 width = converted ? rect->width : buffer->width;
+	const UINT32 height = converted ? rect->height : buffer->height;
+
+	WINPR_ASSERT(xfc->depth != 0);
+	XImage* image = XCreateImage(xfc->display, xfc->visual,
+	                             WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
+	                             (char*)data, width, height, xfc->scanline_pad,
+	                             WINPR_ASSERTING_INT_CAST(int, stride));
+	if (!image)
+	{
+		WLog_WARN(TAG, "Failed create a XImage[%" PRIu32 "x%" PRIu32 "] for window id=0x%08" PRIx64,
+		          width, height, presentBuffer->windowId);
+		goto unlock;
+	}
+
+	image->byte_order = LSBFirst;
+	image->bitmap_bit_order = LSBFirst;
+
+	/* Xlib has taken the pixels once XPutImage returns, the buffer may be reused after that */
+	XPutImage(xfc->display, appWindow->pixmap, appWindow->gc, image,
+	          WINPR_ASSERTING_INT_CAST(int, x), WINPR_ASSERTING_INT_CAST(int, y),
+	          WINPR_ASSERTING_INT_CAST(int, rect->left), WINPR_ASSERTING_INT_CAST(int, rect->top),
+	          rect->width, rect->height);
+	XCopyArea(xfc->display, appWindow->pixmap, appWindow->handle, appWindow->gc,
+	          WINPR_ASSERTING_INT_CAST(int, rect->left), WINPR_ASSERTING_INT_CAST(int, rect->top),
+	          rect->width, rect->height, WINPR_ASSERTING_INT_CAST(int, rect->left),
+	          WINPR_ASSERTING_INT_CAST(int, rect->top));
+
+	/* the pixels belong to the shared memory pool, not to the image */
+	image->data = NULL;
+	XDestroyImage(image);
+	rc = CHANNEL_RC_OK;
+
+unlock:
+	XFlush(xfc->display);
+	xf_unlock_x11(xfc);
+out:
+	free(converted);
+	return rc;
+}
+
+void xf_gfxredir_init(xfContext* xfc, GfxRedirClientContext* gfxredir)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(gfxredir);
+
+	gfxredir->custom = (void*)xfc;
+	gfxredir->PresentBuffer = xf_gfxredir_present_buffer;
+}
+
+void xf_gfxredir_uninit(WINPR_ATTR_UNUSED xfContext* xfc, GfxRedirClientContext* gfxredir)
+{
+	WINPR_ASSERT(gfxredir);
+
+	gfxredir->PresentBuffer = NULL;
+	gfxredir->custom = NULL;
+}
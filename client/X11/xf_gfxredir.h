@@ -0,0 +1,28 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 Remote App Graphics Redirection
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_X11_GFXREDIR_H
+#define FREERDP_CLIENT_X11_GFXREDIR_H
+
+#include <freerdp/client/gfxredir.h>
+
+#include "xfreerdp.h"
+
+void xf_gfxredir_init(xfContext* xfc, GfxRedirClientContext* gfxredir);
+void xf_gfxredir_uninit(xfContext* xfc, GfxRedirClientContext* gfxredir);
+
+#endif /* FREERDP_CLIENT_X11_GFXREDIR_H */
@@ -356,8 +356,8 @@ static void xf_Pointer_Free(rdpContext* context, rdpPointer* pointer)
 static BOOL xf_Pointer_Set(rdpContext* context, rdpPointer* pointer)
 {
 	WLog_DBG(TAG, "%p", pointer);
-#ifdef WITH_XCURSOR
 	xfContext* xfc = (xfContext*)context;
+#ifdef WITH_XCURSOR
 	Window handle = xf_Pointer_get_window(xfc);
 
 	WINPR_ASSERT(xfc);
@@ -387,8 +387,8 @@ static BOOL xf_Pointer_Set(rdpContext* context, rdpPointer* pointer)
 static BOOL xf_Pointer_SetNull(rdpContext* context)
 {
 	WLog_DBG(TAG, "called");
-#ifdef WITH_XCURSOR
 	xfContext* xfc = (xfContext*)context;
+#ifdef WITH_XCURSOR
 	static Cursor nullcursor = None;
 	Window handle = xf_Pointer_get_window(xfc);
 	xf_lock_x11(xfc);
@@ -420,8 +420,8 @@ static BOOL xf_Pointer_SetNull(rdpContext* context)
 static BOOL xf_Pointer_SetDefault(rdpContext* context)
 {
 	WLog_DBG(TAG, "called");
-#ifdef WITH_XCURSOR
 	xfContext* xfc = (xfContext*)context;
+#ifdef WITH_XCURSOR
 	Window handle = xf_Pointer_get_window(xfc);
 	xf_lock_x11(xfc);
 	xfc->pointer = NULL;
@@ -58,6 +58,7 @@ struct xf_rail_icon
 {
 	long* data;
 	int length;
+	UINT64 hash; /* of the icon info data was decoded from, 0 if none */
 };
 typedef struct xf_rail_icon xfRailIcon;
 
@@ -320,6 +321,111 @@ static void window_state_log_style_int(wLog* log, const WINDOW_STATE_ORDER* wind
 
 /* RemoteApp Core Protocol Extension */
 
+/* Applies the window orders received since the last EndPaint to the X window */
+static void xf_rail_window_apply(xfContext* xfc, xfAppWindow* appWindow)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(appWindow);
+
+	const UINT32 fieldFlags = appWindow->pendingFlags;
+	appWindow->pendingFlags = 0;
+
+	const BOOL position_or_size_updated =
+	    (fieldFlags &
+	     (WINDOW_ORDER_FIELD_WND_OFFSET | WINDOW_ORDER_FIELD_WND_SIZE |
+	      WINDOW_ORDER_FIELD_CLIENT_AREA_OFFSET | WINDOW_ORDER_FIELD_CLIENT_AREA_SIZE |
+	      WINDOW_ORDER_FIELD_WND_CLIENT_DELTA | WINDOW_ORDER_FIELD_VIS_OFFSET |
+	      WINDOW_ORDER_FIELD_VISIBILITY)) != 0;
+
+	if (fieldFlags & WINDOW_ORDER_FIELD_SHOW)
+	{
+		xf_ShowWindow(xfc, appWindow, WINPR_ASSERTING_INT_CAST(UINT8, appWindow->showState));
+	}
+
+	if (fieldFlags & WINDOW_ORDER_FIELD_TITLE)
+	{
+		if (appWindow->title)
+			xf_SetWindowText(xfc, appWindow, appWindow->title);
+	}
+
+	if (position_or_size_updated)
+	{
+		const INT32 visibilityRectsOffsetX =
+		    (appWindow->visibleOffsetX -
+		     (appWindow->clientOffsetX - appWindow->windowClientDeltaX));
+		const INT32 visibilityRectsOffsetY =
+		    (appWindow->visibleOffsetY -
+		     (appWindow->clientOffsetY - appWindow->windowClientDeltaY));
+
+		/*
+		 * The rail server like to set the window to a small size when it is minimized even though
+		 * it is hidden in some cases this can cause the window not to restore back to its original
+		 * size. Therefore we don't update our local window when that rail window state is minimized
+		 */
+		if (appWindow->rail_state != WINDOW_SHOW_MINIMIZED)
+		{
+			/* Redraw window area if already in the correct position */
+			if (appWindow->x == (INT64)appWindow->windowOffsetX &&
+			    appWindow->y == (INT64)appWindow->windowOffsetY &&
+			    appWindow->width == (INT64)appWindow->windowWidth &&
+			    appWindow->height == (INT64)appWindow->windowHeight)
+			{
+				xf_UpdateWindowArea(xfc, appWindow, 0, 0,
+				                    WINPR_ASSERTING_INT_CAST(int, appWindow->windowWidth),
+				                    WINPR_ASSERTING_INT_CAST(int, appWindow->windowHeight));
+			}
+			else
+			{
+				xf_MoveWindow(xfc, appWindow, appWindow->windowOffsetX, appWindow->windowOffsetY,
+				              WINPR_ASSERTING_INT_CAST(int, appWindow->windowWidth),
+				              WINPR_ASSERTING_INT_CAST(int, appWindow->windowHeight));
+			}
+
+			xf_SetWindowVisibilityRects(
+			    xfc, appWindow, WINPR_ASSERTING_INT_CAST(uint32_t, visibilityRectsOffsetX),
+			    WINPR_ASSERTING_INT_CAST(uint32_t, visibilityRectsOffsetY),
+			    appWindow->visibilityRects,
+			    WINPR_ASSERTING_INT_CAST(int, appWindow->numVisibilityRects));
+		}
+
+		if (appWindow->rail_state == WINDOW_SHOW_MAXIMIZED)
+		{
+			xf_SendClientEvent(xfc, appWindow->handle, xfc->NET_WM_STATE, 4, NET_WM_STATE_ADD,
+			                   xfc->NET_WM_STATE_MAXIMIZED_VERT, xfc->NET_WM_STATE_MAXIMIZED_HORZ,
+			                   0, 0);
+		}
+	}
+
+	if (fieldFlags & (WINDOW_ORDER_STATE_NEW | WINDOW_ORDER_FIELD_STYLE))
+		xf_SetWindowStyle(xfc, appWindow, appWindow->dwStyle, appWindow->dwExStyle);
+
+	/* We should only be using the visibility rects for shaping the window */
+	/*if (fieldFlags & WINDOW_ORDER_FIELD_WND_RECTS)
+	{
+	    xf_SetWindowRects(xfc, appWindow, appWindow->windowRects, appWindow->numWindowRects);
+	}*/
+}
+
+static BOOL rail_flush_fn(WINPR_ATTR_UNUSED const void* pvkey, void* value, void* pvarg)
+{
+	xfAppWindow* appWindow = value;
+	WINPR_ASSERT(appWindow);
+
+	if (appWindow->pendingFlags != 0)
+		xf_rail_window_apply(pvarg, appWindow);
+	return TRUE;
+}
+
+BOOL xf_rail_flush(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->railWindows)
+		return TRUE;
+
+	return HashTable_Foreach(xfc->railWindows, rail_flush_fn, xfc);
+}
+
 static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO* orderInfo,
                                   const WINDOW_STATE_ORDER* windowState)
 {
@@ -331,7 +437,6 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 	WINPR_ASSERT(windowState);
 
 	UINT32 fieldFlags = orderInfo->fieldFlags;
-	BOOL position_or_size_updated = FALSE;
 	appWindow = xf_rail_get_window(xfc, orderInfo->windowId);
 
 	if (fieldFlags & WINDOW_ORDER_STATE_NEW)
@@ -394,18 +499,6 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 	if (!appWindow)
 		return FALSE;
 
-	/* Keep track of any position/size update so that we can force a refresh of the window */
-	if ((fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_WND_SIZE) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_CLIENT_AREA_SIZE) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_WND_CLIENT_DELTA) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_VIS_OFFSET) ||
-	    (fieldFlags & WINDOW_ORDER_FIELD_VISIBILITY))
-	{
-		position_or_size_updated = TRUE;
-	}
-
 	/* Update Parameters */
 
 	if (fieldFlags & WINDOW_ORDER_FIELD_WND_OFFSET)
@@ -548,79 +641,8 @@ static BOOL xf_rail_window_common(rdpContext* context, const WINDOW_ORDER_INFO*
 		}
 	}
 
-	/* Update Window */
-
-	if (fieldFlags & WINDOW_ORDER_FIELD_STYLE)
-	{
-	}
-
-	if (fieldFlags & WINDOW_ORDER_FIELD_SHOW)
-	{
-		xf_ShowWindow(xfc, appWindow, WINPR_ASSERTING_INT_CAST(UINT8, appWindow->showState));
-	}
-
-	if (fieldFlags & WINDOW_ORDER_FIELD_TITLE)
-	{
-		if (appWindow->title)
-			xf_SetWindowText(xfc, appWindow, appWindow->title);
-	}
-
-	if (position_or_size_updated)
-	{
-		const INT32 visibilityRectsOffsetX =
-		    (appWindow->visibleOffsetX -
-		     (appWindow->clientOffsetX - appWindow->windowClientDeltaX));
-		const INT32 visibilityRectsOffsetY =
-		    (appWindow->visibleOffsetY -
-		     (appWindow->clientOffsetY - appWindow->windowClientDeltaY));
-
-		/*
-		 * The rail server like to set the window to a small size when it is minimized even though
-		 * it is hidden in some cases this can cause the window not to restore back to its original
-		 * size. Therefore we don't update our local window when that rail window state is minimized
-		 */
-		if (appWindow->rail_state != WINDOW_SHOW_MINIMIZED)
-		{
-			/* Redraw window area if already in the correct position */
-			if (appWindow->x == (INT64)appWindow->windowOffsetX &&
-			    appWindow->y == (INT64)appWindow->windowOffsetY &&
-			    appWindow->width == (INT64)appWindow->windowWidth &&
-			    appWindow->height == (INT64)appWindow->windowHeight)
-			{
-				xf_UpdateWindowArea(xfc, appWindow, 0, 0,
-				                    WINPR_ASSERTING_INT_CAST(int, appWindow->windowWidth),
-				                    WINPR_ASSERTING_INT_CAST(int, appWindow->windowHeight));
-			}
-			else
-			{
-				xf_MoveWindow(xfc, appWindow, appWindow->windowOffsetX, appWindow->windowOffsetY,
-				              WINPR_ASSERTING_INT_CAST(int, appWindow->windowWidth),
-				              WINPR_ASSERTING_INT_CAST(int, appWindow->windowHeight));
-			}
-
-			xf_SetWindowVisibilityRects(
-			    xfc, appWindow, WINPR_ASSERTING_INT_CAST(uint32_t, visibilityRectsOffsetX),
-			    WINPR_ASSERTING_INT_CAST(uint32_t, visibilityRectsOffsetY),
-			    appWindow->visibilityRects,
-			    WINPR_ASSERTING_INT_CAST(int, appWindow->numVisibilityRects));
-		}
-
-		if (appWindow->rail_state == WINDOW_SHOW_MAXIMIZED)
-		{
-			xf_SendClientEvent(xfc, appWindow->handle, xfc->NET_WM_STATE, 4, NET_WM_STATE_ADD,
-			                   xfc->NET_WM_STATE_MAXIMIZED_VERT, xfc->NET_WM_STATE_MAXIMIZED_HORZ,
-			                   0, 0);
-		}
-	}
-
-	if (fieldFlags & (WINDOW_ORDER_STATE_NEW | WINDOW_ORDER_FIELD_STYLE))
-		xf_SetWindowStyle(xfc, appWindow, appWindow->dwStyle, appWindow->dwExStyle);
-
-	/* We should only be using the visibility rects for shaping the window */
-	/*if (fieldFlags & WINDOW_ORDER_FIELD_WND_RECTS)
-	{
-	    xf_SetWindowRects(xfc, appWindow, appWindow->windowRects, appWindow->numWindowRects);
-	}*/
+	/* The X window is updated once per EndPaint, see xf_rail_flush */
+	appWindow->pendingFlags |= fieldFlags;
 	return TRUE;
 }
 
@@ -751,6 +773,67 @@ error:
 	return FALSE;
 }
 
+static UINT64 rail_icon_hash_data(UINT64 hash, const void* data, size_t length)
+{
+	const BYTE* bytes = data;
+
+	/* FNV-1a */
+	for (size_t x = 0; x < length; x++)
+	{
+		hash ^= bytes[x];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static UINT64 rail_icon_hash(const ICON_INFO* iconInfo)
+{
+	WINPR_ASSERT(iconInfo);
+
+	const UINT32 header[] = { iconInfo->bpp, iconInfo->width, iconInfo->height,
+		                      iconInfo->cbColorTable, iconInfo->cbBitsMask,
+		                      iconInfo->cbBitsColor };
+	UINT64 hash = rail_icon_hash_data(0xcbf29ce484222325ull, header, sizeof(header));
+	if (iconInfo->colorTable)
+		hash = rail_icon_hash_data(hash, iconInfo->colorTable, iconInfo->cbColorTable);
+	if (iconInfo->bitsMask)
+		hash = rail_icon_hash_data(hash, iconInfo->bitsMask, iconInfo->cbBitsMask);
+	if (iconInfo->bitsColor)
+		hash = rail_icon_hash_data(hash, iconInfo->bitsColor, iconInfo->cbBitsColor);
+	return (hash != 0) ? hash : 1;
+}
+
+/* Servers resend the same icons for every window of an application, look for an icon
+ * that was already decoded from the same data before decoding it again */
+static BOOL RailIconCache_Reuse(xfRailIconCache* cache, xfRailIcon* icon, UINT64 hash)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(icon);
+
+	if (icon->data && (icon->hash == hash))
+		return TRUE;
+
+	const size_t count = 1ull * cache->numCaches * cache->numCacheEntries;
+	for (size_t x = 0; x <= count; x++)
+	{
+		const xfRailIcon* cur = (x < count) ? &cache->entries[x] : &cache->scratch;
+		if ((cur == icon) || !cur->data || (cur->hash != hash))
+			continue;
+
+		const size_t size = sizeof(long) * WINPR_ASSERTING_INT_CAST(size_t, cur->length);
+		long* data = realloc(icon->data, size);
+		if (!data)
+			return FALSE;
+
+		memcpy(data, cur->data, size);
+		icon->data = data;
+		icon->length = cur->length;
+		icon->hash = hash;
+		return TRUE;
+	}
+	return FALSE;
+}
+
 static void xf_rail_set_window_icon(xfContext* xfc, xfAppWindow* railWindow, xfRailIcon* icon,
                                     BOOL replace)
 {
@@ -785,10 +868,16 @@ static BOOL xf_rail_window_icon(rdpContext* context, const WINDOW_ORDER_INFO* or
 		return FALSE;
 	}
 
-	if (!convert_rail_icon(windowIcon->iconInfo, icon))
+	const UINT64 hash = rail_icon_hash(windowIcon->iconInfo);
+	if (!RailIconCache_Reuse(xfc->railIconCache, icon, hash))
 	{
-		WLog_WARN(TAG, "failed to convert icon for window %08X", orderInfo->windowId);
-		return FALSE;
+		icon->hash = 0;
+		if (!convert_rail_icon(windowIcon->iconInfo, icon))
+		{
+			WLog_WARN(TAG, "failed to convert icon for window %08X", orderInfo->windowId);
+			return FALSE;
+		}
+		icon->hash = hash;
 	}
 
 	replaceIcon = !!(orderInfo->fieldFlags & WINDOW_ORDER_STATE_NEW);
@@ -153,6 +153,7 @@ struct xf_app_window
 	BOOL maxHorz;
 	BOOL minimized;
 	BOOL rail_ignore_configure;
+	UINT32 pendingFlags; /* window order fields not yet applied to the X window */
 
 	Pixmap pixmap;
 	XImage* image;
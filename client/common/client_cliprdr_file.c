@@ -68,14 +68,43 @@
 #endif
 
 #if defined(WITH_FUSE)
+/* FUSE reads are answered from up to this many range requests kept in flight per file */
+#define CLIPRDR_FUSE_READ_AHEAD_REQUESTS 4
+#define CLIPRDR_FUSE_READ_AHEAD_MIN_SIZE (256ULL * 1024ULL)
+#define CLIPRDR_FUSE_READ_AHEAD_MAX_SIZE (8ULL * 1024ULL * 1024ULL)
+#define CLIPRDR_FUSE_READ_AHEAD_MAX_CACHE (64ULL * 1024ULL * 1024ULL)
+
 typedef enum eFuseLowlevelOperationType
 {
 	FUSE_LL_OPERATION_NONE,
 	FUSE_LL_OPERATION_LOOKUP,
 	FUSE_LL_OPERATION_GETATTR,
 	FUSE_LL_OPERATION_READ,
+	FUSE_LL_OPERATION_READ_AHEAD,
 } FuseLowlevelOperationType;
 
+typedef enum
+{
+	FUSE_RANGE_MISSING,
+	FUSE_RANGE_PENDING,
+	FUSE_RANGE_AVAILABLE,
+} FuseRangeState;
+
+typedef struct
+{
+	UINT64 offset;
+	UINT32 size;
+	UINT32 stream_id;
+	BYTE* data; /* NULL while the request is in flight */
+} CliprdrFuseRange;
+
+typedef struct
+{
+	fuse_req_t fuse_req;
+	UINT64 offset;
+	UINT64 end;
+} CliprdrFuseRead;
+
 typedef struct sCliprdrFuseFile CliprdrFuseFile;
 
 struct sCliprdrFuseFile
@@ -99,6 +128,12 @@ struct sCliprdrFuseFile
 
 	BOOL has_clip_data_id;
 	UINT32 clip_data_id;
+
+	/* read-ahead: received and requested ranges sorted by offset, reads waiting for them */
+	wArrayList* ranges;
+	wArrayList* waiting_reads;
+	UINT64 read_ahead_offset;
+	UINT64 read_ahead_size;
 };
 
 typedef struct
@@ -196,6 +231,17 @@ struct cliprdr_file_context
 };
 
 #if defined(WITH_FUSE)
+static void fuse_range_free(void* data)
+{
+	CliprdrFuseRange* range = data;
+
+	if (!range)
+		return;
+
+	free(range->data);
+	free(range);
+}
+
 static void fuse_file_free(void* data)
 {
 	CliprdrFuseFile* fuse_file = data;
@@ -203,6 +249,16 @@ static void fuse_file_free(void* data)
 	if (!fuse_file)
 		return;
 
+	if (fuse_file->waiting_reads)
+	{
+		for (size_t x = 0; x < ArrayList_Count(fuse_file->waiting_reads); x++)
+		{
+			CliprdrFuseRead* read = ArrayList_GetItem(fuse_file->waiting_reads, x);
+			fuse_reply_err(read->fuse_req, EIO);
+		}
+		ArrayList_Free(fuse_file->waiting_reads);
+	}
+	ArrayList_Free(fuse_file->ranges);
 	ArrayList_Free(fuse_file->children);
 	free(fuse_file->filename_with_root);
 
@@ -218,12 +274,22 @@ static CliprdrFuseFile* fuse_file_new(void)
 		return NULL;
 
 	fuse_file->children = ArrayList_New(FALSE);
-	if (!fuse_file->children)
+	fuse_file->ranges = ArrayList_New(FALSE);
+	fuse_file->waiting_reads = ArrayList_New(FALSE);
+	if (!fuse_file->children || !fuse_file->ranges || !fuse_file->waiting_reads)
 	{
-		free(fuse_file);
+		fuse_file_free(fuse_file);
 		return NULL;
 	}
 
+	wObject* obj = ArrayList_Object(fuse_file->ranges);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = fuse_range_free;
+
+	obj = ArrayList_Object(fuse_file->waiting_reads);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = free;
+
 	return fuse_file;
 }
 
@@ -352,7 +418,8 @@ static BOOL maybe_clear_fuse_request(const void* key, void* value, void* arg)
 	DEBUG_CLIPRDR(file_context->log, "Clearing FileContentsRequest for file \"%s\"",
 	              fuse_file->filename_with_root);
 
-	fuse_reply_err(fuse_request->fuse_req, EIO);
+	if (fuse_request->fuse_req)
+		fuse_reply_err(fuse_request->fuse_req, EIO);
 	HashTable_Remove(file_context->request_table, key);
 
 	return TRUE;
@@ -910,8 +977,10 @@ static void cliprdr_file_fuse_open(fuse_req_t fuse_req, fuse_ino_t fuse_ino,
 	fuse_reply_open(fuse_req, file_info);
 }
 
-static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
-                                     fuse_req_t fuse_req, off_t offset, size_t requested_size)
+static CliprdrFuseRequest* request_file_range(CliprdrFileContext* file_context,
+                                              CliprdrFuseFile* fuse_file, fuse_req_t fuse_req,
+                                              FuseLowlevelOperationType operation_type,
+                                              UINT64 offset, size_t requested_size)
 {
 	CLIPRDR_FILE_CONTENTS_REQUEST file_contents_request = { 0 };
 
@@ -919,12 +988,12 @@ static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFu
 	WINPR_ASSERT(fuse_file);
 
 	if (requested_size > UINT32_MAX)
-		return FALSE;
+		return NULL;
 
 	CliprdrFuseRequest* fuse_request =
-	    cliprdr_fuse_request_new(file_context, fuse_file, fuse_req, FUSE_LL_OPERATION_READ);
+	    cliprdr_fuse_request_new(file_context, fuse_file, fuse_req, operation_type);
 	if (!fuse_request)
-		return FALSE;
+		return NULL;
 
 	file_contents_request.common.msgType = CB_FILECONTENTS_REQUEST;
 	file_contents_request.streamId = fuse_request->stream_id;
@@ -943,20 +1012,280 @@ static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFu
 		           "Failed to send FileContentsRequest for file \"%s\"",
 		           fuse_file->filename_with_root);
 		HashTable_Remove(file_context->request_table, (void*)(uintptr_t)fuse_request->stream_id);
-		return FALSE;
+		return NULL;
 	}
 
 	// file_context->request_table owns fuse_request
 	// NOLINTBEGIN(clang-analyzer-unix.Malloc)
-	DEBUG_CLIPRDR(
-	    file_context->log,
-	    "Requested file range (%zu Bytes at offset %lu) for file \"%s\" with stream id %u",
-	    requested_size, offset, fuse_file->filename, fuse_request->stream_id);
+	DEBUG_CLIPRDR(file_context->log,
+	              "Requested file range (%zu Bytes at offset %" PRIu64
+	              ") for file \"%s\" with stream id %u",
+	              requested_size, offset, fuse_file->filename, fuse_request->stream_id);
 
-	return TRUE;
+	return fuse_request;
 	// NOLINTEND(clang-analyzer-unix.Malloc)
 }
 
+static BOOL request_file_range_async(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
+                                     fuse_req_t fuse_req, UINT64 offset, size_t requested_size)
+{
+	return request_file_range(file_context, fuse_file, fuse_req, FUSE_LL_OPERATION_READ, offset,
+	                          requested_size) != NULL;
+}
+
+static FuseRangeState fuse_file_range_state(CliprdrFuseFile* fuse_file, UINT64 offset, UINT64 end)
+{
+	FuseRangeState state = FUSE_RANGE_AVAILABLE;
+	UINT64 pos = offset;
+
+	WINPR_ASSERT(fuse_file);
+
+	for (size_t x = 0; (x < ArrayList_Count(fuse_file->ranges)) && (pos < end); x++)
+	{
+		const CliprdrFuseRange* range = ArrayList_GetItem(fuse_file->ranges, x);
+
+		if (range->offset + range->size <= pos)
+			continue;
+		if (range->offset > pos)
+			return FUSE_RANGE_MISSING;
+		if (!range->data)
+			state = FUSE_RANGE_PENDING;
+		pos = range->offset + range->size;
+	}
+
+	return (pos < end) ? FUSE_RANGE_MISSING : state;
+}
+
+/* the range [offset, end) must be available */
+static void fuse_file_reply_range(CliprdrFuseFile* fuse_file, fuse_req_t fuse_req, UINT64 offset,
+                                  UINT64 end)
+{
+	BYTE* buffer = NULL;
+	UINT64 pos = offset;
+
+	WINPR_ASSERT(fuse_file);
+
+	for (size_t x = 0; (x < ArrayList_Count(fuse_file->ranges)) && (pos < end); x++)
+	{
+		const CliprdrFuseRange* range = ArrayList_GetItem(fuse_file->ranges, x);
+		const UINT64 range_end = range->offset + range->size;
+
+		if (range_end <= pos)
+			continue;
+
+		WINPR_ASSERT(range->data);
+		const BYTE* data = &range->data[pos - range->offset];
+		const size_t length = (size_t)(MIN(end, range_end) - pos);
+
+		/* most reads fall into a single range, reply without a copy */
+		if ((pos == offset) && (range_end >= end))
+		{
+			fuse_reply_buf(fuse_req, (const char*)data, length);
+			return;
+		}
+
+		if (!buffer)
+		{
+			buffer = malloc((size_t)(end - offset));
+			if (!buffer)
+			{
+				fuse_reply_err(fuse_req, ENOMEM);
+				return;
+			}
+		}
+		memcpy(&buffer[pos - offset], data, length);
+		pos += length;
+	}
+
+	fuse_reply_buf(fuse_req, (const char*)buffer, (size_t)(end - offset));
+	free(buffer);
+}
+
+/* keep up to CLIPRDR_FUSE_READ_AHEAD_REQUESTS range requests in flight ahead of the reader */
+static void fuse_file_read_ahead(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file)
+{
+	size_t pending = 0;
+	UINT64 cached = 0;
+
+	WINPR_ASSERT(fuse_file);
+
+	for (size_t x = 0; x < ArrayList_Count(fuse_file->ranges); x++)
+	{
+		const CliprdrFuseRange* range = ArrayList_GetItem(fuse_file->ranges, x);
+		if (!range->data)
+			pending++;
+		cached += range->size;
+	}
+
+	while ((pending < CLIPRDR_FUSE_READ_AHEAD_REQUESTS) &&
+	       (cached < CLIPRDR_FUSE_READ_AHEAD_MAX_CACHE) &&
+	       (fuse_file->read_ahead_offset < fuse_file->size))
+	{
+		const UINT64 size =
+		    MIN(fuse_file->read_ahead_size, fuse_file->size - fuse_file->read_ahead_offset);
+		CliprdrFuseRange* range = calloc(1, sizeof(CliprdrFuseRange));
+		if (!range)
+			return;
+
+		range->offset = fuse_file->read_ahead_offset;
+		range->size = (UINT32)size;
+
+		CliprdrFuseRequest* fuse_request =
+		    request_file_range(file_context, fuse_file, NULL, FUSE_LL_OPERATION_READ_AHEAD,
+		                       range->offset, range->size);
+		if (!fuse_request)
+		{
+			free(range);
+			return;
+		}
+		range->stream_id = fuse_request->stream_id;
+
+		if (!ArrayList_Append(fuse_file->ranges, range))
+		{
+			free(range);
+			return;
+		}
+
+		fuse_file->read_ahead_offset += size;
+		cached += size;
+		pending++;
+
+		/* the reader is sequential, widen the window */
+		fuse_file->read_ahead_size =
+		    MIN(fuse_file->read_ahead_size * 2, CLIPRDR_FUSE_READ_AHEAD_MAX_SIZE);
+	}
+}
+
+static BOOL fuse_file_read(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
+                           fuse_req_t fuse_req, UINT64 offset, UINT64 end)
+{
+	WINPR_ASSERT(fuse_file);
+
+	if (offset >= end)
+	{
+		fuse_reply_buf(fuse_req, NULL, 0);
+		return TRUE;
+	}
+
+	/* a read outside of the window is a seek, start over from there */
+	const CliprdrFuseRange* first = ArrayList_GetItem(fuse_file->ranges, 0);
+	const UINT64 start = first ? first->offset : fuse_file->read_ahead_offset;
+	if ((fuse_file->read_ahead_size == 0) || (offset < start) ||
+	    (offset > fuse_file->read_ahead_offset))
+	{
+		ArrayList_Clear(fuse_file->ranges);
+		fuse_file->read_ahead_offset = offset;
+		const UINT64 length = MIN(end - offset, CLIPRDR_FUSE_READ_AHEAD_MAX_SIZE);
+		fuse_file->read_ahead_size = MAX(CLIPRDR_FUSE_READ_AHEAD_MIN_SIZE, length);
+	}
+
+	/* the reader moved on, drop what it has consumed */
+	while (ArrayList_Count(fuse_file->ranges) > 0)
+	{
+		const CliprdrFuseRange* range = ArrayList_GetItem(fuse_file->ranges, 0);
+		if (!range->data || (range->offset + range->size > offset))
+			break;
+		ArrayList_RemoveAt(fuse_file->ranges, 0);
+	}
+
+	fuse_file_read_ahead(file_context, fuse_file);
+
+	switch (fuse_file_range_state(fuse_file, offset, end))
+	{
+		case FUSE_RANGE_AVAILABLE:
+			fuse_file_reply_range(fuse_file, fuse_req, offset, end);
+			return TRUE;
+		case FUSE_RANGE_PENDING:
+		{
+			CliprdrFuseRead* read = calloc(1, sizeof(CliprdrFuseRead));
+			if (!read)
+				return FALSE;
+
+			read->fuse_req = fuse_req;
+			read->offset = offset;
+			read->end = end;
+			if (!ArrayList_Append(fuse_file->waiting_reads, read))
+			{
+				free(read);
+				return FALSE;
+			}
+			return TRUE;
+		}
+		case FUSE_RANGE_MISSING:
+		default:
+			/* a short response left a gap, or the read-ahead could not be sent */
+			return request_file_range_async(file_context, fuse_file, fuse_req, offset,
+			                                (size_t)(end - offset));
+	}
+}
+
+static void fuse_file_range_received(CliprdrFileContext* file_context, CliprdrFuseFile* fuse_file,
+                                     UINT32 stream_id,
+                                     const CLIPRDR_FILE_CONTENTS_RESPONSE* file_contents_response)
+{
+	CliprdrFuseRange* range = NULL;
+	size_t index = 0;
+	BOOL failed = TRUE;
+
+	WINPR_ASSERT(fuse_file);
+
+	for (; index < ArrayList_Count(fuse_file->ranges); index++)
+	{
+		CliprdrFuseRange* cur = ArrayList_GetItem(fuse_file->ranges, index);
+		if (!cur->data && (cur->stream_id == stream_id))
+		{
+			range = cur;
+			break;
+		}
+	}
+
+	/* dropped by a seek */
+	if (!range)
+		return;
+
+	if (file_contents_response && (file_contents_response->cbRequested > 0))
+	{
+		const UINT32 size = MIN(range->size, file_contents_response->cbRequested);
+		range->data = malloc(size);
+		if (range->data)
+		{
+			memcpy(range->data, file_contents_response->requestedData, size);
+			range->size = size;
+			range->stream_id = 0;
+			failed = FALSE;
+		}
+	}
+
+	if (failed)
+		ArrayList_RemoveAt(fuse_file->ranges, index);
+
+	for (size_t x = 0; x < ArrayList_Count(fuse_file->waiting_reads);)
+	{
+		CliprdrFuseRead* read = ArrayList_GetItem(fuse_file->waiting_reads, x);
+
+		switch (fuse_file_range_state(fuse_file, read->offset, read->end))
+		{
+			case FUSE_RANGE_PENDING:
+				x++;
+				continue;
+			case FUSE_RANGE_AVAILABLE:
+				fuse_file_reply_range(fuse_file, read->fuse_req, read->offset, read->end);
+				break;
+			case FUSE_RANGE_MISSING:
+			default:
+				if (failed ||
+				    !request_file_range_async(file_context, fuse_file, read->fuse_req, read->offset,
+				                              (size_t)(read->end - read->offset)))
+					fuse_reply_err(read->fuse_req, EIO);
+				break;
+		}
+		ArrayList_RemoveAt(fuse_file->waiting_reads, x);
+	}
+
+	if (!failed)
+		fuse_file_read_ahead(file_context, fuse_file);
+}
+
 static void cliprdr_file_fuse_read(fuse_req_t fuse_req, fuse_ino_t fuse_ino, size_t size,
                                    off_t offset, WINPR_ATTR_UNUSED struct fuse_file_info* file_info)
 {
@@ -986,9 +1315,10 @@ static void cliprdr_file_fuse_read(fuse_req_t fuse_req, fuse_ino_t fuse_ino, siz
 		return;
 	}
 
-	size = MIN(size, 8ULL * 1024ULL * 1024ULL);
+	size = MIN(size, CLIPRDR_FUSE_READ_AHEAD_MAX_SIZE);
 
-	result = request_file_range_async(file_context, fuse_file, fuse_req, offset, size);
+	const UINT64 end = MIN((UINT64)offset + size, fuse_file->size);
+	result = fuse_file_read(file_context, fuse_file, fuse_req, (UINT64)offset, end);
 	HashTable_Unlock(file_context->inode_table);
 
 	if (!result)
@@ -1199,6 +1529,22 @@ static UINT cliprdr_file_context_server_file_contents_response(
 		return CHANNEL_RC_OK;
 	}
 
+	if (fuse_request->operation_type == FUSE_LL_OPERATION_READ_AHEAD)
+	{
+		const BOOL ok = (file_contents_response->common.msgFlags & CB_RESPONSE_OK) != 0;
+
+		DEBUG_CLIPRDR(file_context->log, "Received read-ahead for file \"%s\" with stream id %u",
+		              fuse_request->fuse_file->filename, file_contents_response->streamId);
+
+		fuse_file_range_received(file_context, fuse_request->fuse_file,
+		                         file_contents_response->streamId,
+		                         ok ? file_contents_response : NULL);
+		HashTable_Remove(file_context->request_table,
+		                 (void*)(uintptr_t)file_contents_response->streamId);
+		HashTable_Unlock(file_context->inode_table);
+		return CHANNEL_RC_OK;
+	}
+
 	if (!(file_contents_response->common.msgFlags & CB_RESPONSE_OK))
 	{
 		WLog_Print(file_context->log, WLOG_WARN,
@@ -2139,6 +2139,30 @@ static int parse_tls_secrets_file(rdpSettings* settings, const char* Value)
 	return 0;
 }
 
+static int parse_tls_kernel_offload(rdpSettings* settings)
+{
+	if (!freerdp_settings_set_bool(settings, FreeRDP_TlsKernelOffload, TRUE))
+		return COMMAND_LINE_ERROR;
+	return 0;
+}
+
+static int parse_tls_session_cache(rdpSettings* settings, const char* Value)
+{
+	if (!Value)
+		return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+
+	if (!freerdp_settings_set_string(settings, FreeRDP_TlsSessionCacheFile, Value))
+		return COMMAND_LINE_ERROR_MEMORY;
+	return 0;
+}
+
+static int parse_tls_no_resumption(rdpSettings* settings)
+{
+	if (!freerdp_settings_set_bool(settings, FreeRDP_TlsSessionResumption, FALSE))
+		return COMMAND_LINE_ERROR;
+	return 0;
+}
+
 static int parse_tls_enforce(rdpSettings* settings, const char* Value)
 {
 	UINT16 version = TLS1_2_VERSION;
@@ -2194,6 +2218,12 @@ static int parse_tls_cipher_options(rdpSettings* settings, const COMMAND_LINE_AR
 			rc = fail_at(arg, parse_tls_secrets_file(settings, &arg->Value[13]));
 		else if (option_starts_with("enforce:", arg->Value))
 			rc = fail_at(arg, parse_tls_enforce(settings, &arg->Value[8]));
+		else if (option_equals("kernel-offload", arg->Value))
+			rc = fail_at(arg, parse_tls_kernel_offload(settings));
+		else if (option_starts_with("session-cache:", arg->Value))
+			rc = fail_at(arg, parse_tls_session_cache(settings, &arg->Value[14]));
+		else if (option_equals("no-resumption", arg->Value))
+			rc = fail_at(arg, parse_tls_no_resumption(settings));
 	}
 
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
@@ -2360,6 +2390,16 @@ static int parse_gfx_options(rdpSettings* settings, const COMMAND_LINE_ARGUMENT_
 					                                    bval == PARSE_OFF))
 						rc = COMMAND_LINE_ERROR;
 				}
+				else if (option_starts_with("cache-budget:", val))
+				{
+					ULONGLONG v = 0;
+					const char* uv = &val[13];
+					if (!value_to_uint(uv, &v, 0, UINT32_MAX))
+						rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+					else if (!freerdp_settings_set_uint32(settings, FreeRDP_GfxCacheBudget,
+					                                      (UINT32)v))
+						rc = COMMAND_LINE_ERROR;
+				}
 				else
 					rc = COMMAND_LINE_ERROR;
 			}
@@ -2615,6 +2655,67 @@ static int parse_prevent_session_lock_options(rdpSettings* settings,
 	return 0;
 }
 
+static int parse_input_coalesce_options(rdpSettings* settings, const COMMAND_LINE_ARGUMENT_A* arg)
+{
+	WINPR_ASSERT(settings);
+	WINPR_ASSERT(arg);
+
+	LONGLONG val = 8;
+
+	if (arg->Flags & COMMAND_LINE_VALUE_PRESENT)
+	{
+		if (!value_to_int(arg->Value, &val, 0, 1000))
+			return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+	}
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_InputCoalesceInterval, (UINT32)val))
+		return COMMAND_LINE_ERROR_MEMORY;
+
+	return 0;
+}
+
+static int parse_tcp_latency_options(rdpSettings* settings, const COMMAND_LINE_ARGUMENT_A* arg)
+{
+	WINPR_ASSERT(settings);
+	WINPR_ASSERT(arg);
+
+	if (!freerdp_settings_set_bool(settings, FreeRDP_TcpLatencyMode, TRUE))
+		return COMMAND_LINE_ERROR;
+
+	if (!(arg->Flags & COMMAND_LINE_VALUE_PRESENT))
+		return 0;
+
+	int rc = 0;
+	size_t count = 0;
+	char** ptr = CommandLineParseCommaSeparatedValues(arg->Value, &count);
+	if (!ptr || (count == 0))
+		return COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+
+	for (size_t x = 0; (x < count) && (rc == 0); x++)
+	{
+		const char* val = ptr[x];
+
+		if (option_starts_with("lowat:", val))
+		{
+			ULONGLONG v = 0;
+			if (!value_to_uint(&val[6], &v, 0, UINT32_MAX))
+				rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+			else if (!freerdp_settings_set_uint32(settings, FreeRDP_TcpNotSentLowat, (UINT32)v))
+				rc = COMMAND_LINE_ERROR;
+		}
+		else if (option_starts_with("cc:", val))
+		{
+			if (!freerdp_settings_set_string(settings, FreeRDP_TcpCongestionControl, &val[3]))
+				rc = COMMAND_LINE_ERROR_MEMORY;
+		}
+		else
+			rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+	}
+
+	CommandLineParserFree(ptr);
+	return rc;
+}
+
 static int parse_vmconnect_options(rdpSettings* settings, const COMMAND_LINE_ARGUMENT_A* arg)
 {
 	WINPR_ASSERT(settings);
@@ -3160,6 +3261,19 @@ static int parse_clipboard_options(rdpSettings* settings, const COMMAND_LINE_ARG
 				                                 mask | bflags))
 					rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
 			}
+			else if (option_starts_with("prefetch", cur))
+			{
+				const UINT32 mask =
+				    freerdp_settings_get_uint32(settings, FreeRDP_ClipboardFeatureMask) &
+				    (uint32_t)~CLIPRDR_FLAG_PREFETCH_TEXT;
+				const PARSE_ON_OFF_RESULT bval = parse_on_off_option(cur);
+				if (bval == PARSE_FAIL)
+					rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+				else if (!freerdp_settings_set_uint32(
+				             settings, FreeRDP_ClipboardFeatureMask,
+				             mask | ((bval != PARSE_OFF) ? CLIPRDR_FLAG_PREFETCH_TEXT : 0)))
+					rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+			}
 			else
 				rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
 		}
@@ -3910,6 +4024,14 @@ static int parse_cache_options(rdpSettings* settings, const COMMAND_LINE_ARGUMEN
 			else if (!freerdp_settings_set_bool(settings, FreeRDP_BitmapCachePersistEnabled, TRUE))
 				rc = COMMAND_LINE_ERROR;
 		}
+		else if (option_starts_with("bitmap-budget:", val))
+		{
+			ULONGLONG v = 0;
+			if (!value_to_uint(&val[14], &v, 0, UINT32_MAX))
+				rc = COMMAND_LINE_ERROR_UNEXPECTED_VALUE;
+			else if (!freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheBudget, (UINT32)v))
+				rc = COMMAND_LINE_ERROR;
+		}
 		else
 		{
 			const PARSE_ON_OFF_RESULT bval = parse_on_off_option(val);
@@ -4892,6 +5014,11 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			                                      strlen(arg->Value)))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "local-shm")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_LocalShmTransport, enable))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 
 		CommandLineSwitchCase(arg, "compression")
 		{
@@ -4926,6 +5053,12 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			if (!freerdp_settings_set_bool(settings, FreeRDP_RedirectHomeDrive, enable))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "input-coalesce")
+		{
+			const int rc = parse_input_coalesce_options(settings, arg);
+			if (rc != 0)
+				return fail_at(arg, rc);
+		}
 		CommandLineSwitchCase(arg, "ipv4")
 		{
 			if (arg->Value != NULL && strncmp(arg->Value, str_force, ARRAYSIZE(str_force)) == 0)
@@ -5011,6 +5144,12 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			if (!freerdp_settings_set_bool(settings, FreeRDP_DisableMenuAnims, !enable))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "tcp-latency")
+		{
+			const int rc = parse_tcp_latency_options(settings, arg);
+			if (rc != 0)
+				return fail_at(arg, rc);
+		}
 		CommandLineSwitchCase(arg, "themes")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_DisableThemes, !enable))
@@ -5049,6 +5188,11 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			else
 				return fail_at(arg, COMMAND_LINE_ERROR_UNEXPECTED_VALUE);
 		}
+		CommandLineSwitchCase(arg, "gdi-monitors")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_GdiMonitorSurfaces, enable))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 		CommandLineSwitchCase(arg, "gfx")
 		{
 			int rc = parse_gfx_options(settings, arg);
@@ -5311,6 +5455,11 @@ static int parse_command_line(rdpSettings* settings, const COMMAND_LINE_ARGUMENT
 			if (!freerdp_settings_set_bool(settings, FreeRDP_AsyncChannels, enable))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "async-transport")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_AsyncTransport, enable))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 		CommandLineSwitchCase(arg, "wm-class")
 		{
 			if (!freerdp_settings_set_string(settings, FreeRDP_WmClass, arg->Value))
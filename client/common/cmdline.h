@@ -58,6 +58,8 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "Automatically request remote assistance input control" },
 	{ "async-channels", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "Asynchronous channels (experimental)" },
+	{ "async-transport", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Send PDUs from a dedicated writer thread once the session is active" },
 	{ "async-update", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "Asynchronous update" },
 	{ "audio-mode", COMMAND_LINE_VALUE_REQUIRED, "<mode>", NULL, NULL, -1, NULL,
@@ -86,7 +88,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  NULL, "Print the build configuration" },
 	{ "cache", COMMAND_LINE_VALUE_REQUIRED,
 	  "[bitmap[:on|off],codec[:rfx|nsc],glyph[:on|off],offscreen[:on|off],persist,persist-file:<"
-	  "filename>]",
+	  "filename>,bitmap-budget:<MiB>]",
 	  NULL, NULL, -1, NULL, "" },
 	{ "cert", COMMAND_LINE_VALUE_REQUIRED,
 	  "[deny,ignore,name:<name>,tofu,fingerprint:<hash>:<hash as hex>[,fingerprint:<hash>:<another "
@@ -123,13 +125,14 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "Client Hostname to send to server" },
 	{ "clipboard", COMMAND_LINE_VALUE_BOOL | COMMAND_LINE_VALUE_OPTIONAL,
 	  "[[use-selection:<atom>],[direction-to:[all|local|remote|off]],[files-to[:all|local|remote|"
-	  "off]]]",
+	  "off]],[prefetch[:on|off]]]",
 	  BoolValueTrue, NULL, -1, NULL,
 	  "Redirect clipboard:\n"
 	  " * use-selection:<atom>  ... (X11) Specify which X selection to access. Default is "
 	  "CLIPBOARD. PRIMARY is the X-style middle-click selection.\n"
 	  " * direction-to:[all|local|remote|off] control enabled clipboard direction\n"
-	  " * files-to:[all|local|remote|off] control enabled file clipboard direction" },
+	  " * files-to:[all|local|remote|off] control enabled file clipboard direction\n"
+	  " * prefetch[:on|off] (X11) fetch the text of a new remote clipboard before it is pasted" },
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
 	{ "codec-cache", COMMAND_LINE_VALUE_REQUIRED, "[rfx|nsc|jpeg]", NULL, NULL, -1, NULL,
 	  "[DEPRECATED, use /cache:codec:[rfx|nsc|jpeg]] Bitmap codec cache" },
@@ -196,6 +199,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "[DEPRECATED, use /gateway:d:<domain>] Gateway domain" },
 #endif
 	{ "gdi", COMMAND_LINE_VALUE_REQUIRED, "sw|hw", NULL, NULL, -1, NULL, "GDI rendering" },
+	{ "gdi-monitors", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Back only the monitor areas of a multi monitor desktop with memory, gaps between monitors "
+	  "are neither allocated nor presented" },
 	{ "geometry", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
 	  "Geometry tracking channel" },
 	{ "gestures", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
@@ -204,7 +210,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	{ "gfx", COMMAND_LINE_VALUE_OPTIONAL,
 	  "[[progressive[:on|off]|RFX[:on|off]|AVC420[:on|off]AVC444[:on|off]],mask:<value>,small-"
 	  "cache[:on|off],thin-client[:on|off],progressive[:on|"
-	  "off],frame-ack[:on|off]]",
+	  "off],frame-ack[:on|off],cache-budget:<MiB>]",
 	  NULL, NULL, -1, NULL, "RDP8 graphics pipeline" },
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
 	{ "gfx-h264", COMMAND_LINE_VALUE_OPTIONAL, "[[AVC420|AVC444],mask:<value>]", NULL, NULL, -1,
@@ -213,7 +219,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 #else
 	{ "gfx", COMMAND_LINE_VALUE_OPTIONAL,
 	  "[progressive[:on|off]|RFX[:on|off]|AVC420[:on|off]AVC444[:on|off]],mask:<value>,small-cache["
-	  ":on|off],thin-client[:on|off],progressive[:on|off]]",
+	  ":on|off],thin-client[:on|off],progressive[:on|off],cache-budget:<MiB>]",
 	  NULL, NULL, -1, NULL, "RDP8 graphics pipeline" },
 #endif
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
@@ -250,6 +256,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "Print help" },
 	{ "home-drive", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "Redirect user home as share" },
+	{ "input-coalesce", COMMAND_LINE_VALUE_OPTIONAL, "<ms>", NULL, NULL, -1, NULL,
+	  "Merge fast-path mouse motion for up to <ms> milliseconds and send it together with the "
+	  "next input event (default: 8 ms)" },
 	{ "ipv4", COMMAND_LINE_VALUE_OPTIONAL, "[:force]", NULL, NULL, -1, "4",
 	  "Prefer IPv4 A record over IPv6 AAAA record" },
 	{ "ipv6", COMMAND_LINE_VALUE_OPTIONAL, "[:force]", NULL, NULL, -1, "6",
@@ -306,6 +315,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "monitor|tune|timezones]",
 	  "List available options for subcommand", NULL, -1, NULL,
 	  "List available options for subcommand" },
+	{ "local-shm", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
+	  "Exchange data with a server on a unix domain socket (/v:<path>) through shared memory "
+	  "rings, the server must enable it as well. Combine with /sec:rdp to skip TLS" },
 	{ "log-filters", COMMAND_LINE_VALUE_REQUIRED, "<tag>:<level>[,<tag>:<level>[,...]]", NULL, NULL,
 	  -1, NULL, "Set logger filters, see wLog(7) for details" },
 	{ "log-level", COMMAND_LINE_VALUE_REQUIRED, "[OFF|FATAL|ERROR|WARN|INFO|DEBUG|TRACE]", NULL,
@@ -317,8 +329,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	{ "menu-anims", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueFalse, NULL, -1, NULL,
 	  "menu animations" },
 	{ "microphone", COMMAND_LINE_VALUE_OPTIONAL,
-	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>]", NULL, NULL, -1,
-	  "mic", "Audio input (microphone)" },
+	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>,][opus-frame:<"
+	  "ms>]",
+	  NULL, NULL, -1, "mic", "Audio input (microphone)" },
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
 	{ "smartcard-list", COMMAND_LINE_VALUE_FLAG | COMMAND_LINE_PRINT, NULL, NULL, NULL, -1, NULL,
 	  "[DEPRECATED, use /list:smartcard] List smartcard information" },
@@ -445,7 +458,7 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  -1, NULL, "Activates Smartcard (optional certificate) Logon authentication." },
 	{ "sound", COMMAND_LINE_VALUE_OPTIONAL,
 	  "[sys:<sys>,][dev:<dev>,][format:<format>,][rate:<rate>,][channel:<channel>,][latency:<"
-	  "latency>,][quality:<quality>]",
+	  "latency>,][stretch:<percent>,][quality:<quality>]",
 	  NULL, NULL, -1, "audio", "Audio output (sound)" },
 	{ "span", COMMAND_LINE_VALUE_FLAG, NULL, NULL, NULL, -1, NULL,
 	  "Span screen over multiple monitors" },
@@ -461,6 +474,11 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  "Deactivate all graphics decoding in the client session. Useful for load tests with many "
 	  "simultaneous connections" },
 	{ "t", COMMAND_LINE_VALUE_REQUIRED, "<title>", NULL, NULL, -1, "title", "Window title" },
+	{ "tcp-latency", COMMAND_LINE_VALUE_OPTIONAL, "[lowat:<bytes>,cc:<algorithm>]", NULL, NULL, -1,
+	  NULL,
+	  "Keep the socket send queue short for interactive use on congested links: limit unsent "
+	  "data to lowat bytes (default 16384), size the send buffer from the measured bandwidth "
+	  "delay product and optionally select a TCP congestion control algorithm" },
 	{ "themes", COMMAND_LINE_VALUE_BOOL, NULL, BoolValueTrue, NULL, -1, NULL, "themes" },
 	{ "timeout", COMMAND_LINE_VALUE_REQUIRED, "<time in ms>", "9000", NULL, -1, "timeout",
 	  "Advanced setting for high latency links: Adjust connection timeout, use if you encounter "
@@ -468,8 +486,9 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	{ "timezone", COMMAND_LINE_VALUE_REQUIRED, "<windows timezone>", NULL, NULL, -1, NULL,
 	  "Use supplied windows timezone for connection (requires server support), see /list:timezones "
 	  "for allowed values" },
-	{ "tls", COMMAND_LINE_VALUE_REQUIRED, "[ciphers|seclevel|secrets-file|enforce]", NULL, NULL, -1,
-	  NULL,
+	{ "tls", COMMAND_LINE_VALUE_REQUIRED,
+	  "[ciphers|seclevel|secrets-file|enforce|kernel-offload|session-cache|no-resumption]", NULL,
+	  NULL, -1, NULL,
 	  "TLS configuration options:"
 	  " * ciphers:[netmon|ma|<cipher names>]\n"
 	  " * seclevel:<level>, default: 1, range: [0-5] Override the default TLS security level, "
@@ -478,7 +497,12 @@ static const COMMAND_LINE_ARGUMENT_A global_cmd_args[] = {
 	  " * enforce[:[ssl3|1.0|1.1|1.2|1.3]] Force use of SSL/TLS version for a connection. Some "
 	  "servers have a buggy TLS "
 	  "version negotiation and might fail without this. Defaults to TLS 1.2 if no argument is "
-	  "supplied. Use 1.0 for windows 7" },
+	  "supplied. Use 1.0 for windows 7\n"
+	  " * kernel-offload Let the kernel encrypt outgoing TLS records (Linux kTLS, requires "
+	  "OpenSSL 3.0 or higher)\n"
+	  " * session-cache:<filename> Keep TLS sessions across client runs to resume them on the "
+	  "next connection. The file contains session keys\n"
+	  " * no-resumption Always do a full TLS handshake" },
 #if defined(WITH_FREERDP_DEPRECATED_COMMANDLINE)
 	{ "tls-ciphers", COMMAND_LINE_VALUE_REQUIRED, "[netmon|ma|ciphers]", NULL, NULL, -1, NULL,
 	  "[DEPRECATED, use /tls:ciphers] Allowed TLS ciphers" },
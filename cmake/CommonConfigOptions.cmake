@@ -16,6 +16,17 @@ if(WITH_VERBOSE_WINPR_ASSERT)
   add_compile_definitions(WITH_VERBOSE_WINPR_ASSERT)
 endif()
 
+# Log statements below this level are removed from the whole project
+set(WLOG_LEVELS "TRACE" "DEBUG" "INFO" "WARN" "ERROR" "FATAL")
+set(WITH_WLOG_MIN_LEVEL "TRACE" CACHE STRING "Compile out log statements below this level")
+set_property(CACHE WITH_WLOG_MIN_LEVEL PROPERTY STRINGS ${WLOG_LEVELS})
+list(FIND WLOG_LEVELS "${WITH_WLOG_MIN_LEVEL}" WLOG_MIN_LEVEL)
+if(WLOG_MIN_LEVEL LESS 0)
+  message(FATAL_ERROR "WITH_WLOG_MIN_LEVEL=${WITH_WLOG_MIN_LEVEL} not supported. Set to any of ${WLOG_LEVELS}")
+elseif(WLOG_MIN_LEVEL GREATER 0)
+  add_compile_definitions(WINPR_WLOG_MIN_LEVEL=${WLOG_MIN_LEVEL})
+endif()
+
 # known issue on android, thus disabled until we support newer CMake
 # https://github.com/android/ndk/issues/1444
 if(NOT ANDROID OR ("${CMAKE_VERSION}" GREATER_EQUAL "3.20.0"))
@@ -1,4 +1,5 @@
 include(CMakeDependentOption)
+include(CheckIncludeFiles)
 
 if((CMAKE_SYSTEM_PROCESSOR MATCHES "i386|i686|x86|AMD64") AND (CMAKE_SIZEOF_VOID_P EQUAL 4))
   set(TARGET_ARCH "x86")
@@ -22,6 +23,15 @@ option(WITH_MANPAGES "Generate manpages." ${MANPAGE_DEF})
 option(WITH_PROFILER "Compile profiler." OFF)
 option(WITH_GPROF "Compile with GProf profiler." OFF)
 
+check_include_files(sys/sdt.h HAVE_SYS_SDT_H)
+if(MSVC OR HAVE_SYS_SDT_H)
+  set(TRACEPOINTS_DEF ON)
+endif()
+option(WITH_TRACEPOINTS "Compile static tracepoints (USDT, TraceLogging)" ${TRACEPOINTS_DEF})
+if(WITH_TRACEPOINTS AND NOT WIN32 AND NOT HAVE_SYS_SDT_H)
+  message(FATAL_ERROR "WITH_TRACEPOINTS requires <sys/sdt.h> (systemtap sdt headers)")
+endif()
+
 option(WITH_JPEG "Use JPEG decoding." OFF)
 
 include(CompilerDetect)
@@ -54,6 +64,7 @@ option(WITH_SAMPLE "Build sample code" ON)
 option(WITH_CLIENT_COMMON "Build client common library" ON)
 cmake_dependent_option(WITH_CLIENT "Build client binaries" ON "WITH_CLIENT_COMMON" OFF)
 cmake_dependent_option(WITH_CLIENT_SDL "[experimental] Build SDL client " ON "WITH_CLIENT" OFF)
+cmake_dependent_option(WITH_CLIENT_LOAD "Build the headless multi session load generator" OFF "WITH_CLIENT" OFF)
 
 option(WITH_SERVER "Build server binaries" ON)
 
@@ -152,6 +163,10 @@ cmake_dependent_option(WITH_VAAPI_H264_ENCODING "Use FFMPEG VAAPI hardware H264
 if(WITH_VAAPI_H264_ENCODING)
   add_definitions("-DWITH_VAAPI_H264_ENCODING")
 endif()
+cmake_dependent_option(WITH_NVENC_H264_ENCODING "Use FFMPEG NVENC hardware H264 encoding" ON "WITH_VIDEO_FFMPEG" OFF)
+if(WITH_NVENC_H264_ENCODING)
+  add_definitions("-DWITH_NVENC_H264_ENCODING")
+endif()
 
 option(USE_VERSION_FROM_GIT_TAG "Extract FreeRDP version from git tag." ON)
 
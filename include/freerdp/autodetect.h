@@ -23,6 +23,7 @@
 
 #include <freerdp/api.h>
 #include <freerdp/types.h>
+#include <freerdp/timer.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -118,7 +119,17 @@ extern "C"
 		ALIGN64 FREERDP_AUTODETECT_STATE state; /* 9 */
 		ALIGN64 void* custom;                   /* 10 */
 		ALIGN64 wLog* log;                      /* 11 */
-		UINT64 paddingA[16 - 12];               /* 12 */
+		/* Continuous measurement (server side) */
+		ALIGN64 FreeRDP_TimerID continuousTimer; /** 12
+		                                          * @since version 3.16.0
+		                                          */
+		ALIGN64 UINT16 continuousSequence;       /** 13
+		                                          * @since version 3.16.0
+		                                          */
+		ALIGN64 BOOL continuousStarted;          /** 14
+		                                          * @since version 3.16.0
+		                                          */
+		UINT64 paddingA[16 - 15];                /* 15 */
 
 		ALIGN64 pRTTMeasureRequest RTTMeasureRequest;                       /* 16 */
 		ALIGN64 pRTTMeasureResponse RTTMeasureResponse;                     /* 17 */
@@ -137,6 +148,21 @@ extern "C"
 	};
 	FREERDP_API rdpAutoDetect* autodetect_get(rdpContext* context);
 
+	/** @brief Get the current estimate of the network characteristics
+	 *
+	 *  A server measuring continuously (\b FreeRDP_NetworkAutoDetectInterval) smooths the samples,
+	 *  a client reports what the server sent last. Every change is also announced with a
+	 *  \b NetworkCharacteristicsChange event.
+	 *
+	 *  @param context The RDP context to query
+	 *  @param result A pointer receiving the estimate, \b type denotes the valid fields
+	 *
+	 *  @return \b TRUE if an estimate is available, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL freerdp_autodetect_get_network_characteristics(
+	    rdpContext* context, rdpNetworkCharacteristicsResult* result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -81,6 +81,20 @@ extern "C"
 
 	FREERDP_API int persistent_cache_read_entry(rdpPersistentCache* persistent,
 	                                            PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief Position a cache opened for reading at the entry with the given index
+	 *
+	 *  Entries that are skipped are not read. Files opened for reading are memory mapped, the
+	 *  data of an entry read afterwards is a view that stays valid until the cache is closed.
+	 *
+	 *  @param persistent The cache
+	 *  @param index The entry index, less than \b persistent_cache_get_count
+	 *
+	 *  @return 1 for success, -1 if the index is out of range
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API int persistent_cache_seek_entry(rdpPersistentCache* persistent, int index);
+
 	FREERDP_API int persistent_cache_write_entry(rdpPersistentCache* persistent,
 	                                             const PERSISTENT_CACHE_ENTRY* entry);
 
@@ -0,0 +1,72 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDPXXXX Remote App Graphics Redirection Virtual Channel Extension
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CHANNEL_GFXREDIR_CLIENT_GFXREDIR_H
+#define FREERDP_CHANNEL_GFXREDIR_CLIENT_GFXREDIR_H
+
+#include <freerdp/channels/gfxredir.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief a buffer in a shared memory pool, the pixels are mapped from the server
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		UINT64 poolId;
+		UINT64 bufferId;
+		const BYTE* data; /* first pixel of the buffer inside the mapped pool */
+		UINT32 stride;
+		UINT32 width;
+		UINT32 height;
+		UINT32 format; /* PIXEL_FORMAT_ */
+	} GFXREDIR_CLIENT_BUFFER;
+
+	typedef struct s_gfxredir_client_context GfxRedirClientContext;
+
+	/** Called for every present, the server may reuse the buffer once this returned. The
+	 *  acknowledge is sent by the channel, the dirty rectangle is clipped to the buffer. */
+	typedef UINT (*pcGfxRedirPresentBuffer)(GfxRedirClientContext* context,
+	                                        const GFXREDIR_PRESENT_BUFFER_PDU* presentBuffer,
+	                                        const GFXREDIR_CLIENT_BUFFER* buffer);
+
+	/** @brief the graphics redirection client context
+	 *
+	 *  @since version 3.16.0
+	 */
+	struct s_gfxredir_client_context
+	{
+		void* handle;
+		void* custom;
+
+		UINT32 confirmedCapsVersion;
+
+		pcGfxRedirPresentBuffer PresentBuffer;
+	};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_CHANNEL_GFXREDIR_CLIENT_GFXREDIR_H */
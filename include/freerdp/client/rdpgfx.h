@@ -175,6 +175,9 @@ extern "C"
 		CRITICAL_SECTION mux;
 		rdpCodecs* codecs;
 		PROFILER_DEFINE(SurfaceProfiler)
+
+		/* frames received after the one passed to EndFrame that are not decoded yet */
+		UINT32 FramesBehind; /** @since version 3.16.0 */
 	};
 
 	FREERDP_API void rdpgfx_client_context_free(RdpgfxClientContext* context);
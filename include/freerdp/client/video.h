@@ -22,6 +22,7 @@
 
 #include <freerdp/client/geometry.h>
 #include <freerdp/channels/video.h>
+#include <freerdp/codec/h264.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -49,6 +50,19 @@ extern "C"
 	                                   UINT32 destinationWidth, UINT32 destinationHeight);
 	typedef BOOL (*pcVideoDeleteSurface)(VideoClientContext* video, VideoSurface* surface);
 
+	/** @brief present a frame the hardware decoder kept in GPU memory
+	 *
+	 * Optional. If set, frames of a hardware decoder are not written to the surface but handed
+	 * over as DMA-BUF to be shown at the surface position, e.g. on an overlay plane or as GPU
+	 * texture. The file descriptors are only valid during the call. Returning \b FALSE makes
+	 * the channel decode to the surface and use \b showSurface for the presentation.
+	 *
+	 * @since version 3.16.0
+	 */
+	typedef BOOL (*pcVideoShowHwFrame)(VideoClientContext* video, const VideoSurface* surface,
+	                                   const H264_DMABUF_FRAME* frame, UINT32 destinationWidth,
+	                                   UINT32 destinationHeight);
+
 	/** @brief context for the video (MS-RDPEVOR) channel */
 	struct s_VideoClientContext
 	{
@@ -61,6 +75,7 @@ extern "C"
 		pcVideoCreateSurface createSurface;
 		pcVideoShowSurface showSurface;
 		pcVideoDeleteSurface deleteSurface;
+		pcVideoShowHwFrame showHwFrame; /** @since version 3.16.0 */
 	};
 
 	FREERDP_API VideoSurface* VideoClient_CreateCommonContext(size_t size, UINT32 x, UINT32 y,
@@ -38,6 +38,27 @@ extern "C"
 	                               BYTE** WINPR_RESTRICT ppDstData,
 	                               UINT32* WINPR_RESTRICT pDstSize);
 
+	/** @brief Encode a bitmap as ClearCodec message
+	 *
+	 *  The encoder keeps glyph and vbar caches in sync with the peer decoder, so all messages
+	 *  produced by one context must be decoded by one decoder context in order.
+	 *
+	 *  @param clear A ClearCodec context created with \b Compressor set to \b TRUE
+	 *  @param s The stream to append the message to
+	 *  @param pSrcData The bitmap to encode
+	 *  @param SrcFormat The pixel format of \b pSrcData
+	 *  @param nSrcStep The line stride of \b pSrcData in bytes
+	 *  @param nWidth The width of the bitmap, must be in [1, 65535]
+	 *  @param nHeight The height of the bitmap, must be in [1, 65535]
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL clear_compose_message(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+	                                       wStream* WINPR_RESTRICT s,
+	                                       const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat,
+	                                       UINT32 nSrcStep, UINT32 nWidth, UINT32 nHeight);
+
 	FREERDP_API INT32 clear_decompress(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 	                                   const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
 	                                   UINT32 nWidth, UINT32 nHeight, BYTE* WINPR_RESTRICT pDstData,
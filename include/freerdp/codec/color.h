@@ -398,6 +398,9 @@ typedef struct gdi_palette gdiPalette;
 	    UINT32 nYSrc, const gdiPalette* WINPR_RESTRICT palette, UINT32 flags);
 
 	/*** Same as @ref freerdp_image_copy but only for non overlapping source and destination
+	 *
+	 * Since version 3.16.0 copies of large rectangles are split in bands of whole lines that
+	 * are processed in parallel on an internal thread pool, small copies are done inline.
 	 * @since version 3.6.0
 	 */
 	FREERDP_API BOOL freerdp_image_copy_no_overlap(
@@ -32,6 +32,16 @@ extern "C"
 
 	typedef struct S_FREERDP_DSP_CONTEXT FREERDP_DSP_CONTEXT;
 
+	/** @brief Filter length of the built-in resampler, longer filters add latency
+	 *  @since version 3.16.0
+	 */
+	typedef enum
+	{
+		FREERDP_DSP_RESAMPLE_QUALITY_LOW,    /** 8 taps, 4 frames latency */
+		FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM, /** 16 taps, 8 frames latency */
+		FREERDP_DSP_RESAMPLE_QUALITY_HIGH    /** 32 taps, 16 frames latency */
+	} FREERDP_DSP_RESAMPLE_QUALITY;
+
 	FREERDP_API void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context);
 
 	WINPR_ATTR_MALLOC(freerdp_dsp_context_free, 1)
@@ -52,6 +62,37 @@ extern "C"
 	                                           const AUDIO_FORMAT* WINPR_RESTRICT targetFormat,
 	                                           UINT32 FramesPerPacket);
 
+	/** @brief Select the filter length used when encoding requires a sample rate conversion
+	 *
+	 *  Only affects the built-in resampler, the FFmpeg and SOXR backends keep their defaults.
+	 *  The default is FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM.
+	 *
+	 *  @param context The DSP context
+	 *  @param quality The quality to use from the next encoded packet on
+	 *  @return \b TRUE for success, \b FALSE for an invalid argument
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL freerdp_dsp_context_set_resample_quality(
+	    FREERDP_DSP_CONTEXT* WINPR_RESTRICT context, FREERDP_DSP_RESAMPLE_QUALITY quality);
+
+	/** @brief Encode Opus in fixed size frames for low latency audio
+	 *
+	 *  With a frame duration set the encoder buffers input until complete frames are available
+	 *  and combines all complete frames of one freerdp_dsp_encode call into a single Opus packet
+	 *  of at most 120ms. Incomplete frames are kept for the next call. Only affects the libopus
+	 *  backend and takes effect with the next freerdp_dsp_context_reset.
+	 *
+	 *  @param context The DSP context
+	 *  @param frameDuration The frame duration in ms, 10 or 20. 0 encodes every packet as given.
+	 *  @param inbandFEC Enable Opus in-band forward error correction
+	 *  @param packetLoss The expected packet loss in percent, tunes the FEC redundancy
+	 *  @return \b TRUE for success, \b FALSE for an invalid argument
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL
+	freerdp_dsp_context_set_opus_framing(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+	                                     UINT32 frameDuration, BOOL inbandFEC, UINT32 packetLoss);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,6 +26,11 @@
 #include <freerdp/types.h>
 #include <freerdp/channels/rdpgfx.h>
 
+/** @brief The highest H.264 quantization parameter
+ *  @since version 3.16.0
+ */
+#define H264_QP_MAX 51
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -54,23 +59,108 @@ extern "C"
 
 	} H264_USAGETYPE;
 
+	/**
+	 * @brief The hardware encoders selectable with H264_CONTEXT_OPTION_HW_ENCODER
+	 * @since version 3.16.0
+	 */
+	typedef enum
+	{
+		H264_HW_ENCODER_AUTO = 0, /** use the first hardware encoder that initializes */
+		H264_HW_ENCODER_VAAPI,
+		H264_HW_ENCODER_NVENC
+	} H264_HW_ENCODER;
+
+	/**
+	 * @brief The decoder threading modes selectable with H264_CONTEXT_OPTION_THREAD_TYPE
+	 * @since version 3.16.0
+	 */
+	typedef enum
+	{
+		H264_THREAD_SLICE = 0, /** the slices of a frame in parallel, no added latency */
+		H264_THREAD_FRAME      /** consecutive frames in parallel, delays the output by a
+		                          frame per thread */
+	} H264_THREAD_TYPE;
+
 	typedef enum
 	{
 		H264_CONTEXT_OPTION_RATECONTROL,
 		H264_CONTEXT_OPTION_BITRATE,
 		H264_CONTEXT_OPTION_FRAMERATE,
 		H264_CONTEXT_OPTION_QP,
-		H264_CONTEXT_OPTION_USAGETYPE, /** @since version 3.6.0 */
-		H264_CONTEXT_OPTION_HW_ACCEL,  /** set to request hw accel, get to check if hw accel is on,
-		                                  @since version 3.11.0 */
+		H264_CONTEXT_OPTION_USAGETYPE,  /** @since version 3.6.0 */
+		H264_CONTEXT_OPTION_HW_ACCEL,   /** set to request hw accel, get to check if hw accel is on,
+		                                   @since version 3.11.0 */
+		H264_CONTEXT_OPTION_HW_ENCODER, /** a H264_HW_ENCODER, applied together with
+		                                   H264_CONTEXT_OPTION_HW_ACCEL on the next
+		                                   h264_context_reset, get to check the encoder in use
+		                                   @since version 3.16.0 */
+		H264_CONTEXT_OPTION_HW_FRAMES,  /** decoder only, set to keep AVC420 frames in GPU memory,
+		                                   see h264_context_get_dmabuf
+		                                   @since version 3.16.0 */
+		H264_CONTEXT_OPTION_THREADS,    /** number of codec threads, 0 for one per CPU,
+		                                   applied on the next h264_context_reset
+		                                   @since version 3.16.0 */
+		H264_CONTEXT_OPTION_THREAD_TYPE, /** decoder only, a H264_THREAD_TYPE, applied on the
+		                                    next h264_context_reset
+		                                    @since version 3.16.0 */
+		H264_CONTEXT_OPTION_SHARED_THREADPOOL, /** convert the pictures on the process wide
+		                                          thread pool shared by all contexts with
+		                                          this option, applied on the next
+		                                          h264_context_reset
+		                                          @since version 3.16.0 */
 	} H264_CONTEXT_OPTION;
 
+	/**
+	 * @brief A decoded frame exported as DMA-BUF, see h264_context_get_dmabuf
+	 * @since version 3.16.0
+	 */
+	typedef struct
+	{
+		UINT32 width;
+		UINT32 height;
+		UINT32 fourcc;   /** DRM fourcc of the frame, e.g. NV12 */
+		UINT64 modifier; /** DRM format modifier of all objects */
+		UINT32 numObjects;
+		INT32 fds[4]; /** owned by the context */
+		UINT32 numPlanes;
+		UINT32 planeObject[4]; /** index into fds */
+		UINT32 planeOffset[4];
+		UINT32 planePitch[4];
+	} H264_DMABUF_FRAME;
+
+	/**
+	 * @brief A quantizer offset for a part of the frame, see h264_context_set_qp_regions
+	 * @since version 3.16.0
+	 */
+	typedef struct
+	{
+		RECTANGLE_16 rect;
+		INT32 qpOffset; /** added to the QP of the frame, negative values raise the quality */
+	} H264_QP_REGION;
+
 	FREERDP_API void free_h264_metablock(RDPGFX_H264_METABLOCK* meta);
 
 	FREERDP_API BOOL h264_context_set_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option,
 	                                         UINT32 value);
 	FREERDP_API UINT32 h264_context_get_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option);
 
+	/**
+	 * @brief Set quantizer offsets for parts of the frames passed to avc420_compress
+	 *
+	 * Text or a window that just got focus can be sent with a lower QP, full motion video
+	 * with a higher one. Where regions overlap the first one applies. The regions stay in
+	 * effect until replaced, a \b count of 0 removes them. Encoders without region support
+	 * ignore them, the quantQualityVals of the metablock always report the QP that was used.
+	 *
+	 * @param h264 The H264 context used for encoding
+	 * @param regions The regions in surface coordinates, copied
+	 * @param count The number of elements in \b regions
+	 * @return \b TRUE on success, \b FALSE otherwise
+	 * @since version 3.16.0
+	 */
+	FREERDP_API BOOL h264_context_set_qp_regions(H264_CONTEXT* h264,
+	                                             const H264_QP_REGION* regions, UINT32 count);
+
 	FREERDP_API INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                                  UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
 	                                  const RECTANGLE_16* regionRect, BYTE** ppDstData,
@@ -101,11 +191,46 @@ extern "C"
 	 */
 	FREERDP_API INT32 h264_compress(H264_CONTEXT* h264, BYTE** ppDstData, UINT32* pDstSize);
 
+	/**
+	 * @brief Compress caller provided YUV planes to H264 stream
+	 *
+	 * Same as \b h264_compress but reads the image from \b YUVData instead of the buffer
+	 * returned by \b h264_get_yuv_buffer, saving a copy when the source already has the
+	 * layout the encoder expects: NV12 (\b stride[2] == 0) if
+	 * \b H264_CONTEXT_OPTION_HW_ACCEL is set, I420 otherwise.
+	 *
+	 * @param h264 The H264 context to use for compression
+	 * @param YUVData The planes of the image, the size set by \b h264_context_reset
+	 * @param stride The byte length of a line in each of the planes
+	 * @param ppDstData A pointer that will hold the allocated result buffer
+	 * @param pDstSize A pointer for the destination buffer size in bytes
+	 * @return \b >= 0 for success, \b <0 for an error
+	 * @since version 3.16.0
+	 */
+	FREERDP_API INT32 h264_compress_yuv(H264_CONTEXT* h264, const BYTE* YUVData[3],
+	                                    const UINT32 stride[3], BYTE** ppDstData,
+	                                    UINT32* pDstSize);
+
 	FREERDP_API INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize,
 	                                    BYTE* pDstData, DWORD DstFormat, UINT32 nDstStep,
 	                                    UINT32 nDstWidth, UINT32 nDstHeight,
 	                                    const RECTANGLE_16* regionRects, UINT32 numRegionRect);
 
+	/**
+	 * @brief Export the last frame avc420_decompress left in GPU memory
+	 *
+	 * With H264_CONTEXT_OPTION_HW_FRAMES set and a hardware decoder active avc420_decompress
+	 * does not write to its destination buffer. The frame can then be imported for display,
+	 * for example with EGL_EXT_image_dma_buf_import. The file descriptors stay valid until
+	 * the next call to avc420_decompress, h264_context_reset or h264_context_free.
+	 *
+	 * @param h264 The H264 context used for decoding
+	 * @param frame A pointer that receives the frame description
+	 * @return \b TRUE if the last frame is available as DMA-BUF, \b FALSE otherwise
+	 * @since version 3.16.0
+	 */
+	FREERDP_API BOOL h264_context_get_dmabuf(H264_CONTEXT* h264, H264_DMABUF_FRAME* frame);
+
 	FREERDP_API INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                                  UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
 	                                  BYTE version, const RECTANGLE_16* regionRect, BYTE* op,
@@ -39,7 +39,11 @@ extern "C"
 		NSC_COLOR_LOSS_LEVEL,
 		NSC_ALLOW_SUBSAMPLING,
 		NSC_DYNAMIC_COLOR_FIDELITY,
-		NSC_COLOR_FORMAT
+		NSC_COLOR_FORMAT,
+		/** THREADING_FLAGS_* bitmask for the encoder thread pool
+		 *  @since version 3.16.0
+		 */
+		NSC_THREADING_FLAGS
 	} NSC_PARAMETER;
 
 	typedef struct S_NSC_CONTEXT NSC_CONTEXT;
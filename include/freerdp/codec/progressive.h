@@ -59,6 +59,66 @@ extern "C"
 	progressive_delete_surface_context(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 	                                   UINT16 surfaceId);
 
+	/** Set the number of quality passes used by \link progressive_compress
+	 *
+	 *  With a single pass (the default) every tile is sent at full quality. With more passes
+	 *  \link progressive_compress only sends a coarse first pass, the remaining quality is
+	 *  sent with \link progressive_compress_upgrade
+	 *
+	 *  @param progressive The progressive codec context
+	 *  @param passes The number of passes, 1 to 4
+	 *
+	 *  @since version 3.16.0
+	 *  @return \b TRUE in case of success, \b FALSE for any error
+	 */
+	FREERDP_API BOOL progressive_context_set_passes(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                                UINT32 passes);
+
+	/** Encode the next quality upgrade of tiles previously sent with \link progressive_compress
+	 *
+	 *  The coarsest tiles are upgraded first until the message would exceed \b maxSize bytes,
+	 *  at least one tile is upgraded per call.
+	 *
+	 *  @param progressive The progressive codec context
+	 *  @param maxSize The number of bytes the message should not exceed
+	 *  @param ppDstData A pointer receiving the encoded message, owned by the context
+	 *  @param pDstSize A pointer receiving the size of the encoded message
+	 *
+	 *  @since version 3.16.0
+	 *  @return \b <0 in case of an error, \b 0 if all tiles are at full quality, \b >0 if a
+	 *  message was encoded
+	 */
+	FREERDP_API int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                             UINT32 maxSize, BYTE** WINPR_RESTRICT ppDstData,
+	                                             UINT32* WINPR_RESTRICT pDstSize);
+
+	/** Enable or disable the encoder tile cache
+	 *
+	 *  With the cache enabled tiles that did not change since they were last encoded are
+	 *  dropped, see \link rfx_context_set_tile_cache
+	 *  \link progressive_compress returns \b 0 if no tile changed.
+	 *
+	 *  @param progressive The progressive codec context
+	 *  @param enable \b TRUE to enable the cache, \b FALSE to disable (and clear) it
+	 *
+	 *  @since version 3.16.0
+	 *  @return \b TRUE in case of success, \b FALSE for any error
+	 */
+	FREERDP_API BOOL
+	progressive_context_set_tile_cache(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                   BOOL enable);
+
+	/** Forget the cached tile hashes of an area
+	 *
+	 *  @param progressive The progressive codec context
+	 *  @param rect The area to invalidate or \b NULL to invalidate everything
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void
+	progressive_context_invalidate_tile_cache(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                          const RECTANGLE_16* WINPR_RESTRICT rect);
+
 	FREERDP_API BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive);
 
 	FREERDP_API void progressive_context_free(PROGRESSIVE_CONTEXT* progressive);
@@ -99,6 +99,13 @@ extern "C"
 	 */
 	FREERDP_API void region16_clear(REGION16* region);
 
+	/** empties the region but keeps its storage, so a region that is refilled every frame
+	 * does not need to allocate again. Release it with region16_uninit as usual.
+	 * @param region the region to reset
+	 * @since version 3.16.0
+	 */
+	FREERDP_API void region16_reset(REGION16* region);
+
 	/** dumps the region on stderr
 	 * @param region the region to dump
 	 */
@@ -120,6 +127,21 @@ extern "C"
 	FREERDP_API BOOL region16_union_rect(REGION16* dst, const REGION16* src,
 	                                     const RECTANGLE_16* rect);
 
+	/** adds a list of rectangles to src and stores the resulting region in dst
+	 *
+	 * Same result as calling region16_union_rect for every rectangle, but the region is
+	 * rebuilt once. Empty rectangles are ignored.
+	 *
+	 * @param dst destination region
+	 * @param src source region, can be the same as dst
+	 * @param rects the rectangles to add
+	 * @param count the number of rectangles
+	 * @return if the operation was successful (false meaning out-of-memory)
+	 * @since version 3.16.0
+	 */
+	FREERDP_API BOOL region16_union_rects(REGION16* dst, const REGION16* src,
+	                                      const RECTANGLE_16* rects, UINT32 count);
+
 	/** returns if a rectangle intersects the region
 	 * @param src the region
 	 * @param arg2 the rectangle
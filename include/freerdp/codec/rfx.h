@@ -169,6 +169,48 @@ extern "C"
 
 	FREERDP_API UINT32 rfx_context_get_frame_idx(const RFX_CONTEXT* WINPR_RESTRICT context);
 
+	/** Enable or disable the encoder tile cache
+	 *
+	 *  With the cache enabled the encoder remembers a content hash for every 64x64 tile it
+	 *  encoded and drops tiles from later messages if their content did not change.
+	 *  Messages might then contain no tiles at all, \b rfx_compose_message does not write
+	 *  anything to the stream in that case.
+	 *
+	 *  @param context The RFX encoder context
+	 *  @param enable \b TRUE to enable the cache, \b FALSE to disable (and clear) it
+	 *
+	 *  @since version 3.16.0
+	 *  @return \b TRUE in case of success, \b FALSE for any error
+	 */
+	FREERDP_API BOOL rfx_context_set_tile_cache(RFX_CONTEXT* WINPR_RESTRICT context, BOOL enable);
+
+	/** Forget the cached tile hashes, the affected tiles are encoded again with the next message
+	 *
+	 *  Must be called whenever the peer content of an area was changed by other means than
+	 *  messages from this context, e.g. a refresh request or a cache to surface command.
+	 *
+	 *  @param context The RFX encoder context
+	 *  @param rect The area to invalidate or \b NULL to invalidate everything
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void rfx_context_invalidate_tile_cache(RFX_CONTEXT* WINPR_RESTRICT context,
+	                                                   const RECTANGLE_16* WINPR_RESTRICT rect);
+
+	/** Calculate the (non cryptographic) content hash used by the tile cache
+	 *
+	 *  @param data Pointer to the top left pixel of the tile
+	 *  @param width The width of the tile in pixels
+	 *  @param height The height of the tile in pixels
+	 *  @param scanline The line length of \b data in bytes
+	 *  @param bpp The number of bytes per pixel
+	 *
+	 *  @since version 3.16.0
+	 *  @return A non zero 64bit hash of the tile content and dimensions
+	 */
+	FREERDP_API UINT64 rfx_tile_hash(const BYTE* WINPR_RESTRICT data, UINT32 width, UINT32 height,
+	                                 UINT32 scanline, UINT32 bpp);
+
 	/** Write a RFX message as simple progressive message to a stream.
 	 *
 	 *  @param rfx The RFX codec context
@@ -32,6 +32,15 @@
 
 #define ZGFX_SEGMENTED_MAXSIZE 65535
 
+/* History of the RDP8 Lite variant used for dynamic virtual channel data */
+#define ZGFX_HISTORY_SIZE_LITE 65536
+
+/* Compressor effort, 0 stores segments uncompressed, 9 searches hardest */
+#define ZGFX_COMPRESSION_LEVEL_NONE 0
+#define ZGFX_COMPRESSION_LEVEL_FAST 1
+#define ZGFX_COMPRESSION_LEVEL_DEFAULT 4
+#define ZGFX_COMPRESSION_LEVEL_MAX 9
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -52,6 +61,60 @@ extern "C"
 	                                        const BYTE* WINPR_RESTRICT pUncompressed,
 	                                        UINT32 uncompressedSize, UINT32* WINPR_RESTRICT pFlags);
 
+	/** @brief Compress a single RDP8_BULK_ENCODED_DATA segment
+	 *
+	 *  Unlike \b zgfx_compress_to_stream no RDP_SEGMENTED_DATA descriptor is written, the
+	 *  output is the segment header followed by the (possibly uncompressed) data.
+	 *
+	 *  @param zgfx A compressor context
+	 *  @param sDst The stream to append the segment to
+	 *  @param pSrcData The data to compress
+	 *  @param SrcSize The length of \b pSrcData, at most \b ZGFX_SEGMENTED_MAXSIZE
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL zgfx_compress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+	                                    wStream* WINPR_RESTRICT sDst,
+	                                    const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize);
+
+	/** @brief Decompress a single RDP8_BULK_ENCODED_DATA segment
+	 *
+	 *  @param zgfx A decompressor context
+	 *  @param pSrcData The segment, header included
+	 *  @param SrcSize The length of \b pSrcData
+	 *  @param sDst The stream to append the decompressed data to
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL zgfx_decompress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+	                                      const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+	                                      wStream* WINPR_RESTRICT sDst);
+
+	/** @brief Change the size of the history buffer, this resets the context
+	 *
+	 *  Both sides must agree on the size, \b ZGFX_HISTORY_SIZE_LITE for RDP8 Lite.
+	 *
+	 *  @param zgfx A compressor or decompressor context
+	 *  @param size The history size, between \b ZGFX_SEGMENTED_MAXSIZE and 2500000 bytes
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL zgfx_set_history_size(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 size);
+
+	/** @brief Select the compressor effort level
+	 *
+	 *  @param zgfx A compressor context
+	 *  @param level A value between \b ZGFX_COMPRESSION_LEVEL_NONE and
+	 *         \b ZGFX_COMPRESSION_LEVEL_MAX
+	 *
+	 *  @return \b TRUE for success, \b FALSE for a decompressor context or an invalid level
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL zgfx_set_compression_level(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 level);
+
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, BOOL flush);
 
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
@@ -126,6 +126,20 @@ extern "C"
 	UINT32 height;
 	DEFINE_EVENT_END(GraphicsReset)
 
+	/** @since version 3.16.0 */
+	DEFINE_EVENT_BEGIN(NetworkCharacteristicsChange)
+	UINT32 baseRTT;
+	UINT32 averageRTT;
+	UINT32 bandwidth;
+	DEFINE_EVENT_END(NetworkCharacteristicsChange)
+
+	/** @since version 3.16.0 */
+	DEFINE_EVENT_BEGIN(ConnectionStep)
+	const char* name;
+	UINT64 start;
+	UINT64 duration;
+	DEFINE_EVENT_END(ConnectionStep)
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 #define FREERDP_H
 
 #include <winpr/stream.h>
+#include <winpr/memory.h>
 #include <winpr/sspi.h>
 
 #include <freerdp/api.h>
@@ -339,8 +340,17 @@ extern "C"
 
 		ALIGN64 rdpStreamDumpContext* dump; /* 64 */
 		ALIGN64 wLog* log;                  /* 65 */
-
-		UINT64 paddingD[96 - 66];  /* 66 */
+		ALIGN64 wArena* frameArena; /**< (offset 66)
+		                               Scratch memory for the update currently processed, reset
+		                               after every EndPaint. Only valid on the thread receiving
+		                               updates.
+		                               @since version 3.16.0 */
+		ALIGN64 wArena* channelArena; /**< (offset 67)
+		                                 Scratch memory for the virtual channel PDU currently
+		                                 dispatched, reset after every ReceiveChannelData.
+		                                 @since version 3.16.0 */
+
+		UINT64 paddingD[96 - 68];  /* 68 */
 		UINT64 paddingE[128 - 96]; /* 96 */
 	};
 
@@ -630,6 +640,30 @@ owned by rdpRdp */
 	FREERDP_API BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes,
 	                                   UINT64* inPackets, UINT64* outPackets);
 
+	/** @brief A timed step of the connection sequence
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		const char* name; /**< a connection state or an inner step like dns, tcp or tls */
+		UINT64 start;     /**< nanoseconds since the connection was started */
+		UINT64 duration;  /**< nanoseconds */
+	} FreeRDPConnectionStep;
+
+	/** @brief Get the timed steps of the last connection sequence
+	 *
+	 *  Steps are listed when they end, so inner steps precede the state they belong to.
+	 *  Every step is also published with the \b ConnectionStep event.
+	 *
+	 *  @param context The context of the connection
+	 *  @param steps An array receiving the steps, may be \b NULL to query the count
+	 *  @param count The number of elements in \b steps
+	 *  @return The number of recorded steps
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API size_t freerdp_get_connection_timeline(rdpContext* context,
+	                                                   FreeRDPConnectionStep* steps, size_t count);
+
 	FREERDP_API void freerdp_get_version(int* major, int* minor, int* revision);
 	FREERDP_API const char* freerdp_get_version_string(void);
 	FREERDP_API const char* freerdp_get_build_revision(void);
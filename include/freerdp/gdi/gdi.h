@@ -489,6 +489,9 @@ extern "C"
 	};
 	typedef struct gdi_glyph gdiGlyph;
 
+	/** @since version 3.16.0 */
+	typedef struct gdi_gfx_cache_budget gdiGfxCacheBudget;
+
 	struct rdp_gdi
 	{
 		rdpContext* context;
@@ -520,6 +523,14 @@ extern "C"
 		GeometryClientContext* geometry;
 
 		wLog* log;
+		gdiGfxCacheBudget* gfxCacheBudget; /** @since version 3.16.0 */
+		BOOL glyphRun;                     /** @since version 3.16.0 */
+		GDI_RECT glyphRunRect;             /** @since version 3.16.0 */
+		UINT64 frameStart;                 /** @since version 3.16.0 */
+		volatile LONGLONG frameComposed;   /** @since version 3.16.0 */
+		volatile LONG framesComposed;      /** @since version 3.16.0 */
+		UINT32 framesSkipped;              /** @since version 3.16.0 */
+		REGION16 monitorRegion;            /** @since version 3.16.0 */
 	};
 	typedef struct rdp_gdi rdpGdi;
 
@@ -539,6 +550,16 @@ extern "C"
 
 	FREERDP_API BOOL gdi_send_suppress_output(rdpGdi* gdi, BOOL suppress);
 
+	/** @brief Report that the GFX frames composed so far reached the display
+	 *
+	 *  Clients call this after presenting. It records the delay since the oldest frame not
+	 *  presented yet was decoded and counts the frames replaced before being presented.
+	 *
+	 *  @param gdi The gdi of the session
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void gdi_frame_presented(rdpGdi* gdi);
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,7 +20,10 @@
 #ifndef FREERDP_METRICS_H
 #define FREERDP_METRICS_H
 
+#include <winpr/wtypes.h>
+
 #include <freerdp/api.h>
+#include <freerdp/types.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -37,9 +40,112 @@ extern "C"
 	};
 	typedef struct rdp_metrics rdpMetrics;
 
+	/** @brief The kind of a registered metric
+	 *  @since version 3.16.0
+	 */
+	typedef enum
+	{
+		FREERDP_METRIC_COUNTER,  /**< monotonic, metrics_record adds the value */
+		FREERDP_METRIC_GAUGE,    /**< metrics_record replaces the value */
+		FREERDP_METRIC_HISTOGRAM /**< metrics_record adds an observation */
+	} FreeRDPMetricType;
+
+	/** @brief Output formats of metrics_export
+	 *  @since version 3.16.0
+	 */
+	typedef enum
+	{
+		FREERDP_METRICS_FORMAT_JSON,
+		FREERDP_METRICS_FORMAT_PROMETHEUS
+	} FreeRDPMetricsFormat;
+
+/** Histogram bucket \b x counts observations <= 2^x, the last one all larger ones
+ *  @since version 3.16.0
+ */
+#define FREERDP_METRICS_HISTOGRAM_BUCKETS 24
+
+	/** @brief A snapshot of a registered metric
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		FreeRDPMetricType type;
+		UINT64 value; /**< counter or gauge value */
+		UINT64 count; /**< histogram observations */
+		UINT64 sum;
+		UINT64 min;
+		UINT64 max;
+		UINT64 buckets[FREERDP_METRICS_HISTOGRAM_BUCKETS + 1];
+	} FreeRDPMetricValue;
+
 	FREERDP_API double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes,
 	                                       UINT32 CompressedBytes);
 
+	/** @brief Register a metric with the session
+	 *
+	 *  Registering a name that already exists with the same type returns the existing id, so
+	 *  components can look up shared metrics by name.
+	 *
+	 *  @param metrics The metrics of the session
+	 *  @param name The metric name, \b [a-zA-Z0-9_] only. Time values should end in \b _us
+	 *  @param type The kind of metric
+	 *
+	 *  @return The id to pass to metrics_record or \b -1 on failure
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API SSIZE_T metrics_register(rdpMetrics* metrics, const char* name,
+	                                     FreeRDPMetricType type);
+
+	/** @brief Update a registered metric, this is safe to call from any thread
+	 *
+	 *  @param metrics The metrics of the session
+	 *  @param id The id returned by metrics_register
+	 *  @param value The value to add, set or observe depending on the metric type
+	 *
+	 *  @return \b TRUE for success, \b FALSE for an unknown id
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL metrics_record(rdpMetrics* metrics, SSIZE_T id, UINT64 value);
+
+	/** @brief Get a snapshot of a registered metric
+	 *
+	 *  @param metrics The metrics of the session
+	 *  @param name The metric name
+	 *  @param value A pointer receiving the snapshot
+	 *
+	 *  @return \b TRUE for success, \b FALSE if no such metric is registered
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL metrics_get(rdpMetrics* metrics, const char* name, FreeRDPMetricValue* value);
+
+	/** @brief Get the traffic of a static virtual channel
+	 *
+	 *  @param metrics The metrics of the session
+	 *  @param channelId The MCS channel id
+	 *  @param bytesIn Optional pointer receiving the received payload bytes
+	 *  @param bytesOut Optional pointer receiving the sent payload bytes
+	 *  @param pdusIn Optional pointer receiving the number of received chunks
+	 *  @param pdusOut Optional pointer receiving the number of sent chunks
+	 *
+	 *  @return \b TRUE for success, \b FALSE if the channel has seen no traffic
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL metrics_channel_get(rdpMetrics* metrics, UINT16 channelId, UINT64* bytesIn,
+	                                     UINT64* bytesOut, UINT64* pdusIn, UINT64* pdusOut);
+
+	/** @brief Export all metrics of the session
+	 *
+	 *  @param metrics The metrics of the session
+	 *  @param format The output format
+	 *  @param plength Optional pointer receiving the length of the result
+	 *
+	 *  @return A '\0' terminated string to be freed with \b free or \b NULL on failure
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(free, 1)
+	FREERDP_API char* metrics_export(rdpMetrics* metrics, FreeRDPMetricsFormat format,
+	                                 size_t* plength);
+
 	FREERDP_API void metrics_free(rdpMetrics* metrics);
 
 	WINPR_ATTR_MALLOC(metrics_free, 1)
@@ -211,6 +211,60 @@ extern "C"
 	FREERDP_API BOOL freerdp_peer_set_local_and_hostname(freerdp_peer* client,
 	                                                     const struct sockaddr_storage* peer_addr);
 
+	/** @brief A small pool of worker threads serving many peers, instead of a thread per peer.
+	 *  Each peer stays with one worker, its callbacks are never called concurrently.
+	 *  @since version 3.16.0
+	 */
+	typedef struct rdp_peer_reactor rdpPeerReactor;
+
+	/** @brief Collect the handles to wait on, called after each check of the peer
+	 *  @return The number of handles stored, \b 0 to remove the peer
+	 *  @since version 3.16.0
+	 */
+	typedef DWORD (*psPeerReactorGetHandles)(freerdp_peer* peer, void* userarg, HANDLE* handles,
+	                                         DWORD count);
+
+	/** @brief Process the peer, called when one of its handles is signaled and at least once every
+	 *  timeout. Must not block, other peers of the same worker wait meanwhile.
+	 *  @return \b FALSE to remove the peer
+	 *  @since version 3.16.0
+	 */
+	typedef BOOL (*psPeerReactorCheck)(freerdp_peer* peer, void* userarg);
+
+	/** @brief Called once the peer was removed, the peer can be freed here
+	 *  @since version 3.16.0
+	 */
+	typedef void (*psPeerReactorRemoved)(freerdp_peer* peer, void* userarg);
+
+	/** @brief Stop the workers, the peers still attached are removed
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API void freerdp_peer_reactor_free(rdpPeerReactor* reactor);
+
+	/** @brief Create a peer reactor, uses epoll on Linux and poll elsewhere
+	 *
+	 *  @param workers The number of worker threads, \b 0 for one per processor
+	 *  @param timeout The maximum time in ms between two checks of a peer, \b 0 for 1000
+	 *
+	 *  @return A new reactor or \b NULL if it could not be created or is not supported (Windows)
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(freerdp_peer_reactor_free, 1)
+	FREERDP_API rdpPeerReactor* freerdp_peer_reactor_new(size_t workers, DWORD timeout);
+
+	/** @brief Hand a peer to the least loaded worker
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL freerdp_peer_reactor_add(rdpPeerReactor* reactor, freerdp_peer* peer,
+	                                          psPeerReactorGetHandles getHandles,
+	                                          psPeerReactorCheck check,
+	                                          psPeerReactorRemoved removed, void* userarg);
+
+	/** @return The number of peers attached to the reactor
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API size_t freerdp_peer_reactor_count(const rdpPeerReactor* reactor);
+
 #ifdef __cplusplus
 }
 #endif
@@ -348,6 +348,20 @@ typedef enum
 	 */
 	FREERDP_API const char* primtives_hint_str(primitive_hints hint);
 
+	/** @brief set the file used to persist the results of \b PRIMITIVES_AUTODETECT
+	 *
+	 *  If more than one backend is available autodetection benchmarks every primitive with
+	 *  differing implementations and uses the fastest of each. The choices are stored in the
+	 *  profile and reused as long as FreeRDP version and backends do not change. The default is
+	 *  primitives.profile in the user configuration directory. Must be called before the first
+	 *  call to primitives_get.
+	 *
+	 *  @param path The profile to use, \b NULL to always run the benchmark
+	 *  @return \b TRUE for success, \b FALSE if out of memory
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL primitives_set_profile_path(const char* path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,37 @@ extern "C"
 		ECHO_SERVER_OPEN_RESULT_ERROR = 3
 	} ECHO_SERVER_OPEN_RESULT;
 
+	/** @brief bytes at the start of every benchmark payload: magic, run, sequence and timestamp
+	 *  @since version 3.16.0
+	 */
+#define ECHO_SERVER_BENCHMARK_HEADER_SIZE 20
+
+	/** @since version 3.16.0 */
+	typedef struct
+	{
+		UINT32 PayloadSize; /* bytes per request, at least ECHO_SERVER_BENCHMARK_HEADER_SIZE */
+		UINT32 Rate;        /* requests per second, 0 sends as fast as the window allows */
+		UINT32 Count;       /* number of requests */
+		UINT32 Window;      /* requests in flight at most, 0 for 1 */
+		UINT32 Timeout;     /* milliseconds to wait for a response */
+	} ECHO_SERVER_BENCHMARK_SETTINGS;
+
+	/** @since version 3.16.0 */
+	typedef struct
+	{
+		UINT32 Sent;
+		UINT32 Received;
+		UINT32 Invalid;    /* responses that did not match an outstanding request */
+		UINT64 Duration;   /* microseconds from the first request to the last response */
+		UINT64 Bytes;      /* payload bytes echoed back */
+		UINT64 Throughput; /* echoed payload bytes per second */
+		UINT64 RttMin;     /* round trip times in microseconds */
+		UINT64 RttP50;
+		UINT64 RttP90;
+		UINT64 RttP99;
+		UINT64 RttMax;
+	} ECHO_SERVER_BENCHMARK_RESULT;
+
 	typedef struct s_echo_server_context echo_server_context;
 
 	typedef BOOL (*psEchoServerChannelIdAssigned)(echo_server_context* context, UINT32 channelId);
@@ -50,6 +81,9 @@ extern "C"
 	                                       ECHO_SERVER_OPEN_RESULT result);
 	typedef UINT (*psEchoServerResponse)(echo_server_context* context, const BYTE* buffer,
 	                                     UINT32 length);
+	typedef UINT (*psEchoServerBenchmark)(echo_server_context* context,
+	                                      const ECHO_SERVER_BENCHMARK_SETTINGS* settings,
+	                                      ECHO_SERVER_BENCHMARK_RESULT* result);
 
 	struct s_echo_server_context
 	{
@@ -88,6 +122,15 @@ extern "C"
 		 * Callback, when the channel got its id assigned.
 		 */
 		psEchoServerChannelIdAssigned ChannelIdAssigned;
+
+		/**
+		 * Send timestamped requests at a controlled rate and measure the round trip
+		 * of the echoed responses. Blocks until all responses arrived or timed out,
+		 * the benchmark responses are not passed to the Response callback.
+		 * Requires the channel to be opened successfully.
+		 * @since version 3.16.0
+		 */
+		psEchoServerBenchmark Benchmark;
 	};
 
 	FREERDP_API void echo_server_context_free(echo_server_context* context);
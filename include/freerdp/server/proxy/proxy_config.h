@@ -119,6 +119,22 @@ extern "C"
 
 		/* target continued */
 		UINT32 TargetTlsSecLevel; /** @since version 3.2.0 */
+
+		/* security continued */
+		BOOL TlsKernelOffload; /** @since version 3.16.0 */
+
+		/* server continued */
+		UINT32 Workers; /** @since version 3.16.0 */
+
+		/* channels continued */
+		BOOL GraphicsPassthrough; /** @since version 3.16.0 */
+
+		/* metrics */
+		char* MetricsHost;  /** @since version 3.16.0 */
+		UINT16 MetricsPort; /** @since version 3.16.0 */
+
+		/* target continued */
+		UINT32 TargetCacheTTL; /** @since version 3.16.0 */
 	};
 
 	/**
@@ -40,6 +40,7 @@ extern "C"
 
 	typedef struct proxy_data proxyData;
 	typedef struct proxy_module proxyModule;
+	typedef struct proxy_session_metrics proxySessionMetrics;
 	typedef struct p_server_static_channel_context pServerStaticChannelContext;
 
 	typedef struct s_InterceptContextMapEntry
@@ -139,6 +140,10 @@ extern "C"
 			char* c;
 			void* v;
 		} computerName;
+
+		/* the cached address ServerHostname was replaced with, the name moved to
+		 * UserSpecifiedServerName */
+		char* resolved_address; /** @since version 3.16.0 */
 	};
 
 	/**
@@ -161,6 +166,11 @@ extern "C"
 		/* used to external modules to store per-session info */
 		wHashTable* modules_info;
 		psPeerReceiveChannelData server_receive_channel_data_original;
+
+		/** @since version 3.16.0 */
+		BOOL client_shared_loop; /* the peer's event loop drives the client once connected */
+		HANDLE client_connected; /* set by the client thread when handing over the connection */
+		proxySessionMetrics* metrics;
 	};
 
 	FREERDP_API BOOL pf_context_copy_settings(rdpSettings* dst, const rdpSettings* src);
@@ -228,7 +228,11 @@ typedef struct dyn_channel_to_intercept_data
 {
 	const char* name;
 	UINT32 channelId;
-	BOOL intercept;
+	BOOL intercept; /* both directions */
+
+	/** @since version 3.16.0 */
+	BOOL interceptFront; /* only the client to server direction */
+	BOOL interceptBack;  /* only the server to client direction */
 } proxyChannelToInterceptData;
 
 #define WINPR_PACK_POP
@@ -122,6 +122,27 @@ typedef void (*psRdpdrOnDriveDeleteFileComplete)(RdpdrServerContext* context, vo
 typedef void (*psRdpdrOnDriveRenameFileComplete)(RdpdrServerContext* context, void* callbackData,
                                                  UINT32 ioStatus);
 
+/** @since version 3.16.0 */
+typedef UINT (*psRdpdrDriveReadFileEx)(RdpdrServerContext* context, void* callbackData,
+                                       UINT32 deviceId, UINT32 fileId, UINT64 offset,
+                                       UINT32 length);
+/** @since version 3.16.0 */
+typedef UINT (*psRdpdrDriveWriteFileEx)(RdpdrServerContext* context, void* callbackData,
+                                        UINT32 deviceId, UINT32 fileId, UINT64 offset,
+                                        const BYTE* buffer, UINT32 length);
+/** @since version 3.16.0 */
+typedef size_t (*psRdpdrGetOutstandingIrps)(RdpdrServerContext* context);
+
+/** @since version 3.16.0 */
+typedef void (*psRdpdrOnDriveReadFileExComplete)(RdpdrServerContext* context, void* callbackData,
+                                                 UINT32 completionId, UINT32 ioStatus,
+                                                 UINT64 offset, const BYTE* buffer,
+                                                 UINT32 length);
+/** @since version 3.16.0 */
+typedef void (*psRdpdrOnDriveWriteFileExComplete)(RdpdrServerContext* context, void* callbackData,
+                                                  UINT32 completionId, UINT32 ioStatus,
+                                                  UINT64 offset, UINT32 bytesWritten);
+
 typedef UINT (*psRdpdrOnDeviceCreate)(RdpdrServerContext* context, const RdpdrDevice* device);
 typedef UINT (*psRdpdrOnDeviceDelete)(RdpdrServerContext* context, UINT32 deviceId);
 
@@ -213,6 +234,23 @@ struct s_rdpdr_server_context
 	                                            after \b                ReceiveDeviceRemove */
 
 	rdpContext* rdpcontext;
+
+	/*** Asynchronous drive APIs called by the server.
+	 * Any number of requests may be outstanding per device, each completes with its own
+	 * completion id on the channel thread. The read buffer passed to the completion is only
+	 * valid during the call.
+	 */
+	psRdpdrDriveReadFileEx DriveReadFileEx;       /** @since version 3.16.0 */
+	psRdpdrDriveWriteFileEx DriveWriteFileEx;     /** @since version 3.16.0 */
+	psRdpdrGetOutstandingIrps GetOutstandingIrps; /** @since version 3.16.0 */
+	psRdpdrOnDriveReadFileExComplete OnDriveReadFileExComplete;   /** @since version 3.16.0 */
+	psRdpdrOnDriveWriteFileExComplete OnDriveWriteFileExComplete; /** @since version 3.16.0 */
+
+	/** Reads longer than this are sent as several outstanding requests of at most this size,
+	 * each completing on its own with its offset. 0 sends every read as one request.
+	 * @since version 3.16.0
+	 */
+	UINT32 MaxReadChunkSize;
 };
 
 FREERDP_API void rdpdr_server_context_free(RdpdrServerContext* context);
@@ -149,6 +149,28 @@ extern "C"
 	FREERDP_API HANDLE rdpgfx_server_get_event_handle(RdpgfxServerContext* context);
 	FREERDP_API UINT rdpgfx_server_handle_messages(RdpgfxServerContext* context);
 
+	/**
+	 * @brief Collect the PDUs sent from now on in one packet list.
+	 *
+	 * The PDUs are compressed together and written as a single DVC message by
+	 * rdpgfx_server_end_batch, very large batches are sent early. Use it around the PDUs of a
+	 * frame, from the thread sending them.
+	 *
+	 * @param context The rdpgfx server context
+	 * @return \b TRUE for success, \b FALSE if a batch is already active or on failure
+	 * @since version 3.16.0
+	 */
+	FREERDP_API BOOL rdpgfx_server_begin_batch(RdpgfxServerContext* context);
+
+	/**
+	 * @brief Send the PDUs collected since rdpgfx_server_begin_batch.
+	 *
+	 * @param context The rdpgfx server context
+	 * @return 0 on success, otherwise a Win32 error code
+	 * @since version 3.16.0
+	 */
+	FREERDP_API UINT rdpgfx_server_end_batch(RdpgfxServerContext* context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -180,6 +180,18 @@ extern "C"
 
 		UINT16 udpPort;  /** @since version 3.14.0 */
 		UINT8 lastblock; /** @since version 3.14.0 */
+
+		/**
+		 * Opus frame duration in ms, 10 or 20. When set and an Opus format is selected
+		 * every wave PDU carries opusFramesPerPacket frames instead of latency ms of audio.
+		 * Set by server.
+		 * @since version 3.16.0
+		 */
+		UINT32 opusFrameDuration;
+		/** Opus frames combined into one wave PDU, 0 is treated as 1. @since version 3.16.0 */
+		UINT32 opusFramesPerPacket;
+		/** Enable Opus in-band forward error correction. @since version 3.16.0 */
+		BOOL opusInbandFEC;
 	};
 
 	FREERDP_API void rdpsnd_server_context_free(RdpsndServerContext* context);
@@ -59,6 +59,12 @@ extern "C"
 	typedef struct rdp_shadow_capture rdpShadowCapture;
 	typedef struct rdp_shadow_subsystem rdpShadowSubsystem;
 	typedef struct rdp_shadow_multiclient_event rdpShadowMultiClientEvent;
+	typedef struct rdp_shadow_input_queue rdpShadowInputQueue; /** @since version 3.16.0 */
+	typedef struct rdp_shadow_pointer_cache
+	    rdpShadowPointerCache; /** @since version 3.16.0 */
+	typedef struct rdp_shadow_shared_encoder
+	    rdpShadowSharedEncoder; /** @since version 3.16.0 */
+	typedef struct rdp_shadow_audio_out rdpShadowAudioOut; /** @since version 3.16.0 */
 
 	typedef struct S_RDP_SHADOW_ENTRY_POINTS RDP_SHADOW_ENTRY_POINTS;
 	typedef int (*pfnShadowSubsystemEntry)(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
@@ -140,6 +146,8 @@ extern "C"
 		UINT32 resizeWidth;
 		UINT32 resizeHeight;
 		BOOL areGfxCapsReady; /** @since version 3.3.0 */
+		rdpShadowInputQueue* inputQueue; /** @since version 3.16.0 */
+		rdpShadowPointerCache* pointerCache; /** @since version 3.16.0 */
 	};
 
 	struct rdp_shadow_server
@@ -180,6 +188,10 @@ extern "C"
 		size_t maxClientsConnected;
 		BOOL SupportMultiRectBitmapUpdates; /** @since version 3.13.0 */
 		BOOL ShowMouseCursor;               /** @since version 3.15.0 */
+		rdpShadowSharedEncoder* sharedEncoder; /** @since version 3.16.0 */
+		rdpShadowAudioOut* audioOut;           /** @since version 3.16.0 */
+		BOOL hugePages;                        /** @since version 3.16.0 */
+		INT32 numaNode; /** @since version 3.16.0, -1 for no binding */
 	};
 
 	struct rdp_shadow_surface
@@ -196,6 +208,13 @@ extern "C"
 
 		CRITICAL_SECTION lock;
 		REGION16 invalidRegion;
+
+		/** @since version 3.16.0 */
+		UINT64 captureId; /* incremented whenever data changes */
+		BOOL moveValid;   /* the change to captureId moved moveSrc to moveDst */
+		RECTANGLE_16 moveSrc;
+		RECTANGLE_16 moveDst;
+		size_t dataSize; /* size of the winpr_LargeAlloc mapping of data */
 	};
 
 	struct S_RDP_SHADOW_ENTRY_POINTS
@@ -387,8 +406,88 @@ extern "C"
 	                                                   UINT32 format2, UINT32 nStep2,
 	                                                   RECTANGLE_16* WINPR_RESTRICT rect);
 
+	/** @brief Compare two framebuffer images of possibly different formats tile by tile
+	 *
+	 *  Like \b shadow_capture_compare_with_format but every 16x16 tile is reported on its own,
+	 *  so distant changes do not merge into one large rectangle.
+	 *
+	 *  @param pData1  A pointer to the data of image 1
+	 *  @param format1 The format of image 1
+	 *  @param nStep1  The line width in bytes of image 1
+	 *  @param nWidth  The line width in pixels of image 1
+	 *  @param nHeight The height of image 1
+	 *  @param pData2  A pointer to the data of image 2
+	 *  @param format2 The format of image 2
+	 *  @param nStep2  The line width in bytes of image 2
+	 *  @param tiles   Set to non zero for each changed tile, one byte per tile in rows of
+	 *                 (nWidth + 15) / 16 tiles
+	 *  @param count   The number of bytes available in \b tiles
+	 *
+	 *  @return the number of changed tiles or \b <0 if \b tiles is too small
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API int shadow_capture_compare_tiles(const BYTE* WINPR_RESTRICT pData1,
+	                                             UINT32 format1, UINT32 nStep1, UINT32 nWidth,
+	                                             UINT32 nHeight, const BYTE* WINPR_RESTRICT pData2,
+	                                             UINT32 format2, UINT32 nStep2,
+	                                             BYTE* WINPR_RESTRICT tiles, size_t count);
+
+	/** @brief Add the changed tiles of \b shadow_capture_compare_tiles to a region
+	 *
+	 *  @param tiles   The tiles of an image of \b nWidth x \b nHeight pixels
+	 *  @param nWidth  The width in pixels of the compared images
+	 *  @param nHeight The height in pixels of the compared images
+	 *  @param nXDst   The x position of the compared images in the region
+	 *  @param nYDst   The y position of the compared images in the region
+	 *  @param region  The region to add to
+	 *
+	 *  @return \b TRUE for success
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL shadow_capture_tiles_to_region(const BYTE* WINPR_RESTRICT tiles,
+	                                                UINT32 nWidth, UINT32 nHeight, UINT16 nXDst,
+	                                                UINT16 nYDst, REGION16* WINPR_RESTRICT region);
+
+	/** @brief Detect content of image 1 that moved (scrolled) to another position in image 2
+	 *
+	 *  Rows and columns of both images are hashed in strips to find a vertical or horizontal
+	 *  shift of a part of the rectangle, the result is verified pixel by pixel.
+	 *
+	 *  @param pData1  A pointer to the data of image 1, the previous frame
+	 *  @param format1 The format of image 1
+	 *  @param nStep1  The line width in bytes of image 1
+	 *  @param pData2  A pointer to the data of image 2, the current frame
+	 *  @param format2 The format of image 2
+	 *  @param nStep2  The line width in bytes of image 2
+	 *  @param rect The changed rectangle of the images to search in
+	 *  @param src  Set to the moved area in image 1
+	 *  @param dst  Set to the area of image 2 that equals \b src of image 1
+	 *
+	 *  @return \b TRUE if a move was found
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL shadow_capture_detect_move(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+	                                            UINT32 nStep1, const BYTE* WINPR_RESTRICT pData2,
+	                                            UINT32 format2, UINT32 nStep2,
+	                                            const RECTANGLE_16* WINPR_RESTRICT rect,
+	                                            RECTANGLE_16* WINPR_RESTRICT src,
+	                                            RECTANGLE_16* WINPR_RESTRICT dst);
+
 	FREERDP_API void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem);
 
+	/** @brief The capture rate for the fastest client, slower clients skip frames
+	 *
+	 *  @param subsystem The subsystem capturing for the clients
+	 *
+	 *  @return the highest preferred frame rate of the connected clients, \b 0 without clients
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API UINT32 shadow_subsystem_preferred_fps(rdpShadowSubsystem* subsystem);
+
 	FREERDP_API BOOL shadow_client_post_msg(rdpShadowClient* client, void* context, UINT32 type,
 	                                        SHADOW_MSG_OUT* msg, void* lParam);
 	FREERDP_API int shadow_client_boardcast_msg(rdpShadowServer* server, void* context, UINT32 type,
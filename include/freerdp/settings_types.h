@@ -336,6 +336,7 @@ extern "C"
 #define CLIPRDR_FLAG_LOCAL_TO_REMOTE_FILES 0x02
 #define CLIPRDR_FLAG_REMOTE_TO_LOCAL 0x10
 #define CLIPRDR_FLAG_REMOTE_TO_LOCAL_FILES 0x20
+#define CLIPRDR_FLAG_PREFETCH_TEXT 0x100 /** @since version 3.16.0 */
 
 #define CLIPRDR_FLAG_DEFAULT_MASK                                        \
 	(CLIPRDR_FLAG_LOCAL_TO_REMOTE | CLIPRDR_FLAG_LOCAL_TO_REMOTE_FILES | \
@@ -487,6 +488,10 @@ extern "C"
 
 /* ThreadingFlags */
 #define THREADING_FLAGS_DISABLE_THREADS 0x00000001
+/** use the process wide thread pool instead of a private one
+ *  @since version 3.16.0
+ */
+#define THREADING_FLAGS_SHARED_POOL 0x00000002
 
 	enum rdp_settings_type
 	{
@@ -118,7 +118,10 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 UINT64 MonitorOverrideFlags);  /** 154
 		                                                        * @since version 3.15.0
 		                                                        */
-	UINT64 padding0192[192 - 155];                             /* 155 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 NetworkAutoDetectInterval); /** 155
+		                                                            * @since version 3.16.0
+		                                                            */
+	UINT64 padding0192[192 - 156];                                 /* 156 */
 
 	/* Client/Server Security Data */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL UseRdpSecurityLayer);                /* 192 */
@@ -207,7 +210,10 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 BOOL ForceEncryptedCsPdu);    /* 719 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL HiDefRemoteApp);         /* 720 */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 CompressionLevel);     /* 721 */
-	UINT64 padding0768[768 - 722];                            /* 722 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL CompressionAdaptive);    /** 722
+		                                                       * @since version 3.16.0
+		                                                       */
+	UINT64 padding0768[768 - 723];                            /* 723 */
 
 	/* Client Info (Extra) */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL IPv6Enabled);       /* 768 */
@@ -290,7 +296,16 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 char* WinSCardModule);              /* 1113 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL RemoteCredentialGuard);        /* 1114 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL RestrictedAdminModeSupported); /* 1115 */
-	UINT64 padding1152[1152 - 1116];                                /* 1116 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL TlsKernelOffload);             /** 1116
+		                                                             * @since version 3.16.0
+		                                                             */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL TlsSessionResumption);         /** 1117
+		                                                             * @since version 3.16.0
+		                                                             */
+	SETTINGS_DEPRECATED(ALIGN64 char* TlsSessionCacheFile);         /** 1118
+		                                                             * @since version 3.16.0
+		                                                             */
+	UINT64 padding1152[1152 - 1119];                                /* 1119 */
 
 	/* Connection Cookie */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL MstscCookieMode);      /* 1152 */
@@ -583,7 +598,10 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 BitmapCacheV2NumCells);                     /* 2501 */
 	SETTINGS_DEPRECATED(ALIGN64 BITMAP_CACHE_V2_CELL_INFO* BitmapCacheV2CellInfo); /* 2502 */
 	SETTINGS_DEPRECATED(ALIGN64 char* BitmapCachePersistFile);                     /* 2503 */
-	UINT64 padding2560[2560 - 2504];                                               /* 2504 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 BitmapCacheBudget);                         /** 2504
+		                                                                            * @since version 3.16.0
+		                                                                            */
+	UINT64 padding2560[2560 - 2505];                                               /* 2505 */
 
 	/* Pointer Capabilities */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 ColorPointerCacheSize); /* 2560 */
@@ -614,7 +632,10 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 char* KeyboardPipeName);     /* 2637 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL HasRelativeMouseEvent); /* 2638 */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL HasQoeEvent);           /* 2639 */
-	UINT64 padding2688[2688 - 2640];                         /* 2640 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 InputCoalesceInterval); /** 2640
+	                                                            * @since version 3.16.0
+	                                                            */
+	UINT64 padding2688[2688 - 2641];                           /* 2641 */
 
 	/* Brush Capabilities */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 BrushSupportLevel); /* 2688 */
@@ -724,7 +745,13 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 BOOL GfxSuspendFrameAck); /** 3850
 		                                                   * @since version 3.6.0
 		                                                   */
-	UINT64 padding3904[3904 - 3851];                      /* 3851 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL GfxClearCodec);      /** 3851
+		                                                   * @since version 3.16.0
+		                                                   */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 GfxCacheBudget);   /** 3852
+		                                                   * @since version 3.16.0
+		                                                   */
+	UINT64 padding3904[3904 - 3853];                      /* 3853 */
 
 	/**
 	 * Caches
@@ -831,7 +858,28 @@ struct rdp_settings
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 Floatbar);                /* 5196 */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 TcpConnectTimeout);       /* 5197 */
 	SETTINGS_DEPRECATED(ALIGN64 UINT32 FakeMouseMotionInterval); /* 5198 */
-	UINT64 padding5312[5312 - 5199];                             /* 5199 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 TcpConnectAttemptDelay);  /** 5199
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL TcpLatencyMode);            /** 5200
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 TcpNotSentLowat);         /** 5201
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 char* TcpCongestionControl);     /** 5202
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL LocalShmTransport);         /** 5203
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL GdiMonitorSurfaces);        /** 5204
+		                                                          * @since version 3.16.0
+		                                                          */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL AsyncTransport);            /** 5205
+		                                                          * @since version 3.16.0
+		                                                          */
+	UINT64 padding5312[5312 - 5206];                             /* 5206 */
 
 	/**
 	 * WARNING: End of ABI stable zone!
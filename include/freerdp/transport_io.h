@@ -102,6 +102,27 @@ extern "C"
 	 */
 	typedef BOOL (*pTransportAttachLayer)(rdpTransport* transport, rdpTransportLayer* layer);
 
+	/** @since version 3.16.0 */
+	typedef struct
+	{
+		const BYTE* data;
+		size_t length;
+	} rdpTransportBuffer;
+
+	/**
+	 * @brief Write a whole PDU given as a list of buffers (e.g. headers and payload) to the
+	 * transport, in order and without interleaving other writes.
+	 * @param transport the transport to write to
+	 * @param buffers the buffers to write
+	 * @param count the number of buffers
+	 *
+	 * @return a negative value for failure
+	 * @since version 3.16.0
+	 */
+	typedef int (*pTransportWriteVec)(rdpTransport* transport,
+	                                  const rdpTransportBuffer* WINPR_RESTRICT buffers,
+	                                  size_t count);
+
 	struct rdp_transport_io
 	{
 		pTCPConnect TCPConnect;
@@ -116,7 +137,8 @@ extern "C"
 		pTransportSetBlockingMode SetBlockingMode; /** @since version 3.3.0 */
 		pTransportConnectLayer ConnectLayer;       /** @since 3.9.0 */
 		pTransportAttachLayer AttachLayer;         /** @since 3.9.0 */
-		UINT64 reserved[64 - 12]; /* Reserve some space for ABI compatibility */
+		pTransportWriteVec WritePduVec;            /** @since 3.16.0 */
+		UINT64 reserved[64 - 13]; /* Reserve some space for ABI compatibility */
 	};
 	typedef struct rdp_transport_io rdpTransportIo;
 
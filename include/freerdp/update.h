@@ -112,6 +112,25 @@ extern "C"
 		BYTE* bitmapData;
 	} TS_BITMAP_DATA_EX;
 
+	/** @brief Fast-path update codes, see MS-RDPBCGR 2.2.9.1.2.1
+	 *  @since version 3.16.0
+	 */
+	enum FASTPATH_UPDATETYPE
+	{
+		FASTPATH_UPDATETYPE_ORDERS = 0x0,
+		FASTPATH_UPDATETYPE_BITMAP = 0x1,
+		FASTPATH_UPDATETYPE_PALETTE = 0x2,
+		FASTPATH_UPDATETYPE_SYNCHRONIZE = 0x3,
+		FASTPATH_UPDATETYPE_SURFCMDS = 0x4,
+		FASTPATH_UPDATETYPE_PTR_NULL = 0x5,
+		FASTPATH_UPDATETYPE_PTR_DEFAULT = 0x6,
+		FASTPATH_UPDATETYPE_PTR_POSITION = 0x8,
+		FASTPATH_UPDATETYPE_COLOR = 0x9,
+		FASTPATH_UPDATETYPE_CACHED = 0xA,
+		FASTPATH_UPDATETYPE_POINTER = 0xB,
+		FASTPATH_UPDATETYPE_LARGE_POINTER = 0xC
+	};
+
 	enum SURFCMD_CMDTYPE
 	{
 		CMDTYPE_SET_SURFACE_BITS = 0x0001,
@@ -197,6 +216,22 @@ extern "C"
 	                                      UINT32 imeConvMode);
 	typedef BOOL (*pServerStatusInfo)(rdpContext* context, UINT32 status);
 
+	/** @brief A fast-path update as raw, reassembled and decompressed update data
+	 *
+	 *  On the client the callback sees every received update before the library parses it,
+	 *  setting \b handled skips the parsing. On the server the registered callback sends the
+	 *  data as a fast-path update of the given code and sets \b handled.
+	 *
+	 *  @param context The RDP context
+	 *  @param updateCode A FASTPATH_UPDATETYPE code
+	 *  @param s The update data, from the current position to the end of the stream
+	 *  @param handled Set to \b TRUE if the update was consumed
+	 *  @return \b FALSE on error
+	 *  @since version 3.16.0
+	 */
+	typedef BOOL (*pFastPathUpdate)(rdpContext* context, BYTE updateCode, wStream* s,
+	                                BOOL* handled);
+
 	struct rdp_update
 	{
 		rdpContext* context;     /* 0 */
@@ -236,8 +271,9 @@ extern "C"
 		/* if autoCalculateBitmapData is set to TRUE, the server automatically
 		 * fills BITMAP_DATA struct members: flags, cbCompMainBodySize and cbCompFirstRowSize.
 		 */
-		BOOL autoCalculateBitmapData; /* 71 */
-		UINT32 paddingE[80 - 72];     /* 72 */
+		BOOL autoCalculateBitmapData;  /* 71 */
+		pFastPathUpdate FastPathUpdate; /* 72 */
+		UINT32 paddingE[80 - 73];       /* 73 */
 	};
 
 	FREERDP_API void rdp_update_lock(rdpUpdate* update);
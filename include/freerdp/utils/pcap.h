@@ -20,6 +20,8 @@
 #ifndef FREERDP_UTILS_PCAP_H
 #define FREERDP_UTILS_PCAP_H
 
+#include <winpr/stream.h>
+
 #include <freerdp/api.h>
 #include <freerdp/types.h>
 
@@ -73,6 +75,39 @@ extern "C"
 	FREERDP_API BOOL pcap_get_next_record_content(rdpPcap* pcap, pcap_record* record);
 	FREERDP_API void pcap_flush(rdpPcap* pcap);
 
+	/** @brief Read the next record without copying its data
+	 *
+	 *  Files opened for reading are memory mapped, \b s is initialized as a read only view of
+	 *  the record data in the mapping. The view is valid until the next call or pcap_close.
+	 *
+	 *  @param pcap The capture to read from
+	 *  @param header Receives the record header
+	 *  @param s An unused stream (e.g. on the stack) that receives the record data
+	 *
+	 *  @return \b TRUE for success, \b FALSE if there are no more (complete) records
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL pcap_get_next_record_view(rdpPcap* pcap, pcap_record_header* header,
+	                                           wStream* s);
+
+	/** @brief Number of complete records in a capture opened for reading
+	 *
+	 *  The first call scans all record headers of the file.
+	 *
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API size_t pcap_get_record_count(rdpPcap* pcap);
+
+	/** @brief Position a capture opened for reading at the record with the given index
+	 *
+	 *  @param pcap The capture
+	 *  @param index The record index, \b pcap_get_record_count positions at the end of the file
+	 *
+	 *  @return \b TRUE for success, \b FALSE if the index is out of range
+	 *  @since version 3.16.0
+	 */
+	FREERDP_API BOOL pcap_seek_record(rdpPcap* pcap, size_t index);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,65 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Static Tracepoints
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_UTILS_TRACEPOINT_H
+#define FREERDP_UTILS_TRACEPOINT_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+/**
+ * Static tracepoints along the transport to present pipeline, compiled in with
+ * WITH_TRACEPOINTS. Every tracepoint carries the id of the frame it belongs to (0 if the
+ * stage does not know it) and one stage specific value.
+ *
+ * On Linux these are USDT probes of the provider \b freerdp, a probe costs a single nop
+ * until a tracer attaches to it:
+ *
+ *   bpftrace -e 'usdt:*:freerdp:gfx_end_frame { printf("%d\n", arg0); }' -p <pid>
+ *
+ * On Windows they are TraceLogging events \b Tracepoint of the provider \b FreeRDP
+ * {67d2ccac-da3c-4240-aac1-c6474bf02db5} with the fields Stage, FrameId and Value.
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(WITH_TRACEPOINTS) && defined(_WIN32)
+	FREERDP_API void freerdp_tracepoint(const char* name, UINT64 frameId, UINT64 value);
+
+#define FREERDP_TRACEPOINT(name, frameId, value) \
+	freerdp_tracepoint(#name, (UINT64)(frameId), (UINT64)(value))
+#elif defined(WITH_TRACEPOINTS)
+#include <sys/sdt.h>
+
+#define FREERDP_TRACEPOINT(name, frameId, value) \
+	DTRACE_PROBE2(freerdp, name, (UINT64)(frameId), (UINT64)(value))
+#else
+#define FREERDP_TRACEPOINT(name, frameId, value) \
+	do                                           \
+	{                                            \
+	} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_UTILS_TRACEPOINT_H */
@@ -24,6 +24,7 @@
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/collections.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
@@ -40,9 +41,31 @@
 
 #define TAG FREERDP_TAG("cache.bitmap")
 
+/* Book keeping for one cache slot. While a budget is set the encoded
+ * bitmap is kept next to the decoded one, so a cold slot can drop its
+ * decoded bitmap and decode it again when the server references it. */
+struct s_bitmap_cache_entry
+{
+	BITMAP_CACHE_ENTRY* prev;
+	BITMAP_CACHE_ENTRY* next;
+	BOOL linked;
+	UINT32 id;
+	UINT32 index;
+	size_t size;
+	UINT64 key64;
+	BYTE* src;
+	UINT32 srcLength;
+	UINT32 width;
+	UINT32 height;
+	UINT32 bpp;
+	BOOL compressed;
+	UINT32 codecId;
+};
+
 static rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index);
 static BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index,
-                             rdpBitmap* bitmap);
+                             rdpBitmap* bitmap, const BYTE* src, UINT32 srcLength, UINT32 bpp,
+                             BOOL compressed, UINT32 codecId);
 
 static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
@@ -101,7 +124,6 @@ static BOOL update_gdi_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
 static BOOL update_gdi_cache_bitmap(rdpContext* context, const CACHE_BITMAP_ORDER* cacheBitmap)
 {
 	rdpBitmap* bitmap = NULL;
-	rdpBitmap* prevBitmap = NULL;
 	rdpCache* cache = context->cache;
 	bitmap = Bitmap_Alloc(context);
 
@@ -121,9 +143,9 @@ static BOOL update_gdi_cache_bitmap(rdpContext* context, const CACHE_BITMAP_ORDE
 	if (!bitmap->New(context, bitmap))
 		goto fail;
 
-	prevBitmap = bitmap_cache_get(cache->bitmap, cacheBitmap->cacheId, cacheBitmap->cacheIndex);
-	Bitmap_Free(context, prevBitmap);
-	return bitmap_cache_put(cache->bitmap, cacheBitmap->cacheId, cacheBitmap->cacheIndex, bitmap);
+	return bitmap_cache_put(cache->bitmap, cacheBitmap->cacheId, cacheBitmap->cacheIndex, bitmap,
+	                        cacheBitmap->bitmapDataStream, cacheBitmap->bitmapLength,
+	                        cacheBitmap->bitmapBpp, cacheBitmap->compressed, RDP_CODEC_ID_NONE);
 
 fail:
 	Bitmap_Free(context, bitmap);
@@ -133,7 +155,6 @@ fail:
 static BOOL update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDER* cacheBitmapV2)
 
 {
-	rdpBitmap* prevBitmap = NULL;
 	rdpCache* cache = context->cache;
 	rdpSettings* settings = context->settings;
 	rdpBitmap* bitmap = Bitmap_Alloc(context);
@@ -160,14 +181,13 @@ static BOOL update_gdi_cache_bitmap_v2(rdpContext* context, CACHE_BITMAP_V2_ORDE
 	                        cacheBitmapV2->compressed, RDP_CODEC_ID_NONE))
 		goto fail;
 
-	prevBitmap = bitmap_cache_get(cache->bitmap, cacheBitmapV2->cacheId, cacheBitmapV2->cacheIndex);
-
 	if (!bitmap->New(context, bitmap))
 		goto fail;
 
-	Bitmap_Free(context, prevBitmap);
 	return bitmap_cache_put(cache->bitmap, cacheBitmapV2->cacheId, cacheBitmapV2->cacheIndex,
-	                        bitmap);
+	                        bitmap, cacheBitmapV2->bitmapDataStream, cacheBitmapV2->bitmapLength,
+	                        cacheBitmapV2->bitmapBpp, cacheBitmapV2->compressed,
+	                        RDP_CODEC_ID_NONE);
 
 fail:
 	Bitmap_Free(context, bitmap);
@@ -177,7 +197,6 @@ fail:
 static BOOL update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDER* cacheBitmapV3)
 {
 	rdpBitmap* bitmap = NULL;
-	rdpBitmap* prevBitmap = NULL;
 	BOOL compressed = TRUE;
 	rdpCache* cache = context->cache;
 	rdpSettings* settings = context->settings;
@@ -207,16 +226,140 @@ static BOOL update_gdi_cache_bitmap_v3(rdpContext* context, CACHE_BITMAP_V3_ORDE
 	if (!bitmap->New(context, bitmap))
 		goto fail;
 
-	prevBitmap = bitmap_cache_get(cache->bitmap, cacheBitmapV3->cacheId, cacheBitmapV3->cacheIndex);
-	Bitmap_Free(context, prevBitmap);
 	return bitmap_cache_put(cache->bitmap, cacheBitmapV3->cacheId, cacheBitmapV3->cacheIndex,
-	                        bitmap);
+	                        bitmap, bitmapData->data, bitmapData->length, bitmapData->bpp,
+	                        compressed, bitmapData->codecID);
 
 fail:
 	Bitmap_Free(context, bitmap);
 	return FALSE;
 }
 
+static void bitmap_cache_lru_unlink(rdpBitmapCache* bitmapCache, BITMAP_CACHE_ENTRY* entry)
+{
+	if (!entry->linked)
+		return;
+
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		bitmapCache->lruHead = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		bitmapCache->lruTail = entry->prev;
+
+	entry->prev = NULL;
+	entry->next = NULL;
+	entry->linked = FALSE;
+}
+
+static void bitmap_cache_lru_touch(rdpBitmapCache* bitmapCache, BITMAP_CACHE_ENTRY* entry)
+{
+	if (bitmapCache->lruHead == entry)
+		return;
+
+	bitmap_cache_lru_unlink(bitmapCache, entry);
+	entry->next = bitmapCache->lruHead;
+
+	if (bitmapCache->lruHead)
+		bitmapCache->lruHead->prev = entry;
+	else
+		bitmapCache->lruTail = entry;
+
+	bitmapCache->lruHead = entry;
+	entry->linked = TRUE;
+}
+
+static void bitmap_cache_usage_add(rdpBitmapCache* bitmapCache, size_t bytes)
+{
+	bitmapCache->usage += bytes;
+	MemoryTag_Allocated(bitmapCache->memoryTag, bytes);
+}
+
+static void bitmap_cache_usage_sub(rdpBitmapCache* bitmapCache, size_t bytes)
+{
+	bitmapCache->usage -= bytes;
+	MemoryTag_Released(bitmapCache->memoryTag, bytes);
+}
+
+static size_t bitmap_cache_bitmap_size(const rdpBitmap* bitmap)
+{
+	if (bitmap->length > 0)
+		return bitmap->length;
+
+	return 4ull * bitmap->width * bitmap->height;
+}
+
+static rdpBitmap* bitmap_cache_entry_decode(rdpBitmapCache* bitmapCache,
+                                            const BITMAP_CACHE_ENTRY* entry)
+{
+	rdpContext* context = bitmapCache->context;
+	rdpBitmap* bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return NULL;
+
+	bitmap->key64 = entry->key64;
+
+	if (!Bitmap_SetDimensions(bitmap, WINPR_ASSERTING_INT_CAST(UINT16, entry->width),
+	                          WINPR_ASSERTING_INT_CAST(UINT16, entry->height)))
+		goto fail;
+
+	if (!bitmap->Decompress(context, bitmap, entry->src, entry->width, entry->height, entry->bpp,
+	                        entry->srcLength, entry->compressed, entry->codecId))
+		goto fail;
+
+	if (!bitmap->New(context, bitmap))
+		goto fail;
+
+	return bitmap;
+
+fail:
+	WLog_WARN(TAG, "failed to decode bitmap cache entry %" PRIu32 ":%" PRIu32 "", entry->id,
+	          entry->index);
+	Bitmap_Free(context, bitmap);
+	return NULL;
+}
+
+/* Drop the decoded bitmaps of the least recently used slots that can be
+ * decoded again until usage is back at 7/8 of the budget. The most
+ * recently used slot is never dropped, it is the one being drawn. */
+static void bitmap_cache_enforce_budget(rdpBitmapCache* bitmapCache)
+{
+	if ((bitmapCache->budget == 0) || (bitmapCache->usage <= bitmapCache->budget))
+		return;
+
+	const size_t target = bitmapCache->budget - bitmapCache->budget / 8;
+
+	while ((bitmapCache->usage > target) && bitmapCache->lruTail &&
+	       (bitmapCache->lruTail != bitmapCache->lruHead))
+	{
+		BITMAP_CACHE_ENTRY* entry = bitmapCache->lruTail;
+		BITMAP_V2_CELL* cell = &bitmapCache->cells[entry->id];
+
+		bitmap_cache_lru_unlink(bitmapCache, entry);
+		Bitmap_Free(bitmapCache->context, cell->entries[entry->index]);
+		cell->entries[entry->index] = NULL;
+		bitmap_cache_usage_sub(bitmapCache, entry->size);
+		entry->size = 0;
+	}
+}
+
+static void bitmap_cache_entry_clear(rdpBitmapCache* bitmapCache, BITMAP_CACHE_ENTRY* entry)
+{
+	bitmap_cache_lru_unlink(bitmapCache, entry);
+	bitmap_cache_usage_sub(bitmapCache, entry->size + entry->srcLength);
+	free(entry->src);
+
+	const UINT32 id = entry->id;
+	const UINT32 index = entry->index;
+	*entry = (BITMAP_CACHE_ENTRY){ 0 };
+	entry->id = id;
+	entry->index = index;
+}
+
 rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index)
 {
 	rdpBitmap* bitmap = NULL;
@@ -237,16 +380,39 @@ rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index
 		return NULL;
 	}
 
-	bitmap = bitmapCache->cells[id].entries[index];
+	BITMAP_V2_CELL* cell = &bitmapCache->cells[id];
+	BITMAP_CACHE_ENTRY* entry = &cell->info[index];
+	bitmap = cell->entries[index];
+
+	if (!bitmap && entry->src)
+	{
+		bitmap = bitmap_cache_entry_decode(bitmapCache, entry);
+
+		if (!bitmap)
+			return NULL;
+
+		cell->entries[index] = bitmap;
+		entry->size = bitmap_cache_bitmap_size(bitmap);
+		bitmap_cache_usage_add(bitmapCache, entry->size);
+	}
+
+	if (entry->src)
+	{
+		bitmap_cache_lru_touch(bitmapCache, entry);
+		bitmap_cache_enforce_budget(bitmapCache);
+	}
+
 	return bitmap;
 }
 
-BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpBitmap* bitmap)
+BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpBitmap* bitmap,
+                      const BYTE* src, UINT32 srcLength, UINT32 bpp, BOOL compressed,
+                      UINT32 codecId)
 {
-	if (id > bitmapCache->maxCells)
+	if (id >= bitmapCache->maxCells)
 	{
 		WLog_ERR(TAG, "put invalid bitmap cell id: %" PRIu32 "", id);
-		return FALSE;
+		goto fail;
 	}
 
 	if (index == BITMAP_CACHE_WAITING_LIST_INDEX)
@@ -256,11 +422,48 @@ BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index, rdpB
 	else if (index > bitmapCache->cells[id].number)
 	{
 		WLog_ERR(TAG, "put invalid bitmap index %" PRIu32 " in cell id: %" PRIu32 "", index, id);
-		return FALSE;
+		goto fail;
+	}
+
+	BITMAP_V2_CELL* cell = &bitmapCache->cells[id];
+	BITMAP_CACHE_ENTRY* entry = &cell->info[index];
+
+	Bitmap_Free(bitmapCache->context, cell->entries[index]);
+	bitmap_cache_entry_clear(bitmapCache, entry);
+
+	cell->entries[index] = bitmap;
+	entry->size = bitmap_cache_bitmap_size(bitmap);
+	bitmap_cache_usage_add(bitmapCache, entry->size);
+
+	/* Palette bitmaps are not kept encoded, decoding them later could pick
+	 * up a different palette. Neither are sources that are not smaller than
+	 * the decoded bitmap. */
+	if ((bitmapCache->budget > 0) && src && (bpp > 8) && (srcLength > 0) &&
+	    (srcLength < entry->size))
+	{
+		entry->src = malloc(srcLength);
+
+		if (entry->src)
+		{
+			memcpy(entry->src, src, srcLength);
+			entry->srcLength = srcLength;
+			entry->key64 = bitmap->key64;
+			entry->width = bitmap->width;
+			entry->height = bitmap->height;
+			entry->bpp = bpp;
+			entry->compressed = compressed;
+			entry->codecId = codecId;
+			bitmap_cache_usage_add(bitmapCache, srcLength);
+			bitmap_cache_lru_touch(bitmapCache, entry);
+			bitmap_cache_enforce_budget(bitmapCache);
+		}
 	}
 
-	bitmapCache->cells[id].entries[index] = bitmap;
 	return TRUE;
+
+fail:
+	Bitmap_Free(bitmapCache->context, bitmap);
+	return FALSE;
 }
 
 void bitmap_cache_register_callbacks(rdpUpdate* update)
@@ -324,6 +527,10 @@ static int bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
 			{
 				PERSISTENT_CACHE_ENTRY cacheEntry = { 0 };
 				rdpBitmap* bitmap = cell->entries[j];
+				rdpBitmap* decoded = NULL;
+
+				if (!bitmap && cell->info && cell->info[j].src && cell->info[j].key64)
+					bitmap = decoded = bitmap_cache_entry_decode(bitmapCache, &cell->info[j]);
 
 				if (!bitmap || !bitmap->key64)
 					continue;
@@ -334,12 +541,18 @@ static int bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
 				cacheEntry.height = WINPR_ASSERTING_INT_CAST(UINT16, bitmap->height);
 				const UINT64 size = 4ULL * bitmap->width * bitmap->height;
 				if (size > UINT32_MAX)
+				{
+					Bitmap_Free(context, decoded);
 					continue;
+				}
 				cacheEntry.size = (UINT32)size;
 				cacheEntry.flags = 0;
 				cacheEntry.data = bitmap->data;
 
-				if (persistent_cache_write_entry(persistent, &cacheEntry) < 1)
+				const int rc = persistent_cache_write_entry(persistent, &cacheEntry);
+				Bitmap_Free(context, decoded);
+
+				if (rc < 1)
 				{
 					status = -1;
 					goto end;
@@ -378,6 +591,9 @@ rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 	if (!bitmapCache->cells)
 		goto fail;
 	bitmapCache->maxCells = BitmapCacheV2NumCells;
+	bitmapCache->budget =
+	    1024ull * 1024ull * freerdp_settings_get_uint32(settings, FreeRDP_BitmapCacheBudget);
+	bitmapCache->memoryTag = MemoryTag_Get("bitmap_cache");
 
 	for (UINT32 i = 0; i < bitmapCache->maxCells; i++)
 	{
@@ -387,10 +603,17 @@ rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 		UINT32 nr = info->numEntries;
 		/* allocate an extra entry for BITMAP_CACHE_WAITING_LIST_INDEX */
 		cell->entries = (rdpBitmap**)calloc((nr + 1), sizeof(rdpBitmap*));
+		cell->info = (BITMAP_CACHE_ENTRY*)calloc((nr + 1), sizeof(BITMAP_CACHE_ENTRY));
 
-		if (!cell->entries)
+		if (!cell->entries || !cell->info)
 			goto fail;
 		cell->number = nr;
+
+		for (UINT32 j = 0; j < nr + 1; j++)
+		{
+			cell->info[j].id = i;
+			cell->info[j].index = j;
+		}
 	}
 
 	return bitmapCache;
@@ -416,6 +639,14 @@ void bitmap_cache_free(rdpBitmapCache* bitmapCache)
 			UINT32 j = 0;
 			BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
 
+			if (cell->info)
+			{
+				for (j = 0; j < cell->number + 1; j++)
+					free(cell->info[j].src);
+			}
+
+			free(cell->info);
+
 			if (!cell->entries)
 				continue;
 
@@ -431,6 +662,7 @@ void bitmap_cache_free(rdpBitmapCache* bitmapCache)
 		free(bitmapCache->cells);
 	}
 
+	bitmap_cache_usage_sub(bitmapCache, bitmapCache->usage);
 	persistent_cache_free(bitmapCache->persistent);
 
 	free(bitmapCache);
@@ -25,10 +25,13 @@
 
 #include <freerdp/cache/persistent.h>
 
+typedef struct s_bitmap_cache_entry BITMAP_CACHE_ENTRY;
+
 typedef struct
 {
 	UINT32 number;
 	rdpBitmap** entries;
+	BITMAP_CACHE_ENTRY* info;
 } BITMAP_V2_CELL;
 
 typedef struct
@@ -48,6 +51,12 @@ typedef struct
 	/* internal */
 	rdpContext* context;
 	rdpPersistentCache* persistent;
+
+	size_t budget;
+	size_t usage;
+	wMemoryTag* memoryTag; /* mirrors usage */
+	BITMAP_CACHE_ENTRY* lruHead;
+	BITMAP_CACHE_ENTRY* lruTail;
 } rdpBitmapCache;
 
 #ifdef __cplusplus
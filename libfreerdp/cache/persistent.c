@@ -20,14 +20,27 @@
 #include <freerdp/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/cast.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
 #include <winpr/stream.h>
 #include <winpr/assert.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
 
 #include <freerdp/cache/persistent.h>
 
+/* stdio buffer for writing a cache file, entries are small and written one by one */
+#define PERSISTENT_CACHE_WRITE_BUFFER_SIZE (1024 * 1024)
+
 struct rdp_persistent_cache
 {
 	FILE* fp;
@@ -37,6 +50,24 @@ struct rdp_persistent_cache
 	char* filename;
 	BYTE* bmpData;
 	UINT32 bmpSize;
+
+	/* read only mapping of the whole file, fp is NULL if this is used */
+	const BYTE* map;
+	size_t mapSize;
+	size_t offset;
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+	/* file offset of each entry */
+	UINT64* index;
+
+	/* a file being written is renamed to filename on close */
+	char* tmpFilename;
+	char* writeBuffer;
 };
 
 static const char sig_str[] = "RDP8bmp";
@@ -53,6 +84,101 @@ int persistent_cache_get_count(rdpPersistentCache* persistent)
 	return persistent->count;
 }
 
+static BOOL persistent_cache_map(rdpPersistentCache* persistent)
+{
+	WINPR_ASSERT(persistent);
+
+#if defined(_WIN32)
+	LARGE_INTEGER size = { 0 };
+
+	persistent->file = CreateFileA(persistent->filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+	                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (persistent->file == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!GetFileSizeEx(persistent->file, &size) || (size.QuadPart <= 0) ||
+	    ((UINT64)size.QuadPart > SIZE_MAX))
+		return FALSE;
+
+	persistent->mapping = CreateFileMappingA(persistent->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!persistent->mapping)
+		return FALSE;
+
+	persistent->map = MapViewOfFile(persistent->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!persistent->map)
+		return FALSE;
+
+	persistent->mapSize = (size_t)size.QuadPart;
+	return TRUE;
+#else
+	struct stat st = { 0 };
+
+	persistent->fd = open(persistent->filename, O_RDONLY | O_CLOEXEC);
+	if (persistent->fd < 0)
+		return FALSE;
+
+	if ((fstat(persistent->fd, &st) != 0) || (st.st_size <= 0) ||
+	    ((UINT64)st.st_size > SIZE_MAX))
+		return FALSE;
+
+	void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, persistent->fd, 0);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	persistent->map = map;
+	persistent->mapSize = (size_t)st.st_size;
+	return TRUE;
+#endif
+}
+
+static void persistent_cache_unmap(rdpPersistentCache* persistent)
+{
+	WINPR_ASSERT(persistent);
+
+#if defined(_WIN32)
+	if (persistent->map)
+		(void)UnmapViewOfFile(persistent->map);
+	if (persistent->mapping)
+		(void)CloseHandle(persistent->mapping);
+	if (persistent->file && (persistent->file != INVALID_HANDLE_VALUE))
+		(void)CloseHandle(persistent->file);
+	persistent->mapping = NULL;
+	persistent->file = NULL;
+#else
+	if (persistent->map)
+		(void)munmap(WINPR_CAST_CONST_PTR_AWAY(persistent->map, void*), persistent->mapSize);
+	if (persistent->fd >= 0)
+		(void)close(persistent->fd);
+	persistent->fd = -1;
+#endif
+	persistent->map = NULL;
+	persistent->mapSize = 0;
+	persistent->offset = 0;
+}
+
+/* reads from the mapping or the file, the mapping returns a view instead of a copy */
+static const BYTE* persistent_cache_read(rdpPersistentCache* persistent, void* buffer, size_t size)
+{
+	WINPR_ASSERT(persistent);
+
+	if (persistent->map)
+	{
+		if ((persistent->offset > persistent->mapSize) ||
+		    (size > persistent->mapSize - persistent->offset))
+			return NULL;
+
+		const BYTE* data = &persistent->map[persistent->offset];
+		persistent->offset += size;
+		if (buffer)
+			memcpy(buffer, data, size);
+		return data;
+	}
+
+	if (!buffer || (fread(buffer, size, 1, persistent->fp) != 1))
+		return NULL;
+	return buffer;
+}
+
 static int persistent_cache_read_entry_v2(rdpPersistentCache* persistent,
                                           PERSISTENT_CACHE_ENTRY* entry)
 {
@@ -61,7 +187,7 @@ static int persistent_cache_read_entry_v2(rdpPersistentCache* persistent,
 	WINPR_ASSERT(persistent);
 	WINPR_ASSERT(entry);
 
-	if (fread((void*)&entry2, sizeof(entry2), 1, persistent->fp) != 1)
+	if (!persistent_cache_read(persistent, &entry2, sizeof(entry2)))
 		return -1;
 
 	entry->key64 = entry2.key64;
@@ -70,11 +196,15 @@ static int persistent_cache_read_entry_v2(rdpPersistentCache* persistent,
 	entry->size = entry2.width * entry2.height * 4;
 	entry->flags = entry2.flags;
 
-	entry->data = persistent->bmpData;
+	if (entry->size > 0x4000)
+		return -1;
 
-	if (fread((void*)entry->data, 0x4000, 1, persistent->fp) != 1)
+	const BYTE* data =
+	    persistent_cache_read(persistent, persistent->map ? NULL : persistent->bmpData, 0x4000);
+	if (!data)
 		return -1;
 
+	entry->data = WINPR_CAST_CONST_PTR_AWAY(data, BYTE*);
 	return 1;
 }
 
@@ -113,25 +243,6 @@ static int persistent_cache_write_entry_v2(rdpPersistentCache* persistent,
 	return 1;
 }
 
-static int persistent_cache_read_v2(rdpPersistentCache* persistent)
-{
-	WINPR_ASSERT(persistent);
-	while (1)
-	{
-		PERSISTENT_CACHE_ENTRY_V2 entry = { 0 };
-
-		if (fread((void*)&entry, sizeof(entry), 1, persistent->fp) != 1)
-			break;
-
-		if (fseek(persistent->fp, 0x4000, SEEK_CUR) != 0)
-			break;
-
-		persistent->count++;
-	}
-
-	return 1;
-}
-
 static int persistent_cache_read_entry_v3(rdpPersistentCache* persistent,
                                           PERSISTENT_CACHE_ENTRY* entry)
 {
@@ -140,7 +251,7 @@ static int persistent_cache_read_entry_v3(rdpPersistentCache* persistent,
 	WINPR_ASSERT(persistent);
 	WINPR_ASSERT(entry);
 
-	if (fread(&entry3, sizeof(entry3), 1, persistent->fp) != 1)
+	if (!persistent_cache_read(persistent, &entry3, sizeof(entry3)))
 		return -1;
 
 	entry->key64 = entry3.key64;
@@ -152,7 +263,7 @@ static int persistent_cache_read_entry_v3(rdpPersistentCache* persistent,
 	entry->size = (UINT32)size;
 	entry->flags = 0;
 
-	if (entry->size > persistent->bmpSize)
+	if (!persistent->map && (entry->size > persistent->bmpSize))
 	{
 		persistent->bmpSize = entry->size;
 		BYTE* bmpData = (BYTE*)winpr_aligned_recalloc(persistent->bmpData, persistent->bmpSize,
@@ -164,11 +275,12 @@ static int persistent_cache_read_entry_v3(rdpPersistentCache* persistent,
 		persistent->bmpData = bmpData;
 	}
 
-	entry->data = persistent->bmpData;
-
-	if (fread((void*)entry->data, entry->size, 1, persistent->fp) != 1)
+	BYTE* buffer = persistent->map ? NULL : persistent->bmpData;
+	const BYTE* data = persistent_cache_read(persistent, buffer, entry->size);
+	if (!data)
 		return -1;
 
+	entry->data = WINPR_CAST_CONST_PTR_AWAY(data, BYTE*);
 	return 1;
 }
 
@@ -195,20 +307,68 @@ static int persistent_cache_write_entry_v3(rdpPersistentCache* persistent,
 	return 1;
 }
 
-static int persistent_cache_read_v3(rdpPersistentCache* persistent)
+static BOOL persistent_cache_add_index(rdpPersistentCache* persistent, size_t* capacity,
+                                       UINT64 offset)
 {
 	WINPR_ASSERT(persistent);
-	while (1)
+	WINPR_ASSERT(capacity);
+
+	if ((size_t)persistent->count >= *capacity)
 	{
-		PERSISTENT_CACHE_ENTRY_V3 entry = { 0 };
+		const size_t ncapacity = (*capacity > 0) ? *capacity * 2 : 1024;
+		UINT64* tmp = realloc(persistent->index, ncapacity * sizeof(UINT64));
+		if (!tmp)
+			return FALSE;
+		persistent->index = tmp;
+		*capacity = ncapacity;
+	}
 
-		if (fread((void*)&entry, sizeof(entry), 1, persistent->fp) != 1)
-			break;
+	persistent->index[persistent->count++] = offset;
+	return TRUE;
+}
+
+/**
+ * Counts the entries of the file and records where each of them starts. Only the entry headers
+ * are read, a mapped file does not page in any bitmap data here.
+ */
+static int persistent_cache_build_index(rdpPersistentCache* persistent, UINT64 start)
+{
+	size_t capacity = 0;
+	UINT64 offset = start;
+	const UINT64 headerSize = (persistent->version == 3) ? sizeof(PERSISTENT_CACHE_ENTRY_V3)
+	                                                     : sizeof(PERSISTENT_CACHE_ENTRY_V2);
 
-		if (_fseeki64(persistent->fp, (4LL * entry.width * entry.height), SEEK_CUR) != 0)
+	WINPR_ASSERT(persistent);
+	while (persistent->count < INT32_MAX)
+	{
+		UINT64 dataSize = 0x4000;
+
+		if (persistent->version == 3)
+		{
+			PERSISTENT_CACHE_ENTRY_V3 entry = { 0 };
+			if (!persistent_cache_read(persistent, &entry, sizeof(entry)))
+				break;
+			dataSize = 4ull * entry.width * entry.height;
+		}
+		else
+		{
+			PERSISTENT_CACHE_ENTRY_V2 entry = { 0 };
+			if (!persistent_cache_read(persistent, &entry, sizeof(entry)))
+				break;
+		}
+
+		if (persistent->map)
+		{
+			if (dataSize > persistent->mapSize - persistent->offset)
+				break;
+			persistent->offset += dataSize;
+		}
+		else if (_fseeki64(persistent->fp, (INT64)dataSize, SEEK_CUR) != 0)
 			break;
 
-		persistent->count++;
+		if (!persistent_cache_add_index(persistent, &capacity, offset))
+			return -1;
+		offset += headerSize + dataSize;
 	}
 
 	return 1;
@@ -227,6 +387,25 @@ int persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE
 	return -1;
 }
 
+int persistent_cache_seek_entry(rdpPersistentCache* persistent, int index)
+{
+	WINPR_ASSERT(persistent);
+
+	if (persistent->write || (index < 0) || (index >= persistent->count) || !persistent->index)
+		return -1;
+
+	const UINT64 offset = persistent->index[index];
+	if (persistent->map)
+	{
+		persistent->offset = (size_t)offset;
+		return 1;
+	}
+
+	if (_fseeki64(persistent->fp, (INT64)offset, SEEK_SET) != 0)
+		return -1;
+	return 1;
+}
+
 int persistent_cache_write_entry(rdpPersistentCache* persistent,
                                  const PERSISTENT_CACHE_ENTRY* entry)
 {
@@ -245,15 +424,21 @@ static int persistent_cache_open_read(rdpPersistentCache* persistent)
 {
 	BYTE sig[8] = { 0 };
 	int status = 1;
-	long offset = 0;
+	UINT64 offset = 0;
 
 	WINPR_ASSERT(persistent);
-	persistent->fp = winpr_fopen(persistent->filename, "rb");
 
-	if (!persistent->fp)
-		return -1;
+	/* fall back to reading the file if it can not be mapped */
+	if (!persistent_cache_map(persistent))
+	{
+		persistent_cache_unmap(persistent);
+		persistent->fp = winpr_fopen(persistent->filename, "rb");
 
-	if (fread(sig, 8, 1, persistent->fp) != 1)
+		if (!persistent->fp)
+			return -1;
+	}
+
+	if (!persistent_cache_read(persistent, sig, sizeof(sig)))
 		return -1;
 
 	if (memcmp(sig, sig_str, sizeof(sig_str)) == 0)
@@ -261,25 +446,27 @@ static int persistent_cache_open_read(rdpPersistentCache* persistent)
 	else
 		persistent->version = 2;
 
-	(void)fseek(persistent->fp, 0, SEEK_SET);
+	if (persistent->map)
+		persistent->offset = 0;
+	else
+		(void)fseek(persistent->fp, 0, SEEK_SET);
 
 	if (persistent->version == 3)
 	{
 		PERSISTENT_CACHE_HEADER_V3 header;
 
-		if (fread(&header, sizeof(header), 1, persistent->fp) != 1)
+		if (!persistent_cache_read(persistent, &header, sizeof(header)))
 			return -1;
 
-		status = persistent_cache_read_v3(persistent);
 		offset = sizeof(header);
 	}
-	else
-	{
-		status = persistent_cache_read_v2(persistent);
-		offset = 0;
-	}
 
-	(void)fseek(persistent->fp, offset, SEEK_SET);
+	status = persistent_cache_build_index(persistent, offset);
+
+	if (persistent->map)
+		persistent->offset = (size_t)offset;
+	else
+		(void)_fseeki64(persistent->fp, (INT64)offset, SEEK_SET);
 
 	return status;
 }
@@ -288,11 +475,21 @@ static int persistent_cache_open_write(rdpPersistentCache* persistent)
 {
 	WINPR_ASSERT(persistent);
 
-	persistent->fp = winpr_fopen(persistent->filename, "w+b");
+	size_t len = 0;
+	(void)winpr_asprintf(&persistent->tmpFilename, &len, "%s.tmp", persistent->filename);
+	if (!persistent->tmpFilename)
+		return -1;
+
+	persistent->fp = winpr_fopen(persistent->tmpFilename, "w+b");
 
 	if (!persistent->fp)
 		return -1;
 
+	persistent->writeBuffer = malloc(PERSISTENT_CACHE_WRITE_BUFFER_SIZE);
+	if (persistent->writeBuffer)
+		(void)setvbuf(persistent->fp, persistent->writeBuffer, _IOFBF,
+		              PERSISTENT_CACHE_WRITE_BUFFER_SIZE);
+
 	if (persistent->version == 3)
 	{
 		PERSISTENT_CACHE_HEADER_V3 header = { 0 };
@@ -332,14 +529,34 @@ int persistent_cache_open(rdpPersistentCache* persistent, const char* filename,
 
 int persistent_cache_close(rdpPersistentCache* persistent)
 {
+	int status = 1;
+
 	WINPR_ASSERT(persistent);
 	if (persistent->fp)
 	{
-		(void)fclose(persistent->fp);
+		if (fclose(persistent->fp) != 0)
+			status = -1;
 		persistent->fp = NULL;
+
+		/* an incomplete file never replaces the previous cache */
+		if (persistent->tmpFilename)
+		{
+			if ((status < 0) || !winpr_MoveFileEx(persistent->tmpFilename, persistent->filename,
+			                                      MOVEFILE_REPLACE_EXISTING))
+			{
+				(void)winpr_DeleteFile(persistent->tmpFilename);
+				status = -1;
+			}
+		}
 	}
 
-	return 1;
+	free(persistent->tmpFilename);
+	persistent->tmpFilename = NULL;
+	free(persistent->writeBuffer);
+	persistent->writeBuffer = NULL;
+	persistent_cache_unmap(persistent);
+
+	return status;
 }
 
 rdpPersistentCache* persistent_cache_new(void)
@@ -349,8 +566,11 @@ rdpPersistentCache* persistent_cache_new(void)
 	if (!persistent)
 		return NULL;
 
+#if !defined(_WIN32)
+	persistent->fd = -1;
+#endif
 	persistent->bmpSize = 0x4000;
-	persistent->bmpData = calloc(1, persistent->bmpSize);
+	persistent->bmpData = winpr_aligned_calloc(persistent->bmpSize, sizeof(BYTE), 32);
 
 	if (!persistent->bmpData)
 	{
@@ -369,6 +589,7 @@ void persistent_cache_free(rdpPersistentCache* persistent)
 	persistent_cache_close(persistent);
 
 	free(persistent->filename);
+	free(persistent->index);
 
 	winpr_aligned_free(persistent->bmpData);
 
@@ -0,0 +1,1177 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * codec benchmarking tool
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/image.h>
+#include <winpr/path.h>
+#include <winpr/stream.h>
+#include <winpr/string.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/codec/rfx.h>
+#include <freerdp/codec/progressive.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/interleaved.h>
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/clear.h>
+#include <freerdp/codec/zgfx.h>
+#include <freerdp/codec/h264.h>
+
+#if defined(EXPORT_ALL_SYMBOLS)
+/* The bulk compressors are internal to libfreerdp, only reachable with all symbols exported */
+#define WITH_BULK_BENCHMARK
+#include "../mppc.h"
+#include "../ncrush.h"
+#include "../xcrush.h"
+#endif
+
+#define BENCH_FORMAT PIXEL_FORMAT_BGRX32
+#define BENCH_TILE 64
+#define BENCH_BULK_CHUNK 16383
+
+typedef struct
+{
+	BYTE* data;
+	UINT32 width;
+	UINT32 height;
+	UINT32 stride;
+} codec_bench_frame;
+
+typedef struct
+{
+	char name[64];
+	codec_bench_frame* frames;
+	size_t count;
+} codec_bench_scenario;
+
+typedef struct
+{
+	const char* name;
+	void* (*create)(BOOL encoder, UINT32 width, UINT32 height);
+	void (*destroy)(void* ctx);
+	BOOL (*encode)(void* ctx, const codec_bench_frame* frame, wStream* s);
+	BOOL (*decode)(void* ctx, const BYTE* data, size_t length, codec_bench_frame* frame);
+} codec_bench_codec;
+
+typedef struct
+{
+	BOOL csv;
+	size_t frames;
+	UINT32 width;
+	UINT32 height;
+	const char* codecs;
+	const char* scenarios;
+	primitive_hints hint;
+} codec_bench_options;
+
+/* ------------------------------------------------------------------------- */
+/* Corpus of deterministic synthetic desktop frames */
+
+static UINT32 bench_rand(UINT32* state)
+{
+	/* xorshift32, the corpus must be identical between runs and machines */
+	UINT32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static void bench_fill(codec_bench_frame* frame, UINT32 x, UINT32 y, UINT32 w, UINT32 h,
+                       UINT32 color)
+{
+	for (UINT32 j = y; j < MIN(y + h, frame->height); j++)
+	{
+		BYTE* line = &frame->data[1ull * j * frame->stride];
+		for (UINT32 i = x; i < MIN(x + w, frame->width); i++)
+			FreeRDPWriteColor(&line[4ull * i], BENCH_FORMAT, color);
+	}
+}
+
+/* Draws an 8x16 pseudo glyph, the same id always gives the same shape */
+static void bench_glyph(codec_bench_frame* frame, UINT32 x, UINT32 y, UINT32 id, UINT32 color)
+{
+	UINT32 state = 0x9E3779B9u * (id + 1);
+
+	for (UINT32 j = 3; j < 14; j++)
+	{
+		const UINT32 bits = bench_rand(&state);
+		if (y + j >= frame->height)
+			break;
+
+		BYTE* line = &frame->data[1ull * (y + j) * frame->stride];
+		for (UINT32 i = 1; i < 7; i++)
+		{
+			if ((x + i < frame->width) && (bits & (1u << i)))
+				FreeRDPWriteColor(&line[4ull * (x + i)], BENCH_FORMAT, color);
+		}
+	}
+}
+
+/* A page of text in editor style, line numbers index a virtually endless document */
+static void bench_text_page(codec_bench_frame* frame, UINT32 top, UINT32 firstLine,
+                            size_t typed)
+{
+	const UINT32 text = FreeRDPGetColor(BENCH_FORMAT, 0x20, 0x20, 0x20, 0xFF);
+	const UINT32 keyword = FreeRDPGetColor(BENCH_FORMAT, 0x00, 0x00, 0xC0, 0xFF);
+
+	bench_fill(frame, 0, top, frame->width, frame->height - top,
+	           FreeRDPGetColor(BENCH_FORMAT, 0xFF, 0xFF, 0xFF, 0xFF));
+
+	for (UINT32 y = top, line = firstLine; y + 16 <= frame->height; y += 16, line++)
+	{
+		UINT32 state = 0x85EBCA6Bu * (line + 1);
+		UINT32 x = 8 + 8 * (bench_rand(&state) % 8);
+		size_t chars = 0;
+
+		while (x + 8 < frame->width - 8)
+		{
+			const UINT32 len = 2 + bench_rand(&state) % 8;
+			const UINT32 color = (bench_rand(&state) % 5) == 0 ? keyword : text;
+
+			if ((bench_rand(&state) % 7) == 0)
+				break;
+
+			for (UINT32 c = 0; (c < len) && (x + 8 < frame->width - 8); c++, x += 8)
+			{
+				/* The first lines grow while typing */
+				if ((line == firstLine) && (chars++ >= typed))
+					break;
+				bench_glyph(frame, x, y, bench_rand(&state) % 96, color);
+			}
+			x += 8;
+		}
+	}
+}
+
+static void bench_title_bar(codec_bench_frame* frame)
+{
+	for (UINT32 y = 0; y < MIN(24, frame->height); y++)
+	{
+		const BYTE c = (BYTE)(0x30 + 3 * y);
+		bench_fill(frame, 0, y, frame->width, 1, FreeRDPGetColor(BENCH_FORMAT, 0x10, c, 0xA0, 0xFF));
+	}
+
+	for (UINT32 x = 8; x < MIN(frame->width / 3, frame->width); x += 8)
+		bench_glyph(frame, x, 4, x / 8, FreeRDPGetColor(BENCH_FORMAT, 0xFF, 0xFF, 0xFF, 0xFF));
+}
+
+static void bench_render_text(codec_bench_frame* frame, size_t index)
+{
+	bench_title_bar(frame);
+	bench_text_page(frame, 24, 0, 40 + 8 * index);
+}
+
+static void bench_render_scroll(codec_bench_frame* frame, size_t index)
+{
+	bench_title_bar(frame);
+	bench_text_page(frame, 24, WINPR_ASSERTING_INT_CAST(UINT32, 3 * index), SIZE_MAX);
+}
+
+/* A video player window on a desktop, moving gradients with sensor noise */
+static void bench_render_video(codec_bench_frame* frame, size_t index)
+{
+	const UINT32 vx = frame->width / 4;
+	const UINT32 vy = frame->height / 4;
+	const UINT32 vw = frame->width / 2;
+	const UINT32 vh = frame->height / 2;
+	UINT32 state = 0xC2B2AE35u * (UINT32)(index + 1);
+
+	bench_fill(frame, 0, 0, frame->width, frame->height,
+	           FreeRDPGetColor(BENCH_FORMAT, 0x3A, 0x6E, 0xA5, 0xFF));
+	bench_title_bar(frame);
+
+	for (UINT32 y = 0; y < vh; y++)
+	{
+		BYTE* line = &frame->data[1ull * (vy + y) * frame->stride + 4ull * vx];
+		for (UINT32 x = 0; x < vw; x++)
+		{
+			const UINT32 noise = bench_rand(&state) & 0x07;
+			const UINT32 t = (UINT32)index * 5;
+			const BYTE r = (BYTE)(((x + t) * 255 / vw + noise) & 0xFF);
+			const BYTE g = (BYTE)(((y + 2 * t) * 255 / vh + noise) & 0xFF);
+			const BYTE b = (BYTE)((((x ^ y) + 3 * t) >> 1) & 0xFF);
+			FreeRDPWriteColor(&line[4ull * x], BENCH_FORMAT,
+			                      FreeRDPGetColor(BENCH_FORMAT, r, g, b, 0xFF));
+		}
+	}
+}
+
+static BOOL bench_frame_init(codec_bench_frame* frame, UINT32 width, UINT32 height)
+{
+	frame->width = width;
+	frame->height = height;
+	frame->stride = width * FreeRDPGetBytesPerPixel(BENCH_FORMAT);
+	frame->data = winpr_aligned_calloc(frame->stride, height, 32);
+	return frame->data != NULL;
+}
+
+static void bench_scenario_free(codec_bench_scenario* scenario)
+{
+	if (!scenario)
+		return;
+
+	for (size_t x = 0; x < scenario->count; x++)
+		winpr_aligned_free(scenario->frames[x].data);
+	free(scenario->frames);
+}
+
+static BOOL bench_scenario_generate(codec_bench_scenario* scenario, const char* name,
+                                    void (*render)(codec_bench_frame*, size_t), size_t count,
+                                    UINT32 width, UINT32 height)
+{
+	(void)_snprintf(scenario->name, sizeof(scenario->name), "%s", name);
+	scenario->frames = calloc(count, sizeof(codec_bench_frame));
+	if (!scenario->frames)
+		return FALSE;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (!bench_frame_init(&scenario->frames[x], width, height))
+			return FALSE;
+		scenario->count++;
+		render(&scenario->frames[x], x);
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_scenario_load(codec_bench_scenario* scenario, const char* path)
+{
+	BOOL rc = FALSE;
+	wImage* image = winpr_image_new();
+	const char* base = strrchr(path, '/');
+
+	(void)_snprintf(scenario->name, sizeof(scenario->name), "%s", base ? base + 1 : path);
+	scenario->frames = calloc(1, sizeof(codec_bench_frame));
+	if (!image || !scenario->frames)
+		goto fail;
+
+	if (winpr_image_read(image, path) <= 0)
+	{
+		(void)fprintf(stderr, "failed to read image %s\n", path);
+		goto fail;
+	}
+
+	if ((image->bitsPerPixel != 24) && (image->bitsPerPixel != 32))
+	{
+		(void)fprintf(stderr, "image %s: only 24 and 32 bpp are supported\n", path);
+		goto fail;
+	}
+
+	if (!bench_frame_init(&scenario->frames[0], image->width, image->height))
+		goto fail;
+	scenario->count = 1;
+
+	const UINT32 srcFormat =
+	    (image->bitsPerPixel == 24) ? PIXEL_FORMAT_BGR24 : PIXEL_FORMAT_BGRA32;
+	rc = freerdp_image_copy_no_overlap(scenario->frames[0].data, BENCH_FORMAT,
+	                                   scenario->frames[0].stride, 0, 0, image->width,
+	                                   image->height, image->data, srcFormat, image->scanline, 0,
+	                                   0, NULL, FREERDP_FLIP_NONE);
+fail:
+	winpr_image_free(image, TRUE);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Codecs */
+
+typedef struct
+{
+	RFX_CONTEXT* rfx;
+	REGION16 invalid;
+} bench_rfx;
+
+static void bench_rfx_destroy(void* ctx)
+{
+	bench_rfx* bench = ctx;
+	if (!bench)
+		return;
+	region16_uninit(&bench->invalid);
+	rfx_context_free(bench->rfx);
+	free(bench);
+}
+
+static void* bench_rfx_create(BOOL encoder, UINT32 width, UINT32 height)
+{
+	bench_rfx* bench = calloc(1, sizeof(bench_rfx));
+	if (!bench)
+		return NULL;
+
+	region16_init(&bench->invalid);
+	bench->rfx = rfx_context_new(encoder);
+	if (!bench->rfx || !rfx_context_reset(bench->rfx, width, height))
+	{
+		bench_rfx_destroy(bench);
+		return NULL;
+	}
+	rfx_context_set_pixel_format(bench->rfx, BENCH_FORMAT);
+	return bench;
+}
+
+static BOOL bench_rfx_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	bench_rfx* bench = ctx;
+	const RFX_RECT rect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, frame->width),
+		                    WINPR_ASSERTING_INT_CAST(UINT16, frame->height) };
+	return rfx_compose_message(bench->rfx, s, &rect, 1, frame->data, frame->width, frame->height,
+	                           frame->stride);
+}
+
+static BOOL bench_rfx_decode(void* ctx, const BYTE* data, size_t length, codec_bench_frame* frame)
+{
+	bench_rfx* bench = ctx;
+	region16_clear(&bench->invalid);
+	return rfx_process_message(bench->rfx, data, WINPR_ASSERTING_INT_CAST(UINT32, length), 0, 0,
+	                           frame->data, BENCH_FORMAT, frame->stride, frame->height,
+	                           &bench->invalid);
+}
+
+typedef struct
+{
+	PROGRESSIVE_CONTEXT* progressive;
+	REGION16 invalid;
+	UINT32 frameId;
+} bench_progressive;
+
+static void bench_progressive_destroy(void* ctx)
+{
+	bench_progressive* bench = ctx;
+	if (!bench)
+		return;
+	region16_uninit(&bench->invalid);
+	progressive_context_free(bench->progressive);
+	free(bench);
+}
+
+static void* bench_progressive_create(BOOL encoder, UINT32 width, UINT32 height)
+{
+	bench_progressive* bench = calloc(1, sizeof(bench_progressive));
+	if (!bench)
+		return NULL;
+
+	region16_init(&bench->invalid);
+	bench->progressive = progressive_context_new(encoder);
+	if (!bench->progressive)
+		goto fail;
+
+	if (!encoder && (progressive_create_surface_context(bench->progressive, 0, width, height) < 0))
+		goto fail;
+
+	return bench;
+fail:
+	bench_progressive_destroy(bench);
+	return NULL;
+}
+
+static BOOL bench_progressive_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	bench_progressive* bench = ctx;
+	BYTE* dst = NULL;
+	UINT32 dstSize = 0;
+
+	if (progressive_compress(bench->progressive, frame->data, frame->stride * frame->height,
+	                         BENCH_FORMAT, frame->width, frame->height, frame->stride, NULL, &dst,
+	                         &dstSize) < 0)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, dstSize))
+		return FALSE;
+	Stream_Write(s, dst, dstSize);
+	return TRUE;
+}
+
+static BOOL bench_progressive_decode(void* ctx, const BYTE* data, size_t length,
+                                     codec_bench_frame* frame)
+{
+	bench_progressive* bench = ctx;
+	region16_clear(&bench->invalid);
+	return progressive_decompress(bench->progressive, data,
+	                              WINPR_ASSERTING_INT_CAST(UINT32, length), frame->data,
+	                              BENCH_FORMAT, frame->stride, 0, 0, &bench->invalid, 0,
+	                              bench->frameId++) >= 0;
+}
+
+static void bench_planar_destroy(void* ctx)
+{
+	freerdp_bitmap_planar_context_free(ctx);
+}
+
+static void* bench_planar_create(WINPR_ATTR_UNUSED BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                                 WINPR_ATTR_UNUSED UINT32 height)
+{
+	/* Bitmap updates are sent in tiles of at most 64x64 pixels */
+	return freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE,
+	                                         BENCH_TILE, BENCH_TILE);
+}
+
+static BOOL bench_planar_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	for (UINT32 y = 0; y < frame->height; y += BENCH_TILE)
+	{
+		for (UINT32 x = 0; x < frame->width; x += BENCH_TILE)
+		{
+			const UINT32 w = MIN(BENCH_TILE, frame->width - x);
+			const UINT32 h = MIN(BENCH_TILE, frame->height - y);
+			const BYTE* src = &frame->data[1ull * y * frame->stride + 4ull * x];
+			UINT32 size = 0;
+			BYTE* dst =
+			    freerdp_bitmap_compress_planar(ctx, src, BENCH_FORMAT, w, h, frame->stride, NULL,
+			                                   &size);
+			if (!dst)
+				return FALSE;
+
+			const BOOL rc = Stream_EnsureRemainingCapacity(s, 4ull + size);
+			if (rc)
+			{
+				Stream_Write_UINT32(s, size);
+				Stream_Write(s, dst, size);
+			}
+			free(dst);
+			if (!rc)
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_planar_decode(void* ctx, const BYTE* data, size_t length,
+                                codec_bench_frame* frame)
+{
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+
+	for (UINT32 y = 0; y < frame->height; y += BENCH_TILE)
+	{
+		for (UINT32 x = 0; x < frame->width; x += BENCH_TILE)
+		{
+			const UINT32 w = MIN(BENCH_TILE, frame->width - x);
+			const UINT32 h = MIN(BENCH_TILE, frame->height - y);
+
+			if (!Stream_CheckAndLogRequiredLength("bench", s, 4))
+				return FALSE;
+			const UINT32 size = Stream_Get_UINT32(s);
+			if (!Stream_CheckAndLogRequiredLength("bench", s, size))
+				return FALSE;
+
+			if (!planar_decompress(ctx, Stream_ConstPointer(s), size, w, h, frame->data,
+			                       BENCH_FORMAT, frame->stride, x, y, w, h, FALSE))
+				return FALSE;
+			Stream_Seek(s, size);
+		}
+	}
+
+	return TRUE;
+}
+
+static void bench_interleaved_destroy(void* ctx)
+{
+	bitmap_interleaved_context_free(ctx);
+}
+
+static void* bench_interleaved_create(BOOL encoder, UINT32 width,
+                                      WINPR_ATTR_UNUSED UINT32 height)
+{
+	/* The encoder only supports tile widths that are a multiple of 4 */
+	if ((width % 4) != 0)
+		return NULL;
+	return bitmap_interleaved_context_new(encoder);
+}
+
+static BOOL bench_interleaved_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	for (UINT32 y = 0; y < frame->height; y += BENCH_TILE)
+	{
+		for (UINT32 x = 0; x < frame->width; x += BENCH_TILE)
+		{
+			const UINT32 w = MIN(BENCH_TILE, frame->width - x);
+			const UINT32 h = MIN(BENCH_TILE, frame->height - y);
+
+			if (!Stream_EnsureRemainingCapacity(s, 4ull + BENCH_TILE * BENCH_TILE * 4))
+				return FALSE;
+
+			const size_t pos = Stream_GetPosition(s);
+			UINT32 size = BENCH_TILE * BENCH_TILE * 4;
+			Stream_Seek(s, 4);
+			if (!interleaved_compress(ctx, Stream_Pointer(s), &size, w, h, frame->data,
+			                          BENCH_FORMAT, frame->stride, x, y, NULL, 24))
+				return FALSE;
+			Stream_SetPosition(s, pos);
+			Stream_Write_UINT32(s, size);
+			Stream_Seek(s, size);
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_interleaved_decode(void* ctx, const BYTE* data, size_t length,
+                                     codec_bench_frame* frame)
+{
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+
+	for (UINT32 y = 0; y < frame->height; y += BENCH_TILE)
+	{
+		for (UINT32 x = 0; x < frame->width; x += BENCH_TILE)
+		{
+			const UINT32 w = MIN(BENCH_TILE, frame->width - x);
+			const UINT32 h = MIN(BENCH_TILE, frame->height - y);
+
+			if (!Stream_CheckAndLogRequiredLength("bench", s, 4))
+				return FALSE;
+			const UINT32 size = Stream_Get_UINT32(s);
+			if (!Stream_CheckAndLogRequiredLength("bench", s, size))
+				return FALSE;
+
+			if (!interleaved_decompress(ctx, Stream_ConstPointer(s), size, w, h, 24, frame->data,
+			                            BENCH_FORMAT, frame->stride, x, y, w, h, NULL))
+				return FALSE;
+			Stream_Seek(s, size);
+		}
+	}
+
+	return TRUE;
+}
+
+static void bench_nsc_destroy(void* ctx)
+{
+	nsc_context_free(ctx);
+}
+
+static void* bench_nsc_create(WINPR_ATTR_UNUSED BOOL encoder, UINT32 width, UINT32 height)
+{
+	NSC_CONTEXT* nsc = nsc_context_new();
+	if (!nsc)
+		return NULL;
+
+	if (!nsc_context_reset(nsc, width, height) ||
+	    !nsc_context_set_parameters(nsc, NSC_COLOR_FORMAT, BENCH_FORMAT))
+	{
+		nsc_context_free(nsc);
+		return NULL;
+	}
+	return nsc;
+}
+
+static BOOL bench_nsc_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	return nsc_compose_message(ctx, s, frame->data, frame->width, frame->height, frame->stride);
+}
+
+static BOOL bench_nsc_decode(void* ctx, const BYTE* data, size_t length, codec_bench_frame* frame)
+{
+	return nsc_process_message(ctx, 32, frame->width, frame->height, data,
+	                           WINPR_ASSERTING_INT_CAST(UINT32, length), frame->data, BENCH_FORMAT,
+	                           frame->stride, 0, 0, frame->width, frame->height,
+	                           FREERDP_FLIP_NONE);
+}
+
+static void bench_clear_destroy(void* ctx)
+{
+	clear_context_free(ctx);
+}
+
+static void* bench_clear_create(BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                                WINPR_ATTR_UNUSED UINT32 height)
+{
+	return clear_context_new(encoder);
+}
+
+static BOOL bench_clear_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	return clear_compose_message(ctx, s, frame->data, BENCH_FORMAT, frame->stride, frame->width,
+	                             frame->height);
+}
+
+static BOOL bench_clear_decode(void* ctx, const BYTE* data, size_t length,
+                               codec_bench_frame* frame)
+{
+	return clear_decompress(ctx, data, WINPR_ASSERTING_INT_CAST(UINT32, length), frame->width,
+	                        frame->height, frame->data, BENCH_FORMAT, frame->stride, 0, 0,
+	                        frame->width, frame->height, NULL) >= 0;
+}
+
+static void bench_zgfx_destroy(void* ctx)
+{
+	zgfx_context_free(ctx);
+}
+
+static void* bench_zgfx_create(BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                               WINPR_ATTR_UNUSED UINT32 height)
+{
+	return zgfx_context_new(encoder);
+}
+
+static BOOL bench_zgfx_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	UINT32 flags = 0;
+	return zgfx_compress_to_stream(ctx, s, frame->data, frame->stride * frame->height, &flags) >=
+	       0;
+}
+
+static BOOL bench_zgfx_decode(void* ctx, const BYTE* data, size_t length, codec_bench_frame* frame)
+{
+	BYTE* dst = NULL;
+	UINT32 dstSize = 0;
+
+	if (zgfx_decompress(ctx, data, WINPR_ASSERTING_INT_CAST(UINT32, length), &dst, &dstSize, 0) <
+	    0)
+		return FALSE;
+
+	const BOOL rc = dstSize == frame->stride * frame->height;
+	if (rc)
+		memcpy(frame->data, dst, dstSize);
+	free(dst);
+	return rc;
+}
+
+#if defined(WITH_BULK_BENCHMARK)
+typedef int (*bench_bulk_compress_fn)(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                      BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                      UINT32* pFlags);
+typedef int (*bench_bulk_decompress_fn)(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                        const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags);
+
+/* Slow path PDUs are compressed in chunks below 16384 bytes, like bulk_compress does */
+static BOOL bench_bulk_encode(void* ctx, bench_bulk_compress_fn fkt, const codec_bench_frame* frame,
+                              wStream* s)
+{
+	BYTE buffer[65536] = { 0 };
+	const size_t size = 1ull * frame->stride * frame->height;
+
+	for (size_t offset = 0; offset < size; offset += BENCH_BULK_CHUNK)
+	{
+		const UINT32 len = (UINT32)MIN(BENCH_BULK_CHUNK, size - offset);
+		const BYTE* dst = NULL;
+		UINT32 dstSize = sizeof(buffer);
+		UINT32 flags = 0;
+
+		if (fkt(ctx, &frame->data[offset], len, buffer, &dst, &dstSize, &flags) < 0)
+			return FALSE;
+
+		if (!(flags & PACKET_COMPRESSED))
+		{
+			dst = &frame->data[offset];
+			dstSize = len;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(s, 8ull + dstSize))
+			return FALSE;
+		Stream_Write_UINT32(s, flags);
+		Stream_Write_UINT32(s, dstSize);
+		Stream_Write(s, dst, dstSize);
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_bulk_decode(void* ctx, bench_bulk_decompress_fn fkt, const BYTE* data,
+                              size_t length, codec_bench_frame* frame)
+{
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, length);
+	const size_t size = 1ull * frame->stride * frame->height;
+	size_t offset = 0;
+
+	while (Stream_GetRemainingLength(s) > 0)
+	{
+		if (!Stream_CheckAndLogRequiredLength("bench", s, 8))
+			return FALSE;
+		const UINT32 flags = Stream_Get_UINT32(s);
+		UINT32 plainSize = Stream_Get_UINT32(s);
+		if (!Stream_CheckAndLogRequiredLength("bench", s, plainSize))
+			return FALSE;
+
+		const BYTE* plain = Stream_ConstPointer(s);
+		Stream_Seek(s, plainSize);
+
+		/* Flushed but uncompressed packets still reset the history */
+		if (flags & (PACKET_COMPRESSED | PACKET_AT_FRONT | PACKET_FLUSHED))
+		{
+			if (fkt(ctx, plain, plainSize, &plain, &plainSize, flags) < 0)
+				return FALSE;
+		}
+
+		if (plainSize > size - offset)
+			return FALSE;
+		memcpy(&frame->data[offset], plain, plainSize);
+		offset += plainSize;
+	}
+
+	return offset == size;
+}
+
+static void bench_mppc_destroy(void* ctx)
+{
+	mppc_context_free(ctx);
+}
+
+static void* bench_mppc_create(BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                               WINPR_ATTR_UNUSED UINT32 height)
+{
+	/* 64K history, RDP 5.0 */
+	return mppc_context_new(1, encoder);
+}
+
+static int bench_mppc_compress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstBuffer,
+                               const BYTE** ppDstData, UINT32* pDstSize, UINT32* pFlags)
+{
+	return mppc_compress(ctx, pSrcData, SrcSize, pDstBuffer, ppDstData, pDstSize, pFlags);
+}
+
+static int bench_mppc_decompress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                 const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
+{
+	return mppc_decompress(ctx, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+}
+
+static BOOL bench_mppc_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	return bench_bulk_encode(ctx, bench_mppc_compress, frame, s);
+}
+
+static BOOL bench_mppc_decode(void* ctx, const BYTE* data, size_t length, codec_bench_frame* frame)
+{
+	return bench_bulk_decode(ctx, bench_mppc_decompress, data, length, frame);
+}
+
+static void bench_ncrush_destroy(void* ctx)
+{
+	ncrush_context_free(ctx);
+}
+
+static void* bench_ncrush_create(BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                                 WINPR_ATTR_UNUSED UINT32 height)
+{
+	return ncrush_context_new(encoder);
+}
+
+static int bench_ncrush_compress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                 BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                 UINT32* pFlags)
+{
+	return ncrush_compress(ctx, pSrcData, SrcSize, pDstBuffer, ppDstData, pDstSize, pFlags);
+}
+
+static int bench_ncrush_decompress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                   const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
+{
+	return ncrush_decompress(ctx, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+}
+
+static BOOL bench_ncrush_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	return bench_bulk_encode(ctx, bench_ncrush_compress, frame, s);
+}
+
+static BOOL bench_ncrush_decode(void* ctx, const BYTE* data, size_t length,
+                                codec_bench_frame* frame)
+{
+	return bench_bulk_decode(ctx, bench_ncrush_decompress, data, length, frame);
+}
+
+static void bench_xcrush_destroy(void* ctx)
+{
+	xcrush_context_free(ctx);
+}
+
+static void* bench_xcrush_create(BOOL encoder, WINPR_ATTR_UNUSED UINT32 width,
+                                 WINPR_ATTR_UNUSED UINT32 height)
+{
+	return xcrush_context_new(encoder);
+}
+
+static int bench_xcrush_compress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                 BYTE* pDstBuffer, const BYTE** ppDstData, UINT32* pDstSize,
+                                 UINT32* pFlags)
+{
+	return xcrush_compress(ctx, pSrcData, SrcSize, pDstBuffer, ppDstData, pDstSize, pFlags);
+}
+
+static int bench_xcrush_decompress(void* ctx, const BYTE* pSrcData, UINT32 SrcSize,
+                                   const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
+{
+	return xcrush_decompress(ctx, pSrcData, SrcSize, ppDstData, pDstSize, flags);
+}
+
+static BOOL bench_xcrush_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	return bench_bulk_encode(ctx, bench_xcrush_compress, frame, s);
+}
+
+static BOOL bench_xcrush_decode(void* ctx, const BYTE* data, size_t length,
+                                codec_bench_frame* frame)
+{
+	return bench_bulk_decode(ctx, bench_xcrush_decompress, data, length, frame);
+}
+#endif
+
+static void bench_h264_destroy(void* ctx)
+{
+	h264_context_free(ctx);
+}
+
+static void* bench_h264_create(BOOL encoder, UINT32 width, UINT32 height)
+{
+	H264_CONTEXT* h264 = h264_context_new(encoder);
+	if (!h264)
+		return NULL;
+
+	if (!h264_context_reset(h264, width, height))
+	{
+		h264_context_free(h264);
+		return NULL;
+	}
+	return h264;
+}
+
+static BOOL bench_h264_encode(void* ctx, const codec_bench_frame* frame, wStream* s)
+{
+	BYTE* dst = NULL;
+	UINT32 dstSize = 0;
+	RDPGFX_H264_METABLOCK meta = { 0 };
+	const RECTANGLE_16 rect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, frame->width),
+		                        WINPR_ASSERTING_INT_CAST(UINT16, frame->height) };
+
+	const INT32 rc = avc420_compress(ctx, frame->data, BENCH_FORMAT, frame->stride, frame->width,
+	                                 frame->height, &rect, &dst, &dstSize, &meta);
+	free_h264_metablock(&meta);
+	if (rc < 0)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, dstSize))
+		return FALSE;
+	Stream_Write(s, dst, dstSize);
+	return TRUE;
+}
+
+static BOOL bench_h264_decode(void* ctx, const BYTE* data, size_t length,
+                              codec_bench_frame* frame)
+{
+	const RECTANGLE_16 rect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, frame->width),
+		                        WINPR_ASSERTING_INT_CAST(UINT16, frame->height) };
+
+	return avc420_decompress(ctx, data, WINPR_ASSERTING_INT_CAST(UINT32, length), frame->data,
+	                         BENCH_FORMAT, frame->stride, frame->width, frame->height, &rect,
+	                         1) >= 0;
+}
+
+#define BENCH_CODEC(name)                                                                  \
+	{                                                                                      \
+		#name, bench_##name##_create, bench_##name##_destroy, bench_##name##_encode,       \
+		    bench_##name##_decode                                                          \
+	}
+
+static const codec_bench_codec codecs[] = {
+	BENCH_CODEC(rfx),         BENCH_CODEC(progressive), BENCH_CODEC(planar),
+	BENCH_CODEC(interleaved), BENCH_CODEC(nsc),         BENCH_CODEC(clear),
+	BENCH_CODEC(zgfx),
+#if defined(WITH_BULK_BENCHMARK)
+	BENCH_CODEC(mppc),        BENCH_CODEC(ncrush),      BENCH_CODEC(xcrush),
+#endif
+	BENCH_CODEC(h264),
+};
+
+/* ------------------------------------------------------------------------- */
+/* Measurement and reporting */
+
+typedef struct
+{
+	const char* codec;
+	const char* scenario;
+	const char* operation;
+	UINT32 width;
+	UINT32 height;
+	size_t frames;
+	UINT64 ns;
+	UINT64 rawBytes;
+	UINT64 encodedBytes;
+} codec_bench_result;
+
+static void bench_report(const codec_bench_options* options, const codec_bench_result* result)
+{
+	const double seconds = (double)result->ns / 1000000000.0;
+	const double mbps = seconds > 0.0 ? (double)result->rawBytes / 1000000.0 / seconds : 0.0;
+	const double fps = seconds > 0.0 ? (double)result->frames / seconds : 0.0;
+	const double ratio = result->encodedBytes > 0
+	                         ? (double)result->rawBytes / (double)result->encodedBytes
+	                         : 0.0;
+
+	if (options->csv)
+		printf("%s,%s,%s,%s,%" PRIu32 ",%" PRIu32 ",%" PRIuz ",%.6f,%.3f,%.3f,%" PRIu64 ",%.3f\n",
+		       primtives_hint_str(options->hint), result->codec, result->scenario,
+		       result->operation, result->width, result->height, result->frames, seconds, mbps,
+		       fps, result->encodedBytes, ratio);
+	else
+		printf("%-12s %-14s %-6s %5" PRIu32 "x%-5" PRIu32 " %4" PRIuz " frames %10.2f MB/s %9.2f "
+		       "frames/s  ratio %7.2f\n",
+		       result->codec, result->scenario, result->operation, result->width, result->height,
+		       result->frames, mbps, fps, ratio);
+}
+
+static BOOL bench_selected(const char* list, const char* name)
+{
+	if (!list)
+		return TRUE;
+
+	const size_t len = strlen(name);
+	for (const char* cur = list; cur && *cur; cur = strchr(cur, ','))
+	{
+		if (*cur == ',')
+			cur++;
+		if ((strncmp(cur, name, len) == 0) && ((cur[len] == ',') || (cur[len] == '\0')))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void bench_streams_free(wStream** streams, size_t count)
+{
+	if (!streams)
+		return;
+	for (size_t x = 0; x < count; x++)
+		Stream_Free(streams[x], TRUE);
+	free((void*)streams);
+}
+
+static int bench_codec_scenario(const codec_bench_options* options, const codec_bench_codec* codec,
+                                const codec_bench_scenario* scenario)
+{
+	int rc = -1;
+	const codec_bench_frame* first = &scenario->frames[0];
+	codec_bench_result result = { codec->name, scenario->name, "encode", first->width,
+		                          first->height,  scenario->count, 0, 0, 0 };
+	codec_bench_frame output = { 0 };
+	wStream** streams = (wStream**)calloc(scenario->count, sizeof(wStream*));
+	void* encoder = codec->create(TRUE, first->width, first->height);
+	void* decoder = codec->create(FALSE, first->width, first->height);
+
+	if (!encoder || !decoder)
+	{
+		(void)fprintf(stderr, "%s: not available for %s, skipping\n", codec->name,
+		              scenario->name);
+		rc = 0;
+		goto fail;
+	}
+
+	if (!streams || !bench_frame_init(&output, first->width, first->height))
+		goto fail;
+
+	for (size_t x = 0; x < scenario->count; x++)
+	{
+		const codec_bench_frame* frame = &scenario->frames[x];
+		streams[x] = Stream_New(NULL, 1024);
+		if (!streams[x])
+			goto fail;
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		const BOOL status = codec->encode(encoder, frame, streams[x]);
+		result.ns += winpr_GetTickCount64NS() - start;
+		if (!status)
+		{
+			(void)fprintf(stderr, "%s: encoding %s frame %" PRIuz " failed\n", codec->name,
+			              scenario->name, x);
+			goto fail;
+		}
+
+		Stream_SealLength(streams[x]);
+		result.rawBytes += 1ull * frame->width * frame->height * 4;
+		result.encodedBytes += Stream_Length(streams[x]);
+	}
+	bench_report(options, &result);
+
+	result.operation = "decode";
+	result.ns = 0;
+	for (size_t x = 0; x < scenario->count; x++)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		const BOOL status = codec->decode(decoder, Stream_Buffer(streams[x]),
+		                                  Stream_Length(streams[x]), &output);
+		result.ns += winpr_GetTickCount64NS() - start;
+		if (!status)
+		{
+			(void)fprintf(stderr, "%s: decoding %s frame %" PRIuz " failed\n", codec->name,
+			              scenario->name, x);
+			goto fail;
+		}
+	}
+	bench_report(options, &result);
+
+	rc = 0;
+fail:
+	winpr_aligned_free(output.data);
+	bench_streams_free(streams, scenario->count);
+	if (encoder)
+		codec->destroy(encoder);
+	if (decoder)
+		codec->destroy(decoder);
+	return rc;
+}
+
+static void bench_usage(const char* name)
+{
+	printf("Usage: %s [options] [image files]\n\n", name);
+	printf("Encodes and decodes a synthetic corpus of desktop frames (text, video, scroll)\n");
+	printf("and every given 24 or 32 bpp image with all available codecs.\n\n");
+	printf("  --csv                   machine readable output\n");
+	printf("  --frames=<count>        frames per synthetic scenario, default 10\n");
+	printf("  --size=<width>x<height> size of the synthetic frames, default 1920x1080\n");
+	printf("  --codecs=<list>         comma separated list of codecs to run\n");
+	printf("  --scenarios=<list>      comma separated list of synthetic scenarios to run\n");
+	printf("  --primitives=<type>     generic, cpu, gpu or auto (default)\n\n");
+	printf("Codecs:");
+	for (size_t x = 0; x < ARRAYSIZE(codecs); x++)
+		printf(" %s", codecs[x].name);
+	printf("\n");
+}
+
+static BOOL bench_parse_primitives(const char* value, primitive_hints* hint)
+{
+	const struct
+	{
+		const char* name;
+		primitive_hints hint;
+	} hints[] = { { "generic", PRIMITIVES_PURE_SOFT },
+		          { "cpu", PRIMITIVES_ONLY_CPU },
+		          { "gpu", PRIMITIVES_ONLY_GPU },
+		          { "auto", PRIMITIVES_AUTODETECT } };
+
+	for (size_t x = 0; x < ARRAYSIZE(hints); x++)
+	{
+		if (strcmp(value, hints[x].name) == 0)
+		{
+			*hint = hints[x].hint;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	codec_bench_options options = {
+		FALSE, 10, 1920, 1080, NULL, NULL, PRIMITIVES_AUTODETECT
+	};
+	const struct
+	{
+		const char* name;
+		void (*render)(codec_bench_frame*, size_t);
+	} generators[] = { { "text", bench_render_text },
+		               { "video", bench_render_video },
+		               { "scroll", bench_render_scroll } };
+	codec_bench_scenario* scenarios = calloc(ARRAYSIZE(generators) + (size_t)argc,
+	                                         sizeof(codec_bench_scenario));
+	size_t count = 0;
+
+	if (!scenarios)
+		return -1;
+
+	/* The primitives backend must be selected before any codec is created */
+	for (int x = 1; x < argc; x++)
+	{
+		const char* arg = argv[x];
+
+		if (strcmp(arg, "--csv") == 0)
+			options.csv = TRUE;
+		else if (strncmp(arg, "--frames=", 9) == 0)
+		{
+			errno = 0;
+			const unsigned long val = strtoul(&arg[9], NULL, 0);
+			if ((errno != 0) || (val == 0))
+				goto usage;
+			options.frames = val;
+		}
+		else if (strncmp(arg, "--size=", 7) == 0)
+		{
+			if ((sscanf(&arg[7], "%" SCNu32 "x%" SCNu32, &options.width, &options.height) != 2) ||
+			    (options.width == 0) || (options.height == 0) || (options.width > UINT16_MAX) ||
+			    (options.height > UINT16_MAX))
+				goto usage;
+		}
+		else if (strncmp(arg, "--codecs=", 9) == 0)
+			options.codecs = &arg[9];
+		else if (strncmp(arg, "--scenarios=", 12) == 0)
+			options.scenarios = &arg[12];
+		else if (strncmp(arg, "--primitives=", 13) == 0)
+		{
+			if (!bench_parse_primitives(&arg[13], &options.hint))
+				goto usage;
+		}
+		else if (strncmp(arg, "--", 2) == 0)
+			goto usage;
+	}
+	primitives_set_hints(options.hint);
+
+	for (size_t x = 0; x < ARRAYSIZE(generators); x++)
+	{
+		if (!bench_selected(options.scenarios, generators[x].name))
+			continue;
+		if (!bench_scenario_generate(&scenarios[count++], generators[x].name,
+		                             generators[x].render, options.frames, options.width,
+		                             options.height))
+			goto fail;
+	}
+
+	for (int x = 1; x < argc; x++)
+	{
+		if (strncmp(argv[x], "--", 2) == 0)
+			continue;
+		if (!bench_scenario_load(&scenarios[count++], argv[x]))
+			goto fail;
+	}
+
+	if (options.csv)
+		printf("primitives,codec,scenario,operation,width,height,frames,seconds,mb_per_s,"
+		       "frames_per_s,encoded_bytes,ratio\n");
+	else
+		printf("Primitives: %s\n", primtives_hint_str(options.hint));
+
+	for (size_t c = 0; c < ARRAYSIZE(codecs); c++)
+	{
+		if (!bench_selected(options.codecs, codecs[c].name))
+			continue;
+
+		for (size_t s = 0; s < count; s++)
+		{
+			if (bench_codec_scenario(&options, &codecs[c], &scenarios[s]) < 0)
+				goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	for (size_t x = 0; x < count; x++)
+		bench_scenario_free(&scenarios[x]);
+	free(scenarios);
+	return rc;
+
+usage:
+	bench_usage(argv[0]);
+	free(scenarios);
+	return -1;
+}
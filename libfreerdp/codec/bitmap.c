@@ -19,47 +19,101 @@
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/endian.h>
+#include <winpr/synch.h>
 
 #include <freerdp/config.h>
 
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
-static INLINE UINT16 GETPIXEL16(const void* WINPR_RESTRICT d, UINT32 x, UINT32 y, UINT32 w)
+#include "bitmap_types.h"
+#include "sse/bitmap_sse2.h"
+
+/* stands in for the line above the first one */
+static const BYTE bitmap_zero_line[64 * 4] = { 0 };
+
+static INIT_ONCE bitmap_kernels_once = INIT_ONCE_STATIC_INIT;
+static BITMAP_ENCODER_KERNELS bitmap_kernels = { bitmap_line_masks16_generic,
+	                                             bitmap_line_masks32_generic };
+
+static INLINE UINT16 GETPIXEL16(const BYTE* WINPR_RESTRICT line, UINT32 x)
 {
-	const BYTE* WINPR_RESTRICT src = (const BYTE*)d + ((y * w + x) * sizeof(UINT16));
-	return WINPR_ASSERTING_INT_CAST(UINT16, ((UINT16)src[1] << 8) | (UINT16)src[0]);
+	return winpr_Data_Get_UINT16(&line[2ull * x]);
 }
 
-static INLINE UINT32 GETPIXEL32(const void* WINPR_RESTRICT d, UINT32 x, UINT32 y, UINT32 w)
+/* BGRX or BGRA, only the colour is encoded */
+static INLINE UINT32 GETPIXEL32(const BYTE* WINPR_RESTRICT line, UINT32 x)
 {
-	const BYTE* WINPR_RESTRICT src = (const BYTE*)d + ((y * w + x) * sizeof(UINT32));
-	return (((UINT32)src[3]) << 24) | (((UINT32)src[2]) << 16) | (((UINT32)src[1]) << 8) |
-	       (src[0] & 0xFF);
+	return winpr_Data_Get_UINT32(&line[4ull * x]) & 0x00FFFFFF;
 }
 
-/*****************************************************************************/
-static INLINE UINT16 IN_PIXEL16(const void* WINPR_RESTRICT in_ptr, UINT32 in_x, UINT32 in_y,
-                                UINT32 in_w, UINT16 in_last_pixel)
+void bitmap_line_masks16_generic(const BYTE* WINPR_RESTRICT line,
+                                 const BYTE* WINPR_RESTRICT above, UINT32 count, UINT32 mix,
+                                 UINT64* WINPR_RESTRICT fill, UINT64* WINPR_RESTRICT mixed,
+                                 UINT64* WINPR_RESTRICT same)
 {
-	if (in_ptr == 0)
-		return 0;
-	else if (in_x < in_w)
-		return GETPIXEL16(in_ptr, in_x, in_y, in_w);
-	else
-		return in_last_pixel;
+	UINT64 f = 0;
+	UINT64 m = 0;
+	UINT64 s = 0;
+
+	WINPR_ASSERT(count <= 64);
+
+	for (UINT32 k = 0; k < count; k++)
+	{
+		const UINT16 pixel = GETPIXEL16(line, k);
+		const UINT16 ypixel = GETPIXEL16(above, k);
+
+		if (pixel == ypixel)
+			f |= 1ull << k;
+		if (pixel == (ypixel ^ mix))
+			m |= 1ull << k;
+		if ((k > 0) && (pixel == GETPIXEL16(line, k - 1)))
+			s |= 1ull << k;
+	}
+
+	*fill = f;
+	*mixed = m;
+	*same = s;
 }
 
-/*****************************************************************************/
-static INLINE UINT32 IN_PIXEL32(const void* WINPR_RESTRICT in_ptr, UINT32 in_x, UINT32 in_y,
-                                UINT32 in_w, UINT32 in_last_pixel)
+void bitmap_line_masks32_generic(const BYTE* WINPR_RESTRICT line,
+                                 const BYTE* WINPR_RESTRICT above, UINT32 count, UINT32 mix,
+                                 UINT64* WINPR_RESTRICT fill, UINT64* WINPR_RESTRICT mixed,
+                                 UINT64* WINPR_RESTRICT same)
 {
-	if (in_ptr == 0)
-		return 0;
-	else if (in_x < in_w)
-		return GETPIXEL32(in_ptr, in_x, in_y, in_w);
-	else
-		return in_last_pixel;
+	UINT64 f = 0;
+	UINT64 m = 0;
+	UINT64 s = 0;
+
+	WINPR_ASSERT(count <= 64);
+
+	for (UINT32 k = 0; k < count; k++)
+	{
+		const UINT32 pixel = GETPIXEL32(line, k);
+		const UINT32 ypixel = GETPIXEL32(above, k);
+
+		if (pixel == ypixel)
+			f |= 1ull << k;
+		if (pixel == (ypixel ^ mix))
+			m |= 1ull << k;
+		if ((k > 0) && (pixel == GETPIXEL32(line, k - 1)))
+			s |= 1ull << k;
+	}
+
+	*fill = f;
+	*mixed = m;
+	*same = s;
+}
+
+static BOOL CALLBACK bitmap_kernels_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	bitmap_init_sse2(&bitmap_kernels);
+	return TRUE;
 }
 
 /*****************************************************************************/
@@ -187,7 +241,7 @@ static INLINE UINT16 out_copy_count_3(UINT16 in_count, wStream* WINPR_RESTRICT i
 			Stream_Write_UINT16(in_s, in_count);
 		}
 
-		Stream_Write(in_s, Stream_Pointer(in_data), 3ULL * in_count);
+		Stream_Write(in_s, Stream_Buffer(in_data), 3ULL * in_count);
 	}
 
 	Stream_SetPosition(in_data, 0);
@@ -383,7 +437,7 @@ static INLINE UINT16 out_mix_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in
 /*****************************************************************************/
 /* fom */
 static INLINE UINT16 out_from_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      const int8_t* WINPR_RESTRICT in_mask, size_t in_mask_len)
+                                      const BYTE* WINPR_RESTRICT in_mask, size_t in_mask_len)
 {
 	if (in_count > 0)
 	{
@@ -415,7 +469,7 @@ static INLINE UINT16 out_from_count_2(UINT16 in_count, wStream* WINPR_RESTRICT i
 /*****************************************************************************/
 /* fill or mix (fom) */
 static INLINE UINT16 out_from_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      const int8_t* WINPR_RESTRICT in_mask, size_t in_mask_len)
+                                      const BYTE* WINPR_RESTRICT in_mask, size_t in_mask_len)
 {
 	if (in_count > 0)
 	{
@@ -444,10 +498,11 @@ static INLINE UINT16 out_from_count_3(UINT16 in_count, wStream* WINPR_RESTRICT i
 #define OUT_FOM_COUNT3(in_count, in_s, in_mask, in_mask_len) \
 	in_count = out_from_count_3(in_count, in_s, in_mask, in_mask_len)
 
-#define TEST_FILL ((last_line == 0 && pixel == 0) || (last_line != 0 && pixel == ypixel))
-#define TEST_MIX ((last_line == 0 && pixel == mix) || (last_line != 0 && pixel == (ypixel ^ mix)))
+/* fill, mixed and same come from the line masks, see pfnBitmapLineMasks */
+#define TEST_FILL fill
+#define TEST_MIX mixed
 #define TEST_FOM TEST_FILL || TEST_MIX
-#define TEST_COLOR pixel == last_pixel
+#define TEST_COLOR same
 #define TEST_BICOLOR                                                        \
 	((pixel != last_pixel) &&                                               \
 	 ((!bicolor_spin && (pixel == bicolor1) && (last_pixel == bicolor2)) || \
@@ -464,13 +519,15 @@ static INLINE UINT16 out_from_count_3(UINT16 in_count, wStream* WINPR_RESTRICT i
 		bicolor_spin = FALSE; \
 	} while (0)
 
-static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcData, UINT32 width,
+static INLINE SSIZE_T freerdp_bitmap_compress_24(const BITMAP_ENCODER_KERNELS* kernels,
+                                                 const BYTE* WINPR_RESTRICT srcData,
+                                                 UINT32 nSrcStep, UINT32 width,
                                                  WINPR_ATTR_UNUSED UINT32 height,
                                                  wStream* WINPR_RESTRICT s, UINT32 byte_limit,
                                                  UINT32 start_line, wStream* WINPR_RESTRICT temp_s,
                                                  UINT32 e)
 {
-	int8_t fom_mask[8192] = { 0 }; /* good for up to 64K bitmap */
+	BYTE fom_mask[8192] = { 0 }; /* good for up to 64K bitmap */
 	SSIZE_T lines_sent = 0;
 	UINT16 count = 0;
 	UINT16 color_count = 0;
@@ -487,9 +544,12 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 	const UINT32 mix = 0xFFFFFF;
 	UINT16 fom_count = 0;
 	size_t fom_mask_len = 0;
-	const char* start = (const char*)srcData;
-	const char* line = start + 4ULL * width * start_line;
-	const char* last_line = NULL;
+	UINT64 fill_mask = 0;
+	UINT64 mix_mask = 0;
+	UINT64 same_mask = 0;
+	const BYTE* start = srcData;
+	const BYTE* line = start + 1ULL * nSrcStep * start_line;
+	const BYTE* last_line = NULL;
 
 	while ((line >= start) && (out_count < 32768))
 	{
@@ -506,9 +566,33 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 
 		for (UINT32 j = 0; j < end; j++)
 		{
-			/* read next pixel */
-			const UINT32 pixel = IN_PIXEL32(line, j, 0, width, last_pixel);
-			const UINT32 ypixel = IN_PIXEL32(last_line, j, 0, width, last_ypixel);
+			UINT32 pixel = last_pixel;
+			BOOL fill = FALSE;
+			BOOL mixed = FALSE;
+			BOOL same = TRUE;
+
+			if (j < width)
+			{
+				const UINT32 k = j % 64;
+				if (k == 0)
+					kernels->masks32(&line[4ULL * j],
+					                 last_line ? &last_line[4ULL * j] : bitmap_zero_line,
+					                 MIN(64, width - j), mix, &fill_mask, &mix_mask, &same_mask);
+
+				pixel = GETPIXEL32(line, j);
+				fill = ((fill_mask >> k) & 1) != 0;
+				mixed = ((mix_mask >> k) & 1) != 0;
+				same = (k == 0) ? (pixel == last_pixel) : (((same_mask >> k) & 1) != 0);
+				if (last_line && (j + 1 == width))
+					last_ypixel = GETPIXEL32(last_line, j);
+			}
+			else
+			{
+				/* the padding repeats the last pixel of both lines */
+				const UINT32 ypixel = last_line ? last_ypixel : 0;
+				fill = (pixel == ypixel);
+				mixed = (pixel == (ypixel ^ mix));
+			}
 
 			if (!TEST_FILL)
 			{
@@ -632,12 +716,9 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 					fom_mask_len++;
 				}
 
-				if (pixel == (ypixel ^ mix))
+				if (mixed)
 				{
-					const int tmp = (1 << (fom_count % 8));
-					const int val = fom_mask[fom_mask_len - 1] | tmp;
-					const int8_t ival = WINPR_ASSERTING_INT_CAST(int8_t, val);
-					fom_mask[fom_mask_len - 1] = ival;
+					fom_mask[fom_mask_len - 1] |= (BYTE)(1u << (fom_count % 8));
 				}
 
 				fom_count++;
@@ -648,7 +729,6 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 			Stream_Write_UINT8(temp_s, (pixel >> 16) & 0xff);
 			count++;
 			last_pixel = pixel;
-			last_ypixel = ypixel;
 		}
 
 		/* can't take fix, mix, or fom past first line */
@@ -699,7 +779,7 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 		}
 
 		last_line = line;
-		line = line - 4ULL * width;
+		line = line - nSrcStep;
 		start_line--;
 		lines_sent++;
 	}
@@ -774,13 +854,15 @@ static INLINE SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcD
 	return lines_sent;
 }
 
-static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcData, UINT32 width,
+static INLINE SSIZE_T freerdp_bitmap_compress_16(const BITMAP_ENCODER_KERNELS* kernels,
+                                                 const BYTE* WINPR_RESTRICT srcData,
+                                                 UINT32 nSrcStep, UINT32 width,
                                                  WINPR_ATTR_UNUSED UINT32 height,
                                                  wStream* WINPR_RESTRICT s, UINT32 bpp,
                                                  UINT32 byte_limit, UINT32 start_line,
                                                  wStream* WINPR_RESTRICT temp_s, UINT32 e)
 {
-	int8_t fom_mask[8192] = { 0 }; /* good for up to 64K bitmap */
+	BYTE fom_mask[8192] = { 0 }; /* good for up to 64K bitmap */
 	SSIZE_T lines_sent = 0;
 	UINT16 count = 0;
 	UINT16 color_count = 0;
@@ -797,9 +879,12 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 	const UINT32 mix = (bpp == 15) ? 0xBA1F : 0xFFFF;
 	UINT16 fom_count = 0;
 	size_t fom_mask_len = 0;
-	const char* start = (const char*)srcData;
-	const char* line = start + 2ULL * width * start_line;
-	const char* last_line = NULL;
+	UINT64 fill_mask = 0;
+	UINT64 mix_mask = 0;
+	UINT64 same_mask = 0;
+	const BYTE* start = srcData;
+	const BYTE* line = start + 1ULL * nSrcStep * start_line;
+	const BYTE* last_line = NULL;
 
 	while ((line >= start) && (out_count < 32768))
 	{
@@ -816,9 +901,33 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 
 		for (UINT32 j = 0; j < end; j++)
 		{
-			/* read next pixel */
-			const UINT16 pixel = IN_PIXEL16(line, j, 0, width, last_pixel);
-			const UINT16 ypixel = IN_PIXEL16(last_line, j, 0, width, last_ypixel);
+			UINT16 pixel = last_pixel;
+			BOOL fill = FALSE;
+			BOOL mixed = FALSE;
+			BOOL same = TRUE;
+
+			if (j < width)
+			{
+				const UINT32 k = j % 64;
+				if (k == 0)
+					kernels->masks16(&line[2ULL * j],
+					                 last_line ? &last_line[2ULL * j] : bitmap_zero_line,
+					                 MIN(64, width - j), mix, &fill_mask, &mix_mask, &same_mask);
+
+				pixel = GETPIXEL16(line, j);
+				fill = ((fill_mask >> k) & 1) != 0;
+				mixed = ((mix_mask >> k) & 1) != 0;
+				same = (k == 0) ? (pixel == last_pixel) : (((same_mask >> k) & 1) != 0);
+				if (last_line && (j + 1 == width))
+					last_ypixel = GETPIXEL16(last_line, j);
+			}
+			else
+			{
+				/* the padding repeats the last pixel of both lines */
+				const UINT16 ypixel = last_line ? last_ypixel : 0;
+				fill = (pixel == ypixel);
+				mixed = (pixel == (ypixel ^ mix));
+			}
 
 			if (!TEST_FILL)
 			{
@@ -942,12 +1051,9 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 					fom_mask_len++;
 				}
 
-				if (pixel == (ypixel ^ mix))
+				if (mixed)
 				{
-					const int tmp = (1 << (fom_count % 8));
-					const int val = fom_mask[fom_mask_len - 1] | tmp;
-					const int8_t ival = WINPR_ASSERTING_INT_CAST(int8_t, val);
-					fom_mask[fom_mask_len - 1] = ival;
+					fom_mask[fom_mask_len - 1] |= (BYTE)(1u << (fom_count % 8));
 				}
 
 				fom_count++;
@@ -956,7 +1062,6 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 			Stream_Write_UINT16(temp_s, pixel);
 			count++;
 			last_pixel = pixel;
-			last_ypixel = ypixel;
 		}
 
 		/* can't take fix, mix, or fom past first line */
@@ -1007,7 +1112,7 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 		}
 
 		last_line = line;
-		line = line - 2ULL * width;
+		line = line - nSrcStep;
 		start_line--;
 		lines_sent++;
 	}
@@ -1082,24 +1187,43 @@ static INLINE SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcD
 	return lines_sent;
 }
 
-SSIZE_T freerdp_bitmap_compress(const void* WINPR_RESTRICT srcData, UINT32 width, UINT32 height,
-                                wStream* WINPR_RESTRICT s, UINT32 bpp, UINT32 byte_limit,
-                                UINT32 start_line, wStream* WINPR_RESTRICT temp_s, UINT32 e)
+SSIZE_T freerdp_bitmap_compress_ex(const BYTE* WINPR_RESTRICT srcData, UINT32 nSrcStep,
+                                   UINT32 width, UINT32 height, wStream* WINPR_RESTRICT s,
+                                   UINT32 bpp, UINT32 byte_limit, UINT32 start_line,
+                                   wStream* WINPR_RESTRICT temp_s, UINT32 e)
 {
+	if (!InitOnceExecuteOnce(&bitmap_kernels_once, bitmap_kernels_init, NULL, NULL))
+		return -1;
+
 	Stream_SetPosition(temp_s, 0);
 
 	switch (bpp)
 	{
 		case 15:
 		case 16:
-			return freerdp_bitmap_compress_16(srcData, width, height, s, bpp, byte_limit,
-			                                  start_line, temp_s, e);
+			if (nSrcStep < 2ULL * width)
+				return -1;
+			return freerdp_bitmap_compress_16(&bitmap_kernels, srcData, nSrcStep, width, height, s,
+			                                  bpp, byte_limit, start_line, temp_s, e);
 
 		case 24:
-			return freerdp_bitmap_compress_24(srcData, width, height, s, byte_limit, start_line,
-			                                  temp_s, e);
+			if (nSrcStep < 4ULL * width)
+				return -1;
+			return freerdp_bitmap_compress_24(&bitmap_kernels, srcData, nSrcStep, width, height, s,
+			                                  byte_limit, start_line, temp_s, e);
 
 		default:
 			return -1;
 	}
 }
+
+SSIZE_T freerdp_bitmap_compress(const void* WINPR_RESTRICT srcData, UINT32 width, UINT32 height,
+                                wStream* WINPR_RESTRICT s, UINT32 bpp, UINT32 byte_limit,
+                                UINT32 start_line, wStream* WINPR_RESTRICT temp_s, UINT32 e)
+{
+	const UINT32 bytes = (bpp > 16) ? 4 : 2;
+	if (width > UINT32_MAX / bytes)
+		return -1;
+	return freerdp_bitmap_compress_ex(srcData, width * bytes, width, height, s, bpp, byte_limit,
+	                                  start_line, temp_s, e);
+}
@@ -0,0 +1,61 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bitmap Compression
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_BITMAP_TYPES_H
+#define FREERDP_LIB_CODEC_BITMAP_TYPES_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+
+/* Classifies up to 64 pixels of a line, bit k of each mask describes pixel k:
+ * fill  - the pixel equals the one above
+ * mixed - the pixel equals the one above XOR mix
+ * same  - the pixel equals the one before it, bit 0 is left to the caller
+ * The 32bpp version only compares the low 24 bits of a pixel. */
+typedef void (*pfnBitmapLineMasks)(const BYTE* WINPR_RESTRICT line,
+                                   const BYTE* WINPR_RESTRICT above, UINT32 count, UINT32 mix,
+                                   UINT64* WINPR_RESTRICT fill, UINT64* WINPR_RESTRICT mixed,
+                                   UINT64* WINPR_RESTRICT same);
+
+typedef struct
+{
+	pfnBitmapLineMasks masks16;
+	pfnBitmapLineMasks masks32;
+} BITMAP_ENCODER_KERNELS;
+
+FREERDP_LOCAL void bitmap_line_masks16_generic(const BYTE* WINPR_RESTRICT line,
+                                               const BYTE* WINPR_RESTRICT above, UINT32 count,
+                                               UINT32 mix, UINT64* WINPR_RESTRICT fill,
+                                               UINT64* WINPR_RESTRICT mixed,
+                                               UINT64* WINPR_RESTRICT same);
+FREERDP_LOCAL void bitmap_line_masks32_generic(const BYTE* WINPR_RESTRICT line,
+                                               const BYTE* WINPR_RESTRICT above, UINT32 count,
+                                               UINT32 mix, UINT64* WINPR_RESTRICT fill,
+                                               UINT64* WINPR_RESTRICT mixed,
+                                               UINT64* WINPR_RESTRICT same);
+
+/* Same as freerdp_bitmap_compress for lines nSrcStep bytes apart. At 24bpp the source is
+ * 32bpp BGRX or BGRA, the alpha channel is ignored. */
+FREERDP_LOCAL SSIZE_T freerdp_bitmap_compress_ex(const BYTE* WINPR_RESTRICT srcData,
+                                                 UINT32 nSrcStep, UINT32 width, UINT32 height,
+                                                 wStream* WINPR_RESTRICT s, UINT32 bpp,
+                                                 UINT32 byte_limit, UINT32 start_line,
+                                                 wStream* WINPR_RESTRICT temp_s, UINT32 e);
+
+#endif /* FREERDP_LIB_CODEC_BITMAP_TYPES_H */
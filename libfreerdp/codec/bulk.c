@@ -33,6 +33,17 @@
 
 //#define WITH_BULK_DEBUG 1
 
+/* Adaptive mode: links at least this fast (kbit/s) and this close (ms) are treated as LAN */
+#define BULK_ADAPTIVE_LAN_BANDWIDTH 100000
+#define BULK_ADAPTIVE_LAN_RTT 5
+
+/* Adaptive mode: PDUs compressing worse than this (compressed / uncompressed) back off */
+#define BULK_ADAPTIVE_LAN_RATIO 0.9
+#define BULK_ADAPTIVE_WAN_RATIO 0.98
+
+/* Adaptive mode: maximum number of PDUs sent uncompressed before probing again */
+#define BULK_ADAPTIVE_MAX_BACKOFF 64
+
 struct rdp_bulk
 {
 	ALIGN64 rdpContext* context;
@@ -44,6 +55,8 @@ struct rdp_bulk
 	ALIGN64 NCRUSH_CONTEXT* ncrushSend;
 	ALIGN64 XCRUSH_CONTEXT* xcrushRecv;
 	ALIGN64 XCRUSH_CONTEXT* xcrushSend;
+	ALIGN64 UINT32 AdaptiveBackoff;
+	ALIGN64 UINT32 AdaptiveSkip;
 	ALIGN64 BYTE OutputBuffer[65536];
 };
 
@@ -95,6 +108,77 @@ UINT16 bulk_compression_max_size(rdpBulk* WINPR_RESTRICT bulk)
 	return bulk->CompressionMaxSize;
 }
 
+static BOOL bulk_adaptive_is_lan(rdpBulk* WINPR_RESTRICT bulk)
+{
+	WINPR_ASSERT(bulk);
+	WINPR_ASSERT(bulk->context);
+
+	const rdpAutoDetect* autodetect = bulk->context->autodetect;
+
+	if (!autodetect || (autodetect->netCharBandwidth == 0) || (autodetect->netCharAverageRTT == 0))
+		return FALSE;
+
+	return (autodetect->netCharBandwidth >= BULK_ADAPTIVE_LAN_BANDWIDTH) &&
+	       (autodetect->netCharAverageRTT <= BULK_ADAPTIVE_LAN_RTT);
+}
+
+/* Already compressed payloads (H.264, RemoteFX, images) use most byte values in any sample */
+static BOOL bulk_adaptive_is_incompressible(const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize)
+{
+	BYTE seen[256] = { 0 };
+	size_t distinct = 0;
+	const size_t samples = 256;
+
+	WINPR_ASSERT(pSrcData);
+
+	/* Short PDUs use many distinct values even when they compress well */
+	if (SrcSize < 4 * samples)
+		return FALSE;
+
+	const size_t step = SrcSize / samples;
+
+	for (size_t x = 0; x < samples; x++)
+	{
+		const BYTE val = pSrcData[x * step];
+
+		distinct += !seen[val];
+		seen[val] = 1;
+	}
+
+	/* 256 random bytes give about 162 distinct values */
+	return distinct >= (samples * 9 / 16);
+}
+
+static BOOL bulk_adaptive_skip(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSrcData,
+                               UINT32 SrcSize)
+{
+	WINPR_ASSERT(bulk);
+
+	if (bulk->AdaptiveSkip > 0)
+	{
+		bulk->AdaptiveSkip--;
+		return TRUE;
+	}
+
+	return bulk_adaptive_is_incompressible(pSrcData, SrcSize);
+}
+
+static void bulk_adaptive_update(rdpBulk* WINPR_RESTRICT bulk, double CompressionRatio)
+{
+	WINPR_ASSERT(bulk);
+
+	const double limit =
+	    bulk_adaptive_is_lan(bulk) ? BULK_ADAPTIVE_LAN_RATIO : BULK_ADAPTIVE_WAN_RATIO;
+
+	if (CompressionRatio > limit)
+	{
+		bulk->AdaptiveBackoff = MIN(MAX(bulk->AdaptiveBackoff * 2, 1), BULK_ADAPTIVE_MAX_BACKOFF);
+		bulk->AdaptiveSkip = bulk->AdaptiveBackoff;
+	}
+	else
+		bulk->AdaptiveBackoff = 0;
+}
+
 #if defined(WITH_BULK_DEBUG)
 static INLINE int bulk_compress_validate(rdpBulk* bulk, const BYTE* pSrcData, UINT32 SrcSize,
                                          const BYTE* pDstData, UINT32 DstSize, UINT32 Flags)
@@ -259,6 +343,16 @@ int bulk_compress(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSrcD
 		return 0;
 	}
 
+	const BOOL adaptive = bulk->context->settings->CompressionAdaptive;
+
+	/* Sending a PDU uncompressed leaves the history of both peers untouched */
+	if (adaptive && bulk_adaptive_skip(bulk, pSrcData, SrcSize))
+	{
+		*ppDstData = pSrcData;
+		*pDstSize = SrcSize;
+		return 0;
+	}
+
 	*pDstSize = sizeof(bulk->OutputBuffer);
 	(void)bulk_compression_level(bulk);
 	(void)bulk_compression_max_size(bulk);
@@ -295,6 +389,9 @@ int bulk_compress(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSrcD
 		const UINT32 UncompressedBytes = SrcSize;
 		const double CompressionRatio =
 		    metrics_write_bytes(metrics, UncompressedBytes, CompressedBytes);
+
+		if (adaptive)
+			bulk_adaptive_update(bulk, CompressionRatio);
 #ifdef WITH_BULK_DEBUG
 		{
 			WLog_DBG(TAG,
@@ -330,6 +427,8 @@ void bulk_reset(rdpBulk* WINPR_RESTRICT bulk)
 	ncrush_context_reset(bulk->ncrushSend, FALSE);
 	xcrush_context_reset(bulk->xcrushRecv, FALSE);
 	xcrush_context_reset(bulk->xcrushSend, FALSE);
+	bulk->AdaptiveBackoff = 0;
+	bulk->AdaptiveSkip = 0;
 }
 
 rdpBulk* bulk_new(rdpContext* context)
@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bulk Compression Match Helpers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_BULK_MATCH_H
+#define FREERDP_LIB_CODEC_BULK_MATCH_H
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/wtypes.h>
+
+/**
+ * Returns the number of leading bytes (at most max) that are equal in p1 and p2.
+ *
+ * Compares a machine word at a time and only falls back to bytes for the word
+ * holding the first difference. The buffers must not be written while scanning,
+ * callers with overlapping source and history must split the scan themselves.
+ */
+static inline size_t bulk_match_length(const BYTE* p1, const BYTE* p2, size_t max)
+{
+	size_t len = 0;
+
+	WINPR_ASSERT(p1 || (max == 0));
+	WINPR_ASSERT(p2 || (max == 0));
+
+	for (; len + sizeof(UINT64) <= max; len += sizeof(UINT64))
+	{
+		UINT64 v1 = 0;
+		UINT64 v2 = 0;
+		memcpy(&v1, &p1[len], sizeof(v1));
+		memcpy(&v2, &p2[len], sizeof(v2));
+
+		if (v1 != v2)
+			break;
+	}
+
+	while ((len < max) && (p1[len] == p2[len]))
+		len++;
+
+	return len;
+}
+
+#endif /* FREERDP_LIB_CODEC_BULK_MATCH_H */
@@ -37,21 +37,58 @@
 
 #define CLEARCODEC_VBAR_SIZE 32768
 #define CLEARCODEC_VBAR_SHORT_SIZE 16384
+#define CLEARCODEC_VBAR_MAX_HEIGHT 52
+/* bytes reserved per vbar in the storage slab, enough for the tallest vbar at 32bpp */
+#define CLEARCODEC_VBAR_STRIDE (CLEARCODEC_VBAR_MAX_HEIGHT * 4)
+#define CLEARCODEC_GLYPH_MAX_PIXELS 1024
+#define CLEARCODEC_RLEX_MAX_PALETTE 127
+#define CLEARCODEC_HASH_SIZE 65536
+
+#define CLEARCODEC_SUBCODEC_UNCOMPRESSED 0
+#define CLEARCODEC_SUBCODEC_NSCODEC 1
+#define CLEARCODEC_SUBCODEC_RLEX 2
 
 typedef struct
 {
 	UINT32 size;
 	UINT32 count;
 	UINT32* pixels;
+	UINT32 width; /* compressor only */
 } CLEAR_GLYPH_ENTRY;
 
 typedef struct
 {
 	UINT32 size;
 	UINT32 count;
-	BYTE* pixels;
+	BYTE* pixels; /* points into CLEAR_CONTEXT::VBarPixels */
 } CLEAR_VBAR_ENTRY;
 
+typedef enum
+{
+	CLEAR_LAYER_RESIDUAL,
+	CLEAR_LAYER_BANDS,
+	CLEAR_LAYER_RLEX,
+	CLEAR_LAYER_NSCODEC,
+	CLEAR_LAYER_UNCOMPRESSED
+} CLEAR_LAYER;
+
+typedef struct
+{
+	UINT32 y;
+	UINT32 height;
+	CLEAR_LAYER layer;
+} CLEAR_STRIP;
+
+typedef struct
+{
+	UINT32 count;
+	BOOL overflow;
+	UINT32 colors[CLEARCODEC_RLEX_MAX_PALETTE];
+	UINT32 hits[CLEARCODEC_RLEX_MAX_PALETTE];
+	UINT32 keys[256];
+	BYTE index[256];
+} CLEAR_PALETTE;
+
 struct S_CLEAR_CONTEXT
 {
 	BOOL Compressor;
@@ -67,6 +104,21 @@ struct S_CLEAR_CONTEXT
 	CLEAR_VBAR_ENTRY VBarStorage[CLEARCODEC_VBAR_SIZE];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[CLEARCODEC_VBAR_SHORT_SIZE];
+	BYTE* VBarPixels;
+
+	/* compressor state, the hash tables map content to cache index + 1 */
+	BOOL CacheResetPending;
+	UINT32 GlyphCacheCursor;
+	UINT16* GlyphHash;
+	UINT16* VBarHash;
+	UINT16* ShortVBarHash;
+	UINT32* ColumnSeen;
+	UINT32 ColumnEpoch;
+	CLEAR_PALETTE Palette;
+	CLEAR_STRIP* Strips;
+	size_t StripCount;
+	wStream* BandsStream;
+	wStream* SubcodecStream;
 };
 
 static const UINT32 CLEAR_LOG2_FLOOR[256] = {
@@ -82,26 +134,48 @@ static const UINT32 CLEAR_LOG2_FLOOR[256] = {
 
 static const BYTE CLEAR_8BIT_MASKS[9] = { 0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF };
 
-static void clear_reset_vbar_storage(CLEAR_CONTEXT* WINPR_RESTRICT clear, BOOL zero)
+/**
+ * All vbars live in one slab with a fixed stride, so a vbar lookup is an index computation
+ * instead of a pointer chase to an individually allocated buffer.
+ * calloc leaves untouched pages uncommitted, so unused cache entries cost no memory.
+ */
+static BOOL clear_init_vbar_storage(CLEAR_CONTEXT* WINPR_RESTRICT clear)
 {
-	if (zero)
+	clear->VBarPixels = (BYTE*)calloc(ARRAYSIZE(clear->VBarStorage) +
+	                                      ARRAYSIZE(clear->ShortVBarStorage),
+	                                  CLEARCODEC_VBAR_STRIDE);
+
+	if (!clear->VBarPixels)
+		return FALSE;
+
+	BYTE* pixels = clear->VBarPixels;
+
+	for (size_t i = 0; i < ARRAYSIZE(clear->VBarStorage); i++)
 	{
-		for (size_t i = 0; i < ARRAYSIZE(clear->VBarStorage); i++)
-			winpr_aligned_free(clear->VBarStorage[i].pixels);
+		clear->VBarStorage[i].pixels = pixels;
+		pixels += CLEARCODEC_VBAR_STRIDE;
+	}
 
-		ZeroMemory(clear->VBarStorage, sizeof(clear->VBarStorage));
+	for (size_t i = 0; i < ARRAYSIZE(clear->ShortVBarStorage); i++)
+	{
+		clear->ShortVBarStorage[i].pixels = pixels;
+		pixels += CLEARCODEC_VBAR_STRIDE;
 	}
 
-	clear->VBarStorageCursor = 0;
+	return TRUE;
+}
 
+static void clear_reset_vbar_storage(CLEAR_CONTEXT* WINPR_RESTRICT clear, BOOL zero)
+{
 	if (zero)
 	{
-		for (size_t i = 0; i < ARRAYSIZE(clear->ShortVBarStorage); i++)
-			winpr_aligned_free(clear->ShortVBarStorage[i].pixels);
-
+		free(clear->VBarPixels);
+		clear->VBarPixels = NULL;
+		ZeroMemory(clear->VBarStorage, sizeof(clear->VBarStorage));
 		ZeroMemory(clear->ShortVBarStorage, sizeof(clear->ShortVBarStorage));
 	}
 
+	clear->VBarStorageCursor = 0;
 	clear->ShortVBarStorageCursor = 0;
 }
 
@@ -557,34 +631,27 @@ static BOOL clear_decompress_subcodecs_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 static BOOL resize_vbar_entry(CLEAR_CONTEXT* WINPR_RESTRICT clear,
                               CLEAR_VBAR_ENTRY* WINPR_RESTRICT vBarEntry)
 {
-	if (vBarEntry->count > vBarEntry->size)
+	if (vBarEntry->count > CLEARCODEC_VBAR_MAX_HEIGHT)
 	{
-		const UINT32 bpp = FreeRDPGetBytesPerPixel(clear->format);
-		const UINT32 oldPos = vBarEntry->size * bpp;
-		const UINT32 diffSize = (vBarEntry->count - vBarEntry->size) * bpp;
-
-		vBarEntry->size = vBarEntry->count;
-		BYTE* tmp =
-		    (BYTE*)winpr_aligned_recalloc(vBarEntry->pixels, vBarEntry->count, 1ull * bpp, 32);
-
-		if (!tmp)
-		{
-			WLog_ERR(TAG, "vBarEntry->pixels winpr_aligned_recalloc %" PRIu32 " failed",
-			         vBarEntry->count * bpp);
-			return FALSE;
-		}
-
-		memset(&tmp[oldPos], 0, diffSize);
-		vBarEntry->pixels = tmp;
+		WLog_ERR(TAG, "vBarEntry->count %" PRIu32 " > %" PRIu32, vBarEntry->count,
+		         CLEARCODEC_VBAR_MAX_HEIGHT);
+		return FALSE;
 	}
 
-	if (!vBarEntry->pixels && vBarEntry->size)
+	if (!vBarEntry->pixels)
 	{
-		WLog_ERR(TAG, "vBarEntry->pixels is NULL but vBarEntry->size is %" PRIu32 "",
-		         vBarEntry->size);
+		WLog_ERR(TAG, "vBarEntry->pixels is NULL");
 		return FALSE;
 	}
 
+	if (vBarEntry->count > vBarEntry->size)
+	{
+		const size_t bpp = FreeRDPGetBytesPerPixel(clear->format);
+		memset(&vBarEntry->pixels[vBarEntry->size * bpp], 0,
+		       (vBarEntry->count - vBarEntry->size) * bpp);
+		vBarEntry->size = vBarEntry->count;
+	}
+
 	return TRUE;
 }
 
@@ -596,6 +663,9 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
                                         UINT32 nDstWidth, UINT32 nDstHeight)
 {
 	UINT32 suboffset = 0;
+	const size_t bpp = FreeRDPGetBytesPerPixel(clear->format);
+	const size_t dstBpp = FreeRDPGetBytesPerPixel(DstFormat);
+	const BOOL sameFormat = (clear->format == DstFormat);
 
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, bandsByteCount))
 		return FALSE;
@@ -726,8 +796,7 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 					BYTE r = 0;
 					BYTE g = 0;
 					BYTE b = 0;
-					BYTE* dstBuffer =
-					    &vBarShortEntry->pixels[y * FreeRDPGetBytesPerPixel(clear->format)];
+					BYTE* dstBuffer = &vBarShortEntry->pixels[y * bpp];
 					UINT32 color = 0;
 					Stream_Read_UINT8(s, b);
 					Stream_Read_UINT8(s, g);
@@ -798,7 +867,7 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 					while (count--)
 					{
 						FreeRDPWriteColor(dstBuffer, clear->format, colorBkg);
-						dstBuffer += FreeRDPGetBytesPerPixel(clear->format);
+						dstBuffer += bpp;
 					}
 				}
 
@@ -814,25 +883,17 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 
 				if (count > 0)
 				{
-					const size_t offset =
-					    (1ull * y - vBarYOn) * FreeRDPGetBytesPerPixel(clear->format);
+					const size_t offset = (1ull * y - vBarYOn) * bpp;
 					pSrcPixel = &vBarShortEntry->pixels[offset];
 					if (offset + count > vBarShortEntry->count)
 					{
 						WLog_ERR(TAG, "offset + count > vBarShortEntry->count");
 						return FALSE;
 					}
-				}
-				for (size_t x = 0; x < count; x++)
-				{
-					UINT32 color = 0;
-					color = FreeRDPReadColor(&pSrcPixel[x * FreeRDPGetBytesPerPixel(clear->format)],
-					                         clear->format);
 
-					if (!FreeRDPWriteColor(dstBuffer, clear->format, color))
-						return FALSE;
-
-					dstBuffer += FreeRDPGetBytesPerPixel(clear->format);
+					/* both entries are stored in clear->format */
+					memcpy(dstBuffer, pSrcPixel, count * bpp);
+					dstBuffer += count * bpp;
 				}
 
 				/* if (y >= (vBarYOn + vBarShortPixelCount)), use colorBkg */
@@ -846,7 +907,7 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 						if (!FreeRDPWriteColor(dstBuffer, clear->format, colorBkg))
 							return FALSE;
 
-						dstBuffer += FreeRDPGetBytesPerPixel(clear->format);
+						dstBuffer += bpp;
 					}
 				}
 
@@ -878,21 +939,27 @@ static BOOL clear_decompress_bands_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 				if (nXDstRel + i > nDstWidth)
 					return FALSE;
 
+				if ((count > 0) && (nYDstRel + count - 1 > nDstHeight))
+					return FALSE;
+
+				BYTE* pDstPixel8 =
+				    &pDstData[(1ull * nYDstRel * nDstStep) + ((nXDstRel + i) * dstBpp)];
+
 				for (UINT32 y = 0; y < count; y++)
 				{
-					if (nYDstRel + y > nDstHeight)
-						return FALSE;
-
-					BYTE* pDstPixel8 =
-					    &pDstData[((nYDstRel + y) * nDstStep) +
-					              ((nXDstRel + i) * FreeRDPGetBytesPerPixel(DstFormat))];
-					UINT32 color = FreeRDPReadColor(cpSrcPixel, clear->format);
-					color = FreeRDPConvertColor(color, clear->format, DstFormat, NULL);
+					if (sameFormat)
+						memcpy(pDstPixel8, cpSrcPixel, dstBpp);
+					else
+					{
+						UINT32 color = FreeRDPReadColor(cpSrcPixel, clear->format);
+						color = FreeRDPConvertColor(color, clear->format, DstFormat, NULL);
 
-					if (!FreeRDPWriteColor(pDstPixel8, DstFormat, color))
-						return FALSE;
+						if (!FreeRDPWriteColor(pDstPixel8, DstFormat, color))
+							return FALSE;
+					}
 
-					cpSrcPixel += FreeRDPGetBytesPerPixel(clear->format);
+					pDstPixel8 += nDstStep;
+					cpSrcPixel += bpp;
 				}
 			}
 		}
@@ -1150,13 +1217,807 @@ fail:
 	return rc;
 }
 
+static INLINE UINT32 clear_read_pixel(const BYTE* WINPR_RESTRICT src)
+{
+	return (UINT32)src[0] | ((UINT32)src[1] << 8) | ((UINT32)src[2] << 16);
+}
+
+static INLINE void clear_write_pixel(wStream* WINPR_RESTRICT s, UINT32 color)
+{
+	Stream_Write_UINT8(s, (BYTE)(color & 0xFF));         /* blue */
+	Stream_Write_UINT8(s, (BYTE)((color >> 8) & 0xFF));  /* green */
+	Stream_Write_UINT8(s, (BYTE)((color >> 16) & 0xFF)); /* red */
+}
+
+static INLINE UINT32 clear_hash_pixels(const UINT32* WINPR_RESTRICT pixels, size_t count,
+                                       UINT32 seed)
+{
+	UINT32 hash = 2166136261u ^ seed;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		hash ^= pixels[i];
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	return hash & (CLEARCODEC_HASH_SIZE - 1);
+}
+
+static INLINE size_t clear_run_length_size(UINT32 runLength)
+{
+	if (runLength < 0xFF)
+		return 1;
+
+	if (runLength < 0xFFFF)
+		return 3;
+
+	return 7;
+}
+
+static INLINE void clear_write_run_length(wStream* WINPR_RESTRICT s, UINT32 runLength)
+{
+	if (runLength < 0xFF)
+	{
+		Stream_Write_UINT8(s, (BYTE)runLength);
+		return;
+	}
+
+	Stream_Write_UINT8(s, 0xFF);
+
+	if (runLength < 0xFFFF)
+	{
+		Stream_Write_UINT16(s, (UINT16)runLength);
+		return;
+	}
+
+	Stream_Write_UINT16(s, 0xFFFF);
+	Stream_Write_UINT32(s, runLength);
+}
+
+static void clear_palette_reset(CLEAR_PALETTE* WINPR_RESTRICT palette)
+{
+	palette->count = 0;
+	palette->overflow = FALSE;
+	ZeroMemory(palette->keys, sizeof(palette->keys));
+}
+
+static INLINE UINT32 clear_palette_slot(const CLEAR_PALETTE* WINPR_RESTRICT palette, UINT32 color)
+{
+	const UINT32 key = color | 0x01000000;
+	UINT32 slot = ((color * 2654435761u) >> 24) & (ARRAYSIZE(palette->keys) - 1);
+
+	while ((palette->keys[slot] != 0) && (palette->keys[slot] != key))
+		slot = (slot + 1) & (ARRAYSIZE(palette->keys) - 1);
+
+	return slot;
+}
+
+static INLINE void clear_palette_add(CLEAR_PALETTE* WINPR_RESTRICT palette, UINT32 color)
+{
+	const UINT32 slot = clear_palette_slot(palette, color);
+
+	if (palette->keys[slot] != 0)
+	{
+		palette->hits[palette->index[slot]]++;
+		return;
+	}
+
+	if (palette->count >= CLEARCODEC_RLEX_MAX_PALETTE)
+	{
+		palette->overflow = TRUE;
+		return;
+	}
+
+	palette->keys[slot] = color | 0x01000000;
+	palette->index[slot] = (BYTE)palette->count;
+	palette->colors[palette->count] = color;
+	palette->hits[palette->count] = 1;
+	palette->count++;
+}
+
+static INLINE BYTE clear_palette_find(const CLEAR_PALETTE* WINPR_RESTRICT palette, UINT32 color)
+{
+	const UINT32 slot = clear_palette_slot(palette, color);
+	WINPR_ASSERT(palette->keys[slot] != 0);
+	return palette->index[slot];
+}
+
+static void clear_palette_build(CLEAR_PALETTE* WINPR_RESTRICT palette,
+                                const BYTE* WINPR_RESTRICT src, UINT32 nSrcStep, UINT32 width,
+                                UINT32 yStart, UINT32 height)
+{
+	clear_palette_reset(palette);
+
+	for (UINT32 y = yStart; y < yStart + height; y++)
+	{
+		const BYTE* row = &src[1ull * y * nSrcStep];
+
+		for (UINT32 x = 0; x < width; x++)
+			clear_palette_add(palette, clear_read_pixel(&row[4ull * x]));
+	}
+}
+
+static UINT32 clear_palette_background(const CLEAR_PALETTE* WINPR_RESTRICT palette)
+{
+	UINT32 best = 0;
+
+	for (UINT32 i = 1; i < palette->count; i++)
+	{
+		if (palette->hits[i] > palette->hits[best])
+			best = i;
+	}
+
+	return palette->colors[best];
+}
+
+static void clear_encoder_reset_caches(CLEAR_CONTEXT* WINPR_RESTRICT clear)
+{
+	clear->VBarStorageCursor = 0;
+	clear->ShortVBarStorageCursor = 0;
+	clear->GlyphCacheCursor = 0;
+
+	if (clear->VBarHash)
+		ZeroMemory(clear->VBarHash, CLEARCODEC_HASH_SIZE * sizeof(UINT16));
+
+	if (clear->ShortVBarHash)
+		ZeroMemory(clear->ShortVBarHash, CLEARCODEC_HASH_SIZE * sizeof(UINT16));
+
+	if (clear->GlyphHash)
+		ZeroMemory(clear->GlyphHash, CLEARCODEC_HASH_SIZE * sizeof(UINT16));
+}
+
+static BOOL clear_encoder_find_vbar(const CLEAR_VBAR_ENTRY* WINPR_RESTRICT storage,
+                                    size_t storageSize, const UINT16* WINPR_RESTRICT map,
+                                    const UINT32* WINPR_RESTRICT pixels, UINT32 count,
+                                    UINT32* WINPR_RESTRICT pIndex)
+{
+	const UINT32 hash = clear_hash_pixels(pixels, count, count);
+	const UINT32 slot = map[hash];
+
+	if ((slot == 0) || (slot > storageSize))
+		return FALSE;
+
+	const CLEAR_VBAR_ENTRY* entry = &storage[slot - 1];
+
+	if (entry->count != count)
+		return FALSE;
+
+	if ((count > 0) && (memcmp(entry->pixels, pixels, count * sizeof(UINT32)) != 0))
+		return FALSE;
+
+	*pIndex = slot - 1;
+	return TRUE;
+}
+
+static BOOL clear_encoder_insert_vbar(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                                      CLEAR_VBAR_ENTRY* WINPR_RESTRICT storage, size_t storageSize,
+                                      UINT32* WINPR_RESTRICT cursor, UINT16* WINPR_RESTRICT map,
+                                      const UINT32* WINPR_RESTRICT pixels, UINT32 count)
+{
+	CLEAR_VBAR_ENTRY* entry = &storage[*cursor];
+
+	entry->count = count;
+
+	if (!resize_vbar_entry(clear, entry))
+		return FALSE;
+
+	if (count > 0)
+		memcpy(entry->pixels, pixels, count * sizeof(UINT32));
+
+	map[clear_hash_pixels(pixels, count, count)] = (UINT16)(*cursor + 1);
+	*cursor = (*cursor + 1) % storageSize;
+	return TRUE;
+}
+
+/**
+ * Encodes one band covering the whole width and rows [yStart, yStart + height).
+ * With s == NULL only the encoded size is estimated and the vbar caches are left untouched.
+ */
+static BOOL clear_encode_band(CLEAR_CONTEXT* WINPR_RESTRICT clear, wStream* WINPR_RESTRICT s,
+                              const BYTE* WINPR_RESTRICT src, UINT32 nSrcStep, UINT32 width,
+                              UINT32 yStart, UINT32 height, UINT32 background,
+                              size_t* WINPR_RESTRICT pSize)
+{
+	UINT32 column[CLEARCODEC_VBAR_MAX_HEIGHT] = { 0 };
+	size_t size = 11;
+
+	WINPR_ASSERT(height <= CLEARCODEC_VBAR_MAX_HEIGHT);
+
+	if (!s && (++clear->ColumnEpoch == 0))
+	{
+		ZeroMemory(clear->ColumnSeen, CLEARCODEC_HASH_SIZE * sizeof(UINT32));
+		clear->ColumnEpoch = 1;
+	}
+
+	if (s)
+	{
+		if (!Stream_EnsureRemainingCapacity(s, 11))
+			return FALSE;
+
+		Stream_Write_UINT16(s, 0);                             /* xStart */
+		Stream_Write_UINT16(s, (UINT16)(width - 1));           /* xEnd */
+		Stream_Write_UINT16(s, (UINT16)yStart);                /* yStart */
+		Stream_Write_UINT16(s, (UINT16)(yStart + height - 1)); /* yEnd */
+		clear_write_pixel(s, background);                      /* blueBkg, greenBkg, redBkg */
+	}
+
+	for (UINT32 x = 0; x < width; x++)
+	{
+		UINT32 yOn = height;
+		UINT32 yOff = 0;
+		UINT32 index = 0;
+
+		for (UINT32 y = 0; y < height; y++)
+		{
+			column[y] = clear_read_pixel(&src[1ull * (yStart + y) * nSrcStep + 4ull * x]);
+
+			if (column[y] != background)
+			{
+				if (yOn == height)
+					yOn = y;
+
+				yOff = y + 1;
+			}
+		}
+
+		if (yOn == height)
+			yOn = 0;
+
+		const UINT32 count = yOff - yOn;
+
+		if (!s)
+		{
+			/* columns repeated within the band will be cache hits once committed */
+			const UINT32 hash = clear_hash_pixels(column, height, height);
+			const UINT32 shortHash = clear_hash_pixels(&column[yOn], count, count);
+
+			if ((clear->ColumnSeen[hash] == clear->ColumnEpoch) ||
+			    clear_encoder_find_vbar(clear->VBarStorage, ARRAYSIZE(clear->VBarStorage),
+			                            clear->VBarHash, column, height, &index))
+				size += 2;
+			else if ((clear->ColumnSeen[shortHash] == clear->ColumnEpoch) ||
+			         clear_encoder_find_vbar(clear->ShortVBarStorage,
+			                                 ARRAYSIZE(clear->ShortVBarStorage),
+			                                 clear->ShortVBarHash, &column[yOn], count, &index))
+				size += 3;
+			else
+				size += 2ull + 3ull * count;
+
+			clear->ColumnSeen[hash] = clear->ColumnEpoch;
+			clear->ColumnSeen[shortHash] = clear->ColumnEpoch;
+			continue;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(s, 2ull + 3ull * count))
+			return FALSE;
+
+		if (clear_encoder_find_vbar(clear->VBarStorage, ARRAYSIZE(clear->VBarStorage),
+		                            clear->VBarHash, column, height, &index))
+		{
+			Stream_Write_UINT16(s, (UINT16)(0x8000 | index)); /* VBAR_CACHE_HIT */
+			size += 2;
+			continue;
+		}
+
+		if (clear_encoder_find_vbar(clear->ShortVBarStorage, ARRAYSIZE(clear->ShortVBarStorage),
+		                            clear->ShortVBarHash, &column[yOn], count, &index))
+		{
+			Stream_Write_UINT16(s, (UINT16)(0x4000 | index)); /* SHORT_VBAR_CACHE_HIT */
+			Stream_Write_UINT8(s, (BYTE)yOn);
+			size += 3;
+		}
+		else
+		{
+			Stream_Write_UINT16(s, (UINT16)(yOn | (yOff << 8))); /* SHORT_VBAR_CACHE_MISS */
+
+			for (UINT32 y = yOn; y < yOff; y++)
+				clear_write_pixel(s, column[y]);
+
+			if (!clear_encoder_insert_vbar(clear, clear->ShortVBarStorage,
+			                               ARRAYSIZE(clear->ShortVBarStorage),
+			                               &clear->ShortVBarStorageCursor, clear->ShortVBarHash,
+			                               &column[yOn], count))
+				return FALSE;
+
+			size += 2ull + 3ull * count;
+		}
+
+		if (!clear_encoder_insert_vbar(clear, clear->VBarStorage, ARRAYSIZE(clear->VBarStorage),
+		                               &clear->VBarStorageCursor, clear->VBarHash, column, height))
+			return FALSE;
+	}
+
+	*pSize = size;
+	return TRUE;
+}
+
+static INLINE BYTE clear_rlex_index(const CLEAR_PALETTE* WINPR_RESTRICT palette,
+                                    const BYTE* WINPR_RESTRICT src, UINT32 nSrcStep, UINT32 width,
+                                    UINT32 yStart, size_t n)
+{
+	const BYTE* pixel = &src[1ull * (yStart + n / width) * nSrcStep + 4ull * (n % width)];
+	return clear_palette_find(palette, clear_read_pixel(pixel));
+}
+
+/**
+ * Encodes rows [yStart, yStart + height) as RLEX subcodec bitmap data.
+ * With s == NULL only the encoded size is computed.
+ */
+static BOOL clear_encode_rlex(const CLEAR_PALETTE* WINPR_RESTRICT palette,
+                              wStream* WINPR_RESTRICT s, const BYTE* WINPR_RESTRICT src,
+                              UINT32 nSrcStep, UINT32 width, UINT32 yStart, UINT32 height,
+                              size_t* WINPR_RESTRICT pSize)
+{
+	const size_t pixelCount = 1ull * width * height;
+	const UINT32 numBits = CLEAR_LOG2_FLOOR[palette->count - 1] + 1;
+	const UINT32 maxDepth = CLEAR_8BIT_MASKS[8 - numBits];
+	size_t size = 1ull + 3ull * palette->count;
+	size_t i = 0;
+
+	WINPR_ASSERT(!palette->overflow);
+	WINPR_ASSERT(palette->count > 0);
+
+	if (s)
+	{
+		if (!Stream_EnsureRemainingCapacity(s, size))
+			return FALSE;
+
+		Stream_Write_UINT8(s, (BYTE)palette->count);
+
+		for (UINT32 j = 0; j < palette->count; j++)
+			clear_write_pixel(s, palette->colors[j]);
+	}
+
+	while (i < pixelCount)
+	{
+		const BYTE startIndex = clear_rlex_index(palette, src, nSrcStep, width, yStart, i);
+		UINT32 runLength = 0;
+		UINT32 suiteDepth = 0;
+		size_t next = i + 1;
+
+		while ((next < pixelCount) &&
+		       (clear_rlex_index(palette, src, nSrcStep, width, yStart, next) == startIndex))
+		{
+			runLength++;
+			next++;
+		}
+
+		while ((suiteDepth < maxDepth) && (startIndex + suiteDepth + 1 < palette->count) &&
+		       (next < pixelCount) &&
+		       (clear_rlex_index(palette, src, nSrcStep, width, yStart, next) ==
+		        startIndex + suiteDepth + 1))
+		{
+			suiteDepth++;
+			next++;
+		}
+
+		size += 1 + clear_run_length_size(runLength);
+
+		if (s)
+		{
+			if (!Stream_EnsureRemainingCapacity(s, 8))
+				return FALSE;
+
+			Stream_Write_UINT8(s, (BYTE)((suiteDepth << numBits) | (startIndex + suiteDepth)));
+			clear_write_run_length(s, runLength);
+		}
+
+		i = next;
+	}
+
+	*pSize = size;
+	return TRUE;
+}
+
+/**
+ * Encodes the residual layer for the whole image. Pixels of strips that are covered by a band
+ * or a subcodec are overwritten by the decoder later on, so they just extend the current run.
+ * With s == NULL only the encoded size is computed.
+ */
+static BOOL clear_encode_residual(const CLEAR_STRIP* WINPR_RESTRICT strips, size_t stripCount,
+                                  wStream* WINPR_RESTRICT s, const BYTE* WINPR_RESTRICT src,
+                                  UINT32 nSrcStep, UINT32 width, size_t* WINPR_RESTRICT pSize)
+{
+	BOOL haveRun = FALSE;
+	UINT32 color = 0;
+	UINT32 runLength = 0;
+	size_t size = 0;
+
+	for (size_t i = 0; i < stripCount; i++)
+	{
+		const CLEAR_STRIP* strip = &strips[i];
+
+		if (strip->layer != CLEAR_LAYER_RESIDUAL)
+		{
+			runLength += width * strip->height;
+			continue;
+		}
+
+		for (UINT32 y = strip->y; y < strip->y + strip->height; y++)
+		{
+			const BYTE* row = &src[1ull * y * nSrcStep];
+
+			for (UINT32 x = 0; x < width; x++)
+			{
+				const UINT32 pixel = clear_read_pixel(&row[4ull * x]);
+
+				if (!haveRun || (pixel == color))
+				{
+					haveRun = TRUE;
+					color = pixel;
+					runLength++;
+					continue;
+				}
+
+				size += 3 + clear_run_length_size(runLength);
+
+				if (s)
+				{
+					if (!Stream_EnsureRemainingCapacity(s, 10))
+						return FALSE;
+
+					clear_write_pixel(s, color);
+					clear_write_run_length(s, runLength);
+				}
+
+				color = pixel;
+				runLength = 1;
+			}
+		}
+	}
+
+	if (haveRun)
+	{
+		size += 3 + clear_run_length_size(runLength);
+
+		if (s)
+		{
+			if (!Stream_EnsureRemainingCapacity(s, 10))
+				return FALSE;
+
+			clear_write_pixel(s, color);
+			clear_write_run_length(s, runLength);
+		}
+	}
+
+	*pSize = size;
+	return TRUE;
+}
+
+static BOOL clear_write_subcodec_header(wStream* WINPR_RESTRICT s, UINT32 yStart, UINT32 width,
+                                        UINT32 height, size_t bitmapDataByteCount,
+                                        BYTE subcodecId)
+{
+	if (bitmapDataByteCount > UINT32_MAX)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 13))
+		return FALSE;
+
+	Stream_Write_UINT16(s, 0);                           /* xStart */
+	Stream_Write_UINT16(s, (UINT16)yStart);              /* yStart */
+	Stream_Write_UINT16(s, (UINT16)width);               /* width */
+	Stream_Write_UINT16(s, (UINT16)height);              /* height */
+	Stream_Write_UINT32(s, (UINT32)bitmapDataByteCount); /* bitmapDataByteCount */
+	Stream_Write_UINT8(s, subcodecId);                   /* subcodecId */
+	return TRUE;
+}
+
+/**
+ * Picks the cheapest layer for one strip of at most CLEARCODEC_VBAR_MAX_HEIGHT rows and
+ * writes its band or subcodec data. Residual strips are written later in a single pass.
+ */
+static BOOL clear_encode_strip(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                               CLEAR_STRIP* WINPR_RESTRICT strip, const BYTE* WINPR_RESTRICT src,
+                               UINT32 nSrcStep, UINT32 width)
+{
+	CLEAR_PALETTE* palette = &clear->Palette;
+	wStream* subcodecs = clear->SubcodecStream;
+	const size_t subcodecPos = Stream_GetPosition(subcodecs);
+	const size_t rawSize = 13ull + 3ull * width * strip->height;
+	size_t bestSize = 0;
+	size_t size = 0;
+
+	clear_palette_build(palette, src, nSrcStep, width, strip->y, strip->height);
+
+	strip->layer = CLEAR_LAYER_RESIDUAL;
+	if (!clear_encode_residual(strip, 1, NULL, src, nSrcStep, width, &bestSize))
+		return FALSE;
+
+	const UINT32 background = clear_palette_background(palette);
+	if (!clear_encode_band(clear, NULL, src, nSrcStep, width, strip->y, strip->height, background,
+	                       &size))
+		return FALSE;
+
+	if (size < bestSize)
+	{
+		strip->layer = CLEAR_LAYER_BANDS;
+		bestSize = size;
+	}
+
+	if (!palette->overflow)
+	{
+		if (!clear_encode_rlex(palette, NULL, src, nSrcStep, width, strip->y, strip->height,
+		                       &size))
+			return FALSE;
+
+		if (13 + size < bestSize)
+		{
+			strip->layer = CLEAR_LAYER_RLEX;
+			bestSize = 13 + size;
+		}
+	}
+	else
+	{
+		/* Trial encode in place, the data is dropped again if another layer wins. */
+		if (!clear_write_subcodec_header(subcodecs, strip->y, width, strip->height, 0,
+		                                 CLEARCODEC_SUBCODEC_NSCODEC))
+			return FALSE;
+
+		if (!nsc_compose_message(clear->nsc, subcodecs, &src[1ull * strip->y * nSrcStep], width,
+		                         strip->height, nSrcStep))
+			return FALSE;
+
+		size = Stream_GetPosition(subcodecs) - subcodecPos;
+
+		if ((size < bestSize) && (size < rawSize))
+		{
+			const size_t end = Stream_GetPosition(subcodecs);
+			strip->layer = CLEAR_LAYER_NSCODEC;
+			Stream_SetPosition(subcodecs, subcodecPos + 8);
+			Stream_Write_UINT32(subcodecs, (UINT32)(size - 13)); /* bitmapDataByteCount */
+			Stream_SetPosition(subcodecs, end);
+			return TRUE;
+		}
+
+		Stream_SetPosition(subcodecs, subcodecPos);
+	}
+
+	if (rawSize < bestSize)
+		strip->layer = CLEAR_LAYER_UNCOMPRESSED;
+
+	switch (strip->layer)
+	{
+		case CLEAR_LAYER_BANDS:
+			return clear_encode_band(clear, clear->BandsStream, src, nSrcStep, width, strip->y,
+			                         strip->height, background, &size);
+
+		case CLEAR_LAYER_RLEX:
+			if (!clear_encode_rlex(palette, NULL, src, nSrcStep, width, strip->y, strip->height,
+			                       &size))
+				return FALSE;
+
+			if (!clear_write_subcodec_header(subcodecs, strip->y, width, strip->height, size,
+			                                 CLEARCODEC_SUBCODEC_RLEX))
+				return FALSE;
+
+			return clear_encode_rlex(palette, subcodecs, src, nSrcStep, width, strip->y,
+			                         strip->height, &size);
+
+		case CLEAR_LAYER_UNCOMPRESSED:
+			if (!clear_write_subcodec_header(subcodecs, strip->y, width, strip->height,
+			                                 rawSize - 13, CLEARCODEC_SUBCODEC_UNCOMPRESSED))
+				return FALSE;
+
+			if (!Stream_EnsureRemainingCapacity(subcodecs, rawSize - 13))
+				return FALSE;
+
+			for (UINT32 y = strip->y; y < strip->y + strip->height; y++)
+			{
+				const BYTE* row = &src[1ull * y * nSrcStep];
+
+				for (UINT32 x = 0; x < width; x++)
+					clear_write_pixel(subcodecs, clear_read_pixel(&row[4ull * x]));
+			}
+
+			return TRUE;
+
+		case CLEAR_LAYER_RESIDUAL:
+		default:
+			return TRUE;
+	}
+}
+
+static BOOL clear_encode_glyph(CLEAR_CONTEXT* WINPR_RESTRICT clear, const BYTE* WINPR_RESTRICT src,
+                               UINT32 nSrcStep, UINT32 width, UINT32 height,
+                               UINT16* WINPR_RESTRICT pGlyphIndex, BOOL* WINPR_RESTRICT pHit)
+{
+	UINT32 pixels[CLEARCODEC_GLYPH_MAX_PIXELS] = { 0 };
+	const UINT32 count = width * height;
+
+	WINPR_ASSERT(count <= ARRAYSIZE(pixels));
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+			pixels[y * width + x] = clear_read_pixel(&src[1ull * y * nSrcStep + 4ull * x]);
+	}
+
+	const UINT32 hash = clear_hash_pixels(pixels, count, (width << 16) | height);
+	const UINT32 slot = clear->GlyphHash[hash];
+
+	if ((slot > 0) && (slot <= ARRAYSIZE(clear->GlyphCache)))
+	{
+		const CLEAR_GLYPH_ENTRY* entry = &clear->GlyphCache[slot - 1];
+
+		if ((entry->count == count) && (entry->width == width) &&
+		    (memcmp(entry->pixels, pixels, count * sizeof(UINT32)) == 0))
+		{
+			*pGlyphIndex = (UINT16)(slot - 1);
+			*pHit = TRUE;
+			return TRUE;
+		}
+	}
+
+	const UINT32 index = clear->GlyphCacheCursor;
+	CLEAR_GLYPH_ENTRY* entry = &clear->GlyphCache[index];
+
+	if (count > entry->size)
+	{
+		UINT32* tmp = winpr_aligned_recalloc(entry->pixels, count, sizeof(UINT32), 32);
+
+		if (!tmp)
+			return FALSE;
+
+		entry->size = count;
+		entry->pixels = tmp;
+	}
+
+	memcpy(entry->pixels, pixels, count * sizeof(UINT32));
+	entry->count = count;
+	entry->width = width;
+	clear->GlyphHash[hash] = (UINT16)(index + 1);
+	clear->GlyphCacheCursor = (index + 1) % ARRAYSIZE(clear->GlyphCache);
+	*pGlyphIndex = (UINT16)index;
+	*pHit = FALSE;
+	return TRUE;
+}
+
+BOOL clear_compose_message(CLEAR_CONTEXT* WINPR_RESTRICT clear, wStream* WINPR_RESTRICT s,
+                           const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat, UINT32 nSrcStep,
+                           UINT32 nWidth, UINT32 nHeight)
+{
+	BYTE glyphFlags = 0;
+	UINT16 glyphIndex = 0;
+	BOOL glyphHit = FALSE;
+	size_t residualByteCount = 0;
+
+	if (!clear || !s || !pSrcData)
+		return FALSE;
+
+	if (!clear->Compressor)
+	{
+		WLog_ERR(TAG, "context was not created as compressor");
+		return FALSE;
+	}
+
+	if ((nWidth == 0) || (nHeight == 0) || (nWidth > UINT16_MAX) || (nHeight > UINT16_MAX))
+	{
+		WLog_ERR(TAG, "invalid bitmap size %" PRIu32 "x%" PRIu32, nWidth, nHeight);
+		return FALSE;
+	}
+
+	if (!clear_resize_buffer(clear, nWidth, nHeight))
+		return FALSE;
+
+	const UINT32 nTempStep = nWidth * FreeRDPGetBytesPerPixel(clear->format);
+	const BYTE* src = clear->TempBuffer;
+
+	if (!freerdp_image_copy_no_overlap(clear->TempBuffer, clear->format, nTempStep, 0, 0, nWidth,
+	                                   nHeight, pSrcData, SrcFormat, nSrcStep, 0, 0, NULL,
+	                                   FREERDP_FLIP_NONE))
+		return FALSE;
+
+	if (clear->CacheResetPending)
+	{
+		clear_encoder_reset_caches(clear);
+		clear->CacheResetPending = FALSE;
+		glyphFlags |= CLEARCODEC_FLAG_CACHE_RESET;
+	}
+
+	if (1ull * nWidth * nHeight <= CLEARCODEC_GLYPH_MAX_PIXELS)
+	{
+		if (!clear_encode_glyph(clear, src, nTempStep, nWidth, nHeight, &glyphIndex, &glyphHit))
+			return FALSE;
+
+		glyphFlags |= CLEARCODEC_FLAG_GLYPH_INDEX;
+
+		if (glyphHit)
+			glyphFlags |= CLEARCODEC_FLAG_GLYPH_HIT;
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 16))
+		return FALSE;
+
+	Stream_Write_UINT8(s, glyphFlags);
+	Stream_Write_UINT8(s, (BYTE)clear->seqNumber);
+	clear->seqNumber = (clear->seqNumber + 1) % 256;
+
+	if (glyphFlags & CLEARCODEC_FLAG_GLYPH_INDEX)
+		Stream_Write_UINT16(s, glyphIndex);
+
+	if (glyphHit)
+		return TRUE;
+
+	const size_t stripCount =
+	    (nHeight + CLEARCODEC_VBAR_MAX_HEIGHT - 1) / CLEARCODEC_VBAR_MAX_HEIGHT;
+
+	if (stripCount > clear->StripCount)
+	{
+		CLEAR_STRIP* tmp = (CLEAR_STRIP*)realloc(clear->Strips, stripCount * sizeof(CLEAR_STRIP));
+
+		if (!tmp)
+			return FALSE;
+
+		clear->Strips = tmp;
+		clear->StripCount = stripCount;
+	}
+
+	Stream_SetPosition(clear->BandsStream, 0);
+	Stream_SetPosition(clear->SubcodecStream, 0);
+
+	BOOL haveResidual = FALSE;
+
+	for (size_t i = 0; i < stripCount; i++)
+	{
+		CLEAR_STRIP* strip = &clear->Strips[i];
+		strip->y = (UINT32)(i * CLEARCODEC_VBAR_MAX_HEIGHT);
+		strip->height = MIN(CLEARCODEC_VBAR_MAX_HEIGHT, nHeight - strip->y);
+
+		if (!clear_encode_strip(clear, strip, src, nTempStep, nWidth))
+			return FALSE;
+
+		if (strip->layer == CLEAR_LAYER_RESIDUAL)
+			haveResidual = TRUE;
+	}
+
+	const size_t bandsByteCount = Stream_GetPosition(clear->BandsStream);
+	const size_t subcodecByteCount = Stream_GetPosition(clear->SubcodecStream);
+
+	if (!Stream_EnsureRemainingCapacity(s, 12))
+		return FALSE;
+
+	const size_t headerPos = Stream_GetPosition(s);
+	Stream_Seek(s, 12);
+
+	if (haveResidual)
+	{
+		const size_t residualPos = Stream_GetPosition(s);
+
+		if (!clear_encode_residual(clear->Strips, stripCount, s, src, nTempStep, nWidth,
+		                           &residualByteCount))
+			return FALSE;
+
+		WINPR_ASSERT(Stream_GetPosition(s) - residualPos == residualByteCount);
+	}
+
+	if ((residualByteCount > UINT32_MAX) || (bandsByteCount > UINT32_MAX) ||
+	    (subcodecByteCount > UINT32_MAX))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, bandsByteCount + subcodecByteCount))
+		return FALSE;
+
+	Stream_Write(s, Stream_Buffer(clear->BandsStream), bandsByteCount);
+	Stream_Write(s, Stream_Buffer(clear->SubcodecStream), subcodecByteCount);
+
+	const size_t endPos = Stream_GetPosition(s);
+	Stream_SetPosition(s, headerPos);
+	Stream_Write_UINT32(s, (UINT32)residualByteCount); /* residualByteCount (4 bytes) */
+	Stream_Write_UINT32(s, (UINT32)bandsByteCount);    /* bandsByteCount (4 bytes) */
+	Stream_Write_UINT32(s, (UINT32)subcodecByteCount); /* subcodecByteCount (4 bytes) */
+	Stream_SetPosition(s, endPos);
+	return TRUE;
+}
+
 int clear_compress(WINPR_ATTR_UNUSED CLEAR_CONTEXT* WINPR_RESTRICT clear,
                    WINPR_ATTR_UNUSED const BYTE* WINPR_RESTRICT pSrcData,
                    WINPR_ATTR_UNUSED UINT32 SrcSize,
                    WINPR_ATTR_UNUSED BYTE** WINPR_RESTRICT ppDstData,
                    WINPR_ATTR_UNUSED UINT32* WINPR_RESTRICT pDstSize)
 {
-	WLog_ERR(TAG, "TODO: not implemented!");
+	WLog_ERR(TAG, "not implemented, use clear_compose_message instead");
 	return 1;
 }
 
@@ -1170,6 +2031,11 @@ BOOL clear_context_reset(CLEAR_CONTEXT* WINPR_RESTRICT clear)
 	 * and its internal caches must NOT be reset on the ResetGraphics PDU.
 	 */
 	clear->seqNumber = 0;
+
+	/* A compressor can not know the state of the peer, so start over with fresh vbar caches. */
+	if (clear->Compressor)
+		clear->CacheResetPending = TRUE;
+
 	return TRUE;
 }
 
@@ -1195,6 +2061,28 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear->TempBuffer)
 		goto error_nsc;
 
+	if (!clear_init_vbar_storage(clear))
+		goto error_nsc;
+
+	if (Compressor)
+	{
+		clear->GlyphHash = (UINT16*)calloc(CLEARCODEC_HASH_SIZE, sizeof(UINT16));
+		clear->VBarHash = (UINT16*)calloc(CLEARCODEC_HASH_SIZE, sizeof(UINT16));
+		clear->ShortVBarHash = (UINT16*)calloc(CLEARCODEC_HASH_SIZE, sizeof(UINT16));
+		clear->ColumnSeen = (UINT32*)calloc(CLEARCODEC_HASH_SIZE, sizeof(UINT32));
+		clear->BandsStream = Stream_New(NULL, 4096);
+		clear->SubcodecStream = Stream_New(NULL, 4096);
+
+		if (!clear->GlyphHash || !clear->VBarHash || !clear->ShortVBarHash ||
+		    !clear->ColumnSeen || !clear->BandsStream || !clear->SubcodecStream)
+			goto error_nsc;
+
+		/* lossless NSCodec for the subcodec layer */
+		if (!nsc_context_set_parameters(clear->nsc, NSC_COLOR_LOSS_LEVEL, 1) ||
+		    !nsc_context_set_parameters(clear->nsc, NSC_ALLOW_SUBSAMPLING, 0))
+			goto error_nsc;
+	}
+
 	if (!clear_context_reset(clear))
 		goto error_nsc;
 
@@ -1218,5 +2106,13 @@ void clear_context_free(CLEAR_CONTEXT* WINPR_RESTRICT clear)
 	clear_reset_vbar_storage(clear, TRUE);
 	clear_reset_glyph_cache(clear);
 
+	free(clear->GlyphHash);
+	free(clear->VBarHash);
+	free(clear->ShortVBarHash);
+	free(clear->ColumnSeen);
+	free(clear->Strips);
+	Stream_Free(clear->BandsStream, TRUE);
+	Stream_Free(clear->SubcodecStream, TRUE);
+
 	winpr_aligned_free(clear);
 }
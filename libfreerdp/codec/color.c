@@ -26,6 +26,8 @@
 #include <stdlib.h>
 
 #include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/freerdp.h>
@@ -43,6 +45,36 @@
 
 #define TAG FREERDP_TAG("color")
 
+/* Copies of at least this many pixels are split in bands processed in parallel */
+#define IMAGE_COPY_PARALLEL_THRESHOLD (1024ull * 1024ull)
+#define IMAGE_COPY_MIN_BAND_ROWS 64
+#define IMAGE_COPY_MAX_BANDS 16
+
+typedef struct
+{
+	BYTE* pDstData;
+	DWORD DstFormat;
+	UINT32 nDstStep;
+	UINT32 nXDst;
+	UINT32 nYDst;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	const BYTE* pSrcData;
+	DWORD SrcFormat;
+	UINT32 nSrcStep;
+	UINT32 nXSrc;
+	UINT32 nYSrc;
+	const gdiPalette* palette;
+	UINT32 flags;
+	BOOL rc;
+} IMAGE_COPY_WORK_PARAM;
+
+/* A private pool, WaitForThreadpoolWorkCallbacks waits for all work of a pool */
+static INIT_ONCE image_copy_once = INIT_ONCE_STATIC_INIT;
+static PTP_POOL image_copy_pool = NULL;
+static TP_CALLBACK_ENVIRON image_copy_env = { 0 };
+static UINT32 image_copy_threads = 1;
+
 static BOOL freerdp_image_copy_from_pointer_data_int(
     BYTE* WINPR_RESTRICT pDstData, UINT32 DstFormat, UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
     UINT32 nWidth, UINT32 nHeight, const BYTE* WINPR_RESTRICT xorMask, UINT32 xorMaskLength,
@@ -1850,20 +1882,128 @@ UINT32 FreeRDPGetColor(UINT32 format, BYTE r, BYTE g, BYTE b, BYTE a)
 	}
 }
 
+static BOOL image_copy_band(const IMAGE_COPY_WORK_PARAM* WINPR_RESTRICT param)
+{
+	static primitives_t* prims = NULL;
+	if (!prims)
+		prims = primitives_get();
+
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(prims);
+	WINPR_ASSERT(prims->copy_no_overlap);
+	return prims->copy_no_overlap(param->pDstData, param->DstFormat, param->nDstStep,
+	                              param->nXDst, param->nYDst, param->nWidth, param->nHeight,
+	                              param->pSrcData, param->SrcFormat, param->nSrcStep,
+	                              param->nXSrc, param->nYSrc, param->palette,
+	                              param->flags) == PRIMITIVES_SUCCESS;
+}
+
+static void CALLBACK image_copy_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                              void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	IMAGE_COPY_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
+	param->rc = image_copy_band(param);
+}
+
+static BOOL CALLBACK image_copy_pool_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                          WINPR_ATTR_UNUSED PVOID param,
+                                          WINPR_ATTR_UNUSED PVOID* context)
+{
+	SYSTEM_INFO sysInfos = { 0 };
+
+	/* Without a pool every copy is done inline, so failure here is not fatal */
+	GetNativeSystemInfo(&sysInfos);
+	if (sysInfos.dwNumberOfProcessors <= 1)
+		return TRUE;
+
+	image_copy_pool = CreateThreadpool(NULL);
+	if (!image_copy_pool)
+	{
+		WLog_WARN(TAG, "CreateThreadpool failed, copying images single threaded");
+		return TRUE;
+	}
+
+	image_copy_threads = MIN(sysInfos.dwNumberOfProcessors, IMAGE_COPY_MAX_BANDS);
+	InitializeThreadpoolEnvironment(&image_copy_env);
+	SetThreadpoolCallbackPool(&image_copy_env, image_copy_pool);
+	return TRUE;
+}
+
+static UINT32 image_copy_band_count(UINT32 nWidth, UINT32 nHeight)
+{
+	if (1ull * nWidth * nHeight < IMAGE_COPY_PARALLEL_THRESHOLD)
+		return 1;
+
+	InitOnceExecuteOnce(&image_copy_once, image_copy_pool_init, NULL, NULL);
+	if (!image_copy_pool)
+		return 1;
+
+	return MAX(1, MIN(image_copy_threads, nHeight / IMAGE_COPY_MIN_BAND_ROWS));
+}
+
 BOOL freerdp_image_copy_no_overlap(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32 nDstStep,
                                    UINT32 nXDst, UINT32 nYDst, UINT32 nWidth, UINT32 nHeight,
                                    const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat,
                                    UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
                                    const gdiPalette* WINPR_RESTRICT palette, UINT32 flags)
 {
-	static primitives_t* prims = NULL;
-	if (!prims)
-		prims = primitives_get();
+	IMAGE_COPY_WORK_PARAM params[IMAGE_COPY_MAX_BANDS] = { 0 };
+	PTP_WORK work[IMAGE_COPY_MAX_BANDS] = { 0 };
+	const IMAGE_COPY_WORK_PARAM full = { pDstData, DstFormat, nDstStep, nXDst,   nYDst,
+		                                 nWidth,   nHeight,   pSrcData, SrcFormat, nSrcStep,
+		                                 nXSrc,    nYSrc,     palette,  flags,   FALSE };
 
 	WINPR_ASSERT(!overlapping(pDstData, nYDst, nDstStep, pSrcData, nYSrc, nSrcStep, nHeight));
-	WINPR_ASSERT(prims);
-	WINPR_ASSERT(prims->copy_no_overlap);
-	return prims->copy_no_overlap(pDstData, DstFormat, nDstStep, nXDst, nYDst, nWidth, nHeight,
-	                              pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc, palette,
-	                              flags) == PRIMITIVES_SUCCESS;
+
+	const UINT32 bands = image_copy_band_count(nWidth, nHeight);
+	if (bands <= 1)
+		return image_copy_band(&full);
+
+	if (nDstStep == 0)
+		nDstStep = nWidth * FreeRDPGetBytesPerPixel(DstFormat);
+	if (nSrcStep == 0)
+		nSrcStep = nWidth * FreeRDPGetBytesPerPixel(SrcFormat);
+
+	/* Split in bands of whole lines, the first one is copied by the calling thread */
+	for (UINT32 x = 0; x < bands; x++)
+	{
+		IMAGE_COPY_WORK_PARAM* param = &params[x];
+		const UINT32 y = x * (nHeight / bands);
+		const UINT32 h = (x + 1 == bands) ? nHeight - y : nHeight / bands;
+
+		*param = full;
+		param->nDstStep = nDstStep;
+		param->nSrcStep = nSrcStep;
+		param->nYDst = nYDst + y;
+		param->nHeight = h;
+
+		/* A vertically flipped source is read bottom up starting at line nHeight - 1 */
+		if (flags & FREERDP_FLIP_VERTICAL)
+			param->pSrcData = &pSrcData[1ull * (nHeight - y - h) * nSrcStep];
+		else
+			param->nYSrc = nYSrc + y;
+
+		if (x == 0)
+			continue;
+
+		work[x] = CreateThreadpoolWork(image_copy_work_callback, param, &image_copy_env);
+		if (work[x])
+			SubmitThreadpoolWork(work[x]);
+		else
+			param->rc = image_copy_band(param);
+	}
+
+	BOOL rc = image_copy_band(&params[0]);
+	for (UINT32 x = 1; x < bands; x++)
+	{
+		if (work[x])
+		{
+			WaitForThreadpoolWorkCallbacks(work[x], FALSE);
+			CloseThreadpoolWork(work[x]);
+		}
+		rc &= params[x].rc;
+	}
+
+	return rc;
 }
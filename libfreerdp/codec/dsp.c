@@ -31,6 +31,7 @@
 #include <freerdp/codec/dsp.h>
 
 #include "dsp.h"
+#include "dsp_resample.h"
 
 #if defined(WITH_FDK_AAC)
 #include "dsp_fdk_aac.h"
@@ -49,6 +50,8 @@
 #include <opus/opus.h>
 
 #define OPUS_MAX_FRAMES 5760
+/* Largest packet a single frame can encode to */
+#define OPUS_MAX_FRAME_BYTES 1276
 #endif
 
 #if defined(WITH_FAAD2)
@@ -93,6 +96,7 @@ struct S_FREERDP_DSP_CONTEXT
 	FREERDP_DSP_COMMON_CONTEXT common;
 
 	ADPCM adpcm;
+	FREERDP_DSP_KERNELS kernels;
 
 #if defined(WITH_GSM)
 	gsm gsm;
@@ -104,6 +108,8 @@ struct S_FREERDP_DSP_CONTEXT
 #if defined(WITH_OPUS)
 	OpusDecoder* opus_decoder;
 	OpusEncoder* opus_encoder;
+	OpusRepacketizer* opus_repacketizer;
+	wStream* opus_frames;
 #endif
 #if defined(WITH_FAAD2)
 	NeAACDecHandle faad;
@@ -118,6 +124,8 @@ struct S_FREERDP_DSP_CONTEXT
 
 #if defined(WITH_SOXR)
 	soxr_t sox;
+#else
+	FREERDP_DSP_RESAMPLER* resampler;
 #endif
 };
 
@@ -177,13 +185,19 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 				if (!Stream_EnsureCapacity(context->common.channelmix, size * 2))
 					return FALSE;
 
-				for (size_t x = 0; x < samples; x++)
+				if (bpp == 2)
 				{
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
-
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
+					context->kernels.mono_to_stereo16(
+					    src, Stream_Buffer(context->common.channelmix), samples);
+					Stream_SetPosition(context->common.channelmix, samples * 4);
+				}
+				else
+				{
+					for (size_t x = 0; x < samples; x++)
+					{
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+					}
 				}
 
 				Stream_SealLength(context->common.channelmix);
@@ -204,12 +218,18 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 			if (!Stream_EnsureCapacity(context->common.channelmix, size / 2))
 				return FALSE;
 
-			/* Simply drop second channel.
-			 * TODO: Calculate average */
-			for (size_t x = 0; x < samples; x++)
+			/* Average both channels */
+			if (bpp == 2)
 			{
-				for (size_t y = 0; y < bpp; y++)
-					Stream_Write_UINT8(context->common.channelmix, src[2 * x * bpp + y]);
+				context->kernels.stereo_to_mono16(src, Stream_Buffer(context->common.channelmix),
+				                                  samples);
+				Stream_SetPosition(context->common.channelmix, samples * 2);
+			}
+			else
+			{
+				for (size_t x = 0; x < samples; x++)
+					Stream_Write_UINT8(context->common.channelmix,
+					                   (BYTE)((src[2 * x] + src[2 * x + 1]) / 2));
 			}
 
 			Stream_SealLength(context->common.channelmix);
@@ -292,8 +312,38 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	*length = Stream_Length(context->common.resample);
 	return (error == 0) ? TRUE : FALSE;
 #else
-	WLog_ERR(TAG, "Missing resample support, recompile -DWITH_SOXR=ON or -DWITH_DSP_FFMPEG=ON");
-	return FALSE;
+	if ((srcFormat->wBitsPerSample != 16) || (context->common.format.wBitsPerSample != 16))
+	{
+		WLog_ERR(TAG, "resampling requires 16bit PCM, recompile -DWITH_SOXR=ON or "
+		              "-DWITH_DSP_FFMPEG=ON");
+		return FALSE;
+	}
+
+	const UINT32 srcRate = srcFormat->nSamplesPerSec;
+	const UINT32 dstRate = context->common.format.nSamplesPerSec;
+	const UINT32 channels = srcFormat->nChannels;
+
+	if (!dsp_resampler_matches(context->resampler, srcRate, dstRate, channels,
+	                           context->common.resampleQuality))
+	{
+		dsp_resampler_free(context->resampler);
+		context->resampler = dsp_resampler_new(&context->kernels, srcRate, dstRate, channels,
+		                                       context->common.resampleQuality);
+
+		if (!context->resampler)
+			return FALSE;
+	}
+
+	Stream_SetPosition(context->common.resample, 0);
+
+	if (!dsp_resampler_process(context->resampler, src, size / (2ull * channels),
+	                           context->common.resample))
+		return FALSE;
+
+	Stream_SealLength(context->common.resample);
+	*data = Stream_Buffer(context->common.resample);
+	*length = Stream_Length(context->common.resample);
+	return TRUE;
 #endif
 }
 
@@ -634,6 +684,91 @@ static BOOL freerdp_dsp_decode_opus(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	return TRUE;
 }
 
+static BOOL freerdp_dsp_encode_opus_packet(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                           const opus_int16* WINPR_RESTRICT src, size_t frames,
+                                           wStream* WINPR_RESTRICT out)
+{
+	/* Max packet duration is 120ms (5760 at 48KHz) */
+	const size_t max_size = OPUS_MAX_FRAMES * context->common.format.nChannels * sizeof(int16_t);
+	if (!Stream_EnsureRemainingCapacity(out, max_size))
+		return FALSE;
+
+	const int rc = opus_encode(context->opus_encoder, src,
+	                           WINPR_ASSERTING_INT_CAST(opus_int32, frames), Stream_Pointer(out),
+	                           WINPR_ASSERTING_INT_CAST(opus_int32, max_size));
+	if (rc < 0)
+		return FALSE;
+	return Stream_SafeSeek(out, (size_t)rc);
+}
+
+/* Encodes complete frames of opusFrameDuration from the pending input into one packet */
+static BOOL freerdp_dsp_encode_opus_frames(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                           const BYTE* WINPR_RESTRICT src, size_t size,
+                                           wStream* WINPR_RESTRICT out)
+{
+	wStream* buffer = context->common.buffer;
+	const size_t bpf = context->common.format.nChannels * sizeof(opus_int16);
+	const size_t frameSize =
+	    1ull * context->common.format.nSamplesPerSec * context->common.opusFrameDuration / 1000;
+
+	if (!Stream_EnsureRemainingCapacity(buffer, size))
+		return FALSE;
+	Stream_Write(buffer, src, size);
+
+	const size_t pending = Stream_GetPosition(buffer) / bpf;
+	const size_t count = MIN(pending / frameSize, 120 / context->common.opusFrameDuration);
+	const opus_int16* pcm = Stream_BufferAs(buffer, opus_int16);
+
+	if (count == 0)
+		return TRUE;
+
+	if (count == 1)
+	{
+		if (!freerdp_dsp_encode_opus_packet(context, pcm, frameSize, out))
+			return FALSE;
+	}
+	else
+	{
+		/* Several frames in one packet share a single TOC, the client decodes them in one go */
+		if (!Stream_EnsureCapacity(context->opus_frames, count * OPUS_MAX_FRAME_BYTES))
+			return FALSE;
+
+		Stream_SetPosition(context->opus_frames, 0);
+		opus_repacketizer_init(context->opus_repacketizer);
+
+		for (size_t x = 0; x < count; x++)
+		{
+			BYTE* data = Stream_Pointer(context->opus_frames);
+			const int rc = opus_encode(
+			    context->opus_encoder, &pcm[x * frameSize * context->common.format.nChannels],
+			    WINPR_ASSERTING_INT_CAST(opus_int32, frameSize), data, OPUS_MAX_FRAME_BYTES);
+			if (rc < 0)
+				return FALSE;
+			if (opus_repacketizer_cat(context->opus_repacketizer, data, rc) != OPUS_OK)
+				return FALSE;
+			Stream_Seek(context->opus_frames, (size_t)rc);
+		}
+
+		/* The combined packet adds at most a TOC, a frame count and the frame lengths */
+		const size_t max_size = Stream_GetPosition(context->opus_frames) + 2ull * count + 2ull;
+		if (!Stream_EnsureRemainingCapacity(out, max_size))
+			return FALSE;
+
+		const opus_int32 rc =
+		    opus_repacketizer_out(context->opus_repacketizer, Stream_Pointer(out),
+		                          WINPR_ASSERTING_INT_CAST(opus_int32, max_size));
+		if (rc < 0)
+			return FALSE;
+		Stream_Seek(out, (size_t)rc);
+	}
+
+	const size_t used = count * frameSize * bpf;
+	const size_t left = Stream_GetPosition(buffer) - used;
+	memmove(Stream_Buffer(buffer), Stream_Buffer(buffer) + used, left);
+	Stream_SetPosition(buffer, left);
+	return TRUE;
+}
+
 static BOOL freerdp_dsp_encode_opus(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
                                     const BYTE* WINPR_RESTRICT src, size_t size,
                                     wStream* WINPR_RESTRICT out)
@@ -641,19 +776,11 @@ static BOOL freerdp_dsp_encode_opus(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	if (!context || !src || !out)
 		return FALSE;
 
-	/* Max packet duration is 120ms (5760 at 48KHz) */
-	const size_t max_size = OPUS_MAX_FRAMES * context->common.format.nChannels * sizeof(int16_t);
-	if (!Stream_EnsureRemainingCapacity(context->common.buffer, max_size))
-		return FALSE;
+	if (context->common.opusFrameDuration > 0)
+		return freerdp_dsp_encode_opus_frames(context, src, size, out);
 
 	const size_t src_frames = size / sizeof(opus_int16) / context->common.format.nChannels;
-	const opus_int16* src_data = (const opus_int16*)src;
-	const int frames = opus_encode(
-	    context->opus_encoder, src_data, WINPR_ASSERTING_INT_CAST(opus_int32, src_frames),
-	    Stream_Pointer(out), WINPR_ASSERTING_INT_CAST(opus_int32, max_size));
-	if (frames < 0)
-		return FALSE;
-	return Stream_SafeSeek(out, frames * context->common.format.nChannels * sizeof(int16_t));
+	return freerdp_dsp_encode_opus_packet(context, (const opus_int16*)src, src_frames, out);
 }
 #endif
 
@@ -1132,6 +1259,8 @@ FREERDP_DSP_CONTEXT* freerdp_dsp_context_new(BOOL encoder)
 	if (!freerdp_dsp_common_context_init(&context->common, encoder))
 		goto fail;
 
+	dsp_kernels_init(&context->kernels);
+
 #if defined(WITH_GSM)
 	context->gsm = gsm_create();
 
@@ -1217,6 +1346,9 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 			opus_decoder_destroy(context->opus_decoder);
 		if (context->opus_encoder)
 			opus_encoder_destroy(context->opus_encoder);
+		if (context->opus_repacketizer)
+			opus_repacketizer_destroy(context->opus_repacketizer);
+		Stream_Free(context->opus_frames, TRUE);
 
 #endif
 #if defined(WITH_FAAD2)
@@ -1233,6 +1365,8 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 #endif
 #if defined(WITH_SOXR)
 		soxr_delete(context->sox);
+#else
+		dsp_resampler_free(context->resampler);
 #endif
 	    free(context);
 
@@ -1519,6 +1653,9 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 		{
 			int opus_error = OPUS_OK;
 
+			if (context->opus_encoder)
+				opus_encoder_destroy(context->opus_encoder);
+
 			context->opus_encoder = opus_encoder_create(context->common.format.nSamplesPerSec,
 			                                            context->common.format.nChannels,
 			                                            OPUS_APPLICATION_VOIP, &opus_error);
@@ -1530,6 +1667,30 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 			                     OPUS_SET_BITRATE(context->common.format.nAvgBytesPerSec * 8));
 			if (opus_error != OPUS_OK)
 				return FALSE;
+
+			opus_error =
+			    opus_encoder_ctl(context->opus_encoder,
+			                     OPUS_SET_INBAND_FEC(context->common.opusInbandFEC ? 1 : 0));
+			if (opus_error != OPUS_OK)
+				return FALSE;
+
+			opus_error = opus_encoder_ctl(
+			    context->opus_encoder,
+			    OPUS_SET_PACKET_LOSS_PERC((opus_int32)context->common.opusPacketLoss));
+			if (opus_error != OPUS_OK)
+				return FALSE;
+
+			if (context->common.opusFrameDuration > 0)
+			{
+				if (!context->opus_repacketizer)
+					context->opus_repacketizer = opus_repacketizer_create();
+				if (!context->opus_frames)
+					context->opus_frames = Stream_New(NULL, OPUS_MAX_FRAME_BYTES);
+				if (!context->opus_repacketizer || !context->opus_frames)
+					return FALSE;
+			}
+
+			Stream_SetPosition(context->common.buffer, 0);
 		}
 	}
 
@@ -1579,10 +1740,58 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 #endif
 }
 
+BOOL freerdp_dsp_context_set_resample_quality(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                              FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	FREERDP_DSP_COMMON_CONTEXT* ctx = (FREERDP_DSP_COMMON_CONTEXT*)context;
+
+	if (!ctx)
+		return FALSE;
+
+	switch (quality)
+	{
+		case FREERDP_DSP_RESAMPLE_QUALITY_LOW:
+		case FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM:
+		case FREERDP_DSP_RESAMPLE_QUALITY_HIGH:
+			ctx->resampleQuality = quality;
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+BOOL freerdp_dsp_context_set_opus_framing(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
+                                          UINT32 frameDuration, BOOL inbandFEC, UINT32 packetLoss)
+{
+	FREERDP_DSP_COMMON_CONTEXT* ctx = (FREERDP_DSP_COMMON_CONTEXT*)context;
+
+	if (!ctx)
+		return FALSE;
+
+	switch (frameDuration)
+	{
+		case 0:
+		case 10:
+		case 20:
+			break;
+		default:
+			return FALSE;
+	}
+
+	if (packetLoss > 100)
+		return FALSE;
+
+	ctx->opusFrameDuration = frameDuration;
+	ctx->opusInbandFEC = inbandFEC;
+	ctx->opusPacketLoss = packetLoss;
+	return TRUE;
+}
+
 BOOL freerdp_dsp_common_context_init(FREERDP_DSP_COMMON_CONTEXT* context, BOOL encode)
 {
 	WINPR_ASSERT(context);
 	context->encoder = encode;
+	context->resampleQuality = FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM;
 	context->buffer = Stream_New(NULL, 1024);
 	if (!context->buffer)
 		goto fail;
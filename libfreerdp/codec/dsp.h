@@ -32,6 +32,10 @@ typedef struct
 	ALIGN64 wStream* buffer;
 	ALIGN64 wStream* resample;
 	ALIGN64 wStream* channelmix;
+	ALIGN64 FREERDP_DSP_RESAMPLE_QUALITY resampleQuality;
+	ALIGN64 UINT32 opusFrameDuration;
+	ALIGN64 BOOL opusInbandFEC;
+	ALIGN64 UINT32 opusPacketLoss;
 #if defined(WITH_FDK_AAC)
 	ALIGN64 BOOL fdkSetup;
 	ALIGN64 void* fdkAacInstance;
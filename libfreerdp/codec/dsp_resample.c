@@ -0,0 +1,354 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Resampler and Channel Mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+
+#include "dsp_resample.h"
+#include "sse/dsp_sse2.h"
+#include "neon/dsp_neon.h"
+
+/* Larger interpolation factors reuse the nearest of this many filter phases */
+#define DSP_RESAMPLE_MAX_PHASES 1024
+
+struct S_FREERDP_DSP_RESAMPLER
+{
+	const FREERDP_DSP_KERNELS* kernels;
+	FREERDP_DSP_RESAMPLE_QUALITY quality;
+	UINT32 srcRate;
+	UINT32 dstRate;
+	UINT32 channels;
+
+	/* Output frame n is at input position n * down / up */
+	UINT32 up;
+	UINT32 down;
+	UINT32 phases;
+	size_t taps;
+	INT16* coeffs;
+
+	/* Per channel sample history, the next output reads taps samples from pos on */
+	INT16* history;
+	size_t capacity;
+	size_t filled;
+	size_t pos;
+	UINT32 frac;
+};
+
+static INT16 dsp_read_int16(const BYTE* WINPR_RESTRICT src)
+{
+	return (INT16)(src[0] | (src[1] << 8));
+}
+
+static void dsp_write_int16(BYTE* WINPR_RESTRICT dst, INT16 val)
+{
+	dst[0] = (BYTE)(val & 0xFF);
+	dst[1] = (BYTE)((val >> 8) & 0xFF);
+}
+
+static INT32 dsp_fir_q15_generic(const INT16* WINPR_RESTRICT samples,
+                                 const INT16* WINPR_RESTRICT coeffs, size_t taps)
+{
+	INT32 sum = 0;
+
+	for (size_t x = 0; x < taps; x++)
+		sum += samples[x] * coeffs[x];
+
+	return sum;
+}
+
+static void dsp_mono_to_stereo16_generic(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                         size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void dsp_stereo_to_mono16_generic(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                         size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+	{
+		const INT32 left = dsp_read_int16(&src[4 * x]);
+		const INT32 right = dsp_read_int16(&src[4 * x + 2]);
+		dsp_write_int16(&dst[2 * x], (INT16)((left + right) >> 1));
+	}
+}
+
+void dsp_kernels_init_generic(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+	kernels->fir_q15 = dsp_fir_q15_generic;
+	kernels->mono_to_stereo16 = dsp_mono_to_stereo16_generic;
+	kernels->stereo_to_mono16 = dsp_stereo_to_mono16_generic;
+}
+
+void dsp_kernels_init(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+	dsp_kernels_init_generic(kernels);
+	dsp_init_sse2(kernels);
+	dsp_init_neon(kernels);
+}
+
+static UINT32 dsp_gcd(UINT32 a, UINT32 b)
+{
+	while (b != 0)
+	{
+		const UINT32 t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+static size_t dsp_resample_taps(FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	switch (quality)
+	{
+		case FREERDP_DSP_RESAMPLE_QUALITY_LOW:
+			return 8;
+		case FREERDP_DSP_RESAMPLE_QUALITY_HIGH:
+			return 32;
+		case FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM:
+		default:
+			return 16;
+	}
+}
+
+/* Blackman windowed sinc, one row of taps coefficients per phase, each row normalized to unity
+ * gain. Downsampling moves the cutoff below the output Nyquist frequency. */
+static BOOL dsp_resampler_init_coeffs(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler)
+{
+	const double pi = 3.14159265358979323846;
+	const size_t taps = resampler->taps;
+	const double half = (double)taps / 2.0;
+	const double ratio = (double)resampler->dstRate / (double)resampler->srcRate;
+	const double cutoff = MIN(1.0, ratio) * (1.0 - 1.5 / (double)taps);
+	double* row = calloc(taps, sizeof(double));
+
+	if (!row)
+		return FALSE;
+
+	resampler->coeffs = winpr_aligned_malloc(1ull * resampler->phases * taps * sizeof(INT16), 16);
+
+	if (!resampler->coeffs)
+	{
+		free(row);
+		return FALSE;
+	}
+
+	for (size_t phase = 0; phase < resampler->phases; phase++)
+	{
+		const double offset = (double)phase / (double)resampler->phases;
+		INT16* coeffs = &resampler->coeffs[phase * taps];
+		double sum = 0.0;
+
+		for (size_t x = 0; x < taps; x++)
+		{
+			/* Distance from the output position to input sample x */
+			const double d = offset + half - 1.0 - (double)x;
+			const double a = cutoff * pi * d;
+			const double sinc = (fabs(a) < 1e-9) ? 1.0 : sin(a) / a;
+			const double w = 0.5 + 0.5 * d / half;
+			const double window = (w <= 0.0) || (w >= 1.0)
+			                          ? 0.0
+			                          : 0.42 - 0.5 * cos(2.0 * pi * w) + 0.08 * cos(4.0 * pi * w);
+
+			row[x] = cutoff * sinc * window;
+			sum += row[x];
+		}
+
+		for (size_t x = 0; x < taps; x++)
+		{
+			const double val = round(row[x] / sum * 32768.0);
+			coeffs[x] = (INT16)MAX(-32767.0, MIN(32767.0, val));
+		}
+	}
+
+	free(row);
+	return TRUE;
+}
+
+void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler)
+		return;
+
+	winpr_aligned_free(resampler->coeffs);
+	free(resampler->history);
+	free(resampler);
+}
+
+FREERDP_DSP_RESAMPLER* dsp_resampler_new(const FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels,
+                                         UINT32 srcRate, UINT32 dstRate, UINT32 channels,
+                                         FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	WINPR_ASSERT(kernels);
+
+	if ((srcRate == 0) || (dstRate == 0) || (channels == 0))
+		return NULL;
+
+	FREERDP_DSP_RESAMPLER* resampler = calloc(1, sizeof(FREERDP_DSP_RESAMPLER));
+
+	if (!resampler)
+		return NULL;
+
+	const UINT32 gcd = dsp_gcd(srcRate, dstRate);
+	resampler->kernels = kernels;
+	resampler->quality = quality;
+	resampler->srcRate = srcRate;
+	resampler->dstRate = dstRate;
+	resampler->channels = channels;
+	resampler->up = dstRate / gcd;
+	resampler->down = srcRate / gcd;
+	resampler->phases = MIN(resampler->up, DSP_RESAMPLE_MAX_PHASES);
+	resampler->taps = dsp_resample_taps(quality);
+
+	if (!dsp_resampler_init_coeffs(resampler))
+		goto fail;
+
+	/* Start with half a filter of silence so output frame 0 is centered on input frame 0 */
+	resampler->filled = resampler->taps / 2 - 1;
+	resampler->capacity = 4096;
+	resampler->history = calloc(1ull * channels * resampler->capacity, sizeof(INT16));
+
+	if (!resampler->history)
+		goto fail;
+
+	return resampler;
+fail:
+	dsp_resampler_free(resampler);
+	return NULL;
+}
+
+BOOL dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler, UINT32 srcRate,
+                           UINT32 dstRate, UINT32 channels, FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	if (!resampler)
+		return FALSE;
+
+	return (resampler->srcRate == srcRate) && (resampler->dstRate == dstRate) &&
+	       (resampler->channels == channels) && (resampler->quality == quality);
+}
+
+static BOOL dsp_resampler_append(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                 const BYTE* WINPR_RESTRICT src, size_t frames)
+{
+	const size_t channels = resampler->channels;
+
+	/* Drop history no longer reachable by the filter */
+	if (resampler->pos > 0)
+	{
+		const size_t keep = resampler->filled - resampler->pos;
+
+		for (size_t c = 0; c < channels; c++)
+		{
+			INT16* history = &resampler->history[c * resampler->capacity];
+			memmove(history, &history[resampler->pos], keep * sizeof(INT16));
+		}
+
+		resampler->filled = keep;
+		resampler->pos = 0;
+	}
+
+	if (resampler->filled + frames > resampler->capacity)
+	{
+		const size_t capacity = resampler->filled + frames;
+		INT16* history = calloc(1ull * channels * capacity, sizeof(INT16));
+
+		if (!history)
+			return FALSE;
+
+		for (size_t c = 0; c < channels; c++)
+			memcpy(&history[c * capacity], &resampler->history[c * resampler->capacity],
+			       resampler->filled * sizeof(INT16));
+
+		free(resampler->history);
+		resampler->history = history;
+		resampler->capacity = capacity;
+	}
+
+	for (size_t c = 0; c < channels; c++)
+	{
+		INT16* history = &resampler->history[c * resampler->capacity + resampler->filled];
+
+		for (size_t x = 0; x < frames; x++)
+			history[x] = dsp_read_int16(&src[2 * (x * channels + c)]);
+	}
+
+	resampler->filled += frames;
+	return TRUE;
+}
+
+BOOL dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                           const BYTE* WINPR_RESTRICT src, size_t frames,
+                           wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(resampler);
+	WINPR_ASSERT(src || (frames == 0));
+	WINPR_ASSERT(out);
+
+	if (!dsp_resampler_append(resampler, src, frames))
+		return FALSE;
+
+	const size_t taps = resampler->taps;
+	const size_t channels = resampler->channels;
+
+	if (resampler->filled < taps + resampler->pos)
+		return TRUE;
+
+	/* Upper bound of the frames we can produce */
+	const size_t available = resampler->filled - taps - resampler->pos + 1;
+	const size_t maxFrames = (1ull * available * resampler->up) / resampler->down + 1;
+
+	if (!Stream_EnsureRemainingCapacity(out, maxFrames * channels * sizeof(INT16)))
+		return FALSE;
+
+	BYTE* dst = Stream_Pointer(out);
+	size_t produced = 0;
+
+	while (resampler->pos + taps <= resampler->filled)
+	{
+		const size_t phase = (1ull * resampler->frac * resampler->phases) / resampler->up;
+		const INT16* coeffs = &resampler->coeffs[phase * taps];
+
+		for (size_t c = 0; c < channels; c++)
+		{
+			const INT16* history = &resampler->history[c * resampler->capacity + resampler->pos];
+			const INT32 sum = resampler->kernels->fir_q15(history, coeffs, taps);
+			const INT32 val = (sum + (1 << 14)) >> 15;
+			dsp_write_int16(dst, (INT16)MAX(INT16_MIN, MIN(INT16_MAX, val)));
+			dst += sizeof(INT16);
+		}
+
+		produced++;
+		resampler->frac += resampler->down;
+		resampler->pos += resampler->frac / resampler->up;
+		resampler->frac %= resampler->up;
+	}
+
+	WINPR_ASSERT(produced <= maxFrames);
+	Stream_Seek(out, produced * channels * sizeof(INT16));
+	return TRUE;
+}
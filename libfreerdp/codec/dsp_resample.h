@@ -0,0 +1,62 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Resampler and Channel Mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+#define FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+#include <freerdp/codec/dsp.h>
+
+typedef struct
+{
+	/* Dot product of taps samples with Q15 coefficients, taps is a multiple of 8 */
+	INT32 (*fir_q15)(const INT16* WINPR_RESTRICT samples, const INT16* WINPR_RESTRICT coeffs,
+	                 size_t taps);
+	/* 16bit little endian PCM, src holds frames samples and dst 2 * frames */
+	void (*mono_to_stereo16)(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+	                         size_t frames);
+	/* 16bit little endian PCM, src holds 2 * frames samples and dst frames */
+	void (*stereo_to_mono16)(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+	                         size_t frames);
+} FREERDP_DSP_KERNELS;
+
+typedef struct S_FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+
+FREERDP_LOCAL void dsp_kernels_init_generic(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels);
+FREERDP_LOCAL void dsp_kernels_init(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels);
+
+FREERDP_LOCAL void dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler);
+
+WINPR_ATTR_MALLOC(dsp_resampler_free, 1)
+FREERDP_LOCAL FREERDP_DSP_RESAMPLER*
+dsp_resampler_new(const FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels, UINT32 srcRate,
+                  UINT32 dstRate, UINT32 channels, FREERDP_DSP_RESAMPLE_QUALITY quality);
+
+FREERDP_LOCAL BOOL dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                         UINT32 srcRate, UINT32 dstRate, UINT32 channels,
+                                         FREERDP_DSP_RESAMPLE_QUALITY quality);
+
+/* Resamples 16bit little endian interleaved PCM, appending the result to out.
+ * Output lags the input by half the filter length. */
+FREERDP_LOCAL BOOL dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                         const BYTE* WINPR_RESTRICT src, size_t frames,
+                                         wStream* WINPR_RESTRICT out);
+
+#endif /* FREERDP_LIB_CODEC_DSP_RESAMPLE_H */
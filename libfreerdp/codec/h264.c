@@ -25,19 +25,33 @@
 #include <winpr/library.h>
 #include <winpr/bitstream.h>
 #include <winpr/synch.h>
+#include <winpr/collections.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/codec/h264.h>
 #include <freerdp/codec/yuv.h>
+#include <freerdp/codec/region.h>
 #include <freerdp/log.h>
 
 #include "h264.h"
+#include "sse/h264_sse2.h"
 
 #define TAG FREERDP_TAG("codec")
 
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight);
 
-static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
+static void h264_account_buffer(H264_CONTEXT* h264, size_t* accounted, size_t bytes)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(accounted);
+
+	MemoryTag_Released(h264->memoryTag, *accounted);
+	MemoryTag_Allocated(h264->memoryTag, bytes);
+	*accounted = bytes;
+}
+
+static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height,
+                              BOOL nv12)
 {
 	BOOL isNull = FALSE;
 	UINT32 pheight = height;
@@ -54,7 +68,7 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 	if (pheight % 16 != 0)
 		pheight += 16 - pheight % 16;
 
-	const size_t nPlanes = h264->hwAccel ? 2 : 3;
+	const size_t nPlanes = nv12 ? 2 : 3;
 
 	for (size_t x = 0; x < nPlanes; x++)
 	{
@@ -62,6 +76,10 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 			isNull = TRUE;
 	}
 
+	/* switching between NV12 and I420 changes the plane layout */
+	if (nv12 != (h264->iStride[2] == 0))
+		isNull = TRUE;
+
 	if (pheight == 0)
 		return FALSE;
 	if (stride == 0)
@@ -70,7 +88,7 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 	if (isNull || (width != h264->width) || (height != h264->height) ||
 	    (stride != h264->iStride[0]))
 	{
-		if (h264->hwAccel) /* NV12 */
+		if (nv12)
 		{
 			h264->iStride[0] = stride;
 			h264->iStride[1] = stride;
@@ -86,6 +104,7 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 		h264->width = width;
 		h264->height = height;
 
+		size_t bytes = 0;
 		for (size_t x = 0; x < nPlanes; x++)
 		{
 			BYTE* tmp1 = winpr_aligned_recalloc(h264->pYUVData[x], h264->iStride[x], pheight, 16);
@@ -97,7 +116,9 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 				h264->pOldYUVData[x] = tmp2;
 			if (!tmp1 || !tmp2)
 				return FALSE;
+			bytes += 2ull * h264->iStride[x] * pheight;
 		}
+		h264_account_buffer(h264, &h264->yuvBytes, bytes);
 	}
 
 	return TRUE;
@@ -105,7 +126,7 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 
 BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
 {
-	return yuv_ensure_buffer(h264, stride, width, height);
+	return yuv_ensure_buffer(h264, stride, width, height, FALSE);
 }
 
 INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize, BYTE* pDstData,
@@ -119,7 +140,11 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	if (!h264 || h264->Compressor)
 		return -1001;
 
+	/* Only AVC420 frames can be presented without combining them on the CPU */
+	h264->keepHwFrame = h264->hwFrames && h264->subsystem->GetDmaBuf;
+	h264->hwFrameReady = FALSE;
 	status = h264->subsystem->Decompress(h264, pSrcData, SrcSize);
+	h264->keepHwFrame = FALSE;
 
 	if (status == 0)
 		return 1;
@@ -127,6 +152,9 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	if (status < 0)
 		return status;
 
+	if (h264->hwFrameReady)
+		return 1;
+
 	pYUVData[0] = h264->pYUVData[0];
 	pYUVData[1] = h264->pYUVData[1];
 	pYUVData[2] = h264->pYUVData[2];
@@ -137,6 +165,19 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	return 1;
 }
 
+BOOL h264_context_get_dmabuf(H264_CONTEXT* h264, H264_DMABUF_FRAME* frame)
+{
+	if (!h264 || !frame || h264->Compressor || !h264->subsystem)
+		return FALSE;
+
+	if (!h264->hwFrameReady || !h264->subsystem->GetDmaBuf)
+		return FALSE;
+
+	const H264_DMABUF_FRAME empty = { 0 };
+	*frame = empty;
+	return h264->subsystem->GetDmaBuf(h264, frame);
+}
+
 static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
                                     RDPGFX_H264_METABLOCK* meta, size_t count)
 {
@@ -171,50 +212,118 @@ static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
 	return TRUE;
 }
 
-static INLINE BOOL diff_tile(const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
-                             BYTE* pOldYUVData[3], UINT32 const iStride[3])
+/* The offsets of the first region overlapping a rectangle apply, as in the encoder */
+static void h264_metablock_apply_qp_regions(const H264_CONTEXT* h264, RDPGFX_H264_METABLOCK* meta)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(meta);
+
+	for (UINT32 x = 0; x < meta->numRegionRects; x++)
+	{
+		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
+
+		for (UINT32 y = 0; y < h264->numQpRegions; y++)
+		{
+			const H264_QP_REGION* region = &h264->qpRegions[y];
+			if (!rectangles_intersects(&meta->regionRects[x], &region->rect))
+				continue;
+
+			const INT32 qp = (INT32)(h264->QP & 0x3F) + region->qpOffset;
+			const UINT8 value = (UINT8)MAX(0, MIN(qp, H264_QP_MAX));
+			cur->qp = (cur->qp & 0xC0) | value;
+			cur->qualityVal = 100 - value;
+			break;
+		}
+	}
+}
+
+BOOL h264_diff_block_generic(const BYTE* WINPR_RESTRICT pSrc, UINT32 nSrcStep,
+                             const BYTE* WINPR_RESTRICT pOld, UINT32 nOldStep, size_t width,
+                             size_t height)
+{
+	for (size_t y = 0; y < height; y++)
+	{
+		if (memcmp(&pSrc[y * nSrcStep], &pOld[y * nOldStep], width) != 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static INLINE BOOL diff_tile(const H264_CONTEXT* h264, const RECTANGLE_16* regionRect,
+                             BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3])
 {
-	size_t size = 0;
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(h264->diff_block);
 
 	if (!regionRect || !pYUVData || !pOldYUVData || !iStride)
 		return FALSE;
-	size = regionRect->right - regionRect->left;
+
+	/* The chroma planes are subsampled in both directions */
+	const size_t cleft = regionRect->left / 2u;
+	const size_t cright = (regionRect->right + 1u) / 2u;
+	const size_t ctop = regionRect->top / 2u;
+	const size_t cbottom = (regionRect->bottom + 1u) / 2u;
+
 	if (regionRect->right > iStride[0])
 		return FALSE;
-	if (regionRect->right / 2u > iStride[1])
+	if (cright > iStride[1])
 		return FALSE;
-	if (regionRect->right / 2u > iStride[2])
+	if (cright > iStride[2])
 		return FALSE;
 
-	for (size_t y = regionRect->top; y < regionRect->bottom; y++)
-	{
-		const BYTE* cur0 = &pYUVData[0][y * iStride[0]];
-		const BYTE* cur1 = &pYUVData[1][y * iStride[1]];
-		const BYTE* cur2 = &pYUVData[2][y * iStride[2]];
-		const BYTE* old0 = &pOldYUVData[0][y * iStride[0]];
-		const BYTE* old1 = &pOldYUVData[1][y * iStride[1]];
-		const BYTE* old2 = &pOldYUVData[2][y * iStride[2]];
+	const size_t width = regionRect->right - regionRect->left;
+	const size_t height = regionRect->bottom - regionRect->top;
+	const size_t luma = regionRect->top * iStride[0] + regionRect->left;
+	if (h264->diff_block(&pYUVData[0][luma], iStride[0], &pOldYUVData[0][luma], iStride[0], width,
+	                     height))
+		return TRUE;
 
-		if (memcmp(&cur0[regionRect->left], &old0[regionRect->left], size) != 0)
-			return TRUE;
-		if (memcmp(&cur1[regionRect->left / 2], &old1[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
-		if (memcmp(&cur2[regionRect->left / 2], &old2[regionRect->left / 2], size / 2) != 0)
+	for (size_t x = 1; x < 3; x++)
+	{
+		const size_t chroma = ctop * iStride[x] + cleft;
+		if (h264->diff_block(&pYUVData[x][chroma], iStride[x], &pOldYUVData[x][chroma],
+		                     iStride[x], cright - cleft, cbottom - ctop))
 			return TRUE;
 	}
 	return FALSE;
 }
 
-static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE_16* regionRect,
-                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3],
-                           RDPGFX_H264_METABLOCK* meta)
+static INLINE BOOL diff_tile_rgb(const H264_CONTEXT* h264, const RECTANGLE_16* regionRect,
+                                 const BYTE* pSrcData, UINT32 nSrcStep, const BYTE* pOldData,
+                                 UINT32 nOldStep)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(h264->diff_block);
+
+	if (!regionRect || !pSrcData || !pOldData)
+		return FALSE;
+
+	if (4ull * regionRect->right > MIN(nSrcStep, nOldStep))
+		return FALSE;
+
+	const size_t offset = 4ull * regionRect->left;
+	return h264->diff_block(&pSrcData[regionRect->top * nSrcStep + offset], nSrcStep,
+	                        &pOldData[regionRect->top * nOldStep + offset], nOldStep,
+	                        4ull * (regionRect->right - regionRect->left),
+	                        regionRect->bottom - regionRect->top);
+}
+
+/* Compares either the YUV planes or, if pSrcData is set, a 32bpp RGB frame */
+static BOOL detect_changes_ex(const H264_CONTEXT* h264, BOOL firstFrameDone, const UINT32 QP,
+                              const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
+                              BYTE* pOldYUVData[3], UINT32 const iStride[3],
+                              const BYTE* pSrcData, UINT32 nSrcStep, const BYTE* pOldData,
+                              UINT32 nOldStep, RDPGFX_H264_METABLOCK* meta)
 {
 	size_t count = 0;
 	size_t wc = 0;
 	size_t hc = 0;
 	RECTANGLE_16* rectangles = NULL;
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride || !meta)
+	if (!regionRect || !meta)
+		return FALSE;
+
+	if (!pSrcData && (!pYUVData || !pOldYUVData || !iStride))
 		return FALSE;
 
 	wc = (regionRect->right - regionRect->left) / 64 + 1;
@@ -234,13 +343,15 @@ static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE
 			for (size_t x = regionRect->left; x < regionRect->right; x += 64)
 			{
 				RECTANGLE_16 rect;
-				rect.left = (UINT16)MIN(UINT16_MAX, regionRect->left + x);
-				rect.top = (UINT16)MIN(UINT16_MAX, regionRect->top + y);
-				rect.right =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->left + x + 64, regionRect->right));
-				rect.bottom =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->top + y + 64, regionRect->bottom));
-				if (diff_tile(&rect, pYUVData, pOldYUVData, iStride))
+				rect.left = (UINT16)MIN(UINT16_MAX, x);
+				rect.top = (UINT16)MIN(UINT16_MAX, y);
+				rect.right = (UINT16)MIN(UINT16_MAX, MIN(x + 64, regionRect->right));
+				rect.bottom = (UINT16)MIN(UINT16_MAX, MIN(y + 64, regionRect->bottom));
+
+				const BOOL changed =
+				    pSrcData ? diff_tile_rgb(h264, &rect, pSrcData, nSrcStep, pOldData, nOldStep)
+				             : diff_tile(h264, &rect, pYUVData, pOldYUVData, iStride);
+				if (changed)
 					rectangles[count++] = rect;
 			}
 		}
@@ -250,13 +361,23 @@ static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE
 	return TRUE;
 }
 
+static BOOL detect_changes(const H264_CONTEXT* h264, BOOL firstFrameDone, const UINT32 QP,
+                           const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
+                           BYTE* pOldYUVData[3], UINT32 const iStride[3],
+                           RDPGFX_H264_METABLOCK* meta)
+{
+	return detect_changes_ex(h264, firstFrameDone, QP, regionRect, pYUVData, pOldYUVData, iStride,
+	                         NULL, 0, NULL, 0, meta);
+}
+
 INT32 h264_get_yuv_buffer(H264_CONTEXT* h264, UINT32 nSrcStride, UINT32 nSrcWidth,
                           UINT32 nSrcHeight, BYTE* YUVData[3], UINT32 stride[3])
 {
 	if (!h264 || !h264->Compressor || !h264->subsystem || !h264->subsystem->Compress)
 		return -1;
 
-	if (!yuv_ensure_buffer(h264, nSrcStride, nSrcWidth, nSrcHeight))
+	/* Hardware encoders take NV12 directly */
+	if (!yuv_ensure_buffer(h264, nSrcStride, nSrcWidth, nSrcHeight, h264->hwAccel))
 		return -1;
 
 	for (size_t x = 0; x < 3; x++)
@@ -278,6 +399,112 @@ INT32 h264_compress(H264_CONTEXT* h264, BYTE** ppDstData, UINT32* pDstSize)
 	return h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
 }
 
+INT32 h264_compress_yuv(H264_CONTEXT* h264, const BYTE* YUVData[3], const UINT32 stride[3],
+                        BYTE** ppDstData, UINT32* pDstSize)
+{
+	if (!h264 || !h264->Compressor || !h264->subsystem || !h264->subsystem->Compress)
+		return -1;
+
+	if (!YUVData || !stride || !YUVData[0] || !YUVData[1])
+		return -1;
+
+	/* The planes must match what h264_get_yuv_buffer would have handed out */
+	const BOOL nv12 = (stride[2] == 0);
+	if (nv12 != (h264->hwAccel != 0))
+		return -1;
+	if (!nv12 && !YUVData[2])
+		return -1;
+
+	return h264->subsystem->Compress(h264, YUVData, stride, ppDstData, pDstSize);
+}
+
+static BOOL h264_rgb_input_supported(const H264_CONTEXT* h264, DWORD SrcFormat)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(h264->subsystem);
+
+	if (!h264->hwColorConversion || !h264->subsystem->CompressRGB)
+		return FALSE;
+
+	switch (SrcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static BOOL rgb_ensure_buffer(H264_CONTEXT* h264, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(h264);
+
+	const UINT32 stride = 4 * width;
+	if (h264->pOldRGBData && (h264->iOldRGBStride == stride) && (h264->iOldRGBHeight == height))
+		return TRUE;
+
+	winpr_aligned_free(h264->pOldRGBData);
+	h264->pOldRGBData = winpr_aligned_calloc(stride, height, 16);
+	h264->iOldRGBStride = stride;
+	h264->iOldRGBHeight = height;
+	h264_account_buffer(h264, &h264->rgbBytes, h264->pOldRGBData ? 1ull * stride * height : 0);
+	return h264->pOldRGBData != NULL;
+}
+
+/* Hands the RGB frame to the encoder unconverted, change detection runs on the RGB data */
+static INT32 avc420_compress_rgb(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
+                                 UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
+                                 const RECTANGLE_16* regionRect, BYTE** ppDstData,
+                                 UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
+{
+	INT32 rc = -1;
+
+	if ((regionRect->right > nSrcWidth) || (regionRect->bottom > nSrcHeight))
+		goto fail;
+
+	if (!rgb_ensure_buffer(h264, nSrcWidth, nSrcHeight))
+		goto fail;
+
+	if (!detect_changes_ex(h264, h264->firstLumaFrameDone, h264->QP, regionRect, NULL, NULL,
+	                       NULL, pSrcData, nSrcStep, h264->pOldRGBData, h264->iOldRGBStride,
+	                       meta))
+		goto fail;
+
+	if (meta->numRegionRects == 0)
+	{
+		rc = 0;
+		goto fail;
+	}
+
+	h264->qpRegionsActive = TRUE;
+	h264->qpRegionsApplied = FALSE;
+	rc = h264->subsystem->CompressRGB(h264, pSrcData, SrcFormat, nSrcStep, ppDstData, pDstSize);
+	h264->qpRegionsActive = FALSE;
+	if (rc < 0)
+		goto fail;
+
+	if (h264->qpRegionsApplied)
+		h264_metablock_apply_qp_regions(h264, meta);
+
+	h264->firstLumaFrameDone = TRUE;
+
+	const size_t size = 4ull * (regionRect->right - regionRect->left);
+	for (size_t y = regionRect->top; y < regionRect->bottom; y++)
+	{
+		const size_t offset = 4ull * regionRect->left;
+		memcpy(&h264->pOldRGBData[y * h264->iOldRGBStride + offset],
+		       &pSrcData[y * nSrcStep + offset], size);
+	}
+
+fail:
+	if (rc < 0)
+		free_h264_metablock(meta);
+	return rc;
+}
+
 INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
                       UINT32 nSrcWidth, UINT32 nSrcHeight, const RECTANGLE_16* regionRect,
                       BYTE** ppDstData, UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
@@ -296,6 +523,17 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc420_ensure_buffer(h264, nSrcStep, nSrcWidth, nSrcHeight))
 		return -1;
 
+	if (h264_rgb_input_supported(h264, SrcFormat))
+	{
+		rc = avc420_compress_rgb(h264, pSrcData, SrcFormat, nSrcStep, nSrcWidth, nSrcHeight,
+		                         regionRect, ppDstData, pDstSize, meta);
+		if ((rc >= 0) || h264->hwColorConversion)
+			return rc;
+
+		/* The encoder refused the RGB upload, convert on the CPU from now on */
+		h264->firstLumaFrameDone = FALSE;
+	}
+
 	if (h264->encodingBuffer)
 	{
 		for (size_t x = 0; x < 3; x++)
@@ -318,8 +556,8 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                           regionRect, 1))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData, pOldYUVData,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData,
+	                    pOldYUVData, h264->iStride, meta))
 		goto fail;
 
 	if (meta->numRegionRects == 0)
@@ -331,9 +569,16 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	for (size_t x = 0; x < 3; x++)
 		pcYUVData[x] = pYUVData[x];
 
+	h264->qpRegionsActive = TRUE;
+	h264->qpRegionsApplied = FALSE;
 	rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
+	h264->qpRegionsActive = FALSE;
 	if (rc >= 0)
+	{
 		h264->firstLumaFrameDone = TRUE;
+		if (h264->qpRegionsApplied)
+			h264_metablock_apply_qp_regions(h264, meta);
+	}
 
 fail:
 	if (rc < 0)
@@ -387,11 +632,11 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	                           pYUV444Data, pYUVData, region, 1))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, region, pYUV444Data, pOldYUV444Data,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, h264->QP, region, pYUV444Data,
+	                    pOldYUV444Data, h264->iStride, meta))
 		goto fail;
-	if (!detect_changes(h264->firstChromaFrameDone, h264->QP, region, pYUVData, pOldYUVData,
-	                    h264->iStride, auxMeta))
+	if (!detect_changes(h264, h264->firstChromaFrameDone, h264->QP, region, pYUVData,
+	                    pOldYUVData, h264->iStride, auxMeta))
 		goto fail;
 
 	/* [MS-RDPEGFX] 2.2.4.5 RFX_AVC444_BITMAP_STREAM
@@ -490,6 +735,9 @@ static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight)
 				goto fail;
 			h264->lumaData = tmp;
 		}
+
+		/* two buffers for each of the 3 planes plus the 4 luma planes */
+		h264_account_buffer(h264, &h264->yuv444Bytes, 10ull * piDstSize[0]);
 	}
 
 	for (UINT32 x = 0; x < 3; x++)
@@ -521,6 +769,7 @@ static BOOL avc444_process_rects(H264_CONTEXT* h264, const BYTE* pSrcData, UINT3
 	BYTE** ppYUVDstData = h264->pYUV444Data;
 	const UINT32* piStride = h264->iStride;
 
+	h264->hwFrameReady = FALSE;
 	if (h264->subsystem->Decompress(h264, pSrcData, SrcSize) < 0)
 		return FALSE;
 
@@ -680,6 +929,8 @@ static BOOL h264_context_init(H264_CONTEXT* h264)
 		return FALSE;
 
 	h264->subsystem = NULL;
+	h264->hwColorConversion = FALSE;
+	h264->hwFrameReady = FALSE;
 	InitOnceExecuteOnce(&subsystems_once, h264_register_subsystems, NULL, NULL);
 
 	for (size_t i = 0; i < MAX_SUBSYSTEMS; i++)
@@ -706,11 +957,29 @@ BOOL h264_context_reset(H264_CONTEXT* h264, UINT32 width, UINT32 height)
 
 	h264->width = width;
 	h264->height = height;
+	h264->hwFrameReady = FALSE;
+	h264->numQpRegions = 0;
 
-	if (h264->subsystem && h264->subsystem->Uninit)
-		h264->subsystem->Uninit(h264);
-	if (!h264_context_init(h264))
-		return FALSE;
+	/* A decoder follows resolution changes in the stream and a new stream starts with an IDR
+	 * frame, so an initialized decoder session is kept. */
+	if (h264->Compressor || !h264->subsystem)
+	{
+		if (h264->subsystem && h264->subsystem->Uninit)
+			h264->subsystem->Uninit(h264);
+		if (!h264_context_init(h264))
+			return FALSE;
+	}
+
+	const UINT32 flags = h264->sharedThreadpool ? THREADING_FLAGS_SHARED_POOL : 0;
+	if (flags != h264->yuvThreadingFlags)
+	{
+		YUV_CONTEXT* yuv = yuv_context_new(h264->Compressor, flags);
+		if (!yuv)
+			return FALSE;
+		yuv_context_free(h264->yuv);
+		h264->yuv = yuv;
+		h264->yuvThreadingFlags = flags;
+	}
 
 	return yuv_context_reset(h264->yuv, width, height);
 }
@@ -726,6 +995,10 @@ H264_CONTEXT* h264_context_new(BOOL Compressor)
 	if (!h264->log)
 		goto fail;
 
+	h264->memoryTag = MemoryTag_Get("codec_h264");
+	h264->diff_block = h264_diff_block_generic;
+	h264_init_sse2(h264);
+
 	h264->Compressor = Compressor;
 	if (Compressor)
 	{
@@ -772,12 +1045,41 @@ void h264_context_free(H264_CONTEXT* h264)
 			winpr_aligned_free(h264->pOldYUV444Data[x]);
 		}
 		winpr_aligned_free(h264->lumaData);
+		winpr_aligned_free(h264->pOldRGBData);
+		h264_account_buffer(h264, &h264->yuvBytes, 0);
+		h264_account_buffer(h264, &h264->yuv444Bytes, 0);
+		h264_account_buffer(h264, &h264->rgbBytes, 0);
 
 		yuv_context_free(h264->yuv);
+		free(h264->qpRegions);
 		free(h264);
 	}
 }
 
+BOOL h264_context_set_qp_regions(H264_CONTEXT* h264, const H264_QP_REGION* regions, UINT32 count)
+{
+	if (!h264 || !h264->Compressor || ((count > 0) && !regions))
+		return FALSE;
+
+	if (count > h264->maxQpRegions)
+	{
+		H264_QP_REGION* tmp = realloc(h264->qpRegions, sizeof(H264_QP_REGION) * count);
+		if (!tmp)
+			return FALSE;
+		h264->qpRegions = tmp;
+		h264->maxQpRegions = count;
+	}
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		h264->qpRegions[x] = regions[x];
+		h264->qpRegions[x].qpOffset =
+		    MAX(-H264_QP_MAX, MIN(regions[x].qpOffset, H264_QP_MAX));
+	}
+	h264->numQpRegions = count;
+	return TRUE;
+}
+
 void free_h264_metablock(RDPGFX_H264_METABLOCK* meta)
 {
 	RDPGFX_H264_METABLOCK m = { 0 };
@@ -811,6 +1113,40 @@ BOOL h264_context_set_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option, UIN
 		case H264_CONTEXT_OPTION_HW_ACCEL:
 			h264->hwAccel = value ? TRUE : FALSE;
 			return TRUE;
+		case H264_CONTEXT_OPTION_HW_FRAMES:
+			h264->hwFrames = value ? TRUE : FALSE;
+			return TRUE;
+		case H264_CONTEXT_OPTION_THREADS:
+			h264->NumberOfThreads = value;
+			return TRUE;
+		case H264_CONTEXT_OPTION_THREAD_TYPE:
+			switch (value)
+			{
+				case H264_THREAD_SLICE:
+				case H264_THREAD_FRAME:
+					h264->ThreadType = value;
+					return TRUE;
+				default:
+					WLog_Print(h264->log, WLOG_WARN, "Unknown H264_THREAD_TYPE[0x%08" PRIx32 "]",
+					           value);
+					return FALSE;
+			}
+		case H264_CONTEXT_OPTION_SHARED_THREADPOOL:
+			h264->sharedThreadpool = value ? TRUE : FALSE;
+			return TRUE;
+		case H264_CONTEXT_OPTION_HW_ENCODER:
+			switch (value)
+			{
+				case H264_HW_ENCODER_AUTO:
+				case H264_HW_ENCODER_VAAPI:
+				case H264_HW_ENCODER_NVENC:
+					h264->hwEncoder = value;
+					return TRUE;
+				default:
+					WLog_Print(h264->log, WLOG_WARN, "Unknown H264_HW_ENCODER[0x%08" PRIx32 "]",
+					           value);
+					return FALSE;
+			}
 		default:
 			WLog_Print(h264->log, WLOG_WARN, "Unknown H264_CONTEXT_OPTION[0x%08" PRIx32 "]",
 			           option);
@@ -835,6 +1171,16 @@ UINT32 h264_context_get_option(H264_CONTEXT* h264, H264_CONTEXT_OPTION option)
 			return h264->UsageType;
 		case H264_CONTEXT_OPTION_HW_ACCEL:
 			return h264->hwAccel;
+		case H264_CONTEXT_OPTION_HW_ENCODER:
+			return h264->hwEncoder;
+		case H264_CONTEXT_OPTION_HW_FRAMES:
+			return h264->hwFrames;
+		case H264_CONTEXT_OPTION_THREADS:
+			return h264->NumberOfThreads;
+		case H264_CONTEXT_OPTION_THREAD_TYPE:
+			return h264->ThreadType;
+		case H264_CONTEXT_OPTION_SHARED_THREADPOOL:
+			return h264->sharedThreadpool;
 		default:
 			WLog_Print(h264->log, WLOG_WARN, "Unknown H264_CONTEXT_OPTION[0x%08" PRIx32 "]",
 			           option);
@@ -23,6 +23,8 @@
 
 #include <freerdp/api.h>
 #include <freerdp/config.h>
+#include <winpr/collections.h>
+
 #include <freerdp/codec/h264.h>
 
 #ifdef __cplusplus
@@ -40,6 +42,18 @@ extern "C"
 	                                        const UINT32* WINPR_RESTRICT pStride,
 	                                        BYTE** WINPR_RESTRICT ppDstData,
 	                                        UINT32* WINPR_RESTRICT pDstSize);
+	typedef int (*pfnH264SubsystemCompressRGB)(H264_CONTEXT* WINPR_RESTRICT h264,
+	                                           const BYTE* WINPR_RESTRICT pSrcData,
+	                                           DWORD SrcFormat, UINT32 nSrcStep,
+	                                           BYTE** WINPR_RESTRICT ppDstData,
+	                                           UINT32* WINPR_RESTRICT pDstSize);
+	typedef BOOL (*pfnH264SubsystemGetDmaBuf)(H264_CONTEXT* WINPR_RESTRICT h264,
+	                                          H264_DMABUF_FRAME* WINPR_RESTRICT frame);
+
+	/* TRUE if any of the width x height bytes differ */
+	typedef BOOL (*pfnH264DiffBlock)(const BYTE* WINPR_RESTRICT pSrc, UINT32 nSrcStep,
+	                                 const BYTE* WINPR_RESTRICT pOld, UINT32 nOldStep,
+	                                 size_t width, size_t height);
 
 	struct S_H264_CONTEXT_SUBSYSTEM
 	{
@@ -48,6 +62,10 @@ extern "C"
 		pfnH264SubsystemUninit Uninit;
 		pfnH264SubsystemDecompress Decompress;
 		pfnH264SubsystemCompress Compress;
+		/* Optional, encodes 32bpp RGB input when hwColorConversion is set */
+		pfnH264SubsystemCompressRGB CompressRGB;
+		/* Optional, exports the frame Decompress left on the GPU (hwFrameReady) */
+		pfnH264SubsystemGetDmaBuf GetDmaBuf;
 	};
 
 	struct S_H264_CONTEXT
@@ -63,7 +81,14 @@ extern "C"
 		UINT32 QP;
 		UINT32 UsageType;
 		UINT32 hwAccel;
+		UINT32 hwEncoder;
+		BOOL hwColorConversion;
+		BOOL hwFrames;
+		BOOL keepHwFrame;
+		BOOL hwFrameReady;
 		UINT32 NumberOfThreads;
+		H264_THREAD_TYPE ThreadType;
+		BOOL sharedThreadpool;
 
 		UINT32 iStride[3];
 		BYTE* pOldYUVData[3];
@@ -74,10 +99,15 @@ extern "C"
 		BYTE* pOldYUV444Data[3];
 		BYTE* pYUV444Data[3];
 
+		UINT32 iOldRGBStride;
+		UINT32 iOldRGBHeight;
+		BYTE* pOldRGBData;
+
 		UINT32 numSystemData;
 		void* pSystemData;
 		const H264_CONTEXT_SUBSYSTEM* subsystem;
 		YUV_CONTEXT* yuv;
+		UINT32 yuvThreadingFlags;
 
 		BOOL encodingBuffer;
 		BOOL firstLumaFrameDone;
@@ -85,8 +115,29 @@ extern "C"
 
 		void* lumaData;
 		wLog* log;
+
+		/* bytes of the frame buffers accounted against memoryTag */
+		wMemoryTag* memoryTag;
+		size_t yuvBytes;
+		size_t yuv444Bytes;
+		size_t rgbBytes;
+
+		/* quantizer offsets set with h264_context_set_qp_regions, only the subsystem
+		 * knows if its encoder supports them and sets qpRegionsApplied if it did */
+		H264_QP_REGION* qpRegions;
+		UINT32 numQpRegions;
+		UINT32 maxQpRegions;
+		BOOL qpRegionsActive;
+		BOOL qpRegionsApplied;
+
+		/* Change detection kernel, replaced by a SIMD version where available */
+		pfnH264DiffBlock diff_block;
 	};
 
+	FREERDP_LOCAL BOOL h264_diff_block_generic(const BYTE* WINPR_RESTRICT pSrc, UINT32 nSrcStep,
+	                                           const BYTE* WINPR_RESTRICT pOld, UINT32 nOldStep,
+	                                           size_t width, size_t height);
+
 	FREERDP_LOCAL BOOL avc420_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width,
 	                                        UINT32 height);
 
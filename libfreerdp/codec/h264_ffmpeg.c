@@ -23,6 +23,7 @@
 #include <winpr/wlog.h>
 #include <freerdp/log.h>
 #include <freerdp/codec/h264.h>
+#include <freerdp/codec/color.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/opt.h>
 
@@ -38,6 +39,17 @@
 #endif
 #endif
 
+/* Exporting decoded surfaces needs AV_PIX_FMT_DRM_PRIME mapping */
+#if defined(WITH_VAAPI) && (LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 0, 0))
+#include <libavutil/hwcontext_drm.h>
+#define WITH_VAAPI_DMABUF
+#endif
+
+/* NVENC RGB input and the zerolatency option are only in newer libavcodec */
+#if defined(WITH_NVENC_H264_ENCODING) && (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 18, 100))
+#undef WITH_NVENC_H264_ENCODING
+#endif
+
 /* Fallback support for older libavcodec versions */
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(54, 59, 100)
 #define AV_CODEC_ID_H264 CODEC_ID_H264
@@ -81,10 +93,14 @@ typedef struct
 	AVPacket bufferpacket;
 #endif
 	AVPacket* packet;
+	enum AVPixelFormat inputPixFmt;
 #if defined(WITH_VAAPI) || defined(WITH_VAAPI_H264_ENCODING)
 	AVBufferRef* hwctx;
 	AVFrame* hwVideoFrame;
 	enum AVPixelFormat hw_pix_fmt;
+#if defined(WITH_VAAPI_DMABUF)
+	AVFrame* drmFrame;
+#endif
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 80, 100)
 	AVBufferRef* hw_frames_ctx;
 #endif
@@ -114,6 +130,11 @@ static void libavcodec_destroy_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264
 }
 
 #ifdef WITH_VAAPI_H264_ENCODING
+static BOOL libavcodec_is_rgb(int format)
+{
+	return (format == AV_PIX_FMT_BGR0) || (format == AV_PIX_FMT_RGB0);
+}
+
 static int set_hw_frames_ctx(H264_CONTEXT* WINPR_RESTRICT h264)
 {
 	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
@@ -150,7 +171,18 @@ static int set_hw_frames_ctx(H264_CONTEXT* WINPR_RESTRICT h264)
 }
 #endif
 
-static BOOL libavcodec_create_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264)
+static BOOL libavcodec_is_nvenc(const H264_CONTEXT* WINPR_RESTRICT h264)
+{
+#ifdef WITH_NVENC_H264_ENCODING
+	return h264->hwAccel && (h264->hwEncoder == H264_HW_ENCODER_NVENC);
+#else
+	WINPR_UNUSED(h264);
+	return FALSE;
+#endif
+}
+
+static BOOL libavcodec_create_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264,
+                                              enum AVPixelFormat inputPixFmt)
 {
 	BOOL recreate = FALSE;
 	H264_CONTEXT_LIBAVCODEC* sys = NULL;
@@ -170,7 +202,8 @@ static BOOL libavcodec_create_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264)
 	if (sys->codecEncoderContext)
 	{
 		if ((sys->codecEncoderContext->width != (int)h264->width) ||
-		    (sys->codecEncoderContext->height != (int)h264->height))
+		    (sys->codecEncoderContext->height != (int)h264->height) ||
+		    (sys->inputPixFmt != inputPixFmt))
 			recreate = TRUE;
 	}
 
@@ -227,6 +260,17 @@ static BOOL libavcodec_create_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264)
 	}
 	else
 #endif
+	if (libavcodec_is_nvenc(h264))
+	{
+		/* NVENC converts RGB input on the GPU, so it is fed whatever the caller has */
+		av_opt_set(sys->codecEncoderContext, "preset", "p2", AV_OPT_SEARCH_CHILDREN);
+		av_opt_set(sys->codecEncoderContext, "tune", "ull", AV_OPT_SEARCH_CHILDREN);
+		av_opt_set_int(sys->codecEncoderContext, "zerolatency", 1, AV_OPT_SEARCH_CHILDREN);
+		/* one packet out for every frame in */
+		av_opt_set_int(sys->codecEncoderContext, "delay", 0, AV_OPT_SEARCH_CHILDREN);
+		sys->codecEncoderContext->pix_fmt = inputPixFmt;
+	}
+	else
 	{
 		av_opt_set(sys->codecEncoderContext, "preset", "medium", AV_OPT_SEARCH_CHILDREN);
 		sys->codecEncoderContext->pix_fmt = AV_PIX_FMT_YUV420P;
@@ -235,6 +279,7 @@ static BOOL libavcodec_create_encoder_context(H264_CONTEXT* WINPR_RESTRICT h264)
 	if (avcodec_open2(sys->codecEncoderContext, sys->codecEncoder, NULL) < 0)
 		goto EXCEPTION;
 
+	sys->inputPixFmt = inputPixFmt;
 	return TRUE;
 EXCEPTION:
 	libavcodec_destroy_encoder_context(h264);
@@ -327,9 +372,19 @@ static int libavcodec_decompress(H264_CONTEXT* WINPR_RESTRICT h264,
 	{
 		if (sys->hwVideoFrame->format == sys->hw_pix_fmt)
 		{
-			sys->videoFrame->width = sys->hwVideoFrame->width;
-			sys->videoFrame->height = sys->hwVideoFrame->height;
-			status = av_hwframe_transfer_data(sys->videoFrame, sys->hwVideoFrame, 0);
+#if defined(WITH_VAAPI_DMABUF)
+			if (h264->keepHwFrame)
+			{
+				/* Stays on the GPU until libavcodec_get_dmabuf exports it */
+				h264->hwFrameReady = TRUE;
+			}
+			else
+#endif
+			{
+				sys->videoFrame->width = sys->hwVideoFrame->width;
+				sys->videoFrame->height = sys->hwVideoFrame->height;
+				status = av_hwframe_transfer_data(sys->videoFrame, sys->hwVideoFrame, 0);
+			}
 		}
 		else
 		{
@@ -348,7 +403,9 @@ static int libavcodec_decompress(H264_CONTEXT* WINPR_RESTRICT h264,
 
 #endif
 
-	if (gotFrame)
+	if (gotFrame && h264->hwFrameReady)
+		rc = 1;
+	else if (gotFrame)
 	{
 		WINPR_ASSERT(sys->videoFrame);
 
@@ -374,16 +431,44 @@ fail:
 	return rc;
 }
 
-static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
-                               const BYTE** WINPR_RESTRICT pSrcYuv,
-                               const UINT32* WINPR_RESTRICT pStride,
-                               BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+/* AVRegionOfInterest scales the offset to the QP range of the encoder, -1 to 1 */
+static BOOL libavcodec_set_qp_regions(H264_CONTEXT* WINPR_RESTRICT h264, AVFrame* frame)
 {
-	union
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(frame);
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 25, 100)
+	av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+	if (!h264->qpRegionsActive || (h264->numQpRegions == 0))
+		return FALSE;
+
+	AVFrameSideData* data =
+	    av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+	                           sizeof(AVRegionOfInterest) * h264->numQpRegions);
+	if (!data)
+		return FALSE;
+
+	AVRegionOfInterest* roi = (AVRegionOfInterest*)data->data;
+	for (UINT32 x = 0; x < h264->numQpRegions; x++)
 	{
-		const BYTE* cpv;
-		uint8_t* pv;
-	} cnv;
+		const H264_QP_REGION* region = &h264->qpRegions[x];
+		roi[x].self_size = sizeof(AVRegionOfInterest);
+		roi[x].top = region->rect.top;
+		roi[x].bottom = region->rect.bottom;
+		roi[x].left = region->rect.left;
+		roi[x].right = region->rect.right;
+		roi[x].qoffset = av_make_q(region->qpOffset, H264_QP_MAX);
+	}
+	return TRUE;
+#else
+	WINPR_UNUSED(frame);
+	return FALSE;
+#endif
+}
+
+static int libavcodec_encode_frame(H264_CONTEXT* WINPR_RESTRICT h264,
+                                   BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+{
 	int rc = -1;
 	int status = 0;
 	int gotFrame = 0;
@@ -393,9 +478,6 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
 	WINPR_ASSERT(sys);
 
-	if (!libavcodec_create_encoder_context(h264))
-		return -1;
-
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100)
 	sys->packet = &sys->bufferpacket;
 	av_packet_unref(sys->packet);
@@ -416,7 +498,6 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 
 	WINPR_ASSERT(sys->videoFrame);
 	WINPR_ASSERT(sys->codecEncoderContext);
-	sys->videoFrame->format = AV_PIX_FMT_YUV420P;
 	sys->videoFrame->width = sys->codecEncoderContext->width;
 	sys->videoFrame->height = sys->codecEncoderContext->height;
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(52, 48, 100)
@@ -425,18 +506,6 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(52, 92, 100)
 	sys->videoFrame->chroma_location = AVCHROMA_LOC_LEFT;
 #endif
-	cnv.cpv = pSrcYuv[0];
-	sys->videoFrame->data[0] = cnv.pv;
-
-	cnv.cpv = pSrcYuv[1];
-	sys->videoFrame->data[1] = cnv.pv;
-
-	cnv.cpv = pSrcYuv[2];
-	sys->videoFrame->data[2] = cnv.pv;
-
-	sys->videoFrame->linesize[0] = (int)pStride[0];
-	sys->videoFrame->linesize[1] = (int)pStride[1];
-	sys->videoFrame->linesize[2] = (int)pStride[2];
 	sys->videoFrame->pts++;
 
 #ifdef WITH_VAAPI_H264_ENCODING
@@ -451,24 +520,29 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 			           av_err2str(status), status);
 			goto fail;
 		}
-		sys->videoFrame->format = AV_PIX_FMT_NV12;
+
+		/* The driver converts non NV12 input while copying it to the surface */
 		if ((status = av_hwframe_transfer_data(sys->hwVideoFrame, sys->videoFrame, 0)) < 0)
 		{
 			WLog_Print(h264->log, WLOG_ERROR, "av_hwframe_transfer_data failed (%s [%d])",
 			           av_err2str(status), status);
+			if (libavcodec_is_rgb(sys->videoFrame->format))
+				h264->hwColorConversion = FALSE;
 			goto fail;
 		}
 	}
 #endif
 
-	/* avcodec_encode_video2 is deprecated with libavcodec 57.48.101 */
-#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 #ifdef WITH_VAAPI_H264_ENCODING
-	status = avcodec_send_frame(sys->codecEncoderContext,
-	                            sys->hwctx ? sys->hwVideoFrame : sys->videoFrame);
+	AVFrame* frame = sys->hwctx ? sys->hwVideoFrame : sys->videoFrame;
 #else
-	status = avcodec_send_frame(sys->codecEncoderContext, sys->videoFrame);
+	AVFrame* frame = sys->videoFrame;
 #endif
+	const BOOL qpRegions = libavcodec_set_qp_regions(h264, frame);
+
+	/* avcodec_encode_video2 is deprecated with libavcodec 57.48.101 */
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+	status = avcodec_send_frame(sys->codecEncoderContext, frame);
 
 	if (status < 0)
 	{
@@ -529,11 +603,187 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 		rc = -2;
 	}
 	else
+	{
+		h264->qpRegionsApplied = qpRegions;
 		rc = 1;
+	}
 fail:
 	return rc;
 }
 
+static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
+                               const BYTE** WINPR_RESTRICT pSrcYuv,
+                               const UINT32* WINPR_RESTRICT pStride,
+                               BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+{
+	union
+	{
+		const BYTE* cpv;
+		uint8_t* pv;
+	} cnv;
+
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(pSrcYuv);
+	WINPR_ASSERT(pStride);
+
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	/* h264_get_yuv_buffer hands out NV12 for hardware encoders */
+	const enum AVPixelFormat format = (pStride[2] == 0) ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
+
+	if (!libavcodec_create_encoder_context(h264, format))
+		return -1;
+
+	WINPR_ASSERT(sys->videoFrame);
+	sys->videoFrame->format = format;
+
+	cnv.cpv = pSrcYuv[0];
+	sys->videoFrame->data[0] = cnv.pv;
+
+	cnv.cpv = pSrcYuv[1];
+	sys->videoFrame->data[1] = cnv.pv;
+
+	cnv.cpv = pSrcYuv[2];
+	sys->videoFrame->data[2] = cnv.pv;
+
+	sys->videoFrame->linesize[0] = (int)pStride[0];
+	sys->videoFrame->linesize[1] = (int)pStride[1];
+	sys->videoFrame->linesize[2] = (int)pStride[2];
+
+	return libavcodec_encode_frame(h264, ppDstData, pDstSize);
+}
+
+static int libavcodec_compress_rgb(H264_CONTEXT* WINPR_RESTRICT h264,
+                                   const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat,
+                                   UINT32 nSrcStep, BYTE** WINPR_RESTRICT ppDstData,
+                                   UINT32* WINPR_RESTRICT pDstSize)
+{
+	union
+	{
+		const BYTE* cpv;
+		uint8_t* pv;
+	} cnv;
+	enum AVPixelFormat format = AV_PIX_FMT_NONE;
+
+	WINPR_ASSERT(h264);
+
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	/* Alpha is ignored by the encoder, the X formats are the ones drivers accept */
+	switch (SrcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			format = AV_PIX_FMT_BGR0;
+			break;
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			format = AV_PIX_FMT_RGB0;
+			break;
+		default:
+			WLog_Print(h264->log, WLOG_ERROR, "Unsupported RGB input format %s",
+			           FreeRDPGetColorFormatName(SrcFormat));
+			return -1;
+	}
+
+	if (nSrcStep > INT_MAX)
+		return -1;
+
+	if (!libavcodec_create_encoder_context(h264, format))
+		return -1;
+
+	WINPR_ASSERT(sys->videoFrame);
+	sys->videoFrame->format = format;
+
+	cnv.cpv = pSrcData;
+	sys->videoFrame->data[0] = cnv.pv;
+	sys->videoFrame->data[1] = NULL;
+	sys->videoFrame->data[2] = NULL;
+
+	sys->videoFrame->linesize[0] = (int)nSrcStep;
+	sys->videoFrame->linesize[1] = 0;
+	sys->videoFrame->linesize[2] = 0;
+
+	return libavcodec_encode_frame(h264, ppDstData, pDstSize);
+}
+
+#if defined(WITH_VAAPI_DMABUF)
+#define H264_DRM_FOURCC(a, b, c, d) \
+	((UINT32)(a) | ((UINT32)(b) << 8) | ((UINT32)(c) << 16) | ((UINT32)(d) << 24))
+
+static BOOL libavcodec_get_dmabuf(H264_CONTEXT* WINPR_RESTRICT h264,
+                                  H264_DMABUF_FRAME* WINPR_RESTRICT frame)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(frame);
+
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	if (!sys->drmFrame || !sys->hwVideoFrame || !sys->hwVideoFrame->hw_frames_ctx)
+		return FALSE;
+
+	/* The mapping holds a reference to the surface and owns the exported descriptors */
+	av_frame_unref(sys->drmFrame);
+	sys->drmFrame->format = AV_PIX_FMT_DRM_PRIME;
+	const int status = av_hwframe_map(sys->drmFrame, sys->hwVideoFrame, AV_HWFRAME_MAP_READ);
+	if (status < 0)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "Failed to export video frame (%s [%d])",
+		           av_err2str(status), status);
+		return FALSE;
+	}
+
+	const AVDRMFrameDescriptor* desc = (const AVDRMFrameDescriptor*)sys->drmFrame->data[0];
+	if (!desc || (desc->nb_objects < 1) || (desc->nb_objects > (int)ARRAYSIZE(frame->fds)) ||
+	    (desc->nb_layers < 1))
+		return FALSE;
+
+	frame->width = (UINT32)MAX(0, sys->hwVideoFrame->width);
+	frame->height = (UINT32)MAX(0, sys->hwVideoFrame->height);
+	frame->modifier = desc->objects[0].format_modifier;
+	frame->numObjects = (UINT32)desc->nb_objects;
+	for (int x = 0; x < desc->nb_objects; x++)
+		frame->fds[x] = desc->objects[x].fd;
+
+	/* VAAPI exports NV12 either as one layer or as separate R8 and GR88 layers */
+	if (desc->nb_layers == 1)
+		frame->fourcc = desc->layers[0].format;
+	else
+	{
+		const AVHWFramesContext* frames =
+		    (const AVHWFramesContext*)sys->hwVideoFrame->hw_frames_ctx->data;
+		if (frames->sw_format == AV_PIX_FMT_NV12)
+			frame->fourcc = H264_DRM_FOURCC('N', 'V', '1', '2');
+		else if (frames->sw_format == AV_PIX_FMT_P010)
+			frame->fourcc = H264_DRM_FOURCC('P', '0', '1', '0');
+		else
+			return FALSE;
+	}
+
+	for (int x = 0; x < desc->nb_layers; x++)
+	{
+		const AVDRMLayerDescriptor* layer = &desc->layers[x];
+		for (int y = 0; y < layer->nb_planes; y++)
+		{
+			const AVDRMPlaneDescriptor* plane = &layer->planes[y];
+			const size_t index = frame->numPlanes;
+
+			if (index >= ARRAYSIZE(frame->planeObject))
+				return FALSE;
+			frame->planeObject[index] = (UINT32)plane->object_index;
+			frame->planeOffset[index] = (UINT32)plane->offset;
+			frame->planePitch[index] = (UINT32)plane->pitch;
+			frame->numPlanes++;
+		}
+	}
+
+	return TRUE;
+}
+#endif
+
 static void libavcodec_uninit(H264_CONTEXT* h264)
 {
 	WINPR_ASSERT(h264);
@@ -571,6 +821,10 @@ static void libavcodec_uninit(H264_CONTEXT* h264)
 #endif
 	}
 
+#if defined(WITH_VAAPI_DMABUF)
+	av_frame_free(&sys->drmFrame);
+#endif
+
 	if (sys->hwctx)
 		av_buffer_unref(&sys->hwctx);
 
@@ -657,6 +911,99 @@ static enum AVPixelFormat libavcodec_get_format(struct AVCodecContext* ctx,
 }
 #endif
 
+#ifdef WITH_VAAPI_H264_ENCODING
+static BOOL libavcodec_init_vaapi_encoder(H264_CONTEXT* h264)
+{
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	const AVCodec* codec = avcodec_find_encoder_by_name("h264_vaapi");
+	if (!codec)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "H264 VAAPI encoder not found");
+		return FALSE;
+	}
+
+	if (av_hwdevice_ctx_create(&sys->hwctx, AV_HWDEVICE_TYPE_VAAPI, VAAPI_DEVICE, NULL, 0) < 0)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "av_hwdevice_ctx_create failed");
+		sys->hwctx = NULL;
+		return FALSE;
+	}
+
+	WLog_Print(h264->log, WLOG_INFO, "Using VAAPI for accelerated H264 encoding");
+	sys->codecEncoder = codec;
+	return TRUE;
+}
+#endif
+
+#ifdef WITH_NVENC_H264_ENCODING
+static BOOL libavcodec_init_nvenc_encoder(H264_CONTEXT* h264)
+{
+	H264_CONTEXT_LIBAVCODEC* sys = (H264_CONTEXT_LIBAVCODEC*)h264->pSystemData;
+	WINPR_ASSERT(sys);
+
+	const AVCodec* codec = avcodec_find_encoder_by_name("h264_nvenc");
+	if (!codec)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "H264 NVENC encoder not found");
+		return FALSE;
+	}
+
+	/* The encoder is always built, a missing GPU or driver only shows up when opening it */
+	AVCodecContext* probe = avcodec_alloc_context3(codec);
+	if (!probe)
+		return FALSE;
+
+	probe->width = 640;
+	probe->height = 480;
+	probe->time_base = (AVRational){ 1, 30 };
+	probe->pix_fmt = AV_PIX_FMT_BGR0;
+
+	const int rc = avcodec_open2(probe, codec, NULL);
+	avcodec_free_context(&probe);
+	if (rc < 0)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "H264 NVENC encoder not available: %s", av_err2str(rc));
+		return FALSE;
+	}
+
+	WLog_Print(h264->log, WLOG_INFO, "Using NVENC for accelerated H264 encoding");
+	sys->codecEncoder = codec;
+	return TRUE;
+}
+#endif
+
+#if defined(WITH_VAAPI_H264_ENCODING) || defined(WITH_NVENC_H264_ENCODING)
+static BOOL libavcodec_init_hw_encoder(H264_CONTEXT* h264, H264_HW_ENCODER encoder)
+{
+	WINPR_ASSERT(h264);
+
+	switch (encoder)
+	{
+#ifdef WITH_VAAPI_H264_ENCODING
+		case H264_HW_ENCODER_VAAPI:
+			if (!libavcodec_init_vaapi_encoder(h264))
+				return FALSE;
+			break;
+#endif
+#ifdef WITH_NVENC_H264_ENCODING
+		case H264_HW_ENCODER_NVENC:
+			if (!libavcodec_init_nvenc_encoder(h264))
+				return FALSE;
+			break;
+#endif
+		default:
+			return FALSE;
+	}
+
+	/* Both take BGRX/RGBX frames and convert them on the GPU */
+	h264->hwEncoder = encoder;
+	h264->hwColorConversion = TRUE;
+	return TRUE;
+}
+#endif
+
 static BOOL libavcodec_init(H264_CONTEXT* h264)
 {
 	H264_CONTEXT_LIBAVCODEC* sys = NULL;
@@ -727,6 +1074,19 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 	fail_hwdevice_create:
 #endif
 
+		/* libavcodec decodes on a single thread unless told otherwise. Frame threading
+		 * returns every picture a frame per thread late, slice threading does not. */
+		sys->codecDecoderContext->thread_count = (int)MIN(h264->NumberOfThreads, INT32_MAX);
+		if (h264->ThreadType == H264_THREAD_FRAME)
+			sys->codecDecoderContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		else
+		{
+			sys->codecDecoderContext->thread_type = FF_THREAD_SLICE;
+#ifdef AV_CODEC_FLAG_LOW_DELAY
+			sys->codecDecoderContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+#endif
+		}
+
 		if (avcodec_open2(sys->codecDecoderContext, sys->codecDecoder, NULL) < 0)
 		{
 			WLog_Print(h264->log, WLOG_ERROR, "Failed to open libav codec");
@@ -743,25 +1103,16 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 	}
 	else
 	{
-#ifdef WITH_VAAPI_H264_ENCODING
+#if defined(WITH_VAAPI_H264_ENCODING) || defined(WITH_NVENC_H264_ENCODING)
 		if (h264->hwAccel) /* user requested hw accel */
 		{
-			sys->codecEncoder = avcodec_find_encoder_by_name("h264_vaapi");
-			if (!sys->codecEncoder)
-			{
-				WLog_Print(h264->log, WLOG_ERROR, "H264 VAAPI encoder not found");
-			}
-			else if (av_hwdevice_ctx_create(&sys->hwctx, AV_HWDEVICE_TYPE_VAAPI, VAAPI_DEVICE, NULL,
-			                                0) < 0)
+			if (h264->hwEncoder == H264_HW_ENCODER_AUTO)
 			{
-				WLog_Print(h264->log, WLOG_ERROR, "av_hwdevice_ctx_create failed");
-				sys->codecEncoder = NULL;
-				sys->hwctx = NULL;
+				if (!libavcodec_init_hw_encoder(h264, H264_HW_ENCODER_VAAPI))
+					(void)libavcodec_init_hw_encoder(h264, H264_HW_ENCODER_NVENC);
 			}
 			else
-			{
-				WLog_Print(h264->log, WLOG_INFO, "Using VAAPI for accelerated H264 encoding");
-			}
+				(void)libavcodec_init_hw_encoder(h264, (H264_HW_ENCODER)h264->hwEncoder);
 		}
 #endif
 		if (!sys->codecEncoder)
@@ -782,6 +1133,9 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 #if defined(WITH_VAAPI) || defined(WITH_VAAPI_H264_ENCODING)
 	sys->hwVideoFrame = av_frame_alloc();
 #endif
+#if defined(WITH_VAAPI_DMABUF)
+	sys->drmFrame = av_frame_alloc();
+#endif
 #else
 	sys->videoFrame = avcodec_alloc_frame();
 #endif
@@ -799,6 +1153,14 @@ static BOOL libavcodec_init(H264_CONTEXT* h264)
 		goto EXCEPTION;
 	}
 
+#endif
+#if defined(WITH_VAAPI_DMABUF)
+	if (!sys->drmFrame)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "Failed to allocate libav DRM frame");
+		goto EXCEPTION;
+	}
+
 #endif
 	sys->videoFrame->pts = 0;
 	return TRUE;
@@ -807,6 +1169,12 @@ EXCEPTION:
 	return FALSE;
 }
 
-const H264_CONTEXT_SUBSYSTEM g_Subsystem_libavcodec = { "libavcodec", libavcodec_init,
-	                                                    libavcodec_uninit, libavcodec_decompress,
-	                                                    libavcodec_compress };
+const H264_CONTEXT_SUBSYSTEM g_Subsystem_libavcodec = {
+	"libavcodec",        libavcodec_init,         libavcodec_uninit, libavcodec_decompress,
+	libavcodec_compress, libavcodec_compress_rgb,
+#if defined(WITH_VAAPI_DMABUF)
+	libavcodec_get_dmabuf
+#else
+	NULL
+#endif
+};
@@ -583,6 +583,8 @@ static BOOL openh264_init(H264_CONTEXT* h264)
 #if (OPENH264_MAJOR == 1) && (OPENH264_MINOR <= 5)
 			sDecParam.eOutputColorFormat = videoFormatI420;
 #endif
+			/* OpenH264 only threads whole frames, which delays the output, so it always
+			 * decodes on the calling thread and ignores H264_CONTEXT_OPTION_THREADS */
 			sDecParam.eEcActiveIdc = ERROR_CON_FRAME_COPY;
 			sDecParam.sVideoProperty.eVideoBsType = VIDEO_BITSTREAM_AVC;
 			status = (*sys->pDecoder)->Initialize(sys->pDecoder, &sDecParam);
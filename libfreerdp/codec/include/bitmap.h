@@ -174,7 +174,8 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, { DESTWRITEPIXEL(pbDest, BLACK_PIXEL); });
+				memset(pbDest, 0, 1ull * runLength * PIXEL_SIZE);
+				pbDest += 1ull * runLength * PIXEL_SIZE;
 			}
 			else
 			{
@@ -192,10 +193,7 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					DESTREADPIXEL(temp, pbDest - rowDelta);
-					DESTWRITEPIXEL(pbDest, temp);
-				});
+				pbDest = copy_previous_line(pbDest, rowDelta, 1ull * runLength * PIXEL_SIZE);
 			}
 
 			/* A follow-on background run order will need a foreground pel inserted. */
@@ -231,7 +229,11 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 
 				if (fFirstLine)
 				{
-					UNROLL(runLength, { DESTWRITEPIXEL(pbDest, fgPel); });
+					if (runLength > 0)
+					{
+						DESTWRITEPIXEL(pbDest, fgPel);
+						pbDest = repeat_pattern(pbDest, PIXEL_SIZE, runLength - 1);
+					}
 				}
 				else
 				{
@@ -260,10 +262,12 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength * 2))
 					return FALSE;
 
-				UNROLL(runLength, {
+				if (runLength > 0)
+				{
 					DESTWRITEPIXEL(pbDest, pixelA);
 					DESTWRITEPIXEL(pbDest, pixelB);
-				});
+					pbDest = repeat_pattern(pbDest, 2 * PIXEL_SIZE, runLength - 1);
+				}
 				break;
 
 			/* Handle Color Run Orders. */
@@ -280,7 +284,11 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbDest, pbDestEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, { DESTWRITEPIXEL(pbDest, pixelA); });
+				if (runLength > 0)
+				{
+					DESTWRITEPIXEL(pbDest, pixelA);
+					pbDest = repeat_pattern(pbDest, PIXEL_SIZE, runLength - 1);
+				}
 				break;
 
 			/* Handle Foreground/Background Image Orders. */
@@ -366,10 +374,10 @@ static inline BOOL RLEDECOMPRESS(const BYTE* WINPR_RESTRICT pbSrcBuffer, UINT32
 				if (!ENSURE_CAPACITY(pbSrc, pbEnd, runLength))
 					return FALSE;
 
-				UNROLL(runLength, {
-					SRCREADPIXEL(temp, pbSrc);
-					DESTWRITEPIXEL(pbDest, temp);
-				});
+				/* Source and destination pixels share the same little endian layout */
+				memcpy(pbDest, pbSrc, 1ull * runLength * PIXEL_SIZE);
+				pbDest += 1ull * runLength * PIXEL_SIZE;
+				pbSrc += 1ull * runLength * PIXEL_SIZE;
 				break;
 
 			/* Handle Special Order 1. */
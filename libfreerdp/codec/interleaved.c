@@ -28,6 +28,8 @@
 #include <freerdp/codec/interleaved.h>
 #include <freerdp/log.h>
 
+#include "bitmap_types.h"
+
 #define TAG FREERDP_TAG("codec")
 
 #define UNROLL_BODY(_exp, _count)             \
@@ -412,6 +414,41 @@ static INLINE void write_pixel_16(BYTE* _buf, UINT16 _pix)
 	_buf[1] = (_pix >> 8) & 0xFF;
 }
 
+/* Repeat the size bytes in front of _buf count times, doubling the copied block each round */
+static INLINE BYTE* repeat_pattern(BYTE* WINPR_RESTRICT _buf, size_t size, size_t count)
+{
+	WINPR_ASSERT(_buf);
+	const BYTE* pattern = _buf - size;
+	size_t available = size;
+	size_t remaining = size * count;
+
+	while (remaining > 0)
+	{
+		const size_t len = MIN(available, remaining);
+		memcpy(_buf, pattern, len);
+		_buf += len;
+		available += len;
+		remaining -= len;
+	}
+	return _buf;
+}
+
+/* Copy size bytes from the line above, in chunks that never overlap the bytes being written */
+static INLINE BYTE* copy_previous_line(BYTE* WINPR_RESTRICT _buf, size_t rowDelta, size_t size)
+{
+	WINPR_ASSERT(_buf);
+	WINPR_ASSERT(rowDelta > 0);
+
+	while (size > 0)
+	{
+		const size_t len = MIN(rowDelta, size);
+		memcpy(_buf, _buf - rowDelta, len);
+		_buf += len;
+		size -= len;
+	}
+	return _buf;
+}
+
 #undef DESTWRITEPIXEL
 #undef DESTREADPIXEL
 #undef SRCREADPIXEL
@@ -685,9 +722,20 @@ BOOL interleaved_compress(BITMAP_INTERLEAVED_CONTEXT* WINPR_RESTRICT interleaved
 			return FALSE;
 	}
 
-	if (!freerdp_image_copy_no_overlap(interleaved->TempBuffer, DstFormat, 0, 0, 0, nWidth, nHeight,
-	                                   pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc, palette,
-	                                   FREERDP_KEEP_DST_ALPHA))
+	/* The encoder reads its own formats in place, everything else is converted first */
+	const BYTE* pEncData = interleaved->TempBuffer;
+	UINT32 nEncStep = nWidth * FreeRDPGetBytesPerPixel(DstFormat);
+
+	if ((SrcFormat == DstFormat) ||
+	    ((DstFormat == PIXEL_FORMAT_BGRX32) && (SrcFormat == PIXEL_FORMAT_BGRA32)))
+	{
+		pEncData = &pSrcData[1ULL * nYSrc * nSrcStep +
+		                     1ULL * nXSrc * FreeRDPGetBytesPerPixel(SrcFormat)];
+		nEncStep = nSrcStep;
+	}
+	else if (!freerdp_image_copy_no_overlap(interleaved->TempBuffer, DstFormat, 0, 0, 0, nWidth,
+	                                        nHeight, pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc,
+	                                        palette, FREERDP_KEEP_DST_ALPHA))
 		return FALSE;
 
 	s = Stream_New(pDstData, *pDstSize);
@@ -697,8 +745,8 @@ BOOL interleaved_compress(BITMAP_INTERLEAVED_CONTEXT* WINPR_RESTRICT interleaved
 
 	Stream_SetPosition(interleaved->bts, 0);
 
-	if (freerdp_bitmap_compress(interleaved->TempBuffer, nWidth, nHeight, s, bpp, maxSize,
-	                            nHeight - 1, interleaved->bts, 0) < 0)
+	if (freerdp_bitmap_compress_ex(pEncData, nEncStep, nWidth, nHeight, s, bpp, maxSize,
+	                               nHeight - 1, interleaved->bts, 0) < 0)
 		status = FALSE;
 	else
 		status = TRUE;
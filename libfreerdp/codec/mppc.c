@@ -27,6 +27,7 @@
 
 #include <freerdp/log.h>
 #include "mppc.h"
+#include "bulk_match.h"
 
 #define TAG FREERDP_TAG("codec.mppc")
 
@@ -559,11 +560,29 @@ int mppc_compress(MPPC_CONTEXT* mppc, const BYTE* pSrcData, UINT32 SrcSize, BYTE
 			LengthOfMatch = 3;
 			MatchPtr += 2;
 
-			while ((*pSrcPtr == *MatchPtr) && (pSrcPtr < pSrcEnd) && (MatchPtr <= mppc->HistoryPtr))
 			{
-				MatchPtr++;
-				*HistoryPtr++ = *pSrcPtr++;
-				LengthOfMatch++;
+				/* Extend the match up to the end of the source and of the valid history */
+				size_t MaxLength = 0;
+
+				if (MatchPtr <= mppc->HistoryPtr)
+					MaxLength = MIN((size_t)(pSrcEnd - pSrcPtr),
+					                (size_t)(mppc->HistoryPtr - MatchPtr) + 1);
+
+				/* Bytes from HistoryPtr on are written by this copy and repeat the source */
+				size_t Length = MaxLength;
+
+				if ((MatchPtr < HistoryPtr) && ((size_t)(HistoryPtr - MatchPtr) < Length))
+					Length = (size_t)(HistoryPtr - MatchPtr);
+
+				size_t Matched = bulk_match_length(pSrcPtr, MatchPtr, Length);
+
+				if ((Matched == Length) && (Length < MaxLength))
+					Matched += bulk_match_length(&pSrcPtr[Length], pSrcPtr, MaxLength - Length);
+
+				memcpy(HistoryPtr, pSrcPtr, Matched);
+				HistoryPtr += Matched;
+				pSrcPtr += Matched;
+				LengthOfMatch += (DWORD)Matched;
 			}
 
 #if defined(DEBUG_MPPC)
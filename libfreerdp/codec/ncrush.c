@@ -31,6 +31,7 @@
 #include <freerdp/types.h>
 
 #include "ncrush.h"
+#include "bulk_match.h"
 
 #define TAG FREERDP_TAG("codec")
 
@@ -2344,24 +2345,17 @@ static int ncrush_hash_table_add(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, U
 
 static intptr_t ncrush_find_match_length(const BYTE* Ptr1, const BYTE* Ptr2, const BYTE* HistoryPtr)
 {
-	BYTE val1 = 0;
-	BYTE val2 = 0;
-	const BYTE* Ptr = Ptr1;
-
 	WINPR_ASSERT(Ptr1);
 	WINPR_ASSERT(Ptr2);
 	WINPR_ASSERT(HistoryPtr);
 
-	do
-	{
-		if (Ptr1 > HistoryPtr)
-			break;
-
-		val1 = *Ptr1++;
-		val2 = *Ptr2++;
-	} while (val1 == val2);
+	if (Ptr1 > HistoryPtr)
+		return -1;
 
-	return Ptr1 - (Ptr + 1);
+	/* The byte at HistoryPtr is compared but never counted */
+	const size_t MaxLength = (size_t)(HistoryPtr - Ptr1) + 1;
+	const size_t Length = bulk_match_length(Ptr1, Ptr2, MaxLength);
+	return (intptr_t)MIN(Length, MaxLength - 1);
 }
 
 static int ncrush_find_best_match(NCRUSH_CONTEXT* ncrush, UINT16 HistoryOffset,
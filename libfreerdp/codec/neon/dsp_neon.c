@@ -0,0 +1,103 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "dsp_neon.h"
+
+#include "../../core/simd.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static INT32 dsp_fir_q15_neon(const INT16* WINPR_RESTRICT samples,
+                              const INT16* WINPR_RESTRICT coeffs, size_t taps)
+{
+	int32x4_t sum = vdupq_n_s32(0);
+
+	WINPR_ASSERT((taps % 8) == 0);
+
+	for (size_t x = 0; x < taps; x += 8)
+	{
+		const int16x8_t s = vld1q_s16(&samples[x]);
+		const int16x8_t c = vld1q_s16(&coeffs[x]);
+		sum = vmlal_s16(sum, vget_low_s16(s), vget_low_s16(c));
+		sum = vmlal_s16(sum, vget_high_s16(s), vget_high_s16(c));
+	}
+
+	const int32x2_t pair = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+	return vget_lane_s32(vpadd_s32(pair, pair), 0);
+}
+
+static void dsp_mono_to_stereo16_neon(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                      size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		int16x8x2_t stereo;
+		stereo.val[0] = vreinterpretq_s16_u8(vld1q_u8(&src[2 * x]));
+		stereo.val[1] = stereo.val[0];
+		vst2q_s16((int16_t*)&dst[4 * x], stereo);
+	}
+
+	for (; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void dsp_stereo_to_mono16_neon(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                      size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		/* vhaddq computes (left + right) >> 1 without overflowing */
+		const int16x8x2_t stereo = vld2q_s16((const int16_t*)&src[4 * x]);
+		const int16x8_t mono = vhaddq_s16(stereo.val[0], stereo.val[1]);
+		vst1q_u8(&dst[2 * x], vreinterpretq_u8_s16(mono));
+	}
+
+	for (; x < frames; x++)
+	{
+		const INT32 left = (INT16)(src[4 * x] | (src[4 * x + 1] << 8));
+		const INT32 right = (INT16)(src[4 * x + 2] | (src[4 * x + 3] << 8));
+		const INT16 mono = (INT16)((left + right) >> 1);
+		dst[2 * x] = (BYTE)(mono & 0xFF);
+		dst[2 * x + 1] = (BYTE)((mono >> 8) & 0xFF);
+	}
+}
+#endif
+
+void dsp_init_neon_int(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+	kernels->fir_q15 = dsp_fir_q15_neon;
+	kernels->mono_to_stereo16 = dsp_mono_to_stereo16_neon;
+	kernels->stereo_to_mono16 = dsp_stereo_to_mono16_neon;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,189 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDP6 Planar Codec - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../planar_types.h"
+#include "planar_neon.h"
+
+#include "../../core/simd.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* NEON has no movemask, narrow the 0x00/0xFF compare result to 4 bits per byte instead */
+static inline UINT64 planar_neon_mask(uint8x16_t cmp)
+{
+	const uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(narrow), 0);
+}
+
+static inline size_t planar_neon_first(UINT64 mask)
+{
+	WINPR_ASSERT(mask != 0);
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward64(&index, mask);
+	return index / 4;
+#else
+	return (size_t)__builtin_ctzll(mask) / 4;
+#endif
+}
+
+static void planar_delta_encode_line_neon(const BYTE* WINPR_RESTRICT src,
+                                          const BYTE* WINPR_RESTRICT prev,
+                                          BYTE* WINPR_RESTRICT dst, UINT32 width)
+{
+	const int8x16_t zero = vdupq_n_s8(0);
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		/* 2 * delta for positive, -2 * delta - 1 for negative deltas, modulo 256 */
+		const uint8x16_t delta = vsubq_u8(vld1q_u8(&src[x]), vld1q_u8(&prev[x]));
+		const uint8x16_t sign = vcltq_s8(vreinterpretq_s8_u8(delta), zero);
+		vst1q_u8(&dst[x], veorq_u8(vaddq_u8(delta, delta), sign));
+	}
+
+	planar_delta_encode_line_generic(&src[x], &prev[x], &dst[x], width - x);
+}
+
+static size_t planar_rle_run_start_neon(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
+{
+	if (pos == 0)
+	{
+		if (size == 0)
+			return 0;
+
+		if (data[0] == 0)
+			return 0;
+
+		pos = 1;
+	}
+
+	for (; pos + 16 <= size; pos += 16)
+	{
+		const uint8x16_t cur = vld1q_u8(&data[pos]);
+		const uint8x16_t last = vld1q_u8(&data[pos - 1]);
+		const UINT64 mask = planar_neon_mask(vceqq_u8(cur, last));
+
+		if (mask)
+			return pos + planar_neon_first(mask);
+	}
+
+	return planar_rle_run_start_generic(data, pos, size);
+}
+
+static size_t planar_rle_run_end_neon(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
+{
+	WINPR_ASSERT(pos < size);
+	const uint8x16_t symbol = vdupq_n_u8(data[pos]);
+	size_t cur = pos + 1;
+
+	for (; cur + 16 <= size; cur += 16)
+	{
+		const uint8x16_t val = vld1q_u8(&data[cur]);
+		const UINT64 mask = ~planar_neon_mask(vceqq_u8(val, symbol));
+
+		if (mask)
+			return cur + planar_neon_first(mask);
+	}
+
+	/* The generic scan continues with the symbol found at cur - 1, which is the run symbol */
+	if (cur >= size)
+		return size;
+
+	return planar_rle_run_end_generic(data, cur - 1, size);
+}
+
+static void planar_delta_decode_line_neon(BYTE* WINPR_RESTRICT line,
+                                          const BYTE* WINPR_RESTRICT prev, UINT32 width)
+{
+	const uint8x16_t one = vdupq_n_u8(1);
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		/* delta = (encoded >> 1) ^ -(encoded & 1) */
+		const uint8x16_t encoded = vld1q_u8(&line[x]);
+		const uint8x16_t sign = vtstq_u8(encoded, one);
+		const uint8x16_t delta = veorq_u8(vshrq_n_u8(encoded, 1), sign);
+		vst1q_u8(&line[x], vaddq_u8(vld1q_u8(&prev[x]), delta));
+	}
+
+	planar_delta_decode_line_generic(&line[x], &prev[x], width - x);
+}
+
+static void planar_merge_planes_line_neon(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT b,
+                                          const BYTE* WINPR_RESTRICT g,
+                                          const BYTE* WINPR_RESTRICT r,
+                                          const BYTE* WINPR_RESTRICT a, UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		uint8x16x4_t px;
+		px.val[0] = vld1q_u8(&b[x]);
+		px.val[1] = vld1q_u8(&g[x]);
+		px.val[2] = vld1q_u8(&r[x]);
+		px.val[3] = a ? vld1q_u8(&a[x]) : vdupq_n_u8(0xFF);
+		vst4q_u8(dst, px);
+		dst += 64;
+	}
+
+	planar_merge_planes_line_generic(dst, &b[x], &g[x], &r[x], a ? &a[x] : NULL, width - x);
+}
+
+static void planar_subsample_expand_line_neon(BYTE* WINPR_RESTRICT dst,
+                                              const BYTE* WINPR_RESTRICT src, UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x + 32 <= width; x += 32)
+	{
+		const uint8x16_t val = vld1q_u8(&src[x / 2]);
+		uint8x16x2_t pair;
+		pair.val[0] = val;
+		pair.val[1] = val;
+		vst2q_u8(&dst[x], pair);
+	}
+
+	planar_subsample_expand_line_generic(&dst[x], &src[x / 2], width - x);
+}
+#endif
+
+void planar_init_neon_int(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	WINPR_ASSERT(planar);
+	planar->delta_encode_line = planar_delta_encode_line_neon;
+	planar->rle_run_start = planar_rle_run_start_neon;
+	planar->rle_run_end = planar_rle_run_end_neon;
+	planar->delta_decode_line = planar_delta_decode_line_neon;
+	planar->merge_planes_line = planar_merge_planes_line_neon;
+	planar->subsample_expand_line = planar_subsample_expand_line_neon;
+#else
+	WINPR_UNUSED(planar);
+#endif
+}
@@ -69,6 +69,47 @@ static void rfx_quantization_decode_NEON(INT16* buffer, const UINT32* WINPR_REST
 	rfx_quantization_decode_block_NEON(&buffer[4032], 64, quantVals[0] - 1);   /* LL3 */
 }
 
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_quantization_encode_block_NEON(INT16* buffer, const size_t buffer_size, const UINT32 factor)
+{
+	if (factor == 0)
+		return;
+
+	/* A rounding shift by a negative amount is (val + (1 << (factor - 1))) >> factor */
+	const int16x8_t shift = vdupq_n_s16(-(INT16)factor);
+	int16x8_t* buf = (int16x8_t*)buffer;
+	int16x8_t* buf_end = (int16x8_t*)(buffer + buffer_size);
+
+	do
+	{
+		int16x8_t val = vld1q_s16((INT16*)buf);
+		val = vrshlq_s16(val, shift);
+		vst1q_s16((INT16*)buf, val);
+		buf++;
+	} while (buf < buf_end);
+}
+
+static void rfx_quantization_encode_NEON(INT16* WINPR_RESTRICT buffer,
+                                         const UINT32* WINPR_RESTRICT quantVals)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(quantVals);
+
+	rfx_quantization_encode_block_NEON(&buffer[0], 1024, quantVals[8] - 6);    /* HL1 */
+	rfx_quantization_encode_block_NEON(&buffer[1024], 1024, quantVals[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_NEON(&buffer[2048], 1024, quantVals[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_NEON(&buffer[3072], 256, quantVals[5] - 6);  /* HL2 */
+	rfx_quantization_encode_block_NEON(&buffer[3328], 256, quantVals[4] - 6);  /* LH2 */
+	rfx_quantization_encode_block_NEON(&buffer[3584], 256, quantVals[6] - 6);  /* HH2 */
+	rfx_quantization_encode_block_NEON(&buffer[3840], 64, quantVals[2] - 6);   /* HL3 */
+	rfx_quantization_encode_block_NEON(&buffer[3904], 64, quantVals[1] - 6);   /* LH3 */
+	rfx_quantization_encode_block_NEON(&buffer[3968], 64, quantVals[3] - 6);   /* HH3 */
+	rfx_quantization_encode_block_NEON(&buffer[4032], 64, quantVals[0] - 6);   /* LL3 */
+
+	/* The coefficients are scaled by << 5 at RGB->YCbCr phase, so we round it back here */
+	rfx_quantization_encode_block_NEON(buffer, 4096, 5);
+}
+
 static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
 rfx_dwt_2d_decode_block_horiz_NEON(INT16* WINPR_RESTRICT l, INT16* WINPR_RESTRICT h,
                                    INT16* WINPR_RESTRICT dst, size_t subband_width)
@@ -530,7 +571,9 @@ void rfx_init_neon_int(RFX_CONTEXT* WINPR_RESTRICT context)
 	PROFILER_RENAME(context->priv->prof_rfx_ycbcr_to_rgb, "rfx_decode_YCbCr_to_RGB_NEON");
 	PROFILER_RENAME(context->priv->prof_rfx_quantization_decode, "rfx_quantization_decode_NEON");
 	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_decode, "rfx_dwt_2d_decode_NEON");
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode_NEON");
 	context->quantization_decode = rfx_quantization_decode_NEON;
+	context->quantization_encode = rfx_quantization_encode_NEON;
 	context->dwt_2d_decode = rfx_dwt_2d_decode_NEON;
 	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode_neon;
 #else
@@ -29,7 +29,9 @@
 #include <winpr/assert.h>
 #include <winpr/cast.h>
 #include <winpr/crt.h>
+#include <winpr/sysinfo.h>
 
+#include <freerdp/settings.h>
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
 
@@ -340,6 +342,7 @@ BOOL nsc_context_reset(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 width, UINT32
 
 NSC_CONTEXT* nsc_context_new(void)
 {
+	SYSTEM_INFO sysInfos = { 0 };
 	NSC_CONTEXT* context = (NSC_CONTEXT*)winpr_aligned_calloc(1, sizeof(NSC_CONTEXT), 32);
 
 	if (!context)
@@ -354,7 +357,12 @@ NSC_CONTEXT* nsc_context_new(void)
 	WLog_OpenAppender(context->priv->log);
 	context->BitmapData = NULL;
 	context->decode = nsc_decode;
-	context->encode = nsc_encode;
+	context->encode_aycocg = nsc_encode_argb_to_aycocg;
+	context->encode_subsampling = nsc_encode_subsampling;
+
+	GetNativeSystemInfo(&sysInfos);
+	context->priv->ThreadCount = sysInfos.dwNumberOfProcessors;
+	context->priv->UseThreads = (context->priv->ThreadCount > 1);
 
 	PROFILER_CREATE(context->priv->prof_nsc_rle_decompress_data, "nsc_rle_decompress_data")
 	PROFILER_CREATE(context->priv->prof_nsc_decode, "nsc_decode")
@@ -382,9 +390,18 @@ void nsc_context_free(NSC_CONTEXT* context)
 
 	if (context->priv)
 	{
+		if (context->priv->ThreadPool)
+		{
+			CloseThreadpool(context->priv->ThreadPool);
+			DestroyThreadpoolEnvironment(&context->priv->ThreadPoolEnv);
+		}
+
 		for (size_t i = 0; i < 5; i++)
 			winpr_aligned_free(context->priv->PlaneBuffers[i]);
 
+		for (size_t i = 0; i < ARRAYSIZE(context->priv->RleBuffers); i++)
+			winpr_aligned_free(context->priv->RleBuffers[i]);
+
 		nsc_profiler_print(context->priv);
 		PROFILER_FREE(context->priv->prof_nsc_rle_decompress_data)
 		PROFILER_FREE(context->priv->prof_nsc_decode)
@@ -424,6 +441,10 @@ BOOL nsc_context_set_parameters(NSC_CONTEXT* WINPR_RESTRICT context, NSC_PARAMET
 		case NSC_COLOR_FORMAT:
 			context->format = value;
 			break;
+		case NSC_THREADING_FLAGS:
+			context->priv->UseThreads = ((value & THREADING_FLAGS_DISABLE_THREADS) == 0) &&
+			                            (context->priv->ThreadCount > 1);
+			break;
 		default:
 			return FALSE;
 	}
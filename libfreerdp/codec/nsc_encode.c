@@ -56,10 +56,30 @@ typedef struct
 	UINT8 ChromaSubsamplingLevel;
 } NSC_MESSAGE;
 
+typedef struct
+{
+	NSC_CONTEXT* context;
+	const BYTE* data;
+	UINT32 scanline;
+	UINT32 y;
+	UINT32 height;
+	BOOL rc;
+} NSC_ENCODE_WORK_PARAM;
+
+typedef struct
+{
+	NSC_CONTEXT* context;
+	UINT32 plane;
+} NSC_RLE_WORK_PARAM;
+
+/* Bands smaller than this do not pay for the thread pool round trip */
+#define NSC_ENCODE_MIN_BAND_HEIGHT 32
+#define NSC_ENCODE_MAX_BANDS 64
+
 static BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
                               const NSC_MESSAGE* WINPR_RESTRICT message);
 
-static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
+static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context, BOOL threaded)
 {
 	UINT32 length = 0;
 	UINT32 tempWidth = 0;
@@ -85,6 +105,22 @@ static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
 		context->priv->PlaneBuffersLength = length;
 	}
 
+	if (threaded && (length > context->priv->RleBuffersLength))
+	{
+		for (size_t i = 0; i < ARRAYSIZE(context->priv->RleBuffers); i++)
+		{
+			BYTE* tmp = (BYTE*)winpr_aligned_recalloc(context->priv->RleBuffers[i], length,
+			                                          sizeof(BYTE), 32);
+
+			if (!tmp)
+				return FALSE;
+
+			context->priv->RleBuffers[i] = tmp;
+		}
+
+		context->priv->RleBuffersLength = length;
+	}
+
 	if (context->ChromaSubsamplingLevel)
 	{
 		context->OrgByteCount[0] = tempWidth * context->height;
@@ -112,10 +148,10 @@ fail:
 	return FALSE;
 }
 
-static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
-                                      const BYTE* WINPR_RESTRICT data, UINT32 scanline)
+BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
+                               const BYTE* WINPR_RESTRICT data, UINT32 scanline, UINT32 y,
+                               UINT32 height)
 {
-	size_t y = 0;
 	const BYTE* src = NULL;
 	BYTE* yplane = NULL;
 	BYTE* coplane = NULL;
@@ -129,14 +165,18 @@ static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
 	UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
 	const UINT16 rw = (context->ChromaSubsamplingLevel ? tempWidth : context->width);
 	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
+	const size_t last = 1ull * y + height;
+	size_t row = y;
 
-	for (; y < context->height; y++)
+	WINPR_ASSERT(last <= context->height);
+
+	for (; row < last; row++)
 	{
-		src = data + (context->height - 1 - y) * scanline;
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		aplane = context->priv->PlaneBuffers[3] + y * context->width;
+		src = data + (context->height - 1 - row) * scanline;
+		yplane = context->priv->PlaneBuffers[0] + row * rw;
+		coplane = context->priv->PlaneBuffers[1] + row * rw;
+		cgplane = context->priv->PlaneBuffers[2] + row * rw;
+		aplane = context->priv->PlaneBuffers[3] + row * context->width;
 
 		UINT16 x = 0;
 		for (; x < context->width; x++)
@@ -256,11 +296,12 @@ static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
 		}
 	}
 
-	if (context->ChromaSubsamplingLevel && (y % 2) == 1)
+	/* Only the band containing the last row pads an odd height */
+	if (context->ChromaSubsamplingLevel && (row == context->height) && (row % 2) == 1)
 	{
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
+		yplane = context->priv->PlaneBuffers[0] + row * rw;
+		coplane = context->priv->PlaneBuffers[1] + row * rw;
+		cgplane = context->priv->PlaneBuffers[2] + row * rw;
 		CopyMemory(yplane, yplane - rw, rw);
 		CopyMemory(coplane, coplane - rw, rw);
 		CopyMemory(cgplane, cgplane - rw, rw);
@@ -269,7 +310,7 @@ static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
 	return TRUE;
 }
 
-static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
+BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
 {
 	UINT32 tempWidth = 0;
 	UINT32 tempHeight = 0;
@@ -313,18 +354,108 @@ static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
 	return TRUE;
 }
 
-BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT bmpdata,
-                UINT32 rowstride)
+static void CALLBACK nsc_encode_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                              void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	NSC_ENCODE_WORK_PARAM* param = (NSC_ENCODE_WORK_PARAM*)context;
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(param->context);
+	param->rc = param->context->encode_aycocg(param->context, param->data, param->scanline,
+	                                          param->y, param->height);
+}
+
+static BOOL nsc_encode_use_threads(NSC_CONTEXT* WINPR_RESTRICT context)
 {
+	NSC_CONTEXT_PRIV* priv = context->priv;
+
+	if (!priv->UseThreads || (context->height < 2 * NSC_ENCODE_MIN_BAND_HEIGHT))
+		return FALSE;
+
+	/* Created on demand, most contexts only ever decode or encode small bitmaps */
+	if (!priv->ThreadPool)
+	{
+		priv->ThreadPool = CreateThreadpool(NULL);
+
+		if (!priv->ThreadPool)
+		{
+			WLog_Print(priv->log, WLOG_WARN,
+			           "Failed to create thread pool, falling back to single threaded encoding");
+			priv->UseThreads = FALSE;
+			return FALSE;
+		}
+
+		InitializeThreadpoolEnvironment(&priv->ThreadPoolEnv);
+		SetThreadpoolCallbackPool(&priv->ThreadPoolEnv, priv->ThreadPool);
+	}
+
+	return TRUE;
+}
+
+static BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT bmpdata,
+                       UINT32 rowstride, BOOL threaded)
+{
+	BOOL rc = TRUE;
+
 	if (!context || !bmpdata || (rowstride == 0))
 		return FALSE;
 
-	if (!nsc_encode_argb_to_aycocg(context, bmpdata, rowstride))
+	WINPR_ASSERT(context->encode_aycocg);
+	WINPR_ASSERT(context->encode_subsampling);
+
+	if (!threaded)
+		rc = context->encode_aycocg(context, bmpdata, rowstride, 0, context->height);
+	else
+	{
+		PTP_WORK work[NSC_ENCODE_MAX_BANDS] = { 0 };
+		NSC_ENCODE_WORK_PARAM params[NSC_ENCODE_MAX_BANDS] = { 0 };
+		UINT32 bands = MIN(context->priv->ThreadCount, NSC_ENCODE_MAX_BANDS);
+		bands = MIN(bands, context->height / NSC_ENCODE_MIN_BAND_HEIGHT);
+		WINPR_ASSERT(bands > 0);
+		const UINT32 bandHeight = (context->height + bands - 1) / bands;
+
+		for (UINT32 i = 0; i < bands; i++)
+		{
+			NSC_ENCODE_WORK_PARAM* param = &params[i];
+			param->context = context;
+			param->data = bmpdata;
+			param->scanline = rowstride;
+			param->y = i * bandHeight;
+			if (param->y >= context->height)
+			{
+				param->rc = TRUE;
+				continue;
+			}
+			param->height = MIN(bandHeight, context->height - param->y);
+
+			work[i] = CreateThreadpoolWork(nsc_encode_work_callback, param,
+			                               &context->priv->ThreadPoolEnv);
+
+			if (work[i])
+				SubmitThreadpoolWork(work[i]);
+			else
+				nsc_encode_work_callback(NULL, param, NULL);
+		}
+
+		for (UINT32 i = 0; i < bands; i++)
+		{
+			if (work[i])
+			{
+				WaitForThreadpoolWorkCallbacks(work[i], FALSE);
+				CloseThreadpoolWork(work[i]);
+			}
+
+			if (!params[i].rc)
+				rc = FALSE;
+		}
+	}
+
+	if (!rc)
 		return FALSE;
 
+	/* Subsampling works in place across band borders, so it runs once for the whole frame */
 	if (context->ChromaSubsamplingLevel)
 	{
-		if (!nsc_encode_subsampling(context))
+		if (!context->encode_subsampling(context))
 			return FALSE;
 	}
 
@@ -387,32 +518,71 @@ static UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT
 	return planeSize;
 }
 
-static void nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context)
+static void nsc_rle_compress_plane(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 plane,
+                                   BYTE* WINPR_RESTRICT scratch)
 {
 	UINT32 planeSize = 0;
-	UINT32 originalSize = 0;
+	const UINT32 originalSize = context->OrgByteCount[plane];
 
-	for (UINT16 i = 0; i < 4; i++)
+	if (originalSize > 0)
 	{
-		originalSize = context->OrgByteCount[i];
+		planeSize = nsc_rle_encode(context->priv->PlaneBuffers[plane], scratch, originalSize);
 
-		if (originalSize == 0)
-		{
-			planeSize = 0;
-		}
+		if (planeSize < originalSize)
+			CopyMemory(context->priv->PlaneBuffers[plane], scratch, planeSize);
 		else
-		{
-			planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i],
-			                           context->priv->PlaneBuffers[4], originalSize);
+			planeSize = originalSize;
+	}
 
-			if (planeSize < originalSize)
-				CopyMemory(context->priv->PlaneBuffers[i], context->priv->PlaneBuffers[4],
-				           planeSize);
-			else
-				planeSize = originalSize;
-		}
+	context->PlaneByteCount[plane] = planeSize;
+}
 
-		context->PlaneByteCount[i] = planeSize;
+static void CALLBACK
+nsc_rle_compress_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance, void* context,
+                               WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	NSC_RLE_WORK_PARAM* param = (NSC_RLE_WORK_PARAM*)context;
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(param->plane > 0);
+	nsc_rle_compress_plane(param->context, param->plane,
+	                       param->context->priv->RleBuffers[param->plane - 1]);
+}
+
+static void nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context, BOOL threaded)
+{
+	if (!threaded)
+	{
+		for (UINT32 i = 0; i < 4; i++)
+			nsc_rle_compress_plane(context, i, context->priv->PlaneBuffers[4]);
+		return;
+	}
+
+	/* The planes are independent, compress chroma and alpha on the pool and luma here */
+	PTP_WORK work[3] = { 0 };
+	NSC_RLE_WORK_PARAM params[3] = { 0 };
+
+	for (UINT32 i = 0; i < ARRAYSIZE(work); i++)
+	{
+		params[i].context = context;
+		params[i].plane = i + 1;
+		work[i] = CreateThreadpoolWork(nsc_rle_compress_work_callback, &params[i],
+		                               &context->priv->ThreadPoolEnv);
+
+		if (work[i])
+			SubmitThreadpoolWork(work[i]);
+		else
+			nsc_rle_compress_plane(context, i + 1, context->priv->RleBuffers[i]);
+	}
+
+	nsc_rle_compress_plane(context, 0, context->priv->PlaneBuffers[4]);
+
+	for (UINT32 i = 0; i < ARRAYSIZE(work); i++)
+	{
+		if (!work[i])
+			continue;
+
+		WaitForThreadpoolWorkCallbacks(work[i], FALSE);
+		CloseThreadpoolWork(work[i]);
 	}
 }
 
@@ -466,19 +636,21 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 	context->width = WINPR_ASSERTING_INT_CAST(UINT16, width);
 	context->height = WINPR_ASSERTING_INT_CAST(UINT16, height);
 
-	if (!nsc_context_initialize_encode(context))
+	const BOOL threaded = nsc_encode_use_threads(context);
+
+	if (!nsc_context_initialize_encode(context, threaded))
 		return FALSE;
 
 	/* ARGB to AYCoCg conversion, chroma subsampling and colorloss reduction */
 	PROFILER_ENTER(context->priv->prof_nsc_encode)
-	rc = context->encode(context, data, scanline);
+	rc = nsc_encode(context, data, scanline, threaded);
 	PROFILER_EXIT(context->priv->prof_nsc_encode)
 	if (!rc)
 		return FALSE;
 
 	/* RLE encode */
 	PROFILER_ENTER(context->priv->prof_nsc_rle_compress_data)
-	nsc_rle_compress_data(context);
+	nsc_rle_compress_data(context, threaded);
 	PROFILER_EXIT(context->priv->prof_nsc_rle_compress_data)
 	message.PlaneBuffers[0] = context->priv->PlaneBuffers[0];
 	message.PlaneBuffers[1] = context->priv->PlaneBuffers[1];
@@ -24,7 +24,9 @@
 
 #include <freerdp/api.h>
 
-FREERDP_LOCAL BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context,
-                              const BYTE* WINPR_RESTRICT bmpdata, UINT32 rowstride);
+FREERDP_LOCAL BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
+                                             const BYTE* WINPR_RESTRICT data, UINT32 scanline,
+                                             UINT32 y, UINT32 height);
+FREERDP_LOCAL BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context);
 
 #endif /* FREERDP_LIB_CODEC_NSC_ENCODE_H */
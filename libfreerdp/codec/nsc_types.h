@@ -27,6 +27,7 @@
 #include <winpr/cast.h>
 #include <winpr/crt.h>
 #include <winpr/wlog.h>
+#include <winpr/pool.h>
 #include <winpr/collections.h>
 
 #include <freerdp/utils/profiler.h>
@@ -45,6 +46,14 @@ typedef struct
 	BYTE* PlaneBuffers[5];     /* Decompressed Plane Buffers in the respective order */
 	UINT32 PlaneBuffersLength; /* Lengths of each plane buffer */
 
+	/* Encoder threading, the pool is created on first use */
+	BOOL UseThreads;
+	UINT32 ThreadCount;
+	PTP_POOL ThreadPool;
+	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+	BYTE* RleBuffers[3];     /* RLE scratch for planes 1-3, plane 0 uses PlaneBuffers[4] */
+	UINT32 RleBuffersLength; /* Lengths of each RLE scratch buffer */
+
 	/* profilers */
 	PROFILER_DEFINE(prof_nsc_rle_decompress_data)
 	PROFILER_DEFINE(prof_nsc_decode)
@@ -72,8 +81,11 @@ struct S_NSC_CONTEXT
 	const BYTE* palette;
 
 	BOOL (*decode)(NSC_CONTEXT* WINPR_RESTRICT context);
-	BOOL(*encode)
-	(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT BitmapData, UINT32 rowstride);
+	/* Convert rows [y, y + height) to AYCoCg, must not touch rows of other bands */
+	BOOL (*encode_aycocg)(NSC_CONTEXT* WINPR_RESTRICT context,
+	                      const BYTE* WINPR_RESTRICT BitmapData, UINT32 rowstride, UINT32 y,
+	                      UINT32 height);
+	BOOL (*encode_subsampling)(NSC_CONTEXT* WINPR_RESTRICT context);
 
 	NSC_CONTEXT_PRIV* priv;
 };
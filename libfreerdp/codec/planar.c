@@ -26,14 +26,23 @@
 #include <winpr/assert.h>
 #include <winpr/cast.h>
 #include <winpr/print.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/primitives.h>
 #include <freerdp/log.h>
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
+#include "planar_types.h"
+#include "sse/planar_sse2.h"
+#include "neon/planar_neon.h"
+
 #define TAG FREERDP_TAG("codec")
 
+/* Planes of at least this many pixels are decoded in parallel */
+#define PLANAR_PARALLEL_THRESHOLD (256u * 256u)
+
 #define PLANAR_ALIGN(val, align) \
 	((val) % (align) == 0) ? (val) : ((val) + (align) - (val) % (align))
 
@@ -67,34 +76,21 @@ typedef struct
 	BYTE formatHeader;
 } RDP6_BITMAP_STREAM;
 
-struct S_BITMAP_PLANAR_CONTEXT
+typedef struct
 {
-	UINT32 maxWidth;
-	UINT32 maxHeight;
-	UINT32 maxPlaneSize;
-
-	BOOL AllowSkipAlpha;
-	BOOL AllowRunLengthEncoding;
-	BOOL AllowColorSubsampling;
-	BOOL AllowDynamicColorFidelity;
-
-	UINT32 ColorLossLevel;
-
-	BYTE* planes[4];
-	BYTE* planesBuffer;
-
-	BYTE* deltaPlanes[4];
-	BYTE* deltaPlanesBuffer;
-
-	BYTE* rlePlanes[4];
-	BYTE* rlePlanesBuffer;
-
-	BYTE* pTempData;
-	UINT32 nTempStep;
-
-	BOOL bgr;
-	BOOL topdown;
-};
+	const BITMAP_PLANAR_CONTEXT* planar;
+	const BYTE* pSrcData;
+	UINT32 SrcSize;
+	BYTE* pDstData;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	INT32 status;
+} PLANAR_DECODE_WORK_PARAM;
+
+/* A private pool, WaitForThreadpoolWorkCallbacks waits for all work of a pool */
+static INIT_ONCE planar_decode_once = INIT_ONCE_STATIC_INIT;
+static PTP_POOL planar_decode_pool = NULL;
+static TP_CALLBACK_ENVIRON planar_decode_env = { 0 };
 
 static INLINE UINT32 planar_invert_format(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar, BOOL alpha,
                                           UINT32 DstFormat)
@@ -159,14 +155,6 @@ static INLINE UINT32 planar_invert_format(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT
 	return DstFormat;
 }
 
-static INLINE BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane,
-                                                            UINT32 width, UINT32 height,
-                                                            BYTE* WINPR_RESTRICT outPlane,
-                                                            UINT32* WINPR_RESTRICT dstSize);
-static INLINE BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlane,
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlane);
-
 static INLINE INT32 planar_skip_plane_rle(const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
                                           UINT32 nWidth, UINT32 nHeight)
 {
@@ -232,33 +220,33 @@ static inline UINT8 clamp(INT16 val)
 	return (UINT8)val;
 }
 
-static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT pSrcData,
-                                                     UINT32 SrcSize, BYTE* WINPR_RESTRICT pDstData,
-                                                     UINT32 nWidth, UINT32 nHeight)
+/* Decodes one plane into nWidth * nHeight contiguous bytes, first the raw and repeated values of
+ * a scanline are copied as they are, then all but the first scanline are delta decoded */
+static INT32 planar_decode_plane_rle(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                     const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                     BYTE* WINPR_RESTRICT pDstData, UINT32 nWidth, UINT32 nHeight)
 {
-	BYTE* previousScanline = NULL;
-	const BYTE* srcp = pSrcData;
+	size_t used = 0;
 
+	WINPR_ASSERT(planar);
+	WINPR_ASSERT(planar->delta_decode_line);
 	WINPR_ASSERT(nHeight <= INT32_MAX);
 	WINPR_ASSERT(nWidth <= INT32_MAX);
 
 	for (UINT32 y = 0; y < nHeight; y++)
 	{
-		BYTE* dstp = &pDstData[1ULL * (y)*nWidth];
-		INT16 pixel = 0;
-		BYTE* currentScanline = dstp;
+		BYTE* line = &pDstData[1ULL * y * nWidth];
+		BYTE value = 0;
 
 		for (UINT32 x = 0; x < nWidth;)
 		{
-			BYTE controlByte = *srcp;
-			srcp++;
-
-			if ((srcp - pSrcData) > SrcSize * 1ll)
+			if (used >= SrcSize)
 			{
 				WLog_ERR(TAG, "error reading input buffer");
 				return -1;
 			}
 
+			const BYTE controlByte = pSrcData[used++];
 			UINT32 nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
 			UINT32 cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
 
@@ -273,77 +261,114 @@ static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT
 				cRawBytes = 0;
 			}
 
-			if (((dstp + (cRawBytes + nRunLength)) - currentScanline) > nWidth * 1ll)
+			if (1ULL * x + cRawBytes + nRunLength > nWidth)
 			{
 				WLog_ERR(TAG, "too many pixels in scanline");
 				return -1;
 			}
 
-			if (!previousScanline)
+			if (used + cRawBytes > SrcSize)
 			{
-				/* first scanline, absolute values */
-				while (cRawBytes > 0)
-				{
-					pixel = *srcp;
-					srcp++;
-					*dstp = clamp(pixel);
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
-
-				while (nRunLength > 0)
-				{
-					*dstp = clamp(pixel);
-					dstp++;
-					x++;
-					nRunLength--;
-				}
+				WLog_ERR(TAG, "error reading input buffer");
+				return -1;
 			}
-			else
+
+			if (cRawBytes > 0)
 			{
-				/* delta values relative to previous scanline */
-				while (cRawBytes > 0)
-				{
-					UINT8 deltaValue = *srcp;
-					srcp++;
+				memcpy(&line[x], &pSrcData[used], cRawBytes);
+				used += cRawBytes;
+				x += cRawBytes;
+				value = line[x - 1];
+			}
 
-					if (deltaValue & 1)
-					{
-						deltaValue = deltaValue >> 1;
-						deltaValue = deltaValue + 1;
-						pixel = WINPR_ASSERTING_INT_CAST(int16_t, -1 * (int16_t)deltaValue);
-					}
-					else
-					{
-						deltaValue = deltaValue >> 1;
-						pixel = WINPR_ASSERTING_INT_CAST(INT16, deltaValue);
-					}
+			/* A run repeats the last raw byte, an absolute value or a delta alike */
+			memset(&line[x], value, nRunLength);
+			x += nRunLength;
+		}
 
-					const INT16 delta =
-					    WINPR_ASSERTING_INT_CAST(int16_t, previousScanline[x] + pixel);
-					*dstp = clamp(delta);
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
+		if (y > 0)
+			planar->delta_decode_line(line, &line[-(intptr_t)nWidth], nWidth);
+	}
 
-				while (nRunLength > 0)
-				{
-					const INT16 deltaValue =
-					    WINPR_ASSERTING_INT_CAST(int16_t, previousScanline[x] + pixel);
-					*dstp = clamp(deltaValue);
-					dstp++;
-					x++;
-					nRunLength--;
-				}
-			}
+	WINPR_ASSERT(used <= INT32_MAX);
+	return (INT32)used;
+}
+
+static void CALLBACK planar_decode_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                                 void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	PLANAR_DECODE_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
+	param->status = planar_decode_plane_rle(param->planar, param->pSrcData, param->SrcSize,
+	                                        param->pDstData, param->nWidth, param->nHeight);
+}
+
+static BOOL CALLBACK planar_decode_pool_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                             WINPR_ATTR_UNUSED PVOID param,
+                                             WINPR_ATTR_UNUSED PVOID* context)
+{
+	SYSTEM_INFO sysInfos = { 0 };
+
+	/* Without a pool every plane is decoded inline, so failure here is not fatal */
+	GetNativeSystemInfo(&sysInfos);
+	if (sysInfos.dwNumberOfProcessors <= 1)
+		return TRUE;
+
+	planar_decode_pool = CreateThreadpool(NULL);
+	if (!planar_decode_pool)
+	{
+		WLog_WARN(TAG, "CreateThreadpool failed, decoding planes single threaded");
+		return TRUE;
+	}
+
+	InitializeThreadpoolEnvironment(&planar_decode_env);
+	SetThreadpoolCallbackPool(&planar_decode_env, planar_decode_pool);
+	return TRUE;
+}
+
+/* Decodes the planes of params, the first one by the calling thread and the others in the
+ * planar decode pool if the planes are large enough */
+static BOOL planar_decode_planes_rle(PLANAR_DECODE_WORK_PARAM* WINPR_RESTRICT params, size_t count)
+{
+	PTP_WORK work[4] = { 0 };
+	BOOL parallel = FALSE;
+
+	WINPR_ASSERT(params);
+	WINPR_ASSERT(count <= ARRAYSIZE(work));
+
+	if ((count > 1) && (1ull * params[0].nWidth * params[0].nHeight >= PLANAR_PARALLEL_THRESHOLD))
+	{
+		InitOnceExecuteOnce(&planar_decode_once, planar_decode_pool_init, NULL, NULL);
+		parallel = planar_decode_pool != NULL;
+	}
+
+	for (size_t x = 1; x < count; x++)
+	{
+		if (parallel)
+			work[x] = CreateThreadpoolWork(planar_decode_work_callback, &params[x],
+			                               &planar_decode_env);
+		if (work[x])
+			SubmitThreadpoolWork(work[x]);
+	}
+
+	BOOL rc = TRUE;
+	for (size_t x = 0; x < count; x++)
+	{
+		PLANAR_DECODE_WORK_PARAM* param = &params[x];
+
+		if (work[x])
+		{
+			WaitForThreadpoolWorkCallbacks(work[x], FALSE);
+			CloseThreadpoolWork(work[x]);
 		}
+		else
+			planar_decode_work_callback(NULL, param, NULL);
 
-		previousScanline = currentScanline;
+		if (param->status < 0)
+			rc = FALSE;
 	}
 
-	return (INT32)(srcp - pSrcData);
+	return rc;
 }
 
 static INLINE INT32 planar_decompress_plane_rle(const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
@@ -521,10 +546,43 @@ static INLINE INT32 planar_set_plane(BYTE bValue, BYTE* pDstData, UINT32 nDstSte
 	return 0;
 }
 
-static INLINE BOOL writeLine(BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UINT32 width,
+void planar_delta_decode_line_generic(BYTE* WINPR_RESTRICT line, const BYTE* WINPR_RESTRICT prev,
+                                      UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x++)
+	{
+		/* Inverse of the sign and magnitude encoding, odd values are negative deltas */
+		const BYTE delta = (BYTE)((line[x] >> 1) ^ (BYTE)(0 - (line[x] & 1)));
+		line[x] = (BYTE)(prev[x] + delta);
+	}
+}
+
+void planar_merge_planes_line_generic(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT b,
+                                      const BYTE* WINPR_RESTRICT g, const BYTE* WINPR_RESTRICT r,
+                                      const BYTE* WINPR_RESTRICT a, UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x++)
+	{
+		*dst++ = b[x];
+		*dst++ = g[x];
+		*dst++ = r[x];
+		*dst++ = a ? a[x] : 0xFF;
+	}
+}
+
+void planar_subsample_expand_line_generic(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src,
+                                          UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x++)
+		dst[x] = src[x / 2];
+}
+
+static INLINE BOOL writeLine(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                             BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UINT32 width,
                              const BYTE** WINPR_RESTRICT ppR, const BYTE** WINPR_RESTRICT ppG,
                              const BYTE** WINPR_RESTRICT ppB, const BYTE** WINPR_RESTRICT ppA)
 {
+	WINPR_ASSERT(planar);
 	WINPR_ASSERT(ppRgba);
 	WINPR_ASSERT(ppR);
 	WINPR_ASSERT(ppG);
@@ -533,25 +591,21 @@ static INLINE BOOL writeLine(BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UIN
 	switch (DstFormat)
 	{
 		case PIXEL_FORMAT_BGRA32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = *(*ppA)++;
-			}
-
+			WINPR_ASSERT(ppA);
+			planar->merge_planes_line(*ppRgba, *ppB, *ppG, *ppR, *ppA, width);
+			*ppRgba += 4ull * width;
+			*ppB += width;
+			*ppG += width;
+			*ppR += width;
+			*ppA += width;
 			return TRUE;
 
 		case PIXEL_FORMAT_BGRX32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = 0xFF;
-			}
-
+			planar->merge_planes_line(*ppRgba, *ppB, *ppG, *ppR, NULL, width);
+			*ppRgba += 4ull * width;
+			*ppB += width;
+			*ppG += width;
+			*ppR += width;
 			return TRUE;
 
 		default:
@@ -583,11 +637,11 @@ static INLINE BOOL writeLine(BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UIN
 	}
 }
 
-static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcData[4],
-                                                BYTE* WINPR_RESTRICT pDstData, UINT32 DstFormat,
-                                                UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
-                                                UINT32 nWidth, UINT32 nHeight, BOOL vFlip,
-                                                UINT32 totalHeight)
+static INLINE BOOL
+planar_decompress_planes_raw(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                             const BYTE* WINPR_RESTRICT pSrcData[4], BYTE* WINPR_RESTRICT pDstData,
+                             UINT32 DstFormat, UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
+                             UINT32 nWidth, UINT32 nHeight, BOOL vFlip, UINT32 totalHeight)
 {
 	INT32 beg = 0;
 	INT32 end = 0;
@@ -643,20 +697,21 @@ static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcD
 		const intptr_t off = ((1LL * nYDst + y) * nDstStep) + (1LL * nXDst * bpp);
 		pRGB = &pDstData[off];
 
-		if (!writeLine(&pRGB, DstFormat, nWidth, &pR, &pG, &pB, &pA))
+		if (!writeLine(planar, &pRGB, DstFormat, nWidth, &pR, &pG, &pB, &pA))
 			return FALSE;
 	}
 
 	return TRUE;
 }
 
-static BOOL planar_subsample_expand(const BYTE* WINPR_RESTRICT plane, size_t planeLength,
+static BOOL planar_subsample_expand(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                    const BYTE* WINPR_RESTRICT plane, size_t planeLength,
                                     UINT32 nWidth, UINT32 nHeight, UINT32 nPlaneWidth,
                                     UINT32 nPlaneHeight, BYTE* WINPR_RESTRICT deltaPlane)
 {
-	size_t pos = 0;
 	WINPR_UNUSED(planeLength);
 
+	WINPR_ASSERT(planar);
 	WINPR_ASSERT(plane);
 	WINPR_ASSERT(deltaPlane);
 
@@ -676,12 +731,13 @@ static BOOL planar_subsample_expand(const BYTE* WINPR_RESTRICT plane, size_t pla
 
 	for (size_t y = 0; y < nHeight; y++)
 	{
-		const BYTE* src = plane + y / 2 * nPlaneWidth;
+		BYTE* dst = &deltaPlane[y * nWidth];
 
-		for (UINT32 x = 0; x < nWidth; x++)
-		{
-			deltaPlane[pos++] = src[x / 2];
-		}
+		/* Both lines of a pair expand the same subsampled line */
+		if (y % 2)
+			memcpy(dst, &dst[-(intptr_t)nWidth], nWidth);
+		else
+			planar->subsample_expand_line(dst, &plane[y / 2 * nPlaneWidth], nWidth);
 	}
 
 	return TRUE;
@@ -914,8 +970,9 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 
 		if (!rle) /* RAW */
 		{
-			if (!planar_decompress_planes_raw(planes, pTempData, TempFormat, nTempStep, nXDst,
-			                                  nYDst, nSrcWidth, nSrcHeight, vFlip, nTotalHeight))
+			if (!planar_decompress_planes_raw(planar, planes, pTempData, TempFormat, nTempStep,
+			                                  nXDst, nYDst, nSrcWidth, nSrcHeight, vFlip,
+			                                  nTotalHeight))
 				return FALSE;
 
 			if (alpha)
@@ -926,7 +983,42 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 			if ((SrcSize - (srcp - pSrcData)) == 1)
 				srcp++; /* pad */
 		}
-		else /* RLE */
+		else if ((planeSize <= planar->maxPlaneSize) && planar->rlePlanesBuffer) /* RLE */
+		{
+			PLANAR_DECODE_WORK_PARAM params[4] = { 0 };
+			const BYTE* rlePlanes[4] = { 0 };
+			const size_t count = useAlpha ? 4 : 3;
+
+			/* Decode the planes contiguously, then merge them like raw planes. The planes are
+			 * written in B G R A byte order whatever the (possibly inverted) temp format is. */
+			for (size_t x = 0; x < count; x++)
+			{
+				BYTE* plane = &planar->rlePlanesBuffer[1ull * x * planeSize];
+
+				params[x].planar = planar;
+				params[x].pSrcData = planes[x];
+				params[x].SrcSize = WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[x]);
+				params[x].pDstData = plane;
+				params[x].nWidth = nSrcWidth;
+				params[x].nHeight = nSrcHeight;
+				rlePlanes[x] = plane;
+			}
+
+			if (!planar_decode_planes_rle(params, count))
+				return FALSE;
+
+			if (!planar_decompress_planes_raw(
+			        planar, rlePlanes, pTempData,
+			        useAlpha ? PIXEL_FORMAT_BGRA32 : PIXEL_FORMAT_BGRX32, nTempStep, nXDst,
+			        nYDst, nSrcWidth, nSrcHeight, vFlip, nTotalHeight))
+				return FALSE;
+
+			srcp += rleSizes[0] + rleSizes[1] + rleSizes[2];
+
+			if (alpha)
+				srcp += rleSizes[3];
+		}
+		else /* RLE, planes larger than the context, decoded in place */
 		{
 			status = planar_decompress_plane_rle(
 			    planes[0], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[0]), pTempData, nTempStep,
@@ -997,48 +1089,45 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 
 		if (rle) /* RLE encoded data. Decode and handle it like raw data. */
 		{
+			PLANAR_DECODE_WORK_PARAM params[4] = { 0 };
 			BYTE* rleBuffer[4] = { 0 };
+			size_t count = 0;
 
 			if (!planar->rlePlanesBuffer)
 				return FALSE;
 
+			if (planeSize > planar->maxPlaneSize)
+			{
+				WLog_ERR(TAG, "planar plane size %" PRIu32 " exceeds maximum %" PRIu32, planeSize,
+				         planar->maxPlaneSize);
+				return FALSE;
+			}
+
 			rleBuffer[3] = planar->rlePlanesBuffer;  /* AlphaPlane */
 			rleBuffer[0] = rleBuffer[3] + planeSize; /* LumaOrRedPlane */
 			rleBuffer[1] = rleBuffer[0] + planeSize; /* OrangeChromaOrGreenPlane */
 			rleBuffer[2] = rleBuffer[1] + planeSize; /* GreenChromaOrBluePlane */
-			if (useAlpha)
-			{
-				status = planar_decompress_plane_rle_only(
-				    planes[3], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[3]), rleBuffer[3],
-				    rawWidths[3], rawHeights[3]); /* AlphaPlane */
 
-				if (status < 0)
-					return FALSE;
+			/* The luma plane first, it is the largest and is decoded by the calling thread */
+			for (size_t x = 0; x < 4; x++)
+			{
+				if ((x == 3) && !useAlpha)
+					continue;
+
+				params[count].planar = planar;
+				params[count].pSrcData = planes[x];
+				params[count].SrcSize = WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[x]);
+				params[count].pDstData = rleBuffer[x];
+				params[count].nWidth = rawWidths[x];
+				params[count].nHeight = rawHeights[x];
+				count++;
 			}
 
-			if (alpha)
-				srcp += rleSizes[3];
-
-			status = planar_decompress_plane_rle_only(
-			    planes[0], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[0]), rleBuffer[0],
-			    rawWidths[0], rawHeights[0]); /* LumaPlane */
-
-			if (status < 0)
+			if (!planar_decode_planes_rle(params, count))
 				return FALSE;
 
-			status = planar_decompress_plane_rle_only(
-			    planes[1], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[1]), rleBuffer[1],
-			    rawWidths[1], rawHeights[1]); /* OrangeChromaPlane */
-
-			if (status < 0)
-				return FALSE;
-
-			status = planar_decompress_plane_rle_only(
-			    planes[2], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[2]), rleBuffer[2],
-			    rawWidths[2], rawHeights[2]); /* GreenChromaPlane */
-
-			if (status < 0)
-				return FALSE;
+			if (alpha)
+				srcp += rleSizes[3];
 
 			planes[0] = rleBuffer[0];
 			planes[1] = rleBuffer[1];
@@ -1052,7 +1141,7 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 			{ /* Chroma subsampling for Co and Cg:
 			   * Each pixel contains the value that should be expanded to
 			   * [2x,2y;2x+1,2y;2x+1,2y+1;2x;2y+1] */
-				if (!planar_subsample_expand(planes[1], rawSizes[1], nSrcWidth, nSrcHeight,
+				if (!planar_subsample_expand(planar, planes[1], rawSizes[1], nSrcWidth, nSrcHeight,
 				                             rawWidths[1], rawHeights[1], planar->deltaPlanes[0]))
 					return FALSE;
 
@@ -1061,7 +1150,7 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 				rawWidths[1] = nSrcWidth;
 				rawHeights[1] = nSrcHeight;
 
-				if (!planar_subsample_expand(planes[2], rawSizes[2], nSrcWidth, nSrcHeight,
+				if (!planar_subsample_expand(planar, planes[2], rawSizes[2], nSrcWidth, nSrcHeight,
 				                             rawWidths[2], rawHeights[2], planar->deltaPlanes[1]))
 					return FALSE;
 
@@ -1071,8 +1160,9 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 				rawHeights[2] = nSrcHeight;
 			}
 
-			if (!planar_decompress_planes_raw(planes, pTempData, TempFormat, nTempStep, nXDst,
-			                                  nYDst, nSrcWidth, nSrcHeight, vFlip, nTotalHeight))
+			if (!planar_decompress_planes_raw(planar, planes, pTempData, TempFormat, nTempStep,
+			                                  nXDst, nYDst, nSrcWidth, nSrcHeight, vFlip,
+			                                  nTotalHeight))
 				return FALSE;
 
 			if (alpha)
@@ -1105,6 +1195,7 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* WINPR_RESTR
                                               BYTE* WINPR_RESTRICT planes[4])
 {
 	WINPR_ASSERT(planar);
+	WINPR_ASSERT(planar->split_color_planes);
 
 	if ((width > INT32_MAX) || (height > INT32_MAX) || (scanline > INT32_MAX))
 		return FALSE;
@@ -1112,6 +1203,16 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* WINPR_RESTR
 	if (scanline == 0)
 		scanline = width * FreeRDPGetBytesPerPixel(format);
 
+	return planar->split_color_planes(planar, data, format, width, height, scanline, planes);
+}
+
+BOOL planar_split_color_planes_generic(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                       const BYTE* WINPR_RESTRICT data, UINT32 format,
+                                       UINT32 width, UINT32 height, UINT32 scanline,
+                                       BYTE* WINPR_RESTRICT planes[4])
+{
+	WINPR_ASSERT(planar);
+
 	if (planar->topdown)
 	{
 		UINT32 k = 0;
@@ -1268,89 +1369,86 @@ static INLINE UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* WINPR_RES
 	return (UINT32)diff;
 }
 
-static INLINE UINT32 freerdp_bitmap_planar_encode_rle_bytes(const BYTE* WINPR_RESTRICT pInBuffer,
-                                                            UINT32 inBufferSize,
-                                                            BYTE* WINPR_RESTRICT pOutBuffer,
-                                                            UINT32 outBufferSize)
+size_t planar_rle_run_start_generic(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
 {
-	BYTE symbol = 0;
-	const BYTE* pInput = NULL;
-	BYTE* pOutput = NULL;
-	const BYTE* pBytes = NULL;
-	UINT32 cRawBytes = 0;
-	UINT32 nRunLength = 0;
-	UINT32 bSymbolMatch = 0;
-	UINT32 nBytesWritten = 0;
-	UINT32 nTotalBytesWritten = 0;
-	symbol = 0;
-	cRawBytes = 0;
-	nRunLength = 0;
-	pInput = pInBuffer;
-	pOutput = pOutBuffer;
-	nTotalBytesWritten = 0;
+	BYTE symbol = (pos > 0) ? data[pos - 1] : 0;
 
-	if (!outBufferSize)
-		return 0;
-
-	do
+	for (; pos < size; pos++)
 	{
-		if (!inBufferSize)
-			break;
+		if (data[pos] == symbol)
+			return pos;
 
-		bSymbolMatch = (symbol == *pInput) ? TRUE : FALSE;
-		symbol = *pInput;
-		pInput++;
-		inBufferSize--;
+		symbol = data[pos];
+	}
 
-		if (nRunLength && !bSymbolMatch)
-		{
-			if (nRunLength < 3)
-			{
-				cRawBytes += nRunLength;
-				nRunLength = 0;
-			}
-			else
-			{
-				pBytes = pInput - (cRawBytes + nRunLength + 1);
-				nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-				                                                      pOutput, outBufferSize);
-				nRunLength = 0;
+	return size;
+}
 
-				if (!nBytesWritten || (nBytesWritten > outBufferSize))
-					return nRunLength;
+size_t planar_rle_run_end_generic(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
+{
+	WINPR_ASSERT(pos < size);
+	const BYTE symbol = data[pos];
 
-				nTotalBytesWritten += nBytesWritten;
-				outBufferSize -= nBytesWritten;
-				pOutput += nBytesWritten;
-				cRawBytes = 0;
-			}
-		}
+	for (pos++; pos < size; pos++)
+	{
+		if (data[pos] != symbol)
+			return pos;
+	}
 
-		nRunLength += bSymbolMatch;
-		cRawBytes += (!bSymbolMatch) ? TRUE : FALSE;
-	} while (outBufferSize);
+	return size;
+}
 
-	if (cRawBytes || nRunLength)
+static INLINE UINT32
+freerdp_bitmap_planar_encode_rle_bytes(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                       const BYTE* WINPR_RESTRICT pInBuffer, UINT32 inBufferSize,
+                                       BYTE* WINPR_RESTRICT pOutBuffer, UINT32 outBufferSize)
+{
+	size_t pos = 0;
+	size_t rawStart = 0;
+	BYTE* pOutput = pOutBuffer;
+	UINT32 nTotalBytesWritten = 0;
+
+	WINPR_ASSERT(planar);
+	WINPR_ASSERT(planar->rle_run_start);
+	WINPR_ASSERT(planar->rle_run_end);
+
+	if (!inBufferSize || !outBufferSize)
+		return 0;
+
+	/**
+	 * A byte equal to its predecessor (the first one is compared against 0) extends a run,
+	 * any other byte is raw. Runs shorter than 3 bytes stay raw unless they end the line.
+	 */
+	while (pos < inBufferSize)
 	{
-		pBytes = pInput - (cRawBytes + nRunLength);
-		nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-		                                                      pOutput, outBufferSize);
+		const size_t runStart = planar->rle_run_start(pInBuffer, pos, inBufferSize);
+		pos = (runStart < inBufferSize) ? planar->rle_run_end(pInBuffer, runStart, inBufferSize)
+		                                : inBufferSize;
+
+		if ((pos - runStart < 3) && (pos < inBufferSize))
+			continue;
 
-		if (!nBytesWritten)
+		const UINT32 nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(
+		    &pInBuffer[rawStart], (UINT32)(runStart - rawStart), (UINT32)(pos - runStart),
+		    pOutput, outBufferSize);
+
+		if (!nBytesWritten || (nBytesWritten > outBufferSize))
 			return 0;
 
 		nTotalBytesWritten += nBytesWritten;
+		outBufferSize -= nBytesWritten;
+		pOutput += nBytesWritten;
+		rawStart = pos;
 	}
 
-	if (inBufferSize)
-		return 0;
-
 	return nTotalBytesWritten;
 }
 
-BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
-                                              UINT32 height, BYTE* WINPR_RESTRICT outPlane,
-                                              UINT32* WINPR_RESTRICT dstSize)
+static BOOL
+freerdp_bitmap_planar_compress_plane_rle(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                         const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
+                                         UINT32 height, BYTE* WINPR_RESTRICT outPlane,
+                                         UINT32* WINPR_RESTRICT dstSize)
 {
 	UINT32 index = 0;
 	const BYTE* pInput = NULL;
@@ -1371,7 +1469,7 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	while (outBufferSize)
 	{
 		nBytesWritten =
-		    freerdp_bitmap_planar_encode_rle_bytes(pInput, width, pOutput, outBufferSize);
+		    freerdp_bitmap_planar_encode_rle_bytes(planar, pInput, width, pOutput, outBufferSize);
 
 		if ((!nBytesWritten) || (nBytesWritten > outBufferSize))
 			return FALSE;
@@ -1390,11 +1488,11 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	return TRUE;
 }
 
-static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes,
-                                                             UINT32* WINPR_RESTRICT dstSizes,
-                                                             BOOL skipAlpha)
+static INLINE BOOL
+freerdp_bitmap_planar_compress_planes_rle(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                          BYTE* WINPR_RESTRICT inPlanes[4], UINT32 width,
+                                          UINT32 height, BYTE* WINPR_RESTRICT outPlanes,
+                                          UINT32* WINPR_RESTRICT dstSizes, BOOL skipAlpha)
 {
 	UINT32 outPlanesSize = width * height * 4;
 
@@ -1407,8 +1505,8 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRIC
 	{
 		dstSizes[0] = outPlanesSize;
 
-		if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[0], width, height, outPlanes,
-		                                              &dstSizes[0]))
+		if (!freerdp_bitmap_planar_compress_plane_rle(planar, inPlanes[0], width, height,
+		                                              outPlanes, &dstSizes[0]))
 			return FALSE;
 
 		outPlanes += dstSizes[0];
@@ -1418,7 +1516,7 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRIC
 	/* LumaOrRedPlane */
 	dstSizes[1] = outPlanesSize;
 
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[1], width, height, outPlanes,
+	if (!freerdp_bitmap_planar_compress_plane_rle(planar, inPlanes[1], width, height, outPlanes,
 	                                              &dstSizes[1]))
 		return FALSE;
 
@@ -1427,7 +1525,7 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRIC
 	/* OrangeChromaOrGreenPlane */
 	dstSizes[2] = outPlanesSize;
 
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[2], width, height, outPlanes,
+	if (!freerdp_bitmap_planar_compress_plane_rle(planar, inPlanes[2], width, height, outPlanes,
 	                                              &dstSizes[2]))
 		return FALSE;
 
@@ -1436,19 +1534,33 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRIC
 	/* GreenChromeOrBluePlane */
 	dstSizes[3] = outPlanesSize;
 
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[3], width, height, outPlanes,
+	if (!freerdp_bitmap_planar_compress_plane_rle(planar, inPlanes[3], width, height, outPlanes,
 	                                              &dstSizes[3]))
 		return FALSE;
 
 	return TRUE;
 }
 
-BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
-                                               UINT32 height, BYTE* WINPR_RESTRICT outPlane)
+void planar_delta_encode_line_generic(const BYTE* WINPR_RESTRICT src,
+                                      const BYTE* WINPR_RESTRICT prev, BYTE* WINPR_RESTRICT dst,
+                                      UINT32 width)
 {
-	BYTE* outPtr = NULL;
-	const BYTE* srcPtr = NULL;
-	const BYTE* prevLinePtr = NULL;
+	for (UINT32 x = 0; x < width; x++)
+	{
+		/* [MS-RDPEGDI] 3.1.9.2.3 sign and magnitude: 2 * delta or -2 * delta - 1 */
+		const INT8 delta = (INT8)(BYTE)(src[x] - prev[x]);
+		const BYTE mask = (delta < 0) ? 0xFF : 0x00;
+		dst[x] = (BYTE)(((BYTE)delta << 1) ^ mask);
+	}
+}
+
+static BYTE*
+freerdp_bitmap_planar_delta_encode_plane(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                         const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
+                                         UINT32 height, BYTE* WINPR_RESTRICT outPlane)
+{
+	WINPR_ASSERT(planar);
+	WINPR_ASSERT(planar->delta_encode_line);
 
 	if (!outPlane)
 	{
@@ -1461,35 +1573,26 @@ BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlan
 
 	// first line is copied as is
 	CopyMemory(outPlane, inPlane, width);
-	outPtr = outPlane + width;
-	srcPtr = inPlane + width;
-	prevLinePtr = inPlane;
 
 	for (UINT32 y = 1; y < height; y++)
 	{
-		for (UINT32 x = 0; x < width; x++, outPtr++, srcPtr++, prevLinePtr++)
-		{
-			INT32 delta = *srcPtr - *prevLinePtr;
-			BYTE s2c = WINPR_ASSERTING_INT_CAST(
-			    BYTE, (delta >= 0) ? delta : (~((BYTE)(-delta)) + 1) & 0xFF);
-			s2c = WINPR_ASSERTING_INT_CAST(
-			    BYTE,
-			    (s2c >= 0) ? (s2c << 1) & 0xFF : (((UINT32)(~((BYTE)s2c) + 1) << 1) - 1) & 0xFF);
-			*outPtr = s2c;
-		}
+		const size_t offset = 1ull * y * width;
+		planar->delta_encode_line(&inPlane[offset], &inPlane[offset - width], &outPlane[offset],
+		                          width);
 	}
 
 	return outPlane;
 }
 
-static INLINE BOOL freerdp_bitmap_planar_delta_encode_planes(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes[4])
+static INLINE BOOL
+freerdp_bitmap_planar_delta_encode_planes(const BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                          BYTE* WINPR_RESTRICT inPlanes[4], UINT32 width,
+                                          UINT32 height, BYTE* WINPR_RESTRICT outPlanes[4])
 {
 	for (UINT32 i = 0; i < 4; i++)
 	{
-		outPlanes[i] =
-		    freerdp_bitmap_planar_delta_encode_plane(inPlanes[i], width, height, outPlanes[i]);
+		outPlanes[i] = freerdp_bitmap_planar_delta_encode_plane(planar, inPlanes[i], width, height,
+		                                                        outPlanes[i]);
 
 		if (!outPlanes[i])
 			return FALSE;
@@ -1526,12 +1629,12 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT conte
 
 	if (context->AllowRunLengthEncoding)
 	{
-		if (!freerdp_bitmap_planar_delta_encode_planes(context->planes, width, height,
+		if (!freerdp_bitmap_planar_delta_encode_planes(context, context->planes, width, height,
 		                                               context->deltaPlanes))
 			return NULL;
 
-		if (!freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
-		                                               context->rlePlanesBuffer, dstSizes,
+		if (!freerdp_bitmap_planar_compress_planes_rle(context, context->deltaPlanes, width,
+		                                               height, context->rlePlanesBuffer, dstSizes,
 		                                               context->AllowSkipAlpha))
 			return NULL;
 
@@ -1760,6 +1863,10 @@ BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 max
 	if (context->ColorLossLevel)
 		context->AllowDynamicColorFidelity = TRUE;
 
+	planar_init_generic(context);
+	planar_init_sse2(context);
+	planar_init_neon(context);
+
 	if (!freerdp_bitmap_planar_context_reset(context, maxWidth, maxHeight))
 	{
 		WINPR_PRAGMA_DIAG_PUSH
@@ -1784,6 +1891,18 @@ void freerdp_bitmap_planar_context_free(BITMAP_PLANAR_CONTEXT* context)
 	winpr_aligned_free(context);
 }
 
+void planar_init_generic(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar)
+{
+	WINPR_ASSERT(planar);
+	planar->split_color_planes = planar_split_color_planes_generic;
+	planar->delta_encode_line = planar_delta_encode_line_generic;
+	planar->rle_run_start = planar_rle_run_start_generic;
+	planar->rle_run_end = planar_rle_run_end_generic;
+	planar->delta_decode_line = planar_delta_decode_line_generic;
+	planar->merge_planes_line = planar_merge_planes_line_generic;
+	planar->subsample_expand_line = planar_subsample_expand_line_generic;
+}
+
 void freerdp_planar_switch_bgr(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar, BOOL bgr)
 {
 	WINPR_ASSERT(planar);
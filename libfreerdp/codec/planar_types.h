@@ -0,0 +1,105 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDP6 Planar Codec
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_PLANAR_TYPES_H
+#define FREERDP_LIB_CODEC_PLANAR_TYPES_H
+
+#include <freerdp/config.h>
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/codec/planar.h>
+
+struct S_BITMAP_PLANAR_CONTEXT
+{
+	UINT32 maxWidth;
+	UINT32 maxHeight;
+	UINT32 maxPlaneSize;
+
+	BOOL AllowSkipAlpha;
+	BOOL AllowRunLengthEncoding;
+	BOOL AllowColorSubsampling;
+	BOOL AllowDynamicColorFidelity;
+
+	UINT32 ColorLossLevel;
+
+	BYTE* planes[4];
+	BYTE* planesBuffer;
+
+	BYTE* deltaPlanes[4];
+	BYTE* deltaPlanesBuffer;
+
+	BYTE* rlePlanes[4];
+	BYTE* rlePlanesBuffer;
+
+	BYTE* pTempData;
+	UINT32 nTempStep;
+
+	BOOL bgr;
+	BOOL topdown;
+
+	/* Encoder kernels, replaced by SIMD versions where available */
+	BOOL (*split_color_planes)(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+	                           const BYTE* WINPR_RESTRICT data, UINT32 format, UINT32 width,
+	                           UINT32 height, UINT32 scanline, BYTE* WINPR_RESTRICT planes[4]);
+	void (*delta_encode_line)(const BYTE* WINPR_RESTRICT src, const BYTE* WINPR_RESTRICT prev,
+	                          BYTE* WINPR_RESTRICT dst, UINT32 width);
+	/* First index >= pos where data[i] == data[i - 1] (data[-1] is 0), size if none */
+	size_t (*rle_run_start)(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size);
+	/* First index > pos where data[i] != data[i - 1], size if none */
+	size_t (*rle_run_end)(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size);
+
+	/* Decoder kernels, replaced by SIMD versions where available */
+	/* Replace the encoded deltas in line with the values they describe relative to prev */
+	void (*delta_decode_line)(BYTE* WINPR_RESTRICT line, const BYTE* WINPR_RESTRICT prev,
+	                          UINT32 width);
+	/* Write width pixels in B G R A byte order, an alpha of NULL writes 0xFF */
+	void (*merge_planes_line)(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT b,
+	                          const BYTE* WINPR_RESTRICT g, const BYTE* WINPR_RESTRICT r,
+	                          const BYTE* WINPR_RESTRICT a, UINT32 width);
+	/* dst[x] = src[x / 2] for x < width */
+	void (*subsample_expand_line)(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src,
+	                              UINT32 width);
+};
+
+FREERDP_LOCAL BOOL planar_split_color_planes_generic(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                                     const BYTE* WINPR_RESTRICT data,
+                                                     UINT32 format, UINT32 width, UINT32 height,
+                                                     UINT32 scanline,
+                                                     BYTE* WINPR_RESTRICT planes[4]);
+FREERDP_LOCAL void planar_delta_encode_line_generic(const BYTE* WINPR_RESTRICT src,
+                                                    const BYTE* WINPR_RESTRICT prev,
+                                                    BYTE* WINPR_RESTRICT dst, UINT32 width);
+FREERDP_LOCAL size_t planar_rle_run_start_generic(const BYTE* WINPR_RESTRICT data, size_t pos,
+                                                  size_t size);
+FREERDP_LOCAL size_t planar_rle_run_end_generic(const BYTE* WINPR_RESTRICT data, size_t pos,
+                                                size_t size);
+FREERDP_LOCAL void planar_delta_decode_line_generic(BYTE* WINPR_RESTRICT line,
+                                                    const BYTE* WINPR_RESTRICT prev, UINT32 width);
+FREERDP_LOCAL void planar_merge_planes_line_generic(BYTE* WINPR_RESTRICT dst,
+                                                    const BYTE* WINPR_RESTRICT b,
+                                                    const BYTE* WINPR_RESTRICT g,
+                                                    const BYTE* WINPR_RESTRICT r,
+                                                    const BYTE* WINPR_RESTRICT a, UINT32 width);
+FREERDP_LOCAL void planar_subsample_expand_line_generic(BYTE* WINPR_RESTRICT dst,
+                                                        const BYTE* WINPR_RESTRICT src,
+                                                        UINT32 width);
+
+FREERDP_LOCAL void planar_init_generic(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar);
+
+#endif /* FREERDP_LIB_CODEC_PLANAR_TYPES_H */
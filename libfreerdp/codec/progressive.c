@@ -37,12 +37,19 @@
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
 #include "rfx_rlgr.h"
+#include "rfx_encode.h"
 #include "rfx_constants.h"
 #include "rfx_types.h"
 #include "progressive.h"
 
 #define TAG FREERDP_TAG("codec.progressive")
 
+/* the pixel data of a tile, stored in the surface slabs */
+#define PROGRESSIVE_TILE_DATA_BYTES (64ull * 64ull * 4ull)
+
+/* a sign or current coefficient plane of a tile, allocated on demand */
+#define PROGRESSIVE_TILE_PLANE_BYTES ((8192ULL + 32ULL) * 3ULL)
+
 typedef struct
 {
 	BOOL nonLL;
@@ -258,15 +265,31 @@ progressive_get_surface_data(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UI
 	return HashTable_GetItemValue(progressive->SurfaceContexts, key);
 }
 
-static void progressive_tile_free(RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile)
+static BOOL progressive_tile_plane_ensure(wMemoryTag* memoryTag, BYTE** pplane)
 {
-	if (tile)
-	{
-		winpr_aligned_free(tile->sign);
-		winpr_aligned_free(tile->current);
-		winpr_aligned_free(tile->data);
-		winpr_aligned_free(tile);
-	}
+	WINPR_ASSERT(pplane);
+
+	if (*pplane)
+		return TRUE;
+
+	/* zeroed, a difference against a missing state must not read garbage */
+	*pplane = winpr_aligned_calloc(1, PROGRESSIVE_TILE_PLANE_BYTES, 16);
+	if (!*pplane)
+		return FALSE;
+	MemoryTag_Allocated(memoryTag, PROGRESSIVE_TILE_PLANE_BYTES);
+	return TRUE;
+}
+
+static void progressive_tile_plane_free(wMemoryTag* memoryTag, BYTE** pplane)
+{
+	WINPR_ASSERT(pplane);
+
+	if (!*pplane)
+		return;
+
+	winpr_aligned_free(*pplane);
+	*pplane = NULL;
+	MemoryTag_Released(memoryTag, PROGRESSIVE_TILE_PLANE_BYTES);
 }
 
 static void progressive_surface_context_free(void* ptr)
@@ -281,46 +304,64 @@ static void progressive_surface_context_free(void* ptr)
 		for (size_t index = 0; index < surface->tilesSize; index++)
 		{
 			RFX_PROGRESSIVE_TILE* tile = surface->tiles[index];
-			progressive_tile_free(tile);
+			if (!tile)
+				continue;
+			progressive_tile_plane_free(surface->memoryTag, &tile->sign);
+			progressive_tile_plane_free(surface->memoryTag, &tile->current);
 		}
 	}
 
+	for (size_t index = 0; index < surface->numSlabs; index++)
+		winpr_aligned_free(surface->slabs[index]);
+	MemoryTag_Released(surface->memoryTag, surface->slabBytes);
+
+	free((void*)surface->slabs);
 	winpr_aligned_free((void*)surface->tiles);
 	winpr_aligned_free(surface->updatedTileIndices);
 	winpr_aligned_free(surface);
 }
 
-static INLINE RFX_PROGRESSIVE_TILE* progressive_tile_new(void)
+/* Allocates count tiles with their pixel data in one block, the coefficient planes are only
+ * allocated once a tile is decoded. */
+static INLINE BOOL
+progressive_allocate_tile_slab(PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surface, size_t first,
+                               size_t count)
 {
-	RFX_PROGRESSIVE_TILE* tile = winpr_aligned_calloc(1, sizeof(RFX_PROGRESSIVE_TILE), 32);
-	if (!tile)
-		goto fail;
+	WINPR_ASSERT(surface);
 
-	tile->width = 64;
-	tile->height = 64;
-	tile->stride = 4 * tile->width;
+	if (count == 0)
+		return TRUE;
 
-	size_t dataLen = 1ull * tile->stride * tile->height;
-	tile->data = (BYTE*)winpr_aligned_malloc(dataLen, 16);
-	if (!tile->data)
-		goto fail;
-	memset(tile->data, 0xFF, dataLen);
+	BYTE** slabs = (BYTE**)realloc((void*)surface->slabs, (surface->numSlabs + 1) * sizeof(BYTE*));
+	if (!slabs)
+		return FALSE;
+	surface->slabs = slabs;
 
-	size_t signLen = (8192ULL + 32ULL) * 3ULL;
-	tile->sign = (BYTE*)winpr_aligned_malloc(signLen, 16);
-	if (!tile->sign)
-		goto fail;
+	const size_t dataLen = count * PROGRESSIVE_TILE_DATA_BYTES;
+	const size_t slabLen = dataLen + count * sizeof(RFX_PROGRESSIVE_TILE);
+	BYTE* slab = winpr_aligned_malloc(slabLen, 32);
+	if (!slab)
+		return FALSE;
 
-	size_t currentLen = (8192ULL + 32ULL) * 3ULL;
-	tile->current = (BYTE*)winpr_aligned_malloc(currentLen, 16);
-	if (!tile->current)
-		goto fail;
+	surface->slabs[surface->numSlabs++] = slab;
+	surface->slabBytes += slabLen;
+	MemoryTag_Allocated(surface->memoryTag, slabLen);
 
-	return tile;
+	memset(slab, 0xFF, dataLen);
+	RFX_PROGRESSIVE_TILE* tiles = (RFX_PROGRESSIVE_TILE*)&slab[dataLen];
+	memset((void*)tiles, 0, count * sizeof(RFX_PROGRESSIVE_TILE));
 
-fail:
-	progressive_tile_free(tile);
-	return NULL;
+	for (size_t x = 0; x < count; x++)
+	{
+		RFX_PROGRESSIVE_TILE* tile = &tiles[x];
+		tile->width = 64;
+		tile->height = 64;
+		tile->stride = 4 * tile->width;
+		tile->data = &slab[x * PROGRESSIVE_TILE_DATA_BYTES];
+		surface->tiles[first + x] = tile;
+	}
+
+	return TRUE;
 }
 
 static INLINE BOOL
@@ -345,12 +386,8 @@ progressive_allocate_tile_cache(PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surf
 	surface->tilesSize = surface->gridSize;
 	surface->tiles = (RFX_PROGRESSIVE_TILE**)tmp;
 
-	for (size_t x = oldIndex; x < surface->tilesSize; x++)
-	{
-		surface->tiles[x] = progressive_tile_new();
-		if (!surface->tiles[x])
-			return FALSE;
-	}
+	if (!progressive_allocate_tile_slab(surface, oldIndex, surface->tilesSize - oldIndex))
+		return FALSE;
 
 	tmp =
 	    winpr_aligned_recalloc(surface->updatedTileIndices, surface->gridSize, sizeof(UINT32), 32);
@@ -362,7 +399,8 @@ progressive_allocate_tile_cache(PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surf
 	return TRUE;
 }
 
-static PROGRESSIVE_SURFACE_CONTEXT* progressive_surface_context_new(UINT16 surfaceId, UINT32 width,
+static PROGRESSIVE_SURFACE_CONTEXT* progressive_surface_context_new(wMemoryTag* memoryTag,
+                                                                    UINT16 surfaceId, UINT32 width,
                                                                     UINT32 height)
 {
 	PROGRESSIVE_SURFACE_CONTEXT* surface = (PROGRESSIVE_SURFACE_CONTEXT*)winpr_aligned_calloc(
@@ -371,6 +409,7 @@ static PROGRESSIVE_SURFACE_CONTEXT* progressive_surface_context_new(UINT16 surfa
 	if (!surface)
 		return NULL;
 
+	surface->memoryTag = memoryTag;
 	surface->id = surfaceId;
 	surface->width = width;
 	surface->height = height;
@@ -477,7 +516,8 @@ INT32 progressive_create_surface_context(PROGRESSIVE_CONTEXT* WINPR_RESTRICT pro
 
 	if (!surface)
 	{
-		surface = progressive_surface_context_new(surfaceId, width, height);
+		surface =
+		    progressive_surface_context_new(progressive->memoryTag, surfaceId, width, height);
 
 		if (!surface)
 			return -1;
@@ -736,6 +776,81 @@ void rfx_dwt_2d_extrapolate_decode(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RE
 	progressive_rfx_dwt_2d_decode_block(&buffer[0], temp, 1);
 }
 
+static INLINE void progressive_rfx_dwt_encode(const INT16* WINPR_RESTRICT pSrcBand, size_t nSrcStep,
+                                              INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                                              INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                                              size_t nLowCount, size_t nHighCount)
+{
+	/* Inverse of progressive_rfx_idwt_x/y, the last low band coefficient(s) extrapolate the
+	 * odd sized input. */
+	for (size_t k = 0; k < nHighCount; k++)
+	{
+		const int32_t X0 = pSrcBand[(2 * k) * nSrcStep];
+		const int32_t X1 = pSrcBand[(2 * k + 1) * nSrcStep];
+		const int32_t X2 = pSrcBand[(2 * k + 2) * nSrcStep];
+		pHighBand[k * nHighStep] = clampi16((X1 - ((X0 + X2) / 2)) / 2);
+	}
+
+	pLowBand[0] = clampi16((int32_t)pSrcBand[0] + pHighBand[0]);
+
+	for (size_t k = 1; k < nHighCount; k++)
+	{
+		const int32_t H0 = pHighBand[(k - 1) * nHighStep];
+		const int32_t H1 = pHighBand[k * nHighStep];
+		pLowBand[k * nLowStep] = clampi16(pSrcBand[(2 * k) * nSrcStep] + ((H0 + H1) / 2));
+	}
+
+	const int32_t H0 = pHighBand[(nHighCount - 1) * nHighStep];
+	const int32_t X0 = pSrcBand[(2 * nHighCount) * nSrcStep];
+
+	if (nLowCount <= (nHighCount + 1))
+		pLowBand[nHighCount * nLowStep] = clampi16(X0 + H0);
+	else
+	{
+		const int32_t X1 = pSrcBand[(2 * nHighCount + 1) * nSrcStep];
+		pLowBand[nHighCount * nLowStep] = clampi16(X0 + (H0 / 2));
+		pLowBand[(nHighCount + 1) * nLowStep] = clampi16((2 * X1) - X0);
+	}
+}
+
+static INLINE void progressive_rfx_dwt_2d_encode_block(INT16* WINPR_RESTRICT buffer,
+                                                       INT16* WINPR_RESTRICT temp, size_t level)
+{
+	const size_t nBandL = progressive_rfx_get_band_l_count(level);
+	const size_t nBandH = progressive_rfx_get_band_h_count(level);
+	const size_t nCount = nBandL + nBandH;
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nCount];
+	INT16* HL = &buffer[0];
+	INT16* LH = &HL[nBandH * nBandL];
+	INT16* HH = &LH[nBandL * nBandH];
+	INT16* LL = &HH[nBandH * nBandH];
+
+	/* vertical (LL -> L + H) */
+	for (size_t x = 0; x < nCount; x++)
+		progressive_rfx_dwt_encode(&buffer[x], nCount, &L[x], nCount, &H[x], nCount, nBandL,
+		                           nBandH);
+
+	/* horizontal (L -> LL + HL) */
+	for (size_t y = 0; y < nBandL; y++)
+		progressive_rfx_dwt_encode(&L[y * nCount], 1, &LL[y * nBandL], 1, &HL[y * nBandH], 1,
+		                           nBandL, nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (size_t y = 0; y < nBandH; y++)
+		progressive_rfx_dwt_encode(&H[y * nCount], 1, &LH[y * nBandL], 1, &HH[y * nBandH], 1,
+		                           nBandL, nBandH);
+}
+
+void rfx_dwt_2d_extrapolate_encode(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT temp)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(temp);
+	progressive_rfx_dwt_2d_encode_block(&buffer[0], temp, 1);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3007], temp, 2);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3807], temp, 3);
+}
+
 static INLINE int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                                                 INT16* WINPR_RESTRICT buffer,
                                                 INT16* WINPR_RESTRICT current, BOOL coeffDiff,
@@ -843,6 +958,7 @@ progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressiv
 	BOOL sub = 0;
 	BOOL extrapolate = 0;
 	BYTE* pBuffer = NULL;
+	BYTE* pScratch = NULL;
 	INT16* pSign[3];
 	INT16* pSrcDst[3];
 	INT16* pCurrent[3];
@@ -937,13 +1053,37 @@ progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressiv
 	progressive_rfx_quant_add(quantCr, quantProgCr, &shiftCr);
 	progressive_rfx_quant_lsub(&shiftCr, 1); /* -6 + 5 = -1 */
 
-	pSign[0] = (INT16*)((&tile->sign[((8192 + 32) * 0) + 16])); /* Y/R buffer */
-	pSign[1] = (INT16*)((&tile->sign[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
-	pSign[2] = (INT16*)((&tile->sign[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	/* A full quality tile is never upgraded, so its sign is not kept. The current coefficients
+	 * are only kept if a later tile might be a difference against them. */
+	const BOOL final = (tile->quality == 0xFF);
+	if (final)
+		progressive_tile_plane_free(progressive->memoryTag, &tile->sign);
+	else if (!progressive_tile_plane_ensure(progressive->memoryTag, &tile->sign))
+		return -1;
 
-	pCurrent[0] = (INT16*)((&tile->current[((8192 + 32) * 0) + 16])); /* Y/R buffer */
-	pCurrent[1] = (INT16*)((&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
-	pCurrent[2] = (INT16*)((&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	if (final && !diff && !sub)
+		progressive_tile_plane_free(progressive->memoryTag, &tile->current);
+	else if (!progressive_tile_plane_ensure(progressive->memoryTag, &tile->current))
+		return -1;
+
+	/* planes not kept are only written during this pass, they can share one scratch buffer */
+	if (!tile->sign || !tile->current)
+	{
+		pScratch = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
+		if (!pScratch)
+			return -1;
+	}
+
+	BYTE* sign = tile->sign ? tile->sign : pScratch;
+	BYTE* current = tile->current ? tile->current : pScratch;
+
+	pSign[0] = (INT16*)((&sign[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSign[1] = (INT16*)((&sign[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSign[2] = (INT16*)((&sign[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+
+	pCurrent[0] = (INT16*)((&current[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pCurrent[1] = (INT16*)((&current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pCurrent[2] = (INT16*)((&current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
 	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
 	pSrcDst[0] = (INT16*)((&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
@@ -970,6 +1110,8 @@ progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressiv
 	                                    &roi_64x64);
 fail:
 	BufferPool_Return(progressive->bufferPool, pBuffer);
+	if (pScratch)
+		BufferPool_Return(progressive->bufferPool, pScratch);
 	return rc;
 }
 
@@ -1380,6 +1522,11 @@ progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progress
 	tile->cbProgQuant = *quantProgCb;
 	tile->crProgQuant = *quantProgCr;
 
+	/* a tile upgraded without a previous pass starts from zeroed planes */
+	if (!progressive_tile_plane_ensure(progressive->memoryTag, &tile->sign) ||
+	    !progressive_tile_plane_ensure(progressive->memoryTag, &tile->current))
+		return -1;
+
 	pSign[0] = (INT16*)((&tile->sign[((8192 + 32) * 0) + 16])); /* Y/R buffer */
 	pSign[1] = (INT16*)((&tile->sign[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pSign[2] = (INT16*)((&tile->sign[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
@@ -1420,6 +1567,14 @@ progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progress
 	const INT16** ptr = WINPR_REINTERPRET_CAST(pSrcDst, INT16**, const INT16**);
 	status = prims->yCbCrToRGB_16s8u_P3AC4R(ptr, 64 * 2, tile->data, tile->stride,
 	                                        progressive->format, &roi_64x64);
+
+	/* full quality reached, drop the planes no further pass of this tile will read */
+	if ((status >= 0) && (tile->quality == 0xFF))
+	{
+		progressive_tile_plane_free(progressive->memoryTag, &tile->sign);
+		if (!sub)
+			progressive_tile_plane_free(progressive->memoryTag, &tile->current);
+	}
 fail:
 	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return status;
@@ -1565,32 +1720,36 @@ static INLINE BOOL progressive_tile_read(
 	return progressive_surface_tile_replace(surface, region, &tile, FALSE);
 }
 
-static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                  void* context, PTP_WORK work)
+static BOOL progressive_process_tiles_callback(void* arg, size_t begin, size_t end)
 {
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)context;
-
-	WINPR_UNUSED(instance);
-	WINPR_UNUSED(work);
+	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)arg;
+	WINPR_ASSERT(param);
 
-	switch (param->tile->blockType)
+	for (size_t idx = begin; idx < end; idx++)
 	{
-		case PROGRESSIVE_WBT_TILE_SIMPLE:
-		case PROGRESSIVE_WBT_TILE_FIRST:
-			progressive_decompress_tile_first(param->progressive, param->tile, param->region,
-			                                  param->context);
-			break;
+		RFX_PROGRESSIVE_TILE* tile = param->region->tiles[idx];
 
-		case PROGRESSIVE_WBT_TILE_UPGRADE:
-			progressive_decompress_tile_upgrade(param->progressive, param->tile, param->region,
-			                                    param->context);
-			break;
-		default:
-			WLog_Print(param->progressive->log, WLOG_ERROR, "Invalid block type %04" PRIx16 " (%s)",
-			           param->tile->blockType,
-			           rfx_get_progressive_block_type_string(param->tile->blockType));
-			break;
+		switch (tile->blockType)
+		{
+			case PROGRESSIVE_WBT_TILE_SIMPLE:
+			case PROGRESSIVE_WBT_TILE_FIRST:
+				progressive_decompress_tile_first(param->progressive, tile, param->region,
+				                                  param->context);
+				break;
+
+			case PROGRESSIVE_WBT_TILE_UPGRADE:
+				progressive_decompress_tile_upgrade(param->progressive, tile, param->region,
+				                                    param->context);
+				break;
+			default:
+				WLog_Print(param->progressive->log, WLOG_ERROR,
+				           "Invalid block type %04" PRIx16 " (%s)", tile->blockType,
+				           rfx_get_progressive_block_type_string(tile->blockType));
+				break;
+		}
 	}
+
+	return TRUE;
 }
 
 static INLINE SSIZE_T progressive_process_tiles(
@@ -1599,13 +1758,11 @@ static INLINE SSIZE_T progressive_process_tiles(
     PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surface,
     const PROGRESSIVE_BLOCK_CONTEXT* WINPR_RESTRICT context)
 {
-	int status = 0;
 	size_t end = 0;
 	const size_t start = Stream_GetPosition(s);
 	UINT16 blockType = 0;
 	UINT32 blockLen = 0;
 	UINT32 count = 0;
-	UINT16 close_cnt = 0;
 
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(region);
@@ -1687,58 +1844,14 @@ static INLINE SSIZE_T progressive_process_tiles(
 		return -1044;
 	}
 
-	for (UINT32 idx = 0; idx < region->numTiles; idx++)
+	PROGRESSIVE_TILE_PROCESS_WORK_PARAM param = { progressive, region, context };
+	if (!rfx_context_process_tiles(progressive->rfx_context, region->numTiles,
+	                               progressive_process_tiles_callback, &param))
 	{
-		RFX_PROGRESSIVE_TILE* tile = region->tiles[idx];
-		PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = &progressive->params[idx];
-		param->progressive = progressive;
-		param->region = region;
-		param->context = context;
-		param->tile = tile;
-
-		if (progressive->rfx_context->priv->UseThreads)
-		{
-			progressive->work_objects[idx] =
-			    CreateThreadpoolWork(progressive_process_tiles_tile_work_callback, (void*)param,
-			                         &progressive->rfx_context->priv->ThreadPoolEnv);
-			if (!progressive->work_objects[idx])
-			{
-				WLog_Print(progressive->log, WLOG_ERROR,
-				           "Failed to create ThreadpoolWork for tile %" PRIu32, idx);
-				status = -1;
-				break;
-			}
-
-			SubmitThreadpoolWork(progressive->work_objects[idx]);
-
-			close_cnt = WINPR_ASSERTING_INT_CAST(UINT16, idx + 1);
-		}
-		else
-		{
-			progressive_process_tiles_tile_work_callback(0, param, 0);
-		}
-
-		if (status < 0)
-		{
-			WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %s at %" PRIu16,
-			           rfx_get_progressive_block_type_string(tile->blockType), idx);
-			goto fail;
-		}
-	}
-
-	if (progressive->rfx_context->priv->UseThreads)
-	{
-		for (UINT32 idx = 0; idx < close_cnt; idx++)
-		{
-			WaitForThreadpoolWorkCallbacks(progressive->work_objects[idx], FALSE);
-			CloseThreadpoolWork(progressive->work_objects[idx]);
-		}
-	}
-
-fail:
-
-	if (status < 0)
+		WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %" PRIu16 " tiles",
+		           region->numTiles);
 		return -1;
+	}
 
 	return (SSIZE_T)(end - start);
 }
@@ -2395,6 +2508,783 @@ BOOL progressive_rfx_write_message_progressive_simple(
 	return rfx_write_message_progressive_simple(context, s, msg);
 }
 
+#define PROGRESSIVE_MAX_PASSES 4
+#define PROGRESSIVE_ENCODER_STREAM_SIZE 0x4000
+
+/* Progressive quantization (additional bits dropped) of all quality levels, coarse to fine.
+ * The final level always sends the full precision with quality 0xFF. */
+static const BYTE progressive_encoder_pass_bits[PROGRESSIVE_MAX_PASSES][PROGRESSIVE_MAX_PASSES] = {
+	{ 0 }, { 4, 0 }, { 4, 2, 0 }, { 4, 2, 1, 0 }
+};
+
+static const RFX_COMPONENT_CODEC_QUANT progressive_encoder_quant = {
+	.LL3 = 6, .HL3 = 6, .LH3 = 6, .HH3 = 6, .HL2 = 7,
+	.LH2 = 7, .HH2 = 8, .HL1 = 8, .LH1 = 8, .HH1 = 9
+};
+
+/* Sub-band layout of a RFX_DWT_REDUCE_EXTRAPOLATE tile, in the order the bands are coded */
+static const struct
+{
+	size_t offset;
+	size_t length;
+} progressive_rfx_bands[] = { { 0, 1023 },    { 1023, 1023 }, { 2046, 961 }, { 3007, 272 },
+	                          { 3279, 272 }, { 3551, 256 },  { 3807, 72 },  { 3879, 72 },
+	                          { 3951, 64 },  { 4015, 81 } };
+
+#define PROGRESSIVE_BAND_LL3 9
+
+static INLINE UINT32 progressive_rfx_quant_get(const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q,
+                                               size_t band)
+{
+	switch (band)
+	{
+		case 0:
+			return q->HL1;
+		case 1:
+			return q->LH1;
+		case 2:
+			return q->HH1;
+		case 3:
+			return q->HL2;
+		case 4:
+			return q->LH2;
+		case 5:
+			return q->HH2;
+		case 6:
+			return q->HL3;
+		case 7:
+			return q->LH3;
+		case 8:
+			return q->HH3;
+		default:
+			return q->LL3;
+	}
+}
+
+static INLINE void
+progressive_component_codec_quant_write(wStream* WINPR_RESTRICT s,
+                                        const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT quantVal)
+{
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LL3 | (quantVal->HL3 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH3 | (quantVal->HH3 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HL2 | (quantVal->LH2 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HH2 | (quantVal->HL1 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH1 | (quantVal->HH1 << 4)));
+}
+
+static INLINE void progressive_encoder_prog_quant(UINT32 passes, UINT32 level,
+                                                  RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q)
+{
+	WINPR_ASSERT((passes > 0) && (passes <= PROGRESSIVE_MAX_PASSES));
+	WINPR_ASSERT(level < passes);
+
+	const BYTE bits = progressive_encoder_pass_bits[passes - 1][level];
+
+	q->HL1 = q->LH1 = q->HH1 = bits;
+	q->HL2 = q->LH2 = q->HH2 = bits;
+	q->HL3 = q->LH3 = q->HH3 = bits;
+	/* keep more precision for the DC band, it dominates the first pass impression */
+	q->LL3 = bits / 2;
+}
+
+/* The value of a quantized coefficient with the lowest bits dropped as the decoder sees it */
+static INLINE INT16 progressive_encoder_value(INT16 coeff, UINT32 bits, BOOL nonLL)
+{
+	if (!nonLL || (coeff >= 0))
+		return (INT16)(coeff >> bits);
+	return (INT16)(-((-coeff) >> bits));
+}
+
+static INLINE void
+progressive_encoder_quantize(INT16* WINPR_RESTRICT buffer,
+                             const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT quant)
+{
+	for (size_t band = 0; band < ARRAYSIZE(progressive_rfx_bands); band++)
+	{
+		const UINT32 shift = progressive_rfx_quant_get(quant, band) - 1; /* -6 + 5 = -1 */
+		const int32_t round = 1 << (shift - 1);
+		INT16* data = &buffer[progressive_rfx_bands[band].offset];
+
+		for (size_t x = 0; x < progressive_rfx_bands[band].length; x++)
+		{
+			const int32_t val = data[x];
+
+			/* non LL bands are coded as sign and magnitude */
+			if ((band != PROGRESSIVE_BAND_LL3) && (val < 0))
+				data[x] = clampi16(-((-val + round) >> shift));
+			else
+				data[x] = clampi16((val + round) >> shift);
+		}
+	}
+}
+
+static INLINE void progressive_encoder_write_bits(wBitStream* WINPR_RESTRICT bs, UINT32 bits,
+                                                  UINT32 nbits)
+{
+	while (nbits > 16)
+	{
+		nbits -= 16;
+		BitStream_Write_Bits(bs, (bits >> nbits) & 0xFFFF, 16);
+	}
+
+	if (nbits > 0)
+		BitStream_Write_Bits(bs, bits & ((1u << nbits) - 1u), nbits);
+}
+
+/* Mirror of progressive_rfx_srl_read, state->nz counts the pending zero run */
+static INLINE void progressive_rfx_srl_write(RFX_PROGRESSIVE_UPGRADE_STATE* WINPR_RESTRICT state,
+                                             INT16 value, UINT32 numBits)
+{
+	wBitStream* bs = state->srl;
+	const UINT32 k = state->kp / 8;
+
+	if (value == 0)
+	{
+		state->nz++;
+
+		if (state->nz == (1 << k))
+		{
+			/* '0' bit, nz >= (1 << k) */
+			progressive_encoder_write_bits(bs, 0, 1);
+			state->nz = 0;
+			state->kp += 4;
+
+			if (state->kp > 80)
+				state->kp = 80;
+		}
+
+		return;
+	}
+
+	/* '1' bit, nz < (1 << k), nz in the next k bits */
+	progressive_encoder_write_bits(bs, 1, 1);
+	progressive_encoder_write_bits(bs, (UINT32)state->nz, k);
+	state->nz = 0;
+
+	/* unary encoding */
+	progressive_encoder_write_bits(bs, (value < 0) ? 1 : 0, 1);
+
+	if (state->kp < 6)
+		state->kp = 0;
+	else
+		state->kp -= 6;
+
+	if (numBits == 1)
+		return;
+
+	const UINT32 mag = (UINT32)abs(value);
+	const UINT32 max = (1 << numBits) - 1;
+
+	for (UINT32 x = 1; x < mag; x += 16)
+		progressive_encoder_write_bits(bs, 0, MIN(16, mag - x));
+
+	if (mag < max)
+		progressive_encoder_write_bits(bs, 1, 1);
+}
+
+static INLINE BOOL progressive_encoder_bits_finish(wBitStream* WINPR_RESTRICT bs,
+                                                   UINT16* WINPR_RESTRICT length)
+{
+	BitStream_Flush(bs);
+
+	const UINT32 len = (bs->position + 7) / 8;
+	if (len >= bs->capacity)
+		return FALSE;
+
+	*length = WINPR_ASSERTING_INT_CAST(UINT16, len);
+	return TRUE;
+}
+
+static INLINE BOOL progressive_encoder_upgrade_component(
+    const INT16* WINPR_RESTRICT coeffs, const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT oldProg,
+    const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT newProg, wStream* WINPR_RESTRICT s,
+    UINT16* WINPR_RESTRICT srlLen, UINT16* WINPR_RESTRICT rawLen)
+{
+	wBitStream s_srl = { 0 };
+	wBitStream s_raw = { 0 };
+	RFX_PROGRESSIVE_UPGRADE_STATE state = { 0 };
+
+	state.kp = 8;
+	state.srl = &s_srl;
+	state.raw = &s_raw;
+
+	/* SRL: coefficients that are still zero on the decoder side */
+	BitStream_Attach(state.srl, Stream_Pointer(s), PROGRESSIVE_ENCODER_STREAM_SIZE);
+
+	for (size_t band = 0; band < PROGRESSIVE_BAND_LL3; band++)
+	{
+		const UINT32 oldBits = progressive_rfx_quant_get(oldProg, band);
+		const UINT32 newBits = progressive_rfx_quant_get(newProg, band);
+		const UINT32 numBits = oldBits - newBits;
+		const INT16* data = &coeffs[progressive_rfx_bands[band].offset];
+
+		if (!numBits)
+			continue;
+
+		for (size_t x = 0; x < progressive_rfx_bands[band].length; x++)
+		{
+			if (progressive_encoder_value(data[x], oldBits, TRUE) != 0)
+				continue;
+
+			progressive_rfx_srl_write(&state, progressive_encoder_value(data[x], newBits, TRUE),
+			                          numBits);
+		}
+	}
+
+	/* a trailing zero run just needs to be started, the decoder stops at the last coefficient */
+	if (state.nz)
+		progressive_encoder_write_bits(state.srl, 0, 1);
+
+	if (!progressive_encoder_bits_finish(state.srl, srlLen))
+		return FALSE;
+	Stream_Seek(s, *srlLen);
+
+	/* RAW: refinement bits of significant coefficients and the DC band */
+	BitStream_Attach(state.raw, Stream_Pointer(s), PROGRESSIVE_ENCODER_STREAM_SIZE);
+
+	for (size_t band = 0; band < ARRAYSIZE(progressive_rfx_bands); band++)
+	{
+		const BOOL nonLL = (band != PROGRESSIVE_BAND_LL3);
+		const UINT32 oldBits = progressive_rfx_quant_get(oldProg, band);
+		const UINT32 newBits = progressive_rfx_quant_get(newProg, band);
+		const UINT32 numBits = oldBits - newBits;
+		const INT16* data = &coeffs[progressive_rfx_bands[band].offset];
+
+		if (!numBits)
+			continue;
+
+		for (size_t x = 0; x < progressive_rfx_bands[band].length; x++)
+		{
+			if (!nonLL)
+			{
+				const INT16 val = progressive_encoder_value(data[x], newBits, FALSE);
+				progressive_encoder_write_bits(state.raw, (UINT16)val, numBits);
+			}
+			else if (progressive_encoder_value(data[x], oldBits, TRUE) != 0)
+			{
+				const INT16 val = progressive_encoder_value(data[x], newBits, TRUE);
+				progressive_encoder_write_bits(state.raw, (UINT32)abs(val), numBits);
+			}
+		}
+	}
+
+	if (!progressive_encoder_bits_finish(state.raw, rawLen))
+		return FALSE;
+	Stream_Seek(s, *rawLen);
+	return TRUE;
+}
+
+static BOOL
+progressive_encoder_write_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                     wStream* WINPR_RESTRICT s,
+                                     const PROGRESSIVE_ENCODER_TILE* WINPR_RESTRICT tile)
+{
+	BOOL rc = FALSE;
+	UINT16 len[3] = { 0 };
+	RFX_COMPONENT_CODEC_QUANT prog = { 0 };
+	const size_t header = 23;
+
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(tile);
+
+	if (!Stream_EnsureRemainingCapacity(s, header + 3ull * PROGRESSIVE_ENCODER_STREAM_SIZE))
+		return FALSE;
+
+	INT16* buffer = (INT16*)BufferPool_Take(progressive->bufferPool, -1);
+	if (!buffer)
+		return FALSE;
+
+	progressive_encoder_prog_quant(progressive->numPasses, tile->level, &prog);
+
+	const size_t start = Stream_GetPosition(s);
+	Stream_Seek(s, header);
+
+	for (size_t c = 0; c < 3; c++)
+	{
+		for (size_t band = 0; band < ARRAYSIZE(progressive_rfx_bands); band++)
+		{
+			const size_t offset = progressive_rfx_bands[band].offset;
+			const UINT32 bits = progressive_rfx_quant_get(&prog, band);
+			const BOOL nonLL = (band != PROGRESSIVE_BAND_LL3);
+
+			for (size_t x = 0; x < progressive_rfx_bands[band].length; x++)
+				buffer[offset + x] =
+				    progressive_encoder_value(tile->coeffs[c][offset + x], bits, nonLL);
+		}
+
+		rfx_differential_encode(&buffer[4015], 81);
+
+		BYTE* dst = Stream_Pointer(s);
+		const int status = progressive->rfx_context->rlgr_encode(
+		    RLGR1, buffer, 4096, dst, PROGRESSIVE_ENCODER_STREAM_SIZE);
+		if ((status < 0) || (status >= PROGRESSIVE_ENCODER_STREAM_SIZE))
+			goto fail;
+
+		len[c] = WINPR_ASSERTING_INT_CAST(UINT16, status);
+		Stream_Seek(s, len[c]);
+	}
+
+	const size_t end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST);                       /* blockType */
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, end - start));    /* blockLen */
+	Stream_Write_UINT8(s, 0);                                                 /* quantIdxY */
+	Stream_Write_UINT8(s, 0);                                                 /* quantIdxCb */
+	Stream_Write_UINT8(s, 0);                                                 /* quantIdxCr */
+	Stream_Write_UINT16(s, tile->xIdx);                                       /* xIdx */
+	Stream_Write_UINT16(s, tile->yIdx);                                       /* yIdx */
+	Stream_Write_UINT8(s, 0);                                                 /* flags */
+	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(UINT8, tile->level));      /* quality */
+	Stream_Write_UINT16(s, len[0]);                                           /* yLen */
+	Stream_Write_UINT16(s, len[1]);                                           /* cbLen */
+	Stream_Write_UINT16(s, len[2]);                                           /* crLen */
+	Stream_Write_UINT16(s, 0);                                                /* tailLen */
+	Stream_SetPosition(s, end);
+	rc = TRUE;
+fail:
+	BufferPool_Return(progressive->bufferPool, buffer);
+	return rc;
+}
+
+static BOOL
+progressive_encoder_write_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                       wStream* WINPR_RESTRICT s,
+                                       const PROGRESSIVE_ENCODER_TILE* WINPR_RESTRICT tile)
+{
+	UINT16 srlLen[3] = { 0 };
+	UINT16 rawLen[3] = { 0 };
+	RFX_COMPONENT_CODEC_QUANT oldProg = { 0 };
+	RFX_COMPONENT_CODEC_QUANT newProg = { 0 };
+	const size_t header = 26;
+	const UINT32 level = tile->level + 1;
+
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(level < progressive->numPasses);
+
+	if (!Stream_EnsureRemainingCapacity(s, header + 6ull * PROGRESSIVE_ENCODER_STREAM_SIZE))
+		return FALSE;
+
+	progressive_encoder_prog_quant(progressive->numPasses, tile->level, &oldProg);
+	progressive_encoder_prog_quant(progressive->numPasses, level, &newProg);
+
+	const size_t start = Stream_GetPosition(s);
+	Stream_Seek(s, header);
+
+	for (size_t c = 0; c < 3; c++)
+	{
+		if (!progressive_encoder_upgrade_component(tile->coeffs[c], &oldProg, &newProg, s,
+		                                           &srlLen[c], &rawLen[c]))
+			return FALSE;
+	}
+
+	const BYTE quality =
+	    (level + 1 < progressive->numPasses) ? WINPR_ASSERTING_INT_CAST(BYTE, level) : 0xFF;
+	const size_t end = Stream_GetPosition(s);
+	Stream_SetPosition(s, start);
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE);                  /* blockType */
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, end - start)); /* blockLen */
+	Stream_Write_UINT8(s, 0);                                              /* quantIdxY */
+	Stream_Write_UINT8(s, 0);                                              /* quantIdxCb */
+	Stream_Write_UINT8(s, 0);                                              /* quantIdxCr */
+	Stream_Write_UINT16(s, tile->xIdx);                                    /* xIdx */
+	Stream_Write_UINT16(s, tile->yIdx);                                    /* yIdx */
+	Stream_Write_UINT8(s, quality);                                        /* quality */
+	Stream_Write_UINT16(s, srlLen[0]);                                     /* ySrlLen */
+	Stream_Write_UINT16(s, rawLen[0]);                                     /* yRawLen */
+	Stream_Write_UINT16(s, srlLen[1]);                                     /* cbSrlLen */
+	Stream_Write_UINT16(s, rawLen[1]);                                     /* cbRawLen */
+	Stream_Write_UINT16(s, srlLen[2]);                                     /* crSrlLen */
+	Stream_Write_UINT16(s, rawLen[2]);                                     /* crRawLen */
+	Stream_SetPosition(s, end);
+	return TRUE;
+}
+
+static INLINE size_t progressive_encoder_message_overhead(const PROGRESSIVE_CONTEXT* progressive,
+                                                          size_t numRects)
+{
+	/* SYNC + CONTEXT + FRAME_BEGIN + REGION header + quant + FRAME_END */
+	const size_t fixed = 12ull + 10ull + 12ull + 18ull + 5ull + 6ull;
+	return fixed + 16ull * (progressive->numPasses - 1) + 8ull * numRects;
+}
+
+static BOOL progressive_encoder_write_message(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                              wStream* WINPR_RESTRICT s,
+                                              const RFX_RECT* WINPR_RESTRICT rects,
+                                              UINT16 numRects, UINT16 numTiles)
+{
+	wStream* tiles = progressive->tiles;
+	const size_t tilesDataSize = Stream_GetPosition(tiles);
+	const BYTE numProgQuant = WINPR_ASSERTING_INT_CAST(BYTE, progressive->numPasses - 1);
+	const size_t regionLen =
+	    18ull + 8ull * numRects + 5ull + 16ull * numProgQuant + tilesDataSize;
+
+	if (!Stream_EnsureRemainingCapacity(
+	        s, progressive_encoder_message_overhead(progressive, numRects) + tilesDataSize))
+		return FALSE;
+
+	/* PROGRESSIVE_WBT_SYNC */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_SYNC); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, 0xCACCACCA);           /* magic (4 bytes) */
+	Stream_Write_UINT16(s, 0x0100);               /* version (2 bytes) */
+
+	/* PROGRESSIVE_WBT_CONTEXT */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_CONTEXT); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 10);                      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
+	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
+	Stream_Write_UINT8(s, RFX_SUBBAND_DIFFING);      /* flags (1 byte) */
+
+	/* PROGRESSIVE_WBT_FRAME_BEGIN */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                          /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, progressive->frameIndex++);   /* frameIndex (4 bytes) */
+	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
+
+	/* PROGRESSIVE_WBT_REGION */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);                        /* blockType */
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, regionLen));   /* blockLen */
+	Stream_Write_UINT8(s, 64);                                             /* tileSize */
+	Stream_Write_UINT16(s, numRects);                                      /* numRects */
+	Stream_Write_UINT8(s, 1);                                              /* numQuant */
+	Stream_Write_UINT8(s, numProgQuant);                                   /* numProgQuant */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE);                     /* flags */
+	Stream_Write_UINT16(s, numTiles);                                      /* numTiles */
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, tilesDataSize)); /* tileDataSize */
+
+	for (UINT16 i = 0; i < numRects; i++)
+	{
+		const RFX_RECT* r = &rects[i];
+		Stream_Write_UINT16(s, r->x);      /* x (2 bytes) */
+		Stream_Write_UINT16(s, r->y);      /* y (2 bytes) */
+		Stream_Write_UINT16(s, r->width);  /* width (2 bytes) */
+		Stream_Write_UINT16(s, r->height); /* height (2 bytes) */
+	}
+
+	progressive_component_codec_quant_write(s, &progressive_encoder_quant);
+
+	for (BYTE level = 0; level < numProgQuant; level++)
+	{
+		RFX_COMPONENT_CODEC_QUANT prog = { 0 };
+		const UINT32 quality = (level + 1) * 100 / progressive->numPasses;
+
+		progressive_encoder_prog_quant(progressive->numPasses, level, &prog);
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, quality)); /* quality (1 byte) */
+		progressive_component_codec_quant_write(s, &prog);              /* yQuantValues */
+		progressive_component_codec_quant_write(s, &prog);              /* cbQuantValues */
+		progressive_component_codec_quant_write(s, &prog);              /* crQuantValues */
+	}
+
+	Stream_Write(s, Stream_Buffer(tiles), tilesDataSize);
+
+	/* PROGRESSIVE_WBT_FRAME_END */
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_END); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 6);                         /* blockLen (4 bytes) */
+	return TRUE;
+}
+
+static void progressive_encoder_free_tiles(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive)
+{
+	WINPR_ASSERT(progressive);
+
+	if (progressive->encoderTiles)
+	{
+		const size_t count =
+		    1ull * progressive->encoderGridWidth * progressive->encoderGridHeight;
+		for (size_t x = 0; x < count; x++)
+		{
+			if (progressive->encoderTiles[x])
+				MemoryTag_Released(progressive->memoryTag, sizeof(PROGRESSIVE_ENCODER_TILE));
+			winpr_aligned_free(progressive->encoderTiles[x]);
+		}
+	}
+
+	free((void*)progressive->encoderTiles);
+	progressive->encoderTiles = NULL;
+	progressive->encoderGridWidth = 0;
+	progressive->encoderGridHeight = 0;
+}
+
+static BOOL progressive_encoder_resize(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                       UINT32 width, UINT32 height)
+{
+	const UINT32 gridWidth = (width + 63) / 64;
+	const UINT32 gridHeight = (height + 63) / 64;
+
+	progressive->encoderWidth = width;
+	progressive->encoderHeight = height;
+
+	if (progressive->encoderTiles && (progressive->encoderGridWidth == gridWidth) &&
+	    (progressive->encoderGridHeight == gridHeight))
+		return TRUE;
+
+	progressive_encoder_free_tiles(progressive);
+	progressive->encoderTiles = (PROGRESSIVE_ENCODER_TILE**)calloc(
+	    1ull * gridWidth * gridHeight, sizeof(PROGRESSIVE_ENCODER_TILE*));
+	if (!progressive->encoderTiles)
+		return FALSE;
+
+	progressive->encoderGridWidth = gridWidth;
+	progressive->encoderGridHeight = gridHeight;
+	return TRUE;
+}
+
+static PROGRESSIVE_ENCODER_TILE*
+progressive_encoder_tile_update(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat,
+                                UINT32 ScanLine, UINT32 xIdx, UINT32 yIdx)
+{
+	union
+	{
+		const BYTE* cpv;
+		BYTE* pv;
+	} cnv;
+	RFX_TILE rtile = { 0 };
+	const size_t index = 1ull * yIdx * progressive->encoderGridWidth + xIdx;
+	PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[index];
+
+	if (!tile)
+	{
+		tile = winpr_aligned_calloc(1, sizeof(PROGRESSIVE_ENCODER_TILE), 32);
+		if (!tile)
+			return NULL;
+		MemoryTag_Allocated(progressive->memoryTag, sizeof(PROGRESSIVE_ENCODER_TILE));
+		progressive->encoderTiles[index] = tile;
+	}
+
+	const UINT32 x = xIdx * 64;
+	const UINT32 y = yIdx * 64;
+
+	tile->xIdx = WINPR_ASSERTING_INT_CAST(UINT16, xIdx);
+	tile->yIdx = WINPR_ASSERTING_INT_CAST(UINT16, yIdx);
+	tile->level = 0;
+	tile->pending = TRUE;
+
+	/* Cast away const */
+	cnv.cpv = &pSrcData[1ull * y * ScanLine + 1ull * x * FreeRDPGetBytesPerPixel(SrcFormat)];
+	rtile.data = cnv.pv;
+	rtile.width = MIN(64, progressive->encoderWidth - x);
+	rtile.height = MIN(64, progressive->encoderHeight - y);
+	rtile.scanline = ScanLine;
+
+	INT16* pSrcDst[3] = { tile->coeffs[0], tile->coeffs[1], tile->coeffs[2] };
+	rfx_encode_ycbcr(progressive->rfx_context, &rtile, pSrcDst);
+
+	INT16* temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
+	if (!temp)
+		return NULL;
+
+	for (size_t c = 0; c < 3; c++)
+	{
+		progressive->rfx_context->dwt_2d_extrapolate_encode(pSrcDst[c], temp);
+		progressive_encoder_quantize(pSrcDst[c], &progressive_encoder_quant);
+	}
+
+	BufferPool_Return(progressive->bufferPool, temp);
+	return tile;
+}
+
+static int progressive_compress_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                      const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat,
+                                      UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                                      const RFX_RECT* WINPR_RESTRICT rects, UINT32 numRects,
+                                      BYTE** WINPR_RESTRICT ppDstData,
+                                      UINT32* WINPR_RESTRICT pDstSize)
+{
+	int res = -6;
+	UINT32 numTiles = 0;
+	wStream* s = progressive->buffer;
+
+	if (numRects > UINT16_MAX)
+		return -5;
+
+	if (!progressive_encoder_resize(progressive, Width, Height))
+		return -5;
+
+	rfx_context_set_pixel_format(progressive->rfx_context, SrcFormat);
+	Stream_SetPosition(progressive->tiles, 0);
+
+	for (UINT32 i = 0; i < numRects; i++)
+	{
+		const RFX_RECT* r = &rects[i];
+
+		if ((r->width == 0) || (r->height == 0))
+			continue;
+
+		const UINT32 right = MIN(Width, 1ul * r->x + r->width);
+		const UINT32 bottom = MIN(Height, 1ul * r->y + r->height);
+
+		for (UINT32 yIdx = r->y / 64; yIdx * 64 < bottom; yIdx++)
+		{
+			for (UINT32 xIdx = r->x / 64; xIdx * 64 < right; xIdx++)
+			{
+				const size_t index = 1ull * yIdx * progressive->encoderGridWidth + xIdx;
+				PROGRESSIVE_ENCODER_TILE* cur = progressive->encoderTiles[index];
+				UINT64 hash = 0;
+
+				if (cur && cur->queued)
+					continue;
+
+				if (progressive->tileCache)
+				{
+					const UINT32 bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+					const UINT32 x = xIdx * 64;
+					const UINT32 y = yIdx * 64;
+					hash = rfx_tile_hash(&pSrcData[1ull * y * ScanLine + 1ull * x * bpp],
+					                     MIN(64, Width - x), MIN(64, Height - y), ScanLine, bpp);
+
+					/* unchanged, keep upgrading what the peer already has */
+					if (cur && (cur->hash == hash))
+					{
+						cur->queued = TRUE;
+						continue;
+					}
+				}
+
+				PROGRESSIVE_ENCODER_TILE* tile = progressive_encoder_tile_update(
+				    progressive, pSrcData, SrcFormat, ScanLine, xIdx, yIdx);
+				if (!tile)
+					goto fail;
+
+				tile->hash = hash;
+				tile->queued = TRUE;
+				if (!progressive_encoder_write_tile_first(progressive, progressive->tiles, tile))
+					goto fail;
+				numTiles++;
+			}
+		}
+	}
+
+	if (numTiles == 0)
+	{
+		res = 0;
+		goto fail;
+	}
+
+	Stream_SetPosition(s, 0);
+	if (!progressive_encoder_write_message(progressive, s, rects, (UINT16)numRects,
+	                                       WINPR_ASSERTING_INT_CAST(UINT16, numTiles)))
+		goto fail;
+
+	const size_t pos = Stream_GetPosition(s);
+	*pDstSize = WINPR_ASSERTING_INT_CAST(UINT32, pos);
+	*ppDstData = Stream_Buffer(s);
+	res = 1;
+fail:
+	for (size_t x = 0; x < 1ull * progressive->encoderGridWidth * progressive->encoderGridHeight;
+	     x++)
+	{
+		PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[x];
+		if (tile)
+			tile->queued = FALSE;
+	}
+	return res;
+}
+
+BOOL progressive_context_set_passes(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT32 passes)
+{
+	if (!progressive || (passes < 1) || (passes > PROGRESSIVE_MAX_PASSES))
+		return FALSE;
+
+	if (progressive->numPasses != passes)
+		progressive_encoder_free_tiles(progressive);
+	progressive->numPasses = passes;
+	return TRUE;
+}
+
+int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT32 maxSize,
+                                 BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+{
+	int res = -6;
+	UINT32 numTiles = 0;
+	wStream* s = NULL;
+	wStream* tiles = NULL;
+	RFX_RECT* rects = NULL;
+
+	if (!progressive || !ppDstData || !pDstSize)
+		return -1;
+
+	if (!progressive->encoderTiles)
+		return 0;
+
+	const size_t count = 1ull * progressive->encoderGridWidth * progressive->encoderGridHeight;
+	if (count > UINT16_MAX)
+		return -5;
+
+	if (!Stream_EnsureRemainingCapacity(progressive->rects, count * sizeof(RFX_RECT)))
+		return -5;
+	rects = Stream_BufferAs(progressive->rects, RFX_RECT);
+
+	s = progressive->buffer;
+	tiles = progressive->tiles;
+	Stream_SetPosition(tiles, 0);
+
+	/* Upgrade the coarsest tiles first so the quality of the surface stays uniform, at least one
+	 * tile is always sent to guarantee progress */
+	for (UINT32 level = 0; level + 1 < progressive->numPasses; level++)
+	{
+		for (size_t x = 0; x < count; x++)
+		{
+			PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[x];
+
+			if (!tile || !tile->pending || tile->queued || (tile->level != level))
+				continue;
+
+			const size_t pos = Stream_GetPosition(tiles);
+			if (!progressive_encoder_write_tile_upgrade(progressive, tiles, tile))
+				goto fail;
+
+			const size_t size =
+			    progressive_encoder_message_overhead(progressive, numTiles + 1ull) +
+			    Stream_GetPosition(tiles);
+			if ((numTiles > 0) && (size > maxSize))
+			{
+				Stream_SetPosition(tiles, pos);
+				goto out;
+			}
+
+			RFX_RECT* r = &rects[numTiles++];
+			r->x = WINPR_ASSERTING_INT_CAST(UINT16, tile->xIdx * 64);
+			r->y = WINPR_ASSERTING_INT_CAST(UINT16, tile->yIdx * 64);
+			r->width = WINPR_ASSERTING_INT_CAST(UINT16, MIN(64, progressive->encoderWidth - r->x));
+			r->height =
+			    WINPR_ASSERTING_INT_CAST(UINT16, MIN(64, progressive->encoderHeight - r->y));
+
+			tile->queued = TRUE;
+			tile->level++;
+			if (tile->level + 1 >= progressive->numPasses)
+				tile->pending = FALSE;
+		}
+	}
+
+out:
+	if (numTiles == 0)
+	{
+		res = 0;
+		goto fail;
+	}
+
+	Stream_SetPosition(s, 0);
+	if (!progressive_encoder_write_message(progressive, s, rects,
+	                                       WINPR_ASSERTING_INT_CAST(UINT16, numTiles),
+	                                       WINPR_ASSERTING_INT_CAST(UINT16, numTiles)))
+		goto fail;
+
+	const size_t pos = Stream_GetPosition(s);
+	*pDstSize = WINPR_ASSERTING_INT_CAST(UINT32, pos);
+	*ppDstData = Stream_Buffer(s);
+	res = 1;
+fail:
+	for (size_t x = 0; x < count; x++)
+	{
+		PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[x];
+		if (tile)
+			tile->queued = FALSE;
+	}
+	return res;
+}
+
 int progressive_compress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                          const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize, UINT32 SrcFormat,
                          UINT32 Width, UINT32 Height, UINT32 ScanLine,
@@ -2496,6 +3386,10 @@ int progressive_compress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 			WINPR_ASSERT(r->height <= 64);
 		}
 	}
+	if (progressive->numPasses > 1)
+		return progressive_compress_first(progressive, pSrcData, SrcFormat, Width, Height,
+		                                  ScanLine, rects, numRects, ppDstData, pDstSize);
+
 	s = progressive->buffer;
 	Stream_SetPosition(s, 0);
 
@@ -2512,6 +3406,13 @@ int progressive_compress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 		goto fail;
 	}
 
+	/* all tiles unchanged, nothing to send */
+	if (rfx_message_get_tile_count(message) == 0)
+	{
+		rfx_message_free(progressive->rfx_context, message);
+		return 0;
+	}
+
 	rc = progressive_rfx_write_message_progressive_simple(progressive, s, message);
 	rfx_message_free(progressive->rfx_context, message);
 	if (!rc)
@@ -2526,11 +3427,72 @@ fail:
 	return res;
 }
 
+BOOL progressive_context_set_tile_cache(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                        BOOL enable)
+{
+	if (!progressive || !progressive->Compressor)
+		return FALSE;
+
+	if (!rfx_context_set_tile_cache(progressive->rfx_context, enable))
+		return FALSE;
+
+	progressive->tileCache = enable;
+	if (progressive->encoderTiles)
+	{
+		const size_t count =
+		    1ull * progressive->encoderGridWidth * progressive->encoderGridHeight;
+		for (size_t x = 0; x < count; x++)
+		{
+			PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[x];
+			if (tile)
+				tile->hash = 0;
+		}
+	}
+	return TRUE;
+}
+
+void progressive_context_invalidate_tile_cache(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                               const RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	WINPR_ASSERT(progressive);
+
+	if (progressive->rfx_context)
+		rfx_context_invalidate_tile_cache(progressive->rfx_context, rect);
+
+	if (!progressive->encoderTiles)
+		return;
+
+	for (size_t x = 0; x < 1ull * progressive->encoderGridWidth * progressive->encoderGridHeight;
+	     x++)
+	{
+		PROGRESSIVE_ENCODER_TILE* tile = progressive->encoderTiles[x];
+		if (!tile)
+			continue;
+
+		if (rect)
+		{
+			const UINT32 left = tile->xIdx * 64u;
+			const UINT32 top = tile->yIdx * 64u;
+
+			if ((left >= rect->right) || (top >= rect->bottom) || (left + 64 <= rect->left) ||
+			    (top + 64 <= rect->top))
+				continue;
+		}
+
+		/* the peer content was replaced, upgrading it would restore stale data */
+		tile->hash = 0;
+		tile->pending = FALSE;
+	}
+}
+
 BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive)
 {
 	if (!progressive)
 		return FALSE;
 
+	progressive_encoder_free_tiles(progressive);
+	if (progressive->rfx_context)
+		rfx_context_invalidate_tile_cache(progressive->rfx_context, NULL);
 	return TRUE;
 }
 
@@ -2549,6 +3511,7 @@ PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 Threadin
 
 	progressive->Compressor = Compressor;
 	progressive->quantProgValFull.quality = 100;
+	progressive->numPasses = 1;
 	progressive->log = WLog_Get(TAG);
 	if (!progressive->log)
 		goto fail;
@@ -2561,9 +3524,14 @@ PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 Threadin
 	progressive->rects = Stream_New(NULL, 1024);
 	if (!progressive->rects)
 		goto fail;
+	progressive->tiles = Stream_New(NULL, 1024);
+	if (!progressive->tiles)
+		goto fail;
 	progressive->bufferPool = BufferPool_New(TRUE, (8192LL + 32LL) * 3LL, 16);
 	if (!progressive->bufferPool)
 		goto fail;
+	progressive->memoryTag = MemoryTag_Get("codec_progressive");
+	BufferPool_SetMemoryTag(progressive->bufferPool, progressive->memoryTag);
 	progressive->SurfaceContexts = HashTable_New(TRUE);
 	if (!progressive->SurfaceContexts)
 		goto fail;
@@ -2589,6 +3557,8 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 
 	Stream_Free(progressive->buffer, TRUE);
 	Stream_Free(progressive->rects, TRUE);
+	Stream_Free(progressive->tiles, TRUE);
+	progressive_encoder_free_tiles(progressive);
 	rfx_context_free(progressive->rfx_context);
 
 	BufferPool_Free(progressive->bufferPool);
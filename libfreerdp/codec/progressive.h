@@ -123,11 +123,11 @@ typedef struct
 	UINT32 height;
 	UINT32 stride;
 
-	BYTE* data;
-	BYTE* current;
+	BYTE* data; /* points into a slab of the surface */
+	BYTE* current; /* allocated on first decode, NULL once no longer needed */
 
 	UINT16 pass;
-	BYTE* sign;
+	BYTE* sign; /* allocated on first decode, NULL once the tile reached full quality */
 
 	RFX_COMPONENT_CODEC_QUANT yBitPos;
 	RFX_COMPONENT_CODEC_QUANT cbBitPos;
@@ -148,7 +148,6 @@ typedef struct
 	PROGRESSIVE_CONTEXT* progressive;
 	PROGRESSIVE_BLOCK_REGION* region;
 	const PROGRESSIVE_BLOCK_CONTEXT* context;
-	RFX_PROGRESSIVE_TILE* tile;
 } PROGRESSIVE_TILE_PROCESS_WORK_PARAM;
 
 struct S_PROGRESSIVE_BLOCK_REGION
@@ -196,11 +195,26 @@ typedef struct
 	UINT32 gridSize;
 	RFX_PROGRESSIVE_TILE** tiles;
 	size_t tilesSize;
+	BYTE** slabs; /* tile structs and pixel data, one slab per tile cache growth */
+	size_t numSlabs;
+	size_t slabBytes;
 	UINT32 frameId;
 	UINT32 numUpdatedTiles;
 	UINT32* updatedTileIndices;
+	wMemoryTag* memoryTag;
 } PROGRESSIVE_SURFACE_CONTEXT;
 
+typedef struct
+{
+	INT16 coeffs[3][4096];
+	UINT16 xIdx;
+	UINT16 yIdx;
+	UINT32 level;
+	BOOL pending;
+	BOOL queued;
+	UINT64 hash;
+} PROGRESSIVE_ENCODER_TILE;
+
 typedef enum
 {
 	FLAG_WBT_SYNC = 0x01,
@@ -215,6 +229,7 @@ struct S_PROGRESSIVE_CONTEXT
 	BOOL Compressor;
 
 	wBufferPool* bufferPool;
+	wMemoryTag* memoryTag;
 
 	UINT32 format;
 	UINT32 state;
@@ -228,8 +243,17 @@ struct S_PROGRESSIVE_CONTEXT
 	wStream* buffer;
 	wStream* rects;
 	RFX_CONTEXT* rfx_context;
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM params[0x10000];
-	PTP_WORK work_objects[0x10000];
+
+	/* multi-pass encoder state */
+	BOOL tileCache;
+	UINT32 numPasses;
+	UINT32 frameIndex;
+	UINT32 encoderWidth;
+	UINT32 encoderHeight;
+	UINT32 encoderGridWidth;
+	UINT32 encoderGridHeight;
+	PROGRESSIVE_ENCODER_TILE** encoderTiles;
+	wStream* tiles;
 };
 
 #endif /* INTERNAL_CODEC_PROGRESSIVE_H */
@@ -72,6 +72,9 @@ struct S_REGION16_DATA
 {
 	size_t nbRects;
 	RECTANGLE_16* rects;
+	size_t capacity;
+	BYTE* scratch;
+	size_t scratchSize;
 };
 
 void region16_init(REGION16* region)
@@ -188,7 +191,10 @@ BOOL rectangles_intersection(const RECTANGLE_16* r1, const RECTANGLE_16* r2, REC
 static void freeRegion(REGION16_DATA* data)
 {
 	if (data)
+	{
 		free(data->rects);
+		free(data->scratch);
+	}
 	free(data);
 }
 
@@ -203,6 +209,17 @@ void region16_clear(REGION16* region)
 	region->extents = empty;
 }
 
+void region16_reset(REGION16* region)
+{
+	WINPR_ASSERT(region);
+
+	if (region->data)
+		region->data->nbRects = 0;
+
+	const RECTANGLE_16 empty = { 0 };
+	region->extents = empty;
+}
+
 WINPR_ATTR_MALLOC(freeRegion, 1)
 static REGION16_DATA* allocateRegion(size_t nbItems)
 {
@@ -221,25 +238,41 @@ static REGION16_DATA* allocateRegion(size_t nbItems)
 	}
 
 	data->nbRects = nbItems;
+	data->capacity = nbItems;
 	return data;
 }
 
+/* grows the storage geometrically, the content up to nbRects is kept */
+static BOOL reserveRects(REGION16_DATA* data, size_t nbItems)
+{
+	WINPR_ASSERT(data);
+	if (nbItems <= data->capacity)
+		return TRUE;
+
+	const size_t capacity = MAX(nbItems, 2 * data->capacity);
+	RECTANGLE_16* rects = realloc(data->rects, capacity * sizeof(RECTANGLE_16));
+	if (!rects)
+		return FALSE;
+
+	data->rects = rects;
+	data->capacity = capacity;
+	return TRUE;
+}
+
 static inline RECTANGLE_16* nextRect(REGION16_DATA* data, size_t index)
 {
 	WINPR_ASSERT(data);
 	if (index + 1 > data->nbRects)
 	{
-		RECTANGLE_16* rects = realloc(data->rects, (index + 1) * sizeof(RECTANGLE_16));
-		if (!rects)
+		if (!reserveRects(data, index + 1))
 		{
 			freeRegion(data);
 			return NULL;
 		}
 
 		const RECTANGLE_16 empty = { 0 };
-		rects[index] = empty;
+		data->rects[index] = empty;
 		data->nbRects = index + 1;
-		data->rects = rects;
 	}
 	return &data->rects[index];
 }
@@ -260,40 +293,66 @@ static BOOL resizeRegion(REGION16* region, size_t nbItems)
 		return region->data != NULL;
 	}
 
-	RECTANGLE_16* rects = realloc(region->data->rects, nbItems * sizeof(RECTANGLE_16));
-	if (!rects)
+	if (!reserveRects(region->data, nbItems))
 	{
-		free(region->data->rects);
 		region->data->nbRects = 0;
-		region->data->rects = NULL;
 		return FALSE;
 	}
 
 	for (size_t x = region->data->nbRects; x < nbItems; x++)
 	{
 		const RECTANGLE_16 empty = { 0 };
-		rects[x] = empty;
+		region->data->rects[x] = empty;
 	}
-	region->data->rects = rects;
 	region->data->nbRects = nbItems;
 	return TRUE;
 }
 
+/* replaces the rectangles of region, keeping the scratch memory of the old data */
+static void replaceRegionData(REGION16* region, REGION16_DATA* data)
+{
+	WINPR_ASSERT(region);
+	WINPR_ASSERT(data);
+
+	REGION16_DATA* old = region->data;
+	region->data = data;
+	if (!old)
+		return;
+
+	data->scratch = old->scratch;
+	data->scratchSize = old->scratchSize;
+	old->scratch = NULL;
+	freeRegion(old);
+}
+
 static inline BOOL region16_copy_data(REGION16* dst, const REGION16* src)
 {
 	WINPR_ASSERT(dst);
 	WINPR_ASSERT(src);
 
-	freeRegion(dst->data);
-	dst->data = NULL;
+	if (!src->data || (src->data->nbRects == 0))
+	{
+		if (dst->data)
+			dst->data->nbRects = 0;
+		return TRUE;
+	}
 
-	if (src->data && (src->data->nbRects > 0))
+	/* reuse the destination storage if it is large enough */
+	if (!dst->data)
 	{
-		dst->data = allocateRegion(src->data->nbRects);
-		if (!dst->data || !dst->data->rects)
+		dst->data = allocateRegion(0);
+		if (!dst->data)
 			return FALSE;
-		memcpy(dst->data->rects, src->data->rects, dst->data->nbRects * sizeof(RECTANGLE_16));
 	}
+
+	if (!reserveRects(dst->data, src->data->nbRects))
+	{
+		dst->data->nbRects = 0;
+		return FALSE;
+	}
+
+	dst->data->nbRects = src->data->nbRects;
+	memcpy(dst->data->rects, src->data->rects, dst->data->nbRects * sizeof(RECTANGLE_16));
 	return TRUE;
 }
 
@@ -759,12 +818,214 @@ BOOL region16_union_rect(REGION16* dst, const REGION16* src, const RECTANGLE_16*
 	dstExtents->right = MAX(rect->right, srcExtents->right);
 
 	newItems->nbRects = usedRects;
-	freeRegion(dst->data);
-	dst->data = newItems;
+	replaceRegionData(dst, newItems);
 
 	return region16_simplify_bands(dst);
 }
 
+static int region16_compare_rect_top(const void* pva, const void* pvb)
+{
+	const RECTANGLE_16* a = pva;
+	const RECTANGLE_16* b = pvb;
+	if (a->top != b->top)
+		return (a->top < b->top) ? -1 : 1;
+	if (a->left != b->left)
+		return (a->left < b->left) ? -1 : 1;
+	return 0;
+}
+
+static int region16_compare_uint16(const void* pva, const void* pvb)
+{
+	const UINT16* a = pva;
+	const UINT16* b = pvb;
+	return (int)*a - (int)*b;
+}
+
+/* appends the x-merged items of the active rectangles as band [top, bottom)
+ * and coalesces it with the previous band if they touch and have the same items */
+static BOOL region16_emit_band(REGION16_DATA* data, const RECTANGLE_16* input,
+                               const UINT32* active, size_t nbActive, UINT16 top, UINT16 bottom,
+                               size_t* prevBand, size_t* prevCount)
+{
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(input);
+	WINPR_ASSERT(active);
+	WINPR_ASSERT(prevBand);
+	WINPR_ASSERT(prevCount);
+
+	const size_t start = data->nbRects;
+	if (!reserveRects(data, start + nbActive))
+		return FALSE;
+
+	RECTANGLE_16* band = &data->rects[start];
+	size_t count = 0;
+	for (size_t x = 0; x < nbActive; x++)
+	{
+		const RECTANGLE_16* cur = &input[active[x]];
+
+		/* items of a band must not touch, so merge adjacent ones as well */
+		if ((count > 0) && (cur->left <= band[count - 1].right))
+		{
+			band[count - 1].right = MAX(band[count - 1].right, cur->right);
+			continue;
+		}
+
+		band[count].left = cur->left;
+		band[count].right = cur->right;
+		band[count].top = top;
+		band[count].bottom = bottom;
+		count++;
+	}
+
+	RECTANGLE_16* prev = &data->rects[*prevBand];
+	if ((*prevCount == count) && (count > 0) && (prev->bottom == top))
+	{
+		BOOL match = TRUE;
+		for (size_t x = 0; match && (x < count); x++)
+			match = (prev[x].left == band[x].left) && (prev[x].right == band[x].right);
+
+		if (match)
+		{
+			for (size_t x = 0; x < count; x++)
+				prev[x].bottom = bottom;
+			return TRUE;
+		}
+	}
+
+	*prevBand = start;
+	*prevCount = count;
+	data->nbRects = start + count;
+	return TRUE;
+}
+
+BOOL region16_union_rects(REGION16* dst, const REGION16* src, const RECTANGLE_16* rects,
+                          UINT32 count)
+{
+	UINT32 srcNbRects = 0;
+
+	WINPR_ASSERT(dst);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(rects || (count == 0));
+
+	const RECTANGLE_16* srcRects = region16_rects(src, &srcNbRects);
+	const size_t total = 1ull * srcNbRects + count;
+	if (total == 0)
+	{
+		region16_reset(dst);
+		return TRUE;
+	}
+
+	if (!dst->data)
+	{
+		dst->data = allocateRegion(0);
+		if (!dst->data)
+			return FALSE;
+	}
+
+	/* the scratch holds the active list, a copy of all input rectangles and their y edges.
+	 * As the input is copied dst can be written to even if it is src. */
+	REGION16_DATA* data = dst->data;
+	const size_t scratchSize = total * (sizeof(UINT32) + sizeof(RECTANGLE_16) + 2 * sizeof(UINT16));
+	if (data->scratchSize < scratchSize)
+	{
+		BYTE* scratch = realloc(data->scratch, scratchSize);
+		if (!scratch)
+			return FALSE;
+		data->scratch = scratch;
+		data->scratchSize = scratchSize;
+	}
+
+	UINT32* active = (UINT32*)data->scratch;
+	RECTANGLE_16* input = (RECTANGLE_16*)&data->scratch[total * sizeof(UINT32)];
+	UINT16* edges =
+	    (UINT16*)&data->scratch[total * (sizeof(UINT32) + sizeof(RECTANGLE_16))];
+
+	size_t nbInput = 0;
+	for (size_t x = 0; x < total; x++)
+	{
+		const RECTANGLE_16* rect = (x < srcNbRects) ? &srcRects[x] : &rects[x - srcNbRects];
+		if (rectangle_is_empty(rect))
+			continue;
+
+		input[nbInput] = *rect;
+		edges[2 * nbInput] = rect->top;
+		edges[2 * nbInput + 1] = rect->bottom;
+		nbInput++;
+	}
+
+	data->nbRects = 0;
+	const RECTANGLE_16 empty = { 0 };
+	dst->extents = empty;
+	if (nbInput == 0)
+		return TRUE;
+
+	qsort(input, nbInput, sizeof(RECTANGLE_16), region16_compare_rect_top);
+	qsort(edges, 2 * nbInput, sizeof(UINT16), region16_compare_uint16);
+
+	size_t nbEdges = 1;
+	for (size_t x = 1; x < 2 * nbInput; x++)
+	{
+		if (edges[x] != edges[nbEdges - 1])
+			edges[nbEdges++] = edges[x];
+	}
+
+	/* sweep down the y edges, the active list keeps the rectangles covering the
+	 * current band sorted by their left side */
+	size_t nbActive = 0;
+	size_t next = 0;
+	size_t prevBand = 0;
+	size_t prevCount = 0;
+	for (size_t y = 0; y + 1 < nbEdges; y++)
+	{
+		const UINT16 top = edges[y];
+		const UINT16 bottom = edges[y + 1];
+
+		size_t kept = 0;
+		for (size_t x = 0; x < nbActive; x++)
+		{
+			if (input[active[x]].bottom > top)
+				active[kept++] = active[x];
+		}
+		nbActive = kept;
+
+		while ((next < nbInput) && (input[next].top <= top))
+		{
+			size_t pos = nbActive++;
+			while ((pos > 0) && (input[active[pos - 1]].left > input[next].left))
+			{
+				active[pos] = active[pos - 1];
+				pos--;
+			}
+			active[pos] = WINPR_ASSERTING_INT_CAST(UINT32, next);
+			next++;
+		}
+
+		if (nbActive == 0)
+			continue;
+
+		if (!region16_emit_band(data, input, active, nbActive, top, bottom, &prevBand,
+		                        &prevCount))
+		{
+			data->nbRects = 0;
+			return FALSE;
+		}
+	}
+
+	const RECTANGLE_16* first = &data->rects[0];
+	const RECTANGLE_16* last = &data->rects[data->nbRects - 1];
+	dst->extents.top = first->top;
+	dst->extents.bottom = last->bottom;
+	dst->extents.left = first->left;
+	dst->extents.right = first->right;
+	for (size_t x = 1; x < data->nbRects; x++)
+	{
+		dst->extents.left = MIN(dst->extents.left, data->rects[x].left);
+		dst->extents.right = MAX(dst->extents.right, data->rects[x].right);
+	}
+
+	return TRUE;
+}
+
 BOOL region16_intersects_rect(const REGION16* src, const RECTANGLE_16* arg2)
 {
 	const RECTANGLE_16* endPtr = NULL;
@@ -871,8 +1132,7 @@ BOOL region16_intersect_rect(REGION16* dst, const REGION16* src, const RECTANGLE
 
 	newItems->nbRects = usedRects;
 
-	freeRegion(dst->data);
-	dst->data = newItems;
+	replaceRegionData(dst, newItems);
 	dst->extents = newExtents;
 	return region16_simplify_bands(dst);
 }
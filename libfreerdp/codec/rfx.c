@@ -49,6 +49,7 @@
 #include "rfx_rlgr.h"
 
 #include "sse/rfx_sse2.h"
+#include "sse/rfx_avx2.h"
 #include "neon/rfx_neon.h"
 
 #define TAG FREERDP_TAG("codec")
@@ -258,13 +259,16 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	 * that are actually in front/beyond the buffer. Offset calculations are
 	 * performed at the BufferPool_Take function calls in rfx_encode/decode.c.
 	 *
-	 * We then multiply by 3 to use a single, partionned buffer for all 3 channels.
+	 * We then multiply by 4 to use a single, partionned buffer for all 3 channels
+	 * and the dwt_buffer, so decoding a tile works in one cache friendly block.
 	 */
-	priv->BufferPool = BufferPool_New(TRUE, (8192ULL + 32ULL) * 3ULL, 16);
+	priv->BufferPool = BufferPool_New(TRUE, (8192ULL + 32ULL) * 4ULL, 16);
 
 	if (!priv->BufferPool)
 		goto fail;
 
+	BufferPool_SetMemoryTag(priv->BufferPool, MemoryTag_Get("codec_rfx"));
+
 	if (!(ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS))
 	{
 		priv->UseThreads = TRUE;
@@ -318,6 +322,9 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 
 		if (priv->MaxThreadCount)
 			SetThreadpoolThreadMaximum(priv->ThreadPool, priv->MaxThreadCount);
+
+		if (!(priv->ParallelFor = winpr_ParallelFor_New(&priv->ThreadPoolEnv)))
+			goto fail;
 	}
 
 	/* initialize the default pixel format */
@@ -330,9 +337,13 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	context->dwt_2d_decode = rfx_dwt_2d_decode;
 	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode;
 	context->dwt_2d_encode = rfx_dwt_2d_encode;
+	context->dwt_2d_extrapolate_encode = rfx_dwt_2d_extrapolate_encode;
 	context->rlgr_decode = rfx_rlgr_decode;
 	context->rlgr_encode = rfx_rlgr_encode;
 	rfx_init_sse2(context);
+#if defined(WITH_AVX2)
+	rfx_init_avx2(context);
+#endif
 	rfx_init_neon(context);
 	context->state = RFX_STATE_SEND_HEADERS;
 	context->expectedDataBlockType = WBT_FRAME_BEGIN;
@@ -370,11 +381,10 @@ void rfx_context_free(RFX_CONTEXT* context)
 		ObjectPool_Free(priv->TilePool);
 		if (priv->UseThreads)
 		{
+			winpr_ParallelFor_Free(priv->ParallelFor);
 			if (priv->ThreadPool)
 				CloseThreadpool(priv->ThreadPool);
 			DestroyThreadpoolEnvironment(&priv->ThreadPoolEnv);
-			winpr_aligned_free((void*)priv->workObjects);
-			winpr_aligned_free(priv->tileWorkParams);
 #ifdef WITH_PROFILER
 			WLog_VRB(
 			    TAG,
@@ -383,6 +393,7 @@ void rfx_context_free(RFX_CONTEXT* context)
 		}
 
 		BufferPool_Free(priv->BufferPool);
+		free(priv->TileHashes);
 		winpr_aligned_free(priv);
 	}
 	winpr_aligned_free(context);
@@ -450,6 +461,7 @@ BOOL rfx_context_reset(RFX_CONTEXT* WINPR_RESTRICT context, UINT32 width, UINT32
 	context->state = RFX_STATE_SEND_HEADERS;
 	context->expectedDataBlockType = WBT_FRAME_BEGIN;
 	context->frameIdx = 0;
+	rfx_context_invalidate_tile_cache(context, NULL);
 	return TRUE;
 }
 
@@ -796,17 +808,32 @@ static INLINE BOOL rfx_process_message_region(RFX_CONTEXT* WINPR_RESTRICT contex
 
 typedef struct
 {
-	RFX_TILE* tile;
 	RFX_CONTEXT* context;
-} RFX_TILE_PROCESS_WORK_PARAM;
+	RFX_MESSAGE* message;
+} RFX_TILE_WORK_PARAM;
 
-static INLINE void CALLBACK
-rfx_process_message_tile_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
-                                       void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+static BOOL rfx_process_message_tiles_callback(void* arg, size_t begin, size_t end)
 {
-	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
+	RFX_TILE_WORK_PARAM* param = (RFX_TILE_WORK_PARAM*)arg;
 	WINPR_ASSERT(param);
-	rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4);
+
+	for (size_t i = begin; i < end; i++)
+	{
+		RFX_TILE* tile = param->message->tiles[i];
+		rfx_decode_rgb(param->context, tile, tile->data, 64 * 4);
+	}
+	return TRUE;
+}
+
+BOOL rfx_context_process_tiles(RFX_CONTEXT* WINPR_RESTRICT context, size_t count,
+                               WINPR_PARALLEL_FOR_CALLBACK fn, void* arg)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+
+	if (context->priv->UseThreads)
+		return winpr_ParallelFor(context->priv->ParallelFor, count, 1, fn, arg);
+	return fn(arg, 0, count);
 }
 
 static INLINE BOOL rfx_allocate_tiles(RFX_MESSAGE* WINPR_RESTRICT message, size_t count,
@@ -837,7 +864,6 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
                                                UINT16* WINPR_RESTRICT pExpectedBlockType)
 {
 	BOOL rc = 0;
-	size_t close_cnt = 0;
 	BYTE quant = 0;
 	RFX_TILE* tile = NULL;
 	UINT32* quants = NULL;
@@ -846,8 +872,6 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	UINT32 blockLen = 0;
 	UINT32 blockType = 0;
 	UINT32 tilesDataSize = 0;
-	PTP_WORK* work_objects = NULL;
-	RFX_TILE_PROCESS_WORK_PARAM* params = NULL;
 	void* pmem = NULL;
 
 	WINPR_ASSERT(context);
@@ -940,27 +964,7 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	if (!rfx_allocate_tiles(message, numTiles, FALSE))
 		return FALSE;
 
-	if (context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*)winpr_aligned_calloc(message->numTiles, sizeof(PTP_WORK), 32);
-		params = (RFX_TILE_PROCESS_WORK_PARAM*)winpr_aligned_recalloc(
-		    NULL, message->numTiles, sizeof(RFX_TILE_PROCESS_WORK_PARAM), 32);
-
-		if (!work_objects)
-		{
-			winpr_aligned_free(params);
-			return FALSE;
-		}
-
-		if (!params)
-		{
-			winpr_aligned_free((void*)work_objects);
-			return FALSE;
-		}
-	}
-
 	/* tiles */
-	close_cnt = 0;
 	rc = FALSE;
 
 	if (Stream_GetRemainingLength(s) >= tilesDataSize)
@@ -1074,49 +1078,16 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 			}
 			tile->x = tile->xIdx * 64;
 			tile->y = tile->yIdx * 64;
-
-			if (context->priv->UseThreads)
-			{
-				if (!params)
-				{
-					rc = FALSE;
-					break;
-				}
-
-				params[i].context = context;
-				params[i].tile = message->tiles[i];
-
-				if (!(work_objects[i] =
-				          CreateThreadpoolWork(rfx_process_message_tile_work_callback,
-				                               (void*)&params[i], &context->priv->ThreadPoolEnv)))
-				{
-					WLog_Print(context->priv->log, WLOG_ERROR, "CreateThreadpoolWork failed.");
-					rc = FALSE;
-					break;
-				}
-
-				SubmitThreadpoolWork(work_objects[i]);
-				close_cnt = i + 1;
-			}
-			else
-			{
-				rfx_decode_rgb(context, tile, tile->data, 64 * 4);
-			}
 		}
 	}
 
-	if (context->priv->UseThreads)
+	if (rc)
 	{
-		for (size_t i = 0; i < close_cnt; i++)
-		{
-			WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
-			CloseThreadpoolWork(work_objects[i]);
-		}
+		RFX_TILE_WORK_PARAM param = { context, message };
+		rc = rfx_context_process_tiles(context, message->numTiles,
+		                               rfx_process_message_tiles_callback, &param);
 	}
 
-	winpr_aligned_free((void*)work_objects);
-	winpr_aligned_free(params);
-
 	for (size_t i = 0; i < message->numTiles; i++)
 	{
 		if (!(tile = message->tiles[i]))
@@ -1579,19 +1550,14 @@ static INLINE BOOL rfx_write_tile(wStream* WINPR_RESTRICT s, const RFX_TILE* WIN
 	return TRUE;
 }
 
-struct S_RFX_TILE_COMPOSE_WORK_PARAM
-{
-	RFX_TILE* tile;
-	RFX_CONTEXT* context;
-};
-
-static INLINE void CALLBACK
-rfx_compose_message_tile_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
-                                       void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+static BOOL rfx_compose_message_tiles_callback(void* arg, size_t begin, size_t end)
 {
-	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*)context;
+	RFX_TILE_WORK_PARAM* param = (RFX_TILE_WORK_PARAM*)arg;
 	WINPR_ASSERT(param);
-	rfx_encode_rgb(param->context, param->tile);
+
+	for (size_t i = begin; i < end; i++)
+		rfx_encode_rgb(param->context, param->message->tiles[i]);
+	return TRUE;
 }
 
 static INLINE BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t numRects,
@@ -1619,29 +1585,106 @@ static INLINE BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t nu
 
 #define TILE_NO(v) ((v) / 64)
 
-static INLINE BOOL setupWorkers(RFX_CONTEXT* WINPR_RESTRICT context, size_t nbTiles)
+static INLINE BOOL rfx_tile_cache_resize(RFX_CONTEXT_PRIV* WINPR_RESTRICT priv, UINT32 width,
+                                         UINT32 height)
 {
-	WINPR_ASSERT(context);
-
-	RFX_CONTEXT_PRIV* priv = context->priv;
 	WINPR_ASSERT(priv);
 
-	void* pmem = NULL;
+	const UINT32 gridWidth = TILE_NO(width + 63);
+	const UINT32 gridHeight = TILE_NO(height + 63);
 
-	if (!context->priv->UseThreads)
+	if (priv->TileHashes && (priv->TileHashesWidth == gridWidth) &&
+	    (priv->TileHashesHeight == gridHeight))
 		return TRUE;
 
-	if (!(pmem = winpr_aligned_recalloc((void*)priv->workObjects, nbTiles, sizeof(PTP_WORK), 32)))
-		return FALSE;
+	free(priv->TileHashes);
+	priv->TileHashes = calloc(1ull * gridWidth * gridHeight, sizeof(UINT64));
+	priv->TileHashesWidth = priv->TileHashes ? gridWidth : 0;
+	priv->TileHashesHeight = priv->TileHashes ? gridHeight : 0;
+	return priv->TileHashes != NULL;
+}
 
-	priv->workObjects = (PTP_WORK*)pmem;
+/* Restrict the message rectangles to the tiles that are actually part of the message. */
+static INLINE BOOL rfx_message_clip_rects(RFX_MESSAGE* WINPR_RESTRICT message,
+                                          const REGION16* WINPR_RESTRICT rectsRegion)
+{
+	BOOL rc = FALSE;
+	size_t count = 0;
+	size_t capacity = 0;
+	RECTANGLE_16* clipRects = NULL;
+	REGION16 tileRegion = { 0 };
+	REGION16 clipped = { 0 };
 
-	if (!(pmem = winpr_aligned_recalloc(priv->tileWorkParams, nbTiles,
-	                                    sizeof(RFX_TILE_COMPOSE_WORK_PARAM), 32)))
-		return FALSE;
+	WINPR_ASSERT(message);
 
-	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*)pmem;
-	return TRUE;
+	region16_init(&tileRegion);
+	region16_init(&clipped);
+
+	for (UINT16 i = 0; i < message->numTiles; i++)
+	{
+		const RFX_TILE* tile = message->tiles[i];
+		const RECTANGLE_16 tileRect = { tile->x, tile->y,
+			                            WINPR_ASSERTING_INT_CAST(UINT16, tile->x + tile->width),
+			                            WINPR_ASSERTING_INT_CAST(UINT16, tile->y + tile->height) };
+
+		if (!region16_intersect_rect(&tileRegion, rectsRegion, &tileRect))
+			goto fail;
+
+		UINT32 nbRects = 0;
+		const RECTANGLE_16* rects = region16_rects(&tileRegion, &nbRects);
+		if (count + nbRects > capacity)
+		{
+			const size_t newCapacity = MAX(count + nbRects, capacity * 2);
+			RECTANGLE_16* tmp = realloc(clipRects, newCapacity * sizeof(RECTANGLE_16));
+			if (!tmp)
+				goto fail;
+			clipRects = tmp;
+			capacity = newCapacity;
+		}
+
+		if (nbRects > 0)
+			memcpy(&clipRects[count], rects, nbRects * sizeof(RECTANGLE_16));
+		count += nbRects;
+	}
+
+	if (count > UINT32_MAX)
+		goto fail;
+
+	if (!region16_union_rects(&clipped, &clipped, clipRects, (UINT32)count))
+		goto fail;
+
+	UINT32 nbRects = 0;
+	const RECTANGLE_16* rects = region16_rects(&clipped, &nbRects);
+	if (nbRects > UINT16_MAX)
+		goto fail;
+
+	winpr_aligned_free(message->rects);
+	message->rects = NULL;
+	message->numRects = 0;
+
+	if (nbRects > 0)
+	{
+		message->rects = winpr_aligned_calloc(nbRects, sizeof(RFX_RECT), 32);
+		if (!message->rects)
+			goto fail;
+	}
+
+	for (UINT32 i = 0; i < nbRects; i++)
+	{
+		RFX_RECT* rfxRect = &message->rects[i];
+		rfxRect->x = rects[i].left;
+		rfxRect->y = rects[i].top;
+		rfxRect->width = rects[i].right - rects[i].left;
+		rfxRect->height = rects[i].bottom - rects[i].top;
+	}
+	message->numRects = (UINT16)nbRects;
+	rc = TRUE;
+
+fail:
+	free(clipRects);
+	region16_uninit(&clipped);
+	region16_uninit(&tileRegion);
+	return rc;
 }
 
 static INLINE BOOL rfx_ensure_tiles(RFX_MESSAGE* WINPR_RESTRICT message, size_t count)
@@ -1663,13 +1706,13 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	const UINT32 height = h;
 	const UINT32 scanline = (UINT32)s;
 	RFX_MESSAGE* message = NULL;
-	PTP_WORK* workObject = NULL;
-	RFX_TILE_COMPOSE_WORK_PARAM* workParam = NULL;
 	BOOL success = FALSE;
 	REGION16 rectsRegion = { 0 };
 	REGION16 tilesRegion = { 0 };
 	RECTANGLE_16 currentTileRect = { 0 };
 	const RECTANGLE_16* regionRect = NULL;
+	UINT64* tileHashes = NULL;
+	UINT32 skippedTiles = 0;
 
 	WINPR_ASSERT(data);
 	WINPR_ASSERT(rects);
@@ -1721,13 +1764,11 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	if (!rfx_ensure_tiles(message, maxNbTiles))
 		goto skip_encoding_loop;
 
-	if (!setupWorkers(context, maxNbTiles))
-		goto skip_encoding_loop;
-
-	if (context->priv->UseThreads)
+	if (context->priv->TileCache)
 	{
-		workObject = context->priv->workObjects;
-		workParam = context->priv->tileWorkParams;
+		if (!rfx_tile_cache_resize(context->priv, width, height))
+			goto skip_encoding_loop;
+		tileHashes = context->priv->TileHashes;
 	}
 
 	UINT32 regionNbRects = 0;
@@ -1783,6 +1824,26 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 				if (region16_intersects_rect(&tilesRegion, &currentTileRect))
 					continue;
 
+				/* skip tiles that did not change since they were encoded last */
+				if (tileHashes)
+				{
+					const size_t index = 1ull * yIdx * context->priv->TileHashesWidth + xIdx;
+					const size_t offset = (1ull * gridRelY * scanline) + (gridRelX * bytesPerPixel);
+					const UINT64 hash = rfx_tile_hash(&data[offset], tileWidth, tileHeight,
+					                                  scanline, bytesPerPixel);
+					UINT64* cached = &tileHashes[index];
+
+					if (*cached == hash)
+					{
+						skippedTiles++;
+						if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
+							goto skip_encoding_loop;
+						continue;
+					}
+
+					*cached = hash;
+				}
+
 				RFX_TILE* tile = (RFX_TILE*)ObjectPool_Take(context->priv->TilePool);
 				if (!tile)
 					goto skip_encoding_loop;
@@ -1823,55 +1884,31 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 					goto skip_encoding_loop;
 				message->tiles[message->numTiles++] = tile;
 
-				if (context->priv->UseThreads)
-				{
-					workParam->context = context;
-					workParam->tile = tile;
-
-					if (!(*workObject = CreateThreadpoolWork(rfx_compose_message_tile_work_callback,
-					                                         (void*)workParam,
-					                                         &context->priv->ThreadPoolEnv)))
-					{
-						goto skip_encoding_loop;
-					}
-
-					SubmitThreadpoolWork(*workObject);
-					workObject++;
-					workParam++;
-				}
-				else
-				{
-					rfx_encode_rgb(context, tile);
-				}
-
 				if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
 					goto skip_encoding_loop;
 			} /* xIdx */
 		}     /* yIdx */
 	}         /* rects */
 
+	{
+		RFX_TILE_WORK_PARAM param = { context, message };
+		if (!rfx_context_process_tiles(context, message->numTiles,
+		                               rfx_compose_message_tiles_callback, &param))
+			goto skip_encoding_loop;
+	}
+
+	if ((skippedTiles > 0) && !rfx_message_clip_rects(message, &rectsRegion))
+		goto skip_encoding_loop;
+
 	success = TRUE;
 skip_encoding_loop:
 
-	/* when using threads ensure all computations are done */
 	if (success)
 	{
 		message->tilesDataSize = 0;
-		workObject = context->priv->workObjects;
 
 		for (UINT32 i = 0; i < message->numTiles; i++)
 		{
-			if (context->priv->UseThreads)
-			{
-				if (*workObject)
-				{
-					WaitForThreadpoolWorkCallbacks(*workObject, FALSE);
-					CloseThreadpoolWork(*workObject);
-				}
-
-				workObject++;
-			}
-
 			const RFX_TILE* tile = message->tiles[i];
 			const size_t tlen = rfx_tile_length(tile);
 			message->tilesDataSize += WINPR_ASSERTING_INT_CAST(uint32_t, tlen);
@@ -1885,6 +1922,8 @@ skip_encoding_loop:
 
 	WLog_Print(context->priv->log, WLOG_ERROR, "failed");
 
+	/* the peer did not get the tiles we already hashed */
+	rfx_context_invalidate_tile_cache(context, NULL);
 	rfx_message_free(context, message);
 	region16_uninit(&tilesRegion);
 	region16_uninit(&rectsRegion);
@@ -2211,6 +2250,13 @@ BOOL rfx_compose_message(RFX_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 	if (!message)
 		return FALSE;
 
+	/* all tiles unchanged, nothing to send */
+	if (message->numTiles == 0)
+	{
+		rfx_message_free(context, message);
+		return TRUE;
+	}
+
 	const BOOL ret = rfx_write_message(context, s, message);
 	rfx_message_free(context, message);
 	return ret;
@@ -2235,6 +2281,91 @@ UINT32 rfx_context_get_frame_idx(const RFX_CONTEXT* WINPR_RESTRICT context)
 	return context->frameIdx;
 }
 
+BOOL rfx_context_set_tile_cache(RFX_CONTEXT* WINPR_RESTRICT context, BOOL enable)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->priv);
+
+	if (!context->encoder)
+		return FALSE;
+
+	context->priv->TileCache = enable;
+	if (!enable)
+	{
+		free(context->priv->TileHashes);
+		context->priv->TileHashes = NULL;
+		context->priv->TileHashesWidth = 0;
+		context->priv->TileHashesHeight = 0;
+	}
+	return TRUE;
+}
+
+void rfx_context_invalidate_tile_cache(RFX_CONTEXT* WINPR_RESTRICT context,
+                                       const RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	WINPR_ASSERT(context);
+
+	RFX_CONTEXT_PRIV* priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	if (!priv->TileHashes)
+		return;
+
+	if (!rect)
+	{
+		memset(priv->TileHashes, 0,
+		       sizeof(UINT64) * priv->TileHashesWidth * priv->TileHashesHeight);
+		return;
+	}
+
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+		return;
+
+	const UINT32 endX = MIN(priv->TileHashesWidth, TILE_NO(rect->right - 1) + 1);
+	const UINT32 endY = MIN(priv->TileHashesHeight, TILE_NO(rect->bottom - 1) + 1);
+	for (UINT32 y = TILE_NO(rect->top); y < endY; y++)
+	{
+		for (UINT32 x = TILE_NO(rect->left); x < endX; x++)
+			priv->TileHashes[1ull * y * priv->TileHashesWidth + x] = 0;
+	}
+}
+
+UINT64 rfx_tile_hash(const BYTE* WINPR_RESTRICT data, UINT32 width, UINT32 height,
+                     UINT32 scanline, UINT32 bpp)
+{
+	const UINT64 prime = 0x9E3779B97F4A7C15ull;
+	const size_t lineSize = 1ull * width * bpp;
+	UINT64 hash = ((1ull * width << 32) | height) * prime;
+
+	WINPR_ASSERT(data || (lineSize == 0) || (height == 0));
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* line = &data[1ull * y * scanline];
+		size_t x = 0;
+
+		for (; x + sizeof(UINT64) <= lineSize; x += sizeof(UINT64))
+		{
+			UINT64 val = 0;
+			memcpy(&val, &line[x], sizeof(val));
+			hash = (hash ^ val) * prime;
+			hash ^= hash >> 32;
+		}
+
+		for (; x < lineSize; x++)
+			hash = (hash ^ line[x]) * prime;
+	}
+
+	/* final avalanche, see MurmurHash3 fmix64 */
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+
+	return (hash != 0) ? hash : 1;
+}
+
 UINT32 rfx_message_get_frame_idx(const RFX_MESSAGE* WINPR_RESTRICT message)
 {
 	WINPR_ASSERT(message);
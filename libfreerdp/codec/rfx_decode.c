@@ -38,10 +38,9 @@
 static INLINE void rfx_decode_component(RFX_CONTEXT* WINPR_RESTRICT context,
                                         const UINT32* WINPR_RESTRICT quantization_values,
                                         const BYTE* WINPR_RESTRICT data, size_t size,
-                                        INT16* WINPR_RESTRICT buffer)
+                                        INT16* WINPR_RESTRICT buffer,
+                                        INT16* WINPR_RESTRICT dwt_buffer)
 {
-	INT16* dwt_buffer = NULL;
-	dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
 	PROFILER_ENTER(context->priv->prof_rfx_decode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_rlgr_decode)
 	WINPR_ASSERT(size <= UINT32_MAX);
@@ -57,7 +56,6 @@ static INLINE void rfx_decode_component(RFX_CONTEXT* WINPR_RESTRICT context,
 	context->dwt_2d_decode(buffer, dwt_buffer);
 	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_component)
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
 }
 
 /* rfx_decode_ycbcr_to_rgb code now resides in the primitives library. */
@@ -74,6 +72,7 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_R
 	BOOL rc = TRUE;
 	BYTE* pBuffer = NULL;
 	INT16* pSrcDst[3];
+	INT16* dwt_buffer = NULL;
 	UINT32* y_quants = NULL;
 	UINT32* cb_quants = NULL;
 	UINT32* cr_quants = NULL;
@@ -84,12 +83,16 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_R
 	cb_quants = context->quants + (10ULL * tile->quantIdxCb);
 	cr_quants = context->quants + (10ULL * tile->quantIdxCr);
 	pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1);
-	pSrcDst[0] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 0ULL) + 16ULL]));        /* y_r_buffer */
-	pSrcDst[1] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 1ULL) + 16ULL]));        /* cb_g_buffer */
-	pSrcDst[2] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 2ULL) + 16ULL]));        /* cr_b_buffer */
-	rfx_decode_component(context, y_quants, tile->YData, tile->YLen, pSrcDst[0]); /* YData */
-	rfx_decode_component(context, cb_quants, tile->CbData, tile->CbLen, pSrcDst[1]); /* CbData */
-	rfx_decode_component(context, cr_quants, tile->CrData, tile->CrLen, pSrcDst[2]); /* CrData */
+	pSrcDst[0] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 0ULL) + 16ULL])); /* y_r_buffer */
+	pSrcDst[1] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 1ULL) + 16ULL])); /* cb_g_buffer */
+	pSrcDst[2] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 2ULL) + 16ULL])); /* cr_b_buffer */
+	dwt_buffer = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 3ULL) + 16ULL])); /* dwt_buffer */
+	rfx_decode_component(context, y_quants, tile->YData, tile->YLen, pSrcDst[0],
+	                     dwt_buffer); /* YData */
+	rfx_decode_component(context, cb_quants, tile->CbData, tile->CbLen, pSrcDst[1],
+	                     dwt_buffer); /* CbData */
+	rfx_decode_component(context, cr_quants, tile->CrData, tile->CrLen, pSrcDst[2],
+	                     dwt_buffer); /* CrData */
 	PROFILER_ENTER(context->priv->prof_rfx_ycbcr_to_rgb)
 
 	cnv.pv = pSrcDst;
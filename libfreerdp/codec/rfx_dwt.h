@@ -30,5 +30,7 @@ FREERDP_LOCAL void rfx_dwt_2d_encode(INT16* WINPR_RESTRICT buffer,
                                      INT16* WINPR_RESTRICT dwt_buffer);
 FREERDP_LOCAL void rfx_dwt_2d_extrapolate_decode(INT16* WINPR_RESTRICT buffer,
                                                  INT16* WINPR_RESTRICT dwt_buffer);
+FREERDP_LOCAL void rfx_dwt_2d_extrapolate_encode(INT16* WINPR_RESTRICT buffer,
+                                                 INT16* WINPR_RESTRICT dwt_buffer);
 
 #endif /* FREERDP_LIB_CODEC_RFX_DWT_H */
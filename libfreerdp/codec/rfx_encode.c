@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/collections.h>
 
@@ -254,13 +255,36 @@ static void rfx_encode_component(RFX_CONTEXT* WINPR_RESTRICT context,
 	*size = WINPR_ASSERTING_INT_CAST(uint32_t, rc);
 }
 
-void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRICT tile)
+void rfx_encode_ycbcr(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_RESTRICT tile,
+                      INT16* pSrcDst[3])
 {
 	union
 	{
 		const INT16** cpv;
 		INT16** pv;
 	} cnv;
+	primitives_t* prims = primitives_get();
+	static const prim_size_t roi_64x64 = { 64, 64 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(tile);
+	WINPR_ASSERT(pSrcDst);
+
+	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
+	rfx_encode_format_rgb(tile->data, tile->width, tile->height, tile->scanline,
+	                      context->pixel_format, context->palette, pSrcDst[0], pSrcDst[1],
+	                      pSrcDst[2]);
+	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
+	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
+
+	cnv.pv = pSrcDst;
+	prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
+	                              &roi_64x64);
+	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
+}
+
+void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRICT tile)
+{
 	BYTE* pBuffer = NULL;
 	INT16* pSrcDst[3];
 	uint32_t YLen = 0;
@@ -269,8 +293,6 @@ void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRIC
 	UINT32* YQuant = NULL;
 	UINT32* CbQuant = NULL;
 	UINT32* CrQuant = NULL;
-	primitives_t* prims = primitives_get();
-	static const prim_size_t roi_64x64 = { 64, 64 };
 
 	if (!(pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1)))
 		return;
@@ -283,24 +305,7 @@ void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRIC
 	pSrcDst[1] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 1ULL) + 16ULL])); /* cb_g_buffer */
 	pSrcDst[2] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 2ULL) + 16ULL])); /* cr_b_buffer */
 	PROFILER_ENTER(context->priv->prof_rfx_encode_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
-	rfx_encode_format_rgb(tile->data, tile->width, tile->height, tile->scanline,
-	                      context->pixel_format, context->palette, pSrcDst[0], pSrcDst[1],
-	                      pSrcDst[2]);
-	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
-
-	cnv.pv = pSrcDst;
-	prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
-	                              &roi_64x64);
-	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
-	/**
-	 * We need to clear the buffers as the RLGR encoder expects it to be initialized to zero.
-	 * This allows simplifying and improving the performance of the encoding process.
-	 */
-	ZeroMemory(tile->YData, 4096);
-	ZeroMemory(tile->CbData, 4096);
-	ZeroMemory(tile->CrData, 4096);
+	rfx_encode_ycbcr(context, tile, pSrcDst);
 	rfx_encode_component(context, YQuant, pSrcDst[0], tile->YData, 4096, &YLen);
 	rfx_encode_component(context, CbQuant, pSrcDst[1], tile->CbData, 4096, &CbLen);
 	rfx_encode_component(context, CrQuant, pSrcDst[2], tile->CrData, 4096, &CrLen);
@@ -23,6 +23,11 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+/* Convert a (partial) tile to the 64x64 Y, Cb and Cr planes the RFX encoders operate on. */
+FREERDP_LOCAL void rfx_encode_ycbcr(RFX_CONTEXT* WINPR_RESTRICT context,
+                                    const RFX_TILE* WINPR_RESTRICT tile,
+                                    INT16* pSrcDst[3]);
+
 FREERDP_LOCAL void rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context,
                                   RFX_TILE* WINPR_RESTRICT tile);
 
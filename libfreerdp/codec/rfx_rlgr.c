@@ -34,10 +34,9 @@
 #include <winpr/print.h>
 #include <winpr/sysinfo.h>
 #include <winpr/bitstream.h>
+#include <winpr/endian.h>
 #include <winpr/intrin.h>
 
-#include "rfx_bitstream.h"
-
 #include "rfx_rlgr.h"
 
 /* Constants used in RLGR1/RLGR3 algorithm */
@@ -48,19 +47,6 @@
 #define UQ_GR (3)  /* increase in kp after nonzero symbol in GR mode */
 #define DQ_GR (3)  /* decrease in kp after zero symbol in GR mode */
 
-/* Returns the least number of bits required to represent a given value */
-#define GetMinBits(_val, _nbits) \
-	do                           \
-	{                            \
-		UINT32 _v = (_val);      \
-		(_nbits) = 0;            \
-		while (_v)               \
-		{                        \
-			_v >>= 1;            \
-			(_nbits)++;          \
-		}                        \
-	} while (0)
-
 /*
  * Update the passed parameter and clamp it to the range [0, KPMAX]
  * Return the value of parameter right-shifted by LSGR
@@ -598,19 +584,78 @@ int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData, UINT32
 		}                   \
 	} while (0)
 
-/* Emit bitPattern to the output bitstream */
-#define OutputBits(numBits, bitPattern) rfx_bitstream_put_bits(bs, bitPattern, numBits)
+/*
+ * MSB first bit writer for the encoder.
+ *
+ * Pending bits are collected in a 64bit accumulator and stored 32 at a time. Bytes beyond the
+ * end of the output buffer are dropped, the encoder still returns the truncated size then.
+ */
+typedef struct
+{
+	BYTE* buffer;
+	size_t length;
+	size_t position;
+	UINT64 accumulator;
+	uint32_t offset;
+} RFX_RLGR_WRITER;
+
+static inline void rfx_rlgr_writer_store(RFX_RLGR_WRITER* WINPR_RESTRICT w, UINT32 word)
+{
+	if (w->position + 4 <= w->length)
+		winpr_Data_Write_UINT32_BE(&w->buffer[w->position], word);
+	else
+	{
+		for (size_t x = 0; x < 4; x++)
+		{
+			if (w->position + x < w->length)
+				w->buffer[w->position + x] = (BYTE)(word >> (24 - 8 * x));
+		}
+	}
+	w->position += 4;
+}
+
+/* Emit the lower nbits (at most 32) of bits to the output */
+static inline void rfx_rlgr_writer_put(RFX_RLGR_WRITER* WINPR_RESTRICT w, UINT32 bits,
+                                       uint32_t nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+	WINPR_ASSERT((nbits == 32) || ((bits >> nbits) == 0));
+
+	w->accumulator = (w->accumulator << nbits) | bits;
+	w->offset += nbits;
+
+	if (w->offset >= 32)
+	{
+		w->offset -= 32;
+		rfx_rlgr_writer_store(w, (UINT32)(w->accumulator >> w->offset));
+	}
+}
+
+/* Emit a bit (0 or 1), count number of times, to the output */
+static inline void rfx_rlgr_writer_put_run(RFX_RLGR_WRITER* WINPR_RESTRICT w, uint32_t count,
+                                           UINT8 bit)
+{
+	const UINT32 pattern = bit ? UINT32_MAX : 0;
+
+	for (; count >= 32; count -= 32)
+		rfx_rlgr_writer_put(w, pattern, 32);
 
-/* Emit a bit (0 or 1), count number of times, to the output bitstream */
-static inline void OutputBit(RFX_BITSTREAM* bs, uint32_t count, UINT8 bit)
+	rfx_rlgr_writer_put(w, pattern & ((UINT32)(1ULL << count) - 1), count);
+}
+
+/* Pad the pending bits with zeros to a full byte and store them */
+static inline void rfx_rlgr_writer_flush(RFX_RLGR_WRITER* WINPR_RESTRICT w)
 {
-	UINT16 _b = ((bit) ? 0xFFFF : 0);
-	const uint32_t rem = count % 16;
-	for (uint32_t x = 0; x < count - rem; x += 16)
-		rfx_bitstream_put_bits(bs, _b, 16);
+	const uint32_t nbytes = (w->offset + 7) / 8;
+	const UINT64 pending = w->accumulator << (nbytes * 8 - w->offset);
 
-	if (rem > 0)
-		rfx_bitstream_put_bits(bs, _b, rem);
+	for (uint32_t x = 0; x < nbytes; x++)
+	{
+		if (w->position < w->length)
+			w->buffer[w->position] = (BYTE)(pending >> (8 * (nbytes - x - 1)));
+		w->position++;
+	}
+	w->offset = 0;
 }
 
 /* Converts the input value to (2 * abs(input) - sign(input)), where sign(input) = (input < 0 ? 1 :
@@ -623,22 +668,20 @@ static inline UINT32 Get2MagSign(INT32 input)
 }
 
 /* Outputs the Golomb/Rice encoding of a non-negative integer */
-#define CodeGR(krp, val) rfx_rlgr_code_gr(bs, krp, val)
-
-static void rfx_rlgr_code_gr(RFX_BITSTREAM* bs, uint32_t* krp, UINT32 val)
+static inline void rfx_rlgr_code_gr(RFX_RLGR_WRITER* WINPR_RESTRICT w, uint32_t* krp, UINT32 val)
 {
-	uint32_t kr = *krp >> LSGR;
-
-	/* unary part of GR code */
-
+	const uint32_t kr = *krp >> LSGR;
 	const uint32_t vk = val >> kr;
-	OutputBit(bs, vk, 1);
-	OutputBit(bs, 1, 0);
+	const UINT32 remainder = val & ((1u << kr) - 1);
 
-	/* remainder part of GR code, if needed */
-	if (kr)
+	/* kr is at most KPMAX >> LSGR, so all but very long unary parts (vk ones terminated by a
+	 * zero) fit together with the remainder in a single write */
+	if (vk + 1 + kr <= 32)
+		rfx_rlgr_writer_put(w, (((1u << vk) - 1) << (kr + 1)) | remainder, vk + 1 + kr);
+	else
 	{
-		OutputBits(kr, val & ((1 << kr) - 1));
+		rfx_rlgr_writer_put_run(w, vk, 1);
+		rfx_rlgr_writer_put(w, remainder, kr + 1);
 	}
 
 	/* update krp, only if it is not equal to 1 */
@@ -655,20 +698,14 @@ static void rfx_rlgr_code_gr(RFX_BITSTREAM* bs, uint32_t* krp, UINT32 val)
 int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
                     BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size)
 {
-	uint32_t k = 0;
-	uint32_t kp = 0;
-	uint32_t krp = 0;
-	RFX_BITSTREAM* bs = NULL;
+	RFX_RLGR_WRITER w = { .buffer = buffer, .length = buffer_size };
 
-	if (!(bs = (RFX_BITSTREAM*)winpr_aligned_calloc(1, sizeof(RFX_BITSTREAM), 32)))
-		return 0;
-
-	rfx_bitstream_attach(bs, buffer, buffer_size);
+	InitOnceExecuteOnce(&rfx_rlgr_init_once, rfx_rlgr_init, NULL, NULL);
 
 	/* initialize the parameters */
-	k = 1;
-	kp = 1 << LSGR;
-	krp = 1 << LSGR;
+	uint32_t k = 1;
+	uint32_t kp = 1 << LSGR;
+	uint32_t krp = 1 << LSGR;
 
 	/* process all the input coefficients */
 	while (data_size > 0)
@@ -677,14 +714,10 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 
 		if (k)
 		{
-			uint32_t numZeros = 0;
-			uint32_t runmax = 0;
-			BYTE sign = 0;
-
 			/* RUN-LENGTH MODE */
 
 			/* collect the run of zeros in the input stream */
-			numZeros = 0;
+			uint32_t numZeros = 0;
 			GetNextInput(input);
 			while (input == 0 && data_size > 0)
 			{
@@ -692,21 +725,17 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 				GetNextInput(input);
 			}
 
-			// emit output zeros
-			runmax = 1 << k;
+			/* emit a zero bit for every full run of 1 << k zeros */
+			uint32_t runs = 0;
+			uint32_t runmax = 1 << k;
 			while (numZeros >= runmax)
 			{
-				OutputBit(bs, 1, 0); /* output a zero bit */
+				runs++;
 				numZeros -= runmax;
 				k = UpdateParam(&kp, UP_GR); /* update kp, k */
 				runmax = 1 << k;
 			}
-
-			/* output a 1 to terminate runs */
-			OutputBit(bs, 1, 1);
-
-			/* output the remaining run length using k bits */
-			OutputBits(k, numZeros);
+			rfx_rlgr_writer_put_run(&w, runs, 0);
 
 			/* note: when we reach here and the last byte being encoded is 0, we still
 			   need to output the last two bits, otherwise mstsc will crash */
@@ -714,10 +743,12 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 			/* encode the nonzero value using GR coding */
 			const UINT32 mag =
 			    (UINT32)(input < 0 ? -input : input); /* absolute value of input coefficient */
-			sign = (input < 0 ? 1 : 0);         /* sign of input coefficient */
+			const UINT32 sign = (input < 0 ? 1 : 0);  /* sign of input coefficient */
 
-			OutputBit(bs, 1, sign);          /* output the sign bit */
-			CodeGR(&krp, mag ? mag - 1 : 0); /* output GR code for (mag - 1) */
+			/* output a 1 to terminate runs, the remaining run length using k bits and the
+			 * sign bit */
+			rfx_rlgr_writer_put(&w, (((1u << k) | numZeros) << 1) | sign, k + 2);
+			rfx_rlgr_code_gr(&w, &krp, mag ? mag - 1 : 0); /* output GR code for (mag - 1) */
 
 			k = UpdateParam(&kp, -DN_GR);
 		}
@@ -727,14 +758,12 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 
 			if (mode == RLGR1)
 			{
-				UINT32 twoMs = 0;
-
 				/* RLGR1 variant */
 
 				/* convert input to (2*magnitude - sign), encode using GR code */
 				GetNextInput(input);
-				twoMs = Get2MagSign(input);
-				CodeGR(&krp, twoMs);
+				const UINT32 twoMs = Get2MagSign(input);
+				rfx_rlgr_code_gr(&w, &krp, twoMs);
 
 				/* update k, kp */
 				/* NOTE: as of Aug 2011, the algorithm is still wrongly documented
@@ -750,27 +779,22 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 			}
 			else /* mode == RLGR3 */
 			{
-				UINT32 twoMs1 = 0;
-				UINT32 twoMs2 = 0;
-				UINT32 sum2Ms = 0;
-				UINT32 nIdx = 0;
-
 				/* RLGR3 variant */
 
 				/* convert the next two input values to (2*magnitude - sign) and */
 				/* encode their sum using GR code */
 
 				GetNextInput(input);
-				twoMs1 = Get2MagSign(input);
+				const UINT32 twoMs1 = Get2MagSign(input);
 				GetNextInput(input);
-				twoMs2 = Get2MagSign(input);
-				sum2Ms = twoMs1 + twoMs2;
+				const UINT32 twoMs2 = Get2MagSign(input);
+				const UINT32 sum2Ms = twoMs1 + twoMs2;
 
-				CodeGR(&krp, sum2Ms);
+				rfx_rlgr_code_gr(&w, &krp, sum2Ms);
 
 				/* encode binary representation of the first input (twoMs1). */
-				GetMinBits(sum2Ms, nIdx);
-				OutputBits(nIdx, twoMs1);
+				const uint32_t nIdx = 32 - lzcnt_s(sum2Ms);
+				rfx_rlgr_writer_put(&w, twoMs1, nIdx);
 
 				/* update k,kp for the two input values */
 
@@ -786,9 +810,8 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 		}
 	}
 
-	rfx_bitstream_flush(bs);
-	uint32_t processed_size = rfx_bitstream_get_processed_bytes(bs);
-	winpr_aligned_free(bs);
+	rfx_rlgr_writer_flush(&w);
 
+	const size_t processed_size = MIN(w.position, w.length);
 	return WINPR_ASSERTING_INT_CAST(int, processed_size);
 }
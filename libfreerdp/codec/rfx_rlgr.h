@@ -23,6 +23,11 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+/**
+ * Encode data_size coefficients with RLGR1 or RLGR3 to buffer.
+ *
+ * Returns the number of bytes written, output exceeding buffer_size is discarded.
+ */
 FREERDP_LOCAL int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data,
                                   UINT32 data_size, BYTE* WINPR_RESTRICT buffer,
                                   UINT32 buffer_size);
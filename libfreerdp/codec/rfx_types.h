@@ -57,8 +57,6 @@ typedef enum
 	RFX_STATE_FINAL
 } RFX_STATE;
 
-typedef struct S_RFX_TILE_COMPOSE_WORK_PARAM RFX_TILE_COMPOSE_WORK_PARAM;
-
 typedef struct S_RFX_CONTEXT_PRIV RFX_CONTEXT_PRIV;
 struct S_RFX_CONTEXT_PRIV
 {
@@ -66,17 +64,22 @@ struct S_RFX_CONTEXT_PRIV
 	wObjectPool* TilePool;
 
 	BOOL UseThreads;
-	PTP_WORK* workObjects;
-	RFX_TILE_COMPOSE_WORK_PARAM* tileWorkParams;
 
 	DWORD MinThreadCount;
 	DWORD MaxThreadCount;
 
 	PTP_POOL ThreadPool;
 	TP_CALLBACK_ENVIRON ThreadPoolEnv;
+	wParallelFor* ParallelFor;
 
 	wBufferPool* BufferPool;
 
+	/* encoder tile cache, one content hash per 64x64 tile, 0 for unknown */
+	BOOL TileCache;
+	UINT64* TileHashes;
+	UINT32 TileHashesWidth;
+	UINT32 TileHashesHeight;
+
 	/* profilers */
 	PROFILER_DEFINE(prof_rfx_decode_rgb)
 	PROFILER_DEFINE(prof_rfx_decode_component)
@@ -172,6 +175,7 @@ struct S_RFX_CONTEXT
 	void (*dwt_2d_decode)(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT dwt_buffer);
 	void (*dwt_2d_extrapolate_decode)(INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT temp);
 	void (*dwt_2d_encode)(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT dwt_buffer);
+	void (*dwt_2d_extrapolate_encode)(INT16* WINPR_RESTRICT src, INT16* WINPR_RESTRICT temp);
 	int (*rlgr_decode)(RLGR_MODE mode, const BYTE* WINPR_RESTRICT data, UINT32 data_size,
 	                   INT16* WINPR_RESTRICT buffer, UINT32 buffer_size);
 	int (*rlgr_encode)(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
@@ -181,4 +185,8 @@ struct S_RFX_CONTEXT
 	RFX_CONTEXT_PRIV* priv;
 };
 
+/* runs fn over count tiles, on the thread pool of the context if it uses threads */
+FREERDP_LOCAL BOOL rfx_context_process_tiles(RFX_CONTEXT* WINPR_RESTRICT context, size_t count,
+                                             WINPR_PARALLEL_FOR_CALLBACK fn, void* arg);
+
 #endif /* FREERDP_LIB_CODEC_RFX_TYPES_H */
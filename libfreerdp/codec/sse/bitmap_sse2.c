@@ -0,0 +1,144 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bitmap Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/endian.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../bitmap_types.h"
+#include "bitmap_sse2.h"
+
+#include "../../core/simd.h"
+#include "../../primitives/sse/prim_avxsse.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static inline UINT64 bitmap_movemask32(__m128i eq)
+{
+	return (UINT64)(UINT32)_mm_movemask_ps(_mm_castsi128_ps(eq));
+}
+
+static inline UINT64 bitmap_movemask16(__m128i eq)
+{
+	return (UINT64)(UINT32)_mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+}
+
+/* The pixel before each lane is the vector shifted up by one lane, with the last lane of the
+ * previous vector shifted in. Bit 0 of the line has no predecessor and is cleared. */
+static void bitmap_line_masks32_sse2(const BYTE* WINPR_RESTRICT line,
+                                     const BYTE* WINPR_RESTRICT above, UINT32 count, UINT32 mix,
+                                     UINT64* WINPR_RESTRICT fill, UINT64* WINPR_RESTRICT mixed,
+                                     UINT64* WINPR_RESTRICT same)
+{
+	const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i xmix = _mm_set1_epi32((int)mix);
+	__m128i last = _mm_setzero_si128();
+	UINT64 f = 0;
+	UINT64 m = 0;
+	UINT64 s = 0;
+	UINT32 k = 0;
+
+	WINPR_ASSERT(count <= 64);
+
+	for (; k + 4 <= count; k += 4)
+	{
+		const __m128i cur = _mm_and_si128(LOAD_SI128(&line[4ull * k]), rgb);
+		const __m128i up = _mm_and_si128(LOAD_SI128(&above[4ull * k]), rgb);
+		const __m128i prev = _mm_or_si128(_mm_slli_si128(cur, 4), _mm_srli_si128(last, 12));
+
+		f |= bitmap_movemask32(_mm_cmpeq_epi32(cur, up)) << k;
+		m |= bitmap_movemask32(_mm_cmpeq_epi32(cur, _mm_xor_si128(up, xmix))) << k;
+		s |= bitmap_movemask32(_mm_cmpeq_epi32(cur, prev)) << k;
+		last = cur;
+	}
+
+	for (; k < count; k++)
+	{
+		const UINT32 pixel = winpr_Data_Get_UINT32(&line[4ull * k]) & 0x00FFFFFF;
+		const UINT32 ypixel = winpr_Data_Get_UINT32(&above[4ull * k]) & 0x00FFFFFF;
+
+		if (pixel == ypixel)
+			f |= 1ull << k;
+		if (pixel == (ypixel ^ mix))
+			m |= 1ull << k;
+		if ((k > 0) && (pixel == (winpr_Data_Get_UINT32(&line[4ull * (k - 1)]) & 0x00FFFFFF)))
+			s |= 1ull << k;
+	}
+
+	*fill = f;
+	*mixed = m;
+	*same = s & ~1ull;
+}
+
+static void bitmap_line_masks16_sse2(const BYTE* WINPR_RESTRICT line,
+                                     const BYTE* WINPR_RESTRICT above, UINT32 count, UINT32 mix,
+                                     UINT64* WINPR_RESTRICT fill, UINT64* WINPR_RESTRICT mixed,
+                                     UINT64* WINPR_RESTRICT same)
+{
+	const __m128i xmix = _mm_set1_epi16((short)(mix & 0xFFFF));
+	__m128i last = _mm_setzero_si128();
+	UINT64 f = 0;
+	UINT64 m = 0;
+	UINT64 s = 0;
+	UINT32 k = 0;
+
+	WINPR_ASSERT(count <= 64);
+
+	for (; k + 8 <= count; k += 8)
+	{
+		const __m128i cur = LOAD_SI128(&line[2ull * k]);
+		const __m128i up = LOAD_SI128(&above[2ull * k]);
+		const __m128i prev = _mm_or_si128(_mm_slli_si128(cur, 2), _mm_srli_si128(last, 14));
+
+		f |= bitmap_movemask16(_mm_cmpeq_epi16(cur, up)) << k;
+		m |= bitmap_movemask16(_mm_cmpeq_epi16(cur, _mm_xor_si128(up, xmix))) << k;
+		s |= bitmap_movemask16(_mm_cmpeq_epi16(cur, prev)) << k;
+		last = cur;
+	}
+
+	for (; k < count; k++)
+	{
+		const UINT16 pixel = winpr_Data_Get_UINT16(&line[2ull * k]);
+		const UINT16 ypixel = winpr_Data_Get_UINT16(&above[2ull * k]);
+
+		if (pixel == ypixel)
+			f |= 1ull << k;
+		if (pixel == (ypixel ^ mix))
+			m |= 1ull << k;
+		if ((k > 0) && (pixel == winpr_Data_Get_UINT16(&line[2ull * (k - 1)])))
+			s |= 1ull << k;
+	}
+
+	*fill = f;
+	*mixed = m;
+	*same = s & ~1ull;
+}
+#endif
+
+void bitmap_init_sse2_int(BITMAP_ENCODER_KERNELS* WINPR_RESTRICT kernels)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+	kernels->masks16 = bitmap_line_masks16_sse2;
+	kernels->masks32 = bitmap_line_masks32_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
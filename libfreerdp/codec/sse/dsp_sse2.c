@@ -0,0 +1,106 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "dsp_sse2.h"
+
+#include "../../core/simd.h"
+#include "../../primitives/sse/prim_avxsse.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static INT32 dsp_fir_q15_sse2(const INT16* WINPR_RESTRICT samples,
+                              const INT16* WINPR_RESTRICT coeffs, size_t taps)
+{
+	__m128i sum = _mm_setzero_si128();
+
+	WINPR_ASSERT((taps % 8) == 0);
+
+	/* pmaddwd cannot overflow, the coefficients never hold -32768 */
+	for (size_t x = 0; x < taps; x += 8)
+	{
+		const __m128i s = LOAD_SI128(&samples[x]);
+		const __m128i c = _mm_load_si128((const __m128i*)&coeffs[x]);
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(s, c));
+	}
+
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+
+static void dsp_mono_to_stereo16_sse2(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                      size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		const __m128i s = LOAD_SI128(&src[2 * x]);
+		STORE_SI128(&dst[4 * x], _mm_unpacklo_epi16(s, s));
+		STORE_SI128(&dst[4 * x + 16], _mm_unpackhi_epi16(s, s));
+	}
+
+	for (; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void dsp_stereo_to_mono16_sse2(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                      size_t frames)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		/* left + right of each frame as 32bit, halved and packed back to 16bit */
+		const __m128i lo = _mm_madd_epi16(LOAD_SI128(&src[4 * x]), ones);
+		const __m128i hi = _mm_madd_epi16(LOAD_SI128(&src[4 * x + 16]), ones);
+		const __m128i mono = _mm_packs_epi32(_mm_srai_epi32(lo, 1), _mm_srai_epi32(hi, 1));
+		STORE_SI128(&dst[2 * x], mono);
+	}
+
+	for (; x < frames; x++)
+	{
+		const INT32 left = (INT16)(src[4 * x] | (src[4 * x + 1] << 8));
+		const INT32 right = (INT16)(src[4 * x + 2] | (src[4 * x + 3] << 8));
+		const INT16 mono = (INT16)((left + right) >> 1);
+		dst[2 * x] = (BYTE)(mono & 0xFF);
+		dst[2 * x + 1] = (BYTE)((mono >> 8) & 0xFF);
+	}
+}
+#endif
+
+void dsp_init_sse2_int(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(kernels);
+	kernels->fir_q15 = dsp_fir_q15_sse2;
+	kernels->mono_to_stereo16 = dsp_mono_to_stereo16_sse2;
+	kernels->stereo_to_mono16 = dsp_stereo_to_mono16_sse2;
+#else
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,83 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * H.264 Bitmap Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../h264.h"
+#include "h264_sse2.h"
+
+#include "../../core/simd.h"
+#include "../../primitives/sse/prim_avxsse.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+/* A tile row is 64 luma, 32 chroma or 256 RGB bytes, so compare 64 bytes per step and
+ * only fall back to memcmp for the remainder. */
+static BOOL h264_diff_block_sse2(const BYTE* WINPR_RESTRICT pSrc, UINT32 nSrcStep,
+                                 const BYTE* WINPR_RESTRICT pOld, UINT32 nOldStep, size_t width,
+                                 size_t height)
+{
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[y * nSrcStep];
+		const BYTE* old = &pOld[y * nOldStep];
+		size_t x = 0;
+
+		for (; x + 64 <= width; x += 64)
+		{
+			const __m128i e0 = _mm_cmpeq_epi8(LOAD_SI128(&src[x]), LOAD_SI128(&old[x]));
+			const __m128i e1 =
+			    _mm_cmpeq_epi8(LOAD_SI128(&src[x + 16]), LOAD_SI128(&old[x + 16]));
+			const __m128i e2 =
+			    _mm_cmpeq_epi8(LOAD_SI128(&src[x + 32]), LOAD_SI128(&old[x + 32]));
+			const __m128i e3 =
+			    _mm_cmpeq_epi8(LOAD_SI128(&src[x + 48]), LOAD_SI128(&old[x + 48]));
+			const __m128i e = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+
+			if (_mm_movemask_epi8(e) != 0xFFFF)
+				return TRUE;
+		}
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i e = _mm_cmpeq_epi8(LOAD_SI128(&src[x]), LOAD_SI128(&old[x]));
+
+			if (_mm_movemask_epi8(e) != 0xFFFF)
+				return TRUE;
+		}
+
+		if ((x < width) && (memcmp(&src[x], &old[x], width - x) != 0))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+#endif
+
+void h264_init_sse2_int(H264_CONTEXT* WINPR_RESTRICT h264)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(h264);
+	h264->diff_block = h264_diff_block_sse2;
+#else
+	WINPR_UNUSED(h264);
+#endif
+}
@@ -0,0 +1,37 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * H.264 Bitmap Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_H264_SSE2_H
+#define FREERDP_LIB_CODEC_H264_SSE2_H
+
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/h264.h>
+#include <freerdp/api.h>
+
+FREERDP_LOCAL void h264_init_sse2_int(H264_CONTEXT* WINPR_RESTRICT h264);
+
+static inline void h264_init_sse2(H264_CONTEXT* WINPR_RESTRICT h264)
+{
+	if (!IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE) ||
+	    !IsProcessorFeaturePresent(PF_SSE3_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	h264_init_sse2_int(h264);
+}
+
+#endif /* FREERDP_LIB_CODEC_H264_SSE2_H */
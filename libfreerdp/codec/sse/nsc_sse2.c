@@ -251,10 +251,23 @@ static inline size_t nsc_encode_next_rgba(UINT32 format, const BYTE* src, const
 	}
 }
 
-static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+/* Store the low 8 bytes of val, but never more than count bytes */
+static inline void nsc_store_8(BYTE* WINPR_RESTRICT dst, __m128i val, size_t count)
 {
-	size_t y = 0;
+	if (count >= 8)
+		_mm_storel_epi64((__m128i*)dst, val);
+	else
+	{
+		BYTE tmp[16] = { 0 };
+		STORE_SI128(tmp, val);
+		CopyMemory(dst, tmp, count);
+	}
+}
 
+static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* WINPR_RESTRICT context,
+                                           const BYTE* WINPR_RESTRICT data, UINT32 scanline,
+                                           UINT32 y, UINT32 height)
+{
 	if (!context || !data || (scanline == 0))
 		return FALSE;
 
@@ -262,14 +275,19 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 	const UINT16 rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
 
 	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
+	const size_t last = 1ull * y + height;
+	size_t row = y;
+
+	WINPR_ASSERT(last <= context->height);
 
-	for (; y < context->height; y++)
+	/* Stores are clipped to the row, bands may be converted concurrently */
+	for (; row < last; row++)
 	{
-		const BYTE* src = data + (context->height - 1 - y) * scanline;
-		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
-		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
-		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width;
+		const BYTE* src = data + (context->height - 1 - row) * scanline;
+		BYTE* yplane = context->priv->PlaneBuffers[0] + row * rw;
+		BYTE* coplane = context->priv->PlaneBuffers[1] + row * rw;
+		BYTE* cgplane = context->priv->PlaneBuffers[2] + row * rw;
+		BYTE* aplane = context->priv->PlaneBuffers[3] + row * context->width;
 
 		for (UINT16 x = 0; x < context->width; x += 8)
 		{
@@ -291,13 +309,13 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 			cg_val = _mm_sub_epi16(cg_val, _mm_srai_epi16(b_val, 1));
 			cg_val = _mm_srai_epi16(cg_val, ccl);
 			y_val = _mm_packus_epi16(y_val, y_val);
-			STORE_SI128(yplane, y_val);
+			nsc_store_8(yplane, y_val, rw - x);
 			co_val = _mm_packs_epi16(co_val, co_val);
-			STORE_SI128(coplane, co_val);
+			nsc_store_8(coplane, co_val, rw - x);
 			cg_val = _mm_packs_epi16(cg_val, cg_val);
-			STORE_SI128(cgplane, cg_val);
+			nsc_store_8(cgplane, cg_val, rw - x);
 			a_val = _mm_packus_epi16(a_val, a_val);
-			STORE_SI128(aplane, a_val);
+			nsc_store_8(aplane, a_val, context->width - x);
 			yplane += 8;
 			coplane += 8;
 			cgplane += 8;
@@ -306,20 +324,20 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 
 		if (context->ChromaSubsamplingLevel > 0 && (context->width % 2) == 1)
 		{
-			context->priv->PlaneBuffers[0][y * rw + context->width] =
-			    context->priv->PlaneBuffers[0][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[1][y * rw + context->width] =
-			    context->priv->PlaneBuffers[1][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[2][y * rw + context->width] =
-			    context->priv->PlaneBuffers[2][y * rw + context->width - 1];
+			context->priv->PlaneBuffers[0][row * rw + context->width] =
+			    context->priv->PlaneBuffers[0][row * rw + context->width - 1];
+			context->priv->PlaneBuffers[1][row * rw + context->width] =
+			    context->priv->PlaneBuffers[1][row * rw + context->width - 1];
+			context->priv->PlaneBuffers[2][row * rw + context->width] =
+			    context->priv->PlaneBuffers[2][row * rw + context->width - 1];
 		}
 	}
 
-	if (context->ChromaSubsamplingLevel > 0 && (y % 2) == 1)
+	if (context->ChromaSubsamplingLevel > 0 && (row == context->height) && (row % 2) == 1)
 	{
-		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
-		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
-		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
+		BYTE* yplane = context->priv->PlaneBuffers[0] + row * rw;
+		BYTE* coplane = context->priv->PlaneBuffers[1] + row * rw;
+		BYTE* cgplane = context->priv->PlaneBuffers[2] + row * rw;
 		CopyMemory(yplane, yplane - rw, rw);
 		CopyMemory(coplane, coplane - rw, rw);
 		CopyMemory(cgplane, cgplane - rw, rw);
@@ -328,7 +346,7 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 	return TRUE;
 }
 
-static void nsc_encode_subsampling_sse2(NSC_CONTEXT* context)
+static BOOL nsc_encode_subsampling_sse2(NSC_CONTEXT* WINPR_RESTRICT context)
 {
 	BYTE* co_dst = NULL;
 	BYTE* cg_dst = NULL;
@@ -375,26 +393,18 @@ static void nsc_encode_subsampling_sse2(NSC_CONTEXT* context)
 			cg_src1 += 16;
 		}
 	}
-}
-
-static BOOL nsc_encode_sse2(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
-                            UINT32 scanline)
-{
-	if (!nsc_encode_argb_to_aycocg_sse2(context, data, scanline))
-		return FALSE;
-
-	if (context->ChromaSubsamplingLevel > 0)
-		nsc_encode_subsampling_sse2(context);
 
 	return TRUE;
 }
+
 #endif
 
 void nsc_init_sse2_int(NSC_CONTEXT* WINPR_RESTRICT context)
 {
 #if defined(SSE_AVX_INTRINSICS_ENABLED)
 	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_sse2")
-	context->encode = nsc_encode_sse2;
+	context->encode_aycocg = nsc_encode_argb_to_aycocg_sse2;
+	context->encode_subsampling = nsc_encode_subsampling_sse2;
 #else
 	WINPR_UNUSED(context);
 #endif
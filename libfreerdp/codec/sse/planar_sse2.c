@@ -0,0 +1,304 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RDP6 Planar Codec - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../planar_types.h"
+#include "planar_sse2.h"
+
+#include "../../core/simd.h"
+#include "../../primitives/sse/prim_avxsse.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <freerdp/codec/color.h>
+
+static inline size_t planar_ctz(UINT32 mask)
+{
+	WINPR_ASSERT(mask != 0);
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return (size_t)__builtin_ctz(mask);
+#endif
+}
+
+/* Byte offset of the alpha, red, green and blue channel of a 32bpp pixel, -1 if not stored */
+static BOOL planar_get_channel_offsets(UINT32 format, int offsets[4])
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			offsets[0] = 0;
+			offsets[1] = 1;
+			offsets[2] = 2;
+			offsets[3] = 3;
+			break;
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			offsets[0] = 0;
+			offsets[1] = 3;
+			offsets[2] = 2;
+			offsets[3] = 1;
+			break;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			offsets[0] = 3;
+			offsets[1] = 0;
+			offsets[2] = 1;
+			offsets[3] = 2;
+			break;
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			offsets[0] = 3;
+			offsets[1] = 2;
+			offsets[2] = 1;
+			offsets[3] = 0;
+			break;
+		default:
+			return FALSE;
+	}
+
+	if (!FreeRDPColorHasAlpha(format))
+		offsets[0] = -1;
+
+	return TRUE;
+}
+
+/* Extract the byte at offset from each of the 16 pixels in v[0..3] */
+static inline __m128i planar_gather_channel(const __m128i v[4], int offset, __m128i mask)
+{
+	const __m128i shift = _mm_cvtsi32_si128(8 * offset);
+	const __m128i t0 = _mm_and_si128(_mm_srl_epi32(v[0], shift), mask);
+	const __m128i t1 = _mm_and_si128(_mm_srl_epi32(v[1], shift), mask);
+	const __m128i t2 = _mm_and_si128(_mm_srl_epi32(v[2], shift), mask);
+	const __m128i t3 = _mm_and_si128(_mm_srl_epi32(v[3], shift), mask);
+	return _mm_packus_epi16(_mm_packs_epi32(t0, t1), _mm_packs_epi32(t2, t3));
+}
+
+static BOOL planar_split_color_planes_sse2(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                           const BYTE* WINPR_RESTRICT data, UINT32 format,
+                                           UINT32 width, UINT32 height, UINT32 scanline,
+                                           BYTE* WINPR_RESTRICT planes[4])
+{
+	int offsets[4] = { 0 };
+
+	WINPR_ASSERT(planar);
+
+	if (!planar_get_channel_offsets(format, offsets))
+		return planar_split_color_planes_generic(planar, data, format, width, height, scanline,
+		                                         planes);
+
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+	size_t k = 0;
+
+	for (UINT32 i = 0; i < height; i++)
+	{
+		const size_t y = planar->topdown ? i : height - 1 - i;
+		const BYTE* pixel = &data[1ULL * scanline * y];
+		UINT32 x = 0;
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v[4] = { LOAD_SI128(&pixel[0]), LOAD_SI128(&pixel[16]),
+				                   LOAD_SI128(&pixel[32]), LOAD_SI128(&pixel[48]) };
+			pixel += 64;
+
+			for (size_t c = 1; c < 4; c++)
+				STORE_SI128(&planes[c][k], planar_gather_channel(v, offsets[c], mask));
+
+			if (offsets[0] < 0)
+				STORE_SI128(&planes[0][k], opaque);
+			else
+				STORE_SI128(&planes[0][k], planar_gather_channel(v, offsets[0], mask));
+
+			k += 16;
+		}
+
+		for (; x < width; x++)
+		{
+			planes[0][k] = (offsets[0] < 0) ? 0xFF : pixel[offsets[0]];
+			planes[1][k] = pixel[offsets[1]];
+			planes[2][k] = pixel[offsets[2]];
+			planes[3][k] = pixel[offsets[3]];
+			pixel += 4;
+			k++;
+		}
+	}
+
+	return TRUE;
+}
+
+static void planar_delta_encode_line_sse2(const BYTE* WINPR_RESTRICT src,
+                                          const BYTE* WINPR_RESTRICT prev,
+                                          BYTE* WINPR_RESTRICT dst, UINT32 width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		/* 2 * delta for positive, -2 * delta - 1 for negative deltas, modulo 256 */
+		const __m128i delta = _mm_sub_epi8(LOAD_SI128(&src[x]), LOAD_SI128(&prev[x]));
+		const __m128i sign = _mm_cmpgt_epi8(zero, delta);
+		STORE_SI128(&dst[x], _mm_xor_si128(_mm_add_epi8(delta, delta), sign));
+	}
+
+	planar_delta_encode_line_generic(&src[x], &prev[x], &dst[x], width - x);
+}
+
+static size_t planar_rle_run_start_sse2(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
+{
+	if (pos == 0)
+	{
+		if (size == 0)
+			return 0;
+
+		if (data[0] == 0)
+			return 0;
+
+		pos = 1;
+	}
+
+	for (; pos + 16 <= size; pos += 16)
+	{
+		const __m128i cur = LOAD_SI128(&data[pos]);
+		const __m128i last = LOAD_SI128(&data[pos - 1]);
+		const UINT32 mask = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(cur, last));
+
+		if (mask)
+			return pos + planar_ctz(mask);
+	}
+
+	return planar_rle_run_start_generic(data, pos, size);
+}
+
+static size_t planar_rle_run_end_sse2(const BYTE* WINPR_RESTRICT data, size_t pos, size_t size)
+{
+	WINPR_ASSERT(pos < size);
+	const __m128i symbol = _mm_set1_epi8((char)data[pos]);
+	size_t cur = pos + 1;
+
+	for (; cur + 16 <= size; cur += 16)
+	{
+		const __m128i val = LOAD_SI128(&data[cur]);
+		const UINT32 mask = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(val, symbol)) ^ 0xFFFF;
+
+		if (mask)
+			return cur + planar_ctz(mask);
+	}
+
+	/* The generic scan continues with the symbol found at cur - 1, which is the run symbol */
+	if (cur >= size)
+		return size;
+
+	return planar_rle_run_end_generic(data, cur - 1, size);
+}
+
+static void planar_delta_decode_line_sse2(BYTE* WINPR_RESTRICT line,
+                                          const BYTE* WINPR_RESTRICT prev, UINT32 width)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i low = _mm_set1_epi8(0x7F);
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		/* delta = (encoded >> 1) ^ -(encoded & 1), there is no byte shift so mask a word shift */
+		const __m128i encoded = LOAD_SI128(&line[x]);
+		const __m128i magnitude = _mm_and_si128(_mm_srli_epi16(encoded, 1), low);
+		const __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(encoded, one), one);
+		const __m128i delta = _mm_xor_si128(magnitude, sign);
+		STORE_SI128(&line[x], _mm_add_epi8(LOAD_SI128(&prev[x]), delta));
+	}
+
+	planar_delta_decode_line_generic(&line[x], &prev[x], width - x);
+}
+
+static void planar_merge_planes_line_sse2(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT b,
+                                          const BYTE* WINPR_RESTRICT g,
+                                          const BYTE* WINPR_RESTRICT r,
+                                          const BYTE* WINPR_RESTRICT a, UINT32 width)
+{
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i vb = LOAD_SI128(&b[x]);
+		const __m128i vg = LOAD_SI128(&g[x]);
+		const __m128i vr = LOAD_SI128(&r[x]);
+		const __m128i va = a ? LOAD_SI128(&a[x]) : opaque;
+		const __m128i bgLo = _mm_unpacklo_epi8(vb, vg);
+		const __m128i bgHi = _mm_unpackhi_epi8(vb, vg);
+		const __m128i raLo = _mm_unpacklo_epi8(vr, va);
+		const __m128i raHi = _mm_unpackhi_epi8(vr, va);
+
+		STORE_SI128(&dst[0], _mm_unpacklo_epi16(bgLo, raLo));
+		STORE_SI128(&dst[16], _mm_unpackhi_epi16(bgLo, raLo));
+		STORE_SI128(&dst[32], _mm_unpacklo_epi16(bgHi, raHi));
+		STORE_SI128(&dst[48], _mm_unpackhi_epi16(bgHi, raHi));
+		dst += 64;
+	}
+
+	planar_merge_planes_line_generic(dst, &b[x], &g[x], &r[x], a ? &a[x] : NULL, width - x);
+}
+
+static void planar_subsample_expand_line_sse2(BYTE* WINPR_RESTRICT dst,
+                                              const BYTE* WINPR_RESTRICT src, UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x + 32 <= width; x += 32)
+	{
+		const __m128i val = LOAD_SI128(&src[x / 2]);
+		STORE_SI128(&dst[x], _mm_unpacklo_epi8(val, val));
+		STORE_SI128(&dst[x + 16], _mm_unpackhi_epi8(val, val));
+	}
+
+	planar_subsample_expand_line_generic(&dst[x], &src[x / 2], width - x);
+}
+#endif
+
+void planar_init_sse2_int(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WINPR_ASSERT(planar);
+	planar->split_color_planes = planar_split_color_planes_sse2;
+	planar->delta_encode_line = planar_delta_encode_line_sse2;
+	planar->rle_run_start = planar_rle_run_start_sse2;
+	planar->rle_run_end = planar_rle_run_end_sse2;
+	planar->delta_decode_line = planar_delta_decode_line_sse2;
+	planar->merge_planes_line = planar_merge_planes_line_sse2;
+	planar->subsample_expand_line = planar_subsample_expand_line_sse2;
+#else
+	WINPR_UNUSED(planar);
+#endif
+}
@@ -0,0 +1,293 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../rfx_types.h"
+#include "rfx_avx2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static inline __m256i LOAD_SI256(const void* ptr)
+{
+	const __m256i* mptr = WINPR_CXX_COMPAT_CAST(const __m256i*, ptr);
+	return _mm256_loadu_si256(mptr);
+}
+
+static inline void STORE_SI256(void* ptr, __m256i val)
+{
+	__m256i* mptr = WINPR_CXX_COMPAT_CAST(__m256i*, ptr);
+	_mm256_storeu_si256(mptr, val);
+}
+
+static inline __m128i LOAD_SI128(const void* ptr)
+{
+	const __m128i* mptr = WINPR_CXX_COMPAT_CAST(const __m128i*, ptr);
+	return _mm_loadu_si128(mptr);
+}
+
+static inline void STORE_SI128(void* ptr, __m128i val)
+{
+	__m128i* mptr = WINPR_CXX_COMPAT_CAST(__m128i*, ptr);
+	_mm_storeu_si128(mptr, val);
+}
+
+/* The per band quantization and the final rounding of the << 5 YCbCr scaling are done in a
+ * single pass over the coefficients, the result is identical to running them one after another.
+ */
+static inline void rfx_quantization_encode_block_avx2(INT16* WINPR_RESTRICT buffer,
+                                                      size_t buffer_size, UINT32 factor)
+{
+	WINPR_ASSERT((buffer_size % 16) == 0);
+
+	const INT16 h = (factor == 0) ? 0 : WINPR_ASSERTING_INT_CAST(INT16, 1 << (factor - 1));
+	const __m256i half = _mm256_set1_epi16(h);
+	const __m128i shift = _mm_cvtsi32_si128(WINPR_ASSERTING_INT_CAST(int, factor));
+	const __m256i round = _mm256_set1_epi16(1 << 4);
+	const __m128i scale = _mm_cvtsi32_si128(5);
+
+	for (size_t x = 0; x < buffer_size; x += 16)
+	{
+		__m256i a = LOAD_SI256(&buffer[x]);
+		a = _mm256_sra_epi16(_mm256_add_epi16(a, half), shift);
+		a = _mm256_sra_epi16(_mm256_add_epi16(a, round), scale);
+		STORE_SI256(&buffer[x], a);
+	}
+}
+
+static void rfx_quantization_encode_avx2(INT16* WINPR_RESTRICT buffer,
+                                         const UINT32* WINPR_RESTRICT quantization_values)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(quantization_values);
+	for (size_t x = 0; x < 10; x++)
+	{
+		WINPR_ASSERT(quantization_values[x] >= 6);
+		WINPR_ASSERT(quantization_values[x] <= INT16_MAX + 6);
+	}
+
+	rfx_quantization_encode_block_avx2(buffer, 1024, quantization_values[8] - 6);        /* HL1 */
+	rfx_quantization_encode_block_avx2(buffer + 1024, 1024, quantization_values[7] - 6); /* LH1 */
+	rfx_quantization_encode_block_avx2(buffer + 2048, 1024, quantization_values[9] - 6); /* HH1 */
+	rfx_quantization_encode_block_avx2(buffer + 3072, 256, quantization_values[5] - 6);  /* HL2 */
+	rfx_quantization_encode_block_avx2(buffer + 3328, 256, quantization_values[4] - 6);  /* LH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3584, 256, quantization_values[6] - 6);  /* HH2 */
+	rfx_quantization_encode_block_avx2(buffer + 3840, 64, quantization_values[2] - 6);   /* HL3 */
+	rfx_quantization_encode_block_avx2(buffer + 3904, 64, quantization_values[1] - 6);   /* LH3 */
+	rfx_quantization_encode_block_avx2(buffer + 3968, 64, quantization_values[3] - 6);   /* HH3 */
+	rfx_quantization_encode_block_avx2(buffer + 4032, 64, quantization_values[0] - 6);   /* LL3 */
+}
+
+static inline void rfx_dwt_2d_encode_block_vert_avx2(const INT16* WINPR_RESTRICT src,
+                                                     INT16* WINPR_RESTRICT l,
+                                                     INT16* WINPR_RESTRICT h, size_t subband_width)
+{
+	const size_t total_width = subband_width << 1;
+
+	for (size_t n = 0; n < subband_width; n++)
+	{
+		for (size_t x = 0; x < total_width; x += 16)
+		{
+			const __m256i src_2n = LOAD_SI256(src);
+			const __m256i src_2n_1 = LOAD_SI256(src + total_width);
+			__m256i src_2n_2 = src_2n;
+
+			if (n < subband_width - 1)
+				src_2n_2 = LOAD_SI256(src + 2ULL * total_width);
+
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			__m256i h_n = _mm256_add_epi16(src_2n, src_2n_2);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			h_n = _mm256_sub_epi16(src_2n_1, h_n);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			STORE_SI256(h, h_n);
+
+			__m256i h_n_m = h_n;
+			if (n != 0)
+				h_n_m = LOAD_SI256(h - total_width);
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			__m256i l_n = _mm256_add_epi16(h_n_m, h_n);
+			l_n = _mm256_srai_epi16(l_n, 1);
+			l_n = _mm256_add_epi16(l_n, src_2n);
+			STORE_SI256(l, l_n);
+			src += 16;
+			l += 16;
+			h += 16;
+		}
+
+		src += total_width;
+	}
+}
+
+/* Split 32 consecutive coefficients into the 16 even and the 16 odd ones */
+static inline void mm256_deinterleave_epi16(__m256i a, __m256i b, __m256i* WINPR_RESTRICT even,
+                                            __m256i* WINPR_RESTRICT odd)
+{
+	const __m256i ea = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+	const __m256i eb = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+	const __m256i oa = _mm256_srai_epi32(a, 16);
+	const __m256i ob = _mm256_srai_epi32(b, 16);
+
+	/* packs works per 128bit lane, restore the qword order afterwards */
+	*even = _mm256_permute4x64_epi64(_mm256_packs_epi32(ea, eb), 0xD8);
+	*odd = _mm256_permute4x64_epi64(_mm256_packs_epi32(oa, ob), 0xD8);
+}
+
+static inline void rfx_dwt_2d_encode_block_horiz_avx2(const INT16* WINPR_RESTRICT src,
+                                                      INT16* WINPR_RESTRICT l,
+                                                      INT16* WINPR_RESTRICT h,
+                                                      size_t subband_width)
+{
+	WINPR_ASSERT((subband_width % 16) == 0);
+
+	for (size_t y = 0; y < subband_width; y++)
+	{
+		__m256i h_prev = _mm256_setzero_si256();
+
+		for (size_t n = 0; n < subband_width; n += 16)
+		{
+			__m256i src_2n;
+			__m256i src_2n_1;
+			mm256_deinterleave_epi16(LOAD_SI256(src), LOAD_SI256(src + 16), &src_2n, &src_2n_1);
+
+			/* src[2n + 2] is the even vector shifted down by one, the last element of a row
+			 * mirrors src[2n] */
+			const INT16 next = ((n + 16) == subband_width) ? src[30] : src[32];
+			const __m256i carry_next =
+			    _mm256_permute2x128_si256(src_2n, _mm256_set1_epi16(next), 0x21);
+			const __m256i src_2n_2 = _mm256_alignr_epi8(carry_next, src_2n, 2);
+
+			/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+			__m256i h_n = _mm256_add_epi16(src_2n, src_2n_2);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			h_n = _mm256_sub_epi16(src_2n_1, h_n);
+			h_n = _mm256_srai_epi16(h_n, 1);
+			STORE_SI256(h, h_n);
+
+			/* h[n - 1] is h shifted up by one, the first element of a row uses h[0] */
+			if (n == 0)
+				h_prev = _mm256_broadcastw_epi16(_mm256_castsi256_si128(h_n));
+			const __m256i carry_prev = _mm256_permute2x128_si256(h_prev, h_n, 0x21);
+			const __m256i h_n_m = _mm256_alignr_epi8(h_n, carry_prev, 14);
+
+			/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+			__m256i l_n = _mm256_add_epi16(h_n_m, h_n);
+			l_n = _mm256_srai_epi16(l_n, 1);
+			l_n = _mm256_add_epi16(l_n, src_2n);
+			STORE_SI256(l, l_n);
+
+			h_prev = h_n;
+			src += 32;
+			l += 16;
+			h += 16;
+		}
+	}
+}
+
+/* The level 3 sub-bands are only 8 coefficients wide, use 128bit vectors for these. */
+static inline void rfx_dwt_2d_encode_block_horiz8_avx2(const INT16* WINPR_RESTRICT src,
+                                                       INT16* WINPR_RESTRICT l,
+                                                       INT16* WINPR_RESTRICT h)
+{
+	for (size_t y = 0; y < 8; y++)
+	{
+		const __m128i a = LOAD_SI128(src);
+		const __m128i b = LOAD_SI128(src + 8);
+		const __m128i ea = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		const __m128i eb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		const __m128i src_2n = _mm_packs_epi32(ea, eb);
+		const __m128i src_2n_1 = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+		const __m128i src_2n_2 = _mm_alignr_epi8(_mm_set1_epi16(src[14]), src_2n, 2);
+
+		/* h[n] = (src[2n + 1] - ((src[2n] + src[2n + 2]) >> 1)) >> 1 */
+		__m128i h_n = _mm_add_epi16(src_2n, src_2n_2);
+		h_n = _mm_srai_epi16(h_n, 1);
+		h_n = _mm_sub_epi16(src_2n_1, h_n);
+		h_n = _mm_srai_epi16(h_n, 1);
+		STORE_SI128(h, h_n);
+
+		const __m128i h_n_m = _mm_alignr_epi8(h_n, _mm_broadcastw_epi16(h_n), 14);
+
+		/* l[n] = src[2n] + ((h[n - 1] + h[n]) >> 1) */
+		__m128i l_n = _mm_add_epi16(h_n_m, h_n);
+		l_n = _mm_srai_epi16(l_n, 1);
+		l_n = _mm_add_epi16(l_n, src_2n);
+		STORE_SI128(l, l_n);
+
+		src += 16;
+		l += 8;
+		h += 8;
+	}
+}
+
+static inline void rfx_dwt_2d_encode_block_avx2(INT16* WINPR_RESTRICT buffer,
+                                                INT16* WINPR_RESTRICT dwt, size_t subband_width)
+{
+	/* DWT in vertical direction, results in 2 sub-bands in L, H order in tmp buffer dwt. */
+	INT16* l_src = dwt;
+	INT16* h_src = dwt + 2ULL * subband_width * subband_width;
+	rfx_dwt_2d_encode_block_vert_avx2(buffer, l_src, h_src, subband_width);
+	/* DWT in horizontal direction, results in 4 sub-bands in HL(0), LH(1), HH(2), LL(3) order,
+	 * stored in original buffer. */
+	/* The lower part L generates LL(3) and HL(0). */
+	/* The higher part H generates LH(1) and HH(2). */
+	INT16* ll = buffer + 3ULL * subband_width * subband_width;
+	INT16* hl = buffer;
+	INT16* lh = buffer + 1ULL * subband_width * subband_width;
+	INT16* hh = buffer + 2ULL * subband_width * subband_width;
+
+	if (subband_width == 8)
+	{
+		rfx_dwt_2d_encode_block_horiz8_avx2(l_src, ll, hl);
+		rfx_dwt_2d_encode_block_horiz8_avx2(h_src, lh, hh);
+	}
+	else
+	{
+		rfx_dwt_2d_encode_block_horiz_avx2(l_src, ll, hl, subband_width);
+		rfx_dwt_2d_encode_block_horiz_avx2(h_src, lh, hh, subband_width);
+	}
+}
+
+static void rfx_dwt_2d_encode_avx2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT dwt_buffer)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(dwt_buffer);
+
+	rfx_dwt_2d_encode_block_avx2(buffer, dwt_buffer, 32);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3072, dwt_buffer, 16);
+	rfx_dwt_2d_encode_block_avx2(buffer + 3840, dwt_buffer, 8);
+}
+#endif
+
+void rfx_init_avx2_int(RFX_CONTEXT* WINPR_RESTRICT context)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	PROFILER_RENAME(context->priv->prof_rfx_quantization_encode, "rfx_quantization_encode_avx2")
+	PROFILER_RENAME(context->priv->prof_rfx_dwt_2d_encode, "rfx_dwt_2d_encode_avx2")
+	context->quantization_encode = rfx_quantization_encode_avx2;
+	context->dwt_2d_encode = rfx_dwt_2d_encode_avx2;
+#else
+	WINPR_UNUSED(context);
+#endif
+}
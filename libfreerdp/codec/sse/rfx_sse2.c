@@ -449,6 +449,212 @@ static void rfx_dwt_2d_encode_sse2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RE
 	rfx_dwt_2d_encode_block_sse2(buffer + 3072, dwt_buffer, 16);
 	rfx_dwt_2d_encode_block_sse2(buffer + 3840, dwt_buffer, 8);
 }
+
+/* (a + b) / 2 rounded towards zero like the C division, without 16bit overflow */
+static __inline __m128i __attribute__((ATTRIBUTES)) mm_avg_trunc_epi16(__m128i a, __m128i b)
+{
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i sum = _mm_add_epi16(_mm_srai_epi16(a, 1), _mm_srai_epi16(b, 1));
+	const __m128i floor = _mm_add_epi16(sum, _mm_and_si128(_mm_and_si128(a, b), one));
+	const __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), one);
+	return _mm_add_epi16(floor, _mm_and_si128(odd, _mm_srli_epi16(floor, 15)));
+}
+
+/* a / 2 rounded towards zero */
+static __inline __m128i __attribute__((ATTRIBUTES)) mm_half_trunc_epi16(__m128i a)
+{
+	return _mm_srai_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 15)), 1);
+}
+
+/* clamp(a + 2 * h), both additions saturate in the same direction */
+static __inline __m128i __attribute__((ATTRIBUTES)) mm_add_twice_epi16(__m128i a, __m128i h)
+{
+	return _mm_adds_epi16(_mm_adds_epi16(a, h), h);
+}
+
+static __inline INT16 __attribute__((ATTRIBUTES)) rfx_clamp_i16(INT32 val)
+{
+	if (val < INT16_MIN)
+		return INT16_MIN;
+	if (val > INT16_MAX)
+		return INT16_MAX;
+	return (INT16)val;
+}
+
+/*
+ * SSE2 versions of progressive_rfx_idwt_x/y.
+ *
+ * With E[j] = L[j] - (H[j - 1] + H[j]) / 2 (H[-1] = H[0]) and O[j] = (E[j] + E[j + 1]) / 2 + 2H[j]
+ * every even output is E[j] and every odd output O[j]. The last E is extrapolated from the low
+ * band. All intermediate results are clamped to INT16 exactly like the generic code does.
+ */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_horiz_sse2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                                const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                                INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                                size_t nHighCount, size_t nDstCount)
+{
+	INT16 even[40] = { 0 };
+	const __m128i lane0 = _mm_set_epi16(0, 0, 0, 0, 0, 0, 0, -1);
+
+	WINPR_ASSERT(nHighCount >= 8);
+	WINPR_ASSERT(nHighCount < ARRAYSIZE(even) - 8);
+
+	for (size_t i = 0; i < nDstCount; i++)
+	{
+		const INT16* pL = pLowBand;
+		const INT16* pH = pHighBand;
+		INT16* pX = pDstBand;
+
+		/* The last vector overlaps the previous one if nHighCount is not a multiple of 8 */
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t j = (n + 8 > nHighCount) ? nHighCount - 8 : n;
+			const __m128i h_n = LOAD_SI128(&pH[j]);
+			__m128i h_n_m;
+			if (j == 0)
+				h_n_m = _mm_or_si128(_mm_slli_si128(h_n, 2), _mm_and_si128(h_n, lane0));
+			else
+				h_n_m = LOAD_SI128(&pH[j - 1]);
+
+			const __m128i e_n = _mm_subs_epi16(LOAD_SI128(&pL[j]), mm_avg_trunc_epi16(h_n_m, h_n));
+			STORE_SI128(&even[j], e_n);
+		}
+
+		const INT32 H0 = pH[nHighCount - 1];
+		if (nLowCount <= nHighCount)
+			even[nHighCount] = even[nHighCount - 1];
+		else if (nLowCount == nHighCount + 1)
+			even[nHighCount] = rfx_clamp_i16(pL[nHighCount] - H0);
+		else
+			even[nHighCount] = rfx_clamp_i16(pL[nHighCount] - (H0 / 2));
+
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t j = (n + 8 > nHighCount) ? nHighCount - 8 : n;
+			const __m128i e_n = LOAD_SI128(&even[j]);
+			const __m128i e_n_p = LOAD_SI128(&even[j + 1]);
+			const __m128i h_n = LOAD_SI128(&pH[j]);
+			const __m128i o_n = mm_add_twice_epi16(mm_avg_trunc_epi16(e_n, e_n_p), h_n);
+			STORE_SI128(&pX[2 * j], _mm_unpacklo_epi16(e_n, o_n));
+			STORE_SI128(&pX[2 * j + 8], _mm_unpackhi_epi16(e_n, o_n));
+		}
+
+		if (nLowCount > nHighCount)
+			pX[2 * nHighCount] = even[nHighCount];
+		if (nLowCount > nHighCount + 1)
+			pX[2 * nHighCount + 1] = (INT16)((even[nHighCount] + pL[nHighCount + 1]) / 2);
+
+		pLowBand += nLowStep;
+		pHighBand += nHighStep;
+		pDstBand += nDstStep;
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_vert_sse2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                               const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                               INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                               size_t nHighCount, size_t nDstCount)
+{
+	WINPR_ASSERT(nDstCount >= 8);
+	WINPR_ASSERT(nHighCount > 0);
+
+	/* The last columns overlap the previous ones if nDstCount is not a multiple of 8 */
+	for (size_t n = 0; n < nDstCount; n += 8)
+	{
+		const size_t x = (n + 8 > nDstCount) ? nDstCount - 8 : n;
+		const INT16* pL = &pLowBand[x];
+		const INT16* pH = &pHighBand[x];
+		INT16* pX = &pDstBand[x];
+
+		__m128i h_n = LOAD_SI128(pH);
+		__m128i e_n = _mm_subs_epi16(LOAD_SI128(pL), h_n);
+
+		for (size_t j = 0; j < nHighCount; j++)
+		{
+			__m128i h_n_p = h_n;
+			__m128i e_n_p = e_n;
+
+			if (j + 1 < nHighCount)
+			{
+				h_n_p = LOAD_SI128(&pH[(j + 1) * nHighStep]);
+				e_n_p = _mm_subs_epi16(LOAD_SI128(&pL[(j + 1) * nLowStep]),
+				                       mm_avg_trunc_epi16(h_n, h_n_p));
+			}
+			else if (nLowCount == nHighCount + 1)
+				e_n_p = _mm_subs_epi16(LOAD_SI128(&pL[nHighCount * nLowStep]), h_n);
+			else if (nLowCount > nHighCount + 1)
+				e_n_p = _mm_subs_epi16(LOAD_SI128(&pL[nHighCount * nLowStep]),
+				                       mm_half_trunc_epi16(h_n));
+
+			const __m128i o_n = mm_add_twice_epi16(mm_avg_trunc_epi16(e_n, e_n_p), h_n);
+			STORE_SI128(&pX[(2 * j) * nDstStep], e_n);
+			STORE_SI128(&pX[(2 * j + 1) * nDstStep], o_n);
+			e_n = e_n_p;
+			h_n = h_n_p;
+		}
+
+		if (nLowCount > nHighCount)
+			STORE_SI128(&pX[(2 * nHighCount) * nDstStep], e_n);
+		if (nLowCount > nHighCount + 1)
+		{
+			const __m128i l_n = LOAD_SI128(&pL[(nHighCount + 1) * nLowStep]);
+			STORE_SI128(&pX[(2 * nHighCount + 1) * nDstStep], mm_avg_trunc_epi16(e_n, l_n));
+		}
+	}
+}
+
+static __inline size_t __attribute__((ATTRIBUTES)) prfx_get_band_l_count(size_t level)
+{
+	return (64 >> level) + 1;
+}
+
+static __inline size_t __attribute__((ATTRIBUTES)) prfx_get_band_h_count(size_t level)
+{
+	if (level == 1)
+		return (64 >> 1) - 1;
+	else
+		return (64 + (1 << (level - 1))) >> level;
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_extrapolate_decode_block_sse2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT temp,
+                                         size_t level)
+{
+	const size_t nBandL = prfx_get_band_l_count(level);
+	const size_t nBandH = prfx_get_band_h_count(level);
+	const size_t nDstStep = nBandL + nBandH;
+
+	const INT16* HL = &buffer[0];
+	const INT16* LH = &HL[nBandH * nBandL];
+	const INT16* HH = &LH[nBandL * nBandH];
+	const INT16* LL = &HH[nBandH * nBandH];
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nDstStep];
+
+	/* horizontal (LL + HL -> L) */
+	rfx_idwt_extrapolate_horiz_sse2(LL, nBandL, HL, nBandH, L, nDstStep, nBandL, nBandH, nBandL);
+
+	/* horizontal (LH + HH -> H) */
+	rfx_idwt_extrapolate_horiz_sse2(LH, nBandL, HH, nBandH, H, nDstStep, nBandL, nBandH, nBandH);
+
+	/* vertical (L + H -> LL) */
+	rfx_idwt_extrapolate_vert_sse2(L, nDstStep, H, nDstStep, buffer, nDstStep, nBandL, nBandH,
+	                               nBandL + nBandH);
+}
+
+static void rfx_dwt_2d_extrapolate_decode_sse2(INT16* WINPR_RESTRICT buffer,
+                                               INT16* WINPR_RESTRICT temp)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(temp);
+
+	mm_prefetch_buffer((char*)buffer, 4096 * sizeof(INT16));
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[3807], temp, 3);
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[3007], temp, 2);
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[0], temp, 1);
+}
 #endif
 
 void rfx_init_sse2_int(RFX_CONTEXT* WINPR_RESTRICT context)
@@ -461,6 +667,7 @@ void rfx_init_sse2_int(RFX_CONTEXT* WINPR_RESTRICT context)
 	context->quantization_decode = rfx_quantization_decode_sse2;
 	context->quantization_encode = rfx_quantization_encode_sse2;
 	context->dwt_2d_decode = rfx_dwt_2d_decode_sse2;
+	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode_sse2;
 	context->dwt_2d_encode = rfx_dwt_2d_encode_sse2;
 #else
 	WINPR_UNUSED(context);
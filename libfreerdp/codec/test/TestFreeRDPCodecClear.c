@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/platform.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/codec/clear.h>
 
@@ -68,6 +69,175 @@ fail:
 	return rc;
 }
 
+typedef enum
+{
+	CLEAR_TEST_TEXT,
+	CLEAR_TEST_FLAT,
+	CLEAR_TEST_GRADIENT,
+	CLEAR_TEST_NOISE
+} CLEAR_TEST_PATTERN;
+
+static void test_ClearFillImage(BYTE* data, UINT32 width, UINT32 height, CLEAR_TEST_PATTERN pattern)
+{
+	const size_t stride = 4ull * width;
+
+	if (pattern == CLEAR_TEST_NOISE)
+	{
+		winpr_RAND(data, stride * height);
+		return;
+	}
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			BYTE* pixel = &data[y * stride + 4ull * x];
+			BYTE value = 0xFF;
+
+			switch (pattern)
+			{
+				case CLEAR_TEST_TEXT:
+				{
+					/* pseudo glyphs: four shapes made of stems and bars in 9x13 cells */
+					const UINT32 cx = x % 9;
+					const UINT32 cy = y % 13;
+					const UINT32 shape = ((x / 9) + (y / 13)) % 4;
+
+					if ((cy >= 2) && (cy < 11) && (cx >= 1) && (cx < 7))
+					{
+						if ((cx == 1) || ((cx == 6) && (shape & 1)) ||
+						    ((cy == 2 + 4 * (shape >> 1)) && (cx < 6)))
+							value = 0x10;
+					}
+
+					pixel[0] = value;
+					pixel[1] = value;
+					pixel[2] = value;
+				}
+				break;
+
+				case CLEAR_TEST_FLAT:
+					pixel[0] = 0x30;
+					pixel[1] = 0x60;
+					pixel[2] = 0x90;
+					break;
+
+				case CLEAR_TEST_GRADIENT:
+				default:
+					pixel[0] = (BYTE)((x / 3) % 100);
+					pixel[1] = (BYTE)((x / 3) % 100 + 20);
+					pixel[2] = (BYTE)(y / 8);
+					break;
+			}
+
+			pixel[3] = 0xFF;
+		}
+	}
+}
+
+static BOOL test_ClearRoundTripImage(CLEAR_CONTEXT* encoder, CLEAR_CONTEXT* decoder,
+                                     const BYTE* data, UINT32 width, UINT32 height,
+                                     size_t* pEncodedSize)
+{
+	BOOL rc = FALSE;
+	BYTE* decoded = calloc(4ull * width, height);
+	wStream* s = Stream_New(NULL, 1024);
+
+	if (!decoded || !s)
+		goto fail;
+
+	if (!clear_compose_message(encoder, s, data, PIXEL_FORMAT_BGRX32, 4 * width, width, height))
+	{
+		(void)fprintf(stderr, "clear_compose_message %" PRIu32 "x%" PRIu32 " failed\n", width,
+		              height);
+		goto fail;
+	}
+
+	const size_t length = Stream_GetPosition(s);
+	if (length > UINT32_MAX)
+		goto fail;
+
+	if (clear_decompress(decoder, Stream_Buffer(s), (UINT32)length, width, height, decoded,
+	                     PIXEL_FORMAT_BGRX32, 4 * width, 0, 0, width, height, NULL) != 0)
+	{
+		(void)fprintf(stderr, "clear_decompress %" PRIu32 "x%" PRIu32 " failed\n", width, height);
+		goto fail;
+	}
+
+	for (size_t i = 0; i < 1ull * width * height; i++)
+	{
+		if (memcmp(&data[4 * i], &decoded[4 * i], 3) != 0)
+		{
+			(void)fprintf(stderr, "pixel mismatch at %" PRIuz " for %" PRIu32 "x%" PRIu32 "\n", i,
+			              width, height);
+			goto fail;
+		}
+	}
+
+	if (pEncodedSize)
+		*pEncodedSize = length;
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	free(decoded);
+	return rc;
+}
+
+static BOOL test_ClearCompressRoundTrip(void)
+{
+	const struct
+	{
+		UINT32 width;
+		UINT32 height;
+		CLEAR_TEST_PATTERN pattern;
+	} tests[] = { { 300, 120, CLEAR_TEST_TEXT },    { 64, 64, CLEAR_TEST_FLAT },
+		          { 256, 60, CLEAR_TEST_GRADIENT }, { 200, 70, CLEAR_TEST_NOISE },
+		          { 300, 120, CLEAR_TEST_TEXT },    { 1, 1, CLEAR_TEST_FLAT },
+		          { 16, 16, CLEAR_TEST_TEXT },      { 16, 16, CLEAR_TEST_TEXT } };
+	BOOL rc = FALSE;
+	size_t sizes[ARRAYSIZE(tests)] = { 0 };
+	BYTE* data = calloc(4ull * 300, 120);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+
+	if (!data || !encoder || !decoder)
+		goto fail;
+
+	for (size_t i = 0; i < ARRAYSIZE(tests); i++)
+	{
+		test_ClearFillImage(data, tests[i].width, tests[i].height, tests[i].pattern);
+
+		if (!test_ClearRoundTripImage(encoder, decoder, data, tests[i].width, tests[i].height,
+		                              &sizes[i]))
+			goto fail;
+
+		(void)printf("clear round trip %" PRIu32 "x%" PRIu32 ": %" PRIuz " bytes\n",
+		             tests[i].width, tests[i].height, sizes[i]);
+	}
+
+	/* The repeated text image must hit the vbar cache, the repeated glyph the glyph cache */
+	if (sizes[4] >= sizes[0])
+		goto fail;
+
+	if (sizes[7] != 4)
+		goto fail;
+
+	/* After a reset the encoder must not reference vbars cached before */
+	if (!clear_context_reset(encoder) || !clear_context_reset(decoder))
+		goto fail;
+
+	test_ClearFillImage(data, 300, 120, CLEAR_TEST_TEXT);
+	if (!test_ClearRoundTripImage(encoder, decoder, data, 300, 120, NULL))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(data);
+	return rc;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -87,5 +257,8 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 	if (!test_ClearDecompressExample(4, 7, 15, TEST_CLEAR_EXAMPLE_4, sizeof(TEST_CLEAR_EXAMPLE_4)))
 		return -1;
 
+	if (!test_ClearCompressRoundTrip())
+		return -1;
+
 	return 0;
 }
@@ -8,6 +8,7 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/primitives.h>
 
 #define TEST_RUNS 2
 
@@ -86,6 +87,53 @@ fail:
 	free(dst);
 	return rc;
 }
+
+/* Large copies are split in bands, compare them with a single primitives call */
+static BOOL TestFreeRDPImageCopy_parallel(UINT32 w, UINT32 h, UINT32 srcFormat, UINT32 dstFormat,
+                                          UINT32 flags)
+{
+	BOOL rc = FALSE;
+	const UINT32 nXSrc = 3;
+	const UINT32 nYSrc = (flags & FREERDP_FLIP_VERTICAL) ? 0 : 5;
+	const UINT32 nXDst = 7;
+	const UINT32 nYDst = 11;
+	const size_t srcStep = (w + nXSrc) * FreeRDPGetBytesPerPixel(srcFormat);
+	const size_t dstStep = (w + nXDst) * FreeRDPGetBytesPerPixel(dstFormat);
+	const size_t srcSize = (h + nYSrc) * srcStep;
+	const size_t dstSize = (h + nYDst) * dstStep;
+	const primitives_t* prims = primitives_get();
+	BYTE* src = calloc(1, srcSize);
+	BYTE* dst = calloc(1, dstSize);
+	BYTE* ref = calloc(1, dstSize);
+	if (!prims || !src || !dst || !ref)
+		goto fail;
+
+	winpr_RAND_pseudo(src, srcSize);
+	winpr_RAND_pseudo(dst, dstSize);
+	memcpy(ref, dst, dstSize);
+
+	if (!freerdp_image_copy_no_overlap(dst, dstFormat, (UINT32)dstStep, nXDst, nYDst, w, h, src,
+	                                   srcFormat, (UINT32)srcStep, nXSrc, nYSrc, NULL, flags))
+		goto fail;
+	if (prims->copy_no_overlap(ref, dstFormat, (UINT32)dstStep, nXDst, nYDst, w, h, src,
+	                           srcFormat, (UINT32)srcStep, nXSrc, nYSrc, NULL,
+	                           flags) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	rc = memcmp(dst, ref, dstSize) == 0;
+	if (!rc)
+		(void)fprintf(stderr,
+		              "[%s] %" PRIu32 "x%" PRIu32 " [%s] -> [%s] flags 0x%08" PRIx32 " mismatch\n",
+		              __func__, w, h, FreeRDPGetColorFormatName(srcFormat),
+		              FreeRDPGetColorFormatName(dstFormat), flags);
+
+fail:
+	free(src);
+	free(dst);
+	free(ref);
+	return rc;
+}
+
 int TestFreeRDPCodecCopy(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -126,5 +174,16 @@ int TestFreeRDPCodecCopy(int argc, char* argv[])
 		}
 	}
 
+	const UINT32 flags[] = { FREERDP_FLIP_NONE, FREERDP_FLIP_VERTICAL, FREERDP_KEEP_DST_ALPHA };
+	for (size_t x = 0; x < ARRAYSIZE(flags); x++)
+	{
+		if (!TestFreeRDPImageCopy_parallel(1283, 1031, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRA32,
+		                                   flags[x]))
+			return -1;
+		if (!TestFreeRDPImageCopy_parallel(1283, 1031, PIXEL_FORMAT_RGB16, PIXEL_FORMAT_BGRX32,
+		                                   flags[x]))
+			return -1;
+	}
+
 	return 0;
 }
@@ -0,0 +1,278 @@
+#include <math.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/dsp.h>
+
+static const double test_pi = 3.14159265358979323846;
+
+static AUDIO_FORMAT test_pcm_format(UINT32 rate, UINT16 channels)
+{
+	AUDIO_FORMAT format = { 0 };
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = channels;
+	format.nSamplesPerSec = rate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = 2 * channels;
+	format.nAvgBytesPerSec = rate * format.nBlockAlign;
+	return format;
+}
+
+static INT16 test_sample(const BYTE* data, size_t index)
+{
+	return (INT16)(data[2 * index] | (data[2 * index + 1] << 8));
+}
+
+static void test_write_sample(BYTE* data, size_t index, INT16 val)
+{
+	data[2 * index] = (BYTE)(val & 0xFF);
+	data[2 * index + 1] = (BYTE)((val >> 8) & 0xFF);
+}
+
+/* Encodes a stereo sine in 10ms packets and returns the resampled result */
+static wStream* test_resample_sine(FREERDP_DSP_RESAMPLE_QUALITY quality, UINT32 srcRate,
+                                   UINT32 dstRate, double frequency, size_t packets)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(srcRate, 2);
+	const AUDIO_FORMAT dstFormat = test_pcm_format(dstRate, 2);
+	const size_t frames = srcRate / 100;
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	BYTE* packet = calloc(frames, 4);
+	wStream* out = Stream_New(NULL, 1024);
+
+	if (!context || !packet || !out)
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, &dstFormat, 0))
+		goto fail;
+
+	if (!freerdp_dsp_context_set_resample_quality(context, quality))
+		goto fail;
+
+	for (size_t p = 0; p < packets; p++)
+	{
+		for (size_t x = 0; x < frames; x++)
+		{
+			const double t = (double)(p * frames + x) / srcRate;
+			const INT16 val = (INT16)lround(10000.0 * sin(2.0 * test_pi * frequency * t));
+			test_write_sample(packet, 2 * x, val);
+			test_write_sample(packet, 2 * x + 1, val);
+		}
+
+		if (!freerdp_dsp_encode(context, &srcFormat, packet, frames * 4, out))
+			goto fail;
+	}
+
+	Stream_SealLength(out);
+	rc = TRUE;
+fail:
+	free(packet);
+	freerdp_dsp_context_free(context);
+
+	if (!rc)
+	{
+		Stream_Free(out, TRUE);
+		return NULL;
+	}
+
+	return out;
+}
+
+/* RMS of the left channel, skipping the filter warm up */
+static double test_rms(wStream* s, size_t skip, BOOL* stereoMatch)
+{
+	const BYTE* data = Stream_Buffer(s);
+	const size_t frames = Stream_Length(s) / 4;
+	double sum = 0.0;
+
+	*stereoMatch = TRUE;
+
+	for (size_t x = skip; x < frames; x++)
+	{
+		const INT16 left = test_sample(data, 2 * x);
+		const INT16 right = test_sample(data, 2 * x + 1);
+
+		if (left != right)
+			*stereoMatch = FALSE;
+
+		sum += 1.0 * left * left;
+	}
+
+	return sqrt(sum / (double)(frames - skip));
+}
+
+static BOOL test_resample(FREERDP_DSP_RESAMPLE_QUALITY quality)
+{
+	BOOL rc = FALSE;
+	BOOL stereoMatch = FALSE;
+	const size_t packets = 20;
+
+	/* A 1kHz tone passes unchanged */
+	wStream* pass = test_resample_sine(quality, 44100, 48000, 1000.0, packets);
+
+	/* A 12kHz tone is above the new Nyquist frequency and must be filtered */
+	wStream* stop = test_resample_sine(quality, 48000, 16000, 12000.0, packets);
+
+	if (!pass || !stop)
+		goto fail;
+
+	const size_t expected = packets * 480;
+	const size_t frames = Stream_Length(pass) / 4;
+
+	/* Output lags by at most half a filter, 16 frames for the high quality setting */
+	if ((frames > expected) || (frames + 20 < expected))
+	{
+		(void)fprintf(stderr, "[%d] got %" PRIuz " frames, expected %" PRIuz "\n", quality,
+		              frames, expected);
+		goto fail;
+	}
+
+	const double passRms = test_rms(pass, 64, &stereoMatch);
+	const double ideal = 10000.0 / sqrt(2.0);
+
+	if (!stereoMatch || (fabs(passRms - ideal) > ideal * 0.02))
+	{
+		(void)fprintf(stderr, "[%d] pass band rms %lf, expected %lf\n", quality, passRms, ideal);
+		goto fail;
+	}
+
+	const double stopRms = test_rms(stop, 64, &stereoMatch);
+	const double limits[] = { 0.3, 0.08, 0.01 };
+	const double limit = limits[quality];
+
+	if (!stereoMatch || (stopRms > ideal * limit))
+	{
+		(void)fprintf(stderr, "[%d] stop band rms %lf, limit %lf\n", quality, stopRms,
+		              ideal * limit);
+		goto fail;
+	}
+
+	(void)printf("[%d] pass band rms %lf, stop band rms %lf\n", quality, passRms, stopRms);
+	rc = TRUE;
+fail:
+	Stream_Free(pass, TRUE);
+	Stream_Free(stop, TRUE);
+	return rc;
+}
+
+static BOOL test_channel_mix(UINT16 srcChannels, UINT16 dstChannels, size_t frames)
+{
+	BOOL rc = FALSE;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(44100, srcChannels);
+	const AUDIO_FORMAT dstFormat = test_pcm_format(44100, dstChannels);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	BYTE* src = calloc(frames, 2ull * srcChannels);
+	wStream* out = Stream_New(NULL, 1024);
+
+	if (!context || !src || !out)
+		goto fail;
+
+	if (!freerdp_dsp_context_reset(context, &dstFormat, 0))
+		goto fail;
+
+	winpr_RAND(src, frames * 2 * srcChannels);
+
+	if (!freerdp_dsp_encode(context, &srcFormat, src, frames * 2 * srcChannels, out))
+		goto fail;
+
+	if (Stream_GetPosition(out) != frames * 2 * dstChannels)
+		goto fail;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const BYTE* dst = Stream_Buffer(out);
+
+		if (srcChannels == 1)
+		{
+			const INT16 val = test_sample(src, x);
+
+			if ((test_sample(dst, 2 * x) != val) || (test_sample(dst, 2 * x + 1) != val))
+				goto fail;
+		}
+		else
+		{
+			const INT32 left = test_sample(src, 2 * x);
+			const INT32 right = test_sample(src, 2 * x + 1);
+
+			if (test_sample(dst, x) != (INT16)((left + right) >> 1))
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		(void)fprintf(stderr, "channel mix %" PRIu16 " -> %" PRIu16 ", %" PRIuz " frames failed\n",
+		              srcChannels, dstChannels, frames);
+
+	free(src);
+	Stream_Free(out, TRUE);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+static BOOL test_opus_framing(void)
+{
+	BOOL rc = FALSE;
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+
+	if (!context)
+		goto fail;
+
+	if (!freerdp_dsp_context_set_opus_framing(context, 10, TRUE, 10))
+		goto fail;
+
+	if (!freerdp_dsp_context_set_opus_framing(context, 20, FALSE, 0))
+		goto fail;
+
+	if (!freerdp_dsp_context_set_opus_framing(context, 0, FALSE, 0))
+		goto fail;
+
+	/* Only 10 and 20ms frames are supported */
+	if (freerdp_dsp_context_set_opus_framing(context, 15, FALSE, 0))
+		goto fail;
+
+	if (freerdp_dsp_context_set_opus_framing(context, 20, TRUE, 101))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		(void)fprintf(stderr, "opus framing arguments not validated\n");
+
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+int TestFreeRDPCodecDsp(int argc, char* argv[])
+{
+	const FREERDP_DSP_RESAMPLE_QUALITY qualities[] = { FREERDP_DSP_RESAMPLE_QUALITY_LOW,
+		                                               FREERDP_DSP_RESAMPLE_QUALITY_MEDIUM,
+		                                               FREERDP_DSP_RESAMPLE_QUALITY_HIGH };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	for (size_t x = 0; x < ARRAYSIZE(qualities); x++)
+	{
+		if (!test_resample(qualities[x]))
+			return -1;
+	}
+
+	for (size_t frames = 1; frames < 40; frames += 3)
+	{
+		if (!test_channel_mix(1, 2, frames))
+			return -1;
+
+		if (!test_channel_mix(2, 1, frames))
+			return -1;
+	}
+
+	if (!test_opus_framing())
+		return -1;
+
+	return 0;
+}
@@ -8,6 +8,8 @@
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/codec/yuv.h>
+#include <freerdp/primitives.h>
 
 static const char* print_ns(UINT64 start, UINT64 end, char* buffer, size_t len)
 {
@@ -58,6 +60,90 @@ fail:
 	return rc;
 }
 
+static BOOL testHwEncoderOption(void)
+{
+	BOOL rc = FALSE;
+	H264_CONTEXT* h264 = h264_context_new(TRUE);
+	if (!h264)
+		return FALSE;
+
+	if (h264_context_get_option(h264, H264_CONTEXT_OPTION_HW_ENCODER) != H264_HW_ENCODER_AUTO)
+		goto fail;
+
+	const UINT32 encoders[] = { H264_HW_ENCODER_VAAPI, H264_HW_ENCODER_NVENC,
+		                        H264_HW_ENCODER_AUTO };
+	for (size_t x = 0; x < ARRAYSIZE(encoders); x++)
+	{
+		if (!h264_context_set_option(h264, H264_CONTEXT_OPTION_HW_ENCODER, encoders[x]))
+			goto fail;
+		if (h264_context_get_option(h264, H264_CONTEXT_OPTION_HW_ENCODER) != encoders[x])
+			goto fail;
+	}
+
+	if (h264_context_set_option(h264, H264_CONTEXT_OPTION_HW_ENCODER, 0x1234))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	return rc;
+}
+
+static BOOL testHwFramesOption(void)
+{
+	BOOL rc = FALSE;
+	H264_DMABUF_FRAME frame = { 0 };
+	H264_CONTEXT* h264 = h264_context_new(FALSE);
+	if (!h264)
+		return FALSE;
+
+	if (!h264_context_set_option(h264, H264_CONTEXT_OPTION_HW_FRAMES, TRUE))
+		goto fail;
+	if (!h264_context_get_option(h264, H264_CONTEXT_OPTION_HW_FRAMES))
+		goto fail;
+
+	/* Nothing decoded yet */
+	if (h264_context_get_dmabuf(h264, &frame))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	return rc;
+}
+
+static BOOL testThreadOptions(void)
+{
+	BOOL rc = FALSE;
+	H264_CONTEXT* h264 = h264_context_new(FALSE);
+	if (!h264)
+		return FALSE;
+
+	if ((h264_context_get_option(h264, H264_CONTEXT_OPTION_THREAD_TYPE) != H264_THREAD_SLICE) ||
+	    h264_context_get_option(h264, H264_CONTEXT_OPTION_SHARED_THREADPOOL))
+		goto fail;
+
+	if (!h264_context_set_option(h264, H264_CONTEXT_OPTION_THREADS, 4) ||
+	    !h264_context_set_option(h264, H264_CONTEXT_OPTION_THREAD_TYPE, H264_THREAD_FRAME) ||
+	    !h264_context_set_option(h264, H264_CONTEXT_OPTION_SHARED_THREADPOOL, TRUE))
+		goto fail;
+	if (h264_context_set_option(h264, H264_CONTEXT_OPTION_THREAD_TYPE, 0x1234))
+		goto fail;
+	if ((h264_context_get_option(h264, H264_CONTEXT_OPTION_THREADS) != 4) ||
+	    (h264_context_get_option(h264, H264_CONTEXT_OPTION_THREAD_TYPE) != H264_THREAD_FRAME) ||
+	    !h264_context_get_option(h264, H264_CONTEXT_OPTION_SHARED_THREADPOOL))
+		goto fail;
+
+	/* the decoder is opened again with the new settings */
+	if (!h264_context_reset(h264, 64, 64))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	return rc;
+}
+
 static void* allocRGB(uint32_t format, uint32_t width, uint32_t height, uint32_t* pstride)
 {
 	const size_t bpp = FreeRDPGetBytesPerPixel(format);
@@ -76,6 +162,61 @@ static void* allocRGB(uint32_t format, uint32_t width, uint32_t height, uint32_t
 	return rgb;
 }
 
+static BOOL testQpRegions(uint32_t width, uint32_t height)
+{
+	BOOL rc = FALSE;
+	void* src = NULL;
+	uint8_t* dst = NULL;
+	uint32_t dstsize = 0;
+	uint32_t stride = 0;
+	RDPGFX_H264_METABLOCK meta = { 0 };
+	const H264_QP_REGION regions[] = { { { 0, 0, 64, 64 }, -60 }, { { 0, 0, 128, 128 }, 6 } };
+	H264_CONTEXT* h264 = h264_context_new(TRUE);
+	H264_CONTEXT* h264dec = h264_context_new(FALSE);
+	if (!h264 || !h264dec)
+		goto fail;
+
+	if (h264_context_set_qp_regions(h264dec, regions, ARRAYSIZE(regions)))
+		goto fail;
+	if (h264_context_set_qp_regions(h264, NULL, 1))
+		goto fail;
+	if (!h264_context_set_option(h264, H264_CONTEXT_OPTION_QP, 20))
+		goto fail;
+	if (!h264_context_reset(h264, width, height))
+		goto fail;
+	if (!h264_context_set_qp_regions(h264, regions, ARRAYSIZE(regions)))
+		goto fail;
+
+	src = allocRGB(PIXEL_FORMAT_BGRX32, width, height, &stride);
+	if (!src)
+		goto fail;
+
+	const RECTANGLE_16 rect = { .left = 0, .top = 0, .right = width, .bottom = height };
+	if (avc420_compress(h264, src, PIXEL_FORMAT_BGRX32, stride, width, height, &rect, &dst,
+	                    &dstsize, &meta) < 0)
+		goto fail;
+
+	/* the encoder may ignore the regions, the metablock must match what it did */
+	for (UINT32 x = 0; x < meta.numRegionRects; x++)
+	{
+		const RDPGFX_H264_QUANT_QUALITY* cur = &meta.quantQualityVals[x];
+		const UINT8 qp = cur->qp & 0x3F;
+		if (((qp != 20) && (qp != 0) && (qp != 26)) || (cur->qualityVal != 100 - qp))
+			goto fail;
+	}
+
+	if (!h264_context_set_qp_regions(h264, NULL, 0))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	h264_context_free(h264dec);
+	free_h264_metablock(&meta);
+	free(src);
+	return rc;
+}
+
 static BOOL compareRGB(const uint8_t* src, const uint8_t* dst, uint32_t format, size_t width,
                        size_t stride, size_t height)
 {
@@ -139,6 +280,113 @@ fail:
 	return rc;
 }
 
+static BOOL decodeYUV(YUV_CONTEXT* yuv, const BYTE* pMain[3], const BYTE* pAux[3],
+                      const UINT32 strides[3], UINT32 height, BYTE* p444[3], BYTE* p420RGB,
+                      BYTE* p444RGB, UINT32 rgbStride)
+{
+	const UINT32 width = strides[0];
+	const UINT32 s444[3] = { width, width, width };
+	const RECTANGLE_16 full = { 0, 0, (UINT16)width, (UINT16)height };
+	const RECTANGLE_16 parts[] = { { 0, 0, 64, 18 },
+		                           { 64, 2, (UINT16)width, 100 },
+		                           { 10, 100, 200, (UINT16)height } };
+
+	if (!yuv420_context_decode(yuv, pMain, strides, height, PIXEL_FORMAT_BGRX32, p420RGB,
+	                           rgbStride, &full, 1))
+		return FALSE;
+	if (!yuv444_context_decode(yuv, AVC444_LUMA, pMain, strides, height, p444,
+	                           s444, PIXEL_FORMAT_BGRX32, p444RGB, rgbStride, &full, 1))
+		return FALSE;
+	return yuv444_context_decode(yuv, AVC444_CHROMAv1, pAux, strides, height, p444, s444,
+	                             PIXEL_FORMAT_BGRX32, p444RGB, rgbStride, parts,
+	                             ARRAYSIZE(parts));
+}
+
+/* The threaded YUV decoder splits the work into stripes, it must produce exactly what the
+ * single threaded one does, on a private as well as on the shared thread pool. */
+static BOOL testYUVDecodeThreads(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 320;
+	const UINT32 height = 240;
+	const UINT32 strides[3] = { width, width / 2, width / 2 };
+	const size_t rgbStride = 4ull * width;
+	/* the auxiliary view is read in 16 row bands, add some padding */
+	const size_t planeSize[3] = { 1ull * width * (height + 32), 1ull * width / 2 * (height + 32),
+		                          1ull * width / 2 * (height + 32) };
+	BYTE* planes[2][3] = { 0 };
+	BYTE* dst444[3][3] = { 0 };
+	BYTE* rgb420[3] = { 0 };
+	BYTE* rgb444[3] = { 0 };
+	YUV_CONTEXT* yuv[3] = { yuv_context_new(FALSE, THREADING_FLAGS_DISABLE_THREADS),
+		                    yuv_context_new(FALSE, 0),
+		                    yuv_context_new(FALSE, THREADING_FLAGS_SHARED_POOL) };
+
+	for (size_t x = 0; x < 2; x++)
+	{
+		for (size_t y = 0; y < 3; y++)
+		{
+			planes[x][y] = calloc(1, planeSize[y]);
+			if (!planes[x][y])
+				goto fail;
+			winpr_RAND(planes[x][y], planeSize[y]);
+		}
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(yuv); x++)
+	{
+		if (!yuv[x] || !yuv_context_reset(yuv[x], width, height))
+			goto fail;
+		rgb420[x] = calloc(height, rgbStride);
+		rgb444[x] = calloc(height, rgbStride);
+		if (!rgb420[x] || !rgb444[x])
+			goto fail;
+		for (size_t y = 0; y < 3; y++)
+		{
+			dst444[x][y] = calloc(1, planeSize[0]);
+			if (!dst444[x][y])
+				goto fail;
+		}
+
+		const BYTE* pMain[3] = { planes[0][0], planes[0][1], planes[0][2] };
+		const BYTE* pAux[3] = { planes[1][0], planes[1][1], planes[1][2] };
+		if (!decodeYUV(yuv[x], pMain, pAux, strides, height, dst444[x], rgb420[x], rgb444[x],
+		               (UINT32)rgbStride))
+			goto fail;
+	}
+
+	for (size_t x = 1; x < ARRAYSIZE(yuv); x++)
+	{
+		if ((memcmp(rgb420[0], rgb420[x], rgbStride * height) != 0) ||
+		    (memcmp(rgb444[0], rgb444[x], rgbStride * height) != 0))
+			goto fail;
+		for (size_t y = 0; y < 3; y++)
+		{
+			if (memcmp(dst444[0][y], dst444[x][y], planeSize[0]) != 0)
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(yuv); x++)
+	{
+		yuv_context_free(yuv[x]);
+		free(rgb420[x]);
+		free(rgb444[x]);
+		for (size_t y = 0; y < 3; y++)
+			free(dst444[x][y]);
+	}
+	for (size_t x = 0; x < 2; x++)
+	{
+		for (size_t y = 0; y < 3; y++)
+			free(planes[x][y]);
+	}
+	if (!rc)
+		(void)fprintf(stderr, "[%s] threaded and single threaded decoding differ\n", __func__);
+	return rc;
+}
+
 int TestFreeRDPCodecH264(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -167,6 +415,9 @@ int TestFreeRDPCodecH264(int argc, char* argv[])
 		}
 	}
 
+	if (!testYUVDecodeThreads())
+		return -1;
+
 #if !defined(WITH_MEDIACODEC) && !defined(WITH_MEDIA_FOUNDATION) && !defined(WITH_OPENH264) && \
     !defined(WITH_VIDEO_FFMPEG)
 	(void)fprintf(stderr, "[%s] skipping, no H264 encoder/decoder support compiled in\n", __func__);
@@ -177,6 +428,14 @@ int TestFreeRDPCodecH264(int argc, char* argv[])
 		return -1;
 	if (!testContextOptions(TRUE, width, height))
 		return -1;
+	if (!testHwEncoderOption())
+		return -1;
+	if (!testHwFramesOption())
+		return -1;
+	if (!testThreadOptions())
+		return -1;
+	if (!testQpRegions(width, height))
+		return -1;
 
 	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
 	{
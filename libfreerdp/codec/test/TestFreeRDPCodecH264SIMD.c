@@ -0,0 +1,114 @@
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/h264.h>
+
+#include "../h264.h"
+#include "../sse/h264_sse2.h"
+
+static BOOL test_diff_block(const H264_CONTEXT* optimized)
+{
+	BYTE src[64 * 300] = { 0 };
+	BYTE old[64 * 300] = { 0 };
+	const UINT32 step = 300;
+
+	for (size_t iteration = 0; iteration < 10000; iteration++)
+	{
+		const size_t width = 1 + (iteration % step);
+		const size_t height = 1 + (iteration % 64);
+
+		winpr_RAND(src, sizeof(src));
+		memcpy(old, src, sizeof(old));
+
+		/* Every other block gets a single differing byte at a random place */
+		if (iteration % 2)
+		{
+			UINT32 pos = 0;
+			winpr_RAND(&pos, sizeof(pos));
+			const size_t x = pos % width;
+			const size_t y = (pos / width) % height;
+			old[y * step + x] ^= 0x80;
+		}
+
+		/* Bytes outside the block must not count */
+		if (width < step)
+			old[(height - 1) * step + width] ^= 0x01;
+
+		const BOOL expected = h264_diff_block_generic(src, step, old, step, width, height);
+		const BOOL actual = optimized->diff_block(src, step, old, step, width, height);
+		if ((expected != actual) || (expected != ((iteration % 2) != 0)))
+		{
+			(void)fprintf(stderr, "diff_block mismatch, %" PRIuz "x%" PRIuz "\n", width, height);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_diff_speed(const H264_CONTEXT* optimized)
+{
+	const UINT32 width = 1920;
+	const UINT32 height = 1080;
+	BOOL rc = FALSE;
+	UINT64 generic = 0;
+	UINT64 simd = 0;
+	BYTE* src = calloc(height, width);
+	BYTE* old = calloc(height, width);
+
+	if (!src || !old)
+		goto fail;
+
+	/* An unchanged frame is the worst case, every tile is compared completely */
+	for (size_t i = 0; i < 10; i++)
+	{
+		for (UINT32 y = 0; y < height; y += 64)
+		{
+			for (UINT32 x = 0; x < width; x += 64)
+			{
+				const BYTE* s = &src[1ull * y * width + x];
+				const BYTE* o = &old[1ull * y * width + x];
+				const size_t h = MIN(64, height - y);
+
+				const UINT64 start = winpr_GetTickCount64NS();
+				const BOOL a = h264_diff_block_generic(s, width, o, width, 64, h);
+				const UINT64 mid = winpr_GetTickCount64NS();
+				const BOOL b = optimized->diff_block(s, width, o, width, 64, h);
+				const UINT64 end = winpr_GetTickCount64NS();
+
+				if (a || b)
+					goto fail;
+				generic += mid - start;
+				simd += end - mid;
+			}
+		}
+	}
+
+	(void)printf("%s %" PRIu32 "x%" PRIu32 ": generic %" PRIu64 "us, optimized %" PRIu64 "us\n",
+	             __func__, width, height, generic / 10 / 1000, simd / 10 / 1000);
+	rc = TRUE;
+fail:
+	free(src);
+	free(old);
+	return rc;
+}
+
+int TestFreeRDPCodecH264SIMD(int argc, char* argv[])
+{
+	H264_CONTEXT optimized = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	optimized.diff_block = h264_diff_block_generic;
+	h264_init_sse2(&optimized);
+
+	if (!test_diff_block(&optimized))
+		return -1;
+
+	if (!test_diff_speed(&optimized))
+		return -1;
+
+	return 0;
+}
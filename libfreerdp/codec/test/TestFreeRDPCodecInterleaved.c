@@ -156,6 +156,137 @@ fail:
 	return rc;
 }
 
+static void fill_pattern(BYTE* data, UINT32 format, size_t step, UINT32 w, UINT32 h)
+{
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const UINT32 white = FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF);
+	UINT32 colors[8] = { 0 };
+	BYTE rnd[64] = { 0 };
+
+	winpr_RAND(rnd, sizeof(rnd));
+	for (size_t x = 0; x < ARRAYSIZE(colors); x++)
+		colors[x] = FreeRDPGetColor(format, rnd[3 * x], rnd[3 * x + 1], rnd[3 * x + 2], 0xFF);
+	colors[0] = white;
+	colors[1] = FreeRDPGetColor(format, 0, 0, 0, 0xFF);
+
+	/* runs of colour, copies of the line above and lines XORed with white */
+	for (UINT32 y = 0; y < h; y++)
+	{
+		BYTE* line = &data[y * step];
+		const BYTE* above = (y > 0) ? &data[(y - 1) * step] : NULL;
+
+		for (UINT32 x = 0; x < w; x++)
+		{
+			UINT32 color = colors[((x / 5) + y) % ARRAYSIZE(colors)];
+			const UINT32 ycolor = above ? FreeRDPReadColor(&above[1ULL * x * bpp], format) : 0;
+
+			switch (y % 4)
+			{
+				case 1:
+					color = ycolor;
+					break;
+				case 2:
+					color = ((x / 3) % 2) ? ycolor : (ycolor ^ white);
+					break;
+				case 3:
+					if ((x % 7) == 0)
+						winpr_RAND(&color, sizeof(color));
+					break;
+				default:
+					break;
+			}
+			FreeRDPWriteColor(&line[1ULL * x * bpp], format, color);
+		}
+	}
+}
+
+static BOOL run_encode_decode_pattern(UINT16 bpp, UINT32 format, UINT32 w,
+                                      BITMAP_INTERLEAVED_CONTEXT* encoder,
+                                      BITMAP_INTERLEAVED_CONTEXT* decoder)
+{
+	BOOL rc = FALSE;
+	const UINT32 h = 64;
+	const UINT32 x = 3;
+	const UINT32 y = 2;
+	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
+	const size_t step = (13ULL + w + x) * bstep;
+	const size_t SrcSize = step * (h + y);
+	const size_t refStep = (13ULL + w) * 4ULL;
+	UINT32 DstSize = 64 * 64 * 4;
+	UINT32 RefSize = DstSize;
+	BYTE* pSrcData = calloc(1, SrcSize);
+	BYTE* pDstData = calloc(1, SrcSize);
+	BYTE* pRefData = calloc(h, refStep);
+	BYTE* tmp = calloc(1, DstSize);
+	BYTE* ref = calloc(1, RefSize);
+
+	if (!pSrcData || !pDstData || !pRefData || !tmp || !ref)
+		goto fail;
+
+	fill_pattern(&pSrcData[y * step + 1ULL * x * bstep], format, step, w, h);
+
+	if (!interleaved_compress(encoder, tmp, &DstSize, w, h, pSrcData, format, step, x, y, NULL,
+	                          bpp))
+		goto fail;
+
+	/* the same picture as RGBX32 is converted before encoding, the result must not differ */
+	if (bstep == 4)
+	{
+		if (!freerdp_image_copy_no_overlap(pRefData, PIXEL_FORMAT_RGBX32, refStep, 0, 0, w, h,
+		                                   pSrcData, format, step, x, y, NULL, FREERDP_FLIP_NONE))
+			goto fail;
+		if (!interleaved_compress(encoder, ref, &RefSize, w, h, pRefData, PIXEL_FORMAT_RGBX32,
+		                          refStep, 0, 0, NULL, bpp))
+			goto fail;
+
+		if ((DstSize != RefSize) || (memcmp(tmp, ref, DstSize) != 0))
+		{
+			printf("%" PRIu16 "bpp: encoding from %s differs from the converted source\n", bpp,
+			       FreeRDPGetColorFormatName(format));
+			goto fail;
+		}
+	}
+
+	if (!interleaved_decompress(decoder, tmp, DstSize, w, h, bpp, pDstData, format, step, 0, 0, w,
+	                            h, NULL))
+		goto fail;
+
+	for (UINT32 i = 0; i < h; i++)
+	{
+		const BYTE* srcLine = &pSrcData[(i + y) * step + 1ULL * x * bstep];
+		const BYTE* dstLine = &pDstData[i * step];
+
+		for (UINT32 j = 0; j < w; j++)
+		{
+			BYTE r = 0;
+			BYTE g = 0;
+			BYTE b = 0;
+			BYTE dr = 0;
+			BYTE dg = 0;
+			BYTE db = 0;
+			const UINT32 srcColor = FreeRDPReadColor(&srcLine[1ULL * j * bstep], format);
+			const UINT32 dstColor = FreeRDPReadColor(&dstLine[1ULL * j * bstep], format);
+			FreeRDPSplitColor(srcColor, format, &r, &g, &b, NULL, NULL);
+			FreeRDPSplitColor(dstColor, format, &dr, &dg, &db, NULL, NULL);
+
+			if ((r != dr) || (g != dg) || (b != db))
+			{
+				printf("%" PRIu16 "bpp: pixel %" PRIu32 "x%" PRIu32 " differs\n", bpp, j, i);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(pSrcData);
+	free(pDstData);
+	free(pRefData);
+	free(tmp);
+	free(ref);
+	return rc;
+}
+
 static BOOL TestColorConversion(void)
 {
 	const UINT32 formats[] = { PIXEL_FORMAT_RGB15,  PIXEL_FORMAT_BGR15, PIXEL_FORMAT_ABGR15,
@@ -208,6 +339,13 @@ int TestFreeRDPCodecInterleaved(int argc, char* argv[])
 	if (!run_encode_decode(15, encoder, decoder))
 		goto fail;
 
+	if (!run_encode_decode_pattern(24, PIXEL_FORMAT_BGRX32, 64, encoder, decoder) ||
+	    !run_encode_decode_pattern(24, PIXEL_FORMAT_BGRA32, 20, encoder, decoder) ||
+	    !run_encode_decode_pattern(16, PIXEL_FORMAT_RGB16, 64, encoder, decoder) ||
+	    !run_encode_decode_pattern(16, PIXEL_FORMAT_RGB16, 36, encoder, decoder) ||
+	    !run_encode_decode_pattern(15, PIXEL_FORMAT_RGB15, 64, encoder, decoder))
+		goto fail;
+
 	if (!TestColorConversion())
 		goto fail;
 
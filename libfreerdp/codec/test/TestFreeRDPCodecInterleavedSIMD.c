@@ -0,0 +1,117 @@
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/interleaved.h>
+
+#include "../bitmap_types.h"
+#include "../sse/bitmap_sse2.h"
+
+static BOOL test_masks(const char* name, pfnBitmapLineMasks generic, pfnBitmapLineMasks optimized,
+                       UINT32 mix)
+{
+	BYTE line[64 * 4] = { 0 };
+	BYTE above[64 * 4] = { 0 };
+
+	for (size_t iteration = 0; iteration < 1000; iteration++)
+	{
+		winpr_RAND(line, sizeof(line));
+		winpr_RAND(above, sizeof(above));
+
+		/* Short alphabets give runs, fills and mixes of every length */
+		for (size_t x = 0; x < ARRAYSIZE(line); x++)
+		{
+			line[x] %= (BYTE)(1 + iteration % 3);
+			if ((line[x] == 0) && (x % 2))
+				line[x] = above[x];
+			else if (line[x] == 1)
+				line[x] = above[x] ^ (BYTE)(mix >> (8 * (x % 2)));
+		}
+
+		const UINT32 count = 1 + (UINT32)(iteration % 64);
+		UINT64 fill[2] = { 0 };
+		UINT64 mixed[2] = { 0 };
+		UINT64 same[2] = { 0 };
+		generic(line, above, count, mix, &fill[0], &mixed[0], &same[0]);
+		optimized(line, above, count, mix, &fill[1], &mixed[1], &same[1]);
+
+		if ((fill[0] != fill[1]) || (mixed[0] != mixed[1]) || (same[0] != same[1]))
+		{
+			(void)fprintf(stderr, "%s mismatch, count %" PRIu32 "\n", name, count);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_compress(UINT32 format, UINT32 bpp, size_t iterations)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 64;
+	const UINT32 height = 64;
+	const size_t stride = 1ull * width * FreeRDPGetBytesPerPixel(format);
+	BITMAP_INTERLEAVED_CONTEXT* interleaved = bitmap_interleaved_context_new(TRUE);
+	BYTE* bmp = calloc(height, stride);
+	BYTE* dst = calloc(height, stride);
+	UINT64 total = 0;
+
+	if (!interleaved || !bmp || !dst)
+		goto fail;
+
+	/* Mostly flat content with noise, similar to desktop updates */
+	winpr_RAND(bmp, height * stride);
+
+	for (size_t x = 1; x < height * stride; x++)
+	{
+		if ((bmp[x] % 16) != 0)
+			bmp[x] = bmp[x - 1];
+	}
+
+	for (size_t i = 0; i < iterations; i++)
+	{
+		UINT32 size = (UINT32)(height * stride);
+		const UINT64 start = winpr_GetTickCount64NS();
+		const BOOL res = interleaved_compress(interleaved, dst, &size, width, height, bmp, format,
+		                                      (UINT32)stride, 0, 0, NULL, bpp);
+		total += winpr_GetTickCount64NS() - start;
+
+		if (!res)
+			goto fail;
+	}
+
+	(void)printf("%s [%s] %" PRIu32 "bpp: %" PRIu64 "us\n", __func__,
+	             FreeRDPGetColorFormatName(format), bpp, total / iterations / 1000);
+	rc = TRUE;
+fail:
+	free(bmp);
+	free(dst);
+	bitmap_interleaved_context_free(interleaved);
+	return rc;
+}
+
+int TestFreeRDPCodecInterleavedSIMD(int argc, char* argv[])
+{
+	BITMAP_ENCODER_KERNELS optimized = { bitmap_line_masks16_generic,
+		                                 bitmap_line_masks32_generic };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	bitmap_init_sse2(&optimized);
+
+	if (!test_masks("masks32", bitmap_line_masks32_generic, optimized.masks32, 0xFFFFFF))
+		return -1;
+	if (!test_masks("masks16", bitmap_line_masks16_generic, optimized.masks16, 0xFFFF))
+		return -1;
+	if (!test_masks("masks15", bitmap_line_masks16_generic, optimized.masks16, 0xBA1F))
+		return -1;
+
+	if (!test_compress(PIXEL_FORMAT_BGRX32, 24, 100) ||
+	    !test_compress(PIXEL_FORMAT_RGBX32, 24, 100) ||
+	    !test_compress(PIXEL_FORMAT_RGB16, 16, 100) || !test_compress(PIXEL_FORMAT_RGB15, 15, 100))
+		return -1;
+
+	return 0;
+}
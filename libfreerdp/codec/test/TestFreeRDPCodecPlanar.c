@@ -5656,6 +5656,55 @@ fail:
 	return rc;
 }
 
+static BOOL TestPlanarRoundtrip(UINT32 width, UINT32 height)
+{
+	BOOL rc = FALSE;
+	UINT32 compressedSize = 0;
+	const UINT32 format = PIXEL_FORMAT_BGRX32;
+	const size_t stride = 4ull * width;
+	const DWORD planarFlags = PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE;
+	BITMAP_PLANAR_CONTEXT* planar = freerdp_bitmap_planar_context_new(planarFlags, width, height);
+	BYTE* bmp = calloc(height, stride);
+	BYTE* decompressedBitmap = calloc(height, stride);
+	BYTE* compressedBitmap = NULL;
+
+	(void)printf("%s: %" PRIu32 "x%" PRIu32 ": ", __func__, width, height);
+
+	if (!planar || !bmp || !decompressedBitmap)
+		goto fail;
+
+	/* Random lines produce every delta value, repeated and flat lines produce runs */
+	winpr_RAND(bmp, height * stride);
+
+	for (size_t y = 1; y < height; y += 3)
+		memcpy(&bmp[y * stride], &bmp[(y - 1) * stride], stride);
+
+	for (size_t y = 2; y < height; y += 5)
+		memset(&bmp[y * stride], 0x42, stride);
+
+	compressedBitmap = freerdp_bitmap_compress_planar(planar, bmp, format, width, height, 0, NULL,
+	                                                  &compressedSize);
+
+	if (!compressedBitmap)
+		goto fail;
+
+	if (!planar_decompress(planar, compressedBitmap, compressedSize, width, height,
+	                       decompressedBitmap, format, 0, 0, 0, width, height, TRUE))
+		goto fail;
+
+	if (!CompareBitmap(decompressedBitmap, format, bmp, format, width, height))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	(void)printf("%s\n", rc ? "SUCCESS" : "FAIL");
+	free(bmp);
+	free(compressedBitmap);
+	free(decompressedBitmap);
+	freerdp_bitmap_planar_context_free(planar);
+	return rc;
+}
+
 static UINT32 prand(UINT32 max)
 {
 	UINT32 tmp = 0;
@@ -5777,6 +5826,13 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 	if (!FuzzPlanar())
 		return -2;
 
+	if (!TestPlanarRoundtrip(64, 64) || !TestPlanarRoundtrip(67, 45))
+		return -3;
+
+	/* Large enough to decode the planes in parallel */
+	if (!TestPlanarRoundtrip(640, 480) || !TestPlanarRoundtrip(517, 259))
+		return -3;
+
 	for (UINT32 x = 0; x < colorFormatCount; x++)
 	{
 		if (!TestPlanar(colorFormatList[x]))
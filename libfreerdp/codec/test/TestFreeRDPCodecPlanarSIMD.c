@@ -0,0 +1,164 @@
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/planar.h>
+
+#include "../planar_types.h"
+
+static BOOL test_kernels(const BITMAP_PLANAR_CONTEXT* generic,
+                         const BITMAP_PLANAR_CONTEXT* optimized)
+{
+	BYTE src[257] = { 0 };
+	BYTE prev[257] = { 0 };
+	BYTE dst1[257] = { 0 };
+	BYTE dst2[257] = { 0 };
+
+	for (size_t iteration = 0; iteration < 1000; iteration++)
+	{
+		winpr_RAND(src, sizeof(src));
+		winpr_RAND(prev, sizeof(prev));
+
+		/* Short alphabets give runs of every length */
+		for (size_t x = 0; x < ARRAYSIZE(src); x++)
+			src[x] %= (BYTE)(1 + iteration % 5);
+
+		const UINT32 width = 1 + (UINT32)(iteration % ARRAYSIZE(src));
+		generic->delta_encode_line(src, prev, dst1, width);
+		optimized->delta_encode_line(src, prev, dst2, width);
+
+		if (memcmp(dst1, dst2, width) != 0)
+		{
+			(void)fprintf(stderr, "delta_encode_line mismatch, width %" PRIu32 "\n", width);
+			return FALSE;
+		}
+
+		for (size_t pos = 0; pos < width; pos++)
+		{
+			const size_t start1 = generic->rle_run_start(src, pos, width);
+			const size_t start2 = optimized->rle_run_start(src, pos, width);
+
+			if (start1 != start2)
+			{
+				(void)fprintf(stderr, "rle_run_start mismatch at %" PRIuz "\n", pos);
+				return FALSE;
+			}
+
+			const size_t end1 = generic->rle_run_end(src, pos, width);
+			const size_t end2 = optimized->rle_run_end(src, pos, width);
+
+			if (end1 != end2)
+			{
+				(void)fprintf(stderr, "rle_run_end mismatch at %" PRIuz "\n", pos);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_compress(UINT32 format, UINT32 width, UINT32 height, BOOL skipAlpha,
+                          size_t iterations)
+{
+	BOOL rc = FALSE;
+	UINT32 size1 = 0;
+	UINT32 size2 = 0;
+	BYTE* dst1 = NULL;
+	BYTE* dst2 = NULL;
+	UINT64 generic = 0;
+	UINT64 optimized = 0;
+	const DWORD flags = PLANAR_FORMAT_HEADER_RLE | (skipAlpha ? PLANAR_FORMAT_HEADER_NA : 0);
+	const size_t stride = 1ull * width * FreeRDPGetBytesPerPixel(format);
+	BITMAP_PLANAR_CONTEXT* planar1 = freerdp_bitmap_planar_context_new(flags, width, height);
+	BITMAP_PLANAR_CONTEXT* planar2 = freerdp_bitmap_planar_context_new(flags, width, height);
+	BYTE* bmp = calloc(height, stride);
+
+	if (!planar1 || !planar2 || !bmp)
+		goto fail;
+
+	planar_init_generic(planar1);
+
+	/* Mostly flat content with noise, similar to desktop updates */
+	winpr_RAND(bmp, height * stride);
+
+	for (size_t x = 1; x < height * stride; x++)
+	{
+		if ((bmp[x] % 16) != 0)
+			bmp[x] = bmp[x - 1];
+	}
+
+	for (size_t i = 0; i < iterations; i++)
+	{
+		free(dst1);
+		free(dst2);
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		dst1 = freerdp_bitmap_compress_planar(planar1, bmp, format, width, height, 0, NULL, &size1);
+		const UINT64 mid = winpr_GetTickCount64NS();
+		dst2 = freerdp_bitmap_compress_planar(planar2, bmp, format, width, height, 0, NULL, &size2);
+		const UINT64 end = winpr_GetTickCount64NS();
+
+		generic += mid - start;
+		optimized += end - mid;
+
+		if (!dst1 || !dst2 || (size1 != size2) || (memcmp(dst1, dst2, size1) != 0))
+		{
+			(void)fprintf(stderr, "%s [%s] %" PRIu32 "x%" PRIu32 ": output mismatch\n", __func__,
+			              FreeRDPGetColorFormatName(format), width, height);
+			goto fail;
+		}
+	}
+
+	(void)printf("%s [%s] %" PRIu32 "x%" PRIu32 ": generic %" PRIu64 "us, optimized %" PRIu64
+	             "us\n",
+	             __func__, FreeRDPGetColorFormatName(format), width, height,
+	             generic / iterations / 1000, optimized / iterations / 1000);
+	rc = TRUE;
+fail:
+	free(dst1);
+	free(dst2);
+	free(bmp);
+	freerdp_bitmap_planar_context_free(planar1);
+	freerdp_bitmap_planar_context_free(planar2);
+	return rc;
+}
+
+int TestFreeRDPCodecPlanarSIMD(int argc, char* argv[])
+{
+	int rc = -1;
+	const UINT32 formats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGBX32,
+		                       PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_RGB24,  PIXEL_FORMAT_RGB16 };
+	BITMAP_PLANAR_CONTEXT* generic = freerdp_bitmap_planar_context_new(0, 64, 64);
+	BITMAP_PLANAR_CONTEXT* optimized = freerdp_bitmap_planar_context_new(0, 64, 64);
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!generic || !optimized)
+		goto fail;
+
+	planar_init_generic(generic);
+
+	if (!test_kernels(generic, optimized))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		if (!test_compress(formats[x], 61, 17, FALSE, 1))
+			goto fail;
+
+		if (!test_compress(formats[x], 64, 64, TRUE, 10))
+			goto fail;
+
+		if (!test_compress(formats[x], 1024, 768, FALSE, 5))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	freerdp_bitmap_planar_context_free(generic);
+	freerdp_bitmap_planar_context_free(optimized);
+	return rc;
+}
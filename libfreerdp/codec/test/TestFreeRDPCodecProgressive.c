@@ -1120,6 +1120,206 @@ fail:
 	return res;
 }
 
+static UINT64 test_image_error(const wImage* image, const BYTE* data, UINT32 format)
+{
+	UINT64 error = 0;
+
+	for (size_t y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &data[y * image->scanline];
+		for (size_t x = 0; x < image->width; x++)
+		{
+			BYTE ar = 0;
+			BYTE ag = 0;
+			BYTE ab = 0;
+			BYTE br = 0;
+			BYTE bg = 0;
+			BYTE bb = 0;
+			const DWORD a = FreeRDPReadColor(&orig[x * 4], format);
+			const DWORD b = FreeRDPReadColor(&dec[x * 4], format);
+			FreeRDPSplitColor(a, format, &ar, &ag, &ab, NULL, NULL);
+			FreeRDPSplitColor(b, format, &br, &bg, &bb, NULL, NULL);
+			error += (UINT64)abs(ar - br) + (UINT64)abs(ag - bg) + (UINT64)abs(ab - bb);
+		}
+	}
+	return error;
+}
+
+static BOOL test_encode_decode_multipass(const char* path)
+{
+	BOOL res = FALSE;
+	int rc = 0;
+	BYTE* resultData = NULL;
+	BYTE* dstData = NULL;
+	UINT32 dstSize = 0;
+	UINT32 simpleSize = 0;
+	UINT32 frameId = 0;
+	const UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveSimple = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveEnc = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveDec = progressive_context_new(FALSE);
+
+	if (!image || !name || !progressiveSimple || !progressiveEnc || !progressiveDec)
+		goto fail;
+
+	if (winpr_image_read(image, name) <= 0)
+		goto fail;
+
+	resultData = calloc(image->scanline, image->height);
+	if (!resultData)
+		goto fail;
+
+	rc = progressive_compress(progressiveSimple, image->data, image->scanline * image->height,
+	                          ColorFormat, image->width, image->height, image->scanline, NULL,
+	                          &dstData, &simpleSize);
+	if (rc < 0)
+		goto fail;
+
+	if (progressive_context_set_passes(progressiveEnc, 0) ||
+	    progressive_context_set_passes(progressiveEnc, 5))
+		goto fail;
+	if (!progressive_context_set_passes(progressiveEnc, 3))
+		goto fail;
+
+	/* nothing to upgrade before the first pass */
+	if (progressive_compress_upgrade(progressiveEnc, 4096, &dstData, &dstSize) != 0)
+		goto fail;
+
+	rc = progressive_compress(progressiveEnc, image->data, image->scanline * image->height,
+	                          ColorFormat, image->width, image->height, image->scanline, NULL,
+	                          &dstData, &dstSize);
+	if (rc < 0)
+		goto fail;
+
+	/* the coarse pass must be considerably cheaper than full quality tiles */
+	if (dstSize >= simpleSize / 2)
+	{
+		printf("first pass %" PRIu32 " bytes, simple %" PRIu32 " bytes\n", dstSize, simpleSize);
+		goto fail;
+	}
+
+	rc = progressive_create_surface_context(progressiveDec, 0, image->width, image->height);
+	if (rc <= 0)
+		goto fail;
+
+	rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+	                            image->scanline, 0, 0, NULL, 0, frameId++);
+	if (rc < 0)
+		goto fail;
+
+	const UINT64 firstError = test_image_error(image, resultData, ColorFormat);
+	UINT64 lastError = firstError;
+
+	for (size_t x = 0; x < 10000; x++)
+	{
+		rc = progressive_compress_upgrade(progressiveEnc, 8192, &dstData, &dstSize);
+		if (rc < 0)
+			goto fail;
+		if (rc == 0)
+			break;
+
+		rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                            image->scanline, 0, 0, NULL, 0, frameId++);
+		if (rc < 0)
+			goto fail;
+
+		const UINT64 error = test_image_error(image, resultData, ColorFormat);
+		if (error > lastError)
+		{
+			printf("upgrade %" PRIuz " increased error %" PRIu64 " -> %" PRIu64 "\n", x,
+			       lastError, error);
+			goto fail;
+		}
+		lastError = error;
+	}
+
+	if ((rc != 0) || (lastError >= firstError / 2))
+	{
+		printf("error first pass %" PRIu64 ", final %" PRIu64 "\n", firstError, lastError);
+		goto fail;
+	}
+
+	for (size_t y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &resultData[y * image->scanline];
+		for (size_t x = 0; x < image->width; x++)
+		{
+			const DWORD a = FreeRDPReadColor(&orig[x * 4], ColorFormat);
+			const DWORD b = FreeRDPReadColor(&dec[x * 4], ColorFormat);
+			if (!colordiff(ColorFormat, a, b))
+			{
+				printf("xxxxxxx [%" PRIuz ":%" PRIuz "] [%s] %08X != %08X\n", x, y,
+				       FreeRDPGetColorFormatName(ColorFormat), a, b);
+				goto fail;
+			}
+		}
+	}
+
+	res = TRUE;
+fail:
+	progressive_context_free(progressiveSimple);
+	progressive_context_free(progressiveEnc);
+	progressive_context_free(progressiveDec);
+	winpr_image_free(image, TRUE);
+	free(resultData);
+	free(name);
+	return res;
+}
+
+/* With the tile cache enabled an unchanged frame produces no message */
+static BOOL test_encode_tile_cache(const char* path)
+{
+	BOOL res = FALSE;
+	BYTE* dstData = NULL;
+	UINT32 dstSize = 0;
+	const UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressive = progressive_context_new(TRUE);
+
+	if (!image || !name || !progressive)
+		goto fail;
+
+	if (winpr_image_read(image, name) <= 0)
+		goto fail;
+
+	if (!progressive_context_set_tile_cache(progressive, TRUE))
+		goto fail;
+
+	for (UINT32 passes = 1; passes <= 2; passes++)
+	{
+		if (!progressive_context_set_passes(progressive, passes))
+			goto fail;
+
+		const int expected[] = { 1, 0 };
+		for (size_t x = 0; x < ARRAYSIZE(expected); x++)
+		{
+			const int rc = progressive_compress(
+			    progressive, image->data, image->scanline * image->height, ColorFormat,
+			    image->width, image->height, image->scanline, NULL, &dstData, &dstSize);
+			if (rc != expected[x])
+			{
+				printf("passes %" PRIu32 ", frame %" PRIuz ": expected %d, got %d\n", passes, x,
+				       expected[x], rc);
+				goto fail;
+			}
+		}
+
+		progressive_context_invalidate_tile_cache(progressive, NULL);
+	}
+
+	res = TRUE;
+fail:
+	progressive_context_free(progressive);
+	winpr_image_free(image, TRUE);
+	free(name);
+	return res;
+}
+
 static BOOL read_cmd(FILE* fp, RDPGFX_SURFACE_COMMAND* cmd, UINT32* frameId)
 {
 	WINPR_ASSERT(fp);
@@ -1463,6 +1663,10 @@ int TestFreeRDPCodecProgressive(int argc, char* argv[])
 		    */
 		if (!test_encode_decode(ms_sample_path))
 			goto fail;
+		if (!test_encode_decode_multipass(ms_sample_path))
+			goto fail;
+		if (!test_encode_tile_cache(ms_sample_path))
+			goto fail;
 		rc = 0;
 	}
 
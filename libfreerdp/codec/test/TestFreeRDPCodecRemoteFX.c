@@ -1,5 +1,6 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
@@ -842,6 +843,102 @@ static BOOL fuzzyCompareImage(const UINT32* crefImage, const BYTE* img, size_t n
 	return TRUE;
 }
 
+static BOOL test_encode_tile_count(RFX_CONTEXT* context, const RFX_RECT* rect, const BYTE* data,
+                                   UINT32 width, UINT32 height, UINT16 expected,
+                                   const RFX_RECT* expectedRect)
+{
+	BOOL rc = FALSE;
+	RFX_MESSAGE* message =
+	    rfx_encode_message(context, rect, 1, data, width, height, 4ull * width);
+	if (!message)
+		return FALSE;
+
+	const UINT16 count = rfx_message_get_tile_count(message);
+	if (count != expected)
+	{
+		(void)fprintf(stderr, "expected %" PRIu16 " tiles, got %" PRIu16 "\n", expected, count);
+		goto fail;
+	}
+
+	/* the message area must be restricted to the remaining tiles */
+	if (expectedRect)
+	{
+		UINT16 numRects = 0;
+		const RFX_RECT* rects = rfx_message_get_rects(message, &numRects);
+		if ((numRects != 1) || (memcmp(rects, expectedRect, sizeof(RFX_RECT)) != 0))
+		{
+			(void)fprintf(stderr, "unexpected message rectangles\n");
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	rfx_message_free(context, message);
+	return rc;
+}
+
+/* Unchanged tiles are dropped from the message once the tile cache is enabled */
+static BOOL test_tile_cache(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 200;
+	const UINT32 height = 130;
+	const RFX_RECT rect = { 0, 0, (UINT16)width, (UINT16)height };
+	const RECTANGLE_16 invalid = { 70, 70, 71, 71 };
+	const RFX_RECT changed = { 192, 128, 8, 2 };
+	const RFX_RECT invalidTile = { 64, 64, 64, 64 };
+	const UINT16 allTiles = 4 * 3;
+	RFX_CONTEXT* context = rfx_context_new(TRUE);
+	BYTE* data = calloc(height, 4ull * width);
+	wStream* s = Stream_New(NULL, 1024);
+
+	if (!context || !data || !s)
+		goto fail;
+
+	winpr_RAND(data, 4ull * width * height);
+	rfx_context_set_pixel_format(context, PIXEL_FORMAT_BGRX32);
+	if (!rfx_context_set_tile_cache(context, TRUE))
+		goto fail;
+
+	if (!test_encode_tile_count(context, &rect, data, width, height, allTiles, NULL))
+		goto fail;
+	if (!test_encode_tile_count(context, &rect, data, width, height, 0, NULL))
+		goto fail;
+
+	/* nothing to send for an unchanged frame */
+	if (!rfx_compose_message(context, s, &rect, 1, data, width, height, 4 * width))
+		goto fail;
+	if (Stream_GetPosition(s) != 0)
+		goto fail;
+
+	/* change a single pixel in the bottom right (partial) tile */
+	data[(4ull * width * (height - 1)) + 4ull * (width - 1)] ^= 0xFF;
+	if (!test_encode_tile_count(context, &rect, data, width, height, 1, &changed))
+		goto fail;
+
+	rfx_context_invalidate_tile_cache(context, &invalid);
+	if (!test_encode_tile_count(context, &rect, data, width, height, 1, &invalidTile))
+		goto fail;
+
+	if (!rfx_context_reset(context, width, height))
+		goto fail;
+	if (!test_encode_tile_count(context, &rect, data, width, height, allTiles, NULL))
+		goto fail;
+
+	if (!rfx_context_set_tile_cache(context, FALSE))
+		goto fail;
+	if (!test_encode_tile_count(context, &rect, data, width, height, allTiles, NULL))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	free(data);
+	rfx_context_free(context);
+	return rc;
+}
+
 int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 {
 	int rc = -1;
@@ -877,6 +974,9 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	if (!fuzzyCompareImage(srefImage, dest, IMG_WIDTH * IMG_HEIGHT))
 		goto fail;
 
+	if (!test_tile_cache())
+		goto fail;
+
 	rc = 0;
 fail:
 	region16_uninit(&region);
@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,6 +254,161 @@ fail:
 	return rc;
 }
 
+static BOOL test_ZGfxRoundTripBuffer(ZGFX_CONTEXT* compressor, ZGFX_CONTEXT* decompressor,
+                                     const BYTE* pSrcData, UINT32 SrcSize, UINT32* pDstSize)
+{
+	BOOL rc = FALSE;
+	UINT32 Flags = 0;
+	UINT32 DstSize = 0;
+	BYTE* pDstData = NULL;
+	UINT32 DstSize2 = 0;
+	BYTE* pDstData2 = NULL;
+
+	if (zgfx_compress(compressor, pSrcData, SrcSize, &pDstData, &DstSize, &Flags) < 0)
+		goto fail;
+
+	if (zgfx_decompress(decompressor, pDstData, DstSize, &pDstData2, &DstSize2, Flags) < 0)
+		goto fail;
+
+	if ((DstSize2 != SrcSize) || (memcmp(pDstData2, pSrcData, SrcSize) != 0))
+	{
+		printf("%s: round trip mismatch: Actual: %" PRIu32 ", Expected: %" PRIu32 "\n", __func__,
+		       DstSize2, SrcSize);
+		goto fail;
+	}
+
+	*pDstSize = DstSize;
+	rc = TRUE;
+fail:
+	free(pDstData);
+	free(pDstData2);
+	return rc;
+}
+
+static int test_ZGfxCompressRoundTrip(void)
+{
+	int rc = -1;
+	const UINT32 SrcSize = 3 * ZGFX_SEGMENTED_MAXSIZE + 1234;
+	BYTE* pSrcData = malloc(SrcSize);
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!pSrcData || !compressor || !decompressor)
+		goto fail;
+
+	if (zgfx_set_compression_level(decompressor, ZGFX_COMPRESSION_LEVEL_DEFAULT))
+		goto fail;
+
+	/* repeating text with some noise, spanning multiple segments */
+	winpr_RAND(pSrcData, SrcSize);
+	for (UINT32 x = 0; x + sizeof(TEST_FOX_DATA) < SrcSize; x += 2 * sizeof(TEST_FOX_DATA))
+		memcpy(&pSrcData[x], TEST_FOX_DATA, sizeof(TEST_FOX_DATA) - 1);
+
+	for (UINT32 level = ZGFX_COMPRESSION_LEVEL_NONE; level <= ZGFX_COMPRESSION_LEVEL_MAX;
+	     level++)
+	{
+		UINT32 DstSize = 0;
+
+		if (!zgfx_set_compression_level(compressor, level))
+			goto fail;
+
+		/* the first pass fills the history, the second must reference it */
+		for (size_t pass = 0; pass < 2; pass++)
+		{
+			if (!test_ZGfxRoundTripBuffer(compressor, decompressor, pSrcData, SrcSize, &DstSize))
+				goto fail;
+
+			printf("level %" PRIu32 " pass %" PRIuz ": %" PRIu32 " -> %" PRIu32 "\n", level, pass,
+			       SrcSize, DstSize);
+
+			if ((level > ZGFX_COMPRESSION_LEVEL_NONE) && (DstSize >= SrcSize))
+				goto fail;
+
+			if ((level > ZGFX_COMPRESSION_LEVEL_NONE) && (pass > 0) && (DstSize > SrcSize / 16))
+				goto fail;
+		}
+
+		/* random data must not expand beyond the segment headers */
+		winpr_RAND(pSrcData, 4096);
+		if (!test_ZGfxRoundTripBuffer(compressor, decompressor, pSrcData, 4096, &DstSize))
+			goto fail;
+		if (DstSize > 4096 + 2)
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	free(pSrcData);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
+/* small segments with the RDP8 Lite history, as dynamic virtual channels use them */
+static int test_ZGfxBulkLite(void)
+{
+	int rc = -1;
+	size_t total = 0;
+	const UINT32 SrcSize = 5 * ZGFX_HISTORY_SIZE_LITE;
+	const UINT32 chunk = 1590;
+	BYTE* pSrcData = malloc(SrcSize);
+	wStream* compressed = Stream_New(NULL, 2 * chunk);
+	wStream* decompressed = Stream_New(NULL, chunk);
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!pSrcData || !compressed || !decompressed || !compressor || !decompressor)
+		goto fail;
+
+	/* too small to hold a segment, and a decompressor can not compress */
+	if (zgfx_set_history_size(compressor, 1024))
+		goto fail;
+	if (zgfx_compress_bulk(decompressor, compressed, TEST_FOX_DATA, 4))
+		goto fail;
+	if (!zgfx_set_history_size(compressor, ZGFX_HISTORY_SIZE_LITE) ||
+	    !zgfx_set_history_size(decompressor, ZGFX_HISTORY_SIZE_LITE))
+		goto fail;
+
+	winpr_RAND(pSrcData, SrcSize);
+	for (UINT32 x = 0; x + sizeof(TEST_FOX_DATA) < SrcSize; x += 2 * sizeof(TEST_FOX_DATA))
+		memcpy(&pSrcData[x], TEST_FOX_DATA, sizeof(TEST_FOX_DATA) - 1);
+
+	for (UINT32 offset = 0; offset < SrcSize; offset += chunk)
+	{
+		const UINT32 length = MIN(chunk, SrcSize - offset);
+
+		Stream_SetPosition(compressed, 0);
+		Stream_SetPosition(decompressed, 0);
+		if (!zgfx_compress_bulk(compressor, compressed, &pSrcData[offset], length))
+			goto fail;
+		if (Stream_GetPosition(compressed) > length + 1)
+			goto fail;
+		if (!zgfx_decompress_bulk(decompressor, Stream_Buffer(compressed),
+		                          (UINT32)Stream_GetPosition(compressed), decompressed))
+			goto fail;
+		if ((Stream_GetPosition(decompressed) != length) ||
+		    (memcmp(Stream_Buffer(decompressed), &pSrcData[offset], length) != 0))
+		{
+			printf("%s: round trip mismatch at offset %" PRIu32 "\n", __func__, offset);
+			goto fail;
+		}
+		total += Stream_GetPosition(compressed);
+	}
+
+	printf("lite: %" PRIu32 " -> %" PRIuz "\n", SrcSize, total);
+	if (total > SrcSize * 3ull / 4ull)
+		goto fail;
+
+	rc = 0;
+fail:
+	free(pSrcData);
+	Stream_Free(compressed, TRUE);
+	Stream_Free(decompressed, TRUE);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -270,5 +426,11 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressRoundTrip() < 0)
+		return -1;
+
+	if (test_ZGfxBulkLite() < 0)
+		return -1;
+
 	return 0;
 }
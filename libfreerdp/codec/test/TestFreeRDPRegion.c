@@ -835,6 +835,131 @@ struct UnitaryTest
 	TestFunction func;
 };
 
+#define UNION_GRID 16
+#define UNION_CELLS 64
+
+static BOOL region_rasterize(const REGION16* region, BYTE* cells)
+{
+	UINT32 nbRects = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+
+	memset(cells, 0, UNION_CELLS * UNION_CELLS);
+	for (UINT32 x = 0; x < nbRects; x++)
+	{
+		const RECTANGLE_16* rect = &rects[x];
+		for (UINT32 y = rect->top / UNION_GRID; y < rect->bottom / UNION_GRID; y++)
+		{
+			for (UINT32 z = rect->left / UNION_GRID; z < rect->right / UNION_GRID; z++)
+			{
+				if (cells[y * UNION_CELLS + z])
+				{
+					(void)fprintf(stderr, "rectangle %" PRIu32 " overlaps others\n", x);
+					return FALSE;
+				}
+				cells[y * UNION_CELLS + z] = 1;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL region_is_banded(const REGION16* region)
+{
+	UINT32 nbRects = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &nbRects);
+
+	for (UINT32 x = 1; x < nbRects; x++)
+	{
+		const RECTANGLE_16* prev = &rects[x - 1];
+		const RECTANGLE_16* cur = &rects[x];
+
+		if (cur->top == prev->top)
+		{
+			/* same band: same height, sorted and not touching */
+			if ((cur->bottom != prev->bottom) || (cur->left <= prev->right))
+				return FALSE;
+		}
+		else if (cur->top < prev->bottom)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int test_union_rects(void)
+{
+	int retCode = -1;
+	REGION16 batch = { 0 };
+	REGION16 single = { 0 };
+	RECTANGLE_16 rects[200] = { 0 };
+	BYTE batchCells[UNION_CELLS * UNION_CELLS] = { 0 };
+	BYTE singleCells[UNION_CELLS * UNION_CELLS] = { 0 };
+	UINT32 seed = 0x12345678;
+
+	region16_init(&batch);
+	region16_init(&single);
+
+	for (size_t round = 0; round < 50; round++)
+	{
+		const UINT32 count = 1 + (round * 7) % ARRAYSIZE(rects);
+
+		/* every 10 rounds start over with storage reused, else add to what is there */
+		if ((round % 10) == 0)
+		{
+			region16_reset(&batch);
+			region16_clear(&single);
+		}
+
+		for (UINT32 x = 0; x < count; x++)
+		{
+			UINT16 v[4] = { 0 };
+			for (size_t y = 0; y < ARRAYSIZE(v); y++)
+			{
+				/* a coarse grid gives many touching and identical edges */
+				seed = seed * 1103515245u + 12345u;
+				v[y] = (UINT16)(((seed >> 16) % UNION_CELLS) * UNION_GRID);
+			}
+			rects[x].left = MIN(v[0], v[1]);
+			rects[x].right = MAX(v[0], v[1]);
+			rects[x].top = MIN(v[2], v[3]);
+			rects[x].bottom = MAX(v[2], v[3]);
+		}
+
+		if (!region16_union_rects(&batch, &batch, rects, count))
+			goto out;
+
+		for (UINT32 x = 0; x < count; x++)
+		{
+			if (rectangle_is_empty(&rects[x]))
+				continue;
+			if (!region16_union_rect(&single, &single, &rects[x]))
+				goto out;
+		}
+
+		/* both must cover the same area, the batch result is in strict y-x banded form */
+		if (!region_rasterize(&batch, batchCells) || !region_rasterize(&single, singleCells))
+			goto out;
+
+		if ((memcmp(batchCells, singleCells, sizeof(batchCells)) != 0) ||
+		    !region_is_banded(&batch))
+		{
+			(void)fprintf(stderr, "round %" PRIuz ": batch union differs\n", round);
+			goto out;
+		}
+
+		if (!region16_is_empty(&single) &&
+		    !compareRectangles(region16_extents(&batch), region16_extents(&single), 1))
+			goto out;
+	}
+
+	retCode = 0;
+out:
+	region16_uninit(&batch);
+	region16_uninit(&single);
+	return retCode;
+}
+
 static struct UnitaryTest tests[] = { { "Basic trivial tests", test_basic },
 	                                  { "R1+R3 and R3+R1", test_r1_r3 },
 	                                  { "R1+R5", test_r1_r5 },
@@ -849,6 +974,7 @@ static struct UnitaryTest tests[] = { { "Basic trivial tests", test_basic },
 	                                  { "norbert's case", test_norbert_case },
 	                                  { "norbert's case 2", test_norbert2_case },
 	                                  { "empty rectangle case", test_empty_rectangle },
+	                                  { "batch union", test_union_rects },
 
 	                                  { NULL, NULL } };
 
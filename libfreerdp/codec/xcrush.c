@@ -30,6 +30,7 @@
 
 #include <freerdp/log.h>
 #include "xcrush.h"
+#include "bulk_match.h"
 
 #pragma pack(push, 1)
 
@@ -411,8 +412,6 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT3
                                     UINT32 MaxMatchLength,
                                     XCRUSH_MATCH_INFO* WINPR_RESTRICT MatchInfo)
 {
-	UINT32 MatchSymbol = 0;
-	UINT32 ChunkSymbol = 0;
 	BYTE* ChunkBuffer = NULL;
 	BYTE* MatchBuffer = NULL;
 	BYTE* MatchStartPtr = NULL;
@@ -462,18 +461,10 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT3
 		return 0;
 	}
 
-	while (1)
+	if (ForwardMatchPtr < HistoryBufferEnd)
 	{
-		MatchSymbol = *ForwardMatchPtr++;
-		ChunkSymbol = *ForwardChunkPtr++;
-
-		if (MatchSymbol != ChunkSymbol)
-			break;
-
-		if (ForwardMatchPtr > HistoryBufferEnd)
-			break;
-
-		ForwardMatchLength++;
+		const size_t MaxLength = (size_t)(HistoryBufferEnd - ForwardMatchPtr);
+		ForwardMatchLength = (UINT32)bulk_match_length(ForwardMatchPtr, ForwardChunkPtr, MaxLength);
 	}
 
 	ReverseMatchPtr = MatchBuffer - 1;
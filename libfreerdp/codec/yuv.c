@@ -33,6 +33,13 @@ typedef struct
 	UINT32 iDstStride[3];
 	RECTANGLE_16 rect;
 	BYTE type;
+
+	/* convert the combined stripe right away, while it is still in cache */
+	BOOL convert;
+	RECTANGLE_16 convertRect;
+	DWORD DstFormat;
+	BYTE* dest;
+	UINT32 nDstStep;
 } YUV_COMBINE_WORK_PARAM;
 
 typedef struct
@@ -62,6 +69,7 @@ struct S_YUV_CONTEXT
 	TP_CALLBACK_ENVIRON ThreadPoolEnv;
 
 	UINT32 work_object_count;
+	size_t work_object_capacity;
 	PTP_WORK* work_objects;
 	YUV_ENCODE_WORK_PARAM* work_enc_params;
 	YUV_PROCESS_WORK_PARAM* work_dec_params;
@@ -182,42 +190,49 @@ BOOL yuv_context_reset(YUV_CONTEXT* WINPR_RESTRICT context, UINT32 width, UINT32
 		const size_t count = pw * ph;
 
 		context->work_object_count = 0;
-		if (context->encoder)
-		{
-			void* tmp = winpr_aligned_recalloc(context->work_enc_params, count,
-			                                   sizeof(YUV_ENCODE_WORK_PARAM), 32);
-			if (!tmp)
-				goto fail;
-			memset(tmp, 0, count * sizeof(YUV_ENCODE_WORK_PARAM));
 
-			context->work_enc_params = tmp;
-		}
-		else
+		/* arrays only grow, shrinking or returning to a previous size reuses them */
+		if (count > context->work_object_capacity)
 		{
-			void* tmp = winpr_aligned_recalloc(context->work_dec_params, count,
-			                                   sizeof(YUV_PROCESS_WORK_PARAM), 32);
-			if (!tmp)
-				goto fail;
-			memset(tmp, 0, count * sizeof(YUV_PROCESS_WORK_PARAM));
+			if (context->encoder)
+			{
+				void* tmp = winpr_aligned_recalloc(context->work_enc_params, count,
+				                                   sizeof(YUV_ENCODE_WORK_PARAM), 32);
+				if (!tmp)
+					goto fail;
+				context->work_enc_params = tmp;
+			}
+			else
+			{
+				void* tmp = winpr_aligned_recalloc(context->work_dec_params, count,
+				                                   sizeof(YUV_PROCESS_WORK_PARAM), 32);
+				if (!tmp)
+					goto fail;
+				context->work_dec_params = tmp;
 
-			context->work_dec_params = tmp;
+				void* ctmp = winpr_aligned_recalloc(context->work_combined_params, count,
+				                                    sizeof(YUV_COMBINE_WORK_PARAM), 32);
+				if (!ctmp)
+					goto fail;
+				context->work_combined_params = ctmp;
+			}
 
-			void* ctmp = winpr_aligned_recalloc(context->work_combined_params, count,
-			                                    sizeof(YUV_COMBINE_WORK_PARAM), 32);
-			if (!ctmp)
+			void* wtmp =
+			    winpr_aligned_recalloc((void*)context->work_objects, count, sizeof(PTP_WORK), 32);
+			if (!wtmp)
 				goto fail;
-			memset(ctmp, 0, count * sizeof(YUV_COMBINE_WORK_PARAM));
-
-			context->work_combined_params = ctmp;
+			context->work_objects = (PTP_WORK*)wtmp;
+			context->work_object_capacity = count;
 		}
 
-		void* wtmp =
-		    winpr_aligned_recalloc((void*)context->work_objects, count, sizeof(PTP_WORK), 32);
-		if (!wtmp)
-			goto fail;
-		memset(wtmp, 0, count * sizeof(PTP_WORK));
-
-		context->work_objects = (PTP_WORK*)wtmp;
+		if (context->encoder)
+			memset(context->work_enc_params, 0, count * sizeof(YUV_ENCODE_WORK_PARAM));
+		else
+		{
+			memset(context->work_dec_params, 0, count * sizeof(YUV_PROCESS_WORK_PARAM));
+			memset(context->work_combined_params, 0, count * sizeof(YUV_COMBINE_WORK_PARAM));
+		}
+		memset((void*)context->work_objects, 0, count * sizeof(PTP_WORK));
 		context->work_object_count = WINPR_ASSERTING_INT_CAST(uint32_t, count);
 	}
 	rc = TRUE;
@@ -241,7 +256,9 @@ YUV_CONTEXT* yuv_context_new(BOOL encoder, UINT32 ThreadingFlags)
 	{
 		GetNativeSystemInfo(&sysInfos);
 		ret->useThreads = (sysInfos.dwNumberOfProcessors > 1);
-		if (ret->useThreads)
+		if (ret->useThreads && (ThreadingFlags & THREADING_FLAGS_SHARED_POOL))
+			ret->nthreads = sysInfos.dwNumberOfProcessors;
+		else if (ret->useThreads)
 		{
 			ret->nthreads = sysInfos.dwNumberOfProcessors;
 			ret->threadPool = CreateThreadpool(NULL);
@@ -272,8 +289,10 @@ void yuv_context_free(YUV_CONTEXT* context)
 	if (context->useThreads)
 	{
 		if (context->threadPool)
+		{
 			CloseThreadpool(context->threadPool);
-		DestroyThreadpoolEnvironment(&context->ThreadPoolEnv);
+			DestroyThreadpoolEnvironment(&context->ThreadPoolEnv);
+		}
 		winpr_aligned_free((void*)context->work_objects);
 		winpr_aligned_free(context->work_combined_params);
 		winpr_aligned_free(context->work_enc_params);
@@ -329,7 +348,9 @@ static BOOL submit_object(PTP_WORK* WINPR_RESTRICT work_object, PTP_WORK_CALLBAC
 	if (!param || !context)
 		return FALSE;
 
-	*work_object = CreateThreadpoolWork(cb, cnv.pv, &context->ThreadPoolEnv);
+	/* without a private pool the work goes to the process wide one */
+	*work_object =
+	    CreateThreadpoolWork(cb, cnv.pv, context->threadPool ? &context->ThreadPoolEnv : NULL);
 	if (!*work_object)
 		return FALSE;
 
@@ -389,6 +410,21 @@ static RECTANGLE_16 clamp(YUV_CONTEXT* WINPR_RESTRICT context,
 	return c;
 }
 
+/**
+ * Rows per work item when splitting a rectangle into full width stripes, one per thread.
+ * Stripes are a multiple of 16 rows, so the AVC444 auxiliary frame bands and the chroma
+ * subsampling never cross a stripe boundary.
+ */
+static UINT32 stripe_height(const YUV_CONTEXT* WINPR_RESTRICT context, UINT32 height)
+{
+	WINPR_ASSERT(context);
+
+	const UINT32 nthreads = MAX(1, context->nthreads);
+	UINT32 step = (height + nthreads - 1) / nthreads;
+	step = (step + 15) & ~15u;
+	return MAX(step, TILE_SIZE);
+}
+
 static BOOL pool_decode(YUV_CONTEXT* WINPR_RESTRICT context, PTP_WORK_CALLBACK cb,
                         const BYTE* WINPR_RESTRICT pYUVData[3], const UINT32 iStride[3],
                         UINT32 yuvHeight, UINT32 DstFormat, BYTE* WINPR_RESTRICT dest,
@@ -432,33 +468,24 @@ static BOOL pool_decode(YUV_CONTEXT* WINPR_RESTRICT context, PTP_WORK_CALLBACK c
 		if (intersects(x, regionRects, numRegionRects))
 			continue;
 
-		while (r.left < r.right)
+		const UINT32 step = stripe_height(context, 1u * r.bottom - r.top);
+		while (r.top < r.bottom)
 		{
-			RECTANGLE_16 y = r;
-			y.right = MIN(r.right, r.left + TILE_SIZE);
+			RECTANGLE_16 z = r;
+			z.bottom = WINPR_ASSERTING_INT_CAST(UINT16, MIN(r.bottom, r.top + step));
 
-			while (y.top < y.bottom)
+			if (context->work_object_count <= waitCount)
 			{
-				RECTANGLE_16 z = y;
-
-				if (context->work_object_count <= waitCount)
-				{
-					free_objects(context->work_objects, context->work_object_count);
-					waitCount = 0;
-				}
-
-				YUV_PROCESS_WORK_PARAM* cur = &context->work_dec_params[waitCount];
-				z.bottom = MIN(z.bottom, z.top + TILE_SIZE);
-				if (rectangle_is_empty(&z))
-					continue;
-				*cur = pool_decode_param(&z, context, pYUVData, iStride, DstFormat, dest, nDstStep);
-				if (!submit_object(&context->work_objects[waitCount], cb, cur, context))
-					goto fail;
-				waitCount++;
-				y.top += TILE_SIZE;
+				free_objects(context->work_objects, context->work_object_count);
+				waitCount = 0;
 			}
 
-			r.left += TILE_SIZE;
+			YUV_PROCESS_WORK_PARAM* cur = &context->work_dec_params[waitCount];
+			*cur = pool_decode_param(&z, context, pYUVData, iStride, DstFormat, dest, nDstStep);
+			if (!submit_object(&context->work_objects[waitCount], cb, cur, context))
+				goto fail;
+			waitCount++;
+			r.top = z.bottom;
 		}
 	}
 	rc = TRUE;
@@ -517,7 +544,19 @@ static void CALLBACK yuv444_combine_work_callback(PTP_CALLBACK_INSTANCE instance
 	if (prims->YUV420CombineToYUV444(param->type, param->pYUVData, param->iStride, alignedWidth,
 	                                 alignedHeight, param->pYUVDstData, param->iDstStride,
 	                                 rect) != PRIMITIVES_SUCCESS)
+	{
 		WLog_WARN(TAG, "YUV420CombineToYUV444 failed");
+		return;
+	}
+
+	if (!param->convert)
+		return;
+
+	const BYTE* pYUVCDstData[3] = { param->pYUVDstData[0], param->pYUVDstData[1],
+		                            param->pYUVDstData[2] };
+	if (!avc444_yuv_to_rgb(pYUVCDstData, param->iDstStride, &param->convertRect, param->nDstStep,
+	                       param->dest, param->DstFormat))
+		WLog_WARN(TAG, "avc444_yuv_to_rgb failed");
 }
 
 static INLINE YUV_COMBINE_WORK_PARAM
@@ -552,9 +591,17 @@ pool_decode_rect_param(const RECTANGLE_16* WINPR_RESTRICT rect, YUV_CONTEXT* WIN
 	return current;
 }
 
+/**
+ * Combine the AVC444 views and convert the result to RGB.
+ * With threads every rectangle is split into stripes that are combined and converted by the
+ * same work item, so the whole frame needs a single wait and the YUV444 rows of a stripe are
+ * still in cache when they are converted.
+ */
 static BOOL pool_decode_rect(YUV_CONTEXT* WINPR_RESTRICT context, BYTE type,
                              const BYTE* WINPR_RESTRICT pYUVData[3], const UINT32 iStride[3],
-                             BYTE* WINPR_RESTRICT pYUVDstData[3], const UINT32 iDstStride[3],
+                             UINT32 yuvHeight, BYTE* WINPR_RESTRICT pYUVDstData[3],
+                             const UINT32 iDstStride[3], DWORD DstFormat,
+                             BYTE* WINPR_RESTRICT dest, UINT32 nDstStep,
                              const RECTANGLE_16* WINPR_RESTRICT regionRects, UINT32 numRegionRects)
 {
 	BOOL rc = FALSE;
@@ -577,25 +624,49 @@ static BOOL pool_decode_rect(YUV_CONTEXT* WINPR_RESTRICT context, BYTE type,
 			    &regionRects[y], context, type, pYUVData, iStride, pYUVDstData, iDstStride);
 			cb(NULL, &current, NULL);
 		}
-		return TRUE;
+
+		const BYTE* pYUVCDstData[3] = { pYUVDstData[0], pYUVDstData[1], pYUVDstData[2] };
+		return pool_decode(context, yuv444_process_work_callback, pYUVCDstData, iDstStride,
+		                   yuvHeight, DstFormat, dest, nDstStep, regionRects, numRegionRects);
 	}
 
 	/* case where we use threads */
-	for (waitCount = 0; waitCount < numRegionRects; waitCount++)
+	for (UINT32 x = 0; x < numRegionRects; x++)
 	{
-		YUV_COMBINE_WORK_PARAM* current = NULL;
+		RECTANGLE_16 r = regionRects[x];
+		const RECTANGLE_16 clamped = clamp(context, &r, yuvHeight);
 
-		if (context->work_object_count <= waitCount)
+		/* intersecting rectangles are combined but not converted */
+		const BOOL convert = !intersects(x, regionRects, numRegionRects);
+
+		const UINT32 step = stripe_height(context, 1u * r.bottom - r.top);
+		while (r.top < r.bottom)
 		{
-			free_objects(context->work_objects, context->work_object_count);
-			waitCount = 0;
-		}
-		current = &context->work_combined_params[waitCount];
-		*current = pool_decode_rect_param(&regionRects[waitCount], context, type, pYUVData, iStride,
-		                                  pYUVDstData, iDstStride);
+			RECTANGLE_16 z = r;
+			z.bottom = WINPR_ASSERTING_INT_CAST(UINT16, MIN(r.bottom, r.top + step));
+
+			if (context->work_object_count <= waitCount)
+			{
+				free_objects(context->work_objects, context->work_object_count);
+				waitCount = 0;
+			}
 
-		if (!submit_object(&context->work_objects[waitCount], cb, current, context))
-			goto fail;
+			YUV_COMBINE_WORK_PARAM* current = &context->work_combined_params[waitCount];
+			*current = pool_decode_rect_param(&z, context, type, pYUVData, iStride, pYUVDstData,
+			                                  iDstStride);
+			current->convertRect = z;
+			current->convertRect.top = MAX(z.top, clamped.top);
+			current->convertRect.bottom = MIN(z.bottom, clamped.bottom);
+			current->convert = convert && (current->convertRect.top < current->convertRect.bottom);
+			current->DstFormat = DstFormat;
+			current->dest = dest;
+			current->nDstStep = nDstStep;
+
+			if (!submit_object(&context->work_objects[waitCount], cb, current, context))
+				goto fail;
+			waitCount++;
+			r.top = z.bottom;
+		}
 	}
 
 	rc = TRUE;
@@ -611,8 +682,6 @@ BOOL yuv444_context_decode(YUV_CONTEXT* WINPR_RESTRICT context, BYTE type,
                            UINT32 nDstStep, const RECTANGLE_16* WINPR_RESTRICT regionRects,
                            UINT32 numRegionRects)
 {
-	const BYTE* pYUVCDstData[3];
-
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(pYUVData);
 	WINPR_ASSERT(iStride);
@@ -626,15 +695,8 @@ BOOL yuv444_context_decode(YUV_CONTEXT* WINPR_RESTRICT context, BYTE type,
 		WLog_ERR(TAG, "YUV context set up for encoding, can not decode with it, aborting");
 		return FALSE;
 	}
-	if (!pool_decode_rect(context, type, pYUVData, iStride, pYUVDstData, iDstStride, regionRects,
-	                      numRegionRects))
-		return FALSE;
-
-	pYUVCDstData[0] = pYUVDstData[0];
-	pYUVCDstData[1] = pYUVDstData[1];
-	pYUVCDstData[2] = pYUVDstData[2];
-	return pool_decode(context, yuv444_process_work_callback, pYUVCDstData, iDstStride,
-	                   srcYuvHeight, DstFormat, dest, nDstStep, regionRects, numRegionRects);
+	return pool_decode_rect(context, type, pYUVData, iStride, srcYuvHeight, pYUVDstData,
+	                        iDstStride, DstFormat, dest, nDstStep, regionRects, numRegionRects);
 }
 
 BOOL yuv420_context_decode(YUV_CONTEXT* WINPR_RESTRICT context,
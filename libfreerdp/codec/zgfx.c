@@ -26,6 +26,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/intrin.h>
 
 #include <freerdp/log.h>
 #include <freerdp/codec/zgfx.h>
@@ -42,6 +43,15 @@
  * Minimum match length: 3 bytes
  */
 
+#define ZGFX_HASH_BITS 16
+#define ZGFX_HASH_SIZE (1u << ZGFX_HASH_BITS)
+#define ZGFX_MAX_MATCH 65535
+#define ZGFX_MIN_UNENCODED 32
+#define ZGFX_MAX_UNENCODED 32767
+
+/* the longest token prefix, the decoder looks up that many bits at once */
+#define ZGFX_DECODE_BITS 9
+
 typedef struct
 {
 	UINT32 prefixLength;
@@ -55,20 +65,33 @@ struct S_ZGFX_CONTEXT
 {
 	BOOL Compressor;
 
+	const BYTE* pbInputStart;
 	const BYTE* pbInputCurrent;
 	const BYTE* pbInputEnd;
 
-	UINT32 bits;
+	UINT32 cBitsRead;
 	UINT32 cBitsRemaining;
-	UINT32 BitsCurrent;
+	UINT64 BitsCurrent; /* buffered input bits, the next one in the most significant bit */
 	UINT32 cBitsCurrent;
 
+	/* Decompressor state, indexed by the next ZGFX_DECODE_BITS input bits */
+	BYTE DecodeLength[1u << ZGFX_DECODE_BITS]; /* prefix length, 0 for an invalid prefix */
+	BYTE DecodeToken[1u << ZGFX_DECODE_BITS];  /* index into ZGFX_TOKEN_TABLE */
+
 	BYTE OutputBuffer[65536];
 	UINT32 OutputCount;
 
 	BYTE HistoryBuffer[2500000];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	/* Compressor state */
+	UINT32 CompressionLevel;
+	UINT32 HistoryPos;
+	UINT32* HashHead;
+	UINT32* HashPrev;
+	UINT16 LiteralCode[256];
+	BYTE LiteralLength[256];
 };
 
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
@@ -116,28 +139,91 @@ static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	{ 0 }
 };
 
-static INLINE BOOL zgfx_GetBits(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 nbits)
+static void zgfx_init_decode_table(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
 {
-	if (!zgfx)
-		return FALSE;
+	for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+		const UINT32 shift = ZGFX_DECODE_BITS - token->prefixLength;
+		const UINT32 first = token->prefixCode << shift;
+
+		for (UINT32 y = 0; y < (1u << shift); y++)
+		{
+			zgfx->DecodeLength[first + y] = (BYTE)token->prefixLength;
+			zgfx->DecodeToken[first + y] = (BYTE)x;
+		}
+	}
+}
 
-	while (zgfx->cBitsCurrent < nbits)
+/* Tops BitsCurrent up to at least 57 bits. Past the end of the input zero bits are shifted in,
+ * the callers check cBitsRemaining before using them. */
+static INLINE void zgfx_input_refill(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	if (zgfx->pbInputEnd - zgfx->pbInputCurrent >= 8)
 	{
-		zgfx->BitsCurrent <<= 8;
+		/* the bytes that do not fit are loaded again by the next refill */
+		const UINT64 value = winpr_Data_Get_UINT64_BE(zgfx->pbInputCurrent);
+		zgfx->BitsCurrent |= value >> zgfx->cBitsCurrent;
+		zgfx->pbInputCurrent += (63 - zgfx->cBitsCurrent) >> 3;
+		zgfx->cBitsCurrent |= 56;
+		return;
+	}
 
+	while (zgfx->cBitsCurrent <= 56)
+	{
 		if (zgfx->pbInputCurrent < zgfx->pbInputEnd)
-			zgfx->BitsCurrent += *(zgfx->pbInputCurrent)++;
-
+			zgfx->BitsCurrent |= (UINT64)*(zgfx->pbInputCurrent)++ << (56 - zgfx->cBitsCurrent);
 		zgfx->cBitsCurrent += 8;
 	}
+}
 
-	zgfx->cBitsRemaining -= nbits;
+static INLINE UINT32 zgfx_input_peek(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= zgfx->cBitsCurrent);
+	if (nbits == 0)
+		return 0;
+	return (UINT32)(zgfx->BitsCurrent >> (64 - nbits));
+}
+
+static INLINE BOOL zgfx_input_skip(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= zgfx->cBitsCurrent);
+	if (nbits > zgfx->cBitsRemaining)
+		return FALSE;
+
+	zgfx->BitsCurrent = (nbits < 64) ? (zgfx->BitsCurrent << nbits) : 0;
 	zgfx->cBitsCurrent -= nbits;
-	zgfx->bits = zgfx->BitsCurrent >> zgfx->cBitsCurrent;
-	zgfx->BitsCurrent &= ((1 << zgfx->cBitsCurrent) - 1);
+	zgfx->cBitsRemaining -= nbits;
+	zgfx->cBitsRead += nbits;
 	return TRUE;
 }
 
+static INLINE BOOL zgfx_input_read(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 nbits,
+                                  UINT32* WINPR_RESTRICT value)
+{
+	WINPR_ASSERT(value);
+	WINPR_ASSERT(nbits <= 32);
+
+	if (zgfx->cBitsCurrent < nbits)
+		zgfx_input_refill(zgfx);
+
+	*value = zgfx_input_peek(zgfx, nbits);
+	return zgfx_input_skip(zgfx, nbits);
+}
+
+/* Drops the bits of a partially read byte and the read ahead, unencoded data starts on the next
+ * byte boundary of the input */
+static INLINE void zgfx_input_align(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	const UINT32 partial = (8 - (zgfx->cBitsRead % 8)) % 8;
+
+	zgfx->cBitsRemaining -= MIN(partial, zgfx->cBitsRemaining);
+	zgfx->cBitsRead += partial;
+	zgfx->pbInputCurrent = &zgfx->pbInputStart[zgfx->cBitsRead / 8];
+	zgfx->BitsCurrent = 0;
+	zgfx->cBitsCurrent = 0;
+}
+
 static INLINE void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
                                                   const BYTE* WINPR_RESTRICT src, size_t count)
 {
@@ -220,17 +306,43 @@ static INLINE void zgfx_history_buffer_ring_read(ZGFX_CONTEXT* WINPR_RESTRICT zg
 	} while ((bytesLeft -= bytes) > 0);
 }
 
+/* A match length is a run of 1 bits terminated by a 0 bit, selecting the base length and the
+ * number of bits that follow: 0 -> 3, 10xx -> 4 + xx, 110xxx -> 8 + xxx, ... */
+static INLINE BOOL zgfx_read_match_length(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                          UINT32* WINPR_RESTRICT count)
+{
+	WINPR_ASSERT(count);
+
+	zgfx_input_refill(zgfx);
+
+	const UINT32 prefix = ~zgfx_input_peek(zgfx, 32);
+	if (prefix == 0)
+		return FALSE;
+
+	const UINT32 ones = __lzcnt(prefix);
+	if (ones == 0)
+	{
+		*count = 3;
+		return zgfx_input_skip(zgfx, 1);
+	}
+
+	/* longer runs exceed the maximum match length */
+	if (ones > 15)
+		return FALSE;
+
+	UINT32 extra = 0;
+	if (!zgfx_input_skip(zgfx, ones + 1) || !zgfx_input_read(zgfx, ones + 1, &extra))
+		return FALSE;
+
+	*count = (4u << (ones - 1)) + extra;
+	return TRUE;
+}
+
 static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
                                            wStream* WINPR_RESTRICT stream, size_t segmentSize)
 {
-	BYTE c = 0;
 	BYTE flags = 0;
-	UINT32 extra = 0;
-	int opIndex = 0;
-	UINT32 haveBits = 0;
-	UINT32 inPrefix = 0;
-	UINT32 count = 0;
-	UINT32 distance = 0;
+	UINT32 pending = 0; /* start of the output not yet appended to the history */
 	BYTE* pbSegment = NULL;
 
 	WINPR_ASSERT(zgfx);
@@ -262,6 +374,7 @@ static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
 		return TRUE;
 	}
 
+	zgfx->pbInputStart = pbSegment;
 	zgfx->pbInputCurrent = pbSegment;
 	zgfx->pbInputEnd = &pbSegment[cbSegment - 1];
 	/* NumberOfBitsToDecode = ((NumberOfBytesToDecode - 1) * 8) - ValueOfLastByte */
@@ -272,111 +385,84 @@ static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
 		return FALSE;
 
 	zgfx->cBitsRemaining = (UINT32)(bits - *zgfx->pbInputEnd);
+	zgfx->cBitsRead = 0;
 	zgfx->cBitsCurrent = 0;
 	zgfx->BitsCurrent = 0;
 
 	while (zgfx->cBitsRemaining)
 	{
-		haveBits = 0;
-		inPrefix = 0;
+		UINT32 value = 0;
 
-		for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+		zgfx_input_refill(zgfx);
+
+		const UINT32 index = zgfx_input_peek(zgfx, ZGFX_DECODE_BITS);
+		const UINT32 prefixLength = zgfx->DecodeLength[index];
+		if ((prefixLength == 0) || !zgfx_input_skip(zgfx, prefixLength))
+			return FALSE;
+
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[zgfx->DecodeToken[index]];
+		if (!zgfx_input_read(zgfx, token->valueBits, &value))
+			return FALSE;
+
+		if (token->tokenType == 0)
 		{
-			while (haveBits < ZGFX_TOKEN_TABLE[opIndex].prefixLength)
-			{
-				zgfx_GetBits(zgfx, 1);
-				inPrefix = (inPrefix << 1) + zgfx->bits;
-				haveBits++;
-			}
+			/* Literal */
+			if (zgfx->OutputCount >= sizeof(zgfx->OutputBuffer))
+				return FALSE;
 
-			if (inPrefix == ZGFX_TOKEN_TABLE[opIndex].prefixCode)
-			{
-				if (ZGFX_TOKEN_TABLE[opIndex].tokenType == 0)
-				{
-					/* Literal */
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					c = (BYTE)(ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits);
-					zgfx->HistoryBuffer[zgfx->HistoryIndex] = c;
-
-					if (++zgfx->HistoryIndex == zgfx->HistoryBufferSize)
-						zgfx->HistoryIndex = 0;
-
-					if (zgfx->OutputCount >= sizeof(zgfx->OutputBuffer))
-						return FALSE;
-
-					zgfx->OutputBuffer[zgfx->OutputCount++] = c;
-				}
-				else
-				{
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					distance = ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits;
-
-					if (distance != 0)
-					{
-						/* Match */
-						zgfx_GetBits(zgfx, 1);
-
-						if (zgfx->bits == 0)
-						{
-							count = 3;
-						}
-						else
-						{
-							count = 4;
-							extra = 2;
-							zgfx_GetBits(zgfx, 1);
-
-							while (zgfx->bits == 1)
-							{
-								count *= 2;
-								extra++;
-								zgfx_GetBits(zgfx, 1);
-							}
-
-							zgfx_GetBits(zgfx, extra);
-							count += zgfx->bits;
-						}
-
-						if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
-							return FALSE;
-
-						zgfx_history_buffer_ring_read(zgfx, WINPR_ASSERTING_INT_CAST(int, distance),
-						                              &(zgfx->OutputBuffer[zgfx->OutputCount]),
-						                              count);
-						zgfx_history_buffer_ring_write(
-						    zgfx, &(zgfx->OutputBuffer[zgfx->OutputCount]), count);
-						zgfx->OutputCount += count;
-					}
-					else
-					{
-						/* Unencoded */
-						zgfx_GetBits(zgfx, 15);
-						count = zgfx->bits;
-						zgfx->cBitsRemaining -= zgfx->cBitsCurrent;
-						zgfx->cBitsCurrent = 0;
-						zgfx->BitsCurrent = 0;
-
-						if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
-							return FALSE;
-						else if (count > zgfx->cBitsRemaining / 8)
-							return FALSE;
-						else if (zgfx->pbInputCurrent + count > zgfx->pbInputEnd)
-							return FALSE;
-
-						CopyMemory(&(zgfx->OutputBuffer[zgfx->OutputCount]), zgfx->pbInputCurrent,
-						           count);
-						zgfx_history_buffer_ring_write(zgfx, zgfx->pbInputCurrent, count);
-						zgfx->pbInputCurrent += count;
-						zgfx->cBitsRemaining -= (8 * count);
-						zgfx->OutputCount += count;
-					}
-				}
-
-				break;
-			}
+			zgfx->OutputBuffer[zgfx->OutputCount++] = (BYTE)(token->valueBase + value);
+		}
+		else if (token->valueBase + value != 0)
+		{
+			/* Match */
+			const UINT32 distance = token->valueBase + value;
+			UINT32 count = 0;
+
+			if (!zgfx_read_match_length(zgfx, &count))
+				return FALSE;
+
+			if (distance > zgfx->HistoryBufferSize)
+				return FALSE;
+
+			if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
+				return FALSE;
+
+			/* the match may refer to the output of this segment so far */
+			zgfx_history_buffer_ring_write(zgfx, &(zgfx->OutputBuffer[pending]),
+			                               zgfx->OutputCount - pending);
+			pending = zgfx->OutputCount;
+
+			zgfx_history_buffer_ring_read(zgfx, WINPR_ASSERTING_INT_CAST(int, distance),
+			                              &(zgfx->OutputBuffer[zgfx->OutputCount]), count);
+			zgfx->OutputCount += count;
+		}
+		else
+		{
+			/* Unencoded */
+			UINT32 count = 0;
+
+			if (!zgfx_input_read(zgfx, 15, &count))
+				return FALSE;
+
+			zgfx_input_align(zgfx);
+
+			if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
+				return FALSE;
+			else if (count > zgfx->cBitsRemaining / 8)
+				return FALSE;
+			else if (zgfx->pbInputCurrent + count > zgfx->pbInputEnd)
+				return FALSE;
+
+			CopyMemory(&(zgfx->OutputBuffer[zgfx->OutputCount]), zgfx->pbInputCurrent, count);
+			zgfx->pbInputCurrent += count;
+			zgfx->cBitsRemaining -= (8 * count);
+			zgfx->cBitsRead += (8 * count);
+			zgfx->OutputCount += count;
 		}
 	}
 
+	zgfx_history_buffer_ring_write(zgfx, &(zgfx->OutputBuffer[pending]),
+	                               zgfx->OutputCount - pending);
 	return TRUE;
 }
 
@@ -488,11 +574,362 @@ fail:
 	return status;
 }
 
-static BOOL zgfx_compress_segment(WINPR_ATTR_UNUSED ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
-                                  wStream* WINPR_RESTRICT s, const BYTE* WINPR_RESTRICT pSrcData,
-                                  UINT32 SrcSize, UINT32* WINPR_RESTRICT pFlags)
+typedef struct
+{
+	UINT32 maxChain;
+	UINT32 niceLength;
+	BOOL lazy;
+} ZGFX_LEVEL;
+
+/* chain depth, length at which the search stops early, lazy evaluation */
+static const ZGFX_LEVEL ZGFX_LEVEL_TABLE[ZGFX_COMPRESSION_LEVEL_MAX + 1] = {
+	{ 0, 0, FALSE },      // 0: store only
+	{ 4, 16, FALSE },     // 1
+	{ 8, 32, FALSE },     // 2
+	{ 16, 64, FALSE },    // 3
+	{ 32, 128, TRUE },    // 4
+	{ 64, 256, TRUE },    // 5
+	{ 128, 512, TRUE },   // 6
+	{ 256, 1024, TRUE },  // 7
+	{ 512, 4096, TRUE },  // 8
+	{ 2048, 65535, TRUE } // 9
+};
+
+typedef struct
+{
+	BYTE* buffer;
+	size_t capacity;
+	size_t length;
+	UINT64 accumulator;
+	UINT32 count;
+	BOOL overflow;
+} ZGFX_BIT_WRITER;
+
+static INLINE void zgfx_bits_write(ZGFX_BIT_WRITER* WINPR_RESTRICT w, UINT32 value, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+
+	w->accumulator = (w->accumulator << nbits) | (value & ((1ull << nbits) - 1ull));
+	w->count += nbits;
+
+	while (w->count >= 8)
+	{
+		w->count -= 8;
+
+		if (w->length >= w->capacity)
+		{
+			w->overflow = TRUE;
+			continue;
+		}
+
+		w->buffer[w->length++] = (BYTE)(w->accumulator >> w->count);
+	}
+}
+
+static INLINE void zgfx_bits_align(ZGFX_BIT_WRITER* WINPR_RESTRICT w)
+{
+	if (w->count > 0)
+		zgfx_bits_write(w, 0, 8 - w->count);
+}
+
+static INLINE void zgfx_bits_write_bytes(ZGFX_BIT_WRITER* WINPR_RESTRICT w,
+                                         const BYTE* WINPR_RESTRICT src, size_t count)
+{
+	WINPR_ASSERT(w->count == 0);
+
+	if (count > w->capacity - w->length)
+	{
+		w->overflow = TRUE;
+		return;
+	}
+
+	CopyMemory(&w->buffer[w->length], src, count);
+	w->length += count;
+}
+
+static INLINE UINT32 zgfx_hash(const BYTE* WINPR_RESTRICT src)
+{
+	const UINT32 value = ((UINT32)src[0] << 16) | ((UINT32)src[1] << 8) | src[2];
+	return (value * 2654435761u) >> (32 - ZGFX_HASH_BITS);
+}
+
+static INLINE const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+
+		if ((token->tokenType == 1) && (distance >= token->valueBase) &&
+		    (distance - token->valueBase < (1u << token->valueBits)))
+			return token;
+	}
+
+	return NULL;
+}
+
+static INLINE UINT32 zgfx_length_bits(UINT32 count)
+{
+	if (count == 3)
+		return 1;
+
+	const UINT32 k = 31 - __lzcnt(count);
+	return 2 * k;
+}
+
+/* Estimated size in bits of a match token, used to reject matches that are not worth it */
+static INLINE UINT32 zgfx_match_bits(UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+
+	if (!token)
+		return UINT32_MAX;
+
+	return token->prefixLength + token->valueBits + zgfx_length_bits(count);
+}
+
+static void zgfx_init_literal_table(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	/* Default: 1 bit prefix followed by the 8 bit value */
+	for (size_t c = 0; c < ARRAYSIZE(zgfx->LiteralCode); c++)
+	{
+		zgfx->LiteralCode[c] = (UINT16)((ZGFX_TOKEN_TABLE[0].prefixCode << 8) | c);
+		zgfx->LiteralLength[c] = (BYTE)(ZGFX_TOKEN_TABLE[0].prefixLength + 8);
+	}
+
+	for (size_t x = 1; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+
+		if ((token->tokenType == 0) && (token->valueBits == 0))
+		{
+			zgfx->LiteralCode[token->valueBase] = (UINT16)token->prefixCode;
+			zgfx->LiteralLength[token->valueBase] = (BYTE)token->prefixLength;
+		}
+	}
+}
+
+static INLINE void zgfx_write_literal(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                      ZGFX_BIT_WRITER* WINPR_RESTRICT w, BYTE c)
+{
+	zgfx_bits_write(w, zgfx->LiteralCode[c], zgfx->LiteralLength[c]);
+}
+
+static INLINE void zgfx_write_match(ZGFX_BIT_WRITER* WINPR_RESTRICT w, UINT32 distance,
+                                    UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+	WINPR_ASSERT(token);
+	WINPR_ASSERT(count >= 3);
+
+	zgfx_bits_write(w, token->prefixCode, token->prefixLength);
+	zgfx_bits_write(w, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+	{
+		zgfx_bits_write(w, 0, 1);
+		return;
+	}
+
+	/* (k - 1) one bits, a zero bit and k bits of count - 2^k */
+	const UINT32 k = 31 - __lzcnt(count);
+	zgfx_bits_write(w, ((1u << (k - 1)) - 1) << 1, k);
+	zgfx_bits_write(w, count - (1u << k), k);
+}
+
+static INLINE void zgfx_write_literals(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                       ZGFX_BIT_WRITER* WINPR_RESTRICT w,
+                                       const BYTE* WINPR_RESTRICT src, size_t count)
+{
+	while (count >= ZGFX_MIN_UNENCODED)
+	{
+		const UINT32 run = (UINT32)MIN(count, ZGFX_MAX_UNENCODED);
+
+		/* distance 0 announces a run of unencoded bytes */
+		zgfx_bits_write(w, ZGFX_TOKEN_TABLE[1].prefixCode, ZGFX_TOKEN_TABLE[1].prefixLength);
+		zgfx_bits_write(w, 0, ZGFX_TOKEN_TABLE[1].valueBits);
+		zgfx_bits_write(w, run, 15);
+		zgfx_bits_align(w);
+		zgfx_bits_write_bytes(w, src, run);
+		src += run;
+		count -= run;
+	}
+
+	for (size_t x = 0; x < count; x++)
+		zgfx_write_literal(zgfx, w, src[x]);
+}
+
+static INLINE UINT32 zgfx_ring_index(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 startIndex,
+                                     UINT32 pos)
+{
+	const UINT32 size = zgfx->HistoryBufferSize;
+
+	if (pos >= zgfx->HistoryPos)
+		return (UINT32)((startIndex + (pos - zgfx->HistoryPos)) % size);
+
+	return (UINT32)((startIndex + size - ((zgfx->HistoryPos - pos) % size)) % size);
+}
+
+static void zgfx_hash_rebase(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	const UINT32 delta = zgfx->HistoryPos - zgfx->HistoryBufferSize;
+
+	for (size_t x = 0; x < ZGFX_HASH_SIZE; x++)
+		zgfx->HashHead[x] = (zgfx->HashHead[x] > delta) ? zgfx->HashHead[x] - delta : 0;
+
+	for (size_t x = 0; x < zgfx->HistoryBufferSize; x++)
+		zgfx->HashPrev[x] = (zgfx->HashPrev[x] > delta) ? zgfx->HashPrev[x] - delta : 0;
+
+	zgfx->HistoryPos -= delta;
+}
+
+static INLINE void zgfx_hash_insert(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                    const BYTE* WINPR_RESTRICT pSrcData, UINT32 startIndex,
+                                    UINT32 offset)
+{
+	const UINT32 pos = zgfx->HistoryPos + offset;
+	const UINT32 h = zgfx_hash(&pSrcData[offset]);
+	zgfx->HashPrev[(startIndex + offset) % zgfx->HistoryBufferSize] = zgfx->HashHead[h];
+	zgfx->HashHead[h] = pos + 1;
+}
+
+/**
+ * Walk the hash chain for the data at pSrcData[offset] and return the longest match.
+ * Chain entries are absolute history positions + 1, 0 terminates the chain.
+ */
+static INLINE UINT32 zgfx_find_match(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                     const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                     UINT32 startIndex, UINT32 lowBound, UINT32 offset,
+                                     UINT32* WINPR_RESTRICT pDistance)
+{
+	const ZGFX_LEVEL* level = &ZGFX_LEVEL_TABLE[zgfx->CompressionLevel];
+	const UINT32 size = zgfx->HistoryBufferSize;
+	const UINT32 pos = zgfx->HistoryPos + offset;
+	const UINT32 maxLength = MIN(SrcSize - offset, ZGFX_MAX_MATCH);
+	const BYTE* cur = &pSrcData[offset];
+	UINT32 bestLength = 0;
+	UINT32 bestDistance = 0;
+	UINT32 chain = level->maxChain;
+	UINT32 entry = zgfx->HashHead[zgfx_hash(cur)];
+
+	if (maxLength < 3)
+		return 0;
+
+	while ((entry > lowBound) && (chain-- > 0))
+	{
+		const UINT32 candidate = entry - 1;
+
+		if (candidate >= pos)
+			break;
+
+		UINT32 index = zgfx_ring_index(zgfx, startIndex, candidate);
+		const UINT32 next = zgfx->HashPrev[index];
+
+		if ((bestLength == 0) ||
+		    (zgfx->HistoryBuffer[(index + bestLength) % size] == cur[bestLength]))
+		{
+			UINT32 length = 0;
+
+			while ((length < maxLength) && (zgfx->HistoryBuffer[index] == cur[length]))
+			{
+				length++;
+
+				if (++index == size)
+					index = 0;
+			}
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				bestDistance = pos - candidate;
+
+				if (length >= level->niceLength)
+					break;
+			}
+		}
+
+		if (next >= entry)
+			break;
+
+		entry = next;
+	}
+
+	if ((bestLength < 3) || (zgfx_match_bits(bestDistance, bestLength) >= 9 * bestLength))
+		return 0;
+
+	*pDistance = bestDistance;
+	return bestLength;
+}
+
+static BOOL zgfx_compress_segment_data(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                       ZGFX_BIT_WRITER* WINPR_RESTRICT w,
+                                       const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                       UINT32 startIndex)
+{
+	const ZGFX_LEVEL* level = &ZGFX_LEVEL_TABLE[zgfx->CompressionLevel];
+	const UINT32 end = zgfx->HistoryPos + SrcSize;
+	/* Only reference data still present in the ring once this segment is appended */
+	const UINT32 lowBound = (end > zgfx->HistoryBufferSize) ? end - zgfx->HistoryBufferSize : 0;
+	UINT32 literalStart = 0;
+	UINT32 offset = 0;
+
+	while (offset < SrcSize)
+	{
+		UINT32 distance = 0;
+		UINT32 length = 0;
+
+		if (offset + 3 <= SrcSize)
+		{
+			length =
+			    zgfx_find_match(zgfx, pSrcData, SrcSize, startIndex, lowBound, offset, &distance);
+			zgfx_hash_insert(zgfx, pSrcData, startIndex, offset);
+
+			if ((length > 0) && level->lazy && (length < level->niceLength) &&
+			    (offset + 4 <= SrcSize))
+			{
+				UINT32 nextDistance = 0;
+				const UINT32 nextLength = zgfx_find_match(zgfx, pSrcData, SrcSize, startIndex,
+				                                          lowBound, offset + 1, &nextDistance);
+
+				if (nextLength > length + 1)
+					length = 0;
+			}
+		}
+
+		if (length == 0)
+		{
+			offset++;
+			continue;
+		}
+
+		zgfx_write_literals(zgfx, w, &pSrcData[literalStart], offset - literalStart);
+		zgfx_write_match(w, distance, length);
+
+		for (UINT32 x = 1; x < length; x++)
+		{
+			if (offset + x + 3 <= SrcSize)
+				zgfx_hash_insert(zgfx, pSrcData, startIndex, offset + x);
+		}
+
+		offset += length;
+		literalStart = offset;
+
+		if (w->overflow)
+			return FALSE;
+	}
+
+	zgfx_write_literals(zgfx, w, &pSrcData[literalStart], offset - literalStart);
+	return !w->overflow;
+}
+
+static BOOL zgfx_compress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, wStream* WINPR_RESTRICT s,
+                                  const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                  UINT32* WINPR_RESTRICT pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
+	BOOL compressed = FALSE;
+	ZGFX_BIT_WRITER writer = { 0 };
+
+	WINPR_ASSERT(zgfx);
+
 	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
@@ -500,8 +937,55 @@ static BOOL zgfx_compress_segment(WINPR_ATTR_UNUSED ZGFX_CONTEXT* WINPR_RESTRICT
 	}
 
 	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
-	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, *pFlags)); /* header (1 byte) */
-	Stream_Write(s, pSrcData, SrcSize);
+
+	if (zgfx->Compressor && (zgfx->CompressionLevel > ZGFX_COMPRESSION_LEVEL_NONE) &&
+	    (SrcSize > 2))
+	{
+		const UINT32 startIndex = zgfx->HistoryIndex;
+
+		if (zgfx->HistoryPos > UINT32_MAX - zgfx->HistoryBufferSize - 2 * ZGFX_SEGMENTED_MAXSIZE)
+			zgfx_hash_rebase(zgfx);
+
+		/* The decoder appends every segment to its history, compressed or not */
+		zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+
+		/* Compressed data plus the trailing padding byte must be smaller than the raw data */
+		writer.buffer = zgfx->OutputBuffer;
+		writer.capacity = MIN(sizeof(zgfx->OutputBuffer), SrcSize - 2);
+		compressed = zgfx_compress_segment_data(zgfx, &writer, pSrcData, SrcSize, startIndex);
+		zgfx->HistoryPos += SrcSize;
+
+		if (compressed)
+		{
+			const BYTE padding = (BYTE)((8 - writer.count) % 8);
+			zgfx_bits_write(&writer, 0, padding);
+			compressed = !writer.overflow;
+
+			if (compressed)
+				writer.buffer[writer.length++] = padding;
+		}
+	}
+	else if (zgfx->Compressor)
+	{
+		if (zgfx->HistoryPos > UINT32_MAX - zgfx->HistoryBufferSize - 2 * ZGFX_SEGMENTED_MAXSIZE)
+			zgfx_hash_rebase(zgfx);
+
+		zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+		zgfx->HistoryPos += SrcSize;
+	}
+
+	if (compressed)
+	{
+		(*pFlags) |= PACKET_COMPRESSED;
+		Stream_Write_UINT8(s, ZGFX_PACKET_COMPR_TYPE_RDP8 | PACKET_COMPRESSED); /* header */
+		Stream_Write(s, writer.buffer, writer.length);
+	}
+	else
+	{
+		Stream_Write_UINT8(s, ZGFX_PACKET_COMPR_TYPE_RDP8); /* header (1 byte) */
+		Stream_Write(s, pSrcData, SrcSize);
+	}
+
 	return TRUE;
 }
 
@@ -608,9 +1092,78 @@ int zgfx_compress(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT
 	return status;
 }
 
+BOOL zgfx_compress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, wStream* WINPR_RESTRICT sDst,
+                        const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize)
+{
+	UINT32 flags = 0;
+
+	WINPR_ASSERT(zgfx);
+	WINPR_ASSERT(sDst);
+
+	if (!zgfx->Compressor || (SrcSize > ZGFX_SEGMENTED_MAXSIZE))
+		return FALSE;
+
+	return zgfx_compress_segment(zgfx, sDst, pSrcData, SrcSize, &flags);
+}
+
+BOOL zgfx_decompress_bulk(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT pSrcData,
+                          UINT32 SrcSize, wStream* WINPR_RESTRICT sDst)
+{
+	wStream sbuffer = { 0 };
+	wStream* stream = Stream_StaticConstInit(&sbuffer, pSrcData, SrcSize);
+
+	WINPR_ASSERT(zgfx);
+	WINPR_ASSERT(sDst);
+
+	if (!zgfx_decompress_segment(zgfx, stream, SrcSize))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(sDst, zgfx->OutputCount))
+		return FALSE;
+
+	Stream_Write(sDst, zgfx->OutputBuffer, zgfx->OutputCount);
+	return TRUE;
+}
+
+BOOL zgfx_set_history_size(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 size)
+{
+	WINPR_ASSERT(zgfx);
+
+	/* a match must never reach past the history of the peer */
+	if ((size < ZGFX_SEGMENTED_MAXSIZE) || (size > sizeof(zgfx->HistoryBuffer)))
+		return FALSE;
+
+	if (zgfx->Compressor)
+	{
+		UINT32* prev = (UINT32*)realloc(zgfx->HashPrev, size * sizeof(UINT32));
+		if (!prev)
+			return FALSE;
+		zgfx->HashPrev = prev;
+	}
+
+	zgfx->HistoryBufferSize = size;
+	zgfx_context_reset(zgfx, FALSE);
+	return TRUE;
+}
+
+BOOL zgfx_set_compression_level(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 level)
+{
+	WINPR_ASSERT(zgfx);
+
+	if (!zgfx->Compressor || (level > ZGFX_COMPRESSION_LEVEL_MAX))
+		return FALSE;
+
+	zgfx->CompressionLevel = level;
+	return TRUE;
+}
+
 void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, WINPR_ATTR_UNUSED BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+	zgfx->HistoryPos = 0;
+
+	if (zgfx->HashHead)
+		ZeroMemory(zgfx->HashHead, ZGFX_HASH_SIZE * sizeof(UINT32));
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -622,6 +1175,24 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	{
 		zgfx->Compressor = Compressor;
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+
+		if (Compressor)
+		{
+			zgfx->CompressionLevel = ZGFX_COMPRESSION_LEVEL_DEFAULT;
+			zgfx->HashHead = (UINT32*)calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+			zgfx->HashPrev = (UINT32*)calloc(zgfx->HistoryBufferSize, sizeof(UINT32));
+
+			if (!zgfx->HashHead || !zgfx->HashPrev)
+			{
+				zgfx_context_free(zgfx);
+				return NULL;
+			}
+
+			zgfx_init_literal_table(zgfx);
+		}
+
+		zgfx_init_decode_table(zgfx);
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -630,5 +1201,10 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->HashHead);
+	free(zgfx->HashPrev);
 	free(zgfx);
 }
@@ -79,6 +79,9 @@ BOOL freerdp_settings_get_bool(WINPR_ATTR_UNUSED const rdpSettings* settings,
 		case FreeRDP_AsyncChannels:
 			return settings->AsyncChannels;
 
+		case FreeRDP_AsyncTransport:
+			return settings->AsyncTransport;
+
 		case FreeRDP_AsyncUpdate:
 			return settings->AsyncUpdate;
 
@@ -124,6 +127,9 @@ BOOL freerdp_settings_get_bool(WINPR_ATTR_UNUSED const rdpSettings* settings,
 		case FreeRDP_CertificateCallbackPreferPEM:
 			return settings->CertificateCallbackPreferPEM;
 
+		case FreeRDP_CompressionAdaptive:
+			return settings->CompressionAdaptive;
+
 		case FreeRDP_CompressionEnabled:
 			return settings->CompressionEnabled;
 
@@ -271,12 +277,18 @@ BOOL freerdp_settings_get_bool(WINPR_ATTR_UNUSED const rdpSettings* settings,
 		case FreeRDP_GatewayUseSameCredentials:
 			return settings->GatewayUseSameCredentials;
 
+		case FreeRDP_GdiMonitorSurfaces:
+			return settings->GdiMonitorSurfaces;
+
 		case FreeRDP_GfxAVC444:
 			return settings->GfxAVC444;
 
 		case FreeRDP_GfxAVC444v2:
 			return settings->GfxAVC444v2;
 
+		case FreeRDP_GfxClearCodec:
+			return settings->GfxClearCodec;
+
 		case FreeRDP_GfxH264:
 			return settings->GfxH264;
 
@@ -346,6 +358,9 @@ BOOL freerdp_settings_get_bool(WINPR_ATTR_UNUSED const rdpSettings* settings,
 		case FreeRDP_LocalConnection:
 			return settings->LocalConnection;
 
+		case FreeRDP_LocalShmTransport:
+			return settings->LocalShmTransport;
+
 		case FreeRDP_LogonErrors:
 			return settings->LogonErrors;
 
@@ -598,9 +613,18 @@ BOOL freerdp_settings_get_bool(WINPR_ATTR_UNUSED const rdpSettings* settings,
 		case FreeRDP_TcpKeepAlive:
 			return settings->TcpKeepAlive;
 
+		case FreeRDP_TcpLatencyMode:
+			return settings->TcpLatencyMode;
+
+		case FreeRDP_TlsKernelOffload:
+			return settings->TlsKernelOffload;
+
 		case FreeRDP_TlsSecurity:
 			return settings->TlsSecurity;
 
+		case FreeRDP_TlsSessionResumption:
+			return settings->TlsSessionResumption;
+
 		case FreeRDP_ToggleFullscreen:
 			return settings->ToggleFullscreen;
 
@@ -696,6 +720,10 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->AsyncChannels = cnv.c;
 			break;
 
+		case FreeRDP_AsyncTransport:
+			settings->AsyncTransport = cnv.c;
+			break;
+
 		case FreeRDP_AsyncUpdate:
 			settings->AsyncUpdate = cnv.c;
 			break;
@@ -756,6 +784,10 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->CertificateCallbackPreferPEM = cnv.c;
 			break;
 
+		case FreeRDP_CompressionAdaptive:
+			settings->CompressionAdaptive = cnv.c;
+			break;
+
 		case FreeRDP_CompressionEnabled:
 			settings->CompressionEnabled = cnv.c;
 			break;
@@ -952,6 +984,10 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->GatewayUseSameCredentials = cnv.c;
 			break;
 
+		case FreeRDP_GdiMonitorSurfaces:
+			settings->GdiMonitorSurfaces = cnv.c;
+			break;
+
 		case FreeRDP_GfxAVC444:
 			settings->GfxAVC444 = cnv.c;
 			break;
@@ -960,6 +996,10 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->GfxAVC444v2 = cnv.c;
 			break;
 
+		case FreeRDP_GfxClearCodec:
+			settings->GfxClearCodec = cnv.c;
+			break;
+
 		case FreeRDP_GfxH264:
 			settings->GfxH264 = cnv.c;
 			break;
@@ -1052,6 +1092,10 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->LocalConnection = cnv.c;
 			break;
 
+		case FreeRDP_LocalShmTransport:
+			settings->LocalShmTransport = cnv.c;
+			break;
+
 		case FreeRDP_LogonErrors:
 			settings->LogonErrors = cnv.c;
 			break;
@@ -1388,10 +1432,22 @@ BOOL freerdp_settings_set_bool(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->TcpKeepAlive = cnv.c;
 			break;
 
+		case FreeRDP_TcpLatencyMode:
+			settings->TcpLatencyMode = cnv.c;
+			break;
+
+		case FreeRDP_TlsKernelOffload:
+			settings->TlsKernelOffload = cnv.c;
+			break;
+
 		case FreeRDP_TlsSecurity:
 			settings->TlsSecurity = cnv.c;
 			break;
 
+		case FreeRDP_TlsSessionResumption:
+			settings->TlsSessionResumption = cnv.c;
+			break;
+
 		case FreeRDP_ToggleFullscreen:
 			settings->ToggleFullscreen = cnv.c;
 			break;
@@ -1646,6 +1702,9 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_AutoReconnectMaxRetries:
 			return settings->AutoReconnectMaxRetries;
 
+		case FreeRDP_BitmapCacheBudget:
+			return settings->BitmapCacheBudget;
+
 		case FreeRDP_BitmapCacheV2NumCells:
 			return settings->BitmapCacheV2NumCells;
 
@@ -1775,12 +1834,18 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_GatewayUsageMethod:
 			return settings->GatewayUsageMethod;
 
+		case FreeRDP_GfxCacheBudget:
+			return settings->GfxCacheBudget;
+
 		case FreeRDP_GfxCapsFilter:
 			return settings->GfxCapsFilter;
 
 		case FreeRDP_GlyphSupportLevel:
 			return settings->GlyphSupportLevel;
 
+		case FreeRDP_InputCoalesceInterval:
+			return settings->InputCoalesceInterval;
+
 		case FreeRDP_JpegCodecId:
 			return settings->JpegCodecId;
 
@@ -1841,6 +1906,9 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_NegotiationFlags:
 			return settings->NegotiationFlags;
 
+		case FreeRDP_NetworkAutoDetectInterval:
+			return settings->NetworkAutoDetectInterval;
+
 		case FreeRDP_NumMonitorIds:
 			return settings->NumMonitorIds;
 
@@ -1985,6 +2053,9 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_TcpAckTimeout:
 			return settings->TcpAckTimeout;
 
+		case FreeRDP_TcpConnectAttemptDelay:
+			return settings->TcpConnectAttemptDelay;
+
 		case FreeRDP_TcpConnectTimeout:
 			return settings->TcpConnectTimeout;
 
@@ -1997,6 +2068,9 @@ UINT32 freerdp_settings_get_uint32(WINPR_ATTR_UNUSED const rdpSettings* settings
 		case FreeRDP_TcpKeepAliveRetries:
 			return settings->TcpKeepAliveRetries;
 
+		case FreeRDP_TcpNotSentLowat:
+			return settings->TcpNotSentLowat;
+
 		case FreeRDP_ThreadingFlags:
 			return settings->ThreadingFlags;
 
@@ -2056,6 +2130,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->AutoReconnectMaxRetries = cnv.c;
 			break;
 
+		case FreeRDP_BitmapCacheBudget:
+			settings->BitmapCacheBudget = cnv.c;
+			break;
+
 		case FreeRDP_BitmapCacheV2NumCells:
 			settings->BitmapCacheV2NumCells = cnv.c;
 			break;
@@ -2228,6 +2306,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->GatewayUsageMethod = cnv.c;
 			break;
 
+		case FreeRDP_GfxCacheBudget:
+			settings->GfxCacheBudget = cnv.c;
+			break;
+
 		case FreeRDP_GfxCapsFilter:
 			settings->GfxCapsFilter = cnv.c;
 			break;
@@ -2236,6 +2318,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->GlyphSupportLevel = cnv.c;
 			break;
 
+		case FreeRDP_InputCoalesceInterval:
+			settings->InputCoalesceInterval = cnv.c;
+			break;
+
 		case FreeRDP_JpegCodecId:
 			settings->JpegCodecId = cnv.c;
 			break;
@@ -2316,6 +2402,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->NegotiationFlags = cnv.c;
 			break;
 
+		case FreeRDP_NetworkAutoDetectInterval:
+			settings->NetworkAutoDetectInterval = cnv.c;
+			break;
+
 		case FreeRDP_NumMonitorIds:
 			settings->NumMonitorIds = cnv.c;
 			break;
@@ -2506,6 +2596,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->TcpAckTimeout = cnv.c;
 			break;
 
+		case FreeRDP_TcpConnectAttemptDelay:
+			settings->TcpConnectAttemptDelay = cnv.c;
+			break;
+
 		case FreeRDP_TcpConnectTimeout:
 			settings->TcpConnectTimeout = cnv.c;
 			break;
@@ -2522,6 +2616,10 @@ BOOL freerdp_settings_set_uint32(WINPR_ATTR_UNUSED rdpSettings* settings,
 			settings->TcpKeepAliveRetries = cnv.c;
 			break;
 
+		case FreeRDP_TcpNotSentLowat:
+			settings->TcpNotSentLowat = cnv.c;
+			break;
+
 		case FreeRDP_ThreadingFlags:
 			settings->ThreadingFlags = cnv.c;
 			break;
@@ -3007,12 +3105,18 @@ const char* freerdp_settings_get_string(WINPR_ATTR_UNUSED const rdpSettings* set
 		case FreeRDP_TargetNetAddress:
 			return settings->TargetNetAddress;
 
+		case FreeRDP_TcpCongestionControl:
+			return settings->TcpCongestionControl;
+
 		case FreeRDP_TerminalDescriptor:
 			return settings->TerminalDescriptor;
 
 		case FreeRDP_TlsSecretsFile:
 			return settings->TlsSecretsFile;
 
+		case FreeRDP_TlsSessionCacheFile:
+			return settings->TlsSessionCacheFile;
+
 		case FreeRDP_TransportDumpFile:
 			return settings->TransportDumpFile;
 
@@ -3322,12 +3426,18 @@ char* freerdp_settings_get_string_writable(rdpSettings* settings, FreeRDP_Settin
 		case FreeRDP_TargetNetAddress:
 			return settings->TargetNetAddress;
 
+		case FreeRDP_TcpCongestionControl:
+			return settings->TcpCongestionControl;
+
 		case FreeRDP_TerminalDescriptor:
 			return settings->TerminalDescriptor;
 
 		case FreeRDP_TlsSecretsFile:
 			return settings->TlsSecretsFile;
 
+		case FreeRDP_TlsSessionCacheFile:
+			return settings->TlsSessionCacheFile;
+
 		case FreeRDP_TransportDumpFile:
 			return settings->TransportDumpFile;
 
@@ -3648,12 +3758,18 @@ BOOL freerdp_settings_set_string_(WINPR_ATTR_UNUSED rdpSettings* settings,
 		case FreeRDP_TargetNetAddress:
 			return update_string_(&settings->TargetNetAddress, cnv.c, len);
 
+		case FreeRDP_TcpCongestionControl:
+			return update_string_(&settings->TcpCongestionControl, cnv.c, len);
+
 		case FreeRDP_TerminalDescriptor:
 			return update_string_(&settings->TerminalDescriptor, cnv.c, len);
 
 		case FreeRDP_TlsSecretsFile:
 			return update_string_(&settings->TlsSecretsFile, cnv.c, len);
 
+		case FreeRDP_TlsSessionCacheFile:
+			return update_string_(&settings->TlsSessionCacheFile, cnv.c, len);
+
 		case FreeRDP_TransportDumpFile:
 			return update_string_(&settings->TransportDumpFile, cnv.c, len);
 
@@ -3995,12 +4111,19 @@ BOOL freerdp_settings_set_string_copy_(WINPR_ATTR_UNUSED rdpSettings* settings,
 		case FreeRDP_TargetNetAddress:
 			return update_string_copy_(&settings->TargetNetAddress, cnv.cc, len, cleanup);
 
+		case FreeRDP_TcpCongestionControl:
+			return update_string_copy_(&settings->TcpCongestionControl, cnv.cc, len,
+			                           cleanup);
+
 		case FreeRDP_TerminalDescriptor:
 			return update_string_copy_(&settings->TerminalDescriptor, cnv.cc, len, cleanup);
 
 		case FreeRDP_TlsSecretsFile:
 			return update_string_copy_(&settings->TlsSecretsFile, cnv.cc, len, cleanup);
 
+		case FreeRDP_TlsSessionCacheFile:
+			return update_string_copy_(&settings->TlsSessionCacheFile, cnv.cc, len, cleanup);
+
 		case FreeRDP_TransportDumpFile:
 			return update_string_copy_(&settings->TransportDumpFile, cnv.cc, len, cleanup);
 
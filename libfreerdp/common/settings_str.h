@@ -40,6 +40,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_AltSecFrameMarkerSupport, FREERDP_SETTINGS_TYPE_BOOL,
 	  "FreeRDP_AltSecFrameMarkerSupport" },
 	{ FreeRDP_AsyncChannels, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_AsyncChannels" },
+	{ FreeRDP_AsyncTransport, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_AsyncTransport" },
 	{ FreeRDP_AsyncUpdate, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_AsyncUpdate" },
 	{ FreeRDP_AudioCapture, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_AudioCapture" },
 	{ FreeRDP_AudioPlayback, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_AudioPlayback" },
@@ -60,6 +61,7 @@ static const struct settings_str_entry settings_map[] = {
 	  "FreeRDP_BitmapCompressionDisabled" },
 	{ FreeRDP_CertificateCallbackPreferPEM, FREERDP_SETTINGS_TYPE_BOOL,
 	  "FreeRDP_CertificateCallbackPreferPEM" },
+	{ FreeRDP_CompressionAdaptive, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_CompressionAdaptive" },
 	{ FreeRDP_CompressionEnabled, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_CompressionEnabled" },
 	{ FreeRDP_ConnectChildSession, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_ConnectChildSession" },
 	{ FreeRDP_ConsoleSession, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_ConsoleSession" },
@@ -123,8 +125,10 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_GatewayUdpTransport, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GatewayUdpTransport" },
 	{ FreeRDP_GatewayUseSameCredentials, FREERDP_SETTINGS_TYPE_BOOL,
 	  "FreeRDP_GatewayUseSameCredentials" },
+	{ FreeRDP_GdiMonitorSurfaces, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GdiMonitorSurfaces" },
 	{ FreeRDP_GfxAVC444, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxAVC444" },
 	{ FreeRDP_GfxAVC444v2, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxAVC444v2" },
+	{ FreeRDP_GfxClearCodec, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxClearCodec" },
 	{ FreeRDP_GfxH264, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxH264" },
 	{ FreeRDP_GfxPlanar, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxPlanar" },
 	{ FreeRDP_GfxProgressive, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_GfxProgressive" },
@@ -148,6 +152,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_KerberosRdgIsProxy, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_KerberosRdgIsProxy" },
 	{ FreeRDP_ListMonitors, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_ListMonitors" },
 	{ FreeRDP_LocalConnection, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_LocalConnection" },
+	{ FreeRDP_LocalShmTransport, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_LocalShmTransport" },
 	{ FreeRDP_LogonErrors, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_LogonErrors" },
 	{ FreeRDP_LogonNotify, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_LogonNotify" },
 	{ FreeRDP_LongCredentialsSupported, FREERDP_SETTINGS_TYPE_BOOL,
@@ -254,7 +259,10 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_SynchronousStaticChannels, FREERDP_SETTINGS_TYPE_BOOL,
 	  "FreeRDP_SynchronousStaticChannels" },
 	{ FreeRDP_TcpKeepAlive, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TcpKeepAlive" },
+	{ FreeRDP_TcpLatencyMode, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TcpLatencyMode" },
+	{ FreeRDP_TlsKernelOffload, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TlsKernelOffload" },
 	{ FreeRDP_TlsSecurity, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TlsSecurity" },
+	{ FreeRDP_TlsSessionResumption, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TlsSessionResumption" },
 	{ FreeRDP_ToggleFullscreen, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_ToggleFullscreen" },
 	{ FreeRDP_TransportDump, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TransportDump" },
 	{ FreeRDP_TransportDumpReplay, FREERDP_SETTINGS_TYPE_BOOL, "FreeRDP_TransportDumpReplay" },
@@ -293,6 +301,7 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_AuthenticationLevel, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_AuthenticationLevel" },
 	{ FreeRDP_AutoReconnectMaxRetries, FREERDP_SETTINGS_TYPE_UINT32,
 	  "FreeRDP_AutoReconnectMaxRetries" },
+	{ FreeRDP_BitmapCacheBudget, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_BitmapCacheBudget" },
 	{ FreeRDP_BitmapCacheV2NumCells, FREERDP_SETTINGS_TYPE_UINT32,
 	  "FreeRDP_BitmapCacheV2NumCells" },
 	{ FreeRDP_BitmapCacheV3CodecId, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_BitmapCacheV3CodecId" },
@@ -345,8 +354,11 @@ static const struct settings_str_entry settings_map[] = {
 	  "FreeRDP_GatewayCredentialsSource" },
 	{ FreeRDP_GatewayPort, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_GatewayPort" },
 	{ FreeRDP_GatewayUsageMethod, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_GatewayUsageMethod" },
+	{ FreeRDP_GfxCacheBudget, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_GfxCacheBudget" },
 	{ FreeRDP_GfxCapsFilter, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_GfxCapsFilter" },
 	{ FreeRDP_GlyphSupportLevel, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_GlyphSupportLevel" },
+	{ FreeRDP_InputCoalesceInterval, FREERDP_SETTINGS_TYPE_UINT32,
+	  "FreeRDP_InputCoalesceInterval" },
 	{ FreeRDP_JpegCodecId, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_JpegCodecId" },
 	{ FreeRDP_JpegQuality, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_JpegQuality" },
 	{ FreeRDP_KeySpec, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_KeySpec" },
@@ -371,6 +383,8 @@ static const struct settings_str_entry settings_map[] = {
 	  "FreeRDP_NSCodecColorLossLevel" },
 	{ FreeRDP_NSCodecId, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_NSCodecId" },
 	{ FreeRDP_NegotiationFlags, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_NegotiationFlags" },
+	{ FreeRDP_NetworkAutoDetectInterval, FREERDP_SETTINGS_TYPE_UINT32,
+	  "FreeRDP_NetworkAutoDetectInterval" },
 	{ FreeRDP_NumMonitorIds, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_NumMonitorIds" },
 	{ FreeRDP_OffscreenCacheEntries, FREERDP_SETTINGS_TYPE_UINT32,
 	  "FreeRDP_OffscreenCacheEntries" },
@@ -440,10 +454,13 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_TargetNetAddressCount, FREERDP_SETTINGS_TYPE_UINT32,
 	  "FreeRDP_TargetNetAddressCount" },
 	{ FreeRDP_TcpAckTimeout, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpAckTimeout" },
+	{ FreeRDP_TcpConnectAttemptDelay, FREERDP_SETTINGS_TYPE_UINT32,
+	  "FreeRDP_TcpConnectAttemptDelay" },
 	{ FreeRDP_TcpConnectTimeout, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpConnectTimeout" },
 	{ FreeRDP_TcpKeepAliveDelay, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpKeepAliveDelay" },
 	{ FreeRDP_TcpKeepAliveInterval, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpKeepAliveInterval" },
 	{ FreeRDP_TcpKeepAliveRetries, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpKeepAliveRetries" },
+	{ FreeRDP_TcpNotSentLowat, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TcpNotSentLowat" },
 	{ FreeRDP_ThreadingFlags, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_ThreadingFlags" },
 	{ FreeRDP_TlsSecLevel, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_TlsSecLevel" },
 	{ FreeRDP_VCChunkSize, FREERDP_SETTINGS_TYPE_UINT32, "FreeRDP_VCChunkSize" },
@@ -578,8 +595,11 @@ static const struct settings_str_entry settings_map[] = {
 	{ FreeRDP_SmartcardPrivateKey, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_SmartcardPrivateKey" },
 	{ FreeRDP_SspiModule, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_SspiModule" },
 	{ FreeRDP_TargetNetAddress, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_TargetNetAddress" },
+	{ FreeRDP_TcpCongestionControl, FREERDP_SETTINGS_TYPE_STRING,
+	  "FreeRDP_TcpCongestionControl" },
 	{ FreeRDP_TerminalDescriptor, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_TerminalDescriptor" },
 	{ FreeRDP_TlsSecretsFile, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_TlsSecretsFile" },
+	{ FreeRDP_TlsSessionCacheFile, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_TlsSessionCacheFile" },
 	{ FreeRDP_TransportDumpFile, FREERDP_SETTINGS_TYPE_STRING, "FreeRDP_TransportDumpFile" },
 	{ FreeRDP_UserSpecifiedServerName, FREERDP_SETTINGS_TYPE_STRING,
 	  "FreeRDP_UserSpecifiedServerName" },
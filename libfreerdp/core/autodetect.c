@@ -22,7 +22,10 @@
 #include <winpr/crypto.h>
 #include <winpr/assert.h>
 
+#include <freerdp/event.h>
+
 #include "autodetect.h"
+#include "transport.h"
 
 #define TYPE_ID_AUTODETECT_REQUEST 0x00
 #define TYPE_ID_AUTODETECT_RESPONSE 0x01
@@ -129,6 +132,39 @@ static const char* autodetect_request_type_to_string_buffer(UINT32 requestType,
 	return buffer;
 }
 
+static void autodetect_publish_network_characteristics(rdpAutoDetect* autodetect)
+{
+	NetworkCharacteristicsChangeEventArgs e = { 0 };
+
+	WINPR_ASSERT(autodetect);
+	WINPR_ASSERT(autodetect->context);
+
+	WLog_Print(autodetect->log, WLOG_DEBUG,
+	           "network characteristics: bandwidth=%" PRIu32 " kbit/s, baseRTT=%" PRIu32
+	           " ms, averageRTT=%" PRIu32 " ms",
+	           autodetect->netCharBandwidth, autodetect->netCharBaseRTT,
+	           autodetect->netCharAverageRTT);
+
+	EventArgsInit(&e, "freerdp");
+	e.baseRTT = autodetect->netCharBaseRTT;
+	e.averageRTT = autodetect->netCharAverageRTT;
+	e.bandwidth = autodetect->netCharBandwidth;
+	(void)PubSub_OnNetworkCharacteristicsChange(autodetect->context->pubSub, autodetect->context,
+	                                            &e);
+}
+
+/* A growing queue shows in the round trip time before the socket blocks */
+static BOOL autodetect_link_congested(rdpAutoDetect* autodetect)
+{
+	WINPR_ASSERT(autodetect);
+	WINPR_ASSERT(autodetect->context);
+
+	if (transport_is_write_blocked(autodetect->context->rdp->transport))
+		return TRUE;
+
+	return autodetect->netCharAverageRTT > 2ull * autodetect->netCharBaseRTT + 10ull;
+}
+
 static BOOL autodetect_send_rtt_measure_request(rdpAutoDetect* autodetect,
                                                 WINPR_ATTR_UNUSED RDP_TRANSPORT_TYPE transport,
                                                 UINT16 sequenceNumber)
@@ -493,12 +529,17 @@ static BOOL autodetect_recv_rtt_measure_response(rdpAutoDetect* autodetect,
 	}
 
 	WLog_Print(autodetect->log, WLOG_TRACE, "received RTT Measure Response PDU");
-	autodetect->netCharAverageRTT =
-	    (UINT32)MIN(GetTickCount64() - autodetect->rttMeasureStartTime, UINT32_MAX);
+	const UINT32 rtt = (UINT32)MIN(GetTickCount64() - autodetect->rttMeasureStartTime, UINT32_MAX);
+
+	/* smoothed like the TCP retransmission timer, RFC 6298 */
+	if (autodetect->netCharAverageRTT == 0)
+		autodetect->netCharAverageRTT = rtt;
+	else
+		autodetect->netCharAverageRTT =
+		    (UINT32)((7ull * autodetect->netCharAverageRTT + rtt) / 8ull);
 
-	if (autodetect->netCharBaseRTT == 0 ||
-	    autodetect->netCharBaseRTT > autodetect->netCharAverageRTT)
-		autodetect->netCharBaseRTT = autodetect->netCharAverageRTT;
+	if (autodetect->netCharBaseRTT == 0 || autodetect->netCharBaseRTT > rtt)
+		autodetect->netCharBaseRTT = rtt;
 
 	IFCALLRET(autodetect->RTTMeasureResponse, success, autodetect, transport,
 	          autodetectRspPdu->sequenceNumber);
@@ -662,6 +703,32 @@ static BOOL autodetect_recv_bandwidth_measure_results(rdpAutoDetect* autodetect,
 	Stream_Read_UINT32(s, timeDelta); /* timeDelta (4 bytes) */
 	Stream_Read_UINT32(s, byteCount); /* byteCount (4 bytes) */
 
+	/* kbit/s, the time delta is in milliseconds */
+	if (timeDelta > 0)
+	{
+		const UINT32 bandwidth = (UINT32)MIN(8ull * byteCount / timeDelta, UINT32_MAX);
+
+		const UINT32 last = autodetect->netCharBandwidth;
+
+		/* A continuous measurement only sees the traffic we had to send, that is the capacity
+		 * of the link only if it was congested. Otherwise probe for more, like TCP does. */
+		if (autodetectRspPdu->responseType == RDP_BW_RESULTS_RESPONSE_TYPE_CONNECTTIME)
+			autodetect->netCharBandwidth = bandwidth;
+		else if (autodetect_link_congested(autodetect))
+		{
+			if ((last == 0) || (bandwidth > last))
+				autodetect->netCharBandwidth = bandwidth;
+			else
+				autodetect->netCharBandwidth = (UINT32)((3ull * last + bandwidth) / 4ull);
+		}
+		else if (last != 0)
+			autodetect->netCharBandwidth =
+			    (UINT32)MIN(MAX(bandwidth, last + last / 8ull), UINT32_MAX);
+
+		if (autodetect->netCharBandwidth != last)
+			autodetect_publish_network_characteristics(autodetect);
+	}
+
 	IFCALLRET(autodetect->BandwidthMeasureResults, success, autodetect, transport,
 	          autodetectRspPdu->sequenceNumber, autodetectRspPdu->responseType, timeDelta,
 	          byteCount);
@@ -700,6 +767,10 @@ static BOOL autodetect_recv_netchar_sync(rdpAutoDetect* autodetect, RDP_TRANSPOR
 	           "",
 	           bandwidth, rtt);
 
+	autodetect->netCharBandwidth = bandwidth;
+	autodetect->netCharAverageRTT = rtt;
+	autodetect_publish_network_characteristics(autodetect);
+
 	IFCALLRET(autodetect->NetworkCharacteristicsSync, success, autodetect, transport,
 	          autodetectRspPdu->sequenceNumber, bandwidth, rtt);
 	if (!success)
@@ -784,6 +855,16 @@ static BOOL autodetect_recv_netchar_request(rdpAutoDetect* autodetect, RDP_TRANS
 	           ", bandwidth=%" PRIu32 ", averageRTT=%" PRIu32 "",
 	           result.baseRTT, result.bandwidth, result.averageRTT);
 
+	if (result.type != RDP_NETCHAR_RESULT_TYPE_BW_AVG_RTT)
+		autodetect->netCharBaseRTT = result.baseRTT;
+	if (result.type != RDP_NETCHAR_RESULT_TYPE_BASE_RTT_AVG_RTT)
+		autodetect->netCharBandwidth = result.bandwidth;
+	if (result.type != RDP_NETCHAR_RESERVED)
+	{
+		autodetect->netCharAverageRTT = result.averageRTT;
+		autodetect_publish_network_characteristics(autodetect);
+	}
+
 	IFCALLRET(autodetect->NetworkCharacteristicsResult, success, autodetect, transport,
 	          autodetectReqPdu->sequenceNumber, &result);
 	if (!success)
@@ -1072,6 +1153,72 @@ void autodetect_register_server_callbacks(rdpAutoDetect* autodetect)
 	    autodetect_on_connect_time_auto_detect_progress_default;
 }
 
+static uint64_t autodetect_continuous_timer(rdpContext* context, void* userdata,
+                                            WINPR_ATTR_UNUSED FreeRDP_TimerID timerID,
+                                            WINPR_ATTR_UNUSED uint64_t timestamp,
+                                            uint64_t interval)
+{
+	rdpAutoDetect* autodetect = userdata;
+	WINPR_ASSERT(autodetect);
+
+	/* paused during a deactivation-reactivation sequence */
+	if (freerdp_get_state(context) != CONNECTION_STATE_ACTIVE)
+		return interval;
+
+	WINPR_ASSERT(autodetect->RTTMeasureRequest);
+	WINPR_ASSERT(autodetect->BandwidthMeasureStart);
+	WINPR_ASSERT(autodetect->BandwidthMeasureStop);
+
+	/* every other tick closes the bandwidth measurement started by the previous one */
+	const UINT16 sequenceNumber = autodetect->continuousSequence++;
+	BOOL rc = FALSE;
+	if (autodetect->continuousStarted)
+		rc = autodetect->BandwidthMeasureStop(autodetect, RDP_TRANSPORT_TCP, sequenceNumber, 0);
+	else
+		rc = autodetect->RTTMeasureRequest(autodetect, RDP_TRANSPORT_TCP, sequenceNumber) &&
+		     autodetect->BandwidthMeasureStart(autodetect, RDP_TRANSPORT_TCP, sequenceNumber);
+
+	if (!rc)
+	{
+		WLog_Print(autodetect->log, WLOG_WARN, "continuous auto-detection failed, stopping");
+		autodetect->continuousTimer = 0;
+		return 0;
+	}
+
+	autodetect->continuousStarted = !autodetect->continuousStarted;
+	return interval;
+}
+
+BOOL autodetect_start_continuous(rdpAutoDetect* autodetect)
+{
+	WINPR_ASSERT(autodetect);
+	WINPR_ASSERT(autodetect->context);
+
+	const rdpSettings* settings = autodetect->context->settings;
+	WINPR_ASSERT(settings);
+
+	const UINT32 interval =
+	    freerdp_settings_get_uint32(settings, FreeRDP_NetworkAutoDetectInterval);
+	if ((interval == 0) || !freerdp_settings_get_bool(settings, FreeRDP_NetworkAutoDetect))
+		return TRUE;
+	if (autodetect->continuousTimer != 0)
+		return TRUE;
+
+	autodetect->continuousStarted = FALSE;
+	autodetect->continuousTimer =
+	    freerdp_timer_add(autodetect->context, 1000000ull * interval, autodetect_continuous_timer,
+	                      autodetect, true);
+	if (autodetect->continuousTimer == 0)
+	{
+		WLog_Print(autodetect->log, WLOG_ERROR, "failed to start continuous auto-detection");
+		return FALSE;
+	}
+
+	WLog_Print(autodetect->log, WLOG_DEBUG,
+	           "continuous auto-detection every %" PRIu32 " ms", interval);
+	return TRUE;
+}
+
 FREERDP_AUTODETECT_STATE autodetect_get_state(rdpAutoDetect* autodetect)
 {
 	WINPR_ASSERT(autodetect);
@@ -1084,3 +1231,30 @@ rdpAutoDetect* autodetect_get(rdpContext* context)
 	WINPR_ASSERT(context->rdp);
 	return context->rdp->autodetect;
 }
+
+BOOL freerdp_autodetect_get_network_characteristics(rdpContext* context,
+                                                    rdpNetworkCharacteristicsResult* result)
+{
+	WINPR_ASSERT(result);
+
+	const rdpNetworkCharacteristicsResult empty = { 0 };
+	*result = empty;
+
+	rdpAutoDetect* autodetect = autodetect_get(context);
+	if (!autodetect)
+		return FALSE;
+
+	result->baseRTT = autodetect->netCharBaseRTT;
+	result->averageRTT = autodetect->netCharAverageRTT;
+	result->bandwidth = autodetect->netCharBandwidth;
+
+	if ((result->bandwidth != 0) && (result->baseRTT != 0))
+		result->type = RDP_NETCHAR_RESULT_TYPE_BASE_RTT_BW_AVG_RTT;
+	else if (result->bandwidth != 0)
+		result->type = RDP_NETCHAR_RESULT_TYPE_BW_AVG_RTT;
+	else if (result->averageRTT != 0)
+		result->type = RDP_NETCHAR_RESULT_TYPE_BASE_RTT_AVG_RTT;
+	else
+		return FALSE;
+	return TRUE;
+}
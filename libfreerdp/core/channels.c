@@ -47,6 +47,7 @@
 #include "client.h"
 #include "server.h"
 #include "channels.h"
+#include "metrics.h"
 
 #define TAG FREERDP_TAG("core.channels")
 
@@ -144,8 +145,11 @@ BOOL freerdp_channel_process(freerdp* instance, wStream* s, UINT16 channelId, si
 		return FALSE;
 	}
 
+	WINPR_ASSERT(instance->context);
+	metrics_channel_record(instance->context->metrics, channelId, FALSE, chunkLength);
 	IFCALLRET(instance->ReceiveChannelData, rc, instance, channelId, Stream_Pointer(s), chunkLength,
 	          flags, length);
+	winpr_Arena_Reset(instance->context->channelArena);
 	if (!rc)
 	{
 		WLog_WARN(TAG, "ReceiveChannelData returned %d", rc);
@@ -172,6 +176,9 @@ BOOL freerdp_channel_peer_process(freerdp_peer* client, wStream* s, UINT16 chann
 	if (chunkLength > UINT32_MAX)
 		return FALSE;
 
+	WINPR_ASSERT(client->context);
+	metrics_channel_record(client->context->metrics, channelId, FALSE, chunkLength);
+
 	if (client->VirtualChannelRead)
 	{
 		int rc = 0;
@@ -196,6 +203,7 @@ BOOL freerdp_channel_peer_process(freerdp_peer* client, wStream* s, UINT16 chann
 			return FALSE;
 
 		rc = client->VirtualChannelRead(client, hChannel, Stream_Pointer(s), (UINT32)chunkLength);
+		winpr_Arena_Reset(context->channelArena);
 		if (rc < 0)
 			return FALSE;
 	}
@@ -203,6 +211,7 @@ BOOL freerdp_channel_peer_process(freerdp_peer* client, wStream* s, UINT16 chann
 	{
 		BOOL rc = client->ReceiveChannelData(client, channelId, Stream_Pointer(s),
 		                                     (UINT32)chunkLength, flags, length);
+		winpr_Arena_Reset(client->context->channelArena);
 		if (!rc)
 			return FALSE;
 	}
@@ -317,5 +326,7 @@ BOOL freerdp_channel_send_packet(rdpRdp* rdp, UINT16 channelId, size_t totalSize
 	Stream_Write(s, data, chunkSize);
 
 	/* WLog_DBG(TAG, "sending data (flags=0x%x size=%d)",  flags, size); */
+	WINPR_ASSERT(rdp->context);
+	metrics_channel_record(rdp->context->metrics, channelId, TRUE, chunkSize);
 	return rdp_send(rdp, s, channelId, sec_flags);
 }
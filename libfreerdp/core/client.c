@@ -30,6 +30,7 @@
 
 #include "rdp.h"
 #include "client.h"
+#include "metrics.h"
 
 #define TAG FREERDP_TAG("core.client")
 
@@ -693,6 +694,12 @@ static BOOL freerdp_channels_process_sync(rdpChannels* channels, freerdp* instan
 	wMessage message = { 0 };
 
 	WINPR_ASSERT(channels);
+	WINPR_ASSERT(instance);
+	WINPR_ASSERT(instance->context);
+
+	/* the backlog the channel threads built up since the last run of the main loop */
+	(void)metrics_record(instance->context->metrics, METRICS_CHANNEL_QUEUE_DEPTH,
+	                     MessageQueue_Size(channels->queue));
 
 	while (MessageQueue_Peek(channels->queue, &message, TRUE))
 	{
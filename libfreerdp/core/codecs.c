@@ -96,10 +96,13 @@ static void codecs_free_int(rdpCodecs* codecs, UINT32 flags)
 		}
 	}
 }
+/* Contexts that already exist are reset in place by freerdp_client_codecs_reset, so
+ * reconnects, redirects and resizes keep their buffers, thread pools and decoder sessions. */
 BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width, UINT32 height)
 {
-	codecs_free_int(codecs, flags);
-	if ((flags & FREERDP_CODEC_INTERLEAVED))
+	WINPR_ASSERT(codecs);
+
+	if ((flags & FREERDP_CODEC_INTERLEAVED) && !codecs->interleaved)
 	{
 		if (!(codecs->interleaved = bitmap_interleaved_context_new(FALSE)))
 		{
@@ -108,7 +111,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 		}
 	}
 
-	if ((flags & FREERDP_CODEC_PLANAR))
+	if ((flags & FREERDP_CODEC_PLANAR) && !codecs->planar)
 	{
 		if (!(codecs->planar = freerdp_bitmap_planar_context_new(0, 64, 64)))
 		{
@@ -117,7 +120,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 		}
 	}
 
-	if ((flags & FREERDP_CODEC_NSCODEC))
+	if ((flags & FREERDP_CODEC_NSCODEC) && !codecs->nsc)
 	{
 		if (!(codecs->nsc = nsc_context_new()))
 		{
@@ -126,7 +129,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 		}
 	}
 
-	if ((flags & FREERDP_CODEC_REMOTEFX))
+	if ((flags & FREERDP_CODEC_REMOTEFX) && !codecs->rfx)
 	{
 		if (!(codecs->rfx = rfx_context_new_ex(FALSE, codecs->ThreadingFlags)))
 		{
@@ -135,7 +138,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 		}
 	}
 
-	if ((flags & FREERDP_CODEC_CLEARCODEC))
+	if ((flags & FREERDP_CODEC_CLEARCODEC) && !codecs->clear)
 	{
 		if (!(codecs->clear = clear_context_new(FALSE)))
 		{
@@ -148,7 +151,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 	{
 	}
 
-	if ((flags & FREERDP_CODEC_PROGRESSIVE))
+	if ((flags & FREERDP_CODEC_PROGRESSIVE) && !codecs->progressive)
 	{
 		if (!(codecs->progressive = progressive_context_new_ex(FALSE, codecs->ThreadingFlags)))
 		{
@@ -158,7 +161,7 @@ BOOL freerdp_client_codecs_prepare(rdpCodecs* codecs, UINT32 flags, UINT32 width
 	}
 
 #ifdef WITH_GFX_H264
-	if ((flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444)))
+	if ((flags & (FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444)) && !codecs->h264)
 	{
 		if (!(codecs->h264 = h264_context_new(FALSE)))
 		{
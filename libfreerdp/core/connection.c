@@ -208,8 +208,15 @@ static BOOL rdp_client_reset_codecs(rdpContext* context)
 	if (!freerdp_settings_get_bool(settings, FreeRDP_DeactivateClientDecoding))
 	{
 		const UINT32 flags = freerdp_settings_get_uint32(settings, FreeRDP_ThreadingFlags);
-		freerdp_client_codecs_free(context->codecs);
-		context->codecs = freerdp_client_codecs_new(flags);
+
+		/* keep the codecs of a previous connection, they are reset for the new one */
+		if (context->codecs && (context->codecs->ThreadingFlags != flags))
+		{
+			freerdp_client_codecs_free(context->codecs);
+			context->codecs = NULL;
+		}
+		if (!context->codecs)
+			context->codecs = freerdp_client_codecs_new(flags);
 
 		if (!context->codecs)
 			return FALSE;
@@ -312,6 +319,7 @@ BOOL rdp_client_connect(rdpRdp* rdp)
 	settings = rdp->settings;
 	WINPR_ASSERT(settings);
 
+	rdp_timeline_reset(rdp);
 	if (!rdp_client_reset_codecs(rdp->context))
 		return FALSE;
 
@@ -2095,7 +2103,17 @@ CONNECTION_STATE rdp_get_state(const rdpRdp* rdp)
 BOOL rdp_set_state(rdpRdp* rdp, CONNECTION_STATE state)
 {
 	WINPR_ASSERT(rdp);
+	if (state == rdp->state)
+		return TRUE;
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	rdp_timeline_add(rdp, rdp_state_string(rdp->state), rdp->stateStart);
+	rdp->stateStart = now;
 	rdp->state = state;
+
+	if ((state == CONNECTION_STATE_ACTIVE) &&
+	    !rdp_finalize_is_flag_set(rdp, FINALIZE_DEACTIVATE_REACTIVATE))
+		rdp_timeline_log(rdp);
 	return TRUE;
 }
 
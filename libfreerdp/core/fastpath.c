@@ -35,6 +35,7 @@
 #include <freerdp/api.h>
 #include <freerdp/log.h>
 #include <freerdp/crypto/per.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include "orders.h"
 #include "update.h"
@@ -294,7 +295,7 @@ static BOOL fastpath_recv_update_common(rdpFastPath* fastpath, wStream* s)
 
 	context = update->context;
 
-	defaultReturn = freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding);
+	defaultReturn = context->settings->DeactivateClientDecoding;
 
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, 2))
 		return FALSE;
@@ -353,9 +354,6 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	if (!fastpath || !fastpath->rdp || !s)
 		return -1;
 
-	Stream_SealLength(s);
-	Stream_SetPosition(s, 0);
-
 	rdpUpdate* update = fastpath->rdp->update;
 
 	if (!update || !update->pointer || !update->context)
@@ -367,13 +365,32 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	rdpPointerUpdate* pointer = update->pointer;
 	WINPR_ASSERT(pointer);
 
+	FREERDP_TRACEPOINT(fastpath_update, 0, updateCode);
+
 #ifdef WITH_DEBUG_RDP
 	DEBUG_RDP(fastpath->rdp, "recv Fast-Path %s Update (0x%02" PRIX8 "), length:%" PRIuz "",
 	          fastpath_update_to_string(updateCode), updateCode, Stream_GetRemainingLength(s));
 #endif
 
-	const BOOL defaultReturn =
-	    freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding);
+	if (update->FastPathUpdate)
+	{
+		BOOL handled = FALSE;
+		const size_t pos = Stream_GetPosition(s);
+
+		if (!update->FastPathUpdate(context, updateCode, s, &handled))
+		{
+			WLog_ERR(TAG, "Fastpath update %s [%" PRIx8 "] hook failed",
+			         fastpath_update_to_string(updateCode), updateCode);
+			return -1;
+		}
+
+		if (handled)
+			return 0;
+
+		Stream_SetPosition(s, pos);
+	}
+
+	const BOOL defaultReturn = context->settings->DeactivateClientDecoding;
 	switch (updateCode)
 	{
 		case FASTPATH_UPDATETYPE_ORDERS:
@@ -478,7 +495,6 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			break;
 	}
 
-	Stream_SetPosition(s, 0);
 	if (!rc)
 	{
 		WLog_ERR(TAG, "Fastpath update %s [%" PRIx8 "] failed, status %d",
@@ -544,11 +560,6 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 		return -1;
 	}
 
-	if (!Stream_EnsureRemainingCapacity(fastpath->updateData, DstSize))
-		return -1;
-
-	Stream_Write(fastpath->updateData, pDstData, DstSize);
-
 	if (fragmentation == FASTPATH_FRAGMENT_SINGLE)
 	{
 		if (fastpath->fragmentation != -1)
@@ -557,7 +568,11 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			goto out_fail;
 		}
 
-		status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
+		/* Parse in place, the data is either part of the received PDU or in the bulk
+		 * decompression history, both untouched until the next update is read. */
+		wStream sbuffer = { 0 };
+		wStream* us = Stream_StaticConstInit(&sbuffer, pDstData, DstSize);
+		status = fastpath_recv_update(fastpath, updateCode, us);
 
 		if (status < 0)
 		{
@@ -568,7 +583,7 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 	else
 	{
 		rdpContext* context = NULL;
-		const size_t totalSize = Stream_GetPosition(fastpath->updateData);
+		const size_t totalSize = Stream_GetPosition(fastpath->updateData) + DstSize;
 
 		context = transport_get_context(transport);
 		WINPR_ASSERT(context);
@@ -612,7 +627,19 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			}
 
 			fastpath->fragmentation = -1;
+		}
+
+		/* The decompressors emit into their history buffer, so every fragment is copied once */
+		if (!Stream_EnsureRemainingCapacity(fastpath->updateData, DstSize))
+			goto out_fail;
+		Stream_Write(fastpath->updateData, pDstData, DstSize);
+
+		if (fragmentation == FASTPATH_FRAGMENT_LAST)
+		{
+			Stream_SealLength(fastpath->updateData);
+			Stream_SetPosition(fastpath->updateData, 0);
 			status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
+			Stream_SetPosition(fastpath->updateData, 0);
 
 			if (status < 0)
 			{
@@ -716,14 +743,15 @@ static BOOL fastpath_recv_input_event_mouse(rdpFastPath* fastpath, wStream* s,
 	WINPR_ASSERT(fastpath->rdp->input);
 	WINPR_ASSERT(s);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 6))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 6, &span))
 		return FALSE;
 
 	input = fastpath->rdp->input;
 
-	Stream_Read_UINT16(s, pointerFlags); /* pointerFlags (2 bytes) */
-	Stream_Read_UINT16(s, xPos);         /* xPos (2 bytes) */
-	Stream_Read_UINT16(s, yPos);         /* yPos (2 bytes) */
+	pointerFlags = StreamSpan_Get_UINT16(&span); /* pointerFlags (2 bytes) */
+	xPos = StreamSpan_Get_UINT16(&span);         /* xPos (2 bytes) */
+	yPos = StreamSpan_Get_UINT16(&span);         /* yPos (2 bytes) */
 	return IFCALLRESULT(TRUE, input->MouseEvent, input, pointerFlags, xPos, yPos);
 }
 
@@ -740,16 +768,17 @@ static BOOL fastpath_recv_input_event_relmouse(rdpFastPath* fastpath, wStream* s
 	WINPR_ASSERT(fastpath->rdp->input);
 	WINPR_ASSERT(s);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 6))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 6, &span))
 		return FALSE;
 
 	input = fastpath->rdp->input;
 
-	Stream_Read_UINT16(s, pointerFlags); /* pointerFlags (2 bytes) */
-	Stream_Read_INT16(s, xDelta);        /* xDelta (2 bytes) */
-	Stream_Read_INT16(s, yDelta);        /* yDelta (2 bytes) */
+	pointerFlags = StreamSpan_Get_UINT16(&span); /* pointerFlags (2 bytes) */
+	xDelta = StreamSpan_Get_INT16(&span);        /* xDelta (2 bytes) */
+	yDelta = StreamSpan_Get_INT16(&span);        /* yDelta (2 bytes) */
 
-	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_HasRelativeMouseEvent))
+	if (!input->context->settings->HasRelativeMouseEvent)
 	{
 		WLog_ERR(TAG,
 		         "Received relative mouse event(flags=0x%04" PRIx16 ", xPos=%" PRId16
@@ -778,7 +807,7 @@ static BOOL fastpath_recv_input_event_qoe(rdpFastPath* fastpath, wStream* s,
 	UINT32 timestampMS = 0;
 	Stream_Read_UINT32(s, timestampMS); /* timestamp (4 bytes) */
 
-	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_HasQoeEvent))
+	if (!input->context->settings->HasQoeEvent)
 	{
 		WLog_ERR(TAG,
 		         "Received qoe event(timestamp=%" PRIu32
@@ -804,16 +833,17 @@ static BOOL fastpath_recv_input_event_mousex(rdpFastPath* fastpath, wStream* s,
 	WINPR_ASSERT(fastpath->rdp->input);
 	WINPR_ASSERT(s);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 6))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 6, &span))
 		return FALSE;
 
 	input = fastpath->rdp->input;
 
-	Stream_Read_UINT16(s, pointerFlags); /* pointerFlags (2 bytes) */
-	Stream_Read_UINT16(s, xPos);         /* xPos (2 bytes) */
-	Stream_Read_UINT16(s, yPos);         /* yPos (2 bytes) */
+	pointerFlags = StreamSpan_Get_UINT16(&span); /* pointerFlags (2 bytes) */
+	xPos = StreamSpan_Get_UINT16(&span);         /* xPos (2 bytes) */
+	yPos = StreamSpan_Get_UINT16(&span);         /* yPos (2 bytes) */
 
-	if (!freerdp_settings_get_bool(input->context->settings, FreeRDP_HasExtendedMouseEvent))
+	if (!input->context->settings->HasExtendedMouseEvent)
 	{
 		WLog_ERR(TAG,
 		         "Received extended mouse event(flags=0x%04" PRIx16 ", xPos=%" PRIu16
@@ -1134,7 +1164,7 @@ BOOL fastpath_send_multiple_input_pdu(rdpFastPath* fastpath, wStream* s, size_t
 	Stream_SetPosition(s, length);
 	Stream_SealLength(s);
 
-	if (transport_write(rdp->transport, s) < 0)
+	if (transport_write_priority(rdp->transport, s, TRANSPORT_PRIORITY_HIGH) < 0)
 		goto fail;
 
 	rc = TRUE;
@@ -1311,6 +1341,18 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 		if (!fastpath_write_update_header(fs, &fpUpdateHeader))
 			return FALSE;
 
+		/* unencrypted payloads are sent from where they are, without a copy */
+		if (!(sec_flags & SEC_ENCRYPT) && (DstSize >= FASTPATH_WRITE_VEC_MIN_SIZE))
+		{
+			const rdpTransportBuffer buffers[] = { { Stream_Buffer(fs), Stream_GetPosition(fs) },
+				                                   { pDstData, DstSize } };
+			if (transport_write_vec(rdp->transport, buffers, ARRAYSIZE(buffers)) < 0)
+				return FALSE;
+
+			Stream_Seek(s, SrcSize);
+			continue;
+		}
+
 		if (!Stream_CheckAndLogRequiredCapacity(TAG, (fs), (size_t)DstSize + pad))
 			return FALSE;
 		Stream_Write(fs, pDstData, DstSize);
@@ -1371,6 +1413,130 @@ BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s
 	return status;
 }
 
+/* gathers the buffers for the paths that compress or encrypt the update */
+static BOOL fastpath_send_update_pdu_copy(rdpFastPath* fastpath, BYTE updateCode,
+                                          const rdpTransportBuffer* buffers, size_t count,
+                                          size_t length, BOOL skipCompression)
+{
+	wStream* s = fastpath_update_pdu_init(fastpath);
+	if (!s)
+		return FALSE;
+
+	BOOL rc = Stream_EnsureRemainingCapacity(s, length);
+	for (size_t x = 0; rc && (x < count); x++)
+		Stream_Write(s, buffers[x].data, buffers[x].length);
+
+	if (rc)
+		rc = fastpath_send_update_pdu(fastpath, updateCode, s, skipCompression);
+	Stream_Release(s);
+	return rc;
+}
+
+BOOL fastpath_send_update_pdu_vec(rdpFastPath* fastpath, BYTE updateCode,
+                                  const rdpTransportBuffer* buffers, size_t count,
+                                  BOOL skipCompression)
+{
+	if (!fastpath || !fastpath->rdp || !fastpath->fs || (!buffers && (count > 0)))
+		return FALSE;
+
+	rdpRdp* rdp = fastpath->rdp;
+	wStream* fs = fastpath->fs;
+	const rdpSettings* settings = rdp->settings;
+
+	if (!settings)
+		return FALSE;
+
+	size_t totalLength = 0;
+	for (size_t x = 0; x < count; x++)
+		totalLength += buffers[x].length;
+
+	if (rdp->do_crypt || (settings->CompressionEnabled && !skipCompression) ||
+	    (count > FASTPATH_UPDATE_MAX_BUFFERS))
+		return fastpath_send_update_pdu_copy(fastpath, updateCode, buffers, count, totalLength,
+		                                     skipCompression);
+
+	/* check if fast path output is possible */
+	if (!settings->FastPathOutput)
+	{
+		WLog_ERR(TAG, "client does not support fast path output");
+		return FALSE;
+	}
+
+	/* check if the client's fast path pdu buffer is large enough */
+	if (totalLength > settings->MultifragMaxRequestSize)
+	{
+		WLog_ERR(TAG,
+		         "fast path update size (%" PRIuz
+		         ") exceeds the client's maximum request size (%" PRIu32 ")",
+		         totalLength, settings->MultifragMaxRequestSize);
+		return FALSE;
+	}
+
+	const size_t maxLength = FASTPATH_MAX_PACKET_SIZE - 20;
+	size_t index = 0;
+	size_t offset = 0;
+
+	for (int fragment = 0; (totalLength > 0) || (fragment == 0); fragment++)
+	{
+		FASTPATH_UPDATE_PDU_HEADER fpUpdatePduHeader = { 0 };
+		FASTPATH_UPDATE_HEADER fpUpdateHeader = { 0 };
+		rdpTransportBuffer out[FASTPATH_UPDATE_MAX_BUFFERS + 1] = { 0 };
+		size_t nout = 1;
+
+		const size_t size = MIN(totalLength, maxLength);
+		totalLength -= size;
+
+		fpUpdateHeader.updateCode = updateCode;
+		fpUpdateHeader.size = (UINT16)size;
+		if (totalLength == 0)
+			fpUpdateHeader.fragmentation =
+			    (fragment == 0) ? FASTPATH_FRAGMENT_SINGLE : FASTPATH_FRAGMENT_LAST;
+		else
+			fpUpdateHeader.fragmentation =
+			    (fragment == 0) ? FASTPATH_FRAGMENT_FIRST : FASTPATH_FRAGMENT_NEXT;
+
+		fpUpdatePduHeader.length =
+		    (UINT16)(size + fastpath_get_update_header_size(&fpUpdateHeader) +
+		             fastpath_get_update_pdu_header_size(&fpUpdatePduHeader, rdp));
+
+		Stream_SetPosition(fs, 0);
+		if (!fastpath_write_update_pdu_header(fs, &fpUpdatePduHeader, rdp))
+			return FALSE;
+		if (!fastpath_write_update_header(fs, &fpUpdateHeader))
+			return FALSE;
+		out[0].data = Stream_Buffer(fs);
+		out[0].length = Stream_GetPosition(fs);
+
+		/* the fragment references the slices of the buffers it spans */
+		for (size_t remaining = size; remaining > 0;)
+		{
+			const rdpTransportBuffer* cur = &buffers[index];
+			const size_t length = MIN(remaining, cur->length - offset);
+
+			if (length > 0)
+			{
+				WINPR_ASSERT(nout < ARRAYSIZE(out));
+				out[nout].data = &cur->data[offset];
+				out[nout].length = length;
+				nout++;
+			}
+
+			remaining -= length;
+			offset += length;
+			if (offset == cur->length)
+			{
+				index++;
+				offset = 0;
+			}
+		}
+
+		if (transport_write_vec(rdp->transport, out, nout) < 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 rdpFastPath* fastpath_new(rdpRdp* rdp)
 {
 	rdpFastPath* fastpath = NULL;
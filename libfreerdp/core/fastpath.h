@@ -28,6 +28,12 @@
  */
 #define FASTPATH_MAX_PACKET_SIZE 0x3FFF
 
+/* smaller updates are cheaper to copy than to write (and encrypt with TLS) separately */
+#define FASTPATH_WRITE_VEC_MIN_SIZE 1024
+
+/* upper bound of the buffers an update given to fastpath_send_update_pdu_vec consists of */
+#define FASTPATH_UPDATE_MAX_BUFFERS 4
+
 /*
  *  The following size guarantees that no fast-path PDU fragmentation occurs.
  *  It was calculated by subtracting 128 from FASTPATH_MAX_PACKET_SIZE.
@@ -55,22 +61,6 @@ enum FASTPATH_OUTPUT_ACTION_TYPE
 	FASTPATH_OUTPUT_ACTION_X224 = 0x3
 };
 
-enum FASTPATH_UPDATETYPE
-{
-	FASTPATH_UPDATETYPE_ORDERS = 0x0,
-	FASTPATH_UPDATETYPE_BITMAP = 0x1,
-	FASTPATH_UPDATETYPE_PALETTE = 0x2,
-	FASTPATH_UPDATETYPE_SYNCHRONIZE = 0x3,
-	FASTPATH_UPDATETYPE_SURFCMDS = 0x4,
-	FASTPATH_UPDATETYPE_PTR_NULL = 0x5,
-	FASTPATH_UPDATETYPE_PTR_DEFAULT = 0x6,
-	FASTPATH_UPDATETYPE_PTR_POSITION = 0x8,
-	FASTPATH_UPDATETYPE_COLOR = 0x9,
-	FASTPATH_UPDATETYPE_CACHED = 0xA,
-	FASTPATH_UPDATETYPE_POINTER = 0xB,
-	FASTPATH_UPDATETYPE_LARGE_POINTER = 0xC
-};
-
 enum FASTPATH_FRAGMENT
 {
 	FASTPATH_FRAGMENT_SINGLE = 0x0,
@@ -147,6 +137,13 @@ FREERDP_LOCAL wStream* fastpath_update_pdu_init_new(rdpFastPath* fastpath);
 FREERDP_LOCAL BOOL fastpath_send_update_pdu(rdpFastPath* fastpath, BYTE updateCode, wStream* s,
                                             BOOL skipCompression);
 
+/** Sends an update given as a list of buffers. Unless the update is compressed or encrypted the
+ *  fragments are written from the buffers directly, without assembling the update first.
+ */
+FREERDP_LOCAL BOOL fastpath_send_update_pdu_vec(rdpFastPath* fastpath, BYTE updateCode,
+                                                const rdpTransportBuffer* buffers, size_t count,
+                                                BOOL skipCompression);
+
 FREERDP_LOCAL BOOL fastpath_send_surfcmd_frame_marker(rdpFastPath* fastpath, UINT16 frameAction,
                                                       UINT32 frameId);
 FREERDP_LOCAL BYTE fastpath_get_encryption_flags(rdpFastPath* fastpath);
@@ -239,9 +239,9 @@ BOOL freerdp_connect(freerdp* instance)
 
 	if (rdp->settings->PlayRemoteFx)
 	{
-		wStream* s = NULL;
+		wStream sbuffer = { 0 };
 		rdp_update_internal* update = update_cast(instance->context->update);
-		pcap_record record = { 0 };
+		pcap_record_header record = { 0 };
 
 		WINPR_ASSERT(update);
 		update->pcap_rfx = pcap_open(rdp->settings->PlayRemoteFxFile, FALSE);
@@ -254,18 +254,9 @@ BOOL freerdp_connect(freerdp* instance)
 
 		status = TRUE;
 
-		while (pcap_has_next_record(update->pcap_rfx) && status)
+		while (status && pcap_get_next_record_view(update->pcap_rfx, &record, &sbuffer))
 		{
-			pcap_get_next_record_header(update->pcap_rfx, &record);
-
-			s = transport_take_from_pool(rdp->transport, record.length);
-			if (!s)
-				break;
-
-			record.data = Stream_Buffer(s);
-			pcap_get_next_record_content(update->pcap_rfx, &record);
-			Stream_SetLength(s, record.length);
-			Stream_SetPosition(s, 0);
+			wStream* s = &sbuffer;
 
 			if (!update_begin_paint(&update->common))
 				status = FALSE;
@@ -277,8 +268,6 @@ BOOL freerdp_connect(freerdp* instance)
 				if (!update_end_paint(&update->common))
 					status = FALSE;
 			}
-
-			Stream_Release(s);
 		}
 
 		pcap_close(update->pcap_rfx);
@@ -771,7 +760,8 @@ static wEventType FreeRDP_Events[] = {
 	DEFINE_EVENT_ENTRY(ConnectionResult),    DEFINE_EVENT_ENTRY(ChannelConnected),
 	DEFINE_EVENT_ENTRY(ChannelDisconnected), DEFINE_EVENT_ENTRY(MouseEvent),
 	DEFINE_EVENT_ENTRY(Activated),           DEFINE_EVENT_ENTRY(Timer),
-	DEFINE_EVENT_ENTRY(GraphicsReset)
+	DEFINE_EVENT_ENTRY(GraphicsReset),       DEFINE_EVENT_ENTRY(NetworkCharacteristicsChange),
+	DEFINE_EVENT_ENTRY(ConnectionStep)
 };
 
 /** Allocator function for a rdp context.
@@ -869,6 +859,11 @@ BOOL freerdp_context_new_ex(freerdp* instance, rdpSettings* settings)
 	if (!context->dump)
 		goto fail;
 
+	context->frameArena = winpr_Arena_New(0);
+	context->channelArena = winpr_Arena_New(0);
+	if (!context->frameArena || !context->channelArena)
+		goto fail;
+
 	IFCALLRET(instance->ContextNew, ret, instance, context);
 
 	if (ret)
@@ -937,6 +932,11 @@ void freerdp_context_free(freerdp* instance)
 	stream_dump_free(ctx->dump);
 	ctx->dump = NULL;
 
+	winpr_Arena_Free(ctx->frameArena);
+	ctx->frameArena = NULL;
+	winpr_Arena_Free(ctx->channelArena);
+	ctx->channelArena = NULL;
+
 	ctx->input = NULL;      /* owned by rdpRdp */
 	ctx->update = NULL;     /* owned by rdpRdp */
 	ctx->settings = NULL;   /* owned by rdpRdp */
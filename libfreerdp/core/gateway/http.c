@@ -1272,6 +1272,29 @@ static BOOL sleep_or_timeout_(rdpTls* tls, UINT64 startMS, UINT32 timeoutMS, con
 	return FALSE;
 }
 
+/* how many bytes to read so that a read ends with the header terminator at the latest */
+static size_t http_response_header_read_size(rdpTls* tls, HttpResponse* response)
+{
+	const size_t position = Stream_GetPosition(response->data);
+	char* data = Stream_PointerAs(response->data, char);
+
+	/* whatever follows the header belongs to the body or the next protocol layer, so only look
+	 * at what is already decrypted and consume exactly up to the end of the header. 1 byte
+	 * reads are only used if there is nothing to peek at, they also update the BIO retry
+	 * state. */
+	const size_t available = MIN(Stream_GetRemainingCapacity(response->data), 4096);
+	const int peeked = freerdp_tls_peek(tls, (BYTE*)data, available);
+	if (peeked <= 0)
+		return 1;
+
+	/* the terminator might start in the data already read */
+	const size_t back = MIN(position, 3);
+	const char* end = string_strnstr(data - back, "\r\n\r\n", (size_t)peeked + back);
+	if (!end)
+		return (size_t)peeked;
+	return WINPR_ASSERTING_INT_CAST(size_t, (end + 4) - data);
+}
+
 static SSIZE_T http_response_recv_line(rdpTls* tls, HttpResponse* response)
 {
 	WINPR_ASSERT(tls);
@@ -1291,7 +1314,11 @@ static SSIZE_T http_response_recv_line(rdpTls* tls, HttpResponse* response)
 		/* Read until we encounter \r\n\r\n */
 		ERR_clear_error();
 
-		status = BIO_read(tls->bio, Stream_Pointer(response->data), 1);
+		if (!Stream_EnsureRemainingCapacity(response->data, 1024))
+			goto out_error;
+
+		const size_t toRead = http_response_header_read_size(tls, response);
+		status = BIO_read(tls->bio, Stream_Pointer(response->data), (int)toRead);
 		if (status <= 0)
 		{
 			if (sleep_or_timeout(tls, startMS, timeoutMS))
@@ -1304,9 +1331,6 @@ static SSIZE_T http_response_recv_line(rdpTls* tls, HttpResponse* response)
 #endif
 		Stream_Seek(response->data, (size_t)status);
 
-		if (!Stream_EnsureRemainingCapacity(response->data, 1024))
-			goto out_error;
-
 		position = Stream_GetPosition(response->data);
 
 		if (position < 4)
@@ -1317,9 +1341,8 @@ static SSIZE_T http_response_recv_line(rdpTls* tls, HttpResponse* response)
 			goto out_error;
 		}
 
-		/* Always check at most the lase 8 bytes for occurrence of the desired
-		 * sequence of \r\n\r\n */
-		s = (position > 8) ? 8 : position;
+		/* Check the data of this read and the 3 bytes before for the sequence \r\n\r\n */
+		s = MIN(position, (size_t)status + 3);
 		end = (char*)Stream_Pointer(response->data) - s;
 
 		if (string_strnstr(end, "\r\n\r\n", s) != NULL)
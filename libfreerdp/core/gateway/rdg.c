@@ -291,38 +291,60 @@ static BOOL rdg_read_http_unicode_string(wLog* log, wStream* s, const WCHAR** st
 	return TRUE;
 }
 
-static BOOL rdg_write_chunked(BIO* bio, wStream* sPacket)
+/* start a HTTP chunk of the given length, the payload follows the returned header */
+static wStream* rdg_chunk_new(rdpRdg* rdg, size_t length)
 {
-	size_t len = 0;
-	int status = 0;
-	wStream* sChunk = NULL;
-	char chunkSize[11];
-	(void)sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIXz "\r\n", Stream_Length(sPacket));
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + Stream_Length(sPacket) + 2);
+	char chunkSize[11] = { 0 };
+
+	WINPR_ASSERT(rdg);
+	WINPR_ASSERT(rdg->context);
+	WINPR_ASSERT(rdg->context->rdp);
 
+	const int rc = sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIxz "\r\n", length);
+	if (rc <= 0)
+		return NULL;
+
+	/* header + payload + trailing CRLF go out with a single write, i.e. a single TLS record */
+	const size_t size = (size_t)rc + length + 2;
+
+	/* the transport pool is only available after transport setup */
+	rdpTransport* transport = rdg->context->rdp->transport;
+	wStream* sChunk = transport ? transport_take_from_pool(transport, size) : NULL;
 	if (!sChunk)
-		return FALSE;
+		sChunk = Stream_New(NULL, size);
+	if (!sChunk)
+		return NULL;
+
+	Stream_SetPosition(sChunk, 0);
+	Stream_Write(sChunk, chunkSize, (size_t)rc);
+	return sChunk;
+}
+
+static BOOL rdg_chunk_send(rdpRdg* rdg, wStream* sChunk)
+{
+	WINPR_ASSERT(rdg);
+	WINPR_ASSERT(sChunk);
 
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
-	Stream_Write(sChunk, Stream_Buffer(sPacket), Stream_Length(sPacket));
 	Stream_Write(sChunk, "\r\n", 2);
 	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
 
-	if (len > INT_MAX)
-	{
-		Stream_Free(sChunk, TRUE);
-		return FALSE;
-	}
+	const size_t len = Stream_Length(sChunk);
+	const int status = freerdp_tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), len);
+	Stream_Release(sChunk);
+
+	return (status >= 0) && ((size_t)status == len);
+}
 
-	ERR_clear_error();
-	status = BIO_write(bio, Stream_Buffer(sChunk), (int)len);
-	Stream_Free(sChunk, TRUE);
+static BOOL rdg_write_chunked(rdpRdg* rdg, wStream* sPacket)
+{
+	const size_t len = Stream_Length(sPacket);
+	wStream* sChunk = rdg_chunk_new(rdg, len);
 
-	if (status != (SSIZE_T)len)
+	if (!sChunk)
 		return FALSE;
 
-	return TRUE;
+	Stream_Write(sChunk, Stream_Buffer(sPacket), len);
+	return rdg_chunk_send(rdg, sChunk);
 }
 
 static BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
@@ -331,7 +353,7 @@ static BOOL rdg_write_packet(rdpRdg* rdg, wStream* sPacket)
 		return websocket_context_write_wstream(rdg->transferEncoding.context.websocket,
 		                                       rdg->tlsOut->bio, sPacket, WebsocketBinaryOpcode);
 
-	return rdg_write_chunked(rdg->tlsIn->bio, sPacket);
+	return rdg_write_chunked(rdg, sPacket);
 }
 
 static int rdg_socket_read(BIO* bio, BYTE* pBuffer, size_t size,
@@ -1559,6 +1581,8 @@ BOOL rdg_connect(rdpRdg* rdg, DWORD timeout, BOOL* rpcFallback)
 	BOOL rpcFallbackLocal = FALSE;
 
 	WINPR_ASSERT(rdg != NULL);
+	WINPR_ASSERT(rdg->context);
+	const UINT64 start = winpr_GetTickCount64NS();
 	status = rdg_establish_data_connection(rdg, rdg->tlsOut, "RDG_OUT_DATA", NULL, timeout,
 	                                       &rpcFallbackLocal);
 
@@ -1600,11 +1624,15 @@ BOOL rdg_connect(rdpRdg* rdg, DWORD timeout, BOOL* rpcFallback)
 		return FALSE;
 	}
 
+	rdp_timeline_add(rdg->context->rdp, "rdg_channels", start);
+
+	const UINT64 tunnelStart = winpr_GetTickCount64NS();
 	status = rdg_tunnel_connect(rdg);
 
 	if (!status)
 		return FALSE;
 
+	rdp_timeline_add(rdg->context->rdp, "rdg_tunnel", tunnelStart);
 	return TRUE;
 }
 
@@ -1621,8 +1649,9 @@ static int rdg_write_websocket_data_packet(rdpRdg* rdg, const BYTE* buf, int isi
 		UINT8 u8[4];
 	} maskingKey;
 
-	wStream* sWS =
-	    websocket_context_packet_new(payloadSize, WebsocketBinaryOpcode, &maskingKey.u32);
+	websocket_context* context = rdg->transferEncoding.context.websocket;
+	wStream* sWS = websocket_context_packet_new(context, payloadSize, WebsocketBinaryOpcode,
+	                                            &maskingKey.u32);
 	if (!sWS)
 		return FALSE;
 
@@ -1644,7 +1673,8 @@ static int rdg_write_websocket_data_packet(rdpRdg* rdg, const BYTE* buf, int isi
 	WINPR_ASSERT(rdg->tlsOut);
 	wStream sPacket = { 0 };
 	Stream_StaticConstInit(&sPacket, buf, (size_t)isize);
-	if (!websocket_context_mask_and_send(rdg->tlsOut->bio, sWS, &sPacket, maskingKey.u32))
+	if (!websocket_context_mask_and_send(context, rdg->tlsOut->bio, sWS, &sPacket,
+	                                     maskingKey.u32))
 		return -1;
 
 	return isize;
@@ -1652,10 +1682,6 @@ static int rdg_write_websocket_data_packet(rdpRdg* rdg, const BYTE* buf, int isi
 
 static int rdg_write_chunked_data_packet(rdpRdg* rdg, const BYTE* buf, int isize)
 {
-	int status = 0;
-	size_t len = 0;
-	wStream* sChunk = NULL;
-
 	if (isize > UINT16_MAX)
 		return -1;
 
@@ -1664,27 +1690,18 @@ static int rdg_write_chunked_data_packet(rdpRdg* rdg, const BYTE* buf, int isize
 		return 0;
 
 	const size_t packetSize = size + 10;
-	char chunkSize[11] = { 0 };
-	(void)sprintf_s(chunkSize, sizeof(chunkSize), "%" PRIxz "\r\n", packetSize);
-	sChunk = Stream_New(NULL, strnlen(chunkSize, sizeof(chunkSize)) + packetSize + 2);
+	wStream* sChunk = rdg_chunk_new(rdg, packetSize);
 
 	if (!sChunk)
 		return -1;
 
-	Stream_Write(sChunk, chunkSize, strnlen(chunkSize, sizeof(chunkSize)));
 	Stream_Write_UINT16(sChunk, PKT_TYPE_DATA);      /* Type */
 	Stream_Write_UINT16(sChunk, 0);                  /* Reserved */
 	Stream_Write_UINT32(sChunk, (UINT32)packetSize); /* Packet length */
 	Stream_Write_UINT16(sChunk, (UINT16)size);       /* Data size */
 	Stream_Write(sChunk, buf, size);                 /* Data */
-	Stream_Write(sChunk, "\r\n", 2);
-	Stream_SealLength(sChunk);
-	len = Stream_Length(sChunk);
 
-	status = freerdp_tls_write_all(rdg->tlsIn, Stream_Buffer(sChunk), len);
-	Stream_Free(sChunk, TRUE);
-
-	if (status < 0)
+	if (!rdg_chunk_send(rdg, sChunk))
 		return -1;
 
 	return (int)size;
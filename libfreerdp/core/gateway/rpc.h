@@ -475,7 +475,7 @@ typedef struct
 
 	/* align(8) */
 
-	BYTE* stub_data;
+	const BYTE* stub_data; /* points into the PDU data */
 
 	auth_verifier_co_t auth_verifier;
 } rpcconn_fault_hdr_t;
@@ -501,7 +501,7 @@ typedef struct
 
 	/* align(8) */
 
-	BYTE* stub_data;
+	const BYTE* stub_data; /* points into the PDU data */
 
 	auth_verifier_co_t auth_verifier;
 } rpcconn_request_hdr_t;
@@ -518,7 +518,7 @@ typedef struct
 
 	/* align(8) */
 
-	BYTE* stub_data;
+	const BYTE* stub_data; /* points into the PDU data */
 
 	auth_verifier_co_t auth_verifier;
 } rpcconn_response_hdr_t;
@@ -458,7 +458,8 @@ static int rpc_client_recv_fragment(rdpRpc* rpc, wStream* fragment)
 		{
 			const rpcconn_response_hdr_t* response =
 			    (const rpcconn_response_hdr_t*)&header.response;
-			if (!Stream_EnsureCapacity(pdu->s, response->alloc_hint))
+			/* alloc_hint is the size of the remaining stub, including this fragment */
+			if (!Stream_EnsureRemainingCapacity(pdu->s, response->alloc_hint))
 				goto fail;
 
 			if (Stream_Length(fragment) < StubOffset + StubLength)
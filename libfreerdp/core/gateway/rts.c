@@ -332,7 +332,7 @@ static BOOL rts_read_auth_verifier_with_stub(wStream* s, auth_verifier_co_t* aut
 {
 	size_t pos = 0;
 	size_t alloc_hint = 0;
-	BYTE** ptr = NULL;
+	const BYTE** ptr = NULL;
 
 	if (!rts_read_auth_verifier_no_checks(s, auth, header, &pos, silent))
 		return FALSE;
@@ -368,7 +368,7 @@ static BOOL rts_read_auth_verifier_with_stub(wStream* s, auth_verifier_co_t* aut
 	{
 		const size_t off = header->auth_length + 8 + auth->auth_pad_length + pos;
 		const size_t size = header->frag_length - MIN(header->frag_length, off);
-		const void* src = Stream_Buffer(s) + pos;
+		const BYTE* src = Stream_ConstBuffer(s) + pos;
 
 		if (off > header->frag_length)
 			WLog_WARN(TAG,
@@ -377,13 +377,10 @@ static BOOL rts_read_auth_verifier_with_stub(wStream* s, auth_verifier_co_t* aut
 			          alloc_hint, rts_pdu_ptype_to_string(header->ptype), size, header->frag_length,
 			          off);
 
+		/* the stub is only referenced, the header is valid as long as the PDU stream is */
 		*ptr = NULL;
 		if (size > 0)
-		{
-			*ptr = (BYTE*)sdup(src, size);
-			if (!*ptr)
-				return FALSE;
-		}
+			*ptr = src;
 	}
 
 	return TRUE;
@@ -1065,7 +1062,6 @@ static void rts_free_pdu_response(rpcconn_response_hdr_t* ctx)
 {
 	if (!ctx)
 		return;
-	free(ctx->stub_data);
 	rts_free_auth_verifier(&ctx->auth_verifier);
 }
 
@@ -17,12 +17,17 @@
  * limitations under the License.
  */
 
+#include <winpr/interlocked.h>
+
 #include "websocket.h"
 #include <freerdp/log.h>
 #include "../tcp.h"
 
 #define TAG FREERDP_TAG("core.gateway.websocket")
 
+/* send buffers larger than this are not kept for reuse */
+#define WEBSOCKET_SEND_BUFFER_MAX (1024ull * 1024ull)
+
 struct s_websocket_context
 {
 	size_t payloadLength;
@@ -34,51 +39,102 @@ struct s_websocket_context
 	BYTE lengthAndMaskPosition;
 	WEBSOCKET_STATE state;
 	wStream* responseStreamBuffer;
+	wStream* volatile sendStreamBuffer;
 };
 
 static int websocket_write_all(BIO* bio, const BYTE* data, size_t length);
 
-BOOL websocket_context_mask_and_send(BIO* bio, wStream* sPacket, wStream* sDataPacket,
-                                     UINT32 maskingKey)
+/* XOR the masking key in memory order, 32 bytes per iteration are left to the compiler to
+ * vectorize. The mask of byte n is key[n % 4], so callers continuing a payload must rotate
+ * the key accordingly. */
+static void websocket_mask(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src, size_t len,
+                           UINT32 maskingKey)
 {
-	const size_t len = Stream_Length(sDataPacket);
-	Stream_SetPosition(sDataPacket, 0);
+	BYTE key[8] = { 0 };
+	for (size_t x = 0; x < ARRAYSIZE(key); x++)
+		key[x] = (BYTE)(maskingKey >> (8 * (x % 4)));
 
-	if (!Stream_EnsureRemainingCapacity(sPacket, len))
-		return FALSE;
+	UINT64 key64 = 0;
+	memcpy(&key64, key, sizeof(key64));
 
-	/* mask as much as possible with 32bit access */
-	size_t streamPos = 0;
-	for (; streamPos + 4 <= len; streamPos += 4)
+	size_t pos = 0;
+	for (; pos + 32 <= len; pos += 32)
 	{
-		const uint32_t data = Stream_Get_UINT32(sDataPacket);
-		Stream_Write_UINT32(sPacket, data ^ maskingKey);
+		UINT64 data[4] = { 0 };
+		memcpy(data, &src[pos], sizeof(data));
+		data[0] ^= key64;
+		data[1] ^= key64;
+		data[2] ^= key64;
+		data[3] ^= key64;
+		memcpy(&dst[pos], data, sizeof(data));
 	}
 
-	/* mask the rest byte by byte */
-	for (; streamPos < len; streamPos++)
+	for (; pos + 8 <= len; pos += 8)
 	{
-		BYTE data = 0;
-		BYTE* partialMask = ((BYTE*)&maskingKey) + (streamPos % 4);
-		Stream_Read_UINT8(sDataPacket, data);
-		Stream_Write_UINT8(sPacket, data ^ *partialMask);
+		UINT64 data = 0;
+		memcpy(&data, &src[pos], sizeof(data));
+		data ^= key64;
+		memcpy(&dst[pos], &data, sizeof(data));
 	}
 
+	for (; pos < len; pos++)
+		dst[pos] = src[pos] ^ key[pos % 4];
+}
+
+void websocket_context_packet_release(websocket_context* context, wStream* sPacket)
+{
+	WINPR_ASSERT(context);
+
+	if (!sPacket)
+		return;
+
+	if (Stream_Capacity(sPacket) <= WEBSOCKET_SEND_BUFFER_MAX)
+	{
+		/* keep the buffer unless another one was returned in the meantime */
+		if (!InterlockedCompareExchangePointer((PVOID volatile*)&context->sendStreamBuffer,
+		                                       sPacket, NULL))
+			return;
+	}
+	Stream_Free(sPacket, TRUE);
+}
+
+BOOL websocket_context_mask_and_send(websocket_context* context, BIO* bio, wStream* sPacket,
+                                     wStream* sDataPacket, UINT32 maskingKey)
+{
+	BOOL rc = FALSE;
+	const size_t len = sDataPacket ? Stream_Length(sDataPacket) : 0;
+
+	WINPR_ASSERT(sPacket);
+
+	/* websocket_context_packet_new reserved space for the payload, mask it straight in */
+	if (!Stream_EnsureRemainingCapacity(sPacket, len))
+		goto fail;
+
+	if (len > 0)
+	{
+		websocket_mask(Stream_Pointer(sPacket), Stream_ConstBuffer(sDataPacket), len,
+		               maskingKey);
+		Stream_Seek(sPacket, len);
+	}
 	Stream_SealLength(sPacket);
 
 	ERR_clear_error();
 	const size_t size = Stream_Length(sPacket);
 	const int status = websocket_write_all(bio, Stream_Buffer(sPacket), size);
-	Stream_Free(sPacket, TRUE);
 
 	if ((status < 0) || ((size_t)status != size))
-		return FALSE;
+		goto fail;
 
-	return TRUE;
+	rc = TRUE;
+fail:
+	websocket_context_packet_release(context, sPacket);
+	return rc;
 }
 
-wStream* websocket_context_packet_new(size_t len, WEBSOCKET_OPCODE opcode, UINT32* pMaskingKey)
+wStream* websocket_context_packet_new(websocket_context* context, size_t len,
+                                      WEBSOCKET_OPCODE opcode, UINT32* pMaskingKey)
 {
+	WINPR_ASSERT(context);
 	WINPR_ASSERT(pMaskingKey);
 	if (len > INT_MAX)
 		return NULL;
@@ -91,7 +147,23 @@ wStream* websocket_context_packet_new(size_t len, WEBSOCKET_OPCODE opcode, UINT3
 	else
 		fullLen = len + 14; /* 2 byte "mini header" + 8 byte length + 4 byte masking key */
 
-	wStream* sWS = Stream_New(NULL, fullLen);
+	/* reuse the buffer of the last message, a concurrent writer gets a new one */
+	wStream* sWS = context->sendStreamBuffer;
+	if (sWS && (InterlockedCompareExchangePointer((PVOID volatile*)&context->sendStreamBuffer,
+	                                              NULL, sWS) != sWS))
+		sWS = NULL;
+
+	if (sWS)
+	{
+		Stream_SetPosition(sWS, 0);
+		if (!Stream_EnsureCapacity(sWS, fullLen))
+		{
+			Stream_Free(sWS, TRUE);
+			return NULL;
+		}
+	}
+	else
+		sWS = Stream_New(NULL, MAX(fullLen, 1024));
 	if (!sWS)
 		return NULL;
 
@@ -129,15 +201,15 @@ BOOL websocket_context_write_wstream(websocket_context* context, BIO* bio, wStre
 		context->closeSent = TRUE;
 
 	WINPR_ASSERT(bio);
-	WINPR_ASSERT(sPacket);
 
-	const size_t len = Stream_Length(sPacket);
+	/* a close reply might not carry a payload */
+	const size_t len = sPacket ? Stream_Length(sPacket) : 0;
 	uint32_t maskingKey = 0;
-	wStream* sWS = websocket_context_packet_new(len, opcode, &maskingKey);
+	wStream* sWS = websocket_context_packet_new(context, len, opcode, &maskingKey);
 	if (!sWS)
 		return FALSE;
 
-	return websocket_context_mask_and_send(bio, sWS, sPacket, maskingKey);
+	return websocket_context_mask_and_send(context, bio, sWS, sPacket, maskingKey);
 }
 
 int websocket_write_all(BIO* bio, const BYTE* data, size_t length)
@@ -485,6 +557,7 @@ void websocket_context_free(websocket_context* context)
 		return;
 
 	Stream_Free(context->responseStreamBuffer, TRUE);
+	Stream_Free(context->sendStreamBuffer, TRUE);
 	free(context);
 }
 
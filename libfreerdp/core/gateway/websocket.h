@@ -66,11 +66,17 @@ FREERDP_LOCAL int websocket_context_write(websocket_context* context, BIO* bio,
 FREERDP_LOCAL int websocket_context_read(websocket_context* encodingContext, BIO* bio,
                                          BYTE* pBuffer, size_t size);
 
-WINPR_ATTR_MALLOC(Stream_Free, 1)
-FREERDP_LOCAL wStream* websocket_context_packet_new(size_t len, WEBSOCKET_OPCODE opcode,
-                                                    UINT32* pMaskingKey);
+FREERDP_LOCAL void websocket_context_packet_release(websocket_context* context,
+                                                   wStream* sPacket);
 
-FREERDP_LOCAL BOOL websocket_context_mask_and_send(BIO* bio, wStream* sPacket, wStream* sDataPacket,
+/* The returned stream holds the frame header and has room for the payload. It is owned by the
+ * context, hand it to websocket_context_mask_and_send or websocket_context_packet_release. */
+WINPR_ATTR_MALLOC(websocket_context_packet_release, 2)
+FREERDP_LOCAL wStream* websocket_context_packet_new(websocket_context* context, size_t len,
+                                                    WEBSOCKET_OPCODE opcode, UINT32* pMaskingKey);
+
+FREERDP_LOCAL BOOL websocket_context_mask_and_send(websocket_context* context, BIO* bio,
+                                                   wStream* sPacket, wStream* sDataPacket,
                                                    UINT32 maskingKey);
 
 #endif /* FREERDP_LIB_CORE_GATEWAY_WEBSOCKET_H */
@@ -334,28 +334,157 @@ static BOOL input_send_keyboard_pause_event(rdpInput* input)
 	                                 RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
 }
 
+/**
+ * Fast-path input PDUs are built and sent with the input lock held. A mouse motion that is
+ * still waiting for its coalescing window to end is written in front of the new event, so
+ * key, wheel and button events carry the latest pointer position in the same PDU.
+ */
+static wStream* input_fastpath_pdu_init_header(rdpInput* input, UINT16* sec_flags)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	WINPR_ASSERT(input->context);
+	rdpRdp* rdp = input->context->rdp;
+	WINPR_ASSERT(rdp);
+
+	EnterCriticalSection(&in->lock);
+	wStream* s = fastpath_input_pdu_init_header(rdp->fastpath, sec_flags);
+
+	if (!s)
+	{
+		LeaveCriticalSection(&in->lock);
+		return NULL;
+	}
+
+	in->batchedEvents = 0;
+
+	if (in->pendingMove)
+	{
+		Stream_Write_UINT8(s, FASTPATH_INPUT_EVENT_MOUSE << 5); /* eventHeader (1 byte) */
+		input_write_mouse_event(s, PTR_FLAGS_MOVE, in->pendingX, in->pendingY);
+		in->pendingMove = FALSE;
+		in->batchedEvents++;
+	}
+
+	return s;
+}
+
+static wStream* input_fastpath_pdu_init(rdpInput* input, BYTE eventFlags, BYTE eventCode,
+                                        UINT16* sec_flags)
+{
+	wStream* s = input_fastpath_pdu_init_header(input, sec_flags);
+
+	if (!s)
+		return NULL;
+
+	WINPR_ASSERT(eventCode < 8);
+	WINPR_ASSERT(eventFlags < 0x20);
+	Stream_Write_UINT8(s, (UINT8)(eventFlags | (eventCode << 5))); /* eventHeader (1 byte) */
+	return s;
+}
+
+static BOOL input_fastpath_send(rdpInput* input, wStream* s, size_t numEvents, UINT16 sec_flags)
+{
+	rdp_input_internal* in = input_cast(input);
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(input->context);
+	rdpRdp* rdp = input->context->rdp;
+	WINPR_ASSERT(rdp);
+
+	const size_t count = in->batchedEvents + numEvents;
+	in->batchedEvents = 0;
+
+	if (count > 0)
+		rc = fastpath_send_multiple_input_pdu(rdp->fastpath, s, count, sec_flags);
+	else
+		Stream_Release(s);
+
+	LeaveCriticalSection(&in->lock);
+	return rc;
+}
+
+static void input_fastpath_discard(rdpInput* input, wStream* s)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	Stream_Release(s);
+	in->batchedEvents = 0;
+	LeaveCriticalSection(&in->lock);
+}
+
+static uint64_t input_coalesce_timer_cb(WINPR_ATTR_UNUSED rdpContext* context, void* userdata,
+                                        WINPR_ATTR_UNUSED FreeRDP_TimerID timerID,
+                                        WINPR_ATTR_UNUSED uint64_t timestamp, uint64_t interval)
+{
+	rdpInput* input = userdata;
+	rdp_input_internal* in = input_cast(input);
+	UINT16 sec_flags = 0;
+
+	EnterCriticalSection(&in->lock);
+
+	/* no motion during the last window, stop until the next one arrives */
+	if (!in->pendingMove || !input_ensure_client_running(input))
+	{
+		in->pendingMove = FALSE;
+		in->coalesceTimer = 0;
+		LeaveCriticalSection(&in->lock);
+		return 0;
+	}
+
+	wStream* s = input_fastpath_pdu_init_header(input, &sec_flags);
+
+	if (s)
+		(void)input_fastpath_send(input, s, 0, sec_flags);
+
+	LeaveCriticalSection(&in->lock);
+	return interval;
+}
+
+static BOOL input_coalesce_move(rdpInput* input, UINT16 x, UINT16 y)
+{
+	rdp_input_internal* in = input_cast(input);
+
+	if (in->coalesceIntervalNS == 0)
+		return FALSE;
+
+	EnterCriticalSection(&in->lock);
+
+	if (in->coalesceTimer == 0)
+		in->coalesceTimer = freerdp_timer_add(input->context, in->coalesceIntervalNS,
+		                                      input_coalesce_timer_cb, input, true);
+
+	const BOOL coalesced = (in->coalesceTimer != 0);
+
+	if (coalesced)
+	{
+		in->pendingMove = TRUE;
+		in->pendingX = x;
+		in->pendingY = y;
+	}
+
+	LeaveCriticalSection(&in->lock);
+	return coalesced;
+}
+
 static BOOL input_send_fastpath_synchronize_event(rdpInput* input, UINT32 flags)
 {
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
 	/* The FastPath Synchronization eventFlags has identical values as SlowPath */
-	s = fastpath_input_pdu_init(rdp->fastpath, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC, &sec_flags);
+	s = input_fastpath_pdu_init(input, (BYTE)flags, FASTPATH_INPUT_EVENT_SYNC, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
@@ -363,29 +492,24 @@ static BOOL input_send_fastpath_keyboard_event(rdpInput* input, UINT16 flags, UI
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED) ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0;
 	eventFlags |= (flags & KBD_FLAGS_EXTENDED1) ? FASTPATH_INPUT_KBDFLAGS_PREFIX_E1 : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE,
-	                            &sec_flags);
+	s = input_fastpath_pdu_init(input, eventFlags, FASTPATH_INPUT_EVENT_SCANCODE, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
 	WINPR_ASSERT(code <= UINT8_MAX);
 	Stream_Write_UINT8(s, code); /* keyCode (1 byte) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
@@ -393,15 +517,11 @@ static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 f
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -412,29 +532,24 @@ static BOOL input_send_fastpath_unicode_keyboard_event(rdpInput* input, UINT16 f
 	}
 
 	eventFlags |= (flags & KBD_FLAGS_RELEASE) ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0;
-	s = fastpath_input_pdu_init(rdp->fastpath, eventFlags, FASTPATH_INPUT_EVENT_UNICODE,
-	                            &sec_flags);
+	s = input_fastpath_pdu_init(input, eventFlags, FASTPATH_INPUT_EVENT_UNICODE, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
 	Stream_Write_UINT16(s, code); /* unicodeCode (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
 {
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -450,13 +565,17 @@ static BOOL input_send_fastpath_mouse_event(rdpInput* input, UINT16 flags, UINT1
 		}
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSE, &sec_flags);
+	/* plain motion waits for the coalescing window, everything else goes out at once */
+	if ((flags == PTR_FLAGS_MOVE) && input_coalesce_move(input, x, y))
+		return TRUE;
+
+	s = input_fastpath_pdu_init(input, 0, FASTPATH_INPUT_EVENT_MOUSE, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
 	input_write_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x,
@@ -464,14 +583,10 @@ static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 fla
 {
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -484,13 +599,13 @@ static BOOL input_send_fastpath_extended_mouse_event(rdpInput* input, UINT16 fla
 		return TRUE;
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, FASTPATH_INPUT_EVENT_MOUSEX, &sec_flags);
+	s = input_fastpath_pdu_init(input, 0, FASTPATH_INPUT_EVENT_MOUSEX, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
 	input_write_extended_mouse_event(s, flags, x, y);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, INT16 xDelta,
@@ -498,15 +613,11 @@ static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, IN
 {
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -516,7 +627,7 @@ static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, IN
 		return FALSE;
 	}
 
-	s = fastpath_input_pdu_init(rdp->fastpath, 0, TS_FP_RELPOINTER_EVENT, &sec_flags);
+	s = input_fastpath_pdu_init(input, 0, TS_FP_RELPOINTER_EVENT, &sec_flags);
 
 	if (!s)
 		return FALSE;
@@ -524,7 +635,7 @@ static BOOL input_send_fastpath_relmouse_event(rdpInput* input, UINT16 flags, IN
 	Stream_Write_UINT16(s, flags); /* pointerFlags (2 bytes) */
 	Stream_Write_INT16(s, xDelta); /* xDelta (2 bytes) */
 	Stream_Write_INT16(s, yDelta); /* yDelta (2 bytes) */
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
@@ -533,9 +644,6 @@ static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
 	WINPR_ASSERT(input->context);
 	WINPR_ASSERT(input->context->settings);
 
-	rdpRdp* rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
@@ -546,19 +654,19 @@ static BOOL input_send_fastpath_qoe_event(rdpInput* input, UINT32 timestampMS)
 	}
 
 	UINT16 sec_flags = 0;
-	wStream* s = fastpath_input_pdu_init(rdp->fastpath, 0, TS_FP_QOETIMESTAMP_EVENT, &sec_flags);
+	wStream* s = input_fastpath_pdu_init(input, 0, TS_FP_QOETIMESTAMP_EVENT, &sec_flags);
 
 	if (!s)
 		return FALSE;
 
 	if (!Stream_EnsureRemainingCapacity(s, 4))
 	{
-		Stream_Free(s, TRUE);
+		input_fastpath_discard(input, s);
 		return FALSE;
 	}
 
 	Stream_Write_UINT32(s, timestampMS);
-	return fastpath_send_input_pdu(rdp->fastpath, s, sec_flags);
+	return input_fastpath_send(input, s, 1, sec_flags);
 }
 
 static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleStates)
@@ -566,18 +674,14 @@ static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleSta
 	UINT16 sec_flags = 0;
 	wStream* s = NULL;
 	BYTE eventFlags = 0;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
-	s = fastpath_input_pdu_init_header(rdp->fastpath, &sec_flags);
+	s = input_fastpath_pdu_init_header(input, &sec_flags);
 
 	if (!s)
 		return FALSE;
@@ -593,7 +697,7 @@ static BOOL input_send_fastpath_focus_in_event(rdpInput* input, UINT16 toggleSta
 	eventFlags = FASTPATH_INPUT_KBDFLAGS_RELEASE | FASTPATH_INPUT_EVENT_SCANCODE << 5;
 	Stream_Write_UINT8(s, eventFlags); /* Key Release event (1 byte) */
 	Stream_Write_UINT8(s, 0x0f);       /* keyCode (1 byte) */
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 3, sec_flags);
+	return input_fastpath_send(input, s, 3, sec_flags);
 }
 
 static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
@@ -606,18 +710,14 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	wStream* s = NULL;
 	const BYTE keyDownEvent = FASTPATH_INPUT_EVENT_SCANCODE << 5;
 	const BYTE keyUpEvent = (FASTPATH_INPUT_EVENT_SCANCODE << 5) | FASTPATH_INPUT_KBDFLAGS_RELEASE;
-	rdpRdp* rdp = NULL;
 
 	WINPR_ASSERT(input);
 	WINPR_ASSERT(input->context);
 
-	rdp = input->context->rdp;
-	WINPR_ASSERT(rdp);
-
 	if (!input_ensure_client_running(input))
 		return FALSE;
 
-	s = fastpath_input_pdu_init_header(rdp->fastpath, &sec_flags);
+	s = input_fastpath_pdu_init_header(input, &sec_flags);
 
 	if (!s)
 		return FALSE;
@@ -634,7 +734,7 @@ static BOOL input_send_fastpath_keyboard_pause_event(rdpInput* input)
 	/* Numlock down (0x45) */
 	Stream_Write_UINT8(s, keyUpEvent);
 	Stream_Write_UINT8(s, RDP_SCANCODE_CODE(RDP_SCANCODE_NUMLOCK));
-	return fastpath_send_multiple_input_pdu(rdp->fastpath, s, 4, sec_flags);
+	return input_fastpath_send(input, s, 4, sec_flags);
 }
 
 static BOOL input_recv_sync_event(rdpInput* input, wStream* s)
@@ -875,8 +975,13 @@ BOOL input_register_client_callbacks(rdpInput* input)
 	if (!settings)
 		return FALSE;
 
+	rdp_input_internal* in = input_cast(input);
+	in->coalesceIntervalNS = 0;
+
 	if (freerdp_settings_get_bool(settings, FreeRDP_FastPathInput))
 	{
+		in->coalesceIntervalNS =
+		    freerdp_settings_get_uint32(settings, FreeRDP_InputCoalesceInterval) * 1000000ull;
 		input->SynchronizeEvent = input_send_fastpath_synchronize_event;
 		input->KeyboardEvent = input_send_fastpath_keyboard_event;
 		input->KeyboardPauseEvent = input_send_fastpath_keyboard_pause_event;
@@ -1075,6 +1180,13 @@ rdpInput* input_new(rdpRdp* rdp)
 		return NULL;
 	}
 
+	if (!InitializeCriticalSectionAndSpinCount(&input->lock, 4000))
+	{
+		MessageQueue_Free(input->queue);
+		free(input);
+		return NULL;
+	}
+
 	return &input->common;
 }
 
@@ -1085,6 +1197,7 @@ void input_free(rdpInput* input)
 		rdp_input_internal* in = input_cast(input);
 
 		MessageQueue_Free(in->queue);
+		DeleteCriticalSection(&in->lock);
 		free(in);
 	}
 }
@@ -25,6 +25,7 @@
 #include "message.h"
 
 #include <freerdp/input.h>
+#include <freerdp/timer.h>
 #include <freerdp/freerdp.h>
 #include <freerdp/api.h>
 
@@ -41,6 +42,15 @@ typedef struct
 	UINT64 lastInputTimestamp;
 	UINT16 lastX;
 	UINT16 lastY;
+
+	/* fast-path mouse motion coalescing */
+	CRITICAL_SECTION lock;
+	UINT64 coalesceIntervalNS;
+	FreeRDP_TimerID coalesceTimer;
+	BOOL pendingMove;
+	UINT16 pendingX;
+	UINT16 pendingY;
+	size_t batchedEvents;
 } rdp_input_internal;
 
 static INLINE rdp_input_internal* input_cast(rdpInput* input)
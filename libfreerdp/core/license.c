@@ -217,6 +217,8 @@ struct rdp_license
 	UINT16 ClientType;
 	UINT16 LicenseDetailLevel;
 	BOOL update;
+	char* calKey;      /* license store key of the current server scope */
+	BOOL presentedCal; /* a stored license was sent in this licensing sequence */
 	wLog* log;
 };
 
@@ -639,8 +641,16 @@ static BYTE* loadCalFile(wLog* log, const rdpSettings* settings, const char* hos
 	length = _ftelli64(fp);
 	if (_fseeki64(fp, 0, SEEK_SET) != 0)
 		goto error_malloc;
-	if (length < 0)
-		goto error_malloc;
+	if ((length <= 0) || (length > UINT16_MAX))
+	{
+		/* the license is sent in a blob with a 16bit length, such a file can not be used */
+		WLog_Print(log, WLOG_WARN, "ignoring license file '%s' with invalid size %" PRId64,
+		           calPath, length);
+		(void)fclose(fp);
+		fp = NULL;
+		winpr_DeleteFile(calPath);
+		goto error_open;
+	}
 
 	ret = (BYTE*)malloc((size_t)length);
 	if (!ret)
@@ -660,7 +670,7 @@ static BYTE* loadCalFile(wLog* log, const rdpSettings* settings, const char* hos
 error_read:
 	free(ret);
 error_malloc:
-	fclose(fp);
+	(void)fclose(fp);
 error_open:
 	free(calPath);
 error_path:
@@ -668,6 +678,60 @@ error_path:
 	return NULL;
 }
 
+static void removeCalFile(wLog* log, const rdpSettings* settings, const char* hostname)
+{
+	char hash[41] = { 0 };
+	char calFilename[MAX_PATH] = { 0 };
+
+	WINPR_ASSERT(settings);
+	WINPR_ASSERT(hostname);
+
+	if (!computeCalHash(log, hostname, hash, sizeof(hash)))
+		return;
+	(void)sprintf_s(calFilename, sizeof(calFilename) - 1, "%s.cal", hash);
+
+	char* licenseStorePath =
+	    GetCombinedPath(freerdp_settings_get_string(settings, FreeRDP_ConfigPath), licenseStore);
+	char* calPath = licenseStorePath ? GetCombinedPath(licenseStorePath, calFilename) : NULL;
+	if (calPath && winpr_PathFileExists(calPath))
+	{
+		WLog_Print(log, WLOG_INFO, "removing rejected license file '%s'", calPath);
+		winpr_DeleteFile(calPath);
+	}
+	free(calPath);
+	free(licenseStorePath);
+}
+
+/**
+ * The license store key is the client hostname combined with the scope the server announced.
+ * All servers of a farm share the license server scope and therefore a single CAL, while
+ * CALs issued by different license servers do not overwrite each other.
+ */
+static char* license_cal_key(const rdpLicense* license)
+{
+	char scope[256] = { 0 };
+	const char* hostname = license->rdp->settings->ClientHostname;
+
+	WINPR_ASSERT(hostname);
+
+	const SCOPE_LIST* scopeList = license->ScopeList;
+	if (scopeList && (scopeList->count > 0) && scopeList->array && scopeList->array[0])
+	{
+		const LICENSE_BLOB* blob = scopeList->array[0];
+		const size_t len = MIN(blob->length, sizeof(scope) - 1);
+		if (blob->data)
+			memcpy(scope, blob->data, len);
+	}
+
+	if (strnlen(scope, sizeof(scope)) == 0)
+		return _strdup(hostname);
+
+	char* key = NULL;
+	size_t keylen = 0;
+	winpr_asprintf(&key, &keylen, "%s@%s", hostname, scope);
+	return key;
+}
+
 /**
  * Read a licensing preamble.
  * msdn{cc240480}
@@ -2257,8 +2321,12 @@ BOOL license_read_new_or_upgrade_license_packet(rdpLicense* license, wStream* s)
 	ret = license_set_state(license, LICENSE_STATE_COMPLETED);
 
 	if (!license->rdp->settings->OldLicenseBehaviour)
+	{
+		const char* key =
+		    license->calKey ? license->calKey : license->rdp->settings->ClientHostname;
 		ret = saveCal(license->log, license->rdp->settings, Stream_Pointer(licenseStream),
-		              cbLicenseInfo, license->rdp->settings->ClientHostname);
+		              cbLicenseInfo, key);
+	}
 
 fail:
 	license_free_binary_blob(calBlob);
@@ -2300,6 +2368,20 @@ BOOL license_read_error_alert_packet(rdpLicense* license, wStream* s)
 		return license_set_state(license, LICENSE_STATE_COMPLETED);
 	}
 
+	/* The server refused the stored license, do not present it again on the next connect */
+	const BOOL rejected = (dwErrorCode == ERR_INVALID_CLIENT) || (dwErrorCode == ERR_NO_LICENSE) ||
+	                      (dwErrorCode == ERR_INVALID_PRODUCT_ID) ||
+	                      (dwErrorCode == ERR_INVALID_SCOPE);
+	if (rejected && license->presentedCal && license->calKey)
+	{
+		const char* hostname = license->rdp->settings->ClientHostname;
+
+		removeCalFile(license->log, license->rdp->settings, license->calKey);
+		if (strcmp(license->calKey, hostname) != 0)
+			removeCalFile(license->log, license->rdp->settings, hostname);
+		license->presentedCal = FALSE;
+	}
+
 	switch (dwStateTransition)
 	{
 		case ST_TOTAL_ABORT:
@@ -2439,9 +2521,24 @@ BOOL license_answer_license_request(rdpLicense* license)
 	WINPR_ASSERT(license->rdp);
 	WINPR_ASSERT(license->rdp->settings);
 
+	license->presentedCal = FALSE;
 	if (!license->rdp->settings->OldLicenseBehaviour)
-		license_data = loadCalFile(license->log, license->rdp->settings,
-		                           license->rdp->settings->ClientHostname, &license_size);
+	{
+		const char* hostname = license->rdp->settings->ClientHostname;
+
+		free(license->calKey);
+		license->calKey = license_cal_key(license);
+		if (!license->calKey)
+			return FALSE;
+
+		license_data =
+		    loadCalFile(license->log, license->rdp->settings, license->calKey, &license_size);
+
+		/* licenses stored by older versions are only keyed by the client hostname */
+		if (!license_data && (strcmp(license->calKey, hostname) != 0))
+			license_data =
+			    loadCalFile(license->log, license->rdp->settings, hostname, &license_size);
+	}
 
 	if (license_data)
 	{
@@ -2471,6 +2568,7 @@ BOOL license_answer_license_request(rdpLicense* license)
 
 		status = license_send_license_info(license, calBlob, signature, sizeof(signature));
 		license_free_binary_blob(calBlob);
+		license->presentedCal = status;
 
 		return status;
 	}
@@ -2820,6 +2918,7 @@ void license_free(rdpLicense* license)
 		license_free_binary_blob(license->EncryptedHardwareId);
 		license_free_binary_blob(license->EncryptedLicenseInfo);
 		license_free_scope_list(license->ScopeList);
+		free(license->calKey);
 		free(license);
 	}
 }
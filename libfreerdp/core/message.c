@@ -43,6 +43,204 @@
 
 #define TAG FREERDP_TAG("core.message")
 
+#define UPDATE_MESSAGE_BLOCK_SIZE (64 * 1024)
+
+typedef struct update_message_block update_message_block;
+
+struct update_message_block
+{
+	update_message_block* next;
+	size_t used;
+	BYTE data[UPDATE_MESSAGE_BLOCK_SIZE];
+};
+
+/**
+ * The orders queued between BeginPaint and EndPaint are allocated linearly from
+ * a chain of pooled blocks. The chain travels with the EndPaint message and is
+ * returned to the pool once that message was processed, after all orders of the
+ * frame.
+ */
+struct rdp_update_arena
+{
+	wObjectPool* pool;
+	CRITICAL_SECTION lock;
+	update_message_block* frame;
+	DWORD thread;
+};
+
+static void* update_message_block_new(WINPR_ATTR_UNUSED const void* val)
+{
+	return malloc(sizeof(update_message_block));
+}
+
+static void update_message_block_init(void* obj)
+{
+	update_message_block* block = obj;
+	if (!block)
+		return;
+	block->next = NULL;
+	block->used = 0;
+}
+
+static void update_message_arena_release(rdpUpdateArena* arena, update_message_block* frame)
+{
+	if (!arena)
+		return;
+
+	while (frame)
+	{
+		update_message_block* next = frame->next;
+		ObjectPool_Return(arena->pool, frame);
+		frame = next;
+	}
+}
+
+rdpUpdateArena* update_message_arena_new(void)
+{
+	rdpUpdateArena* arena = calloc(1, sizeof(rdpUpdateArena));
+	if (!arena)
+		return NULL;
+
+	InitializeCriticalSection(&arena->lock);
+	arena->pool = ObjectPool_New(TRUE);
+	if (!arena->pool)
+		goto fail;
+
+	wObject* obj = ObjectPool_Object(arena->pool);
+	obj->fnObjectNew = update_message_block_new;
+	obj->fnObjectInit = update_message_block_init;
+	obj->fnObjectFree = free;
+	return arena;
+
+fail:
+	update_message_arena_free(arena);
+	return NULL;
+}
+
+void update_message_arena_free(rdpUpdateArena* arena)
+{
+	if (!arena)
+		return;
+
+	if (arena->pool)
+	{
+		update_message_arena_release(arena, arena->frame);
+		ObjectPool_Free(arena->pool);
+	}
+	DeleteCriticalSection(&arena->lock);
+	free(arena);
+}
+
+static void update_message_arena_begin(rdpUpdateArena* arena)
+{
+	if (!arena)
+		return;
+
+	EnterCriticalSection(&arena->lock);
+	if (!arena->frame)
+	{
+		arena->frame = ObjectPool_Take(arena->pool);
+		arena->thread = GetCurrentThreadId();
+	}
+	LeaveCriticalSection(&arena->lock);
+}
+
+static update_message_block* update_message_arena_end(rdpUpdateArena* arena)
+{
+	update_message_block* frame = NULL;
+
+	if (!arena)
+		return NULL;
+
+	EnterCriticalSection(&arena->lock);
+	if (arena->thread == GetCurrentThreadId())
+	{
+		frame = arena->frame;
+		arena->frame = NULL;
+	}
+	LeaveCriticalSection(&arena->lock);
+	return frame;
+}
+
+static void update_message_arena_reopen(rdpUpdateArena* arena, update_message_block* frame)
+{
+	if (!arena || !frame)
+		return;
+
+	EnterCriticalSection(&arena->lock);
+	WINPR_ASSERT(!arena->frame);
+	arena->frame = frame;
+	arena->thread = GetCurrentThreadId();
+	LeaveCriticalSection(&arena->lock);
+}
+
+/**
+ * Allocates a copy for a queued message. Only the thread that opened the frame
+ * allocates from it, so its orders are queued before its EndPaint. Everything
+ * else falls back to the heap, *lParam tells the free handlers which one it was.
+ */
+static void* update_message_alloc(rdpContext* context, size_t size, void** lParam)
+{
+	void* ptr = NULL;
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(lParam);
+
+	rdp_update_internal* up = update_cast(context->update);
+	rdpUpdateArena* arena = up->arena;
+	const size_t aligned = (size + 15) & ~(size_t)15;
+
+	*lParam = NULL;
+	if (arena && (aligned > 0) && (aligned <= UPDATE_MESSAGE_BLOCK_SIZE))
+	{
+		EnterCriticalSection(&arena->lock);
+		update_message_block* block = arena->frame;
+		if (block && (arena->thread == GetCurrentThreadId()))
+		{
+			if (block->used + aligned > UPDATE_MESSAGE_BLOCK_SIZE)
+			{
+				update_message_block* next = ObjectPool_Take(arena->pool);
+				if (next)
+				{
+					next->next = block;
+					arena->frame = next;
+				}
+				block = next;
+			}
+
+			if (block)
+			{
+				ptr = &block->data[block->used];
+				block->used += aligned;
+				*lParam = arena;
+			}
+		}
+		LeaveCriticalSection(&arena->lock);
+	}
+
+	if (!ptr)
+		ptr = malloc(size);
+	return ptr;
+}
+
+static void* update_message_copy(rdpContext* context, const void* data, size_t size,
+                                 void** lParam)
+{
+	void* ptr = update_message_alloc(context, size, lParam);
+	if (ptr)
+		CopyMemory(ptr, data, size);
+	return ptr;
+}
+
+static void update_message_free(const wMessage* msg, void* ptr)
+{
+	WINPR_ASSERT(msg);
+
+	/* memory from the frame arena is released with the EndPaint message */
+	if (!msg->lParam)
+		free(ptr);
+}
+
 /* Update */
 
 static BOOL update_message_BeginPaint(rdpContext* context)
@@ -53,6 +251,7 @@ static BOOL update_message_BeginPaint(rdpContext* context)
 		return FALSE;
 
 	up = update_cast(context->update);
+	update_message_arena_begin(up->arena);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, BeginPaint), NULL,
 	                         NULL);
 }
@@ -65,13 +264,21 @@ static BOOL update_message_EndPaint(rdpContext* context)
 		return FALSE;
 
 	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, EndPaint), NULL,
-	                         NULL);
+	update_message_block* frame = update_message_arena_end(up->arena);
+	if (!MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, EndPaint), frame,
+	                       NULL))
+	{
+		/* the orders already queued still use it */
+		update_message_arena_reopen(up->arena, frame);
+		return FALSE;
+	}
+	return TRUE;
 }
 
 static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bounds)
 {
 	rdpBounds* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update)
@@ -79,17 +286,15 @@ static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bound
 
 	if (bounds)
 	{
-		wParam = (rdpBounds*)malloc(sizeof(rdpBounds));
+		wParam = update_message_copy(context, bounds, sizeof(rdpBounds), &lParam);
 
 		if (!wParam)
 			return FALSE;
-
-		CopyMemory(wParam, bounds, sizeof(rdpBounds));
 	}
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, SetBounds),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_Synchronize(rdpContext* context)
@@ -321,386 +526,369 @@ static BOOL update_message_SurfaceFrameAcknowledge(rdpContext* context, UINT32 f
 static BOOL update_message_DstBlt(rdpContext* context, const DSTBLT_ORDER* dstBlt)
 {
 	DSTBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !dstBlt)
 		return FALSE;
 
-	wParam = (DSTBLT_ORDER*)malloc(sizeof(DSTBLT_ORDER));
+	wParam = update_message_copy(context, dstBlt, sizeof(DSTBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, dstBlt, sizeof(DSTBLT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, DstBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_PatBlt(rdpContext* context, PATBLT_ORDER* patBlt)
 {
 	PATBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !patBlt)
 		return FALSE;
 
-	wParam = (PATBLT_ORDER*)malloc(sizeof(PATBLT_ORDER));
+	wParam = update_message_copy(context, patBlt, sizeof(PATBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, patBlt, sizeof(PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PatBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_ScrBlt(rdpContext* context, const SCRBLT_ORDER* scrBlt)
 {
 	SCRBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !scrBlt)
 		return FALSE;
 
-	wParam = (SCRBLT_ORDER*)malloc(sizeof(SCRBLT_ORDER));
+	wParam = update_message_copy(context, scrBlt, sizeof(SCRBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, scrBlt, sizeof(SCRBLT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, ScrBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_OpaqueRect(rdpContext* context, const OPAQUE_RECT_ORDER* opaqueRect)
 {
 	OPAQUE_RECT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !opaqueRect)
 		return FALSE;
 
-	wParam = (OPAQUE_RECT_ORDER*)malloc(sizeof(OPAQUE_RECT_ORDER));
+	wParam = update_message_copy(context, opaqueRect, sizeof(OPAQUE_RECT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, opaqueRect, sizeof(OPAQUE_RECT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, OpaqueRect),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_DrawNineGrid(rdpContext* context,
                                         const DRAW_NINE_GRID_ORDER* drawNineGrid)
 {
 	DRAW_NINE_GRID_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !drawNineGrid)
 		return FALSE;
 
-	wParam = (DRAW_NINE_GRID_ORDER*)malloc(sizeof(DRAW_NINE_GRID_ORDER));
+	wParam = update_message_copy(context, drawNineGrid, sizeof(DRAW_NINE_GRID_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, drawNineGrid, sizeof(DRAW_NINE_GRID_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, DrawNineGrid),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_MultiDstBlt(rdpContext* context, const MULTI_DSTBLT_ORDER* multiDstBlt)
 {
 	MULTI_DSTBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiDstBlt)
 		return FALSE;
 
-	wParam = (MULTI_DSTBLT_ORDER*)malloc(sizeof(MULTI_DSTBLT_ORDER));
+	wParam = update_message_copy(context, multiDstBlt, sizeof(MULTI_DSTBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiDstBlt, sizeof(MULTI_DSTBLT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiDstBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_MultiPatBlt(rdpContext* context, const MULTI_PATBLT_ORDER* multiPatBlt)
 {
 	MULTI_PATBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiPatBlt)
 		return FALSE;
 
-	wParam = (MULTI_PATBLT_ORDER*)malloc(sizeof(MULTI_PATBLT_ORDER));
+	wParam = update_message_copy(context, multiPatBlt, sizeof(MULTI_PATBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiPatBlt, sizeof(MULTI_PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiPatBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_MultiScrBlt(rdpContext* context, const MULTI_SCRBLT_ORDER* multiScrBlt)
 {
 	MULTI_SCRBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiScrBlt)
 		return FALSE;
 
-	wParam = (MULTI_SCRBLT_ORDER*)malloc(sizeof(MULTI_SCRBLT_ORDER));
+	wParam = update_message_copy(context, multiScrBlt, sizeof(MULTI_SCRBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiScrBlt, sizeof(MULTI_SCRBLT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiScrBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_MultiOpaqueRect(rdpContext* context,
                                            const MULTI_OPAQUE_RECT_ORDER* multiOpaqueRect)
 {
 	MULTI_OPAQUE_RECT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiOpaqueRect)
 		return FALSE;
 
-	wParam = (MULTI_OPAQUE_RECT_ORDER*)malloc(sizeof(MULTI_OPAQUE_RECT_ORDER));
+	wParam =
+	    update_message_copy(context, multiOpaqueRect, sizeof(MULTI_OPAQUE_RECT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiOpaqueRect, sizeof(MULTI_OPAQUE_RECT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiOpaqueRect), (void*)wParam, NULL);
+	                         MakeMessageId(PrimaryUpdate, MultiOpaqueRect), (void*)wParam, lParam);
 }
 
 static BOOL update_message_MultiDrawNineGrid(rdpContext* context,
                                              const MULTI_DRAW_NINE_GRID_ORDER* multiDrawNineGrid)
 {
 	MULTI_DRAW_NINE_GRID_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiDrawNineGrid)
 		return FALSE;
 
-	wParam = (MULTI_DRAW_NINE_GRID_ORDER*)malloc(sizeof(MULTI_DRAW_NINE_GRID_ORDER));
+	wParam = update_message_copy(context, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER),
+	                             &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 	/* TODO: complete copy */
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiDrawNineGrid), (void*)wParam, NULL);
+	                         MakeMessageId(PrimaryUpdate, MultiDrawNineGrid), (void*)wParam,
+	                         lParam);
 }
 
 static BOOL update_message_LineTo(rdpContext* context, const LINE_TO_ORDER* lineTo)
 {
 	LINE_TO_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !lineTo)
 		return FALSE;
 
-	wParam = (LINE_TO_ORDER*)malloc(sizeof(LINE_TO_ORDER));
+	wParam = update_message_copy(context, lineTo, sizeof(LINE_TO_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, lineTo, sizeof(LINE_TO_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, LineTo),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_Polyline(rdpContext* context, const POLYLINE_ORDER* polyline)
 {
 	POLYLINE_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polyline)
 		return FALSE;
 
-	wParam = (POLYLINE_ORDER*)malloc(sizeof(POLYLINE_ORDER));
+	const size_t size = sizeof(DELTA_POINT) * polyline->numDeltaEntries;
+	wParam = update_message_alloc(context, sizeof(POLYLINE_ORDER) + size, &lParam);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polyline, sizeof(POLYLINE_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numDeltaEntries, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
-	CopyMemory(wParam->points, polyline->points, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
+	wParam->points = (DELTA_POINT*)&wParam[1];
+	if (size > 0)
+		CopyMemory(wParam->points, polyline->points, size);
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, Polyline),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_MemBlt(rdpContext* context, MEMBLT_ORDER* memBlt)
 {
 	MEMBLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !memBlt)
 		return FALSE;
 
-	wParam = (MEMBLT_ORDER*)malloc(sizeof(MEMBLT_ORDER));
+	wParam = update_message_copy(context, memBlt, sizeof(MEMBLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, memBlt, sizeof(MEMBLT_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MemBlt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_Mem3Blt(rdpContext* context, MEM3BLT_ORDER* mem3Blt)
 {
 	MEM3BLT_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !mem3Blt)
 		return FALSE;
 
-	wParam = (MEM3BLT_ORDER*)malloc(sizeof(MEM3BLT_ORDER));
+	wParam = update_message_copy(context, mem3Blt, sizeof(MEM3BLT_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, mem3Blt, sizeof(MEM3BLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, Mem3Blt),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_SaveBitmap(rdpContext* context, const SAVE_BITMAP_ORDER* saveBitmap)
 {
 	SAVE_BITMAP_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !saveBitmap)
 		return FALSE;
 
-	wParam = (SAVE_BITMAP_ORDER*)malloc(sizeof(SAVE_BITMAP_ORDER));
+	wParam = update_message_copy(context, saveBitmap, sizeof(SAVE_BITMAP_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, saveBitmap, sizeof(SAVE_BITMAP_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, SaveBitmap),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* glyphIndex)
 {
 	GLYPH_INDEX_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !glyphIndex)
 		return FALSE;
 
-	wParam = (GLYPH_INDEX_ORDER*)malloc(sizeof(GLYPH_INDEX_ORDER));
+	wParam = update_message_copy(context, glyphIndex, sizeof(GLYPH_INDEX_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, glyphIndex, sizeof(GLYPH_INDEX_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, GlyphIndex),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_FastIndex(rdpContext* context, const FAST_INDEX_ORDER* fastIndex)
 {
 	FAST_INDEX_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !fastIndex)
 		return FALSE;
 
-	wParam = (FAST_INDEX_ORDER*)malloc(sizeof(FAST_INDEX_ORDER));
+	wParam = update_message_copy(context, fastIndex, sizeof(FAST_INDEX_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, fastIndex, sizeof(FAST_INDEX_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, FastIndex),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER* fastGlyph)
 {
 	FAST_GLYPH_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !fastGlyph)
 		return FALSE;
 
-	wParam = (FAST_GLYPH_ORDER*)malloc(sizeof(FAST_GLYPH_ORDER));
+	const size_t size = (fastGlyph->cbData > 1) ? fastGlyph->glyphData.cb : 0;
+	wParam = update_message_alloc(context, sizeof(FAST_GLYPH_ORDER) + size, &lParam);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, fastGlyph, sizeof(FAST_GLYPH_ORDER));
 
-	if (wParam->cbData > 1)
+	if (fastGlyph->cbData > 1)
 	{
-		wParam->glyphData.aj = (BYTE*)malloc(fastGlyph->glyphData.cb);
-
-		if (!wParam->glyphData.aj)
-		{
-			free(wParam);
-			return FALSE;
-		}
-
-		CopyMemory(wParam->glyphData.aj, fastGlyph->glyphData.aj, fastGlyph->glyphData.cb);
+		wParam->glyphData.aj = (BYTE*)&wParam[1];
+		CopyMemory(wParam->glyphData.aj, fastGlyph->glyphData.aj, size);
 	}
 	else
 	{
@@ -709,107 +897,98 @@ static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, FastGlyph),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_PolygonSC(rdpContext* context, const POLYGON_SC_ORDER* polygonSC)
 {
 	POLYGON_SC_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polygonSC)
 		return FALSE;
 
-	wParam = (POLYGON_SC_ORDER*)malloc(sizeof(POLYGON_SC_ORDER));
+	const size_t size = sizeof(DELTA_POINT) * polygonSC->numPoints;
+	wParam = update_message_alloc(context, sizeof(POLYGON_SC_ORDER) + size, &lParam);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polygonSC, sizeof(POLYGON_SC_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
-	CopyMemory(wParam->points, polygonSC, sizeof(DELTA_POINT) * wParam->numPoints);
+	wParam->points = (DELTA_POINT*)&wParam[1];
+	if (size > 0)
+		CopyMemory(wParam->points, polygonSC->points, size);
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PolygonSC),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_PolygonCB(rdpContext* context, POLYGON_CB_ORDER* polygonCB)
 {
 	POLYGON_CB_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polygonCB)
 		return FALSE;
 
-	wParam = (POLYGON_CB_ORDER*)malloc(sizeof(POLYGON_CB_ORDER));
+	const size_t size = sizeof(DELTA_POINT) * polygonCB->numPoints;
+	wParam = update_message_alloc(context, sizeof(POLYGON_CB_ORDER) + size, &lParam);
 
 	if (!wParam)
 		return FALSE;
 
 	CopyMemory(wParam, polygonCB, sizeof(POLYGON_CB_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
-
-	if (!wParam->points)
-	{
-		free(wParam);
-		return FALSE;
-	}
-
-	CopyMemory(wParam->points, polygonCB, sizeof(DELTA_POINT) * wParam->numPoints);
+	wParam->points = (DELTA_POINT*)&wParam[1];
+	if (size > 0)
+		CopyMemory(wParam->points, polygonCB->points, size);
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PolygonCB),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_EllipseSC(rdpContext* context, const ELLIPSE_SC_ORDER* ellipseSC)
 {
 	ELLIPSE_SC_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !ellipseSC)
 		return FALSE;
 
-	wParam = (ELLIPSE_SC_ORDER*)malloc(sizeof(ELLIPSE_SC_ORDER));
+	wParam = update_message_copy(context, ellipseSC, sizeof(ELLIPSE_SC_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, ellipseSC, sizeof(ELLIPSE_SC_ORDER));
-
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, EllipseSC),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 static BOOL update_message_EllipseCB(rdpContext* context, const ELLIPSE_CB_ORDER* ellipseCB)
 {
 	ELLIPSE_CB_ORDER* wParam = NULL;
+	void* lParam = NULL;
 	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !ellipseCB)
 		return FALSE;
 
-	wParam = (ELLIPSE_CB_ORDER*)malloc(sizeof(ELLIPSE_CB_ORDER));
+	wParam = update_message_copy(context, ellipseCB, sizeof(ELLIPSE_CB_ORDER), &lParam);
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, ellipseCB, sizeof(ELLIPSE_CB_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
 	up = update_cast(context->update);
 	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, EllipseCB),
-	                         (void*)wParam, NULL);
+	                         (void*)wParam, lParam);
 }
 
 /* Secondary Update */
@@ -1696,10 +1875,14 @@ static BOOL update_message_free_update_class(wMessage* msg, int type)
 			break;
 
 		case Update_EndPaint:
-			break;
+		{
+			rdp_update_internal* up = update_cast(context->update);
+			update_message_arena_release(up->arena, msg->wParam);
+		}
+		break;
 
 		case Update_SetBounds:
-			free(msg->wParam);
+			update_message_free(msg, msg->wParam);
 			break;
 
 		case Update_Synchronize:
@@ -1862,110 +2045,32 @@ static BOOL update_message_free_primary_update_class(wMessage* msg, int type)
 	if (!msg)
 		return FALSE;
 
+	/* variable length data is allocated together with the order */
 	switch (type)
 	{
 		case PrimaryUpdate_DstBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_PatBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_ScrBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_OpaqueRect:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_DrawNineGrid:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiDstBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiPatBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiScrBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiOpaqueRect:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiDrawNineGrid:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_LineTo:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_Polyline:
-		{
-			POLYLINE_ORDER* wParam = (POLYLINE_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_MemBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_Mem3Blt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_SaveBitmap:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_GlyphIndex:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_FastIndex:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_FastGlyph:
-		{
-			FAST_GLYPH_ORDER* wParam = (FAST_GLYPH_ORDER*)msg->wParam;
-			free(wParam->glyphData.aj);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_PolygonSC:
-		{
-			POLYGON_SC_ORDER* wParam = (POLYGON_SC_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_PolygonCB:
-		{
-			POLYGON_CB_ORDER* wParam = (POLYGON_CB_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_EllipseSC:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_EllipseCB:
-			free(msg->wParam);
+			update_message_free(msg, msg->wParam);
 			break;
 
 		default:
@@ -2887,6 +2992,12 @@ rdpUpdateProxy* update_message_proxy_new(rdpUpdate* update)
 		return NULL;
 
 	message->update = update;
+
+	/* kept with the update, queued messages may outlive the proxy */
+	rdp_update_internal* up = update_cast(update);
+	if (!up->arena)
+		up->arena = update_message_arena_new();
+
 	update_message_register_interface(message, update);
 
 	if (!(message->thread = CreateThread(NULL, 0, update_message_proxy_thread, update, 0, NULL)))
@@ -128,6 +128,13 @@ struct rdp_update_proxy
 	HANDLE thread;
 };
 
+typedef struct rdp_update_arena rdpUpdateArena;
+
+FREERDP_LOCAL void update_message_arena_free(rdpUpdateArena* arena);
+
+WINPR_ATTR_MALLOC(update_message_arena_free, 1)
+FREERDP_LOCAL rdpUpdateArena* update_message_arena_new(void);
+
 FREERDP_LOCAL int update_message_queue_process_message(rdpUpdate* update, wMessage* message);
 FREERDP_LOCAL int update_message_queue_free_message(wMessage* message);
 
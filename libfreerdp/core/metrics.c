@@ -19,7 +19,83 @@
 
 #include <freerdp/config.h>
 
+#include <stdarg.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
+
 #include "rdp.h"
+#include "metrics.h"
+
+typedef struct
+{
+	char* name;
+	FreeRDPMetricValue value;
+} rdp_metric;
+
+typedef struct
+{
+	UINT16 id;
+	UINT64 bytes[2];
+	UINT64 pdus[2];
+} rdp_metrics_channel;
+
+typedef struct
+{
+	rdpMetrics common;
+
+	CRITICAL_SECTION lock;
+	rdp_metric* metrics;
+	size_t count;
+	rdp_metrics_channel* channels;
+	size_t channelCount;
+} rdp_metrics_internal;
+
+static inline rdp_metrics_internal* metrics_cast(rdpMetrics* metrics)
+{
+	WINPR_ASSERT(metrics);
+	return (rdp_metrics_internal*)metrics;
+}
+
+static const char* metrics_type_string(FreeRDPMetricType type)
+{
+	switch (type)
+	{
+		case FREERDP_METRIC_COUNTER:
+			return "counter";
+		case FREERDP_METRIC_GAUGE:
+			return "gauge";
+		case FREERDP_METRIC_HISTOGRAM:
+			return "histogram";
+		default:
+			return "untyped";
+	}
+}
+
+static BOOL metrics_valid_name(const char* name)
+{
+	if (!name || (*name == '\0'))
+		return FALSE;
+
+	for (const char* cur = name; *cur != '\0'; cur++)
+	{
+		const char c = *cur;
+		if (((c < 'a') || (c > 'z')) && ((c < 'A') || (c > 'Z')) && ((c < '0') || (c > '9')) &&
+		    (c != '_'))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static size_t metrics_bucket(UINT64 value)
+{
+	size_t bucket = 0;
+	while ((bucket < FREERDP_METRICS_HISTOGRAM_BUCKETS) && (value > (1ull << bucket)))
+		bucket++;
+	return bucket;
+}
 
 double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32 CompressedBytes)
 {
@@ -37,21 +113,507 @@ double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32
 	return CompressionRatio;
 }
 
+SSIZE_T metrics_register(rdpMetrics* metrics, const char* name, FreeRDPMetricType type)
+{
+	SSIZE_T id = -1;
+
+	if (!metrics || !metrics_valid_name(name))
+		return -1;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+	for (size_t x = 0; x < priv->count; x++)
+	{
+		const rdp_metric* cur = &priv->metrics[x];
+		if (strcmp(cur->name, name) == 0)
+		{
+			if (cur->value.type == type)
+				id = (SSIZE_T)x;
+			goto out;
+		}
+	}
+
+	rdp_metric* tmp = realloc(priv->metrics, sizeof(rdp_metric) * (priv->count + 1));
+	if (!tmp)
+		goto out;
+	priv->metrics = tmp;
+
+	rdp_metric* metric = &priv->metrics[priv->count];
+	memset(metric, 0, sizeof(rdp_metric));
+	metric->name = _strdup(name);
+	if (!metric->name)
+		goto out;
+	metric->value.type = type;
+	id = (SSIZE_T)priv->count++;
+
+out:
+	LeaveCriticalSection(&priv->lock);
+	return id;
+}
+
+BOOL metrics_record(rdpMetrics* metrics, SSIZE_T id, UINT64 value)
+{
+	BOOL rc = FALSE;
+
+	if (!metrics || (id < 0))
+		return FALSE;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+	if ((size_t)id < priv->count)
+	{
+		FreeRDPMetricValue* cur = &priv->metrics[id].value;
+		switch (cur->type)
+		{
+			case FREERDP_METRIC_COUNTER:
+				cur->value += value;
+				break;
+			case FREERDP_METRIC_GAUGE:
+				cur->value = value;
+				break;
+			case FREERDP_METRIC_HISTOGRAM:
+				if ((cur->count == 0) || (value < cur->min))
+					cur->min = value;
+				if (value > cur->max)
+					cur->max = value;
+				cur->count++;
+				cur->sum += value;
+				cur->buckets[metrics_bucket(value)]++;
+				break;
+			default:
+				break;
+		}
+		rc = TRUE;
+	}
+	LeaveCriticalSection(&priv->lock);
+	return rc;
+}
+
+BOOL metrics_get(rdpMetrics* metrics, const char* name, FreeRDPMetricValue* value)
+{
+	BOOL rc = FALSE;
+
+	if (!metrics || !name || !value)
+		return FALSE;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+	for (size_t x = 0; x < priv->count; x++)
+	{
+		const rdp_metric* cur = &priv->metrics[x];
+		if (strcmp(cur->name, name) == 0)
+		{
+			*value = cur->value;
+			rc = TRUE;
+			break;
+		}
+	}
+	LeaveCriticalSection(&priv->lock);
+	return rc;
+}
+
+void metrics_channel_record(rdpMetrics* metrics, UINT16 channelId, BOOL outbound, size_t bytes)
+{
+	if (!metrics)
+		return;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+
+	rdp_metrics_channel* channel = NULL;
+	for (size_t x = 0; x < priv->channelCount; x++)
+	{
+		if (priv->channels[x].id == channelId)
+		{
+			channel = &priv->channels[x];
+			break;
+		}
+	}
+
+	if (!channel)
+	{
+		rdp_metrics_channel* tmp =
+		    realloc(priv->channels, sizeof(rdp_metrics_channel) * (priv->channelCount + 1));
+		if (tmp)
+		{
+			priv->channels = tmp;
+			channel = &priv->channels[priv->channelCount++];
+			memset(channel, 0, sizeof(rdp_metrics_channel));
+			channel->id = channelId;
+		}
+	}
+
+	if (channel)
+	{
+		const size_t dir = outbound ? 1 : 0;
+		channel->bytes[dir] += bytes;
+		channel->pdus[dir]++;
+	}
+	LeaveCriticalSection(&priv->lock);
+}
+
+BOOL metrics_channel_get(rdpMetrics* metrics, UINT16 channelId, UINT64* bytesIn, UINT64* bytesOut,
+                         UINT64* pdusIn, UINT64* pdusOut)
+{
+	BOOL rc = FALSE;
+
+	if (!metrics)
+		return FALSE;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+	for (size_t x = 0; x < priv->channelCount; x++)
+	{
+		const rdp_metrics_channel* cur = &priv->channels[x];
+		if (cur->id != channelId)
+			continue;
+
+		if (bytesIn)
+			*bytesIn = cur->bytes[0];
+		if (bytesOut)
+			*bytesOut = cur->bytes[1];
+		if (pdusIn)
+			*pdusIn = cur->pdus[0];
+		if (pdusOut)
+			*pdusOut = cur->pdus[1];
+		rc = TRUE;
+		break;
+	}
+	LeaveCriticalSection(&priv->lock);
+	return rc;
+}
+
+WINPR_ATTR_FORMAT_ARG(2, 3)
+static BOOL metrics_printf(wStream* s, WINPR_FORMAT_ARG const char* fmt, ...)
+{
+	va_list ap = { 0 };
+	va_start(ap, fmt);
+	const int rc = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	if (rc < 0)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, (size_t)rc + 1))
+		return FALSE;
+
+	char* ptr = Stream_PointerAs(s, char);
+	va_start(ap, fmt);
+	const int rc2 = vsnprintf(ptr, (size_t)rc + 1, fmt, ap);
+	va_end(ap);
+	if (rc != rc2)
+		return FALSE;
+	return Stream_SafeSeek(s, (size_t)rc2);
+}
+
+/* channel names are chosen by the peer, only pass through what needs no escaping */
+static void metrics_channel_name(const rdpContext* context, UINT16 channelId, char* name,
+                                 size_t size)
+{
+	WINPR_ASSERT(name);
+	WINPR_ASSERT(size > 0);
+
+	name[0] = '\0';
+	if (!context || !context->rdp || !context->rdp->mcs)
+		return;
+
+	const rdpMcs* mcs = context->rdp->mcs;
+	for (UINT32 x = 0; x < mcs->channelCount; x++)
+	{
+		const rdpMcsChannel* cur = &mcs->channels[x];
+		if (cur->ChannelId != channelId)
+			continue;
+
+		size_t len = 0;
+		for (; (len + 1 < size) && (len < ARRAYSIZE(cur->Name)) && (cur->Name[len] != '\0');
+		     len++)
+		{
+			const char c = cur->Name[len];
+			const BOOL valid = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+			                   ((c >= '0') && (c <= '9')) || (c == '_');
+			name[len] = valid ? c : '_';
+		}
+		name[len] = '\0';
+		break;
+	}
+}
+
+typedef struct
+{
+	wStream* s;
+	size_t index;
+	size_t family; /* prometheus only, index into metrics_memory_families */
+} metrics_memory_export;
+
+static const struct
+{
+	const char* name;
+	const char* type;
+} metrics_memory_families[] = { { "memory_live_bytes", "gauge" },
+	                            { "memory_peak_bytes", "gauge" },
+	                            { "memory_allocations", "counter" },
+	                            { "memory_allocated_bytes", "counter" } };
+
+static BOOL metrics_memory_json(const char* name, const wMemoryTagStatistics* stats, void* arg)
+{
+	metrics_memory_export* exp = arg;
+	WINPR_ASSERT(exp);
+	WINPR_ASSERT(stats);
+
+	return metrics_printf(exp->s,
+	                      "%s{\"tag\":\"%s\",\"live\":%" PRIu64 ",\"peak\":%" PRIu64
+	                      ",\"allocations\":%" PRIu64 ",\"allocated\":%" PRIu64 "}",
+	                      (exp->index++ > 0) ? "," : "", name, stats->live, stats->peak,
+	                      stats->allocations, stats->allocated);
+}
+
+static BOOL metrics_memory_prometheus(const char* name, const wMemoryTagStatistics* stats,
+                                      void* arg)
+{
+	metrics_memory_export* exp = arg;
+	WINPR_ASSERT(exp);
+	WINPR_ASSERT(stats);
+
+	const UINT64 values[] = { stats->live, stats->peak, stats->allocations, stats->allocated };
+	WINPR_ASSERT(exp->family < ARRAYSIZE(values));
+	return metrics_printf(exp->s, "freerdp_%s{tag=\"%s\"} %" PRIu64 "\n",
+	                      metrics_memory_families[exp->family].name, name, values[exp->family]);
+}
+
+static BOOL metrics_export_json(rdp_metrics_internal* priv, wStream* s)
+{
+	const rdpMetrics* metrics = &priv->common;
+	const rdpRdp* rdp = metrics->context ? metrics->context->rdp : NULL;
+
+	if (!metrics_printf(s,
+	                    "{\"bytes_in\":%" PRIu64 ",\"bytes_out\":%" PRIu64 ",\"pdus_in\":%" PRIu64
+	                    ",\"pdus_out\":%" PRIu64 ",\"compressed_bytes\":%" PRIu64
+	                    ",\"uncompressed_bytes\":%" PRIu64 ",\"channels\":[",
+	                    rdp ? rdp->inBytes : 0, rdp ? rdp->outBytes : 0, rdp ? rdp->inPackets : 0,
+	                    rdp ? rdp->outPackets : 0, metrics->TotalCompressedBytes,
+	                    metrics->TotalUncompressedBytes))
+		return FALSE;
+
+	for (size_t x = 0; x < priv->channelCount; x++)
+	{
+		const rdp_metrics_channel* cur = &priv->channels[x];
+		char name[CHANNEL_NAME_LEN + 1] = { 0 };
+		metrics_channel_name(metrics->context, cur->id, name, sizeof(name));
+		if (!metrics_printf(s,
+		                    "%s{\"id\":%" PRIu16 ",\"name\":\"%s\",\"bytes_in\":%" PRIu64
+		                    ",\"bytes_out\":%" PRIu64 ",\"pdus_in\":%" PRIu64
+		                    ",\"pdus_out\":%" PRIu64 "}",
+		                    (x > 0) ? "," : "", cur->id, name, cur->bytes[0], cur->bytes[1],
+		                    cur->pdus[0], cur->pdus[1]))
+			return FALSE;
+	}
+
+	if (!metrics_printf(s, "],\"memory\":["))
+		return FALSE;
+
+	metrics_memory_export exp = { .s = s };
+	if (!MemoryTag_Foreach(metrics_memory_json, &exp))
+		return FALSE;
+
+	if (!metrics_printf(s, "],\"metrics\":{"))
+		return FALSE;
+
+	for (size_t x = 0; x < priv->count; x++)
+	{
+		const rdp_metric* cur = &priv->metrics[x];
+		const FreeRDPMetricValue* v = &cur->value;
+		if (!metrics_printf(s, "%s\"%s\":{\"type\":\"%s\"", (x > 0) ? "," : "", cur->name,
+		                    metrics_type_string(v->type)))
+			return FALSE;
+
+		if (v->type != FREERDP_METRIC_HISTOGRAM)
+		{
+			if (!metrics_printf(s, ",\"value\":%" PRIu64 "}", v->value))
+				return FALSE;
+			continue;
+		}
+
+		if (!metrics_printf(s,
+		                    ",\"count\":%" PRIu64 ",\"sum\":%" PRIu64 ",\"min\":%" PRIu64
+		                    ",\"max\":%" PRIu64 ",\"buckets\":[",
+		                    v->count, v->sum, v->min, v->max))
+			return FALSE;
+		for (size_t y = 0; y < ARRAYSIZE(v->buckets); y++)
+		{
+			if (!metrics_printf(s, "%s%" PRIu64, (y > 0) ? "," : "", v->buckets[y]))
+				return FALSE;
+		}
+		if (!metrics_printf(s, "]}"))
+			return FALSE;
+	}
+
+	return metrics_printf(s, "}}\n");
+}
+
+static BOOL metrics_export_prometheus(rdp_metrics_internal* priv, wStream* s)
+{
+	const rdpMetrics* metrics = &priv->common;
+	const rdpRdp* rdp = metrics->context ? metrics->context->rdp : NULL;
+
+	if (!metrics_printf(s,
+	                    "# TYPE freerdp_bytes counter\n"
+	                    "freerdp_bytes{direction=\"in\"} %" PRIu64 "\n"
+	                    "freerdp_bytes{direction=\"out\"} %" PRIu64 "\n"
+	                    "# TYPE freerdp_pdus counter\n"
+	                    "freerdp_pdus{direction=\"in\"} %" PRIu64 "\n"
+	                    "freerdp_pdus{direction=\"out\"} %" PRIu64 "\n"
+	                    "# TYPE freerdp_compressed_bytes counter\n"
+	                    "freerdp_compressed_bytes %" PRIu64 "\n"
+	                    "# TYPE freerdp_uncompressed_bytes counter\n"
+	                    "freerdp_uncompressed_bytes %" PRIu64 "\n",
+	                    rdp ? rdp->inBytes : 0, rdp ? rdp->outBytes : 0, rdp ? rdp->inPackets : 0,
+	                    rdp ? rdp->outPackets : 0, metrics->TotalCompressedBytes,
+	                    metrics->TotalUncompressedBytes))
+		return FALSE;
+
+	const char* channelTypes[] = { "bytes", "pdus" };
+	for (size_t t = 0; (priv->channelCount > 0) && (t < ARRAYSIZE(channelTypes)); t++)
+	{
+		if (!metrics_printf(s, "# TYPE freerdp_channel_%s counter\n", channelTypes[t]))
+			return FALSE;
+
+		for (size_t x = 0; x < priv->channelCount; x++)
+		{
+			const rdp_metrics_channel* cur = &priv->channels[x];
+			const UINT64* values = (t == 0) ? cur->bytes : cur->pdus;
+			char name[CHANNEL_NAME_LEN + 1] = { 0 };
+			metrics_channel_name(metrics->context, cur->id, name, sizeof(name));
+			for (size_t dir = 0; dir < 2; dir++)
+			{
+				if (!metrics_printf(s,
+				                    "freerdp_channel_%s{id=\"%" PRIu16
+				                    "\",channel=\"%s\",direction=\"%s\"} %" PRIu64 "\n",
+				                    channelTypes[t], cur->id, name, (dir == 0) ? "in" : "out",
+				                    values[dir]))
+					return FALSE;
+			}
+		}
+	}
+
+	for (size_t t = 0; t < ARRAYSIZE(metrics_memory_families); t++)
+	{
+		metrics_memory_export exp = { .s = s, .family = t };
+		if (!metrics_printf(s, "# TYPE freerdp_%s %s\n", metrics_memory_families[t].name,
+		                    metrics_memory_families[t].type))
+			return FALSE;
+		if (!MemoryTag_Foreach(metrics_memory_prometheus, &exp))
+			return FALSE;
+	}
+
+	for (size_t x = 0; x < priv->count; x++)
+	{
+		const rdp_metric* cur = &priv->metrics[x];
+		const FreeRDPMetricValue* v = &cur->value;
+		if (!metrics_printf(s, "# TYPE freerdp_%s %s\n", cur->name, metrics_type_string(v->type)))
+			return FALSE;
+
+		if (v->type != FREERDP_METRIC_HISTOGRAM)
+		{
+			if (!metrics_printf(s, "freerdp_%s %" PRIu64 "\n", cur->name, v->value))
+				return FALSE;
+			continue;
+		}
+
+		/* prometheus buckets are cumulative */
+		UINT64 total = 0;
+		for (size_t y = 0; y < FREERDP_METRICS_HISTOGRAM_BUCKETS; y++)
+		{
+			total += v->buckets[y];
+			if (!metrics_printf(s, "freerdp_%s_bucket{le=\"%" PRIu64 "\"} %" PRIu64 "\n",
+			                    cur->name, 1ull << y, total))
+				return FALSE;
+		}
+		if (!metrics_printf(s,
+		                    "freerdp_%s_bucket{le=\"+Inf\"} %" PRIu64 "\n"
+		                    "freerdp_%s_sum %" PRIu64 "\n"
+		                    "freerdp_%s_count %" PRIu64 "\n",
+		                    cur->name, v->count, cur->name, v->sum, cur->name, v->count))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+char* metrics_export(rdpMetrics* metrics, FreeRDPMetricsFormat format, size_t* plength)
+{
+	BOOL rc = FALSE;
+	char* str = NULL;
+
+	if (!metrics)
+		return NULL;
+
+	wStream* s = Stream_New(NULL, 1024);
+	if (!s)
+		return NULL;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	EnterCriticalSection(&priv->lock);
+	switch (format)
+	{
+		case FREERDP_METRICS_FORMAT_JSON:
+			rc = metrics_export_json(priv, s);
+			break;
+		case FREERDP_METRICS_FORMAT_PROMETHEUS:
+			rc = metrics_export_prometheus(priv, s);
+			break;
+		default:
+			break;
+	}
+	LeaveCriticalSection(&priv->lock);
+
+	if (rc && Stream_EnsureRemainingCapacity(s, 1))
+	{
+		const size_t length = Stream_GetPosition(s);
+		Stream_Write_UINT8(s, '\0');
+		if (plength)
+			*plength = length;
+		str = (char*)Stream_Buffer(s);
+		Stream_Free(s, FALSE);
+	}
+	else
+		Stream_Free(s, TRUE);
+	return str;
+}
+
 rdpMetrics* metrics_new(rdpContext* context)
 {
-	rdpMetrics* metrics = NULL;
+	rdp_metrics_internal* priv = (rdp_metrics_internal*)calloc(1, sizeof(rdp_metrics_internal));
 
-	metrics = (rdpMetrics*)calloc(1, sizeof(rdpMetrics));
+	if (!priv)
+		return NULL;
 
-	if (metrics)
+	priv->common.context = context;
+	InitializeCriticalSection(&priv->lock);
+
+	/* the order must match the METRICS_* ids */
+	if ((metrics_register(&priv->common, "transport_write_stalls", FREERDP_METRIC_COUNTER) !=
+	     METRICS_TRANSPORT_WRITE_STALLS) ||
+	    (metrics_register(&priv->common, "transport_write_stall_us", FREERDP_METRIC_HISTOGRAM) !=
+	     METRICS_TRANSPORT_WRITE_STALL_US) ||
+	    (metrics_register(&priv->common, "channel_queue_depth", FREERDP_METRIC_GAUGE) !=
+	     METRICS_CHANNEL_QUEUE_DEPTH))
 	{
-		metrics->context = context;
+		metrics_free(&priv->common);
+		return NULL;
 	}
 
-	return metrics;
+	return &priv->common;
 }
 
 void metrics_free(rdpMetrics* metrics)
 {
-	free(metrics);
+	if (!metrics)
+		return;
+
+	rdp_metrics_internal* priv = metrics_cast(metrics);
+	for (size_t x = 0; x < priv->count; x++)
+		free(priv->metrics[x].name);
+	free(priv->metrics);
+	free(priv->channels);
+	DeleteCriticalSection(&priv->lock);
+	free(priv);
 }
@@ -0,0 +1,37 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Protocol Metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CORE_METRICS_H
+#define FREERDP_LIB_CORE_METRICS_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/metrics.h>
+
+/* metrics every session has, registered in this order by metrics_new */
+enum
+{
+	METRICS_TRANSPORT_WRITE_STALLS,
+	METRICS_TRANSPORT_WRITE_STALL_US,
+	METRICS_CHANNEL_QUEUE_DEPTH
+};
+
+FREERDP_LOCAL void metrics_channel_record(rdpMetrics* metrics, UINT16 channelId, BOOL outbound,
+                                          size_t bytes);
+
+#endif /* FREERDP_LIB_CORE_METRICS_H */
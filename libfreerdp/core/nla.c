@@ -136,6 +136,11 @@ struct rdp_nla
 	SmartcardCertInfo* smartcardCert;
 	BYTE certSha1[20];
 	BOOL earlyUserAuth;
+	UINT64 sendTime; /* of the last request, to time the authentication rounds */
+
+	/* Reused for every TSRequest sent, lifetime nla_new -> nla_free */
+	WinPrAsn1Encoder* enc;
+	wStream* sendStream;
 };
 
 static BOOL nla_send(rdpNla* nla);
@@ -188,8 +193,15 @@ static BOOL nla_sec_buffer_alloc(SecBuffer* buffer, size_t size)
 static BOOL nla_sec_buffer_alloc_from_data(SecBuffer* buffer, const BYTE* data, size_t offset,
                                            size_t size)
 {
-	if (!nla_sec_buffer_alloc(buffer, offset + size))
-		return FALSE;
+	WINPR_ASSERT(buffer);
+
+	/* tokens of the same size are exchanged in every round, keep the buffer then */
+	if (!buffer->pvBuffer || (buffer->cbBuffer != offset + size))
+	{
+		if (!nla_sec_buffer_alloc(buffer, offset + size))
+			return FALSE;
+	}
+	buffer->BufferType = SECBUFFER_TOKEN;
 
 	WINPR_ASSERT(buffer);
 	BYTE* pb = buffer->pvBuffer;
@@ -1781,15 +1793,16 @@ static BOOL nla_write_octet_string_free(WinPrAsn1Encoder* enc, SecBuffer* buffer
 BOOL nla_send(rdpNla* nla)
 {
 	BOOL rc = FALSE;
-	wStream* s = NULL;
 	size_t length = 0;
-	WinPrAsn1Encoder* enc = NULL;
 
 	WINPR_ASSERT(nla);
 
-	enc = WinPrAsn1Encoder_New(WINPR_ASN1_DER);
-	if (!enc)
-		return FALSE;
+	WinPrAsn1Encoder* enc = nla->enc;
+	wStream* s = nla->sendStream;
+	WINPR_ASSERT(enc);
+	WINPR_ASSERT(s);
+
+	WinPrAsn1Encoder_Reset(enc);
 
 	/* TSRequest */
 	WLog_DBG(TAG, "----->> sending...");
@@ -1857,8 +1870,8 @@ BOOL nla_send(rdpNla* nla)
 	if (!WinPrAsn1EncStreamSize(enc, &length))
 		goto fail;
 
-	s = Stream_New(NULL, length);
-	if (!s)
+	Stream_SetPosition(s, 0);
+	if (!Stream_EnsureCapacity(s, length))
 		goto fail;
 
 	if (!WinPrAsn1EncToStream(enc, s))
@@ -1867,11 +1880,10 @@ BOOL nla_send(rdpNla* nla)
 	WLog_DBG(TAG, "[%" PRIuz " bytes]", length);
 	if (transport_write(nla->transport, s) < 0)
 		goto fail;
+	nla->sendTime = winpr_GetTickCount64NS();
 	rc = TRUE;
 
 fail:
-	Stream_Free(s, TRUE);
-	WinPrAsn1Encoder_Free(&enc);
 	return rc;
 }
 
@@ -1988,6 +2000,14 @@ int nla_recv_pdu(rdpNla* nla, wStream* s)
 	WINPR_ASSERT(nla);
 	WINPR_ASSERT(s);
 
+	if (!nla->server && (nla->sendTime != 0))
+	{
+		WINPR_ASSERT(nla->rdpcontext);
+		rdp_timeline_add(nla->rdpcontext->rdp, nla_get_state_str(nla_get_state(nla)),
+		                 nla->sendTime);
+		nla->sendTime = 0;
+	}
+
 	if (nla_get_state(nla) == NLA_STATE_EARLY_USER_AUTH)
 	{
 		UINT32 code = 0;
@@ -2122,6 +2142,14 @@ rdpNla* nla_new(rdpContext* context, rdpTransport* transport)
 	if (!nla->auth)
 		goto cleanup;
 
+	nla->enc = WinPrAsn1Encoder_New(WINPR_ASN1_DER);
+	if (!nla->enc)
+		goto cleanup;
+
+	nla->sendStream = Stream_New(NULL, 4096);
+	if (!nla->sendStream)
+		goto cleanup;
+
 	/* init to 0 or we end up freeing a bad pointer if the alloc fails */
 	if (!nla_sec_buffer_alloc(&nla->ClientNonce, NonceLength))
 		goto cleanup;
@@ -2153,6 +2181,8 @@ void nla_free(rdpNla* nla)
 	nla_buffer_free(nla);
 	sspi_SecBufferFree(&nla->tsCredentials);
 	credssp_auth_free(nla->auth);
+	WinPrAsn1Encoder_Free(&nla->enc);
+	Stream_Free(nla->sendStream, TRUE);
 
 	sspi_FreeAuthIdentity(nla->identity);
 	free(nla->pkinitArgs);
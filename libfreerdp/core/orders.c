@@ -511,47 +511,48 @@ static BOOL check_primary_order_supported(wLog* log, const rdpSettings* settings
 	return check_order_activated(log, settings, orderName, condition, extendedMessage);
 }
 
-WINPR_PRAGMA_DIAG_PUSH
-WINPR_PRAGMA_DIAG_IGNORED_FORMAT_NONLITERAL
 static const char* primary_order_string(UINT32 orderType)
 {
-	const char* orders[] = { "[0x%02" PRIx8 "] DstBlt",
-		                     "[0x%02" PRIx8 "] PatBlt",
-		                     "[0x%02" PRIx8 "] ScrBlt",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] DrawNineGrid",
-		                     "[0x%02" PRIx8 "] MultiDrawNineGrid",
-		                     "[0x%02" PRIx8 "] LineTo",
-		                     "[0x%02" PRIx8 "] OpaqueRect",
-		                     "[0x%02" PRIx8 "] SaveBitmap",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] MemBlt",
-		                     "[0x%02" PRIx8 "] Mem3Blt",
-		                     "[0x%02" PRIx8 "] MultiDstBlt",
-		                     "[0x%02" PRIx8 "] MultiPatBlt",
-		                     "[0x%02" PRIx8 "] MultiScrBlt",
-		                     "[0x%02" PRIx8 "] MultiOpaqueRect",
-		                     "[0x%02" PRIx8 "] FastIndex",
-		                     "[0x%02" PRIx8 "] PolygonSC",
-		                     "[0x%02" PRIx8 "] PolygonCB",
-		                     "[0x%02" PRIx8 "] Polyline",
-		                     "[0x%02" PRIx8 "] UNUSED",
-		                     "[0x%02" PRIx8 "] FastGlyph",
-		                     "[0x%02" PRIx8 "] EllipseSC",
-		                     "[0x%02" PRIx8 "] EllipseCB",
-		                     "[0x%02" PRIx8 "] GlyphIndex" };
-	const char* fmt = "[0x%02" PRIx8 "] UNKNOWN";
+	/* looked up for every order, so the known names are not formatted */
+	static const char* orders[] = { "[0x00] DstBlt",
+		                            "[0x01] PatBlt",
+		                            "[0x02] ScrBlt",
+		                            "[0x03] UNUSED",
+		                            "[0x04] UNUSED",
+		                            "[0x05] UNUSED",
+		                            "[0x06] UNUSED",
+		                            "[0x07] DrawNineGrid",
+		                            "[0x08] MultiDrawNineGrid",
+		                            "[0x09] LineTo",
+		                            "[0x0a] OpaqueRect",
+		                            "[0x0b] SaveBitmap",
+		                            "[0x0c] UNUSED",
+		                            "[0x0d] MemBlt",
+		                            "[0x0e] Mem3Blt",
+		                            "[0x0f] MultiDstBlt",
+		                            "[0x10] MultiPatBlt",
+		                            "[0x11] MultiScrBlt",
+		                            "[0x12] MultiOpaqueRect",
+		                            "[0x13] FastIndex",
+		                            "[0x14] PolygonSC",
+		                            "[0x15] PolygonCB",
+		                            "[0x16] Polyline",
+		                            "[0x17] UNUSED",
+		                            "[0x18] FastGlyph",
+		                            "[0x19] EllipseSC",
+		                            "[0x1a] EllipseCB",
+		                            "[0x1b] GlyphIndex" };
 	static char buffer[64] = { 0 };
 
 	if (orderType < ARRAYSIZE(orders))
-		fmt = orders[orderType];
+		return orders[orderType];
 
-	(void)sprintf_s(buffer, ARRAYSIZE(buffer), fmt, orderType);
+	(void)sprintf_s(buffer, ARRAYSIZE(buffer), "[0x%02" PRIx32 "] UNKNOWN", orderType);
 	return buffer;
 }
+
+WINPR_PRAGMA_DIAG_PUSH
+WINPR_PRAGMA_DIAG_IGNORED_FORMAT_NONLITERAL
 static const char* secondary_order_string(UINT32 orderType)
 {
 	const char* orders[] = { "[0x%02" PRIx8 "] Cache Bitmap",
@@ -1310,17 +1311,144 @@ static INLINE BOOL FIELD_SKIP_BUFFER16(wStream* s, UINT32 TARGET_LEN)
 
 	return TRUE;
 }
+
+typedef enum
+{
+	ORDER_LAYOUT_COORD,
+	ORDER_LAYOUT_BYTE,
+	ORDER_LAYOUT_UINT16,
+	ORDER_LAYOUT_INT16,
+	ORDER_LAYOUT_UINT32,
+	ORDER_LAYOUT_COLOR,
+	ORDER_LAYOUT_COLOR_BYTE
+} ORDER_LAYOUT_TYPE;
+
+/**
+ * One field of a primary order: the field flag number, the wire type and the
+ * offset of the 32bit member it is read into. Fields sharing a number are read
+ * one after the other when the flag is set.
+ */
+typedef struct
+{
+	BYTE number;
+	BYTE type;
+	BYTE shift;
+	size_t offset;
+} ORDER_FIELD_LAYOUT;
+
+#define ORDER_LAYOUT(number, type, order, member) \
+	{                                             \
+		number, type, 0, offsetof(order, member)  \
+	}
+
+#define ORDER_LAYOUT_SHIFT(number, shift, order, member)                \
+	{                                                                   \
+		number, ORDER_LAYOUT_COLOR_BYTE, shift, offsetof(order, member) \
+	}
+
+/**
+ * Reads the fields present in fieldFlags. The length of all of them is checked
+ * once up front, the values are then read without further checks.
+ */
+static BOOL read_order_fields(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
+                              const ORDER_FIELD_LAYOUT* layout, size_t count, void* order)
+{
+	static const BYTE sizes[] = { 2, 1, 2, 2, 4, 3, 1 };
+	BYTE* base = order;
+	size_t length = 0;
+
+	WINPR_ASSERT(orderName);
+	WINPR_ASSERT(orderInfo);
+	WINPR_ASSERT(layout);
+	WINPR_ASSERT(order);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const ORDER_FIELD_LAYOUT* field = &layout[x];
+		WINPR_ASSERT(field->type < ARRAYSIZE(sizes));
+
+		if (!order_field_flag_is_set(orderInfo, field->number))
+			continue;
+		if ((field->type == ORDER_LAYOUT_COORD) && orderInfo->deltaCoordinates)
+			length += 1;
+		else
+			length += sizes[field->type];
+	}
+
+	if (!Stream_CheckAndLogRequiredLengthEx(TAG, WLOG_WARN, s, length, 1, "%s fields", orderName))
+		return FALSE;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const ORDER_FIELD_LAYOUT* field = &layout[x];
+		if (!order_field_flag_is_set(orderInfo, field->number))
+			continue;
+
+		INT32* ivalue = (INT32*)&base[field->offset];
+		UINT32* uvalue = (UINT32*)&base[field->offset];
+		switch (field->type)
+		{
+			case ORDER_LAYOUT_COORD:
+				if (orderInfo->deltaCoordinates)
+					*ivalue += Stream_Get_INT8(s);
+				else
+					*ivalue = Stream_Get_INT16(s);
+				break;
+
+			case ORDER_LAYOUT_BYTE:
+				*uvalue = Stream_Get_UINT8(s);
+				break;
+
+			case ORDER_LAYOUT_UINT16:
+				*uvalue = Stream_Get_UINT16(s);
+				break;
+
+			case ORDER_LAYOUT_INT16:
+				*ivalue = Stream_Get_INT16(s);
+				break;
+
+			case ORDER_LAYOUT_UINT32:
+				*uvalue = Stream_Get_UINT32(s);
+				break;
+
+			case ORDER_LAYOUT_COLOR:
+			{
+				const UINT32 red = Stream_Get_UINT8(s);
+				const UINT32 green = Stream_Get_UINT8(s);
+				const UINT32 blue = Stream_Get_UINT8(s);
+				*uvalue = red | (green << 8) | (blue << 16);
+			}
+			break;
+
+			case ORDER_LAYOUT_COLOR_BYTE:
+			{
+				const UINT32 mask = 0x00FFFFFF & ~(0xFFu << field->shift);
+				*uvalue = (*uvalue & mask) | ((UINT32)Stream_Get_UINT8(s) << field->shift);
+			}
+			break;
+
+			default:
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 /* Primary Drawing Orders */
+static const ORDER_FIELD_LAYOUT dstblt_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, DSTBLT_ORDER, nLeftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, DSTBLT_ORDER, nTopRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, DSTBLT_ORDER, nWidth),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, DSTBLT_ORDER, nHeight),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_BYTE, DSTBLT_ORDER, bRop)
+};
+
 static BOOL update_read_dstblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      DSTBLT_ORDER* dstblt)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &dstblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &dstblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &dstblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &dstblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &dstblt->bRop, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_order_fields(orderName, s, orderInfo, dstblt_layout, ARRAYSIZE(dstblt_layout),
+	                         dstblt);
 }
 
 size_t update_approximate_dstblt_order(ORDER_INFO* orderInfo, const DSTBLT_ORDER* dstblt)
@@ -1353,16 +1481,21 @@ BOOL update_write_dstblt_order(wStream* s, ORDER_INFO* orderInfo, const DSTBLT_O
 	return TRUE;
 }
 
+static const ORDER_FIELD_LAYOUT patblt_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, PATBLT_ORDER, nLeftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, PATBLT_ORDER, nTopRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, PATBLT_ORDER, nWidth),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, PATBLT_ORDER, nHeight),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_BYTE, PATBLT_ORDER, bRop),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_COLOR, PATBLT_ORDER, backColor),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COLOR, PATBLT_ORDER, foreColor)
+};
+
 static BOOL update_read_patblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      PATBLT_ORDER* patblt)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &patblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &patblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &patblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &patblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &patblt->bRop, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 6, &patblt->backColor, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &patblt->foreColor, TRUE) &&
+	if (read_order_fields(orderName, s, orderInfo, patblt_layout, ARRAYSIZE(patblt_layout),
+	                      patblt) &&
 	    update_read_brush(s, &patblt->brush,
 	                      get_checked_uint8((orderInfo->fieldFlags >> 7) & 0x1F)))
 		return TRUE;
@@ -1409,20 +1542,23 @@ BOOL update_write_patblt_order(wStream* s, ORDER_INFO* orderInfo, PATBLT_ORDER*
 	return TRUE;
 }
 
+static const ORDER_FIELD_LAYOUT scrblt_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nLeftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nTopRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nWidth),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nHeight),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_BYTE, SCRBLT_ORDER, bRop),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nXSrc),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COORD, SCRBLT_ORDER, nYSrc)
+};
+
 static BOOL update_read_scrblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      SCRBLT_ORDER* scrblt)
 {
 	WINPR_ASSERT(orderInfo);
 	WINPR_ASSERT(scrblt);
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &scrblt->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &scrblt->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &scrblt->nWidth, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &scrblt->nHeight, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &scrblt->bRop, TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 6, &scrblt->nXSrc, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 7, &scrblt->nYSrc, FALSE))
-		return TRUE;
-	return FALSE;
+	return read_order_fields(orderName, s, orderInfo, scrblt_layout, ARRAYSIZE(scrblt_layout),
+	                         scrblt);
 }
 
 size_t update_approximate_scrblt_order(ORDER_INFO* orderInfo, const SCRBLT_ORDER* scrblt)
@@ -1465,45 +1601,23 @@ BOOL update_write_scrblt_order(wStream* s, ORDER_INFO* orderInfo, const SCRBLT_O
 		return FALSE;
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT opaque_rect_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, OPAQUE_RECT_ORDER, nLeftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, OPAQUE_RECT_ORDER, nTopRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, OPAQUE_RECT_ORDER, nWidth),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, OPAQUE_RECT_ORDER, nHeight),
+	ORDER_LAYOUT_SHIFT(5, 0, OPAQUE_RECT_ORDER, color),
+	ORDER_LAYOUT_SHIFT(6, 8, OPAQUE_RECT_ORDER, color),
+	ORDER_LAYOUT_SHIFT(7, 16, OPAQUE_RECT_ORDER, color)
+};
+
 static BOOL update_read_opaque_rect_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           OPAQUE_RECT_ORDER* opaque_rect)
 {
-	BYTE byte = 0;
-	if (!read_order_field_coord(orderName, orderInfo, s, 1, &opaque_rect->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &opaque_rect->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &opaque_rect->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &opaque_rect->nHeight, FALSE))
-		return FALSE;
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_05) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x00FFFF00) | ((UINT32)byte);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_06) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x00FF00FF) | ((UINT32)byte << 8);
-	}
-
-	if ((orderInfo->fieldFlags & ORDER_FIELD_07) != 0)
-	{
-		if (!Stream_CheckAndLogRequiredLength(TAG, s, 1))
-			return FALSE;
-
-		Stream_Read_UINT8(s, byte);
-		opaque_rect->color = (opaque_rect->color & 0x0000FFFF) | ((UINT32)byte << 16);
-	}
-
-	return TRUE;
+	return read_order_fields(orderName, s, orderInfo, opaque_rect_layout,
+	                         ARRAYSIZE(opaque_rect_layout), opaque_rect);
 }
 
 size_t update_approximate_opaque_rect_order(ORDER_INFO* orderInfo,
@@ -1549,17 +1663,20 @@ BOOL update_write_opaque_rect_order(wStream* s, ORDER_INFO* orderInfo,
 	return TRUE;
 }
 
+static const ORDER_FIELD_LAYOUT draw_nine_grid_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, DRAW_NINE_GRID_ORDER, srcLeft),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, DRAW_NINE_GRID_ORDER, srcTop),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, DRAW_NINE_GRID_ORDER, srcRight),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, DRAW_NINE_GRID_ORDER, srcBottom),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_UINT16, DRAW_NINE_GRID_ORDER, bitmapId)
+};
+
 static BOOL update_read_draw_nine_grid_order(const char* orderName, wStream* s,
                                              const ORDER_INFO* orderInfo,
                                              DRAW_NINE_GRID_ORDER* draw_nine_grid)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &draw_nine_grid->srcLeft, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &draw_nine_grid->srcTop, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &draw_nine_grid->srcRight, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &draw_nine_grid->srcBottom, FALSE) &&
-	    read_order_field_uint16(orderName, orderInfo, s, 5, &draw_nine_grid->bitmapId, FALSE))
-		return TRUE;
-	return FALSE;
+	return read_order_fields(orderName, s, orderInfo, draw_nine_grid_layout,
+	                         ARRAYSIZE(draw_nine_grid_layout), draw_nine_grid);
 }
 
 static BOOL update_read_multi_dstblt_order(const char* orderName, wStream* s,
@@ -1778,21 +1895,25 @@ static BOOL update_read_multi_draw_nine_grid_order(const char* orderName, wStrea
 
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT line_to_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_UINT16, LINE_TO_ORDER, backMode),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, LINE_TO_ORDER, nXStart),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, LINE_TO_ORDER, nYStart),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, LINE_TO_ORDER, nXEnd),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COORD, LINE_TO_ORDER, nYEnd),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_COLOR, LINE_TO_ORDER, backColor),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_BYTE, LINE_TO_ORDER, bRop2),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_BYTE, LINE_TO_ORDER, penStyle),
+	ORDER_LAYOUT(9, ORDER_LAYOUT_BYTE, LINE_TO_ORDER, penWidth),
+	ORDER_LAYOUT(10, ORDER_LAYOUT_COLOR, LINE_TO_ORDER, penColor)
+};
+
 static BOOL update_read_line_to_order(const char* orderName, wStream* s,
                                       const ORDER_INFO* orderInfo, LINE_TO_ORDER* line_to)
 {
-	if (read_order_field_uint16(orderName, orderInfo, s, 1, &line_to->backMode, TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &line_to->nXStart, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &line_to->nYStart, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &line_to->nXEnd, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 5, &line_to->nYEnd, FALSE) &&
-	    read_order_field_color(orderName, orderInfo, s, 6, &line_to->backColor, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 7, &line_to->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 8, &line_to->penStyle, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 9, &line_to->penWidth, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 10, &line_to->penColor, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_order_fields(orderName, s, orderInfo, line_to_layout, ARRAYSIZE(line_to_layout),
+	                         line_to);
 }
 
 size_t update_approximate_line_to_order(ORDER_INFO* orderInfo, const LINE_TO_ORDER* line_to)
@@ -1877,21 +1998,26 @@ static BOOL update_read_polyline_order(const char* orderName, wStream* s,
 	return TRUE;
 }
 
+static const ORDER_FIELD_LAYOUT memblt_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_UINT16, MEMBLT_ORDER, cacheId),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nLeftRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nTopRect),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nWidth),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nHeight),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_BYTE, MEMBLT_ORDER, bRop),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nXSrc),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_COORD, MEMBLT_ORDER, nYSrc),
+	ORDER_LAYOUT(9, ORDER_LAYOUT_UINT16, MEMBLT_ORDER, cacheIndex)
+};
+
 static BOOL update_read_memblt_order(const char* orderName, wStream* s, const ORDER_INFO* orderInfo,
                                      MEMBLT_ORDER* memblt)
 {
 	if (!s || !orderInfo || !memblt)
 		return FALSE;
 
-	if (!read_order_field_uint16(orderName, orderInfo, s, 1, &memblt->cacheId, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &memblt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &memblt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &memblt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &memblt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 6, &memblt->bRop, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &memblt->nXSrc, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &memblt->nYSrc, FALSE) ||
-	    !read_order_field_uint16(orderName, orderInfo, s, 9, &memblt->cacheIndex, TRUE))
+	if (!read_order_fields(orderName, s, orderInfo, memblt_layout, ARRAYSIZE(memblt_layout),
+	                       memblt))
 		return FALSE;
 	memblt->colorIndex = (memblt->cacheId >> 8);
 	memblt->cacheId = (memblt->cacheId & 0xFF);
@@ -1938,66 +2064,91 @@ BOOL update_write_memblt_order(wStream* s, ORDER_INFO* orderInfo, const MEMBLT_O
 	Stream_Write_UINT16(s, get_checked_uint16(memblt->cacheIndex));
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT mem3blt_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_UINT16, MEM3BLT_ORDER, cacheId),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nLeftRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nTopRect),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nWidth),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nHeight),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_BYTE, MEM3BLT_ORDER, bRop),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nXSrc),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_COORD, MEM3BLT_ORDER, nYSrc),
+	ORDER_LAYOUT(9, ORDER_LAYOUT_COLOR, MEM3BLT_ORDER, backColor),
+	ORDER_LAYOUT(10, ORDER_LAYOUT_COLOR, MEM3BLT_ORDER, foreColor)
+};
+
+static const ORDER_FIELD_LAYOUT mem3blt_index_layout[] = {
+	ORDER_LAYOUT(16, ORDER_LAYOUT_UINT16, MEM3BLT_ORDER, cacheIndex)
+};
+
 static BOOL update_read_mem3blt_order(const char* orderName, wStream* s,
                                       const ORDER_INFO* orderInfo, MEM3BLT_ORDER* mem3blt)
 {
-	if (!read_order_field_uint16(orderName, orderInfo, s, 1, &mem3blt->cacheId, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 2, &mem3blt->nLeftRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 3, &mem3blt->nTopRect, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 4, &mem3blt->nWidth, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &mem3blt->nHeight, FALSE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 6, &mem3blt->bRop, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &mem3blt->nXSrc, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &mem3blt->nYSrc, FALSE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 9, &mem3blt->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 10, &mem3blt->foreColor, TRUE))
+	if (!read_order_fields(orderName, s, orderInfo, mem3blt_layout, ARRAYSIZE(mem3blt_layout),
+	                       mem3blt))
 		return FALSE;
 
 	if (!update_read_brush(s, &mem3blt->brush,
 	                       get_checked_uint8((orderInfo->fieldFlags >> 10) & 0x1F)) ||
-	    !read_order_field_uint16(orderName, orderInfo, s, 16, &mem3blt->cacheIndex, TRUE))
+	    !read_order_fields(orderName, s, orderInfo, mem3blt_index_layout,
+	                       ARRAYSIZE(mem3blt_index_layout), mem3blt))
 		return FALSE;
 	mem3blt->colorIndex = (mem3blt->cacheId >> 8);
 	mem3blt->cacheId = (mem3blt->cacheId & 0xFF);
 	mem3blt->bitmap = NULL;
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT save_bitmap_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_UINT32, SAVE_BITMAP_ORDER, savedBitmapPosition),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, SAVE_BITMAP_ORDER, nLeftRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, SAVE_BITMAP_ORDER, nTopRect),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, SAVE_BITMAP_ORDER, nRightRect),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COORD, SAVE_BITMAP_ORDER, nBottomRect),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_BYTE, SAVE_BITMAP_ORDER, operation)
+};
+
 static BOOL update_read_save_bitmap_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           SAVE_BITMAP_ORDER* save_bitmap)
 {
-	if (read_order_field_uint32(orderName, orderInfo, s, 1, &save_bitmap->savedBitmapPosition,
-	                            TRUE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &save_bitmap->nLeftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &save_bitmap->nTopRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &save_bitmap->nRightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 5, &save_bitmap->nBottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &save_bitmap->operation, TRUE))
-		return TRUE;
-	return FALSE;
-}
+	return read_order_fields(orderName, s, orderInfo, save_bitmap_layout,
+	                         ARRAYSIZE(save_bitmap_layout), save_bitmap);
+}
+
+static const ORDER_FIELD_LAYOUT glyph_index_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_BYTE, GLYPH_INDEX_ORDER, cacheId),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_BYTE, GLYPH_INDEX_ORDER, flAccel),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_BYTE, GLYPH_INDEX_ORDER, ulCharInc),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_BYTE, GLYPH_INDEX_ORDER, fOpRedundant),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COLOR, GLYPH_INDEX_ORDER, backColor),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_COLOR, GLYPH_INDEX_ORDER, foreColor),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, bkLeft),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, bkTop),
+	ORDER_LAYOUT(9, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, bkRight),
+	ORDER_LAYOUT(10, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, bkBottom),
+	ORDER_LAYOUT(11, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, opLeft),
+	ORDER_LAYOUT(12, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, opTop),
+	ORDER_LAYOUT(13, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, opRight),
+	ORDER_LAYOUT(14, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, opBottom)
+};
+
+static const ORDER_FIELD_LAYOUT glyph_index_origin_layout[] = {
+	ORDER_LAYOUT(20, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, x),
+	ORDER_LAYOUT(21, ORDER_LAYOUT_INT16, GLYPH_INDEX_ORDER, y)
+};
+
 static BOOL update_read_glyph_index_order(const char* orderName, wStream* s,
                                           const ORDER_INFO* orderInfo,
                                           GLYPH_INDEX_ORDER* glyph_index)
 {
-	if (!read_order_field_byte(orderName, orderInfo, s, 1, &glyph_index->cacheId, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 2, &glyph_index->flAccel, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 3, &glyph_index->ulCharInc, TRUE) ||
-	    !read_order_field_byte(orderName, orderInfo, s, 4, &glyph_index->fOpRedundant, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 5, &glyph_index->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 6, &glyph_index->foreColor, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 7, &glyph_index->bkLeft, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 8, &glyph_index->bkTop, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 9, &glyph_index->bkRight, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 10, &glyph_index->bkBottom, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 11, &glyph_index->opLeft, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 12, &glyph_index->opTop, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 13, &glyph_index->opRight, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 14, &glyph_index->opBottom, TRUE) ||
+	if (!read_order_fields(orderName, s, orderInfo, glyph_index_layout,
+	                       ARRAYSIZE(glyph_index_layout), glyph_index) ||
 	    !update_read_brush(s, &glyph_index->brush,
 	                       get_checked_uint8((orderInfo->fieldFlags >> 14) & 0x1F)) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 20, &glyph_index->x, TRUE) ||
-	    !read_order_field_int16(orderName, orderInfo, s, 21, &glyph_index->y, TRUE))
+	    !read_order_fields(orderName, s, orderInfo, glyph_index_origin_layout,
+	                       ARRAYSIZE(glyph_index_origin_layout), glyph_index))
 		return FALSE;
 
 	if ((orderInfo->fieldFlags & ORDER_FIELD_22) != 0)
@@ -2089,24 +2240,30 @@ BOOL update_write_glyph_index_order(wStream* s, ORDER_INFO* orderInfo,
 	Stream_Write(s, glyph_index->data, glyph_index->cbData);
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT fast_index_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_BYTE, FAST_INDEX_ORDER, cacheId),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_BYTE, FAST_INDEX_ORDER, ulCharInc),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_BYTE, FAST_INDEX_ORDER, flAccel),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COLOR, FAST_INDEX_ORDER, backColor),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COLOR, FAST_INDEX_ORDER, foreColor),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, bkLeft),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, bkTop),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, bkRight),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, bkBottom),
+	ORDER_LAYOUT(9, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, opLeft),
+	ORDER_LAYOUT(10, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, opTop),
+	ORDER_LAYOUT(11, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, opRight),
+	ORDER_LAYOUT(12, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, opBottom),
+	ORDER_LAYOUT(13, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, x),
+	ORDER_LAYOUT(14, ORDER_LAYOUT_COORD, FAST_INDEX_ORDER, y)
+};
+
 static BOOL update_read_fast_index_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, FAST_INDEX_ORDER* fast_index)
 {
-	if (!read_order_field_byte(orderName, orderInfo, s, 1, &fast_index->cacheId, TRUE) ||
-	    !read_order_field_2bytes(orderName, orderInfo, s, 2, &fast_index->ulCharInc,
-	                             &fast_index->flAccel, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 3, &fast_index->backColor, TRUE) ||
-	    !read_order_field_color(orderName, orderInfo, s, 4, &fast_index->foreColor, TRUE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 5, &fast_index->bkLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 6, &fast_index->bkTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 7, &fast_index->bkRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 8, &fast_index->bkBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 9, &fast_index->opLeft, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 10, &fast_index->opTop, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 11, &fast_index->opRight, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 12, &fast_index->opBottom, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 13, &fast_index->x, FALSE) ||
-	    !read_order_field_coord(orderName, orderInfo, s, 14, &fast_index->y, FALSE))
+	if (!read_order_fields(orderName, s, orderInfo, fast_index_layout,
+	                       ARRAYSIZE(fast_index_layout), fast_index))
 		return FALSE;
 
 	if ((orderInfo->fieldFlags & ORDER_FIELD_15) != 0)
@@ -2297,30 +2454,40 @@ static BOOL update_read_polygon_cb_order(const char* orderName, wStream* s,
 	polygon_cb->bRop2 = (polygon_cb->bRop2 & 0x1F);
 	return TRUE;
 }
+
+static const ORDER_FIELD_LAYOUT ellipse_sc_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, ELLIPSE_SC_ORDER, leftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, ELLIPSE_SC_ORDER, topRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, ELLIPSE_SC_ORDER, rightRect),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, ELLIPSE_SC_ORDER, bottomRect),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_BYTE, ELLIPSE_SC_ORDER, bRop2),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_BYTE, ELLIPSE_SC_ORDER, fillMode),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COLOR, ELLIPSE_SC_ORDER, color)
+};
+
 static BOOL update_read_ellipse_sc_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, ELLIPSE_SC_ORDER* ellipse_sc)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &ellipse_sc->leftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &ellipse_sc->topRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &ellipse_sc->rightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &ellipse_sc->bottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &ellipse_sc->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &ellipse_sc->fillMode, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &ellipse_sc->color, TRUE))
-		return TRUE;
-	return FALSE;
+	return read_order_fields(orderName, s, orderInfo, ellipse_sc_layout,
+	                         ARRAYSIZE(ellipse_sc_layout), ellipse_sc);
 }
+
+static const ORDER_FIELD_LAYOUT ellipse_cb_layout[] = {
+	ORDER_LAYOUT(1, ORDER_LAYOUT_COORD, ELLIPSE_CB_ORDER, leftRect),
+	ORDER_LAYOUT(2, ORDER_LAYOUT_COORD, ELLIPSE_CB_ORDER, topRect),
+	ORDER_LAYOUT(3, ORDER_LAYOUT_COORD, ELLIPSE_CB_ORDER, rightRect),
+	ORDER_LAYOUT(4, ORDER_LAYOUT_COORD, ELLIPSE_CB_ORDER, bottomRect),
+	ORDER_LAYOUT(5, ORDER_LAYOUT_BYTE, ELLIPSE_CB_ORDER, bRop2),
+	ORDER_LAYOUT(6, ORDER_LAYOUT_BYTE, ELLIPSE_CB_ORDER, fillMode),
+	ORDER_LAYOUT(7, ORDER_LAYOUT_COLOR, ELLIPSE_CB_ORDER, backColor),
+	ORDER_LAYOUT(8, ORDER_LAYOUT_COLOR, ELLIPSE_CB_ORDER, foreColor)
+};
+
 static BOOL update_read_ellipse_cb_order(const char* orderName, wStream* s,
                                          const ORDER_INFO* orderInfo, ELLIPSE_CB_ORDER* ellipse_cb)
 {
-	if (read_order_field_coord(orderName, orderInfo, s, 1, &ellipse_cb->leftRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 2, &ellipse_cb->topRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 3, &ellipse_cb->rightRect, FALSE) &&
-	    read_order_field_coord(orderName, orderInfo, s, 4, &ellipse_cb->bottomRect, FALSE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 5, &ellipse_cb->bRop2, TRUE) &&
-	    read_order_field_byte(orderName, orderInfo, s, 6, &ellipse_cb->fillMode, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 7, &ellipse_cb->backColor, TRUE) &&
-	    read_order_field_color(orderName, orderInfo, s, 8, &ellipse_cb->foreColor, TRUE) &&
+	if (read_order_fields(orderName, s, orderInfo, ellipse_cb_layout,
+	                      ARRAYSIZE(ellipse_cb_layout), ellipse_cb) &&
 	    update_read_brush(s, &ellipse_cb->brush,
 	                      get_checked_uint8((orderInfo->fieldFlags >> 8) & 0x1F)))
 		return TRUE;
@@ -2343,14 +2510,17 @@ static CACHE_BITMAP_ORDER* update_read_cache_bitmap_order(rdpUpdate* update, wSt
 	if (!cache_bitmap)
 		goto fail;
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, s, 9))
+	wStreamSpan span = { 0 };
+	if (!Stream_CheckAndLogRequiredSpan(TAG, s, 9, &span))
 		goto fail;
 
-	Stream_Read_UINT8(s, cache_bitmap->cacheId);      /* cacheId (1 byte) */
-	Stream_Seek_UINT8(s);                             /* pad1Octet (1 byte) */
-	Stream_Read_UINT8(s, cache_bitmap->bitmapWidth);  /* bitmapWidth (1 byte) */
-	Stream_Read_UINT8(s, cache_bitmap->bitmapHeight); /* bitmapHeight (1 byte) */
-	Stream_Read_UINT8(s, cache_bitmap->bitmapBpp);    /* bitmapBpp (1 byte) */
+	cache_bitmap->cacheId = StreamSpan_Get_UINT8(&span);       /* cacheId (1 byte) */
+	StreamSpan_Seek(&span, sizeof(UINT8));                     /* pad1Octet (1 byte) */
+	cache_bitmap->bitmapWidth = StreamSpan_Get_UINT8(&span);   /* bitmapWidth (1 byte) */
+	cache_bitmap->bitmapHeight = StreamSpan_Get_UINT8(&span);  /* bitmapHeight (1 byte) */
+	cache_bitmap->bitmapBpp = StreamSpan_Get_UINT8(&span);     /* bitmapBpp (1 byte) */
+	cache_bitmap->bitmapLength = StreamSpan_Get_UINT16(&span); /* bitmapLength (2 bytes) */
+	cache_bitmap->cacheIndex = StreamSpan_Get_UINT16(&span);   /* cacheIndex (2 bytes) */
 
 	if ((cache_bitmap->bitmapBpp < 1) || (cache_bitmap->bitmapBpp > 32))
 	{
@@ -2358,9 +2528,6 @@ static CACHE_BITMAP_ORDER* update_read_cache_bitmap_order(rdpUpdate* update, wSt
 		goto fail;
 	}
 
-	Stream_Read_UINT16(s, cache_bitmap->bitmapLength); /* bitmapLength (2 bytes) */
-	Stream_Read_UINT16(s, cache_bitmap->cacheIndex);   /* cacheIndex (2 bytes) */
-
 	if (compressed)
 	{
 		if ((flags & NO_BITMAP_COMPRESSION_HDR) == 0)
@@ -3818,8 +3985,7 @@ static BOOL update_recv_primary_order(rdpUpdate* update, wStream* s, BYTE flags)
 	const rdpSettings* settings = context->settings;
 	WINPR_ASSERT(settings);
 
-	const BOOL defaultReturn =
-	    freerdp_settings_get_bool(settings, FreeRDP_DeactivateClientDecoding);
+	const BOOL defaultReturn = settings->DeactivateClientDecoding;
 
 	if (flags & ORDER_TYPE_CHANGE)
 	{
@@ -4098,7 +4264,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 	const char* name = NULL;
 	BOOL defaultReturn = 0;
 
-	defaultReturn = freerdp_settings_get_bool(settings, FreeRDP_DeactivateClientDecoding);
+	defaultReturn = settings->DeactivateClientDecoding;
 
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, 5))
 		return FALSE;
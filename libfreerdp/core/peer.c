@@ -33,9 +33,11 @@
 #include "display.h"
 
 #include <freerdp/log.h>
+#include <freerdp/event.h>
 #include <freerdp/streamdump.h>
 #include <freerdp/redirection.h>
 #include <freerdp/crypto/certificate.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include "rdp.h"
 #include "peer.h"
@@ -316,7 +318,14 @@ static DWORD freerdp_peer_get_event_handles(freerdp_peer* client, HANDLE* events
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->context);
 	WINPR_ASSERT(client->context->rdp);
-	return transport_get_event_handles(client->context->rdp->transport, events, count);
+
+	rdpRdp* rdp = client->context->rdp;
+	DWORD nCount = transport_get_event_handles(rdp->transport, events, count);
+
+	/* mainloop timers are also polled with the transport, so callers with no room still work */
+	if ((nCount > 0) && (nCount < count))
+		events[nCount++] = freerdp_timer_get_event(rdp->timer);
+	return nCount;
 }
 
 static BOOL freerdp_peer_check_fds(freerdp_peer* peer)
@@ -407,6 +416,7 @@ static state_run_t peer_recv_data_pdu(freerdp_peer* client, wStream* s,
 				return STATE_RUN_FAILED;
 
 			Stream_Read_UINT32(s, client->ack_frame_id);
+			FREERDP_TRACEPOINT(surface_frame_ack, client->ack_frame_id, 0);
 			IFCALL(update->SurfaceFrameAcknowledge, update->context, client->ack_frame_id);
 			break;
 
@@ -1125,6 +1135,8 @@ static state_run_t peer_recv_callback_internal(WINPR_ATTR_UNUSED rdpTransport* t
 				{
 					if (!rdp_server_transition_to_state(rdp, CONNECTION_STATE_ACTIVE))
 						ret = STATE_RUN_FAILED;
+					else if (!autodetect_start_continuous(rdp->autodetect))
+						ret = STATE_RUN_FAILED;
 					else
 					{
 						update_reset_state(rdp->update);
@@ -1350,6 +1362,10 @@ void freerdp_peer_context_free(freerdp_peer* client)
 		ctx->metrics = NULL;
 		stream_dump_free(ctx->dump);
 		ctx->dump = NULL;
+		winpr_Arena_Free(ctx->frameArena);
+		ctx->frameArena = NULL;
+		winpr_Arena_Free(ctx->channelArena);
+		ctx->channelArena = NULL;
 		free(ctx);
 	}
 	client->context = NULL;
@@ -1528,6 +1544,8 @@ static BOOL freerdp_peer_transport_setup(freerdp_peer* client)
 	return TRUE;
 }
 
+static wEventType FreeRDP_Peer_Events[] = { DEFINE_EVENT_ENTRY(NetworkCharacteristicsChange) };
+
 BOOL freerdp_peer_context_new_ex(freerdp_peer* client, const rdpSettings* settings)
 {
 	rdpRdp* rdp = NULL;
@@ -1558,6 +1576,10 @@ BOOL freerdp_peer_context_new_ex(freerdp_peer* client, const rdpSettings* settin
 	context->dump = stream_dump_new();
 	if (!context->dump)
 		goto fail;
+	context->frameArena = winpr_Arena_New(0);
+	context->channelArena = winpr_Arena_New(0);
+	if (!context->frameArena || !context->channelArena)
+		goto fail;
 	if (!(context->metrics = metrics_new(context)))
 		goto fail;
 
@@ -1576,6 +1598,7 @@ BOOL freerdp_peer_context_new_ex(freerdp_peer* client, const rdpSettings* settin
 	context->update = rdp->update;
 	context->settings = rdp->settings;
 	context->autodetect = rdp->autodetect;
+	PubSub_AddEventTypes(rdp->pubSub, FreeRDP_Peer_Events, ARRAYSIZE(FreeRDP_Peer_Events));
 	update_register_server_callbacks(rdp->update);
 	autodetect_register_server_callbacks(rdp->autodetect);
 
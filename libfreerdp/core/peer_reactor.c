@@ -0,0 +1,516 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Peer Reactor
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/log.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define WITH_REACTOR_EPOLL
+#else
+#include <poll.h>
+#endif
+#endif
+
+#define TAG FREERDP_TAG("core.reactor")
+
+#define REACTOR_MAX_EVENTS 64
+
+typedef struct
+{
+	freerdp_peer* peer;
+	psPeerReactorGetHandles getHandles;
+	psPeerReactorCheck check;
+	psPeerReactorRemoved removed;
+	void* userarg;
+
+	UINT64 lastCheck;
+	UINT64 round; /* the dispatch round the peer was last collected in */
+
+	DWORD nfds;
+	int fds[MAXIMUM_WAIT_OBJECTS];
+	DWORD nregistered;
+	int registered[MAXIMUM_WAIT_OBJECTS]; /* a duplicate if the descriptor is shared */
+} reactor_entry;
+
+typedef struct
+{
+	rdpPeerReactor* reactor;
+	HANDLE thread;
+	HANDLE wakeup;
+	wArrayList* pending; /* peers added, but not yet picked up by the worker */
+	wArrayList* entries; /* only used by the worker thread */
+	volatile LONG count;
+#if defined(WITH_REACTOR_EPOLL)
+	int epfd;
+#endif
+} reactor_worker;
+
+struct rdp_peer_reactor
+{
+	DWORD timeout;
+	HANDLE stopEvent;
+	size_t nworkers;
+	reactor_worker* workers;
+};
+
+#if !defined(_WIN32)
+static void reactor_entry_unregister(reactor_worker* worker, reactor_entry* entry)
+{
+	WINPR_ASSERT(worker);
+	WINPR_ASSERT(entry);
+
+	for (DWORD x = 0; x < entry->nregistered; x++)
+	{
+#if defined(WITH_REACTOR_EPOLL)
+		(void)epoll_ctl(worker->epfd, EPOLL_CTL_DEL, entry->registered[x], NULL);
+#endif
+		if (entry->registered[x] != entry->fds[x])
+			(void)close(entry->registered[x]);
+	}
+	entry->nregistered = 0;
+}
+
+static BOOL reactor_entry_register(reactor_worker* worker, reactor_entry* entry)
+{
+	WINPR_ASSERT(worker);
+	WINPR_ASSERT(entry);
+
+	for (DWORD x = 0; x < entry->nfds; x++)
+	{
+		int fd = entry->fds[x];
+#if defined(WITH_REACTOR_EPOLL)
+		struct epoll_event ev = { 0 };
+		ev.events = EPOLLIN;
+		ev.data.ptr = entry;
+
+		if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		{
+			/* the handle is shared with another peer of this worker, e.g. a server stop event */
+			if (errno != EEXIST)
+				return FALSE;
+
+			fd = dup(fd);
+			if (fd < 0)
+				return FALSE;
+
+			if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+			{
+				(void)close(fd);
+				return FALSE;
+			}
+		}
+#endif
+		entry->registered[entry->nregistered++] = fd;
+	}
+
+	return TRUE;
+}
+
+/* the handles of a peer change during the connection, e.g. when channels are set up */
+static BOOL reactor_entry_update(reactor_worker* worker, reactor_entry* entry)
+{
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	int fds[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	DWORD nfds = 0;
+
+	WINPR_ASSERT(entry);
+	WINPR_ASSERT(entry->getHandles);
+
+	const DWORD count = entry->getHandles(entry->peer, entry->userarg, handles, ARRAYSIZE(handles));
+	if ((count == 0) || (count > ARRAYSIZE(handles)))
+	{
+		WLog_ERR(TAG, "failed to get the event handles of the peer");
+		return FALSE;
+	}
+
+	for (DWORD x = 0; x < count; x++)
+	{
+		const int fd = GetEventFileDescriptor(handles[x]);
+		if (fd < 0)
+		{
+			WLog_ERR(TAG, "event handle %" PRIu32 " has no file descriptor", x);
+			return FALSE;
+		}
+
+		BOOL known = FALSE;
+		for (DWORD y = 0; y < nfds; y++)
+			known |= (fds[y] == fd);
+		if (!known)
+			fds[nfds++] = fd;
+	}
+
+	if ((nfds == entry->nfds) && (memcmp(fds, entry->fds, nfds * sizeof(int)) == 0))
+		return TRUE;
+
+	reactor_entry_unregister(worker, entry);
+	memcpy(entry->fds, fds, nfds * sizeof(int));
+	entry->nfds = nfds;
+	return reactor_entry_register(worker, entry);
+}
+#endif
+
+static void reactor_entry_remove(reactor_worker* worker, reactor_entry* entry)
+{
+	WINPR_ASSERT(worker);
+	WINPR_ASSERT(entry);
+
+#if !defined(_WIN32)
+	reactor_entry_unregister(worker, entry);
+#endif
+	ArrayList_Remove(worker->entries, entry);
+
+	if (entry->removed)
+		entry->removed(entry->peer, entry->userarg);
+	free(entry);
+	(void)InterlockedDecrement(&worker->count);
+}
+
+#if !defined(_WIN32)
+static void reactor_entry_dispatch(reactor_worker* worker, reactor_entry* entry, UINT64 now)
+{
+	WINPR_ASSERT(entry);
+	WINPR_ASSERT(entry->check);
+
+	entry->lastCheck = now;
+	if (!entry->check(entry->peer, entry->userarg) || !reactor_entry_update(worker, entry))
+		reactor_entry_remove(worker, entry);
+}
+
+static void reactor_worker_take_pending(reactor_worker* worker)
+{
+	WINPR_ASSERT(worker);
+
+	(void)ResetEvent(worker->wakeup);
+
+	ArrayList_Lock(worker->pending);
+	const size_t count = ArrayList_Count(worker->pending);
+	for (size_t x = 0; x < count; x++)
+	{
+		reactor_entry* entry = ArrayList_GetItem(worker->pending, x);
+		if (!ArrayList_Append(worker->entries, entry))
+		{
+			if (entry->removed)
+				entry->removed(entry->peer, entry->userarg);
+			free(entry);
+			(void)InterlockedDecrement(&worker->count);
+			continue;
+		}
+
+		entry->lastCheck = GetTickCount64();
+		if (!reactor_entry_update(worker, entry))
+			reactor_entry_remove(worker, entry);
+	}
+	ArrayList_Clear(worker->pending);
+	ArrayList_Unlock(worker->pending);
+}
+
+/* collect each signaled peer once, dispatching might remove it */
+static size_t reactor_worker_wait(reactor_worker* worker, UINT64 round, reactor_entry** signaled,
+                                  size_t size)
+{
+	size_t count = 0;
+
+	WINPR_ASSERT(worker);
+	WINPR_ASSERT(worker->reactor);
+
+#if defined(WITH_REACTOR_EPOLL)
+	struct epoll_event events[REACTOR_MAX_EVENTS] = { 0 };
+	const int status =
+	    epoll_wait(worker->epfd, events, ARRAYSIZE(events), (int)worker->reactor->timeout);
+
+	for (int x = 0; x < status; x++)
+	{
+		reactor_entry* entry = events[x].data.ptr;
+		if (!entry || (entry->round == round) || (count >= size))
+			continue;
+
+		entry->round = round;
+		signaled[count++] = entry;
+	}
+#else
+	const size_t nentries = ArrayList_Count(worker->entries);
+	size_t nfds = 1;
+	for (size_t x = 0; x < nentries; x++)
+	{
+		const reactor_entry* entry = ArrayList_GetItem(worker->entries, x);
+		nfds += entry->nfds;
+	}
+
+	struct pollfd* pfds = calloc(nfds, sizeof(struct pollfd));
+	reactor_entry** owners = calloc(nfds, sizeof(reactor_entry*));
+	if (!pfds || !owners)
+		goto out;
+
+	pfds[0].fd = GetEventFileDescriptor(worker->wakeup);
+	pfds[0].events = POLLIN;
+	nfds = 1;
+	for (size_t x = 0; x < nentries; x++)
+	{
+		reactor_entry* entry = ArrayList_GetItem(worker->entries, x);
+		for (DWORD y = 0; y < entry->nfds; y++)
+		{
+			pfds[nfds].fd = entry->fds[y];
+			pfds[nfds].events = POLLIN;
+			owners[nfds++] = entry;
+		}
+	}
+
+	const int status = poll(pfds, nfds, (int)worker->reactor->timeout);
+	for (size_t x = 1; (status > 0) && (x < nfds); x++)
+	{
+		reactor_entry* entry = owners[x];
+		if (!pfds[x].revents || (entry->round == round) || (count >= size))
+			continue;
+
+		entry->round = round;
+		signaled[count++] = entry;
+	}
+
+out:
+	free(pfds);
+	free(owners);
+#endif
+
+	return count;
+}
+
+static DWORD WINAPI reactor_worker_thread(LPVOID arg)
+{
+	reactor_worker* worker = arg;
+	reactor_entry* signaled[REACTOR_MAX_EVENTS] = { 0 };
+	UINT64 round = 0;
+
+	WINPR_ASSERT(worker);
+	rdpPeerReactor* reactor = worker->reactor;
+	WINPR_ASSERT(reactor);
+
+	while (WaitForSingleObject(reactor->stopEvent, 0) != WAIT_OBJECT_0)
+	{
+		if (WaitForSingleObject(worker->wakeup, 0) == WAIT_OBJECT_0)
+			reactor_worker_take_pending(worker);
+
+		round++;
+		const size_t count = reactor_worker_wait(worker, round, signaled, ARRAYSIZE(signaled));
+
+		UINT64 now = GetTickCount64();
+		for (size_t x = 0; x < count; x++)
+			reactor_entry_dispatch(worker, signaled[x], now);
+
+		/* peers that were not signaled are still checked every timeout */
+		now = GetTickCount64();
+		for (size_t x = ArrayList_Count(worker->entries); x > 0; x--)
+		{
+			reactor_entry* entry = ArrayList_GetItem(worker->entries, x - 1);
+			if ((entry->round != round) && (now - entry->lastCheck >= reactor->timeout))
+				reactor_entry_dispatch(worker, entry, now);
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+}
+#endif
+
+void freerdp_peer_reactor_free(rdpPeerReactor* reactor)
+{
+	if (!reactor)
+		return;
+
+	if (reactor->stopEvent)
+		(void)SetEvent(reactor->stopEvent);
+
+	for (size_t x = 0; x < reactor->nworkers; x++)
+	{
+		reactor_worker* worker = &reactor->workers[x];
+		if (worker->thread)
+		{
+			(void)SetEvent(worker->wakeup);
+			(void)WaitForSingleObject(worker->thread, INFINITE);
+			(void)CloseHandle(worker->thread);
+		}
+	}
+
+	/* the peers still attached are removed here */
+	for (size_t x = 0; x < reactor->nworkers; x++)
+	{
+		reactor_worker* worker = &reactor->workers[x];
+
+		if (worker->pending)
+		{
+			while (ArrayList_Count(worker->pending) > 0)
+			{
+				reactor_entry* entry = ArrayList_GetItem(worker->pending, 0);
+				ArrayList_RemoveAt(worker->pending, 0);
+				if (entry->removed)
+					entry->removed(entry->peer, entry->userarg);
+				free(entry);
+				(void)InterlockedDecrement(&worker->count);
+			}
+		}
+
+		if (worker->entries)
+		{
+			while (ArrayList_Count(worker->entries) > 0)
+				reactor_entry_remove(worker, ArrayList_GetItem(worker->entries, 0));
+		}
+
+		ArrayList_Free(worker->pending);
+		ArrayList_Free(worker->entries);
+		if (worker->wakeup)
+			(void)CloseHandle(worker->wakeup);
+#if defined(WITH_REACTOR_EPOLL)
+		if (worker->epfd >= 0)
+			(void)close(worker->epfd);
+#endif
+	}
+
+	free(reactor->workers);
+	if (reactor->stopEvent)
+		(void)CloseHandle(reactor->stopEvent);
+	free(reactor);
+}
+
+rdpPeerReactor* freerdp_peer_reactor_new(size_t workers, DWORD timeout)
+{
+#if defined(_WIN32)
+	WINPR_UNUSED(workers);
+	WINPR_UNUSED(timeout);
+	WLog_ERR(TAG, "the peer reactor is not supported on this platform");
+	return NULL;
+#else
+	if (workers == 0)
+	{
+		SYSTEM_INFO sysinfo = { 0 };
+		GetNativeSystemInfo(&sysinfo);
+		workers = MAX(1, sysinfo.dwNumberOfProcessors);
+	}
+
+	rdpPeerReactor* reactor = calloc(1, sizeof(rdpPeerReactor));
+	if (!reactor)
+		return NULL;
+
+	reactor->timeout = (timeout > 0) ? timeout : 1000;
+	reactor->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	reactor->workers = calloc(workers, sizeof(reactor_worker));
+	if (!reactor->stopEvent || !reactor->workers)
+		goto fail;
+
+	for (size_t x = 0; x < workers; x++)
+	{
+		reactor_worker* worker = &reactor->workers[x];
+		worker->reactor = reactor;
+#if defined(WITH_REACTOR_EPOLL)
+		worker->epfd = -1;
+#endif
+		reactor->nworkers++;
+
+		worker->wakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
+		worker->pending = ArrayList_New(TRUE);
+		worker->entries = ArrayList_New(FALSE);
+		if (!worker->wakeup || !worker->pending || !worker->entries)
+			goto fail;
+
+#if defined(WITH_REACTOR_EPOLL)
+		worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (worker->epfd < 0)
+			goto fail;
+
+		struct epoll_event ev = { 0 };
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, GetEventFileDescriptor(worker->wakeup), &ev) <
+		    0)
+			goto fail;
+#endif
+
+		worker->thread = CreateThread(NULL, 0, reactor_worker_thread, worker, 0, NULL);
+		if (!worker->thread)
+			goto fail;
+	}
+
+	return reactor;
+
+fail:
+	WLog_ERR(TAG, "failed to create the peer reactor");
+	freerdp_peer_reactor_free(reactor);
+	return NULL;
+#endif
+}
+
+BOOL freerdp_peer_reactor_add(rdpPeerReactor* reactor, freerdp_peer* peer,
+                              psPeerReactorGetHandles getHandles, psPeerReactorCheck check,
+                              psPeerReactorRemoved removed, void* userarg)
+{
+	WINPR_ASSERT(reactor);
+	WINPR_ASSERT(getHandles);
+	WINPR_ASSERT(check);
+
+	if (reactor->nworkers == 0)
+		return FALSE;
+
+	reactor_entry* entry = calloc(1, sizeof(reactor_entry));
+	if (!entry)
+		return FALSE;
+
+	entry->peer = peer;
+	entry->getHandles = getHandles;
+	entry->check = check;
+	entry->removed = removed;
+	entry->userarg = userarg;
+
+	/* the worker with the fewest peers, a peer stays with its worker for its lifetime */
+	reactor_worker* worker = &reactor->workers[0];
+	for (size_t x = 1; x < reactor->nworkers; x++)
+	{
+		reactor_worker* cur = &reactor->workers[x];
+		if (cur->count < worker->count)
+			worker = cur;
+	}
+
+	(void)InterlockedIncrement(&worker->count);
+	if (!ArrayList_Append(worker->pending, entry))
+	{
+		(void)InterlockedDecrement(&worker->count);
+		free(entry);
+		return FALSE;
+	}
+
+	return SetEvent(worker->wakeup);
+}
+
+size_t freerdp_peer_reactor_count(const rdpPeerReactor* reactor)
+{
+	size_t count = 0;
+
+	WINPR_ASSERT(reactor);
+	for (size_t x = 0; x < reactor->nworkers; x++)
+		count += (size_t)reactor->workers[x].count;
+	return count;
+}
@@ -1143,6 +1143,7 @@ state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s)
 {
 	BYTE type = 0;
 	wStream* cs = NULL;
+	wStream sbuffer = { 0 };
 	UINT16 length = 0;
 	UINT32 shareId = 0;
 	BYTE compressedType = 0;
@@ -1180,21 +1181,10 @@ state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s)
 			return STATE_RUN_FAILED;
 		}
 
+		/* parse in place, the decompression history is untouched until the next PDU */
 		if (bulk_decompress(rdp->bulk, Stream_ConstPointer(s), SrcSize, &pDstData, &DstSize,
-		                    compressedType))
-		{
-			cs = transport_take_from_pool(rdp->transport, DstSize);
-			if (!cs)
-			{
-				WLog_Print(rdp->log, WLOG_ERROR, "Couldn't take stream from pool");
-				return STATE_RUN_FAILED;
-			}
-
-			Stream_SetPosition(cs, 0);
-			Stream_Write(cs, pDstData, DstSize);
-			Stream_SealLength(cs);
-			Stream_SetPosition(cs, 0);
-		}
+		                    compressedType) >= 0)
+			cs = Stream_StaticConstInit(&sbuffer, pDstData, DstSize);
 		else
 		{
 			WLog_Print(rdp->log, WLOG_ERROR, "bulk_decompress() failed");
@@ -1360,15 +1350,8 @@ state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s)
 			break;
 	}
 
-	if (cs != s)
-		Stream_Release(cs);
-
 	return STATE_RUN_SUCCESS;
 out_fail:
-
-	if (cs != s)
-		Stream_Release(cs);
-
 	return STATE_RUN_FAILED;
 }
 
@@ -2303,6 +2286,89 @@ BOOL freerdp_get_stats(rdpRdp* rdp, UINT64* inBytes, UINT64* outBytes, UINT64* i
 	return TRUE;
 }
 
+size_t freerdp_get_connection_timeline(rdpContext* context, FreeRDPConnectionStep* steps,
+                                       size_t count)
+{
+	if (!context || !context->rdp)
+		return 0;
+
+	rdpRdp* rdp = context->rdp;
+	EnterCriticalSection(&rdp->critical);
+	const size_t total = rdp->timelineCount;
+	if (steps)
+		memcpy(steps, rdp->timeline, sizeof(FreeRDPConnectionStep) * MIN(count, total));
+	LeaveCriticalSection(&rdp->critical);
+	return total;
+}
+
+void rdp_timeline_reset(rdpRdp* rdp)
+{
+	WINPR_ASSERT(rdp);
+
+	EnterCriticalSection(&rdp->critical);
+	rdp->timelineCount = 0;
+	rdp->timelineStart = winpr_GetTickCount64NS();
+	rdp->stateStart = rdp->timelineStart;
+	LeaveCriticalSection(&rdp->critical);
+}
+
+void rdp_timeline_add(rdpRdp* rdp, const char* name, UINT64 start)
+{
+	WINPR_ASSERT(name);
+
+	if (!rdp)
+		return;
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	ConnectionStepEventArgs e = { 0 };
+
+	EnterCriticalSection(&rdp->critical);
+	const BOOL record = (rdp->timelineStart != 0) && (start >= rdp->timelineStart);
+	if (record)
+	{
+		e.name = name;
+		e.start = start - rdp->timelineStart;
+		e.duration = now - start;
+		if (rdp->timelineCount < ARRAYSIZE(rdp->timeline))
+		{
+			FreeRDPConnectionStep* step = &rdp->timeline[rdp->timelineCount++];
+			step->name = e.name;
+			step->start = e.start;
+			step->duration = e.duration;
+		}
+	}
+	LeaveCriticalSection(&rdp->critical);
+
+	if (record)
+	{
+		EventArgsInit(&e, "libfreerdp");
+		PubSub_OnConnectionStep(rdp->pubSub, rdp->context, &e);
+	}
+}
+
+void rdp_timeline_log(rdpRdp* rdp)
+{
+	WINPR_ASSERT(rdp);
+
+	if (!WLog_IsLevelActive(rdp->log, WLOG_INFO))
+		return;
+
+	char buffer[2048] = { 0 };
+	EnterCriticalSection(&rdp->critical);
+	for (size_t x = 0; x < rdp->timelineCount; x++)
+	{
+		const FreeRDPConnectionStep* step = &rdp->timeline[x];
+		char cur[128] = { 0 };
+		(void)_snprintf(cur, sizeof(cur), "%s %" PRIu64 ".%03" PRIu64, step->name,
+		                step->duration / 1000000ull, (step->duration / 1000ull) % 1000ull);
+		if (!winpr_str_append(cur, buffer, sizeof(buffer), ", "))
+			break;
+	}
+	LeaveCriticalSection(&rdp->critical);
+
+	WLog_Print(rdp->log, WLOG_INFO, "connection timeline [ms]: %s", buffer);
+}
+
 static bool rdp_new_common(rdpRdp* rdp)
 {
 	WINPR_ASSERT(rdp);
@@ -2480,6 +2546,7 @@ static void rdp_reset_free(rdpRdp* rdp)
 	winpr_Cipher_Free(rdp->fips_decrypt);
 	rdp->fips_encrypt = NULL;
 	rdp->fips_decrypt = NULL;
+	security_free_mac_contexts(rdp);
 	(void)security_unlock(rdp);
 
 	aad_free(rdp->aad);
@@ -144,6 +144,8 @@ typedef enum
 #define STREAM_MED 0x02
 #define STREAM_HI 0x04
 
+#define RDP_TIMELINE_MAX_STEPS 64
+
 struct rdp_rdp
 {
 	CONNECTION_STATE state;
@@ -173,6 +175,9 @@ struct rdp_rdp
 	UINT32 encrypt_checksum_use_count;
 	WINPR_CIPHER_CTX* fips_encrypt;
 	WINPR_CIPHER_CTX* fips_decrypt;
+	WINPR_DIGEST_CTX* mac_sha1;
+	WINPR_DIGEST_CTX* mac_md5;
+	WINPR_HMAC_CTX* fips_hmac;
 	BOOL do_crypt;
 	BOOL do_crypt_license;
 	BOOL do_secure_checksum;
@@ -209,6 +214,12 @@ struct rdp_rdp
 	char log_context[64];
 	WINPR_JSON* wellknown;
 	FreeRDPTimer* timer;
+
+	/* steps of the last connection sequence, timestamps from winpr_GetTickCount64NS */
+	FreeRDPConnectionStep timeline[RDP_TIMELINE_MAX_STEPS];
+	size_t timelineCount;
+	UINT64 timelineStart;
+	UINT64 stateStart;
 };
 
 FREERDP_LOCAL BOOL rdp_read_security_header(rdpRdp* rdp, wStream* s, UINT16* flags, UINT16* length);
@@ -239,6 +250,12 @@ FREERDP_LOCAL state_run_t rdp_recv_data_pdu(rdpRdp* rdp, wStream* s);
 
 FREERDP_LOCAL BOOL rdp_send(rdpRdp* rdp, wStream* s, UINT16 channelId, UINT16 sec_flags);
 
+/* starts a new connection timeline */
+FREERDP_LOCAL void rdp_timeline_reset(rdpRdp* rdp);
+/* records a step that started at \b start and ends now, ignored outside of a connection */
+FREERDP_LOCAL void rdp_timeline_add(rdpRdp* rdp, const char* name, UINT64 start);
+FREERDP_LOCAL void rdp_timeline_log(rdpRdp* rdp);
+
 FREERDP_LOCAL BOOL rdp_send_channel_data(rdpRdp* rdp, UINT16 channelId, const BYTE* data,
                                          size_t size);
 FREERDP_LOCAL BOOL rdp_channel_send_packet(rdpRdp* rdp, UINT16 channelId, size_t totalSize,
@@ -375,15 +375,29 @@ out:
 	return result;
 }
 
-BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BYTE* output,
-                            size_t out_len)
+/**
+ * The digest contexts of the per PDU MACs are kept in rdpRdp and reused, all callers hold
+ * security_lock() while signing or verifying.
+ */
+static BOOL security_mac_contexts(rdpRdp* rdp)
+{
+	WINPR_ASSERT(rdp);
+
+	if (!rdp->mac_sha1)
+		rdp->mac_sha1 = winpr_Digest_New();
+
+	if (!rdp->mac_md5)
+		rdp->mac_md5 = winpr_Digest_New();
+
+	return rdp->mac_sha1 && rdp->mac_md5;
+}
+
+static BOOL security_rdp_mac(rdpRdp* rdp, const BYTE* data, UINT32 length,
+                             const BYTE* use_count_le, BYTE* output, size_t out_len)
 {
-	WINPR_DIGEST_CTX* sha1 = NULL;
-	WINPR_DIGEST_CTX* md5 = NULL;
 	BYTE length_le[4] = { 0 };
 	BYTE md5_digest[WINPR_MD5_DIGEST_LENGTH] = { 0 };
 	BYTE sha1_digest[WINPR_SHA1_DIGEST_LENGTH] = { 0 };
-	BOOL result = FALSE;
 
 	WINPR_ASSERT(rdp);
 	WINPR_ASSERT(data || (length == 0));
@@ -392,78 +406,72 @@ BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BYTE*
 	if (out_len < 8)
 		return FALSE;
 
-	security_UINT32_le(length_le, sizeof(length_le), length); /* length must be little-endian */
+	if (!security_mac_contexts(rdp))
+		return FALSE;
 
-	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	if (!(sha1 = winpr_Digest_New()))
-		goto out;
+	WINPR_DIGEST_CTX* sha1 = rdp->mac_sha1;
+	WINPR_DIGEST_CTX* md5 = rdp->mac_md5;
 
+	security_UINT32_le(length_le, sizeof(length_le), length); /* length must be little-endian */
+
+	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data [+ encryptionCount]) */
 	if (!winpr_Digest_Init(sha1, WINPR_MD_SHA1))
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, pad1, sizeof(pad1))) /* pad1 */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, length_le, sizeof(length_le))) /* length */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(sha1, data, length)) /* data */
-		goto out;
+		return FALSE;
+
+	if (use_count_le && !winpr_Digest_Update(sha1, use_count_le, 4)) /* encryptionCount */
+		return FALSE;
 
 	if (!winpr_Digest_Final(sha1, sha1_digest, sizeof(sha1_digest)))
-		goto out;
+		return FALSE;
 
 	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	if (!(md5 = winpr_Digest_New()))
-		goto out;
-
 	if (!winpr_Digest_Init(md5, WINPR_MD_MD5))
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, pad2, sizeof(pad2))) /* pad2 */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Update(md5, sha1_digest, sizeof(sha1_digest))) /* SHA1_Digest */
-		goto out;
+		return FALSE;
 
 	if (!winpr_Digest_Final(md5, md5_digest, sizeof(md5_digest)))
-		goto out;
+		return FALSE;
 
 	memcpy(output, md5_digest, 8);
-	result = TRUE;
-out:
+	return TRUE;
+}
+
+BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BYTE* output,
+                            size_t out_len)
+{
+	const BOOL result = security_rdp_mac(rdp, data, length, NULL, output, out_len);
+
 	if (!result)
 		WLog_WARN(TAG, "security mac generation failed");
-	winpr_Digest_Free(sha1);
-	winpr_Digest_Free(md5);
 	return result;
 }
 
 BOOL security_salted_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length, BOOL encryption,
                                    BYTE* output, size_t out_len)
 {
-	WINPR_DIGEST_CTX* sha1 = NULL;
-	WINPR_DIGEST_CTX* md5 = NULL;
-	BYTE length_le[4] = { 0 };
 	BYTE use_count_le[4] = { 0 };
-	BYTE md5_digest[WINPR_MD5_DIGEST_LENGTH] = { 0 };
-	BYTE sha1_digest[WINPR_SHA1_DIGEST_LENGTH] = { 0 };
-	BOOL result = FALSE;
 
 	WINPR_ASSERT(rdp);
-	WINPR_ASSERT(data || (length == 0));
-	WINPR_ASSERT(output);
-	WINPR_ASSERT(out_len >= 8);
-	if (out_len < 8)
-		return FALSE;
-
-	security_UINT32_le(length_le, sizeof(length_le), length); /* length must be little-endian */
 
 	if (encryption)
 	{
@@ -479,61 +487,25 @@ BOOL security_salted_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length,
 		                   rdp->decrypt_checksum_use_count - 1u);
 	}
 
-	/* SHA1_Digest = SHA1(MACKeyN + pad1 + length + data) */
-	if (!(sha1 = winpr_Digest_New()))
-		goto out;
-
-	if (!winpr_Digest_Init(sha1, WINPR_MD_SHA1))
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, pad1, sizeof(pad1))) /* pad1 */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, length_le, sizeof(length_le))) /* length */
-		goto out;
+	const BOOL result = security_rdp_mac(rdp, data, length, use_count_le, output, out_len);
 
-	if (!winpr_Digest_Update(sha1, data, length)) /* data */
-		goto out;
-
-	if (!winpr_Digest_Update(sha1, use_count_le, sizeof(use_count_le))) /* encryptionCount */
-		goto out;
-
-	if (!winpr_Digest_Final(sha1, sha1_digest, sizeof(sha1_digest)))
-		goto out;
-
-	/* MACSignature = First64Bits(MD5(MACKeyN + pad2 + SHA1_Digest)) */
-	if (!(md5 = winpr_Digest_New()))
-		goto out;
-
-	if (!winpr_Digest_Init(md5, WINPR_MD_MD5))
-		goto out;
-
-	if (!winpr_Digest_Update(md5, rdp->sign_key, rdp->rc4_key_len)) /* MacKeyN */
-		goto out;
-
-	if (!winpr_Digest_Update(md5, pad2, sizeof(pad2))) /* pad2 */
-		goto out;
-
-	if (!winpr_Digest_Update(md5, sha1_digest, sizeof(sha1_digest))) /* SHA1_Digest */
-		goto out;
-
-	if (!winpr_Digest_Final(md5, md5_digest, sizeof(md5_digest)))
-		goto out;
-
-	memcpy(output, md5_digest, 8);
-	result = TRUE;
-out:
 	if (!result)
 		WLog_WARN(TAG, "security mac signature generation failed");
-
-	winpr_Digest_Free(sha1);
-	winpr_Digest_Free(md5);
 	return result;
 }
 
+void security_free_mac_contexts(rdpRdp* rdp)
+{
+	WINPR_ASSERT(rdp);
+
+	winpr_Digest_Free(rdp->mac_sha1);
+	winpr_Digest_Free(rdp->mac_md5);
+	winpr_HMAC_Free(rdp->fips_hmac);
+	rdp->mac_sha1 = NULL;
+	rdp->mac_md5 = NULL;
+	rdp->fips_hmac = NULL;
+}
+
 static BOOL security_A(const BYTE* master_secret, size_t master_len, const BYTE* client_random,
                        size_t client_len, const BYTE* server_random, size_t server_len,
                        BYTE* output, size_t out_len)
@@ -890,41 +862,43 @@ fail:
 	return rc;
 }
 
-BOOL security_hmac_signature(const BYTE* data, size_t length, BYTE* output, size_t out_len,
-                             rdpRdp* rdp)
+static BOOL security_fips_hmac(rdpRdp* rdp, const BYTE* data, size_t length, UINT32 use_count,
+                               BYTE* output)
 {
-	BYTE buf[WINPR_SHA1_DIGEST_LENGTH] = { 0 };
 	BYTE use_count_le[4] = { 0 };
-	WINPR_HMAC_CTX* hmac = NULL;
-	BOOL result = FALSE;
 
 	WINPR_ASSERT(rdp);
-	WINPR_ASSERT(output);
-	if (out_len < 8)
-		return FALSE;
 
-	security_UINT32_le(use_count_le, sizeof(use_count_le), rdp->encrypt_use_count);
+	if (!rdp->fips_hmac)
+		rdp->fips_hmac = winpr_HMAC_New();
 
-	if (!(hmac = winpr_HMAC_New()))
+	if (!rdp->fips_hmac)
 		return FALSE;
 
-	if (!winpr_HMAC_Init(hmac, WINPR_MD_SHA1, rdp->fips_sign_key, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
+	security_UINT32_le(use_count_le, sizeof(use_count_le), use_count);
 
-	if (!winpr_HMAC_Update(hmac, data, length))
-		goto out;
+	return winpr_HMAC_Init(rdp->fips_hmac, WINPR_MD_SHA1, rdp->fips_sign_key,
+	                       WINPR_SHA1_DIGEST_LENGTH) &&
+	       winpr_HMAC_Update(rdp->fips_hmac, data, length) &&
+	       winpr_HMAC_Update(rdp->fips_hmac, use_count_le, sizeof(use_count_le)) &&
+	       winpr_HMAC_Final(rdp->fips_hmac, output, WINPR_SHA1_DIGEST_LENGTH);
+}
 
-	if (!winpr_HMAC_Update(hmac, use_count_le, 4))
-		goto out;
+BOOL security_hmac_signature(const BYTE* data, size_t length, BYTE* output, size_t out_len,
+                             rdpRdp* rdp)
+{
+	BYTE buf[WINPR_SHA1_DIGEST_LENGTH] = { 0 };
 
-	if (!winpr_HMAC_Final(hmac, buf, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
+	WINPR_ASSERT(rdp);
+	WINPR_ASSERT(output);
+	if (out_len < 8)
+		return FALSE;
+
+	if (!security_fips_hmac(rdp, data, length, rdp->encrypt_use_count, buf))
+		return FALSE;
 
 	memmove(output, buf, 8);
-	result = TRUE;
-out:
-	winpr_HMAC_Free(hmac);
-	return result;
+	return TRUE;
 }
 
 BOOL security_fips_encrypt(BYTE* data, size_t length, rdpRdp* rdp)
@@ -961,34 +935,16 @@ BOOL security_fips_check_signature(const BYTE* data, size_t length, const BYTE*
                                    rdpRdp* rdp)
 {
 	BYTE buf[WINPR_SHA1_DIGEST_LENGTH] = { 0 };
-	BYTE use_count_le[4] = { 0 };
-	WINPR_HMAC_CTX* hmac = NULL;
 	BOOL result = FALSE;
 
-	security_UINT32_le(use_count_le, sizeof(use_count_le), rdp->decrypt_use_count++);
-
-	if (!(hmac = winpr_HMAC_New()))
-		goto out;
-
-	if (!winpr_HMAC_Init(hmac, WINPR_MD_SHA1, rdp->fips_sign_key, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, data, length))
-		goto out;
-
-	if (!winpr_HMAC_Update(hmac, use_count_le, 4))
-		goto out;
-
-	if (!winpr_HMAC_Final(hmac, buf, WINPR_SHA1_DIGEST_LENGTH))
-		goto out;
+	WINPR_ASSERT(rdp);
 
-	if ((sig_len >= 8) && (memcmp(sig, buf, 8) == 0))
+	if (security_fips_hmac(rdp, data, length, rdp->decrypt_use_count++, buf) && (sig_len >= 8) &&
+	    (memcmp(sig, buf, 8) == 0))
 		result = TRUE;
 
-out:
 	if (!result)
 		WLog_WARN(TAG, "signature check failed");
-	winpr_HMAC_Free(hmac);
 	return result;
 }
 
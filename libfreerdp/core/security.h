@@ -53,6 +53,7 @@ FREERDP_LOCAL BOOL security_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32
 FREERDP_LOCAL BOOL security_salted_mac_signature(rdpRdp* rdp, const BYTE* data, UINT32 length,
                                                  BOOL encryption, BYTE* output, size_t out_len);
 FREERDP_LOCAL BOOL security_establish_keys(rdpRdp* rdp);
+FREERDP_LOCAL void security_free_mac_contexts(rdpRdp* rdp);
 
 FREERDP_LOCAL BOOL security_lock(rdpRdp* rdp);
 FREERDP_LOCAL BOOL security_unlock(rdpRdp* rdp);
@@ -163,10 +163,26 @@ static BOOL wts_read_drdynvc_capabilities_response(rdpPeerChannel* channel, UINT
 	}
 
 	WTSVirtualChannelManager* vcm = channel->vcm;
-	vcm->drdynvc_state = DRDYNVC_STATE_READY;
 
-	/* we only support version 1 for now (no compression yet) */
-	vcm->dvc_spoken_version = MAX(Version, 1);
+	/* version 3 adds compressed data PDUs */
+	vcm->dvc_spoken_version = MIN(Version, 3);
+	if (vcm->dvc_spoken_version >= 3)
+	{
+		if (!vcm->dvc_compressor)
+			vcm->dvc_compressor = zgfx_context_new(TRUE);
+		if (!vcm->dvc_decompressor)
+			vcm->dvc_decompressor = zgfx_context_new(FALSE);
+		if (!vcm->dvc_compressor || !vcm->dvc_decompressor ||
+		    !zgfx_set_history_size(vcm->dvc_compressor, ZGFX_HISTORY_SIZE_LITE) ||
+		    !zgfx_set_history_size(vcm->dvc_decompressor, ZGFX_HISTORY_SIZE_LITE) ||
+		    !zgfx_set_compression_level(vcm->dvc_compressor, ZGFX_COMPRESSION_LEVEL_FAST))
+		{
+			WLog_ERR(TAG, "failed to set up DVC compression");
+			return FALSE;
+		}
+	}
+
+	vcm->drdynvc_state = DRDYNVC_STATE_READY;
 
 	return SetEvent(MessageQueue_Event(vcm->queue));
 }
@@ -264,6 +280,55 @@ static BOOL wts_read_drdynvc_data(rdpPeerChannel* channel, wStream* s, UINT32 le
 	return ret;
 }
 
+static BOOL wts_read_drdynvc_data_compressed(rdpPeerChannel* channel, wStream* s, BYTE Cmd,
+                                             int cbLen, UINT32 length)
+{
+	BOOL ret = FALSE;
+
+	WINPR_ASSERT(channel);
+	WINPR_ASSERT(channel->vcm);
+	WINPR_ASSERT(s);
+
+	WTSVirtualChannelManager* vcm = channel->vcm;
+	if (!vcm->dvc_decompressor)
+	{
+		WLog_ERR(TAG, "compressed data without DVC version 3");
+		return FALSE;
+	}
+
+	/* decompress behind the total length of a DATA_FIRST PDU and parse as usual */
+	const size_t header = (Cmd == DATA_FIRST_COMPRESSED_PDU) ? (1ull << cbLen) : 0;
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, length) || (header > length))
+		return FALSE;
+
+	wStream* data = Stream_New(NULL, DVC_MAX_DATA_PDU_SIZE);
+	if (!data)
+		return FALSE;
+
+	Stream_Write(data, Stream_ConstPointer(s), header);
+	Stream_Seek(s, header);
+	if (!zgfx_decompress_bulk(vcm->dvc_decompressor, Stream_ConstPointer(s),
+	                          (UINT32)(length - header), data))
+	{
+		WLog_ERR(TAG, "failed to decompress DVC data");
+		goto fail;
+	}
+
+	const size_t total = Stream_GetPosition(data);
+	if (total > UINT32_MAX)
+		goto fail;
+
+	Stream_SetPosition(data, 0);
+	if (Cmd == DATA_FIRST_COMPRESSED_PDU)
+		ret = wts_read_drdynvc_data_first(channel, data, cbLen, (UINT32)total);
+	else
+		ret = wts_read_drdynvc_data(channel, data, (UINT32)total);
+
+fail:
+	Stream_Free(data, TRUE);
+	return ret;
+}
+
 static void wts_read_drdynvc_close_response(rdpPeerChannel* channel)
 {
 	WINPR_ASSERT(channel);
@@ -365,8 +430,17 @@ static BOOL wts_read_drdynvc_pdu(rdpPeerChannel* channel)
 
 			case DATA_FIRST_COMPRESSED_PDU:
 			case DATA_COMPRESSED_PDU:
-				WLog_ERR(TAG, "Compressed data not handled");
-				break;
+				if (dvc->dvc_open_state != DVC_OPEN_STATE_SUCCEEDED)
+				{
+					WLog_ERR(TAG,
+					         "ChannelId %" PRIu32 " did not open successfully. "
+					         "Ignoring compressed data PDU",
+					         ChannelId);
+					return TRUE;
+				}
+
+				return wts_read_drdynvc_data_compressed(dvc, channel->receiveData, Cmd, Sp,
+				                                        (UINT32)length);
 
 			case SOFT_SYNC_RESPONSE_PDU:
 				WLog_ERR(TAG, "SoftSync response not handled yet(and rather strange to receive "
@@ -581,9 +655,13 @@ BOOL WTSVirtualChannelManagerOpen(HANDLE hServer)
 			vcm->dvc_spoken_version = 1;
 			Stream_Write_UINT8(s, 0x50);    /* Cmd=5 sp=0 cbId=0 */
 			Stream_Write_UINT8(s, 0x00);    /* Pad */
-			Stream_Write_UINT16(s, 0x0001); /* Version */
+			Stream_Write_UINT16(s, 0x0003); /* Version */
 
-			/* TODO: shall implement version 2 and 3 */
+			/* PriorityCharge0-3, the values recommended by MS-RDPEDYC */
+			Stream_Write_UINT16(s, 936);
+			Stream_Write_UINT16(s, 3276);
+			Stream_Write_UINT16(s, 9362);
+			Stream_Write_UINT16(s, 37449);
 
 			const size_t pos = Stream_GetPosition(s);
 			WINPR_ASSERT(pos <= UINT32_MAX);
@@ -1113,6 +1191,8 @@ VOID WINAPI FreeRDP_WTSCloseServer(HANDLE hServer)
 		}
 
 		MessageQueue_Free(vcm->queue);
+		zgfx_context_free(vcm->dvc_compressor);
+		zgfx_context_free(vcm->dvc_decompressor);
 		free(vcm);
 	}
 }
@@ -1677,8 +1757,14 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 	}
 	else
 	{
+		rdpPeerChannel* drdynvc = channel->vcm->drdynvc_channel;
+		ZGFX_CONTEXT* compressor = channel->vcm->dvc_compressor;
 		first = TRUE;
 
+		/* the client decompresses in the order the PDUs arrive, not per channel */
+		if (compressor)
+			EnterCriticalSection(&drdynvc->writeLock);
+
 		size_t Length = uLength;
 		while (Length > 0)
 		{
@@ -1688,40 +1774,62 @@ BOOL WINAPI FreeRDP_WTSVirtualChannelWrite(HANDLE hChannelHandle, PCHAR Buffer,
 			{
 				WLog_ERR(TAG, "Stream_New failed!");
 				SetLastError(g_err_oom);
-				goto fail;
+				break;
 			}
 
 			buffer = Stream_Buffer(s);
 			Stream_Seek_UINT8(s);
 			cbChId = wts_write_variable_uint(s, channel->channelId);
 
-			if (first && (Length > Stream_GetRemainingLength(s)))
+			/* a compressed PDU needs room for the bulk header */
+			const size_t room = Stream_GetRemainingLength(s) - (compressor ? 1 : 0);
+			BYTE Cmd = compressor ? DATA_COMPRESSED_PDU : DATA_PDU;
+			cbLen = 0;
+
+			if (first && (Length > room))
 			{
 				cbLen = wts_write_variable_uint(s, WINPR_ASSERTING_INT_CAST(uint32_t, Length));
-				buffer[0] = ((DATA_FIRST_PDU << 4) | (cbLen << 2) | cbChId) & 0xFF;
-			}
-			else
-			{
-				buffer[0] = ((DATA_PDU << 4) | cbChId) & 0xFF;
+				Cmd = compressor ? DATA_FIRST_COMPRESSED_PDU : DATA_FIRST_PDU;
 			}
 
+			buffer[0] = ((Cmd << 4) | (cbLen << 2) | cbChId) & 0xFF;
 			first = FALSE;
-			size_t written = Stream_GetRemainingLength(s);
+			size_t written = Stream_GetRemainingLength(s) - (compressor ? 1 : 0);
 
 			if (written > Length)
 				written = Length;
 
-			Stream_Write(s, Buffer, written);
+			if (compressor)
+			{
+				if (!zgfx_compress_bulk(compressor, s, (const BYTE*)Buffer, (UINT32)written))
+				{
+					WLog_ERR(TAG, "failed to compress DVC data");
+					Stream_Free(s, TRUE);
+					break;
+				}
+			}
+			else
+				Stream_Write(s, Buffer, written);
+
+			buffer = Stream_Buffer(s);
 			const size_t length = Stream_GetPosition(s);
 			Stream_Free(s, FALSE);
 			if (length > UINT32_MAX)
-				goto fail;
+			{
+				free(buffer);
+				break;
+			}
 			Length -= written;
 			Buffer += written;
 			totalWritten += written;
-			if (!wts_queue_send_item(channel->vcm->drdynvc_channel, buffer, (UINT32)length))
-				goto fail;
+			if (!wts_queue_send_item(drdynvc, buffer, (UINT32)length))
+				break;
 		}
+
+		if (compressor)
+			LeaveCriticalSection(&drdynvc->writeLock);
+		if (Length > 0)
+			goto fail;
 	}
 
 	if (pBytesWritten)
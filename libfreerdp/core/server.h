@@ -24,6 +24,7 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/api.h>
 #include <freerdp/channels/wtsvc.h>
+#include <freerdp/codec/zgfx.h>
 
 #include <winpr/synch.h>
 #include <winpr/stream.h>
@@ -89,6 +90,10 @@ struct WTSVirtualChannelManager
 	void* dvc_creation_status_userdata;
 
 	wHashTable* dynamicVirtualChannels;
+
+	/* RDP8 Lite bulk compression of DVC data, version 3 only */
+	ZGFX_CONTEXT* dvc_compressor;
+	ZGFX_CONTEXT* dvc_decompressor;
 };
 
 FREERDP_LOCAL BOOL WINAPI FreeRDP_WTSStartRemoteControlSessionW(LPWSTR pTargetServerName,
@@ -852,6 +852,7 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_HasExtendedMouseEvent, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_HasQoeEvent, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_HasRelativeMouseEvent, TRUE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_InputCoalesceInterval, 0) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_HiDefRemoteApp, TRUE) ||
 	    !freerdp_settings_set_uint32(
 	        settings, FreeRDP_RemoteApplicationSupportMask,
@@ -880,6 +881,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_ExtSecurity, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_TlsSecurity, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TlsKernelOffload, FALSE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TlsSessionResumption, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_RdpSecurity, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_RdstlsSecurity, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_NegotiateSecurityLayer, TRUE) ||
@@ -920,6 +923,7 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_uint32(settings, FreeRDP_EncryptionLevel, ENCRYPTION_LEVEL_NONE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_FIPSMode, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_CompressionEnabled, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_CompressionAdaptive, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_LogonNotify, TRUE) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_BrushSupportLevel, BRUSH_COLOR_FULL) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP61) ||
@@ -1009,7 +1013,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_FrameMarkerCommandEnabled, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_SurfaceFrameMarkerEnabled, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_AllowCacheWaitingList, TRUE) ||
-	    !freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheV2NumCells, 5))
+	    !freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheV2NumCells, 5) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_BitmapCacheBudget, 0))
 		goto out_fail;
 	settings->BitmapCacheV2CellInfo =
 	    (BITMAP_CACHE_V2_CELL_INFO*)calloc(6, sizeof(BITMAP_CACHE_V2_CELL_INFO));
@@ -1135,6 +1140,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxProgressive, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxProgressiveV2, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_GfxClearCodec, FALSE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_GfxCacheBudget, 0) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxH264, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxAVC444, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_GfxSendQoeAck, FALSE) ||
@@ -1183,7 +1190,9 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpKeepAliveDelay, 5) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpKeepAliveInterval, 2) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpAckTimeout, 9000) ||
-	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpConnectTimeout, 15000))
+	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpConnectTimeout, 15000) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpConnectAttemptDelay, 250) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_TcpNotSentLowat, 16384))
 		goto out_fail;
 
 	if (!freerdp_settings_get_bool(settings, FreeRDP_ServerMode))
@@ -0,0 +1,769 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared memory transport for local peers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // NOLINT(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp)
+#endif
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/interlocked.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+
+#include "shmtransport.h"
+
+#define TAG FREERDP_TAG("core.shm")
+
+#if defined(HAVE_MEMFD_CREATE) && defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * The client creates a sealed memfd holding a header and one ring per direction plus four
+ * eventfds and passes them with the offer over the socket. The server answers with a single
+ * byte. Afterwards the socket only tells about the peer going away.
+ *
+ * The rings are single producer, single consumer with free running positions. Each side keeps
+ * its own position privately and only trusts the one of the peer after checking it, the
+ * memory is shared with a process that might not play by the rules.
+ */
+#define SHM_TRANSPORT_MAGIC "FRDPSHM1"
+#define SHM_TRANSPORT_MAGIC_LENGTH 8
+#define SHM_TRANSPORT_VERSION 1
+#define SHM_TRANSPORT_ACK 'Y'
+#define SHM_TRANSPORT_HEADER_SIZE 4096
+#define SHM_TRANSPORT_RING_SIZE (4ull * 1024ull * 1024ull)
+#define SHM_TRANSPORT_SIZE (SHM_TRANSPORT_HEADER_SIZE + 2 * SHM_TRANSPORT_RING_SIZE)
+
+/* order of the descriptors passed with the offer */
+enum
+{
+	SHM_FD_MEMORY,
+	SHM_FD_CLIENT_DATA,  /* client to server, data was written */
+	SHM_FD_CLIENT_SPACE, /* client to server, data was consumed */
+	SHM_FD_SERVER_DATA,  /* server to client, data was written */
+	SHM_FD_SERVER_SPACE, /* server to client, data was consumed */
+	SHM_FD_COUNT
+};
+
+typedef struct
+{
+	volatile LONGLONG head; /* written by the producer */
+	BYTE pad1[56];
+	volatile LONGLONG tail; /* written by the consumer */
+	BYTE pad2[56];
+	volatile LONG writerWaiting; /* the producer waits for space */
+	BYTE pad3[60];
+} SHM_RING;
+
+typedef struct
+{
+	char magic[SHM_TRANSPORT_MAGIC_LENGTH];
+	UINT32 version;
+	UINT32 ringSize;
+	BYTE pad[48];
+	SHM_RING rings[2]; /* client to server, server to client */
+} SHM_HEADER;
+
+typedef struct
+{
+	int sockfd;
+	int epollfd;
+	HANDLE hEvent;
+
+	BOOL probing; /* server, nothing received from the client yet */
+	BOOL shm;
+
+	BYTE* base;
+	int fds[SHM_FD_COUNT];
+
+	SHM_RING* rx;
+	const BYTE* rxData;
+	UINT64 rxTail;
+	int rxDataFd;
+	int rxSpaceFd;
+
+	SHM_RING* tx;
+	BYTE* txData;
+	UINT64 txHead;
+	int txDataFd;
+	int txSpaceFd;
+} rdpShmLayer;
+
+static UINT64 shm_load(volatile LONGLONG* value)
+{
+	return (UINT64)InterlockedCompareExchange64(value, 0, 0);
+}
+
+static void shm_store(volatile LONGLONG* value, UINT64 next, UINT64 previous)
+{
+	/* only we write this position, the exchange orders the ring contents before it */
+	(void)InterlockedCompareExchange64(value, (LONGLONG)next, (LONGLONG)previous);
+}
+
+static void shm_signal(int fd)
+{
+	(void)eventfd_write(fd, 1);
+}
+
+static void shm_drain(int fd)
+{
+	eventfd_t value = 0;
+	(void)eventfd_read(fd, &value);
+}
+
+static void shm_close_fds(int* fds, size_t count)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		if (fds[x] >= 0)
+			close(fds[x]);
+		fds[x] = -1;
+	}
+}
+
+static BOOL shm_set_nonblock(int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+	if (flags < 0)
+		return FALSE;
+	return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static BOOL shm_epoll_add(rdpShmLayer* shm, int fd, uint32_t events)
+{
+	struct epoll_event ev = { 0 };
+	ev.events = events;
+	ev.data.fd = fd;
+	return epoll_ctl(shm->epollfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+static BOOL shm_layer_setup(rdpShmLayer* shm, BOOL server)
+{
+	WINPR_ASSERT(shm);
+	WINPR_ASSERT(shm->base);
+
+	SHM_HEADER* header = (SHM_HEADER*)shm->base;
+	BYTE* clientData = shm->base + SHM_TRANSPORT_HEADER_SIZE;
+	BYTE* serverData = clientData + SHM_TRANSPORT_RING_SIZE;
+
+	if (server)
+	{
+		shm->rx = &header->rings[0];
+		shm->rxData = clientData;
+		shm->rxDataFd = shm->fds[SHM_FD_CLIENT_DATA];
+		shm->rxSpaceFd = shm->fds[SHM_FD_CLIENT_SPACE];
+		shm->tx = &header->rings[1];
+		shm->txData = serverData;
+		shm->txDataFd = shm->fds[SHM_FD_SERVER_DATA];
+		shm->txSpaceFd = shm->fds[SHM_FD_SERVER_SPACE];
+	}
+	else
+	{
+		shm->rx = &header->rings[1];
+		shm->rxData = serverData;
+		shm->rxDataFd = shm->fds[SHM_FD_SERVER_DATA];
+		shm->rxSpaceFd = shm->fds[SHM_FD_SERVER_SPACE];
+		shm->tx = &header->rings[0];
+		shm->txData = clientData;
+		shm->txDataFd = shm->fds[SHM_FD_CLIENT_DATA];
+		shm->txSpaceFd = shm->fds[SHM_FD_CLIENT_SPACE];
+	}
+
+	shm->rxTail = shm_load(&shm->rx->tail);
+	shm->txHead = shm_load(&shm->tx->head);
+	if (!shm_epoll_add(shm, shm->rxDataFd, EPOLLIN))
+		return FALSE;
+
+	shm->shm = TRUE;
+	return TRUE;
+}
+
+/** bytes readable in the receive ring, -1 if the peer broke the ring */
+static SSIZE_T shm_rx_available(rdpShmLayer* shm)
+{
+	const UINT64 head = shm_load(&shm->rx->head);
+	const UINT64 available = head - shm->rxTail;
+	if (available > SHM_TRANSPORT_RING_SIZE)
+	{
+		WLog_ERR(TAG, "peer corrupted the receive ring");
+		return -1;
+	}
+	return (SSIZE_T)available;
+}
+
+/** bytes writable in the send ring, -1 if the peer broke the ring */
+static SSIZE_T shm_tx_free(rdpShmLayer* shm)
+{
+	const UINT64 tail = shm_load(&shm->tx->tail);
+	const UINT64 used = shm->txHead - tail;
+	if (used > SHM_TRANSPORT_RING_SIZE)
+	{
+		WLog_ERR(TAG, "peer corrupted the send ring");
+		return -1;
+	}
+	return (SSIZE_T)(SHM_TRANSPORT_RING_SIZE - used);
+}
+
+static BOOL shm_server_accept_offer(rdpShmLayer* shm)
+{
+	WINPR_ASSERT(shm);
+
+	char magic[SHM_TRANSPORT_MAGIC_LENGTH] = { 0 };
+	char control[CMSG_SPACE(sizeof(int) * SHM_FD_COUNT)] = { 0 };
+	struct iovec iov = { .iov_base = magic, .iov_len = sizeof(magic) };
+	struct msghdr msg = { 0 };
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	const ssize_t rc = recvmsg(shm->sockfd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (rc != (ssize_t)sizeof(magic))
+		return FALSE;
+
+	size_t count = 0;
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+			continue;
+
+		const size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t x = 0; x < received; x++)
+		{
+			int fd = -1;
+			memcpy(&fd, CMSG_DATA(cmsg) + x * sizeof(int), sizeof(int));
+			if (count < SHM_FD_COUNT)
+				shm->fds[count] = fd;
+			else
+				close(fd);
+			count++;
+		}
+	}
+
+	if ((msg.msg_flags & MSG_CTRUNC) || (count != SHM_FD_COUNT))
+	{
+		WLog_ERR(TAG, "invalid shared memory offer, got %" PRIuz " descriptors", count);
+		return FALSE;
+	}
+
+	/* the client must not be able to resize the mapping under our feet */
+	struct stat st = { 0 };
+	const int memfd = shm->fds[SHM_FD_MEMORY];
+	const int seals = fcntl(memfd, F_GET_SEALS);
+	if ((fstat(memfd, &st) != 0) || !S_ISREG(st.st_mode) ||
+	    ((UINT64)st.st_size != SHM_TRANSPORT_SIZE) || (seals < 0) ||
+	    ((seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)))
+	{
+		WLog_ERR(TAG, "shared memory offer is not a sealed memfd of the expected size");
+		return FALSE;
+	}
+
+	for (size_t x = SHM_FD_CLIENT_DATA; x < SHM_FD_COUNT; x++)
+	{
+		if (!shm_set_nonblock(shm->fds[x]))
+			return FALSE;
+	}
+
+	void* base = mmap(NULL, SHM_TRANSPORT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (base == MAP_FAILED)
+		return FALSE;
+	shm->base = base;
+
+	const SHM_HEADER* header = (const SHM_HEADER*)shm->base;
+	if ((memcmp(header->magic, SHM_TRANSPORT_MAGIC, SHM_TRANSPORT_MAGIC_LENGTH) != 0) ||
+	    (header->version != SHM_TRANSPORT_VERSION) ||
+	    (header->ringSize != SHM_TRANSPORT_RING_SIZE))
+	{
+		WLog_ERR(TAG, "unsupported shared memory header");
+		return FALSE;
+	}
+
+	if (!shm_layer_setup(shm, TRUE))
+		return FALSE;
+
+	const char ack = SHM_TRANSPORT_ACK;
+	if (send(shm->sockfd, &ack, sizeof(ack), MSG_NOSIGNAL) != (ssize_t)sizeof(ack))
+		return FALSE;
+
+	WLog_INFO(TAG, "client uses the shared memory transport");
+	return TRUE;
+}
+
+/** returns FALSE on error, probing is cleared once the client made up its mind */
+static BOOL shm_server_probe(rdpShmLayer* shm)
+{
+	char magic[SHM_TRANSPORT_MAGIC_LENGTH] = { 0 };
+	const ssize_t rc = recv(shm->sockfd, magic, sizeof(magic), MSG_PEEK | MSG_DONTWAIT);
+	if (rc < 0)
+		return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+	if (rc == 0)
+	{
+		shm->probing = FALSE;
+		return TRUE;
+	}
+
+	if (memcmp(magic, SHM_TRANSPORT_MAGIC, (size_t)rc) != 0)
+	{
+		shm->probing = FALSE;
+		return TRUE;
+	}
+
+	/* the offer is a single message, the rest follows right away */
+	if (rc < (ssize_t)sizeof(magic))
+		return TRUE;
+
+	shm->probing = FALSE;
+	return shm_server_accept_offer(shm);
+}
+
+static int shm_socket_read(rdpShmLayer* shm, void* data, int bytes)
+{
+	const ssize_t rc = recv(shm->sockfd, data, (size_t)bytes, MSG_DONTWAIT);
+	if (rc > 0)
+		return (int)rc;
+	if (rc == 0)
+		return -1; /* socket closed */
+	if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+		return 0;
+	return -1;
+}
+
+static int shm_socket_write(rdpShmLayer* shm, const void* data, int bytes)
+{
+	const ssize_t rc = send(shm->sockfd, data, (size_t)bytes, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (rc >= 0)
+		return (int)rc;
+	if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+		return 0;
+	return -1;
+}
+
+/** the socket carries nothing but the end of the connection once the rings are in use */
+static int shm_check_socket(rdpShmLayer* shm)
+{
+	char c = 0;
+	const ssize_t rc = recv(shm->sockfd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+	if (rc < 0)
+		return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -1;
+	if (rc > 0)
+		WLog_ERR(TAG, "unexpected data on the socket of a shared memory transport");
+	return -1;
+}
+
+static int shm_layer_read(void* userContext, void* data, int bytes)
+{
+	if (!userContext)
+		return -1;
+	if (!data || !bytes)
+		return 0;
+
+	rdpShmLayer* shm = (rdpShmLayer*)userContext;
+
+	if (shm->probing)
+	{
+		if (!shm_server_probe(shm))
+			return -1;
+		if (shm->probing)
+			return 0;
+	}
+
+	if (!shm->shm)
+		return shm_socket_read(shm, data, bytes);
+
+	BOOL drained = FALSE;
+	SSIZE_T available = shm_rx_available(shm);
+	if (available == 0)
+	{
+		/* the writer signals after publishing, so anything after the drain wakes us again */
+		shm_drain(shm->rxDataFd);
+		drained = TRUE;
+		available = shm_rx_available(shm);
+		if (available == 0)
+			return shm_check_socket(shm);
+	}
+	if (available < 0)
+		return -1;
+
+	const size_t length = MIN((size_t)bytes, (size_t)available);
+	const size_t offset = shm->rxTail & (SHM_TRANSPORT_RING_SIZE - 1);
+	const size_t first = MIN(length, SHM_TRANSPORT_RING_SIZE - offset);
+	memcpy(data, &shm->rxData[offset], first);
+	memcpy((BYTE*)data + first, shm->rxData, length - first);
+
+	const UINT64 tail = shm->rxTail;
+	shm->rxTail += length;
+	shm_store(&shm->rx->tail, shm->rxTail, tail);
+
+	if (InterlockedCompareExchange(&shm->rx->writerWaiting, 0, 1) == 1)
+		shm_signal(shm->rxSpaceFd);
+
+	/* the signal for the rest might have been drained above */
+	if (drained && (length < (size_t)available))
+		shm_signal(shm->rxDataFd);
+
+	return (int)length;
+}
+
+static int shm_layer_write(void* userContext, const void* data, int bytes)
+{
+	if (!userContext)
+		return -1;
+	if (!data || !bytes)
+		return 0;
+
+	rdpShmLayer* shm = (rdpShmLayer*)userContext;
+
+	if (!shm->shm)
+		return shm_socket_write(shm, data, bytes);
+
+	SSIZE_T space = shm_tx_free(shm);
+	if (space == 0)
+	{
+		/* the reader signals space once it sees the flag, check again after raising it */
+		(void)InterlockedExchange(&shm->tx->writerWaiting, 1);
+		space = shm_tx_free(shm);
+		if (space == 0)
+			return 0;
+	}
+	if (space < 0)
+		return -1;
+
+	const size_t length = MIN((size_t)bytes, (size_t)space);
+	const size_t offset = shm->txHead & (SHM_TRANSPORT_RING_SIZE - 1);
+	const size_t first = MIN(length, SHM_TRANSPORT_RING_SIZE - offset);
+	memcpy(&shm->txData[offset], data, first);
+	memcpy(shm->txData, (const BYTE*)data + first, length - first);
+
+	const UINT64 head = shm->txHead;
+	shm->txHead += length;
+	shm_store(&shm->tx->head, shm->txHead, head);
+	shm_signal(shm->txDataFd);
+
+	return (int)length;
+}
+
+static BOOL shm_layer_close(void* userContext)
+{
+	if (!userContext)
+		return FALSE;
+
+	rdpShmLayer* shm = (rdpShmLayer*)userContext;
+
+	if (shm->base)
+		munmap(shm->base, SHM_TRANSPORT_SIZE);
+	shm->base = NULL;
+	shm_close_fds(shm->fds, ARRAYSIZE(shm->fds));
+
+	if (shm->hEvent)
+		(void)CloseHandle(shm->hEvent);
+	if (shm->epollfd >= 0)
+		close(shm->epollfd);
+	if (shm->sockfd >= 0)
+	{
+		shutdown(shm->sockfd, SHUT_RDWR);
+		close(shm->sockfd);
+	}
+
+	return TRUE;
+}
+
+static BOOL shm_poll(int fd, int timeout)
+{
+	struct pollfd pollset = { 0 };
+	pollset.fd = fd;
+	pollset.events = POLLIN;
+
+	int status = -1;
+	do
+	{
+		status = poll(&pollset, 1, timeout);
+	} while ((status < 0) && (errno == EINTR));
+
+	return status != 0;
+}
+
+static BOOL shm_layer_wait(void* userContext, BOOL waitWrite, DWORD timeout)
+{
+	if (!userContext)
+		return FALSE;
+
+	rdpShmLayer* shm = (rdpShmLayer*)userContext;
+
+	if (!shm->shm)
+	{
+		struct pollfd pollset = { 0 };
+		pollset.fd = shm->sockfd;
+		pollset.events = waitWrite ? POLLOUT : POLLIN;
+
+		int status = -1;
+		do
+		{
+			status = poll(&pollset, 1, (int)timeout);
+		} while ((status < 0) && (errno == EINTR));
+
+		return status != 0;
+	}
+
+	if (!waitWrite)
+	{
+		if (shm_rx_available(shm) != 0)
+			return TRUE;
+		return shm_poll(shm->epollfd, (int)timeout);
+	}
+
+	(void)InterlockedExchange(&shm->tx->writerWaiting, 1);
+	if (shm_tx_free(shm) != 0)
+		return TRUE;
+
+	struct pollfd pollset[2] = { 0 };
+	pollset[0].fd = shm->txSpaceFd;
+	pollset[0].events = POLLIN;
+	pollset[1].fd = shm->sockfd;
+	pollset[1].events = POLLIN | POLLRDHUP;
+
+	int status = -1;
+	do
+	{
+		status = poll(pollset, ARRAYSIZE(pollset), (int)timeout);
+	} while ((status < 0) && (errno == EINTR));
+
+	shm_drain(shm->txSpaceFd);
+	return status != 0;
+}
+
+static HANDLE shm_layer_get_event(void* userContext)
+{
+	if (!userContext)
+		return NULL;
+
+	rdpShmLayer* shm = (rdpShmLayer*)userContext;
+	return shm->hEvent;
+}
+
+static rdpTransportLayer* shm_layer_new(rdpTransport* transport)
+{
+	rdpTransportLayer* layer = transport_layer_new(transport, sizeof(rdpShmLayer));
+	if (!layer)
+		return NULL;
+
+	layer->Read = shm_layer_read;
+	layer->Write = shm_layer_write;
+	layer->Close = shm_layer_close;
+	layer->Wait = shm_layer_wait;
+	layer->GetEvent = shm_layer_get_event;
+
+	rdpShmLayer* shm = (rdpShmLayer*)layer->userContext;
+	WINPR_ASSERT(shm);
+
+	shm->sockfd = -1;
+	shm->rxDataFd = shm->rxSpaceFd = shm->txDataFd = shm->txSpaceFd = -1;
+	for (size_t x = 0; x < ARRAYSIZE(shm->fds); x++)
+		shm->fds[x] = -1;
+
+	/* the event is readable for data in the receive ring and for the socket going away */
+	shm->epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (shm->epollfd < 0)
+		goto fail;
+
+	shm->hEvent = CreateFileDescriptorEvent(NULL, TRUE, FALSE, shm->epollfd, WINPR_FD_READ);
+	if (!shm->hEvent)
+		goto fail;
+
+	return layer;
+
+fail:
+	transport_layer_free(layer);
+	return NULL;
+}
+
+static BOOL shm_layer_attach_socket(rdpShmLayer* shm, int sockfd)
+{
+	if (!shm_set_nonblock(sockfd))
+		return FALSE;
+	if (!shm_epoll_add(shm, sockfd, EPOLLIN | EPOLLRDHUP))
+		return FALSE;
+	shm->sockfd = sockfd;
+	return TRUE;
+}
+
+static BOOL shm_client_create(rdpShmLayer* shm)
+{
+	int memfd = memfd_create("freerdp-shm-transport", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memfd < 0)
+		return FALSE;
+	shm->fds[SHM_FD_MEMORY] = memfd;
+
+	if ((ftruncate(memfd, SHM_TRANSPORT_SIZE) != 0) ||
+	    (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0))
+		return FALSE;
+
+	void* base = mmap(NULL, SHM_TRANSPORT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (base == MAP_FAILED)
+		return FALSE;
+	shm->base = base;
+
+	SHM_HEADER* header = (SHM_HEADER*)shm->base;
+	memcpy(header->magic, SHM_TRANSPORT_MAGIC, SHM_TRANSPORT_MAGIC_LENGTH);
+	header->version = SHM_TRANSPORT_VERSION;
+	header->ringSize = SHM_TRANSPORT_RING_SIZE;
+
+	for (size_t x = SHM_FD_CLIENT_DATA; x < SHM_FD_COUNT; x++)
+	{
+		shm->fds[x] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (shm->fds[x] < 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL shm_client_offer(rdpShmLayer* shm, DWORD timeout)
+{
+	char magic[SHM_TRANSPORT_MAGIC_LENGTH] = { 0 };
+	memcpy(magic, SHM_TRANSPORT_MAGIC, sizeof(magic));
+
+	char control[CMSG_SPACE(sizeof(int) * SHM_FD_COUNT)] = { 0 };
+	struct iovec iov = { .iov_base = magic, .iov_len = sizeof(magic) };
+	struct msghdr msg = { 0 };
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	WINPR_ASSERT(cmsg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * SHM_FD_COUNT);
+	memcpy(CMSG_DATA(cmsg), shm->fds, sizeof(int) * SHM_FD_COUNT);
+
+	ssize_t rc = -1;
+	do
+	{
+		rc = sendmsg(shm->sockfd, &msg, MSG_NOSIGNAL);
+	} while ((rc < 0) && (errno == EINTR));
+	if (rc != (ssize_t)sizeof(magic))
+		return FALSE;
+
+	if (!shm_poll(shm->sockfd, (int)timeout))
+	{
+		WLog_ERR(TAG, "server did not answer the shared memory offer");
+		return FALSE;
+	}
+
+	char ack = 0;
+	rc = recv(shm->sockfd, &ack, sizeof(ack), MSG_DONTWAIT);
+	if ((rc != (ssize_t)sizeof(ack)) || (ack != SHM_TRANSPORT_ACK))
+	{
+		WLog_ERR(TAG, "server refused the shared memory transport");
+		return FALSE;
+	}
+
+	/* the mapping stays, the server holds its own reference */
+	close(shm->fds[SHM_FD_MEMORY]);
+	shm->fds[SHM_FD_MEMORY] = -1;
+	return TRUE;
+}
+
+BOOL freerdp_shm_transport_supported(int sockfd)
+{
+	struct sockaddr_storage addr = { 0 };
+	socklen_t length = sizeof(addr);
+	if (getsockname(sockfd, (struct sockaddr*)&addr, &length) != 0)
+		return FALSE;
+	return addr.ss_family == AF_UNIX;
+}
+
+rdpTransportLayer* freerdp_shm_transport_connect(rdpContext* context, int sockfd, DWORD timeout)
+{
+	WINPR_ASSERT(context);
+
+	rdpTransportLayer* layer = shm_layer_new(freerdp_get_transport(context));
+	if (!layer)
+		return NULL;
+
+	rdpShmLayer* shm = (rdpShmLayer*)layer->userContext;
+	if (!shm_client_create(shm) || !shm_layer_attach_socket(shm, sockfd))
+		goto fail;
+
+	if (!shm_client_offer(shm, timeout) || !shm_layer_setup(shm, FALSE))
+		goto fail;
+
+	WLog_INFO(TAG, "using the shared memory transport");
+	return layer;
+
+fail:
+	/* the caller still owns the socket */
+	shm->sockfd = -1;
+	transport_layer_free(layer);
+	return NULL;
+}
+
+rdpTransportLayer* freerdp_shm_transport_accept(rdpTransport* transport, int sockfd)
+{
+	rdpTransportLayer* layer = shm_layer_new(transport);
+	if (!layer)
+		return NULL;
+
+	rdpShmLayer* shm = (rdpShmLayer*)layer->userContext;
+	if (!shm_layer_attach_socket(shm, sockfd))
+	{
+		shm->sockfd = -1;
+		transport_layer_free(layer);
+		return NULL;
+	}
+
+	shm->probing = TRUE;
+	return layer;
+}
+
+#else
+
+BOOL freerdp_shm_transport_supported(WINPR_ATTR_UNUSED int sockfd)
+{
+	return FALSE;
+}
+
+rdpTransportLayer* freerdp_shm_transport_connect(WINPR_ATTR_UNUSED rdpContext* context,
+                                                 WINPR_ATTR_UNUSED int sockfd,
+                                                 WINPR_ATTR_UNUSED DWORD timeout)
+{
+	WLog_ERR(TAG, "shared memory transport not supported on this platform");
+	return NULL;
+}
+
+rdpTransportLayer* freerdp_shm_transport_accept(WINPR_ATTR_UNUSED rdpTransport* transport,
+                                                WINPR_ATTR_UNUSED int sockfd)
+{
+	WLog_ERR(TAG, "shared memory transport not supported on this platform");
+	return NULL;
+}
+
+#endif
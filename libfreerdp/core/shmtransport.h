@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared memory transport for local peers
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CORE_SHMTRANSPORT_H
+#define FREERDP_LIB_CORE_SHMTRANSPORT_H
+
+#include <freerdp/api.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
+
+/** TRUE if sockfd is a unix domain socket the shared memory transport can be offered on */
+FREERDP_LOCAL BOOL freerdp_shm_transport_supported(int sockfd);
+
+/**
+ * Offers shared memory rings to the server on a connected unix domain socket and waits up to
+ * timeout ms for the answer. On success the returned layer owns sockfd.
+ */
+FREERDP_LOCAL rdpTransportLayer* freerdp_shm_transport_connect(rdpContext* context, int sockfd,
+                                                               DWORD timeout);
+
+/**
+ * Wraps an accepted unix domain socket. The layer switches to the rings if the first data of
+ * the client is an offer and stays a plain socket otherwise. On success the layer owns sockfd.
+ */
+FREERDP_LOCAL rdpTransportLayer* freerdp_shm_transport_accept(rdpTransport* transport,
+                                                              int sockfd);
+
+#endif /* FREERDP_LIB_CORE_SHMTRANSPORT_H */
@@ -21,6 +21,7 @@
 
 #include <time.h>
 
+#include <winpr/synch.h>
 #include <winpr/sysinfo.h>
 #include <winpr/path.h>
 #include <winpr/string.h>
@@ -38,28 +39,57 @@ struct stream_dump_context
 	rdpTransportIo io;
 	size_t writeDumpOffset;
 	size_t readDumpOffset;
-	size_t replayOffset;
 	UINT64 replayTime;
 	CONNECTION_STATE state;
 	BOOL isServer;
 	BOOL nodelay;
+	FILE* replayFile;
 	wLog* log;
+
+	/* replay statistics, collected in nodelay mode */
+	struct
+	{
+		UINT64 start;
+		UINT64 last;
+		UINT64 readTime;
+		UINT64 processTime[2];
+		UINT64 pdus[2];
+		UINT64 bytes[2];
+		size_t current;
+		BOOL reported;
+	} stats;
 };
 
-static UINT32 crc32b(const BYTE* data, size_t length)
-{
-	UINT32 crc = 0xFFFFFFFF;
+static UINT32 crc32_table[256] = { 0 };
 
-	for (size_t x = 0; x < length; x++)
+static BOOL CALLBACK crc32_table_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                      WINPR_ATTR_UNUSED PVOID param,
+                                      WINPR_ATTR_UNUSED PVOID* context)
+{
+	for (UINT32 x = 0; x < ARRAYSIZE(crc32_table); x++)
 	{
-		const UINT32 d = data[x] & 0xFF;
-		crc = crc ^ d;
+		UINT32 crc = x;
 		for (int j = 7; j >= 0; j--)
 		{
 			UINT32 mask = ~(crc & 1);
 			crc = (crc >> 1) ^ (0xEDB88320 & mask);
 		}
+		crc32_table[x] = crc;
 	}
+	return TRUE;
+}
+
+static UINT32 crc32b(const BYTE* data, size_t length)
+{
+	static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+	UINT32 crc = 0xFFFFFFFF;
+
+	if (!InitOnceExecuteOnce(&once, crc32_table_init, NULL, NULL))
+		return 0;
+
+	/* table driven, one lookup per byte instead of eight shifts */
+	for (size_t x = 0; x < length; x++)
+		crc = (crc >> 8) ^ crc32_table[(crc ^ data[x]) & 0xFF];
 	return ~crc;
 }
 
@@ -343,6 +373,30 @@ static int stream_dump_replay_transport_write(rdpTransport* transport, wStream*
 	return 1;
 }
 
+static void stream_dump_replay_report(rdpStreamDumpContext* dump)
+{
+	WINPR_ASSERT(dump);
+
+	if (!dump->nodelay || dump->stats.reported || (dump->stats.start == 0))
+		return;
+	dump->stats.reported = TRUE;
+
+	const char* names[] = { "fastpath", "slowpath" };
+	const UINT64 total = winpr_GetTickCount64NS() - dump->stats.start;
+	WLog_Print(dump->log, WLOG_INFO,
+	           "replay finished after %" PRIu64 " ms, %" PRIu64 " ms reading the dump",
+	           total / 1000000, dump->stats.readTime / 1000000);
+	for (size_t x = 0; x < ARRAYSIZE(names); x++)
+	{
+		const UINT64 pdus = dump->stats.pdus[x];
+		const UINT64 ns = dump->stats.processTime[x];
+		WLog_Print(dump->log, WLOG_INFO,
+		           "replay %s: %" PRIu64 " PDUs, %" PRIu64 " bytes, %" PRIu64
+		           " ms processing, %" PRIu64 " us/PDU",
+		           names[x], pdus, dump->stats.bytes[x], ns / 1000000, pdus ? ns / pdus / 1000 : 0);
+	}
+}
+
 static int stream_dump_replay_transport_read(rdpTransport* transport, wStream* s)
 {
 	rdpContext* ctx = transport_get_context(transport);
@@ -356,24 +410,57 @@ static int stream_dump_replay_transport_read(rdpTransport* transport, wStream* s
 	WINPR_ASSERT(ctx->dump);
 	WINPR_ASSERT(s);
 
+	rdpStreamDumpContext* dump = ctx->dump;
+	const UINT64 now = winpr_GetTickCount64NS();
+	if (dump->nodelay)
+	{
+		/* everything since the last PDU was returned was spent processing it */
+		if (dump->stats.start == 0)
+			dump->stats.start = now;
+		else
+			dump->stats.processTime[dump->stats.current] += now - dump->stats.last;
+	}
+
+	/* the dump is read sequentially, keep it open for the whole replay */
+	if (!dump->replayFile)
+	{
+		dump->replayFile = stream_dump_get_file(ctx->settings, "rb");
+		if (!dump->replayFile)
+			return -1;
+	}
+
 	const size_t start = Stream_GetPosition(s);
 	do
 	{
 		Stream_SetPosition(s, start);
-		if (stream_dump_get(ctx, &flags, s, &ctx->dump->replayOffset, &ts) < 0)
+		if (!stream_dump_read_line(dump->replayFile, s, &ts, NULL, &flags))
+		{
+			stream_dump_replay_report(dump);
 			return -1;
+		}
 	} while (flags & STREAM_MSG_SRV_RX);
 
-	if (!ctx->dump->nodelay)
+	if (!dump->nodelay)
 	{
-		if ((ctx->dump->replayTime > 0) && (ts > ctx->dump->replayTime))
-			slp = ts - ctx->dump->replayTime;
+		if ((dump->replayTime > 0) && (ts > dump->replayTime))
+			slp = ts - dump->replayTime;
 	}
-	ctx->dump->replayTime = ts;
+	dump->replayTime = ts;
 
 	size = Stream_Length(s);
 	Stream_SetPosition(s, 0);
-	WLog_Print(ctx->dump->log, WLOG_TRACE, "replay read %" PRIuz, size);
+	WLog_Print(dump->log, WLOG_TRACE, "replay read %" PRIuz, size);
+
+	if (dump->nodelay)
+	{
+		/* fastpath PDUs carry the action 0 in the low bits, slow path ones are TPKT */
+		const BYTE header = (size > 0) ? Stream_Buffer(s)[0] : 0;
+		dump->stats.current = ((header & 0x03) == 0) ? 0 : 1;
+		dump->stats.pdus[dump->stats.current]++;
+		dump->stats.bytes[dump->stats.current] += size;
+		dump->stats.last = winpr_GetTickCount64NS();
+		dump->stats.readTime += dump->stats.last - now;
+	}
 
 	if (slp > 0)
 	{
@@ -470,6 +557,12 @@ BOOL stream_dump_register_handlers(rdpContext* context, CONNECTION_STATE state,
 
 void stream_dump_free(rdpStreamDumpContext* dump)
 {
+	if (!dump)
+		return;
+
+	stream_dump_replay_report(dump);
+	if (dump->replayFile)
+		(void)fclose(dump->replayFile);
 	free(dump);
 }
 
@@ -181,7 +181,7 @@ static BOOL update_recv_surfcmd_frame_marker(rdpUpdate* update, wStream* s)
 	if (!update->SurfaceFrameMarker)
 	{
 		WINPR_ASSERT(update->context);
-		if (freerdp_settings_get_bool(update->context->settings, FreeRDP_DeactivateClientDecoding))
+		if (update->context->settings->DeactivateClientDecoding)
 			return TRUE;
 		WLog_ERR(TAG, "Missing callback update->SurfaceFrameMarker");
 		return FALSE;
@@ -285,14 +285,10 @@ static BOOL update_write_surfcmd_bitmap_ex(wStream* s, const TS_BITMAP_DATA_EX*
 			return FALSE;
 	}
 
-	if (!Stream_EnsureRemainingCapacity(s, bmp->bitmapDataLength))
-		return FALSE;
-
-	Stream_Write(s, bmp->bitmapData, bmp->bitmapDataLength);
 	return TRUE;
 }
 
-BOOL update_write_surfcmd_surface_bits(wStream* s, const SURFACE_BITS_COMMAND* cmd)
+BOOL update_write_surfcmd_surface_bits_header(wStream* s, const SURFACE_BITS_COMMAND* cmd)
 {
 	if (!Stream_EnsureRemainingCapacity(s, SURFCMD_SURFACE_BITS_HEADER_LENGTH))
 		return FALSE;
@@ -321,6 +317,18 @@ BOOL update_write_surfcmd_surface_bits(wStream* s, const SURFACE_BITS_COMMAND* c
 	return update_write_surfcmd_bitmap_ex(s, &cmd->bmp);
 }
 
+BOOL update_write_surfcmd_surface_bits(wStream* s, const SURFACE_BITS_COMMAND* cmd)
+{
+	if (!update_write_surfcmd_surface_bits_header(s, cmd))
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, cmd->bmp.bitmapDataLength))
+		return FALSE;
+
+	Stream_Write(s, cmd->bmp.bitmapData, cmd->bmp.bitmapDataLength);
+	return TRUE;
+}
+
 BOOL update_write_surfcmd_frame_marker(wStream* s, UINT16 frameAction, UINT32 frameId)
 {
 	if (!Stream_EnsureRemainingCapacity(s, SURFCMD_FRAME_MARKER_LENGTH))
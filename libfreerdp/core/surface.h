@@ -31,6 +31,10 @@
 FREERDP_LOCAL int update_recv_surfcmds(rdpUpdate* update, wStream* s);
 
 FREERDP_LOCAL BOOL update_write_surfcmd_surface_bits(wStream* s, const SURFACE_BITS_COMMAND* cmd);
+
+/** Writes the surface bits command up to its bitmap data, which the caller sends on its own */
+FREERDP_LOCAL BOOL update_write_surfcmd_surface_bits_header(wStream* s,
+                                                            const SURFACE_BITS_COMMAND* cmd);
 FREERDP_LOCAL BOOL update_write_surfcmd_frame_marker(wStream* s, UINT16 frameAction,
                                                      UINT32 frameId);
 
@@ -29,6 +29,7 @@
 #include <winpr/crt.h>
 #include <winpr/platform.h>
 #include <winpr/winsock.h>
+#include <winpr/sysinfo.h>
 
 #include "rdp.h"
 #include "utils.h"
@@ -83,6 +84,7 @@
 #include <winpr/stream.h>
 
 #include "tcp.h"
+#include "shmtransport.h"
 #include "../crypto/opensslcompat.h"
 
 #if defined(HAVE_AF_VSOCK_H)
@@ -92,12 +94,89 @@
 
 #define TAG FREERDP_TAG("core")
 
+/* OpenSSL hands the record keys to the socket BIO with controls it does not export */
+#if !defined(OPENSSL_NO_KTLS) && !defined(LIBRESSL_VERSION_NUMBER) && \
+    (OPENSSL_VERSION_NUMBER >= 0x30000000L) && defined(__linux__)
+#define WITH_KTLS_BIO
+#ifndef BIO_CTRL_SET_KTLS
+#define BIO_CTRL_SET_KTLS 72
+#endif
+#ifndef BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG
+#define BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG 74
+#endif
+#ifndef BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG
+#define BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG 75
+#endif
+#endif
+
+/* send buffer bounds of the latency mode, the kernel doubles the value set */
+#define TCP_LATENCY_SNDBUF_MIN (16 * 1024)
+#define TCP_LATENCY_SNDBUF_MAX (4 * 1024 * 1024)
+#define TCP_LATENCY_SNDBUF_INTERVAL_NS 1000000000ull
+
+typedef struct
+{
+	BOOL enabled;
+	int size;
+	UINT64 nextUpdate;
+} rdpTcpSendBuffer;
+
+/* Size the send buffer to the bandwidth delay product the connection currently achieves.
+ * A larger buffer only adds queueing delay in front of input responses and acks. */
+static void freerdp_tcp_update_send_buffer(rdpTcpSendBuffer* sendBuffer, SOCKET sockfd)
+{
+	WINPR_ASSERT(sendBuffer);
+
+	if (!sendBuffer->enabled)
+		return;
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	if (now < sendBuffer->nextUpdate)
+		return;
+	sendBuffer->nextUpdate = now + TCP_LATENCY_SNDBUF_INTERVAL_NS;
+
+#if defined(__linux__) && defined(TCP_INFO)
+	struct tcp_info info = { 0 };
+	socklen_t len = sizeof(info);
+	if (getsockopt((int)sockfd, IPPROTO_TCP, TCP_INFO, (void*)&info, &len) < 0)
+		return;
+
+	/* the congestion window is what the path carries per round trip */
+	const UINT64 bdp = 1ull * info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+	const int size = (int)MIN(MAX(bdp, TCP_LATENCY_SNDBUF_MIN), TCP_LATENCY_SNDBUF_MAX);
+
+	/* ignore small changes, the window always oscillates a bit */
+	if ((sendBuffer->size > 0) && (size > sendBuffer->size * 3 / 4) &&
+	    (size < sendBuffer->size * 5 / 4))
+		return;
+
+	if (setsockopt((int)sockfd, SOL_SOCKET, SO_SNDBUF, (void*)&size, sizeof(size)) < 0)
+	{
+		WLog_WARN(TAG, "setsockopt() SOL_SOCKET, SO_SNDBUF");
+		sendBuffer->enabled = FALSE;
+		return;
+	}
+
+	WLog_DBG(TAG, "send buffer %d bytes, rtt %" PRIu32 " us, cwnd %" PRIu32 " x %" PRIu32, size,
+	         info.tcpi_rtt, info.tcpi_snd_cwnd, info.tcpi_snd_mss);
+	sendBuffer->size = size;
+#else
+	WINPR_UNUSED(sockfd);
+	sendBuffer->enabled = FALSE;
+#endif
+}
+
 /* Simple Socket BIO */
 
 typedef struct
 {
 	SOCKET socket;
 	HANDLE hEvent;
+	rdpTcpSendBuffer sendBuffer;
+#if defined(WITH_KTLS_BIO)
+	BIO* ktlsBio; /* OpenSSL socket BIO on the same socket, owns the kernel TLS state */
+	BOOL ktlsCtrlMsg;
+#endif
 } WINPR_BIO_SIMPLE_SOCKET;
 
 static int transport_bio_simple_init(BIO* bio, SOCKET socket, int shutdown);
@@ -113,6 +192,22 @@ static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
 		return 0;
 
 	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
+
+#if defined(WITH_KTLS_BIO)
+	/* non application data records must be sent with the record type attached */
+	if (ptr->ktlsBio && ptr->ktlsCtrlMsg)
+	{
+		status = BIO_write(ptr->ktlsBio, buf, size);
+		if (status > 0)
+			ptr->ktlsCtrlMsg = FALSE;
+		else if (BIO_should_retry(ptr->ktlsBio))
+			BIO_set_flags(bio, (BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY));
+		else
+			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+		return status;
+	}
+#endif
+
 	status = _send(ptr->socket, buf, size, 0);
 
 	if (status <= 0)
@@ -129,6 +224,8 @@ static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
 			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
 		}
 	}
+	else
+		freerdp_tcp_update_send_buffer(&ptr->sendBuffer, ptr->socket);
 
 	return status;
 }
@@ -206,6 +303,9 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 
 			*((HANDLE*)arg2) = ptr->hEvent;
 			return 1;
+		case BIO_C_SET_LATENCY_MODE:
+			ptr->sendBuffer.enabled = (arg1 != 0);
+			return 1;
 		case BIO_C_SET_NONBLOCK:
 		{
 #ifndef _WIN32
@@ -338,6 +438,48 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 			status = 1;
 			break;
 
+#if defined(WITH_KTLS_BIO)
+		case BIO_CTRL_SET_KTLS:
+			/* only transmit, the TLS BIO reads ahead and keeps decrypting in user space */
+			status = 0;
+			if (!arg1 || !BIO_get_init(bio))
+				break;
+
+			if (!ptr->ktlsBio)
+				ptr->ktlsBio = BIO_new_socket((int)ptr->socket, BIO_NOCLOSE);
+			if (!ptr->ktlsBio)
+				break;
+
+			status = (int)BIO_ctrl(ptr->ktlsBio, cmd, arg1, arg2);
+			if (status <= 0)
+			{
+				WLog_WARN(TAG, "kernel TLS not available, encrypting in user space");
+				BIO_free(ptr->ktlsBio);
+				ptr->ktlsBio = NULL;
+			}
+			break;
+
+		case BIO_CTRL_GET_KTLS_SEND:
+			status = ptr->ktlsBio ? (int)BIO_ctrl(ptr->ktlsBio, cmd, arg1, arg2) : 0;
+			break;
+
+		case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+			status = 0;
+			if (ptr->ktlsBio)
+			{
+				status = (int)BIO_ctrl(ptr->ktlsBio, cmd, arg1, arg2);
+				ptr->ktlsCtrlMsg = TRUE;
+			}
+			break;
+
+		case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+			status = 0;
+			if (ptr->ktlsBio)
+				status = (int)BIO_ctrl(ptr->ktlsBio, cmd, arg1, arg2);
+			ptr->ktlsCtrlMsg = FALSE;
+			break;
+#endif
+
 		default:
 			status = 0;
 			break;
@@ -388,6 +530,15 @@ static int transport_bio_simple_uninit(BIO* bio)
 		ptr->hEvent = NULL;
 	}
 
+#if defined(WITH_KTLS_BIO)
+	if (ptr)
+	{
+		BIO_free(ptr->ktlsBio);
+		ptr->ktlsBio = NULL;
+		ptr->ktlsCtrlMsg = FALSE;
+	}
+#endif
+
 	BIO_set_init(bio, 0);
 	BIO_set_flags(bio, 0);
 	return 1;
@@ -581,7 +732,23 @@ static long transport_bio_buffered_ctrl(BIO* bio, int cmd, long arg1, void* arg2
 			else
 				status = (transport_bio_buffered_write(bio, NULL, 0) >= 0) ? 1 : -1;
 
+#if defined(WITH_KTLS_BIO)
+			/* the kernel must not see pending records mixed with the next control record */
+			if ((status > 0) && ringbuffer_used(&ptr->xmitBuffer) &&
+			    BIO_get_ktls_send(BIO_next(bio)))
+				status = -1;
+#endif
+			break;
+
+#if defined(WITH_KTLS_BIO)
+		case BIO_CTRL_SET_KTLS:
+			/* records still queued here are already encrypted */
+			if (ringbuffer_used(&ptr->xmitBuffer))
+				status = 0;
+			else
+				status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
 			break;
+#endif
 
 		case BIO_CTRL_WPENDING:
 			status = WINPR_ASSERTING_INT_CAST(long, ringbuffer_used(&ptr->xmitBuffer));
@@ -802,125 +969,219 @@ static BOOL freerdp_tcp_is_hostname_resolvable(rdpContext* context, const char*
 	return TRUE;
 }
 
-static BOOL freerdp_tcp_connect_timeout(rdpContext* context, int sockfd, struct sockaddr* addr,
-                                        socklen_t addrlen, UINT32 timeout)
+/* the candidates are raced as in RFC 8305, a new attempt starts after the attempt delay */
+#define TCP_CONNECT_MAX_CANDIDATES 16
+
+typedef struct
 {
-	BOOL rc = FALSE;
-	HANDLE handles[2] = { 0 };
-	DWORD count = 0;
-	u_long arg = 0;
-	DWORD tout = (timeout > 0) ? timeout : INFINITE;
+	SOCKET s;
+	HANDLE event;
+	const struct addrinfo* addr;
+} t_candidate;
 
-	handles[count] = CreateEvent(NULL, TRUE, FALSE, NULL);
+static void candidate_close(t_candidate* candidate)
+{
+	WINPR_ASSERT(candidate);
+
+	if (candidate->event)
+		(void)CloseHandle(candidate->event);
+	if (candidate->s != INVALID_SOCKET)
+		closesocket(candidate->s);
+	candidate->event = NULL;
+	candidate->s = INVALID_SOCKET;
+}
+
+static BOOL candidate_start(t_candidate* candidate, BOOL* pConnected)
+{
+	WINPR_ASSERT(candidate);
+	WINPR_ASSERT(pConnected);
+
+	const struct addrinfo* addr = candidate->addr;
+	WINPR_ASSERT(addr);
 
-	if (!handles[count])
+	candidate->s = _socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+	if (candidate->s == INVALID_SOCKET)
 		return FALSE;
 
-	const int wsastatus = WSAEventSelect((SOCKET)sockfd, handles[count++],
-	                                     FD_READ | FD_WRITE | FD_CONNECT | FD_CLOSE);
+	candidate->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!candidate->event)
+		goto fail;
 
-	if (wsastatus < 0)
+	if (WSAEventSelect(candidate->s, candidate->event, FD_READ | FD_WRITE | FD_CONNECT | FD_CLOSE) <
+	    0)
 	{
 		WLog_ERR(TAG, "WSAEventSelect failed with %d", WSAGetLastError());
 		goto fail;
 	}
 
-	handles[count++] = utils_get_abort_event(context->rdp);
-	const int constatus = _connect((SOCKET)sockfd, addr, WINPR_ASSERTING_INT_CAST(int, addrlen));
-
-	if (constatus < 0)
+	char* peerAddress =
+	    freerdp_tcp_address_to_string((const struct sockaddr_storage*)addr->ai_addr, NULL);
+	if (peerAddress)
 	{
-		const int estatus = WSAGetLastError();
+		WLog_DBG(TAG, "connecting to peer %s", peerAddress);
+		free(peerAddress);
+	}
 
-		switch (estatus)
+	const int status =
+	    _connect(candidate->s, addr->ai_addr, WINPR_ASSERTING_INT_CAST(int, addr->ai_addrlen));
+	if (status < 0)
+	{
+		switch (WSAGetLastError())
 		{
 			case WSAEINPROGRESS:
 			case WSAEWOULDBLOCK:
-				break;
-
+				return TRUE;
 			default:
 				goto fail;
 		}
 	}
 
-	const DWORD wstatus = WaitForMultipleObjects(count, handles, FALSE, tout);
+	*pConnected = TRUE;
+	return TRUE;
 
-	if (WAIT_OBJECT_0 != wstatus)
-		goto fail;
+fail:
+	candidate_close(candidate);
+	return FALSE;
+}
 
-	const SSIZE_T res = recv(sockfd, NULL, 0, 0);
+static BOOL candidate_connected(const t_candidate* candidate)
+{
+	WINPR_ASSERT(candidate);
 
-	if (res == SOCKET_ERROR)
-	{
-		if (WSAGetLastError() == WSAECONNRESET)
-			goto fail;
-	}
+	int error = 0;
+	socklen_t len = sizeof(error);
+	if (getsockopt(candidate->s, SOL_SOCKET, SO_ERROR, (void*)&error, &len) != 0)
+		return FALSE;
+	return error == 0;
+}
 
-	const int status = WSAEventSelect((SOCKET)sockfd, handles[0], 0);
+/**
+ * Connect to the first of the candidates that answers. The attempts are started one after
+ * another with FreeRDP_TcpConnectAttemptDelay in between, a failed attempt starts the next one
+ * right away. The returned socket is in blocking mode again.
+ */
+static SOCKET freerdp_tcp_connect_race(rdpContext* context, const struct addrinfo** addrs,
+                                       size_t count, DWORD timeout)
+{
+	SOCKET sockfd = INVALID_SOCKET;
+	t_candidate candidates[TCP_CONNECT_MAX_CANDIDATES] = { 0 };
+	HANDLE handles[TCP_CONNECT_MAX_CANDIDATES + 1] = { 0 };
+	size_t map[TCP_CONNECT_MAX_CANDIDATES + 1] = { 0 };
 
-	if (status < 0)
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(addrs);
+
+	const UINT32 delay =
+	    freerdp_settings_get_uint32(context->settings, FreeRDP_TcpConnectAttemptDelay);
+	const UINT64 start = GetTickCount64();
+
+	count = MIN(count, ARRAYSIZE(candidates));
+	for (size_t x = 0; x < count; x++)
 	{
-		WLog_ERR(TAG, "WSAEventSelect failed with %d", WSAGetLastError());
-		goto fail;
+		candidates[x].s = INVALID_SOCKET;
+		candidates[x].addr = addrs[x];
 	}
 
-	if (_ioctlsocket((SOCKET)sockfd, FIONBIO, &arg) != 0)
-		goto fail;
+	size_t next = 0;
+	size_t winner = count;
+	while (winner == count)
+	{
+		BOOL connected = FALSE;
+		while (next < count)
+		{
+			if (candidate_start(&candidates[next++], &connected))
+				break;
+		}
 
-	rc = TRUE;
-fail:
-	(void)CloseHandle(handles[0]);
-	return rc;
-}
+		if (connected)
+		{
+			winner = next - 1;
+			break;
+		}
 
-typedef struct
-{
-	SOCKET s;
-	struct addrinfo* addr;
-	struct addrinfo* result;
-} t_peer;
+		DWORD nevents = 0;
+		handles[nevents++] = utils_get_abort_event(context->rdp);
+		for (size_t x = 0; x < next; x++)
+		{
+			if (candidates[x].s == INVALID_SOCKET)
+				continue;
+			map[nevents] = x;
+			handles[nevents++] = candidates[x].event;
+		}
 
-static void peer_free(t_peer* peer)
-{
-	if (peer->s != INVALID_SOCKET)
-		closesocket(peer->s);
+		/* every candidate failed */
+		if (nevents == 1)
+			break;
+
+		DWORD wait = INFINITE;
+		if (timeout > 0)
+		{
+			const UINT64 elapsed = GetTickCount64() - start;
+			if (elapsed >= timeout)
+				break;
+			wait = (DWORD)(timeout - elapsed);
+		}
+		if ((next < count) && (wait > delay))
+			wait = delay;
+
+		const DWORD status = WaitForMultipleObjects(nevents, handles, FALSE, wait);
+		if (status == WAIT_TIMEOUT)
+			continue;
+		if ((status == WAIT_OBJECT_0) || (status >= WAIT_OBJECT_0 + nevents))
+			break;
+
+		const size_t index = map[status - WAIT_OBJECT_0];
+		if (candidate_connected(&candidates[index]))
+			winner = index;
+		else
+			candidate_close(&candidates[index]);
+	}
+
+	if (winner < count)
+	{
+		t_candidate* candidate = &candidates[winner];
+		u_long arg = 0;
+		if (WSAEventSelect(candidate->s, candidate->event, 0) < 0)
+			WLog_ERR(TAG, "WSAEventSelect failed with %d", WSAGetLastError());
+		else if (_ioctlsocket(candidate->s, FIONBIO, &arg) == 0)
+		{
+			sockfd = candidate->s;
+			candidate->s = INVALID_SOCKET;
+		}
+	}
 
-	freeaddrinfo(peer->addr);
-	memset(peer, 0, sizeof(t_peer));
-	peer->s = INVALID_SOCKET;
+	for (size_t x = 0; x < count; x++)
+		candidate_close(&candidates[x]);
+	return sockfd;
 }
 
 static int freerdp_tcp_connect_multi(rdpContext* context, char** hostnames, const UINT32* ports,
-                                     UINT32 count, UINT16 port, WINPR_ATTR_UNUSED UINT32 timeout)
+                                     UINT32 count, UINT16 port, UINT32 timeout)
 {
-	UINT32 sindex = count;
-	SOCKET sockfd = INVALID_SOCKET;
-	struct addrinfo* addr = NULL;
-	struct addrinfo* result = NULL;
-
-	HANDLE* events = (HANDLE*)calloc(count + 1, sizeof(HANDLE));
-	t_peer* peers = (t_peer*)calloc(count, sizeof(t_peer));
+	size_t naddrs = 0;
+	const struct addrinfo* addrs[TCP_CONNECT_MAX_CANDIDATES] = { 0 };
+	struct addrinfo** results = (struct addrinfo**)calloc(count, sizeof(struct addrinfo*));
 
-	if (!peers || !events || (count < 1))
+	if (!results || (count < 1))
 	{
-		free(peers);
-		free((void*)events);
+		free((void*)results);
 		return -1;
 	}
 
-	for (UINT32 index = 0; index < count; index++)
+	for (UINT32 index = 0; (index < count) && (naddrs < ARRAYSIZE(addrs)); index++)
 	{
 		int curPort = port;
 
 		if (ports)
 			curPort = WINPR_ASSERTING_INT_CAST(int, ports[index]);
 
-		result = freerdp_tcp_resolve_host(hostnames[index], curPort, 0);
+		struct addrinfo* result = freerdp_tcp_resolve_host(hostnames[index], curPort, 0);
 
 		if (!result)
 			continue;
 
-		addr = result;
+		results[index] = result;
+		struct addrinfo* addr = result;
 
 		if ((addr->ai_family == AF_INET6) && (addr->ai_next != 0))
 		{
@@ -934,51 +1195,21 @@ static int freerdp_tcp_connect_multi(rdpContext* context, char** hostnames, cons
 				addr = result;
 		}
 
-		peers[index].s = _socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-
-		if (peers[index].s == INVALID_SOCKET)
-		{
-			freeaddrinfo(result);
-			continue;
-		}
-
-		peers[index].addr = addr;
-		peers[index].result = result;
+		addrs[naddrs++] = addr;
 	}
 
-	for (UINT32 index = 0; index < count; index++)
-	{
-		sockfd = peers[index].s;
-		addr = peers[index].addr;
-
-		if ((sockfd == INVALID_SOCKET) || (!addr))
-			continue;
-
-		/* blocking tcp connect */
-		const int rc =
-		    _connect(sockfd, addr->ai_addr, WINPR_ASSERTING_INT_CAST(int, addr->ai_addrlen));
-
-		if (rc >= 0)
-		{
-			/* connection success */
-			sindex = index;
-			break;
-		}
-	}
-
-	if (sindex < count)
-	{
-		sockfd = peers[sindex].s;
-		peers[sindex].s = INVALID_SOCKET;
-	}
-	else
+	/* the addresses are in order of preference, keep it when racing them */
+	const SOCKET sockfd = freerdp_tcp_connect_race(context, addrs, naddrs, timeout);
+	if (sockfd == INVALID_SOCKET)
 		freerdp_set_last_error_log(context, FREERDP_ERROR_CONNECT_CANCELLED);
 
 	for (UINT32 index = 0; index < count; index++)
-		peer_free(&peers[index]);
+	{
+		if (results[index])
+			freeaddrinfo(results[index]);
+	}
 
-	free(peers);
-	free((void*)events);
+	free((void*)results);
 	return (int)sockfd;
 }
 
@@ -1054,6 +1285,36 @@ BOOL freerdp_tcp_set_keep_alive_mode(const rdpSettings* settings, int sockfd)
 	return TRUE;
 }
 
+BOOL freerdp_tcp_set_latency_mode(const rdpSettings* settings, int sockfd)
+{
+	WINPR_ASSERT(settings);
+
+	if (!freerdp_settings_get_bool(settings, FreeRDP_TcpLatencyMode))
+		return TRUE;
+
+#ifdef TCP_NOTSENT_LOWAT
+	/* only keep what the network takes soon in the kernel, later frames wait in our buffers
+	 * where they are still merged or dropped instead of delaying everything behind them */
+	const UINT32 lowat = freerdp_settings_get_uint32(settings, FreeRDP_TcpNotSentLowat);
+	if (lowat > 0)
+	{
+		const int optval = (int)MIN(lowat, INT32_MAX);
+		if (setsockopt(sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, (const void*)&optval,
+		               sizeof(optval)) < 0)
+			WLog_WARN(TAG, "setsockopt() IPPROTO_TCP, TCP_NOTSENT_LOWAT");
+	}
+#endif
+#ifdef TCP_CONGESTION
+	const char* cc = freerdp_settings_get_string(settings, FreeRDP_TcpCongestionControl);
+	if (cc && (cc[0] != '\0'))
+	{
+		if (setsockopt(sockfd, IPPROTO_TCP, TCP_CONGESTION, cc, (socklen_t)strlen(cc)) < 0)
+			WLog_WARN(TAG, "congestion control '%s' not available, keeping the default", cc);
+	}
+#endif
+	return TRUE;
+}
+
 int freerdp_tcp_connect(rdpContext* context, const char* hostname, int port, DWORD timeout)
 {
 	rdpTransport* transport = NULL;
@@ -1065,50 +1326,70 @@ int freerdp_tcp_connect(rdpContext* context, const char* hostname, int port, DWO
 	return transport_tcp_connect(context->rdp->transport, hostname, port, timeout);
 }
 
-static int get_next_addrinfo(rdpContext* context, struct addrinfo* input, struct addrinfo** result,
-                             UINT32 errorCode)
+/**
+ * Order the resolved addresses as RFC 8305 section 4 describes: the address families alternate,
+ * starting with the family of the first address, or IPv6 if PreferIPv6OverIPv4 is set.
+ */
+static size_t freerdp_tcp_sort_candidates(rdpContext* context, const struct addrinfo* input,
+                                          const struct addrinfo** addrs, size_t max)
 {
 	WINPR_ASSERT(context);
-	WINPR_ASSERT(result);
+	WINPR_ASSERT(addrs);
 
-	struct addrinfo* addr = input;
-	if (!addr)
-		goto fail;
-
-	if (freerdp_settings_get_bool(context->settings, FreeRDP_PreferIPv6OverIPv4))
-	{
-		while (addr && (addr->ai_family != AF_INET6))
-			addr = addr->ai_next;
-		if (!addr)
-			addr = input;
-	}
-
-	/* We want to force IPvX, abort if not detected */
+	int force = AF_UNSPEC;
 	const UINT32 IPvX = freerdp_settings_get_uint32(context->settings, FreeRDP_ForceIPvX);
 	switch (IPvX)
 	{
 		case 4:
+			force = AF_INET;
+			break;
 		case 6:
-		{
-			const int family = (IPvX == 4) ? AF_INET : AF_INET6;
-			while (addr && (addr->ai_family != family))
-				addr = addr->ai_next;
-		}
-		break;
+			force = AF_INET6;
+			break;
 		default:
 			break;
 	}
 
-	if (!addr)
-		goto fail;
+	int first = AF_UNSPEC;
+	for (const struct addrinfo* addr = input; addr; addr = addr->ai_next)
+	{
+		if ((force != AF_UNSPEC) && (addr->ai_family != force))
+			continue;
+		if (first == AF_UNSPEC)
+			first = addr->ai_family;
+		if ((addr->ai_family == AF_INET6) &&
+		    freerdp_settings_get_bool(context->settings, FreeRDP_PreferIPv6OverIPv4))
+			first = AF_INET6;
+	}
 
-	*result = addr;
-	return 0;
+	const struct addrinfo* primary = input;
+	const struct addrinfo* secondary = input;
+	size_t count = 0;
+	while (count < max)
+	{
+		while (primary && ((primary->ai_family != first) ||
+		                   ((force != AF_UNSPEC) && (primary->ai_family != force))))
+			primary = primary->ai_next;
+		while (secondary && ((secondary->ai_family == first) ||
+		                     ((force != AF_UNSPEC) && (secondary->ai_family != force))))
+			secondary = secondary->ai_next;
+
+		if (!primary && !secondary)
+			break;
 
-fail:
-	freerdp_set_last_error_if_not(context, errorCode);
-	freeaddrinfo(input);
-	return -1;
+		if (primary)
+		{
+			addrs[count++] = primary;
+			primary = primary->ai_next;
+		}
+		if (secondary && (count < max))
+		{
+			addrs[count++] = secondary;
+			secondary = secondary->ai_next;
+		}
+	}
+
+	return count;
 }
 
 int freerdp_tcp_default_connect(rdpContext* context, rdpSettings* settings, const char* hostname,
@@ -1211,11 +1492,8 @@ int freerdp_tcp_default_connect(rdpContext* context, rdpSettings* settings, cons
 
 		if (sockfd <= 0)
 		{
-			char* peerAddress = NULL;
-			struct addrinfo* addr = NULL;
-			struct addrinfo* result = NULL;
-
-			result = freerdp_tcp_resolve_host(hostname, port, 0);
+			const UINT64 dnsStart = winpr_GetTickCount64NS();
+			struct addrinfo* result = freerdp_tcp_resolve_host(hostname, port, 0);
 
 			if (!result)
 			{
@@ -1224,47 +1502,30 @@ int freerdp_tcp_default_connect(rdpContext* context, rdpSettings* settings, cons
 				return -1;
 			}
 			freerdp_set_last_error_log(context, 0);
+			rdp_timeline_add(context->rdp, "dns", dnsStart);
 
-			/* By default we take the first returned entry.
-			 *
-			 * If PreferIPv6OverIPv4 = TRUE we force to IPv6 if there
-			 * is such an address available, but fall back to first if not found
-			 */
-			const int rc =
-			    get_next_addrinfo(context, result, &addr, FREERDP_ERROR_DNS_NAME_NOT_FOUND);
-			if (rc < 0)
-				return rc;
-
-			do
-			{
-				sockfd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-				if (sockfd < 0)
-				{
-					const int lrc = get_next_addrinfo(context, addr->ai_next, &addr,
-					                                  FREERDP_ERROR_CONNECT_FAILED);
-					if (lrc < 0)
-						return lrc;
-				}
-			} while (sockfd < 0);
-
-			if ((peerAddress = freerdp_tcp_address_to_string(
-			         (const struct sockaddr_storage*)addr->ai_addr, NULL)) != NULL)
+			const struct addrinfo* addrs[TCP_CONNECT_MAX_CANDIDATES] = { 0 };
+			const size_t count =
+			    freerdp_tcp_sort_candidates(context, result, addrs, ARRAYSIZE(addrs));
+			if (count == 0)
 			{
-				WLog_DBG(TAG, "connecting to peer %s", peerAddress);
-				free(peerAddress);
+				freeaddrinfo(result);
+				freerdp_set_last_error_if_not(context, FREERDP_ERROR_DNS_NAME_NOT_FOUND);
+				return -1;
 			}
 
-			if (!freerdp_tcp_connect_timeout(context, sockfd, addr->ai_addr, addr->ai_addrlen,
-			                                 timeout))
+			const UINT64 tcpStart = winpr_GetTickCount64NS();
+			sockfd = (int)freerdp_tcp_connect_race(context, addrs, count, timeout);
+			if (sockfd < 0)
 			{
 				freeaddrinfo(result);
-				close(sockfd);
 
 				freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_FAILED);
 
 				WLog_ERR(TAG, "failed to connect to %s", hostname);
 				return -1;
 			}
+			rdp_timeline_add(context->rdp, "tcp", tcpStart);
 
 			freeaddrinfo(result);
 		}
@@ -1342,6 +1603,7 @@ struct rdp_tcp_layer
 {
 	int sockfd;
 	HANDLE hEvent;
+	rdpTcpSendBuffer sendBuffer;
 };
 typedef struct rdp_tcp_layer rdpTcpLayer;
 
@@ -1409,6 +1671,8 @@ static int freerdp_tcp_layer_write(void* userContext, const void* data, int byte
 			status = -1;
 		}
 	}
+	else
+		freerdp_tcp_update_send_buffer(&tcpLayer->sendBuffer, (SOCKET)tcpLayer->sockfd);
 
 	return status;
 }
@@ -1498,6 +1762,21 @@ rdpTransportLayer* freerdp_tcp_connect_layer(rdpContext* context, const char* ho
 		goto fail;
 	if (!freerdp_tcp_set_keep_alive_mode(settings, sockfd))
 		goto fail;
+	if (!freerdp_tcp_set_latency_mode(settings, sockfd))
+		goto fail;
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_LocalShmTransport))
+	{
+		if (freerdp_shm_transport_supported(sockfd))
+		{
+			layer = freerdp_shm_transport_connect(context, sockfd, timeout);
+			if (!layer)
+				goto fail;
+			return layer;
+		}
+
+		WLog_WARN(TAG, "shared memory transport needs a unix domain socket, using the socket");
+	}
 
 	layer = transport_layer_new(freerdp_get_transport(context), sizeof(rdpTcpLayer));
 	if (!layer)
@@ -1525,6 +1804,7 @@ rdpTransportLayer* freerdp_tcp_connect_layer(rdpContext* context, const char* ho
 	}
 
 	tcpLayer->sockfd = sockfd;
+	tcpLayer->sendBuffer.enabled = freerdp_settings_get_bool(settings, FreeRDP_TcpLatencyMode);
 
 	return layer;
 
@@ -53,6 +53,7 @@
 #define BIO_C_WAIT_READ 1107
 #define BIO_C_WAIT_WRITE 1108
 #define BIO_C_SET_HANDLE 1109
+#define BIO_C_SET_LATENCY_MODE 1110
 
 static INLINE long BIO_set_socket(BIO* b, SOCKET s, long c)
 {
@@ -74,6 +75,10 @@ static INLINE long BIO_set_nonblock(BIO* b, long c)
 {
 	return BIO_ctrl(b, BIO_C_SET_NONBLOCK, c, NULL);
 }
+static INLINE long BIO_set_latency_mode(BIO* b, long c)
+{
+	return BIO_ctrl(b, BIO_C_SET_LATENCY_MODE, c, NULL);
+}
 static INLINE long BIO_read_blocked(BIO* b)
 {
 	return BIO_ctrl(b, BIO_C_READ_BLOCKED, 0, NULL);
@@ -96,6 +101,7 @@ FREERDP_LOCAL BIO_METHOD* BIO_s_simple_socket(void);
 FREERDP_LOCAL BIO_METHOD* BIO_s_buffered_socket(void);
 
 FREERDP_LOCAL BOOL freerdp_tcp_set_keep_alive_mode(const rdpSettings* settings, int sockfd);
+FREERDP_LOCAL BOOL freerdp_tcp_set_latency_mode(const rdpSettings* settings, int sockfd);
 
 FREERDP_LOCAL int freerdp_tcp_connect(rdpContext* context, const char* hostname, int port,
                                       DWORD timeout);
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <freerdp/metrics.h>
+
+static BOOL test_registry(rdpMetrics* metrics)
+{
+	FreeRDPMetricValue value = { 0 };
+
+	const SSIZE_T counter = metrics_register(metrics, "test_counter", FREERDP_METRIC_COUNTER);
+	const SSIZE_T gauge = metrics_register(metrics, "test_gauge", FREERDP_METRIC_GAUGE);
+	const SSIZE_T histogram = metrics_register(metrics, "test_us", FREERDP_METRIC_HISTOGRAM);
+	if ((counter < 0) || (gauge < 0) || (histogram < 0))
+		return FALSE;
+
+	/* names are shared, but only with the same type */
+	if (metrics_register(metrics, "test_counter", FREERDP_METRIC_COUNTER) != counter)
+		return FALSE;
+	if (metrics_register(metrics, "test_counter", FREERDP_METRIC_GAUGE) >= 0)
+		return FALSE;
+	if (metrics_register(metrics, "test-invalid", FREERDP_METRIC_GAUGE) >= 0)
+		return FALSE;
+	if (metrics_record(metrics, 4242, 1))
+		return FALSE;
+
+	if (!metrics_record(metrics, counter, 3) || !metrics_record(metrics, counter, 4))
+		return FALSE;
+	if (!metrics_record(metrics, gauge, 3) || !metrics_record(metrics, gauge, 4))
+		return FALSE;
+
+	const UINT64 observations[] = { 0, 1, 2, 3, 1000, UINT32_MAX };
+	for (size_t x = 0; x < ARRAYSIZE(observations); x++)
+	{
+		if (!metrics_record(metrics, histogram, observations[x]))
+			return FALSE;
+	}
+
+	if (!metrics_get(metrics, "test_counter", &value) || (value.value != 7))
+		return FALSE;
+	if (!metrics_get(metrics, "test_gauge", &value) || (value.value != 4))
+		return FALSE;
+	if (!metrics_get(metrics, "test_us", &value))
+		return FALSE;
+	if ((value.count != 6) || (value.min != 0) || (value.max != UINT32_MAX) ||
+	    (value.sum != 1006ull + UINT32_MAX))
+		return FALSE;
+
+	/* buckets count values <= 2^x, 1000 goes to 1024 */
+	if ((value.buckets[0] != 2) || (value.buckets[1] != 1) || (value.buckets[2] != 1) ||
+	    (value.buckets[10] != 1) || (value.buckets[FREERDP_METRICS_HISTOGRAM_BUCKETS] != 1))
+		return FALSE;
+
+	return !metrics_get(metrics, "test_missing", &value);
+}
+
+static BOOL test_export(rdpMetrics* metrics)
+{
+	BOOL rc = FALSE;
+	size_t length = 0;
+
+	char* json = metrics_export(metrics, FREERDP_METRICS_FORMAT_JSON, &length);
+	char* prom = metrics_export(metrics, FREERDP_METRICS_FORMAT_PROMETHEUS, NULL);
+	if (!json || !prom || (length != strlen(json)))
+		goto fail;
+
+	if (!strstr(json, "\"test_counter\":{\"type\":\"counter\",\"value\":7}") ||
+	    !strstr(json, "\"test_us\":{\"type\":\"histogram\",\"count\":6,"))
+	{
+		(void)fprintf(stderr, "unexpected JSON export:\n%s\n", json);
+		goto fail;
+	}
+
+	if (!strstr(prom, "# TYPE freerdp_test_gauge gauge\nfreerdp_test_gauge 4\n") ||
+	    !strstr(prom, "freerdp_test_us_bucket{le=\"2\"} 3\n") ||
+	    !strstr(prom, "freerdp_test_us_bucket{le=\"+Inf\"} 6\n") ||
+	    !strstr(prom, "freerdp_test_us_count 6\n"))
+	{
+		(void)fprintf(stderr, "unexpected prometheus export:\n%s\n", prom);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(json);
+	free(prom);
+	return rc;
+}
+
+int TestMetrics(int argc, char* argv[])
+{
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	rdpMetrics* metrics = metrics_new(NULL);
+	if (!metrics)
+		return -1;
+
+	if (!test_registry(metrics))
+		goto fail;
+	if (!test_export(metrics))
+		goto fail;
+
+	rc = 0;
+fail:
+	metrics_free(metrics);
+	return rc;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/peer.h>
+
+#define TEST_PEERS 16
+#define TEST_ROUNDS 5
+
+typedef struct
+{
+	HANDLE event;
+	HANDLE shared;
+	volatile LONG checks;
+	volatile LONG removed;
+	BOOL idle;
+} test_peer;
+
+static DWORD test_get_handles(freerdp_peer* peer, void* userarg, HANDLE* handles, DWORD count)
+{
+	test_peer* tp = userarg;
+	WINPR_UNUSED(peer);
+
+	if (count < 2)
+		return 0;
+	handles[0] = tp->event;
+	handles[1] = tp->shared;
+	return 2;
+}
+
+static BOOL test_check(freerdp_peer* peer, void* userarg)
+{
+	test_peer* tp = userarg;
+	WINPR_UNUSED(peer);
+
+	(void)ResetEvent(tp->event);
+	const LONG checks = InterlockedIncrement(&tp->checks);
+	return tp->idle || (checks < TEST_ROUNDS);
+}
+
+static void test_removed(freerdp_peer* peer, void* userarg)
+{
+	test_peer* tp = userarg;
+	WINPR_UNUSED(peer);
+
+	(void)InterlockedIncrement(&tp->removed);
+}
+
+static BOOL wait_for(rdpPeerReactor* reactor, size_t count)
+{
+	const UINT64 start = GetTickCount64();
+	while (freerdp_peer_reactor_count(reactor) != count)
+	{
+		if (GetTickCount64() - start > 5000)
+			return FALSE;
+		Sleep(1);
+	}
+	return TRUE;
+}
+
+int TestPeerReactor(int argc, char* argv[])
+{
+	int rc = -1;
+	test_peer peers[TEST_PEERS + 1] = { 0 };
+	rdpPeerReactor* reactor = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	/* every peer also waits on a handle shared by all of them, like a server stop event */
+	HANDLE shared = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!shared)
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(peers); x++)
+	{
+		peers[x].shared = shared;
+		peers[x].event = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!peers[x].event)
+			goto fail;
+	}
+	peers[TEST_PEERS].idle = TRUE;
+
+	reactor = freerdp_peer_reactor_new(3, 20);
+	if (!reactor)
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(peers); x++)
+	{
+		if (!freerdp_peer_reactor_add(reactor, NULL, test_get_handles, test_check, test_removed,
+		                              &peers[x]))
+			goto fail;
+	}
+
+	/* signal the busy peers until they asked to be removed */
+	const UINT64 start = GetTickCount64();
+	while (freerdp_peer_reactor_count(reactor) > 1)
+	{
+		if (GetTickCount64() - start > 5000)
+		{
+			(void)fprintf(stderr, "peers were not removed\n");
+			goto fail;
+		}
+
+		for (size_t x = 0; x < TEST_PEERS; x++)
+			(void)SetEvent(peers[x].event);
+		Sleep(1);
+	}
+
+	for (size_t x = 0; x < TEST_PEERS; x++)
+	{
+		if ((peers[x].checks != TEST_ROUNDS) || (peers[x].removed != 1))
+		{
+			(void)fprintf(stderr, "peer %" PRIuz ": %" PRId32 " checks, %" PRId32 " removed\n",
+			              x, peers[x].checks, peers[x].removed);
+			goto fail;
+		}
+	}
+
+	/* the idle peer is never signaled but checked on timeout */
+	Sleep(100);
+	if ((peers[TEST_PEERS].checks < 2) || !wait_for(reactor, 1))
+	{
+		(void)fprintf(stderr, "idle peer was checked %" PRId32 " times\n",
+		              peers[TEST_PEERS].checks);
+		goto fail;
+	}
+
+	freerdp_peer_reactor_free(reactor);
+	reactor = NULL;
+	if (peers[TEST_PEERS].removed != 1)
+		goto fail;
+
+	rc = 0;
+fail:
+	freerdp_peer_reactor_free(reactor);
+	for (size_t x = 0; x < ARRAYSIZE(peers); x++)
+	{
+		if (peers[x].event)
+			(void)CloseHandle(peers[x].event);
+	}
+	if (shared)
+		(void)CloseHandle(shared);
+	return rc;
+}
@@ -0,0 +1,435 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // NOLINT(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp)
+#endif
+
+#include <stdio.h>
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/thread.h>
+#include <winpr/synch.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
+
+#include "../shmtransport.h"
+
+#if defined(HAVE_MEMFD_CREATE) && defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+/* the layout of shmtransport.c, a peer that does not play by the rules is faked with it */
+#define SHM_MAGIC "FRDPSHM1"
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 4096
+#define SHM_RING_SIZE (4ull * 1024ull * 1024ull)
+#define SHM_SIZE (SHM_HEADER_SIZE + 2 * SHM_RING_SIZE)
+#define SHM_FD_COUNT 5
+#define SHM_CLIENT_RING_HEAD 64  /* rings[0].head, written by the client */
+#define SHM_SERVER_RING_TAIL 320 /* rings[1].tail, written by the client */
+
+typedef struct
+{
+	rdpContext* context;
+	int sockfd;
+	rdpTransportLayer* layer;
+} connect_arg;
+
+static int layer_read(rdpTransportLayer* layer, void* data, size_t bytes)
+{
+	return layer->Read(layer->userContext, data, (int)bytes);
+}
+
+static int layer_write(rdpTransportLayer* layer, const void* data, size_t bytes)
+{
+	return layer->Write(layer->userContext, data, (int)bytes);
+}
+
+static BOOL socket_readable(int fd)
+{
+	struct pollfd pollset = { .fd = fd, .events = POLLIN };
+	return poll(&pollset, 1, 0) > 0;
+}
+
+static BYTE pattern(size_t pos)
+{
+	return (BYTE)((pos * 7) ^ (pos >> 13));
+}
+
+static DWORD WINAPI connect_thread(LPVOID arg)
+{
+	connect_arg* param = arg;
+	param->layer = freerdp_shm_transport_connect(param->context, param->sockfd, 5000);
+	return 0;
+}
+
+/**
+ * Sends total bytes from writer to reader. The first write must fill the ring exactly, later
+ * ones wrap around the end of it.
+ */
+static BOOL pump(rdpTransportLayer* writer, rdpTransportLayer* reader, size_t total)
+{
+	const size_t chunk = 3ull * 1024ull * 1024ull;
+	BYTE* out = malloc(total);
+	BYTE* in = calloc(1, total);
+	BOOL rc = FALSE;
+
+	if (!out || !in)
+		goto fail;
+	for (size_t x = 0; x < total; x++)
+		out[x] = pattern(x);
+
+	if ((layer_write(writer, out, total) != (int)SHM_RING_SIZE) ||
+	    (layer_write(writer, out, 1) != 0))
+	{
+		(void)fprintf(stderr, "the send ring is not bounded\n");
+		goto fail;
+	}
+
+	size_t sent = SHM_RING_SIZE;
+	size_t received = 0;
+	while (received < total)
+	{
+		const int status = layer_read(reader, &in[received], MIN(chunk, total - received));
+		if (status <= 0)
+			goto fail;
+		received += (size_t)status;
+
+		if (sent < total)
+		{
+			const int written = layer_write(writer, &out[sent], total - sent);
+			if (written < 0)
+				goto fail;
+			sent += (size_t)written;
+		}
+	}
+
+	rc = (memcmp(in, out, total) == 0);
+	if (!rc)
+		(void)fprintf(stderr, "data corrupted across the ring wrap\n");
+fail:
+	free(in);
+	free(out);
+	return rc;
+}
+
+static BOOL test_offer(rdpContext* context)
+{
+	int sv[2] = { -1, -1 };
+	BOOL rc = FALSE;
+	rdpTransportLayer* server = NULL;
+	HANDLE thread = NULL;
+	connect_arg arg = { context, -1, NULL };
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+		return FALSE;
+	if (!freerdp_shm_transport_supported(sv[0]))
+		goto fail;
+
+	server = freerdp_shm_transport_accept(freerdp_get_transport(context), sv[1]);
+	if (!server)
+		goto fail;
+	sv[1] = -1;
+
+	arg.sockfd = sv[0];
+	thread = CreateThread(NULL, 0, connect_thread, &arg, 0, NULL);
+	if (!thread)
+		goto fail;
+
+	/* the server takes the offer on its first reads */
+	BYTE byte = 0;
+	for (size_t x = 0; WaitForSingleObject(thread, 10) != WAIT_OBJECT_0; x++)
+	{
+		if ((x > 1000) || (layer_read(server, &byte, 1) != 0))
+			goto fail;
+	}
+	if (!arg.layer)
+	{
+		(void)fprintf(stderr, "shared memory offer was not acknowledged\n");
+		goto fail;
+	}
+	sv[0] = -1;
+
+	/* the payload goes through the rings, not the socket */
+	const char hello[] = "hello";
+	char buffer[sizeof(hello)] = { 0 };
+	if (layer_write(arg.layer, hello, sizeof(hello)) != (int)sizeof(hello))
+		goto fail;
+	if ((layer_read(server, buffer, sizeof(buffer)) != (int)sizeof(buffer)) ||
+	    (memcmp(buffer, hello, sizeof(hello)) != 0))
+		goto fail;
+	if (layer_read(server, buffer, sizeof(buffer)) != 0)
+		goto fail;
+
+	rc = pump(arg.layer, server, 10ull * 1024ull * 1024ull + 17) &&
+	     pump(server, arg.layer, 9ull * 1024ull * 1024ull + 3);
+fail:
+	if (thread)
+	{
+		(void)WaitForSingleObject(thread, INFINITE);
+		(void)CloseHandle(thread);
+	}
+	transport_layer_free(arg.layer);
+	transport_layer_free(server);
+	for (size_t x = 0; x < ARRAYSIZE(sv); x++)
+	{
+		if (sv[x] >= 0)
+			close(sv[x]);
+	}
+	return rc;
+}
+
+/** sends an offer like the client does, but with a memfd of our choosing */
+static BOOL fake_offer(int sockfd, size_t size, BOOL seal, BYTE** pbase)
+{
+	int fds[SHM_FD_COUNT] = { -1, -1, -1, -1, -1 };
+	BOOL rc = FALSE;
+
+	fds[0] = memfd_create("TestShmTransport", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if ((fds[0] < 0) || (ftruncate(fds[0], (off_t)size) != 0))
+		goto fail;
+	if (seal && (fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0))
+		goto fail;
+
+	BYTE* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	if (base == MAP_FAILED)
+		goto fail;
+	memcpy(base, SHM_MAGIC, 8);
+	const UINT32 version = SHM_VERSION;
+	const UINT32 ringSize = SHM_RING_SIZE;
+	memcpy(&base[8], &version, sizeof(version));
+	memcpy(&base[12], &ringSize, sizeof(ringSize));
+	*pbase = base;
+
+	for (size_t x = 1; x < SHM_FD_COUNT; x++)
+	{
+		fds[x] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (fds[x] < 0)
+			goto fail;
+	}
+
+	char magic[8] = { 0 };
+	memcpy(magic, SHM_MAGIC, sizeof(magic));
+	char control[CMSG_SPACE(sizeof(fds))] = { 0 };
+	struct iovec iov = { .iov_base = magic, .iov_len = sizeof(magic) };
+	struct msghdr msg = { 0 };
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	rc = (sendmsg(sockfd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(magic));
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(fds); x++)
+	{
+		if (fds[x] >= 0)
+			close(fds[x]);
+	}
+	return rc;
+}
+
+/**
+ * Offers a memfd to a server layer. Returns the result of its first read, the ack state and
+ * the mapping of the fake client.
+ */
+static int offer_to_server(rdpTransport* transport, size_t size, BOOL seal, BOOL* acked,
+                           BYTE** base, rdpTransportLayer** pserver, int* pclient)
+{
+	int sv[2] = { -1, -1 };
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+		return -2;
+
+	*pclient = sv[0];
+	*pserver = freerdp_shm_transport_accept(transport, sv[1]);
+	if (!*pserver)
+	{
+		close(sv[1]);
+		return -2;
+	}
+
+	if (!fake_offer(sv[0], size, seal, base))
+		return -2;
+
+	BYTE byte = 0;
+	const int status = layer_read(*pserver, &byte, 1);
+
+	char ack = 0;
+	*acked = (recv(sv[0], &ack, 1, MSG_DONTWAIT) == 1) && (ack == 'Y');
+	return status;
+}
+
+static BOOL test_invalid_offer(rdpTransport* transport, size_t size, BOOL seal)
+{
+	BOOL acked = FALSE;
+	BYTE* base = NULL;
+	rdpTransportLayer* server = NULL;
+	int client = -1;
+
+	const int status = offer_to_server(transport, size, seal, &acked, &base, &server, &client);
+	const BOOL rc = (status == -1) && !acked;
+	if (!rc)
+		(void)fprintf(stderr, "offer of %" PRIuz " bytes, sealed %d accepted\n", size, seal);
+
+	if (base)
+		munmap(base, size);
+	transport_layer_free(server);
+	if (client >= 0)
+		close(client);
+	return rc;
+}
+
+static BOOL test_corrupted_ring(rdpTransport* transport, size_t position, UINT64 value)
+{
+	BOOL acked = FALSE;
+	BYTE* base = NULL;
+	rdpTransportLayer* server = NULL;
+	int client = -1;
+	BOOL rc = FALSE;
+
+	if ((offer_to_server(transport, SHM_SIZE, TRUE, &acked, &base, &server, &client) != 0) ||
+	    !acked)
+		goto fail;
+
+	memcpy(&base[position], &value, sizeof(value));
+
+	BYTE byte = 0;
+	if (position == SHM_CLIENT_RING_HEAD)
+		rc = (layer_read(server, &byte, 1) == -1);
+	else
+		rc = (layer_write(server, &byte, 1) == -1);
+	if (!rc)
+		(void)fprintf(stderr, "corrupted ring at %" PRIuz " not detected\n", position);
+fail:
+	if (base)
+		munmap(base, SHM_SIZE);
+	transport_layer_free(server);
+	if (client >= 0)
+		close(client);
+	return rc;
+}
+
+static BOOL test_plain_socket(rdpTransport* transport)
+{
+	int sv[2] = { -1, -1 };
+	BOOL rc = FALSE;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+		return FALSE;
+
+	rdpTransportLayer* server = freerdp_shm_transport_accept(transport, sv[1]);
+	if (!server)
+		goto fail;
+	sv[1] = -1;
+
+	/* nothing was sent yet, the server keeps waiting for the client to make up its mind */
+	BYTE buffer[16] = { 0 };
+	if (layer_read(server, buffer, sizeof(buffer)) != 0)
+		goto fail;
+
+	const BYTE request[] = { 0x03, 0x00, 0x00, 0x07, 'a', 'b', 'c' };
+	if (send(sv[0], request, sizeof(request), MSG_NOSIGNAL) != (ssize_t)sizeof(request))
+		goto fail;
+	if ((layer_read(server, buffer, sizeof(buffer)) != (int)sizeof(request)) ||
+	    (memcmp(buffer, request, sizeof(request)) != 0))
+		goto fail;
+
+	const BYTE response[] = { 0x03, 0x00, 0x00, 0x04 };
+	if (layer_write(server, response, sizeof(response)) != (int)sizeof(response))
+		goto fail;
+	if ((recv(sv[0], buffer, sizeof(buffer), MSG_DONTWAIT) != (ssize_t)sizeof(response)) ||
+	    (memcmp(buffer, response, sizeof(response)) != 0))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (!rc)
+		(void)fprintf(stderr, "plain socket fallback failed\n");
+	transport_layer_free(server);
+	for (size_t x = 0; x < ARRAYSIZE(sv); x++)
+	{
+		if (sv[x] >= 0)
+			close(sv[x]);
+	}
+	return rc;
+}
+
+/** a server that never answers leaves the socket to the caller */
+static BOOL test_no_answer(rdpContext* context)
+{
+	int sv[2] = { -1, -1 };
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+		return FALSE;
+
+	rdpTransportLayer* layer = freerdp_shm_transport_connect(context, sv[0], 50);
+	const BOOL rc = !layer && (fcntl(sv[0], F_GETFD) >= 0) && socket_readable(sv[1]);
+	transport_layer_free(layer);
+	close(sv[0]);
+	close(sv[1]);
+	return rc;
+}
+
+int TestShmTransport(int argc, char* argv[])
+{
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	freerdp* instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	rdpContext* context = instance->context;
+	rdpTransport* transport = freerdp_get_transport(context);
+
+	if (!test_offer(context))
+		goto fail;
+
+	rc = -2;
+	if (!test_invalid_offer(transport, SHM_SIZE, FALSE) ||
+	    !test_invalid_offer(transport, SHM_SIZE - SHM_HEADER_SIZE, TRUE))
+		goto fail;
+
+	rc = -3;
+	if (!test_corrupted_ring(transport, SHM_CLIENT_RING_HEAD, SHM_RING_SIZE + 1) ||
+	    !test_corrupted_ring(transport, SHM_SERVER_RING_TAIL, 1))
+		goto fail;
+
+	rc = -4;
+	if (!test_plain_socket(transport) || !test_no_answer(context))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (instance)
+	{
+		freerdp_context_free(instance);
+		freerdp_free(instance);
+	}
+	return rc;
+}
+
+#else
+
+int TestShmTransport(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	printf("shared memory transport not supported on this platform, skipping\n");
+	return 0;
+}
+
+#endif
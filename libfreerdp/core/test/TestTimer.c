@@ -0,0 +1,107 @@
+#include <stdio.h>
+
+#include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/client.h>
+#include <freerdp/timer.h>
+
+#define TEST_CONTEXTS 3
+#define TEST_TIMERS 20
+#define TEST_RUNS 5
+
+typedef struct
+{
+	LONG runs;
+	LONG removedRuns;
+} test_counters;
+
+static uint64_t test_timer_cb(rdpContext* context, void* userdata, FreeRDP_TimerID timerID,
+                              uint64_t timestamp, uint64_t interval)
+{
+	test_counters* counters = userdata;
+
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(timerID);
+	WINPR_UNUSED(timestamp);
+
+	if (InterlockedIncrement(&counters->runs) % TEST_RUNS == 0)
+		return 0;
+	return interval;
+}
+
+static uint64_t test_removed_cb(rdpContext* context, void* userdata, FreeRDP_TimerID timerID,
+                                uint64_t timestamp, uint64_t interval)
+{
+	test_counters* counters = userdata;
+
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(timerID);
+	WINPR_UNUSED(timestamp);
+
+	(void)InterlockedIncrement(&counters->removedRuns);
+	return interval;
+}
+
+/* the timers of all contexts are run by one thread, each runs until its callback disables it */
+int TestTimer(int argc, char* argv[])
+{
+	int rc = -1;
+	rdpContext* contexts[TEST_CONTEXTS] = { 0 };
+	test_counters counters[TEST_CONTEXTS] = { 0 };
+	RDP_CLIENT_ENTRY_POINTS entry = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	entry.Version = RDP_CLIENT_INTERFACE_VERSION;
+	entry.Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	entry.ContextSize = sizeof(rdpContext);
+
+	for (size_t x = 0; x < TEST_CONTEXTS; x++)
+	{
+		contexts[x] = freerdp_client_context_new(&entry);
+		if (!contexts[x])
+			goto fail;
+
+		/* the callback returns 0 every TEST_RUNS calls, so each timer sees that once */
+		for (size_t y = 0; y < TEST_TIMERS; y++)
+		{
+			if (!freerdp_timer_add(contexts[x], 1000000ull * (1 + y % 3), test_timer_cb,
+			                       &counters[x], false))
+				goto fail;
+		}
+
+		const FreeRDP_TimerID id =
+		    freerdp_timer_add(contexts[x], 1000000ull, test_removed_cb, &counters[x], false);
+		if (!id || !freerdp_timer_remove(contexts[x], id) ||
+		    freerdp_timer_remove(contexts[x], id))
+			goto fail;
+	}
+
+	const UINT64 end = GetTickCount64() + 10000;
+	for (size_t x = 0; x < TEST_CONTEXTS; x++)
+	{
+		while ((InterlockedCompareExchange(&counters[x].runs, 0, 0) < TEST_TIMERS * TEST_RUNS) &&
+		       (GetTickCount64() < end))
+			Sleep(1);
+	}
+
+	/* disabled and removed timers do not run again */
+	Sleep(20);
+	for (size_t x = 0; x < TEST_CONTEXTS; x++)
+	{
+		if ((counters[x].runs != TEST_TIMERS * TEST_RUNS) || (counters[x].removedRuns != 0))
+		{
+			(void)fprintf(stderr, "context %" PRIuz ": %" PRId32 " runs, %" PRId32 " removed\n",
+			              x, counters[x].runs, counters[x].removedRuns);
+			goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	for (size_t x = 0; x < TEST_CONTEXTS; x++)
+		freerdp_client_context_free(contexts[x]);
+	return rc;
+}
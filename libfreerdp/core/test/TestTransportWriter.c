@@ -0,0 +1,318 @@
+#include <stdio.h>
+
+#include <winpr/stream.h>
+#include <winpr/synch.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
+
+#include "../rdp.h"
+#include "../connection.h"
+#include "../mcs.h"
+#include "../transport.h"
+
+#define TEST_USER_ID 1007
+#define TEST_CHANNEL_ID 1004
+#define TEST_MARK_START 0xF0
+#define TEST_MARK_HIGH 0xA1
+#define TEST_MARK_UPDATE 0xB2
+#define TEST_MARK_CHANNEL 0xCC
+#define TEST_SYNC_TARGET 0x5EED
+#define TEST_SYNC_MARK 0x5E /* last byte of the little endian targetUser */
+
+typedef struct
+{
+	CRITICAL_SECTION lock;
+	wStream* wire;
+	BOOL hold;
+	HANDLE entered;
+	HANDLE release;
+} test_layer;
+
+/* the transport owns the layer context, the recorder outlives it */
+typedef struct
+{
+	test_layer* layer;
+} test_layer_context;
+
+static int test_layer_read(void* userContext, void* data, int bytes)
+{
+	WINPR_UNUSED(userContext);
+	WINPR_UNUSED(data);
+	WINPR_UNUSED(bytes);
+	return 0;
+}
+
+/* records the bytes, blocks the writer thread while the test queues PDUs behind it */
+static int test_layer_write(void* userContext, const void* data, int bytes)
+{
+	test_layer_context* ctx = userContext;
+	test_layer* layer = ctx->layer;
+	BOOL hold = FALSE;
+
+	EnterCriticalSection(&layer->lock);
+	hold = layer->hold;
+	layer->hold = FALSE;
+	LeaveCriticalSection(&layer->lock);
+
+	if (hold)
+	{
+		(void)SetEvent(layer->entered);
+		(void)WaitForSingleObject(layer->release, INFINITE);
+	}
+
+	EnterCriticalSection(&layer->lock);
+	const BOOL rc = Stream_EnsureRemainingCapacity(layer->wire, (size_t)bytes);
+	if (rc)
+		Stream_Write(layer->wire, data, (size_t)bytes);
+	LeaveCriticalSection(&layer->lock);
+	return rc ? bytes : -1;
+}
+
+static BOOL test_layer_close(void* userContext)
+{
+	WINPR_UNUSED(userContext);
+	return TRUE;
+}
+
+static BOOL test_layer_wait(void* userContext, BOOL waitWrite, DWORD timeout)
+{
+	WINPR_UNUSED(userContext);
+	WINPR_UNUSED(waitWrite);
+	WINPR_UNUSED(timeout);
+	return TRUE;
+}
+
+static HANDLE test_layer_get_event(void* userContext)
+{
+	WINPR_UNUSED(userContext);
+	return NULL;
+}
+
+/* a TPKT frame whose payload is filled with mark, recognizable on the wire by its last byte */
+static BOOL send_marker(rdpTransport* transport, BYTE mark, TRANSPORT_PRIORITY priority)
+{
+	const size_t length = 16;
+	wStream* s = transport_send_stream_init(transport, length);
+	if (!s)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, length))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+	Stream_Write_UINT8(s, 0x03);
+	Stream_Write_UINT8(s, 0x00);
+	Stream_Write_UINT16_BE(s, (UINT16)length);
+	Stream_Fill(s, mark, length - 4);
+	Stream_SealLength(s);
+	return transport_write_priority(transport, s, priority) >= 0;
+}
+
+/* the writer thread blocks on the next write until released */
+static BOOL hold_writer(rdpTransport* transport, test_layer* layer)
+{
+	(void)ResetEvent(layer->entered);
+	(void)ResetEvent(layer->release);
+
+	EnterCriticalSection(&layer->lock);
+	layer->hold = TRUE;
+	LeaveCriticalSection(&layer->lock);
+
+	if (!send_marker(transport, TEST_MARK_START, TRANSPORT_PRIORITY_NORMAL))
+		return FALSE;
+	if (WaitForSingleObject(layer->entered, 10000) != WAIT_OBJECT_0)
+	{
+		(void)fprintf(stderr, "writer thread did not write\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL send_channel_data(rdpRdp* rdp)
+{
+	UINT16 sec_flags = 0;
+	wStream* s = rdp_send_stream_init(rdp, &sec_flags);
+	if (!s)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 64))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+	Stream_Fill(s, TEST_MARK_CHANNEL, 64);
+	return rdp_send(rdp, s, TEST_CHANNEL_ID, sec_flags);
+}
+
+static BOOL send_synchronize(rdpRdp* rdp)
+{
+	UINT16 sec_flags = 0;
+	wStream* s = rdp_data_pdu_init(rdp, &sec_flags);
+	if (!s)
+		return FALSE;
+
+	Stream_Write_UINT16(s, 0x0001);           /* messageType, SYNCMSGTYPE_SYNC */
+	Stream_Write_UINT16(s, TEST_SYNC_TARGET); /* targetUser */
+	return rdp_send_data_pdu(rdp, s, DATA_PDU_TYPE_SYNCHRONIZE, rdp->mcs->userId, sec_flags);
+}
+
+/* the last byte of each TPKT frame, in wire order */
+static size_t wire_marks(wStream* wire, BYTE* marks, size_t size)
+{
+	size_t count = 0;
+	const BYTE* data = Stream_Buffer(wire);
+	const size_t length = Stream_GetPosition(wire);
+
+	for (size_t pos = 0; (pos + 4 <= length) && (count < size);)
+	{
+		const size_t frame = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+		if ((data[pos] != 0x03) || (frame < 4) || (pos + frame > length))
+			return 0;
+		marks[count++] = data[pos + frame - 1];
+		pos += frame;
+	}
+
+	return count;
+}
+
+/* waits until the writer thread put count frames on the wire */
+static BOOL wait_frames(test_layer* layer, size_t count)
+{
+	BYTE marks[16] = { 0 };
+
+	for (size_t x = 0; x < 1000; x++)
+	{
+		EnterCriticalSection(&layer->lock);
+		const size_t written = wire_marks(layer->wire, marks, ARRAYSIZE(marks));
+		LeaveCriticalSection(&layer->lock);
+		if (written >= count)
+			return TRUE;
+		Sleep(10);
+	}
+
+	(void)fprintf(stderr, "writer thread did not drain\n");
+	return FALSE;
+}
+
+static BOOL test_mixed_priorities(rdpContext* context, test_layer* layer)
+{
+	rdpRdp* rdp = context->rdp;
+	rdpTransport* transport = rdp->transport;
+	BYTE marks[16] = { 0 };
+
+	/* the first write is synchronous and starts the writer thread */
+	if (!send_marker(transport, TEST_MARK_START, TRANSPORT_PRIORITY_NORMAL))
+		return FALSE;
+
+	/* active: only input goes ahead, updates stay behind the slow-path PDUs sent before them */
+	if (!hold_writer(transport, layer))
+		return FALSE;
+	const BOOL active = send_channel_data(rdp) && send_synchronize(rdp) &&
+	                    send_marker(transport, TEST_MARK_UPDATE, TRANSPORT_PRIORITY_NORMAL) &&
+	                    send_channel_data(rdp) &&
+	                    send_marker(transport, TEST_MARK_HIGH, TRANSPORT_PRIORITY_HIGH);
+	(void)SetEvent(layer->release);
+	if (!active || !wait_frames(layer, 7))
+		return FALSE;
+
+	/* reactivation: input must not overtake the PDUs of the sequence */
+	if (!rdp_client_transition_to_state(rdp, CONNECTION_STATE_CAPABILITIES_EXCHANGE_DEMAND_ACTIVE))
+		return FALSE;
+	if (!hold_writer(transport, layer))
+		return FALSE;
+	const BOOL inactive =
+	    send_synchronize(rdp) && send_marker(transport, TEST_MARK_HIGH, TRANSPORT_PRIORITY_HIGH);
+	(void)SetEvent(layer->release);
+	if (!inactive)
+		return FALSE;
+
+	/* sends everything still queued before the layer goes away */
+	if (!transport_disconnect(transport))
+		return FALSE;
+
+	const BYTE expected[] = { TEST_MARK_START,   TEST_MARK_START,  TEST_MARK_HIGH,
+		                      TEST_MARK_CHANNEL, TEST_SYNC_MARK,   TEST_MARK_UPDATE,
+		                      TEST_MARK_CHANNEL, TEST_MARK_START,  TEST_SYNC_MARK,
+		                      TEST_MARK_HIGH };
+	const size_t count = wire_marks(layer->wire, marks, ARRAYSIZE(marks));
+
+	if ((count != ARRAYSIZE(expected)) || (memcmp(marks, expected, sizeof(expected)) != 0))
+	{
+		(void)fprintf(stderr, "unexpected wire order:");
+		for (size_t x = 0; x < count; x++)
+			(void)fprintf(stderr, " %02" PRIX8, marks[x]);
+		(void)fprintf(stderr, "\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int TestTransportWriter(int argc, char* argv[])
+{
+	int rc = -1;
+	test_layer layer = { 0 };
+	freerdp* instance = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!InitializeCriticalSectionAndSpinCount(&layer.lock, 4000))
+		goto fail_lock;
+
+	layer.wire = Stream_New(NULL, 1024);
+	layer.entered = CreateEvent(NULL, TRUE, FALSE, NULL);
+	layer.release = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!layer.wire || !layer.entered || !layer.release)
+		goto fail;
+
+	instance = freerdp_new();
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	rdpContext* context = instance->context;
+	if (!freerdp_settings_set_bool(context->settings, FreeRDP_AsyncTransport, TRUE))
+		goto fail;
+
+	rdpTransport* transport = context->rdp->transport;
+	rdpTransportLayer* transportLayer = transport_layer_new(transport, sizeof(test_layer_context));
+	if (!transportLayer)
+		goto fail;
+
+	test_layer_context* ctx = transportLayer->userContext;
+	ctx->layer = &layer;
+	transportLayer->Read = test_layer_read;
+	transportLayer->Write = test_layer_write;
+	transportLayer->Close = test_layer_close;
+	transportLayer->Wait = test_layer_wait;
+	transportLayer->GetEvent = test_layer_get_event;
+
+	if (!transport_attach_layer(transport, transportLayer))
+	{
+		transport_layer_free(transportLayer);
+		goto fail;
+	}
+
+	context->rdp->mcs->userId = TEST_USER_ID;
+	if (!rdp_client_transition_to_state(context->rdp, CONNECTION_STATE_ACTIVE))
+		goto fail;
+
+	if (!test_mixed_priorities(context, &layer))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (instance)
+	{
+		freerdp_context_free(instance);
+		freerdp_free(instance);
+	}
+	(void)CloseHandle(layer.release);
+	(void)CloseHandle(layer.entered);
+	Stream_Free(layer.wire, TRUE);
+	DeleteCriticalSection(&layer.lock);
+fail_lock:
+	return rc;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+
+#include <winpr/stream.h>
+#include <winpr/crypto.h>
+
+#include <openssl/bio.h>
+
+#include "../gateway/websocket.h"
+
+/* parse one client frame from the BIO and compare the unmasked payload */
+static BOOL check_frame(BIO* bio, const BYTE* payload, size_t length, BYTE opcode)
+{
+	BOOL rc = FALSE;
+	BYTE* data = NULL;
+	const long pending = BIO_ctrl_pending(bio);
+	if (pending <= 0)
+		return FALSE;
+
+	data = malloc((size_t)pending);
+	if (!data || (BIO_read(bio, data, (int)pending) != (int)pending))
+		goto fail;
+
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, (size_t)pending);
+
+	BYTE byte = 0;
+	Stream_Read_UINT8(s, byte);
+	if (byte != (WEBSOCKET_FIN_BIT | opcode))
+		goto fail;
+	Stream_Read_UINT8(s, byte);
+	if ((byte & WEBSOCKET_MASK_BIT) == 0)
+		goto fail;
+
+	size_t len = byte & 0x7f;
+	if (len == 126)
+	{
+		UINT16 len16 = 0;
+		Stream_Read_UINT16_BE(s, len16);
+		len = len16;
+	}
+	else if (len == 127)
+	{
+		UINT64 len64 = 0;
+		Stream_Read_UINT64_BE(s, len64);
+		len = (size_t)len64;
+	}
+
+	BYTE key[4] = { 0 };
+	Stream_Read(s, key, sizeof(key));
+	if ((len != length) || (Stream_GetRemainingLength(s) != length))
+		goto fail;
+
+	const BYTE* masked = Stream_ConstPointer(s);
+	for (size_t x = 0; x < length; x++)
+	{
+		if ((masked[x] ^ key[x % 4]) != payload[x])
+		{
+			(void)fprintf(stderr, "[%s] length %" PRIuz ": mismatch at %" PRIuz "\n", __func__,
+			              length, x);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(data);
+	return rc;
+}
+
+static BOOL test_frames(void)
+{
+	BOOL rc = FALSE;
+	const size_t sizes[] = { 0, 1, 3, 7, 8, 31, 32, 33, 125, 126, 127, 1000, 0xFFFF, 0x10000, 70001 };
+	BYTE* payload = malloc(70001);
+	websocket_context* context = websocket_context_new();
+	BIO* bio = BIO_new(BIO_s_mem());
+
+	if (!payload || !context || !bio)
+		goto fail;
+
+	if (winpr_RAND(payload, 70001) < 0)
+		goto fail;
+
+	/* the reused send buffer grows and shrinks with the frames, check both directions */
+	for (size_t pass = 0; pass < 2; pass++)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+		{
+			const size_t idx = (pass == 0) ? x : ARRAYSIZE(sizes) - x - 1;
+			const size_t length = sizes[idx];
+			if (websocket_context_write(context, bio, payload, (int)length,
+			                            WebsocketBinaryOpcode) != (int)length)
+				goto fail;
+			if (!check_frame(bio, payload, length, WebsocketBinaryOpcode))
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	BIO_free_all(bio);
+	websocket_context_free(context);
+	free(payload);
+	return rc;
+}
+
+int TestWebsocket(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_frames())
+		return -1;
+	return 0;
+}
@@ -10,6 +10,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_AllowUnanouncedOrdersFromServer,
 	FreeRDP_AltSecFrameMarkerSupport,
 	FreeRDP_AsyncChannels,
+	FreeRDP_AsyncTransport,
 	FreeRDP_AsyncUpdate,
 	FreeRDP_AudioCapture,
 	FreeRDP_AudioPlayback,
@@ -25,6 +26,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_BitmapCacheV3Enabled,
 	FreeRDP_BitmapCompressionDisabled,
 	FreeRDP_CertificateCallbackPreferPEM,
+	FreeRDP_CompressionAdaptive,
 	FreeRDP_CompressionEnabled,
 	FreeRDP_ConnectChildSession,
 	FreeRDP_ConsoleSession,
@@ -74,8 +76,10 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_GatewayRpcTransport,
 	FreeRDP_GatewayUdpTransport,
 	FreeRDP_GatewayUseSameCredentials,
+	FreeRDP_GdiMonitorSurfaces,
 	FreeRDP_GfxAVC444,
 	FreeRDP_GfxAVC444v2,
+	FreeRDP_GfxClearCodec,
 	FreeRDP_GfxH264,
 	FreeRDP_GfxPlanar,
 	FreeRDP_GfxProgressive,
@@ -99,6 +103,7 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_KerberosRdgIsProxy,
 	FreeRDP_ListMonitors,
 	FreeRDP_LocalConnection,
+	FreeRDP_LocalShmTransport,
 	FreeRDP_LogonErrors,
 	FreeRDP_LogonNotify,
 	FreeRDP_LongCredentialsSupported,
@@ -183,7 +188,10 @@ static const size_t bool_list_indices[] = {
 	FreeRDP_SynchronousDynamicChannels,
 	FreeRDP_SynchronousStaticChannels,
 	FreeRDP_TcpKeepAlive,
+	FreeRDP_TcpLatencyMode,
+	FreeRDP_TlsKernelOffload,
 	FreeRDP_TlsSecurity,
+	FreeRDP_TlsSessionResumption,
 	FreeRDP_ToggleFullscreen,
 	FreeRDP_TransportDump,
 	FreeRDP_TransportDumpReplay,
@@ -222,6 +230,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_AcceptedCertLength,
 	FreeRDP_AuthenticationLevel,
 	FreeRDP_AutoReconnectMaxRetries,
+	FreeRDP_BitmapCacheBudget,
 	FreeRDP_BitmapCacheV2NumCells,
 	FreeRDP_BitmapCacheV3CodecId,
 	FreeRDP_BitmapCacheVersion,
@@ -265,8 +274,10 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_GatewayCredentialsSource,
 	FreeRDP_GatewayPort,
 	FreeRDP_GatewayUsageMethod,
+	FreeRDP_GfxCacheBudget,
 	FreeRDP_GfxCapsFilter,
 	FreeRDP_GlyphSupportLevel,
+	FreeRDP_InputCoalesceInterval,
 	FreeRDP_JpegCodecId,
 	FreeRDP_JpegQuality,
 	FreeRDP_KeySpec,
@@ -287,6 +298,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_NSCodecColorLossLevel,
 	FreeRDP_NSCodecId,
 	FreeRDP_NegotiationFlags,
+	FreeRDP_NetworkAutoDetectInterval,
 	FreeRDP_NumMonitorIds,
 	FreeRDP_OffscreenCacheEntries,
 	FreeRDP_OffscreenCacheSize,
@@ -335,10 +347,12 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_SurfaceCommandsSupported,
 	FreeRDP_TargetNetAddressCount,
 	FreeRDP_TcpAckTimeout,
+	FreeRDP_TcpConnectAttemptDelay,
 	FreeRDP_TcpConnectTimeout,
 	FreeRDP_TcpKeepAliveDelay,
 	FreeRDP_TcpKeepAliveInterval,
 	FreeRDP_TcpKeepAliveRetries,
+	FreeRDP_TcpNotSentLowat,
 	FreeRDP_ThreadingFlags,
 	FreeRDP_TlsSecLevel,
 	FreeRDP_VCChunkSize,
@@ -453,8 +467,10 @@ static const size_t string_list_indices[] = {
 	FreeRDP_SmartcardPrivateKey,
 	FreeRDP_SspiModule,
 	FreeRDP_TargetNetAddress,
+	FreeRDP_TcpCongestionControl,
 	FreeRDP_TerminalDescriptor,
 	FreeRDP_TlsSecretsFile,
+	FreeRDP_TlsSessionCacheFile,
 	FreeRDP_TransportDumpFile,
 	FreeRDP_UserSpecifiedServerName,
 	FreeRDP_Username,
@@ -19,6 +19,7 @@
  */
 
 #include <winpr/thread.h>
+#include <winpr/synch.h>
 #include <winpr/collections.h>
 
 #include <freerdp/timer.h>
@@ -26,6 +27,20 @@
 #include "utils.h"
 #include "timer.h"
 
+/**
+ * All timers of the process are run by one thread. Pending timers are kept in a min heap
+ * ordered by their next deadline, the thread sleeps until the earliest one. Deadlines are
+ * rounded up to TIMER_COALESCE_NS and every timer that is due within that window runs in the
+ * same wakeup, so the timers of many sessions do not wake the thread one after another.
+ */
+
+#define TIMER_COALESCE_NS 1000000ull
+
+/* timers of aborted connections are skipped and looked at again after this delay */
+#define TIMER_ABORTED_RETRY_NS 100000000ull
+
+#define TIMER_NOT_SCHEDULED SIZE_MAX
+
 typedef ALIGN64 struct
 {
 	FreeRDP_TimerID id;
@@ -34,240 +49,415 @@ typedef ALIGN64 struct
 	FreeRDP_TimerCallback cb;
 	void* userdata;
 	rdpContext* context;
+	FreeRDPTimer* timer;
+	size_t heapIndex;
 	bool mainloop;
+	bool mainloopPending;
+	bool running;
+	bool removed;
 } timer_entry_t;
 
 struct ALIGN64 freerdp_timer_s
 {
 	rdpRdp* rdp;
 	wArrayList* entries;
-	HANDLE thread;
-	HANDLE event;
 	HANDLE mainevent;
 	size_t maxIdx;
-	bool running;
 };
 
-FreeRDP_TimerID freerdp_timer_add(rdpContext* context, uint64_t intervalNS,
-                                  FreeRDP_TimerCallback callback, void* userdata, bool mainloop)
+typedef struct
 {
-	WINPR_ASSERT(context);
-	WINPR_ASSERT(context->rdp);
+	CRITICAL_SECTION lock;
+	timer_entry_t** heap;
+	size_t count;
+	size_t capacity;
+	HANDLE event;
+	HANDLE thread;
+	DWORD threadId;
+	size_t generation;
+	size_t users;
+	const timer_entry_t* current;
+} timer_service_t;
+
+static timer_service_t service = { 0 };
+static INIT_ONCE serviceOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK timer_service_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                        WINPR_ATTR_UNUSED PVOID param,
+                                        WINPR_ATTR_UNUSED PVOID* context)
+{
+	if (!InitializeCriticalSectionAndSpinCount(&service.lock, 4000))
+		return FALSE;
 
-	FreeRDPTimer* timer = context->rdp->timer;
-	WINPR_ASSERT(timer);
+	service.event = CreateEventA(NULL, TRUE, FALSE, NULL);
+	return service.event != NULL;
+}
 
-	if ((intervalNS == 0) || !callback)
-		return false;
+static bool heap_less(size_t a, size_t b)
+{
+	return service.heap[a]->nextRunTimeNS < service.heap[b]->nextRunTimeNS;
+}
 
-	const uint64_t cur = winpr_GetTickCount64NS();
-	const timer_entry_t entry = { .id = ++timer->maxIdx,
-		                          .intervallNS = intervalNS,
-		                          .nextRunTimeNS = cur + intervalNS,
-		                          .cb = callback,
-		                          .userdata = userdata,
-		                          .context = context,
-		                          .mainloop = mainloop };
+static void heap_swap(size_t a, size_t b)
+{
+	timer_entry_t* tmp = service.heap[a];
+	service.heap[a] = service.heap[b];
+	service.heap[b] = tmp;
+	service.heap[a]->heapIndex = a;
+	service.heap[b]->heapIndex = b;
+}
 
-	if (!ArrayList_Append(timer->entries, &entry))
-		return 0;
-	(void)SetEvent(timer->event);
-	return entry.id;
+static void heap_sift_up(size_t index)
+{
+	while (index > 0)
+	{
+		const size_t parent = (index - 1) / 2;
+		if (!heap_less(index, parent))
+			break;
+		heap_swap(index, parent);
+		index = parent;
+	}
 }
 
-static BOOL foreach_entry(void* data, WINPR_ATTR_UNUSED size_t index, va_list ap)
+static void heap_sift_down(size_t index)
 {
-	timer_entry_t* entry = data;
-	WINPR_ASSERT(entry);
+	for (;;)
+	{
+		const size_t left = 2 * index + 1;
+		const size_t right = left + 1;
+		size_t smallest = index;
+
+		if ((left < service.count) && heap_less(left, smallest))
+			smallest = left;
+		if ((right < service.count) && heap_less(right, smallest))
+			smallest = right;
+		if (smallest == index)
+			break;
+		heap_swap(index, smallest);
+		index = smallest;
+	}
+}
 
-	FreeRDP_TimerID id = va_arg(ap, FreeRDP_TimerID);
+static bool heap_push(timer_entry_t* entry, uint64_t nextRunTimeNS)
+{
+	WINPR_ASSERT(entry);
+	WINPR_ASSERT(entry->heapIndex == TIMER_NOT_SCHEDULED);
 
-	if (entry->id == id)
+	if (service.count == service.capacity)
 	{
-		/* Mark the timer to be disabled.
-		 * It will be removed on next rescheduling event
-		 */
-		entry->intervallNS = 0;
-		return FALSE;
+		const size_t capacity = (service.capacity > 0) ? service.capacity * 2 : 32;
+		timer_entry_t** heap = realloc(service.heap, sizeof(timer_entry_t*) * capacity);
+		if (!heap)
+			return false;
+		service.heap = heap;
+		service.capacity = capacity;
 	}
-	return TRUE;
+
+	/* round up, so timers that are due at about the same time share a wakeup */
+	entry->nextRunTimeNS = nextRunTimeNS;
+	if (nextRunTimeNS < UINT64_MAX - TIMER_COALESCE_NS)
+		entry->nextRunTimeNS = (nextRunTimeNS + TIMER_COALESCE_NS - 1) / TIMER_COALESCE_NS *
+		                       TIMER_COALESCE_NS;
+
+	entry->heapIndex = service.count;
+	service.heap[service.count++] = entry;
+	heap_sift_up(entry->heapIndex);
+
+	/* a new earliest deadline, the thread has to look again */
+	if (entry->heapIndex == 0)
+		(void)SetEvent(service.event);
+	return true;
 }
 
-bool freerdp_timer_remove(rdpContext* context, FreeRDP_TimerID id)
+static void heap_remove(timer_entry_t* entry)
 {
-	WINPR_ASSERT(context);
-	WINPR_ASSERT(context->rdp);
+	WINPR_ASSERT(entry);
 
-	FreeRDPTimer* timer = context->rdp->timer;
-	WINPR_ASSERT(timer);
+	const size_t index = entry->heapIndex;
+	if (index == TIMER_NOT_SCHEDULED)
+		return;
 
-	return !ArrayList_ForEach(timer->entries, foreach_entry, id);
+	entry->heapIndex = TIMER_NOT_SCHEDULED;
+	service.count--;
+	if (index == service.count)
+		return;
+
+	service.heap[index] = service.heap[service.count];
+	service.heap[index]->heapIndex = index;
+	heap_sift_up(index);
+	heap_sift_down(service.heap[index]->heapIndex);
 }
 
-static BOOL runTimerEvent(timer_entry_t* entry, uint64_t* now)
+static void timer_entry_free(timer_entry_t* entry)
 {
 	WINPR_ASSERT(entry);
+	heap_remove(entry);
+	ArrayList_Remove(entry->timer->entries, entry);
+}
 
-	entry->intervallNS =
-	    entry->cb(entry->context, entry->userdata, entry->id, *now, entry->intervallNS);
-	*now = winpr_GetTickCount64NS();
-	entry->nextRunTimeNS = *now + entry->intervallNS;
-	return TRUE;
+/* called with the lock held once a callback returned */
+static void timer_entry_reschedule(timer_entry_t* entry, uint64_t intervalNS)
+{
+	WINPR_ASSERT(entry);
+
+	entry->running = false;
+	entry->intervallNS = intervalNS;
+	if (entry->removed || (intervalNS == 0) ||
+	    !heap_push(entry, winpr_GetTickCount64NS() + intervalNS))
+		timer_entry_free(entry);
 }
 
-static BOOL runExpiredTimer(void* data, WINPR_ATTR_UNUSED size_t index,
-                            WINPR_ATTR_UNUSED va_list ap)
+static uint64_t timer_entry_run(timer_entry_t* entry, uint64_t now)
 {
-	timer_entry_t* entry = data;
 	WINPR_ASSERT(entry);
 	WINPR_ASSERT(entry->cb);
 
-	/* Skip all timers that have been deactivated. */
-	if (entry->intervallNS == 0)
-		return TRUE;
+	entry->running = true;
+	LeaveCriticalSection(&service.lock);
+	const uint64_t interval =
+	    entry->cb(entry->context, entry->userdata, entry->id, now, entry->intervallNS);
+	EnterCriticalSection(&service.lock);
+	return interval;
+}
 
-	uint64_t* now = va_arg(ap, uint64_t*);
-	WINPR_ASSERT(now);
+FreeRDP_TimerID freerdp_timer_add(rdpContext* context, uint64_t intervalNS,
+                                  FreeRDP_TimerCallback callback, void* userdata, bool mainloop)
+{
+	FreeRDP_TimerID id = 0;
 
-	bool* mainloop = va_arg(ap, bool*);
-	WINPR_ASSERT(mainloop);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->rdp);
 
-	if (entry->nextRunTimeNS > *now)
-		return TRUE;
+	FreeRDPTimer* timer = context->rdp->timer;
+	WINPR_ASSERT(timer);
+
+	if ((intervalNS == 0) || !callback)
+		return false;
+
+	timer_entry_t* entry = calloc(1, sizeof(timer_entry_t));
+	if (!entry)
+		return 0;
+
+	entry->intervallNS = intervalNS;
+	entry->cb = callback;
+	entry->userdata = userdata;
+	entry->context = context;
+	entry->timer = timer;
+	entry->heapIndex = TIMER_NOT_SCHEDULED;
+	entry->mainloop = mainloop;
+
+	EnterCriticalSection(&service.lock);
+	entry->id = ++timer->maxIdx;
+	if (!ArrayList_Append(timer->entries, entry))
+	{
+		free(entry);
+		goto out;
+	}
 
-	if (entry->mainloop)
-		*mainloop = true;
-	else
-		runTimerEvent(entry, now);
+	if (!heap_push(entry, winpr_GetTickCount64NS() + intervalNS))
+	{
+		ArrayList_Remove(timer->entries, entry);
+		goto out;
+	}
+	id = entry->id;
 
-	return TRUE;
+out:
+	LeaveCriticalSection(&service.lock);
+	return id;
 }
 
-static uint64_t expire_and_reschedule(FreeRDPTimer* timer)
+static timer_entry_t* timer_find(FreeRDPTimer* timer, FreeRDP_TimerID id)
 {
 	WINPR_ASSERT(timer);
 
-	bool mainloop = false;
-	uint64_t next = UINT64_MAX;
-	uint64_t now = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < ArrayList_Count(timer->entries); x++)
+	{
+		timer_entry_t* entry = ArrayList_GetItem(timer->entries, x);
+		if (entry->id == id)
+			return entry;
+	}
+	return NULL;
+}
 
-	ArrayList_Lock(timer->entries);
-	ArrayList_ForEach(timer->entries, runExpiredTimer, &now, &mainloop);
-	if (mainloop)
-		(void)SetEvent(timer->mainevent);
+bool freerdp_timer_remove(rdpContext* context, FreeRDP_TimerID id)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->rdp);
+
+	FreeRDPTimer* timer = context->rdp->timer;
+	WINPR_ASSERT(timer);
+
+	EnterCriticalSection(&service.lock);
+	timer_entry_t* entry = timer_find(timer, id);
+	const bool found = entry && !entry->removed;
+	if (found)
+	{
+		/* a running callback frees its entry once it returned */
+		if (entry->running)
+			entry->removed = true;
+		else
+			timer_entry_free(entry);
+	}
+	LeaveCriticalSection(&service.lock);
+	return found;
+}
+
+static void expire_timers(size_t generation)
+{
+	uint64_t now = winpr_GetTickCount64NS();
 
-	size_t pos = 0;
-	while (pos < ArrayList_Count(timer->entries))
+	while ((service.generation == generation) && (service.count > 0) &&
+	       (service.heap[0]->nextRunTimeNS <= now + TIMER_COALESCE_NS))
 	{
-		timer_entry_t* entry = ArrayList_GetItem(timer->entries, pos);
-		WINPR_ASSERT(entry);
-		if (entry->intervallNS == 0)
+		timer_entry_t* entry = service.heap[0];
+		heap_remove(entry);
+
+		if (utils_abort_event_is_set(entry->timer->rdp))
 		{
-			ArrayList_RemoveAt(timer->entries, pos);
+			const uint64_t retry = (entry->intervallNS > TIMER_ABORTED_RETRY_NS)
+			                           ? entry->intervallNS
+			                           : TIMER_ABORTED_RETRY_NS;
+			if (!heap_push(entry, now + retry))
+				timer_entry_free(entry);
 			continue;
 		}
-		if (next > entry->nextRunTimeNS)
-			next = entry->nextRunTimeNS;
-		pos++;
-	}
-	ArrayList_Unlock(timer->entries);
 
-	if (next == UINT64_MAX)
-		return 0;
-	return next;
+		if (entry->mainloop)
+		{
+			entry->mainloopPending = true;
+			(void)SetEvent(entry->timer->mainevent);
+			continue;
+		}
+
+		service.current = entry;
+		const uint64_t interval = timer_entry_run(entry, now);
+		service.current = NULL;
+		timer_entry_reschedule(entry, interval);
+		now = winpr_GetTickCount64NS();
+	}
 }
 
 static DWORD WINAPI timer_thread(LPVOID arg)
 {
-	FreeRDPTimer* timer = arg;
-	WINPR_ASSERT(timer);
-
-	// TODO: Currently we only support ms granularity, look for ways to improve
-	DWORD timeout = INFINITE;
-	HANDLE handles[2] = { utils_get_abort_event(timer->rdp), timer->event };
+	const size_t generation = (size_t)arg;
 
-	while (WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, timeout) != WAIT_OBJECT_0)
+	EnterCriticalSection(&service.lock);
+	while (service.generation == generation)
 	{
-		(void)ResetEvent(timer->event);
-		const uint64_t next = expire_and_reschedule(timer);
-		const uint64_t now = winpr_GetTickCount64NS();
-		if (now >= next)
+		(void)ResetEvent(service.event);
+		expire_timers(generation);
+
+		// TODO: Currently we only support ms granularity, look for ways to improve
+		DWORD timeout = INFINITE;
+		if (service.count > 0)
 		{
-			timeout = INFINITE;
-			continue;
+			const uint64_t now = winpr_GetTickCount64NS();
+			const uint64_t next = service.heap[0]->nextRunTimeNS;
+			const uint64_t diffMS = (next > now) ? (next - now + 999999ull) / 1000000ull : 0;
+			if (diffMS < INFINITE)
+				timeout = (DWORD)diffMS;
 		}
 
-		const uint64_t diff = next - now;
-		const uint64_t diffMS = diff / 1000;
-		timeout = INFINITE;
-		if (diffMS < INFINITE)
-			timeout = (uint32_t)diffMS;
+		LeaveCriticalSection(&service.lock);
+		(void)WaitForSingleObject(service.event, timeout);
+		EnterCriticalSection(&service.lock);
 	}
+	LeaveCriticalSection(&service.lock);
 	return 0;
 }
 
 void freerdp_timer_free(FreeRDPTimer* timer)
 {
+	HANDLE thread = NULL;
+
 	if (!timer)
 		return;
 
-	if (timer->event)
-		(void)SetEvent(timer->event);
-	timer->running = false;
-	if (timer->thread)
+	if (timer->entries)
+	{
+		EnterCriticalSection(&service.lock);
+
+		/* wait for a callback of this timer that is running right now */
+		while (service.current && (service.current->timer == timer) &&
+		       (service.threadId != GetCurrentThreadId()))
+		{
+			LeaveCriticalSection(&service.lock);
+			Sleep(1);
+			EnterCriticalSection(&service.lock);
+		}
+
+		while (ArrayList_Count(timer->entries) > 0)
+			timer_entry_free(ArrayList_GetItem(timer->entries, 0));
+
+		/* the last user stops the thread */
+		if (--service.users == 0)
+		{
+			service.generation++;
+			(void)SetEvent(service.event);
+			thread = service.thread;
+			service.thread = NULL;
+			if (service.threadId == GetCurrentThreadId())
+			{
+				(void)CloseHandle(thread);
+				thread = NULL;
+			}
+		}
+		LeaveCriticalSection(&service.lock);
+	}
+
+	if (thread)
 	{
-		(void)WaitForSingleObject(timer->thread, INFINITE);
-		CloseHandle(timer->thread);
+		(void)WaitForSingleObject(thread, INFINITE);
+		(void)CloseHandle(thread);
 	}
 	if (timer->mainevent)
-		CloseHandle(timer->mainevent);
-	if (timer->event)
-		CloseHandle(timer->event);
+		(void)CloseHandle(timer->mainevent);
 	ArrayList_Free(timer->entries);
 	free(timer);
 }
 
-static void* entry_new(const void* val)
+FreeRDPTimer* freerdp_timer_new(rdpRdp* rdp)
 {
-	const timer_entry_t* entry = val;
-	if (!entry)
-		return NULL;
+	WINPR_ASSERT(rdp);
 
-	timer_entry_t* copy = calloc(1, sizeof(timer_entry_t));
-	if (!copy)
+	if (!InitOnceExecuteOnce(&serviceOnce, timer_service_init, NULL, NULL))
 		return NULL;
-	*copy = *entry;
-	return copy;
-}
 
-FreeRDPTimer* freerdp_timer_new(rdpRdp* rdp)
-{
-	WINPR_ASSERT(rdp);
 	FreeRDPTimer* timer = calloc(1, sizeof(FreeRDPTimer));
 	if (!timer)
 		return NULL;
 	timer->rdp = rdp;
 
-	timer->entries = ArrayList_New(TRUE);
-	if (!timer->entries)
+	timer->mainevent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (!timer->mainevent)
 		goto fail;
-	wObject* obj = ArrayList_Object(timer->entries);
-	WINPR_ASSERT(obj);
-	obj->fnObjectNew = entry_new;
-	obj->fnObjectFree = free;
 
-	timer->event = CreateEventA(NULL, TRUE, FALSE, NULL);
-	if (!timer->event)
+	wArrayList* entries = ArrayList_New(FALSE);
+	if (!entries)
 		goto fail;
+	wObject* obj = ArrayList_Object(entries);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = free;
 
-	timer->mainevent = CreateEventA(NULL, TRUE, FALSE, NULL);
-	if (!timer->mainevent)
-		goto fail;
+	EnterCriticalSection(&service.lock);
+	if (!service.thread)
+	{
+		service.generation++;
+		service.thread = CreateThread(NULL, 0, timer_thread, (void*)service.generation, 0,
+		                              &service.threadId);
+	}
+	if (service.thread)
+	{
+		service.users++;
+		timer->entries = entries;
+	}
+	LeaveCriticalSection(&service.lock);
 
-	timer->running = true;
-	timer->thread = CreateThread(NULL, 0, timer_thread, timer, 0, NULL);
-	if (!timer->thread)
+	if (!timer->entries)
+	{
+		ArrayList_Free(entries);
 		goto fail;
+	}
 	return timer;
 
 fail:
@@ -275,31 +465,6 @@ fail:
 	return NULL;
 }
 
-static BOOL runExpiredTimerOnMainloop(void* data, WINPR_ATTR_UNUSED size_t index,
-                                      WINPR_ATTR_UNUSED va_list ap)
-{
-	timer_entry_t* entry = data;
-	WINPR_ASSERT(entry);
-	WINPR_ASSERT(entry->cb);
-
-	/* Skip events not on mainloop */
-	if (!entry->mainloop)
-		return TRUE;
-
-	/* Skip all timers that have been deactivated. */
-	if (entry->intervallNS == 0)
-		return TRUE;
-
-	uint64_t* now = va_arg(ap, uint64_t*);
-	WINPR_ASSERT(now);
-
-	if (entry->nextRunTimeNS > *now)
-		return TRUE;
-
-	runTimerEvent(entry, now);
-	return TRUE;
-}
-
 bool freerdp_timer_poll(FreeRDPTimer* timer)
 {
 	WINPR_ASSERT(timer);
@@ -307,12 +472,32 @@ bool freerdp_timer_poll(FreeRDPTimer* timer)
 	if (WaitForSingleObject(timer->mainevent, 0) != WAIT_OBJECT_0)
 		return true;
 
-	ArrayList_Lock(timer->entries);
+	EnterCriticalSection(&service.lock);
 	(void)ResetEvent(timer->mainevent);
-	uint64_t now = winpr_GetTickCount64NS();
-	ArrayList_ForEach(timer->entries, runExpiredTimerOnMainloop, &now);
-	(void)SetEvent(timer->event); // Trigger a wakeup of timer thread to reschedule
-	ArrayList_Unlock(timer->entries);
+
+	/* callbacks may add or remove timers, start over after each one */
+	size_t x = 0;
+	while (x < ArrayList_Count(timer->entries))
+	{
+		timer_entry_t* entry = ArrayList_GetItem(timer->entries, x);
+		if (!entry->mainloopPending || entry->running)
+		{
+			x++;
+			continue;
+		}
+
+		entry->mainloopPending = false;
+		if (entry->removed)
+		{
+			timer_entry_free(entry);
+			continue;
+		}
+
+		const uint64_t interval = timer_entry_run(entry, winpr_GetTickCount64NS());
+		timer_entry_reschedule(entry, interval);
+		x = 0;
+	}
+	LeaveCriticalSection(&service.lock);
 	return true;
 }
 
@@ -29,10 +29,12 @@
 #include <winpr/stream.h>
 #include <winpr/winsock.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/error.h>
 #include <freerdp/utils/ringbuffer.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include <openssl/bio.h>
 #include <time.h>
@@ -56,6 +58,8 @@
 #include "utils.h"
 #include "state.h"
 #include "childsession.h"
+#include "shmtransport.h"
+#include "metrics.h"
 
 #include "gateway/rdg.h"
 #include "gateway/wst.h"
@@ -65,6 +69,25 @@
 
 #define BUFFER_SIZE 16384
 
+/* coalesced small PDUs fill at most one TLS record and wait no longer than the deadline */
+#define COALESCE_BUFFER_SIZE 16000
+#define COALESCE_DEADLINE_MS 1
+
+/* received data is read in chunks of this size, larger remainders go to the PDU directly */
+#define READ_AHEAD_SIZE 0x10000
+/* PDUs dispatched from already received data before returning to the event loop */
+#define READ_AHEAD_MAX_PDUS 32
+
+/* producers wait for the writer thread above the high until it is below the low watermark */
+#define WRITER_HIGH_WATERMARK (4 * 1024 * 1024)
+#define WRITER_LOW_WATERMARK (1 * 1024 * 1024)
+
+typedef struct transport_send_entry
+{
+	struct transport_send_entry* next;
+	wStream* s;
+} rdpTransportSendEntry;
+
 struct rdp_transport
 {
 	TRANSPORT_LAYER layer;
@@ -88,15 +111,35 @@ struct rdp_transport
 	CRITICAL_SECTION ReadLock;
 	CRITICAL_SECTION WriteLock;
 	UINT64 written;
+	BOOL coalesce;
+	wStream* coalesceBuffer;
+	UINT64 coalesceStart;
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
+	RingBuffer readAhead;
 	wLog* log;
 	rdpTransportIo io;
 	HANDLE ioEvent;
 	BOOL useIoEvent;
 	BOOL earlyUserAuth;
+	DWORD packetSession;
+	BOOL flushWrites;
+	HANDLE writerThread;
+	HANDLE writerEvent;
+	HANDLE writerDrainedEvent;
+	wStreamPool* SendPool;
+	rdpTransportSendEntry* volatile writerQueue[TRANSPORT_PRIORITY_COUNT];
+	rdpTransportSendEntry* writerFifo[TRANSPORT_PRIORITY_COUNT];
+	volatile LONG writerActive;
+	volatile LONG writerProducers;
+	volatile LONG writerPending;
+	volatile LONG writerQueuedBytes;
+	volatile LONG writerFailed;
 };
 
+/* every transport is captured as its own session by packet logging */
+static LONG g_PacketSession = 0;
+
 static void transport_ssl_cb(const SSL* ssl, int where, int ret)
 {
 	if (where & SSL_CB_ALERT)
@@ -177,10 +220,28 @@ static BOOL transport_default_attach(rdpTransport* transport, int sockfd)
 	settings = context->settings;
 	WINPR_ASSERT(settings);
 
+	if (freerdp_settings_get_bool(settings, FreeRDP_LocalShmTransport) &&
+	    freerdp_shm_transport_supported(sockfd))
+	{
+		rdpTransportLayer* layer = freerdp_shm_transport_accept(transport, sockfd);
+		if (!layer)
+			goto fail;
+
+		/* the layer owns the socket from here on */
+		if (!transport_attach_layer(transport, layer))
+		{
+			transport_layer_free(layer);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
 	if (sockfd >= 0)
 	{
 		if (!freerdp_tcp_set_keep_alive_mode(settings, sockfd))
 			goto fail;
+		if (!freerdp_tcp_set_latency_mode(settings, sockfd))
+			goto fail;
 
 		socketBio = BIO_new(BIO_s_simple_socket());
 
@@ -204,6 +265,8 @@ static BOOL transport_default_attach(rdpTransport* transport, int sockfd)
 		 * - if this function is successful, the caller MUST NOT close the socket any more.
 		 */
 		BIO_set_fd(socketBio, sockfd, BIO_CLOSE);
+		BIO_set_latency_mode(socketBio,
+		                     freerdp_settings_get_bool(settings, FreeRDP_TcpLatencyMode));
 	}
 	EnterCriticalSection(&(transport->ReadLock));
 	EnterCriticalSection(&(transport->WriteLock));
@@ -270,6 +333,20 @@ BOOL transport_connect_tls(rdpTransport* transport)
 	return IFCALLRESULT(FALSE, transport->io.TLSConnect, transport);
 }
 
+/* data read ahead belongs to the layer below the new TLS layer and can not be handed over */
+static BOOL transport_read_ahead_empty(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	const size_t used = ringbuffer_used(&transport->readAhead);
+	if (used == 0)
+		return TRUE;
+
+	WLog_Print(transport->log, WLOG_ERROR,
+	           "peer sent %" PRIuz " bytes ahead of the TLS handshake, aborting", used);
+	return FALSE;
+}
+
 static BOOL transport_default_connect_tls(rdpTransport* transport)
 {
 	int tlsStatus = 0;
@@ -285,6 +362,9 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 	settings = context->settings;
 	WINPR_ASSERT(settings);
 
+	if (!transport_read_ahead_empty(transport))
+		return FALSE;
+
 	if (!(tls = freerdp_tls_new(context)))
 		return FALSE;
 
@@ -303,6 +383,7 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 		tls->port = 3389;
 
 	tls->isGatewayTransport = FALSE;
+	const UINT64 start = winpr_GetTickCount64NS();
 	tlsStatus = freerdp_tls_connect(tls, transport->frontBio);
 
 	if (tlsStatus < 1)
@@ -319,6 +400,7 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 		return FALSE;
 	}
 
+	rdp_timeline_add(context->rdp, "tls", start);
 	transport->frontBio = tls->bio;
 
 	/* See libfreerdp/crypto/tls.c transport_default_connect_tls
@@ -637,6 +719,9 @@ static BOOL transport_default_accept_tls(rdpTransport* transport)
 	settings = context->settings;
 	WINPR_ASSERT(settings);
 
+	if (!transport_read_ahead_empty(transport))
+		return FALSE;
+
 	if (!transport->tls)
 		transport->tls = freerdp_tls_new(context);
 
@@ -790,10 +875,38 @@ static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t
 
 	while (read < (SSIZE_T)bytes)
 	{
-		const SSIZE_T tr = (SSIZE_T)bytes - read;
-		int r = (int)((tr > INT_MAX) ? INT_MAX : tr);
+		const size_t tr = bytes - (size_t)read;
+
+		/* serve what an earlier read already received */
+		const size_t buffered = ringbuffer_used(&transport->readAhead);
+		if (buffered > 0)
+		{
+			DataChunk chunks[2] = { 0 };
+			const size_t len = MIN(tr, buffered);
+			const int nchunks = ringbuffer_peek(&transport->readAhead, chunks, len);
+			for (int x = 0; x < nchunks; x++)
+			{
+				memcpy(data + read, chunks[x].data, chunks[x].size);
+				read += (SSIZE_T)chunks[x].size;
+			}
+			ringbuffer_commit_read_bytes(&transport->readAhead, len);
+			continue;
+		}
+
+		/* read ahead so the following headers and PDUs need no read of their own */
+		BYTE* target = data + read;
+		int r = (int)MIN(tr, INT_MAX);
+		const BOOL readAhead = (tr < READ_AHEAD_SIZE);
+		if (readAhead)
+		{
+			target = ringbuffer_ensure_linear_write(&transport->readAhead, READ_AHEAD_SIZE);
+			if (!target)
+				return -1;
+			r = READ_AHEAD_SIZE;
+		}
+
 		ERR_clear_error();
-		int status = BIO_read(transport->frontBio, data + read, r);
+		int status = BIO_read(transport->frontBio, target, r);
 
 		if (freerdp_shall_disconnect_context(context))
 			return -1;
@@ -831,9 +944,15 @@ static SSIZE_T transport_read_layer(rdpTransport* transport, BYTE* data, size_t
 		}
 
 #ifdef FREERDP_HAVE_VALGRIND_MEMCHECK_H
-		VALGRIND_MAKE_MEM_DEFINED(data + read, bytes - read);
+		VALGRIND_MAKE_MEM_DEFINED(target, (size_t)status);
 #endif
-		read += status;
+		if (readAhead)
+		{
+			if (!ringbuffer_commit_written_bytes(&transport->readAhead, (size_t)status))
+				return -1;
+		}
+		else
+			read += status;
 		rdp->inBytes += WINPR_ASSERTING_INT_CAST(uint64_t, status);
 	}
 
@@ -888,7 +1007,11 @@ int transport_read_pdu(rdpTransport* transport, wStream* s)
 {
 	if (!transport)
 		return -1;
-	return IFCALLRESULT(-1, transport->io.ReadPdu, transport, s);
+
+	const int rc = IFCALLRESULT(-1, transport->io.ReadPdu, transport, s);
+	if (rc > 0)
+		FREERDP_TRACEPOINT(transport_read_pdu, 0, rc);
+	return rc;
 }
 
 static SSIZE_T parse_nla_mode_pdu(rdpTransport* transport, wStream* stream)
@@ -1119,7 +1242,7 @@ static int transport_default_read_pdu(rdpTransport* transport, wStream* s)
 
 		if (Stream_GetPosition(s) >= pduLength)
 			WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), pduLength,
-			            WLOG_PACKET_INBOUND);
+			            WLOG_PACKET_INBOUND | transport->packetSession);
 	}
 
 	Stream_SealLength(s);
@@ -1138,42 +1261,29 @@ int transport_write(rdpTransport* transport, wStream* s)
 	return IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
 }
 
-static int transport_default_write(rdpTransport* transport, wStream* s)
+/* must be called with the WriteLock held */
+static int transport_write_buffer(rdpTransport* transport, const BYTE* data, size_t length)
 {
-	int status = -1;
+	int status = 0;
+	UINT64 stalled = 0;
 	rdpContext* context = transport_get_context(transport);
 
 	WINPR_ASSERT(transport);
 	WINPR_ASSERT(context);
-
-	if (!s)
-		return -1;
-
-	Stream_AddRef(s);
-
-	rdpRdp* rdp = context->rdp;
-	if (!rdp)
-		goto fail;
-
-	EnterCriticalSection(&(transport->WriteLock));
-	if (!transport->frontBio)
-		goto out_cleanup;
-
-	size_t length = Stream_GetPosition(s);
-	size_t writtenlength = length;
-	Stream_SetPosition(s, 0);
+	WINPR_ASSERT(data || (length == 0));
 
 	if (length > 0)
 	{
-		rdp->outBytes += length;
-		WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
+		context->rdp->outBytes += length;
+		WLog_Packet(transport->log, WLOG_TRACE, data, length,
+		            WLOG_PACKET_OUTBOUND | transport->packetSession);
 	}
 
 	while (length > 0)
 	{
 		ERR_clear_error();
 		const int towrite = (length > INT32_MAX) ? INT32_MAX : (int)length;
-		status = BIO_write(transport->frontBio, Stream_ConstPointer(s), towrite);
+		status = BIO_write(transport->frontBio, data, towrite);
 
 		if (status <= 0)
 		{
@@ -1184,74 +1294,560 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 			if (!BIO_should_retry(transport->frontBio))
 			{
 				WLog_ERR_BIO(transport, "BIO_should_retry", transport->frontBio);
-				goto out_cleanup;
+				return -1;
 			}
 
 			/* non-blocking can live with blocked IOs */
 			if (!transport->blocking)
 			{
 				WLog_ERR_BIO(transport, "BIO_write", transport->frontBio);
-				goto out_cleanup;
+				return -1;
 			}
 
+			if (stalled == 0)
+				stalled = winpr_GetTickCount64NS();
 			if (BIO_wait_write(transport->frontBio, 100) < 0)
 			{
 				WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
-				status = -1;
-				goto out_cleanup;
+				return -1;
 			}
 
 			continue;
 		}
 
 		WINPR_ASSERT(context->settings);
-		if (transport->blocking || context->settings->WaitForOutputBufferFlush)
+		if (transport->blocking || transport->flushWrites ||
+		    context->settings->WaitForOutputBufferFlush)
 		{
 			while (BIO_write_blocked(transport->frontBio))
 			{
+				if (stalled == 0)
+					stalled = winpr_GetTickCount64NS();
 				if (BIO_wait_write(transport->frontBio, 100) < 0)
 				{
 					WLog_Print(transport->log, WLOG_ERROR, "error when selecting for write");
-					status = -1;
-					goto out_cleanup;
+					return -1;
 				}
 
 				if (BIO_flush(transport->frontBio) < 1)
 				{
 					WLog_Print(transport->log, WLOG_ERROR, "error when flushing outputBuffer");
-					status = -1;
-					goto out_cleanup;
+					return -1;
 				}
 			}
 		}
 
 		const size_t ustatus = (size_t)status;
 		if (ustatus > length)
+			return -1;
+
+		length -= ustatus;
+		data += ustatus;
+	}
+
+	if (stalled != 0)
+	{
+		const UINT64 us = (winpr_GetTickCount64NS() - stalled) / 1000;
+		(void)metrics_record(context->metrics, METRICS_TRANSPORT_WRITE_STALLS, 1);
+		(void)metrics_record(context->metrics, METRICS_TRANSPORT_WRITE_STALL_US, us);
+	}
+	return status;
+}
+
+/* must be called with the WriteLock held */
+static int transport_flush_coalesced(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	wStream* s = transport->coalesceBuffer;
+	if (!s || (Stream_GetPosition(s) == 0))
+		return 0;
+
+	const int status = transport_write_buffer(transport, Stream_Buffer(s), Stream_GetPosition(s));
+	Stream_SetPosition(s, 0);
+	return status;
+}
+
+/* must be called with the WriteLock held, buffers a small PDU while coalescing is enabled */
+static int transport_coalesce(rdpTransport* transport, const rdpTransportBuffer* buffers,
+                              size_t count, size_t length)
+{
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(length <= COALESCE_BUFFER_SIZE);
+
+	if (!transport->coalesceBuffer)
+	{
+		transport->coalesceBuffer = Stream_New(NULL, COALESCE_BUFFER_SIZE);
+		if (!transport->coalesceBuffer)
+			return -1;
+	}
+
+	wStream* s = transport->coalesceBuffer;
+	if (Stream_GetPosition(s) + length > COALESCE_BUFFER_SIZE)
+	{
+		if (transport_flush_coalesced(transport) < 0)
+			return -1;
+	}
+
+	if (Stream_GetPosition(s) == 0)
+		transport->coalesceStart = GetTickCount64();
+
+	for (size_t x = 0; x < count; x++)
+		Stream_Write(s, buffers[x].data, buffers[x].length);
+
+	if (GetTickCount64() - transport->coalesceStart >= COALESCE_DEADLINE_MS)
+	{
+		if (transport_flush_coalesced(transport) < 0)
+			return -1;
+	}
+
+	return (length > INT32_MAX) ? INT32_MAX : (int)length;
+}
+
+/* must be called with the WriteLock held */
+static void transport_write_failed(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	/* A write error indicates that the peer has dropped the connection */
+	transport->layer = TRANSPORT_LAYER_CLOSED;
+	freerdp_set_last_error_if_not(transport_get_context(transport),
+	                              FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+}
+
+/* writes a queued PDU from the writer thread, small ones are coalesced until the queue is empty */
+static int transport_writer_write(rdpTransport* transport, wStream* s)
+{
+	int status = -1;
+	const rdpTransportBuffer buffer = { Stream_Buffer(s), Stream_Length(s) };
+
+	EnterCriticalSection(&(transport->WriteLock));
+	transport->flushWrites = TRUE;
+	if (transport->frontBio)
+	{
+		if (buffer.length <= COALESCE_BUFFER_SIZE)
+			status = transport_coalesce(transport, &buffer, 1, buffer.length);
+		else
 		{
-			status = -1;
-			goto out_cleanup;
+			status = transport_flush_coalesced(transport);
+			if (status >= 0)
+				status = transport_write_buffer(transport, buffer.data, buffer.length);
 		}
+	}
 
-		length -= ustatus;
-		Stream_Seek(s, ustatus);
+	if (status >= 0)
+		transport->written += buffer.length;
+	else
+		transport_write_failed(transport);
+	transport->flushWrites = FALSE;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status;
+}
+
+static rdpTransportSendEntry* transport_writer_next(rdpTransport* transport)
+{
+	for (size_t x = 0; x < TRANSPORT_PRIORITY_COUNT; x++)
+	{
+		if (!transport->writerFifo[x] && transport->writerQueue[x])
+		{
+			/* take all pushed entries at once, they are stacked newest first */
+			rdpTransportSendEntry* head = NULL;
+			rdpTransportSendEntry* fifo = NULL;
+
+			do
+			{
+				head = transport->writerQueue[x];
+			} while (InterlockedCompareExchangePointer((PVOID volatile*)&transport->writerQueue[x],
+			                                           NULL, head) != head);
+
+			while (head)
+			{
+				rdpTransportSendEntry* next = head->next;
+				head->next = fifo;
+				fifo = head;
+				head = next;
+			}
+
+			transport->writerFifo[x] = fifo;
+		}
+
+		rdpTransportSendEntry* entry = transport->writerFifo[x];
+		if (entry)
+		{
+			transport->writerFifo[x] = entry->next;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void transport_writer_drain(rdpTransport* transport)
+{
+	while (InterlockedCompareExchange(&transport->writerPending, 0, 0) > 0)
+	{
+		rdpTransportSendEntry* entry = transport_writer_next(transport);
+		WINPR_ASSERT(entry);
+		if (!entry)
+			break;
+
+		const LONG length = (LONG)Stream_Length(entry->s);
+		if (!InterlockedCompareExchange(&transport->writerFailed, 0, 0))
+		{
+			if (transport_writer_write(transport, entry->s) < 0)
+				(void)InterlockedExchange(&transport->writerFailed, 1);
+		}
+
+		Stream_Release(entry->s);
+		free(entry);
+
+		const LONG queued = InterlockedExchangeAdd(&transport->writerQueuedBytes, -length) - length;
+		(void)InterlockedDecrement(&transport->writerPending);
+		if ((queued <= WRITER_LOW_WATERMARK) && (queued + length > WRITER_LOW_WATERMARK))
+			(void)SetEvent(transport->writerDrainedEvent);
+	}
+
+	EnterCriticalSection(&(transport->WriteLock));
+	transport->flushWrites = TRUE;
+	if (transport->frontBio && !InterlockedCompareExchange(&transport->writerFailed, 0, 0))
+	{
+		if (transport_flush_coalesced(transport) < 0)
+		{
+			(void)InterlockedExchange(&transport->writerFailed, 1);
+			transport_write_failed(transport);
+		}
+	}
+	transport->flushWrites = FALSE;
+	LeaveCriticalSection(&(transport->WriteLock));
+}
+
+static DWORD WINAPI transport_writer_thread(LPVOID arg)
+{
+	rdpTransport* transport = (rdpTransport*)arg;
+
+	WINPR_ASSERT(transport);
+
+	for (;;)
+	{
+		(void)ResetEvent(transport->writerEvent);
+
+		/* read before draining, everything queued before the writer was stopped is sent */
+		const LONG active = InterlockedCompareExchange(&transport->writerActive, 0, 0);
+
+		transport_writer_drain(transport);
+
+		if (!active)
+			break;
+
+		if (WaitForSingleObject(transport->writerEvent, INFINITE) != WAIT_OBJECT_0)
+			break;
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+/* must be called with the WriteLock held */
+static BOOL transport_writer_should_start(rdpTransport* transport)
+{
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(context);
+
+	if (transport->writerThread || !transport->writerEvent)
+		return FALSE;
+
+	if (!freerdp_settings_get_bool(context->settings, FreeRDP_AsyncTransport))
+		return FALSE;
+
+	/* the connection sequence relies on writes completing in the calling thread */
+	return rdp_get_state(context->rdp) == CONNECTION_STATE_ACTIVE;
+}
+
+/* must be called with the WriteLock held */
+static BOOL transport_writer_start(rdpTransport* transport)
+{
+	(void)InterlockedExchange(&transport->writerFailed, 0);
+	(void)InterlockedExchange(&transport->writerActive, 1);
+
+	transport->writerThread = CreateThread(NULL, 0, transport_writer_thread, transport, 0, NULL);
+	if (!transport->writerThread)
+	{
+		(void)InterlockedExchange(&transport->writerActive, 0);
+		while (InterlockedCompareExchange(&transport->writerProducers, 0, 0) > 0)
+			(void)SwitchToThread();
+
+		/* PDUs queued in the meantime are written right here */
+		transport_writer_drain(transport);
+		WLog_Print(transport->log, WLOG_WARN, "failed to start the writer thread");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void transport_writer_stop(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	if (!transport->writerThread)
+		return;
+
+	(void)InterlockedExchange(&transport->writerActive, 0);
+	while (InterlockedCompareExchange(&transport->writerProducers, 0, 0) > 0)
+	{
+		(void)SetEvent(transport->writerDrainedEvent);
+		(void)SwitchToThread();
 	}
 
-	transport->written += writtenlength;
+	(void)SetEvent(transport->writerEvent);
+	(void)WaitForSingleObject(transport->writerThread, INFINITE);
+	(void)CloseHandle(transport->writerThread);
+	transport->writerThread = NULL;
+}
+
+/* back-pressure: a producer above the high watermark waits until the writer got below the low */
+static void transport_writer_wait_drained(rdpTransport* transport)
+{
+	if (InterlockedCompareExchange(&transport->writerQueuedBytes, 0, 0) <= WRITER_HIGH_WATERMARK)
+		return;
+
+	while (InterlockedCompareExchange(&transport->writerQueuedBytes, 0, 0) > WRITER_LOW_WATERMARK)
+	{
+		if (!InterlockedCompareExchange(&transport->writerActive, 0, 0) ||
+		    InterlockedCompareExchange(&transport->writerFailed, 0, 0))
+			return;
+
+		(void)ResetEvent(transport->writerDrainedEvent);
+		if (InterlockedCompareExchange(&transport->writerQueuedBytes, 0, 0) <=
+		    WRITER_LOW_WATERMARK)
+			return;
+
+		(void)WaitForSingleObject(transport->writerDrainedEvent, 100);
+	}
+}
+
+static int transport_writer_enqueue(rdpTransport* transport,
+                                    const rdpTransportBuffer* WINPR_RESTRICT buffers,
+                                    size_t count, size_t length, TRANSPORT_PRIORITY priority)
+{
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->rdp);
+	WINPR_ASSERT(priority < TRANSPORT_PRIORITY_COUNT);
+
+	/* queued sizes are accounted as LONG, stay far away from its limit */
+	if (length > INT32_MAX / 4)
+		return -1;
+
+	/* standard RDP security encrypts in send order, nothing may overtake. Outside the active
+	 * state input must not overtake the PDUs of the (re)activation sequence either. */
+	if (context->rdp->do_crypt || (rdp_get_state(context->rdp) != CONNECTION_STATE_ACTIVE))
+		priority = TRANSPORT_PRIORITY_NORMAL;
+
+	if (priority != TRANSPORT_PRIORITY_HIGH)
+		transport_writer_wait_drained(transport);
+
+	if (InterlockedCompareExchange(&transport->writerFailed, 0, 0))
+		return -1;
+
+	/* callers reuse their stream once this returns, the queue holds a pooled copy */
+	wStream* s = StreamPool_Take(transport->SendPool, length);
+	rdpTransportSendEntry* entry = calloc(1, sizeof(rdpTransportSendEntry));
+	if (!s || !entry)
+	{
+		if (s)
+			Stream_Release(s);
+		free(entry);
+		return -1;
+	}
+
+	for (size_t x = 0; x < count; x++)
+		Stream_Write(s, buffers[x].data, buffers[x].length);
+	Stream_SealLength(s);
+	entry->s = s;
+
+	(void)InterlockedExchangeAdd(&transport->writerQueuedBytes, (LONG)length);
+
+	rdpTransportSendEntry* head = NULL;
+	do
+	{
+		head = transport->writerQueue[priority];
+		entry->next = head;
+	} while (InterlockedCompareExchangePointer((PVOID volatile*)&transport->writerQueue[priority],
+	                                           entry, head) != head);
+
+	if (InterlockedIncrement(&transport->writerPending) == 1)
+		(void)SetEvent(transport->writerEvent);
+
+	return (int)length;
+}
+
+static int transport_default_write_vec_priority(rdpTransport* transport,
+                                                const rdpTransportBuffer* WINPR_RESTRICT buffers,
+                                                size_t count, TRANSPORT_PRIORITY priority)
+{
+	int status = -1;
+	size_t writtenlength = 0;
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(context);
+
+	if (!buffers && (count > 0))
+		return -1;
+
+	if (!context->rdp)
+		return -1;
+
+	for (size_t x = 0; x < count; x++)
+		writtenlength += buffers[x].length;
+
+	if (freerdp_settings_get_bool(context->settings, FreeRDP_AsyncTransport))
+	{
+		(void)InterlockedIncrement(&transport->writerProducers);
+		if (InterlockedCompareExchange(&transport->writerActive, 0, 0))
+		{
+			status = transport_writer_enqueue(transport, buffers, count, writtenlength, priority);
+			(void)InterlockedDecrement(&transport->writerProducers);
+			return status;
+		}
+		(void)InterlockedDecrement(&transport->writerProducers);
+	}
+
+	EnterCriticalSection(&(transport->WriteLock));
+	if (!transport->frontBio)
+		goto out_cleanup;
+
+	if (transport->coalesce && (writtenlength <= COALESCE_BUFFER_SIZE))
+		status = transport_coalesce(transport, buffers, count, writtenlength);
+	else
+	{
+		/* anything buffered goes first to keep the order of PDUs */
+		status = transport_flush_coalesced(transport);
+
+		for (size_t x = 0; (status >= 0) && (x < count); x++)
+			status = transport_write_buffer(transport, buffers[x].data, buffers[x].length);
+	}
+
+	if (status >= 0)
+	{
+		transport->written += writtenlength;
+
+		/* later PDUs go through the writer thread */
+		if (transport_writer_should_start(transport))
+			(void)transport_writer_start(transport);
+	}
 out_cleanup:
 
 	if (status < 0)
+		transport_write_failed(transport);
+
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status;
+}
+
+static int transport_default_write_vec(rdpTransport* transport,
+                                       const rdpTransportBuffer* WINPR_RESTRICT buffers,
+                                       size_t count)
+{
+	return transport_default_write_vec_priority(transport, buffers, count,
+	                                            TRANSPORT_PRIORITY_NORMAL);
+}
+
+static BOOL transport_flush_output(rdpTransport* transport, BOOL disableCoalescing)
+{
+	WINPR_ASSERT(transport);
+
+	int status = 0;
+	EnterCriticalSection(&(transport->WriteLock));
+	if (disableCoalescing)
+		transport->coalesce = FALSE;
+	if (transport->frontBio)
+		status = transport_flush_coalesced(transport);
+
+	if (status < 0)
+		transport_write_failed(transport);
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status >= 0;
+}
+
+BOOL transport_set_coalescing(rdpTransport* transport, BOOL enable)
+{
+	WINPR_ASSERT(transport);
+
+	if (enable)
 	{
-		/* A write error indicates that the peer has dropped the connection */
-		transport->layer = TRANSPORT_LAYER_CLOSED;
-		freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+		EnterCriticalSection(&(transport->WriteLock));
+		transport->coalesce = TRUE;
+		LeaveCriticalSection(&(transport->WriteLock));
+		return TRUE;
 	}
 
-	LeaveCriticalSection(&(transport->WriteLock));
-fail:
+	return transport_flush_output(transport, TRUE);
+}
+
+static int transport_default_write_priority(rdpTransport* transport, wStream* s,
+                                            TRANSPORT_PRIORITY priority)
+{
+	if (!s)
+		return -1;
+
+	Stream_AddRef(s);
+
+	const rdpTransportBuffer buffer = { Stream_Buffer(s), Stream_GetPosition(s) };
+	const int status = transport_default_write_vec_priority(transport, &buffer, 1, priority);
+	Stream_SetPosition(s, buffer.length);
+
 	Stream_Release(s);
 	return status;
 }
 
+static int transport_default_write(rdpTransport* transport, wStream* s)
+{
+	return transport_default_write_priority(transport, s, TRANSPORT_PRIORITY_NORMAL);
+}
+
+int transport_write_priority(rdpTransport* transport, wStream* s, TRANSPORT_PRIORITY priority)
+{
+	if (!transport)
+		return -1;
+
+	/* a custom WritePdu has no notion of priorities */
+	if (transport->io.WritePdu != transport_default_write)
+		return transport_write(transport, s);
+
+	return transport_default_write_priority(transport, s, priority);
+}
+
+int transport_write_vec(rdpTransport* transport, const rdpTransportBuffer* buffers, size_t count)
+{
+	if (!transport)
+		return -1;
+
+	/* a custom WritePdu without a matching WritePduVec must see every PDU */
+	if (transport->io.WritePduVec &&
+	    ((transport->io.WritePduVec != transport_default_write_vec) ||
+	     (transport->io.WritePdu == transport_default_write)))
+		return transport->io.WritePduVec(transport, buffers, count);
+
+	size_t length = 0;
+	for (size_t x = 0; x < count; x++)
+		length += buffers[x].length;
+
+	wStream* s = transport_send_stream_init(transport, length);
+	if (!s)
+		return -1;
+
+	for (size_t x = 0; x < count; x++)
+		Stream_Write(s, buffers[x].data, buffers[x].length);
+
+	const int status = transport_write(transport, s);
+	Stream_Free(s, TRUE);
+	return status;
+}
+
 BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data, DWORD* length)
 {
 	return IFCALLRESULT(FALSE, transport->io.GetPublicKey, transport, data, length);
@@ -1382,6 +1978,12 @@ void transport_get_fds(rdpTransport* transport, void** rfds, int* rcount)
 BOOL transport_is_write_blocked(rdpTransport* transport)
 {
 	WINPR_ASSERT(transport);
+
+	/* the writer thread owns the BIO while it runs */
+	if (InterlockedCompareExchange(&transport->writerActive, 0, 0))
+		return InterlockedCompareExchange(&transport->writerQueuedBytes, 0, 0) >
+		       WRITER_HIGH_WATERMARK;
+
 	WINPR_ASSERT(transport->frontBio);
 	return BIO_write_blocked(transport->frontBio) != 0;
 }
@@ -1391,6 +1993,10 @@ int transport_drain_output_buffer(rdpTransport* transport)
 	BOOL status = FALSE;
 
 	WINPR_ASSERT(transport);
+
+	if (InterlockedCompareExchange(&transport->writerActive, 0, 0))
+		return InterlockedCompareExchange(&transport->writerPending, 0, 0) > 0;
+
 	WINPR_ASSERT(transport->frontBio);
 	if (BIO_write_blocked(transport->frontBio))
 	{
@@ -1420,6 +2026,10 @@ int transport_check_fds(rdpTransport* transport)
 		return -1;
 	}
 
+	/* do not hold back coalesced output longer than one event loop iteration */
+	if (transport->coalesce && !transport_flush_output(transport, FALSE))
+		return -1;
+
 	/**
 	 * Note: transport_read_pdu tries to read one PDU from
 	 * the transport layer.
@@ -1428,46 +2038,55 @@ int transport_check_fds(rdpTransport* transport)
 	 * this point.
 	 * Note that transport->ReceiveBuffer is replaced after each iteration
 	 * of this loop with a fresh stream instance from a pool.
+	 * PDUs already received with an earlier read are dispatched right away, up to
+	 * READ_AHEAD_MAX_PDUS, before the event loop gets its turn again.
 	 */
-	if ((status = transport_read_pdu(transport, transport->ReceiveBuffer)) <= 0)
+	size_t dispatched = 0;
+	do
 	{
-		if (status < 0)
-			WLog_Print(transport->log, WLOG_DEBUG, "transport_check_fds: transport_read_pdu() - %i",
-			           status);
-		if (transport->haveMoreBytesToRead)
+		if ((status = transport_read_pdu(transport, transport->ReceiveBuffer)) <= 0)
 		{
-			transport->haveMoreBytesToRead = FALSE;
-			(void)ResetEvent(transport->rereadEvent);
+			if (status < 0)
+				WLog_Print(transport->log, WLOG_DEBUG,
+				           "transport_check_fds: transport_read_pdu() - %i", status);
+			if (transport->haveMoreBytesToRead)
+			{
+				transport->haveMoreBytesToRead = FALSE;
+				(void)ResetEvent(transport->rereadEvent);
+			}
+			return status;
 		}
-		return status;
-	}
 
-	received = transport->ReceiveBuffer;
-	transport->ReceiveBuffer = StreamPool_Take(transport->ReceivePool, 0);
-	if (!transport->ReceiveBuffer)
-	{
-		Stream_Release(received);
-		return -1;
-	}
+		received = transport->ReceiveBuffer;
+		transport->ReceiveBuffer = StreamPool_Take(transport->ReceivePool, 0);
+		if (!transport->ReceiveBuffer)
+		{
+			Stream_Release(received);
+			return -1;
+		}
 
-	/**
-	 * status:
-	 * 	-1: error
-	 * 	 0: success
-	 * 	 1: redirection
-	 */
-	WINPR_ASSERT(transport->ReceiveCallback);
-	recv_status = transport->ReceiveCallback(transport, received, transport->ReceiveExtra);
-	Stream_Release(received);
+		/**
+		 * status:
+		 * 	-1: error
+		 * 	 0: success
+		 * 	 1: redirection
+		 */
+		WINPR_ASSERT(transport->ReceiveCallback);
+		recv_status = transport->ReceiveCallback(transport, received, transport->ReceiveExtra);
+		Stream_Release(received);
 
-	if (state_run_failed(recv_status))
-	{
-		char buffer[64] = { 0 };
-		WLog_Print(transport->log, WLOG_ERROR,
-		           "transport_check_fds: transport->ReceiveCallback() - %s",
-		           state_run_result_string(recv_status, buffer, ARRAYSIZE(buffer)));
-		return -1;
-	}
+		if (state_run_failed(recv_status))
+		{
+			char buffer[64] = { 0 };
+			WLog_Print(transport->log, WLOG_ERROR,
+			           "transport_check_fds: transport->ReceiveCallback() - %s",
+			           state_run_result_string(recv_status, buffer, ARRAYSIZE(buffer)));
+			return -1;
+		}
+	} while ((recv_status == STATE_RUN_SUCCESS) && (++dispatched < READ_AHEAD_MAX_PDUS) &&
+	         (ringbuffer_used(&transport->readAhead) > 0) &&
+	         (transport->layer != TRANSPORT_LAYER_CLOSED) &&
+	         !freerdp_shall_disconnect_context(context));
 
 	/* Run this again to be sure we consumed all input data.
 	 * This will be repeated until a (not fully) received packet is in buffer
@@ -1594,6 +2213,9 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 	if (!transport)
 		return FALSE;
 
+	/* queued PDUs are sent before the layers go away */
+	transport_writer_stop(transport);
+
 	EnterCriticalSection(&(transport->ReadLock));
 	EnterCriticalSection(&(transport->WriteLock));
 	if (transport->tls)
@@ -1626,6 +2248,7 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 	}
 
 	transport->frontBio = NULL;
+	ringbuffer_commit_read_bytes(&transport->readAhead, ringbuffer_used(&transport->readAhead));
 	transport->layer = TRANSPORT_LAYER_TCP;
 	transport->earlyUserAuth = FALSE;
 	LeaveCriticalSection(&(transport->WriteLock));
@@ -1646,12 +2269,19 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!transport->log)
 		goto fail;
 
+	transport->packetSession = WLOG_PACKET_SESSION(InterlockedIncrement(&g_PacketSession));
+
 	transport->context = context;
 	transport->ReceivePool = StreamPool_New(TRUE, BUFFER_SIZE);
 
 	if (!transport->ReceivePool)
 		goto fail;
 
+	transport->SendPool = StreamPool_New(TRUE, BUFFER_SIZE);
+
+	if (!transport->SendPool)
+		goto fail;
+
 	/* receive buffer for non-blocking read. */
 	transport->ReceiveBuffer = StreamPool_Take(transport->ReceivePool, 0);
 
@@ -1673,6 +2303,19 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!transport->ioEvent || transport->ioEvent == INVALID_HANDLE_VALUE)
 		goto fail;
 
+	transport->writerEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!transport->writerEvent || transport->writerEvent == INVALID_HANDLE_VALUE)
+		goto fail;
+
+	transport->writerDrainedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!transport->writerDrainedEvent || transport->writerDrainedEvent == INVALID_HANDLE_VALUE)
+		goto fail;
+
+	if (!ringbuffer_init(&transport->readAhead, READ_AHEAD_SIZE))
+		goto fail;
+
 	transport->haveMoreBytesToRead = FALSE;
 	transport->blocking = TRUE;
 	transport->GatewayEnabled = FALSE;
@@ -1692,6 +2335,7 @@ rdpTransport* transport_new(rdpContext* context)
 	transport->io.TransportDisconnect = transport_default_disconnect;
 	transport->io.ReadPdu = transport_default_read_pdu;
 	transport->io.WritePdu = transport_default_write;
+	transport->io.WritePduVec = transport_default_write_vec;
 	transport->io.ReadBytes = transport_read_layer;
 	transport->io.GetPublicKey = transport_default_get_public_key;
 	transport->io.SetBlockingMode = transport_default_set_blocking_mode;
@@ -1713,6 +2357,7 @@ void transport_free(rdpTransport* transport)
 		return;
 
 	transport_disconnect(transport);
+	transport_writer_stop(transport);
 
 	EnterCriticalSection(&(transport->ReadLock));
 	if (transport->ReceiveBuffer)
@@ -1729,10 +2374,16 @@ void transport_free(rdpTransport* transport)
 	(void)CloseHandle(transport->connectedEvent);
 	(void)CloseHandle(transport->rereadEvent);
 	(void)CloseHandle(transport->ioEvent);
+	(void)CloseHandle(transport->writerEvent);
+	(void)CloseHandle(transport->writerDrainedEvent);
+	StreamPool_Free(transport->SendPool);
+	ringbuffer_destroy(&transport->readAhead);
 
 	LeaveCriticalSection(&(transport->ReadLock));
 	DeleteCriticalSection(&(transport->ReadLock));
 
+	Stream_Free(transport->coalesceBuffer, TRUE);
+
 	LeaveCriticalSection(&(transport->WriteLock));
 	DeleteCriticalSection(&(transport->WriteLock));
 	free(transport);
@@ -30,6 +30,19 @@ typedef enum
 	TRANSPORT_LAYER_CLOSED
 } TRANSPORT_LAYER;
 
+/** Send classes of the writer thread, a class is only written once all higher ones are empty.
+ *  PDUs of one class keep their order.
+ */
+typedef enum
+{
+	TRANSPORT_PRIORITY_HIGH, /* fast-path input while the connection is active */
+	/** Everything else, the default. Slow-path PDUs, fast-path updates and virtual channel data
+	 *  all carry protocol state (deactivation, reactivation, finalization, ...) and share this
+	 *  FIFO, so none of them overtakes another. */
+	TRANSPORT_PRIORITY_NORMAL,
+	TRANSPORT_PRIORITY_COUNT
+} TRANSPORT_PRIORITY;
+
 #include "tcp.h"
 #include "nla.h"
 #include "rdstls.h"
@@ -105,6 +118,24 @@ FREERDP_LOCAL BOOL transport_accept_rdstls(rdpTransport* transport);
 FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
 
+/** Like transport_write, the priority decides the send order while FreeRDP_AsyncTransport
+ *  has the writer thread running.
+ */
+FREERDP_LOCAL int transport_write_priority(rdpTransport* transport, wStream* s,
+                                           TRANSPORT_PRIORITY priority);
+
+/** Write a PDU given as a list of buffers, used to send headers and large payloads without
+ *  assembling them in one stream first
+ */
+FREERDP_LOCAL int transport_write_vec(rdpTransport* transport, const rdpTransportBuffer* buffers,
+                                      size_t count);
+
+/** Enable or disable output coalescing. While enabled small PDUs are collected and written
+ *  together (in one TLS record) once the buffer is full, a larger PDU is written, the event
+ *  loop runs or coalescing is disabled again.
+ */
+FREERDP_LOCAL BOOL transport_set_coalescing(rdpTransport* transport, BOOL enable);
+
 FREERDP_LOCAL BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data,
                                             DWORD* length);
 
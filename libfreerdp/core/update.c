@@ -1036,7 +1036,9 @@ static BOOL s_update_begin_paint(rdpContext* context)
 	update->combineUpdates = TRUE;
 	update->numberOrders = 0;
 	update->us = s;
-	return TRUE;
+
+	/* the updates until EndPaint are a burst, write small ones together */
+	return transport_set_coalescing(context->rdp->transport, TRUE);
 }
 
 static BOOL s_update_end_paint(rdpContext* context)
@@ -1065,7 +1067,7 @@ static BOOL s_update_end_paint(rdpContext* context)
 	update->offsetOrders = 0;
 	update->us = NULL;
 	Stream_Free(s, TRUE);
-	return TRUE;
+	return transport_set_coalescing(context->rdp->transport, FALSE);
 }
 
 static BOOL update_flush(rdpContext* context)
@@ -1361,37 +1363,66 @@ out:
 	return ret;
 }
 
-static BOOL update_send_surface_bits(rdpContext* context,
-                                     const SURFACE_BITS_COMMAND* surfaceBitsCommand)
+/* The bitmap data is sent from the buffer of the encoder, only the headers are written */
+static BOOL update_write_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cmd,
+                                      BOOL first, BOOL last, UINT32 frameId)
 {
-	wStream* s = NULL;
 	WINPR_ASSERT(context);
-	rdpRdp* rdp = context->rdp;
-	BOOL ret = FALSE;
+	WINPR_ASSERT(cmd);
 
-	WINPR_ASSERT(surfaceBitsCommand);
+	rdpRdp* rdp = context->rdp;
 	WINPR_ASSERT(rdp);
 
-	if (!update_force_flush(context))
-		return FALSE;
-	s = fastpath_update_pdu_init(rdp->fastpath);
+	BOOL ret = FALSE;
+	wStream sbuffer = { 0 };
+	BYTE marker[SURFCMD_FRAME_MARKER_LENGTH] = { 0 };
+	wStream* s = fastpath_update_pdu_init(rdp->fastpath);
 
 	if (!s)
 		return FALSE;
 
-	if (!update_write_surfcmd_surface_bits(s, surfaceBitsCommand))
-		goto out_fail;
+	if (first)
+	{
+		if (!update_write_surfcmd_frame_marker(s, SURFACECMD_FRAMEACTION_BEGIN, frameId))
+			goto out_fail;
+	}
 
-	if (!fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s,
-	                              surfaceBitsCommand->skipCompression))
+	if (!update_write_surfcmd_surface_bits_header(s, cmd))
 		goto out_fail;
 
-	ret = update_force_flush(context);
+	rdpTransportBuffer buffers[] = { { Stream_Buffer(s), Stream_GetPosition(s) },
+		                             { cmd->bmp.bitmapData, cmd->bmp.bitmapDataLength },
+		                             { marker, 0 } };
+
+	if (last)
+	{
+		wStream* ms = Stream_StaticInit(&sbuffer, marker, sizeof(marker));
+		if (!update_write_surfcmd_frame_marker(ms, SURFACECMD_FRAMEACTION_END, frameId))
+			goto out_fail;
+		buffers[2].length = Stream_GetPosition(ms);
+	}
+
+	ret = fastpath_send_update_pdu_vec(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, buffers,
+	                                   ARRAYSIZE(buffers), cmd->skipCompression);
 out_fail:
 	Stream_Release(s);
 	return ret;
 }
 
+static BOOL update_send_surface_bits(rdpContext* context,
+                                     const SURFACE_BITS_COMMAND* surfaceBitsCommand)
+{
+	WINPR_ASSERT(surfaceBitsCommand);
+
+	if (!update_force_flush(context))
+		return FALSE;
+
+	if (!update_write_surface_bits(context, surfaceBitsCommand, FALSE, FALSE, 0))
+		return FALSE;
+
+	return update_force_flush(context);
+}
+
 static BOOL update_send_surface_frame_marker(rdpContext* context,
                                              const SURFACE_FRAME_MARKER* surfaceFrameMarker)
 {
@@ -1415,6 +1446,11 @@ static BOOL update_send_surface_frame_marker(rdpContext* context,
 		goto out_fail;
 
 	ret = update_force_flush(context);
+
+	/* coalesce the small updates of a frame, the end marker flushes them */
+	if (ret)
+		ret = transport_set_coalescing(
+		    rdp->transport, surfaceFrameMarker->frameAction == SURFACECMD_FRAMEACTION_BEGIN);
 out_fail:
 	Stream_Release(s);
 	return ret;
@@ -1423,45 +1459,13 @@ out_fail:
 static BOOL update_send_surface_frame_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cmd,
                                            BOOL first, BOOL last, UINT32 frameId)
 {
-	wStream* s = NULL;
-
-	WINPR_ASSERT(context);
-	rdpRdp* rdp = context->rdp;
-	BOOL ret = FALSE;
-
 	if (!update_force_flush(context))
 		return FALSE;
 
-	WINPR_ASSERT(rdp);
-	s = fastpath_update_pdu_init(rdp->fastpath);
-
-	if (!s)
+	if (!update_write_surface_bits(context, cmd, first, last, frameId))
 		return FALSE;
 
-	if (first)
-	{
-		if (!update_write_surfcmd_frame_marker(s, SURFACECMD_FRAMEACTION_BEGIN, frameId))
-			goto out_fail;
-	}
-
-	if (!update_write_surfcmd_surface_bits(s, cmd))
-		goto out_fail;
-
-	if (last)
-	{
-		if (!update_write_surfcmd_frame_marker(s, SURFACECMD_FRAMEACTION_END, frameId))
-			goto out_fail;
-	}
-
-	ret = fastpath_send_update_pdu(rdp->fastpath, FASTPATH_UPDATETYPE_SURFCMDS, s,
-	                               cmd->skipCompression);
-	if (!ret)
-		goto out_fail;
-
-	ret = update_force_flush(context);
-out_fail:
-	Stream_Release(s);
-	return ret;
+	return update_force_flush(context);
 }
 
 static BOOL update_send_frame_acknowledge(rdpContext* context, UINT32 frameId)
@@ -2187,6 +2191,35 @@ static BOOL update_send_switch_surface_order(rdpContext* context,
 	return TRUE;
 }
 
+static BOOL update_send_fastpath_update(rdpContext* context, BYTE updateCode, wStream* s,
+                                        BOOL* handled)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(s);
+	rdpRdp* rdp = context->rdp;
+	WINPR_ASSERT(rdp);
+
+	wStream* out = fastpath_update_pdu_init(rdp->fastpath);
+
+	if (!out)
+		return FALSE;
+
+	const size_t length = Stream_GetRemainingLength(s);
+	BOOL ret = Stream_EnsureRemainingCapacity(out, length);
+
+	if (ret)
+	{
+		Stream_Write(out, Stream_ConstPointer(s), length);
+		ret = fastpath_send_update_pdu(rdp->fastpath, updateCode, out, FALSE);
+	}
+
+	Stream_Release(out);
+
+	if (ret && handled)
+		*handled = TRUE;
+	return ret;
+}
+
 static BOOL update_send_pointer_system(rdpContext* context,
                                        const POINTER_SYSTEM_UPDATE* pointer_system)
 {
@@ -3239,6 +3272,7 @@ void update_register_server_callbacks(rdpUpdate* update)
 	update->SetKeyboardImeStatus = update_send_set_keyboard_ime_status;
 	update->SaveSessionInfo = rdp_send_save_session_info;
 	update->ServerStatusInfo = rdp_send_server_status_info;
+	update->FastPathUpdate = update_send_fastpath_update;
 	update->primary->DstBlt = update_send_dstblt;
 	update->primary->PatBlt = update_send_patblt;
 	update->primary->ScrBlt = update_send_scrblt;
@@ -3407,6 +3441,7 @@ void update_free(rdpUpdate* update)
 			free(update->window);
 
 		MessageQueue_Free(up->queue);
+		update_message_arena_free(up->arena);
 		DeleteCriticalSection(&up->mux);
 
 		if (up->us)
@@ -3468,6 +3503,9 @@ BOOL update_end_paint(rdpUpdate* update)
 	if (!rc)
 		WLog_WARN(TAG, "EndPaint call failed");
 
+	if (update->context)
+		winpr_Arena_Reset(update->context->frameArena);
+
 	rdp_update_internal* up = update_cast(update);
 
 	if (!up->withinBeginEndPaint)
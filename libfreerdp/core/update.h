@@ -56,6 +56,7 @@ typedef struct
 	BOOL asynchronous;
 	rdpUpdateProxy* proxy;
 	wMessageQueue* queue;
+	struct rdp_update_arena* arena;
 
 	wStream* us;
 	UINT16 numberOrders;
@@ -1163,7 +1163,12 @@ BOOL cert_clone_int(rdpCertificate* dst, const rdpCertificate* src)
 
 	if (src->x509)
 	{
-		dst->x509 = X509_dup(src->x509);
+		/* The X509 is never modified once set, update_x509_from_info replaces it.
+		 * Share it instead of paying for a DER round trip in every clone. */
+		if (X509_up_ref(src->x509) == 1)
+			dst->x509 = src->x509;
+		else
+			dst->x509 = X509_dup(src->x509);
 		if (!dst->x509)
 		{
 			/* Workaround for SSL deprecation issues:
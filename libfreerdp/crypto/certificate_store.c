@@ -32,6 +32,12 @@
 #include <winpr/crt.h>
 #include <winpr/file.h>
 #include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
 
 #include <freerdp/settings.h>
 
@@ -48,6 +54,184 @@ struct rdp_certificate_store
 static const char certificate_store_dir[] = "certs";
 static const char certificate_server_dir[] = "server";
 
+/* Parsed known host certificates, shared by all stores of the process and keyed by file path.
+ * An entry is only used as long as the file on disk did not change since it was loaded. */
+#define CERTIFICATE_STORE_CACHE_MAX_ENTRIES 4096
+
+typedef struct
+{
+	UINT64 size;
+	UINT64 mtime;
+	UINT64 mtimeNsec;
+	UINT64 inode;
+} certificate_file_stamp;
+
+typedef struct
+{
+	certificate_file_stamp stamp;
+	rdpCertificateData* data;
+} certificate_cache_entry;
+
+static INIT_ONCE certificate_cache_once = INIT_ONCE_STATIC_INIT;
+static wHashTable* certificate_cache = NULL;
+
+static void certificate_cache_entry_free(void* ptr)
+{
+	certificate_cache_entry* entry = ptr;
+	if (!entry)
+		return;
+	freerdp_certificate_data_free(entry->data);
+	free(entry);
+}
+
+static BOOL CALLBACK certificate_cache_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                            WINPR_ATTR_UNUSED PVOID param,
+                                            WINPR_ATTR_UNUSED PVOID* context)
+{
+	/* Without the cache every lookup reads the file, so failure here is not fatal */
+	certificate_cache = HashTable_New(TRUE);
+	if (!certificate_cache)
+		return TRUE;
+
+	if (!HashTable_SetupForStringData(certificate_cache, FALSE))
+		goto fail;
+
+	wObject* obj = HashTable_ValueObject(certificate_cache);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = certificate_cache_entry_free;
+	return TRUE;
+
+fail:
+	HashTable_Free(certificate_cache);
+	certificate_cache = NULL;
+	return TRUE;
+}
+
+static wHashTable* certificate_cache_get(void)
+{
+	InitOnceExecuteOnce(&certificate_cache_once, certificate_cache_init, NULL, NULL);
+	return certificate_cache;
+}
+
+static BOOL certificate_file_get_stamp(const char* path, certificate_file_stamp* stamp)
+{
+	WINPR_ASSERT(path);
+	WINPR_ASSERT(stamp);
+
+	*stamp = (certificate_file_stamp){ 0 };
+#if defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA attr = { 0 };
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attr))
+		return FALSE;
+
+	stamp->size = (((UINT64)attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+	stamp->mtime = (((UINT64)attr.ftLastWriteTime.dwHighDateTime) << 32) |
+	               attr.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st = { 0 };
+	if (stat(path, &st) != 0)
+		return FALSE;
+
+	stamp->size = (UINT64)st.st_size;
+	stamp->mtime = (UINT64)st.st_mtime;
+	stamp->inode = (UINT64)st.st_ino;
+#if defined(__APPLE__)
+	stamp->mtimeNsec = (UINT64)st.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	stamp->mtimeNsec = (UINT64)st.st_mtim.tv_nsec;
+#endif
+#endif
+	return TRUE;
+}
+
+static BOOL certificate_file_stamp_equal(const certificate_file_stamp* a,
+                                         const certificate_file_stamp* b)
+{
+	WINPR_ASSERT(a);
+	WINPR_ASSERT(b);
+	return (a->size == b->size) && (a->mtime == b->mtime) && (a->mtimeNsec == b->mtimeNsec) &&
+	       (a->inode == b->inode);
+}
+
+static void certificate_cache_remove(const char* path)
+{
+	wHashTable* cache = certificate_cache_get();
+	if (cache)
+		HashTable_Remove(cache, path);
+}
+
+/* Takes ownership of data */
+static void certificate_cache_insert(const char* path, const certificate_file_stamp* stamp,
+                                     rdpCertificateData* data)
+{
+	wHashTable* cache = certificate_cache_get();
+	certificate_cache_entry* entry = NULL;
+
+	if (!cache)
+		goto fail;
+
+	entry = calloc(1, sizeof(certificate_cache_entry));
+	if (!entry)
+		goto fail;
+	entry->stamp = *stamp;
+	entry->data = data;
+
+	HashTable_Lock(cache);
+	if (HashTable_Count(cache) >= CERTIFICATE_STORE_CACHE_MAX_ENTRIES)
+		HashTable_Clear(cache);
+	const BOOL rc = HashTable_Insert(cache, path, entry);
+	HashTable_Unlock(cache);
+	if (rc)
+		return;
+
+fail:
+	certificate_cache_entry_free(entry);
+	if (!entry)
+		freerdp_certificate_data_free(data);
+}
+
+/**
+ * Looks up the certificate stored at \b path and passes it to \b fn while the cache is locked.
+ * The file is only read and parsed if it is not cached yet or changed since it was cached.
+ */
+static BOOL certificate_cache_lookup(const char* path, const char* host, UINT16 port,
+                                     BOOL (*fn)(const rdpCertificateData* data, void* arg),
+                                     void* arg)
+{
+	certificate_file_stamp stamp = { 0 };
+
+	WINPR_ASSERT(path);
+	WINPR_ASSERT(fn);
+
+	if (!certificate_file_get_stamp(path, &stamp))
+	{
+		certificate_cache_remove(path);
+		return FALSE;
+	}
+
+	wHashTable* cache = certificate_cache_get();
+	if (cache)
+	{
+		HashTable_Lock(cache);
+		const certificate_cache_entry* entry = HashTable_GetItemValue(cache, path);
+		if (entry && certificate_file_stamp_equal(&entry->stamp, &stamp))
+		{
+			const BOOL rc = fn(entry->data, arg);
+			HashTable_Unlock(cache);
+			return rc;
+		}
+		HashTable_Unlock(cache);
+	}
+
+	rdpCertificateData* data = freerdp_certificate_data_new_from_file(host, port, path);
+	if (!data)
+		return FALSE;
+
+	const BOOL rc = fn(data, arg);
+	certificate_cache_insert(path, &stamp, data);
+	return rc;
+}
+
 static char* freerdp_certificate_store_file_path(const rdpCertificateStore* store, const char* hash)
 {
 	const char* hosts = freerdp_certificate_store_get_hosts_path(store);
@@ -58,22 +242,53 @@ static char* freerdp_certificate_store_file_path(const rdpCertificateStore* stor
 	return GetCombinedPath(hosts, hash);
 }
 
+typedef struct
+{
+	const rdpCertificateData* data;
+	BOOL equal;
+} certificate_store_compare_arg;
+
+static BOOL certificate_store_compare(const rdpCertificateData* data, void* arg)
+{
+	certificate_store_compare_arg* cmp = arg;
+	WINPR_ASSERT(cmp);
+
+	cmp->equal = freerdp_certificate_data_equal(cmp->data, data);
+	return TRUE;
+}
+
+static BOOL certificate_store_copy(const rdpCertificateData* data, void* arg)
+{
+	rdpCertificateData** copy = arg;
+	WINPR_ASSERT(copy);
+
+	const char* pem = freerdp_certificate_data_get_pem_ex(data, TRUE);
+	if (!pem)
+		return FALSE;
+	*copy = freerdp_certificate_data_new_from_pem(freerdp_certificate_data_get_host(data),
+	                                              freerdp_certificate_data_get_port(data), pem,
+	                                              strlen(pem));
+	return *copy != NULL;
+}
+
 freerdp_certificate_store_result
 freerdp_certificate_store_contains_data(rdpCertificateStore* store, const rdpCertificateData* data)
 {
-	freerdp_certificate_store_result rc = CERT_STORE_NOT_FOUND;
+	certificate_store_compare_arg cmp = { .data = data, .equal = FALSE };
 	const char* host = freerdp_certificate_data_get_host(data);
 	const UINT16 port = freerdp_certificate_data_get_port(data);
 
-	rdpCertificateData* loaded = freerdp_certificate_store_load_data(store, host, port);
-	if (!loaded)
-		goto fail;
+	WINPR_ASSERT(store);
 
-	rc = freerdp_certificate_data_equal(data, loaded) ? CERT_STORE_MATCH : CERT_STORE_MISMATCH;
+	char* path = freerdp_certificate_store_get_cert_path(store, host, port);
+	if (!path)
+		return CERT_STORE_NOT_FOUND;
 
-fail:
-	freerdp_certificate_data_free(loaded);
-	return rc;
+	const BOOL found = certificate_cache_lookup(path, host, port, certificate_store_compare, &cmp);
+	free(path);
+	if (!found)
+		return CERT_STORE_NOT_FOUND;
+	return cmp.equal ? CERT_STORE_MATCH : CERT_STORE_MISMATCH;
 }
 
 BOOL freerdp_certificate_store_remove_data(rdpCertificateStore* store,
@@ -91,6 +306,7 @@ BOOL freerdp_certificate_store_remove_data(rdpCertificateStore* store,
 	if (!path)
 		return FALSE;
 
+	certificate_cache_remove(path);
 	if (winpr_PathFileExists(path))
 		rc = winpr_DeleteFile(path);
 	free(path);
@@ -116,6 +332,24 @@ BOOL freerdp_certificate_store_save_data(rdpCertificateStore* store, const rdpCe
 		goto fail;
 
 	(void)fprintf(fp, "%s", freerdp_certificate_data_get_pem_ex(data, FALSE));
+	(void)fclose(fp);
+	fp = NULL;
+
+	/* the next verification of this host should not need to read back what was just written */
+	certificate_file_stamp stamp = { 0 };
+	const char* pem = freerdp_certificate_data_get_pem_ex(data, FALSE);
+	rdpCertificateData* copy =
+	    pem ? freerdp_certificate_data_new_from_pem(freerdp_certificate_data_get_host(data),
+	                                                freerdp_certificate_data_get_port(data), pem,
+	                                                strlen(pem))
+	        : NULL;
+	if (copy && certificate_file_get_stamp(path, &stamp))
+		certificate_cache_insert(path, &stamp, copy);
+	else
+	{
+		freerdp_certificate_data_free(copy);
+		certificate_cache_remove(path);
+	}
 
 	rc = TRUE;
 fail:
@@ -137,7 +371,8 @@ rdpCertificateData* freerdp_certificate_store_load_data(rdpCertificateStore* sto
 	if (!path)
 		goto fail;
 
-	data = freerdp_certificate_data_new_from_file(host, port, path);
+	if (!certificate_cache_lookup(path, host, port, certificate_store_copy, &data))
+		goto fail;
 
 fail:
 	free(path);
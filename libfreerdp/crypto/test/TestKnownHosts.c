@@ -258,6 +258,9 @@ static BOOL test_certs_dir(void)
 	rdpCertificateData* data2 = NULL;
 	rdpCertificateData* data3 = NULL;
 	rdpCertificateData* data4 = NULL;
+	rdpCertificateData* data5 = NULL;
+	char* path = NULL;
+	FILE* fp = NULL;
 
 	printf("%s\n", __func__);
 	if (!setup_config(&settings))
@@ -274,7 +277,8 @@ static BOOL test_certs_dir(void)
 		data2 = freerdp_certificate_data_new_from_pem("otherhost", 4321, pem2, strlen(pem2));
 		data3 = freerdp_certificate_data_new_from_pem("otherhost4", 444, pem3, strlen(pem3));
 		data4 = freerdp_certificate_data_new_from_pem("otherhost", 4321, pem4, strlen(pem4));
-		if (!data1 || !data2 || !data3 || !data4)
+		data5 = freerdp_certificate_data_new_from_pem("somehost", 1234, pem2, strlen(pem2));
+		if (!data1 || !data2 || !data3 || !data4 || !data5)
 			goto fail;
 
 		/* Find non existing in empty store */
@@ -369,6 +373,24 @@ static BOOL test_certs_dir(void)
 			goto fail;
 		if (test_get_data_ex(store, data3))
 			goto fail;
+
+		/* Replace a loaded entry behind the back of the store */
+		printf("freerdp_certificate_store_load_data on externally modified value\n");
+		if (freerdp_certificate_store_contains_data(store, data1) != CERT_STORE_MATCH)
+			goto fail;
+		path = freerdp_certificate_store_get_cert_path(store, "somehost", 1234);
+		if (!path)
+			goto fail;
+		fp = winpr_fopen(path, "w");
+		if (!fp)
+			goto fail;
+		(void)fprintf(fp, "%s", pem2);
+		(void)fclose(fp);
+		fp = NULL;
+		if (!test_get_data_ex(store, data5))
+			goto fail;
+		if (freerdp_certificate_store_contains_data(store, data1) != CERT_STORE_MISMATCH)
+			goto fail;
 	}
 
 	rc = TRUE;
@@ -378,6 +400,10 @@ fail:
 	freerdp_certificate_data_free(data2);
 	freerdp_certificate_data_free(data3);
 	freerdp_certificate_data_free(data4);
+	freerdp_certificate_data_free(data5);
+	if (fp)
+		(void)fclose(fp);
+	free(path);
 	freerdp_certificate_store_free(store);
 	freerdp_settings_free(settings);
 	return rc;
@@ -33,12 +33,18 @@
 #include <winpr/sspi.h>
 #include <winpr/ssl.h>
 #include <winpr/json.h>
+#include <winpr/collections.h>
+#include <winpr/crypto.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/thread.h>
 
 #include <winpr/stream.h>
 #include <freerdp/utils/ringbuffer.h>
 
 #include <freerdp/crypto/certificate.h>
 #include <freerdp/crypto/certificate_data.h>
+#include <freerdp/crypto/crypto.h>
 #include <freerdp/utils/helpers.h>
 
 #include <freerdp/log.h>
@@ -53,6 +59,13 @@
 #include <poll.h>
 #endif
 
+#if defined(_WIN32)
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#endif
+
 #ifdef FREERDP_HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
@@ -97,6 +110,9 @@ static void tls_print_new_certificate_warn(rdpCertificateStore* store, const cha
 static void tls_print_certificate_error(rdpCertificateStore* store, rdpCertificateData* stored_data,
                                         const char* hostname, UINT16 port, const char* fingerprint);
 
+static char* tls_config_read(const char* configfile);
+static const char* tls_get_server_name(rdpTls* tls);
+
 static void free_tls_public_key(rdpTls* tls)
 {
 	WINPR_ASSERT(tls);
@@ -738,10 +754,404 @@ static void SSLCTX_keylog_cb(const SSL* ssl, const char* line)
 	}
 }
 
+/* clients resume TLS sessions of earlier connections to the same host and port */
+#define TLS_SESSION_CACHE_MAX 64
+
+static INIT_ONCE tls_session_cache_once = INIT_ONCE_STATIC_INIT;
+static wHashTable* tls_session_cache = NULL;
+static int tls_session_idx = -1;
+
+/* servers share one ticket key per process, every connection has its own SSL_CTX */
+static BYTE tls_ticket_keys[80] = { 0 };
+
+static void tls_session_free(void* obj)
+{
+	SSL_SESSION_free(obj);
+}
+
+static BOOL CALLBACK tls_session_cache_init_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                               WINPR_ATTR_UNUSED PVOID param,
+                                               WINPR_ATTR_UNUSED PVOID* context)
+{
+	tls_session_idx = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+	if (tls_session_idx == -1)
+		return FALSE;
+
+	if (winpr_RAND(tls_ticket_keys, sizeof(tls_ticket_keys)) < 0)
+		return FALSE;
+
+	tls_session_cache = HashTable_New(TRUE);
+	if (!tls_session_cache)
+		return FALSE;
+
+	if (!HashTable_SetupForStringData(tls_session_cache, FALSE))
+		goto fail;
+
+	wObject* obj = HashTable_ValueObject(tls_session_cache);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = tls_session_free;
+	return TRUE;
+
+fail:
+	HashTable_Free(tls_session_cache);
+	tls_session_cache = NULL;
+	return FALSE;
+}
+
+static BOOL tls_session_usable(const SSL_SESSION* session)
+{
+	if (!session)
+		return FALSE;
+
+	const long expires = SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+	if (expires < time(NULL))
+		return FALSE;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+	return SSL_SESSION_is_resumable(session) == 1;
+#else
+	return TRUE;
+#endif
+}
+
+static char* tls_session_cache_key(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+
+	const char* name = tls_get_server_name(tls);
+	if (!name)
+		return NULL;
+
+	char* key = NULL;
+	size_t len = 0;
+	(void)winpr_asprintf(&key, &len, "%s:%d", name, tls->port);
+	return key;
+}
+
+static SSL_SESSION* tls_session_decode(const char* b64, size_t length)
+{
+	BYTE* der = NULL;
+	size_t derlen = 0;
+	crypto_base64_decode(b64, length, &der, &derlen);
+	if (!der || (derlen > INT32_MAX))
+	{
+		free(der);
+		return NULL;
+	}
+
+	const unsigned char* ptr = der;
+	SSL_SESSION* session = d2i_SSL_SESSION(NULL, &ptr, (long)derlen);
+	free(der);
+	return session;
+}
+
+static char* tls_session_encode(const SSL_SESSION* session)
+{
+	const int derlen = i2d_SSL_SESSION(WINPR_CAST_CONST_PTR_AWAY(session, SSL_SESSION*), NULL);
+	if (derlen <= 0)
+		return NULL;
+
+	BYTE* der = malloc((size_t)derlen);
+	if (!der)
+		return NULL;
+
+	unsigned char* ptr = der;
+	char* b64 = NULL;
+	if (i2d_SSL_SESSION(WINPR_CAST_CONST_PTR_AWAY(session, SSL_SESSION*), &ptr) == derlen)
+		b64 = crypto_base64_encode(der, (size_t)derlen);
+	free(der);
+	return b64;
+}
+
+/**
+ * The cache file holds one "<host>:<port> <base64 DER session>" line per server.
+ * Sessions contain the keys of the connection, the file is only readable by its owner.
+ */
+static SSL_SESSION* tls_session_file_lookup(const char* file, const char* key)
+{
+	SSL_SESSION* session = NULL;
+	char* data = tls_config_read(file);
+	if (!data)
+		return NULL;
+
+	const size_t keylen = strlen(key);
+	char* context = NULL;
+	char* line = strtok_s(data, "\n", &context);
+	while (line && !session)
+	{
+		if ((strncmp(line, key, keylen) == 0) && (line[keylen] == ' '))
+		{
+			const char* b64 = &line[keylen + 1];
+			session = tls_session_decode(b64, strlen(b64));
+			if (!tls_session_usable(session))
+			{
+				SSL_SESSION_free(session);
+				session = NULL;
+			}
+		}
+		line = strtok_s(NULL, "\n", &context);
+	}
+
+	free(data);
+	return session;
+}
+
+/* Creates a new file only readable by its owner, never an existing file or symlink target */
+static FILE* tls_session_file_create(const char* path)
+{
+#if defined(_WIN32)
+	const int fd = _open(path, _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE);
+	if (fd < 0)
+		return NULL;
+
+	FILE* fp = _fdopen(fd, "w");
+	if (!fp)
+		(void)_close(fd);
+#else
+	const int fd = open(path, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return NULL;
+
+	FILE* fp = fdopen(fd, "w");
+	if (!fp)
+		(void)close(fd);
+#endif
+	return fp;
+}
+
+/* The cache is written to a temporary file that replaces it, a reader always sees a complete
+ * file and concurrent writers do not interleave. */
+static void tls_session_file_update(const char* file, const char* key, const SSL_SESSION* session)
+{
+	UINT32 nonce = 0;
+	char* tmp = NULL;
+	size_t tmplen = 0;
+
+	winpr_RAND(&nonce, sizeof(nonce));
+	(void)winpr_asprintf(&tmp, &tmplen, "%s.%08" PRIx32 "%08" PRIx32 ".tmp", file,
+	                     GetCurrentProcessId(), nonce);
+	FILE* fp = tmp ? tls_session_file_create(tmp) : NULL;
+	if (!fp)
+	{
+		WLog_WARN(TAG, "failed to write the TLS session cache file %s", file);
+		free(tmp);
+		return;
+	}
+
+	char* data = tls_config_read(file);
+	size_t count = 0;
+	const size_t keylen = strlen(key);
+	char* context = NULL;
+	char* line = data ? strtok_s(data, "\n", &context) : NULL;
+	for (; line && (count < TLS_SESSION_CACHE_MAX - 1); line = strtok_s(NULL, "\n", &context))
+	{
+		const char* sep = strchr(line, ' ');
+		if (!sep || (((size_t)(sep - line) == keylen) && (strncmp(line, key, keylen) == 0)))
+			continue;
+
+		/* drop expired entries so the file does not grow forever */
+		SSL_SESSION* cur = tls_session_decode(sep + 1, strlen(sep + 1));
+		const BOOL usable = tls_session_usable(cur);
+		SSL_SESSION_free(cur);
+		if (!usable)
+			continue;
+
+		(void)fprintf(fp, "%s\n", line);
+		count++;
+	}
+
+	char* b64 = session ? tls_session_encode(session) : NULL;
+	if (b64)
+		(void)fprintf(fp, "%s %s\n", key, b64);
+	free(b64);
+	free(data);
+
+	const BOOL written = (ferror(fp) == 0);
+	if ((fclose(fp) != 0) || !written ||
+	    !winpr_MoveFileEx(tmp, file, MOVEFILE_REPLACE_EXISTING))
+	{
+		WLog_WARN(TAG, "failed to write the TLS session cache file %s", file);
+		(void)winpr_DeleteFile(tmp);
+	}
+	free(tmp);
+}
+
+static void tls_session_cache_put(rdpTls* tls, SSL_SESSION* session)
+{
+	WINPR_ASSERT(tls);
+	WINPR_ASSERT(session);
+
+	if (!tls_session_cache || !tls_session_usable(session))
+		return;
+
+	char* key = tls_session_cache_key(tls);
+	if (!key)
+		return;
+
+	HashTable_Lock(tls_session_cache);
+	if ((HashTable_Count(tls_session_cache) >= TLS_SESSION_CACHE_MAX) &&
+	    !HashTable_Contains(tls_session_cache, key))
+		HashTable_Clear(tls_session_cache);
+
+	if (SSL_SESSION_up_ref(session) == 1)
+	{
+		if (!HashTable_Insert(tls_session_cache, key, session))
+			SSL_SESSION_free(session);
+	}
+
+	const char* file =
+	    freerdp_settings_get_string(tls->context->settings, FreeRDP_TlsSessionCacheFile);
+	if (file)
+		tls_session_file_update(file, key, session);
+	HashTable_Unlock(tls_session_cache);
+
+	WLog_DBG(TAG, "stored TLS session for %s", key);
+	free(key);
+}
+
+static void tls_session_cache_remove(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+
+	if (!tls_session_cache)
+		return;
+
+	char* key = tls_session_cache_key(tls);
+	if (!key)
+		return;
+
+	HashTable_Lock(tls_session_cache);
+	HashTable_Remove(tls_session_cache, key);
+	const char* file =
+	    freerdp_settings_get_string(tls->context->settings, FreeRDP_TlsSessionCacheFile);
+	if (file)
+		tls_session_file_update(file, key, NULL);
+	HashTable_Unlock(tls_session_cache);
+	free(key);
+}
+
+/* TLS 1.3 tickets arrive after the handshake, TLS 1.2 ones before the certificate is checked */
+static int tls_session_new_cb(SSL* ssl, SSL_SESSION* session)
+{
+	rdpTls* tls = SSL_get_ex_data(ssl, tls_session_idx);
+	if (!tls)
+		return 0;
+
+	if (!tls->sessionVerified)
+	{
+		SSL_SESSION_free(tls->pendingSession);
+		tls->pendingSession = session;
+		return 1;
+	}
+
+	tls_session_cache_put(tls, session);
+	return 0;
+}
+
+static void tls_session_verified(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+
+	tls->sessionVerified = TRUE;
+	if (tls->pendingSession)
+	{
+		tls_session_cache_put(tls, tls->pendingSession);
+		SSL_SESSION_free(tls->pendingSession);
+		tls->pendingSession = NULL;
+	}
+}
+
+static void tls_session_resume(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+
+	if (!tls_session_cache ||
+	    !freerdp_settings_get_bool(tls->context->settings, FreeRDP_TlsSessionResumption))
+		return;
+
+	char* key = tls_session_cache_key(tls);
+	if (!key)
+		return;
+
+	HashTable_Lock(tls_session_cache);
+	SSL_SESSION* session = HashTable_GetItemValue(tls_session_cache, key);
+	if (session && !tls_session_usable(session))
+	{
+		HashTable_Remove(tls_session_cache, key);
+		session = NULL;
+	}
+
+	if (session)
+		(void)SSL_SESSION_up_ref(session);
+	else
+	{
+		const char* file =
+		    freerdp_settings_get_string(tls->context->settings, FreeRDP_TlsSessionCacheFile);
+		if (file)
+			session = tls_session_file_lookup(file, key);
+		if (session && (SSL_SESSION_up_ref(session) == 1) &&
+		    !HashTable_Insert(tls_session_cache, key, session))
+			SSL_SESSION_free(session);
+	}
+	HashTable_Unlock(tls_session_cache);
+
+	if (session)
+	{
+		if (SSL_set_session(tls->ssl, session) != 1)
+			WLog_DBG(TAG, "cached TLS session for %s not applicable", key);
+		SSL_SESSION_free(session);
+	}
+
+	free(key);
+}
+
+static void tls_prepare_resumption(rdpTls* tls, BOOL clientMode)
+{
+	WINPR_ASSERT(tls);
+
+	rdpSettings* settings = tls->context->settings;
+	WINPR_ASSERT(settings);
+
+	const BOOL enabled = freerdp_settings_get_bool(settings, FreeRDP_TlsSessionResumption);
+	if (enabled &&
+	    !InitOnceExecuteOnce(&tls_session_cache_once, tls_session_cache_init_cb, NULL, NULL))
+		WLog_WARN(TAG, "TLS session cache not available");
+
+	if (!enabled || !tls_session_cache)
+	{
+		SSL_CTX_set_session_cache_mode(tls->ctx, SSL_SESS_CACHE_OFF);
+		SSL_CTX_set_options(tls->ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+		if (!clientMode)
+			(void)SSL_CTX_set_num_tickets(tls->ctx, 0);
+#endif
+		return;
+	}
+
+	if (clientMode)
+	{
+		SSL_CTX_set_session_cache_mode(tls->ctx,
+		                               SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(tls->ctx, tls_session_new_cb);
+		return;
+	}
+
+#if defined(SSL_CTRL_SET_TLSEXT_TICKET_KEYS)
+	const long keylen = SSL_CTX_get_tlsext_ticket_keys(tls->ctx, NULL, 0);
+	if ((keylen <= 0) || ((size_t)keylen > sizeof(tls_ticket_keys)) ||
+	    (SSL_CTX_set_tlsext_ticket_keys(tls->ctx, tls_ticket_keys, keylen) != 1))
+		WLog_WARN(TAG, "failed to set the TLS session ticket keys");
+#endif
+}
+
 static void tls_reset(rdpTls* tls)
 {
 	WINPR_ASSERT(tls);
 
+	SSL_SESSION_free(tls->pendingSession);
+	tls->pendingSession = NULL;
+	tls->sessionVerified = FALSE;
+
 	if (tls->ctx)
 	{
 		SSL_CTX_free(tls->ctx);
@@ -761,6 +1171,16 @@ static void tls_reset(rdpTls* tls)
 	free_tls_bindings(tls);
 }
 
+/* kernel TLS needs the records to go straight to the TCP socket, not through a gateway tunnel */
+static BOOL tls_is_socket_bio(BIO* underlying)
+{
+	if (!underlying || (BIO_method_type(underlying) != BIO_TYPE_BUFFERED))
+		return FALSE;
+
+	BIO* next = BIO_next(underlying);
+	return next && (BIO_method_type(next) == BIO_TYPE_SIMPLE);
+}
+
 #if OPENSSL_VERSION_NUMBER >= 0x010000000L
 static BOOL tls_prepare(rdpTls* tls, BIO* underlying, const SSL_METHOD* method, int options,
                         BOOL clientMode)
@@ -788,6 +1208,21 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 	SSL_CTX_set_mode(tls->ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE);
 	SSL_CTX_set_options(tls->ctx, WINPR_ASSERTING_INT_CAST(uint64_t, options));
 	SSL_CTX_set_read_ahead(tls->ctx, 1);
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_TlsKernelOffload))
+	{
+		if (tls_is_socket_bio(underlying))
+		{
+#if defined(SSL_OP_ENABLE_KTLS)
+			SSL_CTX_set_options(tls->ctx, SSL_OP_ENABLE_KTLS);
+#else
+			WLog_WARN(TAG, "kernel TLS offload requires OpenSSL 3.0 or higher");
+#endif
+		}
+		else
+			WLog_DBG(TAG, "no kernel TLS offload, the connection is not a plain TCP socket");
+	}
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
 	UINT16 version = freerdp_settings_get_uint16(settings, FreeRDP_TLSMinVersion);
 	if (!SSL_CTX_set_min_proto_version(tls->ctx, version))
@@ -815,6 +1250,7 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 		}
 	}
 
+	tls_prepare_resumption(tls, clientMode);
 	tls->bio = BIO_new_rdp_tls(tls->ctx, clientMode);
 
 	if (BIO_get_ssl(tls->bio, &tls->ssl) < 0)
@@ -822,6 +1258,8 @@ static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int op
 		WLog_ERR(TAG, "unable to retrieve the SSL of the connection");
 		return FALSE;
 	}
+	if (tls_session_idx != -1)
+		SSL_set_ex_data(tls->ssl, tls_session_idx, tls);
 
 	if (settings->TlsSecretsFile)
 	{
@@ -919,6 +1357,7 @@ TlsHandshakeResult freerdp_tls_connect_ex(rdpTls* tls, BIO* underlying, const SS
 	SSL_set_tlsext_host_name(tls->ssl, ptr);
 #endif
 
+	tls_session_resume(tls);
 	return freerdp_tls_handshake(tls);
 }
 
@@ -978,6 +1417,11 @@ TlsHandshakeResult freerdp_tls_handshake(rdpTls* tls)
 		/* server-side NLA needs public keys (keys from us, the server) but no certificate verify */
 		ret = TLS_HANDSHAKE_SUCCESS;
 
+#if defined(SSL_OP_ENABLE_KTLS)
+		if (BIO_get_ktls_send(SSL_get_wbio(tls->ssl)))
+			WLog_INFO(TAG, "TLS records are encrypted by the kernel");
+#endif
+
 		if (tls->isClientMode)
 		{
 			WINPR_ASSERT(tls->port <= UINT16_MAX);
@@ -987,9 +1431,16 @@ TlsHandshakeResult freerdp_tls_handshake(rdpTls* tls)
 			if (verify_status < 1)
 			{
 				WLog_ERR(TAG, "certificate not trusted, aborting.");
+				tls_session_cache_remove(tls);
 				freerdp_tls_send_alert(tls);
 				ret = TLS_HANDSHAKE_VERIFY_ERROR;
 			}
+			else
+			{
+				if (SSL_session_reused(tls->ssl))
+					WLog_DBG(TAG, "resumed TLS session with %s", tls_get_server_name(tls));
+				tls_session_verified(tls);
+			}
 		}
 	} while (0);
 
@@ -1254,6 +1705,39 @@ BOOL freerdp_tls_send_alert(rdpTls* tls)
 	return TRUE;
 }
 
+int freerdp_tls_peek(rdpTls* tls, BYTE* data, size_t length)
+{
+	WINPR_ASSERT(tls);
+	WINPR_ASSERT(data || (length == 0));
+
+	if (!tls->bio || (BIO_method_type(tls->bio) != BIO_TYPE_RDP_TLS))
+		return -1;
+
+	BIO_RDP_TLS* bdata = (BIO_RDP_TLS*)BIO_get_data(tls->bio);
+	if (!bdata || !bdata->ssl)
+		return -1;
+
+	const int size = (length > INT32_MAX) ? INT32_MAX : (int)length;
+
+	ERR_clear_error();
+	EnterCriticalSection(&bdata->lock);
+	const int status = SSL_peek(bdata->ssl, data, size);
+	const int error = SSL_get_error(bdata->ssl, status);
+	LeaveCriticalSection(&bdata->lock);
+
+	if (status > 0)
+		return status;
+
+	switch (error)
+	{
+		case SSL_ERROR_WANT_READ:
+		case SSL_ERROR_WANT_WRITE:
+			return 0;
+		default:
+			return -1;
+	}
+}
+
 int freerdp_tls_write_all(rdpTls* tls, const BYTE* data, size_t length)
 {
 	WINPR_ASSERT(tls);
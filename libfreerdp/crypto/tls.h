@@ -82,6 +82,8 @@ struct rdp_tls
 	int alertDescription;
 	BOOL isGatewayTransport;
 	BOOL isClientMode;
+	SSL_SESSION* pendingSession; /* received before the certificate was verified */
+	BOOL sessionVerified;
 };
 
 /** @brief result of a handshake operation */
@@ -117,6 +119,12 @@ extern "C"
 
 	FREERDP_LOCAL int freerdp_tls_write_all(rdpTls* tls, const BYTE* data, size_t length);
 
+	/** @brief Look at already decrypted data without consuming it.
+	 *
+	 *  @return the number of bytes copied, 0 if no data is available yet or -1 on error
+	 */
+	FREERDP_LOCAL int freerdp_tls_peek(rdpTls* tls, BYTE* data, size_t length);
+
 	FREERDP_LOCAL int freerdp_tls_set_alert_code(rdpTls* tls, int level, int description);
 
 	FREERDP_LOCAL void freerdp_tls_free(rdpTls* tls);
@@ -177,102 +177,118 @@ HGDI_BITMAP gdi_CreateCompatibleBitmap(HGDI_DC hdc, UINT32 nWidth, UINT32 nHeigh
 	return hBitmap;
 }
 
-static BOOL op_not(UINT32* stack, const UINT32* stackp)
+/* Number of row buffers the reverse polish ROP string needs. */
+static size_t rop_stack_depth(const char* rop)
 {
-	if (!stack || !stackp)
-		return FALSE;
-
-	if (*stackp < 1)
-		return FALSE;
-
-	stack[(*stackp) - 1] = ~stack[(*stackp) - 1];
-	return TRUE;
-}
+	size_t depth = 1;
+	size_t sp = 0;
 
-static BOOL op_and(UINT32* stack, UINT32* stackp)
-{
-	if (!stack || !stackp)
-		return FALSE;
-
-	if (*stackp < 2)
-		return FALSE;
-
-	(*stackp)--;
-	stack[(*stackp) - 1] &= stack[(*stackp)];
-	return TRUE;
-}
+	while (*rop != '\0')
+	{
+		switch (*rop++)
+		{
+			case '0':
+			case '1':
+			case 'D':
+			case 'S':
+			case 'P':
+				sp++;
+				depth = MAX(depth, sp);
+				break;
 
-static BOOL op_or(UINT32* stack, UINT32* stackp)
-{
-	if (!stack || !stackp)
-		return FALSE;
+			case 'x':
+			case 'a':
+			case 'o':
+				if (sp >= 2)
+					sp--;
+				break;
 
-	if (*stackp < 2)
-		return FALSE;
+			default:
+				break;
+		}
+	}
 
-	(*stackp)--;
-	stack[(*stackp) - 1] |= stack[(*stackp)];
-	return TRUE;
+	return depth;
 }
 
-static BOOL op_xor(UINT32* stack, UINT32* stackp)
+/* Evaluate the ROP for a whole row. Each operator is applied to complete
+ * rows, so every step is a simple loop the compiler can vectorise. */
+static const UINT32* process_rop_row(const char* rop, UINT32* stack, size_t width,
+                                     const UINT32* src, const UINT32* dst, const UINT32* pat,
+                                     UINT32 zero, UINT32 one)
 {
-	if (!stack || !stackp)
-		return FALSE;
+	size_t sp = 0;
 
-	if (*stackp < 2)
-		return FALSE;
-
-	(*stackp)--;
-	stack[(*stackp) - 1] ^= stack[(*stackp)];
-	return TRUE;
-}
-
-static UINT32 process_rop(UINT32 src, UINT32 dst, UINT32 pat, const char* rop, UINT32 format)
-{
-	UINT32 stack[10] = { 0 };
-	UINT32 stackp = 0;
+	memset(stack, 0, width * sizeof(UINT32));
 
 	while (*rop != '\0')
 	{
-		char op = *rop++;
+		const char op = *rop++;
+		UINT32* a = &stack[(sp > 0 ? sp - 1 : 0) * width];
+		UINT32* top = &stack[sp * width];
+		const UINT32* b = NULL;
 
 		switch (op)
 		{
 			case '0':
-				stack[stackp++] = FreeRDPGetColor(format, 0, 0, 0, 0xFF);
-				break;
-
 			case '1':
-				stack[stackp++] = FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF);
-				break;
+			{
+				const UINT32 value = (op == '0') ? zero : one;
+
+				for (size_t x = 0; x < width; x++)
+					top[x] = value;
+				sp++;
+			}
+			break;
 
 			case 'D':
-				stack[stackp++] = dst;
+				memcpy(top, dst, width * sizeof(UINT32));
+				sp++;
 				break;
 
 			case 'S':
-				stack[stackp++] = src;
+				memcpy(top, src, width * sizeof(UINT32));
+				sp++;
 				break;
 
 			case 'P':
-				stack[stackp++] = pat;
+				memcpy(top, pat, width * sizeof(UINT32));
+				sp++;
 				break;
 
 			case 'x':
-				op_xor(stack, &stackp);
-				break;
-
 			case 'a':
-				op_and(stack, &stackp);
-				break;
-
 			case 'o':
-				op_or(stack, &stackp);
+				if (sp < 2)
+					break;
+
+				sp--;
+				a = &stack[(sp - 1) * width];
+				b = &stack[sp * width];
+
+				if (op == 'x')
+				{
+					for (size_t x = 0; x < width; x++)
+						a[x] ^= b[x];
+				}
+				else if (op == 'a')
+				{
+					for (size_t x = 0; x < width; x++)
+						a[x] &= b[x];
+				}
+				else
+				{
+					for (size_t x = 0; x < width; x++)
+						a[x] |= b[x];
+				}
 				break;
 
 			case 'n':
-				op_not(stack, &stackp);
+				if (sp < 1)
+					break;
+
+				for (size_t x = 0; x < width; x++)
+					a[x] = ~a[x];
 				break;
 
 			default:
@@ -280,21 +296,87 @@ static UINT32 process_rop(UINT32 src, UINT32 dst, UINT32 pat, const char* rop, U
 		}
 	}
 
-	return stack[0];
+	return stack;
+}
+
+typedef struct
+{
+	size_t width;
+	UINT32* src;
+	UINT32* dst;
+	UINT32* pat;
+	UINT32* stack;
+	BOOL raw;
+	UINT32 srcMask;
+	UINT32 zero;
+	UINT32 one;
+} BITBLT_ROWS;
+
+/* Value as it is stored in memory. Bitwise ROPs give the same result on
+ * stored 32 bpp values, whose channels are just reordered bytes. */
+static INLINE UINT32 BitBlt_raw_color(UINT32 format, UINT32 color)
+{
+	UINT32 raw = 0;
+	FreeRDPWriteColor((BYTE*)&raw, format, color);
+	return raw;
+}
+
+/* Fill one row of pattern colors. Patterns repeat every brush width, so
+ * only the first period is looked up. */
+static BOOL BitBlt_read_pattern(HGDI_DC hdcDest, UINT32 style, INT32 nXDest, INT32 nY,
+                                const BITBLT_ROWS* rows)
+{
+	const size_t width = rows->width;
+	UINT32* pat = rows->pat;
+	size_t period = width;
+
+	if (style == GDI_BS_SOLID)
+	{
+		UINT32 color = hdcDest->brush->color;
+
+		if (rows->raw)
+			color = BitBlt_raw_color(hdcDest->format, color);
+
+		for (size_t x = 0; x < width; x++)
+			pat[x] = color;
+		return TRUE;
+	}
+
+	if (hdcDest->brush->pattern)
+		period = MIN(width, WINPR_ASSERTING_INT_CAST(size_t, hdcDest->brush->pattern->width));
+
+	for (size_t x = 0; x < period; x++)
+	{
+		const BYTE* patp = gdi_get_brush_pointer(
+		    hdcDest, WINPR_ASSERTING_INT_CAST(uint32_t, nXDest + (INT32)x),
+		    WINPR_ASSERTING_INT_CAST(uint32_t, nY));
+
+		if (!patp)
+		{
+			WLog_ERR(TAG, "patp=%p", (const void*)patp);
+			return FALSE;
+		}
+
+		if (rows->raw)
+			memcpy(&pat[x], patp, sizeof(UINT32));
+		else
+			pat[x] = FreeRDPReadColor(patp, hdcDest->format);
+	}
+
+	for (size_t x = period; x < width; x++)
+		pat[x] = pat[x - period];
+
+	return TRUE;
 }
 
-static INLINE BOOL BitBlt_write(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, INT32 nYDest,
-                                INT32 nXSrc, INT32 nYSrc, INT32 x, INT32 y, BOOL useSrc,
-                                BOOL usePat, UINT32 style, const char* rop,
-                                const gdiPalette* palette)
+static BOOL BitBlt_row(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, INT32 nYDest, INT32 nXSrc,
+                       INT32 nYSrc, INT32 y, BOOL useSrc, BOOL usePat, UINT32 style,
+                       const char* rop, const gdiPalette* palette, const BITBLT_ROWS* rows)
 {
-	UINT32 dstColor = 0;
-	UINT32 colorA = 0;
-	UINT32 colorB = 0;
-	UINT32 colorC = 0;
-	const INT32 dstX = nXDest + x;
-	const INT32 dstY = nYDest + y;
-	BYTE* dstp = gdi_get_bitmap_pointer(hdcDest, dstX, dstY);
+	const size_t width = rows->width;
+	const UINT32 dstFormat = hdcDest->format;
+	const size_t dstBpp = FreeRDPGetBytesPerPixel(dstFormat);
+	BYTE* dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
 	if (!dstp)
 	{
@@ -302,11 +384,19 @@ static INLINE BOOL BitBlt_write(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, I
 		return FALSE;
 	}
 
-	colorA = FreeRDPReadColor(dstp, hdcDest->format);
+	if (rows->raw)
+		memcpy(rows->dst, dstp, width * sizeof(UINT32));
+	else
+	{
+		for (size_t x = 0; x < width; x++)
+			rows->dst[x] = FreeRDPReadColor(&dstp[x * dstBpp], dstFormat);
+	}
 
 	if (useSrc)
 	{
-		const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc + x, nYSrc + y);
+		const UINT32 srcFormat = hdcSrc->format;
+		const size_t srcBpp = FreeRDPGetBytesPerPixel(srcFormat);
+		const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
 
 		if (!srcp)
 		{
@@ -314,42 +404,45 @@ static INLINE BOOL BitBlt_write(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, I
 			return FALSE;
 		}
 
-		colorC = FreeRDPReadColor(srcp, hdcSrc->format);
-		colorC = FreeRDPConvertColor(colorC, hdcSrc->format, hdcDest->format, palette);
+		if (rows->raw)
+		{
+			memcpy(rows->src, srcp, width * sizeof(UINT32));
+
+			for (size_t x = 0; x < width; x++)
+				rows->src[x] |= rows->srcMask;
+		}
+		else
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				const UINT32 color = FreeRDPReadColor(&srcp[x * srcBpp], srcFormat);
+				rows->src[x] = FreeRDPConvertColor(color, srcFormat, dstFormat, palette);
+			}
+		}
 	}
 
 	if (usePat)
 	{
-		switch (style)
-		{
-			case GDI_BS_SOLID:
-				colorB = hdcDest->brush->color;
-				break;
-
-			case GDI_BS_HATCHED:
-			case GDI_BS_PATTERN:
-			{
-				const BYTE* patp =
-				    gdi_get_brush_pointer(hdcDest, WINPR_ASSERTING_INT_CAST(uint32_t, nXDest + x),
-				                          WINPR_ASSERTING_INT_CAST(uint32_t, nYDest + y));
+		if (!BitBlt_read_pattern(hdcDest, style, nXDest, nYDest + y, rows))
+			return FALSE;
+	}
 
-				if (!patp)
-				{
-					WLog_ERR(TAG, "patp=%p", (const void*)patp);
-					return FALSE;
-				}
+	const UINT32* result = process_rop_row(rop, rows->stack, width, rows->src, rows->dst,
+	                                       rows->pat, rows->zero, rows->one);
 
-				colorB = FreeRDPReadColor(patp, hdcDest->format);
-			}
-			break;
+	if (rows->raw)
+	{
+		memcpy(dstp, result, width * sizeof(UINT32));
+		return TRUE;
+	}
 
-			default:
-				break;
-		}
+	for (size_t x = 0; x < width; x++)
+	{
+		if (!FreeRDPWriteColor(&dstp[x * dstBpp], dstFormat, result[x]))
+			return FALSE;
 	}
 
-	dstColor = process_rop(colorC, colorA, colorB, rop, hdcDest->format);
-	return FreeRDPWriteColor(dstp, hdcDest->format, dstColor);
+	return TRUE;
 }
 
 static BOOL adjust_src_coordinates(HGDI_DC hdcSrc, INT32 nWidth, INT32 nHeight, INT32* px,
@@ -521,56 +614,65 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 		}
 	}
 
-	if ((nXDest > nXSrc) && (nYDest > nYSrc))
-	{
-		for (INT32 y = nHeight - 1; y >= 0; y--)
-		{
-			for (INT32 x = nWidth - 1; x >= 0; x--)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
-		}
-	}
-	else if (nXDest > nXSrc)
+	if ((nWidth <= 0) || (nHeight <= 0))
+		return TRUE;
+
+	/* The destination and source are checked at both ends of the span
+	 * once, rows are then read and written without per pixel checks. */
+	if (!gdi_get_bitmap_pointer(hdcDest, nXDest + nWidth - 1, nYDest + nHeight - 1))
+		return FALSE;
+
+	if (useSrc && !gdi_get_bitmap_pointer(hdcSrc, nXSrc + nWidth - 1, nYSrc + nHeight - 1))
+		return FALSE;
+
+	/* Whole source rows are read before the destination row is written,
+	 * so only the vertical direction matters for overlapping blits. */
+	const UINT32 format = hdcDest->format;
+	const size_t width = WINPR_ASSERTING_INT_CAST(size_t, nWidth);
+	const size_t depth = rop_stack_depth(rop);
+	UINT32* buffer = (UINT32*)calloc((3 + depth) * width, sizeof(UINT32));
+
+	if (!buffer)
+		return FALSE;
+
+	BITBLT_ROWS rows = { .width = width,
+		                 .src = &buffer[0],
+		                 .dst = &buffer[width],
+		                 .pat = &buffer[2 * width],
+		                 .stack = &buffer[3 * width],
+		                 .zero = FreeRDPGetColor(format, 0, 0, 0, 0xFF),
+		                 .one = FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF) };
+
+	/* 32 bpp rows are processed as stored, without a color conversion per
+	 * pixel. A source in the same format only needs the forced alpha that
+	 * the conversion would apply to formats without an alpha channel. */
+	if ((FreeRDPGetBytesPerPixel(format) == 4) && (!useSrc || (hdcSrc->format == format)))
 	{
-		for (INT32 y = 0; y < nHeight; y++)
-		{
-			for (INT32 x = nWidth - 1; x >= 0; x--)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
-		}
+		rows.raw = TRUE;
+		rows.zero = BitBlt_raw_color(format, rows.zero);
+		rows.one = BitBlt_raw_color(format, rows.one);
+
+		if (!FreeRDPColorHasAlpha(format))
+			rows.srcMask = BitBlt_raw_color(format, FreeRDPGetColor(format, 0, 0, 0, 0xFF));
 	}
-	else if (nYDest > nYSrc)
+
+	BOOL rc = TRUE;
+
+	if (nYDest > nYSrc)
 	{
-		for (INT32 y = nHeight - 1; y >= 0; y--)
-		{
-			for (INT32 x = 0; x < nWidth; x++)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
-		}
+		for (INT32 y = nHeight - 1; rc && (y >= 0); y--)
+			rc = BitBlt_row(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, y, useSrc, usePat,
+			                style, rop, palette, &rows);
 	}
 	else
 	{
-		for (INT32 y = 0; y < nHeight; y++)
-		{
-			for (INT32 x = 0; x < nWidth; x++)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
-		}
+		for (INT32 y = 0; rc && (y < nHeight); y++)
+			rc = BitBlt_row(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, y, useSrc, usePat,
+			                style, rop, palette, &rows);
 	}
 
-	return TRUE;
+	free(buffer);
+	return rc;
 }
 
 /**
@@ -21,6 +21,8 @@
 
 #include <freerdp/config.h>
 
+#include "../core/settings.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -38,6 +40,7 @@
 #include <freerdp/gdi/shape.h>
 #include <freerdp/gdi/region.h>
 #include <freerdp/gdi/bitmap.h>
+#include <freerdp/utils/tracepoint.h>
 
 #include "drawing.h"
 #include "clipping.h"
@@ -340,8 +343,7 @@ BOOL gdi_decode_color(rdpGdi* gdi, UINT32 srcColor, UINT32* color, UINT32* forma
 	if (!gdi || !color || !gdi->context || !gdi->context->settings)
 		return FALSE;
 
-	const UINT32 ColorDepth =
-	    freerdp_settings_get_uint32(gdi->context->settings, FreeRDP_ColorDepth);
+	const UINT32 ColorDepth = gdi->context->settings->ColorDepth;
 
 	switch (ColorDepth)
 	{
@@ -642,8 +644,7 @@ static BOOL gdi_patblt(rdpContext* context, PATBLT_ORDER* patblt)
 			{
 				UINT32 bpp = brush->bpp;
 
-				if ((bpp == 16) &&
-				    (freerdp_settings_get_uint32(context->settings, FreeRDP_ColorDepth) == 15))
+				if ((bpp == 16) && (context->settings->ColorDepth == 15))
 					bpp = 15;
 
 				brushFormat = gdi_get_pixel_format(bpp);
@@ -903,8 +904,7 @@ static BOOL gdi_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
 			{
 				UINT32 bpp = brush->bpp;
 
-				const UINT32 ColorDepth =
-				    freerdp_settings_get_uint32(gdi->context->settings, FreeRDP_ColorDepth);
+				const UINT32 ColorDepth = gdi->context->settings->ColorDepth;
 				if ((bpp == 16) && (ColorDepth == 15))
 					bpp = 15;
 
@@ -1016,7 +1016,7 @@ static BOOL gdi_surface_frame_marker(rdpContext* context,
 			break;
 
 		case SURFACECMD_FRAMEACTION_END:
-			if (freerdp_settings_get_uint32(context->settings, FreeRDP_FrameAcknowledge) > 0)
+			if (context->settings->FrameAcknowledge > 0)
 			{
 				IFCALL(context->update->SurfaceFrameAcknowledge, context,
 				       surfaceFrameMarker->frameId);
@@ -1081,6 +1081,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 	    cmd->destLeft, cmd->destTop, cmd->destRight, cmd->destBottom, cmd->bmp.bpp, cmd->bmp.flags,
 	    cmd->bmp.codecID, cmd->bmp.width, cmd->bmp.height, cmd->bmp.bitmapDataLength);
 	region16_init(&region);
+	FREERDP_TRACEPOINT(surface_bits, 0, cmd->bmp.codecID);
 
 	if (!intersect_rect(gdi, cmd, &cmdRect))
 		goto out;
@@ -1143,6 +1144,22 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 			break;
 	}
 
+	if (!region16_is_empty(&gdi->monitorRegion))
+	{
+		if (region16_is_empty(&region) && !region16_union_rect(&region, &region, &cmdRect))
+			goto out;
+
+		/* Areas between monitors are never presented */
+		if (!gdi_clip_to_monitors(gdi, &region, 0, 0))
+			goto out;
+
+		if (region16_is_empty(&region))
+		{
+			result = TRUE;
+			goto out;
+		}
+	}
+
 	UINT32 nbRects = 0;
 	const RECTANGLE_16* rects = region16_rects(&region, &nbRects);
 	if (!rects && (nbRects > 0))
@@ -1230,6 +1247,139 @@ static void gdi_register_update_callbacks(rdpUpdate* update)
 	update->altsec->FrameMarker = gdi_frame_marker;
 }
 
+static void gdi_update_monitor_region(rdpGdi* gdi)
+{
+	INT32 minX = INT32_MAX;
+	INT32 minY = INT32_MAX;
+	INT64 maxX = INT64_MIN;
+	INT64 maxY = INT64_MIN;
+	const rdpSettings* settings = gdi->context->settings;
+	const UINT32 count = freerdp_settings_get_uint32(settings, FreeRDP_MonitorCount);
+
+	region16_clear(&gdi->monitorRegion);
+
+	if (!freerdp_settings_get_bool(settings, FreeRDP_GdiMonitorSurfaces) || (count < 2))
+		return;
+
+	if ((gdi->width > UINT16_MAX) || (gdi->height > UINT16_MAX))
+		return;
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		const rdpMonitor* monitor =
+		    freerdp_settings_get_pointer_array(settings, FreeRDP_MonitorDefArray, i);
+
+		if (!monitor || (monitor->width <= 0) || (monitor->height <= 0))
+			return;
+
+		minX = MIN(minX, monitor->x);
+		minY = MIN(minY, monitor->y);
+		maxX = MAX(maxX, 1ll * monitor->x + monitor->width);
+		maxY = MAX(maxY, 1ll * monitor->y + monitor->height);
+	}
+
+	/* A layout that does not describe the current desktop (e.g. after a resize) backs it all */
+	if ((maxX - minX != gdi->width) || (maxY - minY != gdi->height))
+		return;
+
+	for (UINT32 i = 0; i < count; i++)
+	{
+		const rdpMonitor* monitor =
+		    freerdp_settings_get_pointer_array(settings, FreeRDP_MonitorDefArray, i);
+		const RECTANGLE_16 rect = {
+			.left = WINPR_ASSERTING_INT_CAST(UINT16, monitor->x - minX),
+			.top = WINPR_ASSERTING_INT_CAST(UINT16, monitor->y - minY),
+			.right = WINPR_ASSERTING_INT_CAST(UINT16, monitor->x - minX + monitor->width),
+			.bottom = WINPR_ASSERTING_INT_CAST(UINT16, monitor->y - minY + monitor->height)
+		};
+
+		if (!region16_union_rect(&gdi->monitorRegion, &gdi->monitorRegion, &rect))
+		{
+			region16_clear(&gdi->monitorRegion);
+			return;
+		}
+	}
+
+	/* Without gaps the bounding box is the cheapest representation */
+	const RECTANGLE_16* extents = region16_extents(&gdi->monitorRegion);
+	if ((region16_n_rects(&gdi->monitorRegion) == 1) && (extents->left == 0) &&
+	    (extents->top == 0) && (extents->right == gdi->width) && (extents->bottom == gdi->height))
+		region16_clear(&gdi->monitorRegion);
+}
+
+/**
+ * Allocates the primary buffer for a layout with gaps. The buffer is zeroed lazily by the system,
+ * only the rows of the monitors are touched, so pages of the gaps are never committed.
+ */
+static BYTE* gdi_alloc_monitor_buffer(const rdpGdi* gdi)
+{
+	UINT32 nbRects = 0;
+	const size_t bpp = FreeRDPGetBytesPerPixel(gdi->dstFormat);
+	const RECTANGLE_16* rects = region16_rects(&gdi->monitorRegion, &nbRects);
+	BYTE* data = calloc(WINPR_ASSERTING_INT_CAST(size_t, gdi->height), gdi->stride);
+
+	if (!data)
+		return NULL;
+
+	for (UINT32 i = 0; i < nbRects; i++)
+	{
+		const RECTANGLE_16* rect = &rects[i];
+
+		for (size_t y = rect->top; y < rect->bottom; y++)
+			memset(&data[y * gdi->stride + rect->left * bpp], 0xff,
+			       (rect->right - rect->left) * bpp);
+	}
+
+	return data;
+}
+
+BOOL gdi_clip_to_monitors(const rdpGdi* gdi, REGION16* region, UINT32 x, UINT32 y)
+{
+	BOOL rc = FALSE;
+	UINT32 nbRects = 0;
+	REGION16 clipped;
+	REGION16 part;
+
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(region);
+
+	if (region16_is_empty(&gdi->monitorRegion))
+		return TRUE;
+
+	region16_init(&clipped);
+	region16_init(&part);
+
+	const RECTANGLE_16* rects = region16_rects(&gdi->monitorRegion, &nbRects);
+
+	for (UINT32 i = 0; i < nbRects; i++)
+	{
+		const RECTANGLE_16* rect = &rects[i];
+
+		if ((rect->right <= x) || (rect->bottom <= y))
+			continue;
+
+		const RECTANGLE_16 monitor = { .left = (UINT16)(rect->left - MIN(rect->left, x)),
+			                           .top = (UINT16)(rect->top - MIN(rect->top, y)),
+			                           .right = (UINT16)(rect->right - x),
+			                           .bottom = (UINT16)(rect->bottom - y) };
+
+		if (!region16_intersect_rect(&part, region, &monitor))
+			goto fail;
+
+		UINT32 nbParts = 0;
+		const RECTANGLE_16* parts = region16_rects(&part, &nbParts);
+
+		if (!region16_union_rects(&clipped, &clipped, parts, nbParts))
+			goto fail;
+	}
+
+	rc = region16_copy(region, &clipped);
+fail:
+	region16_uninit(&part);
+	region16_uninit(&clipped);
+	return rc;
+}
+
 static BOOL gdi_init_primary(rdpGdi* gdi, UINT32 stride, UINT32 format, BYTE* buffer,
                              void (*pfree)(void*), BOOL isLocked)
 {
@@ -1257,6 +1407,24 @@ static BOOL gdi_init_primary(rdpGdi* gdi, UINT32 stride, UINT32 format, BYTE* bu
 		goto fail_hdc;
 
 	if (!buffer)
+		gdi_update_monitor_region(gdi);
+	else
+		region16_clear(&gdi->monitorRegion);
+
+	if (!buffer && !region16_is_empty(&gdi->monitorRegion))
+	{
+		BYTE* data = gdi_alloc_monitor_buffer(gdi);
+
+		if (data)
+			gdi->primary->bitmap =
+			    gdi_CreateBitmapEx(WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
+			                       WINPR_ASSERTING_INT_CAST(uint32_t, gdi->height),
+			                       gdi->dstFormat, gdi->stride, data, free);
+
+		if (data && !gdi->primary->bitmap)
+			free(data);
+	}
+	else if (!buffer)
 	{
 		gdi->primary->bitmap =
 		    gdi_CreateCompatibleBitmap(gdi->hdc, WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
@@ -1390,6 +1558,7 @@ BOOL gdi_init_ex(freerdp* instance, UINT32 format, UINT32 stride, BYTE* buffer,
 		goto fail;
 
 	context->gdi = gdi;
+	region16_init(&gdi->monitorRegion);
 	gdi->log = WLog_Get(TAG);
 
 	if (!gdi->log)
@@ -1443,18 +1612,22 @@ void gdi_free(freerdp* instance)
 	if (!instance || !instance->context)
 		return;
 
-	gdi = instance->context->gdi;
+	context = instance->context;
+	gdi = context->gdi;
+
+	/* The bitmap cache may decode entries while saving the persistent
+	 * cache, so release it while gdi is still valid. */
+	cache_free(context->cache);
+	context->cache = NULL;
 
 	if (gdi)
 	{
 		gdi_bitmap_free_ex(gdi->primary);
 		gdi_DeleteDC(gdi->hdc);
+		region16_uninit(&gdi->monitorRegion);
 		free(gdi);
 	}
 
-	context = instance->context;
-	cache_free(context->cache);
-	context->cache = NULL;
 	instance->context->gdi = (rdpGdi*)NULL;
 }
 
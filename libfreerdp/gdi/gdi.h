@@ -32,6 +32,12 @@ FREERDP_LOCAL BOOL gdi_bitmap_update(rdpContext* context, const BITMAP_UPDATE* b
 FREERDP_LOCAL gdiBitmap* gdi_bitmap_new_ex(rdpGdi* gdi, int width, int height, int bpp, BYTE* data);
 FREERDP_LOCAL void gdi_bitmap_free_ex(gdiBitmap* gdi_bmp);
 
+/**
+ * Clips region to the monitor areas when the primary surface only backs the monitors of the
+ * layout. The region is placed at (x, y) of the primary surface.
+ */
+FREERDP_LOCAL BOOL gdi_clip_to_monitors(const rdpGdi* gdi, REGION16* region, UINT32 x, UINT32 y);
+
 static INLINE BYTE* gdi_get_bitmap_pointer(HGDI_DC hdcBmp, INT32 x, INT32 y)
 {
 	HGDI_BITMAP hBmp = (HGDI_BITMAP)hdcBmp->selectedObject;
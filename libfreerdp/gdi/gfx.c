@@ -22,19 +22,29 @@
 #include <freerdp/config.h>
 
 #include "../core/update.h"
+#include "gdi.h"
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/sysinfo.h>
+#include <winpr/collections.h>
 
 #include <freerdp/api.h>
 #include <freerdp/log.h>
+#include <freerdp/metrics.h>
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/gdi/region.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/primitives.h>
 #include <freerdp/utils/gfx.h>
+#include <freerdp/utils/tracepoint.h>
 #include <math.h>
 
 #define TAG FREERDP_TAG("gdi")
 
+/* presenting is skipped for at most this many frames in a row while decoding is behind */
+#define GDI_MAX_SKIPPED_FRAMES 4
+
 static BOOL is_rect_valid(const RECTANGLE_16* rect, size_t width, size_t height)
 {
 	if (!rect)
@@ -193,6 +203,11 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 	const double sx = surface->outputTargetWidth / (double)surface->mappedWidth;
 	const double sy = surface->outputTargetHeight / (double)surface->mappedHeight;
 
+	/* Only copy what lands on a monitor, the gaps of the primary are never presented */
+	if ((sx == 1.0) && (sy == 1.0) &&
+	    !gdi_clip_to_monitors(gdi, &surface->invalidRegion, surfaceX, surfaceY))
+		return ERROR_INTERNAL_ERROR;
+
 	if (!(rects = region16_rects(&surface->invalidRegion, &nbRects)) || !nbRects)
 		return CHANNEL_RC_OK;
 
@@ -228,7 +243,7 @@ fail:
 	if (!update_end_paint(update))
 		rc = ERROR_INTERNAL_ERROR;
 
-	region16_clear(&(surface->invalidRegion));
+	region16_reset(&(surface->invalidRegion));
 	return rc;
 }
 
@@ -303,6 +318,8 @@ static UINT gdi_StartFrame(RdpgfxClientContext* context, const RDPGFX_START_FRAM
 	WINPR_ASSERT(gdi);
 	gdi->inGfxFrame = TRUE;
 	gdi->frameId = startFrame->frameId;
+	gdi->frameStart = winpr_GetTickCount64NS();
+	FREERDP_TRACEPOINT(gfx_start_frame, gdi->frameId, 0);
 	return CHANNEL_RC_OK;
 }
 
@@ -317,19 +334,76 @@ static UINT gdi_call_update_surfaces(RdpgfxClientContext* context)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT gdi_EndFrame(RdpgfxClientContext* context,
-                         WINPR_ATTR_UNUSED const RDPGFX_END_FRAME_PDU* endFrame)
+static void gdi_record_frame_metric(rdpGdi* gdi, const char* name, FreeRDPMetricType type,
+                                    UINT64 value)
+{
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->context);
+
+	rdpMetrics* metrics = gdi->context->metrics;
+	(void)metrics_record(metrics, metrics_register(metrics, name, type), value);
+}
+
+static UINT gdi_EndFrame(RdpgfxClientContext* context, const RDPGFX_END_FRAME_PDU* endFrame)
 {
 	WINPR_ASSERT(context);
 	WINPR_ASSERT(endFrame);
 
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 	WINPR_ASSERT(gdi);
-	const UINT status = gdi_call_update_surfaces(context);
 	gdi->inGfxFrame = FALSE;
+	FREERDP_TRACEPOINT(gfx_end_frame, endFrame->frameId, context->FramesBehind);
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	gdi_record_frame_metric(gdi, "gfx_frame_decode_us", FREERDP_METRIC_HISTOGRAM,
+	                        (start - gdi->frameStart) / 1000);
+
+	/* a later frame is already waiting, its output update includes the areas of this one */
+	if ((context->FramesBehind > 0) && (gdi->framesSkipped < GDI_MAX_SKIPPED_FRAMES))
+	{
+		gdi->framesSkipped++;
+		gdi_record_frame_metric(gdi, "gfx_frames_skipped", FREERDP_METRIC_COUNTER, 1);
+		return CHANNEL_RC_OK;
+	}
+	gdi->framesSkipped = 0;
+
+	/* keep the oldest frame not presented yet, clients might present while updating */
+	(void)InterlockedCompareExchange64(&gdi->frameComposed, (LONGLONG)start, 0);
+	(void)InterlockedIncrement(&gdi->framesComposed);
+
+	const UINT status = gdi_call_update_surfaces(context);
+	gdi_record_frame_metric(gdi, "gfx_frame_compose_us", FREERDP_METRIC_HISTOGRAM,
+	                        (winpr_GetTickCount64NS() - start) / 1000);
 	return status;
 }
 
+void gdi_frame_presented(rdpGdi* gdi)
+{
+	if (!gdi)
+		return;
+
+	LONGLONG composed = InterlockedCompareExchange64(&gdi->frameComposed, 0, 0);
+	while (composed != 0)
+	{
+		const LONGLONG cur = InterlockedCompareExchange64(&gdi->frameComposed, 0, composed);
+		if (cur == composed)
+			break;
+		composed = cur;
+	}
+	const LONG frames = InterlockedExchange(&gdi->framesComposed, 0);
+	if ((composed == 0) || (frames <= 0))
+		return;
+
+	FREERDP_TRACEPOINT(gfx_present, gdi->frameId, frames);
+	const UINT64 now = winpr_GetTickCount64NS();
+	const UINT64 then = (UINT64)composed;
+	gdi_record_frame_metric(gdi, "gfx_frame_present_us", FREERDP_METRIC_HISTOGRAM,
+	                        (now > then) ? (now - then) / 1000 : 0);
+	if (frames > 1)
+		gdi_record_frame_metric(gdi, "gfx_frames_superseded", FREERDP_METRIC_COUNTER,
+		                        (UINT64)frames - 1);
+}
+
 static UINT gdi_interFrameUpdate(rdpGdi* gdi, RdpgfxClientContext* context)
 {
 	WINPR_ASSERT(gdi);
@@ -445,8 +519,11 @@ static UINT gdi_SurfaceCommand_RemoteFX(rdpGdi* gdi, RdpgfxClientContext* contex
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (UINT32 x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	if (!region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects))
+	{
+		status = ERROR_INTERNAL_ERROR;
+		goto fail;
+	}
 
 	status = gdi_interFrameUpdate(gdi, context);
 
@@ -600,6 +677,10 @@ static UINT gdi_SurfaceCommand_AVC420(rdpGdi* gdi, RdpgfxClientContext* context,
 			return ERROR_NOT_ENOUGH_MEMORY;
 		}
 
+		/* one thread pool for the surfaces of all monitors, not one each */
+		if (!h264_context_set_option(surface->h264, H264_CONTEXT_OPTION_SHARED_THREADPOOL, TRUE))
+			return ERROR_INTERNAL_ERROR;
+
 		if (!h264_context_reset(surface->h264, surface->width, surface->height))
 			return ERROR_INTERNAL_ERROR;
 	}
@@ -685,6 +766,10 @@ static UINT gdi_SurfaceCommand_AVC444(rdpGdi* gdi, RdpgfxClientContext* context,
 			return ERROR_NOT_ENOUGH_MEMORY;
 		}
 
+		/* one thread pool for the surfaces of all monitors, not one each */
+		if (!h264_context_set_option(surface->h264, H264_CONTEXT_OPTION_SHARED_THREADPOOL, TRUE))
+			return ERROR_INTERNAL_ERROR;
+
 		if (!h264_context_reset(surface->h264, surface->width, surface->height))
 			return ERROR_INTERNAL_ERROR;
 	}
@@ -745,14 +830,56 @@ fail:
 #endif
 }
 
+/**
+ * The byte FreeRDPGetColor stores the alpha value in for a 32bpp format, -1 if the format needs
+ * the generic color conversion.
+ */
+static SSIZE_T gdi_alpha_offset(UINT32 format)
+{
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_ABGR32:
+			return 0;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			return 3;
+		default:
+			return -1;
+	}
+}
+
 static BOOL gdi_apply_alpha(BYTE* data, UINT32 format, UINT32 stride, RECTANGLE_16* rect,
                             UINT32 startOffsetX, UINT32 count, BYTE a)
 {
 	UINT32 written = 0;
 	BOOL first = TRUE;
 	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const SSIZE_T offset = gdi_alpha_offset(format);
 	WINPR_ASSERT(rect);
 
+	/* only the alpha byte changes, runs are written without converting every pixel */
+	if (offset >= 0)
+	{
+		for (size_t y = rect->top; (y < rect->bottom) && (written < count); y++)
+		{
+			const size_t left = first ? rect->left + startOffsetX : rect->left;
+			const size_t end = MIN(rect->right, left + count - written);
+			BYTE* line = &data[y * stride + (size_t)offset];
+
+			for (size_t x = left; x < end; x++)
+				line[x * 4] = a;
+
+			if (end > left)
+				written += (UINT32)(end - left);
+			first = FALSE;
+		}
+
+		return TRUE;
+	}
+
 	for (size_t y = rect->top; y < rect->bottom; y++)
 	{
 		BYTE* line = &data[y * stride];
@@ -827,7 +954,18 @@ static UINT gdi_SurfaceCommand_Alpha(rdpGdi* gdi, RdpgfxClientContext* context,
 		if (!Stream_CheckAndLogRequiredLengthOfSize(TAG, s, cmd->height, cmd->width))
 			return ERROR_INVALID_DATA;
 
-		for (size_t y = cmd->top; y < cmd->top + cmd->height; y++)
+		const SSIZE_T offset = gdi_alpha_offset(surface->format);
+		for (size_t y = cmd->top; (offset >= 0) && (y < cmd->top + cmd->height); y++)
+		{
+			BYTE* line = &surface->data[y * surface->scanline + (size_t)offset];
+			const BYTE* alpha = Stream_ConstPointer(s);
+
+			for (size_t x = 0; x < cmd->width; x++)
+				line[(cmd->left + x) * 4] = alpha[x];
+			Stream_Seek(s, cmd->width);
+		}
+
+		for (size_t y = cmd->top; (offset < 0) && (y < cmd->top + cmd->height); y++)
 		{
 			BYTE* line = &surface->data[y * surface->scanline];
 
@@ -1012,17 +1150,46 @@ static UINT gdi_SurfaceCommand_Progressive(rdpGdi* gdi, RdpgfxClientContext* con
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
-	for (UINT32 x = 0; x < nrRects; x++)
-		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &rects[x]);
+	if (!region16_union_rects(&surface->invalidRegion, &surface->invalidRegion, rects, nrRects))
+		status = ERROR_INTERNAL_ERROR;
 
 	region16_uninit(&invalidRegion);
 
+	if (status != CHANNEL_RC_OK)
+		return status;
+
 	status = gdi_interFrameUpdate(gdi, context);
 
 fail:
 	return status;
 }
 
+static const char* gdi_decode_metric_name(UINT16 codecId)
+{
+	switch (codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			return "gfx_decode_uncompressed_us";
+		case RDPGFX_CODECID_CAVIDEO:
+			return "gfx_decode_remotefx_us";
+		case RDPGFX_CODECID_CLEARCODEC:
+			return "gfx_decode_clearcodec_us";
+		case RDPGFX_CODECID_PLANAR:
+			return "gfx_decode_planar_us";
+		case RDPGFX_CODECID_AVC420:
+			return "gfx_decode_avc420_us";
+		case RDPGFX_CODECID_AVC444:
+		case RDPGFX_CODECID_AVC444v2:
+			return "gfx_decode_avc444_us";
+		case RDPGFX_CODECID_ALPHA:
+			return "gfx_decode_alpha_us";
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+			return "gfx_decode_progressive_us";
+		default:
+			return NULL;
+	}
+}
+
 /**
  * Function description
  *
@@ -1052,6 +1219,8 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 	dump_cmd(cmd, gdi->frameId);
 #endif
 
+	const UINT64 start = winpr_GetTickCount64NS();
+	FREERDP_TRACEPOINT(gfx_decode, gdi->frameId, codecId);
 	switch (codecId)
 	{
 		case RDPGFX_CODECID_UNCOMPRESSED:
@@ -1098,6 +1267,16 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 			break;
 	}
 
+	FREERDP_TRACEPOINT(gfx_decode_done, gdi->frameId, status);
+	const char* metric = gdi_decode_metric_name(codecId);
+	if (metric && (status == CHANNEL_RC_OK))
+	{
+		rdpMetrics* metrics = gdi->context->metrics;
+		const UINT64 us = (winpr_GetTickCount64NS() - start) / 1000;
+		(void)metrics_record(metrics, metrics_register(metrics, metric, FREERDP_METRIC_HISTOGRAM),
+		                     us);
+	}
+
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1266,13 +1445,48 @@ static BOOL intersect_rect(const RECTANGLE_16* rect, const gdiGfxSurface* surfac
  *
  * @return 0 on success, otherwise a Win32 error code
  */
+/**
+ * Fill a rectangle of a surface, 32bpp surfaces use the vectorized set primitive.
+ */
+static BOOL gdi_fill_rect(gdiGfxSurface* surface, const RECTANGLE_16* rect, UINT32 color)
+{
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(rect);
+
+	const UINT32 nWidth = rect->right - rect->left;
+	const UINT32 nHeight = rect->bottom - rect->top;
+
+	if (FreeRDPGetBytesPerPixel(surface->format) != 4)
+		return freerdp_image_fill(surface->data, surface->format, surface->scanline, rect->left,
+		                          rect->top, nWidth, nHeight, color);
+
+	/* the value as it is stored in memory */
+	UINT32 value = 0;
+	BYTE pixel[4] = { 0 };
+	FreeRDPWriteColor(pixel, surface->format, color);
+	memcpy(&value, pixel, sizeof(value));
+
+	primitives_t* prims = primitives_get();
+	WINPR_ASSERT(prims);
+	for (UINT32 y = rect->top; y < rect->bottom; y++)
+	{
+		BYTE* line = &surface->data[1ull * y * surface->scanline + 4ull * rect->left];
+		if (prims->set_32u(value, (UINT32*)line, nWidth) != PRIMITIVES_SUCCESS)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_PDU* solidFill)
 {
 	UINT status = ERROR_INTERNAL_ERROR;
 	BYTE a = 0xff;
 	RECTANGLE_16 invalidRect = { 0 };
+	REGION16 fillRegion = { 0 };
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 
+	region16_init(&fillRegion);
 	EnterCriticalSection(&context->mux);
 
 	WINPR_ASSERT(context->GetSurfaceData);
@@ -1293,6 +1507,7 @@ static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_
 
 	const UINT32 color = FreeRDPGetColor(surface->format, r, g, b, a);
 
+	/* overlapping rectangles are merged, every pixel is filled once */
 	for (UINT16 index = 0; index < solidFill->fillRectCount; index++)
 	{
 		const RECTANGLE_16* rect = &(solidFill->fillRects[index]);
@@ -1300,26 +1515,34 @@ static UINT gdi_SolidFill(RdpgfxClientContext* context, const RDPGFX_SOLID_FILL_
 		if (!intersect_rect(rect, surface, &invalidRect))
 			goto fail;
 
-		const UINT32 nWidth = invalidRect.right - invalidRect.left;
-		const UINT32 nHeight = invalidRect.bottom - invalidRect.top;
-
-		if (!freerdp_image_fill(surface->data, surface->format, surface->scanline, invalidRect.left,
-		                        invalidRect.top, nWidth, nHeight, color))
+		if (!region16_union_rect(&fillRegion, &fillRegion, &invalidRect))
 			goto fail;
+	}
 
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+	UINT32 nbRects = 0;
+	const RECTANGLE_16* rects = region16_rects(&fillRegion, &nbRects);
+	for (UINT32 index = 0; index < nbRects; index++)
+	{
+		if (!gdi_fill_rect(surface, &rects[index], color))
+			goto fail;
 	}
 
+	if (!region16_union_rects(&(surface->invalidRegion), &(surface->invalidRegion), rects,
+	                          nbRects))
+		goto fail;
+
 	status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context, surface->surfaceId,
 	                      solidFill->fillRectCount, solidFill->fillRects);
 
 	if (status != CHANNEL_RC_OK)
 		goto fail;
 
+	region16_uninit(&fillRegion);
 	LeaveCriticalSection(&context->mux);
 
 	return gdi_interFrameUpdate(gdi, context);
 fail:
+	region16_uninit(&fillRegion);
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1338,6 +1561,7 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 	UINT32 nHeight = 0;
 	const RECTANGLE_16* rectSrc = NULL;
 	RECTANGLE_16 invalidRect;
+	RECTANGLE_16* invalidRects = NULL;
 	gdiGfxSurface* surfaceSrc = NULL;
 	gdiGfxSurface* surfaceDst = NULL;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
@@ -1364,6 +1588,13 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 	nWidth = rectSrc->right - rectSrc->left;
 	nHeight = rectSrc->bottom - rectSrc->top;
 
+	if (surfaceToSurface->destPtsCount > 0)
+	{
+		invalidRects = calloc(surfaceToSurface->destPtsCount, sizeof(RECTANGLE_16));
+		if (!invalidRects)
+			goto fail;
+	}
+
 	for (UINT16 index = 0; index < surfaceToSurface->destPtsCount; index++)
 	{
 		const RDPGFX_POINT16* destPt = &surfaceToSurface->destPts[index];
@@ -1373,44 +1604,348 @@ static UINT gdi_SurfaceToSurface(RdpgfxClientContext* context,
 		if (!is_rect_valid(&rect, surfaceDst->width, surfaceDst->height))
 			goto fail;
 
-		if (!freerdp_image_copy(surfaceDst->data, surfaceDst->format, surfaceDst->scanline,
-		                        destPt->x, destPt->y, nWidth, nHeight, surfaceSrc->data,
-		                        surfaceSrc->format, surfaceSrc->scanline, rectSrc->left,
-		                        rectSrc->top, NULL, FREERDP_FLIP_NONE))
+		/* only a copy within a surface can overlap */
+		if (sameSurface)
+		{
+			if (!freerdp_image_copy(surfaceDst->data, surfaceDst->format, surfaceDst->scanline,
+			                        destPt->x, destPt->y, nWidth, nHeight, surfaceSrc->data,
+			                        surfaceSrc->format, surfaceSrc->scanline, rectSrc->left,
+			                        rectSrc->top, NULL, FREERDP_FLIP_NONE))
+				goto fail;
+		}
+		else if (!freerdp_image_copy_no_overlap(
+		             surfaceDst->data, surfaceDst->format, surfaceDst->scanline, destPt->x,
+		             destPt->y, nWidth, nHeight, surfaceSrc->data, surfaceSrc->format,
+		             surfaceSrc->scanline, rectSrc->left, rectSrc->top, NULL, FREERDP_FLIP_NONE))
 			goto fail;
 
 		invalidRect = rect;
 		region16_union_rect(&surfaceDst->invalidRegion, &surfaceDst->invalidRegion, &invalidRect);
+		invalidRects[index] = invalidRect;
+	}
+
+	/* one notification for all destinations */
+	status = CHANNEL_RC_OK;
+	if (surfaceToSurface->destPtsCount > 0)
 		status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context,
-		                      surfaceDst->surfaceId, 1, &invalidRect);
+		                      surfaceDst->surfaceId, surfaceToSurface->destPtsCount, invalidRects);
 
-		if (status != CHANNEL_RC_OK)
-			goto fail;
-	}
+	if (status != CHANNEL_RC_OK)
+		goto fail;
 
+	free(invalidRects);
 	LeaveCriticalSection(&context->mux);
 
 	return gdi_interFrameUpdate(gdi, context);
 fail:
+	free(invalidRects);
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
 
+/* Larger entries stay uncompressed, the planar context needs 18 bytes per pixel of scratch */
+#define GFX_CACHE_MAX_COMPRESSED_AREA (512ULL * 512ULL)
+
+typedef struct gdi_gfx_cache_entry_ex gdiGfxCacheEntryEx;
+
+/**
+ * A cache entry as allocated by gdi. The bitmap of an entry that has not been used for a
+ * while may be held planar compressed, data is NULL then.
+ */
+struct gdi_gfx_cache_entry_ex
+{
+	gdiGfxCacheEntry entry;
+
+	gdiGfxCacheBudget* budget;
+	gdiGfxCacheEntryEx* prev; /* more recently used */
+	gdiGfxCacheEntryEx* next; /* less recently used */
+	BYTE* compressed;
+	UINT32 compressedSize;
+	BOOL incompressible;
+};
+
+/**
+ * Byte usage of all cache entries, with the entries in order of their last use. Entries keep a
+ * reference, so the budget outlives a graphics pipeline whose cache is evicted late.
+ */
+struct gdi_gfx_cache_budget
+{
+	CRITICAL_SECTION lock;
+	LONG refs;
+	size_t limit; /* bytes, 0 for no limit */
+	size_t used;
+	wMemoryTag* memoryTag; /* mirrors used */
+	gdiGfxCacheEntryEx* head;
+	gdiGfxCacheEntryEx* tail;
+	BITMAP_PLANAR_CONTEXT* planar;
+	UINT32 planarWidth;
+	UINT32 planarHeight;
+	BYTE* scratch;
+	size_t scratchSize;
+};
+
+static gdiGfxCacheBudget* gdi_GfxCacheBudgetNew(size_t limit)
+{
+	gdiGfxCacheBudget* budget = (gdiGfxCacheBudget*)calloc(1, sizeof(gdiGfxCacheBudget));
+	if (!budget)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&budget->lock, 4000))
+	{
+		free(budget);
+		return NULL;
+	}
+
+	budget->refs = 1;
+	budget->limit = limit;
+	budget->memoryTag = MemoryTag_Get("gfx_cache");
+	return budget;
+}
+
+static void gdi_GfxCacheBudgetAdd(gdiGfxCacheBudget* budget, size_t bytes)
+{
+	budget->used += bytes;
+	MemoryTag_Allocated(budget->memoryTag, bytes);
+}
+
+static void gdi_GfxCacheBudgetSub(gdiGfxCacheBudget* budget, size_t bytes)
+{
+	budget->used -= bytes;
+	MemoryTag_Released(budget->memoryTag, bytes);
+}
+
+static void gdi_GfxCacheBudgetRelease(gdiGfxCacheBudget* budget)
+{
+	if (!budget)
+		return;
+
+	EnterCriticalSection(&budget->lock);
+	const LONG refs = --budget->refs;
+	LeaveCriticalSection(&budget->lock);
+
+	if (refs > 0)
+		return;
+
+	freerdp_bitmap_planar_context_free(budget->planar);
+	free(budget->scratch);
+	DeleteCriticalSection(&budget->lock);
+	free(budget);
+}
+
+static size_t gdi_GfxCacheEntrySize(const gdiGfxCacheEntryEx* ex)
+{
+	WINPR_ASSERT(ex);
+	if (ex->compressed)
+		return ex->compressedSize;
+	if (!ex->entry.data)
+		return 0;
+	return 1ull * ex->entry.scanline * ex->entry.height;
+}
+
+static void gdi_GfxCacheEntryUnlink(gdiGfxCacheBudget* budget, gdiGfxCacheEntryEx* ex)
+{
+	if (ex->prev)
+		ex->prev->next = ex->next;
+	else
+		budget->head = ex->next;
+
+	if (ex->next)
+		ex->next->prev = ex->prev;
+	else
+		budget->tail = ex->prev;
+
+	ex->prev = NULL;
+	ex->next = NULL;
+}
+
+static void gdi_GfxCacheEntryLinkHead(gdiGfxCacheBudget* budget, gdiGfxCacheEntryEx* ex)
+{
+	ex->next = budget->head;
+	if (budget->head)
+		budget->head->prev = ex;
+	budget->head = ex;
+	if (!budget->tail)
+		budget->tail = ex;
+}
+
+/* must be called with the budget locked */
+static BOOL gdi_GfxCacheBudgetPreparePlanar(gdiGfxCacheBudget* budget, UINT32 width,
+                                            UINT32 height)
+{
+	UINT32 w = MAX(width, budget->planarWidth);
+	UINT32 h = MAX(height, budget->planarHeight);
+
+	if ((w == budget->planarWidth) && (h == budget->planarHeight) && budget->planar)
+		return TRUE;
+
+	if (1ull * w * h > GFX_CACHE_MAX_COMPRESSED_AREA)
+	{
+		w = width;
+		h = height;
+	}
+
+	if (!budget->planar)
+	{
+		budget->planar = freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_RLE, w, h);
+		if (budget->planar)
+			freerdp_planar_topdown_image(budget->planar, TRUE);
+	}
+	else if (!freerdp_bitmap_planar_context_reset(budget->planar, w, h))
+	{
+		freerdp_bitmap_planar_context_free(budget->planar);
+		budget->planar = NULL;
+	}
+
+	if (!budget->planar)
+	{
+		budget->planarWidth = 0;
+		budget->planarHeight = 0;
+		return FALSE;
+	}
+
+	budget->planarWidth = w;
+	budget->planarHeight = h;
+	return TRUE;
+}
+
+/* must be called with the budget locked */
+static void gdi_GfxCacheEntryCompress(gdiGfxCacheBudget* budget, gdiGfxCacheEntryEx* ex)
+{
+	gdiGfxCacheEntry* entry = &ex->entry;
+	const size_t size = gdi_GfxCacheEntrySize(ex);
+
+	if (!entry->data || (1ull * entry->width * entry->height > GFX_CACHE_MAX_COMPRESSED_AREA) ||
+	    !gdi_GfxCacheBudgetPreparePlanar(budget, entry->width, entry->height))
+	{
+		ex->incompressible = TRUE;
+		return;
+	}
+
+	UINT32 compressedSize = 0;
+	BYTE* compressed =
+	    freerdp_bitmap_compress_planar(budget->planar, entry->data, entry->format, entry->width,
+	                                   entry->height, entry->scanline, NULL, &compressedSize);
+	if (!compressed || (compressedSize >= size))
+	{
+		free(compressed);
+		ex->incompressible = TRUE;
+		return;
+	}
+
+	free(entry->data);
+	entry->data = NULL;
+	ex->compressed = compressed;
+	ex->compressedSize = compressedSize;
+	gdi_GfxCacheBudgetSub(budget, size - compressedSize);
+}
+
+/* must be called with the budget locked */
+static BOOL gdi_GfxCacheEntryDecompressTo(gdiGfxCacheBudget* budget, const gdiGfxCacheEntryEx* ex,
+                                          BYTE* dst)
+{
+	const gdiGfxCacheEntry* entry = &ex->entry;
+
+	if (!gdi_GfxCacheBudgetPreparePlanar(budget, entry->width, entry->height))
+		return FALSE;
+
+	return planar_decompress(budget->planar, ex->compressed, ex->compressedSize, entry->width,
+	                         entry->height, dst, entry->format, entry->scanline, 0, 0,
+	                         entry->width, entry->height, FALSE);
+}
+
+/**
+ * Compresses the least recently used entries once the cache exceeds its budget, down to 7/8 of
+ * it so the work is not repeated on every new entry. The most recently used entry is left as is.
+ */
+static void gdi_GfxCacheBudgetEnforce(gdiGfxCacheBudget* budget)
+{
+	if (!budget)
+		return;
+
+	EnterCriticalSection(&budget->lock);
+	if ((budget->limit > 0) && (budget->used > budget->limit))
+	{
+		const size_t target = budget->limit - budget->limit / 8;
+		for (gdiGfxCacheEntryEx* ex = budget->tail; ex && (ex != budget->head); ex = ex->prev)
+		{
+			if (budget->used <= target)
+				break;
+			if (!ex->compressed && !ex->incompressible)
+				gdi_GfxCacheEntryCompress(budget, ex);
+		}
+	}
+	LeaveCriticalSection(&budget->lock);
+}
+
+/**
+ * Marks an entry as most recently used and restores its bitmap if it was compressed.
+ */
+static BOOL gdi_GfxCacheEntryAcquire(gdiGfxCacheEntry* entry)
+{
+	gdiGfxCacheEntryEx* ex = (gdiGfxCacheEntryEx*)entry;
+	gdiGfxCacheBudget* budget = ex->budget;
+	BOOL rc = TRUE;
+
+	if (!budget)
+		return TRUE;
+
+	EnterCriticalSection(&budget->lock);
+	gdi_GfxCacheEntryUnlink(budget, ex);
+	gdi_GfxCacheEntryLinkHead(budget, ex);
+
+	if (ex->compressed)
+	{
+		BYTE* data = (BYTE*)calloc(entry->height, entry->scanline);
+		if (!data || !gdi_GfxCacheEntryDecompressTo(budget, ex, data))
+		{
+			free(data);
+			rc = FALSE;
+		}
+		else
+		{
+			gdi_GfxCacheBudgetSub(budget, ex->compressedSize);
+			gdi_GfxCacheBudgetAdd(budget, 1ull * entry->scanline * entry->height);
+			free(ex->compressed);
+			ex->compressed = NULL;
+			ex->compressedSize = 0;
+			entry->data = data;
+		}
+	}
+	ex->incompressible = FALSE;
+	LeaveCriticalSection(&budget->lock);
+	return rc;
+}
+
 static void gdi_GfxCacheEntryFree(gdiGfxCacheEntry* entry)
 {
+	gdiGfxCacheEntryEx* ex = (gdiGfxCacheEntryEx*)entry;
+
 	if (!entry)
 		return;
+
+	gdiGfxCacheBudget* budget = ex->budget;
+	if (budget)
+	{
+		EnterCriticalSection(&budget->lock);
+		gdi_GfxCacheBudgetSub(budget, gdi_GfxCacheEntrySize(ex));
+		gdi_GfxCacheEntryUnlink(budget, ex);
+		LeaveCriticalSection(&budget->lock);
+		gdi_GfxCacheBudgetRelease(budget);
+	}
+
+	free(ex->compressed);
 	free(entry->data);
-	free(entry);
+	free(ex);
 }
 
-static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(UINT64 cacheKey, UINT32 width, UINT32 height,
-                                              UINT32 format)
+static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(gdiGfxCacheBudget* budget, UINT64 cacheKey,
+                                              UINT32 width, UINT32 height, UINT32 format)
 {
-	gdiGfxCacheEntry* cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
-	if (!cacheEntry)
-		goto fail;
+	gdiGfxCacheEntryEx* ex = (gdiGfxCacheEntryEx*)calloc(1, sizeof(gdiGfxCacheEntryEx));
+	if (!ex)
+		return NULL;
 
+	gdiGfxCacheEntry* cacheEntry = &ex->entry;
 	cacheEntry->cacheKey = cacheKey;
 	cacheEntry->width = width;
 	cacheEntry->height = height;
@@ -1424,12 +1959,63 @@ static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(UINT64 cacheKey, UINT32 width, UIN
 		if (!cacheEntry->data)
 			goto fail;
 	}
+
+	if (budget)
+	{
+		EnterCriticalSection(&budget->lock);
+		budget->refs++;
+		gdi_GfxCacheBudgetAdd(budget, gdi_GfxCacheEntrySize(ex));
+		gdi_GfxCacheEntryLinkHead(budget, ex);
+		ex->budget = budget;
+		LeaveCriticalSection(&budget->lock);
+	}
 	return cacheEntry;
 fail:
 	gdi_GfxCacheEntryFree(cacheEntry);
 	return NULL;
 }
 
+/**
+ * The bitmap of an entry for export. A compressed entry is decompressed to a buffer of the
+ * budget, which stays valid until the next export, so exporting a cache does not undo its
+ * compression.
+ */
+static BYTE* gdi_GfxCacheEntryExportData(gdiGfxCacheEntry* entry)
+{
+	gdiGfxCacheEntryEx* ex = (gdiGfxCacheEntryEx*)entry;
+	gdiGfxCacheBudget* budget = ex->budget;
+	BYTE* data = entry->data;
+
+	if (!budget || !ex->compressed)
+		return data;
+
+	EnterCriticalSection(&budget->lock);
+	const size_t size = 1ull * entry->scanline * entry->height;
+	if (budget->scratchSize < size)
+	{
+		BYTE* tmp = (BYTE*)realloc(budget->scratch, size);
+		if (tmp)
+		{
+			budget->scratch = tmp;
+			budget->scratchSize = size;
+		}
+	}
+
+	if ((budget->scratchSize >= size) && gdi_GfxCacheEntryDecompressTo(budget, ex, budget->scratch))
+		data = budget->scratch;
+	LeaveCriticalSection(&budget->lock);
+	return data;
+}
+
+static gdiGfxCacheBudget* gdi_GfxCacheBudget(RdpgfxClientContext* context)
+{
+	WINPR_ASSERT(context);
+	const rdpGdi* gdi = (const rdpGdi*)context->custom;
+	if (!gdi)
+		return NULL;
+	return gdi->gfxCacheBudget;
+}
+
 /**
  * Function description
  *
@@ -1454,7 +2040,8 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!is_rect_valid(rect, surface->width, surface->height))
 		goto fail;
 
-	cacheEntry = gdi_GfxCacheEntryNew(surfaceToCache->cacheKey, (UINT32)(rect->right - rect->left),
+	cacheEntry = gdi_GfxCacheEntryNew(gdi_GfxCacheBudget(context), surfaceToCache->cacheKey,
+	                                  (UINT32)(rect->right - rect->left),
 	                                  (UINT32)(rect->bottom - rect->top), surface->format);
 
 	if (!cacheEntry)
@@ -1475,6 +2062,8 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 
 	WINPR_ASSERT(context->SetCacheSlotData);
 	rc = context->SetCacheSlotData(context, surfaceToCache->cacheSlot, (void*)cacheEntry);
+	if (rc == CHANNEL_RC_OK)
+		gdi_GfxCacheBudgetEnforce(gdi_GfxCacheBudget(context));
 fail:
 	if (rc != CHANNEL_RC_OK)
 		gdi_GfxCacheEntryFree(cacheEntry);
@@ -1494,6 +2083,8 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 	gdiGfxSurface* surface = NULL;
 	gdiGfxCacheEntry* cacheEntry = NULL;
 	RECTANGLE_16 invalidRect;
+	RECTANGLE_16* invalidRects = NULL;
+	UINT16 numInvalidRects = 0;
 	rdpGdi* gdi = (rdpGdi*)context->custom;
 
 	EnterCriticalSection(&context->mux);
@@ -1507,6 +2098,16 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 	if (!surface || !cacheEntry)
 		goto fail;
 
+	if (!gdi_GfxCacheEntryAcquire(cacheEntry))
+		goto fail;
+
+	if (cacheToSurface->destPtsCount > 0)
+	{
+		invalidRects = calloc(cacheToSurface->destPtsCount, sizeof(RECTANGLE_16));
+		if (!invalidRects)
+			goto fail;
+	}
+
 	for (UINT16 index = 0; index < cacheToSurface->destPtsCount; index++)
 	{
 		const RDPGFX_POINT16* destPt = &cacheToSurface->destPts[index];
@@ -1528,18 +2129,26 @@ static UINT gdi_CacheToSurface(RdpgfxClientContext* context,
 
 		invalidRect = rect;
 		region16_union_rect(&surface->invalidRegion, &surface->invalidRegion, &invalidRect);
+		invalidRects[numInvalidRects++] = invalidRect;
+	}
+
+	/* one notification for all destinations */
+	status = CHANNEL_RC_OK;
+	if (numInvalidRects > 0)
 		status = IFCALLRESULT(CHANNEL_RC_OK, context->UpdateSurfaceArea, context,
-		                      surface->surfaceId, 1, &invalidRect);
+		                      surface->surfaceId, numInvalidRects, invalidRects);
 
-		if (status != CHANNEL_RC_OK)
-			goto fail;
-	}
+	if (status != CHANNEL_RC_OK)
+		goto fail;
 
+	free(invalidRects);
+	gdi_GfxCacheBudgetEnforce(gdi_GfxCacheBudget(context));
 	LeaveCriticalSection(&context->mux);
 
 	return gdi_interFrameUpdate(gdi, context);
 
 fail:
+	free(invalidRects);
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1573,7 +2182,8 @@ static UINT gdi_CacheImportReply(RdpgfxClientContext* context,
 		if (cacheEntry)
 			continue;
 
-		cacheEntry = gdi_GfxCacheEntryNew(cacheSlot, 0, 0, PIXEL_FORMAT_BGRX32);
+		cacheEntry = gdi_GfxCacheEntryNew(gdi_GfxCacheBudget(context), cacheSlot, 0, 0,
+		                                  PIXEL_FORMAT_BGRX32);
 
 		if (!cacheEntry)
 			return ERROR_INTERNAL_ERROR;
@@ -1602,8 +2212,9 @@ static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
 	if (cacheSlot == 0)
 		return CHANNEL_RC_OK;
 
-	cacheEntry = gdi_GfxCacheEntryNew(importCacheEntry->key64, importCacheEntry->width,
-	                                  importCacheEntry->height, PIXEL_FORMAT_BGRX32);
+	cacheEntry = gdi_GfxCacheEntryNew(gdi_GfxCacheBudget(context), importCacheEntry->key64,
+	                                  importCacheEntry->width, importCacheEntry->height,
+	                                  PIXEL_FORMAT_BGRX32);
 
 	if (!cacheEntry)
 		goto fail;
@@ -1622,6 +2233,8 @@ static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
 
 	WINPR_ASSERT(context->SetCacheSlotData);
 	error = context->SetCacheSlotData(context, cacheSlot, (void*)cacheEntry);
+	if (error == CHANNEL_RC_OK)
+		gdi_GfxCacheBudgetEnforce(gdi_GfxCacheBudget(context));
 
 fail:
 	if (error)
@@ -1643,12 +2256,16 @@ static UINT gdi_ExportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
 
 	if (cacheEntry)
 	{
+		BYTE* data = gdi_GfxCacheEntryExportData(cacheEntry);
+		if (!data)
+			return ERROR_INTERNAL_ERROR;
+
 		exportCacheEntry->key64 = cacheEntry->cacheKey;
 		exportCacheEntry->width = (UINT16)MIN(UINT16_MAX, cacheEntry->width);
 		exportCacheEntry->height = (UINT16)MIN(UINT16_MAX, cacheEntry->height);
 		exportCacheEntry->size = cacheEntry->width * cacheEntry->height * 4;
 		exportCacheEntry->flags = 0;
-		exportCacheEntry->data = cacheEntry->data;
+		exportCacheEntry->data = data;
 		return CHANNEL_RC_OK;
 	}
 
@@ -1894,6 +2511,12 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 		if (!freerdp_client_codecs_prepare(gfx->codecs, FREERDP_CODEC_ALL, w, h))
 			return FALSE;
 	}
+	gdi_GfxCacheBudgetRelease(gdi->gfxCacheBudget);
+	gdi->gfxCacheBudget = gdi_GfxCacheBudgetNew(
+	    1ull * freerdp_settings_get_uint32(settings, FreeRDP_GfxCacheBudget) * 1024ull * 1024ull);
+	if (!gdi->gfxCacheBudget)
+		return FALSE;
+
 	InitializeCriticalSection(&gfx->mux);
 	PROFILER_CREATE(gfx->SurfaceProfiler, "GFX-PROFILER")
 
@@ -1917,7 +2540,11 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 {
 	if (gdi)
+	{
 		gdi->gfx = NULL;
+		gdi_GfxCacheBudgetRelease(gdi->gfxCacheBudget);
+		gdi->gfxCacheBudget = NULL;
+	}
 
 	if (!gfx)
 		return;
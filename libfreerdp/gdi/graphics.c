@@ -320,6 +320,107 @@ static void gdi_Glyph_Free(WINPR_ATTR_UNUSED rdpContext* context, rdpGlyph* glyp
 	}
 }
 
+static BOOL gdi_glyph_run_invalidate(rdpGdi* gdi, INT32 x, INT32 y, INT32 w, INT32 h)
+{
+	if (!gdi->glyphRun)
+		return gdi_InvalidateRegion(gdi->drawing->hdc, x, y, w, h);
+
+	GDI_RECT* rect = &gdi->glyphRunRect;
+
+	if (rect->right < rect->left)
+	{
+		rect->left = x;
+		rect->top = y;
+		rect->right = x + w - 1;
+		rect->bottom = y + h - 1;
+		return TRUE;
+	}
+
+	rect->left = MIN(rect->left, x);
+	rect->top = MIN(rect->top, y);
+	rect->right = MAX(rect->right, x + w - 1);
+	rect->bottom = MAX(rect->bottom, y + h - 1);
+	return TRUE;
+}
+
+static BOOL gdi_glyph_run_flush(rdpGdi* gdi)
+{
+	GDI_RECT* rect = &gdi->glyphRunRect;
+	BOOL rc = TRUE;
+
+	if (gdi->glyphRun && (rect->right >= rect->left))
+		rc = gdi_InvalidateRegion(gdi->drawing->hdc, rect->left, rect->top,
+		                          rect->right - rect->left + 1, rect->bottom - rect->top + 1);
+
+	rect->left = 0;
+	rect->top = 0;
+	rect->right = -1;
+	rect->bottom = -1;
+	return rc;
+}
+
+/* Expand the one byte per pixel glyph mask straight into the drawing
+ * surface. This is what a GDI_GLYPH_ORDER BitBlt with a solid text color
+ * brush does, without the brush and the generic ROP path. Returns FALSE
+ * if the fast path does not apply and the BitBlt has to be used. */
+static BOOL gdi_glyph_blit(rdpGdi* gdi, const gdiGlyph* gdi_glyph, INT32 x, INT32 y, INT32 w,
+                           INT32 h, INT32 sx, INT32 sy, BOOL* drawn)
+{
+	HGDI_DC hdc = gdi->drawing->hdc;
+	const GDI_BITMAP* src = gdi_glyph->bitmap;
+	const GDI_BITMAP* dst = (const GDI_BITMAP*)hdc->selectedObject;
+
+	if (!src || !dst || !dst->data || (FreeRDPGetBytesPerPixel(src->format) != 1))
+		return FALSE;
+
+	if (!gdi_ClipCoords(hdc, &x, &y, &w, &h, &sx, &sy))
+	{
+		*drawn = TRUE;
+		return TRUE;
+	}
+
+	if ((x < 0) || (y < 0) || (sx < 0) || (sy < 0) || (w <= 0) || (h <= 0) ||
+	    (x + w > dst->width) || (y + h > dst->height) || (sx + w > src->width) ||
+	    (sy + h > src->height))
+		return FALSE;
+
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(dst->format);
+	const UINT32 color = hdc->textColor;
+	UINT32 pixel = 0;
+
+	if (bpp == 4)
+		FreeRDPWriteColor((BYTE*)&pixel, dst->format, color);
+
+	for (INT32 row = 0; row < h; row++)
+	{
+		const BYTE* mask = &src->data[1ull * src->scanline * (UINT32)(sy + row) + (UINT32)sx];
+		BYTE* line = &dst->data[1ull * dst->scanline * (UINT32)(y + row) + 1ull * bpp * (UINT32)x];
+
+		if (bpp == 4)
+		{
+			/* branchless select, the mask bytes are either 0x00 or 0xFF */
+			UINT32* pixels = (UINT32*)line;
+
+			for (INT32 col = 0; col < w; col++)
+			{
+				const UINT32 m = 0u - (mask[col] != 0);
+				pixels[col] = (pixels[col] & ~m) | (pixel & m);
+			}
+		}
+		else
+		{
+			for (INT32 col = 0; col < w; col++)
+			{
+				if (mask[col])
+					FreeRDPWriteColor(&line[1ull * bpp * (UINT32)col], dst->format, color);
+			}
+		}
+	}
+
+	*drawn = gdi_glyph_run_invalidate(gdi, x, y, w, h);
+	return TRUE;
+}
+
 static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x, INT32 y, INT32 w,
                            INT32 h, INT32 sx, INT32 sy, BOOL fOpRedundant)
 {
@@ -362,6 +463,11 @@ static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x,
 		}
 	}
 
+	BOOL drawn = FALSE;
+
+	if (gdi_glyph_blit(gdi, gdi_glyph, x, y, w, h, sx, sy, &drawn))
+		return drawn;
+
 	brush = gdi_CreateSolidBrush(gdi->drawing->hdc->textColor);
 
 	if (!brush)
@@ -387,6 +493,12 @@ static BOOL gdi_Glyph_BeginDraw(rdpContext* context, INT32 x, INT32 y, INT32 wid
 	if (!gdi->drawing || !gdi->drawing->hdc)
 		return FALSE;
 
+	/* A run left open by a failed order still owes its invalidation. */
+	if (!gdi_glyph_run_flush(gdi))
+		return FALSE;
+
+	gdi->glyphRun = TRUE;
+
 	if (!fOpRedundant)
 	{
 		if (!gdi_decode_color(gdi, bgcolor, &bgcolor, NULL))
@@ -443,8 +555,10 @@ static BOOL gdi_Glyph_EndDraw(rdpContext* context, WINPR_ATTR_UNUSED INT32 x,
 	if (!gdi->drawing || !gdi->drawing->hdc)
 		return FALSE;
 
+	const BOOL rc = gdi_glyph_run_flush(gdi);
+	gdi->glyphRun = FALSE;
 	gdi_SetNullClipRgn(gdi->drawing->hdc);
-	return TRUE;
+	return rc;
 }
 
 /* Graphics Module */
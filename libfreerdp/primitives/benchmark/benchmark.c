@@ -31,6 +31,7 @@ typedef struct
 	prim_size_t roi;
 	BYTE* outputBuffer;
 	BYTE* outputChannels[3];
+	BYTE* auxChannels[3];
 	BYTE* rgbBuffer;
 	UINT32 outputStride;
 	UINT32 testedFormat;
@@ -47,6 +48,7 @@ static void primitives_YUV_benchmark_free(primitives_YUV_benchmark* bench)
 	for (size_t i = 0; i < 3; i++)
 	{
 		free(bench->outputChannels[i]);
+		free(bench->auxChannels[i]);
 		free(bench->channels[i]);
 	}
 
@@ -74,7 +76,8 @@ static primitives_YUV_benchmark primitives_YUV_benchmark_init(void)
 	{
 		ret.channels[i] = calloc(ret.roi.width, ret.roi.height);
 		ret.outputChannels[i] = calloc(ret.roi.width, ret.roi.height);
-		if (!ret.channels[i] || !ret.outputChannels[i])
+		ret.auxChannels[i] = calloc(ret.roi.width, ret.roi.height);
+		if (!ret.channels[i] || !ret.outputChannels[i] || !ret.auxChannels[i])
 			goto fail;
 
 		winpr_RAND(ret.channels[i], 1ull * ret.roi.width * ret.roi.height);
@@ -198,6 +201,70 @@ static BOOL primitives_RGB2444_benchmark_run(primitives_YUV_benchmark* bench, pr
 	return TRUE;
 }
 
+static BOOL primitives_RGB2AVC444_benchmark_run(primitives_YUV_benchmark* bench,
+                                                primitives_t* prims)
+{
+	for (size_t x = 0; x < 10; x++)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		pstatus_t status = prims->RGBToAVC444YUV(
+		    bench->rgbBuffer, bench->testedFormat, bench->outputStride, bench->outputChannels,
+		    bench->steps, bench->auxChannels, bench->steps, &bench->roi);
+		const UINT64 end = winpr_GetTickCount64NS();
+		if (status != PRIMITIVES_SUCCESS)
+		{
+			(void)fprintf(stderr, "Running RGBToAVC444YUV failed\n");
+			return FALSE;
+		}
+		const UINT64 diff = end - start;
+		char buffer[32] = { 0 };
+		printf("[%" PRIuz "] RGBToAVC444YUV %" PRIu32 "x%" PRIu32 " took %sns\n", x,
+		       bench->roi.width, bench->roi.height, print_time(diff, buffer, sizeof(buffer)));
+	}
+
+	return TRUE;
+}
+
+static BOOL primitives_AVC444Combine_benchmark_run(primitives_YUV_benchmark* bench,
+                                                   primitives_t* prims)
+{
+	const BYTE* channels[3] = { 0 };
+
+	for (size_t i = 0; i < 3; i++)
+		channels[i] = bench->channels[i];
+
+	/* The auxiliary view reads up to 16 lines past the rectangle */
+	const UINT32 height = bench->roi.height - 16;
+	const RECTANGLE_16 rect = { .left = 0,
+		                        .top = 0,
+		                        .right = WINPR_ASSERTING_INT_CAST(UINT16, bench->roi.width),
+		                        .bottom = WINPR_ASSERTING_INT_CAST(UINT16, height) };
+
+	for (size_t x = 0; x < 10; x++)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		pstatus_t status = prims->YUV420CombineToYUV444(
+		    AVC444_LUMA, channels, bench->steps, bench->roi.width, bench->roi.height,
+		    bench->outputChannels, bench->steps, &rect);
+		if (status == PRIMITIVES_SUCCESS)
+			status = prims->YUV420CombineToYUV444(
+			    AVC444_CHROMAv1, channels, bench->steps, bench->roi.width, bench->roi.height,
+			    bench->outputChannels, bench->steps, &rect);
+		const UINT64 end = winpr_GetTickCount64NS();
+		if (status != PRIMITIVES_SUCCESS)
+		{
+			(void)fprintf(stderr, "Running YUV420CombineToYUV444 failed\n");
+			return FALSE;
+		}
+		const UINT64 diff = end - start;
+		char buffer[32] = { 0 };
+		printf("[%" PRIuz "] YUV420CombineToYUV444 %" PRIu32 "x%" PRIu32 " took %sns\n", x,
+		       bench->roi.width, bench->roi.height, print_time(diff, buffer, sizeof(buffer)));
+	}
+
+	return TRUE;
+}
+
 int main(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -245,6 +312,22 @@ int main(int argc, char* argv[])
 			goto fail;
 		}
 		printf("\n");
+
+		printf("Running RGB -> AVC444 benchmark on %s implementation:\n", hintstr);
+		if (!primitives_RGB2AVC444_benchmark_run(&bench, prim))
+		{
+			(void)fprintf(stderr, "RGB -> AVC444 benchmark failed\n");
+			goto fail;
+		}
+		printf("\n");
+
+		printf("Running AVC444 -> YUV444 benchmark on %s implementation:\n", hintstr);
+		if (!primitives_AVC444Combine_benchmark_run(&bench, prim))
+		{
+			(void)fprintf(stderr, "AVC444 -> YUV444 benchmark failed\n");
+			goto fail;
+		}
+		printf("\n");
 	}
 fail:
 	primitives_YUV_benchmark_free(&bench);
@@ -20,6 +20,8 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/crt.h>
+
 #include <freerdp/types.h>
 #include <freerdp/primitives.h>
 #include "prim_internal.h"
@@ -43,16 +45,19 @@ typedef struct
 	cl_context context;
 	cl_command_queue commandQueue;
 	cl_program program;
+	char deviceName[2048];
 } primitives_opencl_context;
 
 typedef struct
 {
 	primitives_opencl_context* cl;
 	cl_kernel kernel;
-	cl_mem srcObjs[3];
-	cl_mem dstObj;
-	prim_size_t roi;
-	size_t dstStep;
+	cl_mem objs[7];
+	void* hostPtrs[7];
+	size_t sizes[7];
+	BOOL readBack[7];
+	size_t nobjs;
+	cl_uint nargs;
 } primitives_cl_kernel;
 
 static primitives_opencl_context* primitives_get_opencl_context(void);
@@ -62,13 +67,10 @@ static void cl_kernel_free(primitives_cl_kernel* kernel)
 	if (!kernel)
 		return;
 
-	if (kernel->dstObj)
-		clReleaseMemObject(kernel->dstObj);
-
-	for (size_t i = 0; i < ARRAYSIZE(kernel->srcObjs); i++)
+	for (size_t i = 0; i < kernel->nobjs; i++)
 	{
-		cl_mem obj = kernel->srcObjs[i];
-		kernel->srcObjs[i] = NULL;
+		cl_mem obj = kernel->objs[i];
+		kernel->objs[i] = NULL;
 		if (obj)
 			clReleaseMemObject(obj);
 	}
@@ -79,16 +81,14 @@ static void cl_kernel_free(primitives_cl_kernel* kernel)
 	free(kernel);
 }
 
-static primitives_cl_kernel* cl_kernel_new(const char* kernelName, const prim_size_t* roi)
+static primitives_cl_kernel* cl_kernel_new(const char* kernelName)
 {
 	WINPR_ASSERT(kernelName);
-	WINPR_ASSERT(roi);
 
 	primitives_cl_kernel* kernel = calloc(1, sizeof(primitives_cl_kernel));
 	if (!kernel)
 		goto fail;
 
-	kernel->roi = *roi;
 	kernel->cl = primitives_get_opencl_context();
 	if (!kernel->cl)
 		goto fail;
@@ -107,86 +107,108 @@ fail:
 	return NULL;
 }
 
-static BOOL cl_kernel_set_sources(primitives_cl_kernel* ctx, const BYTE* WINPR_RESTRICT pSrc[3],
-                                  const UINT32 srcStep[3])
+static BOOL cl_kernel_add_uint(primitives_cl_kernel* ctx, const char* name, UINT32 value)
 {
-	const char* sourceNames[] = { "Y", "U", "V" };
-
 	WINPR_ASSERT(ctx);
-	WINPR_ASSERT(pSrc);
-	WINPR_ASSERT(srcStep);
 
-	for (cl_uint i = 0; i < ARRAYSIZE(ctx->srcObjs); i++)
+	const cl_uint val = value;
+	const cl_int ret = clSetKernelArg(ctx->kernel, ctx->nargs++, sizeof(cl_uint), &val);
+	if (ret != CL_SUCCESS)
 	{
-		cl_int ret = CL_INVALID_VALUE;
-		const BYTE* csrc = pSrc[i];
-		void* WINPR_RESTRICT src = WINPR_CAST_CONST_PTR_AWAY(csrc, void* WINPR_RESTRICT);
-		ctx->srcObjs[i] = clCreateBuffer(ctx->cl->context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-		                                 1ull * srcStep[i] * ctx->roi.height, src, &ret);
-		if (ret != CL_SUCCESS)
-		{
-			WLog_ERR(TAG, "unable to create %sobj", sourceNames[i]);
-			return FALSE;
-		}
-
-		ret = clSetKernelArg(ctx->kernel, i * 2, sizeof(cl_mem), (const void*)&ctx->srcObjs[i]);
-		if (ret != CL_SUCCESS)
-		{
-			WLog_ERR(TAG, "unable to set arg for %sobj", sourceNames[i]);
-			return FALSE;
-		}
-
-		ret = clSetKernelArg(ctx->kernel, i * 2 + 1, sizeof(cl_uint), &srcStep[i]);
-		if (ret != CL_SUCCESS)
-		{
-			WLog_ERR(TAG, "unable to set arg stride for %sobj", sourceNames[i]);
-			return FALSE;
-		}
+		WLog_ERR(TAG, "unable to set arg %s", name);
+		return FALSE;
 	}
 
 	return TRUE;
 }
 
-static BOOL cl_kernel_set_destination(primitives_cl_kernel* ctx, UINT32 dstStep)
+/**
+ * Wraps a host buffer of rows lines with step bytes each and passes it to the kernel
+ * followed by its step. The buffers use the host memory directly, so lines outside the
+ * ROI are preserved when output buffers are read back.
+ */
+static BOOL cl_kernel_add_buffer(primitives_cl_kernel* ctx, const char* name, const BYTE* ptr,
+                                 UINT32 step, size_t rows, BOOL output)
 {
-
 	WINPR_ASSERT(ctx);
+	WINPR_ASSERT(ptr);
+
+	if (ctx->nobjs >= ARRAYSIZE(ctx->objs))
+		return FALSE;
 
-	ctx->dstStep = dstStep;
+	const size_t i = ctx->nobjs++;
+	const cl_mem_flags flags = output ? CL_MEM_READ_WRITE : CL_MEM_READ_ONLY;
 	cl_int ret = CL_INVALID_VALUE;
-	ctx->dstObj = clCreateBuffer(ctx->cl->context, CL_MEM_WRITE_ONLY,
-	                             1ull * dstStep * ctx->roi.height, NULL, &ret);
+	void* host = WINPR_CAST_CONST_PTR_AWAY(ptr, void*);
+
+	ctx->hostPtrs[i] = host;
+	ctx->sizes[i] = 1ull * step * rows;
+	ctx->readBack[i] = output;
+	ctx->objs[i] =
+	    clCreateBuffer(ctx->cl->context, flags | CL_MEM_USE_HOST_PTR, ctx->sizes[i], host, &ret);
 	if (ret != CL_SUCCESS)
 	{
-		WLog_ERR(TAG, "unable to create dest obj");
+		WLog_ERR(TAG, "unable to create %sobj", name);
 		return FALSE;
 	}
 
-	ret = clSetKernelArg(ctx->kernel, 6, sizeof(cl_mem), (const void*)&ctx->dstObj);
+	ret = clSetKernelArg(ctx->kernel, ctx->nargs++, sizeof(cl_mem), (const void*)&ctx->objs[i]);
 	if (ret != CL_SUCCESS)
 	{
-		WLog_ERR(TAG, "unable to set arg destObj");
+		WLog_ERR(TAG, "unable to set arg for %sobj", name);
 		return FALSE;
 	}
 
-	ret = clSetKernelArg(ctx->kernel, 7, sizeof(cl_uint), &dstStep);
-	if (ret != CL_SUCCESS)
+	return cl_kernel_add_uint(ctx, name, step);
+}
+
+static BOOL cl_kernel_set_sources(primitives_cl_kernel* ctx, const BYTE* WINPR_RESTRICT pSrc[3],
+                                  const UINT32 srcStep[3], const size_t rows[3])
+{
+	const char* sourceNames[] = { "Y", "U", "V" };
+
+	WINPR_ASSERT(ctx);
+	WINPR_ASSERT(pSrc);
+	WINPR_ASSERT(srcStep);
+
+	for (size_t i = 0; i < ARRAYSIZE(sourceNames); i++)
 	{
-		WLog_ERR(TAG, "unable to set arg dstStep");
-		return FALSE;
+		if (!cl_kernel_add_buffer(ctx, sourceNames[i], pSrc[i], srcStep[i], rows[i], FALSE))
+			return FALSE;
 	}
 
 	return TRUE;
 }
 
-static BOOL cl_kernel_process(primitives_cl_kernel* ctx, BYTE* pDst)
+static BOOL cl_kernel_set_destinations(primitives_cl_kernel* ctx, const char* destNames[3],
+                                       BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                       const size_t rows[3])
 {
 	WINPR_ASSERT(ctx);
+	WINPR_ASSERT(destNames);
 	WINPR_ASSERT(pDst);
+	WINPR_ASSERT(dstStep);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		if (!cl_kernel_add_buffer(ctx, destNames[i], pDst[i], dstStep[i], rows[i], TRUE))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Enqueues the kernel and the transfers of all output buffers without blocking, so the
+ * whole call only waits once for the command queue to drain.
+ */
+static BOOL cl_kernel_process(primitives_cl_kernel* ctx, size_t width, size_t height)
+{
+	WINPR_ASSERT(ctx);
 
 	size_t indexes[2] = { 0 };
-	indexes[0] = ctx->roi.width;
-	indexes[1] = ctx->roi.height;
+	indexes[0] = width;
+	indexes[1] = height;
 
 	cl_int ret = clEnqueueNDRangeKernel(ctx->cl->commandQueue, ctx->kernel, 2, NULL, indexes, NULL,
 	                                    0, NULL, NULL);
@@ -196,12 +218,26 @@ static BOOL cl_kernel_process(primitives_cl_kernel* ctx, BYTE* pDst)
 		return FALSE;
 	}
 
-	/* Transfer result to host */
-	ret = clEnqueueReadBuffer(ctx->cl->commandQueue, ctx->dstObj, CL_TRUE, 0,
-	                          ctx->roi.height * ctx->dstStep, pDst, 0, NULL, NULL);
+	/* Transfer results to host */
+	for (size_t i = 0; i < ctx->nobjs; i++)
+	{
+		if (!ctx->readBack[i])
+			continue;
+
+		ret = clEnqueueReadBuffer(ctx->cl->commandQueue, ctx->objs[i], CL_FALSE, 0,
+		                          ctx->sizes[i], ctx->hostPtrs[i], 0, NULL, NULL);
+		if (ret != CL_SUCCESS)
+		{
+			WLog_ERR(TAG, "unable to read back buffer");
+			(void)clFinish(ctx->cl->commandQueue);
+			return FALSE;
+		}
+	}
+
+	ret = clFinish(ctx->cl->commandQueue);
 	if (ret != CL_SUCCESS)
 	{
-		WLog_ERR(TAG, "unable to read back buffer");
+		WLog_ERR(TAG, "unable to finish command queue");
 		return FALSE;
 	}
 
@@ -209,22 +245,23 @@ static BOOL cl_kernel_process(primitives_cl_kernel* ctx, BYTE* pDst)
 }
 
 static pstatus_t opencl_YUVToRGB(const char* kernelName, const BYTE* WINPR_RESTRICT pSrc[3],
-                                 const UINT32 srcStep[3], BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                 const UINT32 srcStep[3], const size_t srcRows[3],
+                                 BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
                                  const prim_size_t* WINPR_RESTRICT roi)
 {
 	pstatus_t res = -1;
 
-	primitives_cl_kernel* ctx = cl_kernel_new(kernelName, roi);
+	primitives_cl_kernel* ctx = cl_kernel_new(kernelName);
 	if (!ctx)
 		goto fail;
 
-	if (!cl_kernel_set_sources(ctx, pSrc, srcStep))
+	if (!cl_kernel_set_sources(ctx, pSrc, srcStep, srcRows))
 		goto fail;
 
-	if (!cl_kernel_set_destination(ctx, dstStep))
+	if (!cl_kernel_add_buffer(ctx, "dest", pDst, dstStep, roi->height, TRUE))
 		goto fail;
 
-	if (!cl_kernel_process(ctx, pDst))
+	if (!cl_kernel_process(ctx, roi->width, roi->height))
 		goto fail;
 
 	res = PRIMITIVES_SUCCESS;
@@ -333,6 +370,8 @@ static BOOL primitives_init_opencl_context(primitives_opencl_context* WINPR_REST
 
 		WLog_INFO(TAG, "openCL: using platform=%s device=%s", platformName, deviceName);
 
+		(void)_snprintf(prims->deviceName, sizeof(prims->deviceName), "%s %s", platformName,
+		                deviceName);
 		prims->platformId = platform_ids[i];
 		prims->deviceId = device_id;
 		prims->context = context;
@@ -434,7 +473,8 @@ static pstatus_t opencl_YUV420ToRGB_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc[3]
 		}
 	}
 
-	return opencl_YUVToRGB(kernel_name, pSrc, srcStep, pDst, dstStep, roi);
+	const size_t rows[3] = { roi->height, (roi->height + 1) / 2, (roi->height + 1) / 2 };
+	return opencl_YUVToRGB(kernel_name, pSrc, srcStep, rows, pDst, dstStep, roi);
 }
 
 static pstatus_t opencl_YUV444ToRGB_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc[3],
@@ -479,7 +519,179 @@ static pstatus_t opencl_YUV444ToRGB_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc[3]
 		}
 	}
 
-	return opencl_YUVToRGB(kernel_name, pSrc, srcStep, pDst, dstStep, roi);
+	const size_t rows[3] = { roi->height, roi->height, roi->height };
+	return opencl_YUVToRGB(kernel_name, pSrc, srcStep, rows, pDst, dstStep, roi);
+}
+
+static pstatus_t opencl_RGBToYUV420_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc, UINT32 SrcFormat,
+                                              UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[3],
+                                              const UINT32 dstStep[3],
+                                              const prim_size_t* WINPR_RESTRICT roi)
+{
+	const char* kernel_name = NULL;
+
+	switch (SrcFormat)
+	{
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			kernel_name = "bgrx_to_yuv420";
+			break;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			kernel_name = "rgbx_to_yuv420";
+			break;
+		default:
+		{
+			primitives_t* p = primitives_get_by_type(PRIMITIVES_ONLY_CPU);
+			if (!p)
+				return -1;
+			return p->RGBToYUV420_8u_P3AC4R(pSrc, SrcFormat, srcStep, pDst, dstStep, roi);
+		}
+	}
+
+	pstatus_t res = -1;
+	const size_t halfWidth = (roi->width + 1) / 2;
+	const size_t halfHeight = (roi->height + 1) / 2;
+	const size_t rows[3] = { roi->height, halfHeight, halfHeight };
+
+	primitives_cl_kernel* ctx = cl_kernel_new(kernel_name);
+	if (!ctx)
+		goto fail;
+
+	if (!cl_kernel_add_buffer(ctx, "src", pSrc, srcStep, roi->height, FALSE))
+		goto fail;
+
+	const char* names[] = { "Y", "U", "V" };
+	if (!cl_kernel_set_destinations(ctx, names, pDst, dstStep, rows))
+		goto fail;
+
+	if (!cl_kernel_add_uint(ctx, "width", roi->width) ||
+	    !cl_kernel_add_uint(ctx, "height", roi->height))
+		goto fail;
+
+	if (!cl_kernel_process(ctx, halfWidth, halfHeight))
+		goto fail;
+
+	res = PRIMITIVES_SUCCESS;
+
+fail:
+	cl_kernel_free(ctx);
+	return res;
+}
+
+static pstatus_t opencl_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pMainDst[3],
+                                       const UINT32 dstMainStep[3],
+                                       BYTE* WINPR_RESTRICT pAuxDst[3],
+                                       const UINT32 dstAuxStep[3],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	const char* kernel_name = NULL;
+
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			kernel_name = "bgrx_to_avc444";
+			break;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			kernel_name = "rgbx_to_avc444";
+			break;
+		default:
+		{
+			primitives_t* p = primitives_get_by_type(PRIMITIVES_ONLY_CPU);
+			if (!p)
+				return -1;
+			return p->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pMainDst, dstMainStep, pAuxDst,
+			                         dstAuxStep, roi);
+		}
+	}
+
+	if (!pSrc || !pMainDst || !dstMainStep || !pAuxDst || !dstAuxStep)
+		return -1;
+
+	pstatus_t res = -1;
+	const size_t halfWidth = (roi->width + 1) / 2;
+	const size_t halfHeight = (roi->height + 1) / 2;
+	const size_t mainRows[3] = { roi->height, halfHeight, halfHeight };
+
+	/* The auxiliary luma plane stores the odd lines in blocks of 16 lines, B4 and B5 */
+	size_t auxLumaRows = roi->height;
+	if (roi->height >= 2)
+	{
+		const size_t last = roi->height / 2 - 1;
+		auxLumaRows = MAX(auxLumaRows, (last & ~(size_t)7) + last + 9);
+	}
+	const size_t auxRows[3] = { auxLumaRows, halfHeight, halfHeight };
+
+	primitives_cl_kernel* ctx = cl_kernel_new(kernel_name);
+	if (!ctx)
+		goto fail;
+
+	if (!cl_kernel_add_buffer(ctx, "src", pSrc, srcStep, roi->height, FALSE))
+		goto fail;
+
+	const char* mainNames[] = { "mainY", "mainU", "mainV" };
+	if (!cl_kernel_set_destinations(ctx, mainNames, pMainDst, dstMainStep, mainRows))
+		goto fail;
+
+	const char* auxNames[] = { "auxY", "auxU", "auxV" };
+	if (!cl_kernel_set_destinations(ctx, auxNames, pAuxDst, dstAuxStep, auxRows))
+		goto fail;
+
+	if (!cl_kernel_add_uint(ctx, "width", roi->width) ||
+	    !cl_kernel_add_uint(ctx, "height", roi->height))
+		goto fail;
+
+	if (!cl_kernel_process(ctx, halfWidth, halfHeight))
+		goto fail;
+
+	res = PRIMITIVES_SUCCESS;
+
+fail:
+	cl_kernel_free(ctx);
+	return res;
+}
+
+static pstatus_t opencl_alphaComp_argb(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                       const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                       BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 width,
+                                       UINT32 height)
+{
+	pstatus_t res = -1;
+
+	if ((width == 0) || (height == 0))
+		return PRIMITIVES_SUCCESS;
+
+	primitives_cl_kernel* ctx = cl_kernel_new("alpha_comp_argb");
+	if (!ctx)
+		goto fail;
+
+	if (!cl_kernel_add_buffer(ctx, "src1", pSrc1, src1Step, height, FALSE))
+		goto fail;
+
+	if (!cl_kernel_add_buffer(ctx, "src2", pSrc2, src2Step, height, FALSE))
+		goto fail;
+
+	if (!cl_kernel_add_buffer(ctx, "dest", pDst, dstStep, height, TRUE))
+		goto fail;
+
+	if (!cl_kernel_process(ctx, width, height))
+		goto fail;
+
+	res = PRIMITIVES_SUCCESS;
+
+fail:
+	cl_kernel_free(ctx);
+	return res;
+}
+
+const char* primitives_opencl_device_name(void)
+{
+	if (!openclContext.support)
+		return NULL;
+	return openclContext.deviceName;
 }
 
 BOOL primitives_init_opencl(primitives_t* prims)
@@ -494,6 +706,9 @@ BOOL primitives_init_opencl(primitives_t* prims)
 
 	prims->YUV420ToRGB_8u_P3AC4R = opencl_YUV420ToRGB_8u_P3AC4R;
 	prims->YUV444ToRGB_8u_P3AC4R = opencl_YUV444ToRGB_8u_P3AC4R;
+	prims->RGBToYUV420_8u_P3AC4R = opencl_RGBToYUV420_8u_P3AC4R;
+	prims->RGBToAVC444YUV = opencl_RGBToAVC444YUV;
+	prims->alphaComp_argb = opencl_alphaComp_argb;
 	prims->flags |= PRIM_FLAGS_HAVE_EXTGPU;
 	prims->uninit = primitives_uninit_opencl;
 	return TRUE;
@@ -472,3 +472,217 @@ __kernel void yuv444_to_xrgb_1b(__global const uchar* bufY, unsigned strideY,
 	destPtr[1] = clamp_uc((y256 + (403 * E)) >> 8, 0, 255);            /* R */
 	destPtr[0] = 0xff;                                                 /* A */
 }
+
+uchar rgb_to_y(int R, int G, int B)
+{
+	return (uchar)((54 * R + 183 * G + 18 * B) >> 8);
+}
+
+uchar rgb_to_u(int R, int G, int B)
+{
+	return (uchar)(((-29 * R - 99 * G + 128 * B) >> 8) + 128);
+}
+
+uchar rgb_to_v(int R, int G, int B)
+{
+	return (uchar)(((128 * R - 116 * G - 12 * B) >> 8) + 128);
+}
+
+/**
+ * Every work item converts a block of 2x2 pixels, the chroma is computed from the
+ * average color of the block. Missing pixels on odd sized edges count as black,
+ * which matches the CPU implementation.
+ */
+void rgb_to_yuv420(__global const uchar* src, unsigned strideSrc, __global uchar* bufY,
+                   unsigned strideY, __global uchar* bufU, unsigned strideU, __global uchar* bufV,
+                   unsigned strideV, unsigned width, unsigned height, unsigned rOff, unsigned bOff)
+{
+	unsigned int x = get_global_id(0);
+	unsigned int y = get_global_id(1);
+	int Ra = 0;
+	int Ga = 0;
+	int Ba = 0;
+
+	for (unsigned int j = 2 * y; j < min(2 * y + 2, height); j++)
+	{
+		for (unsigned int i = 2 * x; i < min(2 * x + 2, width); i++)
+		{
+			__global const uchar* srcPtr = src + (strideSrc * j) + (i * 4);
+			const int R = srcPtr[rOff];
+			const int G = srcPtr[1];
+			const int B = srcPtr[bOff];
+
+			bufY[j * strideY + i] = rgb_to_y(R, G, B);
+			Ra += R;
+			Ga += G;
+			Ba += B;
+		}
+	}
+
+	Ra >>= 2;
+	Ga >>= 2;
+	Ba >>= 2;
+	bufU[y * strideU + x] = rgb_to_u(Ra, Ga, Ba);
+	bufV[y * strideV + x] = rgb_to_v(Ra, Ga, Ba);
+}
+
+__kernel void bgrx_to_yuv420(__global const uchar* src, unsigned strideSrc, __global uchar* bufY,
+                             unsigned strideY, __global uchar* bufU, unsigned strideU,
+                             __global uchar* bufV, unsigned strideV, unsigned width,
+                             unsigned height)
+{
+	rgb_to_yuv420(src, strideSrc, bufY, strideY, bufU, strideU, bufV, strideV, width, height, 2,
+	              0);
+}
+
+__kernel void rgbx_to_yuv420(__global const uchar* src, unsigned strideSrc, __global uchar* bufY,
+                             unsigned strideY, __global uchar* bufU, unsigned strideU,
+                             __global uchar* bufV, unsigned strideV, unsigned width,
+                             unsigned height)
+{
+	rgb_to_yuv420(src, strideSrc, bufY, strideY, bufU, strideU, bufV, strideV, width, height, 0,
+	              2);
+}
+
+/**
+ * Every work item splits a block of 2x2 pixels into the main and auxiliary AVC444 views
+ * of MS-RDPEGFX 3.3.8.3.2, see general_RGBToAVC444YUV_BGRX_DOUBLE_ROW for the layout.
+ */
+void rgb_to_avc444(__global const uchar* src, unsigned strideSrc, __global uchar* mainY,
+                   unsigned strideMainY, __global uchar* mainU, unsigned strideMainU,
+                   __global uchar* mainV, unsigned strideMainV, __global uchar* auxY,
+                   unsigned strideAuxY, __global uchar* auxU, unsigned strideAuxU,
+                   __global uchar* auxV, unsigned strideAuxV, unsigned width, unsigned height,
+                   unsigned rOff, unsigned bOff)
+{
+	unsigned int x = get_global_id(0);
+	unsigned int y = get_global_id(1);
+	const unsigned int i = 2 * x;
+	const unsigned int j = 2 * y;
+	const bool lastX = (i + 1) >= width;
+	const bool haveOdd = (j + 1) < height;
+
+	__global const uchar* srcEven = src + (strideSrc * j) + (i * 4);
+	__global const uchar* srcOdd = srcEven + strideSrc;
+
+	const uchar Y1e = rgb_to_y(srcEven[rOff], srcEven[1], srcEven[bOff]);
+	const uchar U1e = rgb_to_u(srcEven[rOff], srcEven[1], srcEven[bOff]);
+	const uchar V1e = rgb_to_v(srcEven[rOff], srcEven[1], srcEven[bOff]);
+	uchar U2e = U1e;
+	uchar V2e = V1e;
+	uchar U1o = U1e;
+	uchar V1o = V1e;
+
+	mainY[j * strideMainY + i] = Y1e;
+
+	if (!lastX)
+	{
+		mainY[j * strideMainY + i + 1] = rgb_to_y(srcEven[4 + rOff], srcEven[5], srcEven[4 + bOff]);
+		U2e = rgb_to_u(srcEven[4 + rOff], srcEven[5], srcEven[4 + bOff]);
+		V2e = rgb_to_v(srcEven[4 + rOff], srcEven[5], srcEven[4 + bOff]);
+	}
+
+	if (haveOdd)
+	{
+		mainY[(j + 1) * strideMainY + i] = rgb_to_y(srcOdd[rOff], srcOdd[1], srcOdd[bOff]);
+		U1o = rgb_to_u(srcOdd[rOff], srcOdd[1], srcOdd[bOff]);
+		V1o = rgb_to_v(srcOdd[rOff], srcOdd[1], srcOdd[bOff]);
+	}
+
+	uchar U2o = U1o;
+	uchar V2o = V1o;
+
+	if (haveOdd && !lastX)
+	{
+		mainY[(j + 1) * strideMainY + i + 1] =
+		    rgb_to_y(srcOdd[4 + rOff], srcOdd[5], srcOdd[4 + bOff]);
+		U2o = rgb_to_u(srcOdd[4 + rOff], srcOdd[5], srcOdd[4 + bOff]);
+		V2o = rgb_to_v(srcOdd[4 + rOff], srcOdd[5], srcOdd[4 + bOff]);
+	}
+
+	/* B2 and B3, the averaged chroma of the main view */
+	mainU[y * strideMainU + x] = (uchar)(((ushort)U1e + U2e + U1o + U2o) / 4);
+	mainV[y * strideMainV + x] = (uchar)(((ushort)V1e + V2e + V1o + V2o) / 4);
+
+	/* B4 and B5, the odd rows go to the luma plane of the auxiliary view */
+	if (haveOdd)
+	{
+		const unsigned int n = (y & ~7u) + y;
+		__global uchar* b4 = auxY + (n * strideAuxY) + i;
+		__global uchar* b5 = b4 + (8 * strideAuxY);
+
+		b4[0] = U1o;
+		b5[0] = V1o;
+		if (!lastX)
+		{
+			b4[1] = U2o;
+			b5[1] = V2o;
+		}
+	}
+
+	/* B6 and B7, the odd columns of the even rows */
+	if (!lastX)
+	{
+		auxU[y * strideAuxU + x] = U2e;
+		auxV[y * strideAuxV + x] = V2e;
+	}
+}
+
+__kernel void bgrx_to_avc444(__global const uchar* src, unsigned strideSrc, __global uchar* mainY,
+                             unsigned strideMainY, __global uchar* mainU, unsigned strideMainU,
+                             __global uchar* mainV, unsigned strideMainV, __global uchar* auxY,
+                             unsigned strideAuxY, __global uchar* auxU, unsigned strideAuxU,
+                             __global uchar* auxV, unsigned strideAuxV, unsigned width,
+                             unsigned height)
+{
+	rgb_to_avc444(src, strideSrc, mainY, strideMainY, mainU, strideMainU, mainV, strideMainV, auxY,
+	              strideAuxY, auxU, strideAuxU, auxV, strideAuxV, width, height, 2, 0);
+}
+
+__kernel void rgbx_to_avc444(__global const uchar* src, unsigned strideSrc, __global uchar* mainY,
+                             unsigned strideMainY, __global uchar* mainU, unsigned strideMainU,
+                             __global uchar* mainV, unsigned strideMainV, __global uchar* auxY,
+                             unsigned strideAuxY, __global uchar* auxU, unsigned strideAuxU,
+                             __global uchar* auxV, unsigned strideAuxV, unsigned width,
+                             unsigned height)
+{
+	rgb_to_avc444(src, strideSrc, mainY, strideMainY, mainU, strideMainU, mainV, strideMainV, auxY,
+	              strideAuxY, auxU, strideAuxU, auxV, strideAuxV, width, height, 0, 2);
+}
+
+/**
+ * Blends src1 over src2 with the alpha of src1, one work item per pixel.
+ * Uses the same (alpha + 1) / 256 packed approximation as general_alphaComp_argb.
+ */
+__kernel void alpha_comp_argb(__global const uchar* src1, unsigned strideSrc1,
+                              __global const uchar* src2, unsigned strideSrc2,
+                              __global uchar* dest, unsigned strideDest)
+{
+	unsigned int x = get_global_id(0);
+	unsigned int y = get_global_id(1);
+
+	__global const uchar* src1Ptr = src1 + (strideSrc1 * y) + (x * 4);
+	__global const uchar* src2Ptr = src2 + (strideSrc2 * y) + (x * 4);
+	__global uchar* destPtr = dest + (strideDest * y) + (x * 4);
+
+	const uint s1 = src1Ptr[0] | (src1Ptr[1] << 8) | (src1Ptr[2] << 16) | ((uint)src1Ptr[3] << 24);
+	const uint s2 = src2Ptr[0] | (src2Ptr[1] << 8) | (src2Ptr[2] << 16) | ((uint)src2Ptr[3] << 24);
+	const uint alpha = (s1 >> 24) + 1;
+	uint d = s2;
+
+	if (alpha == 256)
+		d = s1;
+	else if (alpha > 1)
+	{
+		const uint s2rb = s2 & 0x00FF00FFu;
+		const uint s2ag = (s2 >> 8) & 0x00FF00FFu;
+		const uint drb = ((s1 & 0x00FF00FFu) - s2rb) * alpha;
+		const uint dag = (((s1 >> 8) & 0x00FF00FFu) - s2ag) * alpha;
+		d = (((drb >> 8) + s2rb) & 0x00FF00FFu) | ((((dag >> 8) + s2ag) << 8) & 0xFF00FF00u);
+	}
+
+	destPtr[0] = d & 0xFF;
+	destPtr[1] = (d >> 8) & 0xFF;
+	destPtr[2] = (d >> 16) & 0xFF;
+	destPtr[3] = (d >> 24) & 0xFF;
+}
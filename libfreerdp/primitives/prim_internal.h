@@ -337,6 +337,9 @@ FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* WINPR_RESTRICT prims);
 
 #if defined(WITH_OPENCL)
 FREERDP_LOCAL BOOL primitives_init_opencl(primitives_t* WINPR_RESTRICT prims);
+
+/** @brief platform and name of the device used, \b NULL if OpenCL is not available */
+FREERDP_LOCAL const char* primitives_opencl_device_name(void);
 #endif
 
 #endif /* FREERDP_LIB_PRIM_INTERNAL_H */
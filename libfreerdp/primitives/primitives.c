@@ -18,13 +18,18 @@
 
 #include <freerdp/config.h>
 
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include <winpr/synch.h>
 #include <winpr/sysinfo.h>
 #include <winpr/crypto.h>
+#include <winpr/path.h>
+#include <winpr/string.h>
 #include <freerdp/primitives.h>
+#include <freerdp/version.h>
+#include <freerdp/utils/helpers.h>
 
 #include "prim_internal.h"
 
@@ -109,107 +114,417 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	return TRUE;
 }
 
+struct prim_benchmark
+{
+	const char* name;
+	primitives_t* prims;
+	UINT32 flags;
+	UINT32 count;
+};
+
+/* file to persist the per function autodetection results in, resolved on first use */
+static char* primitivesProfile = NULL;
+static BOOL primitivesProfileSet = FALSE;
+
+BOOL primitives_set_profile_path(const char* path)
+{
+	char* copy = NULL;
+
+	if (path)
+	{
+		copy = _strdup(path);
+		if (!copy)
+			return FALSE;
+	}
+
+	free(primitivesProfile);
+	primitivesProfile = copy;
+	primitivesProfileSet = TRUE;
+	return TRUE;
+}
+
 #if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES) && defined(WITH_OPENCL)
 typedef struct
 {
 	BYTE* channels[3];
+	BYTE* auxChannels[3];
 	UINT32 steps[3];
 	prim_size_t roi;
+	BYTE* inputBuffer;
 	BYTE* outputBuffer;
+	BYTE* compBuffer;
 	UINT32 outputStride;
 	UINT32 testedFormat;
 } primitives_YUV_benchmark;
 
+typedef pstatus_t (*primitives_benchmark_fn)(primitives_YUV_benchmark* bench,
+                                             const primitives_t* prims);
+
+typedef void (*primitives_fkt_t)(void);
+
+typedef struct
+{
+	const char* name;
+	size_t offset;
+	primitives_benchmark_fn fkt;
+} primitives_tunable;
+
 static void primitives_YUV_benchmark_free(primitives_YUV_benchmark* bench)
 {
 	if (!bench)
 		return;
 
+	free(bench->inputBuffer);
 	free(bench->outputBuffer);
+	free(bench->compBuffer);
 
 	for (int i = 0; i < 3; i++)
+	{
 		free(bench->channels[i]);
+		free(bench->auxChannels[i]);
+	}
 	memset(bench, 0, sizeof(primitives_YUV_benchmark));
 }
 
 static primitives_YUV_benchmark* primitives_YUV_benchmark_init(primitives_YUV_benchmark* ret)
 {
-	prim_size_t* roi = NULL;
 	if (!ret)
 		return NULL;
 
+	/* Allocated for the largest size benchmarked, the AVC444 auxiliary view is 16 line aligned */
+	const UINT32 width = 1920;
+	const UINT32 height = 1088;
+
 	memset(ret, 0, sizeof(primitives_YUV_benchmark));
-	roi = &ret->roi;
-	roi->width = 1024;
-	roi->height = 768;
-	ret->outputStride = roi->width * 4;
+	ret->outputStride = width * 4;
 	ret->testedFormat = PIXEL_FORMAT_BGRA32;
 
-	ret->outputBuffer = calloc(ret->outputStride, roi->height);
-	if (!ret->outputBuffer)
+	ret->inputBuffer = calloc(ret->outputStride, height);
+	ret->outputBuffer = calloc(ret->outputStride, height);
+	ret->compBuffer = calloc(ret->outputStride, height);
+	if (!ret->inputBuffer || !ret->outputBuffer || !ret->compBuffer)
 		goto fail;
 
+	winpr_RAND(ret->inputBuffer, 1ull * ret->outputStride * height);
+
 	for (int i = 0; i < 3; i++)
 	{
-		BYTE* buf = ret->channels[i] = calloc(roi->width, roi->height);
-		if (!buf)
+		BYTE* buf = ret->channels[i] = calloc(width, height);
+		BYTE* aux = ret->auxChannels[i] = calloc(width, height);
+		if (!buf || !aux)
 			goto fail;
 
-		winpr_RAND(buf, 1ull * roi->width * roi->height);
-		ret->steps[i] = roi->width;
+		winpr_RAND(buf, 1ull * width * height);
+		ret->steps[i] = width;
 	}
 
 	return ret;
 
 fail:
 	primitives_YUV_benchmark_free(ret);
-	return ret;
+	return NULL;
+}
+
+static pstatus_t primitives_bench_YUV420ToRGB_8u_P3AC4R(primitives_YUV_benchmark* bench,
+                                                        const primitives_t* prims)
+{
+	const BYTE* channels[3] = { bench->channels[0], bench->channels[1], bench->channels[2] };
+	return prims->YUV420ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
+	                                    bench->outputStride, bench->testedFormat, &bench->roi);
+}
+
+static pstatus_t primitives_bench_YUV444ToRGB_8u_P3AC4R(primitives_YUV_benchmark* bench,
+                                                        const primitives_t* prims)
+{
+	const BYTE* channels[3] = { bench->channels[0], bench->channels[1], bench->channels[2] };
+	return prims->YUV444ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
+	                                    bench->outputStride, bench->testedFormat, &bench->roi);
 }
 
-static BOOL primitives_YUV_benchmark_run(primitives_YUV_benchmark* bench, primitives_t* prims,
-                                         UINT64 runTime, UINT32* computations)
+static pstatus_t primitives_bench_RGBToYUV420_8u_P3AC4R(primitives_YUV_benchmark* bench,
+                                                        const primitives_t* prims)
 {
-	ULONGLONG dueDate = 0;
-	const BYTE* channels[3] = { 0 };
-	pstatus_t status = 0;
+	return prims->RGBToYUV420_8u_P3AC4R(bench->inputBuffer, bench->testedFormat,
+	                                    bench->outputStride, bench->channels, bench->steps,
+	                                    &bench->roi);
+}
 
-	*computations = 0;
+static pstatus_t primitives_bench_RGBToAVC444YUV(primitives_YUV_benchmark* bench,
+                                                 const primitives_t* prims)
+{
+	return prims->RGBToAVC444YUV(bench->inputBuffer, bench->testedFormat, bench->outputStride,
+	                             bench->channels, bench->steps, bench->auxChannels, bench->steps,
+	                             &bench->roi);
+}
 
-	for (size_t i = 0; i < 3; i++)
-		channels[i] = bench->channels[i];
+static pstatus_t primitives_bench_alphaComp_argb(primitives_YUV_benchmark* bench,
+                                                 const primitives_t* prims)
+{
+	return prims->alphaComp_argb(bench->inputBuffer, bench->outputStride, bench->outputBuffer,
+	                             bench->outputStride, bench->compBuffer, bench->outputStride,
+	                             bench->roi.width, bench->roi.height);
+}
+
+#define PRIM_TUNABLE(fkt) { #fkt, offsetof(primitives_t, fkt), primitives_bench_##fkt }
+
+/* The primitives with more than one implementation worth benchmarking, the others are taken
+ * from the fastest CPU backend. */
+static const primitives_tunable primitivesTunables[] = {
+	PRIM_TUNABLE(YUV420ToRGB_8u_P3AC4R), PRIM_TUNABLE(YUV444ToRGB_8u_P3AC4R),
+	PRIM_TUNABLE(RGBToYUV420_8u_P3AC4R), PRIM_TUNABLE(RGBToAVC444YUV),
+	PRIM_TUNABLE(alphaComp_argb),
+};
+
+static BYTE* primitives_tunable_slot(const primitives_t* prims, const primitives_tunable* tunable)
+{
+	return WINPR_CAST_CONST_PTR_AWAY(prims, BYTE*) + tunable->offset;
+}
+
+static BOOL primitives_tunable_equal(const primitives_t* a, const primitives_t* b,
+                                     const primitives_tunable* tunable)
+{
+	return memcmp(primitives_tunable_slot(a, tunable), primitives_tunable_slot(b, tunable),
+	              sizeof(primitives_fkt_t)) == 0;
+}
+
+static BOOL primitives_benchmark_run(primitives_YUV_benchmark* bench,
+                                     const primitives_tunable* tunable, const primitives_t* prims,
+                                     UINT64 runTime, double* nsPerCall)
+{
+	UINT64 computations = 0;
 
 	/* do a first dry run to initialize cache and such */
-	status = prims->YUV420ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
-	                                      bench->outputStride, bench->testedFormat, &bench->roi);
-	if (status != PRIMITIVES_SUCCESS)
+	if (tunable->fkt(bench, prims) != PRIMITIVES_SUCCESS)
 		return FALSE;
 
 	/* let's run the benchmark */
-	dueDate = GetTickCount64() + runTime;
-	while (GetTickCount64() < dueDate)
+	const UINT64 start = winpr_GetTickCount64NS();
+	const UINT64 dueDate = start + runTime * 1000000ull;
+	UINT64 now = start;
+	do
 	{
-		pstatus_t cstatus =
-		    prims->YUV420ToRGB_8u_P3AC4R(channels, bench->steps, bench->outputBuffer,
-		                                 bench->outputStride, bench->testedFormat, &bench->roi);
-		if (cstatus != PRIMITIVES_SUCCESS)
+		if (tunable->fkt(bench, prims) != PRIMITIVES_SUCCESS)
 			return FALSE;
-		*computations = *computations + 1;
+		computations++;
+		now = winpr_GetTickCount64NS();
+	} while (now < dueDate);
+
+	*nsPerCall = (double)(now - start) / (double)computations;
+	return TRUE;
+}
+
+/* Picks the fastest backend of every tunable, rated by the product of the time per call at a
+ * tile and a full HD frame size */
+static BOOL primitives_autodetect_functions(const struct prim_benchmark* testcases, size_t count,
+                                            size_t base, size_t* choices)
+{
+	const prim_size_t sizes[] = { { 64, 64 }, { 1920, 1080 } };
+	const UINT64 benchDuration = 20; /* 20 ms for every function, backend and size */
+	double scores[3] = { 0 };
+	primitives_YUV_benchmark bench = { 0 };
+
+	WINPR_ASSERT(count <= ARRAYSIZE(scores));
+
+	if (!primitives_YUV_benchmark_init(&bench))
+		return FALSE;
+
+	WLog_DBG(TAG, "primitives benchmark result:");
+	for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
+	{
+		const primitives_tunable* tunable = &primitivesTunables[t];
+		choices[t] = base;
+
+		for (size_t x = 0; x < count; x++)
+		{
+			const struct prim_benchmark* cur = &testcases[x];
+			scores[x] = -1.0;
+			if (!cur->prims)
+				continue;
+
+			/* backends share most implementations, measure each only once */
+			size_t same = x;
+			for (size_t y = 0; y < x; y++)
+			{
+				if (testcases[y].prims &&
+				    primitives_tunable_equal(testcases[y].prims, cur->prims, tunable))
+					same = y;
+			}
+
+			if (same != x)
+				scores[x] = scores[same];
+			else
+			{
+				double score = 1.0;
+				for (size_t s = 0; s < ARRAYSIZE(sizes); s++)
+				{
+					double ns = 0.0;
+					bench.roi = sizes[s];
+					if (!primitives_benchmark_run(&bench, tunable, cur->prims, benchDuration, &ns))
+					{
+						WLog_WARN(TAG, "error running %s %s bench", cur->name, tunable->name);
+						score = -1.0;
+						break;
+					}
+					score *= ns;
+				}
+				scores[x] = score;
+				WLog_DBG(TAG, " * %s %s= %lf", tunable->name, cur->name, score);
+			}
+
+			if ((scores[x] >= 0.0) &&
+			    ((scores[choices[t]] < 0.0) || (scores[x] < scores[choices[t]])))
+				choices[t] = x;
+		}
 	}
+
+	primitives_YUV_benchmark_free(&bench);
 	return TRUE;
 }
+
+static char* primitives_profile_path(void)
+{
+	if (primitivesProfileSet)
+	{
+		if (!primitivesProfile)
+			return NULL;
+		return _strdup(primitivesProfile);
+	}
+
+	return freerdp_GetConfigFilePath(FALSE, "primitives.profile");
+}
+
+static void primitives_profile_fingerprint(const struct prim_benchmark* testcases, size_t count,
+                                           char* fingerprint, size_t size)
+{
+	const char* device = primitives_opencl_device_name();
+
+	(void)_snprintf(fingerprint, size, "%s", FREERDP_VERSION_FULL);
+	for (size_t x = 0; x < count; x++)
+	{
+		if (testcases[x].prims)
+			winpr_str_append(testcases[x].name, fingerprint, size, " ");
+	}
+	if (device)
+		winpr_str_append(device, fingerprint, size, " ");
+}
+
+static BOOL primitives_profile_load(const char* path, const char* fingerprint,
+                                    const struct prim_benchmark* testcases, size_t count,
+                                    size_t* choices)
+{
+	BOOL valid = FALSE;
+	char line[512] = { 0 };
+
+	if (!path)
+		return FALSE;
+
+	FILE* fp = winpr_fopen(path, "r");
+	if (!fp)
+		return FALSE;
+
+	for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
+		choices[t] = SIZE_MAX;
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#')
+			continue;
+
+		char* value = strchr(line, '=');
+		if (!value)
+			continue;
+		*value++ = '\0';
+
+		if (strcmp(line, "backends") == 0)
+		{
+			valid = strcmp(value, fingerprint) == 0;
+			continue;
+		}
+
+		for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
+		{
+			if (strcmp(line, primitivesTunables[t].name) != 0)
+				continue;
+
+			for (size_t x = 0; x < count; x++)
+			{
+				if (testcases[x].prims && (strcmp(value, testcases[x].name) == 0))
+					choices[t] = x;
+			}
+		}
+	}
+	(void)fclose(fp);
+
+	for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
+	{
+		if (choices[t] == SIZE_MAX)
+			valid = FALSE;
+	}
+
+	if (!valid)
+		WLog_DBG(TAG, "primitives profile %s does not match, running benchmark", path);
+	return valid;
+}
+
+static void primitives_profile_save(const char* path, const char* fingerprint,
+                                    const struct prim_benchmark* testcases, const size_t* choices)
+{
+	if (!path)
+		return;
+
+	char* dir = _strdup(path);
+	if (!dir)
+		return;
+
+	char* sep = strrchr(dir, '/');
+#if defined(_WIN32)
+	char* wsep = strrchr(dir, '\\');
+	if (wsep > sep)
+		sep = wsep;
 #endif
+	if (sep)
+	{
+		*sep = '\0';
+		if (!winpr_PathFileExists(dir))
+			(void)winpr_PathMakePath(dir, NULL);
+	}
+	free(dir);
 
-static BOOL primitives_autodetect_best(primitives_t* prims)
+	FILE* fp = winpr_fopen(path, "w");
+	if (!fp)
+	{
+		WLog_WARN(TAG, "unable to write primitives profile %s", path);
+		return;
+	}
+
+	(void)fprintf(fp, "# FreeRDP primitives profile, remove to run the benchmark again\n");
+	(void)fprintf(fp, "backends=%s\n", fingerprint);
+	for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
+		(void)fprintf(fp, "%s=%s\n", primitivesTunables[t].name, testcases[choices[t]].name);
+	(void)fclose(fp);
+}
+
+static void primitives_apply_choices(primitives_t* prims, const struct prim_benchmark* testcases,
+                                     const size_t* choices)
 {
-	BOOL ret = FALSE;
-	struct prim_benchmark
+	for (size_t t = 0; t < ARRAYSIZE(primitivesTunables); t++)
 	{
-		const char* name;
-		primitives_t* prims;
-		UINT32 flags;
-		UINT32 count;
-	};
+		const primitives_tunable* tunable = &primitivesTunables[t];
+		const primitives_t* src = testcases[choices[t]].prims;
+
+		memcpy(primitives_tunable_slot(prims, tunable), primitives_tunable_slot(src, tunable),
+		       sizeof(primitives_fkt_t));
+		prims->flags |= src->flags & PRIM_FLAGS_HAVE_EXTGPU;
+		WLog_DBG(TAG, "primitives autodetect, using %s %s", testcases[choices[t]].name,
+		         tunable->name);
+	}
+}
+#endif
 
+static BOOL primitives_autodetect_best(primitives_t* prims)
+{
+	BOOL ret = FALSE;
 	struct prim_benchmark testcases[] =
 	{
 		{ "generic", NULL, PRIMITIVES_PURE_SOFT, 0 },
@@ -239,34 +554,36 @@ static BOOL primitives_autodetect_best(primitives_t* prims)
 		best = cur;
 	}
 #else
+	size_t choices[ARRAYSIZE(primitivesTunables)] = { 0 };
 	{
-		UINT64 benchDuration = 150; /* 150 ms */
-		primitives_YUV_benchmark bench = { 0 };
-		primitives_YUV_benchmark* yuvBench = primitives_YUV_benchmark_init(&bench);
-		if (!yuvBench)
-			return FALSE;
-
-		WLog_DBG(TAG, "primitives benchmark result:");
 		for (size_t x = 0; x < ARRAYSIZE(testcases); x++)
 		{
 			struct prim_benchmark* cur = &testcases[x];
 			cur->prims = primitives_get_by_type(cur->flags);
 			if (!cur->prims)
-			{
 				WLog_WARN(TAG, "Failed to initialize %s primitives", cur->name);
-				continue;
-			}
-			if (!primitives_YUV_benchmark_run(yuvBench, cur->prims, benchDuration, &cur->count))
+		}
+
+		/* everything not benchmarked comes from the fastest CPU backend */
+		const size_t base = testcases[1].prims ? 1 : 0;
+		if (testcases[base].prims)
+		{
+			char fingerprint[512] = { 0 };
+			char* profile = primitives_profile_path();
+
+			primitives_profile_fingerprint(testcases, ARRAYSIZE(testcases), fingerprint,
+			                               sizeof(fingerprint));
+			if (primitives_profile_load(profile, fingerprint, testcases, ARRAYSIZE(testcases),
+			                            choices))
+				best = &testcases[base];
+			else if (primitives_autodetect_functions(testcases, ARRAYSIZE(testcases), base,
+			                                         choices))
 			{
-				WLog_WARN(TAG, "error running %s YUV bench", cur->name);
-				continue;
+				primitives_profile_save(profile, fingerprint, testcases, choices);
+				best = &testcases[base];
 			}
-
-			WLog_DBG(TAG, " * %s= %" PRIu32, cur->name, cur->count);
-			if (!best || (best->count < cur->count))
-				best = cur;
+			free(profile);
 		}
-		primitives_YUV_benchmark_free(yuvBench);
 	}
 #endif
 
@@ -278,7 +595,11 @@ static BOOL primitives_autodetect_best(primitives_t* prims)
 	/* finally compute the results */
 	*prims = *best->prims;
 
+#if defined(HAVE_CPU_OPTIMIZED_PRIMITIVES) && defined(WITH_OPENCL)
+	primitives_apply_choices(prims, testcases, choices);
+#else
 	WLog_DBG(TAG, "primitives autodetect, using %s", best->name);
+#endif
 	ret = TRUE;
 out:
 	if (!ret)
@@ -361,6 +682,10 @@ void primitives_uninit(void)
 #endif
 	if (pPrimitivesGeneric.uninit)
 		pPrimitivesGeneric.uninit();
+
+	free(primitivesProfile);
+	primitivesProfile = NULL;
+	primitivesProfileSet = FALSE;
 }
 
 /* ------------------------------------------------------------------------- */
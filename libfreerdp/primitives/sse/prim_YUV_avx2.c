@@ -0,0 +1,638 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_YUV.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static primitives_t* generic = NULL;
+
+/* Same factors and shifts as the SSE4.1 implementation, the results are identical.
+ * Each 32 bit lane holds the B, G, R, X factors for one pixel. */
+#define BGRX_Y_FACTORS _mm256_set1_epi32(0x001B5C09)
+#define BGRX_U_FACTORS _mm256_set1_epi32(0x00E39D7F)
+#define BGRX_V_FACTORS _mm256_set1_epi32(0x007F8CF4)
+#define CONST128_FACTORS _mm256_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+static inline __m256i avx2_load(const void* WINPR_RESTRICT ptr)
+{
+	return _mm256_loadu_si256((const __m256i*)ptr);
+}
+
+static inline void avx2_store(void* WINPR_RESTRICT ptr, __m256i val)
+{
+	_mm256_storeu_si256((__m256i*)ptr, val);
+}
+
+/* hadd and pack work within 128 bit lanes, restore the pixel order of 32 results */
+static inline __m256i avx2_pixel_order(__m256i val)
+{
+	return _mm256_permutevar8x32_epi32(val, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+/* Y of 32 BGRX pixels */
+static inline __m256i avx2_BGRX_Y(const __m256i x[4])
+{
+	const __m256i y_factors = BGRX_Y_FACTORS;
+	const __m256i y1 = _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x[0], y_factors),
+	                                                        _mm256_maddubs_epi16(x[1], y_factors)),
+	                                     Y_SHIFT);
+	const __m256i y2 = _mm256_srli_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x[2], y_factors),
+	                                                        _mm256_maddubs_epi16(x[3], y_factors)),
+	                                     Y_SHIFT);
+	return avx2_pixel_order(_mm256_packus_epi16(y1, y2));
+}
+
+/* U or V of 32 BGRX pixels, depending on the factors */
+static inline __m256i avx2_BGRX_UV(const __m256i x[4], __m256i factors)
+{
+	const __m256i vector128 = CONST128_FACTORS;
+	const __m256i c1 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x[0], factors), _mm256_maddubs_epi16(x[1], factors)),
+	    U_SHIFT);
+	const __m256i c2 = _mm256_srai_epi16(
+	    _mm256_hadd_epi16(_mm256_maddubs_epi16(x[2], factors), _mm256_maddubs_epi16(x[3], factors)),
+	    U_SHIFT);
+	return avx2_pixel_order(_mm256_sub_epi8(_mm256_packs_epi16(c1, c2), vector128));
+}
+
+static inline void avx2_load_BGRX(const BYTE* WINPR_RESTRICT src, __m256i x[4])
+{
+	for (size_t i = 0; i < 4; i++)
+		x[i] = avx2_load(&src[32 * i]);
+}
+
+/****************************************************************************/
+/* avx2 RGB -> YUV420 conversion                                           **/
+/****************************************************************************/
+
+static inline void avx2_RGBToYUV420_BGRX_Y(const BYTE* WINPR_RESTRICT src, BYTE* dst,
+                                           UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i rgb[4];
+		avx2_load_BGRX(&src[4ULL * x], rgb);
+		avx2_store(&dst[x], avx2_BGRX_Y(rgb));
+	}
+
+	for (; x < width; x++)
+	{
+		const BYTE* pixel = &src[4ULL * x];
+		dst[x] = RGB2Y(pixel[2], pixel[1], pixel[0]);
+	}
+}
+
+/* compute the chrominance (UV) components from two rgb source lines */
+static inline void avx2_RGBToYUV420_BGRX_UV(const BYTE* WINPR_RESTRICT src1,
+                                            const BYTE* WINPR_RESTRICT src2,
+                                            BYTE* WINPR_RESTRICT dst1, BYTE* WINPR_RESTRICT dst2,
+                                            UINT32 width)
+{
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+	const __m256i vector128 = CONST128_FACTORS;
+	const __m256i order = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15, 0,
+	                                       1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+
+	size_t x = 0;
+
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i avg[4];
+
+		/* subsample 32x2 pixels into 32x1 pixels */
+		for (size_t i = 0; i < 4; i++)
+			avg[i] = _mm256_avg_epu8(avx2_load(&src1[4ULL * x + 32 * i]),
+			                         avx2_load(&src2[4ULL * x + 32 * i]));
+
+		/* subsample these 32x1 pixels into 16x1 pixels, see the SSE4.1 version for the
+		 * shuffle controls. Results are in lane order and sorted after packing. */
+		const __m256 f0 = _mm256_castsi256_ps(avg[0]);
+		const __m256 f1 = _mm256_castsi256_ps(avg[1]);
+		const __m256 f2 = _mm256_castsi256_ps(avg[2]);
+		const __m256 f3 = _mm256_castsi256_ps(avg[3]);
+		const __m256i x0 = _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0xdd)),
+		                                   _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, 0x88)));
+		const __m256i x1 = _mm256_avg_epu8(_mm256_castps_si256(_mm256_shuffle_ps(f2, f3, 0xdd)),
+		                                   _mm256_castps_si256(_mm256_shuffle_ps(f2, f3, 0x88)));
+
+		/* multiplications, subtotals and shifts */
+		const __m256i u = _mm256_srai_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x0, u_factors),
+		                                                       _mm256_maddubs_epi16(x1, u_factors)),
+		                                    U_SHIFT);
+		const __m256i v = _mm256_srai_epi16(_mm256_hadd_epi16(_mm256_maddubs_epi16(x0, v_factors),
+		                                                       _mm256_maddubs_epi16(x1, v_factors)),
+		                                    V_SHIFT);
+
+		/* pack the 32 words into bytes and add 128, U to the low, V to the high lane */
+		const __m256i uv = _mm256_sub_epi8(_mm256_packs_epi16(u, v), vector128);
+		const __m256i sorted = _mm256_shuffle_epi8(_mm256_permute4x64_epi64(uv, 0xD8), order);
+		_mm_storeu_si128((__m128i*)&dst1[x / 2], _mm256_castsi256_si128(sorted));
+		_mm_storeu_si128((__m128i*)&dst2[x / 2], _mm256_extracti128_si256(sorted, 1));
+	}
+
+	for (; x < width - width % 2; x += 2)
+	{
+		const BYTE* p[4] = { &src1[4ULL * x], &src1[4ULL * x + 4], &src2[4ULL * x],
+			                 &src2[4ULL * x + 4] };
+		INT16 u4 = 0;
+		INT16 v4 = 0;
+
+		for (size_t i = 0; i < ARRAYSIZE(p); i++)
+		{
+			u4 = WINPR_ASSERTING_INT_CAST(INT16, u4 + RGB2U(p[i][2], p[i][1], p[i][0]));
+			v4 = WINPR_ASSERTING_INT_CAST(INT16, v4 + RGB2V(p[i][2], p[i][1], p[i][0]));
+		}
+
+		dst1[x / 2] = CLIP(u4 / 4);
+		dst2[x / 2] = CLIP(v4 / 4);
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                       BYTE* WINPR_RESTRICT pDst[], const UINT32 dstStep[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* line1 = &pSrc[y * srcStep];
+		const BYTE* line2 = &pSrc[(1ULL + y) * srcStep];
+		BYTE* ydst1 = &pDst[0][y * dstStep[0]];
+		BYTE* ydst2 = &pDst[0][(1ULL + y) * dstStep[0]];
+		BYTE* udst = &pDst[1][y / 2 * dstStep[1]];
+		BYTE* vdst = &pDst[2][y / 2 * dstStep[2]];
+
+		avx2_RGBToYUV420_BGRX_UV(line1, line2, udst, vdst, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line1, ydst1, roi->width);
+		avx2_RGBToYUV420_BGRX_Y(line2, ydst2, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* line = &pSrc[y * srcStep];
+		BYTE* ydst = &pDst[0][1ULL * y * dstStep[0]];
+		avx2_RGBToYUV420_BGRX_Y(line, ydst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                  UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[],
+                                  const UINT32 dstStep[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx2 RGB -> AVC444-YUV conversion                                       **/
+/****************************************************************************/
+
+/* Splits 32 even and odd line chroma values according to
+ * 3.3.8.3.2 YUV420p Stream Combination for YUV444 mode:
+ * 2x   2y    -> avg (b2, b3)
+ * x    2y+1  -> full (b4, b5)
+ * 2x+1 2y    -> odd (b6, b7) */
+static inline void avx2_AVC444_split_chroma(__m256i even, __m256i odd, BYTE* WINPR_RESTRICT avg,
+                                            BYTE* WINPR_RESTRICT full, BYTE* WINPR_RESTRICT oddX)
+{
+	const __m256i ones = _mm256_set1_epi8(1);
+	const __m256i oddBytes = _mm256_setr_epi8(
+	    1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1, 1, 3, 5, 7, 9, 11, 13, 15, -1,
+	    -1, -1, -1, -1, -1, -1, -1);
+	const __m256i sum = _mm256_add_epi16(_mm256_maddubs_epi16(even, ones),
+	                                     _mm256_maddubs_epi16(odd, ones));
+	const __m256i avg16 = _mm256_srli_epi16(sum, 2);
+	const __m256i avg8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(avg16, avg16), 0xD8);
+	const __m256i odd8 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(even, oddBytes), 0xD8);
+
+	_mm_storeu_si128((__m128i*)avg, _mm256_castsi256_si128(avg8));
+	avx2_store(full, odd);
+	_mm_storeu_si128((__m128i*)oddX, _mm256_castsi256_si128(odd8));
+}
+
+static inline void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT b1Even, BYTE* WINPR_RESTRICT b1Odd, BYTE* WINPR_RESTRICT b2,
+    BYTE* WINPR_RESTRICT b3, BYTE* WINPR_RESTRICT b4, BYTE* WINPR_RESTRICT b5,
+    BYTE* WINPR_RESTRICT b6, BYTE* WINPR_RESTRICT b7, UINT32 width)
+{
+	const __m256i u_factors = BGRX_U_FACTORS;
+	const __m256i v_factors = BGRX_V_FACTORS;
+
+	UINT32 x = 0;
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i xe[4];
+		__m256i xo[4];
+		avx2_load_BGRX(&srcEven[4ULL * x], xe);
+		avx2_load_BGRX(&srcOdd[4ULL * x], xo);
+
+		/* store y [b1] */
+		avx2_store(b1Even, avx2_BGRX_Y(xe));
+		avx2_store(b1Odd, avx2_BGRX_Y(xo));
+		b1Even += 32;
+		b1Odd += 32;
+
+		avx2_AVC444_split_chroma(avx2_BGRX_UV(xe, u_factors), avx2_BGRX_UV(xo, u_factors), b2, b4,
+		                         b6);
+		avx2_AVC444_split_chroma(avx2_BGRX_UV(xe, v_factors), avx2_BGRX_UV(xo, v_factors), b3, b5,
+		                         b7);
+		b2 += 16;
+		b3 += 16;
+		b4 += 32;
+		b5 += 32;
+		b6 += 16;
+		b7 += 16;
+	}
+
+	general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(x, srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6,
+	                                       b7, width);
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                          BYTE* WINPR_RESTRICT pDst1[], const UINT32 dst1Step[],
+                                          BYTE* WINPR_RESTRICT pDst2[], const UINT32 dst2Step[],
+                                          const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		const BYTE* srcOdd = pSrc + (y + 1) * srcStep;
+		const size_t i = y >> 1;
+		const size_t n = (i & (size_t)~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = (b1Even + dst1Step[0]);
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(0, srcEven, NULL, b1Even, NULL, b2, b3, NULL, NULL,
+		                                       b6, b7, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                     UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                     const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                     const UINT32 dst2Step[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step, roi);
+
+		default:
+			return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx2 AVC444-YUV -> YUV444 combination                                   **/
+/****************************************************************************/
+
+/* AVX2 has no byte masked store, merge with the destination instead */
+static inline void avx2_store_masked(BYTE* WINPR_RESTRICT dst, __m256i val, __m256i mask)
+{
+	avx2_store(dst, _mm256_blendv_epi8(avx2_load(dst), val, mask));
+}
+
+/* 16 values to the odd bytes of 32 */
+static inline void avx2_store_odd(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src)
+{
+	const __m256i mask = _mm256_set1_epi16((INT16)0xFF00);
+	const __m256i val =
+	    _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src)), 8);
+	avx2_store_masked(dst, val, mask);
+}
+
+/* 8 values each to byte 0 and 2 of 32 */
+static inline __m256i avx2_interleave_quarter(const BYTE* WINPR_RESTRICT even,
+                                              const BYTE* WINPR_RESTRICT odd)
+{
+	const __m256i e = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)even));
+	const __m256i o = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)odd));
+	return _mm256_or_si256(e, _mm256_slli_epi32(o, 16));
+}
+
+static pstatus_t avx2_LumaToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[], const UINT32 srcStep[],
+                                   BYTE* WINPR_RESTRICT pDstRaw[], const UINT32 dstStep[],
+                                   const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+
+	/* B1 */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const BYTE* Ym = pSrc[0] + y * srcStep[0];
+		BYTE* pY = pDst[0] + y * dstStep[0];
+		memcpy(pY, Ym, nWidth);
+	}
+
+	/* B2 and B3 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		for (size_t p = 1; p < 3; p++)
+		{
+			const BYTE* Um = pSrc[p] + 1ULL * srcStep[p] * y;
+			BYTE* pU = pDst[p] + 1ULL * dstStep[p] * (2 * y);
+			BYTE* pU1 = pU + dstStep[p];
+
+			size_t x = 0;
+			for (; x < halfWidth - halfPad; x += 32)
+			{
+				/* unpack works within 128 bit lanes, swap the middle halves */
+				const __m256i u = avx2_load(&Um[x]);
+				const __m256i lo = _mm256_unpacklo_epi8(u, u);
+				const __m256i hi = _mm256_unpackhi_epi8(u, u);
+				const __m256i u1 = _mm256_permute2x128_si256(lo, hi, 0x20);
+				const __m256i u2 = _mm256_permute2x128_si256(lo, hi, 0x31);
+				avx2_store(&pU[2 * x], u1);
+				avx2_store(&pU[2 * x + 32], u2);
+				avx2_store(&pU1[2 * x], u1);
+				avx2_store(&pU1[2 * x + 32], u2);
+			}
+
+			for (; x < halfWidth; x++)
+			{
+				pU[2 * x] = Um[x];
+				pU[2 * x + 1] = Um[x];
+				pU1[2 * x] = Um[x];
+				pU1[2 * x + 1] = Um[x];
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_ChromaV1ToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[3],
+                                       const UINT32 srcStep[3], BYTE* WINPR_RESTRICT pDstRaw[3],
+                                       const UINT32 dstStep[3],
+                                       const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 mod = 16;
+	UINT32 uY = 0;
+	UINT32 vY = 0;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 16;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	/* The auxiliary frame is aligned to multiples of 16x16.
+	 * We need the padded height for B4 and B5 conversion. */
+	const UINT32 padHeigth = nHeight + 16 - nHeight % 16;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+
+	/* B4 and B5 */
+	for (size_t y = 0; y < padHeigth; y++)
+	{
+		const BYTE* Ya = pSrc[0] + 1ULL * srcStep[0] * y;
+		BYTE* pX = NULL;
+
+		if ((y) % mod < (mod + 1) / 2)
+		{
+			const UINT32 pos = (2 * uY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[1] + 1ULL * dstStep[1] * pos;
+		}
+		else
+		{
+			const UINT32 pos = (2 * vY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[2] + 1ULL * dstStep[2] * pos;
+		}
+
+		memcpy(pX, Ya, nWidth);
+	}
+
+	/* B6 and B7 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* Ua = pSrc[1] + srcStep[1] * y;
+		const BYTE* Va = pSrc[2] + srcStep[2] * y;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y);
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y);
+
+		size_t x = 0;
+		for (; x < halfWidth - halfPad; x += 16)
+		{
+			avx2_store_odd(&pU[2 * x], &Ua[x]);
+			avx2_store_odd(&pV[2 * x], &Va[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x + 1] = Ua[x];
+			pV[2 * x + 1] = Va[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_ChromaV2ToYUV444(const BYTE* WINPR_RESTRICT pSrc[3], const UINT32 srcStep[3],
+                                       UINT32 nTotalWidth, WINPR_ATTR_UNUSED UINT32 nTotalHeight,
+                                       BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                       const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 16;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 quaterWidth = (nWidth + 3) / 4;
+	const UINT32 quaterPad = quaterWidth % 16;
+	const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+
+	/* B4 and B5: odd UV values for width/2, height */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const size_t yTop = y + roi->top;
+		const BYTE* pYaU = pSrc[0] + srcStep[0] * yTop + roi->left / 2;
+		const BYTE* pYaV = pYaU + nTotalWidth / 2;
+		BYTE* pU = pDst[1] + 1ULL * dstStep[1] * yTop + roi->left;
+		BYTE* pV = pDst[2] + 1ULL * dstStep[2] * yTop + roi->left;
+
+		size_t x = 0;
+		for (; x < halfWidth - halfPad; x += 16)
+		{
+			avx2_store_odd(&pU[2 * x], &pYaU[x]);
+			avx2_store_odd(&pV[2 * x], &pYaV[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			const size_t odd = 2ULL * x + 1;
+			pU[odd] = pYaU[x];
+			pV[odd] = pYaV[x];
+		}
+	}
+
+	/* B6 - B9 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* pUaU = pSrc[1] + srcStep[1] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pUaV = pUaU + nTotalWidth / 4;
+		const BYTE* pVaU = pSrc[2] + srcStep[2] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pVaV = pVaU + nTotalWidth / 4;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y + 1 + roi->top) + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y + 1 + roi->top) + roi->left;
+
+		UINT32 x = 0;
+		for (; x < quaterWidth - quaterPad; x += 16)
+		{
+			/* U values go to byte 0, V values to byte 2 of every 4 */
+			for (size_t i = 0; i < 16; i += 8)
+			{
+				const __m256i u = avx2_interleave_quarter(&pUaU[x + i], &pVaU[x + i]);
+				const __m256i v = avx2_interleave_quarter(&pUaV[x + i], &pVaV[x + i]);
+				avx2_store_masked(&pU[4 * (x + i)], u, mask);
+				avx2_store_masked(&pV[4 * (x + i)], v, mask);
+			}
+		}
+
+		for (; x < quaterWidth; x++)
+		{
+			pU[4 * x + 0] = pUaU[x];
+			pV[4 * x + 0] = pUaV[x];
+			pU[4 * x + 2] = pVaU[x];
+			pV[4 * x + 2] = pVaV[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420CombineToYUV444(avc444_frame_type type,
+                                            const BYTE* WINPR_RESTRICT pSrc[3],
+                                            const UINT32 srcStep[3], UINT32 nWidth, UINT32 nHeight,
+                                            BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                            const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	if (!pSrc || !pSrc[0] || !pSrc[1] || !pSrc[2])
+		return -1;
+
+	if (!pDst || !pDst[0] || !pDst[1] || !pDst[2])
+		return -1;
+
+	if (!roi)
+		return -1;
+
+	switch (type)
+	{
+		case AVC444_LUMA:
+			return avx2_LumaToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv1:
+			return avx2_ChromaV1ToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv2:
+			return avx2_ChromaV2ToYUV444(pSrc, srcStep, nWidth, nHeight, pDst, dstStep, roi);
+
+		default:
+			return -1;
+	}
+}
+#endif
+
+void primitives_init_YUV_avx2_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+	prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+	prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+	prims->YUV420CombineToYUV444 = avx2_YUV420CombineToYUV444;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
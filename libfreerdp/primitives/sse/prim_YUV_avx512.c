@@ -0,0 +1,638 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_YUV.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static primitives_t* generic = NULL;
+
+/* Same factors and shifts as the SSE4.1 implementation, the results are identical.
+ * Each 32 bit lane holds the B, G, R, X factors for one pixel. */
+#define BGRX_Y_FACTORS _mm512_set1_epi32(0x001B5C09)
+#define BGRX_U_FACTORS _mm512_set1_epi32(0x00E39D7F)
+#define BGRX_V_FACTORS _mm512_set1_epi32(0x007F8CF4)
+#define CONST128_FACTORS _mm512_set1_epi8(-128)
+
+#define Y_SHIFT 7
+#define U_SHIFT 8
+#define V_SHIFT 8
+
+/* Odd bytes, and byte 0 and 2 of every 4 */
+#define MASK_ODD_BYTES 0xAAAAAAAAAAAAAAAAULL
+#define MASK_QUARTER_BYTES 0x5555555555555555ULL
+
+static inline __m512i avx512_load(const void* WINPR_RESTRICT ptr)
+{
+	return _mm512_loadu_si512(ptr);
+}
+
+static inline void avx512_store(void* WINPR_RESTRICT ptr, __m512i val)
+{
+	_mm512_storeu_si512(ptr, val);
+}
+
+static inline void avx512_load_BGRX(const BYTE* WINPR_RESTRICT src, __m512i x[4])
+{
+	for (size_t i = 0; i < 4; i++)
+		x[i] = avx512_load(&src[64 * i]);
+}
+
+/* There is no 512 bit hadd, sum the pairs of maddubs with madd instead.
+ * Returns the full sums of 16 pixels as 32 bit values. */
+static inline __m512i avx512_BGRX_sum(__m512i x, __m512i factors)
+{
+	return _mm512_madd_epi16(_mm512_maddubs_epi16(x, factors), _mm512_set1_epi16(1));
+}
+
+/* pack works within 128 bit lanes, restore the pixel order of 64 results */
+static inline __m512i avx512_pixel_order(__m512i val)
+{
+	const __m512i order =
+	    _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	return _mm512_permutexvar_epi32(order, val);
+}
+
+/* Y of 64 BGRX pixels */
+static inline __m512i avx512_BGRX_Y(const __m512i x[4])
+{
+	const __m512i y_factors = BGRX_Y_FACTORS;
+	__m512i y[4];
+
+	for (size_t i = 0; i < 4; i++)
+		y[i] = _mm512_srli_epi32(avx512_BGRX_sum(x[i], y_factors), Y_SHIFT);
+
+	const __m512i y1 = _mm512_packs_epi32(y[0], y[1]);
+	const __m512i y2 = _mm512_packs_epi32(y[2], y[3]);
+	return avx512_pixel_order(_mm512_packus_epi16(y1, y2));
+}
+
+/* U or V of 64 BGRX pixels, depending on the factors */
+static inline __m512i avx512_BGRX_UV(const __m512i x[4], __m512i factors)
+{
+	const __m512i vector128 = CONST128_FACTORS;
+	__m512i c[4];
+
+	for (size_t i = 0; i < 4; i++)
+		c[i] = _mm512_srai_epi32(avx512_BGRX_sum(x[i], factors), U_SHIFT);
+
+	const __m512i c1 = _mm512_packs_epi32(c[0], c[1]);
+	const __m512i c2 = _mm512_packs_epi32(c[2], c[3]);
+	return avx512_pixel_order(_mm512_sub_epi8(_mm512_packs_epi16(c1, c2), vector128));
+}
+
+/****************************************************************************/
+/* avx512 RGB -> YUV420 conversion                                         **/
+/****************************************************************************/
+
+static inline void avx512_RGBToYUV420_BGRX_Y(const BYTE* WINPR_RESTRICT src, BYTE* dst,
+                                             UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x < width - width % 64; x += 64)
+	{
+		__m512i rgb[4];
+		avx512_load_BGRX(&src[4ULL * x], rgb);
+		avx512_store(&dst[x], avx512_BGRX_Y(rgb));
+	}
+
+	for (; x < width; x++)
+	{
+		const BYTE* pixel = &src[4ULL * x];
+		dst[x] = RGB2Y(pixel[2], pixel[1], pixel[0]);
+	}
+}
+
+/* compute the chrominance (UV) components from two rgb source lines */
+static inline void avx512_RGBToYUV420_BGRX_UV(const BYTE* WINPR_RESTRICT src1,
+                                              const BYTE* WINPR_RESTRICT src2,
+                                              BYTE* WINPR_RESTRICT dst1,
+                                              BYTE* WINPR_RESTRICT dst2, UINT32 width)
+{
+	const __m512i u_factors = BGRX_U_FACTORS;
+	const __m512i v_factors = BGRX_V_FACTORS;
+	const __m128i vector128 = _mm_set1_epi8(-128);
+	const __m512i evenPixels = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24,
+	                                             26, 28, 30);
+	const __m512i oddPixels = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25,
+	                                            27, 29, 31);
+
+	size_t x = 0;
+
+	for (; x < width - width % 64; x += 64)
+	{
+		__m512i avg[4];
+
+		/* subsample 64x2 pixels into 64x1 pixels */
+		for (size_t i = 0; i < 4; i++)
+			avg[i] = _mm512_avg_epu8(avx512_load(&src1[4ULL * x + 64 * i]),
+			                         avx512_load(&src2[4ULL * x + 64 * i]));
+
+		/* subsample these 64x1 pixels into 32x1 pixels */
+		for (size_t i = 0; i < 2; i++)
+		{
+			const __m512i a = avg[2 * i];
+			const __m512i b = avg[2 * i + 1];
+			const __m512i sub =
+			    _mm512_avg_epu8(_mm512_permutex2var_epi32(a, evenPixels, b),
+			                    _mm512_permutex2var_epi32(a, oddPixels, b));
+
+			/* the average is in pixel order, saturate the 32 bit sums to bytes */
+			const __m512i u = _mm512_srai_epi32(avx512_BGRX_sum(sub, u_factors), U_SHIFT);
+			const __m512i v = _mm512_srai_epi32(avx512_BGRX_sum(sub, v_factors), V_SHIFT);
+			const __m128i u8 = _mm_sub_epi8(_mm512_cvtsepi32_epi8(u), vector128);
+			const __m128i v8 = _mm_sub_epi8(_mm512_cvtsepi32_epi8(v), vector128);
+			_mm_storeu_si128((__m128i*)&dst1[x / 2 + 16 * i], u8);
+			_mm_storeu_si128((__m128i*)&dst2[x / 2 + 16 * i], v8);
+		}
+	}
+
+	for (; x < width - width % 2; x += 2)
+	{
+		const BYTE* p[4] = { &src1[4ULL * x], &src1[4ULL * x + 4], &src2[4ULL * x],
+			                 &src2[4ULL * x + 4] };
+		INT16 u4 = 0;
+		INT16 v4 = 0;
+
+		for (size_t i = 0; i < ARRAYSIZE(p); i++)
+		{
+			u4 = WINPR_ASSERTING_INT_CAST(INT16, u4 + RGB2U(p[i][2], p[i][1], p[i][0]));
+			v4 = WINPR_ASSERTING_INT_CAST(INT16, v4 + RGB2V(p[i][2], p[i][1], p[i][0]));
+		}
+
+		dst1[x / 2] = CLIP(u4 / 4);
+		dst2[x / 2] = CLIP(v4 / 4);
+	}
+}
+
+static pstatus_t avx512_RGBToYUV420_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                         BYTE* WINPR_RESTRICT pDst[], const UINT32 dstStep[],
+                                         const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* line1 = &pSrc[y * srcStep];
+		const BYTE* line2 = &pSrc[(1ULL + y) * srcStep];
+		BYTE* ydst1 = &pDst[0][y * dstStep[0]];
+		BYTE* ydst2 = &pDst[0][(1ULL + y) * dstStep[0]];
+		BYTE* udst = &pDst[1][y / 2 * dstStep[1]];
+		BYTE* vdst = &pDst[2][y / 2 * dstStep[2]];
+
+		avx512_RGBToYUV420_BGRX_UV(line1, line2, udst, vdst, roi->width);
+		avx512_RGBToYUV420_BGRX_Y(line1, ydst1, roi->width);
+		avx512_RGBToYUV420_BGRX_Y(line2, ydst2, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* line = &pSrc[y * srcStep];
+		BYTE* ydst = &pDst[0][1ULL * y * dstStep[0]];
+		avx512_RGBToYUV420_BGRX_Y(line, ydst, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToYUV420(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                    UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[],
+                                    const UINT32 dstStep[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToYUV420_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx512 RGB -> AVC444-YUV conversion                                     **/
+/****************************************************************************/
+
+/* Splits 64 even and odd line chroma values according to
+ * 3.3.8.3.2 YUV420p Stream Combination for YUV444 mode:
+ * 2x   2y    -> avg (b2, b3)
+ * x    2y+1  -> full (b4, b5)
+ * 2x+1 2y    -> odd (b6, b7) */
+static inline void avx512_AVC444_split_chroma(__m512i even, __m512i odd,
+                                              BYTE* WINPR_RESTRICT avg,
+                                              BYTE* WINPR_RESTRICT full,
+                                              BYTE* WINPR_RESTRICT oddX)
+{
+	const __m512i ones = _mm512_set1_epi8(1);
+	const __m512i sum = _mm512_add_epi16(_mm512_maddubs_epi16(even, ones),
+	                                     _mm512_maddubs_epi16(odd, ones));
+	const __m256i avg8 = _mm512_cvtepi16_epi8(_mm512_srli_epi16(sum, 2));
+	const __m256i odd8 = _mm512_cvtepi16_epi8(_mm512_srli_epi16(even, 8));
+
+	_mm256_storeu_si256((__m256i*)avg, avg8);
+	avx512_store(full, odd);
+	_mm256_storeu_si256((__m256i*)oddX, odd8);
+}
+
+static inline void avx512_RGBToAVC444YUV_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT b1Even, BYTE* WINPR_RESTRICT b1Odd, BYTE* WINPR_RESTRICT b2,
+    BYTE* WINPR_RESTRICT b3, BYTE* WINPR_RESTRICT b4, BYTE* WINPR_RESTRICT b5,
+    BYTE* WINPR_RESTRICT b6, BYTE* WINPR_RESTRICT b7, UINT32 width)
+{
+	const __m512i u_factors = BGRX_U_FACTORS;
+	const __m512i v_factors = BGRX_V_FACTORS;
+
+	UINT32 x = 0;
+	for (; x < width - width % 64; x += 64)
+	{
+		__m512i xe[4];
+		__m512i xo[4];
+		avx512_load_BGRX(&srcEven[4ULL * x], xe);
+		avx512_load_BGRX(&srcOdd[4ULL * x], xo);
+
+		/* store y [b1] */
+		avx512_store(b1Even, avx512_BGRX_Y(xe));
+		avx512_store(b1Odd, avx512_BGRX_Y(xo));
+		b1Even += 64;
+		b1Odd += 64;
+
+		avx512_AVC444_split_chroma(avx512_BGRX_UV(xe, u_factors), avx512_BGRX_UV(xo, u_factors),
+		                           b2, b4, b6);
+		avx512_AVC444_split_chroma(avx512_BGRX_UV(xe, v_factors), avx512_BGRX_UV(xo, v_factors),
+		                           b3, b5, b7);
+		b2 += 32;
+		b3 += 32;
+		b4 += 64;
+		b5 += 64;
+		b6 += 32;
+		b7 += 32;
+	}
+
+	general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(x, srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6,
+	                                       b7, width);
+}
+
+static pstatus_t avx512_RGBToAVC444YUV_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                            BYTE* WINPR_RESTRICT pDst1[], const UINT32 dst1Step[],
+                                            BYTE* WINPR_RESTRICT pDst2[], const UINT32 dst2Step[],
+                                            const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		const BYTE* srcOdd = pSrc + (y + 1) * srcStep;
+		const size_t i = y >> 1;
+		const size_t n = (i & (size_t)~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = (b1Even + dst1Step[0]);
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx512_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6,
+		                                      b7, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(0, srcEven, NULL, b1Even, NULL, b2, b3, NULL, NULL,
+		                                       b6, b7, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                       const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                       const UINT32 dst2Step[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToAVC444YUV_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+			                                  roi);
+
+		default:
+			return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx512 AVC444-YUV -> YUV444 combination                                 **/
+/****************************************************************************/
+
+/* 32 values to the odd bytes of 64 */
+static inline void avx512_store_odd(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src)
+{
+	const __m512i val =
+	    _mm512_slli_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)src)), 8);
+	_mm512_mask_storeu_epi8(dst, MASK_ODD_BYTES, val);
+}
+
+/* 16 values each to byte 0 and 2 of 64 */
+static inline void avx512_store_quarter(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT even,
+                                        const BYTE* WINPR_RESTRICT odd)
+{
+	const __m512i e = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)even));
+	const __m512i o = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)odd));
+	_mm512_mask_storeu_epi8(dst, MASK_QUARTER_BYTES, _mm512_or_si512(e, _mm512_slli_epi32(o, 16)));
+}
+
+static pstatus_t avx512_LumaToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[], const UINT32 srcStep[],
+                                     BYTE* WINPR_RESTRICT pDstRaw[], const UINT32 dstStep[],
+                                     const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 64;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+	/* unpack works within 128 bit lanes, these collect the lanes in order */
+	const __m512i lanes1 = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+	const __m512i lanes2 = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+
+	/* B1 */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const BYTE* Ym = pSrc[0] + y * srcStep[0];
+		BYTE* pY = pDst[0] + y * dstStep[0];
+		memcpy(pY, Ym, nWidth);
+	}
+
+	/* B2 and B3 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		for (size_t p = 1; p < 3; p++)
+		{
+			const BYTE* Um = pSrc[p] + 1ULL * srcStep[p] * y;
+			BYTE* pU = pDst[p] + 1ULL * dstStep[p] * (2 * y);
+			BYTE* pU1 = pU + dstStep[p];
+
+			size_t x = 0;
+			for (; x < halfWidth - halfPad; x += 64)
+			{
+				const __m512i u = avx512_load(&Um[x]);
+				const __m512i lo = _mm512_unpacklo_epi8(u, u);
+				const __m512i hi = _mm512_unpackhi_epi8(u, u);
+				const __m512i u1 = _mm512_permutex2var_epi64(lo, lanes1, hi);
+				const __m512i u2 = _mm512_permutex2var_epi64(lo, lanes2, hi);
+				avx512_store(&pU[2 * x], u1);
+				avx512_store(&pU[2 * x + 64], u2);
+				avx512_store(&pU1[2 * x], u1);
+				avx512_store(&pU1[2 * x + 64], u2);
+			}
+
+			for (; x < halfWidth; x++)
+			{
+				pU[2 * x] = Um[x];
+				pU[2 * x + 1] = Um[x];
+				pU1[2 * x] = Um[x];
+				pU1[2 * x + 1] = Um[x];
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_ChromaV1ToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[3],
+                                         const UINT32 srcStep[3], BYTE* WINPR_RESTRICT pDstRaw[3],
+                                         const UINT32 dstStep[3],
+                                         const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 mod = 16;
+	UINT32 uY = 0;
+	UINT32 vY = 0;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	/* The auxiliary frame is aligned to multiples of 16x16.
+	 * We need the padded height for B4 and B5 conversion. */
+	const UINT32 padHeigth = nHeight + 16 - nHeight % 16;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+
+	/* B4 and B5 */
+	for (size_t y = 0; y < padHeigth; y++)
+	{
+		const BYTE* Ya = pSrc[0] + 1ULL * srcStep[0] * y;
+		BYTE* pX = NULL;
+
+		if ((y) % mod < (mod + 1) / 2)
+		{
+			const UINT32 pos = (2 * uY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[1] + 1ULL * dstStep[1] * pos;
+		}
+		else
+		{
+			const UINT32 pos = (2 * vY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[2] + 1ULL * dstStep[2] * pos;
+		}
+
+		memcpy(pX, Ya, nWidth);
+	}
+
+	/* B6 and B7 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* Ua = pSrc[1] + srcStep[1] * y;
+		const BYTE* Va = pSrc[2] + srcStep[2] * y;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y);
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y);
+
+		size_t x = 0;
+		for (; x < halfWidth - halfPad; x += 32)
+		{
+			avx512_store_odd(&pU[2 * x], &Ua[x]);
+			avx512_store_odd(&pV[2 * x], &Va[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x + 1] = Ua[x];
+			pV[2 * x + 1] = Va[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_ChromaV2ToYUV444(const BYTE* WINPR_RESTRICT pSrc[3],
+                                         const UINT32 srcStep[3], UINT32 nTotalWidth,
+                                         WINPR_ATTR_UNUSED UINT32 nTotalHeight,
+                                         BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                         const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfPad = halfWidth % 32;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 quaterWidth = (nWidth + 3) / 4;
+	const UINT32 quaterPad = quaterWidth % 16;
+
+	/* B4 and B5: odd UV values for width/2, height */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const size_t yTop = y + roi->top;
+		const BYTE* pYaU = pSrc[0] + srcStep[0] * yTop + roi->left / 2;
+		const BYTE* pYaV = pYaU + nTotalWidth / 2;
+		BYTE* pU = pDst[1] + 1ULL * dstStep[1] * yTop + roi->left;
+		BYTE* pV = pDst[2] + 1ULL * dstStep[2] * yTop + roi->left;
+
+		size_t x = 0;
+		for (; x < halfWidth - halfPad; x += 32)
+		{
+			avx512_store_odd(&pU[2 * x], &pYaU[x]);
+			avx512_store_odd(&pV[2 * x], &pYaV[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			const size_t odd = 2ULL * x + 1;
+			pU[odd] = pYaU[x];
+			pV[odd] = pYaV[x];
+		}
+	}
+
+	/* B6 - B9 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* pUaU = pSrc[1] + srcStep[1] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pUaV = pUaU + nTotalWidth / 4;
+		const BYTE* pVaU = pSrc[2] + srcStep[2] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pVaV = pVaU + nTotalWidth / 4;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y + 1 + roi->top) + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y + 1 + roi->top) + roi->left;
+
+		UINT32 x = 0;
+		for (; x < quaterWidth - quaterPad; x += 16)
+		{
+			avx512_store_quarter(&pU[4 * x], &pUaU[x], &pVaU[x]);
+			avx512_store_quarter(&pV[4 * x], &pUaV[x], &pVaV[x]);
+		}
+
+		for (; x < quaterWidth; x++)
+		{
+			pU[4 * x + 0] = pUaU[x];
+			pV[4 * x + 0] = pUaV[x];
+			pU[4 * x + 2] = pVaU[x];
+			pV[4 * x + 2] = pVaV[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_YUV420CombineToYUV444(avc444_frame_type type,
+                                              const BYTE* WINPR_RESTRICT pSrc[3],
+                                              const UINT32 srcStep[3], UINT32 nWidth,
+                                              UINT32 nHeight, BYTE* WINPR_RESTRICT pDst[3],
+                                              const UINT32 dstStep[3],
+                                              const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	if (!pSrc || !pSrc[0] || !pSrc[1] || !pSrc[2])
+		return -1;
+
+	if (!pDst || !pDst[0] || !pDst[1] || !pDst[2])
+		return -1;
+
+	if (!roi)
+		return -1;
+
+	switch (type)
+	{
+		case AVC444_LUMA:
+			return avx512_LumaToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv1:
+			return avx512_ChromaV1ToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv2:
+			return avx512_ChromaV2ToYUV444(pSrc, srcStep, nWidth, nHeight, pDst, dstStep, roi);
+
+		default:
+			return -1;
+	}
+}
+#endif
+
+void primitives_init_YUV_avx512_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	WLog_VRB(PRIM_TAG, "AVX-512 optimizations");
+	prims->RGBToYUV420_8u_P3AC4R = avx512_RGBToYUV420;
+	prims->RGBToAVC444YUV = avx512_RGBToAVC444YUV;
+	prims->YUV420CombineToYUV444 = avx512_YUV420CombineToYUV444;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX512 or AVX-512 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -14,6 +14,7 @@
 #include <freerdp/utils/profiler.h>
 
 #include "../prim_internal.h"
+#include "../prim_YUV.h"
 
 #define TAG __FILE__
 
@@ -1403,6 +1404,170 @@ fail:
 	return rc;
 }
 
+/* The wider SIMD implementations must produce the same output as SSE4.1 for
+ * BGRX input, the remainder of a line not filling a vector is handled by the
+ * generic code. The YUV420 combination only copies and must match generic. */
+static BOOL compare_planes(const char* name, const char* plane, BYTE* a[3], BYTE* b[3],
+                           const size_t size[3])
+{
+	for (size_t x = 0; x < 3; x++)
+	{
+		if (memcmp(a[x], b[x], size[x]) != 0)
+		{
+			(void)fprintf(stderr, "[%s] %s plane %" PRIuz " differs\n", name, plane, x);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL compare_simd_level(const char* name, primitives_t* prims, primitives_t* ref,
+                               prim_size_t roi)
+{
+	BOOL rc = FALSE;
+	const UINT32 awidth = roi.width + 64 - roi.width % 64;
+	const UINT32 aheight = roi.height + 16 - roi.height % 16;
+	const UINT32 stride = awidth * 4;
+	const UINT32 uvwidth = awidth / 2;
+	const UINT32 step[3] = { awidth, uvwidth, uvwidth };
+	const UINT32 step444[3] = { awidth, awidth, awidth };
+	const size_t size[3] = { 1ULL * awidth * aheight, 1ULL * uvwidth * aheight / 2,
+		                     1ULL * uvwidth * aheight / 2 };
+	const size_t size444[3] = { 1ULL * awidth * aheight, 1ULL * awidth * aheight,
+		                        1ULL * awidth * aheight };
+	const prim_size_t full = { .width = awidth, .height = roi.height };
+	const RECTANGLE_16 rect = { .left = 0,
+		                        .top = 0,
+		                        .right = WINPR_ASSERTING_INT_CAST(UINT16, roi.width),
+		                        .bottom = WINPR_ASSERTING_INT_CAST(UINT16, roi.height) };
+	BYTE* rgb = winpr_aligned_calloc(aheight, stride, 64);
+	BYTE* main[2][3] = { 0 };
+	BYTE* aux[2][3] = { 0 };
+	BYTE* yuv[2][3] = { 0 };
+
+	if (!rgb)
+		goto fail;
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t x = 0; x < 3; x++)
+		{
+			main[i][x] = winpr_aligned_calloc(1, size[x], 64);
+			aux[i][x] = winpr_aligned_calloc(1, size[x], 64);
+			yuv[i][x] = winpr_aligned_calloc(1, size444[x], 64);
+
+			if (!main[i][x] || !aux[i][x] || !yuv[i][x])
+				goto fail;
+		}
+	}
+
+	winpr_RAND(rgb, 1ULL * aheight * stride);
+
+	/* RGBToYUV420_8u_P3AC4R */
+	if (prims->RGBToYUV420_8u_P3AC4R(rgb, PIXEL_FORMAT_BGRX32, stride, main[0], step, &full) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (ref->RGBToYUV420_8u_P3AC4R(rgb, PIXEL_FORMAT_BGRX32, stride, main[1], step, &full) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (!compare_planes(name, "YUV420", main[0], main[1], size))
+		goto fail;
+
+	/* RGBToAVC444YUV */
+	if (prims->RGBToAVC444YUV(rgb, PIXEL_FORMAT_BGRX32, stride, main[0], step, aux[0], step,
+	                          &full) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (ref->RGBToAVC444YUV(rgb, PIXEL_FORMAT_BGRX32, stride, main[1], step, aux[1], step,
+	                        &full) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (!compare_planes(name, "AVC444 main", main[0], main[1], size) ||
+	    !compare_planes(name, "AVC444 auxiliary", aux[0], aux[1], size))
+		goto fail;
+
+	/* YUV420CombineToYUV444, on the original width to cover the remainder */
+	for (size_t x = 0; x < 3; x++)
+	{
+		winpr_RAND(main[0][x], size[x]);
+		winpr_RAND(aux[0][x], size[x]);
+	}
+
+	for (avc444_frame_type type = AVC444_LUMA; type <= AVC444_CHROMAv2; type++)
+	{
+		const BYTE* cmain[3] = { main[0][0], main[0][1], main[0][2] };
+		const BYTE* caux[3] = { aux[0][0], aux[0][1], aux[0][2] };
+		const BYTE** planes = (type == AVC444_LUMA) ? cmain : caux;
+
+		if (prims->YUV420CombineToYUV444(type, planes, step, awidth, aheight, yuv[0], step444,
+		                                 &rect) != PRIMITIVES_SUCCESS)
+			goto fail;
+
+		if (generic->YUV420CombineToYUV444(type, planes, step, awidth, aheight, yuv[1], step444,
+		                                   &rect) != PRIMITIVES_SUCCESS)
+			goto fail;
+	}
+
+	if (!compare_planes(name, "YUV444 combined", yuv[0], yuv[1], size444))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	printf("[%s][%s] run %s.\n", __func__, name, (rc) ? "SUCCESS" : "FAILED");
+	winpr_aligned_free(rgb);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t x = 0; x < 3; x++)
+		{
+			winpr_aligned_free(main[i][x]);
+			winpr_aligned_free(aux[i][x]);
+			winpr_aligned_free(yuv[i][x]);
+		}
+	}
+
+	return rc;
+}
+
+static BOOL compare_simd_levels(prim_size_t roi)
+{
+	primitives_t sse41 = *primitives_get_generic();
+	primitives_init_YUV_sse41(&sse41);
+
+	if (sse41.RGBToAVC444YUV == generic->RGBToAVC444YUV)
+	{
+		printf("[%s] SSE4.1 not available, skipping\n", __func__);
+		return TRUE;
+	}
+
+	/* Only the combination differs from generic code */
+	if (!compare_simd_level("SSE4.1", &sse41, &sse41, roi))
+		return FALSE;
+
+#if defined(WITH_AVX2)
+	primitives_t avx2 = sse41;
+	primitives_init_YUV_avx2(&avx2);
+
+	if ((avx2.RGBToAVC444YUV != sse41.RGBToAVC444YUV) &&
+	    !compare_simd_level("AVX2", &avx2, &sse41, roi))
+		return FALSE;
+#endif
+
+#if defined(WITH_AVX512)
+	primitives_t avx512 = sse41;
+	primitives_init_YUV_avx512(&avx512);
+
+	if ((avx512.RGBToAVC444YUV != sse41.RGBToAVC444YUV) &&
+	    !compare_simd_level("AVX-512", &avx512, &sse41, roi))
+		return FALSE;
+#endif
+
+	return TRUE;
+}
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -1440,6 +1605,9 @@ int TestPrimitivesYUV(int argc, char* argv[])
 			goto end;
 	}
 
+	if (!compare_simd_levels(roi))
+		goto end;
+
 	if (!run_tests(roi))
 		goto end;
 
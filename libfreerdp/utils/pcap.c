@@ -25,10 +25,18 @@
 
 #include <winpr/wtypes.h>
 #include <winpr/assert.h>
+#include <winpr/cast.h>
 #include <winpr/file.h>
 #include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <freerdp/types.h>
 #include <freerdp/utils/pcap.h>
 
@@ -45,14 +53,144 @@ struct rdp_pcap
 	pcap_record* head;
 	pcap_record* tail;
 	pcap_record* record;
+
+	/* read only mapping of the whole file, fp is NULL if this is used */
+	const BYTE* map;
+	size_t offset;
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+	/* file offset of each record, built on first use */
+	INT64* index;
+
+	/* record data for pcap_get_next_record_view if the file is not mapped */
+	BYTE* buffer;
+	size_t buffer_size;
 };
 
+static BOOL pcap_map(rdpPcap* pcap, const char* name)
+{
+	WINPR_ASSERT(pcap);
+	WINPR_ASSERT(name);
+
+#if defined(_WIN32)
+	LARGE_INTEGER size = { 0 };
+
+	pcap->file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (pcap->file == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!GetFileSizeEx(pcap->file, &size) || (size.QuadPart <= 0) ||
+	    ((UINT64)size.QuadPart > SIZE_MAX))
+		return FALSE;
+
+	pcap->mapping = CreateFileMappingA(pcap->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!pcap->mapping)
+		return FALSE;
+
+	pcap->map = MapViewOfFile(pcap->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pcap->map)
+		return FALSE;
+
+	pcap->file_size = size.QuadPart;
+	return TRUE;
+#else
+	struct stat st = { 0 };
+
+	pcap->fd = open(name, O_RDONLY | O_CLOEXEC);
+	if (pcap->fd < 0)
+		return FALSE;
+
+	if ((fstat(pcap->fd, &st) != 0) || (st.st_size <= 0) || ((UINT64)st.st_size > SIZE_MAX))
+		return FALSE;
+
+	void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, pcap->fd, 0);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	/* replay reads the file front to back, let the kernel read ahead aggressively */
+	(void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	pcap->map = map;
+	pcap->file_size = st.st_size;
+	return TRUE;
+#endif
+}
+
+static void pcap_unmap(rdpPcap* pcap)
+{
+	WINPR_ASSERT(pcap);
+
+#if defined(_WIN32)
+	if (pcap->map)
+		(void)UnmapViewOfFile(pcap->map);
+	if (pcap->mapping)
+		(void)CloseHandle(pcap->mapping);
+	if (pcap->file && (pcap->file != INVALID_HANDLE_VALUE))
+		(void)CloseHandle(pcap->file);
+	pcap->mapping = NULL;
+	pcap->file = NULL;
+#else
+	if (pcap->map)
+		(void)munmap(WINPR_CAST_CONST_PTR_AWAY(pcap->map, void*), (size_t)pcap->file_size);
+	if (pcap->fd >= 0)
+		(void)close(pcap->fd);
+	pcap->fd = -1;
+#endif
+	pcap->map = NULL;
+}
+
+static INT64 pcap_tell(const rdpPcap* pcap)
+{
+	WINPR_ASSERT(pcap);
+
+	if (pcap->map)
+		return (INT64)pcap->offset;
+	return _ftelli64(pcap->fp);
+}
+
+static BOOL pcap_seek(rdpPcap* pcap, INT64 offset)
+{
+	WINPR_ASSERT(pcap);
+
+	if ((offset < 0) || (offset > pcap->file_size))
+		return FALSE;
+
+	if (pcap->map)
+	{
+		pcap->offset = (size_t)offset;
+		return TRUE;
+	}
+	return _fseeki64(pcap->fp, offset, SEEK_SET) == 0;
+}
+
+static BOOL pcap_read(rdpPcap* pcap, void* data, size_t length)
+{
+	WINPR_ASSERT(pcap);
+	WINPR_ASSERT(data || (length == 0));
+
+	if (!pcap->map)
+		return fread(data, length, 1, pcap->fp) == 1;
+
+	if (length > (size_t)pcap->file_size - pcap->offset)
+		return FALSE;
+
+	memcpy(data, &pcap->map[pcap->offset], length);
+	pcap->offset += length;
+	return TRUE;
+}
+
 static BOOL pcap_read_header(rdpPcap* pcap, pcap_header* header)
 {
 	WINPR_ASSERT(pcap);
 	WINPR_ASSERT(header);
 
-	return fread(header, sizeof(pcap_header), 1, pcap->fp) == 1;
+	return pcap_read(pcap, header, sizeof(pcap_header));
 }
 
 static BOOL pcap_write_header(rdpPcap* pcap, const pcap_header* header)
@@ -68,7 +206,7 @@ static BOOL pcap_read_record_header(rdpPcap* pcap, pcap_record_header* record)
 	WINPR_ASSERT(pcap);
 	WINPR_ASSERT(record);
 
-	return fread(record, sizeof(pcap_record_header), 1, pcap->fp) == 1;
+	return pcap_read(pcap, record, sizeof(pcap_record_header));
 }
 
 static BOOL pcap_write_record_header(rdpPcap* pcap, const pcap_record_header* record)
@@ -92,7 +230,7 @@ static BOOL pcap_read_record(rdpPcap* pcap, pcap_record* record)
 	if (!record->data)
 		return FALSE;
 
-	if (fread(record->data, record->length, 1, pcap->fp) != 1)
+	if (!pcap_read(pcap, record->data, record->length))
 	{
 		free(record->data);
 		record->data = NULL;
@@ -131,18 +269,10 @@ BOOL pcap_add_record(rdpPcap* pcap, const void* data, size_t length)
 	record->header.ts_usec = (UINT32)WINPR_TIME_NS_REM_US(ns);
 
 	if (pcap->tail == NULL)
-	{
-		pcap->tail = record;
-		if (!pcap->tail)
-			return FALSE;
-
-		pcap->head = pcap->tail;
-	}
+		pcap->head = record;
 	else
-	{
-		record->next = pcap->tail;
-		pcap->tail = record;
-	}
+		pcap->tail->next = record;
+	pcap->tail = record;
 
 	if (pcap->record == NULL)
 		pcap->record = record;
@@ -154,7 +284,7 @@ BOOL pcap_has_next_record(const rdpPcap* pcap)
 {
 	WINPR_ASSERT(pcap);
 
-	if (pcap->file_size - (_ftelli64(pcap->fp)) <= 16)
+	if (pcap->file_size - pcap_tell(pcap) <= 16)
 		return FALSE;
 
 	return TRUE;
@@ -168,7 +298,8 @@ BOOL pcap_get_next_record_header(rdpPcap* pcap, pcap_record* record)
 	if (pcap_has_next_record(pcap) != TRUE)
 		return FALSE;
 
-	pcap_read_record_header(pcap, &record->header);
+	if (!pcap_read_record_header(pcap, &record->header))
+		return FALSE;
 	record->length = record->header.incl_len;
 
 	return TRUE;
@@ -179,7 +310,7 @@ BOOL pcap_get_next_record_content(rdpPcap* pcap, pcap_record* record)
 	WINPR_ASSERT(pcap);
 	WINPR_ASSERT(record);
 
-	return fread(record->data, record->length, 1, pcap->fp) == 1;
+	return pcap_read(pcap, record->data, record->length);
 }
 
 BOOL pcap_get_next_record(rdpPcap* pcap, pcap_record* record)
@@ -190,6 +321,115 @@ BOOL pcap_get_next_record(rdpPcap* pcap, pcap_record* record)
 	return pcap_has_next_record(pcap) && pcap_read_record(pcap, record);
 }
 
+BOOL pcap_get_next_record_view(rdpPcap* pcap, pcap_record_header* header, wStream* s)
+{
+	WINPR_ASSERT(pcap);
+	WINPR_ASSERT(header);
+	WINPR_ASSERT(s);
+
+	if (!pcap_has_next_record(pcap) || !pcap_read_record_header(pcap, header))
+		return FALSE;
+
+	const size_t length = header->incl_len;
+	if ((INT64)length > pcap->file_size - pcap_tell(pcap))
+		return FALSE;
+
+	if (pcap->map)
+	{
+		Stream_StaticConstInit(s, &pcap->map[pcap->offset], length);
+		pcap->offset += length;
+		return TRUE;
+	}
+
+	if (length > pcap->buffer_size)
+	{
+		BYTE* tmp = realloc(pcap->buffer, length);
+		if (!tmp)
+			return FALSE;
+		pcap->buffer = tmp;
+		pcap->buffer_size = length;
+	}
+
+	if (!pcap_read(pcap, pcap->buffer, length))
+		return FALSE;
+
+	Stream_StaticConstInit(s, pcap->buffer, length);
+	return TRUE;
+}
+
+static BOOL pcap_build_index(rdpPcap* pcap)
+{
+	WINPR_ASSERT(pcap);
+
+	if (pcap->index || pcap->write)
+		return pcap->index != NULL;
+
+	size_t capacity = 0;
+	size_t count = 0;
+	INT64* index = NULL;
+	const INT64 current = pcap_tell(pcap);
+	INT64 offset = sizeof(pcap_header);
+
+	while (pcap->file_size - offset > 16)
+	{
+		pcap_record_header header = { 0 };
+		if (!pcap_seek(pcap, offset) || !pcap_read_record_header(pcap, &header))
+			goto fail;
+
+		/* a truncated last record is not counted */
+		const INT64 next = offset + (INT64)sizeof(pcap_record_header) + header.incl_len;
+		if (next > pcap->file_size)
+			break;
+
+		if (count == capacity)
+		{
+			const size_t ncapacity = (capacity == 0) ? 1024 : capacity * 2;
+			INT64* tmp = realloc(index, ncapacity * sizeof(INT64));
+			if (!tmp)
+				goto fail;
+			index = tmp;
+			capacity = ncapacity;
+		}
+		index[count++] = offset;
+		offset = next;
+	}
+
+	if (!index)
+		index = calloc(1, sizeof(INT64));
+	if (!index || !pcap_seek(pcap, current))
+		goto fail;
+
+	pcap->index = index;
+	pcap->record_count = count;
+	return TRUE;
+
+fail:
+	free(index);
+	(void)pcap_seek(pcap, current);
+	return FALSE;
+}
+
+size_t pcap_get_record_count(rdpPcap* pcap)
+{
+	WINPR_ASSERT(pcap);
+
+	if (!pcap_build_index(pcap))
+		return 0;
+	return pcap->record_count;
+}
+
+BOOL pcap_seek_record(rdpPcap* pcap, size_t index)
+{
+	WINPR_ASSERT(pcap);
+
+	if (!pcap_build_index(pcap) || (index > pcap->record_count))
+		return FALSE;
+
+	if (index == pcap->record_count)
+		return pcap_seek(pcap, pcap->file_size);
+	return pcap_seek(pcap, pcap->index[index]);
+}
+
 rdpPcap* pcap_open(const char* name, BOOL write)
 {
 	WINPR_ASSERT(name);
@@ -198,16 +438,19 @@ rdpPcap* pcap_open(const char* name, BOOL write)
 	if (!pcap)
 		goto fail;
 
+#if !defined(_WIN32)
+	pcap->fd = -1;
+#endif
 	pcap->name = _strdup(name);
 	pcap->write = write;
 	pcap->record_count = 0;
-	pcap->fp = winpr_fopen(name, write ? "w+b" : "rb");
-
-	if (pcap->fp == NULL)
-		goto fail;
 
 	if (write)
 	{
+		pcap->fp = winpr_fopen(name, "w+b");
+		if (pcap->fp == NULL)
+			goto fail;
+
 		pcap->header.magic_number = PCAP_MAGIC;
 		pcap->header.version_major = 2;
 		pcap->header.version_minor = 4;
@@ -220,9 +463,20 @@ rdpPcap* pcap_open(const char* name, BOOL write)
 	}
 	else
 	{
-		(void)_fseeki64(pcap->fp, 0, SEEK_END);
-		pcap->file_size = _ftelli64(pcap->fp);
-		(void)_fseeki64(pcap->fp, 0, SEEK_SET);
+		/* fall back to stdio if the file can not be mapped, e.g. on a 32bit address space */
+		if (!pcap_map(pcap, name))
+		{
+			pcap_unmap(pcap);
+
+			pcap->fp = winpr_fopen(name, "rb");
+			if (pcap->fp == NULL)
+				goto fail;
+
+			(void)_fseeki64(pcap->fp, 0, SEEK_END);
+			pcap->file_size = _ftelli64(pcap->fp);
+			(void)_fseeki64(pcap->fp, 0, SEEK_SET);
+		}
+
 		if (!pcap_read_header(pcap, &pcap->header))
 			goto fail;
 	}
@@ -238,11 +492,16 @@ void pcap_flush(rdpPcap* pcap)
 {
 	WINPR_ASSERT(pcap);
 
+	/* the data of written records is owned by the caller and might be gone after this call */
 	while (pcap->record != NULL)
 	{
-		(void)pcap_write_record(pcap, pcap->record);
-		pcap->record = pcap->record->next;
+		pcap_record* record = pcap->record;
+		(void)pcap_write_record(pcap, record);
+		pcap->record = record->next;
+		free(record);
 	}
+	pcap->head = NULL;
+	pcap->tail = NULL;
 
 	if (pcap->fp != NULL)
 		(void)fflush(pcap->fp);
@@ -257,7 +516,10 @@ void pcap_close(rdpPcap* pcap)
 
 	if (pcap->fp != NULL)
 		(void)fclose(pcap->fp);
+	pcap_unmap(pcap);
 
+	free(pcap->index);
+	free(pcap->buffer);
 	free(pcap->name);
 	free(pcap);
 }
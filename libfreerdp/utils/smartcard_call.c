@@ -32,6 +32,7 @@
 #include <winpr/stream.h>
 #include <winpr/library.h>
 #include <winpr/smartcard.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/rdpdr.h>
@@ -58,6 +59,27 @@
 	ctx->useEmulatedCard ? NULL : ctx->pWinSCardApi->pfn##fkt(__VA_ARGS__)
 #endif
 
+/* Reader lists are refreshed at least this often, even without an observed change */
+#define SCARD_CACHE_TIMEOUT_MS 2000
+#define SCARD_CACHE_MAX_ATTRIBS 64
+
+typedef struct
+{
+	BYTE* mszGroups;
+	DWORD cbGroups;
+	BYTE* msz;
+	DWORD cBytes;
+	UINT64 timestamp;
+} scard_readers_cache;
+
+typedef struct
+{
+	SCARDHANDLE hCard;
+	DWORD dwAttrId;
+	DWORD cbAttrLen;
+	BYTE* pbAttr;
+} scard_attrib_cache;
+
 struct s_scard_call_context
 {
 	BOOL useEmulatedCard;
@@ -75,6 +97,12 @@ struct s_scard_call_context
 
 	void* (*fn_new)(void*, SCARDCONTEXT);
 	void (*fn_free)(void*);
+
+	CRITICAL_SECTION cacheLock;
+	scard_readers_cache readers[2]; /* ANSI and unicode reader lists */
+	scard_attrib_cache attribs[SCARD_CACHE_MAX_ATTRIBS];
+	size_t attribCount;
+	UINT64 cacheGeneration;
 };
 
 struct s_scard_context_element
@@ -85,6 +113,244 @@ struct s_scard_context_element
 
 static void context_free(void* arg);
 
+static void smartcard_cache_free_readers(scard_readers_cache* cache)
+{
+	WINPR_ASSERT(cache);
+
+	free(cache->mszGroups);
+	free(cache->msz);
+	memset(cache, 0, sizeof(scard_readers_cache));
+}
+
+/* Drops all cached attributes and, if requested, the cached reader lists. */
+static void smartcard_cache_invalidate(scard_call_context* smartcard, BOOL readers)
+{
+	WINPR_ASSERT(smartcard);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	for (size_t x = 0; x < smartcard->attribCount; x++)
+		free(smartcard->attribs[x].pbAttr);
+	smartcard->attribCount = 0;
+	smartcard->cacheGeneration++;
+
+	if (readers)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(smartcard->readers); x++)
+			smartcard_cache_free_readers(&smartcard->readers[x]);
+	}
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+static void smartcard_cache_invalidate_card(scard_call_context* smartcard, SCARDHANDLE hCard)
+{
+	WINPR_ASSERT(smartcard);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	for (size_t x = 0; x < smartcard->attribCount;)
+	{
+		scard_attrib_cache* cur = &smartcard->attribs[x];
+		if (cur->hCard == hCard)
+		{
+			free(cur->pbAttr);
+			*cur = smartcard->attribs[--smartcard->attribCount];
+		}
+		else
+			x++;
+	}
+	smartcard->cacheGeneration++;
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+/* Results of calls started before an invalidation must not end up in the cache */
+static UINT64 smartcard_cache_generation(scard_call_context* smartcard)
+{
+	WINPR_ASSERT(smartcard);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	const UINT64 generation = smartcard->cacheGeneration;
+	LeaveCriticalSection(&smartcard->cacheLock);
+	return generation;
+}
+
+static BOOL smartcard_cache_groups_equal(const scard_readers_cache* cache,
+                                         const ListReaders_Call* call)
+{
+	if (!cache->mszGroups || !call->mszGroups)
+		return cache->mszGroups == call->mszGroups;
+	if (cache->cbGroups != call->cBytes)
+		return FALSE;
+	return memcmp(cache->mszGroups, call->mszGroups, call->cBytes) == 0;
+}
+
+/* Returns a copy of the cached reader list, to be released with free() */
+static BOOL smartcard_cache_get_readers(scard_call_context* smartcard, const ListReaders_Call* call,
+                                        BOOL unicode, ListReaders_Return* ret)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(smartcard);
+	WINPR_ASSERT(call);
+	WINPR_ASSERT(ret);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	const scard_readers_cache* cache = &smartcard->readers[unicode ? 1 : 0];
+	if (cache->msz && (GetTickCount64() - cache->timestamp < SCARD_CACHE_TIMEOUT_MS) &&
+	    smartcard_cache_groups_equal(cache, call))
+	{
+		ret->msz = malloc(cache->cBytes);
+		if (ret->msz)
+		{
+			memcpy(ret->msz, cache->msz, cache->cBytes);
+			ret->cBytes = cache->cBytes;
+			ret->ReturnCode = SCARD_S_SUCCESS;
+			rc = TRUE;
+		}
+	}
+	LeaveCriticalSection(&smartcard->cacheLock);
+	return rc;
+}
+
+static void smartcard_cache_put_readers(scard_call_context* smartcard, UINT64 generation,
+                                        const ListReaders_Call* call, BOOL unicode, const BYTE* msz,
+                                        DWORD cBytes)
+{
+	WINPR_ASSERT(smartcard);
+	WINPR_ASSERT(call);
+
+	/* an empty list is not cached, a reader is likely about to show up */
+	if (!msz || (cBytes == 0))
+		return;
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	if (generation != smartcard->cacheGeneration)
+	{
+		LeaveCriticalSection(&smartcard->cacheLock);
+		return;
+	}
+
+	scard_readers_cache* cache = &smartcard->readers[unicode ? 1 : 0];
+	smartcard_cache_free_readers(cache);
+
+	cache->msz = malloc(cBytes);
+	if (call->mszGroups && (call->cBytes > 0))
+		cache->mszGroups = malloc(call->cBytes);
+
+	if (!cache->msz || (call->mszGroups && (call->cBytes > 0) && !cache->mszGroups))
+		smartcard_cache_free_readers(cache);
+	else
+	{
+		memcpy(cache->msz, msz, cBytes);
+		cache->cBytes = cBytes;
+		if (cache->mszGroups)
+		{
+			memcpy(cache->mszGroups, call->mszGroups, call->cBytes);
+			cache->cbGroups = call->cBytes;
+		}
+		cache->timestamp = GetTickCount64();
+	}
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+/* Attributes describing the reader itself, these do not change while a handle is open */
+static BOOL smartcard_cache_attrib_is_static(DWORD dwAttrId)
+{
+	switch (dwAttrId)
+	{
+		case SCARD_ATTR_VENDOR_NAME:
+		case SCARD_ATTR_VENDOR_IFD_TYPE:
+		case SCARD_ATTR_VENDOR_IFD_VERSION:
+		case SCARD_ATTR_VENDOR_IFD_SERIAL_NO:
+		case SCARD_ATTR_CHANNEL_ID:
+		case SCARD_ATTR_CHARACTERISTICS:
+		case SCARD_ATTR_DEVICE_UNIT:
+		case SCARD_ATTR_DEVICE_FRIENDLY_NAME_A:
+		case SCARD_ATTR_DEVICE_FRIENDLY_NAME_W:
+		case SCARD_ATTR_DEVICE_SYSTEM_NAME_A:
+		case SCARD_ATTR_DEVICE_SYSTEM_NAME_W:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/* Returns a copy of a cached attribute, to be released with free() */
+static BOOL smartcard_cache_get_attrib(scard_call_context* smartcard, SCARDHANDLE hCard,
+                                       DWORD dwAttrId, BYTE** ppbAttr, DWORD* pcbAttrLen)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(smartcard);
+	WINPR_ASSERT(ppbAttr);
+	WINPR_ASSERT(pcbAttrLen);
+
+	if (!smartcard_cache_attrib_is_static(dwAttrId))
+		return FALSE;
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	for (size_t x = 0; x < smartcard->attribCount; x++)
+	{
+		const scard_attrib_cache* cur = &smartcard->attribs[x];
+		if ((cur->hCard != hCard) || (cur->dwAttrId != dwAttrId))
+			continue;
+
+		*ppbAttr = malloc(cur->cbAttrLen);
+		if (*ppbAttr)
+		{
+			memcpy(*ppbAttr, cur->pbAttr, cur->cbAttrLen);
+			*pcbAttrLen = cur->cbAttrLen;
+			rc = TRUE;
+		}
+		break;
+	}
+	LeaveCriticalSection(&smartcard->cacheLock);
+	return rc;
+}
+
+static void smartcard_cache_put_attrib(scard_call_context* smartcard, UINT64 generation,
+                                       SCARDHANDLE hCard, DWORD dwAttrId, const BYTE* pbAttr,
+                                       DWORD cbAttrLen)
+{
+	WINPR_ASSERT(smartcard);
+
+	if (!smartcard_cache_attrib_is_static(dwAttrId) || !pbAttr || (cbAttrLen == 0))
+		return;
+
+	BYTE* copy = malloc(cbAttrLen);
+	if (!copy)
+		return;
+	memcpy(copy, pbAttr, cbAttrLen);
+
+	EnterCriticalSection(&smartcard->cacheLock);
+	if (generation != smartcard->cacheGeneration)
+	{
+		LeaveCriticalSection(&smartcard->cacheLock);
+		free(copy);
+		return;
+	}
+
+	if (smartcard->attribCount >= ARRAYSIZE(smartcard->attribs))
+	{
+		for (size_t x = 0; x < smartcard->attribCount; x++)
+			free(smartcard->attribs[x].pbAttr);
+		smartcard->attribCount = 0;
+	}
+
+	scard_attrib_cache* cur = &smartcard->attribs[smartcard->attribCount++];
+	cur->hCard = hCard;
+	cur->dwAttrId = dwAttrId;
+	cur->cbAttrLen = cbAttrLen;
+	cur->pbAttr = copy;
+	LeaveCriticalSection(&smartcard->cacheLock);
+}
+
+/* A changed reader state, a new reader or a removed one invalidates everything cached so far */
+static void smartcard_cache_check_status_change(scard_call_context* smartcard, LONG status,
+                                                BOOL changed)
+{
+	if (changed || (status == SCARD_E_UNKNOWN_READER) || (status == SCARD_E_NO_READERS_AVAILABLE))
+		smartcard_cache_invalidate(smartcard, TRUE);
+}
+
 static LONG smartcard_EstablishContext_Call(scard_call_context* smartcard, wStream* out,
                                             SMARTCARD_OPERATION* operation)
 {
@@ -149,6 +415,8 @@ static LONG smartcard_ReleaseContext_Call(scard_call_context* smartcard,
 	WINPR_ASSERT(out);
 	WINPR_ASSERT(operation);
 
+	/* handles of the context are gone, a new one might reuse their values */
+	smartcard_cache_invalidate(smartcard, FALSE);
 	ret.ReturnCode = wrap(smartcard, SCardReleaseContext, operation->hContext);
 
 	if (ret.ReturnCode == SCARD_S_SUCCESS)
@@ -334,6 +602,23 @@ static DWORD filter_device_by_name_w(wLinkedList* list, LPWSTR* mszReaders, DWOR
 	return rc;
 }
 
+static BOOL smartcard_ListReaders_Cached(scard_call_context* smartcard, wStream* out,
+                                         const ListReaders_Call* call, BOOL unicode, LONG* result)
+{
+	ListReaders_Return ret = { 0 };
+
+	WINPR_ASSERT(result);
+
+	if (!smartcard_cache_get_readers(smartcard, call, unicode, &ret))
+		return FALSE;
+
+	*result = smartcard_pack_list_readers_return(out, &ret, unicode);
+	free(ret.msz);
+	if (*result == SCARD_S_SUCCESS)
+		*result = ret.ReturnCode;
+	return TRUE;
+}
+
 static LONG smartcard_ListReadersA_Call(scard_call_context* smartcard, wStream* out,
                                         SMARTCARD_OPERATION* operation)
 {
@@ -345,8 +630,13 @@ static LONG smartcard_ListReadersA_Call(scard_call_context* smartcard, wStream*
 	WINPR_ASSERT(operation);
 
 	ListReaders_Call* call = &operation->call.listReaders;
+	LONG status = SCARD_S_SUCCESS;
+	if (smartcard_ListReaders_Cached(smartcard, out, call, FALSE, &status))
+		return status;
+
+	const UINT64 generation = smartcard_cache_generation(smartcard);
 	DWORD cchReaders = SCARD_AUTOALLOCATE;
-	LONG status = ret.ReturnCode = wrap(smartcard, SCardListReadersA, operation->hContext,
+	status = ret.ReturnCode = wrap(smartcard, SCardListReadersA, operation->hContext,
 	                                    (LPCSTR)call->mszGroups, (LPSTR)&mszReaders, &cchReaders);
 	if (status == SCARD_S_SUCCESS)
 	{
@@ -363,6 +653,7 @@ static LONG smartcard_ListReadersA_Call(scard_call_context* smartcard, wStream*
 	cchReaders = filter_device_by_name_a(smartcard->names, &mszReaders, cchReaders);
 	ret.msz = (BYTE*)mszReaders;
 	ret.cBytes = cchReaders;
+	smartcard_cache_put_readers(smartcard, generation, call, FALSE, ret.msz, ret.cBytes);
 
 	status = smartcard_pack_list_readers_return(out, &ret, FALSE);
 	if (mszReaders)
@@ -399,7 +690,10 @@ static LONG smartcard_ListReadersW_Call(scard_call_context* smartcard, wStream*
 	WINPR_ASSERT(operation);
 
 	call = &operation->call.listReaders;
+	if (smartcard_ListReaders_Cached(smartcard, out, call, TRUE, &status))
+		return status;
 
+	const UINT64 generation = smartcard_cache_generation(smartcard);
 	string.bp = call->mszGroups;
 	cchReaders = SCARD_AUTOALLOCATE;
 	status = ret.ReturnCode = wrap(smartcard, SCardListReadersW, operation->hContext, string.wz,
@@ -419,6 +713,7 @@ static LONG smartcard_ListReadersW_Call(scard_call_context* smartcard, wStream*
 	cchReaders = filter_device_by_name_w(smartcard->names, &mszReaders.pw, cchReaders);
 	ret.msz = mszReaders.pb;
 	ret.cBytes = cchReaders * sizeof(WCHAR);
+	smartcard_cache_put_readers(smartcard, generation, call, TRUE, ret.msz, ret.cBytes);
 	status = smartcard_pack_list_readers_return(out, &ret, TRUE);
 
 	if (mszReaders.pb)
@@ -956,6 +1251,7 @@ static LONG smartcard_GetStatusChangeA_Call(scard_call_context* smartcard, wStre
 	}
 	scard_log_status_error(TAG, "SCardGetStatusChangeA", ret.ReturnCode);
 
+	BOOL changed = FALSE;
 	for (UINT32 index = 0; index < ret.cReaders; index++)
 	{
 		const SCARD_READERSTATEA* cur = &rgReaderStates[index];
@@ -965,7 +1261,10 @@ static LONG smartcard_GetStatusChangeA_Call(scard_call_context* smartcard, wStre
 		rout->dwEventState = cur->dwEventState;
 		rout->cbAtr = cur->cbAtr;
 		CopyMemory(&(rout->rgbAtr), cur->rgbAtr, sizeof(rout->rgbAtr));
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && (cur->dwEventState & SCARD_STATE_CHANGED))
+			changed = TRUE;
 	}
+	smartcard_cache_check_status_change(smartcard, ret.ReturnCode, changed);
 
 	status = smartcard_pack_get_status_change_return(out, &ret, FALSE);
 fail:
@@ -1019,6 +1318,7 @@ static LONG smartcard_GetStatusChangeW_Call(scard_call_context* smartcard, wStre
 	}
 	scard_log_status_error(TAG, "SCardGetStatusChangeW", ret.ReturnCode);
 
+	BOOL changed = FALSE;
 	for (UINT32 index = 0; index < ret.cReaders; index++)
 	{
 		const SCARD_READERSTATEW* cur = &rgReaderStates[index];
@@ -1028,7 +1328,10 @@ static LONG smartcard_GetStatusChangeW_Call(scard_call_context* smartcard, wStre
 		rout->dwEventState = cur->dwEventState;
 		rout->cbAtr = cur->cbAtr;
 		CopyMemory(&(rout->rgbAtr), cur->rgbAtr, sizeof(rout->rgbAtr));
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && (cur->dwEventState & SCARD_STATE_CHANGED))
+			changed = TRUE;
 	}
+	smartcard_cache_check_status_change(smartcard, ret.ReturnCode, changed);
 
 	status = smartcard_pack_get_status_change_return(out, &ret, TRUE);
 fail:
@@ -1138,6 +1441,7 @@ static LONG smartcard_Reconnect_Call(scard_call_context* smartcard, wStream* out
 	WINPR_ASSERT(operation);
 
 	call = &operation->call.reconnect;
+	smartcard_cache_invalidate_card(smartcard, operation->hCard);
 	ret.ReturnCode =
 	    wrap(smartcard, SCardReconnect, operation->hCard, call->dwShareMode,
 	         call->dwPreferredProtocols, call->dwInitialization, &ret.dwActiveProtocol);
@@ -1161,6 +1465,7 @@ static LONG smartcard_Disconnect_Call(scard_call_context* smartcard, WINPR_ATTR_
 
 	call = &operation->call.hCardAndDisposition;
 
+	smartcard_cache_invalidate_card(smartcard, operation->hCard);
 	ret.ReturnCode = wrap(smartcard, SCardDisconnect, operation->hCard, call->dwDisposition);
 	scard_log_status_error(TAG, "SCardDisconnect", ret.ReturnCode);
 	smartcard_trace_long_return(&ret, "Disconnect");
@@ -1439,11 +1744,40 @@ static LONG smartcard_GetAttrib_Call(scard_call_context* smartcard, wStream* out
 		pbAttr = autoAllocate ? (LPBYTE) & (ret.pbAttr) : ret.pbAttr;
 	}
 
-	ret.ReturnCode =
-	    wrap(smartcard, SCardGetAttrib, operation->hCard, call->dwAttrId, pbAttr, &cbAttrLen);
-	scard_log_status_error(TAG, "SCardGetAttrib", ret.ReturnCode);
-	if ((ret.ReturnCode == SCARD_S_SUCCESS) && (cbAttrLen == SCARD_AUTOALLOCATE))
-		return SCARD_F_UNKNOWN_ERROR;
+	BYTE* cached = NULL;
+	DWORD cbCached = 0;
+	if (smartcard_cache_get_attrib(smartcard, operation->hCard, call->dwAttrId, &cached,
+	                               &cbCached) &&
+	    (call->fpbAttrIsNULL || autoAllocate || (cbCached <= cbAttrLen)))
+	{
+		ret.ReturnCode = SCARD_S_SUCCESS;
+		cbAttrLen = cbCached;
+		if (autoAllocate)
+		{
+			/* the copy is owned by us, release it with free() */
+			ret.pbAttr = cached;
+			cached = NULL;
+			autoAllocate = FALSE;
+		}
+		else if (!call->fpbAttrIsNULL)
+			memcpy(ret.pbAttr, cached, cbCached);
+		free(cached);
+	}
+	else
+	{
+		free(cached);
+
+		const UINT64 generation = smartcard_cache_generation(smartcard);
+		ret.ReturnCode =
+		    wrap(smartcard, SCardGetAttrib, operation->hCard, call->dwAttrId, pbAttr, &cbAttrLen);
+		scard_log_status_error(TAG, "SCardGetAttrib", ret.ReturnCode);
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && (cbAttrLen == SCARD_AUTOALLOCATE))
+			return SCARD_F_UNKNOWN_ERROR;
+
+		if ((ret.ReturnCode == SCARD_S_SUCCESS) && !call->fpbAttrIsNULL)
+			smartcard_cache_put_attrib(smartcard, generation, operation->hCard, call->dwAttrId,
+			                           ret.pbAttr, cbAttrLen);
+	}
 
 	ret.cbAttrLen = cbAttrLen;
 
@@ -1896,7 +2230,9 @@ scard_call_context* smartcard_call_context_new(const rdpSettings* settings)
 	WINPR_ASSERT(settings);
 	ctx = calloc(1, sizeof(scard_call_context));
 	if (!ctx)
-		goto fail;
+		return NULL;
+
+	InitializeCriticalSection(&ctx->cacheLock);
 
 	ctx->stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
 	if (!ctx->stopEvent)
@@ -2003,6 +2339,8 @@ void smartcard_call_context_free(scard_call_context* ctx)
 
 	HashTable_Free(ctx->rgSCardContextList);
 	(void)CloseHandle(ctx->stopEvent);
+	smartcard_cache_invalidate(ctx, TRUE);
+	DeleteCriticalSection(&ctx->cacheLock);
 	free(ctx);
 }
 
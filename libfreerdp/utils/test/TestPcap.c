@@ -0,0 +1,156 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/stream.h>
+
+#include <freerdp/utils/pcap.h>
+
+#define TEST_RECORDS 100
+
+static size_t record_length(size_t index)
+{
+	return (index * 37) % 512;
+}
+
+static BYTE record_value(size_t index, size_t offset)
+{
+	return (BYTE)(index + offset);
+}
+
+static BOOL write_capture(const char* name, BYTE* data)
+{
+	rdpPcap* pcap = pcap_open(name, TRUE);
+	if (!pcap)
+		return FALSE;
+
+	BOOL rc = TRUE;
+	for (size_t x = 0; x < TEST_RECORDS; x++)
+	{
+		BYTE* cur = &data[512 * x];
+		for (size_t y = 0; y < record_length(x); y++)
+			cur[y] = record_value(x, y);
+
+		if (!pcap_add_record(pcap, cur, record_length(x)))
+			rc = FALSE;
+
+		/* records added between flushes must be written once each and in order */
+		if ((x % 3) == 0)
+			pcap_flush(pcap);
+	}
+
+	pcap_close(pcap);
+	return rc;
+}
+
+static BOOL check_view(rdpPcap* pcap, size_t index)
+{
+	wStream sbuffer = { 0 };
+	pcap_record_header header = { 0 };
+
+	if (!pcap_get_next_record_view(pcap, &header, &sbuffer))
+	{
+		(void)fprintf(stderr, "record %" PRIuz " missing\n", index);
+		return FALSE;
+	}
+
+	if ((header.incl_len != record_length(index)) ||
+	    (Stream_GetRemainingLength(&sbuffer) != record_length(index)))
+		return FALSE;
+
+	const BYTE* cur = Stream_ConstPointer(&sbuffer);
+	for (size_t y = 0; y < header.incl_len; y++)
+	{
+		if (cur[y] != record_value(index, y))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_read(const char* name)
+{
+	BOOL rc = FALSE;
+	wStream sbuffer = { 0 };
+	pcap_record_header header = { 0 };
+	pcap_record record = { 0 };
+
+	rdpPcap* pcap = pcap_open(name, FALSE);
+	if (!pcap)
+		return FALSE;
+
+	/* counting must not change the read position */
+	if (pcap_get_record_count(pcap) != TEST_RECORDS)
+		goto fail;
+
+	for (size_t x = 0; x < TEST_RECORDS; x++)
+	{
+		if (!check_view(pcap, x))
+			goto fail;
+	}
+	if (pcap_has_next_record(pcap) || pcap_get_next_record_view(pcap, &header, &sbuffer))
+		goto fail;
+
+	const size_t indices[] = { 42, 0, TEST_RECORDS - 1, 7, 7 };
+	for (size_t x = 0; x < ARRAYSIZE(indices); x++)
+	{
+		if (!pcap_seek_record(pcap, indices[x]) || !check_view(pcap, indices[x]))
+			goto fail;
+	}
+
+	if (!pcap_seek_record(pcap, TEST_RECORDS) || pcap_has_next_record(pcap))
+		goto fail;
+	if (pcap_seek_record(pcap, TEST_RECORDS + 1))
+		goto fail;
+
+	/* the copying API still works on the same file */
+	if (!pcap_seek_record(pcap, 5) || !pcap_get_next_record(pcap, &record))
+		goto fail;
+	if (record.length != record_length(5))
+		goto fail;
+	for (size_t y = 0; y < record.length; y++)
+	{
+		if (((const BYTE*)record.data)[y] != record_value(5, y))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(record.data);
+	pcap_close(pcap);
+	return rc;
+}
+
+int TestPcap(int argc, char* argv[])
+{
+	int rc = -1;
+	char filename[64] = { 0 };
+	char* path = NULL;
+	char* name = NULL;
+	BYTE* data = NULL;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	(void)_snprintf(filename, sizeof(filename), "TestPcap-%" PRIu32 ".pcap",
+	                GetCurrentProcessId());
+	path = GetKnownPath(KNOWN_PATH_TEMP);
+	name = GetCombinedPath(path, filename);
+	data = calloc(TEST_RECORDS, 512);
+	if (!name || !data)
+		goto fail;
+
+	if (!write_capture(name, data))
+		goto fail;
+	if (!test_read(name))
+		goto fail;
+
+	rc = 0;
+fail:
+	if (name)
+		(void)winpr_DeleteFile(name);
+	free(data);
+	free(name);
+	free(path);
+	return rc;
+}
@@ -0,0 +1,49 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Static Tracepoints
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+
+#include <freerdp/utils/tracepoint.h>
+
+/* {67d2ccac-da3c-4240-aac1-c6474bf02db5} */
+TRACELOGGING_DEFINE_PROVIDER(freerdp_trace_provider, "FreeRDP",
+                             (0x67d2ccac, 0xda3c, 0x4240, 0xaa, 0xc1, 0xc6, 0x47, 0x4b, 0xf0,
+                              0x2d, 0xb5));
+
+static INIT_ONCE freerdp_trace_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK freerdp_trace_register(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	/* stays registered for the lifetime of the process */
+	return SUCCEEDED(TraceLoggingRegister(freerdp_trace_provider));
+}
+
+void freerdp_tracepoint(const char* name, UINT64 frameId, UINT64 value)
+{
+	if (!InitOnceExecuteOnce(&freerdp_trace_once, freerdp_trace_register, NULL, NULL))
+		return;
+
+	TraceLoggingWrite(freerdp_trace_provider, "Tracepoint", TraceLoggingString(name, "Stage"),
+	                  TraceLoggingUInt64(frameId, "FrameId"), TraceLoggingUInt64(value, "Value"));
+}
@@ -0,0 +1,177 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Sample Server (Echo Benchmark)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+
+#include "sfreerdp.h"
+
+#include "sf_echo.h"
+
+#include <freerdp/server/server-common.h>
+
+#include <freerdp/log.h>
+#define TAG SERVER_TAG("sample.echo")
+
+BOOL sf_echo_parse_benchmark(const char* arg, ECHO_SERVER_BENCHMARK_SETTINGS* settings)
+{
+	UINT32 values[4] = { 0 };
+
+	WINPR_ASSERT(arg);
+	WINPR_ASSERT(settings);
+
+	size_t count = 0;
+	for (const char* cur = arg; count < ARRAYSIZE(values); count++)
+	{
+		char* end = NULL;
+		errno = 0;
+		const unsigned long val = strtoul(cur, &end, 10);
+		if ((errno != 0) || (end == cur) || (val > UINT32_MAX))
+			return FALSE;
+		values[count] = (UINT32)val;
+
+		if (*end == '\0')
+		{
+			count++;
+			break;
+		}
+		if (*end != ':')
+			return FALSE;
+		cur = end + 1;
+	}
+
+	if ((count < 3) || (values[0] < ECHO_SERVER_BENCHMARK_HEADER_SIZE) || (values[2] == 0))
+		return FALSE;
+
+	*settings = (ECHO_SERVER_BENCHMARK_SETTINGS){ .PayloadSize = values[0],
+		                                          .Rate = values[1],
+		                                          .Count = values[2],
+		                                          .Window = values[3] };
+	return TRUE;
+}
+
+static DWORD WINAPI sf_peer_echo_benchmark_thread(LPVOID arg)
+{
+	testPeerContext* context = arg;
+	ECHO_SERVER_BENCHMARK_RESULT result = { 0 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->echo);
+
+	const ECHO_SERVER_BENCHMARK_SETTINGS* settings = &context->echo_settings;
+	const UINT rc = context->echo->Benchmark(context->echo, settings, &result);
+	if (rc != CHANNEL_RC_OK)
+		WLog_ERR(TAG, "echo benchmark failed with error %" PRIu32, rc);
+	else
+		WLog_INFO(TAG,
+		          "echo benchmark %" PRIu32 " bytes at %" PRIu32 "/s: sent %" PRIu32
+		          ", received %" PRIu32 ", invalid %" PRIu32 ", %" PRIu64
+		          " bytes/s, rtt [us] min %" PRIu64 " p50 %" PRIu64 " p90 %" PRIu64
+		          " p99 %" PRIu64 " max %" PRIu64,
+		          settings->PayloadSize, settings->Rate, result.Sent, result.Received,
+		          result.Invalid, result.Throughput, result.RttMin, result.RttP50, result.RttP90,
+		          result.RttP99, result.RttMax);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT sf_peer_echo_open_result(echo_server_context* echo, ECHO_SERVER_OPEN_RESULT result)
+{
+	WINPR_ASSERT(echo);
+
+	testPeerContext* context = echo->data;
+	WINPR_ASSERT(context);
+
+	if (result != ECHO_SERVER_OPEN_RESULT_OK)
+	{
+		WLog_WARN(TAG, "echo channel not opened: %d", result);
+		return CHANNEL_RC_OK;
+	}
+
+	/* the benchmark blocks, the channel thread calling us has to keep reading responses */
+	if (!sf_peer_echo_benchmark(context))
+		return ERROR_INTERNAL_ERROR;
+	return CHANNEL_RC_OK;
+}
+
+void sf_peer_echo_init(testPeerContext* context, const ECHO_SERVER_BENCHMARK_SETTINGS* settings)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(settings);
+
+	context->echo_settings = *settings;
+	context->echo = echo_server_context_new(context->vcm);
+	WINPR_ASSERT(context->echo);
+
+	context->echo->rdpcontext = &context->_p;
+	context->echo->data = context;
+	context->echo->OpenResult = sf_peer_echo_open_result;
+}
+
+BOOL sf_peer_echo_start(testPeerContext* context)
+{
+	if (!context || !context->echo || !context->echo->Open || context->echo_started)
+		return FALSE;
+
+	context->echo_started = TRUE;
+	return context->echo->Open(context->echo) == CHANNEL_RC_OK;
+}
+
+BOOL sf_peer_echo_benchmark(testPeerContext* context)
+{
+	if (!context || !context->echo)
+		return FALSE;
+
+	if (context->echo_thread)
+	{
+		if (WaitForSingleObject(context->echo_thread, 0) != WAIT_OBJECT_0)
+		{
+			WLog_WARN(TAG, "echo benchmark still running");
+			return TRUE;
+		}
+		(void)CloseHandle(context->echo_thread);
+	}
+
+	context->echo_thread = CreateThread(NULL, 0, sf_peer_echo_benchmark_thread, context, 0, NULL);
+	return context->echo_thread != NULL;
+}
+
+void sf_peer_echo_uninit(testPeerContext* context)
+{
+	WINPR_ASSERT(context);
+
+	/* closing the channel makes a running benchmark return */
+	if (context->echo && context->echo->Close)
+		context->echo->Close(context->echo);
+
+	if (context->echo_thread)
+	{
+		(void)WaitForSingleObject(context->echo_thread, INFINITE);
+		(void)CloseHandle(context->echo_thread);
+		context->echo_thread = NULL;
+	}
+
+	echo_server_context_free(context->echo);
+	context->echo = NULL;
+}
@@ -0,0 +1,38 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Sample Server (Echo Benchmark)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SAMPLE_SF_ECHO_H
+#define FREERDP_SERVER_SAMPLE_SF_ECHO_H
+
+#include <freerdp/freerdp.h>
+#include <freerdp/listener.h>
+#include <freerdp/server/echo.h>
+
+#include "sfreerdp.h"
+
+/* <size>:<rate>:<count>[:<window>] */
+BOOL sf_echo_parse_benchmark(const char* arg, ECHO_SERVER_BENCHMARK_SETTINGS* settings);
+
+void sf_peer_echo_init(testPeerContext* context, const ECHO_SERVER_BENCHMARK_SETTINGS* settings);
+void sf_peer_echo_uninit(testPeerContext* context);
+
+BOOL sf_peer_echo_start(testPeerContext* context);
+
+/* Starts another benchmark run unless one is still running */
+BOOL sf_peer_echo_benchmark(testPeerContext* context);
+
+#endif /* FREERDP_SERVER_SAMPLE_SF_ECHO_H */
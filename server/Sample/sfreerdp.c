@@ -50,6 +50,9 @@
 
 #include "sf_ainput.h"
 #include "sf_audin.h"
+#if defined(CHANNEL_ECHO_SERVER)
+#include "sf_echo.h"
+#endif
 #include "sf_rdpsnd.h"
 #include "sf_encomsp.h"
 
@@ -69,6 +72,9 @@ struct server_info
 	const char* replay_dump;
 	const char* cert;
 	const char* key;
+#if defined(CHANNEL_ECHO_SERVER)
+	ECHO_SERVER_BENCHMARK_SETTINGS echo_bench;
+#endif
 };
 
 static void test_peer_context_free(freerdp_peer* client, rdpContext* ctx)
@@ -102,6 +108,10 @@ static void test_peer_context_free(freerdp_peer* client, rdpContext* ctx)
 		sf_peer_ainput_uninit(context);
 #endif
 
+#if defined(CHANNEL_ECHO_SERVER)
+		sf_peer_echo_uninit(context);
+#endif
+
 		rdpsnd_server_context_free(context->rdpsnd);
 		encomsp_server_context_free(context->encomsp);
 
@@ -527,12 +537,13 @@ static BOOL test_sleep_tsdiff(UINT32* old_sec, UINT32* old_usec, UINT32 new_sec,
 static BOOL tf_peer_dump_rfx(freerdp_peer* client)
 {
 	BOOL rc = FALSE;
-	wStream* s = NULL;
+	wStream sbuffer = { 0 };
+	wStream* s = &sbuffer;
 	UINT32 prev_seconds = 0;
 	UINT32 prev_useconds = 0;
 	rdpUpdate* update = NULL;
 	rdpPcap* pcap_rfx = NULL;
-	pcap_record record = { 0 };
+	pcap_record_header record = { 0 };
 
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->context);
@@ -540,11 +551,6 @@ static BOOL tf_peer_dump_rfx(freerdp_peer* client)
 	struct server_info* info = client->ContextExtra;
 	WINPR_ASSERT(info);
 
-	s = Stream_New(NULL, 512);
-
-	if (!s)
-		return FALSE;
-
 	update = client->context->update;
 	WINPR_ASSERT(update);
 
@@ -554,21 +560,14 @@ static BOOL tf_peer_dump_rfx(freerdp_peer* client)
 
 	prev_seconds = prev_useconds = 0;
 
-	while (pcap_has_next_record(pcap_rfx))
+	while (pcap_get_next_record_view(pcap_rfx, &record, s))
 	{
-		if (!pcap_get_next_record_header(pcap_rfx, &record))
-			break;
-
-		if (!Stream_EnsureCapacity(s, record.length))
-			break;
-
-		record.data = Stream_Buffer(s);
-		pcap_get_next_record_content(pcap_rfx, &record);
-		Stream_SetPosition(s, Stream_Capacity(s));
+		/* SurfaceCommand sends everything up to the current position */
+		Stream_SetPosition(s, Stream_Length(s));
 
 		if (info->test_dump_rfx_realtime &&
-		    test_sleep_tsdiff(&prev_seconds, &prev_useconds, record.header.ts_sec,
-		                      record.header.ts_usec) == FALSE)
+		    test_sleep_tsdiff(&prev_seconds, &prev_useconds, record.ts_sec, record.ts_usec) ==
+		        FALSE)
 			break;
 
 		WINPR_ASSERT(update->SurfaceCommand);
@@ -581,7 +580,6 @@ static BOOL tf_peer_dump_rfx(freerdp_peer* client)
 
 	rc = TRUE;
 fail:
-	Stream_Free(s, TRUE);
 	pcap_close(pcap_rfx);
 	return rc;
 }
@@ -764,6 +762,14 @@ static BOOL tf_peer_post_connect(freerdp_peer* client)
 	sf_peer_ainput_init(context);
 #endif
 
+#if defined(CHANNEL_ECHO_SERVER)
+	{
+		const struct server_info* info = client->ContextExtra;
+		WINPR_ASSERT(info);
+		sf_peer_echo_init(context, &info->echo_bench);
+	}
+#endif
+
 	/* Return FALSE here would stop the execution of the peer main loop. */
 	return TRUE;
 }
@@ -902,6 +908,13 @@ static BOOL tf_peer_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
 	{
 		tcontext->ainput_open = !tcontext->ainput_open;
 	}
+#endif
+#if defined(CHANNEL_ECHO_SERVER)
+	else if (((flags & KBD_FLAGS_RELEASE) == 0) && code == RDP_SCANCODE_KEY_E) /* 'e' key */
+	{
+		if (tcontext->echo_settings.Count > 0)
+			sf_peer_echo_benchmark(tcontext);
+	}
 #endif
 	else if (((flags & KBD_FLAGS_RELEASE) == 0) && code == RDP_SCANCODE_KEY_S) /* 's' key */
 	{
@@ -1261,6 +1274,11 @@ static DWORD WINAPI test_peer_mainloop(LPVOID arg)
 					}
 #endif
 
+#if defined(CHANNEL_ECHO_SERVER)
+					if ((context->echo_settings.Count > 0) && !context->echo_started)
+						sf_peer_echo_start(context);
+#endif
+
 					break;
 
 				case DRDYNVC_STATE_FAILED:
@@ -1345,7 +1363,9 @@ static const struct
 	const char slocal_only[13];
 	const char scert[7];
 	const char skey[6];
-} options = { "--pcap=", "--fast", "--port=", "--local-only", "--cert=", "--key=" };
+	const char secho_bench[13];
+} options = { "--pcap=",  "--fast", "--port=",       "--local-only",
+	          "--cert=", "--key=",  "--echo-bench=" };
 
 WINPR_PRAGMA_DIAG_PUSH
 WINPR_PRAGMA_DIAG_IGNORED_FORMAT_NONLITERAL
@@ -1371,6 +1391,10 @@ static int usage(const char* app, const char* invalid)
 	print_entry(fp, "\t%s\n", options.sfast, sizeof(options.sfast));
 	print_entry(fp, "\t%s<port>\n", options.sport, sizeof(options.sport));
 	print_entry(fp, "\t%s\n", options.slocal_only, sizeof(options.slocal_only));
+#if defined(CHANNEL_ECHO_SERVER)
+	print_entry(fp, "\t%s<size>:<rate>:<count>[:<window>]\n", options.secho_bench,
+	            sizeof(options.secho_bench));
+#endif
 	return -1;
 }
 
@@ -1425,6 +1449,13 @@ int main(int argc, char* argv[])
 			if (!winpr_PathFileExists(info.key))
 				return usage(app, arg);
 		}
+#if defined(CHANNEL_ECHO_SERVER)
+		else if (strncmp(arg, options.secho_bench, sizeof(options.secho_bench)) == 0)
+		{
+			if (!sf_echo_parse_benchmark(&arg[sizeof(options.secho_bench)], &info.echo_bench))
+				return usage(app, arg);
+		}
+#endif
 		else
 			return usage(app, arg);
 	}
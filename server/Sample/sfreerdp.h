@@ -31,6 +31,9 @@
 #if defined(CHANNEL_AUDIN_SERVER)
 #include <freerdp/server/audin.h>
 #endif
+#if defined(CHANNEL_ECHO_SERVER)
+#include <freerdp/server/echo.h>
+#endif
 #include <freerdp/server/rdpsnd.h>
 #include <freerdp/server/encomsp.h>
 #include <freerdp/transport_io.h>
@@ -63,6 +66,12 @@ struct test_peer_context
 #if defined(CHANNEL_AINPUT_SERVER)
 	ainput_server_context* ainput;
 	BOOL ainput_open;
+#endif
+#if defined(CHANNEL_ECHO_SERVER)
+	echo_server_context* echo;
+	ECHO_SERVER_BENCHMARK_SETTINGS echo_settings;
+	BOOL echo_started;
+	HANDLE echo_thread;
 #endif
 	UINT32 frame_id;
 	RdpsndServerContext* rdpsnd;
@@ -63,6 +63,8 @@ struct p_server_dynamic_channel_context
 	UINT32 channelId;
 	PfDynChannelOpenStatus openStatus;
 	pf_utils_channel_mode channelMode;
+	BOOL interceptFront;
+	BOOL interceptBack;
 	BOOL packetReassembly;
 	DynChannelTrackerState backTracker;
 	DynChannelTrackerState frontTracker;
@@ -112,6 +114,10 @@ static PfChannelResult data_cb(pServerContext* ps, pServerDynamicChannelContext*
 	WINPR_ASSERT(tracker);
 	WINPR_ASSERT(ps->pdata);
 
+	/* modules may rewrite the packet in place */
+	if (!channelTracker_ownCurrentPacket(tracker))
+		return PF_CHANNEL_RESULT_ERROR;
+
 	wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
 	proxyDynChannelInterceptData dyn = { .name = channel->channelName,
 		                                 .channelId = channel->channelId,
@@ -158,10 +164,18 @@ static pServerDynamicChannelContext* DynamicChannelContext_new(wLog* log, pServe
 
 	proxyChannelToInterceptData dyn = { .name = name, .channelId = id, .intercept = FALSE };
 	if (pf_modules_run_filter(ps->pdata->module, FILTER_TYPE_DYN_INTERCEPT_LIST, ps->pdata, &dyn) &&
-	    dyn.intercept)
+	    (dyn.intercept || dyn.interceptFront || dyn.interceptBack))
+	{
 		ret->channelMode = PF_UTILS_CHANNEL_INTERCEPT;
+		ret->interceptFront = dyn.intercept || dyn.interceptFront;
+		ret->interceptBack = dyn.intercept || dyn.interceptBack;
+	}
 	else
+	{
 		ret->channelMode = pf_utils_get_channel_mode(ps->pdata->config, name);
+		ret->interceptFront = ret->interceptBack =
+		    (ret->channelMode == PF_UTILS_CHANNEL_INTERCEPT);
+	}
 	ret->openStatus = CHANNEL_OPENSTATE_OPENED;
 	ret->packetReassembly = (ret->channelMode == PF_UTILS_CHANNEL_INTERCEPT);
 
@@ -250,6 +264,8 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 
 	BOOL isBackData = (tracker == dynChannelContext->backTracker);
 	DynChannelTrackerState* trackerState = NULL;
+	pf_utils_channel_mode channelMode = PF_UTILS_CHANNEL_NOT_HANDLED;
+	BOOL reassemble = FALSE;
 
 	UINT32 flags = lastPacket ? CHANNEL_FLAG_LAST : 0;
 	proxyData* pdata = channelTracker_getPData(tracker);
@@ -467,6 +483,13 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 		case DATA_PDU:
 			/* treat these below */
 			trackerState = isBackData ? &dynChannel->backTracker : &dynChannel->frontTracker;
+			channelMode = dynChannel->channelMode;
+			/* a direction no module looks at is relayed without copying it */
+			if ((channelMode == PF_UTILS_CHANNEL_INTERCEPT) &&
+			    !(isBackData ? dynChannel->interceptBack : dynChannel->interceptFront))
+				channelMode = PF_UTILS_CHANNEL_PASSTHROUGH;
+			reassemble =
+			    dynChannel->packetReassembly && (channelMode == PF_UTILS_CHANNEL_INTERCEPT);
 			break;
 
 		case DATA_FIRST_COMPRESSED_PDU:
@@ -499,7 +522,7 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 		trackerState->CurrentDataReceived = 0;
 		trackerState->CurrentDataFragments = 0;
 
-		if (dynChannel->packetReassembly)
+		if (reassemble)
 		{
 			if (trackerState->currentPacket)
 				Stream_SetPosition(trackerState->currentPacket, 0);
@@ -513,7 +536,7 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 		trackerState->CurrentDataFragments++;
 		trackerState->CurrentDataReceived += WINPR_ASSERTING_INT_CAST(uint32_t, extraSize);
 
-		if (dynChannel->packetReassembly)
+		if (reassemble)
 		{
 			if (!trackerState->currentPacket)
 			{
@@ -563,10 +586,13 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 	}
 
 	PfChannelResult result = PF_CHANNEL_RESULT_ERROR;
-	switch (dynChannel->channelMode)
+	switch (channelMode)
 	{
 		case PF_UTILS_CHANNEL_PASSTHROUGH:
 			result = channelTracker_flushCurrent(tracker, firstPacket, lastPacket, !isBackData);
+			/* the header is known, relay the remaining fragments as received */
+			if (firstPacket && (result == PF_CHANNEL_RESULT_PASS))
+				channelTracker_setMode(tracker, CHANNEL_TRACKER_PASS);
 			break;
 		case PF_UTILS_CHANNEL_BLOCK:
 			channelTracker_setMode(tracker, CHANNEL_TRACKER_DROP);
@@ -588,7 +614,7 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 			break;
 		default:
 			WLog_Print(dynChannelContext->log, WLOG_ERROR, "unknown channel mode %d",
-			           dynChannel->channelMode);
+			           channelMode);
 			result = PF_CHANNEL_RESULT_ERROR;
 			break;
 	}
@@ -600,7 +626,7 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 		trackerState->CurrentDataFragments = 0;
 		trackerState->CurrentDataReceived = 0;
 
-		if (dynChannel->packetReassembly && trackerState->currentPacket)
+		if (reassemble && trackerState->currentPacket)
 			Stream_SetPosition(trackerState->currentPacket, 0);
 	}
 
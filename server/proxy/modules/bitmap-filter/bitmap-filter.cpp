@@ -147,8 +147,9 @@ static BOOL filter_dyn_channel_intercept_list([[maybe_unused]] proxyPlugin* plug
 
 	auto intercept = std::find(plugin_dyn_intercept().begin(), plugin_dyn_intercept().end(),
 	                           data->name) != plugin_dyn_intercept().end();
+	/* only the client offers cache entries, graphics from the server are relayed untouched */
 	if (intercept)
-		data->intercept = TRUE;
+		data->interceptFront = TRUE;
 	return TRUE;
 }
 
@@ -34,6 +34,11 @@
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <cerrno>
+#include <cstdlib>
 #if __has_include(<filesystem>)
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -67,6 +72,151 @@ static const std::vector<std::string>& plugin_static_intercept()
 
 static constexpr char key_path[] = "path";
 static constexpr char key_channels[] = "channels";
+static constexpr char key_buffer_limit[] = "buffer-limit";
+
+/* KiB of PDUs a session may have waiting for the writer before new ones are dropped */
+static constexpr size_t default_buffer_limit = 16 * 1024;
+
+struct DumpRecord
+{
+	fs::path path;
+	std::vector<char> data;
+};
+
+/* the PDUs of one session, filled by the session while the writer stores the previous batch */
+class DumpBuffer
+{
+  public:
+	explicit DumpBuffer(size_t limit) : _limit(limit)
+	{
+	}
+
+	/* returns true if the writer has to be told about this buffer */
+	bool push(DumpRecord&& record, bool& dropped)
+	{
+		std::lock_guard<std::mutex> guard(_mux);
+		const auto size = record.data.size();
+		dropped = (_bytes + size > _limit);
+		if (dropped)
+		{
+			_dropped++;
+			return false;
+		}
+
+		_bytes += size;
+		const auto first = _pending.empty();
+		_pending.emplace_back(std::move(record));
+		return first;
+	}
+
+	std::vector<DumpRecord> take()
+	{
+		std::lock_guard<std::mutex> guard(_mux);
+		std::vector<DumpRecord> batch;
+		batch.swap(_pending);
+		return batch;
+	}
+
+	void release(size_t size)
+	{
+		std::lock_guard<std::mutex> guard(_mux);
+		_bytes -= std::min(size, _bytes);
+	}
+
+	uint64_t dropped()
+	{
+		std::lock_guard<std::mutex> guard(_mux);
+		return _dropped;
+	}
+
+  private:
+	std::mutex _mux;
+	std::vector<DumpRecord> _pending;
+	size_t _bytes{ 0 }; /* pending and currently written */
+	size_t _limit;
+	uint64_t _dropped{ 0 };
+};
+
+/* stores the PDUs of all sessions on a background thread so dumping never blocks a session */
+class DumpWriter
+{
+  public:
+	DumpWriter() : _thread([this]() { run(); })
+	{
+	}
+
+	~DumpWriter()
+	{
+		{
+			std::lock_guard<std::mutex> guard(_mux);
+			_stop = true;
+		}
+		_cv.notify_one();
+		_thread.join();
+	}
+
+	DumpWriter(const DumpWriter&) = delete;
+	DumpWriter& operator=(const DumpWriter&) = delete;
+
+	bool write(const std::shared_ptr<DumpBuffer>& buffer, DumpRecord&& record)
+	{
+		bool dropped = false;
+		if (buffer->push(std::move(record), dropped))
+		{
+			{
+				std::lock_guard<std::mutex> guard(_mux);
+				_ready.push_back(buffer);
+			}
+			_cv.notify_one();
+		}
+		return !dropped;
+	}
+
+  private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(_mux);
+		for (;;)
+		{
+			_cv.wait(lock, [this]() { return _stop || !_ready.empty(); });
+			if (_ready.empty())
+				break;
+
+			auto buffer = std::move(_ready.front());
+			_ready.pop_front();
+
+			lock.unlock();
+			store(*buffer, buffer->take());
+			lock.lock();
+		}
+	}
+
+	static void store(DumpBuffer& buffer, std::vector<DumpRecord>&& batch)
+	{
+		for (auto& record : batch)
+		{
+			WLog_DBG(TAG, "writing file '%s'", record.path.c_str());
+			std::ofstream stream(record.path, std::ios::binary);
+			const auto s = record.data.size();
+			if (!stream.is_open() || !stream.good() ||
+			    (s > static_cast<size_t>(std::numeric_limits<std::streamsize>::max())))
+				WLog_ERR(TAG, "Could not write to stream");
+			else
+			{
+				stream.write(record.data.data(), static_cast<std::streamsize>(s));
+				if (stream.fail())
+					WLog_ERR(TAG, "Could not write to stream");
+			}
+			buffer.release(s);
+		}
+	}
+
+	std::mutex _mux;
+	std::condition_variable _cv;
+	std::deque<std::shared_ptr<DumpBuffer>> _ready;
+	bool _stop{ false };
+	std::thread _thread;
+};
 
 class PluginData
 {
@@ -85,16 +235,24 @@ class PluginData
 		return _sessionid++;
 	}
 
+	DumpWriter& writer()
+	{
+		return _writer;
+	}
+
   private:
 	proxyPluginsManager* _mgr;
 	uint64_t _sessionid{ 0 };
+	DumpWriter _writer;
 };
 
 class ChannelData
 {
   public:
-	ChannelData(const std::string& base, std::vector<std::string> list, uint64_t sessionid)
-	    : _base(base), _channels_to_dump(std::move(list)), _session_id(sessionid)
+	ChannelData(const std::string& base, std::vector<std::string> list, uint64_t sessionid,
+	            size_t limit)
+	    : _base(base), _channels_to_dump(std::move(list)), _session_id(sessionid),
+	      _buffer(std::make_shared<DumpBuffer>(limit))
 	{
 		char str[64] = {};
 		(void)_snprintf(str, sizeof(str), "session-%016" PRIx64, _session_id);
@@ -112,14 +270,17 @@ class ChannelData
 		return true;
 	}
 
-	std::ofstream stream(const std::string& name, bool back)
+	fs::path next_path(const std::string& name, bool back)
 	{
 		std::lock_guard<std::mutex> guard(_mux);
 		auto& atom = _map[name];
 		auto count = atom++;
-		auto path = filepath(name, back, count);
-		WLog_DBG(TAG, "[%s] writing file '%s'", name.c_str(), path.c_str());
-		return std::ofstream(path);
+		return filepath(name, back, count);
+	}
+
+	[[nodiscard]] const std::shared_ptr<DumpBuffer>& buffer() const
+	{
+		return _buffer;
 	}
 
 	[[nodiscard]] bool dump_enabled(const std::string& name) const
@@ -202,6 +363,7 @@ class ChannelData
 	std::mutex _mux;
 	std::map<std::string, uint64_t> _map;
 	uint64_t _session_id;
+	std::shared_ptr<DumpBuffer> _buffer;
 };
 
 static PluginData* dump_get_plugin_data(proxyPlugin* plugin)
@@ -327,26 +489,13 @@ static BOOL dump_dyn_channel_intercept(proxyPlugin* plugin, proxyData* pdata, vo
 		if (!cdata->ensure_path_exists())
 			return FALSE;
 
-		auto stream = cdata->stream(data->name, data->isBackData);
 		auto buffer = reinterpret_cast<const char*>(Stream_ConstBuffer(data->data));
-		if (!stream.is_open() || !stream.good())
-		{
-			WLog_ERR(TAG, "Could not write to stream");
-			return FALSE;
-		}
-		const auto s = Stream_Length(data->data);
-		if (s > std::numeric_limits<std::streamsize>::max())
-		{
-			WLog_ERR(TAG, "Stream length %" PRIuz " exceeds std::streamsize::max", s);
-			return FALSE;
-		}
-		stream.write(buffer, static_cast<std::streamsize>(s));
-		if (stream.fail())
-		{
-			WLog_ERR(TAG, "Could not write to stream");
-			return FALSE;
-		}
-		stream.flush();
+		DumpRecord record{ cdata->next_path(data->name, data->isBackData),
+			               std::vector<char>(buffer, buffer + Stream_Length(data->data)) };
+
+		auto plugindata = dump_get_plugin_data(plugin);
+		if (!plugindata->writer().write(cdata->buffer(), std::move(record)))
+			WLog_WARN(TAG, "[%s] dump buffer full, dropping PDU", data->name);
 	}
 
 	return TRUE;
@@ -387,10 +536,24 @@ static BOOL dump_session_started(proxyPlugin* plugin, proxyData* pdata, void* /*
 		return FALSE;
 	}
 
+	size_t limit = default_buffer_limit;
+	auto climit = pf_config_get(config, plugin_name, key_buffer_limit);
+	if (climit)
+	{
+		errno = 0;
+		limit = strtoull(climit, nullptr, 0);
+		if ((errno != 0) || (limit == 0))
+		{
+			WLog_ERR(TAG, "Invalid configuration entry [%s/%s] %s, can not continue",
+			         plugin_name, key_buffer_limit, climit);
+			return FALSE;
+		}
+	}
+
 	std::string path(cpath);
 	std::string channels(cchannels);
 	std::vector<std::string> list = split(channels, "[;,]");
-	auto cfg = new ChannelData(path, std::move(list), custom->session());
+	auto cfg = new ChannelData(path, std::move(list), custom->session(), limit * 1024);
 	if (!cfg || !cfg->create())
 	{
 		delete cfg;
@@ -410,7 +573,13 @@ static BOOL dump_session_end(proxyPlugin* plugin, proxyData* pdata, void* /*unus
 
 	auto cfg = dump_get_plugin_data(plugin, pdata);
 	if (cfg)
+	{
+		const auto dropped = cfg->buffer()->dropped();
+		if (dropped > 0)
+			WLog_WARN(TAG, "session dump %" PRIu64 " dropped %" PRIu64 " PDUs", cfg->session(),
+			          dropped);
 		WLog_DBG(TAG, "ending session dump %" PRIu64, cfg->session());
+	}
 	dump_set_plugin_data(plugin, pdata, nullptr);
 	return TRUE;
 }
@@ -32,6 +32,9 @@ struct sChannelStateTracker
 	pServerStaticChannelContext* channel;
 	ChannelTrackerMode mode;
 	wStream* currentPacket;
+	/* the first fragment of a packet is peeked in the receive buffer, copied only when needed */
+	wStream borrowedBuffer;
+	wStream* borrowed;
 	size_t currentPacketReceived;
 	size_t currentPacketSize;
 	size_t currentPacketFragments;
@@ -124,17 +127,35 @@ PfChannelResult channelTracker_update(ChannelStateTracker* tracker, const BYTE*
 	switch (channelTracker_getMode(tracker))
 	{
 		case CHANNEL_TRACKER_PEEK:
-		{
-			wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
-			if (!Stream_EnsureRemainingCapacity(currentPacket, xsize))
-				return PF_CHANNEL_RESULT_ERROR;
-
-			Stream_Write(currentPacket, xdata, xsize);
-
-			WINPR_ASSERT(tracker->peekFn);
-			result = tracker->peekFn(tracker, firstPacket, lastPacket);
-		}
-		break;
+			if (firstPacket)
+			{
+				tracker->borrowed = Stream_StaticConstInit(&tracker->borrowedBuffer, xdata, xsize);
+				Stream_SetPosition(tracker->borrowed, xsize);
+
+				WINPR_ASSERT(tracker->peekFn);
+				result = tracker->peekFn(tracker, firstPacket, lastPacket);
+
+				/* the peek needs the following fragments too, keep a copy to append them to */
+				if (!lastPacket && tracker->borrowed &&
+				    (channelTracker_getMode(tracker) == CHANNEL_TRACKER_PEEK))
+				{
+					if (!channelTracker_ownCurrentPacket(tracker))
+						result = PF_CHANNEL_RESULT_ERROR;
+				}
+				tracker->borrowed = NULL;
+			}
+			else
+			{
+				wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
+				if (!Stream_EnsureRemainingCapacity(currentPacket, xsize))
+					return PF_CHANNEL_RESULT_ERROR;
+
+				Stream_Write(currentPacket, xdata, xsize);
+
+				WINPR_ASSERT(tracker->peekFn);
+				result = tracker->peekFn(tracker, firstPacket, lastPacket);
+			}
+			break;
 		case CHANNEL_TRACKER_PASS:
 			result = PF_CHANNEL_RESULT_PASS;
 			break;
@@ -329,9 +350,30 @@ proxyData* channelTracker_getPData(ChannelStateTracker* tracker)
 wStream* channelTracker_getCurrentPacket(ChannelStateTracker* tracker)
 {
 	WINPR_ASSERT(tracker);
+	if (tracker->borrowed)
+		return tracker->borrowed;
 	return tracker->currentPacket;
 }
 
+BOOL channelTracker_ownCurrentPacket(ChannelStateTracker* tracker)
+{
+	WINPR_ASSERT(tracker);
+
+	if (!tracker->borrowed)
+		return TRUE;
+
+	wStream* borrowed = tracker->borrowed;
+	const size_t size = Stream_GetPosition(borrowed);
+	tracker->borrowed = NULL;
+
+	Stream_SetPosition(tracker->currentPacket, 0);
+	if (!Stream_EnsureRemainingCapacity(tracker->currentPacket, size))
+		return FALSE;
+
+	Stream_Write(tracker->currentPacket, Stream_Buffer(borrowed), size);
+	return TRUE;
+}
+
 BOOL channelTracker_setCustomData(ChannelStateTracker* tracker, void* data)
 {
 	WINPR_ASSERT(tracker);
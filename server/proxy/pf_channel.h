@@ -50,6 +50,10 @@ void* channelTracker_getCustomData(ChannelStateTracker* tracker);
 
 wStream* channelTracker_getCurrentPacket(ChannelStateTracker* tracker);
 
+/** @brief copies the current packet when it still refers to the receive buffer, required
+ *  before the packet is modified or kept beyond the peek function */
+BOOL channelTracker_ownCurrentPacket(ChannelStateTracker* tracker);
+
 size_t channelTracker_getCurrentPacketSize(ChannelStateTracker* tracker);
 BOOL channelTracker_setCurrentPacketSize(ChannelStateTracker* tracker, size_t size);
 
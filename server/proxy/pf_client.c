@@ -23,6 +23,7 @@
 
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/config.h>
 
@@ -31,6 +32,7 @@
 #include <freerdp/client/cmdline.h>
 
 #include <freerdp/server/proxy/proxy_log.h>
+#include <freerdp/server/proxy/proxy_server.h>
 #include <freerdp/channels/drdynvc.h>
 #include <freerdp/channels/encomsp.h>
 #include <freerdp/channels/rdpdr.h>
@@ -46,6 +48,8 @@
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
 #include "pf_utils.h"
+#include "pf_metrics.h"
+#include "pf_server.h"
 #include "channels/pf_channel_rdpdr.h"
 #include "channels/pf_channel_smartcard.h"
 
@@ -186,6 +190,121 @@ static BOOL pf_client_use_proxy_smartcard_auth(const rdpSettings* settings)
 	return TRUE;
 }
 
+static proxyTargetCache* pf_client_get_target_cache(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
+	WINPR_ASSERT(pc->pdata->ps);
+
+	const freerdp_peer* peer = pc->pdata->ps->context.peer;
+	WINPR_ASSERT(peer);
+
+	const proxyServer* server = (const proxyServer*)peer->ContextExtra;
+	return server ? server->targetCache : NULL;
+}
+
+static BOOL pf_client_is_redirected(const rdpSettings* settings)
+{
+	const UINT32 flags = freerdp_settings_get_uint32(settings, FreeRDP_RedirectionFlags);
+	return ((flags & LB_NOREDIRECT) == 0) && (flags != 0);
+}
+
+/*
+ * connects to a cached address of the target and accepts the certificate accepted by an
+ * earlier session, instead of resolving and verifying again for every session.
+ */
+static BOOL pf_client_use_target_cache(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	rdpSettings* settings = pc->context.settings;
+	WINPR_ASSERT(settings);
+
+	proxyTargetCache* cache = pf_client_get_target_cache(pc);
+	const char* hostname = freerdp_settings_get_string(settings, FreeRDP_ServerHostname);
+	if (!cache || !hostname)
+		return TRUE;
+
+	if (pc->resolved_address)
+	{
+		/* a retry, e.g. without NLA, connects to the same address */
+		if (strcmp(hostname, pc->resolved_address) == 0)
+			return TRUE;
+
+		/* redirected, the name of the first target does not apply anymore */
+		if (!freerdp_settings_set_string(settings, FreeRDP_UserSpecifiedServerName, NULL))
+			return FALSE;
+		free(pc->resolved_address);
+		pc->resolved_address = NULL;
+	}
+
+	const UINT16 port =
+	    WINPR_ASSERTING_INT_CAST(UINT16, freerdp_settings_get_uint32(settings, FreeRDP_ServerPort));
+
+	if (!pf_client_is_redirected(settings))
+	{
+		size_t length = 0;
+		char* pem = pf_target_cache_get_certificate(cache, hostname, port, &length);
+		if (pem)
+		{
+			const BOOL rc =
+			    freerdp_settings_set_string_len(settings, FreeRDP_AcceptedCert, pem, length) &&
+			    freerdp_settings_set_uint32(settings, FreeRDP_AcceptedCertLength,
+			                                WINPR_ASSERTING_INT_CAST(UINT32, length));
+			free(pem);
+			if (!rc)
+				return FALSE;
+		}
+	}
+
+	/* a name given by the configuration or a module already decides what TLS and NLA see */
+	if (freerdp_settings_get_string(settings, FreeRDP_UserSpecifiedServerName))
+		return TRUE;
+
+	char* address = pf_target_cache_resolve(cache, hostname, port);
+	if (!address)
+		return TRUE;
+
+	/* TLS (SNI, certificate name) and NLA (service principal) keep using the name */
+	if (!freerdp_settings_set_string(settings, FreeRDP_UserSpecifiedServerName, hostname) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_ServerHostname, address))
+	{
+		free(address);
+		return FALSE;
+	}
+
+	pc->resolved_address = address;
+	return TRUE;
+}
+
+static void pf_client_update_target_cache(pClientContext* pc, BOOL connected)
+{
+	WINPR_ASSERT(pc);
+
+	const rdpSettings* settings = pc->context.settings;
+	WINPR_ASSERT(settings);
+
+	proxyTargetCache* cache = pf_client_get_target_cache(pc);
+	const char* name = freerdp_settings_get_server_name(settings);
+	if (!cache || !name)
+		return;
+
+	const UINT16 port =
+	    WINPR_ASSERTING_INT_CAST(UINT16, freerdp_settings_get_uint32(settings, FreeRDP_ServerPort));
+
+	if (!connected)
+	{
+		/* the target may have moved, resolve and verify again next time */
+		pf_target_cache_remove(cache, name, port);
+		return;
+	}
+
+	const char* pem = freerdp_settings_get_string(settings, FreeRDP_AcceptedCert);
+	const UINT32 length = freerdp_settings_get_uint32(settings, FreeRDP_AcceptedCertLength);
+	if (pem && (length > 0) && !pf_client_is_redirected(settings))
+		(void)pf_target_cache_set_certificate(cache, name, port, pem, length);
+}
+
 static BOOL pf_client_pre_connect(freerdp* instance)
 {
 	pClientContext* pc = NULL;
@@ -286,7 +405,11 @@ static BOOL pf_client_pre_connect(freerdp* instance)
 	if (!pf_client_use_peer_load_balance_info(pc))
 		return FALSE;
 
-	return pf_modules_run_hook(pc->pdata->module, HOOK_TYPE_CLIENT_PRE_CONNECT, pc->pdata, pc);
+	if (!pf_modules_run_hook(pc->pdata->module, HOOK_TYPE_CLIENT_PRE_CONNECT, pc->pdata, pc))
+		return FALSE;
+
+	/* after the modules, they may pick another target */
+	return pf_client_use_target_cache(pc);
 }
 
 /** @brief arguments for updateBackIdFn */
@@ -442,6 +565,9 @@ static BOOL pf_client_receive_channel_data_hook(freerdp* instance, UINT16 channe
 	if (!channel)
 		return TRUE;
 
+	pf_metrics_session_record(pdata, PF_METRIC_BACK_BYTES, xsize);
+	pf_metrics_session_record(pdata, PF_METRIC_BACK_PDUS, 1);
+
 	WINPR_ASSERT(channel->onBackData);
 	switch (channel->onBackData(pdata, channel, xdata, xsize, flags, totalSize))
 	{
@@ -483,7 +609,12 @@ static BOOL pf_client_send_channel_data(pClientContext* pc, const proxyChannelDa
 	WINPR_ASSERT(pc);
 	WINPR_ASSERT(ev);
 
-	return Queue_Enqueue(pc->cached_server_channel_data, ev);
+	if (!Queue_Enqueue(pc->cached_server_channel_data, ev))
+		return FALSE;
+
+	pf_metrics_session_record(pc->pdata, PF_METRIC_BACK_QUEUE_DEPTH,
+	                          Queue_Count(pc->cached_server_channel_data));
+	return TRUE;
 }
 
 static BOOL sendQueuedChannelData(pClientContext* pc)
@@ -554,6 +685,12 @@ static BOOL pf_client_post_connect(freerdp* instance)
 
 	pf_client_register_update_callbacks(update);
 
+	/* Bitmap and pointer updates go to the client as received, without parsing them */
+	WINPR_ASSERT(pc->pdata->config);
+	if (pc->pdata->config->GraphicsPassthrough &&
+	    freerdp_settings_get_bool(ps->settings, FreeRDP_FastPathOutput))
+		pf_client_register_passthrough_callbacks(update);
+
 	/* virtual channels receive data hook */
 	pc->client_receive_channel_data_original = instance->ReceiveChannelData;
 	instance->ReceiveChannelData = pf_client_receive_channel_data_hook;
@@ -668,6 +805,8 @@ static BOOL pf_client_set_security_settings(pClientContext* pc)
 		return FALSE;
 	if (!freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, config->ClientNlaSecurity))
 		return FALSE;
+	if (!freerdp_settings_set_bool(settings, FreeRDP_TlsKernelOffload, config->TlsKernelOffload))
+		return FALSE;
 
 	if (pf_client_use_proxy_smartcard_auth(settings))
 	{
@@ -763,10 +902,68 @@ out:
 	return rc;
 }
 
+BOOL pf_client_check_event_handles(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	freerdp* instance = pc->context.instance;
+	WINPR_ASSERT(instance);
+
+	if (freerdp_shall_disconnect_context(instance->context))
+		return FALSE;
+
+	if (proxy_data_shall_disconnect(pc->pdata))
+		return FALSE;
+
+	if (!freerdp_check_event_handles(instance->context))
+	{
+		if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
+			WLog_ERR(TAG, "Failed to check FreeRDP event handles");
+
+		return FALSE;
+	}
+	sendQueuedChannelData(pc);
+	return TRUE;
+}
+
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* handles, DWORD count)
+{
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(handles);
+
+	if (count < 2)
+		return 0;
+
+	handles[0] = Queue_Event(pc->cached_server_channel_data);
+
+	const DWORD tmp = freerdp_get_event_handles(&pc->context, &handles[1], count - 1);
+	if (tmp == 0)
+	{
+		PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
+		return 0;
+	}
+	return tmp + 1;
+}
+
+void pf_client_close(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	proxyData* pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+
+	freerdp_disconnect(pc->context.instance);
+	pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_UNINIT_CONNECT, pdata, pc);
+	freerdp_client_stop(&pc->context);
+}
+
 /**
  * RDP main loop.
  * Connects RDP, loops while running and handles event and dispatch, cleans up
  * after the connection ends.
+ *
+ * If the peer's event loop drives the client, only connects and hands the
+ * connection over, pf_client_close cleans up once the session ends.
  */
 static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 {
@@ -798,23 +995,31 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 		goto end;
 	}
 
-	if (!pf_client_connect(instance))
+	const UINT64 connectStart = winpr_GetTickCount64NS();
+	const BOOL connected = pf_client_connect(instance);
+	pf_client_update_target_cache(pc, connected);
+	if (!connected)
 	{
 		proxy_data_abort_connect(pdata);
 		goto end;
 	}
-	handles[nCount++] = Queue_Event(pc->cached_server_channel_data);
+	pf_metrics_session_record(pdata, PF_METRIC_SETUP_TARGET_US,
+	                          (winpr_GetTickCount64NS() - connectStart) / 1000ull);
+
+	if (pdata->client_shared_loop)
+	{
+		/* the peer's event loop owns the client from here on */
+		(void)SetEvent(pdata->client_connected);
+		return 0;
+	}
 
 	while (!freerdp_shall_disconnect_context(instance->context))
 	{
-		UINT32 tmp = freerdp_get_event_handles(instance->context, &handles[nCount],
-		                                       ARRAYSIZE(handles) - nCount);
+		const DWORD tmp =
+		    pf_client_get_event_handles(pc, &handles[nCount], ARRAYSIZE(handles) - nCount);
 
 		if (tmp == 0)
-		{
-			PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
 			break;
-		}
 
 		status = WaitForMultipleObjects(nCount + tmp, handles, FALSE, INFINITE);
 
@@ -828,20 +1033,8 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 		if (status == WAIT_OBJECT_0)
 			break;
 
-		if (freerdp_shall_disconnect_context(instance->context))
+		if (!pf_client_check_event_handles(pc))
 			break;
-
-		if (proxy_data_shall_disconnect(pdata))
-			break;
-
-		if (!freerdp_check_event_handles(instance->context))
-		{
-			if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
-				WLog_ERR(TAG, "Failed to check FreeRDP event handles");
-
-			break;
-		}
-		sendQueuedChannelData(pc);
 	}
 
 	freerdp_disconnect(instance);
@@ -878,6 +1071,7 @@ static void pf_client_context_free(freerdp* instance, rdpContext* context)
 	free(pc->remote_hostname);
 	free(pc->computerName.v);
 	HashTable_Free(pc->interceptContextMap);
+	free(pc->resolved_address);
 }
 
 static int pf_client_verify_X509_certificate(freerdp* instance, const BYTE* data, size_t length,
@@ -1052,8 +1246,14 @@ DWORD WINAPI pf_client_start(LPVOID arg)
 	pClientContext* pc = (pClientContext*)arg;
 
 	WINPR_ASSERT(pc);
+	proxyData* pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+
 	if (freerdp_client_start(&pc->context) == 0)
 		rc = pf_client_thread_proc(pc);
-	freerdp_client_stop(&pc->context);
+
+	/* a handed over connection is stopped by pf_client_close */
+	if (WaitForSingleObject(pdata->client_connected, 0) != WAIT_OBJECT_0)
+		freerdp_client_stop(&pc->context);
 	return rc;
 }
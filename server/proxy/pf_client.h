@@ -23,9 +23,15 @@
 #define FREERDP_SERVER_PROXY_PFCLIENT_H
 
 #include <freerdp/freerdp.h>
+#include <freerdp/server/proxy/proxy_context.h>
 #include <winpr/wtypes.h>
 
 int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints);
 DWORD WINAPI pf_client_start(LPVOID arg);
 
+/* drive a connection handed over to the peer's event loop (proxyData::client_shared_loop) */
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* handles, DWORD count);
+BOOL pf_client_check_event_handles(pClientContext* pc);
+void pf_client_close(pClientContext* pc);
+
 #endif /* FREERDP_SERVER_PROXY_PFCLIENT_H */
@@ -67,6 +67,7 @@ static const char* boolstr(BOOL rc)
 static const char* section_server = "Server";
 static const char* key_host = "Host";
 static const char* key_port = "Port";
+static const char* key_workers = "Workers";
 
 static const char* section_target = "Target";
 static const char* key_target_fixed = "FixedTarget";
@@ -74,6 +75,7 @@ static const char* key_target_user = "User";
 static const char* key_target_pwd = "Password";
 static const char* key_target_domain = "Domain";
 static const char* key_target_tls_seclevel = "TlsSecLevel";
+static const char* key_target_cache_ttl = "CacheTTL";
 
 static const char* section_plugins = "Plugins";
 static const char* key_plugins_modules = "Modules";
@@ -92,6 +94,7 @@ static const char* key_channels_rails = "RemoteApp";
 static const char* key_channels_blacklist = "PassthroughIsBlacklist";
 static const char* key_channels_pass = "Passthrough";
 static const char* key_channels_intercept = "Intercept";
+static const char* key_channels_graphics_passthrough = "GraphicsPassthrough";
 
 static const char* section_input = "Input";
 static const char* key_input_kbd = "Keyboard";
@@ -106,6 +109,9 @@ static const char* key_security_client_nla = "ClientNlaSecurity";
 static const char* key_security_client_tls = "ClientTlsSecurity";
 static const char* key_security_client_rdp = "ClientRdpSecurity";
 static const char* key_security_client_fallback = "ClientAllowFallbackToTls";
+static const char* key_security_tls_kernel_offload = "TlsKernelOffload";
+
+static const char* section_metrics = "Metrics";
 
 static const char* section_certificates = "Certificates";
 static const char* key_private_key_file = "PrivateKeyFile";
@@ -225,6 +231,9 @@ static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 	const char* host = NULL;
 
 	WINPR_ASSERT(config);
+	if (!pf_config_get_uint32(ini, section_server, key_workers, &config->Workers, FALSE))
+		return FALSE;
+
 	host = pf_config_get_str(ini, section_server, key_host, FALSE);
 
 	if (!host)
@@ -256,6 +265,10 @@ static BOOL pf_config_load_target(wIniFile* ini, proxyConfig* config)
 	                          &config->TargetTlsSecLevel, FALSE))
 		return FALSE;
 
+	if (!pf_config_get_uint32(ini, section_target, key_target_cache_ttl, &config->TargetCacheTTL,
+	                          FALSE))
+		return FALSE;
+
 	if (config->FixedTarget)
 	{
 		target_value = pf_config_get_str(ini, section_target, key_host, TRUE);
@@ -315,10 +328,28 @@ static BOOL pf_config_load_channels(wIniFile* ini, proxyConfig* config)
 	config->Intercept = pf_config_parse_comma_separated_list(
 	    pf_config_get_str(ini, section_channels, key_channels_intercept, FALSE),
 	    &config->InterceptCount);
+	config->GraphicsPassthrough =
+	    pf_config_get_bool(ini, section_channels, key_channels_graphics_passthrough, FALSE);
 
 	return TRUE;
 }
 
+static BOOL pf_config_load_metrics(wIniFile* ini, proxyConfig* config)
+{
+	WINPR_ASSERT(config);
+
+	/* the endpoint is only served if a port is configured */
+	if (!pf_config_get_str(ini, section_metrics, key_port, FALSE))
+		return TRUE;
+
+	if (!pf_config_get_uint16(ini, section_metrics, key_port, &config->MetricsPort, TRUE))
+		return FALSE;
+
+	const char* host = pf_config_get_str(ini, section_metrics, key_host, FALSE);
+	config->MetricsHost = _strdup(host ? host : "127.0.0.1");
+	return config->MetricsHost != NULL;
+}
+
 static BOOL pf_config_load_input(wIniFile* ini, proxyConfig* config)
 {
 	WINPR_ASSERT(config);
@@ -346,6 +377,8 @@ static BOOL pf_config_load_security(wIniFile* ini, proxyConfig* config)
 	    pf_config_get_bool(ini, section_security, key_security_client_rdp, TRUE);
 	config->ClientAllowFallbackToTls =
 	    pf_config_get_bool(ini, section_security, key_security_client_fallback, TRUE);
+	config->TlsKernelOffload =
+	    pf_config_get_bool(ini, section_security, key_security_tls_kernel_offload, FALSE);
 	return TRUE;
 }
 
@@ -555,6 +588,7 @@ proxyConfig* server_config_load_ini(wIniFile* ini)
 	{
 		/* Set default values != 0 */
 		config->TargetTlsSecLevel = 1;
+		config->TargetCacheTTL = 60;
 
 		/* Load from ini */
 		if (!pf_config_load_server(ini, config))
@@ -577,6 +611,9 @@ proxyConfig* server_config_load_ini(wIniFile* ini)
 
 		if (!pf_config_load_certificates(ini, config))
 			goto out;
+
+		if (!pf_config_load_metrics(ini, config))
+			goto out;
 		config->ini = IniFile_Clone(ini);
 		if (!config->ini)
 			goto out;
@@ -603,6 +640,8 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueInt(ini, section_server, key_port, 3389) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_server, key_workers, 0) < 0)
+		goto fail;
 
 	/* Target configuration */
 	if (IniFile_SetKeyValueString(ini, section_target, key_host, "somehost.example.com") < 0)
@@ -613,6 +652,8 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueInt(ini, section_target, key_target_tls_seclevel, 1) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_target, key_target_cache_ttl, 60) < 0)
+		goto fail;
 
 	/* Channel configuration */
 	if (IniFile_SetKeyValueString(ini, section_channels, key_channels_gfx, bool_str_true) < 0)
@@ -640,6 +681,9 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueString(ini, section_channels, key_channels_intercept, "") < 0)
 		goto fail;
+	if (IniFile_SetKeyValueString(ini, section_channels, key_channels_graphics_passthrough,
+	                              bool_str_false) < 0)
+		goto fail;
 
 	/* Input configuration */
 	if (IniFile_SetKeyValueString(ini, section_input, key_input_kbd, bool_str_true) < 0)
@@ -672,6 +716,9 @@ BOOL pf_server_config_dump(const char* file)
 	if (IniFile_SetKeyValueString(ini, section_security, key_security_client_fallback,
 	                              bool_str_true) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueString(ini, section_security, key_security_tls_kernel_offload,
+	                              bool_str_false) < 0)
+		goto fail;
 
 	/* Module configuration */
 	if (IniFile_SetKeyValueString(ini, section_plugins, key_plugins_modules,
@@ -681,6 +728,12 @@ BOOL pf_server_config_dump(const char* file)
 	                              "module1,module2,...") < 0)
 		goto fail;
 
+	/* Metrics endpoint configuration */
+	if (IniFile_SetKeyValueString(ini, section_metrics, key_host, "127.0.0.1") < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_metrics, key_port, 9389) < 0)
+		goto fail;
+
 	/* Certificate configuration */
 	if (IniFile_SetKeyValueString(ini, section_certificates, key_cert_file,
 	                              "<absolute path to some certificate file> OR") < 0)
@@ -770,6 +823,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION(section_server);
 	CONFIG_PRINT_STR(config, Host);
 	CONFIG_PRINT_UINT16(config, Port);
+	CONFIG_PRINT_UINT32(config, Workers);
 
 	if (config->FixedTarget)
 	{
@@ -777,6 +831,7 @@ void pf_server_config_print(const proxyConfig* config)
 		CONFIG_PRINT_STR(config, TargetHost);
 		CONFIG_PRINT_UINT16(config, TargetPort);
 		CONFIG_PRINT_UINT32(config, TargetTlsSecLevel);
+		CONFIG_PRINT_UINT32(config, TargetCacheTTL);
 
 		if (config->TargetUser)
 			CONFIG_PRINT_STR(config, TargetUser);
@@ -797,6 +852,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_BOOL(config, ClientTlsSecurity);
 	CONFIG_PRINT_BOOL(config, ClientRdpSecurity);
 	CONFIG_PRINT_BOOL(config, ClientAllowFallbackToTls);
+	CONFIG_PRINT_BOOL(config, TlsKernelOffload);
 
 	CONFIG_PRINT_SECTION(section_channels);
 	CONFIG_PRINT_BOOL(config, GFX);
@@ -809,6 +865,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_BOOL(config, CameraRedirection);
 	CONFIG_PRINT_BOOL(config, RemoteApp);
 	CONFIG_PRINT_BOOL(config, PassthroughIsBlacklist);
+	CONFIG_PRINT_BOOL(config, GraphicsPassthrough);
 
 	if (config->PassthroughCount)
 	{
@@ -837,6 +894,13 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_STR_CONTENT(config, CertificateContent);
 	CONFIG_PRINT_STR(config, PrivateKeyFile);
 	CONFIG_PRINT_STR_CONTENT(config, PrivateKeyContent);
+
+	if (config->MetricsPort)
+	{
+		CONFIG_PRINT_SECTION(section_metrics);
+		CONFIG_PRINT_STR(config, MetricsHost);
+		CONFIG_PRINT_UINT16(config, MetricsPort);
+	}
 }
 
 void pf_server_config_free(proxyConfig* config)
@@ -850,6 +914,7 @@ void pf_server_config_free(proxyConfig* config)
 	CommandLineParserFree(config->Modules);
 	free(config->TargetHost);
 	free(config->Host);
+	free(config->MetricsHost);
 	free(config->CertificateFile);
 	free(config->CertificateContent);
 	if (config->CertificatePEM)
@@ -960,6 +1025,8 @@ BOOL pf_config_clone(proxyConfig** dst, const proxyConfig* config)
 		goto fail;
 	if (!pf_config_copy_string(&tmp->TargetHost, config->TargetHost))
 		goto fail;
+	if (!pf_config_copy_string(&tmp->MetricsHost, config->MetricsHost))
+		goto fail;
 
 	if (!pf_config_copy_string_list(&tmp->Passthrough, &tmp->PassthroughCount, config->Passthrough,
 	                                config->PassthroughCount))
@@ -339,6 +339,9 @@ proxyData* proxy_data_new(void)
 	if (!(pdata->gfx_server_ready = CreateEvent(NULL, TRUE, FALSE, NULL)))
 		goto error;
 
+	if (!(pdata->client_connected = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		goto error;
+
 	winpr_RAND(&temp, 16);
 	hex = winpr_BinToHexString(temp, 16, FALSE);
 	if (!hex)
@@ -396,6 +399,9 @@ void proxy_data_free(proxyData* pdata)
 	if (pdata->gfx_server_ready)
 		(void)CloseHandle(pdata->gfx_server_ready);
 
+	if (pdata->client_connected)
+		(void)CloseHandle(pdata->client_connected);
+
 	if (pdata->modules_info)
 		HashTable_Free(pdata->modules_info);
 
@@ -0,0 +1,489 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+#include <winpr/winsock.h>
+#include <winpr/collections.h>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_metrics.h"
+
+#define TAG PROXY_TAG("metrics")
+
+static const struct
+{
+	const char* name;
+	FreeRDPMetricType session;
+	FreeRDPMetricType aggregate;
+} pf_metric_defs[PF_METRIC_LAST] = {
+	{ "proxy_setup_front_us", FREERDP_METRIC_GAUGE, FREERDP_METRIC_HISTOGRAM },
+	{ "proxy_setup_target_us", FREERDP_METRIC_GAUGE, FREERDP_METRIC_HISTOGRAM },
+	{ "proxy_back_queue_depth", FREERDP_METRIC_GAUGE, FREERDP_METRIC_HISTOGRAM },
+	{ "proxy_front_bytes", FREERDP_METRIC_COUNTER, FREERDP_METRIC_COUNTER },
+	{ "proxy_front_pdus", FREERDP_METRIC_COUNTER, FREERDP_METRIC_COUNTER },
+	{ "proxy_back_bytes", FREERDP_METRIC_COUNTER, FREERDP_METRIC_COUNTER },
+	{ "proxy_back_pdus", FREERDP_METRIC_COUNTER, FREERDP_METRIC_COUNTER }
+};
+
+struct proxy_session_metrics
+{
+	proxyMetrics* server;
+	proxyData* pdata;
+	rdpMetrics* registry; /* the registry of the client connection */
+	SSIZE_T ids[PF_METRIC_LAST];
+	UINT64 started;
+};
+
+struct proxy_metrics
+{
+	rdpMetrics* registry; /* sums over all sessions */
+	SSIZE_T ids[PF_METRIC_LAST];
+	SSIZE_T sessions;
+	SSIZE_T sessionsActive;
+	wArrayList* list; /* proxySessionMetrics of the running sessions */
+
+	SOCKET listener;
+	HANDLE listenEvent;
+	HANDLE stopEvent;
+	HANDLE thread;
+};
+
+static BOOL pf_metrics_send(SOCKET s, const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		const int rc = _send(s, data, (int)MIN(length, INT32_MAX), 0);
+		if (rc <= 0)
+			return FALSE;
+		data += rc;
+		length -= (size_t)rc;
+	}
+	return TRUE;
+}
+
+static BOOL pf_metrics_write_export(wStream* s, rdpMetrics* registry)
+{
+	if (!registry)
+	{
+		if (!Stream_EnsureRemainingCapacity(s, 4))
+			return FALSE;
+		Stream_Write(s, "null", 4);
+		return TRUE;
+	}
+
+	size_t length = 0;
+	char* str = metrics_export(registry, FREERDP_METRICS_FORMAT_JSON, &length);
+	if (!str)
+		return FALSE;
+
+	/* strip the trailing newline */
+	while ((length > 0) && (str[length - 1] == '\n'))
+		length--;
+
+	const BOOL rc = Stream_EnsureRemainingCapacity(s, length);
+	if (rc)
+		Stream_Write(s, str, length);
+	free(str);
+	return rc;
+}
+
+/* the front and back connection of every running session, keyed by the session id */
+static char* pf_metrics_export_sessions(proxyMetrics* metrics, size_t* plength)
+{
+	BOOL rc = TRUE;
+	const char head[] = "{\"sessions\":[";
+	const char tail[] = "]}\n";
+
+	wStream* s = Stream_New(NULL, 1024);
+	if (!s)
+		return NULL;
+
+	Stream_Write(s, head, sizeof(head) - 1);
+
+	ArrayList_Lock(metrics->list);
+	const size_t count = ArrayList_Count(metrics->list);
+	for (size_t x = 0; rc && (x < count); x++)
+	{
+		const proxySessionMetrics* session = ArrayList_GetItem(metrics->list, x);
+		WINPR_ASSERT(session);
+
+		const proxyData* pdata = session->pdata;
+		char id[64] = { 0 };
+		const int len = _snprintf(id, sizeof(id), "%s{\"id\":\"%s\",\"front\":", (x > 0) ? "," : "",
+		                          pdata->session_id);
+		rc = (len > 0) && Stream_EnsureRemainingCapacity(s, (size_t)len);
+		if (!rc)
+			break;
+		Stream_Write(s, id, (size_t)len);
+
+		rc = pf_metrics_write_export(s, session->registry) &&
+		     Stream_EnsureRemainingCapacity(s, 8);
+		if (!rc)
+			break;
+		Stream_Write(s, ",\"back\":", 8);
+
+		rc = pf_metrics_write_export(s, pdata->pc ? pdata->pc->context.metrics : NULL) &&
+		     Stream_EnsureRemainingCapacity(s, 1);
+		if (rc)
+			Stream_Write_UINT8(s, '}');
+	}
+	ArrayList_Unlock(metrics->list);
+
+	if (!rc || !Stream_EnsureRemainingCapacity(s, sizeof(tail)))
+	{
+		Stream_Free(s, TRUE);
+		return NULL;
+	}
+
+	Stream_Write(s, tail, sizeof(tail));
+	*plength = Stream_GetPosition(s) - 1;
+	char* str = Stream_BufferAs(s, char);
+	Stream_Free(s, FALSE);
+	return str;
+}
+
+static void pf_metrics_serve(proxyMetrics* metrics, SOCKET s)
+{
+	char request[1024] = { 0 };
+	size_t len = 0;
+
+	/* only the request line is of interest */
+	while ((len + 1 < sizeof(request)) && !strstr(request, "\r\n"))
+	{
+		const int rc = _recv(s, &request[len], (int)(sizeof(request) - 1 - len), 0);
+		if (rc <= 0)
+			return;
+		len += (size_t)rc;
+	}
+
+	const char* status = "404 Not Found";
+	const char* type = "text/plain";
+	char* body = NULL;
+	size_t bodyLength = 0;
+
+	if (strncmp(request, "GET /metrics ", 13) == 0)
+	{
+		type = "text/plain; version=0.0.4";
+		body = metrics_export(metrics->registry, FREERDP_METRICS_FORMAT_PROMETHEUS, &bodyLength);
+		status = body ? "200 OK" : "500 Internal Server Error";
+	}
+	else if (strncmp(request, "GET /sessions ", 14) == 0)
+	{
+		type = "application/json";
+		body = pf_metrics_export_sessions(metrics, &bodyLength);
+		status = body ? "200 OK" : "500 Internal Server Error";
+	}
+
+	char header[256] = { 0 };
+	const int hlen = _snprintf(header, sizeof(header),
+	                           "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %" PRIuz
+	                           "\r\nConnection: close\r\n\r\n",
+	                           status, type, bodyLength);
+	if ((hlen > 0) && pf_metrics_send(s, header, (size_t)hlen))
+		(void)pf_metrics_send(s, body, bodyLength);
+	free(body);
+}
+
+static DWORD WINAPI pf_metrics_thread(LPVOID arg)
+{
+	proxyMetrics* metrics = arg;
+	WINPR_ASSERT(metrics);
+
+	HANDLE handles[] = { metrics->stopEvent, metrics->listenEvent };
+	while (WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE) ==
+	       WAIT_OBJECT_0 + 1)
+	{
+		struct sockaddr_storage peer = { 0 };
+		int peerlen = sizeof(peer);
+		SOCKET s = _accept(metrics->listener, (struct sockaddr*)&peer, &peerlen);
+		if (s == INVALID_SOCKET)
+			continue;
+
+		/* a scrape is answered in one go, never wait long for a request */
+		u_long arg2 = 0;
+#ifdef _WIN32
+		const DWORD timeout = 2000;
+#else
+		const struct timeval timeout = { 2, 0 };
+#endif
+		if ((_ioctlsocket(s, FIONBIO, &arg2) == 0) &&
+		    (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == 0))
+			pf_metrics_serve(metrics, s);
+		closesocket(s);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+BOOL pf_metrics_start(proxyMetrics* metrics, const proxyConfig* config)
+{
+	WINPR_ASSERT(metrics);
+	WINPR_ASSERT(config);
+
+	if (config->MetricsPort == 0)
+		return TRUE;
+
+	char port[8] = { 0 };
+	(void)_snprintf(port, sizeof(port), "%" PRIu16, config->MetricsPort);
+
+	struct addrinfo hints = { 0 };
+	struct addrinfo* res = NULL;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(config->MetricsHost, port, &hints, &res) != 0)
+	{
+		WLog_ERR(TAG, "failed to resolve metrics endpoint %s", config->MetricsHost);
+		return FALSE;
+	}
+
+	for (struct addrinfo* ai = res; ai && (metrics->listener == INVALID_SOCKET); ai = ai->ai_next)
+	{
+		SOCKET s = _socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (s == INVALID_SOCKET)
+			continue;
+
+		const int option_value = 1;
+		(void)setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&option_value,
+		                 sizeof(option_value));
+
+		if ((_bind(s, ai->ai_addr, (int)ai->ai_addrlen) != 0) || (_listen(s, 10) != 0))
+		{
+			closesocket(s);
+			continue;
+		}
+		metrics->listener = s;
+	}
+	freeaddrinfo(res);
+
+	if (metrics->listener == INVALID_SOCKET)
+	{
+		WLog_ERR(TAG, "failed to listen for metrics on %s:%s", config->MetricsHost, port);
+		return FALSE;
+	}
+
+	if (!(metrics->listenEvent = WSACreateEvent()) ||
+	    (WSAEventSelect(metrics->listener, metrics->listenEvent, FD_READ | FD_ACCEPT) != 0) ||
+	    !(metrics->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)) ||
+	    !(metrics->thread = CreateThread(NULL, 0, pf_metrics_thread, metrics, 0, NULL)))
+	{
+		pf_metrics_stop(metrics);
+		return FALSE;
+	}
+
+	WLog_INFO(TAG, "serving metrics on http://%s:%s/metrics", config->MetricsHost, port);
+	return TRUE;
+}
+
+void pf_metrics_stop(proxyMetrics* metrics)
+{
+	if (!metrics)
+		return;
+
+	if (metrics->thread)
+	{
+		(void)SetEvent(metrics->stopEvent);
+		(void)WaitForSingleObject(metrics->thread, INFINITE);
+		(void)CloseHandle(metrics->thread);
+		metrics->thread = NULL;
+	}
+
+	if (metrics->stopEvent)
+		(void)CloseHandle(metrics->stopEvent);
+	metrics->stopEvent = NULL;
+
+	if (metrics->listenEvent)
+		(void)WSACloseEvent(metrics->listenEvent);
+	metrics->listenEvent = NULL;
+
+	if (metrics->listener != INVALID_SOCKET)
+		closesocket(metrics->listener);
+	metrics->listener = INVALID_SOCKET;
+}
+
+proxyMetrics* pf_metrics_new(void)
+{
+	proxyMetrics* metrics = calloc(1, sizeof(proxyMetrics));
+	if (!metrics)
+		return NULL;
+
+	metrics->listener = INVALID_SOCKET;
+	metrics->registry = metrics_new(NULL);
+	metrics->list = ArrayList_New(TRUE);
+	if (!metrics->registry || !metrics->list)
+		goto fail;
+
+	metrics->sessions = metrics_register(metrics->registry, "proxy_sessions",
+	                                     FREERDP_METRIC_COUNTER);
+	metrics->sessionsActive =
+	    metrics_register(metrics->registry, "proxy_sessions_active", FREERDP_METRIC_GAUGE);
+	if ((metrics->sessions < 0) || (metrics->sessionsActive < 0))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(pf_metric_defs); x++)
+	{
+		metrics->ids[x] = metrics_register(metrics->registry, pf_metric_defs[x].name,
+		                                   pf_metric_defs[x].aggregate);
+		if (metrics->ids[x] < 0)
+			goto fail;
+	}
+
+	return metrics;
+
+fail:
+	pf_metrics_free(metrics);
+	return NULL;
+}
+
+void pf_metrics_free(proxyMetrics* metrics)
+{
+	if (!metrics)
+		return;
+
+	pf_metrics_stop(metrics);
+	ArrayList_Free(metrics->list);
+	metrics_free(metrics->registry);
+	free(metrics);
+}
+
+SSIZE_T pf_metrics_register_module(proxyMetrics* metrics, const char* plugin)
+{
+	WINPR_ASSERT(plugin);
+
+	if (!metrics)
+		return -1;
+
+	char name[128] = { 0 };
+	const int rc = _snprintf(name, sizeof(name), "proxy_module_%s_us", plugin);
+	if ((rc < 0) || ((size_t)rc >= sizeof(name)))
+		return -1;
+
+	/* plugin names are free form, metric names are not */
+	for (char* cur = name; *cur != '\0'; cur++)
+	{
+		const char c = *cur;
+		if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+		      ((c >= '0') && (c <= '9'))))
+			*cur = '_';
+	}
+
+	return metrics_register(metrics->registry, name, FREERDP_METRIC_HISTOGRAM);
+}
+
+void pf_metrics_record(proxyMetrics* metrics, SSIZE_T id, UINT64 value)
+{
+	if (!metrics || (id < 0))
+		return;
+	(void)metrics_record(metrics->registry, id, value);
+}
+
+BOOL pf_metrics_session_start(proxyMetrics* metrics, proxyData* pdata)
+{
+	WINPR_ASSERT(metrics);
+	WINPR_ASSERT(pdata);
+	WINPR_ASSERT(pdata->ps);
+
+	proxySessionMetrics* session = calloc(1, sizeof(proxySessionMetrics));
+	if (!session)
+		return FALSE;
+
+	session->server = metrics;
+	session->pdata = pdata;
+	session->registry = pdata->ps->context.metrics;
+	session->started = winpr_GetTickCount64NS();
+
+	for (size_t x = 0; x < ARRAYSIZE(pf_metric_defs); x++)
+	{
+		session->ids[x] =
+		    metrics_register(session->registry, pf_metric_defs[x].name, pf_metric_defs[x].session);
+		if (session->ids[x] < 0)
+			goto fail;
+	}
+
+	ArrayList_Lock(metrics->list);
+	const BOOL rc = ArrayList_Append(metrics->list, session);
+	const size_t count = ArrayList_Count(metrics->list);
+	ArrayList_Unlock(metrics->list);
+	if (!rc)
+		goto fail;
+
+	pdata->metrics = session;
+	pf_metrics_record(metrics, metrics->sessions, 1);
+	pf_metrics_record(metrics, metrics->sessionsActive, count);
+	return TRUE;
+
+fail:
+	free(session);
+	return FALSE;
+}
+
+void pf_metrics_session_end(proxyData* pdata)
+{
+	if (!pdata || !pdata->metrics)
+		return;
+
+	proxySessionMetrics* session = pdata->metrics;
+	proxyMetrics* metrics = session->server;
+
+	ArrayList_Lock(metrics->list);
+	ArrayList_Remove(metrics->list, session);
+	const size_t count = ArrayList_Count(metrics->list);
+	ArrayList_Unlock(metrics->list);
+
+	pf_metrics_record(metrics, metrics->sessionsActive, count);
+	pdata->metrics = NULL;
+	free(session);
+}
+
+void pf_metrics_session_record(proxyData* pdata, PfSessionMetric metric, UINT64 value)
+{
+	WINPR_ASSERT(pdata);
+	WINPR_ASSERT(metric < PF_METRIC_LAST);
+
+	proxySessionMetrics* session = pdata->metrics;
+	if (!session)
+		return;
+
+	(void)metrics_record(session->registry, session->ids[metric], value);
+	pf_metrics_record(session->server, session->server->ids[metric], value);
+}
+
+void pf_metrics_session_elapsed(proxyData* pdata, PfSessionMetric metric)
+{
+	WINPR_ASSERT(pdata);
+
+	const proxySessionMetrics* session = pdata->metrics;
+	if (!session)
+		return;
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	pf_metrics_session_record(pdata, metric, (now - session->started) / 1000);
+}
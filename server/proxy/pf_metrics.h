@@ -0,0 +1,58 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server metrics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INT_FREERDP_SERVER_PROXY_METRICS_H
+#define INT_FREERDP_SERVER_PROXY_METRICS_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/metrics.h>
+#include <freerdp/server/proxy/proxy_config.h>
+#include <freerdp/server/proxy/proxy_context.h>
+
+typedef struct proxy_metrics proxyMetrics;
+
+/* metrics kept per session and summed up over all sessions */
+typedef enum
+{
+	PF_METRIC_SETUP_FRONT_US,  /* accepted until the client connection is established */
+	PF_METRIC_SETUP_TARGET_US, /* connecting to the target, including TLS and NLA */
+	PF_METRIC_BACK_QUEUE_DEPTH, /* channel data of the client waiting for the target */
+	PF_METRIC_FRONT_BYTES,
+	PF_METRIC_FRONT_PDUS,
+	PF_METRIC_BACK_BYTES,
+	PF_METRIC_BACK_PDUS,
+	PF_METRIC_LAST
+} PfSessionMetric;
+
+proxyMetrics* pf_metrics_new(void);
+void pf_metrics_free(proxyMetrics* metrics);
+
+/* serves the metrics over HTTP if the configuration has a metrics port */
+BOOL pf_metrics_start(proxyMetrics* metrics, const proxyConfig* config);
+void pf_metrics_stop(proxyMetrics* metrics);
+
+SSIZE_T pf_metrics_register_module(proxyMetrics* metrics, const char* plugin);
+void pf_metrics_record(proxyMetrics* metrics, SSIZE_T id, UINT64 value);
+
+BOOL pf_metrics_session_start(proxyMetrics* metrics, proxyData* pdata);
+void pf_metrics_session_end(proxyData* pdata);
+void pf_metrics_session_record(proxyData* pdata, PfSessionMetric metric, UINT64 value);
+/* records the microseconds since the session started */
+void pf_metrics_session_elapsed(proxyData* pdata, PfSessionMetric metric);
+
+#endif /* INT_FREERDP_SERVER_PROXY_METRICS_H */
@@ -26,6 +26,7 @@
 #include <winpr/wlog.h>
 #include <winpr/path.h>
 #include <winpr/library.h>
+#include <winpr/sysinfo.h>
 #include <freerdp/api.h>
 #include <freerdp/build-config.h>
 
@@ -39,11 +40,30 @@
 
 #define MODULE_ENTRY_POINT "proxy_module_entry_point"
 
+typedef struct
+{
+	proxyPlugin* plugin;
+	proxyHookFn fn;
+	SSIZE_T metricId; /* run time histogram of the plugin, -1 if not measured */
+} pfModuleCallback;
+
+typedef struct
+{
+	pfModuleCallback* callbacks;
+	size_t count;
+} pfModuleDispatch;
+
 struct proxy_module
 {
 	proxyPluginsManager mgr;
 	wArrayList* plugins;
 	wArrayList* handles;
+
+	/* the subscribers of every hook and filter type in registration order */
+	pfModuleDispatch hooks[HOOK_LAST];
+	pfModuleDispatch filters[FILTER_LAST];
+
+	proxyMetrics* metrics;
 };
 
 static const char* pf_modules_get_filter_type_string(PF_FILTER_TYPE result)
@@ -122,99 +142,50 @@ static const char* pf_modules_get_hook_type_string(PF_HOOK_TYPE result)
 	}
 }
 
-static BOOL pf_modules_proxy_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
+static proxyHookFn pf_modules_get_hook(const proxyPlugin* plugin, PF_HOOK_TYPE type)
 {
-	proxyPlugin* plugin = (proxyPlugin*)data;
-	BOOL ok = FALSE;
-
-	WINPR_UNUSED(index);
-
-	PF_HOOK_TYPE type = va_arg(ap, PF_HOOK_TYPE);
-	proxyData* pdata = va_arg(ap, proxyData*);
-	void* custom = va_arg(ap, void*);
-
-	WLog_VRB(TAG, "running hook %s.%s", plugin->name, pf_modules_get_hook_type_string(type));
+	WINPR_ASSERT(plugin);
 
 	switch (type)
 	{
 		case HOOK_TYPE_CLIENT_INIT_CONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientInitConnect, plugin, pdata, custom);
-			break;
+			return plugin->ClientInitConnect;
 		case HOOK_TYPE_CLIENT_UNINIT_CONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientUninitConnect, plugin, pdata, custom);
-			break;
+			return plugin->ClientUninitConnect;
 		case HOOK_TYPE_CLIENT_PRE_CONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientPreConnect, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientPreConnect;
 		case HOOK_TYPE_CLIENT_POST_CONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientPostConnect, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientPostConnect;
 		case HOOK_TYPE_CLIENT_REDIRECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientRedirect, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientRedirect;
 		case HOOK_TYPE_CLIENT_POST_DISCONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientPostDisconnect, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientPostDisconnect;
 		case HOOK_TYPE_CLIENT_VERIFY_X509:
-			ok = IFCALLRESULT(TRUE, plugin->ClientX509Certificate, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientX509Certificate;
 		case HOOK_TYPE_CLIENT_LOGIN_FAILURE:
-			ok = IFCALLRESULT(TRUE, plugin->ClientLoginFailure, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientLoginFailure;
 		case HOOK_TYPE_CLIENT_END_PAINT:
-			ok = IFCALLRESULT(TRUE, plugin->ClientEndPaint, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientEndPaint;
 		case HOOK_TYPE_CLIENT_LOAD_CHANNELS:
-			ok = IFCALLRESULT(TRUE, plugin->ClientLoadChannels, plugin, pdata, custom);
-			break;
-
+			return plugin->ClientLoadChannels;
 		case HOOK_TYPE_SERVER_POST_CONNECT:
-			ok = IFCALLRESULT(TRUE, plugin->ServerPostConnect, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerPostConnect;
 		case HOOK_TYPE_SERVER_ACTIVATE:
-			ok = IFCALLRESULT(TRUE, plugin->ServerPeerActivate, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerPeerActivate;
 		case HOOK_TYPE_SERVER_CHANNELS_INIT:
-			ok = IFCALLRESULT(TRUE, plugin->ServerChannelsInit, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerChannelsInit;
 		case HOOK_TYPE_SERVER_CHANNELS_FREE:
-			ok = IFCALLRESULT(TRUE, plugin->ServerChannelsFree, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerChannelsFree;
 		case HOOK_TYPE_SERVER_SESSION_END:
-			ok = IFCALLRESULT(TRUE, plugin->ServerSessionEnd, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerSessionEnd;
 		case HOOK_TYPE_SERVER_SESSION_INITIALIZE:
-			ok = IFCALLRESULT(TRUE, plugin->ServerSessionInitialize, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerSessionInitialize;
 		case HOOK_TYPE_SERVER_SESSION_STARTED:
-			ok = IFCALLRESULT(TRUE, plugin->ServerSessionStarted, plugin, pdata, custom);
-			break;
-
+			return plugin->ServerSessionStarted;
 		case HOOK_LAST:
 		default:
-			WLog_ERR(TAG, "invalid hook called");
+			return NULL;
 	}
-
-	if (!ok)
-	{
-		WLog_INFO(TAG, "plugin %s, hook %s failed!", plugin->name,
-		          pf_modules_get_hook_type_string(type));
-		return FALSE;
-	}
-	return TRUE;
 }
 
 /*
@@ -226,90 +197,71 @@ static BOOL pf_modules_proxy_ArrayList_ForEachFkt(void* data, size_t index, va_l
 BOOL pf_modules_run_hook(proxyModule* module, PF_HOOK_TYPE type, proxyData* pdata, void* custom)
 {
 	WINPR_ASSERT(module);
-	WINPR_ASSERT(module->plugins);
-	return ArrayList_ForEach(module->plugins, pf_modules_proxy_ArrayList_ForEachFkt, type, pdata,
-	                         custom);
-}
 
-static BOOL pf_modules_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
-{
-	proxyPlugin* plugin = (proxyPlugin*)data;
-	BOOL result = FALSE;
-
-	WINPR_UNUSED(index);
+	if ((type < 0) || (type >= HOOK_LAST))
+	{
+		WLog_ERR(TAG, "invalid hook called");
+		return FALSE;
+	}
 
-	PF_FILTER_TYPE type = va_arg(ap, PF_FILTER_TYPE);
-	proxyData* pdata = va_arg(ap, proxyData*);
-	void* param = va_arg(ap, void*);
+	const pfModuleDispatch* dispatch = &module->hooks[type];
+	for (size_t x = 0; x < dispatch->count; x++)
+	{
+		const pfModuleCallback* cb = &dispatch->callbacks[x];
+
+		WLog_VRB(TAG, "running hook %s.%s", cb->plugin->name,
+		         pf_modules_get_hook_type_string(type));
+		const UINT64 start = (cb->metricId >= 0) ? winpr_GetTickCount64NS() : 0;
+		const BOOL rc = cb->fn(cb->plugin, pdata, custom);
+		if (cb->metricId >= 0)
+			pf_metrics_record(module->metrics, cb->metricId,
+			                  (winpr_GetTickCount64NS() - start) / 1000ull);
+		if (!rc)
+		{
+			WLog_INFO(TAG, "plugin %s, hook %s failed!", cb->plugin->name,
+			          pf_modules_get_hook_type_string(type));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
 
-	WLog_VRB(TAG, "running filter: %s", plugin->name);
+static proxyFilterFn pf_modules_get_filter(const proxyPlugin* plugin, PF_FILTER_TYPE type)
+{
+	WINPR_ASSERT(plugin);
 
 	switch (type)
 	{
 		case FILTER_TYPE_KEYBOARD:
-			result = IFCALLRESULT(TRUE, plugin->KeyboardEvent, plugin, pdata, param);
-			break;
-
+			return plugin->KeyboardEvent;
 		case FILTER_TYPE_UNICODE:
-			result = IFCALLRESULT(TRUE, plugin->UnicodeEvent, plugin, pdata, param);
-			break;
-
+			return plugin->UnicodeEvent;
 		case FILTER_TYPE_MOUSE:
-			result = IFCALLRESULT(TRUE, plugin->MouseEvent, plugin, pdata, param);
-			break;
-
+			return plugin->MouseEvent;
 		case FILTER_TYPE_MOUSE_EX:
-			result = IFCALLRESULT(TRUE, plugin->MouseExEvent, plugin, pdata, param);
-			break;
-
+			return plugin->MouseExEvent;
 		case FILTER_TYPE_CLIENT_PASSTHROUGH_CHANNEL_DATA:
-			result = IFCALLRESULT(TRUE, plugin->ClientChannelData, plugin, pdata, param);
-			break;
-
+			return plugin->ClientChannelData;
 		case FILTER_TYPE_SERVER_PASSTHROUGH_CHANNEL_DATA:
-			result = IFCALLRESULT(TRUE, plugin->ServerChannelData, plugin, pdata, param);
-			break;
-
+			return plugin->ServerChannelData;
 		case FILTER_TYPE_CLIENT_PASSTHROUGH_CHANNEL_CREATE:
-			result = IFCALLRESULT(TRUE, plugin->ChannelCreate, plugin, pdata, param);
-			break;
-
+			return plugin->ChannelCreate;
 		case FILTER_TYPE_CLIENT_PASSTHROUGH_DYN_CHANNEL_CREATE:
-			result = IFCALLRESULT(TRUE, plugin->DynamicChannelCreate, plugin, pdata, param);
-			break;
-
+			return plugin->DynamicChannelCreate;
 		case FILTER_TYPE_SERVER_FETCH_TARGET_ADDR:
-			result = IFCALLRESULT(TRUE, plugin->ServerFetchTargetAddr, plugin, pdata, param);
-			break;
-
+			return plugin->ServerFetchTargetAddr;
 		case FILTER_TYPE_SERVER_PEER_LOGON:
-			result = IFCALLRESULT(TRUE, plugin->ServerPeerLogon, plugin, pdata, param);
-			break;
-
+			return plugin->ServerPeerLogon;
 		case FILTER_TYPE_INTERCEPT_CHANNEL:
-			result = IFCALLRESULT(TRUE, plugin->DynChannelIntercept, plugin, pdata, param);
-			break;
-
+			return plugin->DynChannelIntercept;
 		case FILTER_TYPE_DYN_INTERCEPT_LIST:
-			result = IFCALLRESULT(TRUE, plugin->DynChannelToIntercept, plugin, pdata, param);
-			break;
-
+			return plugin->DynChannelToIntercept;
 		case FILTER_TYPE_STATIC_INTERCEPT_LIST:
-			result = IFCALLRESULT(TRUE, plugin->StaticChannelToIntercept, plugin, pdata, param);
-			break;
-
+			return plugin->StaticChannelToIntercept;
 		case FILTER_LAST:
 		default:
-			WLog_ERR(TAG, "invalid filter called");
-	}
-
-	if (!result)
-	{
-		/* current filter return FALSE, no need to run other filters. */
-		WLog_DBG(TAG, "plugin %s, filter type [%s] returned FALSE", plugin->name,
-		         pf_modules_get_filter_type_string(type));
+			return NULL;
 	}
-	return result;
 }
 
 /*
@@ -321,9 +273,33 @@ static BOOL pf_modules_ArrayList_ForEachFkt(void* data, size_t index, va_list ap
 BOOL pf_modules_run_filter(proxyModule* module, PF_FILTER_TYPE type, proxyData* pdata, void* param)
 {
 	WINPR_ASSERT(module);
-	WINPR_ASSERT(module->plugins);
 
-	return ArrayList_ForEach(module->plugins, pf_modules_ArrayList_ForEachFkt, type, pdata, param);
+	if ((type < 0) || (type >= FILTER_LAST))
+	{
+		WLog_ERR(TAG, "invalid filter called");
+		return FALSE;
+	}
+
+	const pfModuleDispatch* dispatch = &module->filters[type];
+	for (size_t x = 0; x < dispatch->count; x++)
+	{
+		const pfModuleCallback* cb = &dispatch->callbacks[x];
+
+		WLog_VRB(TAG, "running filter: %s", cb->plugin->name);
+		const UINT64 start = (cb->metricId >= 0) ? winpr_GetTickCount64NS() : 0;
+		const BOOL rc = cb->fn(cb->plugin, pdata, param);
+		if (cb->metricId >= 0)
+			pf_metrics_record(module->metrics, cb->metricId,
+			                  (winpr_GetTickCount64NS() - start) / 1000ull);
+		if (!rc)
+		{
+			/* current filter return FALSE, no need to run other filters. */
+			WLog_DBG(TAG, "plugin %s, filter type [%s] returned FALSE", cb->plugin->name,
+			         pf_modules_get_filter_type_string(type));
+			return FALSE;
+		}
+	}
+	return TRUE;
 }
 
 /*
@@ -400,6 +376,73 @@ static BOOL pf_modules_register_ArrayList_ForEachFkt(void* data, size_t index, v
 	return TRUE;
 }
 
+static BOOL pf_modules_dispatch_add(proxyModule* module, pfModuleDispatch* dispatch,
+                                    proxyPlugin* plugin, proxyHookFn fn)
+{
+	WINPR_ASSERT(module);
+	WINPR_ASSERT(dispatch);
+
+	if (!fn)
+		return TRUE;
+
+	pfModuleCallback* tmp =
+	    realloc(dispatch->callbacks, (dispatch->count + 1) * sizeof(pfModuleCallback));
+	if (!tmp)
+		return FALSE;
+
+	tmp[dispatch->count].plugin = plugin;
+	tmp[dispatch->count].fn = fn;
+	tmp[dispatch->count].metricId = pf_metrics_register_module(module->metrics, plugin->name);
+	dispatch->callbacks = tmp;
+	dispatch->count++;
+	return TRUE;
+}
+
+static void pf_modules_dispatch_remove_from(pfModuleDispatch* dispatch, const proxyPlugin* plugin)
+{
+	WINPR_ASSERT(dispatch);
+
+	size_t count = 0;
+	for (size_t x = 0; x < dispatch->count; x++)
+	{
+		if (dispatch->callbacks[x].plugin != plugin)
+			dispatch->callbacks[count++] = dispatch->callbacks[x];
+	}
+	dispatch->count = count;
+}
+
+static void pf_modules_dispatch_set_metrics(pfModuleDispatch* dispatch, proxyMetrics* metrics)
+{
+	WINPR_ASSERT(dispatch);
+
+	for (size_t x = 0; x < dispatch->count; x++)
+	{
+		pfModuleCallback* cb = &dispatch->callbacks[x];
+		cb->metricId = pf_metrics_register_module(metrics, cb->plugin->name);
+	}
+}
+
+void pf_modules_set_metrics(proxyModule* module, proxyMetrics* metrics)
+{
+	WINPR_ASSERT(module);
+
+	module->metrics = metrics;
+	for (size_t x = 0; x < HOOK_LAST; x++)
+		pf_modules_dispatch_set_metrics(&module->hooks[x], metrics);
+	for (size_t x = 0; x < FILTER_LAST; x++)
+		pf_modules_dispatch_set_metrics(&module->filters[x], metrics);
+}
+
+static void pf_modules_dispatch_remove(proxyModule* module, const proxyPlugin* plugin)
+{
+	WINPR_ASSERT(module);
+
+	for (size_t x = 0; x < HOOK_LAST; x++)
+		pf_modules_dispatch_remove_from(&module->hooks[x], plugin);
+	for (size_t x = 0; x < FILTER_LAST; x++)
+		pf_modules_dispatch_remove_from(&module->filters[x], plugin);
+}
+
 static BOOL pf_modules_register_plugin(proxyPluginsManager* mgr,
                                        const proxyPlugin* plugin_to_register)
 {
@@ -423,7 +466,31 @@ static BOOL pf_modules_register_plugin(proxyPluginsManager* mgr,
 		return FALSE;
 	}
 
+	/* the list holds its own copy of the plugin, subscribe that one */
+	proxyPlugin* plugin = ArrayList_GetItem(module->plugins, ArrayList_Count(module->plugins) - 1);
+	WINPR_ASSERT(plugin);
+
+	for (size_t x = 0; x < HOOK_LAST; x++)
+	{
+		if (!pf_modules_dispatch_add(module, &module->hooks[x], plugin,
+		                             pf_modules_get_hook(plugin, (PF_HOOK_TYPE)x)))
+			goto fail;
+	}
+
+	for (size_t x = 0; x < FILTER_LAST; x++)
+	{
+		if (!pf_modules_dispatch_add(module, &module->filters[x], plugin,
+		                             pf_modules_get_filter(plugin, (PF_FILTER_TYPE)x)))
+			goto fail;
+	}
+
 	return TRUE;
+
+fail:
+	WLog_ERR(TAG, "failed subscribing plugin: %s", plugin_to_register->name);
+	pf_modules_dispatch_remove(module, plugin);
+	ArrayList_Remove(module->plugins, plugin);
+	return FALSE;
 }
 
 static BOOL pf_modules_load_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
@@ -618,6 +685,11 @@ void pf_modules_free(proxyModule* module)
 	if (!module)
 		return;
 
+	for (size_t x = 0; x < HOOK_LAST; x++)
+		free(module->hooks[x].callbacks);
+	for (size_t x = 0; x < FILTER_LAST; x++)
+		free(module->filters[x].callbacks);
+
 	ArrayList_Free(module->plugins);
 	ArrayList_Free(module->handles);
 	free(module);
@@ -304,6 +304,7 @@ static BOOL pf_server_post_connect(freerdp_peer* peer)
 
 	const char* ClientHostname = freerdp_settings_get_string(frontSettings, FreeRDP_ClientHostname);
 	PROXY_LOG_INFO(TAG, ps, "Accepted client: %s", ClientHostname);
+	pf_metrics_session_elapsed(pdata, PF_METRIC_SETUP_FRONT_US);
 	if (!pf_server_setup_channels(peer))
 	{
 		PROXY_LOG_ERR(TAG, ps, "error setting up channels");
@@ -335,6 +336,11 @@ static BOOL pf_server_post_connect(freerdp_peer* peer)
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_POST_CONNECT, pdata, peer))
 		return FALSE;
 
+	/* with an event loop worker the thread only connects, the worker then drives the client */
+	const proxyServer* server = (const proxyServer*)peer->ContextExtra;
+	WINPR_ASSERT(server);
+	pdata->client_shared_loop = (server->reactor != NULL);
+
 	/* Start a proxy's client in it's own thread */
 	if (!(pdata->client_thread = CreateThread(NULL, 0, pf_client_start, pc, 0, NULL)))
 	{
@@ -431,6 +437,9 @@ static BOOL pf_server_receive_channel_data_hook(freerdp_peer* peer, UINT16 chann
 		return TRUE;
 	}
 
+	pf_metrics_session_record(pdata, PF_METRIC_FRONT_BYTES, size);
+	pf_metrics_session_record(pdata, PF_METRIC_FRONT_PDUS, 1);
+
 	WINPR_ASSERT(channel->onFrontData);
 	switch (channel->onFrontData(pdata, channel, data, size, flags, totalSize))
 	{
@@ -534,6 +543,8 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 		return FALSE;
 	if (!freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, config->ServerNlaSecurity))
 		return FALSE;
+	if (!freerdp_settings_set_bool(settings, FreeRDP_TlsKernelOffload, config->TlsKernelOffload))
+		return FALSE;
 
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_EncryptionLevel,
 	                                 ENCRYPTION_LEVEL_CLIENT_COMPATIBLE))
@@ -565,43 +576,43 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	return TRUE;
 }
 
-/**
- * Handles an incoming client connection, to be run in it's own thread.
- *
- * arg is a pointer to a freerdp_peer representing the client.
- */
-static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
+static size_t pf_server_peer_count(proxyServer* server)
 {
-	HANDLE eventHandles[MAXIMUM_WAIT_OBJECTS] = { 0 };
-	pServerContext* ps = NULL;
-	proxyData* pdata = NULL;
-	peer_thread_args* args = arg;
+	WINPR_ASSERT(server);
 
-	WINPR_ASSERT(args);
+	size_t count = ArrayList_Count(server->peer_list);
+	if (server->reactor)
+		count += freerdp_peer_reactor_count(server->reactor);
+	return count;
+}
 
-	freerdp_peer* client = args->client;
+static BOOL pf_server_peer_init(freerdp_peer* client)
+{
 	WINPR_ASSERT(client);
 
 	proxyServer* server = (proxyServer*)client->ContextExtra;
 	WINPR_ASSERT(server);
 
-	size_t count = ArrayList_Count(server->peer_list);
+	const size_t count = pf_server_peer_count(server);
 
 	if (!pf_context_init_server_context(client))
-		goto out_free_peer;
+		return FALSE;
 
 	if (!pf_server_initialize_peer_connection(client))
-		goto out_free_peer;
+		return FALSE;
 
-	ps = (pServerContext*)client->context;
+	pServerContext* ps = (pServerContext*)client->context;
 	WINPR_ASSERT(ps);
 	PROXY_LOG_DBG(TAG, ps, "Added peer, %" PRIuz " connected", count);
 
-	pdata = ps->pdata;
+	proxyData* pdata = ps->pdata;
 	WINPR_ASSERT(pdata);
 
+	if (!pf_metrics_session_start(server->metrics, pdata))
+		return FALSE;
+
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_INITIALIZE, pdata, client))
-		goto out_free_peer;
+		return FALSE;
 
 	WINPR_ASSERT(client->Initialize);
 	client->Initialize(client);
@@ -609,132 +620,191 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 	PROXY_LOG_INFO(TAG, ps, "new connection: proxy address: %s, client address: %s",
 	               pdata->config->Host, client->hostname);
 
-	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_STARTED, pdata, client))
-		goto out_free_peer;
+	return pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_STARTED, pdata, client);
+}
 
-	while (1)
-	{
-		HANDLE ChannelEvent = INVALID_HANDLE_VALUE;
-		DWORD eventCount = 0;
-		{
-			WINPR_ASSERT(client->GetEventHandles);
-			const DWORD tmp = client->GetEventHandles(client, &eventHandles[eventCount],
-			                                          ARRAYSIZE(eventHandles) - eventCount);
+static BOOL pf_server_client_handed_over(const proxyData* pdata)
+{
+	WINPR_ASSERT(pdata);
+	if (!pdata->client_shared_loop)
+		return FALSE;
+	return WaitForSingleObject(pdata->client_connected, 0) == WAIT_OBJECT_0;
+}
 
-			if (tmp == 0)
-			{
-				PROXY_LOG_ERR(TAG, ps, "Failed to get FreeRDP transport event handles");
-				break;
-			}
+/* the handles the event loop of a peer waits on, apart from the server stop event */
+static DWORD pf_server_peer_get_handles(freerdp_peer* client, WINPR_ATTR_UNUSED void* userarg,
+                                        HANDLE* handles, DWORD count)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(handles);
 
-			eventCount += tmp;
-		}
-		/* Main client event handling loop */
-		ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+	pServerContext* ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+	proxyData* pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
 
-		WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
-		WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
-		eventHandles[eventCount++] = ChannelEvent;
-		eventHandles[eventCount++] = pdata->abort_event;
-		eventHandles[eventCount++] = server->stopEvent;
+	if (count < 4)
+		return 0;
 
-		const DWORD status = WaitForMultipleObjects(
-		    eventCount, eventHandles, FALSE, 1000); /* Do periodic polling to avoid client hang */
+	WINPR_ASSERT(client->GetEventHandles);
+	DWORD eventCount = client->GetEventHandles(client, handles, count - 3);
+	if (eventCount == 0)
+	{
+		PROXY_LOG_ERR(TAG, ps, "Failed to get FreeRDP transport event handles");
+		return 0;
+	}
 
-		if (status == WAIT_FAILED)
-		{
-			PROXY_LOG_ERR(TAG, ps, "WaitForMultipleObjects failed (status: %" PRIu32 ")", status);
-			break;
-		}
+	HANDLE ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
 
-		WINPR_ASSERT(client->CheckFileDescriptor);
-		if (client->CheckFileDescriptor(client) != TRUE)
-			break;
+	WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
+	WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
+	handles[eventCount++] = ChannelEvent;
+	handles[eventCount++] = pdata->abort_event;
 
-		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	if (pdata->client_shared_loop)
+	{
+		/* wait for the hand over, then for the client's handles in the same set */
+		if (!pf_server_client_handed_over(pdata))
+			handles[eventCount++] = pdata->client_connected;
+		else
 		{
-			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-			{
-				PROXY_LOG_ERR(TAG, ps, "WTSVirtualChannelManagerCheckFileDescriptor failure");
-				goto fail;
-			}
+			const DWORD clientCount =
+			    pf_client_get_event_handles(pdata->pc, &handles[eventCount], count - eventCount);
+			if (clientCount == 0)
+				return 0;
+			eventCount += clientCount;
 		}
+	}
+	return eventCount;
+}
+
+static BOOL pf_server_peer_check(freerdp_peer* client, WINPR_ATTR_UNUSED void* userarg)
+{
+	WINPR_ASSERT(client);
+
+	proxyServer* server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+	pServerContext* ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+	proxyData* pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
 
-		/* only disconnect after checking client's and vcm's file descriptors  */
-		if (proxy_data_shall_disconnect(pdata))
+	WINPR_ASSERT(client->CheckFileDescriptor);
+	if (client->CheckFileDescriptor(client) != TRUE)
+		return FALSE;
+
+	HANDLE ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+	if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
 		{
-			PROXY_LOG_INFO(TAG, ps, "abort event is set, closing connection with peer %s",
-			               client->hostname);
-			break;
+			PROXY_LOG_ERR(TAG, ps, "WTSVirtualChannelManagerCheckFileDescriptor failure");
+			return FALSE;
 		}
+	}
 
-		if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
+	/* only disconnect after checking client's and vcm's file descriptors  */
+	if (proxy_data_shall_disconnect(pdata))
+	{
+		PROXY_LOG_INFO(TAG, ps, "abort event is set, closing connection with peer %s",
+		               client->hostname);
+		return FALSE;
+	}
+
+	if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
+	{
+		PROXY_LOG_INFO(TAG, ps, "Server shutting down, terminating peer");
+		return FALSE;
+	}
+
+	if (pf_server_client_handed_over(pdata))
+	{
+		if (!pf_client_check_event_handles(pdata->pc))
 		{
-			PROXY_LOG_INFO(TAG, ps, "Server shutting down, terminating peer");
-			break;
+			PROXY_LOG_INFO(TAG, ps, "proxy's client disconnected, closing connection with peer %s",
+			               client->hostname);
+			return FALSE;
 		}
+	}
 
-		switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
-		{
-			/* Dynamic channel status may have been changed after processing */
-			case DRDYNVC_STATE_NONE:
+	switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+	{
+		/* Dynamic channel status may have been changed after processing */
+		case DRDYNVC_STATE_NONE:
 
-				/* Initialize drdynvc channel */
-				if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-				{
-					PROXY_LOG_ERR(TAG, ps, "Failed to initialize drdynvc channel");
-					goto fail;
-				}
+			/* Initialize drdynvc channel */
+			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
+			{
+				PROXY_LOG_ERR(TAG, ps, "Failed to initialize drdynvc channel");
+				return FALSE;
+			}
 
-				break;
+			break;
 
-			case DRDYNVC_STATE_READY:
-				if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
-				{
-					(void)SetEvent(ps->dynvcReady);
-				}
+		case DRDYNVC_STATE_READY:
+			if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
+			{
+				(void)SetEvent(ps->dynvcReady);
+			}
 
-				break;
+			break;
 
-			default:
-				break;
-		}
+		default:
+			break;
 	}
 
-fail:
+	return TRUE;
+}
 
-	PROXY_LOG_INFO(TAG, ps, "starting shutdown of connection");
-	PROXY_LOG_INFO(TAG, ps, "stopping proxy's client");
+/* shut down the connection, the peer itself is freed by pf_server_peer_free */
+static void pf_server_peer_close(freerdp_peer* client, BOOL started)
+{
+	WINPR_ASSERT(client);
 
-	/* Abort the client. */
-	proxy_data_abort_connect(pdata);
+	pServerContext* ps = (pServerContext*)client->context;
+	proxyData* pdata = ps ? ps->pdata : NULL;
 
-	pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_END, pdata, client);
+	if (started)
+	{
+		WINPR_ASSERT(pdata);
+		PROXY_LOG_INFO(TAG, ps, "starting shutdown of connection");
+		PROXY_LOG_INFO(TAG, ps, "stopping proxy's client");
 
-	PROXY_LOG_INFO(TAG, ps, "freeing server's channels");
+		/* Abort the client. */
+		proxy_data_abort_connect(pdata);
 
-	WINPR_ASSERT(client->Close);
-	client->Close(client);
+		pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_END, pdata, client);
 
-	WINPR_ASSERT(client->Disconnect);
-	client->Disconnect(client);
+		PROXY_LOG_INFO(TAG, ps, "freeing server's channels");
+
+		WINPR_ASSERT(client->Close);
+		client->Close(client);
+
+		WINPR_ASSERT(client->Disconnect);
+		client->Disconnect(client);
+	}
 
-out_free_peer:
 	PROXY_LOG_INFO(TAG, ps, "freeing proxy data");
 
 	if (pdata && pdata->client_thread)
 	{
 		proxy_data_abort_connect(pdata);
 		(void)WaitForSingleObject(pdata->client_thread, INFINITE);
-	}
 
-	{
-		ArrayList_Lock(server->peer_list);
-		ArrayList_Remove(server->peer_list, args->thread);
-		count = ArrayList_Count(server->peer_list);
-		ArrayList_Unlock(server->peer_list);
+		if (pf_server_client_handed_over(pdata))
+			pf_client_close(pdata->pc);
 	}
-	PROXY_LOG_DBG(TAG, ps, "Removed peer, %" PRIuz " connected", count);
+}
+
+static void pf_server_peer_free(freerdp_peer* client)
+{
+	WINPR_ASSERT(client);
+
+	pServerContext* ps = (pServerContext*)client->context;
+	proxyData* pdata = ps ? ps->pdata : NULL;
+
+	if (pdata)
+		pf_metrics_session_end(pdata);
 	freerdp_peer_context_free(client);
 	freerdp_peer_free(client);
 	proxy_data_free(pdata);
@@ -742,25 +812,110 @@ out_free_peer:
 #if defined(WITH_DEBUG_EVENTS)
 	DumpEventHandles();
 #endif
+}
+
+static void pf_server_peer_removed(freerdp_peer* client, WINPR_ATTR_UNUSED void* userarg)
+{
+	WINPR_ASSERT(client);
+
+	pServerContext* ps = (pServerContext*)client->context;
+	pf_server_peer_close(client, TRUE);
+	PROXY_LOG_DBG(TAG, ps, "Removed peer");
+	pf_server_peer_free(client);
+}
+
+/**
+ * Handles an incoming client connection, to be run in it's own thread.
+ *
+ * arg is a pointer to a freerdp_peer representing the client.
+ */
+static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
+{
+	HANDLE eventHandles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	peer_thread_args* args = arg;
+
+	WINPR_ASSERT(args);
+
+	freerdp_peer* client = args->client;
+	WINPR_ASSERT(client);
+
+	proxyServer* server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+
+	const BOOL started = pf_server_peer_init(client);
+	pServerContext* ps = (pServerContext*)client->context;
+	while (started)
+	{
+		DWORD eventCount =
+		    pf_server_peer_get_handles(client, NULL, eventHandles, ARRAYSIZE(eventHandles) - 1);
+		if (eventCount == 0)
+			break;
+
+		eventHandles[eventCount++] = server->stopEvent;
+
+		const DWORD status = WaitForMultipleObjects(
+		    eventCount, eventHandles, FALSE, 1000); /* Do periodic polling to avoid client hang */
+
+		if (status == WAIT_FAILED)
+		{
+			PROXY_LOG_ERR(TAG, ps, "WaitForMultipleObjects failed (status: %" PRIu32 ")", status);
+			break;
+		}
+
+		if (!pf_server_peer_check(client, NULL))
+			break;
+	}
+
+	pf_server_peer_close(client, started);
+
+	{
+		ArrayList_Lock(server->peer_list);
+		ArrayList_Remove(server->peer_list, args->thread);
+		const size_t count = ArrayList_Count(server->peer_list);
+		ArrayList_Unlock(server->peer_list);
+		PROXY_LOG_DBG(TAG, ps, "Removed peer, %" PRIuz " connected", count);
+	}
+
+	pf_server_peer_free(client);
 	free(args);
 	ExitThread(0);
 	return 0;
 }
 
+/* the peer is owned by the proxy once this returns TRUE, even if the connection failed */
 static BOOL pf_server_start_peer(freerdp_peer* client)
 {
 	HANDLE hThread = NULL;
 	proxyServer* server = NULL;
+
+	WINPR_ASSERT(client);
+	server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+
+	if (server->reactor)
+	{
+		if (!pf_server_peer_init(client))
+		{
+			pf_server_peer_close(client, FALSE);
+			pf_server_peer_free(client);
+			return TRUE;
+		}
+
+		if (!freerdp_peer_reactor_add(server->reactor, client, pf_server_peer_get_handles,
+		                              pf_server_peer_check, pf_server_peer_removed, NULL))
+		{
+			pf_server_peer_close(client, TRUE);
+			pf_server_peer_free(client);
+		}
+		return TRUE;
+	}
+
 	peer_thread_args* args = calloc(1, sizeof(peer_thread_args));
 	if (!args)
 		return FALSE;
 
-	WINPR_ASSERT(client);
 	args->client = client;
 
-	server = (proxyServer*)client->ContextExtra;
-	WINPR_ASSERT(server);
-
 	hThread = CreateThread(NULL, 0, pf_server_handle_peer, args, CREATE_SUSPENDED, NULL);
 	if (!hThread)
 		return FALSE;
@@ -942,6 +1097,15 @@ proxyServer* pf_server_new(const proxyConfig* config)
 		goto out;
 	}
 
+	server->metrics = pf_metrics_new();
+	if (!server->metrics)
+		goto out;
+	pf_modules_set_metrics(server->module, server->metrics);
+
+	server->targetCache = pf_target_cache_new(server->config->TargetCacheTTL);
+	if (!server->targetCache)
+		goto out;
+
 	pf_modules_list_loaded_plugins(server->module);
 	if (!are_all_required_modules_loaded(server->module, server->config))
 		goto out;
@@ -963,6 +1127,13 @@ proxyServer* pf_server_new(const proxyConfig* config)
 
 	obj->fnObjectFree = peer_free;
 
+	if (server->config->Workers > 0)
+	{
+		server->reactor = freerdp_peer_reactor_new(server->config->Workers, 1000);
+		if (!server->reactor)
+			goto out;
+	}
+
 	server->listener->info = server;
 	server->listener->PeerAccepted = pf_server_peer_accepted;
 
@@ -992,6 +1163,9 @@ BOOL pf_server_run(proxyServer* server)
 	listener = server->listener;
 	WINPR_ASSERT(listener);
 
+	if (!pf_metrics_start(server->metrics, server->config))
+		return FALSE;
+
 	while (1)
 	{
 		WINPR_ASSERT(listener->GetEventHandles);
@@ -1031,6 +1205,7 @@ BOOL pf_server_run(proxyServer* server)
 
 	WINPR_ASSERT(listener->Close);
 	listener->Close(listener);
+	pf_metrics_stop(server->metrics);
 	return rc;
 }
 
@@ -1066,6 +1241,7 @@ void pf_server_free(proxyServer* server)
 		}
 	}
 	ArrayList_Free(server->peer_list);
+	freerdp_peer_reactor_free(server->reactor);
 	freerdp_listener_free(server->listener);
 
 	if (server->stopEvent)
@@ -1073,6 +1249,8 @@ void pf_server_free(proxyServer* server)
 
 	pf_server_config_free(server->config);
 	pf_modules_free(server->module);
+	pf_metrics_free(server->metrics);
+	pf_target_cache_free(server->targetCache);
 	free(server);
 
 #if defined(WITH_DEBUG_EVENTS)
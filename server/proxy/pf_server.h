@@ -26,9 +26,12 @@
 
 #include <winpr/collections.h>
 #include <freerdp/listener.h>
+#include <freerdp/peer.h>
 
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
+#include "pf_metrics.h"
+#include "pf_target_cache.h"
 
 struct proxy_server
 {
@@ -38,6 +41,9 @@ struct proxy_server
 	freerdp_listener* listener;
 	HANDLE stopEvent; /* an event used to signal the main thread to stop */
 	wArrayList* peer_list;
+	rdpPeerReactor* reactor; /* serves the peers if configured, instead of a thread per peer */
+	proxyMetrics* metrics;
+	proxyTargetCache* targetCache; /* shared by the client connections of all peers */
 };
 
 #endif /* INT_FREERDP_SERVER_PROXY_SERVER_H */
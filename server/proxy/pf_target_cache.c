@@ -0,0 +1,340 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server target cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/string.h>
+#include <winpr/sysinfo.h>
+#include <winpr/winsock.h>
+#include <winpr/collections.h>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
+
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_target_cache.h"
+
+#define TAG PROXY_TAG("target.cache")
+
+/* a proxy serves a limited set of targets, anything beyond is not cached */
+#define PF_TARGET_CACHE_MAX 1024
+
+typedef struct
+{
+	char* address;
+	UINT64 addressExpires;
+	char* pem;
+	size_t pemLength;
+	UINT64 pemExpires;
+} pfTargetCacheEntry;
+
+struct proxy_target_cache
+{
+	UINT64 ttl; /* in milliseconds */
+	wHashTable* entries;
+};
+
+static void pf_target_cache_entry_free(void* obj)
+{
+	pfTargetCacheEntry* entry = obj;
+	if (!entry)
+		return;
+
+	free(entry->address);
+	free(entry->pem);
+	free(entry);
+}
+
+static char* pf_target_cache_key(const char* hostname, UINT16 port)
+{
+	WINPR_ASSERT(hostname);
+
+	char* key = NULL;
+	size_t len = 0;
+	(void)winpr_asprintf(&key, &len, "%s:%" PRIu16, hostname, port);
+	return key;
+}
+
+typedef struct
+{
+	wHashTable* entries;
+	UINT64 now;
+} pfTargetCachePurge;
+
+static BOOL pf_target_cache_purge_cb(const void* key, void* value, void* arg)
+{
+	const pfTargetCacheEntry* entry = value;
+	pfTargetCachePurge* purge = arg;
+
+	WINPR_ASSERT(entry);
+	WINPR_ASSERT(purge);
+
+	/* removing is deferred until the iteration is done */
+	if ((entry->addressExpires <= purge->now) && (entry->pemExpires <= purge->now))
+		(void)HashTable_Remove(purge->entries, key);
+	return TRUE;
+}
+
+/* must be called with the table locked */
+static pfTargetCacheEntry* pf_target_cache_entry(proxyTargetCache* cache, const char* key,
+                                                 UINT64 now)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(key);
+
+	pfTargetCacheEntry* entry = HashTable_GetItemValue(cache->entries, key);
+	if (entry)
+		return entry;
+
+	if (HashTable_Count(cache->entries) >= PF_TARGET_CACHE_MAX)
+	{
+		pfTargetCachePurge purge = { cache->entries, now };
+		(void)HashTable_Foreach(cache->entries, pf_target_cache_purge_cb, &purge);
+
+		if (HashTable_Count(cache->entries) >= PF_TARGET_CACHE_MAX)
+			return NULL;
+	}
+
+	entry = calloc(1, sizeof(pfTargetCacheEntry));
+	if (!entry)
+		return NULL;
+
+	if (!HashTable_Insert(cache->entries, key, entry))
+	{
+		pf_target_cache_entry_free(entry);
+		return NULL;
+	}
+	return entry;
+}
+
+static BOOL pf_target_cache_is_numeric(const char* hostname)
+{
+	struct addrinfo hints = { 0 };
+	struct addrinfo* result = NULL;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_flags = AI_NUMERICHOST;
+	if (getaddrinfo(hostname, NULL, &hints, &result) != 0)
+		return FALSE;
+
+	freeaddrinfo(result);
+	return TRUE;
+}
+
+static char* pf_target_cache_lookup_address(const char* hostname, UINT16 port)
+{
+	char service[8] = { 0 };
+	char address[NI_MAXHOST] = { 0 };
+	struct addrinfo hints = { 0 };
+	struct addrinfo* result = NULL;
+
+	(void)_snprintf(service, sizeof(service), "%" PRIu16, port);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(hostname, service, &hints, &result) != 0)
+		return NULL;
+
+	const int rc = getnameinfo(result->ai_addr, (socklen_t)result->ai_addrlen, address,
+	                           sizeof(address), NULL, 0, NI_NUMERICHOST);
+	freeaddrinfo(result);
+	if (rc != 0)
+		return NULL;
+
+	return _strdup(address);
+}
+
+char* pf_target_cache_resolve(proxyTargetCache* cache, const char* hostname, UINT16 port)
+{
+	WINPR_ASSERT(hostname);
+
+	if (!cache || (cache->ttl == 0) || pf_target_cache_is_numeric(hostname))
+		return NULL;
+
+	char* key = pf_target_cache_key(hostname, port);
+	if (!key)
+		return NULL;
+
+	char* address = NULL;
+	UINT64 now = winpr_GetTickCount64();
+
+	HashTable_Lock(cache->entries);
+	const pfTargetCacheEntry* cached = HashTable_GetItemValue(cache->entries, key);
+	if (cached && cached->address && (cached->addressExpires > now))
+		address = _strdup(cached->address);
+	HashTable_Unlock(cache->entries);
+
+	if (address)
+	{
+		free(key);
+		return address;
+	}
+
+	/* resolve without holding the lock, other sessions may use the cache meanwhile */
+	address = pf_target_cache_lookup_address(hostname, port);
+	if (!address)
+	{
+		free(key);
+		return NULL;
+	}
+
+	now = winpr_GetTickCount64();
+	HashTable_Lock(cache->entries);
+	pfTargetCacheEntry* entry = pf_target_cache_entry(cache, key, now);
+	if (entry)
+	{
+		char* copy = _strdup(address);
+		if (copy)
+		{
+			free(entry->address);
+			entry->address = copy;
+			entry->addressExpires = now + cache->ttl;
+		}
+	}
+	HashTable_Unlock(cache->entries);
+
+	WLog_DBG(TAG, "resolved %s to %s", key, address);
+	free(key);
+	return address;
+}
+
+char* pf_target_cache_get_certificate(proxyTargetCache* cache, const char* hostname, UINT16 port,
+                                      size_t* plength)
+{
+	WINPR_ASSERT(hostname);
+	WINPR_ASSERT(plength);
+
+	*plength = 0;
+	if (!cache || (cache->ttl == 0))
+		return NULL;
+
+	char* key = pf_target_cache_key(hostname, port);
+	if (!key)
+		return NULL;
+
+	char* pem = NULL;
+	const UINT64 now = winpr_GetTickCount64();
+
+	HashTable_Lock(cache->entries);
+	const pfTargetCacheEntry* entry = HashTable_GetItemValue(cache->entries, key);
+	if (entry && entry->pem && (entry->pemExpires > now))
+	{
+		pem = malloc(entry->pemLength + 1);
+		if (pem)
+		{
+			memcpy(pem, entry->pem, entry->pemLength);
+			pem[entry->pemLength] = '\0';
+			*plength = entry->pemLength;
+		}
+	}
+	HashTable_Unlock(cache->entries);
+
+	free(key);
+	return pem;
+}
+
+BOOL pf_target_cache_set_certificate(proxyTargetCache* cache, const char* hostname, UINT16 port,
+                                     const char* pem, size_t length)
+{
+	WINPR_ASSERT(hostname);
+	WINPR_ASSERT(pem || (length == 0));
+
+	if (!cache || (cache->ttl == 0) || (length == 0))
+		return TRUE;
+
+	char* key = pf_target_cache_key(hostname, port);
+	if (!key)
+		return FALSE;
+
+	char* copy = malloc(length + 1);
+	if (!copy)
+	{
+		free(key);
+		return FALSE;
+	}
+	memcpy(copy, pem, length);
+	copy[length] = '\0';
+
+	const UINT64 now = winpr_GetTickCount64();
+	HashTable_Lock(cache->entries);
+	pfTargetCacheEntry* entry = pf_target_cache_entry(cache, key, now);
+	if (entry)
+	{
+		free(entry->pem);
+		entry->pem = copy;
+		entry->pemLength = length;
+		entry->pemExpires = now + cache->ttl;
+		copy = NULL;
+	}
+	HashTable_Unlock(cache->entries);
+
+	free(copy);
+	free(key);
+	return entry != NULL;
+}
+
+void pf_target_cache_remove(proxyTargetCache* cache, const char* hostname, UINT16 port)
+{
+	WINPR_ASSERT(hostname);
+
+	if (!cache || (cache->ttl == 0))
+		return;
+
+	char* key = pf_target_cache_key(hostname, port);
+	if (!key)
+		return;
+
+	(void)HashTable_Remove(cache->entries, key);
+	free(key);
+}
+
+proxyTargetCache* pf_target_cache_new(UINT32 ttl)
+{
+	proxyTargetCache* cache = calloc(1, sizeof(proxyTargetCache));
+	if (!cache)
+		return NULL;
+
+	cache->ttl = 1000ull * ttl;
+	cache->entries = HashTable_New(TRUE);
+	if (!cache->entries)
+		goto fail;
+
+	if (!HashTable_SetupForStringData(cache->entries, FALSE))
+		goto fail;
+
+	wObject* obj = HashTable_ValueObject(cache->entries);
+	WINPR_ASSERT(obj);
+	obj->fnObjectFree = pf_target_cache_entry_free;
+	return cache;
+
+fail:
+	pf_target_cache_free(cache);
+	return NULL;
+}
+
+void pf_target_cache_free(proxyTargetCache* cache)
+{
+	if (!cache)
+		return;
+
+	HashTable_Free(cache->entries);
+	free(cache);
+}
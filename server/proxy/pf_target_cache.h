@@ -0,0 +1,46 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server target cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INT_FREERDP_SERVER_PROXY_TARGET_CACHE_H
+#define INT_FREERDP_SERVER_PROXY_TARGET_CACHE_H
+
+#include <winpr/wtypes.h>
+
+/* resolved addresses and accepted certificates of the targets, shared by all sessions */
+typedef struct proxy_target_cache proxyTargetCache;
+
+/* entries expire after `ttl` seconds, 0 disables the cache */
+proxyTargetCache* pf_target_cache_new(UINT32 ttl);
+void pf_target_cache_free(proxyTargetCache* cache);
+
+/**
+ * @brief pf_target_cache_resolve Looks up the address of a target, resolving it if not cached.
+ * @return A numeric address to connect to (to be freed by the caller), NULL if the hostname
+ *         is numeric already, can not be resolved or the cache is disabled.
+ */
+char* pf_target_cache_resolve(proxyTargetCache* cache, const char* hostname, UINT16 port);
+
+/* returns a copy of the PEM certificate accepted for the target, NULL if none is cached */
+char* pf_target_cache_get_certificate(proxyTargetCache* cache, const char* hostname, UINT16 port,
+                                      size_t* plength);
+BOOL pf_target_cache_set_certificate(proxyTargetCache* cache, const char* hostname, UINT16 port,
+                                     const char* pem, size_t length);
+
+/* forgets everything about a target, e.g. after a failed connection attempt */
+void pf_target_cache_remove(proxyTargetCache* cache, const char* hostname, UINT16 port);
+
+#endif /* INT_FREERDP_SERVER_PROXY_TARGET_CACHE_H */
@@ -587,6 +587,40 @@ static BOOL pf_client_non_monitored_desktop(rdpContext* context, const WINDOW_OR
 	return rc;
 }
 
+/* Relays the updates the proxy would otherwise parse and re-encode unchanged */
+static BOOL pf_client_fastpath_update(rdpContext* context, BYTE updateCode, wStream* s,
+                                      BOOL* handled)
+{
+	pClientContext* pc = (pClientContext*)context;
+	proxyData* pdata = NULL;
+	rdpContext* ps = NULL;
+	WINPR_ASSERT(pc);
+	pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+	ps = (rdpContext*)pdata->ps;
+	WINPR_ASSERT(ps);
+	WINPR_ASSERT(ps->update);
+	WINPR_ASSERT(ps->update->FastPathUpdate);
+
+	switch (updateCode)
+	{
+		case FASTPATH_UPDATETYPE_BITMAP:
+		case FASTPATH_UPDATETYPE_PTR_NULL:
+		case FASTPATH_UPDATETYPE_PTR_DEFAULT:
+		case FASTPATH_UPDATETYPE_PTR_POSITION:
+		case FASTPATH_UPDATETYPE_COLOR:
+		case FASTPATH_UPDATETYPE_CACHED:
+		case FASTPATH_UPDATETYPE_POINTER:
+		case FASTPATH_UPDATETYPE_LARGE_POINTER:
+			break;
+
+		default:
+			return TRUE;
+	}
+
+	return ps->update->FastPathUpdate(ps, updateCode, s, handled);
+}
+
 void pf_server_register_update_callbacks(rdpUpdate* update)
 {
 	WINPR_ASSERT(update);
@@ -627,3 +661,9 @@ void pf_client_register_update_callbacks(rdpUpdate* update)
 	update->pointer->PointerNew = pf_client_send_pointer_new;
 	update->pointer->PointerCached = pf_client_send_pointer_cached;
 }
+
+void pf_client_register_passthrough_callbacks(rdpUpdate* update)
+{
+	WINPR_ASSERT(update);
+	update->FastPathUpdate = pf_client_fastpath_update;
+}
@@ -26,6 +26,8 @@
 
 #include <freerdp/server/proxy/proxy_modules_api.h>
 
+#include "pf_metrics.h"
+
 typedef enum
 {
 	FILTER_TYPE_KEYBOARD,                              /* proxyKeyboardEventInfo */
@@ -86,6 +88,9 @@ extern "C"
 	BOOL pf_modules_is_plugin_loaded(proxyModule* module, const char* plugin_name);
 	void pf_modules_list_loaded_plugins(proxyModule* module);
 
+	/* measures the run time of every plugin's hooks and filters into `metrics` */
+	void pf_modules_set_metrics(proxyModule* module, proxyMetrics* metrics);
+
 	BOOL pf_modules_run_filter(proxyModule* module, PF_FILTER_TYPE type, proxyData* pdata,
 	                           void* param);
 	BOOL pf_modules_run_hook(proxyModule* module, PF_HOOK_TYPE type, proxyData* pdata,
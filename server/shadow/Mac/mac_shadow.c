@@ -413,19 +413,11 @@ static void (^mac_capture_stream_handler)(
 
 	  IOSurfaceUnlock(frameSurface, kIOSurfaceLockReadOnly, NULL);
 	  ArrayList_Lock(server->clients);
-	  count = ArrayList_Count(server->clients);
 	  shadow_subsystem_frame_update(&subsystem->common);
 
-	  if (count == 1)
-	  {
-		  rdpShadowClient* client;
-		  client = (rdpShadowClient*)ArrayList_GetItem(server->clients, 0);
-
-		  if (client)
-		  {
-			  subsystem->common.captureFrameRate = shadow_encoder_preferred_fps(client->encoder);
-		  }
-	  }
+	  const UINT32 fps = shadow_subsystem_preferred_fps(&subsystem->common);
+	  if (fps > 0)
+		  subsystem->common.captureFrameRate = fps;
 
 	  ArrayList_Unlock(server->clients);
 	  EnterCriticalSection(&(surface->lock));
@@ -0,0 +1,424 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include <winpr/assert.h>
+#include <winpr/thread.h>
+
+#include <freerdp/log.h>
+
+#include "pw_portal.h"
+
+#define TAG SERVER_TAG("shadow.pipewire")
+
+#define PORTAL_BUS_NAME "org.freedesktop.portal.Desktop"
+#define PORTAL_OBJECT_PATH "/org/freedesktop/portal/desktop"
+#define PORTAL_SCREENCAST "org.freedesktop.portal.ScreenCast"
+#define PORTAL_REQUEST "org.freedesktop.portal.Request"
+#define PORTAL_SESSION "org.freedesktop.portal.Session"
+
+#define PORTAL_SOURCE_MONITOR 1
+#define PORTAL_CURSOR_EMBEDDED 2
+
+struct pw_shadow_portal
+{
+	GDBusConnection* connection;
+	GMainContext* context;
+	char* sender;
+	char* session;
+	UINT32 tokens;
+
+	UINT32 node;
+	BOOL hasSize;
+	UINT32 width;
+	UINT32 height;
+	int fd;
+};
+
+typedef struct
+{
+	GMainLoop* loop;
+	guint32 response;
+	GVariant* results;
+} pwPortalResponse;
+
+static char* pw_portal_new_token(pwShadowPortal* portal)
+{
+	return g_strdup_printf("freerdp_shadow_%" PRIu32 "_%" PRIu32, GetCurrentProcessId(),
+	                       ++portal->tokens);
+}
+
+static void pw_portal_on_response(WINPR_ATTR_UNUSED GDBusConnection* connection,
+                                  WINPR_ATTR_UNUSED const gchar* sender_name,
+                                  WINPR_ATTR_UNUSED const gchar* object_path,
+                                  WINPR_ATTR_UNUSED const gchar* interface_name,
+                                  WINPR_ATTR_UNUSED const gchar* signal_name,
+                                  GVariant* parameters, gpointer user_data)
+{
+	pwPortalResponse* response = (pwPortalResponse*)user_data;
+	WINPR_ASSERT(response);
+
+	if (!response->results)
+		g_variant_get(parameters, "(u@a{sv})", &response->response, &response->results);
+
+	g_main_loop_quit(response->loop);
+}
+
+static guint pw_portal_subscribe(pwShadowPortal* portal, const char* path,
+                                 pwPortalResponse* response)
+{
+	return g_dbus_connection_signal_subscribe(
+	    portal->connection, PORTAL_BUS_NAME, PORTAL_REQUEST, "Response", path, NULL,
+	    G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE, pw_portal_on_response, response, NULL);
+}
+
+/* Portal methods answer with a Request object that emits the actual result later on. The
+ * subscription has to be in place before the call, so it goes to the predicted request path. */
+static GVariant* pw_portal_request(pwShadowPortal* portal, const char* method, const char* token,
+                                   GVariant* parameters)
+{
+	GError* error = NULL;
+	GVariant* results = NULL;
+	pwPortalResponse response = { 0 };
+	char* path =
+	    g_strdup_printf(PORTAL_OBJECT_PATH "/request/%s/%s", portal->sender, token);
+
+	response.loop = g_main_loop_new(portal->context, FALSE);
+	guint subscription = pw_portal_subscribe(portal, path, &response);
+
+	GVariant* reply = g_dbus_connection_call_sync(
+	    portal->connection, PORTAL_BUS_NAME, PORTAL_OBJECT_PATH, PORTAL_SCREENCAST, method,
+	    parameters, G_VARIANT_TYPE("(o)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+
+	if (!reply)
+	{
+		WLog_ERR(TAG, "%s failed: %s", method, error->message);
+		g_error_free(error);
+		goto fail;
+	}
+
+	const char* handle = NULL;
+	g_variant_get(reply, "(&o)", &handle);
+
+	/* portals before 0.9 do not use the predicted path */
+	if (strcmp(handle, path) != 0)
+	{
+		g_dbus_connection_signal_unsubscribe(portal->connection, subscription);
+		subscription = pw_portal_subscribe(portal, handle, &response);
+	}
+
+	g_variant_unref(reply);
+
+	if (!response.results)
+		g_main_loop_run(response.loop);
+
+	if (response.response != 0)
+	{
+		WLog_ERR(TAG, "%s was %s", method, (response.response == 1) ? "cancelled" : "denied");
+		goto fail;
+	}
+
+	results = response.results;
+	response.results = NULL;
+fail:
+	g_dbus_connection_signal_unsubscribe(portal->connection, subscription);
+	if (response.results)
+		g_variant_unref(response.results);
+	g_main_loop_unref(response.loop);
+	g_free(path);
+	return results;
+}
+
+static UINT32 pw_portal_get_cursor_modes(pwShadowPortal* portal)
+{
+	UINT32 modes = 0;
+	GVariant* reply = g_dbus_connection_call_sync(
+	    portal->connection, PORTAL_BUS_NAME, PORTAL_OBJECT_PATH,
+	    "org.freedesktop.DBus.Properties", "Get",
+	    g_variant_new("(ss)", PORTAL_SCREENCAST, "AvailableCursorModes"), G_VARIANT_TYPE("(v)"),
+	    G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+
+	if (reply)
+	{
+		GVariant* value = NULL;
+		g_variant_get(reply, "(v)", &value);
+
+		if (g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32))
+			modes = g_variant_get_uint32(value);
+
+		g_variant_unref(value);
+		g_variant_unref(reply);
+	}
+
+	return modes;
+}
+
+static BOOL pw_portal_create_session(pwShadowPortal* portal)
+{
+	GVariantBuilder options;
+	char* token = pw_portal_new_token(portal);
+	char* sessionToken = pw_portal_new_token(portal);
+
+	g_variant_builder_init(&options, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&options, "{sv}", "handle_token", g_variant_new_string(token));
+	g_variant_builder_add(&options, "{sv}", "session_handle_token",
+	                      g_variant_new_string(sessionToken));
+
+	GVariant* results =
+	    pw_portal_request(portal, "CreateSession", token, g_variant_new("(a{sv})", &options));
+	g_free(sessionToken);
+	g_free(token);
+
+	if (!results)
+		return FALSE;
+
+	/* the specification says 's', some implementations send 'o' */
+	GVariant* handle = g_variant_lookup_value(results, "session_handle", NULL);
+
+	if (handle && (g_variant_is_of_type(handle, G_VARIANT_TYPE_STRING) ||
+	               g_variant_is_of_type(handle, G_VARIANT_TYPE_OBJECT_PATH)))
+		portal->session = g_variant_dup_string(handle, NULL);
+
+	if (handle)
+		g_variant_unref(handle);
+
+	g_variant_unref(results);
+	return portal->session != NULL;
+}
+
+static BOOL pw_portal_select_sources(pwShadowPortal* portal)
+{
+	GVariantBuilder options;
+	char* token = pw_portal_new_token(portal);
+
+	g_variant_builder_init(&options, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&options, "{sv}", "handle_token", g_variant_new_string(token));
+	g_variant_builder_add(&options, "{sv}", "types", g_variant_new_uint32(PORTAL_SOURCE_MONITOR));
+	g_variant_builder_add(&options, "{sv}", "multiple", g_variant_new_boolean(FALSE));
+
+	if (pw_portal_get_cursor_modes(portal) & PORTAL_CURSOR_EMBEDDED)
+		g_variant_builder_add(&options, "{sv}", "cursor_mode",
+		                      g_variant_new_uint32(PORTAL_CURSOR_EMBEDDED));
+
+	GVariant* results =
+	    pw_portal_request(portal, "SelectSources", token,
+	                      g_variant_new("(oa{sv})", portal->session, &options));
+	g_free(token);
+
+	if (!results)
+		return FALSE;
+
+	g_variant_unref(results);
+	return TRUE;
+}
+
+static BOOL pw_portal_start(pwShadowPortal* portal)
+{
+	BOOL rc = FALSE;
+	GVariantBuilder options;
+	GVariantIter* streams = NULL;
+	char* token = pw_portal_new_token(portal);
+
+	g_variant_builder_init(&options, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&options, "{sv}", "handle_token", g_variant_new_string(token));
+
+	GVariant* results = pw_portal_request(
+	    portal, "Start", token, g_variant_new("(osa{sv})", portal->session, "", &options));
+	g_free(token);
+
+	if (!results)
+		return FALSE;
+
+	if (g_variant_lookup(results, "streams", "a(ua{sv})", &streams))
+	{
+		guint32 node = 0;
+		GVariant* properties = NULL;
+
+		if (g_variant_iter_next(streams, "(u@a{sv})", &node, &properties))
+		{
+			gint32 width = 0;
+			gint32 height = 0;
+
+			portal->node = node;
+
+			if (g_variant_lookup(properties, "size", "(ii)", &width, &height) && (width > 0) &&
+			    (height > 0))
+			{
+				portal->width = (UINT32)width;
+				portal->height = (UINT32)height;
+				portal->hasSize = TRUE;
+			}
+
+			g_variant_unref(properties);
+			rc = TRUE;
+		}
+
+		g_variant_iter_free(streams);
+	}
+
+	if (!rc)
+		WLog_ERR(TAG, "the screen cast portal did not provide a stream");
+
+	g_variant_unref(results);
+	return rc;
+}
+
+static BOOL pw_portal_open_remote(pwShadowPortal* portal)
+{
+	GError* error = NULL;
+	GUnixFDList* fds = NULL;
+	gint32 index = -1;
+
+	GVariant* reply = g_dbus_connection_call_with_unix_fd_list_sync(
+	    portal->connection, PORTAL_BUS_NAME, PORTAL_OBJECT_PATH, PORTAL_SCREENCAST,
+	    "OpenPipeWireRemote", g_variant_new("(oa{sv})", portal->session, NULL),
+	    G_VARIANT_TYPE("(h)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &fds, NULL, &error);
+
+	if (!reply)
+	{
+		WLog_ERR(TAG, "OpenPipeWireRemote failed: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	g_variant_get(reply, "(h)", &index);
+	g_variant_unref(reply);
+
+	portal->fd = g_unix_fd_list_get(fds, index, &error);
+	g_object_unref(fds);
+
+	if (portal->fd < 0)
+	{
+		WLog_ERR(TAG, "OpenPipeWireRemote returned no file descriptor: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL pw_shadow_portal_open(pwShadowPortal* portal)
+{
+	GError* error = NULL;
+
+	WINPR_ASSERT(portal);
+
+	portal->connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+
+	if (!portal->connection)
+	{
+		WLog_ERR(TAG, "failed to connect to the session bus: %s", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	/* request paths use the unique name without the leading ':' and '.' replaced by '_' */
+	portal->sender = g_strdup(g_dbus_connection_get_unique_name(portal->connection) + 1);
+	g_strdelimit(portal->sender, ".", '_');
+
+	g_main_context_push_thread_default(portal->context);
+	const BOOL rc = pw_portal_create_session(portal) && pw_portal_select_sources(portal) &&
+	                pw_portal_start(portal) && pw_portal_open_remote(portal);
+	g_main_context_pop_thread_default(portal->context);
+
+	if (rc)
+		WLog_INFO(TAG, "screen cast session %s uses node %" PRIu32, portal->session,
+		          portal->node);
+
+	return rc;
+}
+
+UINT32 pw_shadow_portal_get_node(const pwShadowPortal* portal)
+{
+	WINPR_ASSERT(portal);
+	return portal->node;
+}
+
+BOOL pw_shadow_portal_get_size(const pwShadowPortal* portal, UINT32* width, UINT32* height)
+{
+	WINPR_ASSERT(portal);
+	WINPR_ASSERT(width);
+	WINPR_ASSERT(height);
+
+	if (!portal->hasSize)
+		return FALSE;
+
+	*width = portal->width;
+	*height = portal->height;
+	return TRUE;
+}
+
+int pw_shadow_portal_take_fd(pwShadowPortal* portal)
+{
+	WINPR_ASSERT(portal);
+
+	const int fd = portal->fd;
+	portal->fd = -1;
+	return fd;
+}
+
+void pw_shadow_portal_free(pwShadowPortal* portal)
+{
+	if (!portal)
+		return;
+
+	if (portal->connection && portal->session)
+	{
+		GVariant* reply = g_dbus_connection_call_sync(
+		    portal->connection, PORTAL_BUS_NAME, portal->session, PORTAL_SESSION, "Close", NULL,
+		    NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+
+		if (reply)
+			g_variant_unref(reply);
+	}
+
+	if (portal->fd >= 0)
+		close(portal->fd);
+
+	g_free(portal->session);
+	g_free(portal->sender);
+
+	if (portal->connection)
+		g_object_unref(portal->connection);
+
+	if (portal->context)
+		g_main_context_unref(portal->context);
+
+	free(portal);
+}
+
+pwShadowPortal* pw_shadow_portal_new(void)
+{
+	pwShadowPortal* portal = (pwShadowPortal*)calloc(1, sizeof(pwShadowPortal));
+
+	if (!portal)
+		return NULL;
+
+	portal->fd = -1;
+	portal->context = g_main_context_new();
+
+	if (!portal->context)
+	{
+		pw_shadow_portal_free(portal);
+		return NULL;
+	}
+
+	return portal;
+}
@@ -0,0 +1,51 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_PIPEWIRE_PORTAL_H
+#define FREERDP_SERVER_SHADOW_PIPEWIRE_PORTAL_H
+
+#include <winpr/wtypes.h>
+
+typedef struct pw_shadow_portal pwShadowPortal;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** Start a xdg-desktop-portal ScreenCast session of one monitor. This blocks until the user
+	 *  picked the monitor in the portal dialog. */
+	BOOL pw_shadow_portal_open(pwShadowPortal* portal);
+
+	/** The PipeWire node of the screen cast stream */
+	UINT32 pw_shadow_portal_get_node(const pwShadowPortal* portal);
+
+	/** The size of the monitor as announced by the portal, \b FALSE if unknown */
+	BOOL pw_shadow_portal_get_size(const pwShadowPortal* portal, UINT32* width, UINT32* height);
+
+	/** A connection to the PipeWire daemon restricted to the stream, the caller owns it */
+	int pw_shadow_portal_take_fd(pwShadowPortal* portal);
+
+	void pw_shadow_portal_free(pwShadowPortal* portal);
+
+	WINPR_ATTR_MALLOC(pw_shadow_portal_free, 1)
+	pwShadowPortal* pw_shadow_portal_new(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_PIPEWIRE_PORTAL_H */
@@ -0,0 +1,831 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <linux/dma-buf.h>
+
+#include <spa/buffer/meta.h>
+#include <spa/param/video/type-info.h>
+#include <spa/utils/result.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/region.h>
+
+#include "pw_shadow.h"
+
+#define TAG SERVER_TAG("shadow.pipewire")
+
+#ifndef DRM_FORMAT_MOD_LINEAR
+#define DRM_FORMAT_MOD_LINEAR 0
+#endif
+
+#define PW_SHADOW_DAMAGE_REGIONS 16
+#define PW_SHADOW_FORMAT_TIMEOUT 5000
+
+typedef struct
+{
+	void* data;
+	size_t size;
+} pwShadowMapping;
+
+static DWORD pw_shadow_map_format(enum spa_video_format format)
+{
+	switch (format)
+	{
+		case SPA_VIDEO_FORMAT_BGRx:
+			return PIXEL_FORMAT_BGRX32;
+		case SPA_VIDEO_FORMAT_BGRA:
+			return PIXEL_FORMAT_BGRA32;
+		case SPA_VIDEO_FORMAT_RGBx:
+			return PIXEL_FORMAT_RGBX32;
+		case SPA_VIDEO_FORMAT_RGBA:
+			return PIXEL_FORMAT_RGBA32;
+		default:
+			return 0;
+	}
+}
+
+static void pw_shadow_set_monitor(pwShadowSubsystem* subsystem, UINT32 width, UINT32 height)
+{
+	MONITOR_DEF* monitor = &(subsystem->common.monitors[0]);
+	MONITOR_DEF* virtualScreen = &(subsystem->common.virtualScreen);
+
+	WINPR_ASSERT(width > 0);
+	WINPR_ASSERT(height > 0);
+
+	/* the portal picks the monitor, the stream always starts at the origin */
+	monitor->left = 0;
+	monitor->top = 0;
+	monitor->right = (INT32)width - 1;
+	monitor->bottom = (INT32)height - 1;
+	monitor->flags = 1;
+	subsystem->common.numMonitors = 1;
+
+	*virtualScreen = *monitor;
+}
+
+static void pw_shadow_dmabuf_sync(int fd, UINT64 flags)
+{
+	struct dma_buf_sync sync = { 0 };
+	sync.flags = flags | DMA_BUF_SYNC_READ;
+
+	while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+	{
+		if ((errno != EINTR) && (errno != EAGAIN))
+			break;
+	}
+}
+
+/* Compare one damaged rectangle of the frame with the surface, copy the changed tiles and
+ * remember them for the next frame update. Called with the surface lock held. */
+static BOOL pw_shadow_capture_rect(pwShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                   const BYTE* data, UINT32 step, const RECTANGLE_16* rect)
+{
+	const UINT32 width = 1u * rect->right - rect->left;
+	const UINT32 height = 1u * rect->bottom - rect->top;
+	const size_t count = ((width + 15ull) / 16) * ((height + 15ull) / 16);
+	const size_t surfaceOffset = 1ull * surface->scanline * rect->top +
+	                             1ull * FreeRDPGetBytesPerPixel(surface->format) * rect->left;
+	const size_t dataOffset = 1ull * step * rect->top + 4ull * rect->left;
+	BYTE* tiles = calloc(count, sizeof(BYTE));
+
+	if (!tiles)
+		return FALSE;
+
+	BOOL rc = TRUE;
+	const int status = shadow_capture_compare_tiles(
+	    &surface->data[surfaceOffset], surface->format, surface->scanline, width, height,
+	    &data[dataOffset], subsystem->format, step, tiles, count);
+
+	if (status > 0)
+	{
+		REGION16 region = { 0 };
+		UINT32 numRects = 0;
+		region16_init(&region);
+
+		rc = FALSE;
+		if (shadow_capture_tiles_to_region(tiles, width, height, rect->left, rect->top, &region))
+		{
+			const RECTANGLE_16* rects = region16_rects(&region, &numRects);
+			const RECTANGLE_16* changed = region16_extents(&region);
+
+			rc = region16_union_rects(&subsystem->damage, &subsystem->damage, rects, numRects) &&
+			     freerdp_image_copy_no_overlap(
+			         surface->data, surface->format, surface->scanline, changed->left,
+			         changed->top, 1u * changed->right - changed->left,
+			         1u * changed->bottom - changed->top, data, subsystem->format, step,
+			         changed->left, changed->top, NULL, FREERDP_FLIP_NONE);
+		}
+
+		region16_uninit(&region);
+	}
+
+	free(tiles);
+	return rc && (status >= 0);
+}
+
+static BOOL pw_shadow_capture_frame(pwShadowSubsystem* subsystem, struct spa_buffer* buffer,
+                                    const BYTE* data, UINT32 step, BOOL full)
+{
+	BOOL rc = TRUE;
+	BOOL changed = FALSE;
+	rdpShadowSurface* surface = subsystem->common.server->surface;
+	const RECTANGLE_16 frame = { 0, 0, (UINT16)subsystem->width, (UINT16)subsystem->height };
+
+	EnterCriticalSection(&surface->lock);
+
+	/* frames racing a resize are dropped, the first one after it is taken completely */
+	if ((surface->width != subsystem->width) || (surface->height != subsystem->height))
+	{
+		subsystem->refresh = TRUE;
+		LeaveCriticalSection(&surface->lock);
+		return TRUE;
+	}
+
+	struct spa_meta* meta = spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+
+	if (full || subsystem->refresh || !meta)
+	{
+		changed = TRUE;
+		rc = pw_shadow_capture_rect(subsystem, surface, data, step, &frame);
+	}
+	else
+	{
+		struct spa_meta_region* r = NULL;
+
+		spa_meta_for_each(r, meta)
+		{
+			RECTANGLE_16 rect = { 0 };
+			RECTANGLE_16 clipped = { 0 };
+
+			if (!spa_meta_region_is_valid(r))
+				break;
+
+			if ((r->region.position.x < 0) || (r->region.position.y < 0))
+				continue;
+
+			rect.left = (UINT16)MIN(r->region.position.x, UINT16_MAX);
+			rect.top = (UINT16)MIN(r->region.position.y, UINT16_MAX);
+			rect.right = (UINT16)MIN(1ull * rect.left + r->region.size.width, UINT16_MAX);
+			rect.bottom = (UINT16)MIN(1ull * rect.top + r->region.size.height, UINT16_MAX);
+
+			if (!rectangles_intersection(&rect, &frame, &clipped))
+				continue;
+
+			changed = TRUE;
+			if (!pw_shadow_capture_rect(subsystem, surface, data, step, &clipped))
+			{
+				rc = FALSE;
+				break;
+			}
+		}
+	}
+
+	if (rc)
+		subsystem->refresh = FALSE;
+
+	if (changed)
+	{
+		surface->moveValid = FALSE;
+		surface->captureId++;
+	}
+
+	LeaveCriticalSection(&surface->lock);
+	return rc;
+}
+
+static void pw_shadow_consume_buffer(pwShadowSubsystem* subsystem, struct pw_buffer* pwbuf,
+                                     BOOL full)
+{
+	struct spa_buffer* buffer = pwbuf->buffer;
+	struct spa_data* d = &buffer->datas[0];
+	const struct spa_meta_header* header =
+	    spa_buffer_find_meta_data(buffer, SPA_META_Header, sizeof(*header));
+
+	if (header && (header->flags & SPA_META_HEADER_FLAG_CORRUPTED))
+		return;
+
+	/* an empty chunk only carries metadata, e.g. a cursor update */
+	if (!d->chunk || (d->chunk->size == 0) || (subsystem->format == 0))
+		return;
+
+	const UINT32 step =
+	    (d->chunk->stride > 0) ? (UINT32)d->chunk->stride : subsystem->width * 4u;
+
+	if ((1ull * d->chunk->offset + 1ull * step * subsystem->height) > d->maxsize)
+	{
+		WLog_WARN(TAG, "buffer too small for a %" PRIu32 "x%" PRIu32 " frame", subsystem->width,
+		          subsystem->height);
+		return;
+	}
+
+	const BYTE* data = NULL;
+	const BOOL dmabuf = (d->type == SPA_DATA_DmaBuf);
+
+	if (dmabuf)
+	{
+		const pwShadowMapping* mapping = (const pwShadowMapping*)pwbuf->user_data;
+
+		if (!mapping)
+			return;
+
+		pw_shadow_dmabuf_sync((int)d->fd, DMA_BUF_SYNC_START);
+		data = (const BYTE*)mapping->data + d->mapoffset;
+	}
+	else
+		data = (const BYTE*)d->data;
+
+	if (data && !pw_shadow_capture_frame(subsystem, buffer, &data[d->chunk->offset], step, full))
+		WLog_WARN(TAG, "failed to capture frame");
+
+	if (dmabuf)
+		pw_shadow_dmabuf_sync((int)d->fd, DMA_BUF_SYNC_END);
+}
+
+static void pw_shadow_on_process(void* data)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)data;
+	struct pw_buffer* pwbuf = NULL;
+	BOOL skipped = FALSE;
+
+	/* only the newest frame matters, the damage of skipped ones is unknown after that */
+	for (;;)
+	{
+		struct pw_buffer* next = pw_stream_dequeue_buffer(subsystem->stream);
+
+		if (!next)
+			break;
+
+		if (pwbuf)
+		{
+			pw_stream_queue_buffer(subsystem->stream, pwbuf);
+			skipped = TRUE;
+		}
+
+		pwbuf = next;
+	}
+
+	if (!pwbuf)
+		return;
+
+	if (subsystem->started)
+		pw_shadow_consume_buffer(subsystem, pwbuf, skipped);
+
+	pw_stream_queue_buffer(subsystem->stream, pwbuf);
+}
+
+static void pw_shadow_on_add_buffer(WINPR_ATTR_UNUSED void* data, struct pw_buffer* pwbuf)
+{
+	struct spa_data* d = &pwbuf->buffer->datas[0];
+
+	if (d->type != SPA_DATA_DmaBuf)
+		return;
+
+	/* map once and keep it, mapping a DMA-BUF for every frame is expensive */
+	const size_t size = 1ull * d->maxsize + d->mapoffset;
+	void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, (int)d->fd, 0);
+
+	if (map == MAP_FAILED)
+	{
+		WLog_ERR(TAG, "failed to map DMA-BUF: %s", strerror(errno));
+		return;
+	}
+
+	pwShadowMapping* mapping = (pwShadowMapping*)calloc(1, sizeof(pwShadowMapping));
+
+	if (!mapping)
+	{
+		munmap(map, size);
+		return;
+	}
+
+	mapping->data = map;
+	mapping->size = size;
+	pwbuf->user_data = mapping;
+}
+
+static void pw_shadow_on_remove_buffer(WINPR_ATTR_UNUSED void* data, struct pw_buffer* pwbuf)
+{
+	pwShadowMapping* mapping = (pwShadowMapping*)pwbuf->user_data;
+
+	if (!mapping)
+		return;
+
+	munmap(mapping->data, mapping->size);
+	free(mapping);
+	pwbuf->user_data = NULL;
+}
+
+static void pw_shadow_on_param_changed(void* data, uint32_t id, const struct spa_pod* param)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)data;
+	struct spa_video_info_raw info = { 0 };
+	uint32_t mediaType = 0;
+	uint32_t mediaSubtype = 0;
+
+	if (!param || (id != SPA_PARAM_Format))
+		return;
+
+	if ((spa_format_parse(param, &mediaType, &mediaSubtype) < 0) ||
+	    (mediaType != SPA_MEDIA_TYPE_video) || (mediaSubtype != SPA_MEDIA_SUBTYPE_raw) ||
+	    (spa_format_video_raw_parse(param, &info) < 0))
+		return;
+
+	const DWORD format = pw_shadow_map_format(info.format);
+
+	if ((format == 0) || (info.size.width == 0) || (info.size.height == 0) ||
+	    (info.size.width > UINT16_MAX) || (info.size.height > UINT16_MAX))
+	{
+		WLog_ERR(TAG, "unsupported stream format %" PRIu32 " %" PRIu32 "x%" PRIu32,
+		         (UINT32)info.format, info.size.width, info.size.height);
+		return;
+	}
+
+	subsystem->dmabuf = (info.flags & SPA_VIDEO_FLAG_MODIFIER) != 0;
+	subsystem->format = format;
+
+	if ((subsystem->width != info.size.width) || (subsystem->height != info.size.height))
+	{
+		subsystem->width = info.size.width;
+		subsystem->height = info.size.height;
+		subsystem->resizePending = TRUE;
+	}
+
+	WLog_INFO(TAG, "stream format %s %" PRIu32 "x%" PRIu32 "%s",
+	          FreeRDPGetColorFormatName(format), info.size.width, info.size.height,
+	          subsystem->dmabuf ? " (DMA-BUF)" : "");
+
+	uint8_t buffer[1024] = { 0 };
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod* params[3] = { 0 };
+	const int types = subsystem->dmabuf ? (1 << SPA_DATA_DmaBuf)
+	                                    : ((1 << SPA_DATA_MemFd) | (1 << SPA_DATA_MemPtr));
+
+	params[0] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers, SPA_PARAM_BUFFERS_buffers,
+	    SPA_POD_CHOICE_RANGE_Int(4, 2, 8), SPA_PARAM_BUFFERS_dataType,
+	    SPA_POD_CHOICE_FLAGS_Int(types));
+	params[1] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type,
+	    SPA_POD_Id(SPA_META_Header), SPA_PARAM_META_size,
+	    SPA_POD_Int(sizeof(struct spa_meta_header)));
+	params[2] = spa_pod_builder_add_object(
+	    &b, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type,
+	    SPA_POD_Id(SPA_META_VideoDamage), SPA_PARAM_META_size,
+	    SPA_POD_CHOICE_RANGE_Int(sizeof(struct spa_meta_region) * PW_SHADOW_DAMAGE_REGIONS,
+	                             sizeof(struct spa_meta_region),
+	                             sizeof(struct spa_meta_region) * PW_SHADOW_DAMAGE_REGIONS));
+
+	pw_stream_update_params(subsystem->stream, params, ARRAYSIZE(params));
+	(void)SetEvent(subsystem->formatEvent);
+}
+
+static void pw_shadow_on_state_changed(WINPR_ATTR_UNUSED void* data,
+                                       WINPR_ATTR_UNUSED enum pw_stream_state old,
+                                       enum pw_stream_state state, const char* error)
+{
+	if (state == PW_STREAM_STATE_ERROR)
+		WLog_ERR(TAG, "stream error: %s", error ? error : "unknown");
+	else
+		WLog_DBG(TAG, "stream %s", pw_stream_state_as_string(state));
+}
+
+static const struct pw_stream_events pw_shadow_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = pw_shadow_on_state_changed,
+	.param_changed = pw_shadow_on_param_changed,
+	.add_buffer = pw_shadow_on_add_buffer,
+	.remove_buffer = pw_shadow_on_remove_buffer,
+	.process = pw_shadow_on_process,
+};
+
+static const struct spa_pod* pw_shadow_build_format(struct spa_pod_builder* b, UINT32 width,
+                                                    UINT32 height, BOOL dmabuf)
+{
+	struct spa_pod_frame f = { 0 };
+	const struct spa_rectangle size = SPA_RECTANGLE(width, height);
+	const struct spa_rectangle minSize = SPA_RECTANGLE(1, 1);
+	const struct spa_rectangle maxSize = SPA_RECTANGLE(UINT16_MAX, UINT16_MAX);
+	const struct spa_fraction rate = SPA_FRACTION(30, 1);
+	const struct spa_fraction minRate = SPA_FRACTION(0, 1);
+	const struct spa_fraction maxRate = SPA_FRACTION(144, 1);
+
+	spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat);
+	spa_pod_builder_add(b, SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
+	                    SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+	                    SPA_FORMAT_VIDEO_format,
+	                    SPA_POD_CHOICE_ENUM_Id(5, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRx,
+	                                           SPA_VIDEO_FORMAT_BGRA, SPA_VIDEO_FORMAT_RGBx,
+	                                           SPA_VIDEO_FORMAT_RGBA),
+	                    SPA_FORMAT_VIDEO_size,
+	                    SPA_POD_CHOICE_RANGE_Rectangle(&size, &minSize, &maxSize),
+	                    SPA_FORMAT_VIDEO_framerate,
+	                    SPA_POD_CHOICE_RANGE_Fraction(&rate, &minRate, &maxRate), 0);
+
+	/* only linear buffers can be read by the CPU encoders without a GPU copy */
+	if (dmabuf)
+	{
+		spa_pod_builder_prop(b, SPA_FORMAT_VIDEO_modifier, SPA_POD_PROP_FLAG_MANDATORY);
+		spa_pod_builder_long(b, DRM_FORMAT_MOD_LINEAR);
+	}
+
+	return (const struct spa_pod*)spa_pod_builder_pop(b, &f);
+}
+
+static BOOL pw_shadow_stream_connect(pwShadowSubsystem* subsystem, int fd, UINT32 width,
+                                     UINT32 height)
+{
+	BOOL rc = FALSE;
+	uint8_t buffer[2048] = { 0 };
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod* params[2] = { 0 };
+
+	pw_thread_loop_lock(subsystem->loop);
+
+	subsystem->core = pw_context_connect_fd(subsystem->context, fd, NULL, 0);
+
+	if (!subsystem->core)
+	{
+		WLog_ERR(TAG, "failed to connect to PipeWire: %s", strerror(errno));
+		goto fail;
+	}
+
+	subsystem->stream =
+	    pw_stream_new(subsystem->core, "freerdp-shadow",
+	                  pw_properties_new(PW_KEY_MEDIA_TYPE, "Video", PW_KEY_MEDIA_CATEGORY,
+	                                    "Capture", PW_KEY_MEDIA_ROLE, "Screen", NULL));
+
+	if (!subsystem->stream)
+	{
+		WLog_ERR(TAG, "failed to create PipeWire stream");
+		goto fail;
+	}
+
+	pw_stream_add_listener(subsystem->stream, &subsystem->streamListener,
+	                       &pw_shadow_stream_events, subsystem);
+
+	/* DMA-BUF first, the producer falls back to shared memory if it can not export them */
+	params[0] = pw_shadow_build_format(&b, width, height, TRUE);
+	params[1] = pw_shadow_build_format(&b, width, height, FALSE);
+
+	const int status =
+	    pw_stream_connect(subsystem->stream, PW_DIRECTION_INPUT,
+	                      pw_shadow_portal_get_node(subsystem->portal),
+	                      PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS, params,
+	                      ARRAYSIZE(params));
+
+	if (status < 0)
+	{
+		WLog_ERR(TAG, "failed to connect PipeWire stream: %s", spa_strerror(status));
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	pw_thread_loop_unlock(subsystem->loop);
+	return rc;
+}
+
+static BOOL pw_shadow_check_resize(pwShadowSubsystem* subsystem)
+{
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+	pw_thread_loop_lock(subsystem->loop);
+	const BOOL pending = subsystem->resizePending;
+	const UINT32 width = subsystem->width;
+	const UINT32 height = subsystem->height;
+	subsystem->resizePending = FALSE;
+	pw_thread_loop_unlock(subsystem->loop);
+
+	if (!pending)
+		return FALSE;
+
+	pw_shadow_set_monitor(subsystem, width, height);
+
+	EnterCriticalSection(&surface->lock);
+	region16_clear(&subsystem->damage);
+	subsystem->refresh = TRUE;
+	const BOOL rc = shadow_screen_resize(server->screen);
+	LeaveCriticalSection(&surface->lock);
+	return rc;
+}
+
+static void pw_shadow_frame_update(pwShadowSubsystem* subsystem)
+{
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+	EnterCriticalSection(&surface->lock);
+	const BOOL changed = !region16_is_empty(&subsystem->damage);
+
+	if (changed)
+	{
+		region16_union(&(surface->invalidRegion), &(surface->invalidRegion), &subsystem->damage);
+		region16_clear(&subsystem->damage);
+	}
+
+	LeaveCriticalSection(&surface->lock);
+
+	if (!changed)
+		return;
+
+	shadow_subsystem_frame_update(&subsystem->common);
+
+	const UINT32 fps = shadow_subsystem_preferred_fps(&subsystem->common);
+	if (fps > 0)
+		subsystem->common.captureFrameRate = fps;
+
+	EnterCriticalSection(&surface->lock);
+	region16_clear(&(surface->invalidRegion));
+	LeaveCriticalSection(&surface->lock);
+}
+
+static int pw_shadow_subsystem_process_message(pwShadowSubsystem* subsystem, wMessage* message)
+{
+	switch (message->id)
+	{
+		case SHADOW_MSG_IN_REFRESH_REQUEST_ID:
+			shadow_subsystem_frame_update((rdpShadowSubsystem*)subsystem);
+			break;
+
+		default:
+			WLog_ERR(TAG, "Unknown message id: %" PRIu32 "", message->id);
+			break;
+	}
+
+	if (message->Free)
+		message->Free(message);
+
+	return 1;
+}
+
+static DWORD WINAPI pw_shadow_subsystem_thread(LPVOID arg)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)arg;
+	wMessage message = { 0 };
+	wMessagePipe* MsgPipe = subsystem->common.MsgPipe;
+	HANDLE events[] = { MessageQueue_Event(MsgPipe->In) };
+	subsystem->common.captureFrameRate = 16;
+	DWORD dwInterval = 1000 / subsystem->common.captureFrameRate;
+	UINT64 frameTime = GetTickCount64() + dwInterval;
+
+	while (1)
+	{
+		const UINT64 cTime = GetTickCount64();
+		const DWORD dwTimeout =
+		    (DWORD)((cTime > frameTime) ? 0 : MIN(UINT32_MAX, frameTime - cTime));
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, dwTimeout);
+
+		if (WaitForSingleObject(MessageQueue_Event(MsgPipe->In), 0) == WAIT_OBJECT_0)
+		{
+			if (MessageQueue_Peek(MsgPipe->In, &message, TRUE))
+			{
+				if (message.id == WMQ_QUIT)
+					break;
+
+				pw_shadow_subsystem_process_message(subsystem, &message);
+			}
+		}
+
+		/* frames are captured on the PipeWire thread, this only publishes them */
+		if ((status == WAIT_TIMEOUT) || (GetTickCount64() > frameTime))
+		{
+			pw_shadow_check_resize(subsystem);
+			pw_shadow_frame_update(subsystem);
+			dwInterval = 1000 / subsystem->common.captureFrameRate;
+			frameTime += dwInterval;
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static UINT32 pw_shadow_enum_monitors(WINPR_ATTR_UNUSED MONITOR_DEF* monitors,
+                                      WINPR_ATTR_UNUSED UINT32 maxMonitors)
+{
+	/* the monitor is chosen by the user in the screen cast portal dialog */
+	return 0;
+}
+
+static int pw_shadow_subsystem_init(rdpShadowSubsystem* sub)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)sub;
+	UINT32 width = 0;
+	UINT32 height = 0;
+
+	if (!subsystem)
+		return -1;
+
+	subsystem->portal = pw_shadow_portal_new();
+
+	if (!subsystem->portal || !pw_shadow_portal_open(subsystem->portal))
+		return -1;
+
+	if (!pw_shadow_portal_get_size(subsystem->portal, &width, &height))
+	{
+		width = 1920;
+		height = 1080;
+	}
+
+	pw_init(NULL, NULL);
+
+	subsystem->formatEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	subsystem->loop = pw_thread_loop_new("freerdp-shadow", NULL);
+
+	if (!subsystem->formatEvent || !subsystem->loop)
+		return -1;
+
+	subsystem->context = pw_context_new(pw_thread_loop_get_loop(subsystem->loop), NULL, 0);
+
+	if (!subsystem->context || (pw_thread_loop_start(subsystem->loop) < 0))
+		return -1;
+
+	if (!pw_shadow_stream_connect(subsystem, pw_shadow_portal_take_fd(subsystem->portal), width,
+	                              height))
+		return -1;
+
+	if (WaitForSingleObject(subsystem->formatEvent, PW_SHADOW_FORMAT_TIMEOUT) != WAIT_OBJECT_0)
+	{
+		WLog_ERR(TAG, "no stream format negotiated within %d ms", PW_SHADOW_FORMAT_TIMEOUT);
+		return -1;
+	}
+
+	pw_thread_loop_lock(subsystem->loop);
+	width = subsystem->width;
+	height = subsystem->height;
+	subsystem->resizePending = FALSE;
+	pw_thread_loop_unlock(subsystem->loop);
+
+	pw_shadow_set_monitor(subsystem, width, height);
+	return 1;
+}
+
+static int pw_shadow_subsystem_uninit(rdpShadowSubsystem* sub)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->loop)
+	{
+		pw_thread_loop_lock(subsystem->loop);
+
+		if (subsystem->stream)
+		{
+			pw_stream_disconnect(subsystem->stream);
+			pw_stream_destroy(subsystem->stream);
+			subsystem->stream = NULL;
+		}
+
+		if (subsystem->core)
+		{
+			pw_core_disconnect(subsystem->core);
+			subsystem->core = NULL;
+		}
+
+		pw_thread_loop_unlock(subsystem->loop);
+		pw_thread_loop_stop(subsystem->loop);
+
+		if (subsystem->context)
+		{
+			pw_context_destroy(subsystem->context);
+			subsystem->context = NULL;
+		}
+
+		pw_thread_loop_destroy(subsystem->loop);
+		subsystem->loop = NULL;
+		pw_deinit();
+	}
+
+	if (subsystem->formatEvent)
+	{
+		(void)CloseHandle(subsystem->formatEvent);
+		subsystem->formatEvent = NULL;
+	}
+
+	pw_shadow_portal_free(subsystem->portal);
+	subsystem->portal = NULL;
+	return 1;
+}
+
+static int pw_shadow_subsystem_start(rdpShadowSubsystem* sub)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	pw_thread_loop_lock(subsystem->loop);
+	subsystem->refresh = TRUE;
+	subsystem->started = TRUE;
+	pw_thread_loop_unlock(subsystem->loop);
+
+	if (!(subsystem->thread =
+	          CreateThread(NULL, 0, pw_shadow_subsystem_thread, (void*)subsystem, 0, NULL)))
+	{
+		WLog_ERR(TAG, "Failed to create thread");
+		return -1;
+	}
+
+	return 1;
+}
+
+static int pw_shadow_subsystem_stop(rdpShadowSubsystem* sub)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return -1;
+
+	if (subsystem->loop)
+	{
+		pw_thread_loop_lock(subsystem->loop);
+		subsystem->started = FALSE;
+		pw_thread_loop_unlock(subsystem->loop);
+	}
+
+	if (subsystem->thread)
+	{
+		if (MessageQueue_PostQuit(subsystem->common.MsgPipe->In, 0))
+			(void)WaitForSingleObject(subsystem->thread, INFINITE);
+
+		(void)CloseHandle(subsystem->thread);
+		subsystem->thread = NULL;
+	}
+
+	return 1;
+}
+
+static rdpShadowSubsystem* pw_shadow_subsystem_new(void)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)calloc(1, sizeof(pwShadowSubsystem));
+
+	if (!subsystem)
+		return NULL;
+
+	/* view only, input injection needs the RemoteDesktop portal */
+	region16_init(&subsystem->damage);
+	return (rdpShadowSubsystem*)subsystem;
+}
+
+static void pw_shadow_subsystem_free(rdpShadowSubsystem* sub)
+{
+	pwShadowSubsystem* subsystem = (pwShadowSubsystem*)sub;
+
+	if (!subsystem)
+		return;
+
+	pw_shadow_subsystem_uninit(sub);
+	region16_uninit(&subsystem->damage);
+	free(subsystem);
+}
+
+FREERDP_ENTRY_POINT(FREERDP_API const char* PipeWireShadowSubsystemName(void))
+{
+	return "PipeWire";
+}
+
+FREERDP_ENTRY_POINT(FREERDP_API int PipeWireShadowSubsystemEntry(
+    RDP_SHADOW_ENTRY_POINTS* pEntryPoints))
+{
+	if (!pEntryPoints)
+		return -1;
+
+	pEntryPoints->New = pw_shadow_subsystem_new;
+	pEntryPoints->Free = pw_shadow_subsystem_free;
+	pEntryPoints->Init = pw_shadow_subsystem_init;
+	pEntryPoints->Uninit = pw_shadow_subsystem_uninit;
+	pEntryPoints->Start = pw_shadow_subsystem_start;
+	pEntryPoints->Stop = pw_shadow_subsystem_stop;
+	pEntryPoints->EnumMonitors = pw_shadow_enum_monitors;
+	return 1;
+}
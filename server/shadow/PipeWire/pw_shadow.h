@@ -0,0 +1,71 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_PIPEWIRE_H
+#define FREERDP_SERVER_SHADOW_PIPEWIRE_H
+
+#include <freerdp/server/shadow.h>
+
+typedef struct pw_shadow_subsystem pwShadowSubsystem;
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+
+#include <freerdp/codec/region.h>
+
+#include <pipewire/pipewire.h>
+#include <spa/param/video/format-utils.h>
+
+#include "pw_portal.h"
+
+struct pw_shadow_subsystem
+{
+	rdpShadowSubsystem common;
+
+	HANDLE thread;
+	pwShadowPortal* portal;
+
+	struct pw_thread_loop* loop;
+	struct pw_context* context;
+	struct pw_core* core;
+	struct pw_stream* stream;
+	struct spa_hook streamListener;
+
+	/* negotiated stream format, written on the PipeWire thread */
+	BOOL dmabuf;
+	DWORD format;
+	UINT32 width;
+	UINT32 height;
+	BOOL resizePending;
+	HANDLE formatEvent;
+	BOOL started;
+
+	/* captured but not yet published changes, guarded by the surface lock */
+	REGION16 damage;
+	BOOL refresh;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_PIPEWIRE_H */
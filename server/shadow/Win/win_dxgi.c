@@ -497,26 +497,34 @@ int win_shadow_dxgi_uninit(winShadowSubsystem* subsystem)
 }
 
 int win_shadow_dxgi_fetch_frame_data(winShadowSubsystem* subsystem, BYTE** ppDstData,
-                                     int* pnDstStep, int x, int y, int width, int height)
+                                     int* pnDstStep, const REGION16* region)
 {
 	int status;
 	HRESULT hr;
-	D3D11_BOX Box;
+	UINT32 numRects = 0;
 	DXGI_MAPPED_RECT mappedRect;
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
 
-	if ((width * height) < 1)
+	if (numRects < 1)
 		return 0;
 
-	Box.top = x;
-	Box.left = y;
-	Box.right = x + width;
-	Box.bottom = y + height;
-	Box.front = 0;
-	Box.back = 1;
+	/* the staging texture has the size of the desktop, only the changed rectangles are
+	 * copied into it at their position, everything else is left as it was */
+	for (UINT32 i = 0; i < numRects; i++)
+	{
+		D3D11_BOX Box;
+
+		Box.left = rects[i].left;
+		Box.top = rects[i].top;
+		Box.right = rects[i].right;
+		Box.bottom = rects[i].bottom;
+		Box.front = 0;
+		Box.back = 1;
 
-	subsystem->dxgiDeviceContext->lpVtbl->CopySubresourceRegion(
-	    subsystem->dxgiDeviceContext, (ID3D11Resource*)subsystem->dxgiStage, 0, 0, 0, 0,
-	    (ID3D11Resource*)subsystem->dxgiDesktopImage, 0, &Box);
+		subsystem->dxgiDeviceContext->lpVtbl->CopySubresourceRegion(
+		    subsystem->dxgiDeviceContext, (ID3D11Resource*)subsystem->dxgiStage, 0, Box.left,
+		    Box.top, 0, (ID3D11Resource*)subsystem->dxgiDesktopImage, 0, &Box);
+	}
 
 	hr = subsystem->dxgiStage->lpVtbl->QueryInterface(subsystem->dxgiStage, &IID_IDXGISurface,
 	                                                  (void**)&(subsystem->dxgiSurface));
@@ -697,7 +705,10 @@ int win_shadow_dxgi_get_invalid_region(winShadowSubsystem* subsystem)
 	RECT* pDirtyRectsBuffer;
 	DXGI_OUTDUPL_MOVE_RECT* pMoveRect;
 	DXGI_OUTDUPL_MOVE_RECT* pMoveRectBuffer;
-	rdpShadowSurface* surface = subsystem->server->surface;
+	UINT64 moveArea = 0;
+	rdpShadowSurface* surface = subsystem->base.server->surface;
+
+	subsystem->dxgiMoveValid = FALSE;
 
 	if (subsystem->dxgiFrameInfo.AccumulatedFrames == 0)
 		return 0;
@@ -772,6 +783,22 @@ int win_shadow_dxgi_get_invalid_region(winShadowSubsystem* subsystem)
 		invalidRect.right = (UINT16)pDstRect->right;
 		invalidRect.bottom = (UINT16)pDstRect->bottom;
 
+		/* the surface describes a single move, the largest one is replayed by the clients and
+		 * the destination of every move is copied like a dirty rectangle */
+		const UINT64 area = 1ull * (invalidRect.right - invalidRect.left) *
+		                    (invalidRect.bottom - invalidRect.top);
+
+		if (area > moveArea)
+		{
+			moveArea = area;
+			subsystem->dxgiMoveValid = TRUE;
+			subsystem->dxgiMoveDst = invalidRect;
+			subsystem->dxgiMoveSrc.left = (UINT16)pSrcPt->x;
+			subsystem->dxgiMoveSrc.top = (UINT16)pSrcPt->y;
+			subsystem->dxgiMoveSrc.right = (UINT16)(pSrcPt->x + pDstRect->right - pDstRect->left);
+			subsystem->dxgiMoveSrc.bottom = (UINT16)(pSrcPt->y + pDstRect->bottom - pDstRect->top);
+		}
+
 		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
 	}
 
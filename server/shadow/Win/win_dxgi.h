@@ -47,7 +47,7 @@ extern "C"
 	int win_shadow_dxgi_uninit(winShadowSubsystem* subsystem);
 
 	int win_shadow_dxgi_fetch_frame_data(winShadowSubsystem* subsystem, BYTE** ppDstData,
-	                                     int* pnDstStep, int x, int y, int width, int height);
+	                                     int* pnDstStep, const REGION16* region);
 
 	int win_shadow_dxgi_get_next_frame(winShadowSubsystem* subsystem);
 	int win_shadow_dxgi_get_invalid_region(winShadowSubsystem* subsystem);
@@ -308,16 +308,49 @@ static int win_shadow_surface_copy(winShadowSubsystem* subsystem)
 	}
 #elif defined(WITH_DXGI_1_2)
 	DstFormat = PIXEL_FORMAT_BGRX32;
-	status = win_shadow_dxgi_fetch_frame_data(subsystem, &pDstData, &nDstStep, x, y, width, height);
+	status = win_shadow_dxgi_fetch_frame_data(subsystem, &pDstData, &nDstStep,
+	                                          &(surface->invalidRegion));
 #endif
 
 	if (status <= 0)
 		return status;
 
+	EnterCriticalSection(&(surface->lock));
+#if defined(WITH_DXGI_1_2)
+	{
+		/* only the dirty and moved rectangles were staged */
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects = region16_rects(&(surface->invalidRegion), &numRects);
+
+		for (UINT32 i = 0; i < numRects; i++)
+		{
+			const RECTANGLE_16* rect = &rects[i];
+
+			if (!freerdp_image_copy_no_overlap(
+			        surface->data, surface->format, surface->scanline, rect->left, rect->top,
+			        rect->right - rect->left, rect->bottom - rect->top, pDstData, DstFormat,
+			        nDstStep, rect->left, rect->top, NULL, FREERDP_FLIP_NONE))
+			{
+				LeaveCriticalSection(&(surface->lock));
+				return ERROR_INTERNAL_ERROR;
+			}
+		}
+
+		surface->moveValid = subsystem->dxgiMoveValid;
+		surface->moveSrc = subsystem->dxgiMoveSrc;
+		surface->moveDst = subsystem->dxgiMoveDst;
+	}
+#else
 	if (!freerdp_image_copy_no_overlap(surface->data, surface->format, surface->scanline, x, y,
 	                                   width, height, pDstData, DstFormat, nDstStep, x, y, NULL,
 	                                   FREERDP_FLIP_NONE))
+	{
+		LeaveCriticalSection(&(surface->lock));
 		return ERROR_INTERNAL_ERROR;
+	}
+#endif
+	surface->captureId++;
+	LeaveCriticalSection(&(surface->lock));
 
 	ArrayList_Lock(server->clients);
 	count = ArrayList_Count(server->clients);
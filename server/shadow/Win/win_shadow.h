@@ -74,6 +74,10 @@ struct win_shadow_subsystem
 	DXGI_OUTDUPL_FRAME_INFO dxgiFrameInfo;
 	ID3D11DeviceContext* dxgiDeviceContext;
 	IDXGIOutputDuplication* dxgiOutputDuplication;
+	/* the largest move rectangle of the acquired frame */
+	BOOL dxgiMoveValid;
+	RECTANGLE_16 dxgiMoveSrc;
+	RECTANGLE_16 dxgiMoveDst;
 #endif
 };
 
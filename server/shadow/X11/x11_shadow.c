@@ -50,6 +50,9 @@
 
 // #define USE_SHADOW_BLEND_CURSOR
 
+/* milliseconds between two samples of the pointer position */
+#define X11_SHADOW_POINTER_INTERVAL 8
+
 static UINT32 x11_shadow_enum_monitors(MONITOR_DEF* monitors, UINT32 maxMonitors);
 
 #ifdef WITH_PAM
@@ -645,6 +648,13 @@ static int x11_shadow_handle_xevent(x11ShadowSubsystem* subsystem, XEvent* xeven
 		x11_shadow_query_cursor(subsystem, TRUE);
 	}
 
+#endif
+#ifdef WITH_XDAMAGE
+	else if (subsystem->use_xdamage && (xevent->type == subsystem->xdamage_notify_event))
+	{
+		/* damage is collected with XDamageSubtract when the next frame is grabbed */
+	}
+
 #endif
 	else
 	{
@@ -770,6 +780,9 @@ static BOOL x11_shadow_check_resize(x11ShadowSubsystem* subsystem)
 		virtualScreen->right = attr.width - 1;
 		virtualScreen->bottom = attr.height - 1;
 		virtualScreen->flags = 1;
+#ifdef WITH_XDAMAGE
+		subsystem->xdamage_synced = FALSE;
+#endif
 		return TRUE;
 	}
 
@@ -792,21 +805,207 @@ static int x11_shadow_error_handler_for_capture(Display* display, XErrorEvent* e
 	return 0;
 }
 
+/**
+ * Compare an area of a captured image with the surface, the changed tiles are added to the
+ * invalid region of the surface. The surface lock must be held.
+ *
+ * @return \b 0 if equal, \b >0 if changed with \b changed set to the bounds of the changed
+ * tiles and \b <0 for any error
+ */
+static int x11_shadow_compare_area(x11ShadowSubsystem* subsystem, rdpShadowSurface* surface,
+                                   const BYTE* data, UINT32 step, UINT32 left, UINT32 top,
+                                   UINT32 width, UINT32 height, RECTANGLE_16* changed)
+{
+	const size_t count = ((width + 15ull) / 16) * ((height + 15ull) / 16);
+	const size_t offset =
+	    1ull * surface->scanline * top + 1ull * FreeRDPGetBytesPerPixel(surface->format) * left;
+	BYTE* tiles = calloc(count, sizeof(BYTE));
+
+	if (!tiles)
+		return -1;
+
+	int status = shadow_capture_compare_tiles(&surface->data[offset], surface->format,
+	                                          surface->scanline, width, height, data,
+	                                          subsystem->format, step, tiles, count);
+
+	if (status > 0)
+	{
+		REGION16 region = { 0 };
+		UINT32 numRects = 0;
+		region16_init(&region);
+
+		status = -1;
+		if (shadow_capture_tiles_to_region(tiles, width, height, (UINT16)left, (UINT16)top,
+		                                   &region))
+		{
+			const RECTANGLE_16* rects = region16_rects(&region, &numRects);
+
+			if (region16_union_rects(&(surface->invalidRegion), &(surface->invalidRegion), rects,
+			                         numRects))
+			{
+				*changed = *region16_extents(&region);
+				status = 1;
+			}
+		}
+
+		region16_uninit(&region);
+	}
+
+	free(tiles);
+	return status;
+}
+
+static void x11_shadow_frame_update(x11ShadowSubsystem* subsystem)
+{
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+	shadow_subsystem_frame_update(&subsystem->common);
+
+	const UINT32 fps = shadow_subsystem_preferred_fps(&subsystem->common);
+	if (fps > 0)
+		subsystem->common.captureFrameRate = fps;
+
+	EnterCriticalSection(&surface->lock);
+	region16_clear(&(surface->invalidRegion));
+	LeaveCriticalSection(&surface->lock);
+}
+
+#if defined(WITH_XDAMAGE) && defined(WITH_XFIXES) && !defined(USE_SHADOW_BLEND_CURSOR)
+static XImage* x11_shadow_get_rect_image(x11ShadowSubsystem* subsystem, int x, int y,
+                                         unsigned int width, unsigned int height)
+{
+#ifdef WITH_XSHM
+	if (subsystem->use_xshm)
+	{
+		/* a sub image at the start of the shared segment, which is screen sized */
+		XImage* image = XShmCreateImage(subsystem->display, subsystem->visual, subsystem->depth,
+		                                ZPixmap, subsystem->fb_shm_info.shmaddr,
+		                                &(subsystem->fb_shm_info), width, height);
+
+		if (!image)
+			return NULL;
+
+		if (!XShmGetImage(subsystem->display, subsystem->root_window, image, x, y, AllPlanes))
+		{
+			image->data = NULL;
+			XDestroyImage(image);
+			return NULL;
+		}
+
+		return image;
+	}
+#endif
+
+	return XGetImage(subsystem->display, subsystem->root_window, x, y, width, height, AllPlanes,
+	                 ZPixmap);
+}
+
+static void x11_shadow_free_rect_image(x11ShadowSubsystem* subsystem, XImage* image)
+{
+	if (!image)
+		return;
+
+	/* the shared segment belongs to fb_image */
+	if (subsystem->use_xshm)
+		image->data = NULL;
+
+	XDestroyImage(image);
+}
+
+/**
+ * Fetch only what XDamage reported since the last frame. Each damaged
+ * rectangle is compared against the surface so that redraws with the
+ * same content are not encoded again.
+ *
+ * @return -1 if the damage could not be fetched, 0 if nothing changed, 1 otherwise
+ */
+static int x11_shadow_damage_grab(x11ShadowSubsystem* subsystem, rdpShadowSurface* surface)
+{
+	int status = 0;
+	int nrects = 0;
+
+	XDamageSubtract(subsystem->display, subsystem->xdamage, None, subsystem->xdamage_region);
+	XRectangle* rects = XFixesFetchRegion(subsystem->display, subsystem->xdamage_region, &nrects);
+
+	if (!rects)
+		return 0;
+
+	EnterCriticalSection(&surface->lock);
+	const RECTANGLE_16 surfaceRect = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, surface->width),
+		                               WINPR_ASSERTING_INT_CAST(UINT16, surface->height) };
+	const INT32 originX = WINPR_ASSERTING_INT_CAST(INT32, surface->x);
+	const INT32 originY = WINPR_ASSERTING_INT_CAST(INT32, surface->y);
+	LeaveCriticalSection(&surface->lock);
+
+	for (int i = 0; i < nrects; i++)
+	{
+		const INT32 left = MAX(rects[i].x - originX, 0);
+		const INT32 top = MAX(rects[i].y - originY, 0);
+		const INT32 right = MIN(rects[i].x + rects[i].width - originX, surfaceRect.right);
+		const INT32 bottom = MIN(rects[i].y + rects[i].height - originY, surfaceRect.bottom);
+
+		if ((left >= right) || (top >= bottom))
+			continue;
+
+		const UINT32 width = (UINT32)(right - left);
+		const UINT32 height = (UINT32)(bottom - top);
+		XImage* image =
+		    x11_shadow_get_rect_image(subsystem, left + originX, top + originY, width, height);
+
+		if (!image)
+		{
+			/* BadMatch, the screen is being resized. Grab everything next time. */
+			subsystem->xdamage_synced = FALSE;
+			status = -1;
+			break;
+		}
+
+		RECTANGLE_16 changed = { 0 };
+		EnterCriticalSection(&surface->lock);
+		const UINT32 step = WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line);
+
+		if ((x11_shadow_compare_area(subsystem, surface, (BYTE*)image->data, step, (UINT32)left,
+		                             (UINT32)top, width, height, &changed) > 0) &&
+		    freerdp_image_copy_no_overlap(surface->data, surface->format, surface->scanline,
+		                                  changed.left, changed.top,
+		                                  1u * changed.right - changed.left,
+		                                  1u * changed.bottom - changed.top, (BYTE*)image->data,
+		                                  subsystem->format, step, changed.left - (UINT32)left,
+		                                  changed.top - (UINT32)top, NULL, FREERDP_FLIP_NONE))
+		{
+			if (status == 0)
+				status = 1;
+		}
+
+		LeaveCriticalSection(&surface->lock);
+		x11_shadow_free_rect_image(subsystem, image);
+	}
+
+	XFree(rects);
+
+	if (status > 0)
+	{
+		EnterCriticalSection(&surface->lock);
+		surface->moveValid = FALSE;
+		surface->captureId++;
+		LeaveCriticalSection(&surface->lock);
+	}
+
+	return status;
+}
+#endif
+
 static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 {
 	int rc = 0;
 	size_t count = 0;
 	int status = -1;
-	int x = 0;
-	int y = 0;
-	int width = 0;
-	int height = 0;
 	XImage* image = NULL;
 	rdpShadowServer* server = NULL;
 	rdpShadowSurface* surface = NULL;
 	RECTANGLE_16 invalidRect;
 	RECTANGLE_16 surfaceRect;
-	const RECTANGLE_16* extents = NULL;
 	server = subsystem->common.server;
 	surface = server->surface;
 	count = ArrayList_Count(server->clients);
@@ -828,6 +1027,27 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	 * changed outside. We will resize to correct resolution at next frame
 	 */
 	XSetErrorHandler(x11_shadow_error_handler_for_capture);
+#if defined(WITH_XDAMAGE) && defined(WITH_XFIXES) && !defined(USE_SHADOW_BLEND_CURSOR)
+	if (subsystem->use_xdamage)
+	{
+		if (subsystem->xdamage_synced)
+		{
+			status = x11_shadow_damage_grab(subsystem, surface);
+			XSetErrorHandler(NULL);
+			XSync(subsystem->display, False);
+			XUnlockDisplay(subsystem->display);
+
+			if (status > 0)
+				x11_shadow_frame_update(subsystem);
+
+			return 1;
+		}
+
+		/* Start from a full grab. Damage from before it is already included. */
+		XDamageSubtract(subsystem->display, subsystem->xdamage, None, None);
+		subsystem->xdamage_synced = TRUE;
+	}
+#endif
 #if defined(WITH_XDAMAGE)
 	if (subsystem->use_xshm)
 	{
@@ -836,10 +1056,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare_with_format(
-		    surface->data, surface->format, surface->scanline, surface->width, surface->height,
-		    (BYTE*)&(image->data[surface->width * 4ull]), subsystem->format,
-		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRect);
+		status = x11_shadow_compare_area(
+		    subsystem, surface, (BYTE*)&(image->data[surface->width * 4ull]),
+		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), 0, 0, surface->width,
+		    surface->height, &invalidRect);
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -851,10 +1071,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 		if (image)
 		{
-			status = shadow_capture_compare_with_format(
-			    surface->data, surface->format, surface->scanline, surface->width, surface->height,
-			    (BYTE*)image->data, subsystem->format,
-			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRect);
+			status = x11_shadow_compare_area(
+			    subsystem, surface, (BYTE*)image->data,
+			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), 0, 0, surface->width,
+			    surface->height, &invalidRect);
 		}
 		LeaveCriticalSection(&surface->lock);
 		if (!image)
@@ -872,11 +1092,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XSync(subsystem->display, False);
 	XUnlockDisplay(subsystem->display);
 
-	if (status)
+	if (status > 0)
 	{
 		BOOL empty = 0;
 		EnterCriticalSection(&surface->lock);
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
 		region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
 		empty = region16_is_empty(&(surface->invalidRegion));
 		LeaveCriticalSection(&surface->lock);
@@ -885,23 +1104,34 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		{
 			BOOL success = 0;
 			EnterCriticalSection(&surface->lock);
-			extents = region16_extents(&(surface->invalidRegion));
-			x = extents->left;
-			y = extents->top;
-			width = extents->right - extents->left;
-			height = extents->bottom - extents->top;
 			WINPR_ASSERT(image);
 			WINPR_ASSERT(image->bytes_per_line >= 0);
-			WINPR_ASSERT(width >= 0);
-			WINPR_ASSERT(height >= 0);
-			success = freerdp_image_copy_no_overlap(
-			    surface->data, surface->format, surface->scanline,
-			    WINPR_ASSERTING_INT_CAST(uint32_t, x), WINPR_ASSERTING_INT_CAST(uint32_t, y),
-			    WINPR_ASSERTING_INT_CAST(uint32_t, width),
-			    WINPR_ASSERTING_INT_CAST(uint32_t, height), (BYTE*)image->data, subsystem->format,
-			    WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line),
-			    WINPR_ASSERTING_INT_CAST(UINT32, x), WINPR_ASSERTING_INT_CAST(UINT32, y), NULL,
-			    FREERDP_FLIP_NONE);
+
+			/* surface->data still holds the previous frame, look for scrolled content */
+#if defined(USE_SHADOW_BLEND_CURSOR)
+			surface->moveValid = FALSE;
+#else
+			surface->moveValid = shadow_capture_detect_move(
+			    surface->data, surface->format, surface->scanline, (BYTE*)image->data,
+			    subsystem->format, WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line),
+			    &invalidRect, &surface->moveSrc, &surface->moveDst);
+#endif
+			/* Only the changed tiles differ from surface->data, copying the extents would also
+			 * copy everything in between scattered changes. */
+			UINT32 nrects = 0;
+			const RECTANGLE_16* rects = region16_rects(&(surface->invalidRegion), &nrects);
+			success = TRUE;
+			for (UINT32 i = 0; success && (i < nrects); i++)
+			{
+				const RECTANGLE_16* rect = &rects[i];
+				success = freerdp_image_copy_no_overlap(
+				    surface->data, surface->format, surface->scanline, rect->left, rect->top,
+				    1u * rect->right - rect->left, 1u * rect->bottom - rect->top,
+				    (BYTE*)image->data, subsystem->format,
+				    WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line), rect->left,
+				    rect->top, NULL, FREERDP_FLIP_NONE);
+			}
+			surface->captureId++;
 			LeaveCriticalSection(&surface->lock);
 			if (!success)
 				goto fail_capture;
@@ -910,22 +1140,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 			if (x11_shadow_blend_cursor(subsystem) < 0)
 				goto fail_capture;
 #endif
-			count = ArrayList_Count(server->clients);
-			shadow_subsystem_frame_update(&subsystem->common);
-
-			if (count == 1)
-			{
-				rdpShadowClient* client = NULL;
-				client = (rdpShadowClient*)ArrayList_GetItem(server->clients, 0);
-
-				if (client)
-					subsystem->common.captureFrameRate =
-					    shadow_encoder_preferred_fps(client->encoder);
-			}
-
-			EnterCriticalSection(&surface->lock);
-			region16_clear(&(surface->invalidRegion));
-			LeaveCriticalSection(&surface->lock);
+			x11_shadow_frame_update(subsystem);
 		}
 	}
 
@@ -1004,7 +1219,7 @@ static DWORD WINAPI x11_shadow_subsystem_thread(LPVOID arg)
 		{
 			XLockDisplay(subsystem->display);
 
-			if (XEventsQueued(subsystem->display, QueuedAlready))
+			while (XEventsQueued(subsystem->display, QueuedAlready))
 			{
 				XNextEvent(subsystem->display, &xevent);
 				x11_shadow_handle_xevent(subsystem, &xevent);
@@ -1017,7 +1232,6 @@ static DWORD WINAPI x11_shadow_subsystem_thread(LPVOID arg)
 		{
 			x11_shadow_check_resize(subsystem);
 			x11_shadow_screen_grab(subsystem);
-			x11_shadow_query_cursor(subsystem, FALSE);
 			dwInterval = 1000 / subsystem->common.captureFrameRate;
 			frameTime += dwInterval;
 		}
@@ -1027,6 +1241,19 @@ static DWORD WINAPI x11_shadow_subsystem_thread(LPVOID arg)
 	return 0;
 }
 
+static DWORD WINAPI x11_shadow_pointer_thread(LPVOID arg)
+{
+	x11ShadowSubsystem* subsystem = (x11ShadowSubsystem*)arg;
+
+	/* the screen grab waits for the clients to encode a frame, the pointer must not */
+	while (WaitForSingleObject(subsystem->pointerStopEvent, X11_SHADOW_POINTER_INTERVAL) ==
+	       WAIT_TIMEOUT)
+		x11_shadow_query_cursor(subsystem, FALSE);
+
+	ExitThread(0);
+	return 0;
+}
+
 static int x11_shadow_subsystem_base_init(x11ShadowSubsystem* subsystem)
 {
 	if (subsystem->display)
@@ -1133,8 +1360,10 @@ static int x11_shadow_xdamage_init(x11ShadowSubsystem* subsystem)
 		return -1;
 
 	subsystem->xdamage_notify_event = damage_event + XDamageNotify;
+	/* Damage is collected once per frame with XDamageSubtract, so one notify
+	 * per frame is enough instead of an event per drawn rectangle. */
 	subsystem->xdamage =
-	    XDamageCreate(subsystem->display, subsystem->root_window, XDamageReportDeltaRectangles);
+	    XDamageCreate(subsystem->display, subsystem->root_window, XDamageReportNonEmpty);
 
 	if (!subsystem->xdamage)
 		return -1;
@@ -1505,6 +1734,16 @@ static int x11_shadow_subsystem_start(rdpShadowSubsystem* sub)
 		return -1;
 	}
 
+	if (!(subsystem->pointerStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
+		return -1;
+
+	if (!(subsystem->pointerThread =
+	          CreateThread(NULL, 0, x11_shadow_pointer_thread, (void*)subsystem, 0, NULL)))
+	{
+		WLog_ERR(TAG, "Failed to create pointer thread");
+		return -1;
+	}
+
 	return 1;
 }
 
@@ -1515,6 +1754,20 @@ static int x11_shadow_subsystem_stop(rdpShadowSubsystem* sub)
 	if (!subsystem)
 		return -1;
 
+	if (subsystem->pointerThread)
+	{
+		(void)SetEvent(subsystem->pointerStopEvent);
+		(void)WaitForSingleObject(subsystem->pointerThread, INFINITE);
+		(void)CloseHandle(subsystem->pointerThread);
+		subsystem->pointerThread = NULL;
+	}
+
+	if (subsystem->pointerStopEvent)
+	{
+		(void)CloseHandle(subsystem->pointerStopEvent);
+		subsystem->pointerStopEvent = NULL;
+	}
+
 	if (subsystem->thread)
 	{
 		if (MessageQueue_PostQuit(subsystem->common.MsgPipe->In, 0))
@@ -1547,7 +1800,7 @@ static rdpShadowSubsystem* x11_shadow_subsystem_new(void)
 	subsystem->composite = FALSE;
 	subsystem->use_xshm = FALSE; /* temporarily disabled */
 	subsystem->use_xfixes = TRUE;
-	subsystem->use_xdamage = FALSE;
+	subsystem->use_xdamage = TRUE;
 	subsystem->use_xinerama = TRUE;
 	return (rdpShadowSubsystem*)subsystem;
 }
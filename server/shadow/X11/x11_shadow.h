@@ -56,6 +56,9 @@ struct x11_shadow_subsystem
 	rdpShadowSubsystem common;
 
 	HANDLE thread;
+	/* samples the pointer position independent of the capture and the encoders */
+	HANDLE pointerThread;
+	HANDLE pointerStopEvent;
 
 	UINT32 bpp;
 	int xfds;
@@ -95,6 +98,7 @@ struct x11_shadow_subsystem
 	Damage xdamage;
 	int xdamage_notify_event;
 	XserverRegion xdamage_region;
+	BOOL xdamage_synced;
 #endif
 
 #ifdef WITH_XFIXES
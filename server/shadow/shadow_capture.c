@@ -20,6 +20,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 
@@ -27,6 +29,19 @@
 
 #include "shadow_capture.h"
 
+#define TAG SERVER_TAG("shadow")
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CAPTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define SHADOW_CAPTURE_TILE 16
+/* smaller frames are compared by the calling thread */
+#define SHADOW_CAPTURE_PARALLEL_THRESHOLD (512ull * 512ull)
+#define SHADOW_CAPTURE_MIN_BAND_ROWS 4
+#define SHADOW_CAPTURE_MAX_BANDS 16
+
 int shadow_capture_align_clip_rect(RECTANGLE_16* rect, const RECTANGLE_16* clip)
 {
 	int dx = 0;
@@ -86,47 +101,6 @@ int shadow_capture_compare(const BYTE* WINPR_RESTRICT pData1, UINT32 nStep1, UIN
 }
 #endif
 
-static BOOL color_equal(UINT32 colorA, UINT32 formatA, UINT32 colorB, UINT32 formatB)
-{
-	BYTE ar = 0;
-	BYTE ag = 0;
-	BYTE ab = 0;
-	BYTE aa = 0;
-	BYTE br = 0;
-	BYTE bg = 0;
-	BYTE bb = 0;
-	BYTE ba = 0;
-	FreeRDPSplitColor(colorA, formatA, &ar, &ag, &ab, &aa, NULL);
-	FreeRDPSplitColor(colorB, formatB, &br, &bg, &bb, &ba, NULL);
-
-	if (ar != br)
-		return FALSE;
-	if (ag != bg)
-		return FALSE;
-	if (ab != bb)
-		return FALSE;
-	if (aa != ba)
-		return FALSE;
-	return TRUE;
-}
-
-static BOOL pixel_equal(const BYTE* WINPR_RESTRICT a, UINT32 formatA, const BYTE* WINPR_RESTRICT b,
-                        UINT32 formatB, size_t count)
-{
-	const size_t bppA = FreeRDPGetBytesPerPixel(formatA);
-	const size_t bppB = FreeRDPGetBytesPerPixel(formatB);
-
-	for (size_t x = 0; x < count; x++)
-	{
-		const UINT32 colorA = FreeRDPReadColor(&a[bppA * x], formatA);
-		const UINT32 colorB = FreeRDPReadColor(&b[bppB * x], formatB);
-		if (!color_equal(colorA, formatA, colorB, formatB))
-			return FALSE;
-	}
-
-	return TRUE;
-}
-
 static BOOL color_equal_no_alpha(UINT32 colorA, UINT32 formatA, UINT32 colorB, UINT32 formatB)
 {
 	BYTE ar = 0;
@@ -176,128 +150,328 @@ static BOOL pixel_equal_same_format(const BYTE* WINPR_RESTRICT a, UINT32 formatA
 typedef BOOL (*pixel_equal_fn_t)(const BYTE* WINPR_RESTRICT a, UINT32 formatA,
                                  const BYTE* WINPR_RESTRICT b, UINT32 formatB, size_t count);
 
-static pixel_equal_fn_t get_comparison_fn(DWORD format1, DWORD format2)
+typedef struct
+{
+	UINT32 format1;
+	UINT32 format2;
+	pixel_equal_fn_t fn; /* NULL if 32 bit words are compared with mask */
+	UINT32 mask;
+} SHADOW_PIXEL_COMPARE;
+
+/* a mask with the alpha byte of a 32 bpp pixel cleared, it is the first byte in memory for ARGB
+ * and ABGR and the last one otherwise */
+static UINT32 shadow_capture_no_alpha_mask(UINT32 format)
 {
+	BYTE bytes[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+	UINT32 mask = 0;
 
-	if (format1 == format2)
-		return pixel_equal_same_format;
+	switch (FREERDP_PIXEL_FORMAT_TYPE(format))
+	{
+		case FREERDP_PIXEL_FORMAT_TYPE_ARGB:
+		case FREERDP_PIXEL_FORMAT_TYPE_ABGR:
+			bytes[0] = 0;
+			break;
+		default:
+			bytes[3] = 0;
+			break;
+	}
+	memcpy(&mask, bytes, sizeof(mask));
+	return mask;
+}
 
-	const UINT32 bpp1 = FreeRDPGetBitsPerPixel(format1);
+static void shadow_capture_compare_init(SHADOW_PIXEL_COMPARE* cmp, UINT32 format1, UINT32 format2)
+{
+	WINPR_ASSERT(cmp);
 
-	if (!FreeRDPColorHasAlpha(format1) || !FreeRDPColorHasAlpha(format2))
+	cmp->format1 = format1;
+	cmp->format2 = format2;
+	cmp->fn = NULL;
+	cmp->mask = 0xFFFFFFFF;
+
+	/* 32 bpp images with the same channel layout are compared word wise. The X byte of formats
+	 * without alpha carries no information, so alpha only counts if both images have it. */
+	if ((FreeRDPGetBitsPerPixel(format1) == 32) && (FreeRDPGetBitsPerPixel(format2) == 32) &&
+	    FreeRDPAreColorFormatsEqualNoAlpha(format1, format2))
 	{
-		/* In case we have RGBA32 and RGBX32 or similar assume the alpha data is equal.
-		 * This allows us to use the fast memcmp comparison. */
-		if ((bpp1 == 32) && FreeRDPAreColorFormatsEqualNoAlpha(format1, format2))
-		{
-			switch (format1)
-			{
-				case PIXEL_FORMAT_ARGB32:
-				case PIXEL_FORMAT_XRGB32:
-				case PIXEL_FORMAT_ABGR32:
-				case PIXEL_FORMAT_XBGR32:
-					return pixel_equal;
-				case PIXEL_FORMAT_RGBA32:
-				case PIXEL_FORMAT_RGBX32:
-				case PIXEL_FORMAT_BGRA32:
-				case PIXEL_FORMAT_BGRX32:
-					return pixel_equal;
-				default:
-					break;
-			}
-		}
-		return pixel_equal_no_alpha;
+		if (!FreeRDPColorHasAlpha(format1) || !FreeRDPColorHasAlpha(format2))
+			cmp->mask = shadow_capture_no_alpha_mask(format1);
 	}
+	else if (format1 == format2)
+		cmp->fn = pixel_equal_same_format;
 	else
-		return pixel_equal_no_alpha;
+		cmp->fn = pixel_equal_no_alpha;
 }
 
-int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
-                                       UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
-                                       const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
-                                       UINT32 nStep2, RECTANGLE_16* WINPR_RESTRICT rect)
+static BOOL pixel_equal_masked(const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT b,
+                               size_t count, UINT32 mask)
 {
-	pixel_equal_fn_t pixel_equal_fn = get_comparison_fn(format1, format2);
-	BOOL allEqual = TRUE;
-	UINT32 tw = 0;
-	const UINT32 nrow = (nHeight + 15) / 16;
-	const UINT32 ncol = (nWidth + 15) / 16;
-	UINT32 l = ncol + 1;
-	UINT32 t = nrow + 1;
-	UINT32 r = 0;
-	UINT32 b = 0;
-	const size_t bppA = FreeRDPGetBytesPerPixel(format1);
-	const size_t bppB = FreeRDPGetBytesPerPixel(format2);
-	const RECTANGLE_16 empty = { 0 };
-	WINPR_ASSERT(rect);
+	size_t x = 0;
 
-	*rect = empty;
+#if defined(CAPTURE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i diff = zero;
 
-	for (size_t ty = 0; ty < nrow; ty++)
+	for (; x + 4 <= count; x += 4)
 	{
-		BOOL rowEqual = TRUE;
-		size_t th = ((ty + 1) == nrow) ? (nHeight % 16) : 16;
+		const __m128i va = _mm_loadu_si128((const __m128i*)&a[4 * x]);
+		const __m128i vb = _mm_loadu_si128((const __m128i*)&b[4 * x]);
+		diff = _mm_or_si128(diff, _mm_xor_si128(va, vb));
+	}
 
-		if (!th)
-			th = 16;
+	diff = _mm_and_si128(diff, _mm_set1_epi32((int)mask));
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xFFFF)
+		return FALSE;
+#else
+	const UINT64 mask64 = ((UINT64)mask << 32) | mask;
+	UINT64 diff = 0;
 
-		for (size_t tx = 0; tx < ncol; tx++)
-		{
-			BOOL equal = TRUE;
-			tw = ((tx + 1) == ncol) ? (nWidth % 16) : 16;
+	for (; x + 2 <= count; x += 2)
+	{
+		UINT64 va = 0;
+		UINT64 vb = 0;
+		memcpy(&va, &a[4 * x], sizeof(va));
+		memcpy(&vb, &b[4 * x], sizeof(vb));
+		diff |= va ^ vb;
+	}
+
+	if ((diff & mask64) != 0)
+		return FALSE;
+#endif
 
-			if (!tw)
-				tw = 16;
+	UINT32 rest = 0;
+	for (; x < count; x++)
+	{
+		UINT32 va = 0;
+		UINT32 vb = 0;
+		memcpy(&va, &a[4 * x], sizeof(va));
+		memcpy(&vb, &b[4 * x], sizeof(vb));
+		rest |= va ^ vb;
+	}
 
-			const BYTE* p1 = &pData1[(ty * 16ULL * nStep1) + (tx * 16ull * bppA)];
-			const BYTE* p2 = &pData2[(ty * 16ULL * nStep2) + (tx * 16ull * bppB)];
+	return (rest & mask) == 0;
+}
 
-			for (size_t k = 0; k < th; k++)
+static BOOL shadow_capture_pixels_equal(const SHADOW_PIXEL_COMPARE* WINPR_RESTRICT cmp,
+                                        const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT b,
+                                        size_t count)
+{
+	if (!cmp->fn)
+		return pixel_equal_masked(a, b, count, cmp->mask);
+	return cmp->fn(a, cmp->format1, b, cmp->format2, count);
+}
+
+typedef struct
+{
+	const SHADOW_PIXEL_COMPARE* cmp;
+	const BYTE* pData1;
+	UINT32 nStep1;
+	const BYTE* pData2;
+	UINT32 nStep2;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	UINT32 firstRow;
+	UINT32 lastRow;
+	BYTE* tiles;
+
+	/* changed tiles and their bounds in tile units */
+	size_t changed;
+	UINT32 l;
+	UINT32 t;
+	UINT32 r;
+	UINT32 b;
+} SHADOW_COMPARE_BAND;
+
+static INIT_ONCE compare_once = INIT_ONCE_STATIC_INIT;
+static PTP_POOL compare_pool = NULL;
+static TP_CALLBACK_ENVIRON compare_env = { 0 };
+static UINT32 compare_threads = 1;
+
+static void shadow_capture_compare_band(SHADOW_COMPARE_BAND* WINPR_RESTRICT band)
+{
+	const UINT32 ncol = (band->nWidth + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+	const size_t bppA = FreeRDPGetBytesPerPixel(band->cmp->format1);
+	const size_t bppB = FreeRDPGetBytesPerPixel(band->cmp->format2);
+
+	band->changed = 0;
+	band->l = ncol;
+	band->t = band->lastRow;
+	band->r = 0;
+	band->b = 0;
+
+	for (UINT32 ty = band->firstRow; ty < band->lastRow; ty++)
+	{
+		const UINT32 th = MIN(SHADOW_CAPTURE_TILE, band->nHeight - ty * SHADOW_CAPTURE_TILE);
+
+		for (UINT32 tx = 0; tx < ncol; tx++)
+		{
+			const UINT32 tw = MIN(SHADOW_CAPTURE_TILE, band->nWidth - tx * SHADOW_CAPTURE_TILE);
+			const BYTE* p1 = &band->pData1[1ull * ty * SHADOW_CAPTURE_TILE * band->nStep1 +
+			                               1ull * tx * SHADOW_CAPTURE_TILE * bppA];
+			const BYTE* p2 = &band->pData2[1ull * ty * SHADOW_CAPTURE_TILE * band->nStep2 +
+			                               1ull * tx * SHADOW_CAPTURE_TILE * bppB];
+			BOOL equal = TRUE;
+
+			for (UINT32 k = 0; equal && (k < th); k++)
 			{
-				if (!pixel_equal_fn(p1, format1, p2, format2, tw))
-				{
-					equal = FALSE;
-					break;
-				}
-
-				p1 += nStep1;
-				p2 += nStep2;
+				equal = shadow_capture_pixels_equal(band->cmp, p1, p2, tw);
+				p1 += band->nStep1;
+				p2 += band->nStep2;
 			}
 
+			if (band->tiles)
+				band->tiles[1ull * ty * ncol + tx] = equal ? 0 : 1;
+
 			if (!equal)
 			{
-				rowEqual = FALSE;
-				if (l > tx)
-					l = (UINT32)tx;
-
-				if (r < tx)
-					r = (UINT32)tx;
+				band->changed++;
+				band->l = MIN(band->l, tx);
+				band->r = MAX(band->r, tx);
+				band->t = MIN(band->t, ty);
+				band->b = MAX(band->b, ty);
 			}
 		}
+	}
+}
+
+static void CALLBACK shadow_capture_compare_work(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                                 void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	shadow_capture_compare_band(context);
+}
+
+static BOOL CALLBACK shadow_capture_pool_init(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                              WINPR_ATTR_UNUSED PVOID param,
+                                              WINPR_ATTR_UNUSED PVOID* context)
+{
+	SYSTEM_INFO sysInfos = { 0 };
+
+	/* Without a pool every frame is compared inline, so failure here is not fatal */
+	GetNativeSystemInfo(&sysInfos);
+	if (sysInfos.dwNumberOfProcessors <= 1)
+		return TRUE;
 
-		if (!rowEqual)
+	compare_pool = CreateThreadpool(NULL);
+	if (!compare_pool)
+	{
+		WLog_WARN(TAG, "CreateThreadpool failed, comparing frames single threaded");
+		return TRUE;
+	}
+
+	compare_threads = MIN(sysInfos.dwNumberOfProcessors, SHADOW_CAPTURE_MAX_BANDS);
+	InitializeThreadpoolEnvironment(&compare_env);
+	SetThreadpoolCallbackPool(&compare_env, compare_pool);
+	return TRUE;
+}
+
+static UINT32 shadow_capture_band_count(UINT32 nWidth, UINT32 nHeight, UINT32 nrow)
+{
+	if (1ull * nWidth * nHeight < SHADOW_CAPTURE_PARALLEL_THRESHOLD)
+		return 1;
+
+	InitOnceExecuteOnce(&compare_once, shadow_capture_pool_init, NULL, NULL);
+	if (!compare_pool)
+		return 1;
+
+	return MAX(1, MIN(compare_threads, nrow / SHADOW_CAPTURE_MIN_BAND_ROWS));
+}
+
+/**
+ * Compare both images in bands of tile rows, the first band is done by the calling thread.
+ *
+ * @return the number of changed tiles, \b result holds their bounds in tile units
+ */
+static size_t shadow_capture_compare_tiles_int(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                               UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                               const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                               UINT32 nStep2, BYTE* WINPR_RESTRICT tiles,
+                                               SHADOW_COMPARE_BAND* WINPR_RESTRICT result)
+{
+	SHADOW_PIXEL_COMPARE cmp = { 0 };
+	SHADOW_COMPARE_BAND bands[SHADOW_CAPTURE_MAX_BANDS] = { 0 };
+	PTP_WORK work[SHADOW_CAPTURE_MAX_BANDS] = { 0 };
+	const UINT32 nrow = (nHeight + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+	const UINT32 count = shadow_capture_band_count(nWidth, nHeight, nrow);
+
+	shadow_capture_compare_init(&cmp, format1, format2);
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		SHADOW_COMPARE_BAND* band = &bands[x];
+		band->cmp = &cmp;
+		band->pData1 = pData1;
+		band->nStep1 = nStep1;
+		band->pData2 = pData2;
+		band->nStep2 = nStep2;
+		band->nWidth = nWidth;
+		band->nHeight = nHeight;
+		band->firstRow = x * (nrow / count);
+		band->lastRow = (x + 1 == count) ? nrow : (x + 1) * (nrow / count);
+		band->tiles = tiles;
+
+		if (x == 0)
+			continue;
+
+		work[x] = CreateThreadpoolWork(shadow_capture_compare_work, band, &compare_env);
+		if (work[x])
+			SubmitThreadpoolWork(work[x]);
+		else
+			shadow_capture_compare_band(band);
+	}
+
+	shadow_capture_compare_band(&bands[0]);
+	*result = bands[0];
+
+	for (UINT32 x = 1; x < count; x++)
+	{
+		const SHADOW_COMPARE_BAND* band = &bands[x];
+
+		if (work[x])
 		{
-			allEqual = FALSE;
+			WaitForThreadpoolWorkCallbacks(work[x], FALSE);
+			CloseThreadpoolWork(work[x]);
+		}
 
-			if (t > ty)
-				t = (UINT32)ty;
+		if (band->changed == 0)
+			continue;
 
-			if (b < ty)
-				b = (UINT32)ty;
+		if (result->changed == 0)
+		{
+			result->t = band->t;
+			result->l = band->l;
+			result->r = band->r;
 		}
+		result->changed += band->changed;
+		result->l = MIN(result->l, band->l);
+		result->r = MAX(result->r, band->r);
+		result->b = band->b;
 	}
 
-	if (allEqual)
+	return result->changed;
+}
+
+int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                       UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                       const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                       UINT32 nStep2, RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	SHADOW_COMPARE_BAND result = { 0 };
+	const RECTANGLE_16 empty = { 0 };
+	WINPR_ASSERT(rect);
+
+	*rect = empty;
+
+	if (shadow_capture_compare_tiles_int(pData1, format1, nStep1, nWidth, nHeight, pData2,
+	                                     format2, nStep2, NULL, &result) == 0)
 		return 0;
 
-	WINPR_ASSERT(l * 16 <= UINT16_MAX);
-	WINPR_ASSERT(t * 16 <= UINT16_MAX);
-	WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
-	WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
-	rect->left = (UINT16)l * 16;
-	rect->top = (UINT16)t * 16;
-	rect->right = (UINT16)(r + 1) * 16;
-	rect->bottom = (UINT16)(b + 1) * 16;
+	WINPR_ASSERT(result.l * 16 <= UINT16_MAX);
+	WINPR_ASSERT(result.t * 16 <= UINT16_MAX);
+	WINPR_ASSERT((result.r + 1) * 16 <= UINT16_MAX);
+	WINPR_ASSERT((result.b + 1) * 16 <= UINT16_MAX);
+	rect->left = (UINT16)(result.l * 16);
+	rect->top = (UINT16)(result.t * 16);
+	rect->right = (UINT16)((result.r + 1) * 16);
+	rect->bottom = (UINT16)((result.b + 1) * 16);
 
 	WINPR_ASSERT(nWidth <= UINT16_MAX);
 	if (rect->right > nWidth)
@@ -310,6 +484,334 @@ int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32
 	return 1;
 }
 
+int shadow_capture_compare_tiles(const BYTE* WINPR_RESTRICT pData1, UINT32 format1, UINT32 nStep1,
+                                 UINT32 nWidth, UINT32 nHeight, const BYTE* WINPR_RESTRICT pData2,
+                                 UINT32 format2, UINT32 nStep2, BYTE* WINPR_RESTRICT tiles,
+                                 size_t count)
+{
+	SHADOW_COMPARE_BAND result = { 0 };
+	const size_t ncol = (nWidth + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+	const size_t nrow = (nHeight + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+
+	WINPR_ASSERT(pData1);
+	WINPR_ASSERT(pData2);
+	WINPR_ASSERT(tiles);
+
+	if (count < ncol * nrow)
+		return -1;
+
+	const size_t changed = shadow_capture_compare_tiles_int(
+	    pData1, format1, nStep1, nWidth, nHeight, pData2, format2, nStep2, tiles, &result);
+	WINPR_ASSERT(changed <= INT32_MAX);
+	return (int)changed;
+}
+
+BOOL shadow_capture_tiles_to_region(const BYTE* WINPR_RESTRICT tiles, UINT32 nWidth,
+                                    UINT32 nHeight, UINT16 nXDst, UINT16 nYDst,
+                                    REGION16* WINPR_RESTRICT region)
+{
+	const UINT32 ncol = (nWidth + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+	const UINT32 nrow = (nHeight + SHADOW_CAPTURE_TILE - 1) / SHADOW_CAPTURE_TILE;
+
+	WINPR_ASSERT(tiles);
+	WINPR_ASSERT(region);
+
+	if ((1ull * nXDst + nWidth > UINT16_MAX) || (1ull * nYDst + nHeight > UINT16_MAX))
+		return FALSE;
+
+	/* runs of changed tiles in a row become one rectangle, the region merges equal rows */
+	for (UINT32 ty = 0; ty < nrow; ty++)
+	{
+		const BYTE* row = &tiles[1ull * ty * ncol];
+
+		for (UINT32 tx = 0; tx < ncol; tx++)
+		{
+			if (!row[tx])
+				continue;
+
+			const UINT32 first = tx;
+			while ((tx + 1 < ncol) && row[tx + 1])
+				tx++;
+
+			const RECTANGLE_16 rect = {
+				(UINT16)(nXDst + first * SHADOW_CAPTURE_TILE),
+				(UINT16)(nYDst + ty * SHADOW_CAPTURE_TILE),
+				(UINT16)(nXDst + MIN((tx + 1) * SHADOW_CAPTURE_TILE, nWidth)),
+				(UINT16)(nYDst + MIN((ty + 1) * SHADOW_CAPTURE_TILE, nHeight))
+			};
+			if (!region16_union_rect(region, region, &rect))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* moves are searched in strips of this width (vertical moves) or height (horizontal moves) */
+#define SHADOW_MOVE_STRIP 64
+/* a move must cover at least this many lines and strips to be worth a SurfaceToSurface */
+#define SHADOW_MOVE_MIN_LINES 32
+#define SHADOW_MOVE_MIN_STRIPS 2
+#define SHADOW_MOVE_SAMPLES 16
+
+typedef struct
+{
+	INT32 shift;
+	UINT32 start;
+	UINT32 end;
+} SHADOW_MOVE_RUN;
+
+static UINT64 shadow_capture_hash_line(const BYTE* WINPR_RESTRICT data, size_t count, size_t stride,
+                                       UINT32 mask)
+{
+	UINT64 hash = 0xCBF29CE484222325ull;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		UINT32 pixel = 0;
+		memcpy(&pixel, &data[x * stride], sizeof(pixel));
+		hash = (hash ^ (pixel & mask)) * 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+/**
+ * Hash the lines of a strip: the rows of a strip with vertical lines, the columns otherwise.
+ */
+static void shadow_capture_hash_strip(const BYTE* WINPR_RESTRICT data, UINT32 nStep, UINT32 mask,
+                                      BOOL vertical, UINT32 offset, UINT32 size,
+                                      const RECTANGLE_16* rect, UINT64* WINPR_RESTRICT hashes)
+{
+	if (vertical)
+	{
+		for (UINT32 y = rect->top; y < rect->bottom; y++)
+			hashes[y - rect->top] = shadow_capture_hash_line(
+			    &data[1ull * y * nStep + 4ull * (rect->left + offset)], size, 4, mask);
+	}
+	else
+	{
+		for (UINT32 x = rect->left; x < rect->right; x++)
+			hashes[x - rect->left] = shadow_capture_hash_line(
+			    &data[1ull * (rect->top + offset) * nStep + 4ull * x], size, nStep, mask);
+	}
+}
+
+static UINT32 shadow_capture_run(const UINT64* WINPR_RESTRICT hashes1,
+                                 const UINT64* WINPR_RESTRICT hashes2, UINT32 count, INT32 shift,
+                                 UINT32* start)
+{
+	UINT32 best = 0;
+	UINT32 run = 0;
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		const INT64 y = 1ll * x + shift;
+		if ((y >= 0) && (y < count) && (hashes2[x] == hashes1[y]))
+		{
+			run++;
+			if (run > best)
+			{
+				best = run;
+				*start = x + 1 - run;
+			}
+		}
+		else
+			run = 0;
+	}
+
+	return best;
+}
+
+/**
+ * Find the shift of the longest run of lines of image 2 that is found in image 1.
+ * Only distinctive lines that changed are used to guess shifts, so uniform backgrounds do not
+ * produce arbitrary candidates.
+ */
+static BOOL shadow_capture_find_shift(const UINT64* WINPR_RESTRICT hashes1,
+                                      const UINT64* WINPR_RESTRICT hashes2, UINT32 count,
+                                      SHADOW_MOVE_RUN* result)
+{
+	INT32 tried[SHADOW_MOVE_SAMPLES] = { 0 };
+	size_t numTried = 0;
+	UINT32 best = 0;
+
+	for (UINT32 sample = 1; sample <= SHADOW_MOVE_SAMPLES; sample++)
+	{
+		const UINT32 x = count * sample / (SHADOW_MOVE_SAMPLES + 1);
+		if ((x == 0) || (x + 1 >= count))
+			continue;
+		if ((hashes2[x] == hashes1[x]) || (hashes2[x] == hashes2[x - 1]) ||
+		    (hashes2[x] == hashes2[x + 1]))
+			continue;
+
+		INT32 shift = 0;
+		for (UINT32 d = 1; (d < count / 2) && (shift == 0); d++)
+		{
+			if ((x + d < count) && (hashes1[x + d] == hashes2[x]))
+				shift = (INT32)d;
+			else if ((x >= d) && (hashes1[x - d] == hashes2[x]))
+				shift = -(INT32)d;
+		}
+
+		BOOL known = (shift == 0);
+		for (size_t y = 0; !known && (y < numTried); y++)
+			known = (tried[y] == shift);
+		if (known)
+			continue;
+		tried[numTried++] = shift;
+
+		UINT32 start = 0;
+		const UINT32 run = shadow_capture_run(hashes1, hashes2, count, shift, &start);
+		if (run > best)
+		{
+			best = run;
+			result->shift = shift;
+			result->start = start;
+			result->end = start + run;
+		}
+	}
+
+	return best >= SHADOW_MOVE_MIN_LINES;
+}
+
+static BOOL shadow_capture_detect_move_axis(const BYTE* WINPR_RESTRICT pData1, UINT32 nStep1,
+                                            const BYTE* WINPR_RESTRICT pData2, UINT32 nStep2,
+                                            UINT32 mask, BOOL vertical, const RECTANGLE_16* rect,
+                                            RECTANGLE_16* WINPR_RESTRICT src,
+                                            RECTANGLE_16* WINPR_RESTRICT dst)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = rect->right - rect->left;
+	const UINT32 height = rect->bottom - rect->top;
+	const UINT32 count = vertical ? height : width;
+	const UINT32 length = vertical ? width : height;
+	const UINT32 numStrips = (length + SHADOW_MOVE_STRIP - 1) / SHADOW_MOVE_STRIP;
+	UINT64 bestArea = 0;
+
+	if ((count < SHADOW_MOVE_MIN_LINES) || (numStrips < SHADOW_MOVE_MIN_STRIPS))
+		return FALSE;
+
+	UINT64* hashes1 = calloc(count, sizeof(UINT64));
+	UINT64* hashes2 = calloc(count, sizeof(UINT64));
+	SHADOW_MOVE_RUN* runs = calloc(numStrips, sizeof(SHADOW_MOVE_RUN));
+	BOOL* found = calloc(numStrips, sizeof(BOOL));
+	if (!hashes1 || !hashes2 || !runs || !found)
+		goto fail;
+
+	for (UINT32 strip = 0; strip < numStrips; strip++)
+	{
+		const UINT32 offset = strip * SHADOW_MOVE_STRIP;
+		const UINT32 size = MIN(SHADOW_MOVE_STRIP, length - offset);
+		shadow_capture_hash_strip(pData1, nStep1, mask, vertical, offset, size, rect, hashes1);
+		shadow_capture_hash_strip(pData2, nStep2, mask, vertical, offset, size, rect, hashes2);
+		found[strip] = shadow_capture_find_shift(hashes1, hashes2, count, &runs[strip]);
+	}
+
+	/* neighbouring strips with the same shift form the moved area, a scrollbar or a side panel
+	 * that changed differently only ends it */
+	for (UINT32 first = 0; first < numStrips; first++)
+	{
+		if (!found[first])
+			continue;
+
+		UINT32 start = runs[first].start;
+		UINT32 end = runs[first].end;
+		UINT32 last = first;
+		while ((last + 1 < numStrips) && found[last + 1] &&
+		       (runs[last + 1].shift == runs[first].shift) &&
+		       (MAX(start, runs[last + 1].start) + SHADOW_MOVE_MIN_LINES <=
+		        MIN(end, runs[last + 1].end)))
+		{
+			last++;
+			start = MAX(start, runs[last].start);
+			end = MIN(end, runs[last].end);
+		}
+
+		const UINT32 from = first * SHADOW_MOVE_STRIP;
+		const UINT32 to = MIN((last + 1) * SHADOW_MOVE_STRIP, length);
+		const UINT64 area = 1ull * (to - from) * (end - start);
+		if ((last + 1 - first >= SHADOW_MOVE_MIN_STRIPS) && (area > bestArea))
+		{
+			const INT32 shift = runs[first].shift;
+			bestArea = area;
+			if (vertical)
+			{
+				dst->left = (UINT16)(rect->left + from);
+				dst->right = (UINT16)(rect->left + to);
+				dst->top = (UINT16)(rect->top + start);
+				dst->bottom = (UINT16)(rect->top + end);
+				*src = *dst;
+				src->top = (UINT16)(src->top + shift);
+				src->bottom = (UINT16)(src->bottom + shift);
+			}
+			else
+			{
+				dst->top = (UINT16)(rect->top + from);
+				dst->bottom = (UINT16)(rect->top + to);
+				dst->left = (UINT16)(rect->left + start);
+				dst->right = (UINT16)(rect->left + end);
+				*src = *dst;
+				src->left = (UINT16)(src->left + shift);
+				src->right = (UINT16)(src->right + shift);
+			}
+			rc = TRUE;
+		}
+		first = last;
+	}
+
+fail:
+	free(hashes1);
+	free(hashes2);
+	free(runs);
+	free(found);
+	return rc;
+}
+
+BOOL shadow_capture_detect_move(const BYTE* WINPR_RESTRICT pData1, UINT32 format1, UINT32 nStep1,
+                                const BYTE* WINPR_RESTRICT pData2, UINT32 format2, UINT32 nStep2,
+                                const RECTANGLE_16* WINPR_RESTRICT rect,
+                                RECTANGLE_16* WINPR_RESTRICT src, RECTANGLE_16* WINPR_RESTRICT dst)
+{
+	WINPR_ASSERT(pData1);
+	WINPR_ASSERT(pData2);
+	WINPR_ASSERT(rect);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(dst);
+
+	/* lines are hashed as 32 bit words, both images need the same layout apart from alpha */
+	if ((FreeRDPGetBitsPerPixel(format1) != 32) || (FreeRDPGetBitsPerPixel(format2) != 32) ||
+	    !FreeRDPAreColorFormatsEqualNoAlpha(format1, format2))
+		return FALSE;
+
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+		return FALSE;
+
+	UINT32 mask = 0xFFFFFFFF;
+	if (FreeRDPColorHasAlpha(format1) || FreeRDPColorHasAlpha(format2))
+		mask = shadow_capture_no_alpha_mask(format1);
+
+	if (!shadow_capture_detect_move_axis(pData1, nStep1, pData2, nStep2, mask, TRUE, rect, src,
+	                                     dst) &&
+	    !shadow_capture_detect_move_axis(pData1, nStep1, pData2, nStep2, mask, FALSE, rect, src,
+	                                     dst))
+		return FALSE;
+
+	/* hashes only point to the move, make sure the content really is the same */
+	SHADOW_PIXEL_COMPARE cmp = { 0 };
+	shadow_capture_compare_init(&cmp, format1, format2);
+	const UINT32 width = src->right - src->left;
+	for (UINT32 y = 0; y < (UINT32)(src->bottom - src->top); y++)
+	{
+		const BYTE* p1 = &pData1[1ull * (src->top + y) * nStep1 + 4ull * src->left];
+		const BYTE* p2 = &pData2[1ull * (dst->top + y) * nStep2 + 4ull * dst->left];
+		if (!shadow_capture_pixels_equal(&cmp, p1, p2, width))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
 {
 	WINPR_ASSERT(server);
@@ -31,18 +31,37 @@
 #include <winpr/interlocked.h>
 
 #include <freerdp/log.h>
+#include <freerdp/event.h>
+#include <freerdp/metrics.h>
+#include <freerdp/utils/tracepoint.h>
 #include <freerdp/channels/drdynvc.h>
 
 #include "shadow.h"
 
 #define TAG CLIENT_TAG("shadow")
 
+/* upper bound of buffered PDUs read in one go before their input is dispatched */
+#define SHADOW_CLIENT_MAX_INPUT_DRAIN 64
+
+/* how often a frame held back by a congested connection retries to go out, in ms */
+#define SHADOW_CLIENT_BLOCKED_RETRY 5
+
+/* the pointers a client keeps, the shape of every slot is identified by its hash */
+#define SHADOW_POINTER_CACHE_SLOTS 32
+
 typedef struct
 {
 	BOOL gfxOpened;
 	BOOL gfxSurfaceCreated;
 } SHADOW_GFX_STATUS;
 
+struct rdp_shadow_pointer_cache
+{
+	UINT64 shown;
+	UINT32 next;
+	UINT64 slots[SHADOW_POINTER_CACHE_SLOTS];
+};
+
 /* See https://github.com/FreeRDP/FreeRDP/issues/10413
  *
  * Microsoft ditched support for RFX and multiple rectangles in BitmapUpdate for
@@ -218,6 +237,18 @@ static INLINE void shadow_client_free_queued_message(void* obj)
 	}
 }
 
+static void shadow_client_network_characteristics_change(
+    void* context, const NetworkCharacteristicsChangeEventArgs* e)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(e);
+
+	if (client->encoder && !shadow_encoder_update_network(client->encoder, e->bandwidth))
+		WLog_WARN(TAG, "failed to adjust the encoder to %" PRIu32 " kbit/s", e->bandwidth);
+}
+
 static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 {
 	rdpShadowClient* client = (rdpShadowClient*)context;
@@ -231,7 +262,11 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 	if (server && server->clients)
 		ArrayList_Remove(server->clients, (void*)client);
 
+	PubSub_UnsubscribeNetworkCharacteristicsChange(context->pubSub,
+	                                               shadow_client_network_characteristics_change);
 	shadow_encoder_free(client->encoder);
+	shadow_input_queue_free(client->inputQueue);
+	free(client->pointerCache);
 
 	/* Clear queued messages and free resource */
 	MessageQueue_Free(client->MsgQueue);
@@ -241,6 +276,8 @@ static void shadow_client_context_free(freerdp_peer* peer, rdpContext* context)
 
 	client->MsgQueue = NULL;
 	client->encoder = NULL;
+	client->inputQueue = NULL;
+	client->pointerCache = NULL;
 	client->vcm = NULL;
 }
 
@@ -306,6 +343,10 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 		return FALSE;
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP8))
 		return FALSE;
+	if (!freerdp_settings_set_uint32(
+	        settings, FreeRDP_NetworkAutoDetectInterval,
+	        freerdp_settings_get_uint32(srvSettings, FreeRDP_NetworkAutoDetectInterval)))
+		return FALSE;
 
 	if (server->ipcSocket && (strncmp(bind_address, server->ipcSocket,
 	                                  strnlen(bind_address, sizeof(bind_address))) != 0))
@@ -329,12 +370,22 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 	if (!client->vcm || client->vcm == INVALID_HANDLE_VALUE)
 		goto fail;
 
-	if (!(client->MsgQueue = MessageQueue_New(&cb)))
+	if (!(client->MsgQueue = MessageQueue_NewEx(&cb, WMQ_FLAG_SINGLE_CONSUMER)))
 		goto fail;
 
 	if (!(client->encoder = shadow_encoder_new(client)))
 		goto fail;
 
+	if (!(client->inputQueue = shadow_input_queue_new()))
+		goto fail;
+
+	if (!(client->pointerCache = calloc(1, sizeof(rdpShadowPointerCache))))
+		goto fail;
+
+	if (PubSub_SubscribeNetworkCharacteristicsChange(
+	        context->pubSub, shadow_client_network_characteristics_change) < 0)
+		goto fail;
+
 	if (!ArrayList_Append(server->clients, (void*)client))
 		goto fail;
 
@@ -362,10 +413,7 @@ static INLINE void shadow_client_mark_invalid(rdpShadowClient* client, UINT32 nu
 	/* Mark client invalid region. No rectangle means full screen */
 	if (numRects > 0)
 	{
-		for (UINT32 index = 0; index < numRects; index++)
-		{
-			region16_union_rect(&(client->invalidRegion), &(client->invalidRegion), &rects[index]);
-		}
+		region16_union_rects(&(client->invalidRegion), &(client->invalidRegion), rects, numRects);
 	}
 	else
 	{
@@ -671,6 +719,10 @@ static BOOL shadow_client_refresh_rect(rdpContext* context, BYTE count, const RE
 		shadow_client_mark_invalid(client, 0, NULL);
 	}
 
+	/* the client asks for content it should already have, do not skip anything */
+	if (client->encoder)
+		shadow_encoder_invalidate_tiles(client->encoder, FALSE);
+
 	return shadow_client_refresh_request(client);
 }
 
@@ -694,6 +746,9 @@ static BOOL shadow_client_suppress_output(rdpContext* context, BYTE allow, const
 		{
 			shadow_client_mark_invalid(client, 0, NULL);
 		}
+
+		if (client->encoder)
+			shadow_encoder_invalidate_tiles(client->encoder, FALSE);
 	}
 
 	return shadow_client_refresh_request(client);
@@ -712,6 +767,9 @@ static BOOL shadow_client_activate(freerdp_peer* peer)
 
 	shadow_reset_desktop_resize(client);
 	client->activated = TRUE;
+
+	/* a reactivated client starts with an empty pointer cache */
+	ZeroMemory(client->pointerCache, sizeof(rdpShadowPointerCache));
 	client->inLobby = client->mayView ? FALSE : TRUE;
 
 	if (shadow_encoder_reset(client->encoder) < 0)
@@ -806,7 +864,7 @@ static INLINE void shadow_client_common_frame_acknowledge(rdpShadowClient* clien
 	 */
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->encoder);
-	client->encoder->lastAckframeId = frameId;
+	shadow_encoder_frame_acknowledged(client->encoder, frameId);
 }
 
 static BOOL shadow_client_surface_frame_acknowledge(rdpContext* context, UINT32 frameId)
@@ -840,6 +898,21 @@ shadow_client_rdpgfx_frame_acknowledge(RdpgfxServerContext* context,
 	return CHANNEL_RC_OK;
 }
 
+static UINT shadow_client_rdpgfx_qoe_frame_acknowledge(
+    RdpgfxServerContext* context, const RDPGFX_QOE_FRAME_ACKNOWLEDGE_PDU* qoeFrameAcknowledge)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(qoeFrameAcknowledge);
+
+	rdpShadowClient* client = (rdpShadowClient*)context->custom;
+	WINPR_ASSERT(client);
+
+	/* start to end of the frame plus end of the frame to rendered, in milliseconds */
+	shadow_encoder_frame_decoded(client->encoder, 1u * qoeFrameAcknowledge->timeDiffSE +
+	                                                  qoeFrameAcknowledge->timeDiffEDR);
+	return CHANNEL_RC_OK;
+}
+
 static BOOL shadow_are_caps_filtered(const rdpSettings* settings, UINT32 caps)
 {
 	const UINT32 capList[] = { RDPGFX_CAPVERSION_8,   RDPGFX_CAPVERSION_81,
@@ -871,6 +944,10 @@ static UINT shadow_client_send_caps_confirm(RdpgfxServerContext* context, rdpSha
 	WINPR_ASSERT(context->CapsConfirm);
 	UINT rc = context->CapsConfirm(context, pdu);
 	client->areGfxCapsReady = (rc == CHANNEL_RC_OK);
+
+	/* the client cache lives as long as the channel, surfaces and resets do not clear it */
+	if (client->encoder)
+		shadow_encoder_invalidate_tiles(client->encoder, TRUE);
 	return rc;
 }
 
@@ -904,6 +981,7 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 		{
 			UINT32 flags = 0;
 			BOOL planar = FALSE;
+			BOOL clear = FALSE;
 			BOOL rfx = FALSE;
 			BOOL avc444v2 = FALSE;
 			BOOL avc444 = FALSE;
@@ -948,6 +1026,10 @@ static BOOL shadow_client_caps_test_version(RdpgfxServerContext* context, rdpSha
 			if (!freerdp_settings_set_bool(clientSettings, FreeRDP_GfxPlanar, planar))
 				return FALSE;
 
+			clear = freerdp_settings_get_bool(srvSettings, FreeRDP_GfxClearCodec);
+			if (!freerdp_settings_set_bool(clientSettings, FreeRDP_GfxClearCodec, clear))
+				return FALSE;
+
 			if (!avc444v2 && !avc444 && !avc420)
 				pdu.capsSet->flags |= RDPGFX_CAPS_FLAG_AVC_DISABLED;
 
@@ -1140,250 +1222,1316 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+typedef struct
+{
+	UINT16 cacheSlot;
+	UINT64 cacheKey;
+	RECTANGLE_16 rect;
+} SHADOW_GFX_CACHE_TILE;
+
+typedef struct
+{
+	REGION16 region;   /* the area that still needs to be encoded */
+	REGION16 lossless; /* text and UI of a lossy session, encoded with planar */
+	size_t numSolid;   /* single coloured areas, sent with SolidFill */
+	size_t maxSolid;
+	RECTANGLE_16* solidRects;
+	UINT32* solidColors;
+	BOOL move; /* content moved by the capture, replayed with a SurfaceToSurface */
+	RECTANGLE_16 moveSrc;
+	RDPGFX_POINT16 moveDst;
+	size_t numCacheToSurface;
+	SHADOW_GFX_CACHE_TILE* cacheToSurface;
+	size_t numSurfaceToCache;
+	SHADOW_GFX_CACHE_TILE* surfaceToCache;
+	BOOL coarse; /* tiles are sent at a coarse quality first, a cache slot would keep that */
+} SHADOW_GFX_CACHE_FRAME;
+
+static void shadow_client_gfx_cache_frame_uninit(SHADOW_GFX_CACHE_FRAME* frame)
+{
+	WINPR_ASSERT(frame);
+	region16_uninit(&frame->region);
+	region16_uninit(&frame->lossless);
+	free(frame->solidRects);
+	free(frame->solidColors);
+	free(frame->cacheToSurface);
+	free(frame->surfaceToCache);
+}
+
 /**
- * Function description
- *
- * @return TRUE on success
+ * Replay a move found by the capture with a SurfaceToSurface. Tiles completely inside the
+ * destination show the current content afterwards and are skipped by the cache lookup, the
+ * others are encoded again.
  */
-static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE* pSrcData,
-                                           UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nXSrc,
-                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
+static void shadow_client_gfx_cache_move(rdpShadowClient* client, const BYTE* pSrcData,
+                                         UINT32 nSrcStep, const RECTANGLE_16* src,
+                                         const RECTANGLE_16* dst, SHADOW_GFX_CACHE_FRAME* frame)
 {
-	UINT32 id = 0;
-	UINT error = CHANNEL_RC_OK;
-	const rdpContext* context = (const rdpContext*)client;
-	const rdpSettings* settings = NULL;
-	rdpShadowEncoder* encoder = NULL;
-	RDPGFX_SURFACE_COMMAND cmd = { 0 };
-	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
-	RDPGFX_END_FRAME_PDU cmdend = { 0 };
-	SYSTEMTIME sTime = { 0 };
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(frame);
 
-	if (!context || !pSrcData)
-		return FALSE;
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
 
-	settings = context->settings;
-	encoder = client->encoder;
+	if (!src || !dst || !encoder->tileHashes)
+		return;
 
-	if (!settings || !encoder)
-		return FALSE;
+	frame->move = TRUE;
+	frame->moveSrc = *src;
+	frame->moveDst.x = dst->left;
+	frame->moveDst.y = dst->top;
 
-	if (client->first_frame)
+	const UINT32 endX = MIN((dst->right + 63) / 64, encoder->tileGridWidth);
+	const UINT32 endY = MIN((dst->bottom + 63) / 64, encoder->tileGridHeight);
+	for (UINT32 y = dst->top / 64; y < endY; y++)
 	{
-		rfx_context_reset(encoder->rfx, nWidth, nHeight);
-		client->first_frame = FALSE;
-	}
+		for (UINT32 x = dst->left / 64; x < endX; x++)
+		{
+			const size_t index = 1ull * y * encoder->tileGridWidth + x;
 
-	cmdstart.frameId = shadow_encoder_create_frame_id(encoder);
-	GetSystemTime(&sTime);
-	cmdstart.timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U | sTime.wSecond << 10U |
-	                              sTime.wMilliseconds);
-	cmdend.frameId = cmdstart.frameId;
-	cmd.surfaceId = client->surfaceId;
-	cmd.format = PIXEL_FORMAT_BGRX32;
-	cmd.left = nXSrc;
-	cmd.top = nYSrc;
-	cmd.right = cmd.left + nWidth;
-	cmd.bottom = cmd.top + nHeight;
-	cmd.width = nWidth;
-	cmd.height = nHeight;
+			if ((x * 64 < dst->left) || (y * 64 < dst->top) || (x * 64 + 64 > dst->right) ||
+			    (y * 64 + 64 > dst->bottom))
+				encoder->tileHashes[index] = 0;
+			else
+				encoder->tileHashes[index] = rfx_tile_hash(
+				    &pSrcData[64ull * y * nSrcStep + 256ull * x], 64, 64, nSrcStep, 4);
+		}
+	}
 
-	id = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
-#ifdef WITH_GFX_H264
-	const BOOL GfxH264 = freerdp_settings_get_bool(settings, FreeRDP_GfxH264);
-	const BOOL GfxAVC444 = freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444);
-	const BOOL GfxAVC444v2 = freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444v2);
-	if (GfxAVC444 || GfxAVC444v2)
-	{
-		INT32 rc = 0;
-		RDPGFX_AVC444_BITMAP_STREAM avc444 = { 0 };
-		RECTANGLE_16 regionRect = { 0 };
-		BYTE version = GfxAVC444v2 ? 2 : 1;
+	/* the codecs do not know the content changed */
+	if (encoder->rfx)
+		rfx_context_invalidate_tile_cache(encoder->rfx, dst);
+	if (encoder->progressive)
+		progressive_context_invalidate_tile_cache(encoder->progressive, dst);
+}
 
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC444) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC444");
-			return FALSE;
-		}
+/* Run fn over count items on the thread pool of the encoder, without one on this thread */
+static BOOL shadow_client_parallel_for(rdpShadowEncoder* encoder, size_t count, size_t grain,
+                                       WINPR_PARALLEL_FOR_CALLBACK fn, void* context)
+{
+	WINPR_ASSERT(encoder);
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		regionRect.left = (UINT16)cmd.left;
-		regionRect.top = (UINT16)cmd.top;
-		regionRect.right = (UINT16)cmd.right;
-		regionRect.bottom = (UINT16)cmd.bottom;
-		rc = avc444_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
-		                     version, &regionRect, &avc444.LC, &avc444.bitstream[0].data,
-		                     &avc444.bitstream[0].length, &avc444.bitstream[1].data,
-		                     &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
-		                     &avc444.bitstream[1].meta);
-		if (rc < 0)
-		{
-			WLog_ERR(TAG, "avc420_compress failed for avc444");
-			return FALSE;
-		}
+	if (encoder->parallel)
+		return winpr_ParallelFor(encoder->parallel, count, grain, fn, context);
+	return fn(context, 0, count);
+}
 
-		/* rc > 0 means new data */
-		if (rc > 0)
-		{
-			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
-			cmd.codecId = GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
-			cmd.extra = (void*)&avc444;
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
-		}
+typedef struct
+{
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	const RECTANGLE_16* rect;
+	UINT32 startX;
+	UINT32 startY;
+	UINT32 columns;
+	UINT64* hashes;
+} SHADOW_GFX_HASH_WORK;
+
+/* hash the complete tiles of some tile rows of the update */
+static BOOL shadow_client_gfx_hash_rows(void* arg, size_t begin, size_t end)
+{
+	const SHADOW_GFX_HASH_WORK* work = arg;
+	WINPR_ASSERT(work);
 
-		free_h264_metablock(&avc444.bitstream[0].meta);
-		free_h264_metablock(&avc444.bitstream[1].meta);
-		if (error)
-		{
-			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
-		}
-	}
-	else if (GfxH264)
+	for (size_t row = begin; row < end; row++)
 	{
-		INT32 rc = 0;
-		RDPGFX_AVC420_BITMAP_STREAM avc420 = { 0 };
-		RECTANGLE_16 regionRect;
+		const size_t top = (work->startY + row) * 64;
+		if ((top < work->rect->top) || (top + 64 > work->rect->bottom))
+			continue;
 
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC420) < 0)
+		for (size_t column = 0; column < work->columns; column++)
 		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC420");
-			return FALSE;
-		}
+			const size_t left = (work->startX + column) * 64;
+			if ((left < work->rect->left) || (left + 64 > work->rect->right))
+				continue;
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		regionRect.left = (UINT16)cmd.left;
-		regionRect.top = (UINT16)cmd.top;
-		regionRect.right = (UINT16)cmd.right;
-		regionRect.bottom = (UINT16)cmd.bottom;
-		rc = avc420_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
-		                     &regionRect, &avc420.data, &avc420.length, &avc420.meta);
-		if (rc < 0)
-		{
-			WLog_ERR(TAG, "avc420_compress failed");
-			return FALSE;
+			work->hashes[row * work->columns + column] = rfx_tile_hash(
+			    &work->pSrcData[top * work->nSrcStep + 4 * left], 64, 64, work->nSrcStep, 4);
 		}
+	}
+	return TRUE;
+}
 
-		/* rc > 0 means new data */
-		if (rc > 0)
-		{
-			cmd.codecId = RDPGFX_CODECID_AVC420;
-			cmd.extra = (void*)&avc420;
+/**
+ * Split the update in 64x64 tiles and decide for each of them if
+ *  - the client already shows the content: skip it
+ *  - the content is in a client cache slot: send a CacheToSurface
+ *  - the content repeats: encode it and store it in a cache slot after the surface command,
+ *    unless the frame is coarse
+ *  - otherwise just encode it
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_gfx_cache_prepare(rdpShadowClient* client, const BYTE* pSrcData,
+                                            UINT32 nSrcStep, const RECTANGLE_16* rect,
+                                            SHADOW_GFX_CACHE_FRAME* frame)
+{
+	BOOL rc = FALSE;
+	size_t numRects = 0;
+	RECTANGLE_16* rects = NULL;
+	UINT64* hashes = NULL;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
-		}
-		free_h264_metablock(&avc420.meta);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(rect);
+	WINPR_ASSERT(frame);
 
-		if (error)
-		{
-			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
-		}
-	}
-	else
-#endif
-	    if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0))
-	{
-		BOOL rc = 0;
-		wStream* s = NULL;
-		RFX_RECT rect;
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
 
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
-			return FALSE;
-		}
+	region16_init(&frame->region);
+	if ((rect->right <= rect->left) || (rect->bottom <= rect->top))
+		return TRUE;
 
-		s = Stream_New(NULL, 1024);
-		WINPR_ASSERT(s);
+	if (!encoder->tileHashes || !encoder->cacheKeys || !encoder->cacheCandidates)
+		return region16_union_rect(&frame->region, &frame->region, rect);
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		rect.x = (UINT16)cmd.left;
-		rect.y = (UINT16)cmd.top;
-		rect.width = WINPR_ASSERTING_INT_CAST(UINT16, cmd.right - cmd.left);
-		rect.height = WINPR_ASSERTING_INT_CAST(UINT16, cmd.bottom - cmd.top);
+	const UINT32 startX = rect->left / 64;
+	const UINT32 startY = rect->top / 64;
+	const UINT32 endX = (rect->right + 63) / 64;
+	const UINT32 endY = (rect->bottom + 63) / 64;
+	const size_t maxTiles = 1ull * (endX - startX) * (endY - startY);
 
-		rc = rfx_compose_message(encoder->rfx, s, &rect, 1, pSrcData, nWidth, nHeight, nSrcStep);
+	rects = calloc(maxTiles, sizeof(RECTANGLE_16));
+	hashes = calloc(maxTiles, sizeof(UINT64));
+	frame->cacheToSurface = calloc(maxTiles, sizeof(SHADOW_GFX_CACHE_TILE));
+	frame->surfaceToCache = calloc(maxTiles, sizeof(SHADOW_GFX_CACHE_TILE));
+	if (!rects || !hashes || !frame->cacheToSurface || !frame->surfaceToCache)
+		goto fail;
 
-		if (!rc)
-		{
-			WLog_ERR(TAG, "rfx_compose_message failed");
-			Stream_Free(s, TRUE);
-			return FALSE;
-		}
+	/* hashing reads every pixel, the bookkeeping below is cheap and kept in order */
+	SHADOW_GFX_HASH_WORK work = { pSrcData, nSrcStep, rect, startX, startY, endX - startX, hashes };
+	if (!shadow_client_parallel_for(encoder, endY - startY, 0, shadow_client_gfx_hash_rows,
+	                                &work))
+		goto fail;
 
-		/* rc > 0 means new data */
-		if (rc > 0)
+	for (UINT32 y = startY; y < endY; y++)
+	{
+		for (UINT32 x = startX; x < endX; x++)
 		{
-			const size_t pos = Stream_GetPosition(s);
-			WINPR_ASSERT(pos <= UINT32_MAX);
+			const RECTANGLE_16 tileRect = { WINPR_ASSERTING_INT_CAST(UINT16, x * 64),
+				                            WINPR_ASSERTING_INT_CAST(UINT16, y * 64),
+				                            WINPR_ASSERTING_INT_CAST(UINT16, x * 64 + 64),
+				                            WINPR_ASSERTING_INT_CAST(UINT16, y * 64 + 64) };
+			const BOOL inGrid = (x < encoder->tileGridWidth) && (y < encoder->tileGridHeight);
+			const size_t index = 1ull * y * encoder->tileGridWidth + x;
+
+			/* only complete tiles are cached, partial ones are always encoded */
+			if (!inGrid || (tileRect.left < rect->left) || (tileRect.top < rect->top) ||
+			    (tileRect.right > rect->right) || (tileRect.bottom > rect->bottom))
+			{
+				if (inGrid)
+					encoder->tileHashes[index] = 0;
+				if (!rectangles_intersection(&tileRect, rect, &rects[numRects]))
+					continue;
+				numRects++;
+				continue;
+			}
 
-			cmd.codecId = RDPGFX_CODECID_CAVIDEO;
-			cmd.data = Stream_Buffer(s);
-			cmd.length = (UINT32)pos;
+			const UINT64 hash = hashes[1ull * (y - startY) * work.columns + (x - startX)];
+			if (encoder->tileHashes[index] == hash)
+				continue;
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
-		}
+			encoder->tileHashes[index] = hash;
 
-		Stream_Free(s, TRUE);
-		if (error)
-		{
-			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			const size_t slot = hash % SHADOW_GFX_CACHE_SLOTS;
+			if (encoder->cacheKeys[slot] == hash)
+			{
+				SHADOW_GFX_CACHE_TILE* tile = &frame->cacheToSurface[frame->numCacheToSurface++];
+				tile->cacheSlot = (UINT16)(slot + 1);
+				tile->cacheKey = hash;
+				tile->rect = tileRect;
+
+				/* the codecs do not know the tile content changed */
+				if (encoder->rfx)
+					rfx_context_invalidate_tile_cache(encoder->rfx, &tileRect);
+				if (encoder->progressive)
+					progressive_context_invalidate_tile_cache(encoder->progressive, &tileRect);
+				continue;
+			}
+
+			rects[numRects++] = tileRect;
+			if (frame->coarse)
+				continue;
+
+			const size_t candidate = (hash >> 32) % SHADOW_GFX_CACHE_CANDIDATES;
+			if (encoder->cacheCandidates[candidate] == hash)
+			{
+				SHADOW_GFX_CACHE_TILE* tile = &frame->surfaceToCache[frame->numSurfaceToCache++];
+				tile->cacheSlot = (UINT16)(slot + 1);
+				tile->cacheKey = hash;
+				tile->rect = tileRect;
+				encoder->cacheKeys[slot] = hash;
+			}
+			else
+				encoder->cacheCandidates[candidate] = hash;
 		}
 	}
-	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
-	{
-		INT32 rc = 0;
-		REGION16 region;
-		RECTANGLE_16 regionRect;
 
-		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PROGRESSIVE) < 0)
-		{
-			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PROGRESSIVE");
-			return FALSE;
-		}
+	WINPR_ASSERT(numRects <= UINT32_MAX);
+	rc = region16_union_rects(&frame->region, &frame->region, rects, (UINT32)numRects);
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		regionRect.left = (UINT16)cmd.left;
-		regionRect.top = (UINT16)cmd.top;
-		regionRect.right = (UINT16)cmd.right;
-		regionRect.bottom = (UINT16)cmd.bottom;
-		region16_init(&region);
-		region16_union_rect(&region, &region, &regionRect);
-		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, cmd.format,
-		                          nWidth, nHeight, nSrcStep, &region, &cmd.data, &cmd.length);
-		region16_uninit(&region);
-		if (rc < 0)
-		{
+fail:
+	free(hashes);
+	free(rects);
+	if (!rc)
+		shadow_encoder_invalidate_tiles(encoder, TRUE);
+	return rc;
+}
+
+/**
+ * Function description
+ *
+ * @return TRUE on success
+ */
+static void shadow_client_encode_done(rdpShadowClient* client, const char* metric, UINT64 start)
+{
+	rdpMetrics* metrics = client->context.metrics;
+	const UINT64 us = (winpr_GetTickCount64NS() - start) / 1000;
+	(void)metrics_record(metrics, metrics_register(metrics, metric, FREERDP_METRIC_HISTOGRAM), us);
+}
+
+#define SHADOW_GFX_TEXT_COLORS 64
+#define SHADOW_GFX_EDGE_LUMA 48
+#define SHADOW_GFX_ACTIVITY_STEP 32
+#define SHADOW_GFX_ACTIVITY_MAX 1024
+#define SHADOW_GFX_VIDEO_ACTIVITY 128
+#define SHADOW_GFX_MOTION_ACTIVITY 512
+#define SHADOW_AVC420_QP_MOTION 4
+#define SHADOW_AVC420_QP_STILL 6
+
+typedef enum
+{
+	SHADOW_GFX_CONTENT_SOLID,
+	SHADOW_GFX_CONTENT_TEXT,
+	SHADOW_GFX_CONTENT_VIDEO
+} SHADOW_GFX_CONTENT;
+
+/**
+ * Classify (a part of) a tile. A single colour is solid, few colours are text or UI. With many
+ * colours a high density of sharp edges still means text unless the tile keeps changing,
+ * everything else is video or photo like.
+ */
+static SHADOW_GFX_CONTENT shadow_client_gfx_classify_rect(const BYTE* pSrcData, UINT32 nSrcStep,
+                                                          const RECTANGLE_16* rect,
+                                                          UINT16 activity, UINT32* color)
+{
+	UINT32 colors[SHADOW_GFX_TEXT_COLORS * 2] = { 0 };
+	size_t numColors = 0;
+	size_t edges = 0;
+	const UINT32 width = 1u * rect->right - rect->left;
+	const UINT32 height = 1u * rect->bottom - rect->top;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* line = &pSrcData[1ull * (rect->top + y) * nSrcStep + 4ull * rect->left];
+		UINT32 last = 0;
+		INT32 lastLuma = 0;
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const BYTE* px = &line[4ull * x];
+			const UINT32 value = 0xFF000000 | ((UINT32)px[2] << 16) | ((UINT32)px[1] << 8) | px[0];
+			const INT32 luma = (px[2] * 2 + px[1] * 5 + px[0]) >> 3;
+
+			if ((x > 0) && (abs(luma - lastLuma) > SHADOW_GFX_EDGE_LUMA))
+				edges++;
+			lastLuma = luma;
+
+			if ((value == last) || (numColors > SHADOW_GFX_TEXT_COLORS))
+				continue;
+			last = value;
+
+			/* open addressing, the table is never more than half full */
+			size_t slot = (value * 2654435761u) >> 25;
+			while ((colors[slot] != 0) && (colors[slot] != value))
+				slot = (slot + 1) % ARRAYSIZE(colors);
+
+			if (colors[slot] == 0)
+			{
+				colors[slot] = value;
+				*color = value & 0x00FFFFFF;
+				numColors++;
+			}
+		}
+	}
+
+	if (numColors == 1)
+		return SHADOW_GFX_CONTENT_SOLID;
+
+	if (numColors <= SHADOW_GFX_TEXT_COLORS)
+		return SHADOW_GFX_CONTENT_TEXT;
+
+	if ((activity < SHADOW_GFX_VIDEO_ACTIVITY) && (edges * 8 >= 1ull * width * height))
+		return SHADOW_GFX_CONTENT_TEXT;
+
+	return SHADOW_GFX_CONTENT_VIDEO;
+}
+
+static BOOL shadow_client_gfx_add_solid(SHADOW_GFX_CACHE_FRAME* frame, const RECTANGLE_16* rect,
+                                        UINT32 color)
+{
+	WINPR_ASSERT(frame);
+	WINPR_ASSERT(rect);
+
+	if (frame->numSolid == frame->maxSolid)
+	{
+		const size_t count = MAX(64, frame->maxSolid * 2);
+		RECTANGLE_16* rects = realloc(frame->solidRects, count * sizeof(RECTANGLE_16));
+		if (!rects)
+			return FALSE;
+		frame->solidRects = rects;
+
+		UINT32* colors = realloc(frame->solidColors, count * sizeof(UINT32));
+		if (!colors)
+			return FALSE;
+		frame->solidColors = colors;
+		frame->maxSolid = count;
+	}
+
+	frame->solidRects[frame->numSolid] = *rect;
+	frame->solidColors[frame->numSolid] = color;
+	frame->numSolid++;
+	return TRUE;
+}
+
+typedef struct
+{
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	const RECTANGLE_16* parts;
+	const UINT16* activity;
+	SHADOW_GFX_CONTENT* content;
+	UINT32* colors;
+} SHADOW_GFX_CLASSIFY_WORK;
+
+static BOOL shadow_client_gfx_classify_parts(void* arg, size_t begin, size_t end)
+{
+	const SHADOW_GFX_CLASSIFY_WORK* work = arg;
+	WINPR_ASSERT(work);
+
+	for (size_t x = begin; x < end; x++)
+		work->content[x] = shadow_client_gfx_classify_rect(
+		    work->pSrcData, work->nSrcStep, &work->parts[x], work->activity[x], &work->colors[x]);
+	return TRUE;
+}
+
+/**
+ * Split what is left to encode by content. Single coloured areas are sent with SolidFill and,
+ * if the session codec is lossy, text and UI go to frame->lossless. Only the rest stays in
+ * frame->region for the session codec.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_gfx_classify(rdpShadowClient* client, const BYTE* pSrcData,
+                                       UINT32 nSrcStep, BOOL lossy, SHADOW_GFX_CACHE_FRAME* frame)
+{
+	BOOL rc = FALSE;
+	UINT32 numRects = 0;
+	size_t numParts = 0;
+	size_t maxParts = 0;
+	REGION16 remaining = { 0 };
+	SHADOW_GFX_CLASSIFY_WORK work = { 0 };
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pSrcData);
+	WINPR_ASSERT(frame);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	region16_init(&frame->lossless);
+	if (!encoder->tileActivity)
+		return TRUE;
+
+	const size_t numTiles = 1ull * encoder->tileGridWidth * encoder->tileGridHeight;
+	for (size_t x = 0; x < numTiles; x++)
+		encoder->tileActivity[x] -= encoder->tileActivity[x] >> 3;
+
+	region16_init(&remaining);
+	const RECTANGLE_16* rects = region16_rects(&frame->region, &numRects);
+	for (UINT32 n = 0; n < numRects; n++)
+		maxParts += (((rects[n].right + 63ull) / 64) - rects[n].left / 64) *
+		            (((rects[n].bottom + 63ull) / 64) - rects[n].top / 64);
+
+	RECTANGLE_16* parts = calloc(maxParts, sizeof(RECTANGLE_16));
+	UINT16* activity = calloc(maxParts, sizeof(UINT16));
+	work.content = calloc(maxParts, sizeof(SHADOW_GFX_CONTENT));
+	work.colors = calloc(maxParts, sizeof(UINT32));
+	if ((maxParts > 0) && (!parts || !activity || !work.content || !work.colors))
+		goto fail;
+
+	/* the tile activity is updated in order, the pixels are read on the thread pool */
+	for (UINT32 n = 0; n < numRects; n++)
+	{
+		const RECTANGLE_16* r = &rects[n];
+
+		for (UINT32 ty = r->top / 64; ty * 64 < r->bottom; ty++)
+		{
+			for (UINT32 tx = r->left / 64; tx * 64 < r->right; tx++)
+			{
+				const RECTANGLE_16 tileRect = { (UINT16)(tx * 64), (UINT16)(ty * 64),
+					                            (UINT16)MIN(tx * 64 + 64, UINT16_MAX),
+					                            (UINT16)MIN(ty * 64 + 64, UINT16_MAX) };
+
+				if (!rectangles_intersection(&tileRect, r, &parts[numParts]))
+					continue;
+
+				if ((tx < encoder->tileGridWidth) && (ty < encoder->tileGridHeight))
+				{
+					UINT16* tile = &encoder->tileActivity[1ull * ty * encoder->tileGridWidth + tx];
+					*tile = MIN(*tile + SHADOW_GFX_ACTIVITY_STEP, SHADOW_GFX_ACTIVITY_MAX);
+					activity[numParts] = *tile;
+				}
+				numParts++;
+			}
+		}
+	}
+
+	work.pSrcData = pSrcData;
+	work.nSrcStep = nSrcStep;
+	work.parts = parts;
+	work.activity = activity;
+	if (!shadow_client_parallel_for(encoder, numParts, 0, shadow_client_gfx_classify_parts,
+	                                &work))
+		goto fail;
+
+	rc = TRUE;
+	for (size_t x = 0; rc && (x < numParts); x++)
+	{
+		const RECTANGLE_16* part = &parts[x];
+
+		if (work.content[x] == SHADOW_GFX_CONTENT_SOLID)
+			rc = shadow_client_gfx_add_solid(frame, part, work.colors[x]);
+		else if (lossy && (work.content[x] == SHADOW_GFX_CONTENT_TEXT))
+			rc = region16_union_rect(&frame->lossless, &frame->lossless, part);
+		else
+		{
+			rc = region16_union_rect(&remaining, &remaining, part);
+			continue;
+		}
+
+		/* the codecs do not know the tile content changed */
+		if (encoder->rfx)
+			rfx_context_invalidate_tile_cache(encoder->rfx, part);
+		if (encoder->progressive)
+			progressive_context_invalidate_tile_cache(encoder->progressive, part);
+	}
+
+	if (rc)
+		rc = region16_copy(&frame->region, &remaining);
+
+fail:
+	free(work.colors);
+	free(work.content);
+	free(activity);
+	free(parts);
+	region16_uninit(&remaining);
+	return rc;
+}
+
+/**
+ * Spend the H.264 bits where they are seen. Tiles that keep changing are full motion video
+ * and get a higher QP, tiles that just changed after a calm period (a photo opened, a window
+ * brought to the front) stay on screen and get a lower one.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_gfx_avc420_qp_regions(rdpShadowClient* client,
+                                                const SHADOW_GFX_CACHE_FRAME* frame)
+{
+	UINT32 numRects = 0;
+	size_t count = 0;
+	size_t maxRegions = 0;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(frame);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	if (!encoder->tileActivity)
+		return h264_context_set_qp_regions(encoder->h264, NULL, 0);
+
+	const RECTANGLE_16* rects = region16_rects(&frame->region, &numRects);
+	for (UINT32 n = 0; n < numRects; n++)
+		maxRegions += (((rects[n].right + 63ull) / 64) - rects[n].left / 64) *
+		              (((rects[n].bottom + 63ull) / 64) - rects[n].top / 64);
+
+	H264_QP_REGION* regions = calloc(MAX(1, maxRegions), sizeof(H264_QP_REGION));
+	if (!regions)
+		return FALSE;
+
+	for (UINT32 n = 0; n < numRects; n++)
+	{
+		const RECTANGLE_16* r = &rects[n];
+
+		for (UINT32 ty = r->top / 64; ty * 64 < r->bottom; ty++)
+		{
+			for (UINT32 tx = r->left / 64; tx * 64 < r->right; tx++)
+			{
+				if ((tx >= encoder->tileGridWidth) || (ty >= encoder->tileGridHeight))
+					continue;
+
+				const UINT16 activity =
+				    encoder->tileActivity[1ull * ty * encoder->tileGridWidth + tx];
+				INT32 offset = 0;
+				if (activity >= SHADOW_GFX_MOTION_ACTIVITY)
+					offset = SHADOW_AVC420_QP_MOTION;
+				else if (activity < SHADOW_GFX_VIDEO_ACTIVITY)
+					offset = -SHADOW_AVC420_QP_STILL;
+				else
+					continue;
+
+				const RECTANGLE_16 tileRect = { (UINT16)(tx * 64), (UINT16)(ty * 64),
+					                            (UINT16)MIN(tx * 64 + 64, UINT16_MAX),
+					                            (UINT16)MIN(ty * 64 + 64, UINT16_MAX) };
+				if (!rectangles_intersection(&tileRect, r, &regions[count].rect))
+					continue;
+				regions[count++].qpOffset = offset;
+			}
+		}
+	}
+
+	const BOOL rc = h264_context_set_qp_regions(encoder->h264, regions, (UINT32)count);
+	free(regions);
+	return rc;
+}
+
+typedef struct
+{
+	rdpShadowEncoder* encoder;
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	UINT32 SrcFormat;
+	const RDPGFX_SURFACE_COMMAND* cmd;
+	const RECTANGLE_16* rects;
+	size_t numRects;
+	size_t perStripe;
+	RDPGFX_SURFACE_COMMAND* cmds;
+} SHADOW_GFX_PLANAR_WORK;
+
+/* every stripe is a run of rectangles encoded with the planar context of the stripe */
+static BOOL shadow_client_gfx_encode_planar_stripes(void* arg, size_t begin, size_t end)
+{
+	const SHADOW_GFX_PLANAR_WORK* work = arg;
+	WINPR_ASSERT(work);
+
+	for (size_t stripe = begin; stripe < end; stripe++)
+	{
+		BITMAP_PLANAR_CONTEXT* context = work->encoder->stripePlanar[stripe];
+		const size_t last = MIN((stripe + 1) * work->perStripe, work->numRects);
+
+		for (size_t x = stripe * work->perStripe; x < last; x++)
+		{
+			const RECTANGLE_16* r = &work->rects[x];
+			RDPGFX_SURFACE_COMMAND* planar = &work->cmds[x];
+			const UINT32 w = 1u * r->right - r->left;
+			const UINT32 h = 1u * r->bottom - r->top;
+			const size_t offset = 1ull * r->top * work->nSrcStep +
+			                      1ull * r->left * FreeRDPGetBytesPerPixel(work->SrcFormat);
+
+			if (!context || !freerdp_bitmap_planar_context_reset(context, w, h))
+				return FALSE;
+
+			freerdp_planar_topdown_image(context, TRUE);
+
+			*planar = *work->cmd;
+			planar->left = r->left;
+			planar->top = r->top;
+			planar->right = r->right;
+			planar->bottom = r->bottom;
+			planar->width = w;
+			planar->height = h;
+			planar->codecId = RDPGFX_CODECID_PLANAR;
+			planar->extra = NULL;
+			planar->data =
+			    freerdp_bitmap_compress_planar(context, &work->pSrcData[offset], work->SrcFormat, w,
+			                                   h, work->nSrcStep, NULL, &planar->length);
+			if (!planar->data)
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Encode every rectangle of the region with planar into the commands following the first
+ * ones, these are left to the caller. The rectangles are split in stripes encoded in parallel,
+ * the commands keep the order of the region.
+ *
+ * @return TRUE on success, the commands must be freed with shadow_client_gfx_free_planar
+ */
+static BOOL shadow_client_gfx_encode_planar(rdpShadowClient* client, const BYTE* pSrcData,
+                                            UINT32 nSrcStep, UINT32 SrcFormat,
+                                            const RDPGFX_SURFACE_COMMAND* cmd,
+                                            const REGION16* region, size_t first,
+                                            RDPGFX_SURFACE_COMMAND** pCmds, size_t* pNumCmds)
+{
+	BOOL rc = TRUE;
+	UINT32 numRects = 0;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(cmd);
+	WINPR_ASSERT(region);
+	WINPR_ASSERT(pCmds);
+	WINPR_ASSERT(pNumCmds);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	*pCmds = NULL;
+	*pNumCmds = 0;
+
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
+	if (first + numRects == 0)
+		return TRUE;
+
+	RDPGFX_SURFACE_COMMAND* cmds = calloc(first + numRects, sizeof(RDPGFX_SURFACE_COMMAND));
+	if (!cmds)
+		return FALSE;
+
+	*pCmds = cmds;
+	*pNumCmds = first + numRects;
+
+	if (numRects > 0)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		const size_t stripes = MAX(1, MIN(encoder->numStripes, numRects));
+		const size_t perStripe = (numRects + stripes - 1) / stripes;
+		SHADOW_GFX_PLANAR_WORK work = { encoder, pSrcData, nSrcStep,  SrcFormat,   cmd,
+			                            rects,   numRects, perStripe, &cmds[first] };
+
+		rc = shadow_client_parallel_for(encoder, (numRects + perStripe - 1) / perStripe, 1,
+		                                shadow_client_gfx_encode_planar_stripes, &work);
+		shadow_client_encode_done(client, "gfx_encode_planar_us", start);
+	}
+
+	if (!rc)
+		WLog_ERR(TAG, "freerdp_bitmap_compress_planar failed");
+	return rc;
+}
+
+static void shadow_client_gfx_free_planar(RDPGFX_SURFACE_COMMAND* cmds, size_t first,
+                                          size_t numCmds)
+{
+	for (size_t x = first; cmds && (x < numCmds); x++)
+		free(cmds[x].data);
+	free(cmds);
+}
+
+#ifdef WITH_GFX_H264
+static UINT64 shadow_client_region_area(const REGION16* region)
+{
+	UINT64 area = 0;
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
+
+	for (UINT32 x = 0; x < numRects; x++)
+		area += 1ull * (rects[x].right - rects[x].left) * (rects[x].bottom - rects[x].top);
+	return area;
+}
+
+/**
+ * H.264 only updates blocks that changed since its own last frame, which is not necessarily
+ * what the client shows once other codecs are mixed in. Video tiles it skipped are sent
+ * lossless, tiles it overwrote that were not meant for it are encoded again with the next
+ * update.
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_gfx_avc420_fixup(rdpShadowClient* client,
+                                           const RDPGFX_H264_METABLOCK* meta,
+                                           SHADOW_GFX_CACHE_FRAME* frame)
+{
+	BOOL rc = TRUE;
+	UINT32 numRects = 0;
+	REGION16 updated = { 0 };
+	REGION16 covered = { 0 };
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(meta);
+	WINPR_ASSERT(frame);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	region16_init(&updated);
+	region16_init(&covered);
+	rc = region16_union_rects(&updated, &updated, meta->regionRects, meta->numRegionRects);
+
+	const RECTANGLE_16* rects = region16_rects(&frame->region, &numRects);
+	for (UINT32 x = 0; rc && (x < numRects); x++)
+	{
+		const RECTANGLE_16* r = &rects[x];
+		const UINT64 area = 1ull * (r->right - r->left) * (r->bottom - r->top);
+
+		rc = region16_intersect_rect(&covered, &updated, r);
+		if (rc && (shadow_client_region_area(&covered) < area))
+			rc = region16_union_rect(&frame->lossless, &frame->lossless, r);
+	}
+
+	for (UINT32 x = 0; rc && encoder->tileHashes && (x < meta->numRegionRects); x++)
+	{
+		const RECTANGLE_16* r = &meta->regionRects[x];
+		const UINT32 endX = MIN((r->right + 63u) / 64, encoder->tileGridWidth);
+		const UINT32 endY = MIN((r->bottom + 63u) / 64, encoder->tileGridHeight);
+
+		for (UINT32 ty = r->top / 64u; ty < endY; ty++)
+		{
+			for (UINT32 tx = r->left / 64u; tx < endX; tx++)
+			{
+				const RECTANGLE_16 tileRect = { (UINT16)(tx * 64), (UINT16)(ty * 64),
+					                            (UINT16)MIN(tx * 64 + 64, UINT16_MAX),
+					                            (UINT16)MIN(ty * 64 + 64, UINT16_MAX) };
+
+				if (!region16_intersects_rect(&frame->region, &tileRect))
+					encoder->tileHashes[1ull * ty * encoder->tileGridWidth + tx] = 0;
+			}
+		}
+	}
+
+	region16_uninit(&covered);
+	region16_uninit(&updated);
+	return rc;
+}
+#endif
+
+/**
+ * Send the encoded surface commands (if any) together with the cache commands of the frame.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT shadow_client_gfx_cache_send(rdpShadowClient* client,
+                                         const RDPGFX_SURFACE_COMMAND* cmds, size_t numCmds,
+                                         const RDPGFX_START_FRAME_PDU* cmdstart,
+                                         const RDPGFX_END_FRAME_PDU* cmdend,
+                                         const SHADOW_GFX_CACHE_FRAME* frame)
+{
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(cmds || (numCmds == 0));
+	WINPR_ASSERT(frame);
+
+	RdpgfxServerContext* rdpgfx = client->rdpgfx;
+	WINPR_ASSERT(rdpgfx);
+
+	if (!frame->move && (frame->numCacheToSurface == 0) && (frame->numSurfaceToCache == 0) &&
+	    (frame->numSolid == 0) && (numCmds <= 1))
+	{
+		if (numCmds > 0)
+			IFCALLRET(rdpgfx->SurfaceFrameCommand, error, rdpgfx, cmds, cmdstart, cmdend);
+		return error;
+	}
+
+	/* all PDUs of the frame go out as one compressed packet list */
+	if (!rdpgfx_server_begin_batch(rdpgfx))
+		return ERROR_INTERNAL_ERROR;
+
+	IFCALLRET(rdpgfx->StartFrame, error, rdpgfx, cmdstart);
+
+	if (frame->move && (error == CHANNEL_RC_OK))
+	{
+		RDPGFX_POINT16 pt = frame->moveDst;
+		const RDPGFX_SURFACE_TO_SURFACE_PDU pdu = { .surfaceIdSrc = client->surfaceId,
+			                                        .surfaceIdDest = client->surfaceId,
+			                                        .rectSrc = frame->moveSrc,
+			                                        .destPtsCount = 1,
+			                                        .destPts = &pt };
+		IFCALLRET(rdpgfx->SurfaceToSurface, error, rdpgfx, &pdu);
+	}
+
+	for (size_t x = 0; (error == CHANNEL_RC_OK) && (x < frame->numCacheToSurface); x++)
+	{
+		const SHADOW_GFX_CACHE_TILE* tile = &frame->cacheToSurface[x];
+		RDPGFX_POINT16 pt = { tile->rect.left, tile->rect.top };
+		const RDPGFX_CACHE_TO_SURFACE_PDU pdu = { .cacheSlot = tile->cacheSlot,
+			                                      .surfaceId = client->surfaceId,
+			                                      .destPtsCount = 1,
+			                                      .destPts = &pt };
+		IFCALLRET(rdpgfx->CacheToSurface, error, rdpgfx, &pdu);
+	}
+
+	for (size_t x = 0; (error == CHANNEL_RC_OK) && (x < numCmds); x++)
+		IFCALLRET(rdpgfx->SurfaceCommand, error, rdpgfx, &cmds[x]);
+
+	for (size_t x = 0; (error == CHANNEL_RC_OK) && (x < frame->numSolid);)
+	{
+		const UINT32 color = frame->solidColors[x];
+		size_t count = 1;
+
+		/* neighbouring tiles of the same colour share one PDU */
+		while ((x + count < frame->numSolid) && (count < UINT16_MAX) &&
+		       (frame->solidColors[x + count] == color))
+			count++;
+
+		const RDPGFX_SOLID_FILL_PDU pdu = { .surfaceId = client->surfaceId,
+			                                .fillPixel = { .B = color & 0xFF,
+			                                               .G = (color >> 8) & 0xFF,
+			                                               .R = (color >> 16) & 0xFF,
+			                                               .XA = 0xFF },
+			                                .fillRectCount = (UINT16)count,
+			                                .fillRects = &frame->solidRects[x] };
+		IFCALLRET(rdpgfx->SolidFill, error, rdpgfx, &pdu);
+		x += count;
+	}
+
+	for (size_t x = 0; (error == CHANNEL_RC_OK) && (x < frame->numSurfaceToCache); x++)
+	{
+		const SHADOW_GFX_CACHE_TILE* tile = &frame->surfaceToCache[x];
+		const RDPGFX_SURFACE_TO_CACHE_PDU pdu = { .surfaceId = client->surfaceId,
+			                                      .cacheKey = tile->cacheKey,
+			                                      .cacheSlot = tile->cacheSlot,
+			                                      .rectSrc = tile->rect };
+		IFCALLRET(rdpgfx->SurfaceToCache, error, rdpgfx, &pdu);
+	}
+
+	if (error == CHANNEL_RC_OK)
+		IFCALLRET(rdpgfx->EndFrame, error, rdpgfx, cmdend);
+
+	const UINT rc = rdpgfx_server_end_batch(rdpgfx);
+	if (error == CHANNEL_RC_OK)
+		error = rc;
+
+	return error;
+}
+
+/**
+ * Take over the entries of the client persistent cache that hold a tile sent in an earlier
+ * session. The tile hash is the cache key, so the tile lands in the slot a lookup expects.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT shadow_client_rdpgfx_cache_import_offer(RdpgfxServerContext* context,
+                                                    const RDPGFX_CACHE_IMPORT_OFFER_PDU* offer)
+{
+	RDPGFX_CACHE_IMPORT_REPLY_PDU reply = { 0 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(offer);
+
+	rdpShadowClient* client = (rdpShadowClient*)context->custom;
+	WINPR_ASSERT(client);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	if (encoder && encoder->cacheKeys)
+	{
+		const UINT16 count = MIN(offer->cacheEntriesCount, RDPGFX_CACHE_ENTRY_MAX_COUNT);
+		for (UINT16 index = 0; index < count; index++)
+		{
+			const RDPGFX_CACHE_ENTRY_METADATA* entry = &offer->cacheEntries[index];
+			const size_t slot = entry->cacheKey % SHADOW_GFX_CACHE_SLOTS;
+
+			if ((entry->cacheKey == 0) || (entry->bitmapLength != 64 * 64 * 4) ||
+			    (encoder->cacheKeys[slot] != 0))
+				continue;
+
+			encoder->cacheKeys[slot] = entry->cacheKey;
+			reply.cacheSlots[index] = (UINT16)(slot + 1);
+			reply.importedEntriesCount = index + 1;
+		}
+	}
+
+	WLog_DBG(TAG, "cache import offer of %" PRIu16 " entries", offer->cacheEntriesCount);
+	WINPR_ASSERT(context->CacheImportReply);
+	return context->CacheImportReply(context, &reply);
+}
+
+/**
+ * Send a surface update, moveSrc and moveDst (both or none) describe content the capture moved
+ * since the last update.
+ *
+ * @return TRUE on success
+ */
+static void shadow_client_gfx_frame_init(rdpShadowEncoder* encoder,
+                                         RDPGFX_START_FRAME_PDU* cmdstart,
+                                         RDPGFX_END_FRAME_PDU* cmdend)
+{
+	SYSTEMTIME sTime = { 0 };
+
+	WINPR_ASSERT(cmdstart);
+	WINPR_ASSERT(cmdend);
+
+	cmdstart->frameId = shadow_encoder_create_frame_id(encoder);
+	FREERDP_TRACEPOINT(shadow_encode, cmdstart->frameId, 0);
+	GetSystemTime(&sTime);
+	cmdstart->timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U |
+	                               sTime.wSecond << 10U | sTime.wMilliseconds);
+	cmdend->frameId = cmdstart->frameId;
+}
+
+static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE* pSrcData,
+                                           UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nXSrc,
+                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight,
+                                           const RECTANGLE_16* moveSrc,
+                                           const RECTANGLE_16* moveDst)
+{
+	UINT32 id = 0;
+	UINT error = CHANNEL_RC_OK;
+	const rdpContext* context = (const rdpContext*)client;
+	const rdpSettings* settings = NULL;
+	rdpShadowEncoder* encoder = NULL;
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
+	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+
+	if (!context || !pSrcData)
+		return FALSE;
+
+	settings = context->settings;
+	encoder = client->encoder;
+
+	if (!settings || !encoder)
+		return FALSE;
+
+	if (client->first_frame)
+	{
+		rfx_context_reset(encoder->rfx, nWidth, nHeight);
+		shadow_encoder_invalidate_tiles(encoder, FALSE);
+		client->first_frame = FALSE;
+	}
+
+	shadow_client_gfx_frame_init(encoder, &cmdstart, &cmdend);
+	cmd.surfaceId = client->surfaceId;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.left = nXSrc;
+	cmd.top = nYSrc;
+	cmd.right = cmd.left + nWidth;
+	cmd.bottom = cmd.top + nHeight;
+	cmd.width = nWidth;
+	cmd.height = nHeight;
+
+	id = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
+#ifdef WITH_GFX_H264
+	const BOOL GfxH264 = freerdp_settings_get_bool(settings, FreeRDP_GfxH264);
+	const BOOL GfxAVC444 = freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444);
+	const BOOL GfxAVC444v2 = freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444v2);
+	if (GfxAVC444 || GfxAVC444v2)
+	{
+		INT32 rc = 0;
+		RDPGFX_AVC444_BITMAP_STREAM avc444 = { 0 };
+		RECTANGLE_16 regionRect = { 0 };
+		BYTE version = GfxAVC444v2 ? 2 : 1;
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC444) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC444");
+			return FALSE;
+		}
+
+		WINPR_ASSERT(cmd.left <= UINT16_MAX);
+		WINPR_ASSERT(cmd.top <= UINT16_MAX);
+		WINPR_ASSERT(cmd.right <= UINT16_MAX);
+		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
+		regionRect.left = (UINT16)cmd.left;
+		regionRect.top = (UINT16)cmd.top;
+		regionRect.right = (UINT16)cmd.right;
+		regionRect.bottom = (UINT16)cmd.bottom;
+		const UINT64 start = winpr_GetTickCount64NS();
+		rc = avc444_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth, nHeight,
+		                     version, &regionRect, &avc444.LC, &avc444.bitstream[0].data,
+		                     &avc444.bitstream[0].length, &avc444.bitstream[1].data,
+		                     &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
+		                     &avc444.bitstream[1].meta);
+		shadow_client_encode_done(client, "gfx_encode_avc444_us", start);
+		if (rc < 0)
+		{
+			WLog_ERR(TAG, "avc420_compress failed for avc444");
+			return FALSE;
+		}
+
+		/* rc > 0 means new data */
+		if (rc > 0)
+		{
+			avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
+			cmd.codecId = GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
+			cmd.extra = (void*)&avc444;
+			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
+			          &cmdend);
+		}
+
+		free_h264_metablock(&avc444.bitstream[0].meta);
+		free_h264_metablock(&avc444.bitstream[1].meta);
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
+	else if (GfxH264)
+	{
+		INT32 rc = 0;
+		RDPGFX_AVC420_BITMAP_STREAM avc420 = { 0 };
+		RDPGFX_SURFACE_COMMAND* cmds = NULL;
+		size_t numCmds = 0;
+		SHADOW_GFX_CACHE_FRAME frame = { 0 };
+		RECTANGLE_16 regionRect;
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC420 | FREERDP_CODEC_PLANAR) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_AVC420");
+			return FALSE;
+		}
+
+		WINPR_ASSERT(cmd.left <= UINT16_MAX);
+		WINPR_ASSERT(cmd.top <= UINT16_MAX);
+		WINPR_ASSERT(cmd.right <= UINT16_MAX);
+		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
+		regionRect.left = (UINT16)cmd.left;
+		regionRect.top = (UINT16)cmd.top;
+		regionRect.right = (UINT16)cmd.right;
+		regionRect.bottom = (UINT16)cmd.bottom;
+
+		/* only video like content goes to H.264, text and UI would be blurred */
+		shadow_client_gfx_cache_move(client, pSrcData, nSrcStep, moveSrc, moveDst, &frame);
+		if (!shadow_client_gfx_cache_prepare(client, pSrcData, nSrcStep, &regionRect, &frame) ||
+		    !shadow_client_gfx_classify(client, pSrcData, nSrcStep, TRUE, &frame))
+			rc = -1;
+		else if (!region16_is_empty(&frame.region))
+		{
+			regionRect = *region16_extents(&frame.region);
+
+			const UINT64 start = winpr_GetTickCount64NS();
+			if (!shadow_client_gfx_avc420_qp_regions(client, &frame))
+				rc = -1;
+			else
+				rc = avc420_compress(encoder->h264, pSrcData, cmd.format, nSrcStep, nWidth,
+				                     nHeight, &regionRect, &avc420.data, &avc420.length,
+				                     &avc420.meta);
+			shadow_client_encode_done(client, "gfx_encode_avc420_us", start);
+
+			if ((rc >= 0) && !shadow_client_gfx_avc420_fixup(client, &avc420.meta, &frame))
+				rc = -1;
+		}
+
+		if (rc < 0)
+			WLog_ERR(TAG, "avc420_compress failed");
+		else if (!shadow_client_gfx_encode_planar(client, pSrcData, nSrcStep, SrcFormat, &cmd,
+		                                          &frame.lossless, 1, &cmds, &numCmds))
+			rc = -1;
+
+		if (rc >= 0)
+		{
+			/* rc > 0 means new data */
+			cmd.codecId = RDPGFX_CODECID_AVC420;
+			cmd.extra = (void*)&avc420;
+			cmds[0] = cmd;
+			error = shadow_client_gfx_cache_send(client, (rc > 0) ? cmds : &cmds[1],
+			                                     (rc > 0) ? numCmds : numCmds - 1, &cmdstart,
+			                                     &cmdend, &frame);
+		}
+
+		free_h264_metablock(&avc420.meta);
+		shadow_client_gfx_free_planar(cmds, 1, numCmds);
+		shadow_client_gfx_cache_frame_uninit(&frame);
+
+		if (rc < 0)
+			return FALSE;
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
+	else
+#endif
+	    if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0))
+	{
+		BOOL rc = FALSE;
+		wStream* s = NULL;
+		RFX_RECT* rects = NULL;
+		RDPGFX_SURFACE_COMMAND* cmds = NULL;
+		size_t numCmds = 0;
+		SHADOW_GFX_CACHE_FRAME frame = { 0 };
+		RECTANGLE_16 regionRect = { 0 };
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX | FREERDP_CODEC_PLANAR) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
+			return FALSE;
+		}
+
+		s = Stream_New(NULL, 1024);
+		WINPR_ASSERT(s);
+
+		WINPR_ASSERT(cmd.left <= UINT16_MAX);
+		WINPR_ASSERT(cmd.top <= UINT16_MAX);
+		WINPR_ASSERT(cmd.right <= UINT16_MAX);
+		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
+		regionRect.left = (UINT16)cmd.left;
+		regionRect.top = (UINT16)cmd.top;
+		regionRect.right = (UINT16)cmd.right;
+		regionRect.bottom = (UINT16)cmd.bottom;
+
+		shadow_client_gfx_cache_move(client, pSrcData, nSrcStep, moveSrc, moveDst, &frame);
+		rc = shadow_client_gfx_cache_prepare(client, pSrcData, nSrcStep, &regionRect, &frame) &&
+		     shadow_client_gfx_classify(client, pSrcData, nSrcStep, TRUE, &frame);
+
+		UINT32 numRects = 0;
+		const RECTANGLE_16* regionRects = region16_rects(&frame.region, &numRects);
+		if (rc && (numRects > 0))
+		{
+			rects = calloc(numRects, sizeof(RFX_RECT));
+			rc = rects != NULL;
+		}
+
+		for (UINT32 x = 0; rc && (x < numRects); x++)
+		{
+			const RECTANGLE_16* r = &regionRects[x];
+			rects[x].x = r->left;
+			rects[x].y = r->top;
+			rects[x].width = r->right - r->left;
+			rects[x].height = r->bottom - r->top;
+		}
+
+		if (rc && (numRects > 0))
+		{
+			const UINT64 start = winpr_GetTickCount64NS();
+			rc = rfx_compose_message(encoder->rfx, s, rects, numRects, pSrcData, nWidth, nHeight,
+			                         nSrcStep);
+			shadow_client_encode_done(client, "gfx_encode_remotefx_us", start);
+		}
+		free(rects);
+
+		if (!rc)
+			WLog_ERR(TAG, "rfx_compose_message failed");
+		else
+			rc = shadow_client_gfx_encode_planar(client, pSrcData, nSrcStep, SrcFormat, &cmd,
+			                                     &frame.lossless, 1, &cmds, &numCmds);
+
+		if (!rc)
+		{
+			shadow_client_gfx_free_planar(cmds, 1, numCmds);
+			shadow_client_gfx_cache_frame_uninit(&frame);
+			Stream_Free(s, TRUE);
+			return FALSE;
+		}
+
+		/* an empty stream means all tiles are unchanged */
+		const size_t pos = Stream_GetPosition(s);
+		WINPR_ASSERT(pos <= UINT32_MAX);
+
+		cmd.codecId = RDPGFX_CODECID_CAVIDEO;
+		cmd.data = Stream_Buffer(s);
+		cmd.length = (UINT32)pos;
+		cmds[0] = cmd;
+
+		/* the lossy codec goes first, text and UI on top of it */
+		error = shadow_client_gfx_cache_send(client, (pos > 0) ? cmds : &cmds[1],
+		                                     (pos > 0) ? numCmds : numCmds - 1, &cmdstart, &cmdend,
+		                                     &frame);
+
+		shadow_client_gfx_free_planar(cmds, 1, numCmds);
+		shadow_client_gfx_cache_frame_uninit(&frame);
+		Stream_Free(s, TRUE);
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
+	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
+	{
+		INT32 rc = 0;
+		RDPGFX_SURFACE_COMMAND* cmds = NULL;
+		size_t numCmds = 0;
+		SHADOW_GFX_CACHE_FRAME frame = { 0 };
+		RECTANGLE_16 regionRect;
+
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PROGRESSIVE | FREERDP_CODEC_PLANAR) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PROGRESSIVE");
+			return FALSE;
+		}
+
+		WINPR_ASSERT(cmd.left <= UINT16_MAX);
+		WINPR_ASSERT(cmd.top <= UINT16_MAX);
+		WINPR_ASSERT(cmd.right <= UINT16_MAX);
+		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
+		regionRect.left = (UINT16)cmd.left;
+		regionRect.top = (UINT16)cmd.top;
+		regionRect.right = (UINT16)cmd.right;
+		regionRect.bottom = (UINT16)cmd.bottom;
+		frame.coarse = encoder->progressivePasses > 1;
+		shadow_client_gfx_cache_move(client, pSrcData, nSrcStep, moveSrc, moveDst, &frame);
+		if (!shadow_client_gfx_cache_prepare(client, pSrcData, nSrcStep, &regionRect, &frame) ||
+		    !shadow_client_gfx_classify(client, pSrcData, nSrcStep, TRUE, &frame))
+			rc = -1;
+		else if (!region16_is_empty(&frame.region))
+		{
+			const UINT64 start = winpr_GetTickCount64NS();
+			rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight,
+			                          cmd.format, nWidth, nHeight, nSrcStep, &frame.region,
+			                          &cmd.data, &cmd.length);
+			shadow_client_encode_done(client, "gfx_encode_progressive_us", start);
+		}
+		if (rc < 0)
 			WLog_ERR(TAG, "progressive_compress failed");
+		else if (!shadow_client_gfx_encode_planar(client, pSrcData, nSrcStep, SrcFormat, &cmd,
+		                                          &frame.lossless, 1, &cmds, &numCmds))
+			rc = -1;
+
+		if (rc < 0)
+		{
+			shadow_client_gfx_free_planar(cmds, 1, numCmds);
+			shadow_client_gfx_cache_frame_uninit(&frame);
+			return FALSE;
+		}
+
+		/* rc > 0 means new data */
+		cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+		cmds[0] = cmd;
+		error = shadow_client_gfx_cache_send(client, (rc > 0) ? cmds : &cmds[1],
+		                                     (rc > 0) ? numCmds : numCmds - 1, &cmdstart, &cmdend,
+		                                     &frame);
+		shadow_client_gfx_free_planar(cmds, 1, numCmds);
+		shadow_client_gfx_cache_frame_uninit(&frame);
+
+		if (error)
+		{
+			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+			return FALSE;
+		}
+	}
+	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxClearCodec))
+	{
+		const UINT32 w = cmd.right - cmd.left;
+		const UINT32 h = cmd.bottom - cmd.top;
+		const BYTE* src =
+		    &pSrcData[cmd.top * nSrcStep + cmd.left * FreeRDPGetBytesPerPixel(SrcFormat)];
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+			return FALSE;
+		}
+
+		wStream* s = Stream_New(NULL, 1024);
+		if (!s)
+			return FALSE;
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		const BOOL rc = clear_compose_message(encoder->clear, s, src, SrcFormat, nSrcStep, w, h);
+		shadow_client_encode_done(client, "gfx_encode_clearcodec_us", start);
+		if (!rc)
+		{
+			WLog_ERR(TAG, "clear_compose_message failed");
+			Stream_Free(s, TRUE);
 			return FALSE;
 		}
 
-		/* rc > 0 means new data */
-		if (rc > 0)
-		{
-			cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+		const size_t pos = Stream_GetPosition(s);
+		WINPR_ASSERT(pos <= UINT32_MAX);
 
-			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-			          &cmdend);
-		}
+		cmd.codecId = RDPGFX_CODECID_CLEARCODEC;
+		cmd.data = Stream_Buffer(s);
+		cmd.length = (UINT32)pos;
 
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
+		          &cmdend);
+		Stream_Free(s, TRUE);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
@@ -1392,31 +2540,39 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	}
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
 	{
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const BYTE* src =
-		    &pSrcData[cmd.top * nSrcStep + cmd.left * FreeRDPGetBytesPerPixel(SrcFormat)];
+		BOOL rc = FALSE;
+		size_t numCmds = 0;
+		RDPGFX_SURFACE_COMMAND* cmds = NULL;
+		SHADOW_GFX_CACHE_FRAME frame = { 0 };
+		const RECTANGLE_16 regionRect = { WINPR_ASSERTING_INT_CAST(UINT16, cmd.left),
+			                              WINPR_ASSERTING_INT_CAST(UINT16, cmd.top),
+			                              WINPR_ASSERTING_INT_CAST(UINT16, cmd.right),
+			                              WINPR_ASSERTING_INT_CAST(UINT16, cmd.bottom) };
+
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
 			return FALSE;
 		}
 
-		const BOOL rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
-		if (!rc)
-			return FALSE;
+		/* planar is lossless, what is left after the cache lookup and the solid fills is
+		 * encoded rect by rect */
+		shadow_client_gfx_cache_move(client, pSrcData, nSrcStep, moveSrc, moveDst, &frame);
+		rc = shadow_client_gfx_cache_prepare(client, pSrcData, nSrcStep, &regionRect, &frame) &&
+		     shadow_client_gfx_classify(client, pSrcData, nSrcStep, FALSE, &frame) &&
+		     shadow_client_gfx_encode_planar(client, pSrcData, nSrcStep, SrcFormat, &cmd,
+		                                     &frame.region, 0, &cmds, &numCmds);
 
-		freerdp_planar_topdown_image(encoder->planar, TRUE);
+		if (rc)
+			error =
+			    shadow_client_gfx_cache_send(client, cmds, numCmds, &cmdstart, &cmdend, &frame);
 
-		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
-		                                          NULL, &cmd.length);
-		WINPR_ASSERT(cmd.data || (cmd.length == 0));
+		shadow_client_gfx_free_planar(cmds, 0, numCmds);
+		shadow_client_gfx_cache_frame_uninit(&frame);
 
-		cmd.codecId = RDPGFX_CODECID_PLANAR;
+		if (!rc)
+			return FALSE;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
-		free(cmd.data);
 		if (error)
 		{
 			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
@@ -1495,9 +2651,10 @@ static BOOL is_surface_command_supported(const rdpSettings* settings)
  *
  * @return TRUE on success
  */
-static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcData,
-                                            UINT32 nSrcStep, UINT16 nXSrc, UINT16 nYSrc,
-                                            UINT16 nWidth, UINT16 nHeight)
+static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, UINT64 captureId,
+                                            BYTE* pSrcData, UINT32 nSrcStep, UINT16 nXSrc,
+                                            UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight,
+                                            const RFX_RECT* rects, size_t numRects)
 {
 	BOOL ret = TRUE;
 	BOOL first = 0;
@@ -1523,6 +2680,7 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 
 	if (encoder->frameAck)
 		frameId = shadow_encoder_create_frame_id(encoder);
+	FREERDP_TRACEPOINT(shadow_encode, frameId, 0);
 
 	// TODO: Check FreeRDP_RemoteFxCodecMode if we should send RFX IMAGE or VIDEO data
 	const UINT32 nsID = freerdp_settings_get_uint32(settings, FreeRDP_NSCodecId);
@@ -1544,17 +2702,50 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		rect.width = nWidth;
 		rect.height = nHeight;
 
+		/* the changed rectangles only, distant changes do not encode everything in between */
+		if (!rects || (numRects == 0))
+		{
+			rects = &rect;
+			numRects = 1;
+		}
+
 		const UINT32 MultifragMaxRequestSize =
 		    freerdp_settings_get_uint32(settings, FreeRDP_MultifragMaxRequestSize);
-		RFX_MESSAGE_LIST* messages =
-		    rfx_encode_messages(encoder->rfx, &rect, 1, pSrcData,
-		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight),
-		                        nSrcStep, &numMessages, MultifragMaxRequestSize);
-		if (!messages)
-		{
-			WLog_ERR(TAG, "rfx_encode_messages failed");
-			return FALSE;
+		RFX_MESSAGE_LIST* messages = NULL;
+		wStream** shared = NULL;
+
+		/* viewers of the same capture share the encoded frame, frame ids stay per client */
+		rdpShadowServer* server = client->server;
+		if (!client->inLobby && server->sharedEncoder && (ArrayList_Count(server->clients) > 1))
+			shared = shadow_shared_encoder_rfx(
+			    server->sharedEncoder, captureId, rects, numRects, pSrcData,
+			    freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+			    freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight), nSrcStep,
+			    MultifragMaxRequestSize, &numMessages);
+
+		if (shared)
+		{
+			/* the own tile cache no longer matches what the client shows */
+			for (size_t i = 0; i < numRects; i++)
+			{
+				const RECTANGLE_16 cached = { rects[i].x, rects[i].y,
+					                          (UINT16)(rects[i].x + rects[i].width),
+					                          (UINT16)(rects[i].y + rects[i].height) };
+				rfx_context_invalidate_tile_cache(encoder->rfx, &cached);
+			}
+		}
+		else
+		{
+			messages = rfx_encode_messages(
+			    encoder->rfx, rects, numRects, pSrcData,
+			    freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+			    freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight), nSrcStep,
+			    &numMessages, MultifragMaxRequestSize);
+			if (!messages)
+			{
+				WLog_ERR(TAG, "rfx_encode_messages failed");
+				return FALSE;
+			}
 		}
 
 		cmd.cmdType = CMDTYPE_STREAM_SURFACE_BITS;
@@ -1574,14 +2765,20 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 
 		for (size_t i = 0; i < numMessages; i++)
 		{
-			Stream_SetPosition(s, 0);
-
-			const RFX_MESSAGE* msg = rfx_message_list_get(messages, i);
-			if (!rfx_write_message(encoder->rfx, s, msg))
+			if (shared)
+				s = shared[i]; /* read only, the position is at the end of the message */
+			else
 			{
-				WLog_ERR(TAG, "rfx_write_message failed");
-				ret = FALSE;
-				break;
+				s = encoder->bs;
+				Stream_SetPosition(s, 0);
+
+				const RFX_MESSAGE* msg = rfx_message_list_get(messages, i);
+				if (!rfx_write_message(encoder->rfx, s, msg))
+				{
+					WLog_ERR(TAG, "rfx_write_message failed");
+					ret = FALSE;
+					break;
+				}
 			}
 
 			WINPR_ASSERT(Stream_GetPosition(s) <= UINT32_MAX);
@@ -1604,6 +2801,7 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		}
 
 		rfx_message_list_free(messages);
+		shadow_shared_encoder_release(shared, numMessages);
 	}
 	else if (set_surface_bits_supported(settings) &&
 	         freerdp_settings_get_bool(settings, FreeRDP_NSCodec) && (nsID != 0))
@@ -1648,6 +2846,82 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	return ret;
 }
 
+typedef struct
+{
+	rdpShadowEncoder* encoder;
+	const BYTE* pSrcData;
+	UINT32 nSrcStep;
+	UINT32 SrcFormat;
+	UINT32 bitsPerPixel;
+	BITMAP_DATA* bitmaps;
+	size_t count;
+	size_t perStripe;
+} SHADOW_BITMAP_WORK;
+
+/* every stripe is a run of tiles compressed with the interleaved or planar context of the stripe
+ * into the grid buffer of the tile */
+static BOOL shadow_client_encode_bitmap_stripes(void* arg, size_t begin, size_t end)
+{
+	const SHADOW_BITMAP_WORK* work = arg;
+	WINPR_ASSERT(work);
+
+	rdpShadowEncoder* encoder = work->encoder;
+	const BOOL interleaved = work->bitsPerPixel < 32;
+
+	for (size_t stripe = begin; stripe < end; stripe++)
+	{
+		const size_t last = MIN((stripe + 1) * work->perStripe, work->count);
+
+		for (size_t x = stripe * work->perStripe; x < last; x++)
+		{
+			BITMAP_DATA* bitmap = &work->bitmaps[x];
+			BYTE* buffer = encoder->grid[x];
+
+			if (interleaved)
+			{
+				const UINT32 bytesPerPixel = (work->bitsPerPixel + 7) / 8;
+				UINT32 DstSize = 64 * 64 * 4;
+
+				if (!interleaved_compress(encoder->stripeInterleaved[stripe], buffer, &DstSize,
+				                          bitmap->width, bitmap->height, work->pSrcData,
+				                          work->SrcFormat, work->nSrcStep, bitmap->destLeft,
+				                          bitmap->destTop, NULL, work->bitsPerPixel))
+					return FALSE;
+
+				bitmap->bitmapDataStream = buffer;
+				bitmap->bitmapLength = DstSize;
+				bitmap->bitsPerPixel = work->bitsPerPixel;
+				bitmap->cbScanWidth = bitmap->width * bytesPerPixel;
+				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * bytesPerPixel;
+			}
+			else
+			{
+				UINT32 dstSize = 0;
+				const size_t offset =
+				    (1ull * bitmap->destTop * work->nSrcStep) + (4ull * bitmap->destLeft);
+				const BYTE* data = &work->pSrcData[offset];
+
+				buffer = freerdp_bitmap_compress_planar(encoder->stripePlanar[stripe], data,
+				                                        work->SrcFormat, bitmap->width,
+				                                        bitmap->height, work->nSrcStep, buffer,
+				                                        &dstSize);
+				if (!buffer)
+					return FALSE;
+
+				bitmap->bitmapDataStream = buffer;
+				bitmap->bitmapLength = dstSize;
+				bitmap->bitsPerPixel = 32;
+				bitmap->cbScanWidth = bitmap->width * 4;
+				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
+			}
+
+			bitmap->cbCompFirstRowSize = 0;
+			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
+		}
+	}
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -1658,14 +2932,11 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
                                              UINT16 nWidth, UINT16 nHeight)
 {
 	BOOL ret = TRUE;
-	BYTE* data = NULL;
-	BYTE* buffer = NULL;
 	UINT32 k = 0;
 	UINT32 yIdx = 0;
 	UINT32 xIdx = 0;
 	UINT32 rows = 0;
 	UINT32 cols = 0;
-	UINT32 DstSize = 0;
 	UINT32 SrcFormat = 0;
 	BITMAP_DATA* bitmap = NULL;
 	rdpContext* context = (rdpContext*)client;
@@ -1761,44 +3032,36 @@ static BOOL shadow_client_send_bitmap_update(rdpShadowClient* client, BYTE* pSrc
 			if ((bitmap->width < 4) || (bitmap->height < 4))
 				continue;
 
-			if (freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth) < 32)
-			{
-				UINT32 bitsPerPixel = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
-				UINT32 bytesPerPixel = (bitsPerPixel + 7) / 8;
-				DstSize = 64 * 64 * 4;
-				buffer = encoder->grid[k];
-				interleaved_compress(encoder->interleaved, buffer, &DstSize, bitmap->width,
-				                     bitmap->height, pSrcData, SrcFormat, nSrcStep,
-				                     bitmap->destLeft, bitmap->destTop, NULL, bitsPerPixel);
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = DstSize;
-				bitmap->bitsPerPixel = bitsPerPixel;
-				bitmap->cbScanWidth = bitmap->width * bytesPerPixel;
-				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * bytesPerPixel;
-			}
-			else
-			{
-				UINT32 dstSize = 0;
-				buffer = encoder->grid[k];
-				data = &pSrcData[(bitmap->destTop * nSrcStep) + (bitmap->destLeft * 4)];
-
-				buffer =
-				    freerdp_bitmap_compress_planar(encoder->planar, data, SrcFormat, bitmap->width,
-				                                   bitmap->height, nSrcStep, buffer, &dstSize);
-				bitmap->bitmapDataStream = buffer;
-				bitmap->bitmapLength = dstSize;
-				bitmap->bitsPerPixel = 32;
-				bitmap->cbScanWidth = bitmap->width * 4;
-				bitmap->cbUncompressedSize = bitmap->width * bitmap->height * 4;
-			}
-
-			bitmap->cbCompFirstRowSize = 0;
-			bitmap->cbCompMainBodySize = bitmap->bitmapLength;
-			totalBitmapSize += bitmap->bitmapLength;
 			k++;
 		}
 	}
 
+	if (k > 0)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		const UINT32 bitsPerPixel = freerdp_settings_get_uint32(settings, FreeRDP_ColorDepth);
+		const BOOL interleaved = bitsPerPixel < 32;
+		const size_t numStripes =
+		    interleaved ? encoder->numInterleavedStripes : encoder->numStripes;
+		const size_t stripes = MAX(1, MIN(numStripes, k));
+		const size_t perStripe = (k + stripes - 1) / stripes;
+		SHADOW_BITMAP_WORK work = { encoder,      pSrcData,   nSrcStep, SrcFormat,
+			                        bitsPerPixel, bitmapData, k,        perStripe };
+
+		if (!shadow_client_parallel_for(encoder, (k + perStripe - 1) / perStripe, 1,
+		                                shadow_client_encode_bitmap_stripes, &work))
+		{
+			WLog_ERR(TAG, "Failed to compress bitmap update");
+			ret = FALSE;
+			goto out;
+		}
+		shadow_client_encode_done(
+		    client, interleaved ? "bitmap_interleaved_us" : "bitmap_planar_us", start);
+	}
+
+	for (UINT32 x = 0; x < k; x++)
+		totalBitmapSize += bitmapData[x].bitmapLength;
+
 	bitmapUpdate.number = k;
 	updateSizeEstimate = totalBitmapSize + (k * bitmapUpdate.number) + 16;
 
@@ -1861,10 +3124,12 @@ out:
 
 /**
  * Function description
+ * Encode and send a captured frame, runs on the encoder thread of the pipeline.
  *
  * @return TRUE on success (or nothing need to be updated)
  */
-static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus)
+static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus,
+                                              const SHADOW_PIPELINE_FRAME* frame)
 {
 	BOOL ret = TRUE;
 	INT64 nXSrc = 0;
@@ -1874,9 +3139,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	rdpContext* context = (rdpContext*)client;
 	rdpSettings* settings = NULL;
 	rdpShadowServer* server = NULL;
-	rdpShadowSurface* surface = NULL;
-	REGION16 invalidRegion;
-	RECTANGLE_16 surfaceRect;
+	const REGION16* invalidRegion = NULL;
 	const RECTANGLE_16* extents = NULL;
 	BYTE* pSrcData = NULL;
 	UINT32 nSrcStep = 0;
@@ -1884,7 +3147,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	UINT32 numRects = 0;
 	const RECTANGLE_16* rects = NULL;
 
-	if (!context || !pStatus)
+	if (!context || !pStatus || !frame)
 		return FALSE;
 
 	settings = context->settings;
@@ -1893,50 +3156,23 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	if (!settings || !server)
 		return FALSE;
 
-	surface = client->inLobby ? server->lobby : server->surface;
-
-	if (!surface)
-		return FALSE;
-
-	EnterCriticalSection(&(client->lock));
-	region16_init(&invalidRegion);
-	region16_copy(&invalidRegion, &(client->invalidRegion));
-	region16_clear(&(client->invalidRegion));
-	LeaveCriticalSection(&(client->lock));
-
-	EnterCriticalSection(&surface->lock);
-	rects = region16_rects(&(surface->invalidRegion), &numRects);
-
-	for (UINT32 index = 0; index < numRects; index++)
-		region16_union_rect(&invalidRegion, &invalidRegion, &rects[index]);
+	/* already limited to the surface and the shared sub rect by the capture */
+	invalidRegion = &frame->invalidRegion;
 
-	surfaceRect.left = 0;
-	surfaceRect.top = 0;
-	WINPR_ASSERT(surface->width <= UINT16_MAX);
-	WINPR_ASSERT(surface->height <= UINT16_MAX);
-	surfaceRect.right = (UINT16)surface->width;
-	surfaceRect.bottom = (UINT16)surface->height;
-	region16_intersect_rect(&invalidRegion, &invalidRegion, &surfaceRect);
-
-	if (server->shareSubRect)
-	{
-		region16_intersect_rect(&invalidRegion, &invalidRegion, &(server->subRect));
-	}
-
-	if (region16_is_empty(&invalidRegion))
+	if (region16_is_empty(invalidRegion))
 	{
 		/* No image region need to be updated. Success */
-		goto out;
+		return TRUE;
 	}
 
-	extents = region16_extents(&invalidRegion);
+	extents = region16_extents(invalidRegion);
 	nXSrc = extents->left;
 	nYSrc = extents->top;
 	nWidth = extents->right - extents->left;
 	nHeight = extents->bottom - extents->top;
-	pSrcData = surface->data;
-	nSrcStep = surface->scanline;
-	SrcFormat = surface->format;
+	pSrcData = frame->data;
+	nSrcStep = frame->scanline;
+	SrcFormat = frame->format;
 
 	/* Move to new pSrcData / nXSrc / nYSrc according to sub rect */
 	if (server->shareSubRect)
@@ -1958,6 +3194,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	// PRId64 " height: %" PRId64 " right: %" PRId64 " bottom: %" PRId64, 	nXSrc, nYSrc, nWidth,
 	// nHeight, nXSrc + nWidth, nYSrc + nHeight);
 
+	const UINT64 start = winpr_GetTickCount64NS();
 	if (freerdp_settings_get_bool(settings, FreeRDP_SupportGraphicsPipeline))
 	{
 		if (pStatus->gfxOpened && client->areGfxCapsReady)
@@ -1971,11 +3208,13 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 			{
 				/* Only init surface when we have h264 supported */
 				if (!(ret = shadow_client_rdpgfx_reset_graphic(client)))
-					goto out;
+					return FALSE;
 
 				if (!(ret = shadow_client_rdpgfx_new_surface(client)))
-					goto out;
+					return FALSE;
 
+				/* a new surface has no content, the cache slots are kept */
+				shadow_encoder_invalidate_tiles(client->encoder, FALSE);
 				pStatus->gfxSurfaceCreated = TRUE;
 			}
 
@@ -1983,8 +3222,18 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 			WINPR_ASSERT(nWidth <= UINT16_MAX);
 			WINPR_ASSERT(nHeight >= 0);
 			WINPR_ASSERT(nHeight <= UINT16_MAX);
-			ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
-			                                     (UINT16)nWidth, (UINT16)nHeight);
+
+			/* a move applies to the surface as of the previous capture, the client must show
+			 * exactly that one */
+			rdpShadowEncoder* encoder = client->encoder;
+			const BOOL move = frame->moveValid && !server->shareSubRect && !client->inLobby &&
+			                  encoder->captureSynced &&
+			                  (encoder->captureId + 1 == frame->captureId);
+			ret = shadow_client_send_surface_gfx(
+			    client, pSrcData, nSrcStep, SrcFormat, 0, 0, (UINT16)nWidth, (UINT16)nHeight,
+			    move ? &frame->moveSrc : NULL, move ? &frame->moveDst : NULL);
+			encoder->captureSynced = ret;
+			encoder->captureId = frame->captureId;
 		}
 		else
 		{
@@ -2001,8 +3250,21 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 		WINPR_ASSERT(nWidth <= UINT16_MAX);
 		WINPR_ASSERT(nHeight >= 0);
 		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_surface_bits(client, pSrcData, nSrcStep, (UINT16)nXSrc,
-		                                      (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
+		rects = region16_rects(invalidRegion, &numRects);
+		RFX_RECT* rfxRects = calloc(numRects, sizeof(RFX_RECT));
+
+		for (UINT32 x = 0; rfxRects && (x < numRects); x++)
+		{
+			rfxRects[x].x = (UINT16)(rects[x].left - extents->left + nXSrc);
+			rfxRects[x].y = (UINT16)(rects[x].top - extents->top + nYSrc);
+			rfxRects[x].width = (UINT16)(rects[x].right - rects[x].left);
+			rfxRects[x].height = (UINT16)(rects[x].bottom - rects[x].top);
+		}
+
+		ret = shadow_client_send_surface_bits(client, frame->captureId, pSrcData, nSrcStep,
+		                                      (UINT16)nXSrc, (UINT16)nYSrc, (UINT16)nWidth,
+		                                      (UINT16)nHeight, rfxRects, rfxRects ? numRects : 0);
+		free(rfxRects);
 	}
 	else
 	{
@@ -2018,9 +3280,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 		                                       (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
 	}
 
-out:
-	LeaveCriticalSection(&surface->lock);
-	region16_uninit(&invalidRegion);
+	shadow_encoder_frame_encoded(client->encoder, start, winpr_GetTickCount64NS());
 	return ret;
 }
 
@@ -2043,72 +3303,295 @@ static BOOL shadow_client_send_resize(rdpShadowClient* client, SHADOW_GFX_STATUS
 	peer = context->peer;
 	settings = context->settings;
 
-	if (!peer || !settings)
-		return FALSE;
+	if (!peer || !settings)
+		return FALSE;
+
+	/**
+	 * Unset client activated flag to avoid sending update message during
+	 * resize. DesktopResize will reactive the client and
+	 * shadow_client_activate would be invoked later.
+	 */
+	client->activated = FALSE;
+
+	/* Close Gfx surfaces */
+	if (pStatus->gfxSurfaceCreated)
+	{
+		if (!shadow_client_rdpgfx_release_surface(client))
+			return FALSE;
+
+		pStatus->gfxSurfaceCreated = FALSE;
+	}
+
+	/* Send Resize */
+	if (!shadow_send_desktop_resize(client))
+		return FALSE;
+	shadow_reset_desktop_resize(client);
+
+	/* Clear my invalidRegion. shadow_client_activate refreshes fullscreen */
+	EnterCriticalSection(&(client->lock));
+	region16_clear(&(client->invalidRegion));
+	LeaveCriticalSection(&(client->lock));
+	return TRUE;
+}
+
+/**
+ * Function description
+ * Mark invalid region for client
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_surface_update(rdpShadowClient* client, REGION16* region)
+{
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = NULL;
+	rects = region16_rects(region, &numRects);
+	shadow_client_mark_invalid(client, numRects, rects);
+	return TRUE;
+}
+
+/**
+ * Function description
+ * Only union invalid region from server surface
+ *
+ * @return TRUE on success
+ */
+static INLINE BOOL shadow_client_no_surface_update(rdpShadowClient* client,
+                                                   SHADOW_GFX_STATUS* pStatus)
+{
+	rdpShadowServer* server = NULL;
+	rdpShadowSurface* surface = NULL;
+	WINPR_UNUSED(pStatus);
+	WINPR_ASSERT(client);
+	server = client->server;
+	WINPR_ASSERT(server);
+	surface = client->inLobby ? server->lobby : server->surface;
+	EnterCriticalSection(&surface->lock);
+	const BOOL rc = shadow_client_surface_update(client, &(surface->invalidRegion));
+	LeaveCriticalSection(&surface->lock);
+	return rc;
+}
+
+/* Output of the last frame still waits for the connection, try to push it out */
+static BOOL shadow_client_write_blocked(rdpShadowClient* client)
+{
+	WINPR_ASSERT(client);
+
+	freerdp_peer* peer = client->context.peer;
+	WINPR_ASSERT(peer);
+	WINPR_ASSERT(peer->IsWriteBlocked);
+	WINPR_ASSERT(peer->DrainOutputBuffer);
+
+	if (!peer->IsWriteBlocked(peer))
+		return FALSE;
+	return peer->DrainOutputBuffer(peer) != 0;
+}
+
+/* The encoder waits while the client is still busy with the previous frames, or while the
+ * connection has not sent the last one yet. Runs on the encoder thread of the pipeline. */
+static BOOL shadow_client_frame_ready(rdpShadowClient* client, DWORD* timeout)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(timeout);
+
+	if (!shadow_encoder_frame_due(client->encoder, timeout))
+		return FALSE;
+
+	if (shadow_client_write_blocked(client))
+	{
+		*timeout = SHADOW_CLIENT_BLOCKED_RETRY;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL shadow_client_frame_encode(rdpShadowClient* client, SHADOW_PIPELINE_FRAME* frame,
+                                       void* arg)
+{
+	WINPR_ASSERT(client);
+
+	/* a client that stopped receiving updates gets a full refresh once it continues */
+	if (!client->activated || client->suppressOutput)
+		return TRUE;
+
+	return shadow_client_send_surface_update(client, arg, frame);
+}
+
+/* While no capture waits, send the remaining quality of the progressive tiles at the pace of
+ * the frame rate. Runs on the encoder thread of the pipeline. */
+static BOOL shadow_client_frame_idle(rdpShadowClient* client, DWORD* timeout, void* arg)
+{
+	SHADOW_GFX_STATUS* pStatus = arg;
+	RDPGFX_SURFACE_COMMAND cmd = { 0 };
+	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
+	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+	UINT error = CHANNEL_RC_OK;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(timeout);
+	WINPR_ASSERT(pStatus);
+
+	const rdpSettings* settings = client->context.settings;
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	if (!client->activated || client->suppressOutput || !pStatus->gfxOpened ||
+	    !pStatus->gfxSurfaceCreated || !client->areGfxCapsReady ||
+	    !(encoder->codecs & FREERDP_CODEC_PROGRESSIVE) ||
+	    !freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
+		return TRUE;
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	const int rc = shadow_encoder_progressive_upgrade(encoder, &cmd.data, &cmd.length);
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "progressive_compress_upgrade failed");
+		return FALSE;
+	}
+	if (rc == 0)
+		return TRUE;
+	shadow_client_encode_done(client, "gfx_encode_progressive_upgrade_us", start);
+
+	shadow_client_gfx_frame_init(encoder, &cmdstart, &cmdend);
+	cmd.surfaceId = client->surfaceId;
+	cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	cmd.width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+	cmd.height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+	cmd.right = cmd.width;
+	cmd.bottom = cmd.height;
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
+	          &cmdend);
+	shadow_encoder_frame_encoded(encoder, start, winpr_GetTickCount64NS());
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+
+	/* more tiles may wait, the next upgrade goes out once a frame is due */
+	*timeout = 0;
+	return TRUE;
+}
+
+/* Capture the screen update for the encoder thread, or send the resize to the client. The
+ * encoder picks the capture up as soon as the client and the connection are ready, later
+ * captures until then are merged into it. */
+static BOOL shadow_client_capture_frame(rdpShadowClient* client, rdpShadowPipeline* pipeline,
+                                        SHADOW_GFX_STATUS* pStatus)
+{
+	REGION16 invalidRegion = { 0 };
 
-	/**
-	 * Unset client activated flag to avoid sending update message during
-	 * resize. DesktopResize will reactive the client and
-	 * shadow_client_activate would be invoked later.
-	 */
-	client->activated = FALSE;
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pipeline);
 
-	/* Close Gfx surfaces */
-	if (pStatus->gfxSurfaceCreated)
+	rdpShadowServer* server = client->server;
+	WINPR_ASSERT(server);
+
+	if (shadow_client_recalc_desktop_size(client))
 	{
-		if (!shadow_client_rdpgfx_release_surface(client))
-			return FALSE;
+		/* Screen size changed, do resize */
+		shadow_pipeline_lock(pipeline);
+		shadow_pipeline_reset(pipeline);
+		const BOOL rc = shadow_client_send_resize(client, pStatus);
+		shadow_pipeline_unlock(pipeline);
 
-		pStatus->gfxSurfaceCreated = FALSE;
+		if (!rc)
+		{
+			WLog_ERR(TAG, "Failed to send resize message");
+			return FALSE;
+		}
+		return TRUE;
 	}
 
-	/* Send Resize */
-	if (!shadow_send_desktop_resize(client))
+	rdpShadowSurface* surface = client->inLobby ? server->lobby : server->surface;
+	if (!surface)
 		return FALSE;
-	shadow_reset_desktop_resize(client);
 
-	/* Clear my invalidRegion. shadow_client_activate refreshes fullscreen */
+	region16_init(&invalidRegion);
 	EnterCriticalSection(&(client->lock));
+	BOOL rc = region16_copy(&invalidRegion, &(client->invalidRegion));
 	region16_clear(&(client->invalidRegion));
 	LeaveCriticalSection(&(client->lock));
-	return TRUE;
+
+	EnterCriticalSection(&surface->lock);
+	if (rc)
+		rc = shadow_pipeline_capture(pipeline, surface, &invalidRegion,
+		                             server->shareSubRect ? &server->subRect : NULL);
+	LeaveCriticalSection(&surface->lock);
+
+	region16_uninit(&invalidRegion);
+	if (!rc)
+		WLog_ERR(TAG, "Failed to capture surface update");
+	return rc;
 }
 
-/**
- * Function description
- * Mark invalid region for client
- *
- * @return TRUE on success
- */
-static BOOL shadow_client_surface_update(rdpShadowClient* client, REGION16* region)
+static UINT64 shadow_client_pointer_hash(UINT64 hash, const void* data, size_t length)
 {
-	UINT32 numRects = 0;
-	const RECTANGLE_16* rects = NULL;
-	rects = region16_rects(region, &numRects);
-	shadow_client_mark_invalid(client, numRects, rects);
-	return TRUE;
+	const BYTE* bytes = data;
+
+	/* FNV-1a */
+	for (size_t x = 0; x < length; x++)
+		hash = (hash ^ bytes[x]) * 0x100000001b3ull;
+	return hash;
 }
 
 /**
- * Function description
- * Only union invalid region from server surface
- *
- * @return TRUE on success
+ * Show a pointer shape. The shape the client already shows is not sent again, one it has in
+ * its pointer cache is only selected.
  */
-static INLINE BOOL shadow_client_no_surface_update(rdpShadowClient* client,
-                                                   SHADOW_GFX_STATUS* pStatus)
+static void shadow_client_send_pointer(rdpShadowClient* client,
+                                       const SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE* msg)
 {
-	rdpShadowServer* server = NULL;
-	rdpShadowSurface* surface = NULL;
-	WINPR_UNUSED(pStatus);
-	WINPR_ASSERT(client);
-	server = client->server;
-	WINPR_ASSERT(server);
-	surface = client->inLobby ? server->lobby : server->surface;
-	EnterCriticalSection(&surface->lock);
-	const BOOL rc = shadow_client_surface_update(client, &(surface->invalidRegion));
-	LeaveCriticalSection(&surface->lock);
-	return rc;
+	rdpContext* context = (rdpContext*)client;
+	rdpShadowPointerCache* cache = client->pointerCache;
+	POINTER_NEW_UPDATE pointerNew = { 0 };
+	POINTER_CACHED_UPDATE pointerCached = { 0 };
+
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(msg);
+	WINPR_ASSERT(context->update);
+	WINPR_ASSERT(context->update->pointer);
+
+	const UINT32 shape[] = { msg->xHot, msg->yHot, msg->width, msg->height };
+	UINT64 hash = shadow_client_pointer_hash(0xcbf29ce484222325ull, shape, sizeof(shape));
+	hash = shadow_client_pointer_hash(hash, msg->xorMaskData, msg->lengthXorMask);
+	hash = shadow_client_pointer_hash(hash, msg->andMaskData, msg->lengthAndMask);
+	hash = MAX(hash, 1);
+
+	if (hash == cache->shown)
+		return;
+
+	const UINT32 size = MAX(1, MIN(SHADOW_POINTER_CACHE_SLOTS,
+	                               freerdp_settings_get_uint32(context->settings,
+	                                                           FreeRDP_PointerCacheSize)));
+	UINT32 slot = 0;
+	while ((slot < size) && (cache->slots[slot] != hash))
+		slot++;
+
+	if (slot == size)
+	{
+		POINTER_COLOR_UPDATE* pointerColor = &(pointerNew.colorPtrAttr);
+
+		slot = cache->next;
+		cache->next = (cache->next + 1) % size;
+		cache->slots[slot] = hash;
+
+		pointerNew.xorBpp = 24;
+		pointerColor->cacheIndex = slot;
+		pointerColor->hotSpotX = WINPR_ASSERTING_INT_CAST(UINT16, msg->xHot);
+		pointerColor->hotSpotY = WINPR_ASSERTING_INT_CAST(UINT16, msg->yHot);
+		pointerColor->width = WINPR_ASSERTING_INT_CAST(UINT16, msg->width);
+		pointerColor->height = WINPR_ASSERTING_INT_CAST(UINT16, msg->height);
+		pointerColor->lengthAndMask = WINPR_ASSERTING_INT_CAST(UINT16, msg->lengthAndMask);
+		pointerColor->lengthXorMask = WINPR_ASSERTING_INT_CAST(UINT16, msg->lengthXorMask);
+		pointerColor->xorMaskData = msg->xorMaskData;
+		pointerColor->andMaskData = msg->andMaskData;
+		IFCALL(context->update->pointer->PointerNew, context, &pointerNew);
+	}
+
+	pointerCached.cacheIndex = slot;
+	IFCALL(context->update->pointer->PointerCached, context, &pointerCached);
+	cache->shown = hash;
 }
 
 static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMessage* message)
@@ -2156,33 +3639,15 @@ static int shadow_client_subsystem_process_message(rdpShadowClient* client, wMes
 
 		case SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE_ID:
 		{
-			POINTER_NEW_UPDATE pointerNew = { 0 };
-			POINTER_COLOR_UPDATE* pointerColor = { 0 };
-			POINTER_CACHED_UPDATE pointerCached = { 0 };
 			const SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE* msg =
 			    (const SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE*)message->wParam;
 
 			WINPR_ASSERT(msg);
-			pointerNew.xorBpp = 24;
-			pointerColor = &(pointerNew.colorPtrAttr);
-			pointerColor->cacheIndex = 0;
-			pointerColor->hotSpotX = WINPR_ASSERTING_INT_CAST(UINT16, msg->xHot);
-			pointerColor->hotSpotY = WINPR_ASSERTING_INT_CAST(UINT16, msg->yHot);
-			pointerColor->width = WINPR_ASSERTING_INT_CAST(UINT16, msg->width);
-			pointerColor->height = WINPR_ASSERTING_INT_CAST(UINT16, msg->height);
-			pointerColor->lengthAndMask = WINPR_ASSERTING_INT_CAST(UINT16, msg->lengthAndMask);
-			pointerColor->lengthXorMask = WINPR_ASSERTING_INT_CAST(UINT16, msg->lengthXorMask);
-			pointerColor->xorMaskData = msg->xorMaskData;
-			pointerColor->andMaskData = msg->andMaskData;
-			pointerCached.cacheIndex = pointerColor->cacheIndex;
 
 			if (client->activated)
 			{
-				IFCALL(update->pointer->PointerNew, context, &pointerNew);
 				if (client->server->ShowMouseCursor)
-				{
-					IFCALL(update->pointer->PointerCached, context, &pointerCached);
-				}
+					shadow_client_send_pointer(client, msg);
 				else
 				{
 					POINTER_SYSTEM_UPDATE pointer_system = { 0 };
@@ -2253,6 +3718,8 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	wMessageQueue* MsgQueue = NULL;
 	/* This should only be visited in client thread */
 	SHADOW_GFX_STATUS gfxstatus = { 0 };
+	rdpShadowPipeline* pipeline = NULL;
+	BOOL locked = FALSE;
 	rdpUpdate* update = NULL;
 
 	WINPR_ASSERT(client);
@@ -2310,11 +3777,19 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	WINPR_ASSERT(rc);
 	rc = freerdp_settings_set_bool(settings, FreeRDP_SupportMonitorLayoutPdu, TRUE);
 	WINPR_ASSERT(rc);
+
+	/* frames are encoded and sent on a thread of their own while the next one is captured */
+	pipeline = shadow_pipeline_new(client, shadow_client_frame_ready, shadow_client_frame_encode,
+	                               shadow_client_frame_idle, &gfxstatus);
+	if (!pipeline)
+		goto fail;
+
 	while (1)
 	{
 		HANDLE events[MAXIMUM_WAIT_OBJECTS] = { 0 };
 		DWORD nCount = 0;
 		events[nCount++] = UpdateEvent;
+		events[nCount++] = shadow_pipeline_failed_event(pipeline);
 		{
 			DWORD tmp = peer->GetEventHandles(peer, &events[nCount], 64 - nCount);
 
@@ -2341,42 +3816,29 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 		if (status == WAIT_FAILED)
 			goto fail;
 
+		if (WaitForSingleObject(shadow_pipeline_failed_event(pipeline), 0) == WAIT_OBJECT_0)
+			goto fail;
+
 		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
 		{
-			/* The UpdateEvent means to start sending current frame. It is
+			/* The UpdateEvent means to capture the current frame. It is
 			 * triggered from subsystem implementation and it should ensure
 			 * that the screen and primary surface meta data (width, height,
 			 * scanline, invalid region, etc) is not changed until it is reset
 			 * (at shadow_multiclient_consume). As best practice, subsystem
 			 * implementation should invoke shadow_subsystem_frame_update which
-			 * triggers the event and then wait for completion */
+			 * triggers the event and then wait for completion. The capture only
+			 * copies the changes, the subsystem does not wait for the encoder. */
 			if (client->activated && !client->suppressOutput)
 			{
-				/* Send screen update or resize to this client */
-
-				/* Check resize */
-				if (shadow_client_recalc_desktop_size(client))
-				{
-					/* Screen size changed, do resize */
-					if (!shadow_client_send_resize(client, &gfxstatus))
-					{
-						WLog_ERR(TAG, "Failed to send resize message");
-						break;
-					}
-				}
-				else
-				{
-					/* Send frame */
-					if (!shadow_client_send_surface_update(client, &gfxstatus))
-					{
-						WLog_ERR(TAG, "Failed to send surface update");
-						break;
-					}
-				}
+				/* Capture screen update or send resize to this client */
+				if (!shadow_client_capture_frame(client, pipeline, &gfxstatus))
+					break;
 			}
 			else
 			{
 				/* Our client don't receive graphic updates. Just save the invalid region */
+				shadow_pipeline_invalidate(pipeline);
 				if (!shadow_client_no_surface_update(client, &gfxstatus))
 				{
 					WLog_ERR(TAG, "Failed to handle surface update");
@@ -2391,6 +3853,81 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 			(void)shadow_multiclient_consume(UpdateSubscriber);
 		}
 
+		/* everything below may use the encoder or write to the connection */
+		shadow_pipeline_lock(pipeline);
+		locked = TRUE;
+
+		if (WaitForSingleObject(MessageQueue_Event(MsgQueue), 0) == WAIT_OBJECT_0)
+		{
+			/* Drain messages. Pointer update could be accumulated. */
+			pointerPositionMsg.id = 0;
+			pointerPositionMsg.Free = NULL;
+			pointerAlphaMsg.id = 0;
+			pointerAlphaMsg.Free = NULL;
+			audioVolumeMsg.id = 0;
+			audioVolumeMsg.Free = NULL;
+
+			while (MessageQueue_Peek(MsgQueue, &message, TRUE))
+			{
+				if (message.id == WMQ_QUIT)
+				{
+					break;
+				}
+
+				switch (message.id)
+				{
+					case SHADOW_MSG_OUT_POINTER_POSITION_UPDATE_ID:
+						/* Abandon previous message */
+						shadow_client_free_queued_message(&pointerPositionMsg);
+						pointerPositionMsg = message;
+						break;
+
+					case SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE_ID:
+						/* Abandon previous message */
+						shadow_client_free_queued_message(&pointerAlphaMsg);
+						pointerAlphaMsg = message;
+						break;
+
+					case SHADOW_MSG_OUT_AUDIO_OUT_VOLUME_ID:
+						/* Abandon previous message */
+						shadow_client_free_queued_message(&audioVolumeMsg);
+						audioVolumeMsg = message;
+						break;
+
+					default:
+						shadow_client_subsystem_process_message(client, &message);
+						break;
+				}
+			}
+
+			if (message.id == WMQ_QUIT)
+			{
+				/* Release stored message */
+				shadow_client_free_queued_message(&pointerPositionMsg);
+				shadow_client_free_queued_message(&pointerAlphaMsg);
+				shadow_client_free_queued_message(&audioVolumeMsg);
+				goto fail;
+			}
+			else
+			{
+				/* Process accumulated messages if needed */
+				if (pointerPositionMsg.id)
+				{
+					shadow_client_subsystem_process_message(client, &pointerPositionMsg);
+				}
+
+				if (pointerAlphaMsg.id)
+				{
+					shadow_client_subsystem_process_message(client, &pointerAlphaMsg);
+				}
+
+				if (audioVolumeMsg.id)
+				{
+					shadow_client_subsystem_process_message(client, &audioVolumeMsg);
+				}
+			}
+		}
+
 		WINPR_ASSERT(peer->CheckFileDescriptor);
 		if (!peer->CheckFileDescriptor(peer))
 		{
@@ -2398,6 +3935,23 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 			goto fail;
 		}
 
+		/* Read the PDUs that piled up while we were busy before handing their input to the
+		 * subsystem, so queued pointer motion collapses to the latest position. */
+		for (size_t x = 0; (x < SHADOW_CLIENT_MAX_INPUT_DRAIN) && peer->HasMoreToRead(peer); x++)
+		{
+			if (!peer->CheckFileDescriptor(peer))
+			{
+				WLog_ERR(TAG, "Failed to check FreeRDP file descriptor");
+				goto fail;
+			}
+		}
+
+		if (!shadow_input_flush(client))
+		{
+			WLog_ERR(TAG, "Failed to dispatch input events");
+			goto fail;
+		}
+
 		if (client->activated &&
 		    WTSVirtualChannelManagerIsChannelJoined(client->vcm, DRDYNVC_SVC_CHANNEL_NAME))
 		{
@@ -2432,7 +3986,10 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 					    client->rdpgfx && !gfxstatus.gfxOpened)
 					{
 						client->rdpgfx->FrameAcknowledge = shadow_client_rdpgfx_frame_acknowledge;
+						client->rdpgfx->QoeFrameAcknowledge =
+						    shadow_client_rdpgfx_qoe_frame_acknowledge;
 						client->rdpgfx->CapsAdvertise = shadow_client_rdpgfx_caps_advertise;
+						client->rdpgfx->CacheImportOffer = shadow_client_rdpgfx_cache_import_offer;
 
 						if (!client->rdpgfx->Open(client->rdpgfx))
 						{
@@ -2474,79 +4031,14 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 		}
 #endif
 
-		if (WaitForSingleObject(MessageQueue_Event(MsgQueue), 0) == WAIT_OBJECT_0)
-		{
-			/* Drain messages. Pointer update could be accumulated. */
-			pointerPositionMsg.id = 0;
-			pointerPositionMsg.Free = NULL;
-			pointerAlphaMsg.id = 0;
-			pointerAlphaMsg.Free = NULL;
-			audioVolumeMsg.id = 0;
-			audioVolumeMsg.Free = NULL;
-
-			while (MessageQueue_Peek(MsgQueue, &message, TRUE))
-			{
-				if (message.id == WMQ_QUIT)
-				{
-					break;
-				}
-
-				switch (message.id)
-				{
-					case SHADOW_MSG_OUT_POINTER_POSITION_UPDATE_ID:
-						/* Abandon previous message */
-						shadow_client_free_queued_message(&pointerPositionMsg);
-						pointerPositionMsg = message;
-						break;
-
-					case SHADOW_MSG_OUT_POINTER_ALPHA_UPDATE_ID:
-						/* Abandon previous message */
-						shadow_client_free_queued_message(&pointerAlphaMsg);
-						pointerAlphaMsg = message;
-						break;
-
-					case SHADOW_MSG_OUT_AUDIO_OUT_VOLUME_ID:
-						/* Abandon previous message */
-						shadow_client_free_queued_message(&audioVolumeMsg);
-						audioVolumeMsg = message;
-						break;
-
-					default:
-						shadow_client_subsystem_process_message(client, &message);
-						break;
-				}
-			}
-
-			if (message.id == WMQ_QUIT)
-			{
-				/* Release stored message */
-				shadow_client_free_queued_message(&pointerPositionMsg);
-				shadow_client_free_queued_message(&pointerAlphaMsg);
-				shadow_client_free_queued_message(&audioVolumeMsg);
-				goto fail;
-			}
-			else
-			{
-				/* Process accumulated messages if needed */
-				if (pointerPositionMsg.id)
-				{
-					shadow_client_subsystem_process_message(client, &pointerPositionMsg);
-				}
-
-				if (pointerAlphaMsg.id)
-				{
-					shadow_client_subsystem_process_message(client, &pointerAlphaMsg);
-				}
-
-				if (audioVolumeMsg.id)
-				{
-					shadow_client_subsystem_process_message(client, &audioVolumeMsg);
-				}
-			}
-		}
+		locked = FALSE;
+		shadow_pipeline_unlock(pipeline);
 	}
 
 fail:
+	if (locked)
+		shadow_pipeline_unlock(pipeline);
+	shadow_pipeline_free(pipeline);
 
 	/* Free channels early because we establish channels in post connect */
 #if defined(CHANNEL_AUDIN_SERVER)
@@ -2708,6 +4200,17 @@ int shadow_client_boardcast_msg(rdpShadowServer* server, void* context, UINT32 t
 	shadow_msg_out_addref(&message);
 
 	WINPR_ASSERT(server->clients);
+
+	/* Audio bypasses the client queues, the audio thread frames and encodes it for everyone */
+	if ((type == SHADOW_MSG_OUT_AUDIO_OUT_SAMPLES_ID) && server->audioOut)
+	{
+		if (shadow_audio_out_write(server->audioOut, (const SHADOW_MSG_OUT_AUDIO_OUT_SAMPLES*)msg))
+			count = WINPR_ASSERTING_INT_CAST(int, ArrayList_Count(server->clients));
+
+		shadow_msg_out_release(&message);
+		return count;
+	}
+
 	ArrayList_Lock(server->clients);
 
 	for (size_t index = 0; index < ArrayList_Count(server->clients); index++)
@@ -19,6 +19,7 @@
 #include <freerdp/config.h>
 
 #include <winpr/assert.h>
+#include <winpr/sysinfo.h>
 
 #include "shadow.h"
 
@@ -27,6 +28,20 @@
 #include <freerdp/log.h>
 #define TAG CLIENT_TAG("shadow")
 
+/* limits of the H.264 rate control when following the link bandwidth */
+#define SHADOW_H264_MIN_BITRATE 256000
+#define SHADOW_H264_MAX_QP 51
+
+/* the progressive codec sends one more quality pass each time the link gets 5 times slower */
+#define SHADOW_PROGRESSIVE_FULL_QUALITY_BANDWIDTH 50000
+#define SHADOW_PROGRESSIVE_MAX_PASSES 4
+#define SHADOW_PROGRESSIVE_MIN_UPGRADE 4096
+
+/* limits of the frame rate governor */
+#define SHADOW_ENCODER_MAX_INFLIGHT 2
+#define SHADOW_ENCODER_QUALITY_PERIOD 1000000000ull
+#define SHADOW_H264_MAX_RATE_REDUCTION 2
+
 UINT32 shadow_encoder_preferred_fps(rdpShadowEncoder* encoder)
 {
 	/* Return preferred fps calculated according to the last
@@ -51,31 +66,92 @@ UINT32 shadow_encoder_inflight_frames(rdpShadowEncoder* encoder)
 
 UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder)
 {
-	UINT32 frameId = 0;
-	UINT32 inFlightFrames = shadow_encoder_inflight_frames(encoder);
+	WINPR_ASSERT(encoder);
+
+	/* the send time tells the ack latency when the client acknowledges the frame */
+	const UINT32 frameId = ++encoder->frameId;
+	encoder->frameSent[frameId % SHADOW_ENCODER_FRAME_HISTORY] = winpr_GetTickCount64NS();
+	return frameId;
+}
+
+static UINT64 shadow_encoder_smooth(UINT64 average, UINT64 sample)
+{
+	if (average == 0)
+		return sample;
+	return (average * 7 + sample) / 8;
+}
+
+void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId)
+{
+	WINPR_ASSERT(encoder);
 
 	/*
-	 * Calculate preferred fps according to how much frames are
-	 * in-progress. Note that it only works when subsystem implementation
-	 * calls shadow_encoder_preferred_fps and takes the suggestion.
+	 * Some rdp clients (win7 mstsc) skip the frame ACK if they are
+	 * inactive, the latency is only taken from frames that are still
+	 * in the history.
 	 */
-	if (inFlightFrames > 1)
-	{
-		encoder->fps = (100 / (inFlightFrames + 1) * encoder->maxFps) / 100;
-	}
-	else
+	const UINT32 age = encoder->frameId - frameId;
+	if ((age < SHADOW_ENCODER_FRAME_HISTORY) && (frameId != encoder->lastAckframeId))
 	{
-		encoder->fps += 2;
+		const UINT64 sent = encoder->frameSent[frameId % SHADOW_ENCODER_FRAME_HISTORY];
+		const UINT64 now = winpr_GetTickCount64NS();
 
-		if (encoder->fps > encoder->maxFps)
-			encoder->fps = encoder->maxFps;
+		if ((sent != 0) && (now > sent))
+			encoder->ackLatency = shadow_encoder_smooth(encoder->ackLatency, now - sent);
 	}
 
-	if (encoder->fps < 1)
-		encoder->fps = 1;
+	encoder->lastAckframeId = frameId;
+}
 
-	frameId = ++encoder->frameId;
-	return frameId;
+/**
+ * The time the client needed to decode and render a frame, from a QoE report.
+ */
+void shadow_encoder_frame_decoded(rdpShadowEncoder* encoder, UINT32 ms)
+{
+	WINPR_ASSERT(encoder);
+	encoder->decodeTime = shadow_encoder_smooth(encoder->decodeTime, 1000000ull * ms);
+}
+
+/*
+ * Frames are paced to the slowest of the encoder, the client and the link,
+ * at most SHADOW_ENCODER_MAX_INFLIGHT frames travel at a time.
+ */
+static UINT32 shadow_encoder_govern_fps(rdpShadowEncoder* encoder)
+{
+	const UINT32 inFlightFrames = shadow_encoder_inflight_frames(encoder);
+	UINT64 interval = 1000000000ull / encoder->maxFps;
+
+	interval = MAX(interval, encoder->encodeTime + encoder->encodeTime / 4);
+	interval = MAX(interval, encoder->decodeTime);
+	if (encoder->queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT)
+		interval = MAX(interval, encoder->ackLatency / SHADOW_ENCODER_MAX_INFLIGHT);
+
+	UINT32 fps = (UINT32)(1000000000ull / interval);
+
+	/* acknowledges stopped coming, back off until the client catches up */
+	if (inFlightFrames > SHADOW_ENCODER_MAX_INFLIGHT)
+		fps = MIN(fps, encoder->maxFps / (inFlightFrames + 1));
+
+	return MAX(fps, 1);
+}
+
+/**
+ * Whether the client is ready for the next frame, otherwise \b delay is set to the
+ * milliseconds until it is.
+ */
+BOOL shadow_encoder_frame_due(const rdpShadowEncoder* encoder, DWORD* delay)
+{
+	WINPR_ASSERT(encoder);
+
+	/* captures arrive with some jitter, one slightly early must not halve the rate */
+	const UINT64 now = winpr_GetTickCount64NS();
+	const UINT64 slack = 250000000ull / MAX(encoder->fps, 1);
+	if (now + slack >= encoder->nextFrame)
+		return TRUE;
+
+	if (delay)
+		*delay = (DWORD)((encoder->nextFrame - now + 999999) / 1000000);
+	return FALSE;
 }
 
 static int shadow_encoder_init_grid(rdpShadowEncoder* encoder)
@@ -128,6 +204,70 @@ static int shadow_encoder_uninit_grid(rdpShadowEncoder* encoder)
 	return 0;
 }
 
+static int shadow_encoder_init_tiles(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	encoder->tileGridWidth = (encoder->width + 63) / 64;
+	encoder->tileGridHeight = (encoder->height + 63) / 64;
+	encoder->tileHashes =
+	    calloc(1ull * encoder->tileGridWidth * encoder->tileGridHeight, sizeof(UINT64));
+	encoder->tileActivity =
+	    calloc(1ull * encoder->tileGridWidth * encoder->tileGridHeight, sizeof(UINT16));
+	encoder->cacheKeys = calloc(SHADOW_GFX_CACHE_SLOTS, sizeof(UINT64));
+	encoder->cacheCandidates = calloc(SHADOW_GFX_CACHE_CANDIDATES, sizeof(UINT64));
+
+	if (!encoder->tileHashes || !encoder->tileActivity || !encoder->cacheKeys ||
+	    !encoder->cacheCandidates)
+		return -1;
+
+	return 0;
+}
+
+static void shadow_encoder_uninit_tiles(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	free(encoder->tileHashes);
+	free(encoder->tileActivity);
+	free(encoder->cacheKeys);
+	free(encoder->cacheCandidates);
+	encoder->tileHashes = NULL;
+	encoder->tileActivity = NULL;
+	encoder->cacheKeys = NULL;
+	encoder->cacheCandidates = NULL;
+	encoder->tileGridWidth = 0;
+	encoder->tileGridHeight = 0;
+	encoder->captureSynced = FALSE;
+}
+
+/**
+ * Forget what the client shows, the next update encodes every tile again.
+ * With evict the client cache slots are considered empty as well.
+ */
+void shadow_encoder_invalidate_tiles(rdpShadowEncoder* encoder, BOOL evict)
+{
+	WINPR_ASSERT(encoder);
+
+	if (encoder->tileHashes)
+		memset(encoder->tileHashes, 0,
+		       sizeof(UINT64) * encoder->tileGridWidth * encoder->tileGridHeight);
+	encoder->captureSynced = FALSE;
+
+	if (evict)
+	{
+		if (encoder->cacheKeys)
+			memset(encoder->cacheKeys, 0, sizeof(UINT64) * SHADOW_GFX_CACHE_SLOTS);
+		if (encoder->cacheCandidates)
+			memset(encoder->cacheCandidates, 0, sizeof(UINT64) * SHADOW_GFX_CACHE_CANDIDATES);
+	}
+
+	if (encoder->rfx)
+		rfx_context_invalidate_tile_cache(encoder->rfx, NULL);
+	if (encoder->progressive)
+		progressive_context_invalidate_tile_cache(encoder->progressive, NULL);
+}
+
 static int shadow_encoder_init_rfx(rdpShadowEncoder* encoder)
 {
 	if (!encoder->rfx)
@@ -143,6 +283,8 @@ static int shadow_encoder_init_rfx(rdpShadowEncoder* encoder)
 	rfx_context_set_mode(encoder->rfx, freerdp_settings_get_uint32(encoder->server->settings,
 	                                                               FreeRDP_RemoteFxRlgrMode));
 	rfx_context_set_pixel_format(encoder->rfx, PIXEL_FORMAT_BGRX32);
+	if (!rfx_context_set_tile_cache(encoder->rfx, TRUE))
+		goto fail;
 	encoder->codecs |= FREERDP_CODEC_REMOTEFX;
 	return 1;
 fail:
@@ -209,6 +351,26 @@ static int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 	                                         encoder->maxTileHeight))
 		goto fail;
 
+	/* the first stripe uses the main context */
+	encoder->stripePlanar[0] = encoder->planar;
+	encoder->numStripes = 1;
+	if (encoder->parallel)
+	{
+		SYSTEM_INFO sysinfo = { 0 };
+		GetNativeSystemInfo(&sysinfo);
+
+		const UINT32 stripes = MIN(sysinfo.dwNumberOfProcessors, SHADOW_ENCODER_MAX_STRIPES);
+		for (; encoder->numStripes < stripes; encoder->numStripes++)
+		{
+			BITMAP_PLANAR_CONTEXT** planar = &encoder->stripePlanar[encoder->numStripes];
+			if (!*planar)
+				*planar = freerdp_bitmap_planar_context_new(planarFlags, encoder->maxTileWidth,
+				                                            encoder->maxTileHeight);
+			if (!*planar)
+				break;
+		}
+	}
+
 	encoder->codecs |= FREERDP_CODEC_PLANAR;
 	return 1;
 fail:
@@ -216,6 +378,25 @@ fail:
 	return -1;
 }
 
+static int shadow_encoder_init_clear(rdpShadowEncoder* encoder)
+{
+	if (!encoder->clear)
+		encoder->clear = clear_context_new(TRUE);
+
+	if (!encoder->clear)
+		goto fail;
+
+	if (!clear_context_reset(encoder->clear))
+		goto fail;
+
+	encoder->codecs |= FREERDP_CODEC_CLEARCODEC;
+	return 1;
+fail:
+	clear_context_free(encoder->clear);
+	encoder->clear = NULL;
+	return -1;
+}
+
 static int shadow_encoder_init_interleaved(rdpShadowEncoder* encoder)
 {
 	if (!encoder->interleaved)
@@ -227,6 +408,26 @@ static int shadow_encoder_init_interleaved(rdpShadowEncoder* encoder)
 	if (!bitmap_interleaved_context_reset(encoder->interleaved))
 		goto fail;
 
+	/* the first stripe uses the main context */
+	encoder->stripeInterleaved[0] = encoder->interleaved;
+	encoder->numInterleavedStripes = 1;
+	if (encoder->parallel)
+	{
+		SYSTEM_INFO sysinfo = { 0 };
+		GetNativeSystemInfo(&sysinfo);
+
+		const UINT32 stripes = MIN(sysinfo.dwNumberOfProcessors, SHADOW_ENCODER_MAX_STRIPES);
+		for (; encoder->numInterleavedStripes < stripes; encoder->numInterleavedStripes++)
+		{
+			BITMAP_INTERLEAVED_CONTEXT** interleaved =
+			    &encoder->stripeInterleaved[encoder->numInterleavedStripes];
+			if (!*interleaved)
+				*interleaved = bitmap_interleaved_context_new(TRUE);
+			if (!*interleaved)
+				break;
+		}
+	}
+
 	encoder->codecs |= FREERDP_CODEC_INTERLEAVED;
 	return 1;
 fail:
@@ -234,6 +435,46 @@ fail:
 	return -1;
 }
 
+/* leave a quarter of the link to the other channels and the protocol overhead, halve the rest
+ * for every step the client lags behind */
+static UINT32 shadow_encoder_h264_bitrate(const rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(encoder->server);
+
+	const UINT32 configured = encoder->server->h264BitRate;
+	UINT64 rate = configured;
+	if (encoder->linkBandwidth != 0)
+		rate = MIN(rate, MAX(750ull * encoder->linkBandwidth, SHADOW_H264_MIN_BITRATE));
+
+	return (UINT32)MAX(rate >> encoder->rateReduction, MIN(configured, SHADOW_H264_MIN_BITRATE));
+}
+
+/* a constant QP stream has no target rate, each 6 steps of QP about halve its size */
+static UINT32 shadow_encoder_h264_qp(const rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(encoder->server);
+
+	UINT32 qp = encoder->server->h264QP;
+	for (UINT64 rate = shadow_encoder_h264_bitrate(encoder);
+	     (rate < encoder->server->h264BitRate) && (qp < SHADOW_H264_MAX_QP); rate *= 2)
+		qp += 6;
+	return MIN(qp, SHADOW_H264_MAX_QP);
+}
+
+static BOOL shadow_encoder_h264_rate_control(rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(encoder->h264);
+
+	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_BITRATE,
+	                             shadow_encoder_h264_bitrate(encoder)))
+		return FALSE;
+	return h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_QP,
+	                               shadow_encoder_h264_qp(encoder));
+}
+
 static int shadow_encoder_init_h264(rdpShadowEncoder* encoder)
 {
 	if (!encoder->h264)
@@ -248,13 +489,10 @@ static int shadow_encoder_init_h264(rdpShadowEncoder* encoder)
 	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_RATECONTROL,
 	                             encoder->server->h264RateControlMode))
 		goto fail;
-	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_BITRATE,
-	                             encoder->server->h264BitRate))
-		goto fail;
 	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_FRAMERATE,
 	                             encoder->server->h264FrameRate))
 		goto fail;
-	if (!h264_context_set_option(encoder->h264, H264_CONTEXT_OPTION_QP, encoder->server->h264QP))
+	if (!shadow_encoder_h264_rate_control(encoder))
 		goto fail;
 
 	encoder->codecs |= FREERDP_CODEC_AVC420 | FREERDP_CODEC_AVC444;
@@ -264,6 +502,124 @@ fail:
 	return -1;
 }
 
+/**
+ * Follow the bandwidth estimate of the network auto-detection, in kbit/s.
+ */
+BOOL shadow_encoder_update_network(rdpShadowEncoder* encoder, UINT32 bandwidth)
+{
+	WINPR_ASSERT(encoder);
+
+	if (encoder->linkBandwidth == bandwidth)
+		return TRUE;
+
+	encoder->linkBandwidth = bandwidth;
+	if (!encoder->h264)
+		return TRUE;
+
+	WLog_DBG(TAG, "link bandwidth %" PRIu32 " kbit/s, H.264 bitrate %" PRIu32 ", QP %" PRIu32,
+	         bandwidth, shadow_encoder_h264_bitrate(encoder), shadow_encoder_h264_qp(encoder));
+	return shadow_encoder_h264_rate_control(encoder);
+}
+
+/* trade H.264 quality for frame rate while the client lags behind */
+static void shadow_encoder_adapt_quality(rdpShadowEncoder* encoder, UINT64 now)
+{
+	if (!encoder->h264 || (now - encoder->lastQualityChange < SHADOW_ENCODER_QUALITY_PERIOD))
+		return;
+
+	UINT32 rateReduction = encoder->rateReduction;
+	if ((encoder->fps * 2 < encoder->maxFps) && (rateReduction < SHADOW_H264_MAX_RATE_REDUCTION))
+		rateReduction++;
+	else if ((encoder->fps * 4 >= encoder->maxFps * 3) && (rateReduction > 0))
+		rateReduction--;
+
+	if (rateReduction == encoder->rateReduction)
+		return;
+
+	encoder->rateReduction = rateReduction;
+	encoder->lastQualityChange = now;
+	WLog_DBG(TAG, "%" PRIu32 " fps, H.264 bitrate %" PRIu32 ", QP %" PRIu32, encoder->fps,
+	         shadow_encoder_h264_bitrate(encoder), shadow_encoder_h264_qp(encoder));
+	if (!shadow_encoder_h264_rate_control(encoder))
+		WLog_WARN(TAG, "failed to update the H.264 rate control");
+}
+
+/**
+ * Account a frame that took from \b start to \b end to encode and send, in nanoseconds.
+ */
+void shadow_encoder_frame_encoded(rdpShadowEncoder* encoder, UINT64 start, UINT64 end)
+{
+	WINPR_ASSERT(encoder);
+
+	encoder->encodeTime = shadow_encoder_smooth(encoder->encodeTime, end - start);
+
+	/* slow down at once, speed up gradually */
+	const UINT32 fps = shadow_encoder_govern_fps(encoder);
+	if (fps < encoder->fps)
+		encoder->fps = fps;
+	else
+		encoder->fps = MIN(encoder->fps + 2, fps);
+
+	encoder->nextFrame = start + 1000000000ull / encoder->fps;
+	shadow_encoder_adapt_quality(encoder, end);
+}
+
+/* a slow link gets a coarse picture at once, the quality follows in upgrade passes */
+static UINT32 shadow_encoder_progressive_passes(const rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	UINT32 passes = 1;
+	if (encoder->linkBandwidth == 0)
+		return passes;
+
+	for (UINT32 rate = SHADOW_PROGRESSIVE_FULL_QUALITY_BANDWIDTH;
+	     (encoder->linkBandwidth < rate) && (passes < SHADOW_PROGRESSIVE_MAX_PASSES); rate /= 5)
+		passes++;
+	return passes;
+}
+
+/* upgrades use a quarter of the link per frame interval, like the H.264 rate they leave room
+ * for new content and the other channels */
+static UINT32 shadow_encoder_progressive_upgrade_size(const rdpShadowEncoder* encoder)
+{
+	WINPR_ASSERT(encoder);
+
+	const UINT64 bytes = 125ull * encoder->linkBandwidth / 4 / MAX(encoder->fps, 1);
+	return (UINT32)MIN(MAX(bytes, SHADOW_PROGRESSIVE_MIN_UPGRADE), UINT32_MAX);
+}
+
+/**
+ * Encode the next quality upgrade of the progressive codec, see progressive_compress_upgrade.
+ * The number of passes follows the link bandwidth once all tiles are at full quality, changing
+ * it earlier would lose the tiles still to upgrade.
+ */
+int shadow_encoder_progressive_upgrade(rdpShadowEncoder* encoder, BYTE** ppDstData,
+                                       UINT32* pDstSize)
+{
+	WINPR_ASSERT(encoder);
+
+	if (!encoder->progressive)
+		return 0;
+
+	const int rc = progressive_compress_upgrade(encoder->progressive,
+	                                            shadow_encoder_progressive_upgrade_size(encoder),
+	                                            ppDstData, pDstSize);
+	if (rc != 0)
+		return rc;
+
+	const UINT32 passes = shadow_encoder_progressive_passes(encoder);
+	if (passes == encoder->progressivePasses)
+		return 0;
+
+	WLog_DBG(TAG, "link bandwidth %" PRIu32 " kbit/s, %" PRIu32 " progressive passes",
+	         encoder->linkBandwidth, passes);
+	if (!progressive_context_set_passes(encoder->progressive, passes))
+		return -1;
+	encoder->progressivePasses = passes;
+	return 0;
+}
+
 static int shadow_encoder_init_progressive(rdpShadowEncoder* encoder)
 {
 	WINPR_ASSERT(encoder);
@@ -276,10 +632,19 @@ static int shadow_encoder_init_progressive(rdpShadowEncoder* encoder)
 	if (!progressive_context_reset(encoder->progressive))
 		goto fail;
 
+	if (!progressive_context_set_tile_cache(encoder->progressive, TRUE))
+		goto fail;
+
+	/* no tile waits for an upgrade after the reset */
+	encoder->progressivePasses = shadow_encoder_progressive_passes(encoder);
+	if (!progressive_context_set_passes(encoder->progressive, encoder->progressivePasses))
+		goto fail;
+
 	encoder->codecs |= FREERDP_CODEC_PROGRESSIVE;
 	return 1;
 fail:
 	progressive_context_free(encoder->progressive);
+	encoder->progressive = NULL;
 	return -1;
 }
 
@@ -291,6 +656,9 @@ static int shadow_encoder_init(rdpShadowEncoder* encoder)
 	encoder->maxTileHeight = 64;
 	shadow_encoder_init_grid(encoder);
 
+	if (shadow_encoder_init_tiles(encoder) < 0)
+		return -1;
+
 	if (!encoder->bs)
 		encoder->bs = Stream_New(NULL, 4ULL * encoder->maxTileWidth * encoder->maxTileHeight);
 
@@ -326,6 +694,14 @@ static int shadow_encoder_uninit_nsc(rdpShadowEncoder* encoder)
 
 static int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 {
+	for (size_t x = 1; x < ARRAYSIZE(encoder->stripePlanar); x++)
+	{
+		freerdp_bitmap_planar_context_free(encoder->stripePlanar[x]);
+		encoder->stripePlanar[x] = NULL;
+	}
+	encoder->stripePlanar[0] = NULL;
+	encoder->numStripes = 0;
+
 	if (encoder->planar)
 	{
 		freerdp_bitmap_planar_context_free(encoder->planar);
@@ -336,8 +712,28 @@ static int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 	return 1;
 }
 
+static int shadow_encoder_uninit_clear(rdpShadowEncoder* encoder)
+{
+	if (encoder->clear)
+	{
+		clear_context_free(encoder->clear);
+		encoder->clear = NULL;
+	}
+
+	encoder->codecs &= (UINT32)~FREERDP_CODEC_CLEARCODEC;
+	return 1;
+}
+
 static int shadow_encoder_uninit_interleaved(rdpShadowEncoder* encoder)
 {
+	for (size_t x = 1; x < ARRAYSIZE(encoder->stripeInterleaved); x++)
+	{
+		bitmap_interleaved_context_free(encoder->stripeInterleaved[x]);
+		encoder->stripeInterleaved[x] = NULL;
+	}
+	encoder->stripeInterleaved[0] = NULL;
+	encoder->numInterleavedStripes = 0;
+
 	if (encoder->interleaved)
 	{
 		bitmap_interleaved_context_free(encoder->interleaved);
@@ -376,6 +772,7 @@ static int shadow_encoder_uninit_progressive(rdpShadowEncoder* encoder)
 static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 {
 	shadow_encoder_uninit_grid(encoder);
+	shadow_encoder_uninit_tiles(encoder);
 
 	if (encoder->bs)
 	{
@@ -389,6 +786,8 @@ static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 
 	shadow_encoder_uninit_planar(encoder);
 
+	shadow_encoder_uninit_clear(encoder);
+
 	shadow_encoder_uninit_interleaved(encoder);
 	shadow_encoder_uninit_h264(encoder);
 
@@ -419,9 +818,14 @@ int shadow_encoder_reset(rdpShadowEncoder* encoder)
 		return -1;
 
 	encoder->fps = 16;
-	encoder->maxFps = 32;
+	encoder->maxFps = 60;
 	encoder->frameId = 0;
 	encoder->lastAckframeId = 0;
+	ZeroMemory(encoder->frameSent, sizeof(encoder->frameSent));
+	encoder->ackLatency = 0;
+	encoder->decodeTime = 0;
+	encoder->encodeTime = 0;
+	encoder->nextFrame = 0;
 	encoder->frameAck = freerdp_settings_get_bool(settings, FreeRDP_SurfaceFrameMarkerEnabled);
 	return 1;
 }
@@ -457,6 +861,15 @@ int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs)
 			return -1;
 	}
 
+	if ((codecs & FREERDP_CODEC_CLEARCODEC) && !(encoder->codecs & FREERDP_CODEC_CLEARCODEC))
+	{
+		WLog_DBG(TAG, "initializing ClearCodec encoder");
+		status = shadow_encoder_init_clear(encoder);
+
+		if (status < 0)
+			return -1;
+	}
+
 	if ((codecs & FREERDP_CODEC_INTERLEAVED) && !(encoder->codecs & FREERDP_CODEC_INTERLEAVED))
 	{
 		WLog_DBG(TAG, "initializing interleaved bitmap encoder");
@@ -500,7 +913,15 @@ rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client)
 	encoder->client = client;
 	encoder->server = server;
 	encoder->fps = 16;
-	encoder->maxFps = 32;
+	encoder->maxFps = 60;
+
+	if (!(freerdp_settings_get_uint32(server->settings, FreeRDP_ThreadingFlags) &
+	      THREADING_FLAGS_DISABLE_THREADS))
+	{
+		encoder->parallel = winpr_ParallelFor_New(NULL);
+		if (!encoder->parallel)
+			WLog_WARN(TAG, "winpr_ParallelFor_New failed, encoding single threaded");
+	}
 
 	if (shadow_encoder_init(encoder) < 0)
 	{
@@ -517,5 +938,205 @@ void shadow_encoder_free(rdpShadowEncoder* encoder)
 		return;
 
 	shadow_encoder_uninit(encoder);
+	winpr_ParallelFor_Free(encoder->parallel);
 	free(encoder);
 }
+
+/* RemoteFX frames of the current capture, encoded once for all clients that show it */
+struct rdp_shadow_shared_encoder
+{
+	rdpShadowServer* server;
+	CRITICAL_SECTION lock;
+	RFX_CONTEXT* rfx;
+	wStreamPool* pool;
+
+	/* what the cached messages were encoded from */
+	UINT64 captureId;
+	UINT32 width;
+	UINT32 height;
+	UINT32 maxRequestSize;
+	RFX_RECT* rects;
+	size_t numRects;
+
+	wStream** messages;
+	size_t numMessages;
+};
+
+void shadow_shared_encoder_release(wStream** messages, size_t count)
+{
+	if (!messages)
+		return;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (messages[x])
+			Stream_Release(messages[x]);
+	}
+	free((void*)messages);
+}
+
+static void shadow_shared_encoder_clear(rdpShadowSharedEncoder* shared)
+{
+	WINPR_ASSERT(shared);
+
+	shadow_shared_encoder_release(shared->messages, shared->numMessages);
+	shared->messages = NULL;
+	shared->numMessages = 0;
+	free(shared->rects);
+	shared->rects = NULL;
+	shared->numRects = 0;
+}
+
+static BOOL shadow_shared_encoder_encode(rdpShadowSharedEncoder* shared, UINT64 captureId,
+                                         const RFX_RECT* rects, size_t numRects, const BYTE* data,
+                                         UINT32 width, UINT32 height, UINT32 scanline,
+                                         UINT32 maxRequestSize)
+{
+	size_t numMessages = 0;
+
+	shadow_shared_encoder_clear(shared);
+
+	/* every frame starts with the headers, clients may join at any time */
+	if (!rfx_context_reset(shared->rfx, width, height))
+		return FALSE;
+
+	RFX_MESSAGE_LIST* list = rfx_encode_messages(shared->rfx, rects, numRects, data, width,
+	                                             height, scanline, &numMessages, maxRequestSize);
+	if (!list)
+		return FALSE;
+
+	shared->rects = calloc(numRects, sizeof(RFX_RECT));
+	shared->messages = (wStream**)calloc(numMessages, sizeof(wStream*));
+	BOOL rc = shared->rects && shared->messages;
+
+	for (size_t x = 0; rc && (x < numMessages); x++)
+	{
+		const RFX_MESSAGE* msg = rfx_message_list_get(list, x);
+		wStream* s = StreamPool_Take(shared->pool, 0);
+
+		if (!s)
+		{
+			rc = FALSE;
+			break;
+		}
+
+		shared->messages[shared->numMessages++] = s;
+		Stream_SetPosition(s, 0);
+		rc = rfx_write_message(shared->rfx, s, msg);
+		Stream_SealLength(s);
+	}
+
+	rfx_message_list_free(list);
+
+	if (!rc)
+	{
+		shadow_shared_encoder_clear(shared);
+		return FALSE;
+	}
+
+	memcpy(shared->rects, rects, numRects * sizeof(RFX_RECT));
+	shared->numRects = numRects;
+	shared->captureId = captureId;
+	shared->width = width;
+	shared->height = height;
+	shared->maxRequestSize = maxRequestSize;
+	return TRUE;
+}
+
+/**
+ * Get the RemoteFX messages of a capture, encoded by the first client that asks for them.
+ *
+ * @return references to the messages, to be given back with \b shadow_shared_encoder_release,
+ * or \b NULL if the client has to encode on its own
+ */
+wStream** shadow_shared_encoder_rfx(rdpShadowSharedEncoder* shared, UINT64 captureId,
+                                    const RFX_RECT* rects, size_t numRects, const BYTE* data,
+                                    UINT32 width, UINT32 height, UINT32 scanline,
+                                    UINT32 maxRequestSize, size_t* count)
+{
+	wStream** messages = NULL;
+
+	WINPR_ASSERT(shared);
+	WINPR_ASSERT(rects || (numRects == 0));
+	WINPR_ASSERT(count);
+
+	*count = 0;
+	if (numRects == 0)
+		return NULL;
+
+	EnterCriticalSection(&shared->lock);
+
+	const BOOL cached = (shared->numMessages > 0) && (shared->captureId == captureId);
+	if (!cached || (shared->width != width) || (shared->height != height) ||
+	    (shared->maxRequestSize != maxRequestSize) || (shared->numRects != numRects) ||
+	    (memcmp(shared->rects, rects, numRects * sizeof(RFX_RECT)) != 0))
+	{
+		/* a client that also refreshes other areas of the same capture encodes on its own
+		 * instead of replacing what the others use */
+		if (cached || !shadow_shared_encoder_encode(shared, captureId, rects, numRects, data,
+		                                            width, height, scanline, maxRequestSize))
+			goto out;
+	}
+
+	messages = (wStream**)calloc(shared->numMessages, sizeof(wStream*));
+	if (!messages)
+		goto out;
+
+	for (size_t x = 0; x < shared->numMessages; x++)
+	{
+		Stream_AddRef(shared->messages[x]);
+		messages[x] = shared->messages[x];
+	}
+	*count = shared->numMessages;
+
+out:
+	LeaveCriticalSection(&shared->lock);
+	return messages;
+}
+
+rdpShadowSharedEncoder* shadow_shared_encoder_new(rdpShadowServer* server)
+{
+	WINPR_ASSERT(server);
+
+	rdpShadowSharedEncoder* shared = calloc(1, sizeof(rdpShadowSharedEncoder));
+	if (!shared)
+		return NULL;
+
+	shared->server = server;
+	if (!InitializeCriticalSectionAndSpinCount(&shared->lock, 4000))
+	{
+		free(shared);
+		return NULL;
+	}
+
+	shared->pool = StreamPool_New(TRUE, 64ull * 1024ull);
+	shared->rfx = rfx_context_new_ex(
+	    TRUE, freerdp_settings_get_uint32(server->settings, FreeRDP_ThreadingFlags));
+	if (!shared->pool || !shared->rfx)
+		goto fail;
+
+	/* no tile cache, the messages must not depend on what a single client has seen */
+	rfx_context_set_mode(shared->rfx,
+	                     freerdp_settings_get_uint32(server->settings, FreeRDP_RemoteFxRlgrMode));
+	rfx_context_set_pixel_format(shared->rfx, PIXEL_FORMAT_BGRX32);
+	return shared;
+
+fail:
+	WINPR_PRAGMA_DIAG_PUSH
+	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
+	shadow_shared_encoder_free(shared);
+	WINPR_PRAGMA_DIAG_POP
+	return NULL;
+}
+
+void shadow_shared_encoder_free(rdpShadowSharedEncoder* shared)
+{
+	if (!shared)
+		return;
+
+	shadow_shared_encoder_clear(shared);
+	rfx_context_free(shared->rfx);
+	StreamPool_Free(shared->pool);
+	DeleteCriticalSection(&shared->lock);
+	free(shared);
+}
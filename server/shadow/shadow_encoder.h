@@ -20,6 +20,7 @@
 #define FREERDP_SERVER_SHADOW_ENCODER_H
 
 #include <winpr/crt.h>
+#include <winpr/pool.h>
 #include <winpr/stream.h>
 
 #include <freerdp/freerdp.h>
@@ -27,6 +28,16 @@
 
 #include <freerdp/server/shadow.h>
 
+/* RDPGFX cache slots used for repeated tiles, the limit of clients announcing a small cache */
+#define SHADOW_GFX_CACHE_SLOTS 1024
+#define SHADOW_GFX_CACHE_CANDIDATES 4096
+
+/* frames of the send times kept to match acknowledges against */
+#define SHADOW_ENCODER_FRAME_HISTORY 64
+
+/* stripes of a frame encoded concurrently, each with its own planar or interleaved context */
+#define SHADOW_ENCODER_MAX_STRIPES 16
+
 struct rdp_shadow_encoder
 {
 	rdpShadowClient* client;
@@ -48,16 +59,51 @@ struct rdp_shadow_encoder
 	RFX_CONTEXT* rfx;
 	NSC_CONTEXT* nsc;
 	BITMAP_PLANAR_CONTEXT* planar;
+	CLEAR_CONTEXT* clear;
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
 	H264_CONTEXT* h264;
 	PROGRESSIVE_CONTEXT* progressive;
 
+	/* runs the per tile work of a frame on the thread pool, NULL if threads are disabled */
+	wParallelFor* parallel;
+	BITMAP_PLANAR_CONTEXT* stripePlanar[SHADOW_ENCODER_MAX_STRIPES];
+	UINT32 numStripes;
+	BITMAP_INTERLEAVED_CONTEXT* stripeInterleaved[SHADOW_ENCODER_MAX_STRIPES];
+	UINT32 numInterleavedStripes;
+
 	UINT32 fps;
 	UINT32 maxFps;
 	BOOL frameAck;
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+	/* bandwidth estimate of the link to the client in kbit/s, 0 if unknown */
+	UINT32 linkBandwidth;
+	/* quality passes of the progressive codec, more on slower links */
+	UINT32 progressivePasses;
+
+	/* frame rate governor, all times in nanoseconds and smoothed over several frames */
+	UINT64 frameSent[SHADOW_ENCODER_FRAME_HISTORY];
+	UINT64 ackLatency;
+	UINT64 decodeTime;
+	UINT64 encodeTime;
+	UINT64 nextFrame;
+	UINT64 lastQualityChange;
+	/* the H.264 bit rate is halved this often while the client lags behind */
+	UINT32 rateReduction;
+
+	/* content hash of every 64x64 tile as shown by the client, 0 if unknown */
+	UINT64* tileHashes;
+	UINT32 tileGridWidth;
+	UINT32 tileGridHeight;
+	/* decaying change rate of every tile, tells video like content from text and UI */
+	UINT16* tileActivity;
+	/* content of the RDPGFX cache slots and of tiles seen once (cached when seen again) */
+	UINT64* cacheKeys;
+	UINT64* cacheCandidates;
+	/* the client shows the surface as of captureId, moves of the next capture can be replayed */
+	BOOL captureSynced;
+	UINT64 captureId;
 };
 
 #ifdef __cplusplus
@@ -68,9 +114,28 @@ extern "C"
 	int shadow_encoder_reset(rdpShadowEncoder* encoder);
 	int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs);
 	UINT32 shadow_encoder_create_frame_id(rdpShadowEncoder* encoder);
+	void shadow_encoder_frame_acknowledged(rdpShadowEncoder* encoder, UINT32 frameId);
+	void shadow_encoder_frame_decoded(rdpShadowEncoder* encoder, UINT32 ms);
+	void shadow_encoder_frame_encoded(rdpShadowEncoder* encoder, UINT64 start, UINT64 end);
+	BOOL shadow_encoder_frame_due(const rdpShadowEncoder* encoder, DWORD* delay);
+	void shadow_encoder_invalidate_tiles(rdpShadowEncoder* encoder, BOOL evict);
+	BOOL shadow_encoder_update_network(rdpShadowEncoder* encoder, UINT32 bandwidth);
+	int shadow_encoder_progressive_upgrade(rdpShadowEncoder* encoder, BYTE** ppDstData,
+	                                       UINT32* pDstSize);
 
 	void shadow_encoder_free(rdpShadowEncoder* encoder);
 
+	wStream** shadow_shared_encoder_rfx(rdpShadowSharedEncoder* shared, UINT64 captureId,
+	                                    const RFX_RECT* rects, size_t numRects, const BYTE* data,
+	                                    UINT32 width, UINT32 height, UINT32 scanline,
+	                                    UINT32 maxRequestSize, size_t* count);
+	void shadow_shared_encoder_release(wStream** messages, size_t count);
+
+	void shadow_shared_encoder_free(rdpShadowSharedEncoder* shared);
+
+	WINPR_ATTR_MALLOC(shadow_shared_encoder_free, 1)
+	rdpShadowSharedEncoder* shadow_shared_encoder_new(rdpShadowServer* server);
+
 	WINPR_ATTR_MALLOC(shadow_encoder_free, 1)
 	rdpShadowEncoder* shadow_encoder_new(rdpShadowClient* client);
 
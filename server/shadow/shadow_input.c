@@ -24,10 +24,41 @@
 
 #define TAG SERVER_TAG("shadow.input")
 
-static BOOL shadow_input_synchronize_event(rdpInput* input, UINT32 flags)
+/* events are dispatched at the latest once this many are queued */
+#define SHADOW_INPUT_QUEUE_MAX 256
+
+typedef enum
+{
+	SHADOW_INPUT_SYNCHRONIZE,
+	SHADOW_INPUT_KEYBOARD,
+	SHADOW_INPUT_UNICODE_KEYBOARD,
+	SHADOW_INPUT_MOUSE,
+	SHADOW_INPUT_REL_MOUSE,
+	SHADOW_INPUT_EXTENDED_MOUSE
+} SHADOW_INPUT_EVENT_TYPE;
+
+typedef struct
+{
+	SHADOW_INPUT_EVENT_TYPE type;
+	UINT32 flags;
+	UINT16 code;
+	UINT16 x;
+	UINT16 y;
+	INT32 xDelta;
+	INT32 yDelta;
+} SHADOW_INPUT_EVENT;
+
+struct rdp_shadow_input_queue
+{
+	SHADOW_INPUT_EVENT events[SHADOW_INPUT_QUEUE_MAX];
+	size_t count;
+
+	UINT64 received;
+	UINT64 motionDropped;
+};
+
+static BOOL shadow_input_dispatch_synchronize_event(rdpShadowClient* client, UINT32 flags)
 {
-	WINPR_ASSERT(input);
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 	rdpShadowSubsystem* subsystem = client->server->subsystem;
@@ -40,10 +71,9 @@ static BOOL shadow_input_synchronize_event(rdpInput* input, UINT32 flags)
 	return IFCALLRESULT(TRUE, subsystem->SynchronizeEvent, subsystem, client, flags);
 }
 
-static BOOL shadow_input_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
+static BOOL shadow_input_dispatch_keyboard_event(rdpShadowClient* client, UINT16 flags,
+                                                 UINT8 code)
 {
-	WINPR_ASSERT(input);
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 	rdpShadowSubsystem* subsystem = client->server->subsystem;
@@ -56,10 +86,9 @@ static BOOL shadow_input_keyboard_event(rdpInput* input, UINT16 flags, UINT8 cod
 	return IFCALLRESULT(TRUE, subsystem->KeyboardEvent, subsystem, client, flags, code);
 }
 
-static BOOL shadow_input_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
+static BOOL shadow_input_dispatch_unicode_keyboard_event(rdpShadowClient* client, UINT16 flags,
+                                                         UINT16 code)
 {
-	WINPR_ASSERT(input);
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 	rdpShadowSubsystem* subsystem = client->server->subsystem;
@@ -72,10 +101,9 @@ static BOOL shadow_input_unicode_keyboard_event(rdpInput* input, UINT16 flags, U
 	return IFCALLRESULT(TRUE, subsystem->UnicodeKeyboardEvent, subsystem, client, flags, code);
 }
 
-static BOOL shadow_input_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+static BOOL shadow_input_dispatch_mouse_event(rdpShadowClient* client, UINT16 flags, UINT16 x,
+                                              UINT16 y)
 {
-	WINPR_ASSERT(input);
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 	rdpShadowSubsystem* subsystem = client->server->subsystem;
@@ -109,11 +137,9 @@ static BOOL shadow_input_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UI
 	return IFCALLRESULT(TRUE, subsystem->MouseEvent, subsystem, client, flags, x, y);
 }
 
-static BOOL shadow_input_rel_mouse_event(rdpInput* input, UINT16 flags, INT16 xDelta, INT16 yDelta)
+static BOOL shadow_input_dispatch_rel_mouse_event(rdpShadowClient* client, UINT16 flags,
+                                                  INT16 xDelta, INT16 yDelta)
 {
-	WINPR_ASSERT(input);
-
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 
@@ -134,10 +160,9 @@ static BOOL shadow_input_rel_mouse_event(rdpInput* input, UINT16 flags, INT16 xD
 	return IFCALLRESULT(TRUE, subsystem->RelMouseEvent, subsystem, client, flags, xDelta, yDelta);
 }
 
-static BOOL shadow_input_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+static BOOL shadow_input_dispatch_extended_mouse_event(rdpShadowClient* client, UINT16 flags,
+                                                       UINT16 x, UINT16 y)
 {
-	WINPR_ASSERT(input);
-	rdpShadowClient* client = (rdpShadowClient*)input->context;
 	WINPR_ASSERT(client);
 	WINPR_ASSERT(client->server);
 	rdpShadowSubsystem* subsystem = client->server->subsystem;
@@ -160,6 +185,176 @@ static BOOL shadow_input_extended_mouse_event(rdpInput* input, UINT16 flags, UIN
 	return IFCALLRESULT(TRUE, subsystem->ExtendedMouseEvent, subsystem, client, flags, x, y);
 }
 
+static BOOL shadow_input_dispatch(rdpShadowClient* client, const SHADOW_INPUT_EVENT* event)
+{
+	WINPR_ASSERT(event);
+
+	switch (event->type)
+	{
+		case SHADOW_INPUT_SYNCHRONIZE:
+			return shadow_input_dispatch_synchronize_event(client, event->flags);
+		case SHADOW_INPUT_KEYBOARD:
+			return shadow_input_dispatch_keyboard_event(client, (UINT16)event->flags,
+			                                            (UINT8)event->code);
+		case SHADOW_INPUT_UNICODE_KEYBOARD:
+			return shadow_input_dispatch_unicode_keyboard_event(client, (UINT16)event->flags,
+			                                                    event->code);
+		case SHADOW_INPUT_MOUSE:
+			return shadow_input_dispatch_mouse_event(client, (UINT16)event->flags, event->x,
+			                                         event->y);
+		case SHADOW_INPUT_REL_MOUSE:
+			return shadow_input_dispatch_rel_mouse_event(client, (UINT16)event->flags,
+			                                             (INT16)event->xDelta,
+			                                             (INT16)event->yDelta);
+		case SHADOW_INPUT_EXTENDED_MOUSE:
+			return shadow_input_dispatch_extended_mouse_event(client, (UINT16)event->flags,
+			                                                  event->x, event->y);
+		default:
+			return FALSE;
+	}
+}
+
+BOOL shadow_input_flush(rdpShadowClient* client)
+{
+	BOOL rc = TRUE;
+
+	WINPR_ASSERT(client);
+	rdpShadowInputQueue* queue = client->inputQueue;
+	if (!queue)
+		return TRUE;
+
+	for (size_t x = 0; x < queue->count; x++)
+	{
+		if (!shadow_input_dispatch(client, &queue->events[x]))
+			rc = FALSE;
+	}
+
+	queue->count = 0;
+	return rc;
+}
+
+/**
+ * Motion is only merged into the motion event queued right before it, so buttons, keys and
+ * wheel rotations keep their order relative to each other and to the pointer position.
+ */
+static BOOL shadow_input_merge_motion(rdpShadowInputQueue* queue, const SHADOW_INPUT_EVENT* event)
+{
+	WINPR_ASSERT(queue);
+	WINPR_ASSERT(event);
+
+	if ((queue->count == 0) || (event->flags != PTR_FLAGS_MOVE))
+		return FALSE;
+
+	SHADOW_INPUT_EVENT* last = &queue->events[queue->count - 1];
+	if ((last->type != event->type) || (last->flags != PTR_FLAGS_MOVE))
+		return FALSE;
+
+	switch (event->type)
+	{
+		case SHADOW_INPUT_MOUSE:
+			last->x = event->x;
+			last->y = event->y;
+			break;
+
+		case SHADOW_INPUT_REL_MOUSE:
+		{
+			const INT32 xDelta = last->xDelta + event->xDelta;
+			const INT32 yDelta = last->yDelta + event->yDelta;
+			if ((xDelta < INT16_MIN) || (xDelta > INT16_MAX) || (yDelta < INT16_MIN) ||
+			    (yDelta > INT16_MAX))
+				return FALSE;
+			last->xDelta = xDelta;
+			last->yDelta = yDelta;
+		}
+		break;
+
+		default:
+			return FALSE;
+	}
+
+	queue->motionDropped++;
+	return TRUE;
+}
+
+static BOOL shadow_input_enqueue(rdpInput* input, const SHADOW_INPUT_EVENT* event)
+{
+	WINPR_ASSERT(input);
+	rdpShadowClient* client = (rdpShadowClient*)input->context;
+	WINPR_ASSERT(client);
+
+	rdpShadowInputQueue* queue = client->inputQueue;
+	if (!queue)
+		return shadow_input_dispatch(client, event);
+
+	queue->received++;
+	if (shadow_input_merge_motion(queue, event))
+		return TRUE;
+
+	if ((queue->count == ARRAYSIZE(queue->events)) && !shadow_input_flush(client))
+		return FALSE;
+
+	queue->events[queue->count++] = *event;
+	return TRUE;
+}
+
+static BOOL shadow_input_synchronize_event(rdpInput* input, UINT32 flags)
+{
+	const SHADOW_INPUT_EVENT event = { .type = SHADOW_INPUT_SYNCHRONIZE, .flags = flags };
+	return shadow_input_enqueue(input, &event);
+}
+
+static BOOL shadow_input_keyboard_event(rdpInput* input, UINT16 flags, UINT8 code)
+{
+	const SHADOW_INPUT_EVENT event = { .type = SHADOW_INPUT_KEYBOARD, .flags = flags, .code = code };
+	return shadow_input_enqueue(input, &event);
+}
+
+static BOOL shadow_input_unicode_keyboard_event(rdpInput* input, UINT16 flags, UINT16 code)
+{
+	const SHADOW_INPUT_EVENT event = { .type = SHADOW_INPUT_UNICODE_KEYBOARD,
+		                               .flags = flags,
+		                               .code = code };
+	return shadow_input_enqueue(input, &event);
+}
+
+static BOOL shadow_input_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+{
+	const SHADOW_INPUT_EVENT event = { .type = SHADOW_INPUT_MOUSE, .flags = flags, .x = x, .y = y };
+	return shadow_input_enqueue(input, &event);
+}
+
+static BOOL shadow_input_rel_mouse_event(rdpInput* input, UINT16 flags, INT16 xDelta, INT16 yDelta)
+{
+	const SHADOW_INPUT_EVENT event = { .type = SHADOW_INPUT_REL_MOUSE,
+		                               .flags = flags,
+		                               .xDelta = xDelta,
+		                               .yDelta = yDelta };
+	return shadow_input_enqueue(input, &event);
+}
+
+static BOOL shadow_input_extended_mouse_event(rdpInput* input, UINT16 flags, UINT16 x, UINT16 y)
+{
+	const SHADOW_INPUT_EVENT event = {
+		.type = SHADOW_INPUT_EXTENDED_MOUSE, .flags = flags, .x = x, .y = y
+	};
+	return shadow_input_enqueue(input, &event);
+}
+
+rdpShadowInputQueue* shadow_input_queue_new(void)
+{
+	return calloc(1, sizeof(rdpShadowInputQueue));
+}
+
+void shadow_input_queue_free(rdpShadowInputQueue* queue)
+{
+	if (!queue)
+		return;
+
+	WLog_DBG(TAG, "%" PRIu64 " input events received, %" PRIu64 " motion events merged",
+	         queue->received, queue->motionDropped);
+	free(queue);
+}
+
 void shadow_input_register_callbacks(rdpInput* input)
 {
 	WINPR_ASSERT(input);
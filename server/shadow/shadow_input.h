@@ -28,6 +28,14 @@ extern "C"
 
 	void shadow_input_register_callbacks(rdpInput* input);
 
+	void shadow_input_queue_free(rdpShadowInputQueue* queue);
+
+	WINPR_ATTR_MALLOC(shadow_input_queue_free, 1)
+	rdpShadowInputQueue* shadow_input_queue_new(void);
+
+	/** Dispatches the input events that were queued while reading the last PDUs */
+	BOOL shadow_input_flush(rdpShadowClient* client);
+
 #ifdef __cplusplus
 }
 #endif
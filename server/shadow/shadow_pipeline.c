@@ -0,0 +1,379 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/log.h>
+
+#include "shadow_pipeline.h"
+
+#define TAG SERVER_TAG("shadow.pipeline")
+
+/*
+ * The client thread captures into one frame while the encoder thread works on the other one.
+ * Captures arriving before the encoder is ready are merged into the pending frame, so at most
+ * one frame waits and the encoder always picks up the newest content.
+ */
+struct rdp_shadow_pipeline
+{
+	rdpShadowClient* client;
+	pfnShadowPipelineReady Ready;
+	pfnShadowPipelineEncode Encode;
+	pfnShadowPipelineIdle Idle;
+	void* arg;
+
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE frameEvent;
+	HANDLE failedEvent;
+
+	CRITICAL_SECTION encodeLock;
+	CRITICAL_SECTION lock;
+
+	SHADOW_PIPELINE_FRAME frames[2];
+	/* areas of each frame that are older than the last capture */
+	REGION16 stale[2];
+	size_t pending;
+	BOOL hasPending;
+	const rdpShadowSurface* source;
+};
+
+static BOOL shadow_pipeline_region_union(REGION16* dst, const REGION16* src)
+{
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(src, &numRects);
+	return region16_union_rects(dst, dst, rects, numRects);
+}
+
+static BOOL shadow_pipeline_frame_alloc(SHADOW_PIPELINE_FRAME* frame,
+                                        const rdpShadowSurface* surface)
+{
+	WINPR_ASSERT(frame);
+	WINPR_ASSERT(surface);
+
+	if ((frame->size == surface->dataSize) && (frame->scanline == surface->scanline) &&
+	    (frame->width == surface->width) && (frame->height == surface->height) &&
+	    (frame->format == surface->format))
+		return TRUE;
+
+	winpr_LargeFree(frame->data, frame->size);
+	frame->size = 0;
+	frame->data = winpr_LargeAlloc(surface->dataSize, 0);
+	if (!frame->data)
+		return FALSE;
+
+	frame->size = surface->dataSize;
+	frame->scanline = surface->scanline;
+	frame->width = surface->width;
+	frame->height = surface->height;
+	frame->format = surface->format;
+	return TRUE;
+}
+
+static void shadow_pipeline_frame_copy(SHADOW_PIPELINE_FRAME* frame,
+                                       const rdpShadowSurface* surface, const REGION16* region)
+{
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(region, &numRects);
+	const size_t bpp = FreeRDPGetBytesPerPixel(surface->format);
+
+	WINPR_ASSERT(frame->scanline == surface->scanline);
+
+	for (UINT32 x = 0; x < numRects; x++)
+	{
+		const RECTANGLE_16* rect = &rects[x];
+		const size_t offset = rect->left * bpp;
+		const size_t length = (rect->right - rect->left) * bpp;
+
+		for (size_t y = rect->top; y < rect->bottom; y++)
+		{
+			const size_t line = y * surface->scanline + offset;
+			memcpy(&frame->data[line], &surface->data[line], length);
+		}
+	}
+}
+
+/* Hands the pending frame to the encoder, the capture continues with the other one */
+static SHADOW_PIPELINE_FRAME* shadow_pipeline_take(rdpShadowPipeline* pipeline)
+{
+	SHADOW_PIPELINE_FRAME* frame = NULL;
+
+	EnterCriticalSection(&pipeline->lock);
+	if (pipeline->hasPending)
+	{
+		frame = &pipeline->frames[pipeline->pending];
+		pipeline->pending = (pipeline->pending + 1) % ARRAYSIZE(pipeline->frames);
+		pipeline->hasPending = FALSE;
+		region16_clear(&pipeline->frames[pipeline->pending].invalidRegion);
+	}
+	(void)ResetEvent(pipeline->frameEvent);
+	LeaveCriticalSection(&pipeline->lock);
+	return frame;
+}
+
+static DWORD WINAPI shadow_pipeline_thread(LPVOID arg)
+{
+	rdpShadowPipeline* pipeline = arg;
+	DWORD timeout = INFINITE;
+	BOOL deferred = FALSE;
+
+	WINPR_ASSERT(pipeline);
+
+	while (1)
+	{
+		HANDLE events[] = { pipeline->stopEvent, pipeline->frameEvent };
+
+		/* a deferred frame only waits for its time, newer captures are merged meanwhile */
+		const DWORD status =
+		    WaitForMultipleObjects(deferred ? 1 : ARRAYSIZE(events), events, FALSE, timeout);
+		if ((status == WAIT_OBJECT_0) || (status == WAIT_FAILED))
+			break;
+
+		BOOL rc = TRUE;
+		timeout = INFINITE;
+		deferred = FALSE;
+
+		EnterCriticalSection(&pipeline->encodeLock);
+		if (!pipeline->Ready(pipeline->client, &timeout))
+			deferred = TRUE;
+		else
+		{
+			SHADOW_PIPELINE_FRAME* frame = shadow_pipeline_take(pipeline);
+			if (frame)
+			{
+				rc = pipeline->Encode(pipeline->client, frame, pipeline->arg);
+
+				/* the idle work gets its turn once the next frame is due */
+				if (pipeline->Idle)
+					timeout = 0;
+			}
+			else if (pipeline->Idle)
+				rc = pipeline->Idle(pipeline->client, &timeout, pipeline->arg);
+		}
+		LeaveCriticalSection(&pipeline->encodeLock);
+
+		if (!rc)
+		{
+			WLog_ERR(TAG, "Failed to send surface update");
+			(void)SetEvent(pipeline->failedEvent);
+			break;
+		}
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+rdpShadowPipeline* shadow_pipeline_new(rdpShadowClient* client, pfnShadowPipelineReady ready,
+                                       pfnShadowPipelineEncode encode, pfnShadowPipelineIdle idle,
+                                       void* arg)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(ready);
+	WINPR_ASSERT(encode);
+
+	rdpShadowPipeline* pipeline = calloc(1, sizeof(rdpShadowPipeline));
+	if (!pipeline)
+		return NULL;
+
+	pipeline->client = client;
+	pipeline->Ready = ready;
+	pipeline->Encode = encode;
+	pipeline->Idle = idle;
+	pipeline->arg = arg;
+
+	for (size_t x = 0; x < ARRAYSIZE(pipeline->frames); x++)
+	{
+		region16_init(&pipeline->frames[x].invalidRegion);
+		region16_init(&pipeline->stale[x]);
+	}
+
+	if (!InitializeCriticalSectionAndSpinCount(&pipeline->lock, 4000))
+		goto fail_lock;
+	if (!InitializeCriticalSectionAndSpinCount(&pipeline->encodeLock, 4000))
+		goto fail_encode_lock;
+
+	pipeline->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pipeline->frameEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pipeline->failedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!pipeline->stopEvent || !pipeline->frameEvent || !pipeline->failedEvent)
+		goto fail;
+
+	pipeline->thread = CreateThread(NULL, 0, shadow_pipeline_thread, pipeline, 0, NULL);
+	if (!pipeline->thread)
+		goto fail;
+
+	return pipeline;
+
+fail:
+	(void)CloseHandle(pipeline->stopEvent);
+	(void)CloseHandle(pipeline->frameEvent);
+	(void)CloseHandle(pipeline->failedEvent);
+	DeleteCriticalSection(&pipeline->encodeLock);
+fail_encode_lock:
+	DeleteCriticalSection(&pipeline->lock);
+fail_lock:
+	for (size_t x = 0; x < ARRAYSIZE(pipeline->frames); x++)
+	{
+		region16_uninit(&pipeline->frames[x].invalidRegion);
+		region16_uninit(&pipeline->stale[x]);
+	}
+	free(pipeline);
+	return NULL;
+}
+
+void shadow_pipeline_free(rdpShadowPipeline* pipeline)
+{
+	if (!pipeline)
+		return;
+
+	(void)SetEvent(pipeline->stopEvent);
+	(void)WaitForSingleObject(pipeline->thread, INFINITE);
+	(void)CloseHandle(pipeline->thread);
+
+	(void)CloseHandle(pipeline->stopEvent);
+	(void)CloseHandle(pipeline->frameEvent);
+	(void)CloseHandle(pipeline->failedEvent);
+	DeleteCriticalSection(&pipeline->encodeLock);
+	DeleteCriticalSection(&pipeline->lock);
+
+	for (size_t x = 0; x < ARRAYSIZE(pipeline->frames); x++)
+	{
+		SHADOW_PIPELINE_FRAME* frame = &pipeline->frames[x];
+		winpr_LargeFree(frame->data, frame->size);
+		region16_uninit(&frame->invalidRegion);
+		region16_uninit(&pipeline->stale[x]);
+	}
+	free(pipeline);
+}
+
+HANDLE shadow_pipeline_failed_event(rdpShadowPipeline* pipeline)
+{
+	WINPR_ASSERT(pipeline);
+	return pipeline->failedEvent;
+}
+
+void shadow_pipeline_lock(rdpShadowPipeline* pipeline)
+{
+	WINPR_ASSERT(pipeline);
+	EnterCriticalSection(&pipeline->encodeLock);
+}
+
+void shadow_pipeline_unlock(rdpShadowPipeline* pipeline)
+{
+	WINPR_ASSERT(pipeline);
+	LeaveCriticalSection(&pipeline->encodeLock);
+}
+
+BOOL shadow_pipeline_capture(rdpShadowPipeline* pipeline, const rdpShadowSurface* surface,
+                             const REGION16* invalidRegion, const RECTANGLE_16* clip)
+{
+	BOOL rc = FALSE;
+	REGION16 changed = { 0 };
+
+	WINPR_ASSERT(pipeline);
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(invalidRegion);
+
+	WINPR_ASSERT(surface->width <= UINT16_MAX);
+	WINPR_ASSERT(surface->height <= UINT16_MAX);
+	const RECTANGLE_16 surfaceRect = { 0, 0, (UINT16)surface->width, (UINT16)surface->height };
+
+	region16_init(&changed);
+	EnterCriticalSection(&pipeline->lock);
+
+	const size_t pending = pipeline->pending;
+	const size_t other = (pending + 1) % ARRAYSIZE(pipeline->frames);
+	SHADOW_PIPELINE_FRAME* frame = &pipeline->frames[pending];
+
+	/* a new source or geometry invalidates both copies and everything the client shows */
+	const BOOL reset = (pipeline->source != surface) || (frame->width != surface->width) ||
+	                   (frame->height != surface->height) || (frame->format != surface->format);
+	if (!shadow_pipeline_frame_alloc(frame, surface))
+		goto out;
+
+	if (reset)
+	{
+		pipeline->source = surface;
+		for (size_t x = 0; x < ARRAYSIZE(pipeline->stale); x++)
+		{
+			if (!region16_union_rect(&pipeline->stale[x], &pipeline->stale[x], &surfaceRect))
+				goto out;
+		}
+		if (!region16_union_rect(&frame->invalidRegion, &frame->invalidRegion, &surfaceRect))
+			goto out;
+	}
+
+	if (!region16_intersect_rect(&changed, &surface->invalidRegion, &surfaceRect))
+		goto out;
+
+	/* bring the frame up to date, the other one misses this capture from now on */
+	if (!shadow_pipeline_region_union(&pipeline->stale[pending], &changed) ||
+	    !region16_intersect_rect(&pipeline->stale[pending], &pipeline->stale[pending],
+	                             &surfaceRect))
+		goto out;
+	shadow_pipeline_frame_copy(frame, surface, &pipeline->stale[pending]);
+	region16_clear(&pipeline->stale[pending]);
+	if (!shadow_pipeline_region_union(&pipeline->stale[other], &changed))
+		goto out;
+
+	if (!shadow_pipeline_region_union(&frame->invalidRegion, &changed) ||
+	    !shadow_pipeline_region_union(&frame->invalidRegion, invalidRegion) ||
+	    !region16_intersect_rect(&frame->invalidRegion, &frame->invalidRegion, &surfaceRect))
+		goto out;
+	if (clip && !region16_intersect_rect(&frame->invalidRegion, &frame->invalidRegion, clip))
+		goto out;
+
+	frame->captureId = surface->captureId;
+	frame->moveValid = surface->moveValid;
+	frame->moveSrc = surface->moveSrc;
+	frame->moveDst = surface->moveDst;
+
+	pipeline->hasPending = TRUE;
+	(void)SetEvent(pipeline->frameEvent);
+	rc = TRUE;
+
+out:
+	LeaveCriticalSection(&pipeline->lock);
+	region16_uninit(&changed);
+	return rc;
+}
+
+void shadow_pipeline_invalidate(rdpShadowPipeline* pipeline)
+{
+	WINPR_ASSERT(pipeline);
+
+	EnterCriticalSection(&pipeline->lock);
+	pipeline->source = NULL;
+	LeaveCriticalSection(&pipeline->lock);
+}
+
+void shadow_pipeline_reset(rdpShadowPipeline* pipeline)
+{
+	WINPR_ASSERT(pipeline);
+
+	EnterCriticalSection(&pipeline->lock);
+	pipeline->source = NULL;
+	pipeline->hasPending = FALSE;
+	for (size_t x = 0; x < ARRAYSIZE(pipeline->frames); x++)
+		region16_clear(&pipeline->frames[x].invalidRegion);
+	(void)ResetEvent(pipeline->frameEvent);
+	LeaveCriticalSection(&pipeline->lock);
+}
@@ -0,0 +1,86 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_PIPELINE_H
+#define FREERDP_SERVER_SHADOW_PIPELINE_H
+
+#include <freerdp/server/shadow.h>
+
+typedef struct rdp_shadow_pipeline rdpShadowPipeline;
+
+/** A captured frame, the changes of all captures since the last encoded one */
+typedef struct
+{
+	BYTE* data;
+	size_t size;
+	UINT32 width;
+	UINT32 height;
+	UINT32 scanline;
+	UINT32 format;
+
+	REGION16 invalidRegion;
+
+	UINT64 captureId;
+	BOOL moveValid;
+	RECTANGLE_16 moveSrc;
+	RECTANGLE_16 moveDst;
+} SHADOW_PIPELINE_FRAME;
+
+/** Returns FALSE if the frame has to wait, timeout is then the time to wait in ms */
+typedef BOOL (*pfnShadowPipelineReady)(rdpShadowClient* client, DWORD* timeout);
+typedef BOOL (*pfnShadowPipelineEncode)(rdpShadowClient* client, SHADOW_PIPELINE_FRAME* frame,
+                                        void* arg);
+/** Runs when a frame would be due but none waits. Set timeout to run again, e.g. while there
+ *  is more to send, it is INFINITE otherwise */
+typedef BOOL (*pfnShadowPipelineIdle)(rdpShadowClient* client, DWORD* timeout, void* arg);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	void shadow_pipeline_free(rdpShadowPipeline* pipeline);
+
+	WINPR_ATTR_MALLOC(shadow_pipeline_free, 1)
+	rdpShadowPipeline* shadow_pipeline_new(rdpShadowClient* client, pfnShadowPipelineReady ready,
+	                                       pfnShadowPipelineEncode encode,
+	                                       pfnShadowPipelineIdle idle, void* arg);
+
+	/** Signaled once encoding a frame failed, the pipeline is stopped then */
+	HANDLE shadow_pipeline_failed_event(rdpShadowPipeline* pipeline);
+
+	/** Serializes the encoder thread with everything else using the encoder or the transport */
+	void shadow_pipeline_lock(rdpShadowPipeline* pipeline);
+	void shadow_pipeline_unlock(rdpShadowPipeline* pipeline);
+
+	/**
+	 * Copies the changes of the surface to the frame the encoder picks up next. Must be
+	 * called while the subsystem holds the surface, i.e. before the update event is consumed.
+	 */
+	BOOL shadow_pipeline_capture(rdpShadowPipeline* pipeline, const rdpShadowSurface* surface,
+	                             const REGION16* invalidRegion, const RECTANGLE_16* clip);
+
+	/** The next capture copies the whole surface again */
+	void shadow_pipeline_invalidate(rdpShadowPipeline* pipeline);
+
+	/** Drops the frame not encoded yet, for a resize. Call with the pipeline locked. */
+	void shadow_pipeline_reset(rdpShadowPipeline* pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_PIPELINE_H */
@@ -21,6 +21,7 @@
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/cast.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/log.h>
 #include <freerdp/codec/dsp.h>
@@ -32,8 +33,76 @@
 
 #define TAG SERVER_TAG("shadow")
 
+/* Below this measured bandwidth, in kbit/s, several Opus frames share one wave PDU */
+#define SHADOW_RDPSND_LOW_BANDWIDTH 1000
+#define SHADOW_RDPSND_LOW_BANDWIDTH_FRAMES 3
+
+/* Captured audio is forwarded in frames of this duration, the Opus frame duration of the clients */
+#define SHADOW_RDPSND_FRAME_MS 20
+/* Audio buffered ahead of the audio thread, the oldest samples are dropped beyond that */
+#define SHADOW_RDPSND_RING_MS 200
+/* Encoders shared by all clients of the same format, clients of other formats encode alone */
+#define SHADOW_RDPSND_MAX_SHARED 8
+#define SHADOW_RDPSND_FEC_PACKET_LOSS 10
+/* Clients announcing this channel version accept pre-encoded samples in wave2 PDUs */
+#define SHADOW_RDPSND_WAVE2_VERSION 0x08
+
+typedef struct
+{
+	AUDIO_FORMAT format;
+	FREERDP_DSP_CONTEXT* dsp;
+	wStream* packet;
+	UINT64 frameNo;
+} SHADOW_RDPSND_SHARED;
+
+struct rdp_shadow_audio_out
+{
+	rdpShadowServer* server;
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE dataEvent;
+	CRITICAL_SECTION lock;
+
+	/* PCM as captured, guarded by lock */
+	AUDIO_FORMAT format;
+	size_t bytesPerFrame;
+	BYTE* ring;
+	size_t ringFrames;
+	size_t readPos;
+	size_t fill;
+	/* capture time of the sample at readPos in nanoseconds */
+	UINT64 readTime;
+
+	/* owned by the audio thread */
+	AUDIO_FORMAT frameFormat;
+	BYTE* frame;
+	size_t frameSize;
+	UINT64 frameNo;
+	SHADOW_RDPSND_SHARED shared[SHADOW_RDPSND_MAX_SHARED];
+	size_t numShared;
+};
+
+static void rdpsnd_select_opus_batching(RdpsndServerContext* context)
+{
+	rdpShadowClient* client = (rdpShadowClient*)context->data;
+	UINT32 bandwidth = 0;
+
+	WINPR_ASSERT(client);
+
+	if (client->context.autodetect)
+		bandwidth = client->context.autodetect->netCharBandwidth;
+
+	/* 0 means not measured, keep the lowest latency in that case */
+	if ((bandwidth > 0) && (bandwidth < SHADOW_RDPSND_LOW_BANDWIDTH))
+		context->opusFramesPerPacket = SHADOW_RDPSND_LOW_BANDWIDTH_FRAMES;
+	else
+		context->opusFramesPerPacket = 1;
+}
+
 static void rdpsnd_activated(RdpsndServerContext* context)
 {
+	rdpsnd_select_opus_batching(context);
+
 	for (size_t i = 0; i < context->num_client_formats; i++)
 	{
 		for (size_t j = 0; j < context->num_server_formats; j++)
@@ -74,6 +143,9 @@ int shadow_client_rdpsnd_init(rdpShadowClient* client)
 	if (rdpsnd->num_server_formats > 0)
 		rdpsnd->src_format = &rdpsnd->server_formats[0];
 
+	rdpsnd->opusFrameDuration = 20;
+	rdpsnd->opusFramesPerPacket = 1;
+	rdpsnd->opusInbandFEC = TRUE;
 	rdpsnd->Activated = rdpsnd_activated;
 	rdpsnd->Initialize(rdpsnd, TRUE);
 	return 1;
@@ -81,10 +153,414 @@ int shadow_client_rdpsnd_init(rdpShadowClient* client)
 
 void shadow_client_rdpsnd_uninit(rdpShadowClient* client)
 {
-	if (client->rdpsnd)
+	RdpsndServerContext* rdpsnd = client->rdpsnd;
+
+	if (!rdpsnd)
+		return;
+
+	/* The audio thread sends to the clients with the client list locked */
+	WINPR_ASSERT(client->server);
+	ArrayList_Lock(client->server->clients);
+	client->rdpsnd = NULL;
+	ArrayList_Unlock(client->server->clients);
+
+	rdpsnd->Stop(rdpsnd);
+	rdpsnd_server_context_free(rdpsnd);
+}
+
+static UINT64 shadow_audio_out_duration(const AUDIO_FORMAT* format, size_t frames)
+{
+	return 1000000000ull * frames / format->nSamplesPerSec;
+}
+
+static BOOL shadow_audio_out_same_format(const AUDIO_FORMAT* a, const AUDIO_FORMAT* b)
+{
+	if ((a->wFormatTag != b->wFormatTag) || (a->nChannels != b->nChannels) ||
+	    (a->nSamplesPerSec != b->nSamplesPerSec) || (a->nAvgBytesPerSec != b->nAvgBytesPerSec) ||
+	    (a->nBlockAlign != b->nBlockAlign) || (a->wBitsPerSample != b->wBitsPerSample) ||
+	    (a->cbSize != b->cbSize))
+		return FALSE;
+
+	return (a->cbSize == 0) || (memcmp(a->data, b->data, a->cbSize) == 0);
+}
+
+static BOOL shadow_audio_out_reset(rdpShadowAudioOut* audio, const AUDIO_FORMAT* format)
+{
+	const size_t bytesPerFrame = 1ull * format->nChannels * format->wBitsPerSample / 8;
+	const size_t ringFrames = 1ull * format->nSamplesPerSec * SHADOW_RDPSND_RING_MS / 1000;
+
+	BYTE* ring = realloc(audio->ring, ringFrames * bytesPerFrame);
+	if (!ring)
+		return FALSE;
+
+	audio->ring = ring;
+	audio->ringFrames = ringFrames;
+	audio->bytesPerFrame = bytesPerFrame;
+	audio->readPos = 0;
+	audio->fill = 0;
+	audio->format = *format;
+	audio->format.cbSize = 0;
+	audio->format.data = NULL;
+	return TRUE;
+}
+
+/**
+ * Queues captured PCM samples for the audio thread.
+ *
+ * The caller returns as soon as the samples are copied, encoding and sending happen on the
+ * audio thread in frames of SHADOW_RDPSND_FRAME_MS.
+ */
+BOOL shadow_audio_out_write(rdpShadowAudioOut* audio, const SHADOW_MSG_OUT_AUDIO_OUT_SAMPLES* msg)
+{
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(audio);
+	WINPR_ASSERT(msg);
+
+	const AUDIO_FORMAT* format = msg->audio_format;
+	if (!format || (format->wFormatTag != WAVE_FORMAT_PCM) || (format->nSamplesPerSec == 0) ||
+	    (format->nChannels == 0) || (format->wBitsPerSample < 8))
 	{
-		client->rdpsnd->Stop(client->rdpsnd);
-		rdpsnd_server_context_free(client->rdpsnd);
-		client->rdpsnd = NULL;
+		WLog_WARN(TAG, "Drop samples, the capture must be PCM");
+		return FALSE;
 	}
+
+	EnterCriticalSection(&audio->lock);
+
+	if (!shadow_audio_out_same_format(&audio->format, format) || !audio->ring)
+	{
+		if (!shadow_audio_out_reset(audio, format))
+			goto out;
+	}
+
+	const BYTE* src = msg->buf;
+	size_t nFrames = msg->nFrames;
+
+	if (audio->fill == 0)
+		audio->readTime =
+		    winpr_GetTickCount64NS() - shadow_audio_out_duration(&audio->format, nFrames);
+
+	/* Keep the latency bounded when the audio thread falls behind, the oldest audio goes first */
+	if (nFrames > audio->ringFrames)
+	{
+		const size_t skip = nFrames - audio->ringFrames;
+		src += skip * audio->bytesPerFrame;
+		nFrames -= skip;
+		audio->readTime += shadow_audio_out_duration(&audio->format, skip);
+	}
+
+	if (audio->fill + nFrames > audio->ringFrames)
+	{
+		const size_t drop = audio->fill + nFrames - audio->ringFrames;
+		audio->readPos = (audio->readPos + drop) % audio->ringFrames;
+		audio->fill -= drop;
+		audio->readTime += shadow_audio_out_duration(&audio->format, drop);
+		WLog_DBG(TAG, "audio thread behind, dropped %" PRIuz " frames", drop);
+	}
+
+	while (nFrames > 0)
+	{
+		const size_t pos = (audio->readPos + audio->fill) % audio->ringFrames;
+		const size_t count = MIN(nFrames, audio->ringFrames - pos);
+		CopyMemory(&audio->ring[pos * audio->bytesPerFrame], src, count * audio->bytesPerFrame);
+		src += count * audio->bytesPerFrame;
+		nFrames -= count;
+		audio->fill += count;
+	}
+
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&audio->lock);
+
+	if (rc)
+		(void)SetEvent(audio->dataEvent);
+	return rc;
+}
+
+/* Takes the next complete frame off the ring, returns its length in audio frames or 0 */
+static size_t shadow_audio_out_read_frame(rdpShadowAudioOut* audio, UINT64* timestamp)
+{
+	size_t nFrames = 0;
+
+	EnterCriticalSection(&audio->lock);
+
+	const size_t frames = 1ull * audio->format.nSamplesPerSec * SHADOW_RDPSND_FRAME_MS / 1000;
+	if (!audio->ring || (frames == 0) || (audio->fill < frames))
+		goto out;
+
+	const size_t size = frames * audio->bytesPerFrame;
+	if (audio->frameSize < size)
+	{
+		BYTE* frame = realloc(audio->frame, size);
+		if (!frame)
+			goto out;
+
+		audio->frame = frame;
+		audio->frameSize = size;
+	}
+
+	for (size_t done = 0; done < frames;)
+	{
+		const size_t count = MIN(frames - done, audio->ringFrames - audio->readPos);
+		CopyMemory(&audio->frame[done * audio->bytesPerFrame],
+		           &audio->ring[audio->readPos * audio->bytesPerFrame],
+		           count * audio->bytesPerFrame);
+		audio->readPos = (audio->readPos + count) % audio->ringFrames;
+		done += count;
+	}
+
+	audio->fill -= frames;
+	*timestamp = audio->readTime;
+	audio->readTime += shadow_audio_out_duration(&audio->format, frames);
+	audio->frameFormat = audio->format;
+	nFrames = frames;
+out:
+	LeaveCriticalSection(&audio->lock);
+	return nFrames;
+}
+
+static BOOL shadow_audio_out_shareable(const RdpsndServerContext* rdpsnd,
+                                       const AUDIO_FORMAT* format)
+{
+	if (rdpsnd->clientVersion < SHADOW_RDPSND_WAVE2_VERSION)
+		return FALSE;
+
+	switch (format->wFormatTag)
+	{
+		/* The block sizes do not line up with the frame duration */
+		case WAVE_FORMAT_DVI_ADPCM:
+		case WAVE_FORMAT_ADPCM:
+			return FALSE;
+
+		/* Packets of several frames are assembled per client */
+		case WAVE_FORMAT_OPUS:
+			return rdpsnd->opusFramesPerPacket <= 1;
+
+		default:
+			return TRUE;
+	}
+}
+
+static void shadow_audio_out_shared_free(SHADOW_RDPSND_SHARED* shared)
+{
+	freerdp_dsp_context_free(shared->dsp);
+	Stream_Free(shared->packet, TRUE);
+	free(shared->format.data);
+	ZeroMemory(shared, sizeof(SHADOW_RDPSND_SHARED));
+}
+
+static SHADOW_RDPSND_SHARED* shadow_audio_out_shared_new(rdpShadowAudioOut* audio,
+                                                        const AUDIO_FORMAT* format)
+{
+	if (audio->numShared >= SHADOW_RDPSND_MAX_SHARED)
+		return NULL;
+
+	SHADOW_RDPSND_SHARED* shared = &audio->shared[audio->numShared];
+
+	if (!audio_format_copy(format, &shared->format))
+		goto fail;
+
+	shared->dsp = freerdp_dsp_context_new(TRUE);
+	shared->packet = Stream_New(NULL, 4096);
+	if (!shared->dsp || !shared->packet)
+		goto fail;
+
+	if (format->wFormatTag == WAVE_FORMAT_OPUS)
+	{
+		if (!freerdp_dsp_context_set_opus_framing(shared->dsp, SHADOW_RDPSND_FRAME_MS, TRUE,
+		                                          SHADOW_RDPSND_FEC_PACKET_LOSS))
+			goto fail;
+	}
+
+	if (!freerdp_dsp_context_reset(shared->dsp, format, 0))
+		goto fail;
+
+	audio->numShared++;
+	return shared;
+
+fail:
+	shadow_audio_out_shared_free(shared);
+	return NULL;
+}
+
+/* Encodes the current frame once for all clients of the given format */
+static const SHADOW_RDPSND_SHARED* shadow_audio_out_encode_shared(rdpShadowAudioOut* audio,
+                                                                 const AUDIO_FORMAT* format,
+                                                                 size_t nFrames)
+{
+	SHADOW_RDPSND_SHARED* shared = NULL;
+
+	for (size_t i = 0; i < audio->numShared; i++)
+	{
+		if (shadow_audio_out_same_format(&audio->shared[i].format, format))
+		{
+			shared = &audio->shared[i];
+			break;
+		}
+	}
+
+	if (!shared)
+		shared = shadow_audio_out_shared_new(audio, format);
+
+	if (!shared)
+		return NULL;
+
+	if (shared->frameNo == audio->frameNo)
+		return shared;
+
+	shared->frameNo = audio->frameNo;
+	Stream_SetPosition(shared->packet, 0);
+
+	if (!freerdp_dsp_encode(shared->dsp, &audio->frameFormat, audio->frame,
+	                        nFrames * audio->bytesPerFrame, shared->packet))
+	{
+		WLog_WARN(TAG, "freerdp_dsp_encode failed");
+		Stream_SetPosition(shared->packet, 0);
+		return shared;
+	}
+
+	/* Opus packets derive the frame length from the packet size, padding would corrupt them */
+	const size_t length = Stream_GetPosition(shared->packet);
+	const size_t align = format->nBlockAlign;
+	if ((format->wFormatTag != WAVE_FORMAT_OPUS) && (length > 0) && (align > 1) &&
+	    (length % align != 0))
+	{
+		if (!Stream_EnsureRemainingCapacity(shared->packet, align - length % align))
+			Stream_SetPosition(shared->packet, 0);
+		else
+			Stream_Zero(shared->packet, align - length % align);
+	}
+
+	return shared;
+}
+
+static void shadow_audio_out_send_frame(rdpShadowAudioOut* audio, size_t nFrames,
+                                        UINT64 timestamp)
+{
+	rdpShadowServer* server = audio->server;
+	const UINT32 ms = (UINT32)(timestamp / 1000000ull);
+
+	WINPR_ASSERT(server);
+
+	audio->frameNo++;
+
+	ArrayList_Lock(server->clients);
+
+	for (size_t index = 0; index < ArrayList_Count(server->clients); index++)
+	{
+		rdpShadowClient* client = (rdpShadowClient*)ArrayList_GetItem(server->clients, index);
+		RdpsndServerContext* rdpsnd = client->rdpsnd;
+
+		if (!client->activated || !rdpsnd)
+			continue;
+
+		const UINT16 formatNo = rdpsnd->selected_client_format;
+		if (formatNo >= rdpsnd->num_client_formats)
+			continue;
+
+		const AUDIO_FORMAT* format = &rdpsnd->client_formats[formatNo];
+		const SHADOW_RDPSND_SHARED* shared = NULL;
+
+		if (shadow_audio_out_shareable(rdpsnd, format))
+			shared = shadow_audio_out_encode_shared(audio, format, nFrames);
+
+		if (shared)
+		{
+			/* An empty packet means the encoder keeps the samples for the next frame */
+			const size_t length = Stream_GetPosition(shared->packet);
+			if (length > 0)
+				IFCALL(rdpsnd->SendSamples2, rdpsnd, formatNo, Stream_Buffer(shared->packet),
+				       length, (UINT16)ms, ms);
+		}
+		else
+		{
+			rdpsnd->src_format = &audio->frameFormat;
+			IFCALL(rdpsnd->SendSamples, rdpsnd, audio->frame, nFrames, (UINT16)ms);
+		}
+	}
+
+	ArrayList_Unlock(server->clients);
+}
+
+static DWORD WINAPI shadow_audio_out_thread(LPVOID arg)
+{
+	rdpShadowAudioOut* audio = (rdpShadowAudioOut*)arg;
+	HANDLE events[] = { audio->stopEvent, audio->dataEvent };
+
+	for (;;)
+	{
+		const DWORD status = WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE);
+
+		if (status != WAIT_OBJECT_0 + 1)
+			break;
+
+		UINT64 timestamp = 0;
+		size_t nFrames = 0;
+
+		while ((nFrames = shadow_audio_out_read_frame(audio, &timestamp)) > 0)
+			shadow_audio_out_send_frame(audio, nFrames, timestamp);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+rdpShadowAudioOut* shadow_audio_out_new(rdpShadowServer* server)
+{
+	rdpShadowAudioOut* audio = calloc(1, sizeof(rdpShadowAudioOut));
+
+	if (!audio)
+		return NULL;
+
+	audio->server = server;
+
+	if (!InitializeCriticalSectionAndSpinCount(&audio->lock, 4000))
+	{
+		free(audio);
+		return NULL;
+	}
+
+	audio->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	audio->dataEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	if (!audio->stopEvent || !audio->dataEvent)
+		goto fail;
+
+	audio->thread = CreateThread(NULL, 0, shadow_audio_out_thread, audio, 0, NULL);
+
+	if (!audio->thread)
+		goto fail;
+
+	return audio;
+
+fail:
+	shadow_audio_out_free(audio);
+	return NULL;
+}
+
+void shadow_audio_out_free(rdpShadowAudioOut* audio)
+{
+	if (!audio)
+		return;
+
+	if (audio->thread)
+	{
+		(void)SetEvent(audio->stopEvent);
+		(void)WaitForSingleObject(audio->thread, INFINITE);
+		(void)CloseHandle(audio->thread);
+	}
+
+	if (audio->stopEvent)
+		(void)CloseHandle(audio->stopEvent);
+
+	if (audio->dataEvent)
+		(void)CloseHandle(audio->dataEvent);
+
+	for (size_t i = 0; i < audio->numShared; i++)
+		shadow_audio_out_shared_free(&audio->shared[i]);
+
+	DeleteCriticalSection(&audio->lock);
+	free(audio->ring);
+	free(audio->frame);
+	free(audio);
 }
@@ -32,6 +32,14 @@ extern "C"
 	int shadow_client_rdpsnd_init(rdpShadowClient* client);
 	void shadow_client_rdpsnd_uninit(rdpShadowClient* client);
 
+	BOOL shadow_audio_out_write(rdpShadowAudioOut* audio,
+	                            const SHADOW_MSG_OUT_AUDIO_OUT_SAMPLES* msg);
+
+	void shadow_audio_out_free(rdpShadowAudioOut* audio);
+
+	WINPR_ATTR_MALLOC(shadow_audio_out_free, 1)
+	rdpShadowAudioOut* shadow_audio_out_new(rdpShadowServer* server);
+
 #ifdef __cplusplus
 }
 #endif
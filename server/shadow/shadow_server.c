@@ -28,6 +28,7 @@
 #include <winpr/ssl.h>
 #include <winpr/path.h>
 #include <winpr/cmdline.h>
+#include <winpr/thread.h>
 #include <winpr/winsock.h>
 
 #include <freerdp/log.h>
@@ -44,6 +45,9 @@
 
 #define TAG SERVER_TAG("shadow")
 
+/* ms between two rounds of continuous network auto-detection */
+#define SHADOW_AUTODETECT_INTERVAL 1000
+
 static const char bind_address[] = "bind-address,";
 
 #define fail_at(arg, rc) fail_at_((arg), (rc), __FILE__, __func__, __LINE__)
@@ -300,6 +304,19 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 				return fail_at(arg, COMMAND_LINE_ERROR);
 			server->maxClientsConnected = val;
 		}
+		CommandLineSwitchCase(arg, "huge-pages")
+		{
+			server->hugePages = arg->Value ? TRUE : FALSE;
+		}
+		CommandLineSwitchCase(arg, "numa-node")
+		{
+			errno = 0;
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > UINT8_MAX))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+			server->numaNode = (INT32)val;
+		}
 		CommandLineSwitchCase(arg, "rect")
 		{
 			char* p = NULL;
@@ -530,6 +547,12 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, arg->Value ? TRUE : FALSE))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "gfx-clear")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxClearCodec,
+			                               arg->Value ? TRUE : FALSE))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 		CommandLineSwitchCase(arg, "gfx-avc420")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxH264, arg->Value ? TRUE : FALSE))
@@ -543,6 +566,18 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxAVC444, arg->Value ? TRUE : FALSE))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "tcp-latency")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_TcpLatencyMode,
+			                               arg->Value ? TRUE : FALSE))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
+		CommandLineSwitchCase(arg, "local-shm")
+		{
+			if (!freerdp_settings_set_bool(settings, FreeRDP_LocalShmTransport,
+			                               arg->Value ? TRUE : FALSE))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 		CommandLineSwitchCase(arg, "keytab")
 		{
 			if (!freerdp_settings_set_string(settings, FreeRDP_KerberosKeytab, arg->Value))
@@ -742,6 +777,22 @@ int shadow_server_start(rdpShadowServer* server)
 		return -1;
 	}
 
+	server->sharedEncoder = shadow_shared_encoder_new(server);
+
+	if (!server->sharedEncoder)
+	{
+		WLog_ERR(TAG, "shared_encoder_new failed");
+		return -1;
+	}
+
+	server->audioOut = shadow_audio_out_new(server);
+
+	if (!server->audioOut)
+	{
+		WLog_ERR(TAG, "audio_out_new failed");
+		return -1;
+	}
+
 	/* Bind magic:
 	 *
 	 * empty                 ... bind TCP all
@@ -831,6 +882,12 @@ int shadow_server_stop(rdpShadowServer* server)
 		server->capture = NULL;
 	}
 
+	shadow_audio_out_free(server->audioOut);
+	server->audioOut = NULL;
+
+	shadow_shared_encoder_free(server->sharedEncoder);
+	server->sharedEncoder = NULL;
+
 	return 0;
 }
 
@@ -983,9 +1040,48 @@ static BOOL shadow_server_check_peer_restrictions(freerdp_listener* listener)
 	return TRUE;
 }
 
+static BOOL shadow_server_bind_numa_node(rdpShadowServer* server)
+{
+	ULONG highest = 0;
+	ULONGLONG mask = 0;
+
+	WINPR_ASSERT(server);
+
+	if (server->numaNode < 0)
+		return TRUE;
+
+	if (!GetNumaHighestNodeNumber(&highest) || ((ULONG)server->numaNode > highest) ||
+	    !GetNumaNodeProcessorMask((UCHAR)server->numaNode, &mask) || (mask == 0))
+	{
+		WLog_ERR(TAG, "NUMA node %" PRId32 " is not available", server->numaNode);
+		return FALSE;
+	}
+
+	/* Bind before any thread or surface exists: threads inherit the mask of their creator
+	 * and surface pages are placed on the node of the capture thread writing them first. */
+#if defined(_WIN32)
+	const BOOL rc = SetProcessAffinityMask(GetCurrentProcess(), (DWORD_PTR)mask);
+#else
+	const BOOL rc = SetThreadAffinityMask(_GetCurrentThread(), (DWORD_PTR)mask) != 0;
+#endif
+	if (!rc)
+	{
+		WLog_ERR(TAG, "failed to bind to NUMA node %" PRId32, server->numaNode);
+		return FALSE;
+	}
+
+	WLog_INFO(TAG, "bound to NUMA node %" PRId32 ", processors 0x%016" PRIx64, server->numaNode,
+	          mask);
+	return TRUE;
+}
+
 int shadow_server_init(rdpShadowServer* server)
 {
 	int status = 0;
+
+	if (!shadow_server_bind_numa_node(server))
+		return -1;
+
 	winpr_InitializeSSL(WINPR_SSL_INIT_DEFAULT);
 	WTSRegisterWtsApiFunctionTable(FreeRDP_InitWtsApi());
 
@@ -1073,7 +1169,15 @@ rdpShadowServer* shadow_server_new(void)
 	server->h264FrameRate = 30;
 	server->h264QP = 0;
 	server->authentication = TRUE;
+	server->numaNode = -1;
 	server->settings = freerdp_settings_new(FREERDP_SETTINGS_SERVER_MODE);
+	if (!server->settings ||
+	    !freerdp_settings_set_uint32(server->settings, FreeRDP_NetworkAutoDetectInterval,
+	                                 SHADOW_AUTODETECT_INTERVAL))
+	{
+		shadow_server_free(server);
+		return NULL;
+	}
 	return server;
 }
 
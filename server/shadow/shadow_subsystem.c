@@ -292,3 +292,23 @@ void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
 	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
 }
+
+UINT32 shadow_subsystem_preferred_fps(rdpShadowSubsystem* subsystem)
+{
+	UINT32 fps = 0;
+
+	WINPR_ASSERT(subsystem);
+	WINPR_ASSERT(subsystem->server);
+
+	wArrayList* clients = subsystem->server->clients;
+	ArrayList_Lock(clients);
+	for (size_t index = 0; index < ArrayList_Count(clients); index++)
+	{
+		const rdpShadowClient* client = (rdpShadowClient*)ArrayList_GetItem(clients, index);
+
+		if (client && client->encoder)
+			fps = MAX(fps, shadow_encoder_preferred_fps(client->encoder));
+	}
+	ArrayList_Unlock(clients);
+	return fps;
+}
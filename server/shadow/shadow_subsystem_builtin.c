@@ -16,6 +16,8 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+
 #include <freerdp/config.h>
 
 #include <freerdp/server/shadow.h>
@@ -29,15 +31,29 @@ typedef struct
 extern int ShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
 extern const char* ShadowSubsystemName(void);
 
+#ifdef WITH_SHADOW_PIPEWIRE
+extern int PipeWireShadowSubsystemEntry(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
+extern const char* PipeWireShadowSubsystemName(void);
+#endif
+
 static const RDP_SHADOW_SUBSYSTEM g_Subsystems[] = {
 
-	{ ShadowSubsystemName, ShadowSubsystemEntry }
+	{ ShadowSubsystemName, ShadowSubsystemEntry },
+#ifdef WITH_SHADOW_PIPEWIRE
+	{ PipeWireShadowSubsystemName, PipeWireShadowSubsystemEntry }
+#endif
 };
 
 static const size_t g_SubsystemCount = ARRAYSIZE(g_Subsystems);
 
 static pfnShadowSubsystemEntry shadow_subsystem_load_static_entry(const char* name)
 {
+#ifdef WITH_SHADOW_PIPEWIRE
+	/* a Wayland compositor does not let X11 clients read the screen, use the portal instead */
+	if (!name && getenv("WAYLAND_DISPLAY"))
+		name = PipeWireShadowSubsystemName();
+#endif
+
 	if (!name)
 	{
 		if (g_SubsystemCount > 0)
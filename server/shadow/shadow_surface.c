@@ -18,12 +18,21 @@
 
 #include <freerdp/config.h>
 
+#include <winpr/memory.h>
+
 #include "shadow.h"
 
 #include "shadow_surface.h"
 #define ALIGN_SCREEN_SIZE(size, align) \
 	((((size) % (align)) != 0) ? ((size) + (align) - ((size) % (align))) : (size))
 
+/* framebuffers are mapped directly, so the capture thread writing them first places them */
+static BYTE* shadow_surface_alloc(rdpShadowServer* server, size_t size)
+{
+	const DWORD flags = (server && server->hugePages) ? WINPR_LARGE_ALLOC_HUGE_PAGES : 0;
+	return (BYTE*)winpr_LargeAlloc(size, flags);
+}
+
 rdpShadowSurface* shadow_surface_new(rdpShadowServer* server, UINT16 x, UINT16 y, UINT32 width,
                                      UINT32 height)
 {
@@ -40,7 +49,8 @@ rdpShadowSurface* shadow_surface_new(rdpShadowServer* server, UINT16 x, UINT16 y
 	surface->height = height;
 	surface->scanline = ALIGN_SCREEN_SIZE(surface->width, 32) * 4;
 	surface->format = PIXEL_FORMAT_BGRX32;
-	surface->data = (BYTE*)calloc(ALIGN_SCREEN_SIZE(surface->height, 32), surface->scanline);
+	surface->dataSize = 1ull * ALIGN_SCREEN_SIZE(surface->height, 32) * surface->scanline;
+	surface->data = shadow_surface_alloc(server, surface->dataSize);
 
 	if (!surface->data)
 	{
@@ -50,7 +60,7 @@ rdpShadowSurface* shadow_surface_new(rdpShadowServer* server, UINT16 x, UINT16 y
 
 	if (!InitializeCriticalSectionAndSpinCount(&(surface->lock), 4000))
 	{
-		free(surface->data);
+		winpr_LargeFree(surface->data, surface->dataSize);
 		free(surface);
 		return NULL;
 	}
@@ -64,7 +74,7 @@ void shadow_surface_free(rdpShadowSurface* surface)
 	if (!surface)
 		return;
 
-	free(surface->data);
+	winpr_LargeFree(surface->data, surface->dataSize);
 	DeleteCriticalSection(&(surface->lock));
 	region16_uninit(&(surface->invalidRegion));
 	free(surface);
@@ -82,21 +92,32 @@ BOOL shadow_surface_resize(rdpShadowSurface* surface, UINT16 x, UINT16 y, UINT32
 	if ((width == surface->width) && (height == surface->height))
 	{
 		/* We don't need to reset frame buffer, just update left top */
+		if ((x != surface->x) || (y != surface->y))
+		{
+			surface->captureId++;
+			surface->moveValid = FALSE;
+		}
 		surface->x = x;
 		surface->y = y;
 		return TRUE;
 	}
 
-	buffer = (BYTE*)realloc(surface->data, 1ull * scanline * ALIGN_SCREEN_SIZE(height, 4ull));
+	/* the old content does not match the new geometry and is captured again */
+	const size_t size = 1ull * scanline * ALIGN_SCREEN_SIZE(height, 4ull);
+	buffer = shadow_surface_alloc(surface->server, size);
 
 	if (buffer)
 	{
+		winpr_LargeFree(surface->data, surface->dataSize);
+		surface->dataSize = size;
 		surface->x = x;
 		surface->y = y;
 		surface->width = width;
 		surface->height = height;
 		surface->scanline = scanline;
 		surface->data = buffer;
+		surface->captureId++;
+		surface->moveValid = FALSE;
 		return TRUE;
 	}
 
@@ -536,7 +536,7 @@ extern "C"
 	 *
 	 * @param window the UwacWindow to refresh
 	 * @param copyContentForNextFrame if true the content to display is copied in the next drawing
-	 *buffer
+	 *buffer, limited to the areas damaged since that buffer was last drawn
 	 * @return UWAC_SUCCESS if the operation was successful
 	 */
 	UWAC_API UwacReturnCode UwacWindowSubmitBuffer(UwacWindow* window,
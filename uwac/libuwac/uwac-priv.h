@@ -225,8 +225,10 @@ struct uwac_buffer
 	bool dirty;
 #ifdef UWAC_HAVE_PIXMAN_REGION
 	pixman_region32_t damage;
+	pixman_region32_t stale; /* damaged in other buffers since this one was drawn */
 #else
 	REGION16 damage;
+	REGION16 stale; /* damaged in other buffers since this one was drawn */
 #endif
 	struct wl_buffer* wayland_buffer;
 	void* data;
@@ -65,8 +65,10 @@ static void UwacWindowDestroyBuffers(UwacWindow* w)
 		UwacBuffer* buffer = &w->buffers[i];
 #ifdef UWAC_HAVE_PIXMAN_REGION
 		pixman_region32_fini(&buffer->damage);
+		pixman_region32_fini(&buffer->stale);
 #else
 		region16_uninit(&buffer->damage);
+		region16_uninit(&buffer->stale);
 #endif
 		UwacBufferReleaseData* releaseData =
 		    (UwacBufferReleaseData*)wl_buffer_get_user_data(buffer->wayland_buffer);
@@ -386,10 +388,16 @@ int UwacWindowShmAllocBuffers(UwacWindow* w, uint64_t nbuffers, uint64_t allocSi
 		const size_t bufferIdx = w->nbuffers + idx;
 		UwacBuffer* buffer = &w->buffers[bufferIdx];
 
+		/* a new buffer has no content yet */
 #ifdef UWAC_HAVE_PIXMAN_REGION
 		pixman_region32_init(&buffer->damage);
+		pixman_region32_init_rect(&buffer->stale, 0, 0, width, height);
 #else
+		const RECTANGLE_16 full = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, width),
+			                        WINPR_ASSERTING_INT_CAST(UINT16, height) };
 		region16_init(&buffer->damage);
+		region16_init(&buffer->stale);
+		region16_union_rect(&buffer->stale, &buffer->stale, &full);
 #endif
 		const size_t offset = allocSize * idx;
 		if (offset > INT32_MAX)
@@ -750,6 +758,80 @@ static void damage_surface(UwacWindow* window, UwacBuffer* buffer, int scale)
 }
 #endif
 
+static void UwacBufferCopyRect(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src,
+                               int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+	if (x2 > window->width)
+		x2 = window->width;
+	if (y2 > window->height)
+		y2 = window->height;
+	if ((x1 >= x2) || (y1 >= y2))
+		return;
+
+	const size_t bpp = (size_t)bppFromShmFormat(window->format);
+	const size_t stride = (size_t)window->stride;
+	const size_t width = bpp * (size_t)(x2 - x1);
+	for (int32_t y = y1; y < y2; y++)
+	{
+		const size_t offset = stride * (size_t)y + bpp * (size_t)x1;
+		memcpy(&((char*)dst->data)[offset], &((const char*)src->data)[offset], width);
+	}
+}
+
+#ifdef UWAC_HAVE_PIXMAN_REGION
+static void UwacWindowMarkStale(UwacWindow* window, UwacBuffer* damaged)
+{
+	for (size_t i = 0; i < window->nbuffers; i++)
+	{
+		UwacBuffer* buffer = &window->buffers[i];
+		if (buffer != damaged)
+			pixman_region32_union(&buffer->stale, &buffer->stale, &damaged->damage);
+	}
+}
+
+static void UwacBufferCopyStale(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src)
+{
+	int nrects = 0;
+	const pixman_box32_t* box = pixman_region32_rectangles(&dst->stale, &nrects);
+
+	for (int i = 0; i < nrects; i++, box++)
+		UwacBufferCopyRect(window, dst, src, box->x1, box->y1, box->x2, box->y2);
+
+	pixman_region32_clear(&dst->stale);
+}
+#else
+static void UwacWindowMarkStale(UwacWindow* window, UwacBuffer* damaged)
+{
+	uint32_t nrects = 0;
+	const RECTANGLE_16* boxes = region16_rects(&damaged->damage, &nrects);
+
+	for (size_t i = 0; i < window->nbuffers; i++)
+	{
+		UwacBuffer* buffer = &window->buffers[i];
+		if (buffer != damaged)
+			region16_union_rects(&buffer->stale, &buffer->stale, boxes, nrects);
+	}
+}
+
+static void UwacBufferCopyStale(UwacWindow* window, UwacBuffer* dst, const UwacBuffer* src)
+{
+	uint32_t nrects = 0;
+	const RECTANGLE_16* boxes = region16_rects(&dst->stale, &nrects);
+
+	for (UINT32 i = 0; i < nrects; i++)
+	{
+		const RECTANGLE_16* box = &boxes[i];
+		UwacBufferCopyRect(window, dst, src, box->left, box->top, box->right, box->bottom);
+	}
+
+	region16_clear(&dst->stale);
+}
+#endif
+
 static void UwacSubmitBufferPtr(UwacWindow* window, UwacBuffer* buffer)
 {
 	wl_surface_attach(window->surface, buffer->wayland_buffer, 0, 0);
@@ -858,9 +940,10 @@ UwacReturnCode UwacWindowSubmitBuffer(UwacWindow* window, bool copyContentForNex
 	if ((!nextDrawingBuffer) || (window->drawingBufferIdx < 0))
 		return UWAC_ERROR_NOMEMORY;
 
+	/* the next buffer only lacks what was drawn since it was last used */
+	UwacWindowMarkStale(window, pendingBuffer);
 	if (copyContentForNextFrame)
-		memcpy(nextDrawingBuffer->data, pendingBuffer->data,
-		       1ull * window->stride * window->height);
+		UwacBufferCopyStale(window, nextDrawingBuffer, pendingBuffer);
 
 	UwacSubmitBufferPtr(window, pendingBuffer);
 	return UWAC_SUCCESS;
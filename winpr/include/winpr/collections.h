@@ -667,10 +667,83 @@ extern "C"
 	/* Utility function to setup hash table for strings */
 	WINPR_API BOOL HashTable_SetupForStringData(wHashTable* table, BOOL stringValues);
 
+	/* Memory Tag */
+
+	/** @brief Live, peak and total bytes of a memory tag
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		UINT64 live;        /**< bytes currently allocated */
+		UINT64 peak;        /**< the maximum of \b live */
+		UINT64 allocations; /**< number of allocations so far */
+		UINT64 allocated;   /**< bytes allocated so far, sampled over time this is the rate */
+	} wMemoryTagStatistics;
+
+	typedef BOOL (*MEMORY_TAG_FOREACH_FN)(const char* name, const wMemoryTagStatistics* stats,
+	                                      void* arg);
+
+	/** @brief Get the process wide memory tag of a subsystem, registering it on first use
+	 *
+	 *  Tags are never released, the pointer should be looked up once and kept.
+	 *  All MemoryTag functions accept a \b NULL tag and do not account anything then.
+	 *
+	 *  @param name The name of the tag, less than 32 characters
+	 *
+	 *  @return The tag or \b NULL if the name is invalid or too many tags exist
+	 *  @since version 3.16.0
+	 */
+	WINPR_API wMemoryTag* MemoryTag_Get(const char* name);
+
+	/** @since version 3.16.0 */
+	WINPR_API const char* MemoryTag_Name(const wMemoryTag* tag);
+
+	/** @brief Account \b bytes allocated outside of the MemoryTag allocation functions
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void MemoryTag_Allocated(wMemoryTag* tag, size_t bytes);
+
+	/** @brief Account \b bytes released outside of the MemoryTag allocation functions
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void MemoryTag_Released(wMemoryTag* tag, size_t bytes);
+
+	/** @brief \b malloc accounting the allocation to \b tag
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void* MemoryTag_Malloc(wMemoryTag* tag, size_t size);
+
+	/** @brief \b calloc accounting the allocation to \b tag
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void* MemoryTag_Calloc(wMemoryTag* tag, size_t nmemb, size_t size);
+
+	/** @brief Free memory allocated with \b MemoryTag_Malloc or \b MemoryTag_Calloc
+	 *
+	 *  @param tag The tag the memory was allocated with
+	 *  @param ptr The memory to free
+	 *  @param size The size the memory was allocated with
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void MemoryTag_Free(wMemoryTag* tag, void* ptr, size_t size);
+
+	/** @since version 3.16.0 */
+	WINPR_API BOOL MemoryTag_GetStatistics(const wMemoryTag* tag, wMemoryTagStatistics* stats);
+
+	/** @brief Call \b fn for every registered tag until it returns \b FALSE
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL MemoryTag_Foreach(MEMORY_TAG_FOREACH_FN fn, void* arg);
+
 	/* BufferPool */
 
 	typedef struct s_wBufferPool wBufferPool;
 
+	/** @brief Account the memory of the pool to \b tag instead of the default \b bufferpool tag
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void BufferPool_SetMemoryTag(wBufferPool* pool, wMemoryTag* tag);
+
 	WINPR_API SSIZE_T BufferPool_GetPoolSize(wBufferPool* pool);
 	WINPR_API SSIZE_T BufferPool_GetBufferSize(wBufferPool* pool, const void* buffer);
 
@@ -771,6 +844,27 @@ extern "C"
 	WINPR_ATTR_MALLOC(MessageQueue_Free, 1)
 	WINPR_API wMessageQueue* MessageQueue_New(const wObject* callback);
 
+/** @brief Messages are only ever taken by one thread at a time, see \b MessageQueue_NewEx
+ *  @since version 3.16.0
+ */
+#define WMQ_FLAG_SINGLE_CONSUMER 0x00000001
+
+	/*! \brief Creates a new message queue with options.
+	 *
+	 *  With \b WMQ_FLAG_SINGLE_CONSUMER posting does not take a lock and the event is
+	 *  only signalled when the queue becomes non-empty. 'MessageQueue_Get',
+	 *  'MessageQueue_Peek' and 'MessageQueue_Clear' must then not be called concurrently.
+	 *
+	 * \param callback a pointer to custom initialization / cleanup functions, see
+	 *                 'MessageQueue_New'
+	 * \param flags a combination of WMQ_FLAG_* values
+	 *
+	 * \return A pointer to a newly allocated MessageQueue or NULL.
+	 * \since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(MessageQueue_Free, 1)
+	WINPR_API wMessageQueue* MessageQueue_NewEx(const wObject* callback, DWORD flags);
+
 	/* Message Pipe */
 
 	typedef struct
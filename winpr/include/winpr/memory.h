@@ -79,4 +79,145 @@ extern "C"
 
 #endif
 
+/** @brief The alignment used by \b winpr_Arena_Alloc if none is requested
+ *
+ *  @since version 3.16.0
+ */
+#define WINPR_ARENA_DEFAULT_ALIGNMENT 16
+
+/** @brief \b winpr_LargeAlloc flag asking for huge pages
+ *
+ *  @since version 3.16.0
+ */
+#define WINPR_LARGE_ALLOC_HUGE_PAGES 0x00000001
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/* Arenas */
+
+	/** @brief A bump allocator for short lived scratch memory
+	 *
+	 *  Allocations are carved linearly from a chain of blocks and cannot be freed one by one.
+	 *  All memory is released at once with \b winpr_Arena_Reset or back to the matching
+	 *  \b winpr_Arena_BeginScope with \b winpr_Arena_EndScope. Released blocks are kept for
+	 *  reuse, so an arena settles at the peak size of its workload. Arenas are not thread safe.
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct s_wArena wArena;
+
+	/** @brief Free an arena and all memory allocated from it
+	 *
+	 *  @param arena The arena to free, may be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_Arena_Free(wArena* arena);
+
+	/** @brief Allocate an empty arena
+	 *
+	 *  @param blockSize The size of the blocks allocations are taken from, \b 0 for a default.
+	 *  Larger allocations get a block of their own.
+	 *
+	 *  @return The new arena or \b NULL in case of failure
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(winpr_Arena_Free, 1)
+	WINPR_API wArena* winpr_Arena_New(size_t blockSize);
+
+	/** @brief Allocate uninitialized memory from an arena
+	 *
+	 *  @param arena The arena, must not be \b NULL
+	 *  @param size The number of bytes to allocate
+	 *  @param alignment A power of two or \b 0 for \b WINPR_ARENA_DEFAULT_ALIGNMENT
+	 *
+	 *  @return The memory, valid until the arena is reset, or \b NULL in case of failure
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void* winpr_Arena_Alloc(wArena* arena, size_t size, size_t alignment);
+
+	/** @brief Allocate zeroed memory for an array from an arena
+	 *
+	 *  @param arena The arena, must not be \b NULL
+	 *  @param nmemb The number of elements
+	 *  @param size The size of an element
+	 *
+	 *  @return The memory, valid until the arena is reset, or \b NULL in case of failure
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void* winpr_Arena_Calloc(wArena* arena, size_t nmemb, size_t size);
+
+	/** @brief Release all memory allocated from an arena and close all scopes
+	 *
+	 *  @param arena The arena, may be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_Arena_Reset(wArena* arena);
+
+	/** @brief Open a nested scope
+	 *
+	 *  @param arena The arena, must not be \b NULL
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL winpr_Arena_BeginScope(wArena* arena);
+
+	/** @brief Close the innermost scope and release everything allocated since it was opened
+	 *
+	 *  @param arena The arena, must not be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_Arena_EndScope(wArena* arena);
+
+	/** @brief Get the number of bytes an arena keeps allocated
+	 *
+	 *  @param arena The arena, must not be \b NULL
+	 *
+	 *  @return The size of all blocks of the arena
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API size_t winpr_Arena_Capacity(const wArena* arena);
+
+	/* Large allocations */
+
+	/** @brief Free memory allocated with \b winpr_LargeAlloc
+	 *
+	 *  @param ptr The memory, may be \b NULL
+	 *  @param size The size passed to \b winpr_LargeAlloc
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_LargeFree(void* ptr, size_t size);
+
+	/** @brief Allocate zeroed, page aligned memory for large buffers like framebuffers
+	 *
+	 *  The memory is mapped directly from the system. Pages are only backed on first write,
+	 *  so they are placed on the NUMA node of the thread touching them first.
+	 *
+	 *  @param size The number of bytes to allocate
+	 *  @param flags \b WINPR_LARGE_ALLOC_HUGE_PAGES or \b 0. Huge pages are a hint, the
+	 *  allocation falls back to normal pages if the system has none available.
+	 *
+	 *  @return The memory or \b NULL in case of failure
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(winpr_LargeFree, 1)
+	WINPR_API void* winpr_LargeAlloc(size_t size, DWORD flags);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* WINPR_MEMORY_H */
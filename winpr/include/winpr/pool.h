@@ -275,6 +275,60 @@ extern "C"
 	}
 #endif
 
+	/* Parallel For */
+
+	/** @brief Processes the items \b begin up to (excluding) \b end of a parallel loop
+	 *
+	 *  @param context The context passed to \b winpr_ParallelFor
+	 *  @param begin The first item to process
+	 *  @param end One past the last item to process
+	 *
+	 *  @return \b TRUE to continue, \b FALSE stops the loop and fails it
+	 *  @since version 3.16.0
+	 */
+	typedef BOOL (*WINPR_PARALLEL_FOR_CALLBACK)(void* context, size_t begin, size_t end);
+
+	/** @since version 3.16.0 */
+	typedef struct s_winpr_parallel_for wParallelFor;
+
+	/** @brief Free a parallel loop created with \b winpr_ParallelFor_New
+	 *
+	 *  @param pf The loop to free, may be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_ParallelFor_Free(wParallelFor* pf);
+
+	/** @brief Create a reusable parallel loop running on a thread pool
+	 *
+	 *  The loop keeps a single work object, so running it does not allocate.
+	 *
+	 *  @param pcbe The callback environment selecting the pool, \b NULL for the default pool
+	 *
+	 *  @return A new loop or \b NULL in case of failure
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(winpr_ParallelFor_Free, 1)
+	WINPR_API wParallelFor* winpr_ParallelFor_New(PTP_CALLBACK_ENVIRON pcbe);
+
+	/** @brief Run \b fn over the items 0 up to (excluding) \b count and wait for completion
+	 *
+	 *  The items are split into ranges of \b grain items that are handed out to the pool
+	 *  threads and the calling thread. A loop must not run concurrently with itself, and it
+	 *  must not be run from a callback of its own pool.
+	 *
+	 *  @param pf The loop to run
+	 *  @param count The number of items
+	 *  @param grain The number of items per range, \b 0 for a size based on the pool
+	 *  @param fn The callback processing a range
+	 *  @param context The context passed to \b fn
+	 *
+	 *  @return \b TRUE if all ranges were processed successfully, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL winpr_ParallelFor(wParallelFor* pf, size_t count, size_t grain,
+	                                 WINPR_PARALLEL_FOR_CALLBACK fn, void* context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,6 +37,7 @@ extern "C"
 #endif
 
 	typedef struct s_wStreamPool wStreamPool;
+	typedef struct s_wMemoryTag wMemoryTag;
 
 	typedef struct
 	{
@@ -1321,6 +1322,173 @@ extern "C"
 	WINPR_API BOOL Stream_SafeSeekEx(wStream* s, size_t size, const char* file, size_t line,
 	                                 const char* fkt);
 
+	/** @brief A fixed layout structure at the current position of a stream.
+	 *
+	 *  The length of the structure is checked once when the span is taken, the
+	 *  StreamSpan_Get_* readers then decode the fields without further checks.
+	 *  The caller must not read more than the length it asked for.
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct
+	{
+		const BYTE* pointer;
+		const BYTE* end;
+	} wStreamSpan;
+
+	/** @brief Take the next \b length bytes of a stream as a span and seek past them
+	 *
+	 *  @param _s The stream to read from
+	 *  @param length The number of bytes the span covers
+	 *  @param span The span to initialize
+	 *  @return \b TRUE for success, \b FALSE if the stream is too short
+	 *  @since version 3.16.0
+	 */
+	static INLINE BOOL Stream_GetSpan(wStream* _s, size_t length, wStreamSpan* span)
+	{
+		WINPR_ASSERT(_s);
+		WINPR_ASSERT(span);
+
+		if (Stream_GetRemainingLength(_s) < length)
+			return FALSE;
+
+		span->pointer = _s->pointer;
+		span->end = span->pointer + length;
+		_s->pointer += length;
+		return TRUE;
+	}
+
+/** @brief Check and log the stream length like Stream_CheckAndLogRequiredLength, then take
+ *  a span of \b len bytes
+ *
+ *  @since version 3.16.0
+ */
+#define Stream_CheckAndLogRequiredSpan(tag, s, len, span) \
+	(Stream_CheckAndLogRequiredLength(tag, s, len) && Stream_GetSpan(s, len, span))
+
+/** @brief Check and log the stream length like Stream_CheckAndLogRequiredLengthWLog, then take
+ *  a span of \b len bytes
+ *
+ *  @since version 3.16.0
+ */
+#define Stream_CheckAndLogRequiredSpanWLog(log, s, len, span) \
+	(Stream_CheckAndLogRequiredLengthWLog(log, s, len) && Stream_GetSpan(s, len, span))
+
+	/** @brief The number of bytes of a span not read yet
+	 *  @since version 3.16.0
+	 */
+	static INLINE size_t StreamSpan_GetRemainingLength(const wStreamSpan* span)
+	{
+		WINPR_ASSERT(span);
+		WINPR_ASSERT(span->pointer <= span->end);
+		return WINPR_STREAM_CAST(size_t, span->end - span->pointer);
+	}
+
+	/** @brief The current read position of a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE const BYTE* StreamSpan_Pointer(const wStreamSpan* span)
+	{
+		return span->pointer;
+	}
+
+	/** @brief Skip \b length bytes of a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE void StreamSpan_Seek(wStreamSpan* span, size_t length)
+	{
+		span->pointer += length;
+	}
+
+	/** @brief Copy \b length bytes of a span to \b dst
+	 *  @since version 3.16.0
+	 */
+	static INLINE void StreamSpan_Read(wStreamSpan* span, void* dst, size_t length)
+	{
+		memcpy(dst, span->pointer, length);
+		span->pointer += length;
+	}
+
+	/** @brief Read a UINT8 from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT8 StreamSpan_Get_UINT8(wStreamSpan* span)
+	{
+		const UINT8 v = winpr_Data_Get_UINT8(span->pointer);
+		span->pointer += sizeof(UINT8);
+		return v;
+	}
+
+	/** @brief Read a UINT16 little endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT16 StreamSpan_Get_UINT16(wStreamSpan* span)
+	{
+		const UINT16 v = winpr_Data_Get_UINT16(span->pointer);
+		span->pointer += sizeof(UINT16);
+		return v;
+	}
+
+	/** @brief Read a INT16 little endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE INT16 StreamSpan_Get_INT16(wStreamSpan* span)
+	{
+		const INT16 v = winpr_Data_Get_INT16(span->pointer);
+		span->pointer += sizeof(INT16);
+		return v;
+	}
+
+	/** @brief Read a UINT16 big endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT16 StreamSpan_Get_UINT16_BE(wStreamSpan* span)
+	{
+		const UINT16 v = winpr_Data_Get_UINT16_BE(span->pointer);
+		span->pointer += sizeof(UINT16);
+		return v;
+	}
+
+	/** @brief Read a UINT32 little endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT32 StreamSpan_Get_UINT32(wStreamSpan* span)
+	{
+		const UINT32 v = winpr_Data_Get_UINT32(span->pointer);
+		span->pointer += sizeof(UINT32);
+		return v;
+	}
+
+	/** @brief Read a INT32 little endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE INT32 StreamSpan_Get_INT32(wStreamSpan* span)
+	{
+		const INT32 v = winpr_Data_Get_INT32(span->pointer);
+		span->pointer += sizeof(INT32);
+		return v;
+	}
+
+	/** @brief Read a UINT32 big endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT32 StreamSpan_Get_UINT32_BE(wStreamSpan* span)
+	{
+		const UINT32 v = winpr_Data_Get_UINT32_BE(span->pointer);
+		span->pointer += sizeof(UINT32);
+		return v;
+	}
+
+	/** @brief Read a UINT64 little endian from a span
+	 *  @since version 3.16.0
+	 */
+	static INLINE UINT64 StreamSpan_Get_UINT64(wStreamSpan* span)
+	{
+		const UINT64 v = winpr_Data_Get_UINT64(span->pointer);
+		span->pointer += sizeof(UINT64);
+		return v;
+	}
+
 	WINPR_API BOOL Stream_Read_UTF16_String(wStream* s, WCHAR* dst, size_t charLength);
 	WINPR_API BOOL Stream_Write_UTF16_String(wStream* s, const WCHAR* src, size_t charLength);
 
@@ -1420,6 +1588,15 @@ extern "C"
 
 	WINPR_API char* StreamPool_GetStatistics(wStreamPool* pool, char* buffer, size_t size);
 
+	/** @brief Account the memory of the pool to \b tag instead of the default \b streampool tag
+	 *
+	 *  @param pool The pool to update, must not be \b NULL
+	 *  @param tag The tag to account to, see \b MemoryTag_Get
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void StreamPool_SetMemoryTag(wStreamPool* pool, wMemoryTag* tag);
+
 #ifdef __cplusplus
 }
 #endif
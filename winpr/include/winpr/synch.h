@@ -455,6 +455,91 @@ extern "C"
 
 	WINPR_API void* GetEventWaitObject(HANDLE hEvent);
 
+	/* Wait Sets */
+
+	/** @brief A set of handles registered once and waited on repeatedly
+	 *
+	 *  Unlike \b WaitForMultipleObjects the set is not rebuilt on every wait and only the
+	 *  signaled handles are returned. With epoll the cost of a wait does not depend on the
+	 *  number of registered handles. A handle must be removed before it is closed or its file
+	 *  descriptor is changed.
+	 *
+	 *  @since version 3.16.0
+	 */
+	typedef struct s_wWaitSet wWaitSet;
+
+	/** @brief Free a wait set, the registered handles are not closed
+	 *
+	 *  @param set The wait set to free, may be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_WaitSet_Free(wWaitSet* set);
+
+	/** @brief Allocate an empty wait set
+	 *
+	 *  @return The new wait set or \b NULL in case of failure
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_ATTR_MALLOC(winpr_WaitSet_Free, 1)
+	WINPR_API wWaitSet* winpr_WaitSet_New(void);
+
+	/** @brief Register a handle, adding a registered handle again does nothing
+	 *
+	 *  @param set The wait set, must not be \b NULL
+	 *  @param handle The handle to wait for
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL winpr_WaitSet_Add(wWaitSet* set, HANDLE handle);
+
+	/** @brief Unregister a handle
+	 *
+	 *  @param set The wait set, must not be \b NULL
+	 *  @param handle The handle to remove
+	 *
+	 *  @return \b TRUE if the handle was registered, \b FALSE otherwise
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL winpr_WaitSet_Remove(wWaitSet* set, HANDLE handle);
+
+	/** @brief Unregister all handles
+	 *
+	 *  @param set The wait set, must not be \b NULL
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API void winpr_WaitSet_Clear(wWaitSet* set);
+
+	/** @brief Get the number of registered handles
+	 *
+	 *  @param set The wait set, must not be \b NULL
+	 *
+	 *  @return The number of registered handles
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API size_t winpr_WaitSet_Count(wWaitSet* set);
+
+	/** @brief Wait until at least one registered handle is signaled
+	 *
+	 *  @param set The wait set, must not be \b NULL
+	 *  @param dwMilliseconds The timeout or \b INFINITE
+	 *  @param lpHandles Receives the signaled handles, must not be \b NULL
+	 *  @param nCount The number of entries in \b lpHandles
+	 *  @param pnSignaled Receives the number of signaled handles, must not be \b NULL
+	 *
+	 *  @return \b WAIT_OBJECT_0 if handles are signaled, \b WAIT_TIMEOUT or \b WAIT_FAILED
+	 *
+	 *  @since version 3.16.0
+	 */
+	WINPR_API DWORD winpr_WaitSet_Wait(wWaitSet* set, DWORD dwMilliseconds, HANDLE* lpHandles,
+	                                   DWORD nCount, DWORD* pnSignaled);
+
 #ifdef __cplusplus
 }
 #endif
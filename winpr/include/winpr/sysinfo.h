@@ -377,6 +377,7 @@ extern "C"
 #define PF_EX_ARM_IDIVT 14
 #define PF_EX_AVX_PCLMULQDQ 15
 #define PF_EX_AVX512F 16
+#define PF_EX_AVX512BW 17 /** @since version 3.16.0 */
 
 /*
  * some "aliases" for the standard defines
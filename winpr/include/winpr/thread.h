@@ -264,6 +264,38 @@ extern "C"
 
 	WINPR_API DWORD GetCurrentProcessorNumber(void);
 
+	/**
+	 *  @brief Get the highest NUMA node number of the system
+	 *
+	 *  @param HighestNodeNumber Receives the node number, \b 0 on systems without NUMA
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber);
+
+	/**
+	 *  @brief Get the processors of a NUMA node
+	 *
+	 *  @param Node The node number
+	 *  @param ProcessorMask Receives a bit for each processor of the node, only the first 64
+	 *  processors are reported
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL GetNumaNodeProcessorMask(UCHAR Node, PULONGLONG ProcessorMask);
+
+	/**
+	 *  @brief Restrict a thread to a set of processors
+	 *
+	 *  Threads created afterwards by that thread inherit the mask.
+	 *
+	 *  @param hThread The thread handle to manipulate
+	 *  @param dwThreadAffinityMask A bit for each processor the thread may run on
+	 *  @return The previous mask or \b 0 in case of failure
+	 *  @since version 3.16.0
+	 */
+	WINPR_API DWORD_PTR SetThreadAffinityMask(HANDLE hThread, DWORD_PTR dwThreadAffinityMask);
+
 	/* Thread-Local Storage */
 
 #define TLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
@@ -47,6 +47,14 @@ extern "C"
 #define WLOG_OFF 6
 #define WLOG_LEVEL_INHERIT 0xFFFF
 
+/**
+ * Log statements below this level are compiled out, see the CMake option WITH_WLOG_MIN_LEVEL
+ */
+#if !defined(WINPR_WLOG_MIN_LEVEL)
+#define WINPR_WLOG_MIN_LEVEL WLOG_TRACE
+#endif
+#define WLOG_LEVEL_COMPILED(_log_level) ((_log_level) >= WINPR_WLOG_MIN_LEVEL)
+
 /**
  * Log Message
  */
@@ -106,6 +114,12 @@ extern "C"
 #define WLOG_PACKET_INBOUND 1
 #define WLOG_PACKET_OUTBOUND 2
 
+/** The upper 16 bits of the packet flags identify the session a packet belongs to.
+ *  Captures that support it (WLOG_PCAP_RING) record each session as its own interface.
+ *  @since version 3.16.0
+ */
+#define WLOG_PACKET_SESSION(id) ((((unsigned)(id)) & 0xFFFFu) << 16)
+
 	WINPR_API BOOL WLog_PrintMessage(wLog* log, DWORD type, DWORD level, size_t line,
 	                                 const char* file, const char* function, ...);
 	WINPR_API BOOL WLog_PrintMessageVA(wLog* log, DWORD type, DWORD level, size_t line,
@@ -116,6 +130,15 @@ extern "C"
 	WINPR_API DWORD WLog_GetLogLevel(wLog* log);
 	WINPR_API BOOL WLog_IsLevelActive(wLog* _log, DWORD _log_level);
 
+	/** @brief Get the generation of the log level configuration.
+	 *  The value changes whenever a log level or filter is changed, the result of
+	 *  \b WLog_GetLogLevel can be cached as long as the generation stays the same.
+	 *
+	 *  @return A pointer to the generation, valid for the lifetime of the process
+	 *  @since version 3.16.0
+	 */
+	WINPR_API const LONG volatile* WLog_GetLevelGeneration(void);
+
 	/** @brief Set a custom context for a dynamic logger.
 	 *  This can be used to print a customized prefix, e.g. some session id for a specific context
 	 *
@@ -138,7 +161,8 @@ extern "C"
 #define WLog_Print(_log, _log_level, ...)                        \
 	do                                                           \
 	{                                                            \
-		if (WLog_IsLevelActive(_log, _log_level))                \
+		if (WLOG_LEVEL_COMPILED(_log_level) &&                   \
+		    WLog_IsLevelActive(_log, _log_level))                \
 		{                                                        \
 			WLog_Print_unchecked(_log, _log_level, __VA_ARGS__); \
 		}                                                        \
@@ -163,7 +187,8 @@ extern "C"
 #define WLog_PrintVA(_log, _log_level, _args)                \
 	do                                                       \
 	{                                                        \
-		if (WLog_IsLevelActive(_log, _log_level))            \
+		if (WLOG_LEVEL_COMPILED(_log_level) &&               \
+		    WLog_IsLevelActive(_log, _log_level))            \
 		{                                                    \
 			WLog_PrintVA_unchecked(_log, _log_level, _args); \
 		}                                                    \
@@ -172,7 +197,7 @@ extern "C"
 #define WLog_Data(_log, _log_level, ...)                                                         \
 	do                                                                                           \
 	{                                                                                            \
-		if (WLog_IsLevelActive(_log, _log_level))                                                \
+		if (WLOG_LEVEL_COMPILED(_log_level) && WLog_IsLevelActive(_log, _log_level))             \
 		{                                                                                        \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_DATA, _log_level, __LINE__, __FILE__, __func__, \
 			                  __VA_ARGS__);                                                      \
@@ -182,7 +207,7 @@ extern "C"
 #define WLog_Image(_log, _log_level, ...)                                                        \
 	do                                                                                           \
 	{                                                                                            \
-		if (WLog_IsLevelActive(_log, _log_level))                                                \
+		if (WLOG_LEVEL_COMPILED(_log_level) && WLog_IsLevelActive(_log, _log_level))             \
 		{                                                                                        \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_DATA, _log_level, __LINE__, __FILE__, __func__, \
 			                  __VA_ARGS__);                                                      \
@@ -192,43 +217,75 @@ extern "C"
 #define WLog_Packet(_log, _log_level, ...)                                                         \
 	do                                                                                             \
 	{                                                                                              \
-		if (WLog_IsLevelActive(_log, _log_level))                                                  \
+		if (WLOG_LEVEL_COMPILED(_log_level) && WLog_IsLevelActive(_log, _log_level))               \
 		{                                                                                          \
 			WLog_PrintMessage(_log, WLOG_MESSAGE_PACKET, _log_level, __LINE__, __FILE__, __func__, \
 			                  __VA_ARGS__);                                                        \
 		}                                                                                          \
 	} while (0)
 
-	static inline void WLog_Print_dbg_tag(const char* WINPR_RESTRICT tag, DWORD log_level,
-	                                      size_t line, const char* file, const char* fkt, ...)
+	static inline wLog* WLog_Get_dbg_tag(const char* WINPR_RESTRICT tag)
 	{
 		static wLog* log_cached_ptr = NULL;
 		if (!log_cached_ptr)
 			log_cached_ptr = WLog_Get(tag);
+		return log_cached_ptr;
+	}
+
+	/* The level is cached per translation unit and only queried again after the log level
+	 * configuration changed, a disabled statement costs a compare of the generation. */
+	static inline BOOL WLog_IsLevelActive_dbg_tag(const char* WINPR_RESTRICT tag, DWORD log_level)
+	{
+		static const LONG volatile* generation = NULL;
+		static LONG cached_generation = 0;
+		static DWORD cached_level = WLOG_OFF;
+		static BOOL cached = FALSE;
 
-		if (WLog_IsLevelActive(log_cached_ptr, log_level))
+		if (!WLOG_LEVEL_COMPILED(log_level))
+			return FALSE;
+
+		if (!generation)
+			generation = WLog_GetLevelGeneration();
+
+		const LONG current = *generation;
+		if (!cached || (current != cached_generation))
+		{
+			cached_level = WLog_GetLogLevel(WLog_Get_dbg_tag(tag));
+			cached_generation = current;
+			cached = TRUE;
+		}
+
+		if (cached_level == WLOG_OFF)
+			return FALSE;
+		return log_level >= cached_level;
+	}
+
+	static inline void WLog_Print_dbg_tag(const char* WINPR_RESTRICT tag, DWORD log_level,
+	                                      size_t line, const char* file, const char* fkt, ...)
+	{
+		if (WLog_IsLevelActive_dbg_tag(tag, log_level))
 		{
 			va_list ap;
 			va_start(ap, fkt);
-			WLog_PrintMessageVA(log_cached_ptr, WLOG_MESSAGE_TEXT, log_level, line, file, fkt, ap);
+			WLog_PrintMessageVA(WLog_Get_dbg_tag(tag), WLOG_MESSAGE_TEXT, log_level, line, file,
+			                    fkt, ap);
 			va_end(ap);
 		}
 	}
 
-#define WLog_LVL(tag, lvl, ...) \
-	WLog_Print_dbg_tag(tag, lvl, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_VRB(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_TRACE, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_DBG(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_DEBUG, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_INFO(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_INFO, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_WARN(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_WARN, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_ERR(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_ERROR, __LINE__, __FILE__, __func__, __VA_ARGS__)
-#define WLog_FATAL(tag, ...) \
-	WLog_Print_dbg_tag(tag, WLOG_FATAL, __LINE__, __FILE__, __func__, __VA_ARGS__)
+/* The level check is done before the call, disabled statements do not evaluate their arguments */
+#define WLog_Print_dbg_tag_checked(tag, lvl, ...)                                  \
+	(WLog_IsLevelActive_dbg_tag(tag, lvl)                                          \
+	     ? WLog_Print_dbg_tag(tag, lvl, __LINE__, __FILE__, __func__, __VA_ARGS__) \
+	     : (void)0)
+
+#define WLog_LVL(tag, lvl, ...) WLog_Print_dbg_tag_checked(tag, lvl, __VA_ARGS__)
+#define WLog_VRB(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_TRACE, __VA_ARGS__)
+#define WLog_DBG(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_DEBUG, __VA_ARGS__)
+#define WLog_INFO(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_INFO, __VA_ARGS__)
+#define WLog_WARN(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_WARN, __VA_ARGS__)
+#define WLog_ERR(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_ERROR, __VA_ARGS__)
+#define WLog_FATAL(tag, ...) WLog_Print_dbg_tag_checked(tag, WLOG_FATAL, __VA_ARGS__)
 
 	WINPR_API BOOL WLog_SetLogLevel(wLog* log, DWORD logLevel);
 	WINPR_API BOOL WLog_SetStringLogLevel(wLog* log, LPCSTR level);
@@ -236,6 +293,35 @@ extern "C"
 
 	WINPR_API BOOL WLog_SetLogAppenderType(wLog* log, DWORD logAppenderType);
 	WINPR_API wLogAppender* WLog_GetLogAppender(wLog* log);
+
+	/** @brief Write text messages of the appender used by \b log from a background thread.
+	 *  The message prefix is formatted when the message is logged, the appender is called later
+	 *  by a single writer thread. Data, image and packet messages are still written directly.
+	 *  If more than \b capacity messages are pending new ones are dropped.
+	 *  Like \b WLog_SetLogAppenderType this must not be called while messages are logged, the
+	 *  setting is lost when the appender type changes.
+	 *  Can also be enabled with the environment variable WLOG_ASYNC=<capacity>
+	 *
+	 *  @param log The logger to configure. Must not be \b NULL
+	 *  @param capacity The maximum number of pending messages, \b 0 writes all pending messages
+	 * and switches back to synchronous logging
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise.
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL WLog_SetAsync(wLog* log, size_t capacity);
+
+	/** @brief Get the counters of an asynchronous appender
+	 *
+	 *  @param log The logger to query. Must not be \b NULL
+	 *  @param written Optional, receives the number of messages written by the writer thread
+	 *  @param dropped Optional, receives the number of messages dropped because the queue was full
+	 *
+	 *  @return \b TRUE for success, \b FALSE if the appender of \b log is not asynchronous.
+	 *  @since version 3.16.0
+	 */
+	WINPR_API BOOL WLog_GetAsyncStats(wLog* log, UINT64* written, UINT64* dropped);
+
 	WINPR_API BOOL WLog_OpenAppender(wLog* log);
 	WINPR_API BOOL WLog_CloseAppender(wLog* log);
 	WINPR_API BOOL WLog_ConfigureAppender(wLogAppender* appender, const char* setting, void* value);
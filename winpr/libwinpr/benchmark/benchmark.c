@@ -0,0 +1,914 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * collections, pools and synchronization benchmarking tool
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/stream.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/collections.h>
+#include <winpr/interlocked.h>
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+/* tiles per submitted frame and the stand-in work done for each of them */
+#define BENCH_TILES 64
+#define BENCH_TILE_WORK 256
+#define BENCH_HASH_KEYS 4096
+/* posting waits above this many queued messages, the update consumer keeps up as well */
+#define BENCH_QUEUE_LIMIT 4096
+#define BENCH_EVENTS 16
+
+/* latencies are kept in a log linear histogram with 8 buckets per power of two */
+#define BENCH_SUB_BUCKETS 8
+#define BENCH_BUCKETS (64 * BENCH_SUB_BUCKETS)
+
+typedef struct
+{
+	BOOL csv;
+	DWORD duration;
+	size_t threads;
+	const char* scenarios;
+} winpr_bench_options;
+
+typedef struct
+{
+	UINT64 buckets[BENCH_BUCKETS];
+	UINT64 count;
+	UINT64 max;
+} winpr_bench_histogram;
+
+typedef struct
+{
+	const char* name;
+	const char* description;
+	BOOL multi;
+	void* (*setup)(void);
+	void (*teardown)(void* ctx);
+	void* (*thread_init)(void* ctx);
+	void (*thread_free)(void* tctx);
+	BOOL (*op)(void* ctx, void* tctx, UINT32* seed);
+} winpr_bench_scenario;
+
+typedef struct
+{
+	const winpr_bench_scenario* scenario;
+	void* ctx;
+	HANDLE start;
+	volatile LONG recording;
+	volatile LONG stop;
+} winpr_bench_run;
+
+typedef struct
+{
+	winpr_bench_run* run;
+	HANDLE thread;
+	void* tctx;
+	UINT32 seed;
+	BOOL failed;
+	winpr_bench_histogram hist;
+} winpr_bench_thread;
+
+static UINT32 bench_rand(UINT32* state)
+{
+	/* xorshift32, cheap enough not to show up in the measurements */
+	UINT32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Latency histogram */
+
+static size_t bench_bucket(UINT64 ns)
+{
+	size_t exp = 0;
+
+	while (ns >= 2 * BENCH_SUB_BUCKETS)
+	{
+		ns >>= 1;
+		exp++;
+	}
+
+	if (exp == 0)
+		return (size_t)ns;
+	return exp * BENCH_SUB_BUCKETS + (size_t)ns;
+}
+
+static UINT64 bench_bucket_value(size_t bucket)
+{
+	if (bucket < 2 * BENCH_SUB_BUCKETS)
+		return bucket;
+
+	const size_t exp = bucket / BENCH_SUB_BUCKETS - 1;
+	return (UINT64)(BENCH_SUB_BUCKETS + bucket % BENCH_SUB_BUCKETS) << exp;
+}
+
+static void bench_histogram_add(winpr_bench_histogram* hist, UINT64 ns)
+{
+	hist->buckets[bench_bucket(ns)]++;
+	hist->count++;
+	hist->max = MAX(hist->max, ns);
+}
+
+static void bench_histogram_merge(winpr_bench_histogram* dst, const winpr_bench_histogram* src)
+{
+	for (size_t x = 0; x < BENCH_BUCKETS; x++)
+		dst->buckets[x] += src->buckets[x];
+	dst->count += src->count;
+	dst->max = MAX(dst->max, src->max);
+}
+
+/* lower bound of the bucket holding the given fraction of all samples */
+static UINT64 bench_histogram_percentile(const winpr_bench_histogram* hist, double fraction)
+{
+	const UINT64 target = (UINT64)((double)hist->count * fraction);
+	UINT64 seen = 0;
+
+	for (size_t x = 0; x < BENCH_BUCKETS; x++)
+	{
+		seen += hist->buckets[x];
+		if (seen > target)
+			return MIN(bench_bucket_value(x), hist->max);
+	}
+	return hist->max;
+}
+
+/* ------------------------------------------------------------------------- */
+/* StreamPool and BufferPool */
+
+static void* bench_streampool_setup(void)
+{
+	return StreamPool_New(TRUE, 16384);
+}
+
+static void bench_streampool_teardown(void* ctx)
+{
+	StreamPool_Free(ctx);
+}
+
+/* transport receive buffers, mostly of the default size and now and then a large PDU */
+static BOOL bench_streampool_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	const size_t size = ((bench_rand(seed) & 15) == 0) ? 65536 : 0;
+	wStream* s = StreamPool_Take(ctx, size);
+
+	if (!s)
+		return FALSE;
+
+	Stream_Write_UINT32(s, *seed);
+	Stream_Release(s);
+	return TRUE;
+}
+
+static void* bench_bufferpool_setup(void)
+{
+	return BufferPool_New(TRUE, -1, 16);
+}
+
+static void* bench_bufferpool_fixed_setup(void)
+{
+	return BufferPool_New(TRUE, 64 * 64 * 4, 16);
+}
+
+static void bench_bufferpool_teardown(void* ctx)
+{
+	BufferPool_Free(ctx);
+}
+
+/* codec scratch buffers, one tile plane up to a full band */
+static BOOL bench_bufferpool_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	const SSIZE_T sizes[] = { 4096, 64 * 64 * 4, 65536, 64 * 64 * 4 };
+	BYTE* buffer = BufferPool_Take(ctx, sizes[bench_rand(seed) % ARRAYSIZE(sizes)]);
+
+	if (!buffer)
+		return FALSE;
+
+	buffer[0] = (BYTE)*seed;
+	return BufferPool_Return(ctx, buffer);
+}
+
+/* ------------------------------------------------------------------------- */
+/* MessageQueue, Queue and HashTable */
+
+typedef struct
+{
+	wMessageQueue* queue;
+	HANDLE consumer;
+} bench_message_queue;
+
+static DWORD WINAPI bench_message_consumer(LPVOID arg)
+{
+	wMessage message = { 0 };
+	bench_message_queue* mq = arg;
+
+	while (MessageQueue_Wait(mq->queue))
+	{
+		int status = 0;
+
+		while ((status = MessageQueue_Peek(mq->queue, &message, TRUE)) > 0)
+		{
+			if (message.id == WMQ_QUIT)
+				goto out;
+		}
+
+		if (status < 0)
+			break;
+	}
+
+out:
+	ExitThread(0);
+	return 0;
+}
+
+static void bench_message_queue_teardown(void* ctx)
+{
+	bench_message_queue* mq = ctx;
+
+	if (!mq)
+		return;
+
+	if (mq->consumer)
+	{
+		(void)MessageQueue_PostQuit(mq->queue, 0);
+		(void)WaitForSingleObject(mq->consumer, INFINITE);
+		(void)CloseHandle(mq->consumer);
+	}
+
+	MessageQueue_Free(mq->queue);
+	free(mq);
+}
+
+static void* bench_message_queue_new(DWORD flags)
+{
+	bench_message_queue* mq = calloc(1, sizeof(bench_message_queue));
+
+	if (!mq)
+		return NULL;
+
+	mq->queue = MessageQueue_NewEx(NULL, flags);
+	if (!mq->queue)
+		goto fail;
+
+	mq->consumer = CreateThread(NULL, 0, bench_message_consumer, mq, 0, NULL);
+	if (!mq->consumer)
+		goto fail;
+
+	return mq;
+fail:
+	bench_message_queue_teardown(mq);
+	return NULL;
+}
+
+static void* bench_message_queue_setup(void)
+{
+	return bench_message_queue_new(0);
+}
+
+static void* bench_message_queue_sc_setup(void)
+{
+	return bench_message_queue_new(WMQ_FLAG_SINGLE_CONSUMER);
+}
+
+/* update queue posting, one consumer drains what the producers post */
+static BOOL bench_message_queue_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	bench_message_queue* mq = ctx;
+
+	if (!MessageQueue_Post(mq->queue, NULL, 1, seed, NULL))
+		return FALSE;
+
+	while (MessageQueue_Size(mq->queue) > BENCH_QUEUE_LIMIT)
+		(void)SwitchToThread();
+	return TRUE;
+}
+
+static void* bench_queue_setup(void)
+{
+	return Queue_New(TRUE, -1, -1);
+}
+
+static void bench_queue_teardown(void* ctx)
+{
+	Queue_Free(ctx);
+}
+
+static BOOL bench_queue_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	if (!Queue_Enqueue(ctx, seed))
+		return FALSE;
+
+	/* every thread enqueues before it dequeues, so the queue is never empty here */
+	return Queue_Dequeue(ctx) != NULL;
+}
+
+static void* bench_hashtable_setup(void)
+{
+	wHashTable* table = HashTable_New(TRUE);
+
+	if (!table)
+		return NULL;
+
+	for (size_t x = 1; x <= BENCH_HASH_KEYS; x++)
+	{
+		if (!HashTable_Insert(table, (void*)x, (void*)x))
+		{
+			HashTable_Free(table);
+			return NULL;
+		}
+	}
+
+	return table;
+}
+
+static void bench_hashtable_teardown(void* ctx)
+{
+	HashTable_Free(ctx);
+}
+
+/* cache and channel lookups, one in 16 operations replaces a value */
+static BOOL bench_hashtable_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	const UINT32 r = bench_rand(seed);
+	const size_t key = (r % BENCH_HASH_KEYS) + 1;
+
+	if ((r >> 28) == 0)
+		return HashTable_SetItemValue(ctx, (void*)key, (void*)key);
+
+	return HashTable_GetItemValue(ctx, (void*)key) == (void*)key;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Thread pool tile submission */
+
+typedef struct
+{
+	PTP_POOL pool;
+	TP_CALLBACK_ENVIRON env;
+} bench_pool;
+
+typedef struct
+{
+	UINT32 seed;
+	volatile UINT32 result;
+} bench_tile;
+
+typedef struct
+{
+	bench_pool* pool;
+	wParallelFor* pf;
+	PTP_WORK work[BENCH_TILES];
+	bench_tile tiles[BENCH_TILES];
+} bench_pool_thread;
+
+static void bench_tile_process(bench_tile* tile)
+{
+	UINT32 state = tile->seed | 1;
+
+	for (size_t x = 0; x < BENCH_TILE_WORK; x++)
+		(void)bench_rand(&state);
+	tile->result = state;
+}
+
+static void bench_pool_teardown(void* ctx)
+{
+	bench_pool* pool = ctx;
+
+	if (!pool)
+		return;
+
+	if (pool->pool)
+	{
+		DestroyThreadpoolEnvironment(&pool->env);
+		CloseThreadpool(pool->pool);
+	}
+	free(pool);
+}
+
+static void* bench_pool_setup(void)
+{
+	bench_pool* pool = calloc(1, sizeof(bench_pool));
+
+	if (!pool)
+		return NULL;
+
+	pool->pool = CreateThreadpool(NULL);
+	if (!pool->pool)
+	{
+		free(pool);
+		return NULL;
+	}
+
+	InitializeThreadpoolEnvironment(&pool->env);
+	SetThreadpoolCallbackPool(&pool->env, pool->pool);
+	return pool;
+}
+
+static void bench_pool_thread_free(void* tctx)
+{
+	bench_pool_thread* thread = tctx;
+
+	if (!thread)
+		return;
+
+	winpr_ParallelFor_Free(thread->pf);
+	free(thread);
+}
+
+static void* bench_pool_thread_init(void* ctx)
+{
+	bench_pool_thread* thread = calloc(1, sizeof(bench_pool_thread));
+
+	if (!thread)
+		return NULL;
+
+	thread->pool = ctx;
+	thread->pf = winpr_ParallelFor_New(&thread->pool->env);
+	if (!thread->pf)
+	{
+		bench_pool_thread_free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+static void CALLBACK bench_tile_work(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                     void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	bench_tile_process(context);
+}
+
+/* one work object per tile and frame, as the codecs submit their tiles */
+static BOOL bench_threadpool_op(WINPR_ATTR_UNUSED void* ctx, void* tctx, UINT32* seed)
+{
+	bench_pool_thread* thread = tctx;
+
+	for (size_t x = 0; x < BENCH_TILES; x++)
+	{
+		bench_tile* tile = &thread->tiles[x];
+
+		tile->seed = bench_rand(seed);
+		thread->work[x] = CreateThreadpoolWork(bench_tile_work, tile, &thread->pool->env);
+		if (thread->work[x])
+			SubmitThreadpoolWork(thread->work[x]);
+		else
+			bench_tile_process(tile);
+	}
+
+	for (size_t x = 0; x < BENCH_TILES; x++)
+	{
+		if (!thread->work[x])
+			continue;
+
+		WaitForThreadpoolWorkCallbacks(thread->work[x], FALSE);
+		CloseThreadpoolWork(thread->work[x]);
+	}
+
+	return TRUE;
+}
+
+static BOOL bench_tile_range(void* context, size_t begin, size_t end)
+{
+	bench_tile* tiles = context;
+
+	for (size_t x = begin; x < end; x++)
+		bench_tile_process(&tiles[x]);
+	return TRUE;
+}
+
+static BOOL bench_parallel_for_op(WINPR_ATTR_UNUSED void* ctx, void* tctx, UINT32* seed)
+{
+	bench_pool_thread* thread = tctx;
+
+	for (size_t x = 0; x < BENCH_TILES; x++)
+		thread->tiles[x].seed = bench_rand(seed);
+
+	return winpr_ParallelFor(thread->pf, BENCH_TILES, 1, bench_tile_range, thread->tiles);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Events and waiting */
+
+typedef struct
+{
+	HANDLE ping;
+	HANDLE pong;
+	HANDLE thread;
+	volatile LONG stop;
+} bench_pingpong;
+
+static DWORD WINAPI bench_pingpong_echo(LPVOID arg)
+{
+	bench_pingpong* pp = arg;
+
+	for (;;)
+	{
+		if (WaitForSingleObject(pp->ping, INFINITE) != WAIT_OBJECT_0)
+			break;
+		(void)ResetEvent(pp->ping);
+		if (pp->stop)
+			break;
+		(void)SetEvent(pp->pong);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static void bench_pingpong_teardown(void* ctx)
+{
+	bench_pingpong* pp = ctx;
+
+	if (!pp)
+		return;
+
+	if (pp->thread)
+	{
+		(void)InterlockedExchange(&pp->stop, 1);
+		(void)SetEvent(pp->ping);
+		(void)WaitForSingleObject(pp->thread, INFINITE);
+		(void)CloseHandle(pp->thread);
+	}
+
+	if (pp->ping)
+		(void)CloseHandle(pp->ping);
+	if (pp->pong)
+		(void)CloseHandle(pp->pong);
+	free(pp);
+}
+
+static void* bench_pingpong_setup(void)
+{
+	bench_pingpong* pp = calloc(1, sizeof(bench_pingpong));
+
+	if (!pp)
+		return NULL;
+
+	pp->ping = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pp->pong = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!pp->ping || !pp->pong)
+		goto fail;
+
+	pp->thread = CreateThread(NULL, 0, bench_pingpong_echo, pp, 0, NULL);
+	if (!pp->thread)
+		goto fail;
+
+	return pp;
+fail:
+	bench_pingpong_teardown(pp);
+	return NULL;
+}
+
+/* wake up another thread and wait for its answer */
+static BOOL bench_pingpong_op(void* ctx, WINPR_ATTR_UNUSED void* tctx,
+                              WINPR_ATTR_UNUSED UINT32* seed)
+{
+	bench_pingpong* pp = ctx;
+
+	if (!SetEvent(pp->ping))
+		return FALSE;
+	if (WaitForSingleObject(pp->pong, INFINITE) != WAIT_OBJECT_0)
+		return FALSE;
+	return ResetEvent(pp->pong);
+}
+
+typedef struct
+{
+	HANDLE events[BENCH_EVENTS];
+} bench_wait_multiple;
+
+static void bench_wait_multiple_teardown(void* ctx)
+{
+	bench_wait_multiple* wm = ctx;
+
+	if (!wm)
+		return;
+
+	for (size_t x = 0; x < BENCH_EVENTS; x++)
+	{
+		if (wm->events[x])
+			(void)CloseHandle(wm->events[x]);
+	}
+	free(wm);
+}
+
+static void* bench_wait_multiple_setup(void)
+{
+	bench_wait_multiple* wm = calloc(1, sizeof(bench_wait_multiple));
+
+	if (!wm)
+		return NULL;
+
+	for (size_t x = 0; x < BENCH_EVENTS; x++)
+	{
+		wm->events[x] = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!wm->events[x])
+		{
+			bench_wait_multiple_teardown(wm);
+			return NULL;
+		}
+	}
+
+	return wm;
+}
+
+/* an event loop waiting on its handles with one of them signalled */
+static BOOL bench_wait_multiple_op(void* ctx, WINPR_ATTR_UNUSED void* tctx, UINT32* seed)
+{
+	bench_wait_multiple* wm = ctx;
+	const DWORD index = bench_rand(seed) % BENCH_EVENTS;
+
+	if (!SetEvent(wm->events[index]))
+		return FALSE;
+	if (WaitForMultipleObjects(BENCH_EVENTS, wm->events, FALSE, INFINITE) != WAIT_OBJECT_0 + index)
+		return FALSE;
+	return ResetEvent(wm->events[index]);
+}
+
+static const winpr_bench_scenario scenarios[] = {
+	{ "streampool", "StreamPool take and release of transport sized streams", TRUE,
+	  bench_streampool_setup, bench_streampool_teardown, NULL, NULL, bench_streampool_op },
+	{ "bufferpool", "BufferPool take and return of variable sized buffers", TRUE,
+	  bench_bufferpool_setup, bench_bufferpool_teardown, NULL, NULL, bench_bufferpool_op },
+	{ "bufferpool-fixed", "BufferPool take and return of tile sized buffers", TRUE,
+	  bench_bufferpool_fixed_setup, bench_bufferpool_teardown, NULL, NULL, bench_bufferpool_op },
+	{ "messagequeue", "MessageQueue posting to one consuming thread", TRUE,
+	  bench_message_queue_setup, bench_message_queue_teardown, NULL, NULL,
+	  bench_message_queue_op },
+	{ "messagequeue-sc", "MessageQueue posting with WMQ_FLAG_SINGLE_CONSUMER", TRUE,
+	  bench_message_queue_sc_setup, bench_message_queue_teardown, NULL, NULL,
+	  bench_message_queue_op },
+	{ "queue", "Queue enqueue and dequeue", TRUE, bench_queue_setup, bench_queue_teardown, NULL,
+	  NULL, bench_queue_op },
+	{ "hashtable", "HashTable pointer key lookups with 1/16 updates", TRUE, bench_hashtable_setup,
+	  bench_hashtable_teardown, NULL, NULL, bench_hashtable_op },
+	{ "threadpool", "64 tiles with one CreateThreadpoolWork each, per operation", TRUE,
+	  bench_pool_setup, bench_pool_teardown, bench_pool_thread_init, bench_pool_thread_free,
+	  bench_threadpool_op },
+	{ "parallel-for", "64 tiles through winpr_ParallelFor, per operation", TRUE, bench_pool_setup,
+	  bench_pool_teardown, bench_pool_thread_init, bench_pool_thread_free, bench_parallel_for_op },
+	{ "event-pingpong", "SetEvent round trip to another thread", FALSE, bench_pingpong_setup,
+	  bench_pingpong_teardown, NULL, NULL, bench_pingpong_op },
+	{ "wait-multiple", "WaitForMultipleObjects on 16 events, one signalled", FALSE,
+	  bench_wait_multiple_setup, bench_wait_multiple_teardown, NULL, NULL,
+	  bench_wait_multiple_op },
+};
+
+/* ------------------------------------------------------------------------- */
+/* Measurement and reporting */
+
+static DWORD WINAPI bench_thread(LPVOID arg)
+{
+	winpr_bench_thread* thread = arg;
+	winpr_bench_run* run = thread->run;
+
+	(void)WaitForSingleObject(run->start, INFINITE);
+
+	while (!run->stop)
+	{
+		const UINT64 begin = winpr_GetTickCount64NS();
+		if (!run->scenario->op(run->ctx, thread->tctx, &thread->seed))
+		{
+			thread->failed = TRUE;
+			break;
+		}
+		const UINT64 end = winpr_GetTickCount64NS();
+
+		if (run->recording)
+			bench_histogram_add(&thread->hist, end - begin);
+	}
+
+	ExitThread(0);
+	return 0;
+}
+
+static void bench_report(const winpr_bench_options* options, const char* name, size_t threads,
+                         const winpr_bench_histogram* hist, UINT64 ns)
+{
+	const double seconds = (double)ns / 1000000000.0;
+	const double rate = seconds > 0.0 ? (double)hist->count / seconds : 0.0;
+	const UINT64 p50 = bench_histogram_percentile(hist, 0.5);
+	const UINT64 p90 = bench_histogram_percentile(hist, 0.9);
+	const UINT64 p99 = bench_histogram_percentile(hist, 0.99);
+	const UINT64 p999 = bench_histogram_percentile(hist, 0.999);
+
+	if (options->csv)
+		printf("%s,%" PRIuz ",%" PRIu64 ",%.6f,%.1f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+		       ",%" PRIu64 "\n",
+		       name, threads, hist->count, seconds, rate, p50, p90, p99, p999, hist->max);
+	else
+		printf("%-16s %3" PRIuz " threads %12.0f ops/s  p50 %8" PRIu64 "  p90 %8" PRIu64
+		       "  p99 %8" PRIu64 "  p99.9 %9" PRIu64 "  max %10" PRIu64 " ns\n",
+		       name, threads, rate, p50, p90, p99, p999, hist->max);
+}
+
+static int bench_run(const winpr_bench_options* options, const winpr_bench_scenario* scenario,
+                     size_t threads)
+{
+	int rc = -1;
+	UINT64 elapsed = 0;
+	winpr_bench_histogram total = { 0 };
+	winpr_bench_run run = { scenario, NULL, NULL, 0, 0 };
+	winpr_bench_thread* workers = calloc(threads, sizeof(winpr_bench_thread));
+
+	if (!workers)
+		return -1;
+
+	run.start = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!run.start)
+		goto fail;
+
+	run.ctx = scenario->setup();
+	if (!run.ctx)
+	{
+		(void)fprintf(stderr, "%s: setup failed\n", scenario->name);
+		goto fail;
+	}
+
+	for (size_t x = 0; x < threads; x++)
+	{
+		winpr_bench_thread* thread = &workers[x];
+
+		thread->run = &run;
+		thread->seed = 0x9E3779B9u * (UINT32)(x + 1);
+		if (scenario->thread_init)
+		{
+			thread->tctx = scenario->thread_init(run.ctx);
+			if (!thread->tctx)
+				goto fail;
+		}
+
+		thread->thread = CreateThread(NULL, 0, bench_thread, thread, 0, NULL);
+		if (!thread->thread)
+			goto fail;
+	}
+
+	/* the first tenth of the duration warms up caches, pools and threads unrecorded */
+	(void)SetEvent(run.start);
+	Sleep(MAX(options->duration / 10, 1));
+	const UINT64 begin = winpr_GetTickCount64NS();
+	(void)InterlockedExchange(&run.recording, 1);
+	Sleep(options->duration);
+	(void)InterlockedExchange(&run.recording, 0);
+	elapsed = winpr_GetTickCount64NS() - begin;
+	rc = 0;
+
+fail:
+	(void)InterlockedExchange(&run.stop, 1);
+	if (run.start)
+		(void)SetEvent(run.start);
+
+	for (size_t x = 0; x < threads; x++)
+	{
+		winpr_bench_thread* thread = &workers[x];
+
+		if (thread->thread)
+		{
+			(void)WaitForSingleObject(thread->thread, INFINITE);
+			(void)CloseHandle(thread->thread);
+		}
+
+		if (thread->failed)
+		{
+			(void)fprintf(stderr, "%s: operation failed\n", scenario->name);
+			rc = -1;
+		}
+
+		bench_histogram_merge(&total, &thread->hist);
+		if (thread->tctx)
+			scenario->thread_free(thread->tctx);
+	}
+
+	if (rc == 0)
+		bench_report(options, scenario->name, threads, &total, elapsed);
+
+	if (run.ctx)
+		scenario->teardown(run.ctx);
+	if (run.start)
+		(void)CloseHandle(run.start);
+	free(workers);
+	return rc;
+}
+
+static BOOL bench_selected(const char* list, const char* name)
+{
+	if (!list)
+		return TRUE;
+
+	const size_t len = strlen(name);
+	for (const char* cur = list; cur && *cur; cur = strchr(cur, ','))
+	{
+		if (*cur == ',')
+			cur++;
+		if ((strncmp(cur, name, len) == 0) && ((cur[len] == ',') || (cur[len] == '\0')))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void bench_usage(const char* name)
+{
+	printf("Usage: %s [options]\n\n", name);
+	printf("Measures throughput and latency of WinPR collections, pools and synchronization\n");
+	printf("with one thread and, where it applies, with several threads contending.\n");
+	printf("Latencies include the cost of reading the clock.\n\n");
+	printf("  --csv                   machine readable output\n");
+	printf("  --duration=<ms>         measured time per run, default 1000\n");
+	printf("  --threads=<count>       threads of the contended runs, default processors\n");
+	printf("  --scenarios=<list>      comma separated list of scenarios to run\n\n");
+	printf("Scenarios:\n");
+	for (size_t x = 0; x < ARRAYSIZE(scenarios); x++)
+		printf("  %-22s  %s\n", scenarios[x].name, scenarios[x].description);
+}
+
+int main(int argc, char* argv[])
+{
+	SYSTEM_INFO info = { 0 };
+	winpr_bench_options options = { FALSE, 1000, 0, NULL };
+
+	GetSystemInfo(&info);
+	options.threads = MIN(MAX(info.dwNumberOfProcessors, 2), 64);
+
+	for (int x = 1; x < argc; x++)
+	{
+		const char* arg = argv[x];
+
+		if (strcmp(arg, "--csv") == 0)
+			options.csv = TRUE;
+		else if (strncmp(arg, "--duration=", 11) == 0)
+		{
+			errno = 0;
+			const unsigned long val = strtoul(&arg[11], NULL, 0);
+			if ((errno != 0) || (val == 0) || (val > UINT32_MAX))
+				goto usage;
+			options.duration = (DWORD)val;
+		}
+		else if (strncmp(arg, "--threads=", 10) == 0)
+		{
+			errno = 0;
+			const unsigned long val = strtoul(&arg[10], NULL, 0);
+			if ((errno != 0) || (val == 0) || (val > 1024))
+				goto usage;
+			options.threads = val;
+		}
+		else if (strncmp(arg, "--scenarios=", 12) == 0)
+			options.scenarios = &arg[12];
+		else
+			goto usage;
+	}
+
+	if (options.csv)
+		printf("scenario,threads,ops,seconds,ops_per_s,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+
+	for (size_t x = 0; x < ARRAYSIZE(scenarios); x++)
+	{
+		const winpr_bench_scenario* scenario = &scenarios[x];
+
+		if (!bench_selected(options.scenarios, scenario->name))
+			continue;
+
+		if (bench_run(&options, scenario, 1) < 0)
+			return -1;
+
+		if (scenario->multi && (options.threads > 1))
+		{
+			if (bench_run(&options, scenario, options.threads) < 0)
+				return -1;
+		}
+	}
+
+	return 0;
+
+usage:
+	bench_usage(argv[0]);
+	return -1;
+}
@@ -139,6 +139,64 @@ static wClipboardSynthesizer* ClipboardFindSynthesizer(wClipboardFormat* format,
 	return NULL;
 }
 
+/**
+ * Synthesizing large images or text is expensive and applications tend to request the same
+ * format again for every paste. The results of the built-in synthesizers are kept until the
+ * clipboard data changes. The file list synthesizers register local files as a side effect and
+ * are never cached.
+ */
+
+#define CLIPBOARD_CACHE_MAX_BYTES (64ull * 1024ull * 1024ull)
+
+static void ClipboardClearCache(wClipboard* clipboard)
+{
+	WINPR_ASSERT(clipboard);
+
+	for (size_t x = 0; x < clipboard->cacheCount; x++)
+		free(clipboard->cache[x].data);
+	clipboard->cacheCount = 0;
+	clipboard->cacheBytes = 0;
+}
+
+static const wClipboardCachedData* ClipboardFindCachedData(wClipboard* clipboard, UINT32 formatId)
+{
+	WINPR_ASSERT(clipboard);
+
+	for (size_t x = 0; x < clipboard->cacheCount; x++)
+	{
+		const wClipboardCachedData* cached = &clipboard->cache[x];
+		if (cached->formatId == formatId)
+			return cached;
+	}
+	return NULL;
+}
+
+static void ClipboardCacheData(wClipboard* clipboard, UINT32 formatId, const void* data,
+                               UINT32 size)
+{
+	WINPR_ASSERT(clipboard);
+
+	if (size > CLIPBOARD_CACHE_MAX_BYTES - clipboard->cacheBytes)
+		return;
+
+	wClipboardCachedData* cache = realloc(clipboard->cache, (clipboard->cacheCount + 1) *
+	                                                            sizeof(wClipboardCachedData));
+	if (!cache)
+		return;
+	clipboard->cache = cache;
+
+	void* copy = malloc(size);
+	if (!copy)
+		return;
+	CopyMemory(copy, data, size);
+
+	wClipboardCachedData* cached = &clipboard->cache[clipboard->cacheCount++];
+	cached->formatId = formatId;
+	cached->size = size;
+	cached->data = copy;
+	clipboard->cacheBytes += size;
+}
+
 void ClipboardLock(wClipboard* clipboard)
 {
 	if (!clipboard)
@@ -166,7 +224,9 @@ BOOL ClipboardEmpty(wClipboard* clipboard)
 		clipboard->data = NULL;
 	}
 
+	ClipboardClearCache(clipboard);
 	clipboard->size = 0;
+	clipboard->dataSize = 0;
 	clipboard->formatId = 0;
 	clipboard->sequenceNumber++;
 	return TRUE;
@@ -292,6 +352,7 @@ BOOL ClipboardRegisterSynthesizer(wClipboard* clipboard, UINT32 formatId, UINT32
 
 	synthesizer->syntheticId = syntheticId;
 	synthesizer->pfnSynthesize = pfnSynthesize;
+	synthesizer->cacheable = FALSE;
 	return TRUE;
 }
 
@@ -390,6 +451,14 @@ static BOOL ClipboardInitFormats(wClipboard* clipboard)
 	if (!ClipboardInitSynthesizers(clipboard))
 		goto error;
 
+	/* only the built-in conversions, synthesizers registered later might have side effects */
+	for (UINT32 index = 0; index < clipboard->numFormats; index++)
+	{
+		format = &clipboard->formats[index];
+		for (UINT32 x = 0; x < format->numSynthesizers; x++)
+			format->synthesizers[x].cacheable = TRUE;
+	}
+
 	return TRUE;
 error:
 
@@ -477,10 +546,29 @@ void* ClipboardGetData(wClipboard* clipboard, UINT32 formatId, UINT32* pSize)
 			return NULL;
 		}
 
-		DstSize = SrcSize;
-		pDstData = synthesizer->pfnSynthesize(clipboard, format->formatId, pSrcData, &DstSize);
-		if (pDstData)
-			*pSize = DstSize;
+		const wClipboardCachedData* cached =
+		    synthesizer->cacheable ? ClipboardFindCachedData(clipboard, formatId) : NULL;
+		if (cached)
+		{
+			pDstData = malloc(cached->size);
+			if (!pDstData)
+				return NULL;
+
+			CopyMemory(pDstData, cached->data, cached->size);
+			*pSize = cached->size;
+		}
+		else
+		{
+			DstSize = SrcSize;
+			pDstData =
+			    synthesizer->pfnSynthesize(clipboard, format->formatId, pSrcData, &DstSize);
+			if (pDstData)
+			{
+				*pSize = DstSize;
+				if (synthesizer->cacheable)
+					ClipboardCacheData(clipboard, formatId, pDstData, DstSize);
+			}
+		}
 	}
 
 	WLog_DBG(TAG, "getting formatId=%s [0x%08" PRIx32 "] data=%p, size=%" PRIu32,
@@ -502,6 +590,15 @@ BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data,
 	if (!format)
 		return FALSE;
 
+	/* setting the same data again, e.g. for every paste, keeps the synthesized formats */
+	if (clipboard->data && (formatId == clipboard->formatId) && (size == clipboard->dataSize) &&
+	    ((size == 0) || (memcmp(clipboard->data, data, size) == 0)))
+	{
+		clipboard->sequenceNumber++;
+		return TRUE;
+	}
+
+	ClipboardClearCache(clipboard);
 	free(clipboard->data);
 
 	clipboard->data = calloc(size + sizeof(WCHAR), sizeof(char));
@@ -510,6 +607,7 @@ BOOL ClipboardSetData(wClipboard* clipboard, UINT32 formatId, const void* data,
 		return FALSE;
 
 	memcpy(clipboard->data, data, size);
+	clipboard->dataSize = size;
 
 	/* For string values we don´t know if they are '\0' terminated.
 	 * so set the size to the full length in bytes (e.g. string length + 1)
@@ -618,6 +716,8 @@ void ClipboardDestroy(wClipboard* clipboard)
 
 	ClipboardUninitFormats(clipboard);
 
+	ClipboardClearCache(clipboard);
+	free(clipboard->cache);
 	free(clipboard->data);
 	clipboard->data = NULL;
 	clipboard->size = 0;
@@ -29,8 +29,16 @@ typedef struct
 {
 	UINT32 syntheticId;
 	CLIPBOARD_SYNTHESIZE_FN pfnSynthesize;
+	BOOL cacheable;
 } wClipboardSynthesizer;
 
+typedef struct
+{
+	UINT32 formatId;
+	UINT32 size;
+	void* data;
+} wClipboardCachedData;
+
 typedef struct
 {
 	UINT32 formatId;
@@ -54,10 +62,17 @@ struct s_wClipboard
 	/* clipboard data */
 
 	UINT32 size;
+	UINT32 dataSize;
 	void* data;
 	UINT32 formatId;
 	UINT32 sequenceNumber;
 
+	/* synthesized formats of the clipboard data, dropped when the data changes */
+
+	wClipboardCachedData* cache;
+	size_t cacheCount;
+	size_t cacheBytes;
+
 	/* clipboard file handling */
 
 	wArrayList* localFiles;
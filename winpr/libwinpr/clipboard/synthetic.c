@@ -487,15 +487,22 @@ static void* clipboard_synthesize_image_bmp_to_format(wClipboard* clipboard, UIN
 	size_t dsize = 0;
 	void* result = NULL;
 
-	wImage* img = winpr_image_new();
-	void* bmp = clipboard_synthesize_image_bmp(clipboard, formatId, data, pSize);
 	const UINT32 SrcSize = *pSize;
 	*pSize = 0;
 
-	if (!bmp || !img)
+	if (formatId != CF_DIB)
+	{
+		WLog_WARN(TAG, "[BMP] Unsupported destination format %s",
+		          ClipboardGetFormatName(clipboard, formatId));
+		return NULL;
+	}
+
+	/* decode the DIB in place instead of copying it behind a file header first */
+	wImage* img = winpr_image_new();
+	if (!img)
 		goto fail;
 
-	if (winpr_image_read_buffer(img, bmp, SrcSize) <= 0)
+	if (winpr_image_read_dib_buffer(img, data, SrcSize) <= 0)
 		goto fail;
 
 	result = winpr_image_write_buffer(img, bmpFormat, &dsize);
@@ -511,7 +518,6 @@ static void* clipboard_synthesize_image_bmp_to_format(wClipboard* clipboard, UIN
 	}
 
 fail:
-	free(bmp);
 	winpr_image_free(img, TRUE);
 	return result;
 }
@@ -4,6 +4,40 @@
 #include <winpr/image.h>
 #include <winpr/clipboard.h>
 
+static BOOL test_synthesized_text(wClipboard* clipboard, const char* text)
+{
+	BOOL rc = FALSE;
+	size_t len = 0;
+	WCHAR* wtext = ConvertUtf8ToWCharAlloc(text, &len);
+	if (!wtext)
+		return FALSE;
+
+	if (!ClipboardSetData(clipboard, CF_UNICODETEXT, wtext,
+	                      (UINT32)((len + 1) * sizeof(WCHAR))))
+		goto fail;
+
+	/* the second request is answered from the cache and must not differ */
+	for (size_t x = 0; x < 2; x++)
+	{
+		UINT32 DstSize = 0;
+		char* pDstData = ClipboardGetData(clipboard, CF_TEXT, &DstSize);
+		const BOOL equal = pDstData && (DstSize == strlen(text)) &&
+		                   (strncmp(pDstData, text, DstSize) == 0);
+		free(pDstData);
+		if (!equal)
+		{
+			(void)fprintf(stderr, "synthesized CF_TEXT %" PRIuz " does not match '%s'\n", x,
+			              text);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(wtext);
+	return rc;
+}
+
 int TestClipboardFormats(int argc, char* argv[])
 {
 	int rc = -1;
@@ -75,7 +109,14 @@ int TestClipboardFormats(int argc, char* argv[])
 		free(pSrcData);
 	}
 
+	/* new data drops the cached conversions, setting the same data again keeps them */
 	pFormatIds = NULL;
+	if (!test_synthesized_text(clipboard, "first text") ||
+	    !test_synthesized_text(clipboard, "second text") ||
+	    !test_synthesized_text(clipboard, "second text") ||
+	    !test_synthesized_text(clipboard, "first text"))
+		goto fail;
+
 	count = ClipboardGetFormatIds(clipboard, &pFormatIds);
 
 	for (UINT32 index = 0; index < count; index++)
@@ -164,7 +205,15 @@ int TestClipboardFormats(int argc, char* argv[])
 			(void)fprintf(stderr, "ClipboardGetData: [image/png] %p\n", pDstData);
 			if (!pDstData)
 				goto fail;
+
+			UINT32 CachedSize = 0;
+			void* pCachedData = ClipboardGetData(clipboard, id, &CachedSize);
+			const BOOL equal = pCachedData && (CachedSize == DstSize) &&
+			                   (memcmp(pCachedData, pDstData, DstSize) == 0);
+			free(pCachedData);
 			free(pDstData);
+			if (!equal)
+				goto fail;
 		}
 		{
 			const char* name = TEST_CLIP_PNG;
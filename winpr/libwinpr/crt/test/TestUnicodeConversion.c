@@ -335,6 +335,74 @@ static BOOL test_conversion(const testcase_t* testcases, size_t count)
 	return TRUE;
 }
 
+/* a single non ASCII character (2, 3 or 4 UTF-8 bytes) at every position of an ASCII string */
+static BOOL test_ascii_prefix(void)
+{
+	static const char* special[] = { "\xC3\xA9", "\xE2\x9C\x8A", "\xF0\x9F\x8E\x85" };
+	static const WCHAR special16[][2] = { { 0x00E9, 0 }, { 0x270A, 0 }, { 0xD83C, 0xDF85 } };
+	char utf8[128] = { 0 };
+	WCHAR utf16[128] = { 0 };
+
+	for (size_t s = 0; s < ARRAYSIZE(special); s++)
+	{
+		const size_t slen = strlen(special[s]);
+		const size_t s16len = special16[s][1] ? 2 : 1;
+
+		for (size_t pos = 0; pos <= 80; pos++)
+		{
+			const size_t tail = 7;
+			size_t len = 0;
+			size_t wlen = 0;
+
+			for (size_t x = 0; x < pos; x++)
+			{
+				utf8[len++] = (char)('a' + x % 26);
+				utf16[wlen++] = (WCHAR)('a' + x % 26);
+			}
+			memcpy(&utf8[len], special[s], slen);
+			len += slen;
+			memcpy(&utf16[wlen], special16[s], s16len * sizeof(WCHAR));
+			wlen += s16len;
+			for (size_t x = 0; x < tail; x++)
+			{
+				utf8[len++] = (char)('A' + x);
+				utf16[wlen++] = (WCHAR)('A' + x);
+			}
+
+			size_t size = 0;
+			WCHAR* wstr = ConvertUtf8NToWCharAlloc(utf8, len, &size);
+			const BOOL wok = wstr && (size == wlen) &&
+			                 (memcmp(wstr, utf16, wlen * sizeof(WCHAR)) == 0) && (wstr[wlen] == 0);
+			free(wstr);
+
+			char* str = ConvertWCharNToUtf8Alloc(utf16, wlen, &size);
+			const BOOL ok =
+			    str && (size == len) && (memcmp(str, utf8, len) == 0) && (str[len] == 0);
+			free(str);
+
+			/* an output buffer one code unit short must fail, wherever the prefix ends */
+			WCHAR wbuffer[128] = { 0 };
+			char buffer[128] = { 0 };
+			const BOOL exact = (ConvertUtf8NToWChar(utf8, len, wbuffer, wlen) == (SSIZE_T)wlen) &&
+			                   (ConvertWCharNToUtf8(utf16, wlen, buffer, len) == (SSIZE_T)len);
+			BOOL shortBuffer = (ConvertUtf8NToWChar(utf8, len, wbuffer, wlen - 1) < 0) &&
+			                   (ConvertWCharNToUtf8(utf16, wlen, buffer, len - 1) < 0);
+			if (pos > 0)
+				shortBuffer = shortBuffer && (ConvertUtf8NToWChar(utf8, len, wbuffer, pos) < 0) &&
+				              (ConvertWCharNToUtf8(utf16, wlen, buffer, pos) < 0);
+
+			if (!wok || !ok || !exact || !shortBuffer)
+			{
+				(void)fprintf(stderr,
+				              "ASCII prefix test failed for character %" PRIuz " at %" PRIuz "\n",
+				              s, pos);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
 #if defined(WITH_WINPR_DEPRECATED)
 
 #define compare_win_utf16(what, buffersize, rc, inputlen, test) \
@@ -1165,6 +1233,9 @@ int TestUnicodeConversion(int argc, char* argv[])
 	if (!test_conversion(unit_testcases, ARRAYSIZE(unit_testcases)))
 		return -1;
 
+	if (!test_ascii_prefix())
+		return -1;
+
 #if defined(WITH_WINPR_DEPRECATED)
 	if (!test_win_conversion(unit_testcases, ARRAYSIZE(unit_testcases)))
 		return -1;
@@ -29,6 +29,18 @@
 #include <winpr/error.h>
 #include <winpr/print.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define UNICODE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define UNICODE_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
 #ifndef _WIN32
 
 #include "unicode.h"
@@ -365,6 +377,158 @@ const WCHAR* ByteSwapUnicode(WCHAR* wstr, size_t length)
 	return wstr;
 }
 
+/**
+ * ASCII is the same in UTF-8 and UTF-16 and both encodings can be split at any ASCII code unit.
+ * The leading ASCII part of a string is copied directly, only the rest goes through the
+ * conversion backend.
+ *
+ * The helpers stop at the first non ASCII code unit and return the number of code units
+ * copied. With no output buffer only the length of the ASCII prefix is returned.
+ */
+
+static size_t unicode_ascii_to_wchar(const char* str, size_t len, WCHAR* wstr)
+{
+	const BYTE* src = (const BYTE*)str;
+	size_t x = 0;
+
+#if defined(UNICODE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= len; x += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&src[x]);
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		if (wstr)
+		{
+			_mm_storeu_si128((__m128i*)&wstr[x], _mm_unpacklo_epi8(v, zero));
+			_mm_storeu_si128((__m128i*)&wstr[x + 8], _mm_unpackhi_epi8(v, zero));
+		}
+	}
+#elif defined(UNICODE_NEON)
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint8x16_t v = vld1q_u8(&src[x]);
+		const uint8x8_t any = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+		if ((vget_lane_u64(vreinterpret_u64_u8(any), 0) & 0x8080808080808080ull) != 0)
+			break;
+		if (wstr)
+		{
+			vst1q_u16((uint16_t*)&wstr[x], vmovl_u8(vget_low_u8(v)));
+			vst1q_u16((uint16_t*)&wstr[x + 8], vmovl_u8(vget_high_u8(v)));
+		}
+	}
+#endif
+
+	for (; x < len; x++)
+	{
+		if (src[x] >= 0x80)
+			break;
+		if (wstr)
+			wstr[x] = src[x];
+	}
+	return x;
+}
+
+static size_t unicode_ascii_from_wchar(const WCHAR* wstr, size_t wlen, char* str)
+{
+	size_t x = 0;
+
+#if defined(UNICODE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i high = _mm_set1_epi16((short)0xFF80);
+	for (; x + 16 <= wlen; x += 16)
+	{
+		const __m128i lo = _mm_loadu_si128((const __m128i*)&wstr[x]);
+		const __m128i hi = _mm_loadu_si128((const __m128i*)&wstr[x + 8]);
+		const __m128i any = _mm_and_si128(_mm_or_si128(lo, hi), high);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(any, zero)) != 0xFFFF)
+			break;
+		if (str)
+			_mm_storeu_si128((__m128i*)&str[x], _mm_packus_epi16(lo, hi));
+	}
+#elif defined(UNICODE_NEON)
+	for (; x + 16 <= wlen; x += 16)
+	{
+		const uint16x8_t lo = vld1q_u16((const uint16_t*)&wstr[x]);
+		const uint16x8_t hi = vld1q_u16((const uint16_t*)&wstr[x + 8]);
+		const uint16x8_t both = vorrq_u16(lo, hi);
+		const uint16x4_t any = vorr_u16(vget_low_u16(both), vget_high_u16(both));
+		if ((vget_lane_u64(vreinterpret_u64_u16(any), 0) & 0xFF80FF80FF80FF80ull) != 0)
+			break;
+		if (str)
+			vst1q_u8((uint8_t*)&str[x], vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+	}
+#endif
+
+	for (; x < wlen; x++)
+	{
+		if (wstr[x] >= 0x80)
+			break;
+		if (str)
+			str[x] = (char)wstr[x];
+	}
+	return x;
+}
+
+/* MultiByteToWideChar(CP_UTF8) with the ASCII prefix done by unicode_ascii_to_wchar */
+static int unicode_utf8_to_wchar(const char* str, int len, WCHAR* wstr, int wlen)
+{
+	WINPR_ASSERT(str);
+	WINPR_ASSERT(len >= 0);
+	WINPR_ASSERT(wlen >= 0);
+
+	/* cchWideChar == 0 only measures, keep the error handling of the backend otherwise */
+	const BOOL measure = (wlen == 0);
+	if ((len == 0) || (!measure && !wstr))
+		return MultiByteToWideChar(CP_UTF8, 0, str, len, wstr, wlen);
+
+	const size_t limit = measure ? (size_t)len : MIN((size_t)len, (size_t)wlen);
+	const size_t ascii = unicode_ascii_to_wchar(str, limit, measure ? NULL : wstr);
+	if (ascii == (size_t)len)
+		return len;
+	if (!measure && (ascii == (size_t)wlen))
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return 0;
+	}
+
+	WCHAR* rest = measure ? NULL : &wstr[ascii];
+	const int rc = MultiByteToWideChar(CP_UTF8, 0, &str[ascii], len - (int)ascii, rest,
+	                                   measure ? 0 : wlen - (int)ascii);
+	if (rc <= 0)
+		return rc;
+	return rc + (int)ascii;
+}
+
+/* WideCharToMultiByte(CP_UTF8) with the ASCII prefix done by unicode_ascii_from_wchar */
+static int unicode_wchar_to_utf8(const WCHAR* wstr, int wlen, char* str, int len)
+{
+	WINPR_ASSERT(wstr);
+	WINPR_ASSERT(wlen >= 0);
+	WINPR_ASSERT(len >= 0);
+
+	const BOOL measure = (len == 0);
+	if ((wlen == 0) || (!measure && !str))
+		return WideCharToMultiByte(CP_UTF8, 0, wstr, wlen, str, len, NULL, NULL);
+
+	const size_t limit = measure ? (size_t)wlen : MIN((size_t)wlen, (size_t)len);
+	const size_t ascii = unicode_ascii_from_wchar(wstr, limit, measure ? NULL : str);
+	if (ascii == (size_t)wlen)
+		return wlen;
+	if (!measure && (ascii == (size_t)len))
+	{
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return 0;
+	}
+
+	char* rest = measure ? NULL : &str[ascii];
+	const int rc = WideCharToMultiByte(CP_UTF8, 0, &wstr[ascii], wlen - (int)ascii, rest,
+	                                   measure ? 0 : len - (int)ascii, NULL, NULL);
+	if (rc <= 0)
+		return rc;
+	return rc + (int)ascii;
+}
+
 SSIZE_T ConvertWCharToUtf8(const WCHAR* wstr, char* str, size_t len)
 {
 	if (!wstr)
@@ -398,7 +562,7 @@ SSIZE_T ConvertWCharNToUtf8(const WCHAR* wstr, size_t wlen, char* str, size_t le
 		isNullTerminated = TRUE;
 		iwlen++;
 	}
-	const int rc = WideCharToMultiByte(CP_UTF8, 0, wstr, (int)iwlen, str, (int)len, NULL, NULL);
+	const int rc = unicode_wchar_to_utf8(wstr, (int)iwlen, str, (int)len);
 	if ((rc <= 0) || ((len > 0) && ((size_t)rc > len)))
 		return -1;
 	else if (!isNullTerminated)
@@ -429,7 +593,7 @@ SSIZE_T ConvertMszWCharNToUtf8(const WCHAR* wstr, size_t wlen, char* str, size_t
 	}
 
 	const int iwlen = (int)len;
-	const int rc = WideCharToMultiByte(CP_UTF8, 0, wstr, (int)wlen, str, iwlen, NULL, NULL);
+	const int rc = unicode_wchar_to_utf8(wstr, (int)wlen, str, iwlen);
 	if ((rc <= 0) || ((len > 0) && (rc > iwlen)))
 		return -1;
 
@@ -470,7 +634,7 @@ SSIZE_T ConvertUtf8NToWChar(const char* str, size_t len, WCHAR* wstr, size_t wle
 	}
 
 	const int iwlen = (int)wlen;
-	const int rc = MultiByteToWideChar(CP_UTF8, 0, str, (int)ilen, wstr, iwlen);
+	const int rc = unicode_utf8_to_wchar(str, (int)ilen, wstr, iwlen);
 	if ((rc <= 0) || ((wlen > 0) && (rc > iwlen)))
 		return -1;
 	if (!isNullTerminated)
@@ -501,149 +665,130 @@ SSIZE_T ConvertMszUtf8NToWChar(const char* str, size_t len, WCHAR* wstr, size_t
 	}
 
 	const int iwlen = (int)wlen;
-	const int rc = MultiByteToWideChar(CP_UTF8, 0, str, (int)len, wstr, iwlen);
+	const int rc = unicode_utf8_to_wchar(str, (int)len, wstr, iwlen);
 	if ((rc <= 0) || ((wlen > 0) && (rc > iwlen)))
 		return -1;
 
 	return rc;
 }
 
-char* ConvertWCharToUtf8Alloc(const WCHAR* wstr, size_t* pUtfCharLength)
+/**
+ * A UTF-16 code unit needs at most 3 bytes in UTF-8 and a UTF-8 byte at most one UTF-16 code
+ * unit. The Alloc functions allocate for that worst case and convert in a single pass, the
+ * unused part is given back afterwards. Only strings too long for the worst case are measured
+ * first.
+ */
+
+typedef SSIZE_T (*unicode_to_utf8_fn)(const WCHAR* wstr, size_t wlen, char* str, size_t len);
+typedef SSIZE_T (*unicode_to_wchar_fn)(const char* str, size_t len, WCHAR* wstr, size_t wlen);
+
+static void* unicode_shrink(void* buffer, size_t size, size_t used, size_t elementSize)
 {
-	char* tmp = NULL;
-	const SSIZE_T rc = ConvertWCharToUtf8(wstr, NULL, 0);
-	if (pUtfCharLength)
-		*pUtfCharLength = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(char));
-	if (!tmp)
-		return NULL;
-	const SSIZE_T rc2 = ConvertWCharToUtf8(wstr, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
-	{
-		free(tmp);
-		return NULL;
-	}
-	WINPR_ASSERT(rc == rc2);
-	if (pUtfCharLength)
-		*pUtfCharLength = (size_t)rc2;
-	return tmp;
+	if (size - used <= used + 64)
+		return buffer;
+
+	void* tmp = realloc(buffer, used * elementSize);
+	return tmp ? tmp : buffer;
 }
 
-char* ConvertWCharNToUtf8Alloc(const WCHAR* wstr, size_t wlen, size_t* pUtfCharLength)
+static char* unicode_to_utf8_alloc(const WCHAR* wstr, size_t wlen, size_t* pUtfCharLength,
+                                   unicode_to_utf8_fn convert)
 {
-	char* tmp = NULL;
-	const SSIZE_T rc = ConvertWCharNToUtf8(wstr, wlen, NULL, 0);
+	size_t size = 1;
 
 	if (pUtfCharLength)
 		*pUtfCharLength = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(char));
-	if (!tmp)
-		return NULL;
-	const SSIZE_T rc2 = ConvertWCharNToUtf8(wstr, wlen, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
+
+	if (wlen == 0)
+		return calloc(size, sizeof(char));
+
+	if (wlen < INT32_MAX / 3)
+		size = 3 * wlen + 1;
+	else
 	{
-		free(tmp);
-		return NULL;
+		const SSIZE_T rc = convert(wstr, wlen, NULL, 0);
+		if (rc < 0)
+			return NULL;
+		size = (size_t)rc + 1ull;
 	}
-	WINPR_ASSERT(rc == rc2);
-	if (pUtfCharLength)
-		*pUtfCharLength = (size_t)rc2;
-	return tmp;
-}
 
-char* ConvertMszWCharNToUtf8Alloc(const WCHAR* wstr, size_t wlen, size_t* pUtfCharLength)
-{
-	char* tmp = NULL;
-	const SSIZE_T rc = ConvertMszWCharNToUtf8(wstr, wlen, NULL, 0);
-
-	if (pUtfCharLength)
-		*pUtfCharLength = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(char));
+	char* tmp = calloc(size, sizeof(char));
 	if (!tmp)
 		return NULL;
-	const SSIZE_T rc2 = ConvertMszWCharNToUtf8(wstr, wlen, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
+	const SSIZE_T rc = convert(wstr, wlen, tmp, size);
+	if ((rc < 0) || ((size_t)rc >= size))
 	{
 		free(tmp);
 		return NULL;
 	}
-	WINPR_ASSERT(rc == rc2);
 	if (pUtfCharLength)
-		*pUtfCharLength = (size_t)rc2;
-	return tmp;
+		*pUtfCharLength = (size_t)rc;
+	return unicode_shrink(tmp, size, (size_t)rc + 1ull, sizeof(char));
 }
 
-WCHAR* ConvertUtf8ToWCharAlloc(const char* str, size_t* pSize)
+static WCHAR* unicode_to_wchar_alloc(const char* str, size_t len, size_t* pSize,
+                                     unicode_to_wchar_fn convert)
 {
-	WCHAR* tmp = NULL;
-	const SSIZE_T rc = ConvertUtf8ToWChar(str, NULL, 0);
+	size_t size = 1;
+
 	if (pSize)
 		*pSize = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(WCHAR));
+
+	if (len == 0)
+		return calloc(size, sizeof(WCHAR));
+
+	if (len < INT32_MAX)
+		size = len + 1;
+	else
+	{
+		const SSIZE_T rc = convert(str, len, NULL, 0);
+		if (rc < 0)
+			return NULL;
+		size = (size_t)rc + 1ull;
+	}
+
+	WCHAR* tmp = calloc(size, sizeof(WCHAR));
 	if (!tmp)
 		return NULL;
-	const SSIZE_T rc2 = ConvertUtf8ToWChar(str, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
+	const SSIZE_T rc = convert(str, len, tmp, size);
+	if ((rc < 0) || ((size_t)rc >= size))
 	{
 		free(tmp);
 		return NULL;
 	}
-	WINPR_ASSERT(rc == rc2);
 	if (pSize)
-		*pSize = (size_t)rc2;
-	return tmp;
+		*pSize = (size_t)rc;
+	return unicode_shrink(tmp, size, (size_t)rc + 1ull, sizeof(WCHAR));
+}
+
+char* ConvertWCharToUtf8Alloc(const WCHAR* wstr, size_t* pUtfCharLength)
+{
+	const size_t wlen = wstr ? _wcslen(wstr) + 1 : 0;
+	return unicode_to_utf8_alloc(wstr, wlen, pUtfCharLength, ConvertWCharNToUtf8);
+}
+
+char* ConvertWCharNToUtf8Alloc(const WCHAR* wstr, size_t wlen, size_t* pUtfCharLength)
+{
+	return unicode_to_utf8_alloc(wstr, wlen, pUtfCharLength, ConvertWCharNToUtf8);
+}
+
+char* ConvertMszWCharNToUtf8Alloc(const WCHAR* wstr, size_t wlen, size_t* pUtfCharLength)
+{
+	return unicode_to_utf8_alloc(wstr, wlen, pUtfCharLength, ConvertMszWCharNToUtf8);
+}
+
+WCHAR* ConvertUtf8ToWCharAlloc(const char* str, size_t* pSize)
+{
+	const size_t len = str ? strlen(str) + 1 : 0;
+	return unicode_to_wchar_alloc(str, len, pSize, ConvertUtf8NToWChar);
 }
 
 WCHAR* ConvertUtf8NToWCharAlloc(const char* str, size_t len, size_t* pSize)
 {
-	WCHAR* tmp = NULL;
-	const SSIZE_T rc = ConvertUtf8NToWChar(str, len, NULL, 0);
-	if (pSize)
-		*pSize = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(WCHAR));
-	if (!tmp)
-		return NULL;
-	const SSIZE_T rc2 = ConvertUtf8NToWChar(str, len, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
-	{
-		free(tmp);
-		return NULL;
-	}
-	WINPR_ASSERT(rc == rc2);
-	if (pSize)
-		*pSize = (size_t)rc2;
-	return tmp;
+	return unicode_to_wchar_alloc(str, len, pSize, ConvertUtf8NToWChar);
 }
 
 WCHAR* ConvertMszUtf8NToWCharAlloc(const char* str, size_t len, size_t* pSize)
 {
-	WCHAR* tmp = NULL;
-	const SSIZE_T rc = ConvertMszUtf8NToWChar(str, len, NULL, 0);
-	if (pSize)
-		*pSize = 0;
-	if (rc < 0)
-		return NULL;
-	tmp = calloc((size_t)rc + 1ull, sizeof(WCHAR));
-	if (!tmp)
-		return NULL;
-	const SSIZE_T rc2 = ConvertMszUtf8NToWChar(str, len, tmp, (size_t)rc + 1ull);
-	if (rc2 < 0)
-	{
-		free(tmp);
-		return NULL;
-	}
-	WINPR_ASSERT(rc == rc2);
-	if (pSize)
-		*pSize = (size_t)rc2;
-	return tmp;
+	return unicode_to_wchar_alloc(str, len, pSize, ConvertMszUtf8NToWChar);
 }
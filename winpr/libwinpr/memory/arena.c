@@ -0,0 +1,245 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Memory Functions (Arenas)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/memory.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("memory.arena")
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64ull * 1024ull)
+
+typedef struct
+{
+	BYTE* data;
+	size_t size;
+	size_t used;
+} wArenaBlock;
+
+typedef struct
+{
+	size_t block;
+	size_t used;
+} wArenaMark;
+
+/**
+ * Blocks before current are full, blocks after it are free and only reset once they are
+ * entered. A scope mark is the current block and its fill level, restoring the mark releases
+ * everything allocated after it.
+ */
+struct s_wArena
+{
+	size_t blockSize;
+
+	wArenaBlock* blocks;
+	size_t count;
+	size_t capacity;
+	size_t current;
+
+	wArenaMark* scopes;
+	size_t depth;
+	size_t scopeCapacity;
+};
+
+static void* arena_block_take(wArenaBlock* block, size_t size, size_t alignment)
+{
+	WINPR_ASSERT(block);
+
+	const uintptr_t base = (uintptr_t)block->data;
+	const uintptr_t start = (base + block->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	const size_t offset = (size_t)(start - base);
+
+	if ((offset > block->size) || (size > block->size - offset))
+		return NULL;
+
+	block->used = offset + size;
+	return &block->data[offset];
+}
+
+static wArenaBlock* arena_insert_block(wArena* arena, size_t index, size_t size)
+{
+	WINPR_ASSERT(arena);
+	WINPR_ASSERT(index <= arena->count);
+
+	if (arena->count == arena->capacity)
+	{
+		const size_t capacity = (arena->capacity > 0) ? arena->capacity * 2 : 8;
+		wArenaBlock* blocks = realloc(arena->blocks, capacity * sizeof(wArenaBlock));
+		if (!blocks)
+			return NULL;
+		arena->blocks = blocks;
+		arena->capacity = capacity;
+	}
+
+	BYTE* data = malloc(size);
+	if (!data)
+		return NULL;
+
+	MoveMemory(&arena->blocks[index + 1], &arena->blocks[index],
+	           (arena->count - index) * sizeof(wArenaBlock));
+	arena->count++;
+
+	wArenaBlock* block = &arena->blocks[index];
+	block->data = data;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+void* winpr_Arena_Alloc(wArena* arena, size_t size, size_t alignment)
+{
+	WINPR_ASSERT(arena);
+
+	if (alignment == 0)
+		alignment = WINPR_ARENA_DEFAULT_ALIGNMENT;
+	if ((alignment & (alignment - 1)) != 0)
+	{
+		WLog_ERR(TAG, "invalid alignment %" PRIuz, alignment);
+		return NULL;
+	}
+	if (size == 0)
+		size = 1;
+
+	if (arena->count > 0)
+	{
+		void* ptr = arena_block_take(&arena->blocks[arena->current], size, alignment);
+		if (ptr)
+			return ptr;
+
+		if (arena->current + 1 < arena->count)
+		{
+			wArenaBlock* next = &arena->blocks[arena->current + 1];
+			next->used = 0;
+			ptr = arena_block_take(next, size, alignment);
+			if (ptr)
+			{
+				arena->current++;
+				return ptr;
+			}
+		}
+	}
+
+	/* the free blocks are too small, put a new one in front of them */
+	if (size > SIZE_MAX - alignment)
+		return NULL;
+
+	const size_t index = (arena->count > 0) ? arena->current + 1 : 0;
+	const size_t blockSize = (size + alignment > arena->blockSize) ? size + alignment
+	                                                                : arena->blockSize;
+	wArenaBlock* block = arena_insert_block(arena, index, blockSize);
+	if (!block)
+		return NULL;
+
+	arena->current = index;
+	return arena_block_take(block, size, alignment);
+}
+
+void* winpr_Arena_Calloc(wArena* arena, size_t nmemb, size_t size)
+{
+	WINPR_ASSERT(arena);
+
+	if ((size > 0) && (nmemb > SIZE_MAX / size))
+		return NULL;
+
+	void* ptr = winpr_Arena_Alloc(arena, nmemb * size, 0);
+	if (ptr)
+		ZeroMemory(ptr, nmemb * size);
+	return ptr;
+}
+
+void winpr_Arena_Reset(wArena* arena)
+{
+	if (!arena)
+		return;
+
+	arena->current = 0;
+	arena->depth = 0;
+	if (arena->count > 0)
+		arena->blocks[0].used = 0;
+}
+
+BOOL winpr_Arena_BeginScope(wArena* arena)
+{
+	WINPR_ASSERT(arena);
+
+	if (arena->depth == arena->scopeCapacity)
+	{
+		const size_t capacity = (arena->scopeCapacity > 0) ? arena->scopeCapacity * 2 : 8;
+		wArenaMark* scopes = realloc(arena->scopes, capacity * sizeof(wArenaMark));
+		if (!scopes)
+			return FALSE;
+		arena->scopes = scopes;
+		arena->scopeCapacity = capacity;
+	}
+
+	wArenaMark* mark = &arena->scopes[arena->depth++];
+	mark->block = arena->current;
+	mark->used = (arena->count > 0) ? arena->blocks[arena->current].used : 0;
+	return TRUE;
+}
+
+void winpr_Arena_EndScope(wArena* arena)
+{
+	WINPR_ASSERT(arena);
+
+	if (arena->depth == 0)
+	{
+		WLog_WARN(TAG, "no scope to end");
+		return;
+	}
+
+	const wArenaMark* mark = &arena->scopes[--arena->depth];
+	arena->current = mark->block;
+	if (arena->count > 0)
+		arena->blocks[arena->current].used = mark->used;
+}
+
+size_t winpr_Arena_Capacity(const wArena* arena)
+{
+	size_t capacity = 0;
+
+	WINPR_ASSERT(arena);
+
+	for (size_t x = 0; x < arena->count; x++)
+		capacity += arena->blocks[x].size;
+	return capacity;
+}
+
+void winpr_Arena_Free(wArena* arena)
+{
+	if (!arena)
+		return;
+
+	for (size_t x = 0; x < arena->count; x++)
+		free(arena->blocks[x].data);
+	free(arena->blocks);
+	free(arena->scopes);
+	free(arena);
+}
+
+wArena* winpr_Arena_New(size_t blockSize)
+{
+	wArena* arena = calloc(1, sizeof(wArena));
+	if (!arena)
+		return NULL;
+
+	arena->blockSize = (blockSize > 0) ? blockSize : ARENA_DEFAULT_BLOCK_SIZE;
+	return arena;
+}
@@ -0,0 +1,147 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Memory Functions (Large Allocations)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/memory.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "../log.h"
+#define TAG WINPR_TAG("memory.large")
+
+/* transparent huge pages are 2 MiB on the common platforms */
+#define LARGE_ALLOC_HUGE_PAGE_SIZE (2ull * 1024ull * 1024ull)
+
+static size_t large_alloc_round(size_t size, size_t granularity)
+{
+	if (size > SIZE_MAX - granularity)
+		return 0;
+	return (size + granularity - 1) & ~(granularity - 1);
+}
+
+#if defined(_WIN32)
+
+void* winpr_LargeAlloc(size_t size, DWORD flags)
+{
+	if (size == 0)
+		return NULL;
+
+	if (flags & WINPR_LARGE_ALLOC_HUGE_PAGES)
+	{
+		/* requires SeLockMemoryPrivilege, without it we get normal pages */
+		const SIZE_T granularity = GetLargePageMinimum();
+		if (granularity > 0)
+		{
+			const size_t length = large_alloc_round(size, granularity);
+			void* ptr = (length > 0) ? VirtualAlloc(NULL, length,
+			                                        MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES,
+			                                        PAGE_READWRITE)
+			                         : NULL;
+			if (ptr)
+				return ptr;
+		}
+	}
+
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void winpr_LargeFree(void* ptr, WINPR_ATTR_UNUSED size_t size)
+{
+	if (ptr)
+		(void)VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#else
+
+static size_t large_alloc_page_size(void)
+{
+	const long rc = sysconf(_SC_PAGESIZE);
+	return (rc > 0) ? (size_t)rc : 4096;
+}
+
+#if defined(MADV_HUGEPAGE)
+/* maps length bytes at a huge page boundary so the whole range can use huge pages */
+static void* large_alloc_huge(size_t length)
+{
+	const size_t mapped = large_alloc_round(length, LARGE_ALLOC_HUGE_PAGE_SIZE);
+	if ((mapped == 0) || (mapped > SIZE_MAX - LARGE_ALLOC_HUGE_PAGE_SIZE))
+		return NULL;
+
+	BYTE* base = mmap(NULL, mapped + LARGE_ALLOC_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	/* trim the mapping to the aligned range, winpr_LargeFree unmaps length bytes */
+	BYTE* aligned = (BYTE*)large_alloc_round((size_t)base, LARGE_ALLOC_HUGE_PAGE_SIZE);
+	const size_t head = (size_t)(aligned - base);
+	const size_t tail = mapped + LARGE_ALLOC_HUGE_PAGE_SIZE - head - length;
+	if (head > 0)
+		(void)munmap(base, head);
+	if (tail > 0)
+		(void)munmap(aligned + length, tail);
+
+	if (madvise(aligned, length, MADV_HUGEPAGE) != 0)
+		WLog_DBG(TAG, "transparent huge pages not available");
+	return aligned;
+}
+#endif
+
+void* winpr_LargeAlloc(size_t size, DWORD flags)
+{
+	if (size == 0)
+		return NULL;
+
+	const size_t length = large_alloc_round(size, large_alloc_page_size());
+	if (length == 0)
+		return NULL;
+
+#if defined(MADV_HUGEPAGE)
+	if ((flags & WINPR_LARGE_ALLOC_HUGE_PAGES) && (length >= LARGE_ALLOC_HUGE_PAGE_SIZE))
+	{
+		void* ptr = large_alloc_huge(length);
+		if (ptr)
+			return ptr;
+	}
+#else
+	WINPR_UNUSED(flags);
+#endif
+
+	void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	return ptr;
+}
+
+void winpr_LargeFree(void* ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	const size_t length = large_alloc_round(size, large_alloc_page_size());
+	if (munmap(ptr, length) != 0)
+		WLog_WARN(TAG, "munmap of %" PRIuz " bytes failed", length);
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/memory.h>
+
+#define TEST_BLOCK_SIZE 1024
+
+static BOOL test_alignment(wArena* arena)
+{
+	for (size_t x = 0; x < 200; x++)
+	{
+		const size_t alignment = 1ull << (x % 8);
+		BYTE* ptr = winpr_Arena_Alloc(arena, 1 + (x * 13) % 100, alignment);
+		if (!ptr || (((uintptr_t)ptr % alignment) != 0))
+			return FALSE;
+		ptr[0] = (BYTE)x;
+	}
+
+	/* not a power of two */
+	if (winpr_Arena_Alloc(arena, 8, 3))
+		return FALSE;
+
+	BYTE* zero = winpr_Arena_Calloc(arena, 10, 10);
+	if (!zero || (((uintptr_t)zero % WINPR_ARENA_DEFAULT_ALIGNMENT) != 0))
+		return FALSE;
+	for (size_t x = 0; x < 100; x++)
+	{
+		if (zero[x] != 0)
+			return FALSE;
+	}
+
+	return !winpr_Arena_Calloc(arena, SIZE_MAX / 2, 4);
+}
+
+/* an inner scope gives back its memory, the outer allocations must stay intact */
+static BOOL test_scopes(wArena* arena)
+{
+	BYTE* outer = winpr_Arena_Alloc(arena, 100, 0);
+	if (!outer)
+		return FALSE;
+	memset(outer, 0xAA, 100);
+
+	if (!winpr_Arena_BeginScope(arena))
+		return FALSE;
+
+	BYTE* first = winpr_Arena_Alloc(arena, 16, 0);
+	if (!first)
+		return FALSE;
+
+	for (size_t depth = 0; depth < 20; depth++)
+	{
+		if (!winpr_Arena_BeginScope(arena))
+			return FALSE;
+		for (size_t x = 0; x < 10; x++)
+		{
+			BYTE* ptr = winpr_Arena_Alloc(arena, 300, 0);
+			if (!ptr)
+				return FALSE;
+			memset(ptr, 0x55, 300);
+		}
+	}
+	for (size_t depth = 0; depth < 20; depth++)
+		winpr_Arena_EndScope(arena);
+
+	/* allocations after an inner scope ended reuse its memory */
+	BYTE* again = winpr_Arena_Alloc(arena, 16, 0);
+	winpr_Arena_EndScope(arena);
+	BYTE* last = winpr_Arena_Alloc(arena, 16, 0);
+	if (!again || (again != first + 16) || (last != first))
+		return FALSE;
+
+	for (size_t x = 0; x < 100; x++)
+	{
+		if (outer[x] != 0xAA)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* after a reset the blocks are reused, the same workload does not grow the arena */
+static BOOL test_reset(wArena* arena)
+{
+	size_t capacity = 0;
+
+	for (size_t round = 0; round < 10; round++)
+	{
+		winpr_Arena_Reset(arena);
+		for (size_t x = 0; x < 100; x++)
+		{
+			BYTE* ptr = winpr_Arena_Alloc(arena, 1 + (x * 37) % 500, 0);
+			if (!ptr)
+				return FALSE;
+			memset(ptr, (int)x, 1 + (x * 37) % 500);
+		}
+
+		/* bigger than a block */
+		BYTE* large = winpr_Arena_Alloc(arena, 5 * TEST_BLOCK_SIZE, 64);
+		if (!large || (((uintptr_t)large % 64) != 0))
+			return FALSE;
+		memset(large, 0x11, 5 * TEST_BLOCK_SIZE);
+
+		if (round == 0)
+			capacity = winpr_Arena_Capacity(arena);
+		else if (winpr_Arena_Capacity(arena) != capacity)
+		{
+			(void)fprintf(stderr, "arena grew from %" PRIuz " to %" PRIuz " bytes\n", capacity,
+			              winpr_Arena_Capacity(arena));
+			return FALSE;
+		}
+	}
+	return capacity >= 5 * TEST_BLOCK_SIZE;
+}
+
+int TestMemoryArena(int argc, char* argv[])
+{
+	int rc = -1;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	wArena* arena = winpr_Arena_New(TEST_BLOCK_SIZE);
+	if (!arena)
+		return -1;
+
+	if (!test_alignment(arena))
+		goto fail;
+	winpr_Arena_Reset(arena);
+	if (!test_scopes(arena))
+		goto fail;
+	if (!test_reset(arena))
+		goto fail;
+
+	rc = 0;
+fail:
+	winpr_Arena_Free(arena);
+	return rc;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/memory.h>
+
+static BOOL test_alloc(size_t size, DWORD flags)
+{
+	BYTE* ptr = winpr_LargeAlloc(size, flags);
+	if (!ptr)
+	{
+		printf("winpr_LargeAlloc(%" PRIuz ", 0x%08" PRIx32 ") failed\n", size, flags);
+		return FALSE;
+	}
+
+	BOOL rc = ((uintptr_t)ptr % 4096) == 0;
+	for (size_t x = 0; rc && (x < size); x += 4093)
+	{
+		if (ptr[x] != 0)
+			rc = FALSE;
+		ptr[x] = (BYTE)x;
+	}
+	ptr[size - 1] = 0xFF;
+
+	winpr_LargeFree(ptr, size);
+	return rc;
+}
+
+int TestMemoryLargeAlloc(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (winpr_LargeAlloc(0, 0))
+		return -1;
+	winpr_LargeFree(NULL, 0);
+
+	if (!test_alloc(1, 0) || !test_alloc(5000, 0))
+		return -1;
+
+	/* huge pages are a hint, smaller sizes and systems without them use normal pages */
+	if (!test_alloc(100, WINPR_LARGE_ALLOC_HUGE_PAGES) ||
+	    !test_alloc(3ull * 1024ull * 1024ull + 17, WINPR_LARGE_ALLOC_HUGE_PAGES) ||
+	    !test_alloc(3840ull * 2160ull * 4ull, WINPR_LARGE_ALLOC_HUGE_PAGES))
+		return -1;
+	return 0;
+}
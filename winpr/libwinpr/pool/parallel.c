@@ -0,0 +1,144 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Thread Pool API (Parallel For)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
+#include <winpr/pool.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("pool")
+
+/* ranges handed out per thread when the caller does not choose a grain */
+#define PARALLEL_FOR_RANGES_PER_THREAD 4
+#define PARALLEL_FOR_MAX_RANGES (INT32_MAX / 2)
+
+struct s_winpr_parallel_for
+{
+	PTP_WORK work;
+	size_t threads;
+
+	WINPR_PARALLEL_FOR_CALLBACK fn;
+	void* context;
+	size_t count;
+	size_t grain;
+	LONG ranges;
+	LONG next;
+	LONG failed;
+};
+
+static void parallel_for_run_ranges(wParallelFor* pf)
+{
+	WINPR_ASSERT(pf);
+
+	while (1)
+	{
+		const LONG range = InterlockedIncrement(&pf->next) - 1;
+		if (range >= pf->ranges)
+			break;
+
+		const size_t begin = (size_t)range * pf->grain;
+		const size_t end = (pf->count - begin > pf->grain) ? begin + pf->grain : pf->count;
+
+		if (!pf->fn(pf->context, begin, end))
+		{
+			/* nobody starts another range */
+			(void)InterlockedExchange(&pf->failed, 1);
+			(void)InterlockedExchange(&pf->next, pf->ranges);
+		}
+	}
+}
+
+static void CALLBACK parallel_for_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                                void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	parallel_for_run_ranges((wParallelFor*)context);
+}
+
+void winpr_ParallelFor_Free(wParallelFor* pf)
+{
+	if (!pf)
+		return;
+
+	if (pf->work)
+		CloseThreadpoolWork(pf->work);
+	free(pf);
+}
+
+wParallelFor* winpr_ParallelFor_New(PTP_CALLBACK_ENVIRON pcbe)
+{
+	SYSTEM_INFO info = { 0 };
+	wParallelFor* pf = (wParallelFor*)calloc(1, sizeof(wParallelFor));
+
+	if (!pf)
+		return NULL;
+
+	GetSystemInfo(&info);
+	pf->threads = (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+
+	pf->work = CreateThreadpoolWork(parallel_for_work_callback, pf, pcbe);
+	if (!pf->work)
+	{
+		WLog_ERR(TAG, "CreateThreadpoolWork failed");
+		winpr_ParallelFor_Free(pf);
+		return NULL;
+	}
+
+	return pf;
+}
+
+BOOL winpr_ParallelFor(wParallelFor* pf, size_t count, size_t grain,
+                       WINPR_PARALLEL_FOR_CALLBACK fn, void* context)
+{
+	if (!pf || !fn)
+		return FALSE;
+
+	if (count == 0)
+		return TRUE;
+
+	if (grain == 0)
+		grain = 1 + (count - 1) / (pf->threads * PARALLEL_FOR_RANGES_PER_THREAD);
+
+	/* the range counter is a LONG that every thread overshoots once */
+	if ((count - 1) / grain >= PARALLEL_FOR_MAX_RANGES)
+		grain = 1 + (count - 1) / PARALLEL_FOR_MAX_RANGES;
+
+	const size_t ranges = 1 + (count - 1) / grain;
+	if (ranges == 1)
+		return fn(context, 0, count);
+
+	pf->fn = fn;
+	pf->context = context;
+	pf->count = count;
+	pf->grain = grain;
+	pf->ranges = (LONG)ranges;
+	pf->next = 0;
+	pf->failed = 0;
+
+	/* the calling thread takes ranges as well */
+	const size_t helpers = (ranges - 1 < pf->threads) ? ranges - 1 : pf->threads;
+	for (size_t x = 0; x < helpers; x++)
+		SubmitThreadpoolWork(pf->work);
+
+	parallel_for_run_ranges(pf);
+	WaitForThreadpoolWorkCallbacks(pf->work, FALSE);
+
+	return pf->failed == 0;
+}
@@ -19,7 +19,9 @@
 
 #include <winpr/config.h>
 
+#include <winpr/assert.h>
 #include <winpr/crt.h>
+#include <winpr/interlocked.h>
 #include <winpr/sysinfo.h>
 #include <winpr/pool.h>
 #include <winpr/library.h>
@@ -51,49 +53,246 @@ static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
 }
 #endif
 
+#define WORK_SHARD_MIN_CAPACITY 64
+
+typedef struct
+{
+	PTP_POOL pool;
+	size_t shard;
+} TP_WORKER;
+
 static TP_POOL DEFAULT_POOL = {
-	0,    /* DWORD Minimum */
-	500,  /* DWORD Maximum */
-	NULL, /* wArrayList* Threads */
-	NULL, /* wQueue* PendingQueue */
-	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
+	0,     /* DWORD Minimum */
+	500,   /* DWORD Maximum */
+	NULL,  /* wArrayList* Threads */
+	NULL,  /* TP_WORK_SHARD* Shards */
+	0,     /* size_t ShardCount */
+	0,     /* LONG NextShard */
+	0,     /* LONG NextWorker */
+	0,     /* LONG IdleWorkers */
+	NULL,  /* HANDLE WorkAvailable */
+	NULL,  /* HANDLE TerminateEvent */
+	0,     /* LONG PendingWork */
+	{ 0 }, /* CRITICAL_SECTION CompleteLock */
+	NULL,  /* HANDLE WorkComplete */
 };
 
-static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+static INIT_ONCE init_once_worker = INIT_ONCE_STATIC_INIT;
+static DWORD worker_tls_index = TLS_OUT_OF_INDEXES;
+
+static BOOL CALLBACK init_worker(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                 WINPR_ATTR_UNUSED PVOID param,
+                                 WINPR_ATTR_UNUSED PVOID* context)
+{
+	worker_tls_index = TlsAlloc();
+	return worker_tls_index != TLS_OUT_OF_INDEXES;
+}
+
+static TP_WORKER* current_worker(void)
+{
+	if (!InitOnceExecuteOnce(&init_once_worker, init_worker, NULL, NULL))
+		return NULL;
+	return (TP_WORKER*)TlsGetValue(worker_tls_index);
+}
+
+static BOOL shard_push(TP_WORK_SHARD* shard, PTP_WORK work)
+{
+	WINPR_ASSERT(shard);
+
+	if (shard->Count == shard->Capacity)
+	{
+		const size_t capacity =
+		    (shard->Capacity > 0) ? shard->Capacity * 2 : WORK_SHARD_MIN_CAPACITY;
+		PTP_WORK* items = (PTP_WORK*)calloc(capacity, sizeof(PTP_WORK));
+		if (!items)
+			return FALSE;
+
+		for (size_t x = 0; x < shard->Count; x++)
+			items[x] = shard->Items[(shard->Head + x) & (shard->Capacity - 1)];
+
+		free((void*)shard->Items);
+		shard->Items = items;
+		shard->Capacity = capacity;
+		shard->Head = 0;
+	}
+
+	shard->Items[(shard->Head + shard->Count) & (shard->Capacity - 1)] = work;
+	shard->Count++;
+	return TRUE;
+}
+
+static PTP_WORK shard_pop(TP_WORK_SHARD* shard, BOOL newest)
 {
-	DWORD status = 0;
-	PTP_POOL pool = NULL;
 	PTP_WORK work = NULL;
-	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance = NULL;
 
-	pool = (PTP_POOL)arg;
+	WINPR_ASSERT(shard);
+	if (shard->Count == 0)
+		return NULL;
+
+	if (newest)
+		work = shard->Items[(shard->Head + shard->Count - 1) & (shard->Capacity - 1)];
+	else
+	{
+		work = shard->Items[shard->Head];
+		shard->Head = (shard->Head + 1) & (shard->Capacity - 1);
+	}
+	shard->Count--;
+	return work;
+}
+
+/**
+ * Takes the newest work of the own shard, or steals the oldest one of another. Unless
+ * \b wait is set contended shards of other workers are skipped.
+ */
+static PTP_WORK thread_pool_take(PTP_POOL pool, size_t home, BOOL wait)
+{
+	for (size_t x = 0; x < pool->ShardCount; x++)
+	{
+		TP_WORK_SHARD* shard = &pool->Shards[(home + x) % pool->ShardCount];
 
-	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+		if (wait || (x == 0))
+			EnterCriticalSection(&shard->Lock);
+		else if (!TryEnterCriticalSection(&shard->Lock))
+			continue;
 
-	while (1)
+		PTP_WORK work = shard_pop(shard, x == 0);
+		LeaveCriticalSection(&shard->Lock);
+
+		if (work)
+			return work;
+	}
+
+	return NULL;
+}
+
+/* takes one of the idle workers, whoever succeeds has to post or consume its wakeup */
+static BOOL thread_pool_claim_idle(PTP_POOL pool)
+{
+	LONG idle = InterlockedCompareExchange(&pool->IdleWorkers, 0, 0);
+
+	while (idle > 0)
+	{
+		const LONG prev = InterlockedCompareExchange(&pool->IdleWorkers, idle - 1, idle);
+		if (prev == idle)
+			return TRUE;
+		idle = prev;
+	}
+
+	return FALSE;
+}
+
+/**
+ * The completion event is only touched when the pool goes busy or idle. Work only counts up
+ * without the lock while other work is pending, so whenever work is pending the event is reset
+ * and no other submitter can wait on a completion that has not happened yet.
+ */
+static void thread_pool_work_added(PTP_POOL pool)
+{
+	LONG pending = InterlockedCompareExchange(&pool->PendingWork, 0, 0);
+
+	while (pending > 0)
+	{
+		const LONG prev = InterlockedCompareExchange(&pool->PendingWork, pending + 1, pending);
+		if (prev == pending)
+			return;
+		pending = prev;
+	}
+
+	EnterCriticalSection(&pool->CompleteLock);
+	(void)ResetEvent(pool->WorkComplete);
+	(void)InterlockedIncrement(&pool->PendingWork);
+	LeaveCriticalSection(&pool->CompleteLock);
+}
+
+static void thread_pool_work_done(PTP_POOL pool)
+{
+	if (InterlockedDecrement(&pool->PendingWork) != 0)
+		return;
+
+	EnterCriticalSection(&pool->CompleteLock);
+	if (InterlockedCompareExchange(&pool->PendingWork, 0, 0) == 0)
+		(void)SetEvent(pool->WorkComplete);
+	LeaveCriticalSection(&pool->CompleteLock);
+}
+
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK work)
+{
+	size_t index = 0;
+
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(work);
+
+	/* nested work stays with the submitting worker, everything else is spread over the shards */
+	const TP_WORKER* worker = current_worker();
+	if (worker && (worker->pool == pool))
+		index = worker->shard;
+	else
+		index = (size_t)(ULONG)InterlockedIncrement(&pool->NextShard) % pool->ShardCount;
+
+	TP_WORK_SHARD* shard = &pool->Shards[index];
+
+	thread_pool_work_added(pool);
+	EnterCriticalSection(&shard->Lock);
+	const BOOL rc = shard_push(shard, work);
+	LeaveCriticalSection(&shard->Lock);
+
+	if (!rc)
 	{
-		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		thread_pool_work_done(pool);
+		return FALSE;
+	}
+
+	if (thread_pool_claim_idle(pool))
+		(void)ReleaseSemaphore(pool->WorkAvailable, 1, NULL);
+	return TRUE;
+}
+
+static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+{
+	PTP_POOL pool = (PTP_POOL)arg;
+	WINPR_ASSERT(pool);
 
-		if (status == WAIT_OBJECT_0)
-			break;
+	TP_WORKER worker = { pool, (size_t)(ULONG)InterlockedIncrement(&pool->NextWorker) %
+	                               pool->ShardCount };
+	HANDLE events[] = { pool->TerminateEvent, pool->WorkAvailable };
 
-		if (status != (WAIT_OBJECT_0 + 1))
-			break;
+	/* without thread local storage nested work is spread like any other */
+	(void)current_worker();
+	if (worker_tls_index != TLS_OUT_OF_INDEXES)
+		(void)TlsSetValue(worker_tls_index, &worker);
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
+	while (1)
+	{
+		PTP_WORK work = thread_pool_take(pool, worker.shard, FALSE);
 
-		if (callbackInstance)
+		if (!work)
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			/* a submitter that does not see us idle pushed before the final look */
+			(void)InterlockedIncrement(&pool->IdleWorkers);
+			work = thread_pool_take(pool, worker.shard, TRUE);
+
+			if (!work)
+			{
+				const DWORD status =
+				    WaitForMultipleObjects(ARRAYSIZE(events), events, FALSE, INFINITE);
+				if (status != (WAIT_OBJECT_0 + 1))
+					break;
+				continue;
+			}
+
+			/* somebody already claimed this worker, swallow the wakeup */
+			if (!thread_pool_claim_idle(pool))
+				(void)WaitForSingleObject(pool->WorkAvailable, INFINITE);
 		}
+
+		TP_CALLBACK_INSTANCE instance = { 0 };
+		instance.Work = work;
+		work->WorkCallback(&instance, work->CallbackParameter, work);
+		thread_pool_work_done(pool);
 	}
 
+	if (worker_tls_index != TLS_OUT_OF_INDEXES)
+		(void)TlsSetValue(worker_tls_index, NULL);
 	ExitThread(0);
 	return 0;
 }
@@ -112,12 +311,32 @@ static BOOL InitializeThreadpool(PTP_POOL pool)
 	if (pool->Threads)
 		return TRUE;
 
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
+	SYSTEM_INFO info = { 0 };
+	GetSystemInfo(&info);
+	if (info.dwNumberOfProcessors < 1)
+		info.dwNumberOfProcessors = 1;
+
+	if (!(pool->Shards = (TP_WORK_SHARD*)calloc(info.dwNumberOfProcessors, sizeof(TP_WORK_SHARD))))
 		goto fail;
 
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
+	for (; pool->ShardCount < info.dwNumberOfProcessors; pool->ShardCount++)
+	{
+		if (!InitializeCriticalSectionAndSpinCount(&pool->Shards[pool->ShardCount].Lock, 4000))
+			goto fail;
+	}
+
+	if (!(pool->WorkAvailable = CreateSemaphore(NULL, 0, MAXLONG, NULL)))
+		goto fail;
+
+	if (!InitializeCriticalSectionAndSpinCount(&pool->CompleteLock, 4000))
 		goto fail;
 
+	if (!(pool->WorkComplete = CreateEvent(NULL, TRUE, TRUE, NULL)))
+	{
+		DeleteCriticalSection(&pool->CompleteLock);
+		goto fail;
+	}
+
 	if (!(pool->TerminateEvent = CreateEvent(NULL, TRUE, FALSE, NULL)))
 		goto fail;
 
@@ -127,10 +346,6 @@ static BOOL InitializeThreadpool(PTP_POOL pool)
 	obj = ArrayList_Object(pool->Threads);
 	obj->fnObjectFree = threads_close;
 
-	SYSTEM_INFO info = { 0 };
-	GetSystemInfo(&info);
-	if (info.dwNumberOfProcessors < 1)
-		info.dwNumberOfProcessors = 1;
 	if (!SetThreadpoolThreadMinimum(pool, info.dwNumberOfProcessors))
 		goto fail;
 	SetThreadpoolThreadMaximum(pool, info.dwNumberOfProcessors);
@@ -188,9 +403,23 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 	(void)SetEvent(ptpp->TerminateEvent);
 
 	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
-	(void)CloseHandle(ptpp->TerminateEvent);
+
+	for (size_t x = 0; x < ptpp->ShardCount; x++)
+	{
+		DeleteCriticalSection(&ptpp->Shards[x].Lock);
+		free((void*)ptpp->Shards[x].Items);
+	}
+	free(ptpp->Shards);
+
+	if (ptpp->WorkComplete)
+	{
+		(void)CloseHandle(ptpp->WorkComplete);
+		DeleteCriticalSection(&ptpp->CompleteLock);
+	}
+	if (ptpp->WorkAvailable)
+		(void)CloseHandle(ptpp->WorkAvailable);
+	if (ptpp->TerminateEvent)
+		(void)CloseHandle(ptpp->TerminateEvent);
 
 	{
 		TP_POOL empty = { 0 };
@@ -250,6 +479,11 @@ VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
 		(void)SetEvent(ptpp->TerminateEvent);
 		ArrayList_Clear(ptpp->Threads);
 		(void)ResetEvent(ptpp->TerminateEvent);
+
+		/* no worker is left to wait for wakeups */
+		(void)InterlockedExchange(&ptpp->IdleWorkers, 0);
+		while (WaitForSingleObject(ptpp->WorkAvailable, 0) == WAIT_OBJECT_0)
+			;
 	}
 	ArrayList_Unlock(ptpp->Threads);
 	winpr_SetThreadpoolThreadMinimum(ptpp, ptpp->Minimum);
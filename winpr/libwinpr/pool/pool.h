@@ -26,6 +26,19 @@
 #include <winpr/thread.h>
 #include <winpr/collections.h>
 
+/**
+ * Pending work of one worker group. The owning workers take from the tail (newest first),
+ * idle workers of other shards steal from the head.
+ */
+typedef struct
+{
+	CRITICAL_SECTION Lock;
+	PTP_WORK* Items;
+	size_t Capacity;
+	size_t Head;
+	size_t Count;
+} TP_WORK_SHARD;
+
 #if defined(_WIN32)
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN6) || defined(__MINGW32__)
 struct S_TP_CALLBACK_INSTANCE
@@ -38,9 +51,16 @@ struct S_TP_POOL
 	DWORD Minimum;
 	DWORD Maximum;
 	wArrayList* Threads;
-	wQueue* PendingQueue;
+	TP_WORK_SHARD* Shards;
+	size_t ShardCount;
+	LONG NextShard;
+	LONG NextWorker;
+	LONG IdleWorkers;
+	HANDLE WorkAvailable;
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	LONG PendingWork;
+	CRITICAL_SECTION CompleteLock;
+	HANDLE WorkComplete;
 };
 
 struct S_TP_WORK
@@ -82,9 +102,16 @@ struct S_TP_POOL
 	DWORD Minimum;
 	DWORD Maximum;
 	wArrayList* Threads;
-	wQueue* PendingQueue;
+	TP_WORK_SHARD* Shards;
+	size_t ShardCount;
+	LONG NextShard;
+	LONG NextWorker;
+	LONG IdleWorkers;
+	HANDLE WorkAvailable;
 	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	LONG PendingWork;
+	CRITICAL_SECTION CompleteLock;
+	HANDLE WorkComplete;
 };
 
 struct S_TP_WORK
@@ -118,5 +145,6 @@ struct S_TP_CLEANUP_GROUP
 #endif
 
 PTP_POOL GetDefaultThreadpool(void);
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK work);
 
 #endif /* WINPR_POOL_PRIVATE_H */
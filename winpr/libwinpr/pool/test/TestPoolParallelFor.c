@@ -0,0 +1,125 @@
+
+#include <winpr/wtypes.h>
+#include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/interlocked.h>
+
+#define TEST_ITEMS 10007
+
+typedef struct
+{
+	LONG calls;
+	size_t failAt;
+	BYTE seen[TEST_ITEMS];
+} test_state;
+
+static BOOL test_ParallelForCallback(void* context, size_t begin, size_t end)
+{
+	test_state* state = (test_state*)context;
+
+	InterlockedIncrement(&state->calls);
+	if ((begin >= end) || (end > TEST_ITEMS))
+		return FALSE;
+
+	for (size_t x = begin; x < end; x++)
+	{
+		if (x == state->failAt)
+			return FALSE;
+		state->seen[x]++;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_run(wParallelFor* pf, size_t count, size_t grain)
+{
+	test_state* state = (test_state*)calloc(1, sizeof(test_state));
+	if (!state)
+		return FALSE;
+
+	BOOL rc = FALSE;
+	state->failAt = SIZE_MAX;
+
+	if (!winpr_ParallelFor(pf, count, grain, test_ParallelForCallback, state))
+	{
+		printf("winpr_ParallelFor(%" PRIuz ", %" PRIuz ") failed\n", count, grain);
+		goto fail;
+	}
+
+	/* every item exactly once */
+	for (size_t x = 0; x < TEST_ITEMS; x++)
+	{
+		if (state->seen[x] != ((x < count) ? 1 : 0))
+		{
+			printf("item %" PRIuz " processed %" PRIu8 " times\n", x, state->seen[x]);
+			goto fail;
+		}
+	}
+
+	if ((grain > 0) && ((size_t)state->calls != (count + grain - 1) / grain))
+	{
+		printf("%" PRId32 " ranges for %" PRIuz " items\n", state->calls, count);
+		goto fail;
+	}
+
+	/* a failing range fails the loop */
+	if (count > 0)
+	{
+		memset(state->seen, 0, sizeof(state->seen));
+		state->failAt = count / 2;
+		if (winpr_ParallelFor(pf, count, grain, test_ParallelForCallback, state))
+		{
+			printf("winpr_ParallelFor(%" PRIuz ", %" PRIuz ") did not fail\n", count, grain);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(state);
+	return rc;
+}
+
+int TestPoolParallelFor(int argc, char* argv[])
+{
+	int rc = -1;
+	PTP_POOL pool = NULL;
+	wParallelFor* pf = NULL;
+	TP_CALLBACK_ENVIRON environment;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	InitializeThreadpoolEnvironment(&environment);
+
+	if (!(pool = CreateThreadpool(NULL)))
+		goto fail;
+
+	if (!SetThreadpoolThreadMinimum(pool, 4))
+		goto fail;
+
+	SetThreadpoolCallbackPool(&environment, pool);
+	if (!(pf = winpr_ParallelFor_New(&environment)))
+		goto fail;
+
+	/* the loop is reused over different sizes */
+	const size_t counts[] = { 0, 1, 2, 63, 64, 65, 1000, TEST_ITEMS };
+	const size_t grains[] = { 0, 1, 7, 64, TEST_ITEMS * 2 };
+
+	for (size_t x = 0; x < ARRAYSIZE(counts); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(grains); y++)
+		{
+			if (!test_run(pf, counts[x], grains[y]))
+				goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	winpr_ParallelFor_Free(pf);
+	DestroyThreadpoolEnvironment(&environment);
+	if (pool)
+		CloseThreadpool(pool);
+	return rc;
+}
@@ -118,6 +118,73 @@ fail:
 	return rc;
 }
 
+#define NESTED_PARENTS 64
+#define NESTED_CHILDREN 256
+
+static LONG nested = 0;
+static PTP_WORK nestedChild = NULL;
+
+static void CALLBACK test_NestedChildCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                              PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(work);
+	InterlockedIncrement(&nested);
+}
+
+static void CALLBACK test_NestedParentCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                               PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(context);
+	WINPR_UNUSED(work);
+
+	for (int index = 0; index < NESTED_CHILDREN; index++)
+		SubmitThreadpoolWork(nestedChild);
+}
+
+static BOOL test3(void)
+{
+	BOOL rc = FALSE;
+	printf("Nested work\n");
+
+	/* work submitted from callbacks is waited for as well */
+	PTP_WORK parent = CreateThreadpoolWork(test_NestedParentCallback, NULL, NULL);
+	nestedChild = CreateThreadpoolWork(test_NestedChildCallback, NULL, NULL);
+
+	if (!parent || !nestedChild)
+	{
+		printf("CreateThreadpoolWork failure\n");
+		goto fail;
+	}
+
+	for (int round = 0; round < 4; round++)
+	{
+		nested = 0;
+
+		for (int index = 0; index < NESTED_PARENTS; index++)
+			SubmitThreadpoolWork(parent);
+
+		WaitForThreadpoolWorkCallbacks(parent, FALSE);
+
+		if (nested != NESTED_PARENTS * NESTED_CHILDREN)
+		{
+			printf("%" PRId32 " nested callbacks, expected %d\n", nested,
+			       NESTED_PARENTS * NESTED_CHILDREN);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	if (parent)
+		CloseThreadpoolWork(parent);
+	if (nestedChild)
+		CloseThreadpoolWork(nestedChild);
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 
@@ -130,5 +197,8 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test3())
+		return -1;
+
 	return 0;
 }
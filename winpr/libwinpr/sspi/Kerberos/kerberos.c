@@ -292,6 +292,72 @@ fail:
 	return rv;
 }
 
+/**
+ * Resolve a memory credential cache shared by all credential handles of this process that
+ * authenticate \b principal with \b password. Tickets obtained by one connection are reused by
+ * the next, so concurrent or repeated logons of the same identity do not repeat the AS and TGS
+ * exchanges. The password is part of the cache name so a wrong password never finds the tickets
+ * acquired with the right one.
+ */
+static krb5_error_code kerberos_shared_ccache(krb5_context ctx, krb5_principal principal,
+                                              const char* password, krb5_ccache* pccache)
+{
+	char* pname = NULL;
+	krb5_principal cprincipal = NULL;
+	krb5_ccache ccache = NULL;
+	BYTE hash[WINPR_SHA256_DIGEST_LENGTH] = { 0 };
+	char hex[2 * WINPR_SHA256_DIGEST_LENGTH + 1] = { 0 };
+	char name[sizeof(hex) + 32] = { 0 };
+	krb5_error_code rv = KRB5_CC_NOMEM;
+
+	WINPR_ASSERT(principal);
+	WINPR_ASSERT(password);
+	WINPR_ASSERT(pccache);
+
+	rv = krb_log_exec(krb5_unparse_name, ctx, principal, &pname);
+	if (rv)
+		return rv;
+
+	WINPR_DIGEST_CTX* sha256 = winpr_Digest_New();
+	rv = KRB5_CC_NOMEM;
+	if (!sha256 || !winpr_Digest_Init(sha256, WINPR_MD_SHA256) ||
+	    !winpr_Digest_Update(sha256, (const BYTE*)pname, strlen(pname) + 1) ||
+	    !winpr_Digest_Update(sha256, (const BYTE*)password, strlen(password)) ||
+	    !winpr_Digest_Final(sha256, hash, sizeof(hash)))
+	{
+		winpr_Digest_Free(sha256);
+		goto fail;
+	}
+	winpr_Digest_Free(sha256);
+
+	(void)winpr_BinToHexStringBuffer(hash, sizeof(hash), hex, sizeof(hex), FALSE);
+	(void)_snprintf(name, sizeof(name), "MEMORY:winpr_%s", hex);
+
+	rv = krb_log_exec(krb5_cc_resolve, ctx, name, &ccache);
+	if (rv)
+		goto fail;
+
+	/* A new cache has no principal yet, an existing one keeps its tickets */
+	if (krb5_cc_get_principal(ctx, ccache, &cprincipal) ||
+	    !krb5_principal_compare(ctx, principal, cprincipal))
+	{
+		rv = krb_log_exec(krb5_cc_initialize, ctx, ccache, principal);
+		if (rv)
+			goto fail;
+	}
+
+	*pccache = ccache;
+	ccache = NULL;
+
+fail:
+	if (cprincipal)
+		krb5_free_principal(ctx, cprincipal);
+	if (ccache)
+		krb5_cc_close(ctx, ccache);
+	krb5_free_unparsed_name(ctx, pname);
+	return rv;
+}
+
 #endif /* WITH_KRB5 */
 
 static SECURITY_STATUS SEC_ENTRY kerberos_AcquireCredentialsHandleA(
@@ -376,7 +442,14 @@ static SECURITY_STATUS SEC_ENTRY kerberos_AcquireCredentialsHandleA(
 	else
 		own_ccache = TRUE;
 
-	if (principal)
+	if (principal && own_ccache && password && (fCredentialUse & SECPKG_CRED_OUTBOUND))
+	{
+		/* Authenticating with a password, only reuse tickets acquired with that password */
+		if (kerberos_shared_ccache(ctx, principal, password, &ccache))
+			goto cleanup;
+		own_ccache = FALSE;
+	}
+	else if (principal)
 	{
 		/* Use the default cache if it's initialized with the right principal */
 		if (krb5_cc_cache_match(ctx, principal, &ccache) == KRB5_CC_NOTFOUND)
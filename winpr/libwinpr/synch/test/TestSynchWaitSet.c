@@ -0,0 +1,101 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+/* more than WaitForMultipleObjects can take outside of windows */
+#ifdef _WIN32
+#define TEST_EVENTS MAXIMUM_WAIT_OBJECTS
+#else
+#define TEST_EVENTS 200
+#endif
+
+static BOOL check_signaled(wWaitSet* set, const HANDLE* events, const size_t* expected,
+                           size_t count)
+{
+	HANDLE signaled[TEST_EVENTS] = { 0 };
+	DWORD nSignaled = 0;
+
+	const DWORD status = winpr_WaitSet_Wait(set, 0, signaled, ARRAYSIZE(signaled), &nSignaled);
+	if (count == 0)
+		return (status == WAIT_TIMEOUT) && (nSignaled == 0);
+
+	if ((status != WAIT_OBJECT_0) || (nSignaled != count))
+	{
+		(void)fprintf(stderr, "status %" PRIu32 ", %" PRIu32 " signaled, expected %" PRIuz "\n",
+		              status, nSignaled, count);
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < count; x++)
+	{
+		BOOL found = FALSE;
+		for (DWORD y = 0; y < nSignaled; y++)
+			found |= (signaled[y] == events[expected[x]]);
+		if (!found)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+int TestSynchWaitSet(int argc, char* argv[])
+{
+	int rc = -1;
+	HANDLE events[TEST_EVENTS] = { 0 };
+	const size_t some[] = { 0, 17, TEST_EVENTS - 1 };
+	const size_t remaining[] = { 0, TEST_EVENTS - 1 };
+	HANDLE first = NULL;
+	DWORD nSignaled = 0;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	wWaitSet* set = winpr_WaitSet_New();
+	if (!set)
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(events); x++)
+	{
+		events[x] = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!events[x] || !winpr_WaitSet_Add(set, events[x]))
+			goto fail;
+	}
+
+	/* adding twice does not register the handle twice */
+	if (!winpr_WaitSet_Add(set, events[0]) || (winpr_WaitSet_Count(set) != ARRAYSIZE(events)))
+		goto fail;
+
+	if (!check_signaled(set, events, NULL, 0))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(some); x++)
+		(void)SetEvent(events[some[x]]);
+	if (!check_signaled(set, events, some, ARRAYSIZE(some)))
+		goto fail;
+
+	/* the result array limits the number of returned handles */
+	if ((winpr_WaitSet_Wait(set, 0, &first, 1, &nSignaled) != WAIT_OBJECT_0) || (nSignaled != 1))
+		goto fail;
+
+	/* removed handles are not reported anymore */
+	if (!winpr_WaitSet_Remove(set, events[17]) || winpr_WaitSet_Remove(set, events[17]))
+		goto fail;
+	if (!check_signaled(set, events, remaining, ARRAYSIZE(remaining)))
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(some); x++)
+		(void)ResetEvent(events[some[x]]);
+	if (!check_signaled(set, events, NULL, 0))
+		goto fail;
+
+	winpr_WaitSet_Clear(set);
+	if (winpr_WaitSet_Count(set) != 0)
+		goto fail;
+
+	rc = 0;
+fail:
+	winpr_WaitSet_Free(set);
+	for (size_t x = 0; x < ARRAYSIZE(events); x++)
+		(void)CloseHandle(events[x]);
+	return rc;
+}
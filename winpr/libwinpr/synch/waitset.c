@@ -0,0 +1,381 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Synchronization Functions (Wait Sets)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("sync.waitset")
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef _WIN32
+#include <winpr/handle.h>
+
+#include "../handle/handle.h"
+#include "pollset.h"
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+#endif
+
+struct s_wWaitSet
+{
+	HANDLE* handles;
+	size_t count;
+	size_t capacity;
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+	int epfd;
+	struct epoll_event* events;
+	size_t eventCount;
+#endif
+};
+
+static SSIZE_T waitset_find(const wWaitSet* set, HANDLE handle)
+{
+	WINPR_ASSERT(set);
+
+	for (size_t x = 0; x < set->count; x++)
+	{
+		if (set->handles[x] == handle)
+			return (SSIZE_T)x;
+	}
+	return -1;
+}
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+static uint32_t waitset_epoll_events(ULONG mode)
+{
+	uint32_t events = 0;
+
+	if (mode & WINPR_FD_READ)
+		events |= EPOLLIN;
+	if (mode & WINPR_FD_WRITE)
+		events |= EPOLLOUT;
+	return events;
+}
+#endif
+
+#ifndef _WIN32
+static BOOL waitset_register(wWaitSet* set, HANDLE handle)
+{
+	ULONG type = 0;
+	WINPR_HANDLE* object = NULL;
+
+	WINPR_ASSERT(set);
+
+	if (!winpr_Handle_GetInfo(handle, &type, &object) || (winpr_Handle_getFd(handle) < 0))
+	{
+		WLog_ERR(TAG, "invalid handle %p", handle);
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+	struct epoll_event event = { 0 };
+	event.events = waitset_epoll_events(object->Mode);
+	event.data.ptr = handle;
+
+	if (epoll_ctl(set->epfd, EPOLL_CTL_ADD, winpr_Handle_getFd(handle), &event) < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "epoll_ctl(EPOLL_CTL_ADD) failed [%d] %s", errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+#endif
+	return TRUE;
+}
+
+static void waitset_unregister(wWaitSet* set, HANDLE handle)
+{
+	WINPR_ASSERT(set);
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+	struct epoll_event event = { 0 };
+	(void)epoll_ctl(set->epfd, EPOLL_CTL_DEL, winpr_Handle_getFd(handle), &event);
+#else
+	WINPR_UNUSED(handle);
+#endif
+}
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+static DWORD waitset_timeout(UINT64 dueTime)
+{
+	if (dueTime == UINT64_MAX)
+		return INFINITE;
+
+	const UINT64 now = GetTickCount64();
+	return (now < dueTime) ? (DWORD)(dueTime - now) : 0;
+}
+
+static int waitset_poll(wWaitSet* set, DWORD dwMilliseconds, HANDLE* lpHandles, DWORD nCount)
+{
+	WINPR_ASSERT(set);
+
+	const size_t max = MIN(set->count, nCount);
+	if (set->eventCount < max)
+	{
+		struct epoll_event* events =
+		    (struct epoll_event*)realloc(set->events, sizeof(struct epoll_event) * max);
+		if (!events)
+			return -1;
+		set->events = events;
+		set->eventCount = max;
+	}
+
+	const UINT64 now = GetTickCount64();
+	const UINT64 dueTime = (dwMilliseconds == INFINITE) ? UINT64_MAX : now + dwMilliseconds;
+	int status = 0;
+
+	do
+	{
+		const DWORD timeout = waitset_timeout(dueTime);
+		status = epoll_wait(set->epfd, set->events, (int)max,
+		                    (timeout == INFINITE) ? -1 : (int)MIN(timeout, INT32_MAX));
+	} while ((status < 0) && (errno == EINTR));
+
+	for (int x = 0; x < status; x++)
+		lpHandles[x] = set->events[x].data.ptr;
+	return status;
+}
+#else
+static int waitset_poll(wWaitSet* set, DWORD dwMilliseconds, HANDLE* lpHandles, DWORD nCount)
+{
+	WINPR_POLL_SET pollset = { 0 };
+	int status = -1;
+
+	WINPR_ASSERT(set);
+
+	if (!pollset_init(&pollset, set->count))
+		return -1;
+
+	for (size_t x = 0; x < set->count; x++)
+	{
+		ULONG type = 0;
+		WINPR_HANDLE* object = NULL;
+
+		if (!winpr_Handle_GetInfo(set->handles[x], &type, &object) ||
+		    !pollset_add(&pollset, winpr_Handle_getFd(set->handles[x]), object->Mode))
+			goto out;
+	}
+
+	status = pollset_poll(&pollset, dwMilliseconds);
+	if (status > 0)
+	{
+		DWORD signaled = 0;
+		for (size_t x = 0; (x < set->count) && (signaled < nCount); x++)
+		{
+			if (pollset_isSignaled(&pollset, x))
+				lpHandles[signaled++] = set->handles[x];
+		}
+		status = (int)signaled;
+	}
+
+out:
+	pollset_uninit(&pollset);
+	return status;
+}
+#endif
+#endif
+
+/**
+ * Methods
+ */
+
+BOOL winpr_WaitSet_Add(wWaitSet* set, HANDLE handle)
+{
+	WINPR_ASSERT(set);
+
+	if (waitset_find(set, handle) >= 0)
+		return TRUE;
+
+#ifdef _WIN32
+	if (set->count >= MAXIMUM_WAIT_OBJECTS)
+	{
+		WLog_ERR(TAG, "wait sets are limited to %d handles", MAXIMUM_WAIT_OBJECTS);
+		return FALSE;
+	}
+#endif
+
+	if (set->count == set->capacity)
+	{
+		const size_t capacity = (set->capacity > 0) ? set->capacity * 2 : 16;
+		HANDLE* handles = (HANDLE*)realloc((void*)set->handles, sizeof(HANDLE) * capacity);
+		if (!handles)
+			return FALSE;
+		set->handles = handles;
+		set->capacity = capacity;
+	}
+
+#ifndef _WIN32
+	if (!waitset_register(set, handle))
+		return FALSE;
+#endif
+
+	set->handles[set->count++] = handle;
+	return TRUE;
+}
+
+BOOL winpr_WaitSet_Remove(wWaitSet* set, HANDLE handle)
+{
+	WINPR_ASSERT(set);
+
+	const SSIZE_T index = waitset_find(set, handle);
+	if (index < 0)
+		return FALSE;
+
+#ifndef _WIN32
+	waitset_unregister(set, handle);
+#endif
+
+	/* keep the order, the fallbacks report signaled handles in the order they were added */
+	MoveMemory((void*)&set->handles[index], (void*)&set->handles[index + 1],
+	           (set->count - (size_t)index - 1) * sizeof(HANDLE));
+	set->count--;
+	return TRUE;
+}
+
+void winpr_WaitSet_Clear(wWaitSet* set)
+{
+	WINPR_ASSERT(set);
+
+	while (set->count > 0)
+	{
+		set->count--;
+#ifndef _WIN32
+		waitset_unregister(set, set->handles[set->count]);
+#endif
+	}
+}
+
+size_t winpr_WaitSet_Count(wWaitSet* set)
+{
+	WINPR_ASSERT(set);
+	return set->count;
+}
+
+DWORD winpr_WaitSet_Wait(wWaitSet* set, DWORD dwMilliseconds, HANDLE* lpHandles, DWORD nCount,
+                         DWORD* pnSignaled)
+{
+	DWORD signaled = 0;
+
+	WINPR_ASSERT(set);
+	WINPR_ASSERT(lpHandles);
+	WINPR_ASSERT(pnSignaled);
+
+	*pnSignaled = 0;
+	if ((set->count == 0) || (nCount == 0))
+	{
+		WLog_ERR(TAG, "nothing to wait for (%" PRIuz " handles, %" PRIu32 " results)",
+		         set->count, nCount);
+		return WAIT_FAILED;
+	}
+
+#ifdef _WIN32
+	const DWORD status =
+	    WaitForMultipleObjects((DWORD)set->count, set->handles, FALSE, dwMilliseconds);
+	if ((status == WAIT_TIMEOUT) || (status == WAIT_FAILED))
+		return status;
+	if (status >= WAIT_OBJECT_0 + set->count)
+		return WAIT_FAILED;
+
+	const size_t first = status - WAIT_OBJECT_0;
+	lpHandles[signaled++] = set->handles[first];
+	for (size_t x = first + 1; (x < set->count) && (signaled < nCount); x++)
+	{
+		if (WaitForSingleObject(set->handles[x], 0) == WAIT_OBJECT_0)
+			lpHandles[signaled++] = set->handles[x];
+	}
+#else
+	const int status = waitset_poll(set, dwMilliseconds, lpHandles, nCount);
+	if (status < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "waiting for %" PRIuz " handles failed [%d] %s", set->count, errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		SetLastError(ERROR_INTERNAL_ERROR);
+		return WAIT_FAILED;
+	}
+	if (status == 0)
+		return WAIT_TIMEOUT;
+
+	signaled = (DWORD)status;
+	for (DWORD x = 0; x < signaled; x++)
+	{
+		const DWORD rc = winpr_Handle_cleanup(lpHandles[x]);
+		if (rc != WAIT_OBJECT_0)
+		{
+			WLog_ERR(TAG, "error in cleanup function for handle %p", lpHandles[x]);
+			return rc;
+		}
+	}
+#endif
+
+	*pnSignaled = signaled;
+	return WAIT_OBJECT_0;
+}
+
+/**
+ * Construction, Destruction
+ */
+
+void winpr_WaitSet_Free(wWaitSet* set)
+{
+	if (!set)
+		return;
+
+	winpr_WaitSet_Clear(set);
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+	if (set->epfd >= 0)
+		close(set->epfd);
+	free(set->events);
+#endif
+	free((void*)set->handles);
+	free(set);
+}
+
+wWaitSet* winpr_WaitSet_New(void)
+{
+	wWaitSet* set = (wWaitSet*)calloc(1, sizeof(wWaitSet));
+	if (!set)
+		return NULL;
+
+#if defined(WINPR_HAVE_SYS_EPOLL_H)
+	set->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epfd < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "epoll_create1 failed [%d] %s", errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		winpr_WaitSet_Free(set);
+		return NULL;
+	}
+#endif
+	return set;
+}
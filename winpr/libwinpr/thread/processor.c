@@ -17,18 +17,48 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // NOLINT(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp)
+#endif
+
 #include <winpr/config.h>
 
+#include <stdio.h>
+
 #include <winpr/handle.h>
 
 #include <winpr/thread.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <winpr/debug.h>
+#include <winpr/string.h>
+#include <winpr/error.h>
+
+#include "thread.h"
+#include "../log.h"
+#define TAG WINPR_TAG("thread")
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+#endif
+
 /**
  * GetCurrentProcessorNumber
  * GetCurrentProcessorNumberEx
  * GetThreadIdealProcessorEx
  * SetThreadIdealProcessorEx
  * IsProcessorFeaturePresent
+ *
+ * winbase.h:
+ *
+ * GetNumaHighestNodeNumber
+ * GetNumaNodeProcessorMask
+ * SetThreadAffinityMask
  */
 
 #ifndef _WIN32
@@ -38,4 +68,153 @@ DWORD GetCurrentProcessorNumber(VOID)
 	return 0;
 }
 
+/* parses a sysfs list like "0-3,8-11", ids above 63 are ignored */
+static BOOL parse_id_list(const char* list, ULONGLONG* mask, ULONG* highest)
+{
+	const char* cur = list;
+	ULONGLONG bits = 0;
+	ULONG last = 0;
+
+	while (*cur && (*cur != '\n'))
+	{
+		char* end = NULL;
+		const unsigned long first = strtoul(cur, &end, 10);
+		if (end == cur)
+			return FALSE;
+
+		unsigned long second = first;
+		if (*end == '-')
+		{
+			cur = end + 1;
+			second = strtoul(cur, &end, 10);
+			if ((end == cur) || (second < first))
+				return FALSE;
+		}
+
+		for (unsigned long x = first; (x <= second) && (x < 64); x++)
+			bits |= 1ull << x;
+		if (second > last)
+			last = (ULONG)MIN(second, UINT32_MAX);
+
+		cur = end;
+		if (*cur == ',')
+			cur++;
+	}
+
+	if (mask)
+		*mask = bits;
+	if (highest)
+		*highest = last;
+	return TRUE;
+}
+
+static BOOL read_id_list(const char* path, ULONGLONG* mask, ULONG* highest)
+{
+	char line[1024] = { 0 };
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+		return FALSE;
+
+	const BOOL rc = (fgets(line, sizeof(line), fp) != NULL) && parse_id_list(line, mask, highest);
+	(void)fclose(fp);
+	return rc;
+}
+
+BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber)
+{
+	if (!HighestNodeNumber)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	/* systems without NUMA information have a single node */
+	if (!read_id_list("/sys/devices/system/node/possible", NULL, HighestNodeNumber))
+		*HighestNodeNumber = 0;
+	return TRUE;
+}
+
+BOOL GetNumaNodeProcessorMask(UCHAR Node, PULONGLONG ProcessorMask)
+{
+	char path[64] = { 0 };
+
+	if (!ProcessorMask)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	(void)_snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", Node);
+	if (read_id_list(path, ProcessorMask, NULL))
+		return TRUE;
+
+	if (Node == 0)
+	{
+		const long count = sysconf(_SC_NPROCESSORS_ONLN);
+		if (count > 0)
+		{
+			*ProcessorMask = (count >= 64) ? UINT64_MAX : ((1ull << count) - 1ull);
+			return TRUE;
+		}
+	}
+
+	SetLastError(ERROR_INVALID_PARAMETER);
+	return FALSE;
+}
+
+DWORD_PTR SetThreadAffinityMask(HANDLE hThread, DWORD_PTR dwThreadAffinityMask)
+{
+	ULONG Type = 0;
+	WINPR_HANDLE* Object = NULL;
+
+	if (!winpr_Handle_GetInfo(hThread, &Type, &Object) || (Object->Type != HANDLE_TYPE_THREAD) ||
+	    (dwThreadAffinityMask == 0))
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+
+#if defined(PTHREAD_SETAFFINITY_NP)
+	WINPR_THREAD* thread = (WINPR_THREAD*)Object;
+	cpu_set_t set = { 0 };
+	DWORD_PTR previous = 0;
+
+	/* the main thread object does not carry a pthread id */
+	const pthread_t tid =
+	    (thread == winpr_GetCurrentThread()) ? pthread_self() : thread->thread;
+
+	if (pthread_getaffinity_np(tid, sizeof(set), &set) == 0)
+	{
+		for (size_t x = 0; x < sizeof(DWORD_PTR) * 8; x++)
+		{
+			if (CPU_ISSET(x, &set))
+				previous |= ((DWORD_PTR)1) << x;
+		}
+	}
+
+	CPU_ZERO(&set);
+	for (size_t x = 0; x < sizeof(DWORD_PTR) * 8; x++)
+	{
+		if (dwThreadAffinityMask & (((DWORD_PTR)1) << x))
+			CPU_SET(x, &set);
+	}
+
+	const int rc = pthread_setaffinity_np(tid, sizeof(set), &set);
+	if (rc != 0)
+	{
+		char buffer[256] = { 0 };
+		WLog_WARN(TAG, "pthread_setaffinity_np failed with %s [%d]",
+		          winpr_strerror(rc, buffer, sizeof(buffer)), rc);
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+
+	/* an unknown previous mask is reported as all processors */
+	return (previous != 0) ? previous : (DWORD_PTR)-1;
+#else
+	SetLastError(ERROR_CALL_NOT_IMPLEMENTED);
+	return 0;
+#endif
+}
+
 #endif
@@ -0,0 +1,40 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/error.h>
+#include <winpr/thread.h>
+
+int TestThreadAffinity(int argc, char* argv[])
+{
+	ULONG highest = 0;
+	ULONGLONG mask = 0;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!GetNumaHighestNodeNumber(&highest) || GetNumaHighestNodeNumber(NULL))
+		return -1;
+
+	/* every system has a node 0 with at least one processor */
+	if (!GetNumaNodeProcessorMask(0, &mask) || (mask == 0))
+	{
+		printf("no processors on NUMA node 0\n");
+		return -1;
+	}
+
+	if (SetThreadAffinityMask(NULL, (DWORD_PTR)mask) != 0)
+		return -1;
+
+	const DWORD_PTR previous = SetThreadAffinityMask(_GetCurrentThread(), (DWORD_PTR)mask);
+	if (previous == 0)
+	{
+		if (GetLastError() == ERROR_CALL_NOT_IMPLEMENTED)
+			return 0;
+		printf("SetThreadAffinityMask failed\n");
+		return -1;
+	}
+
+	if (SetThreadAffinityMask(_GetCurrentThread(), previous) != (DWORD_PTR)mask)
+		return -1;
+	return 0;
+}
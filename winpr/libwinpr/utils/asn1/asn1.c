@@ -170,6 +170,7 @@ void WinPrAsn1Encoder_Reset(WinPrAsn1Encoder* enc)
 
 	enc->freeContainerIndex = 0;
 	enc->freeChunkId = 0;
+	Stream_SetPosition(enc->pool, 0);
 
 	ZeroMemory(enc->chunks, sizeof(*enc->chunks) * enc->chunksCapacity);
 }
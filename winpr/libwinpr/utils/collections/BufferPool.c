@@ -20,17 +20,45 @@
 #include <winpr/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/intrin.h>
 
 #include <winpr/collections.h>
 
-#define MAX(a, b) ((a) > (b)) ? (a) : (b)
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/* available variable size buffers are binned by the floor of log2 of their capacity */
+#define BUFFERPOOL_CLASSES (sizeof(size_t) * 8)
+
+/* variable size buffers up to this size get a power of two capacity */
+#define BUFFERPOOL_ROUND_MAX (1024ull * 1024ull)
+
+/* fixed size buffers are allocated in slabs, each one twice as large as the last */
+#define BUFFERPOOL_SLAB_MIN 4
+#define BUFFERPOOL_SLAB_MAX 64
 
 typedef struct
 {
-	SSIZE_T size;
+	size_t size;
+	size_t capacity;
 	void* buffer;
 } wBufferPoolItem;
 
+typedef struct
+{
+	size_t size;
+	size_t capacity;
+	wBufferPoolItem* items;
+} wBufferPoolArray;
+
+typedef struct s_wBufferPoolSlab
+{
+	struct s_wBufferPoolSlab* next;
+	void* memory;
+	size_t bytes;
+} wBufferPoolSlab;
+
 struct s_wBufferPool
 {
 	SSIZE_T fixedSize;
@@ -38,17 +66,20 @@ struct s_wBufferPool
 	BOOL synchronized;
 	CRITICAL_SECTION lock;
 
-	SSIZE_T size;
-	SSIZE_T capacity;
-	void** array;
+	/* fixed size buffers: free buffers hold the pointer to the next one */
+	size_t stride;
+	size_t slabCount;
+	wBufferPoolSlab* slabs;
+	void* freeList;
+	size_t size;
+	size_t uCount;
 
-	SSIZE_T aSize;
-	SSIZE_T aCapacity;
-	wBufferPoolItem* aArray;
+	/* variable size buffers */
+	wBufferPoolArray available[BUFFERPOOL_CLASSES];
+	wBufferPoolArray used;
 
-	SSIZE_T uSize;
-	SSIZE_T uCapacity;
-	wBufferPoolItem* uArray;
+	wMemoryTag* tag;
+	size_t accounted;
 };
 
 static BOOL BufferPool_Lock(wBufferPool* pool)
@@ -80,90 +111,134 @@ static BOOL BufferPool_Unlock(wBufferPool* pool)
  * Methods
  */
 
-static BOOL BufferPool_ShiftAvailable(wBufferPool* pool, size_t index, int count)
+static void* BufferPool_Alloc(wBufferPool* pool, size_t size)
 {
-	if (count > 0)
-	{
-		if (pool->aSize + count > pool->aCapacity)
-		{
-			wBufferPoolItem* newArray = NULL;
-			SSIZE_T newCapacity = pool->aSize + count;
-			newCapacity += (newCapacity + 2) / 2;
-
-			WINPR_ASSERT(newCapacity > 0);
-			if (pool->alignment > 0)
-				newArray = (wBufferPoolItem*)winpr_aligned_realloc(
-				    pool->aArray,
-				    sizeof(wBufferPoolItem) * WINPR_ASSERTING_INT_CAST(size_t, newCapacity),
-				    pool->alignment);
-			else
-				newArray = (wBufferPoolItem*)realloc(
-				    pool->aArray,
-				    sizeof(wBufferPoolItem) * WINPR_ASSERTING_INT_CAST(size_t, newCapacity));
-			if (!newArray)
-				return FALSE;
-			pool->aArray = newArray;
-			pool->aCapacity = newCapacity;
-		}
+	void* buffer = NULL;
+	if (pool->alignment)
+		buffer = winpr_aligned_malloc(size, pool->alignment);
+	else
+		buffer = malloc(size);
 
-		MoveMemory(
-		    &pool->aArray[index + WINPR_ASSERTING_INT_CAST(size_t, count)], &pool->aArray[index],
-		    (WINPR_ASSERTING_INT_CAST(size_t, pool->aSize) - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
+	if (buffer)
+	{
+		MemoryTag_Allocated(pool->tag, size);
+		pool->accounted += size;
 	}
-	else if (count < 0)
+	return buffer;
+}
+
+static void BufferPool_Dealloc(wBufferPool* pool, void* buffer, size_t size)
+{
+	if (pool->alignment)
+		winpr_aligned_free(buffer);
+	else
+		free(buffer);
+
+	MemoryTag_Released(pool->tag, size);
+	pool->accounted -= size;
+}
+
+static size_t BufferPool_Class(size_t capacity)
+{
+	if (capacity < 2)
+		return 0;
+
+#if SIZE_MAX > UINT32_MAX
+	const UINT32 high = (UINT32)(capacity >> 32);
+	if (high != 0)
+		return 63 - __lzcnt(high);
+#endif
+	return 31 - __lzcnt((UINT32)capacity);
+}
+
+static BOOL BufferPool_Append(wBufferPoolArray* array, void* buffer, size_t size, size_t capacity)
+{
+	WINPR_ASSERT(array);
+
+	if (array->size == array->capacity)
 	{
-		MoveMemory(
-		    &pool->aArray[index], &pool->aArray[index + WINPR_ASSERTING_INT_CAST(size_t, -count)],
-		    (WINPR_ASSERTING_INT_CAST(size_t, pool->aSize) - index) * sizeof(wBufferPoolItem));
-		pool->aSize += count;
+		const size_t newCapacity = (array->capacity > 0) ? array->capacity * 2 : 32;
+		wBufferPoolItem* newArray =
+		    (wBufferPoolItem*)realloc(array->items, sizeof(wBufferPoolItem) * newCapacity);
+		if (!newArray)
+			return FALSE;
+		array->items = newArray;
+		array->capacity = newCapacity;
 	}
+
+	wBufferPoolItem* item = &array->items[array->size++];
+	item->buffer = buffer;
+	item->size = size;
+	item->capacity = capacity;
 	return TRUE;
 }
 
-static BOOL BufferPool_ShiftUsed(wBufferPool* pool, SSIZE_T index, SSIZE_T count)
+/* buffers are usually returned shortly after they were taken, search from the end */
+static wBufferPoolItem* BufferPool_FindUsed(wBufferPool* pool, const void* buffer)
 {
-	if (count > 0)
+	for (size_t index = pool->used.size; index > 0; index--)
 	{
-		if (pool->uSize + count > pool->uCapacity)
-		{
-			SSIZE_T newUCapacity = pool->uCapacity * 2;
-			wBufferPoolItem* newUArray = NULL;
-			if (pool->alignment > 0)
-				newUArray = (wBufferPoolItem*)winpr_aligned_realloc(
-				    pool->uArray,
-				    sizeof(wBufferPoolItem) * WINPR_ASSERTING_INT_CAST(size_t, newUCapacity),
-				    pool->alignment);
-			else
-				newUArray = (wBufferPoolItem*)realloc(
-				    pool->uArray,
-				    sizeof(wBufferPoolItem) * WINPR_ASSERTING_INT_CAST(size_t, newUCapacity));
-			if (!newUArray)
-				return FALSE;
-			pool->uCapacity = newUCapacity;
-			pool->uArray = newUArray;
-		}
+		wBufferPoolItem* item = &pool->used.items[index - 1];
+		if (item->buffer == buffer)
+			return item;
+	}
+	return NULL;
+}
 
-		MoveMemory(&pool->uArray[index + count], &pool->uArray[index],
-		           WINPR_ASSERTING_INT_CAST(size_t, pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
+static BOOL BufferPool_AddSlab(wBufferPool* pool)
+{
+	wBufferPoolSlab* slab = (wBufferPoolSlab*)calloc(1, sizeof(wBufferPoolSlab));
+	if (!slab)
+		return FALSE;
+
+	const size_t count = pool->slabCount;
+	slab->bytes = pool->stride * count;
+	slab->memory = BufferPool_Alloc(pool, slab->bytes);
+	if (!slab->memory)
+	{
+		free(slab);
+		return FALSE;
 	}
-	else if (count < 0)
+
+	BYTE* memory = (BYTE*)slab->memory;
+	for (size_t x = count; x > 0; x--)
 	{
-		MoveMemory(&pool->uArray[index], &pool->uArray[index - count],
-		           WINPR_ASSERTING_INT_CAST(size_t, pool->uSize - index) * sizeof(wBufferPoolItem));
-		pool->uSize += count;
+		void* buffer = &memory[(x - 1) * pool->stride];
+		memcpy(buffer, (void*)&pool->freeList, sizeof(void*));
+		pool->freeList = buffer;
 	}
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->size += count;
+	if (pool->slabCount < BUFFERPOOL_SLAB_MAX)
+		pool->slabCount *= 2;
 	return TRUE;
 }
 
+static void BufferPool_FreeSlabs(wBufferPool* pool)
+{
+	while (pool->slabs)
+	{
+		wBufferPoolSlab* slab = pool->slabs;
+		pool->slabs = slab->next;
+		BufferPool_Dealloc(pool, slab->memory, slab->bytes);
+		free(slab);
+	}
+
+	pool->freeList = NULL;
+	pool->size = 0;
+	pool->uCount = 0;
+	pool->slabCount = BUFFERPOOL_SLAB_MIN;
+}
+
 /**
  * Get the buffer pool size
  */
 
 SSIZE_T BufferPool_GetPoolSize(wBufferPool* pool)
 {
-	SSIZE_T size = 0;
+	size_t size = 0;
 
 	BufferPool_Lock(pool);
 
@@ -175,12 +250,12 @@ SSIZE_T BufferPool_GetPoolSize(wBufferPool* pool)
 	else
 	{
 		/* variable size buffers */
-		size = pool->uSize;
+		size = pool->used.size;
 	}
 
 	BufferPool_Unlock(pool);
 
-	return size;
+	return WINPR_ASSERTING_INT_CAST(SSIZE_T, size);
 }
 
 /**
@@ -189,8 +264,7 @@ SSIZE_T BufferPool_GetPoolSize(wBufferPool* pool)
 
 SSIZE_T BufferPool_GetBufferSize(wBufferPool* pool, const void* buffer)
 {
-	SSIZE_T size = 0;
-	BOOL found = FALSE;
+	SSIZE_T size = -1;
 
 	BufferPool_Lock(pool);
 
@@ -198,26 +272,18 @@ SSIZE_T BufferPool_GetBufferSize(wBufferPool* pool, const void* buffer)
 	{
 		/* fixed size buffers */
 		size = pool->fixedSize;
-		found = TRUE;
 	}
 	else
 	{
 		/* variable size buffers */
-
-		for (SSIZE_T index = 0; index < pool->uSize; index++)
-		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				size = pool->uArray[index].size;
-				found = TRUE;
-				break;
-			}
-		}
+		const wBufferPoolItem* item = BufferPool_FindUsed(pool, buffer);
+		if (item)
+			size = WINPR_ASSERTING_INT_CAST(SSIZE_T, item->size);
 	}
 
 	BufferPool_Unlock(pool);
 
-	return (found) ? size : -1;
+	return size;
 }
 
 /**
@@ -226,10 +292,6 @@ SSIZE_T BufferPool_GetBufferSize(wBufferPool* pool, const void* buffer)
 
 void* BufferPool_Take(wBufferPool* pool, SSIZE_T size)
 {
-	SSIZE_T maxSize = 0;
-	SSIZE_T maxIndex = 0;
-	SSIZE_T foundIndex = -1;
-	BOOL found = FALSE;
 	void* buffer = NULL;
 
 	BufferPool_Lock(pool);
@@ -238,127 +300,64 @@ void* BufferPool_Take(wBufferPool* pool, SSIZE_T size)
 	{
 		/* fixed size buffers */
 
-		if (pool->size > 0)
-			buffer = pool->array[--(pool->size)];
-
-		if (!buffer)
-		{
-			if (pool->alignment)
-				buffer = winpr_aligned_malloc(WINPR_ASSERTING_INT_CAST(size_t, pool->fixedSize),
-				                              pool->alignment);
-			else
-				buffer = malloc(WINPR_ASSERTING_INT_CAST(size_t, pool->fixedSize));
-		}
-
-		if (!buffer)
+		if (!pool->freeList && !BufferPool_AddSlab(pool))
 			goto out_error;
+
+		buffer = pool->freeList;
+		memcpy((void*)&pool->freeList, buffer, sizeof(void*));
+		pool->size--;
+		pool->uCount++;
 	}
 	else
 	{
 		/* variable size buffers */
 
-		maxSize = 0;
-		maxIndex = 0;
-
 		if (size < 1)
-			size = pool->fixedSize;
-
-		for (SSIZE_T index = 0; index < pool->aSize; index++)
-		{
-			if (pool->aArray[index].size > maxSize)
-			{
-				maxIndex = index;
-				maxSize = pool->aArray[index].size;
-			}
+			goto out_error;
 
-			if (pool->aArray[index].size >= size)
-			{
-				foundIndex = index;
-				found = TRUE;
-				break;
-			}
-		}
+		const size_t requested = WINPR_ASSERTING_INT_CAST(size_t, size);
+		size_t capacity = 0;
 
-		if (!found && maxSize)
+		/* the newest buffer of the first class that fits */
+		for (size_t c = BufferPool_Class(requested); c < BUFFERPOOL_CLASSES; c++)
 		{
-			foundIndex = maxIndex;
-			found = TRUE;
+			wBufferPoolArray* bin = &pool->available[c];
+			if (bin->size == 0)
+				continue;
+
+			/* only the class of the requested size can hold buffers that are too small */
+			const wBufferPoolItem* item = &bin->items[bin->size - 1];
+			if (item->capacity < requested)
+				continue;
+
+			buffer = item->buffer;
+			capacity = item->capacity;
+			bin->size--;
+			break;
 		}
 
-		if (!found)
-		{
-			if (!size)
-				buffer = NULL;
-			else
-			{
-				if (pool->alignment)
-					buffer = winpr_aligned_malloc(WINPR_ASSERTING_INT_CAST(size_t, size),
-					                              pool->alignment);
-				else
-					buffer = malloc(WINPR_ASSERTING_INT_CAST(size_t, size));
-
-				if (!buffer)
-					goto out_error;
-			}
-		}
-		else
+		if (!buffer)
 		{
-			buffer = pool->aArray[foundIndex].buffer;
-
-			if (maxSize < size)
-			{
-				void* newBuffer = NULL;
-				if (pool->alignment)
-					newBuffer = winpr_aligned_realloc(
-					    buffer, WINPR_ASSERTING_INT_CAST(size_t, size), pool->alignment);
-				else
-					newBuffer = realloc(buffer, WINPR_ASSERTING_INT_CAST(size_t, size));
-
-				if (!newBuffer)
-					goto out_error_no_free;
+			capacity = requested;
+			if ((capacity > 1) && (capacity <= BUFFERPOOL_ROUND_MAX))
+				capacity = (size_t)1 << (BufferPool_Class(capacity - 1) + 1);
 
-				buffer = newBuffer;
-			}
-
-			if (!BufferPool_ShiftAvailable(pool, WINPR_ASSERTING_INT_CAST(size_t, foundIndex), -1))
+			buffer = BufferPool_Alloc(pool, capacity);
+			if (!buffer)
 				goto out_error;
 		}
 
-		if (!buffer)
-			goto out_error;
-
-		if (pool->uSize + 1 > pool->uCapacity)
+		if (!BufferPool_Append(&pool->used, buffer, requested, capacity))
 		{
-			size_t newUCapacity = WINPR_ASSERTING_INT_CAST(size_t, pool->uCapacity);
-			newUCapacity += (newUCapacity + 2) / 2;
-			if (newUCapacity > SSIZE_MAX)
-				goto out_error;
-			wBufferPoolItem* newUArray =
-			    (wBufferPoolItem*)realloc(pool->uArray, sizeof(wBufferPoolItem) * newUCapacity);
-			if (!newUArray)
-				goto out_error;
-
-			pool->uCapacity = (SSIZE_T)newUCapacity;
-			pool->uArray = newUArray;
+			BufferPool_Dealloc(pool, buffer, capacity);
+			buffer = NULL;
+			goto out_error;
 		}
-
-		pool->uArray[pool->uSize].buffer = buffer;
-		pool->uArray[pool->uSize].size = size;
-		(pool->uSize)++;
 	}
 
-	BufferPool_Unlock(pool);
-
-	return buffer;
-
 out_error:
-	if (pool->alignment)
-		winpr_aligned_free(buffer);
-	else
-		free(buffer);
-out_error_no_free:
 	BufferPool_Unlock(pool);
-	return NULL;
+	return buffer;
 }
 
 /**
@@ -368,8 +367,6 @@ out_error_no_free:
 BOOL BufferPool_Return(wBufferPool* pool, void* buffer)
 {
 	BOOL rc = FALSE;
-	SSIZE_T size = 0;
-	BOOL found = FALSE;
 
 	BufferPool_Lock(pool);
 
@@ -377,59 +374,31 @@ BOOL BufferPool_Return(wBufferPool* pool, void* buffer)
 	{
 		/* fixed size buffers */
 
-		if ((pool->size + 1) >= pool->capacity)
-		{
-			SSIZE_T newCapacity = MAX(2, pool->size + (pool->size + 2) / 2 + 1);
-			void** newArray = (void**)realloc(
-			    (void*)pool->array, sizeof(void*) * WINPR_ASSERTING_INT_CAST(size_t, newCapacity));
-			if (!newArray)
-				goto out_error;
-
-			pool->capacity = newCapacity;
-			pool->array = newArray;
-		}
+		if (!buffer)
+			goto out_error;
 
-		pool->array[(pool->size)++] = buffer;
+		memcpy(buffer, (void*)&pool->freeList, sizeof(void*));
+		pool->freeList = buffer;
+		pool->size++;
+		if (pool->uCount > 0)
+			pool->uCount--;
 	}
 	else
 	{
 		/* variable size buffers */
 
-		SSIZE_T index = 0;
-		for (; index < pool->uSize; index++)
-		{
-			if (pool->uArray[index].buffer == buffer)
-			{
-				found = TRUE;
-				break;
-			}
-		}
-
-		if (found)
+		wBufferPoolItem* item = BufferPool_FindUsed(pool, buffer);
+		if (item)
 		{
-			size = pool->uArray[index].size;
-			if (!BufferPool_ShiftUsed(pool, index, -1))
-				goto out_error;
-		}
+			const wBufferPoolItem cur = *item;
+			*item = pool->used.items[--pool->used.size];
 
-		if (size)
-		{
-			if ((pool->aSize + 1) >= pool->aCapacity)
+			wBufferPoolArray* bin = &pool->available[BufferPool_Class(cur.capacity)];
+			if (!BufferPool_Append(bin, cur.buffer, cur.capacity, cur.capacity))
 			{
-				SSIZE_T newCapacity = MAX(2, pool->aSize + (pool->aSize + 2) / 2 + 1);
-				wBufferPoolItem* newArray = (wBufferPoolItem*)realloc(
-				    pool->aArray,
-				    sizeof(wBufferPoolItem) * WINPR_ASSERTING_INT_CAST(size_t, newCapacity));
-				if (!newArray)
-					goto out_error;
-
-				pool->aCapacity = newCapacity;
-				pool->aArray = newArray;
+				BufferPool_Dealloc(pool, cur.buffer, cur.capacity);
+				goto out_error;
 			}
-
-			pool->aArray[pool->aSize].buffer = buffer;
-			pool->aArray[pool->aSize].size = size;
-			(pool->aSize)++;
 		}
 	}
 
@@ -449,40 +418,29 @@ void BufferPool_Clear(wBufferPool* pool)
 
 	if (pool->fixedSize)
 	{
-		/* fixed size buffers */
-
-		while (pool->size > 0)
-		{
-			(pool->size)--;
+		/* fixed size buffers, a slab can only go once none of its buffers is in use */
 
-			if (pool->alignment)
-				winpr_aligned_free(pool->array[pool->size]);
-			else
-				free(pool->array[pool->size]);
-		}
+		if (pool->uCount == 0)
+			BufferPool_FreeSlabs(pool);
 	}
 	else
 	{
 		/* variable size buffers */
 
-		while (pool->aSize > 0)
+		for (size_t c = 0; c < BUFFERPOOL_CLASSES; c++)
 		{
-			(pool->aSize)--;
-
-			if (pool->alignment)
-				winpr_aligned_free(pool->aArray[pool->aSize].buffer);
-			else
-				free(pool->aArray[pool->aSize].buffer);
+			wBufferPoolArray* bin = &pool->available[c];
+			while (bin->size > 0)
+			{
+				const wBufferPoolItem* item = &bin->items[--bin->size];
+				BufferPool_Dealloc(pool, item->buffer, item->capacity);
+			}
 		}
 
-		while (pool->uSize > 0)
+		while (pool->used.size > 0)
 		{
-			(pool->uSize)--;
-
-			if (pool->alignment)
-				winpr_aligned_free(pool->uArray[pool->uSize].buffer);
-			else
-				free(pool->uArray[pool->uSize].buffer);
+			const wBufferPoolItem* item = &pool->used.items[--pool->used.size];
+			BufferPool_Dealloc(pool, item->buffer, item->capacity);
 		}
 	}
 
@@ -508,49 +466,23 @@ wBufferPool* BufferPool_New(BOOL synchronized, SSIZE_T fixedSize, DWORD alignmen
 
 		pool->alignment = alignment;
 		pool->synchronized = synchronized;
+		pool->tag = MemoryTag_Get("bufferpool");
 
 		if (pool->synchronized)
 			InitializeCriticalSectionAndSpinCount(&pool->lock, 4000);
 
 		if (pool->fixedSize)
 		{
-			/* fixed size buffers */
-
-			pool->size = 0;
-			pool->capacity = 32;
-			pool->array =
-			    (void**)calloc(WINPR_ASSERTING_INT_CAST(size_t, pool->capacity), sizeof(void*));
-			if (!pool->array)
-				goto out_error;
-		}
-		else
-		{
-			/* variable size buffers */
-
-			pool->aSize = 0;
-			pool->aCapacity = 32;
-			pool->aArray = (wBufferPoolItem*)calloc(
-			    WINPR_ASSERTING_INT_CAST(size_t, pool->aCapacity), sizeof(wBufferPoolItem));
-			if (!pool->aArray)
-				goto out_error;
+			/* fixed size buffers, every one must hold a pointer and keep the alignment */
 
-			pool->uSize = 0;
-			pool->uCapacity = 32;
-			pool->uArray = (wBufferPoolItem*)calloc(
-			    WINPR_ASSERTING_INT_CAST(size_t, pool->uCapacity), sizeof(wBufferPoolItem));
-			if (!pool->uArray)
-				goto out_error;
+			const size_t align = MAX(pool->alignment, sizeof(void*));
+			const size_t size = MAX((size_t)pool->fixedSize, sizeof(void*));
+			pool->stride = (size + align - 1) / align * align;
+			pool->slabCount = BUFFERPOOL_SLAB_MIN;
 		}
 	}
 
 	return pool;
-
-out_error:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	BufferPool_Free(pool);
-	WINPR_PRAGMA_DIAG_POP
-	return NULL;
 }
 
 void BufferPool_Free(wBufferPool* pool)
@@ -566,16 +498,28 @@ void BufferPool_Free(wBufferPool* pool)
 		{
 			/* fixed size buffers */
 
-			free((void*)pool->array);
+			BufferPool_FreeSlabs(pool);
 		}
 		else
 		{
 			/* variable size buffers */
 
-			free(pool->aArray);
-			free(pool->uArray);
+			for (size_t c = 0; c < BUFFERPOOL_CLASSES; c++)
+				free(pool->available[c].items);
+			free(pool->used.items);
 		}
 
 		free(pool);
 	}
 }
+
+void BufferPool_SetMemoryTag(wBufferPool* pool, wMemoryTag* tag)
+{
+	WINPR_ASSERT(pool);
+
+	BufferPool_Lock(pool);
+	MemoryTag_Released(pool->tag, pool->accounted);
+	pool->tag = tag;
+	MemoryTag_Allocated(pool->tag, pool->accounted);
+	BufferPool_Unlock(pool);
+}
@@ -25,35 +25,40 @@
 #include <winpr/collections.h>
 
 /**
- * This implementation is based on the public domain
- * hash table implementation made by Keith Pomakis:
- *
- * http://www.pomakis.com/hashtable/hashtable.c
- * http://www.pomakis.com/hashtable/hashtable.h
+ * Open addressing with linear probing. The slots live in one power of two sized array and
+ * keep the hash of their key, so a lookup walks adjacent memory and only calls the compare
+ * function when the hashes match. Removals shift the following entries back instead of
+ * leaving tombstones. While a HashTable_Foreach is running entries are only marked for
+ * removal and the table does not grow, so no entry moves under the iteration.
  */
 
-typedef struct s_wKeyValuePair wKeyValuePair;
+#define HASH_TABLE_MIN_CAPACITY 64
+
+typedef enum
+{
+	HASH_TABLE_SLOT_EMPTY = 0,
+	HASH_TABLE_SLOT_USED,
+	HASH_TABLE_SLOT_REMOVED
+} wHashTableSlotState;
 
-struct s_wKeyValuePair
+typedef struct
 {
 	void* key;
 	void* value;
-
-	wKeyValuePair* next;
-	BOOL markedForRemove;
-};
+	UINT32 hash;
+	UINT32 state;
+} wHashTableSlot;
 
 struct s_wHashTable
 {
 	BOOL synchronized;
 	CRITICAL_SECTION lock;
 
-	size_t numOfBuckets;
+	size_t capacity;
+	UINT32 shift;
+	size_t numOfSlots;
 	size_t numOfElements;
-	float idealRatio;
-	float lowerRehashThreshold;
-	float upperRehashThreshold;
-	wKeyValuePair** bucketArray;
+	wHashTableSlot* slots;
 
 	HASH_TABLE_HASH_FN hash;
 	wObject key;
@@ -104,105 +109,138 @@ void HashTable_StringFree(void* str)
 	winpr_ObjectStringFree(str);
 }
 
-static INLINE BOOL HashTable_IsProbablePrime(size_t oddNumber)
+/* fibonacci hashing spreads the weak pointer and string hashes over the whole table */
+static INLINE size_t HashTable_Home(const wHashTable* table, UINT32 hash)
 {
-	for (size_t i = 3; i < 51; i += 2)
-	{
-		if (oddNumber == i)
-			return TRUE;
-		else if (oddNumber % i == 0)
-			return FALSE;
-	}
-
-	return TRUE; /* maybe */
+	WINPR_ASSERT(table);
+	return (size_t)((hash * 2654435769u) >> table->shift);
 }
 
-static INLINE size_t HashTable_CalculateIdealNumOfBuckets(wHashTable* table)
+static INLINE size_t HashTable_Next(const wHashTable* table, size_t index)
 {
 	WINPR_ASSERT(table);
+	return (index + 1) & (table->capacity - 1);
+}
 
-	const float numOfElements = (float)table->numOfElements;
-	const float tmp = (numOfElements / table->idealRatio);
-	size_t idealNumOfBuckets = (size_t)tmp;
+static BOOL HashTable_Allocate(wHashTable* table, size_t capacity)
+{
+	WINPR_ASSERT(table);
+	WINPR_ASSERT((capacity & (capacity - 1)) == 0);
 
-	if (idealNumOfBuckets < 5)
-		idealNumOfBuckets = 5;
-	else
-		idealNumOfBuckets |= 0x01;
+	UINT32 bits = 0;
+	while (((size_t)1 << bits) < capacity)
+		bits++;
+	if (bits > 32)
+		return FALSE;
 
-	while (!HashTable_IsProbablePrime(idealNumOfBuckets))
-		idealNumOfBuckets += 2;
+	wHashTableSlot* slots = (wHashTableSlot*)calloc(capacity, sizeof(wHashTableSlot));
+	if (!slots)
+		return FALSE;
 
-	return idealNumOfBuckets;
+	table->slots = slots;
+	table->capacity = capacity;
+	table->shift = 32 - bits;
+	table->numOfSlots = 0;
+	return TRUE;
 }
 
-static INLINE void HashTable_Rehash(wHashTable* table, size_t numOfBuckets)
+static size_t HashTable_FindEmpty(const wHashTable* table, UINT32 hash)
 {
-	UINT32 hashValue = 0;
-	wKeyValuePair* nextPair = NULL;
-	wKeyValuePair** newBucketArray = NULL;
+	size_t index = HashTable_Home(table, hash);
+
+	while (table->slots[index].state != HASH_TABLE_SLOT_EMPTY)
+		index = HashTable_Next(table, index);
+	return index;
+}
 
+static INLINE BOOL HashTable_Resize(wHashTable* table, size_t capacity)
+{
 	WINPR_ASSERT(table);
-	if (numOfBuckets == 0)
-		numOfBuckets = HashTable_CalculateIdealNumOfBuckets(table);
+	WINPR_ASSERT(table->pendingRemoves == 0);
 
-	if (numOfBuckets == table->numOfBuckets)
-		return; /* already the right size! */
+	wHashTableSlot* old = table->slots;
+	const size_t oldCapacity = table->capacity;
 
-	newBucketArray = (wKeyValuePair**)calloc(numOfBuckets, sizeof(wKeyValuePair*));
+	if (!HashTable_Allocate(table, capacity))
+		return FALSE;
 
-	if (!newBucketArray)
+	for (size_t index = 0; index < oldCapacity; index++)
 	{
-		/*
-		 * Couldn't allocate memory for the new array.
-		 * This isn't a fatal error; we just can't perform the rehash.
-		 */
-		return;
+		const wHashTableSlot* slot = &old[index];
+		if (slot->state == HASH_TABLE_SLOT_EMPTY)
+			continue;
+
+		table->slots[HashTable_FindEmpty(table, slot->hash)] = *slot;
+		table->numOfSlots++;
 	}
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	free(old);
+	return TRUE;
+}
+
+/* empties a slot and moves the entries of the probe sequence behind it into the gap */
+static void HashTable_Erase(wHashTable* table, size_t index)
+{
+	WINPR_ASSERT(table);
+
+	size_t next = index;
+
+	for (;;)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		next = HashTable_Next(table, next);
+		const wHashTableSlot* slot = &table->slots[next];
+		if (slot->state == HASH_TABLE_SLOT_EMPTY)
+			break;
 
-		while (pair)
-		{
-			nextPair = pair->next;
-			hashValue = table->hash(pair->key) % numOfBuckets;
-			pair->next = newBucketArray[hashValue];
-			newBucketArray[hashValue] = pair;
-			pair = nextPair;
-		}
+		/* entries that can not be found from the gap stay where they are */
+		const size_t home = HashTable_Home(table, slot->hash);
+		if ((index <= next) ? ((index < home) && (home <= next))
+		                    : ((index < home) || (home <= next)))
+			continue;
+
+		table->slots[index] = *slot;
+		index = next;
 	}
 
-	free((void*)table->bucketArray);
-	table->bucketArray = newBucketArray;
-	table->numOfBuckets = numOfBuckets;
+	const wHashTableSlot empty = { 0 };
+	table->slots[index] = empty;
+	table->numOfSlots--;
 }
 
-static INLINE BOOL HashTable_Equals(wHashTable* table, const wKeyValuePair* pair, const void* key)
+static INLINE BOOL HashTable_Equals(wHashTable* table, const wHashTableSlot* slot,
+                                    const void* key)
 {
 	WINPR_ASSERT(table);
-	WINPR_ASSERT(pair);
+	WINPR_ASSERT(slot);
 	WINPR_ASSERT(key);
-	return table->key.fnObjectEquals(key, pair->key);
+	return table->key.fnObjectEquals(key, slot->key);
 }
 
-static INLINE wKeyValuePair* HashTable_Get(wHashTable* table, const void* key)
+/* also returns entries marked for removal, callers check the state */
+static INLINE wHashTableSlot* HashTable_Find(wHashTable* table, const void* key, UINT32 hash)
 {
-	UINT32 hashValue = 0;
-	wKeyValuePair* pair = NULL;
+	WINPR_ASSERT(table);
+
+	size_t index = HashTable_Home(table, hash);
+
+	for (;;)
+	{
+		wHashTableSlot* slot = &table->slots[index];
+		if (slot->state == HASH_TABLE_SLOT_EMPTY)
+			return NULL;
+		if ((slot->hash == hash) && HashTable_Equals(table, slot, key))
+			return slot;
+		index = HashTable_Next(table, index);
+	}
+}
 
+static INLINE wHashTableSlot* HashTable_Get(wHashTable* table, const void* key)
+{
 	WINPR_ASSERT(table);
 	if (!key)
 		return NULL;
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
-
-	while (pair && !HashTable_Equals(table, pair, key))
-		pair = pair->next;
-
-	return pair;
+	return HashTable_Find(table, key, table->hash(key));
 }
 
 static INLINE void disposeKey(wHashTable* table, void* key)
@@ -219,17 +257,16 @@ static INLINE void disposeValue(wHashTable* table, void* value)
 		table->value.fnObjectFree(value);
 }
 
-static INLINE void disposePair(wHashTable* table, wKeyValuePair* pair)
+static INLINE void disposeSlot(wHashTable* table, wHashTableSlot* slot)
 {
 	WINPR_ASSERT(table);
-	if (!pair)
+	if (!slot)
 		return;
-	disposeKey(table, pair->key);
-	disposeValue(table, pair->value);
-	free(pair);
+	disposeKey(table, slot->key);
+	disposeValue(table, slot->value);
 }
 
-static INLINE void setKey(wHashTable* table, wKeyValuePair* pair, const void* key)
+static INLINE void setKey(wHashTable* table, wHashTableSlot* pair, const void* key)
 {
 	WINPR_ASSERT(table);
 	if (!pair)
@@ -249,7 +286,7 @@ static INLINE void setKey(wHashTable* table, wKeyValuePair* pair, const void* ke
 	}
 }
 
-static INLINE void setValue(wHashTable* table, wKeyValuePair* pair, const void* value)
+static INLINE void setValue(wHashTable* table, wHashTableSlot* pair, const void* value)
 {
 	WINPR_ASSERT(table);
 	if (!pair)
@@ -307,9 +344,6 @@ int HashTable_Add(wHashTable* table, const void* key, const void* value)
 BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 {
 	BOOL rc = FALSE;
-	UINT32 hashValue = 0;
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* newPair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key || !value)
@@ -318,58 +352,56 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
+	const UINT32 hash = table->hash(key);
+	wHashTableSlot* slot = HashTable_Find(table, key, hash);
 
-	while (pair && !HashTable_Equals(table, pair, key))
-		pair = pair->next;
-
-	if (pair)
+	if (slot)
 	{
-		if (pair->markedForRemove)
+		if (slot->state == HASH_TABLE_SLOT_REMOVED)
 		{
 			/* this entry was set to be removed but will be recycled instead */
 			table->pendingRemoves--;
-			pair->markedForRemove = FALSE;
+			slot->state = HASH_TABLE_SLOT_USED;
 			table->numOfElements++;
 		}
 
-		if (pair->key != key)
+		if (slot->key != key)
 		{
-			setKey(table, pair, key);
+			setKey(table, slot, key);
 		}
 
-		if (pair->value != value)
+		if (slot->value != value)
 		{
-			setValue(table, pair, value);
+			setValue(table, slot, value);
 		}
 		rc = TRUE;
 	}
 	else
 	{
-		newPair = (wKeyValuePair*)calloc(1, sizeof(wKeyValuePair));
-
-		if (newPair)
+		/* keep the load below 3/4, a running foreach can only use up the spare slots */
+		if (table->foreachRecursionLevel)
 		{
-			setKey(table, newPair, key);
-			setValue(table, newPair, value);
-			newPair->next = table->bucketArray[hashValue];
-			newPair->markedForRemove = FALSE;
-			table->bucketArray[hashValue] = newPair;
-			table->numOfElements++;
-
-			if (!table->foreachRecursionLevel && table->upperRehashThreshold > table->idealRatio)
-			{
-				float elementToBucketRatio =
-				    (float)table->numOfElements / (float)table->numOfBuckets;
-
-				if (elementToBucketRatio > table->upperRehashThreshold)
-					HashTable_Rehash(table, 0);
-			}
-			rc = TRUE;
+			if (table->numOfSlots + 1 >= table->capacity)
+				goto out;
 		}
+		else if ((table->numOfSlots + 1) * 4 > table->capacity * 3)
+		{
+			if (!HashTable_Resize(table, table->capacity * 2) &&
+			    (table->numOfSlots + 1 >= table->capacity))
+				goto out;
+		}
+
+		slot = &table->slots[HashTable_FindEmpty(table, hash)];
+		setKey(table, slot, key);
+		setValue(table, slot, value);
+		slot->hash = hash;
+		slot->state = HASH_TABLE_SLOT_USED;
+		table->numOfSlots++;
+		table->numOfElements++;
+		rc = TRUE;
 	}
 
+out:
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 
@@ -382,10 +414,7 @@ BOOL HashTable_Insert(wHashTable* table, const void* key, const void* value)
 
 BOOL HashTable_Remove(wHashTable* table, const void* key)
 {
-	UINT32 hashValue = 0;
 	BOOL status = TRUE;
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* previousPair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key)
@@ -394,16 +423,9 @@ BOOL HashTable_Remove(wHashTable* table, const void* key)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	hashValue = table->hash(key) % table->numOfBuckets;
-	pair = table->bucketArray[hashValue];
+	wHashTableSlot* slot = HashTable_Get(table, key);
 
-	while (pair && !HashTable_Equals(table, pair, key))
-	{
-		previousPair = pair;
-		pair = pair->next;
-	}
-
-	if (!pair)
+	if (!slot || (slot->state == HASH_TABLE_SLOT_REMOVED))
 	{
 		status = FALSE;
 		goto out;
@@ -412,28 +434,16 @@ BOOL HashTable_Remove(wHashTable* table, const void* key)
 	if (table->foreachRecursionLevel)
 	{
 		/* if we are running a HashTable_Foreach, just mark the entry for removal */
-		pair->markedForRemove = TRUE;
+		slot->state = HASH_TABLE_SLOT_REMOVED;
 		table->pendingRemoves++;
 		table->numOfElements--;
 		goto out;
 	}
 
-	if (previousPair)
-		previousPair->next = pair->next;
-	else
-		table->bucketArray[hashValue] = pair->next;
-
-	disposePair(table, pair);
+	disposeSlot(table, slot);
+	HashTable_Erase(table, (size_t)(slot - table->slots));
 	table->numOfElements--;
 
-	if (!table->foreachRecursionLevel && table->lowerRehashThreshold > 0.0f)
-	{
-		float elementToBucketRatio = (float)table->numOfElements / (float)table->numOfBuckets;
-
-		if (elementToBucketRatio < table->lowerRehashThreshold)
-			HashTable_Rehash(table, 0);
-	}
-
 out:
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -448,7 +458,6 @@ out:
 void* HashTable_GetItemValue(wHashTable* table, const void* key)
 {
 	void* value = NULL;
-	wKeyValuePair* pair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key)
@@ -457,10 +466,10 @@ void* HashTable_GetItemValue(wHashTable* table, const void* key)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	pair = HashTable_Get(table, key);
+	const wHashTableSlot* slot = HashTable_Get(table, key);
 
-	if (pair && !pair->markedForRemove)
-		value = pair->value;
+	if (slot && (slot->state == HASH_TABLE_SLOT_USED))
+		value = slot->value;
 
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -475,7 +484,6 @@ void* HashTable_GetItemValue(wHashTable* table, const void* key)
 BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* value)
 {
 	BOOL status = TRUE;
-	wKeyValuePair* pair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key)
@@ -484,13 +492,13 @@ BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* valu
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	pair = HashTable_Get(table, key);
+	wHashTableSlot* slot = HashTable_Get(table, key);
 
-	if (!pair || pair->markedForRemove)
+	if (!slot || (slot->state != HASH_TABLE_SLOT_USED))
 		status = FALSE;
 	else
 	{
-		setValue(table, pair, value);
+		setValue(table, slot, value);
 	}
 
 	if (table->synchronized)
@@ -505,40 +513,48 @@ BOOL HashTable_SetItemValue(wHashTable* table, const void* key, const void* valu
 
 void HashTable_Clear(wHashTable* table)
 {
-	wKeyValuePair* nextPair = NULL;
-
 	WINPR_ASSERT(table);
 
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t index = 0; index < table->capacity; index++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		wHashTableSlot* slot = &table->slots[index];
 
-		while (pair)
-		{
-			nextPair = pair->next;
+		if (slot->state == HASH_TABLE_SLOT_EMPTY)
+			continue;
 
-			if (table->foreachRecursionLevel)
+		if (table->foreachRecursionLevel)
+		{
+			/* if we're in a foreach we just mark the entry for removal */
+			if (slot->state == HASH_TABLE_SLOT_USED)
 			{
-				/* if we're in a foreach we just mark the entry for removal */
-				pair->markedForRemove = TRUE;
+				slot->state = HASH_TABLE_SLOT_REMOVED;
 				table->pendingRemoves++;
 			}
-			else
-			{
-				disposePair(table, pair);
-				pair = nextPair;
-			}
+			continue;
 		}
 
-		table->bucketArray[index] = NULL;
+		disposeSlot(table, slot);
 	}
 
 	table->numOfElements = 0;
 	if (table->foreachRecursionLevel == 0)
-		HashTable_Rehash(table, 5);
+	{
+		wHashTableSlot* old = table->slots;
+		const size_t capacity = table->capacity;
+
+		table->pendingRemoves = 0;
+		if ((capacity > HASH_TABLE_MIN_CAPACITY) &&
+		    HashTable_Allocate(table, HASH_TABLE_MIN_CAPACITY))
+			free(old);
+		else
+		{
+			ZeroMemory(old, capacity * sizeof(wHashTableSlot));
+			table->numOfSlots = 0;
+		}
+	}
 
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -553,7 +569,6 @@ size_t HashTable_GetKeys(wHashTable* table, ULONG_PTR** ppKeys)
 	size_t iKey = 0;
 	size_t count = 0;
 	ULONG_PTR* pKeys = NULL;
-	wKeyValuePair* nextPair = NULL;
 
 	WINPR_ASSERT(table);
 
@@ -583,17 +598,11 @@ size_t HashTable_GetKeys(wHashTable* table, ULONG_PTR** ppKeys)
 		return 0;
 	}
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t index = 0; index < table->capacity; index++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
-
-		while (pair)
-		{
-			nextPair = pair->next;
-			if (!pair->markedForRemove)
-				pKeys[iKey++] = (ULONG_PTR)pair->key;
-			pair = nextPair;
-		}
+		const wHashTableSlot* slot = &table->slots[index];
+		if (slot->state == HASH_TABLE_SLOT_USED)
+			pKeys[iKey++] = (ULONG_PTR)slot->key;
 	}
 
 	if (table->synchronized)
@@ -617,47 +626,33 @@ BOOL HashTable_Foreach(wHashTable* table, HASH_TABLE_FOREACH_FN fn, VOID* arg)
 		EnterCriticalSection(&table->lock);
 
 	table->foreachRecursionLevel++;
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t index = 0; index < table->capacity; index++)
 	{
-		for (wKeyValuePair* pair = table->bucketArray[index]; pair; pair = pair->next)
+		wHashTableSlot* slot = &table->slots[index];
+		if ((slot->state == HASH_TABLE_SLOT_USED) && !fn(slot->key, slot->value, arg))
 		{
-			if (!pair->markedForRemove && !fn(pair->key, pair->value, arg))
-			{
-				ret = FALSE;
-				goto out;
-			}
+			ret = FALSE;
+			break;
 		}
 	}
 	table->foreachRecursionLevel--;
 
-	if (!table->foreachRecursionLevel && table->pendingRemoves)
+	/* if we're the last recursive foreach call, let's do the cleanup if needed. Erasing moves
+	 * entries back, across the end of the array too, so repeat until all are gone */
+	while (!table->foreachRecursionLevel && table->pendingRemoves)
 	{
-		/* if we're the last recursive foreach call, let's do the cleanup if needed */
-		wKeyValuePair** prevPtr = NULL;
-		for (size_t index = 0; index < table->numOfBuckets; index++)
+		for (size_t index = 0; index < table->capacity; index++)
 		{
-			wKeyValuePair* nextPair = NULL;
-			prevPtr = &table->bucketArray[index];
-			for (wKeyValuePair* pair = table->bucketArray[index]; pair;)
+			wHashTableSlot* slot = &table->slots[index];
+			while (slot->state == HASH_TABLE_SLOT_REMOVED)
 			{
-				nextPair = pair->next;
-
-				if (pair->markedForRemove)
-				{
-					disposePair(table, pair);
-					*prevPtr = nextPair;
-				}
-				else
-				{
-					prevPtr = &pair->next;
-				}
-				pair = nextPair;
+				disposeSlot(table, slot);
+				HashTable_Erase(table, index);
+				table->pendingRemoves--;
 			}
 		}
-		table->pendingRemoves = 0;
 	}
 
-out:
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
 	return ret;
@@ -670,7 +665,6 @@ out:
 BOOL HashTable_Contains(wHashTable* table, const void* key)
 {
 	BOOL status = 0;
-	wKeyValuePair* pair = NULL;
 
 	WINPR_ASSERT(table);
 	if (!key)
@@ -679,8 +673,8 @@ BOOL HashTable_Contains(wHashTable* table, const void* key)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	pair = HashTable_Get(table, key);
-	status = (pair && !pair->markedForRemove);
+	const wHashTableSlot* slot = HashTable_Get(table, key);
+	status = (slot && (slot->state == HASH_TABLE_SLOT_USED));
 
 	if (table->synchronized)
 		LeaveCriticalSection(&table->lock);
@@ -694,23 +688,7 @@ BOOL HashTable_Contains(wHashTable* table, const void* key)
 
 BOOL HashTable_ContainsKey(wHashTable* table, const void* key)
 {
-	BOOL status = 0;
-	wKeyValuePair* pair = NULL;
-
-	WINPR_ASSERT(table);
-	if (!key)
-		return FALSE;
-
-	if (table->synchronized)
-		EnterCriticalSection(&table->lock);
-
-	pair = HashTable_Get(table, key);
-	status = (pair && !pair->markedForRemove);
-
-	if (table->synchronized)
-		LeaveCriticalSection(&table->lock);
-
-	return status;
+	return HashTable_Contains(table, key);
 }
 
 /**
@@ -728,23 +706,16 @@ BOOL HashTable_ContainsValue(wHashTable* table, const void* value)
 	if (table->synchronized)
 		EnterCriticalSection(&table->lock);
 
-	for (size_t index = 0; index < table->numOfBuckets; index++)
+	for (size_t index = 0; index < table->capacity; index++)
 	{
-		wKeyValuePair* pair = table->bucketArray[index];
+		const wHashTableSlot* slot = &table->slots[index];
 
-		while (pair)
+		if ((slot->state == HASH_TABLE_SLOT_USED) &&
+		    table->value.fnObjectEquals(value, slot->value))
 		{
-			if (!pair->markedForRemove && HashTable_Equals(table, pair, value))
-			{
-				status = TRUE;
-				break;
-			}
-
-			pair = pair->next;
-		}
-
-		if (status)
+			status = TRUE;
 			break;
+		}
 	}
 
 	if (table->synchronized)
@@ -766,16 +737,11 @@ wHashTable* HashTable_New(BOOL synchronized)
 
 	table->synchronized = synchronized;
 	InitializeCriticalSectionAndSpinCount(&(table->lock), 4000);
-	table->numOfBuckets = 64;
 	table->numOfElements = 0;
-	table->bucketArray = (wKeyValuePair**)calloc(table->numOfBuckets, sizeof(wKeyValuePair*));
 
-	if (!table->bucketArray)
+	if (!HashTable_Allocate(table, HASH_TABLE_MIN_CAPACITY))
 		goto fail;
 
-	table->idealRatio = 3.0f;
-	table->lowerRehashThreshold = 0.0f;
-	table->upperRehashThreshold = 15.0f;
 	table->hash = HashTable_PointerHash;
 	table->key.fnObjectEquals = HashTable_PointerCompare;
 	table->value.fnObjectEquals = HashTable_PointerCompare;
@@ -791,27 +757,19 @@ fail:
 
 void HashTable_Free(wHashTable* table)
 {
-	wKeyValuePair* pair = NULL;
-	wKeyValuePair* nextPair = NULL;
-
 	if (!table)
 		return;
 
-	if (table->bucketArray)
+	if (table->slots)
 	{
-		for (size_t index = 0; index < table->numOfBuckets; index++)
+		for (size_t index = 0; index < table->capacity; index++)
 		{
-			pair = table->bucketArray[index];
+			wHashTableSlot* slot = &table->slots[index];
 
-			while (pair)
-			{
-				nextPair = pair->next;
-
-				disposePair(table, pair);
-				pair = nextPair;
-			}
+			if (slot->state != HASH_TABLE_SLOT_EMPTY)
+				disposeSlot(table, slot);
 		}
-		free((void*)table->bucketArray);
+		free(table->slots);
 	}
 	DeleteCriticalSection(&(table->lock));
 
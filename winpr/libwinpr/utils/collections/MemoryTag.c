@@ -0,0 +1,195 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Memory Tags
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/interlocked.h>
+
+#include <winpr/collections.h>
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+/* tags are never released, the number of subsystems is small and fixed */
+#define MEMORYTAG_MAX 64
+#define MEMORYTAG_NAME_MAX 32
+
+struct s_wMemoryTag
+{
+	char name[MEMORYTAG_NAME_MAX];
+	LONGLONG volatile live;
+	LONGLONG volatile peak;
+	LONGLONG volatile allocations;
+	LONGLONG volatile allocated;
+};
+
+static INIT_ONCE memory_tags_once = INIT_ONCE_STATIC_INIT;
+static CRITICAL_SECTION memory_tags_lock;
+static wMemoryTag memory_tags[MEMORYTAG_MAX];
+static LONG volatile memory_tags_count = 0;
+
+static BOOL CALLBACK MemoryTag_Init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+	return InitializeCriticalSectionAndSpinCount(&memory_tags_lock, 4000);
+}
+
+static LONGLONG MemoryTag_Add(LONGLONG volatile* value, LONGLONG delta)
+{
+	LONGLONG cur = *value;
+	for (;;)
+	{
+		const LONGLONG prev = InterlockedCompareExchange64(value, cur + delta, cur);
+		if (prev == cur)
+			return cur + delta;
+		cur = prev;
+	}
+}
+
+static void MemoryTag_Raise(LONGLONG volatile* value, LONGLONG current)
+{
+	LONGLONG cur = *value;
+	while (cur < current)
+	{
+		const LONGLONG prev = InterlockedCompareExchange64(value, current, cur);
+		if (prev == cur)
+			break;
+		cur = prev;
+	}
+}
+
+static LONGLONG MemoryTag_Read(const LONGLONG volatile* value)
+{
+	return InterlockedCompareExchange64((LONGLONG volatile*)value, 0, 0);
+}
+
+wMemoryTag* MemoryTag_Get(const char* name)
+{
+	wMemoryTag* tag = NULL;
+
+	if (!name || (name[0] == '\0') || (strnlen(name, MEMORYTAG_NAME_MAX) >= MEMORYTAG_NAME_MAX))
+		return NULL;
+
+	if (!InitOnceExecuteOnce(&memory_tags_once, MemoryTag_Init, NULL, NULL))
+		return NULL;
+
+	EnterCriticalSection(&memory_tags_lock);
+	const LONG count = memory_tags_count;
+	for (LONG x = 0; x < count; x++)
+	{
+		if (strcmp(memory_tags[x].name, name) == 0)
+		{
+			tag = &memory_tags[x];
+			break;
+		}
+	}
+
+	if (!tag && (count < MEMORYTAG_MAX))
+	{
+		tag = &memory_tags[count];
+		(void)strncpy(tag->name, name, sizeof(tag->name) - 1);
+		(void)InterlockedExchange(&memory_tags_count, count + 1);
+	}
+	LeaveCriticalSection(&memory_tags_lock);
+	return tag;
+}
+
+const char* MemoryTag_Name(const wMemoryTag* tag)
+{
+	if (!tag)
+		return NULL;
+	return tag->name;
+}
+
+void MemoryTag_Allocated(wMemoryTag* tag, size_t bytes)
+{
+	if (!tag || (bytes == 0))
+		return;
+
+	const LONGLONG delta = (LONGLONG)MIN(bytes, INT64_MAX);
+	MemoryTag_Raise(&tag->peak, MemoryTag_Add(&tag->live, delta));
+	(void)MemoryTag_Add(&tag->allocations, 1);
+	(void)MemoryTag_Add(&tag->allocated, delta);
+}
+
+void MemoryTag_Released(wMemoryTag* tag, size_t bytes)
+{
+	if (!tag || (bytes == 0))
+		return;
+
+	(void)MemoryTag_Add(&tag->live, -(LONGLONG)MIN(bytes, INT64_MAX));
+}
+
+void* MemoryTag_Malloc(wMemoryTag* tag, size_t size)
+{
+	void* ptr = malloc(size);
+	if (ptr)
+		MemoryTag_Allocated(tag, size);
+	return ptr;
+}
+
+void* MemoryTag_Calloc(wMemoryTag* tag, size_t nmemb, size_t size)
+{
+	void* ptr = calloc(nmemb, size);
+	if (ptr)
+		MemoryTag_Allocated(tag, nmemb * size);
+	return ptr;
+}
+
+void MemoryTag_Free(wMemoryTag* tag, void* ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	free(ptr);
+	MemoryTag_Released(tag, size);
+}
+
+BOOL MemoryTag_GetStatistics(const wMemoryTag* tag, wMemoryTagStatistics* stats)
+{
+	if (!tag || !stats)
+		return FALSE;
+
+	const LONGLONG live = MemoryTag_Read(&tag->live);
+	stats->live = (live > 0) ? (UINT64)live : 0;
+	stats->peak = (UINT64)MemoryTag_Read(&tag->peak);
+	stats->allocations = (UINT64)MemoryTag_Read(&tag->allocations);
+	stats->allocated = (UINT64)MemoryTag_Read(&tag->allocated);
+	return TRUE;
+}
+
+BOOL MemoryTag_Foreach(MEMORY_TAG_FOREACH_FN fn, void* arg)
+{
+	if (!fn)
+		return FALSE;
+
+	/* tags are only ever appended, entries below the count are complete */
+	const LONG count = InterlockedCompareExchange(&memory_tags_count, 0, 0);
+	for (LONG x = 0; x < count; x++)
+	{
+		const wMemoryTag* tag = &memory_tags[x];
+		wMemoryTagStatistics stats = { 0 };
+		if (!MemoryTag_GetStatistics(tag, &stats) || !fn(tag->name, &stats, arg))
+			return FALSE;
+	}
+	return TRUE;
+}
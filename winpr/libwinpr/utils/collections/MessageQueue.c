@@ -22,9 +22,18 @@
 #include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 #include <winpr/assert.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/collections.h>
 
+typedef struct s_wMessageNode wMessageNode;
+
+struct s_wMessageNode
+{
+	wMessageNode* volatile next;
+	wMessage message;
+};
+
 struct s_wMessageQueue
 {
 	size_t head;
@@ -37,8 +46,101 @@ struct s_wMessageQueue
 	HANDLE event;
 
 	wObject object;
+
+	/**
+	 * WMQ_FLAG_SINGLE_CONSUMER: a linked list producers append to at \b last, \b first is
+	 * the last node taken by the consumer. \b count only includes linked nodes.
+	 */
+	DWORD flags;
+	wMessageNode* volatile last;
+	wMessageNode* first;
+	LONG count;
+	LONG quit;
 };
 
+static BOOL MessageQueue_IsSingleConsumer(const wMessageQueue* queue)
+{
+	return (queue->flags & WMQ_FLAG_SINGLE_CONSUMER) != 0;
+}
+
+/**
+ * Called on the empty/non-empty transitions only. The lock orders racing transitions so the
+ * last one leaves the event matching the count.
+ */
+static void MessageQueue_UpdateEvent(wMessageQueue* queue)
+{
+	EnterCriticalSection(&queue->lock);
+	if (InterlockedCompareExchange(&queue->count, 0, 0) > 0)
+		(void)SetEvent(queue->event);
+	else
+		(void)ResetEvent(queue->event);
+	LeaveCriticalSection(&queue->lock);
+}
+
+static BOOL MessageQueue_AppendNode(wMessageQueue* queue, const wMessage* message)
+{
+	WINPR_ASSERT(queue);
+	WINPR_ASSERT(message);
+
+	if (InterlockedCompareExchange(&queue->quit, 0, 0) != 0)
+		return FALSE;
+
+	if ((message->id == WMQ_QUIT) && (InterlockedCompareExchange(&queue->quit, 1, 0) != 0))
+		return FALSE;
+
+	wMessageNode* node = (wMessageNode*)calloc(1, sizeof(wMessageNode));
+	if (!node)
+		return FALSE;
+
+	node->message = *message;
+	node->message.time = GetTickCount64();
+
+	wMessageNode* prev = queue->last;
+	while (1)
+	{
+		wMessageNode* cur = (wMessageNode*)InterlockedCompareExchangePointer(
+		    (PVOID volatile*)&queue->last, node, prev);
+		if (cur == prev)
+			break;
+		prev = cur;
+	}
+	(void)InterlockedCompareExchangePointer((PVOID volatile*)&prev->next, node, NULL);
+
+	/* only the first message wakes up the consumer */
+	if (InterlockedIncrement(&queue->count) == 1)
+		MessageQueue_UpdateEvent(queue);
+	return TRUE;
+}
+
+static BOOL MessageQueue_TakeNode(wMessageQueue* queue, wMessage* message, BOOL remove)
+{
+	WINPR_ASSERT(queue);
+
+	if (InterlockedCompareExchange(&queue->count, 0, 0) == 0)
+		return FALSE;
+
+	/* a producer that appended before the counted one might still be linking */
+	wMessageNode* next = NULL;
+	while (!(next = (wMessageNode*)InterlockedCompareExchangePointer(
+	             (PVOID volatile*)&queue->first->next, NULL, NULL)))
+		(void)SwitchToThread();
+
+	if (message)
+		*message = next->message;
+
+	if (!remove)
+		return TRUE;
+
+	/* the taken node becomes the new list head */
+	ZeroMemory(&next->message, sizeof(wMessage));
+	free(queue->first);
+	queue->first = next;
+
+	if (InterlockedDecrement(&queue->count) == 0)
+		MessageQueue_UpdateEvent(queue);
+	return TRUE;
+}
+
 /**
  * Message Queue inspired from Windows:
  * http://msdn.microsoft.com/en-us/library/ms632590/
@@ -71,6 +173,9 @@ HANDLE MessageQueue_Event(wMessageQueue* queue)
 size_t MessageQueue_Size(wMessageQueue* queue)
 {
 	WINPR_ASSERT(queue);
+	if (MessageQueue_IsSingleConsumer(queue))
+		return (size_t)InterlockedCompareExchange(&queue->count, 0, 0);
+
 	EnterCriticalSection(&queue->lock);
 	const size_t ret = queue->size;
 	LeaveCriticalSection(&queue->lock);
@@ -132,7 +237,9 @@ BOOL MessageQueue_Dispatch(wMessageQueue* queue, const wMessage* message)
 	if (!message)
 		return FALSE;
 
-	WINPR_ASSERT(queue);
+	if (MessageQueue_IsSingleConsumer(queue))
+		return MessageQueue_AppendNode(queue, message);
+
 	EnterCriticalSection(&queue->lock);
 
 	if (queue->closed)
@@ -148,7 +255,7 @@ BOOL MessageQueue_Dispatch(wMessageQueue* queue, const wMessage* message)
 	queue->tail = (queue->tail + 1) % queue->capacity;
 	queue->size++;
 
-	if (queue->size > 0)
+	if (queue->size == 1)
 		(void)SetEvent(queue->event);
 
 	if (message->id == WMQ_QUIT)
@@ -185,6 +292,13 @@ int MessageQueue_Get(wMessageQueue* queue, wMessage* message)
 	if (!MessageQueue_Wait(queue))
 		return status;
 
+	if (MessageQueue_IsSingleConsumer(queue))
+	{
+		if (MessageQueue_TakeNode(queue, message, TRUE))
+			status = (message->id != WMQ_QUIT) ? 1 : 0;
+		return status;
+	}
+
 	EnterCriticalSection(&queue->lock);
 
 	if (queue->size > 0)
@@ -210,6 +324,9 @@ int MessageQueue_Peek(wMessageQueue* queue, wMessage* message, BOOL remove)
 	int status = 0;
 
 	WINPR_ASSERT(queue);
+	if (MessageQueue_IsSingleConsumer(queue))
+		return MessageQueue_TakeNode(queue, message, remove) ? 1 : 0;
+
 	EnterCriticalSection(&queue->lock);
 
 	if (queue->size > 0)
@@ -238,6 +355,11 @@ int MessageQueue_Peek(wMessageQueue* queue, wMessage* message, BOOL remove)
  */
 
 wMessageQueue* MessageQueue_New(const wObject* callback)
+{
+	return MessageQueue_NewEx(callback, 0);
+}
+
+wMessageQueue* MessageQueue_NewEx(const wObject* callback, DWORD flags)
 {
 	wMessageQueue* queue = NULL;
 
@@ -245,10 +367,18 @@ wMessageQueue* MessageQueue_New(const wObject* callback)
 	if (!queue)
 		return NULL;
 
+	queue->flags = flags;
+
 	if (!InitializeCriticalSectionAndSpinCount(&queue->lock, 4000))
 		goto fail;
 
-	if (!MessageQueue_EnsureCapacity(queue, 32))
+	if (MessageQueue_IsSingleConsumer(queue))
+	{
+		if (!(queue->first = (wMessageNode*)calloc(1, sizeof(wMessageNode))))
+			goto fail;
+		queue->last = queue->first;
+	}
+	else if (!MessageQueue_EnsureCapacity(queue, 32))
 		goto fail;
 
 	queue->event = CreateEvent(NULL, TRUE, FALSE, NULL);
@@ -279,6 +409,7 @@ void MessageQueue_Free(wMessageQueue* queue)
 	(void)CloseHandle(queue->event);
 	DeleteCriticalSection(&queue->lock);
 
+	free(queue->first);
 	free(queue->array);
 	free(queue);
 }
@@ -290,6 +421,21 @@ int MessageQueue_Clear(wMessageQueue* queue)
 	WINPR_ASSERT(queue);
 	WINPR_ASSERT(queue->event);
 
+	if (MessageQueue_IsSingleConsumer(queue))
+	{
+		wMessage msg = { 0 };
+
+		while (MessageQueue_TakeNode(queue, &msg, TRUE))
+		{
+			if (queue->object.fnObjectUninit)
+				queue->object.fnObjectUninit(&msg);
+			if (queue->object.fnObjectFree)
+				queue->object.fnObjectFree(&msg);
+		}
+		(void)InterlockedExchange(&queue->quit, 0);
+		return status;
+	}
+
 	EnterCriticalSection(&queue->lock);
 
 	while (queue->size > 0)
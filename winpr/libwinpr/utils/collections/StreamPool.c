@@ -20,6 +20,7 @@
 #include <winpr/config.h>
 
 #include <winpr/crt.h>
+#include <winpr/intrin.h>
 #include <winpr/wlog.h>
 
 #include <winpr/collections.h>
@@ -28,6 +29,19 @@
 #include "../log.h"
 #define TAG WINPR_TAG("utils.streampool")
 
+/* available streams are binned by the floor of log2 of their capacity */
+#define STREAMPOOL_CLASSES (sizeof(size_t) * 8)
+
+/* new streams up to this size get a power of two capacity so they fit other requests */
+#define STREAMPOOL_ROUND_MAX (1024ull * 1024ull)
+
+/* bytes that may always be cached, beyond that the peak of bytes in use is the limit */
+#define STREAMPOOL_MIN_CACHE (1024ull * 1024ull)
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
 struct s_StreamPoolEntry
 {
 #if defined(WITH_STREAMPOOL_DEBUG)
@@ -35,21 +49,32 @@ struct s_StreamPoolEntry
 	size_t lines;
 #endif
 	wStream* s;
+	size_t capacity;
+};
+
+struct s_StreamPoolArray
+{
+	size_t size;
+	size_t capacity;
+	struct s_StreamPoolEntry* entries;
 };
 
 struct s_wStreamPool
 {
+	struct s_StreamPoolArray available[STREAMPOOL_CLASSES];
 	size_t aSize;
-	size_t aCapacity;
-	struct s_StreamPoolEntry* aArray;
+	size_t aBytes;
 
-	size_t uSize;
-	size_t uCapacity;
-	struct s_StreamPoolEntry* uArray;
+	struct s_StreamPoolArray used;
+	size_t uBytes;
+	size_t uPeakBytes;
 
 	CRITICAL_SECTION lock;
 	BOOL synchronized;
 	size_t defaultSize;
+
+	wMemoryTag* tag;
+	size_t accounted;
 };
 
 static void discard_entry(struct s_StreamPoolEntry* entry, BOOL discardStream)
@@ -80,9 +105,23 @@ static struct s_StreamPoolEntry add_entry(wStream* s)
 #endif
 
 	entry.s = s;
+	entry.capacity = Stream_Capacity(s);
 	return entry;
 }
 
+static size_t StreamPool_Class(size_t capacity)
+{
+	if (capacity < 2)
+		return 0;
+
+#if SIZE_MAX > UINT32_MAX
+	const UINT32 high = (UINT32)(capacity >> 32);
+	if (high != 0)
+		return 63 - __lzcnt(high);
+#endif
+	return 31 - __lzcnt((UINT32)capacity);
+}
+
 /**
  * Lock the stream pool
  */
@@ -105,36 +144,33 @@ static INLINE void StreamPool_Unlock(wStreamPool* pool)
 		LeaveCriticalSection(&pool->lock);
 }
 
-static BOOL StreamPool_EnsureCapacity(wStreamPool* pool, size_t count, BOOL usedOrAvailable)
+/* the bytes of cached and used streams, as the pool tracks them, are accounted to the tag */
+static void StreamPool_Account(wStreamPool* pool)
 {
-	WINPR_ASSERT(pool);
-
-	size_t* cap = (usedOrAvailable) ? &pool->uCapacity : &pool->aCapacity;
-	size_t* size = (usedOrAvailable) ? &pool->uSize : &pool->aSize;
-	struct s_StreamPoolEntry** array = (usedOrAvailable) ? &pool->uArray : &pool->aArray;
+	const size_t bytes = pool->aBytes + pool->uBytes;
+	if (bytes > pool->accounted)
+		MemoryTag_Allocated(pool->tag, bytes - pool->accounted);
+	else
+		MemoryTag_Released(pool->tag, pool->accounted - bytes);
+	pool->accounted = bytes;
+}
 
-	size_t new_cap = 0;
-	if (*cap == 0)
-		new_cap = *size + count;
-	else if (*size + count > *cap)
-		new_cap = (*size + count + 2) / 2 * 3;
-	else if ((*size + count) < *cap / 3)
-		new_cap = *cap / 2;
+static BOOL StreamPool_Append(struct s_StreamPoolArray* array, wStream* s)
+{
+	WINPR_ASSERT(array);
 
-	if (new_cap > 0)
+	if (array->size == array->capacity)
 	{
-		struct s_StreamPoolEntry* new_arr = NULL;
-
-		if (*cap < *size + count)
-			*cap += count;
-
-		new_arr =
-		    (struct s_StreamPoolEntry*)realloc(*array, sizeof(struct s_StreamPoolEntry) * new_cap);
+		const size_t new_cap = (array->capacity > 0) ? array->capacity * 2 : 32;
+		struct s_StreamPoolEntry* new_arr = (struct s_StreamPoolEntry*)realloc(
+		    array->entries, sizeof(struct s_StreamPoolEntry) * new_cap);
 		if (!new_arr)
 			return FALSE;
-		*cap = new_cap;
-		*array = new_arr;
+		array->entries = new_arr;
+		array->capacity = new_cap;
 	}
+
+	array->entries[array->size++] = add_entry(s);
 	return TRUE;
 }
 
@@ -142,72 +178,70 @@ static BOOL StreamPool_EnsureCapacity(wStreamPool* pool, size_t count, BOOL used
  * Methods
  */
 
-static void StreamPool_ShiftUsed(wStreamPool* pool, size_t index)
+/**
+ * Removes a used stream from the pool. Streams are usually returned shortly after they were
+ * taken, so the search starts at the end and the last entry fills the gap.
+ */
+
+static BOOL StreamPool_RemoveUsed(wStreamPool* pool, wStream* s)
 {
 	WINPR_ASSERT(pool);
 
-	const size_t pcount = 1;
-	const size_t off = index + pcount;
-	if (pool->uSize >= off)
+	for (size_t index = pool->used.size; index > 0; index--)
 	{
-		for (size_t x = 0; x < pcount; x++)
-		{
-			struct s_StreamPoolEntry* cur = &pool->uArray[index + x];
-			discard_entry(cur, FALSE);
-		}
-		MoveMemory(&pool->uArray[index], &pool->uArray[index + pcount],
-		           (pool->uSize - index - pcount) * sizeof(struct s_StreamPoolEntry));
-		pool->uSize -= pcount;
+		struct s_StreamPoolEntry* cur = &pool->used.entries[index - 1];
+		if (cur->s != s)
+			continue;
+
+		pool->uBytes -= cur->capacity;
+		discard_entry(cur, FALSE);
+		pool->used.size--;
+		if (index - 1 < pool->used.size)
+			*cur = pool->used.entries[pool->used.size];
+		return TRUE;
 	}
-}
-
-/**
- * Adds a used stream to the pool.
- */
 
-static void StreamPool_AddUsed(wStreamPool* pool, wStream* s)
-{
-	StreamPool_EnsureCapacity(pool, 1, TRUE);
-	pool->uArray[pool->uSize] = add_entry(s);
-	pool->uSize++;
+	return FALSE;
 }
 
-/**
- * Removes a used stream from the pool.
- */
-
-static void StreamPool_RemoveUsed(wStreamPool* pool, wStream* s)
+static BOOL StreamPool_IsAvailable(wStreamPool* pool, const wStream* s)
 {
 	WINPR_ASSERT(pool);
-	for (size_t index = 0; index < pool->uSize; index++)
+
+	const struct s_StreamPoolArray* bin = &pool->available[StreamPool_Class(Stream_Capacity(s))];
+	for (size_t x = 0; x < bin->size; x++)
 	{
-		struct s_StreamPoolEntry* cur = &pool->uArray[index];
-		if (cur->s == s)
-		{
-			StreamPool_ShiftUsed(pool, index);
-			break;
-		}
+		if (bin->entries[x].s == s)
+			return TRUE;
 	}
+	return FALSE;
 }
 
-static void StreamPool_ShiftAvailable(wStreamPool* pool, size_t index)
+/* the newest stream of the first class that fits */
+static wStream* StreamPool_TakeAvailable(wStreamPool* pool, size_t size)
 {
 	WINPR_ASSERT(pool);
 
-	const size_t pcount = 1;
-	const size_t off = index + pcount;
-	if (pool->aSize >= off)
+	for (size_t c = StreamPool_Class(size); c < STREAMPOOL_CLASSES; c++)
 	{
-		for (size_t x = 0; x < pcount; x++)
-		{
-			struct s_StreamPoolEntry* cur = &pool->aArray[index + x];
-			discard_entry(cur, FALSE);
-		}
-
-		MoveMemory(&pool->aArray[index], &pool->aArray[index + pcount],
-		           (pool->aSize - index - pcount) * sizeof(struct s_StreamPoolEntry));
-		pool->aSize -= pcount;
+		struct s_StreamPoolArray* bin = &pool->available[c];
+		if (bin->size == 0)
+			continue;
+
+		/* only the class of the requested size can hold streams that are too small */
+		struct s_StreamPoolEntry* cur = &bin->entries[bin->size - 1];
+		if (Stream_Capacity(cur->s) < size)
+			continue;
+
+		wStream* s = cur->s;
+		pool->aSize--;
+		pool->aBytes -= cur->capacity;
+		discard_entry(cur, FALSE);
+		bin->size--;
+		return s;
 	}
+
+	return NULL;
 }
 
 /**
@@ -216,48 +250,42 @@ static void StreamPool_ShiftAvailable(wStreamPool* pool, size_t index)
 
 wStream* StreamPool_Take(wStreamPool* pool, size_t size)
 {
-	BOOL found = FALSE;
-	size_t foundIndex = 0;
-	wStream* s = NULL;
-
 	StreamPool_Lock(pool);
 
 	if (size == 0)
 		size = pool->defaultSize;
 
-	for (size_t index = 0; index < pool->aSize; index++)
-	{
-		struct s_StreamPoolEntry* cur = &pool->aArray[index];
-		s = cur->s;
+	wStream* s = StreamPool_TakeAvailable(pool, size);
 
-		if (Stream_Capacity(s) >= size)
-		{
-			found = TRUE;
-			foundIndex = index;
-			break;
-		}
-	}
-
-	if (!found)
+	if (!s)
 	{
-		s = Stream_New(NULL, size);
+		size_t capacity = size;
+		if ((capacity > 1) && (capacity <= STREAMPOOL_ROUND_MAX))
+			capacity = (size_t)1 << (StreamPool_Class(capacity - 1) + 1);
+
+		s = Stream_New(NULL, capacity);
 		if (!s)
 			goto out_fail;
 	}
-	else if (s)
+	else
 	{
 		Stream_SetPosition(s, 0);
 		Stream_SetLength(s, Stream_Capacity(s));
-		StreamPool_ShiftAvailable(pool, foundIndex);
 	}
 
-	if (s)
+	if (!StreamPool_Append(&pool->used, s))
 	{
-		s->pool = pool;
-		s->count = 1;
-		StreamPool_AddUsed(pool, s);
+		Stream_Free(s, TRUE);
+		s = NULL;
+		goto out_fail;
 	}
 
+	s->pool = pool;
+	s->count = 1;
+	pool->uBytes += Stream_Capacity(s);
+	pool->uPeakBytes = MAX(pool->uPeakBytes, pool->uBytes);
+	StreamPool_Account(pool);
+
 out_fail:
 	StreamPool_Unlock(pool);
 
@@ -270,16 +298,26 @@ out_fail:
 
 static void StreamPool_Remove(wStreamPool* pool, wStream* s)
 {
-	StreamPool_EnsureCapacity(pool, 1, FALSE);
 	Stream_EnsureValidity(s);
-	for (size_t x = 0; x < pool->aSize; x++)
+
+	/* streams not taken from the pool and double returns are rare, check them only here */
+	if (!StreamPool_RemoveUsed(pool, s) && StreamPool_IsAvailable(pool, s))
+		return;
+
+	/* do not cache more than was ever in use at once */
+	const size_t capacity = Stream_Capacity(s);
+	struct s_StreamPoolArray* bin = &pool->available[StreamPool_Class(capacity)];
+	if ((pool->aBytes + capacity > MAX(pool->uPeakBytes, STREAMPOOL_MIN_CACHE)) ||
+	    !StreamPool_Append(bin, s))
 	{
-		wStream* cs = pool->aArray[x].s;
-		if (cs == s)
-			return;
+		Stream_Free(s, s->isAllocatedStream);
+		StreamPool_Account(pool);
+		return;
 	}
-	pool->aArray[(pool->aSize)++] = add_entry(s);
-	StreamPool_RemoveUsed(pool, s);
+
+	pool->aSize++;
+	pool->aBytes += capacity;
+	StreamPool_Account(pool);
 }
 
 static void StreamPool_ReleaseOrReturn(wStreamPool* pool, wStream* s)
@@ -339,9 +377,9 @@ wStream* StreamPool_Find(wStreamPool* pool, const BYTE* ptr)
 
 	StreamPool_Lock(pool);
 
-	for (size_t index = 0; index < pool->uSize; index++)
+	for (size_t index = 0; index < pool->used.size; index++)
 	{
-		struct s_StreamPoolEntry* cur = &pool->uArray[index];
+		struct s_StreamPoolEntry* cur = &pool->used.entries[index];
 
 		if ((ptr >= Stream_Buffer(cur->s)) &&
 		    (ptr < (Stream_Buffer(cur->s) + Stream_Capacity(cur->s))))
@@ -364,22 +402,27 @@ void StreamPool_Clear(wStreamPool* pool)
 {
 	StreamPool_Lock(pool);
 
-	for (size_t x = 0; x < pool->aSize; x++)
+	for (size_t c = 0; c < STREAMPOOL_CLASSES; c++)
 	{
-		struct s_StreamPoolEntry* cur = &pool->aArray[x];
-		discard_entry(cur, TRUE);
+		struct s_StreamPoolArray* bin = &pool->available[c];
+		for (size_t x = 0; x < bin->size; x++)
+			discard_entry(&bin->entries[x], TRUE);
+		bin->size = 0;
 	}
+	pool->aSize = 0;
+	pool->aBytes = 0;
 
-	if (pool->uSize > 0)
+	if (pool->used.size > 0)
 	{
 		WLog_WARN(TAG, "Clearing StreamPool, but there are %" PRIuz " streams currently in use",
-		          pool->uSize);
-		for (size_t x = 0; x < pool->uSize; x++)
-		{
-			struct s_StreamPoolEntry* cur = &pool->uArray[x];
-			discard_entry(cur, TRUE);
-		}
+		          pool->used.size);
+		for (size_t x = 0; x < pool->used.size; x++)
+			discard_entry(&pool->used.entries[x], TRUE);
+		pool->used.size = 0;
 	}
+	pool->uBytes = 0;
+	pool->uPeakBytes = 0;
+	StreamPool_Account(pool);
 
 	StreamPool_Unlock(pool);
 }
@@ -387,7 +430,7 @@ void StreamPool_Clear(wStreamPool* pool)
 size_t StreamPool_UsedCount(wStreamPool* pool)
 {
 	StreamPool_Lock(pool);
-	size_t usize = pool->uSize;
+	size_t usize = pool->used.size;
 	StreamPool_Unlock(pool);
 	return usize;
 }
@@ -406,22 +449,12 @@ wStreamPool* StreamPool_New(BOOL synchronized, size_t defaultSize)
 	{
 		pool->synchronized = synchronized;
 		pool->defaultSize = defaultSize;
-
-		if (!StreamPool_EnsureCapacity(pool, 32, FALSE))
-			goto fail;
-		if (!StreamPool_EnsureCapacity(pool, 32, TRUE))
-			goto fail;
+		pool->tag = MemoryTag_Get("streampool");
 
 		InitializeCriticalSectionAndSpinCount(&pool->lock, 4000);
 	}
 
 	return pool;
-fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	StreamPool_Free(pool);
-	WINPR_PRAGMA_DIAG_POP
-	return NULL;
 }
 
 void StreamPool_Free(wStreamPool* pool)
@@ -432,13 +465,25 @@ void StreamPool_Free(wStreamPool* pool)
 
 		DeleteCriticalSection(&pool->lock);
 
-		free(pool->aArray);
-		free(pool->uArray);
+		for (size_t c = 0; c < STREAMPOOL_CLASSES; c++)
+			free(pool->available[c].entries);
+		free(pool->used.entries);
 
 		free(pool);
 	}
 }
 
+void StreamPool_SetMemoryTag(wStreamPool* pool, wMemoryTag* tag)
+{
+	WINPR_ASSERT(pool);
+
+	StreamPool_Lock(pool);
+	MemoryTag_Released(pool->tag, pool->accounted);
+	pool->tag = tag;
+	MemoryTag_Allocated(pool->tag, pool->accounted);
+	StreamPool_Unlock(pool);
+}
+
 char* StreamPool_GetStatistics(wStreamPool* pool, char* buffer, size_t size)
 {
 	WINPR_ASSERT(pool);
@@ -448,9 +493,10 @@ char* StreamPool_GetStatistics(wStreamPool* pool, char* buffer, size_t size)
 
 	size_t used = 0;
 	int offset = _snprintf(buffer, size - 1,
-	                       "aSize    =%" PRIuz ", uSize    =%" PRIuz ", aCapacity=%" PRIuz
-	                       ", uCapacity=%" PRIuz,
-	                       pool->aSize, pool->uSize, pool->aCapacity, pool->uCapacity);
+	                       "aSize    =%" PRIuz ", uSize    =%" PRIuz ", aBytes   =%" PRIuz
+	                       ", uBytes   =%" PRIuz ", uPeak    =%" PRIuz,
+	                       pool->aSize, pool->used.size, pool->aBytes, pool->uBytes,
+	                       pool->uPeakBytes);
 	if ((offset > 0) && ((size_t)offset < size))
 		used += (size_t)offset;
 
@@ -460,9 +506,9 @@ char* StreamPool_GetStatistics(wStreamPool* pool, char* buffer, size_t size)
 	offset = _snprintf(&buffer[used], size - 1 - used, "\n-- dump used array take locations --\n");
 	if ((offset > 0) && ((size_t)offset < size - used))
 		used += (size_t)offset;
-	for (size_t x = 0; x < pool->uSize; x++)
+	for (size_t x = 0; x < pool->used.size; x++)
 	{
-		const struct s_StreamPoolEntry* cur = &pool->uArray[x];
+		const struct s_StreamPoolEntry* cur = &pool->used.entries[x];
 		WINPR_ASSERT(cur->msg || (cur->lines == 0));
 
 		for (size_t y = 0; y < cur->lines; y++)
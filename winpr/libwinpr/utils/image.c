@@ -47,6 +47,14 @@
 
 #if defined(WITH_LODEPNG)
 #include <lodepng.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMAGE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define IMAGE_NEON
+#include <arm_neon.h>
+#endif
 #endif
 #include <winpr/stream.h>
 
@@ -402,40 +410,19 @@ int winpr_image_write_ex(wImage* image, UINT32 format, const char* filename)
 	return write_and_free(filename, data, size);
 }
 
-static int winpr_image_bitmap_read_buffer(wImage* image, const BYTE* buffer, size_t size)
+/* reads the pixels following the headers, s is positioned at the first scanline */
+static int winpr_image_bitmap_read_pixels(wImage* image, wStream* s,
+                                          const WINPR_BITMAP_INFO_HEADER* pbi)
 {
 	int rc = -1;
 	BOOL vFlip = 0;
-	WINPR_BITMAP_FILE_HEADER bf = { 0 };
-	WINPR_BITMAP_INFO_HEADER bi = { 0 };
-	wStream sbuffer = { 0 };
-	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, size);
-
-	if (!s)
-		return -1;
 
-	size_t bmpoffset = 0;
-	if (!readBitmapFileHeader(s, &bf) || !readBitmapInfoHeader(s, &bi, &bmpoffset))
-		goto fail;
-
-	if ((bf.bfType[0] != 'B') || (bf.bfType[1] != 'M'))
-	{
-		WLog_WARN(TAG, "Invalid bitmap header %c%c", bf.bfType[0], bf.bfType[1]);
-		goto fail;
-	}
+	WINPR_ASSERT(image);
+	WINPR_ASSERT(pbi);
 
+	const WINPR_BITMAP_INFO_HEADER bi = *pbi;
 	image->type = WINPR_IMAGE_BITMAP;
 
-	const size_t pos = Stream_GetPosition(s);
-	const size_t expect = bf.bfOffBits;
-
-	if (pos != expect)
-	{
-		WLog_WARN(TAG, "pos=%" PRIuz ", expected %" PRIuz ", offset=" PRIuz, pos, expect,
-		          bmpoffset);
-		goto fail;
-	}
-
 	if (!Stream_CheckAndLogRequiredCapacity(TAG, s, bi.biSizeImage))
 		goto fail;
 
@@ -529,6 +516,56 @@ fail:
 	return rc;
 }
 
+static int winpr_image_bitmap_read_buffer(wImage* image, const BYTE* buffer, size_t size)
+{
+	WINPR_BITMAP_FILE_HEADER bf = { 0 };
+	WINPR_BITMAP_INFO_HEADER bi = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, size);
+
+	if (!s)
+		return -1;
+
+	size_t bmpoffset = 0;
+	if (!readBitmapFileHeader(s, &bf) || !readBitmapInfoHeader(s, &bi, &bmpoffset))
+		return -1;
+
+	if ((bf.bfType[0] != 'B') || (bf.bfType[1] != 'M'))
+	{
+		WLog_WARN(TAG, "Invalid bitmap header %c%c", bf.bfType[0], bf.bfType[1]);
+		return -1;
+	}
+
+	const size_t pos = Stream_GetPosition(s);
+	const size_t expect = bf.bfOffBits;
+
+	if (pos != expect)
+	{
+		WLog_WARN(TAG, "pos=%" PRIuz ", expected %" PRIuz ", offset=" PRIuz, pos, expect,
+		          bmpoffset);
+		return -1;
+	}
+
+	return winpr_image_bitmap_read_pixels(image, s, &bi);
+}
+
+int winpr_image_read_dib_buffer(wImage* image, const BYTE* buffer, size_t size)
+{
+	WINPR_BITMAP_INFO_HEADER bi = { 0 };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, buffer, size);
+
+	if (!image || !s)
+		return -1;
+
+	/* a DIB has no file header, the color table or masks directly follow the info header */
+	size_t bmpoffset = 0;
+	if (!readBitmapInfoHeader(s, &bi, &bmpoffset) || !Stream_SafeSeek(s, bmpoffset))
+		return -1;
+
+	return winpr_image_bitmap_read_pixels(image, s, &bi);
+}
+
 int winpr_image_read(wImage* image, const char* filename)
 {
 	int status = -1;
@@ -741,7 +778,7 @@ SSIZE_T winpr_convert_from_jpeg(WINPR_ATTR_UNUSED const BYTE* comp_data,
 	if (jpeg_read_header(&cinfo, 1) != JPEG_HEADER_OK)
 		goto fail;
 
-	cinfo.out_color_space = cinfo.num_components > 3 ? JCS_EXT_RGBA : JCS_EXT_BGR;
+	cinfo.out_color_space = cinfo.num_components > 3 ? JCS_EXT_BGRA : JCS_EXT_BGR;
 
 	*width = WINPR_ASSERTING_INT_CAST(uint32_t, cinfo.image_width);
 	*height = WINPR_ASSERTING_INT_CAST(uint32_t, cinfo.image_height);
@@ -792,32 +829,53 @@ static void* winpr_convert_to_webp(WINPR_ATTR_UNUSED const void* data,
 	WLog_WARN(TAG, "WEBP not supported in this build");
 	return NULL;
 #else
-	size_t dstSize = 0;
-	uint8_t* pDstData = NULL;
+	void* rc = NULL;
+	int imported = 0;
+	WebPConfig config = { 0 };
+	WebPPicture picture = { 0 };
+	WebPMemoryWriter writer = { 0 };
 	WINPR_ASSERT(width <= INT32_MAX);
 	WINPR_ASSERT(height <= INT32_MAX);
 	WINPR_ASSERT(stride <= INT32_MAX);
+
+	/* WebPEncodeLossless* use the default effort, the fastest preset is a lot quicker and
+	 * still lossless */
+	if (!WebPConfigInit(&config) || !WebPConfigLosslessPreset(&config, 0) ||
+	    !WebPPictureInit(&picture))
+		return NULL;
+
+	WebPMemoryWriterInit(&writer);
+	picture.use_argb = 1;
+	picture.width = (int)width;
+	picture.height = (int)height;
+	picture.writer = WebPMemoryWrite;
+	picture.custom_ptr = &writer;
+
 	switch (bpp)
 	{
 		case 32:
-			dstSize = WebPEncodeLosslessBGRA(data, (int)width, (int)height, (int)stride, &pDstData);
+			imported = WebPPictureImportBGRA(&picture, data, (int)stride);
 			break;
 		case 24:
-			dstSize = WebPEncodeLosslessBGR(data, (int)width, (int)height, (int)stride, &pDstData);
+			imported = WebPPictureImportBGR(&picture, data, (int)stride);
 			break;
 		default:
-			return NULL;
+			break;
 	}
 
-	void* rc = malloc(dstSize);
+	if (!imported || !WebPEncode(&config, &picture) || (writer.size > UINT32_MAX))
+		goto fail;
+
+	rc = malloc(writer.size);
 	if (rc)
 	{
-		memcpy(rc, pDstData, dstSize);
-
-		WINPR_ASSERT(dstSize <= UINT32_MAX);
-		*pSize = (UINT32)dstSize;
+		memcpy(rc, writer.mem, writer.size);
+		*pSize = (UINT32)writer.size;
 	}
-	WebPFree(pDstData);
+
+fail:
+	WebPPictureFree(&picture);
+	WebPMemoryWriterClear(&writer);
 	return rc;
 #endif
 }
@@ -863,6 +921,7 @@ struct png_mem_encode
 {
 	char* buffer;
 	size_t size;
+	size_t capacity;
 };
 
 static void png_write_data(png_structp png_ptr, png_bytep data, png_size_t length)
@@ -870,20 +929,21 @@ static void png_write_data(png_structp png_ptr, png_bytep data, png_size_t lengt
 	/* with libpng15 next line causes pointer deference error; use libpng12 */
 	struct png_mem_encode* p =
 	    (struct png_mem_encode*)png_get_io_ptr(png_ptr); /* was png_ptr->io_ptr */
-	size_t nsize = p->size + length;
+	const size_t nsize = p->size + length;
 
-	/* allocate or grow buffer */
-	if (p->buffer)
+	/* libpng writes in small chunks, grow geometrically */
+	if (nsize > p->capacity)
 	{
-		char* tmp = realloc(p->buffer, nsize);
-		if (tmp)
-			p->buffer = tmp;
+		size_t capacity = (p->capacity > 0) ? p->capacity * 2 : 64ull * 1024ull;
+		if (capacity < nsize)
+			capacity = nsize;
+
+		char* tmp = realloc(p->buffer, capacity);
+		if (!tmp)
+			png_error(png_ptr, "Write Error");
+		p->buffer = tmp;
+		p->capacity = capacity;
 	}
-	else
-		p->buffer = malloc(nsize);
-
-	if (!p->buffer)
-		png_error(png_ptr, "Write Error");
 
 	/* copy new bytes to end of buffer */
 	memcpy(p->buffer + p->size, data, length);
@@ -901,7 +961,7 @@ static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, uint32_t stride, UIN
 	SSIZE_T rc = -1;
 	png_structp png_ptr = NULL;
 	png_infop info_ptr = NULL;
-	png_byte** row_pointers = NULL;
+	png_byte** volatile row_pointers = NULL;
 	struct png_mem_encode state = { 0 };
 
 	*pDstData = NULL;
@@ -914,6 +974,15 @@ static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, uint32_t stride, UIN
 	if (size < (1ULL * stride * height))
 		goto fail;
 
+	if ((bpp != 24) && (bpp != 32))
+	{
+		WLog_WARN(TAG, "PNG encoding of %" PRIu32 " bpp images not supported", bpp);
+		goto fail;
+	}
+
+	if (stride < 1ULL * width * (bpp / 8))
+		goto fail;
+
 	/* Initialize the write struct. */
 	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png_ptr == NULL)
@@ -929,53 +998,34 @@ static SSIZE_T save_png_to_buffer(UINT32 bpp, UINT32 width, uint32_t stride, UIN
 		goto fail;
 
 	/* Set image attributes. */
-	int colorType = PNG_COLOR_TYPE_PALETTE;
-	if (bpp > 8)
-		colorType = PNG_COLOR_TYPE_RGB;
-	if (bpp > 16)
-		colorType = PNG_COLOR_TYPE_RGB;
-	if (bpp > 24)
-		colorType = PNG_COLOR_TYPE_RGBA;
+	const int colorType = (bpp > 24) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
 
 	png_set_IHDR(png_ptr, info_ptr, width, height, 8, colorType, PNG_INTERLACE_NONE,
 	             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
-	/* Initialize rows of PNG. */
+	/* These images are usually transferred once (clipboard), trade size for speed:
+	 * the SUB filter alone and the fastest zlib level (Z_BEST_SPEED) */
+	png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+	png_set_compression_level(png_ptr, 1);
+
+	/* The rows point into the source, libpng swaps BGR(A) to RGB(A) while writing */
 	row_pointers = (png_byte**)png_malloc(png_ptr, height * sizeof(png_byte*));
 	for (size_t y = 0; y < height; ++y)
-	{
-		const uint8_t* line = &data[y * stride];
-		uint8_t* row = png_malloc(png_ptr, sizeof(uint8_t) * stride);
-		row_pointers[y] = (png_byte*)row;
-		for (size_t x = 0; x < width; ++x)
-		{
-
-			*row++ = *line++;
-			if (bpp > 8)
-				*row++ = *line++;
-			if (bpp > 16)
-				*row++ = *line++;
-			if (bpp > 24)
-				*row++ = *line++;
-		}
-	}
+		row_pointers[y] = WINPR_CAST_CONST_PTR_AWAY(&data[y * stride], png_byte*);
 
 	/* Actually write the image data. */
 	png_set_write_fn(png_ptr, &state, png_write_data, png_flush);
 	png_set_rows(png_ptr, info_ptr, row_pointers);
 	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_BGR, NULL);
 
-	/* Cleanup. */
-	for (size_t y = 0; y < height; y++)
-		png_free(png_ptr, row_pointers[y]);
-	png_free(png_ptr, (void*)row_pointers);
-
 	/* Finish writing. */
 	if (state.size > SSIZE_MAX)
 		goto fail;
 	rc = (SSIZE_T)state.size;
 	*pDstData = state.buffer;
 fail:
+	if (png_ptr)
+		png_free(png_ptr, (void*)row_pointers);
 	png_destroy_write_struct(&png_ptr, &info_ptr);
 	if (rc < 0)
 		free(state.buffer);
@@ -1004,15 +1054,14 @@ static void read_data_memory(png_structp png_ptr, png_bytep data, size_t length)
 static void* winpr_read_png_from_buffer(const void* data, size_t SrcSize, size_t* pSize,
                                         UINT32* pWidth, UINT32* pHeight, UINT32* pBpp)
 {
-	void* rc = NULL;
+	BYTE* volatile rc = NULL;
+	png_bytep* volatile row_pointers = NULL;
 	png_uint_32 width = 0;
 	png_uint_32 height = 0;
 	int bit_depth = 0;
 	int color_type = 0;
 	int interlace_type = 0;
-	int transforms = PNG_TRANSFORM_IDENTITY;
 	MEMORY_READER_STATE memory_reader_state = { 0 };
-	png_bytepp row_pointers = NULL;
 	png_infop info_ptr = NULL;
 	if (SrcSize > UINT32_MAX)
 		return NULL;
@@ -1024,14 +1073,23 @@ static void* winpr_read_png_from_buffer(const void* data, size_t SrcSize, size_t
 	if (!info_ptr)
 		goto fail;
 
+	if (setjmp(png_jmpbuf(png_ptr)))
+	{
+		free(rc);
+		rc = NULL;
+		goto fail;
+	}
+
 	memory_reader_state.buffer = WINPR_CAST_CONST_PTR_AWAY(data, png_bytep);
 	memory_reader_state.bufsize = (UINT32)SrcSize;
 	memory_reader_state.current_pos = 0;
 
 	png_set_read_fn(png_ptr, &memory_reader_state, read_data_memory);
 
-	transforms |= PNG_TRANSFORM_BGR;
-	png_read_png(png_ptr, info_ptr, transforms, NULL);
+	png_read_info(png_ptr, info_ptr);
+	png_set_bgr(png_ptr);
+	(void)png_set_interlace_handling(png_ptr);
+	png_read_update_info(png_ptr, info_ptr);
 
 	if (png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type,
 	                 NULL, NULL) != 1)
@@ -1040,35 +1098,91 @@ static void* winpr_read_png_from_buffer(const void* data, size_t SrcSize, size_t
 	WINPR_ASSERT(bit_depth >= 0);
 	const png_byte channelcount = png_get_channels(png_ptr, info_ptr);
 	const size_t bpp = channelcount * (size_t)bit_depth;
+	const size_t stride = 1ULL * width * bpp / 8ull;
+	const size_t png_stride = png_get_rowbytes(png_ptr, info_ptr);
+
+	if ((stride == 0) || (height == 0) || (png_stride < stride) ||
+	    (png_stride > SIZE_MAX / height))
+		goto fail;
+
+	/* decode straight into the result instead of copying from rows libpng allocated */
+	rc = malloc(png_stride * height);
+	row_pointers = png_malloc(png_ptr, height * sizeof(png_bytep));
+	if (!rc)
+		goto fail;
 
-	row_pointers = png_get_rows(png_ptr, info_ptr);
-	if (row_pointers)
+	for (png_uint_32 y = 0; y < height; y++)
+		row_pointers[y] = &rc[y * png_stride];
+
+	png_read_image(png_ptr, row_pointers);
+	png_read_end(png_ptr, NULL);
+
+	/* the result is packed, png rows are padded for bit depths below 8 */
+	if (png_stride != stride)
 	{
-		const size_t stride = 1ULL * width * bpp / 8ull;
-		const size_t png_stride = png_get_rowbytes(png_ptr, info_ptr);
-		const size_t size = 1ULL * width * height * bpp / 8ull;
-		const size_t copybytes = stride > png_stride ? png_stride : stride;
+		for (png_uint_32 y = 1; y < height; y++)
+			memmove(&rc[y * stride], &rc[y * png_stride], stride);
+	}
+
+	*pSize = stride * height;
+	*pWidth = width;
+	*pHeight = height;
+	WINPR_ASSERT(bpp <= UINT32_MAX);
+	*pBpp = (UINT32)bpp;
+
+fail:
+	if (png_ptr)
+		png_free(png_ptr, (void*)row_pointers);
+	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+	return rc;
+}
+#endif
 
-		rc = malloc(size);
-		if (rc)
+#if defined(WITH_LODEPNG)
+/**
+ * Copies width pixels of 24 or 32 bpp from src to dst swapping the red and blue channels,
+ * lodepng works on RGB(A) while winpr images are BGR(A). src and dst may be identical.
+ */
+static void image_swap_red_blue(BYTE* dst, const BYTE* src, size_t width, size_t bytesPerPixel)
+{
+	size_t x = 0;
+
+	if (bytesPerPixel == 4)
+	{
+#if defined(IMAGE_SSE2)
+		const __m128i ga = _mm_set1_epi32((int)0xFF00FF00);
+		const __m128i c0 = _mm_set1_epi32(0x000000FF);
+		for (; x + 4 <= width; x += 4)
 		{
-			char* cur = rc;
-			for (png_uint_32 i = 0; i < height; i++)
-			{
-				memcpy(cur, row_pointers[i], copybytes);
-				cur += stride;
-			}
-			*pSize = size;
-			*pWidth = width;
-			*pHeight = height;
-			WINPR_ASSERT(bpp <= UINT32_MAX);
-			*pBpp = (UINT32)bpp;
+			const __m128i v = _mm_loadu_si128((const __m128i*)&src[4 * x]);
+			const __m128i rb = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), c0),
+			                                _mm_slli_epi32(_mm_and_si128(v, c0), 16));
+			_mm_storeu_si128((__m128i*)&dst[4 * x], _mm_or_si128(_mm_and_si128(v, ga), rb));
 		}
+#elif defined(IMAGE_NEON)
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16x4_t v = vld4q_u8(&src[4 * x]);
+			const uint8x16_t b = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = b;
+			vst4q_u8(&dst[4 * x], v);
+		}
+#endif
 	}
-fail:
 
-	png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-	return rc;
+	for (; x < width; x++)
+	{
+		const BYTE* s = &src[bytesPerPixel * x];
+		BYTE* d = &dst[bytesPerPixel * x];
+		const BYTE b = s[0];
+
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = b;
+		if (bytesPerPixel == 4)
+			d[3] = s[3];
+	}
 }
 #endif
 
@@ -1095,19 +1209,39 @@ static void* winpr_convert_to_png(WINPR_ATTR_UNUSED const void* data, WINPR_ATTR
 		size_t dstsize = 0;
 		unsigned rc = 1;
 
-		switch (bpp)
+		if ((bpp != 24) && (bpp != 32))
+			return NULL;
+
+		/* lodepng expects packed RGB(A) rows */
+		const size_t bytesPerPixel = bpp / 8;
+		const size_t packed = 1ull * width * bytesPerPixel;
+		if ((stride < packed) || (size < 1ull * stride * height))
+			return NULL;
+
+		const BYTE* src = data;
+		BYTE* rgb = calloc(height, packed);
+		if (!rgb)
+			return NULL;
+		for (size_t y = 0; y < height; y++)
+			image_swap_red_blue(&rgb[y * packed], &src[y * stride], width, bytesPerPixel);
+
+		LodePNGState state = { 0 };
+		lodepng_state_init(&state);
+		state.info_raw.colortype = (bpp == 32) ? LCT_RGBA : LCT_RGB;
+		state.info_png.color.colortype = state.info_raw.colortype;
+		/* trade size for speed, like the libpng encoder */
+		state.encoder.filter_strategy = LFS_ZERO;
+		state.encoder.zlibsettings.windowsize = 2048;
+		state.encoder.zlibsettings.lazymatching = 0;
+		rc = lodepng_encode(&dst, &dstsize, rgb, width, height, &state);
+		lodepng_state_cleanup(&state);
+		free(rgb);
+
+		if (rc || (dstsize > UINT32_MAX))
 		{
-			case 32:
-				rc = lodepng_encode32(&dst, &dstsize, data, width, height);
-				break;
-			case 24:
-				rc = lodepng_encode24(&dst, &dstsize, data, width, height);
-				break;
-			default:
-				break;
-		}
-		if (rc)
+			free(dst);
 			return NULL;
+		}
 		*pSize = (UINT32)dstsize;
 		return dst;
 	}
@@ -1132,8 +1266,17 @@ SSIZE_T winpr_convert_from_png(WINPR_ATTR_UNUSED const BYTE* comp_data,
 	return (SSIZE_T)len;
 #elif defined(WITH_LODEPNG)
 	*bpp = 32;
-	return lodepng_decode32((unsigned char**)ppdecomp_data, width, height, comp_data,
-	                        comp_data_bytes);
+	if (lodepng_decode32((unsigned char**)ppdecomp_data, width, height, comp_data,
+	                     comp_data_bytes) != 0)
+		return -1;
+
+	const size_t stride = 4ull * *width;
+	for (size_t y = 0; y < *height; y++)
+	{
+		BYTE* line = &(*ppdecomp_data)[y * stride];
+		image_swap_red_blue(line, line, *width, 4);
+	}
+	return (SSIZE_T)(stride * *height);
 #else
 	WLog_WARN(TAG, "PNG not supported in this build");
 	return -1;
@@ -31,4 +31,7 @@ BOOL writeBitmapFileHeader(wStream* s, const WINPR_BITMAP_FILE_HEADER* bf);
 BOOL readBitmapInfoHeader(wStream* s, WINPR_BITMAP_INFO_HEADER* bi, size_t* poffset);
 BOOL writeBitmapInfoHeader(wStream* s, const WINPR_BITMAP_INFO_HEADER* bi);
 
+/** Decode a CF_DIB (BITMAPINFO followed by the bits) without a BITMAPFILEHEADER in front */
+int winpr_image_read_dib_buffer(wImage* image, const BYTE* buffer, size_t size);
+
 #endif /* LIBWINPR_UTILS_IMAGE_H */
@@ -328,6 +328,19 @@ int TestASN1Write(int argc, char* argv[])
 			goto out;
 	}
 
+	/* a reset encoder must produce the same output as a fresh one */
+	WinPrAsn1Encoder_Reset(enc);
+	Stream_SetPosition(s, 0);
+
+	retCode = 206;
+	if (WinPrAsn1EncInteger(enc, 2) != 3)
+		goto out;
+
+	retCode = 207;
+	if (!WinPrAsn1EncToStream(enc, s) || Stream_GetPosition(s) != sizeof(integerContent) ||
+	    memcmp(Stream_Buffer(s), integerContent, sizeof(integerContent)) != 0)
+		goto out;
+
 	retCode = 0;
 
 out:
@@ -3,6 +3,55 @@
 #include <winpr/stream.h>
 #include <winpr/collections.h>
 
+/* fixed size buffers come from slabs, they must be aligned and must not overlap */
+static BOOL test_fixed_size(void)
+{
+	BOOL rc = FALSE;
+	BYTE* buffers[100] = { 0 };
+	const size_t size = 1000;
+
+	wBufferPool* pool = BufferPool_New(TRUE, (SSIZE_T)size, 16);
+	if (!pool)
+		return FALSE;
+
+	for (size_t round = 0; round < 2; round++)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(buffers); x++)
+		{
+			buffers[x] = BufferPool_Take(pool, -1);
+			if (!buffers[x] || (((ULONG_PTR)buffers[x] % 16) != 0))
+				goto fail;
+			memset(buffers[x], (int)x, size);
+		}
+
+		for (size_t x = 0; x < ARRAYSIZE(buffers); x++)
+		{
+			for (size_t y = 0; y < size; y++)
+			{
+				if (buffers[x][y] != (BYTE)x)
+					goto fail;
+			}
+		}
+
+		for (size_t x = 0; x < ARRAYSIZE(buffers); x++)
+		{
+			if (!BufferPool_Return(pool, buffers[x]))
+				goto fail;
+			buffers[x] = NULL;
+		}
+
+		if (BufferPool_GetPoolSize(pool) < (SSIZE_T)ARRAYSIZE(buffers))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(buffers); x++)
+		BufferPool_Return(pool, buffers[x]);
+	BufferPool_Free(pool);
+	return rc;
+}
+
 int TestBufferPool(int argc, char* argv[])
 {
 	DWORD PoolSize = 0;
@@ -64,5 +113,8 @@ int TestBufferPool(int argc, char* argv[])
 
 	BufferPool_Free(pool);
 
+	if (!test_fixed_size())
+		return -1;
+
 	return 0;
 }
@@ -431,6 +431,71 @@ out:
 	return retCode;
 }
 
+#define STRESS_COUNT 10000
+
+static BOOL foreachRemoveFn(const void* key, void* value, void* arg)
+{
+	wHashTable* table = arg;
+	WINPR_UNUSED(value);
+
+	if (((ULONG_PTR)key % 3) == 0)
+		return HashTable_Remove(table, key);
+	return TRUE;
+}
+
+static BOOL check_stress_keys(wHashTable* table, size_t step, size_t skip)
+{
+	size_t count = 0;
+
+	for (ULONG_PTR x = 1; x <= STRESS_COUNT; x++)
+	{
+		const BOOL expected = ((x % step) == 0) && ((skip == 0) || ((x % skip) != 0));
+		void* value = HashTable_GetItemValue(table, (void*)x);
+		if (expected != (value == (void*)(x + 1)))
+			return FALSE;
+		if (expected)
+			count++;
+	}
+	return HashTable_Count(table) == count;
+}
+
+/* grows the table and removes entries directly and from within a foreach */
+static int test_hash_stress(void)
+{
+	int rc = -1;
+	wHashTable* table = HashTable_New(TRUE);
+	if (!table)
+		return -1;
+
+	for (ULONG_PTR x = 1; x <= STRESS_COUNT; x++)
+	{
+		if (!HashTable_Insert(table, (void*)x, (void*)(x + 1)))
+			goto fail;
+	}
+	if (!check_stress_keys(table, 1, 0))
+		goto fail;
+
+	for (ULONG_PTR x = 1; x <= STRESS_COUNT; x += 2)
+	{
+		if (!HashTable_Remove(table, (void*)x))
+			goto fail;
+	}
+	if (!check_stress_keys(table, 2, 0))
+		goto fail;
+
+	if (!HashTable_Foreach(table, foreachRemoveFn, table) || !check_stress_keys(table, 2, 3))
+		goto fail;
+
+	HashTable_Clear(table);
+	if ((HashTable_Count(table) != 0) || HashTable_Contains(table, (void*)2))
+		goto fail;
+
+	rc = 0;
+fail:
+	HashTable_Free(table);
+	return rc;
+}
+
 int TestHashTable(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -444,5 +509,8 @@ int TestHashTable(int argc, char* argv[])
 
 	if (test_hash_foreach() < 0)
 		return 3;
+
+	if (test_hash_stress() < 0)
+		return 4;
 	return 0;
 }
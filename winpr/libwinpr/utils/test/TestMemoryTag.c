@@ -0,0 +1,118 @@
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/collections.h>
+
+static BOOL test_counters(void)
+{
+	wMemoryTagStatistics stats = { 0 };
+	wMemoryTag* tag = MemoryTag_Get("test_counters");
+	if (!tag || (MemoryTag_Get("test_counters") != tag))
+		return FALSE;
+	if (strcmp(MemoryTag_Name(tag), "test_counters") != 0)
+		return FALSE;
+
+	void* a = MemoryTag_Malloc(tag, 100);
+	void* b = MemoryTag_Calloc(tag, 10, 20);
+	if (!a || !b)
+		goto fail;
+	MemoryTag_Free(tag, a, 100);
+	a = NULL;
+
+	if (!MemoryTag_GetStatistics(tag, &stats))
+		goto fail;
+	if ((stats.live != 200) || (stats.peak != 300) || (stats.allocations != 2) ||
+	    (stats.allocated != 300))
+	{
+		printf("unexpected statistics: live %" PRIu64 " peak %" PRIu64 " allocations %" PRIu64
+		       " allocated %" PRIu64 "\n",
+		       stats.live, stats.peak, stats.allocations, stats.allocated);
+		goto fail;
+	}
+
+	MemoryTag_Free(tag, b, 200);
+	if (!MemoryTag_GetStatistics(tag, &stats) || (stats.live != 0) || (stats.peak != 300))
+		return FALSE;
+
+	/* a NULL tag only skips the accounting */
+	MemoryTag_Allocated(NULL, 10);
+	MemoryTag_Free(NULL, MemoryTag_Malloc(NULL, 10), 10);
+	return !MemoryTag_GetStatistics(NULL, &stats);
+
+fail:
+	MemoryTag_Free(tag, a, 100);
+	MemoryTag_Free(tag, b, 200);
+	return FALSE;
+}
+
+static BOOL test_foreach_cb(const char* name, const wMemoryTagStatistics* stats, void* arg)
+{
+	BOOL* found = arg;
+	if (strcmp(name, "test_counters") == 0)
+		*found = (stats->allocations == 2);
+	return TRUE;
+}
+
+static BOOL test_foreach(void)
+{
+	BOOL found = FALSE;
+	if (!MemoryTag_Foreach(test_foreach_cb, &found))
+		return FALSE;
+	return found;
+}
+
+static BOOL test_pools(void)
+{
+	BOOL rc = FALSE;
+	wMemoryTagStatistics stats = { 0 };
+	wMemoryTag* tag = MemoryTag_Get("test_pools");
+	wBufferPool* bpool = BufferPool_New(TRUE, 1024, 16);
+	wStreamPool* spool = StreamPool_New(TRUE, 4096);
+	if (!tag || !bpool || !spool)
+		goto fail;
+
+	BufferPool_SetMemoryTag(bpool, tag);
+	StreamPool_SetMemoryTag(spool, tag);
+
+	void* buffer = BufferPool_Take(bpool, -1);
+	wStream* s = StreamPool_Take(spool, 0);
+	if (!buffer || !s)
+		goto fail;
+
+	/* memory handed out stays accounted to the pool */
+	if (!MemoryTag_GetStatistics(tag, &stats) || (stats.live < 1024 + 4096))
+		goto fail;
+
+	BufferPool_Return(bpool, buffer);
+	Stream_Release(s);
+	BufferPool_Free(bpool);
+	StreamPool_Free(spool);
+	bpool = NULL;
+	spool = NULL;
+
+	if (!MemoryTag_GetStatistics(tag, &stats) || (stats.live != 0))
+	{
+		printf("pool memory still accounted: %" PRIu64 "\n", stats.live);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	BufferPool_Free(bpool);
+	StreamPool_Free(spool);
+	return rc;
+}
+
+int TestMemoryTag(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_counters())
+		return -1;
+	if (!test_foreach())
+		return -1;
+	if (!test_pools())
+		return -1;
+	return 0;
+}
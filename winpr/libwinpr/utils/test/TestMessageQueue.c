@@ -1,6 +1,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/thread.h>
+#include <winpr/interlocked.h>
 #include <winpr/collections.h>
 
 static DWORD WINAPI message_queue_consumer_thread(LPVOID arg)
@@ -22,6 +23,96 @@ static DWORD WINAPI message_queue_consumer_thread(LPVOID arg)
 	return 0;
 }
 
+#define TEST_PRODUCERS 4
+#define TEST_MESSAGES 10000
+
+static DWORD WINAPI message_queue_producer_thread(LPVOID arg)
+{
+	wMessageQueue* queue = (wMessageQueue*)arg;
+	static LONG producers = 0;
+	const size_t producer = (size_t)InterlockedIncrement(&producers) - 1;
+
+	for (size_t x = 0; x < TEST_MESSAGES; x++)
+	{
+		if (!MessageQueue_Post(queue, NULL, (UINT32)producer, (void*)x, NULL))
+			return 1;
+	}
+
+	return 0;
+}
+
+static size_t freed = 0;
+
+static void message_free(void* obj)
+{
+	WINPR_UNUSED(obj);
+	freed++;
+}
+
+static BOOL test_single_consumer(void)
+{
+	BOOL rc = FALSE;
+	size_t received = 0;
+	size_t next[TEST_PRODUCERS] = { 0 };
+	HANDLE threads[TEST_PRODUCERS] = { 0 };
+	wObject cb = { 0 };
+
+	cb.fnObjectFree = message_free;
+	wMessageQueue* queue = MessageQueue_NewEx(&cb, WMQ_FLAG_SINGLE_CONSUMER);
+	if (!queue)
+		return FALSE;
+
+	for (size_t x = 0; x < TEST_PRODUCERS; x++)
+	{
+		if (!(threads[x] =
+		          CreateThread(NULL, 0, message_queue_producer_thread, (void*)queue, 0, NULL)))
+			goto fail;
+	}
+
+	/* messages of each producer arrive in order */
+	while (received < TEST_PRODUCERS * TEST_MESSAGES)
+	{
+		wMessage message = { 0 };
+
+		if (MessageQueue_Get(queue, &message) != 1)
+			goto fail;
+		if ((message.id >= TEST_PRODUCERS) || ((size_t)message.wParam != next[message.id]))
+		{
+			printf("unexpected message %" PRIu32 ":%" PRIuz "\n", message.id,
+			       (size_t)message.wParam);
+			goto fail;
+		}
+		next[message.id]++;
+		received++;
+	}
+
+	if ((MessageQueue_Size(queue) != 0) || (WaitForSingleObject(MessageQueue_Event(queue), 0) !=
+	                                        WAIT_TIMEOUT))
+		goto fail;
+
+	/* nothing can be posted after WMQ_QUIT until the queue is cleared */
+	if (!MessageQueue_Post(queue, NULL, 1, NULL, NULL) || !MessageQueue_PostQuit(queue, 0) ||
+	    MessageQueue_Post(queue, NULL, 2, NULL, NULL) || (MessageQueue_Size(queue) != 2))
+		goto fail;
+
+	MessageQueue_Clear(queue);
+	if ((freed != 2) || !MessageQueue_Post(queue, NULL, 3, NULL, NULL))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < TEST_PRODUCERS; x++)
+	{
+		if (threads[x])
+		{
+			(void)WaitForSingleObject(threads[x], INFINITE);
+			(void)CloseHandle(threads[x]);
+		}
+	}
+	MessageQueue_Free(queue);
+	return rc && (freed == 3);
+}
+
 int TestMessageQueue(int argc, char* argv[])
 {
 	HANDLE thread = NULL;
@@ -52,5 +143,8 @@ int TestMessageQueue(int argc, char* argv[])
 	MessageQueue_Free(queue);
 	(void)CloseHandle(thread);
 
+	if (!test_single_consumer())
+		return -1;
+
 	return 0;
 }
@@ -803,6 +803,45 @@ out:
 	return rc;
 }
 
+static BOOL TestStream_Span(void)
+{
+	const BYTE data[] = { 0x01, 0x02, 0x03, 0xFE, 0xFF, 0x11, 0x22, 0x33, 0x44,
+		                  0x12, 0x34, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB };
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticConstInit(&sbuffer, data, sizeof(data));
+	wStreamSpan span = { 0 };
+
+	if (Stream_GetSpan(s, sizeof(data) + 1, &span) || (Stream_GetPosition(s) != 0))
+		return FALSE;
+
+	if (!Stream_GetSpan(s, 11, &span) || (Stream_GetPosition(s) != 11))
+		return FALSE;
+
+	if (StreamSpan_Get_UINT8(&span) != 0x01)
+		return FALSE;
+	if (StreamSpan_Get_UINT16(&span) != 0x0302)
+		return FALSE;
+	StreamSpan_Seek(&span, 1);
+	if (StreamSpan_Get_UINT32(&span) != 0x332211FF)
+		return FALSE;
+	if (StreamSpan_Get_UINT16_BE(&span) != 0x4412)
+		return FALSE;
+	if ((StreamSpan_GetRemainingLength(&span) != 1) || (*StreamSpan_Pointer(&span) != 0x34))
+		return FALSE;
+	StreamSpan_Seek(&span, 1);
+	if (StreamSpan_GetRemainingLength(&span) != 0)
+		return FALSE;
+
+	/* the remaining bytes were not taken by the span */
+	if (!Stream_CheckAndLogRequiredSpan("TestStream", s, 7, &span))
+		return FALSE;
+	if (StreamSpan_Get_INT16(&span) != (INT16)0x6655)
+		return FALSE;
+	if (StreamSpan_Get_UINT32_BE(&span) != 0x778899AA)
+		return FALSE;
+	return Stream_GetRemainingLength(s) == 0;
+}
+
 int TestStream(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -847,6 +886,9 @@ int TestStream(int argc, char* argv[])
 	if (!TestStream_WriteAndRead(0x1234567890abcdef))
 		return 13;
 
+	if (!TestStream_Span())
+		return 15;
+
 	for (size_t x = 0; x < 10; x++)
 	{
 		UINT64 val = 0;
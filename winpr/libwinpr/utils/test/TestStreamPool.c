@@ -5,6 +5,39 @@
 
 #define BUFFER_SIZE 16384
 
+/* streams of any size are reused by requests they fit */
+static BOOL test_size_classes(void)
+{
+	BOOL rc = FALSE;
+	wStreamPool* pool = StreamPool_New(TRUE, BUFFER_SIZE);
+	if (!pool)
+		return FALSE;
+
+	wStream* a = StreamPool_Take(pool, 3000);
+	wStream* b = StreamPool_Take(pool, 5000);
+	if (!a || !b || (Stream_Capacity(a) < 3000) || (Stream_Capacity(b) < 5000))
+		goto fail;
+
+	const BYTE* pa = Stream_Buffer(a);
+	const BYTE* pb = Stream_Buffer(b);
+	Stream_Release(a);
+	Stream_Release(b);
+
+	a = StreamPool_Take(pool, 4096);
+	b = StreamPool_Take(pool, 2000);
+	if (!a || !b || (Stream_Buffer(a) != pa) || (Stream_Buffer(b) != pb) ||
+	    (StreamPool_UsedCount(pool) != 2))
+		goto fail;
+
+	Stream_Release(a);
+	Stream_Release(b);
+	rc = StreamPool_UsedCount(pool) == 0;
+
+fail:
+	StreamPool_Free(pool);
+	return rc;
+}
+
 int TestStreamPool(int argc, char* argv[])
 {
 	wStream* s[5] = { 0 };
@@ -78,5 +111,8 @@ int TestStreamPool(int argc, char* argv[])
 
 	StreamPool_Free(pool);
 
+	if (!test_size_classes())
+		return -1;
+
 	return 0;
 }
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/wlog.h>
+
+#define TEST_THREADS 4
+#define TEST_MESSAGES 1000
+
+static const char* channels[TEST_THREADS] = { "com.test.async0", "com.test.async1",
+	                                          "com.test.async2", "com.test.async3" };
+
+static int next[TEST_THREADS] = { 0 };
+static BOOL success = TRUE;
+static HANDLE blocked = NULL;
+
+static BOOL check(const wLogMessage* msg)
+{
+	unsigned thread = 0;
+	int index = 0;
+
+	if (strcmp(msg->FormatString, "%u: %d") != 0)
+		goto fail;
+	if (sscanf(msg->TextString, "%u: %d", &thread, &index) != 2)
+		goto fail;
+	if ((thread >= TEST_THREADS) || (strcmp(msg->PrefixString, channels[thread]) != 0))
+		goto fail;
+
+	/* messages of one thread keep their order */
+	if (index != next[thread]++)
+		goto fail;
+	return TRUE;
+
+fail:
+	(void)fprintf(stderr, "unexpected message '%s' '%s'\n", msg->PrefixString, msg->TextString);
+	success = FALSE;
+	return FALSE;
+}
+
+static BOOL CallbackAppenderMessage(const wLogMessage* msg)
+{
+	if (blocked)
+		(void)WaitForSingleObject(blocked, INFINITE);
+	return check(msg);
+}
+
+static DWORD WINAPI test_thread(LPVOID arg)
+{
+	const unsigned thread = (unsigned)(size_t)arg;
+	wLog* log = WLog_Get(channels[thread]);
+
+	for (int x = 0; x < TEST_MESSAGES; x++)
+		WLog_Print(log, WLOG_INFO, "%u: %d", thread, x);
+	return 0;
+}
+
+static BOOL wait_written(wLog* root, UINT64 count)
+{
+	const UINT64 start = GetTickCount64();
+	UINT64 written = 0;
+
+	while (WLog_GetAsyncStats(root, &written, NULL) && (written != count))
+	{
+		if (GetTickCount64() - start > 5000)
+			return FALSE;
+		Sleep(1);
+	}
+	return written == count;
+}
+
+static BOOL test_threads(wLog* root)
+{
+	HANDLE threads[TEST_THREADS] = { 0 };
+	UINT64 written = 0;
+	UINT64 dropped = 0;
+
+	if (!WLog_SetAsync(root, TEST_THREADS * TEST_MESSAGES))
+		return FALSE;
+
+	for (size_t x = 0; x < ARRAYSIZE(threads); x++)
+	{
+		threads[x] = CreateThread(NULL, 0, test_thread, (void*)x, 0, NULL);
+		if (!threads[x])
+			return FALSE;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(threads); x++)
+	{
+		(void)WaitForSingleObject(threads[x], INFINITE);
+		(void)CloseHandle(threads[x]);
+	}
+
+	if (!wait_written(root, TEST_THREADS * TEST_MESSAGES))
+		return FALSE;
+	if (!WLog_GetAsyncStats(root, &written, &dropped) || (dropped != 0))
+		return FALSE;
+	if (!WLog_SetAsync(root, 0) || WLog_GetAsyncStats(root, NULL, NULL))
+		return FALSE;
+
+	for (size_t x = 0; x < ARRAYSIZE(next); x++)
+	{
+		if (next[x] != TEST_MESSAGES)
+			return FALSE;
+	}
+	return success;
+}
+
+static BOOL test_overflow(wLog* root)
+{
+	UINT64 dropped = 0;
+	wLog* log = WLog_Get(channels[0]);
+
+	next[0] = 0;
+	blocked = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!blocked || !WLog_SetAsync(root, 2))
+		return FALSE;
+
+	/* the writer is stuck in the appender, only two messages fit into the queue */
+	for (int x = 0; x < 10; x++)
+		WLog_Print(log, WLOG_INFO, "%u: %d", 0, x);
+
+	if (!WLog_GetAsyncStats(root, NULL, &dropped) || (dropped != 8))
+		return FALSE;
+
+	(void)SetEvent(blocked);
+	if (!wait_written(root, 2))
+		return FALSE;
+	if (!WLog_SetAsync(root, 0))
+		return FALSE;
+
+	(void)CloseHandle(blocked);
+	blocked = NULL;
+	return success && (next[0] == 2);
+}
+
+int TestWLogAsync(int argc, char* argv[])
+{
+	wLogCallbacks callbacks = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	wLog* root = WLog_GetRoot();
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_CALLBACK))
+		return -1;
+
+	callbacks.message = CallbackAppenderMessage;
+	if (!WLog_ConfigureAppender(WLog_GetLogAppender(root), "callbacks", (void*)&callbacks))
+		return -1;
+
+	if (!WLog_Layout_SetPrefixFormat(root, WLog_GetLogLayout(root), "%mn"))
+		return -1;
+	if (!WLog_OpenAppender(root))
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(channels); x++)
+		WLog_SetLogLevel(WLog_Get(channels[x]), WLOG_TRACE);
+
+	if (!test_threads(root))
+		return -1;
+	if (!test_overflow(root))
+		return -1;
+
+	WLog_CloseAppender(root);
+	return 0;
+}
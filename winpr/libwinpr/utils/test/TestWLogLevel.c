@@ -0,0 +1,86 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/wlog.h>
+
+#define TAG "com.test.level"
+
+static size_t messages = 0;
+static size_t evaluated = 0;
+
+static BOOL CallbackAppenderMessage(const wLogMessage* msg)
+{
+	WINPR_UNUSED(msg);
+	messages++;
+	return TRUE;
+}
+
+static int argument(void)
+{
+	evaluated++;
+	return 42;
+}
+
+static BOOL check(const char* what, size_t expected)
+{
+	const size_t before = messages;
+
+	/* built with WITH_WLOG_MIN_LEVEL above DEBUG */
+	if (!WLOG_LEVEL_COMPILED(WLOG_DEBUG))
+		expected = 0;
+
+	WLog_DBG(TAG, "debug %d", argument());
+	if (messages - before != expected)
+	{
+		(void)fprintf(stderr, "%s: got %" PRIuz " messages, expected %" PRIuz "\n", what,
+		              messages - before, expected);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+int TestWLogLevel(int argc, char* argv[])
+{
+	wLogCallbacks callbacks = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	wLog* root = WLog_GetRoot();
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_CALLBACK))
+		return -1;
+
+	callbacks.message = CallbackAppenderMessage;
+	if (!WLog_ConfigureAppender(WLog_GetLogAppender(root), "callbacks", (void*)&callbacks))
+		return -1;
+	if (!WLog_OpenAppender(root))
+		return -1;
+
+	wLog* log = WLog_Get(TAG);
+	if (!log || !WLog_SetLogLevel(root, WLOG_INFO))
+		return -1;
+
+	/* disabled statements do not evaluate their arguments */
+	if (!check("info", 0) || (evaluated != 0))
+		return -1;
+
+	/* the cached level follows changes of the parent */
+	if (!WLog_SetLogLevel(root, WLOG_DEBUG) || !check("inherited debug", 1))
+		return -1;
+	if (!WLog_SetLogLevel(log, WLOG_ERROR) || !check("error", 0))
+		return -1;
+	if (!WLog_SetLogLevel(log, WLOG_TRACE) || !check("trace", 1))
+		return -1;
+	if (!WLog_SetLogLevel(log, WLOG_OFF) || !check("off", 0))
+		return -1;
+
+	/* and filters */
+	if (!WLog_AddStringLogFilters(TAG ":DEBUG") || !check("filter", 1))
+		return -1;
+
+	if (!WLog_IsLevelActive(log, WLOG_DEBUG) || WLog_IsLevelActive(log, WLOG_TRACE))
+		return -1;
+
+	WLog_CloseAppender(root);
+	return 0;
+}
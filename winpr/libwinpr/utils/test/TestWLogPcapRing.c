@@ -0,0 +1,143 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/endian.h>
+#include <winpr/environment.h>
+#include <winpr/wlog.h>
+
+#define TEST_RING_MIB 1
+#define TEST_SESSIONS 3
+
+static BYTE* read_file(const char* name, size_t* size)
+{
+	BYTE* data = NULL;
+	FILE* fp = winpr_fopen(name, "rb");
+	if (!fp)
+		return NULL;
+
+	if (_fseeki64(fp, 0, SEEK_END) != 0)
+		goto fail;
+	const INT64 length = _ftelli64(fp);
+	if ((length <= 0) || (_fseeki64(fp, 0, SEEK_SET) != 0))
+		goto fail;
+
+	data = malloc((size_t)length);
+	if (!data || (fread(data, (size_t)length, 1, fp) != 1))
+	{
+		free(data);
+		data = NULL;
+		goto fail;
+	}
+	*size = (size_t)length;
+
+fail:
+	(void)fclose(fp);
+	return data;
+}
+
+/* the whole file must consist of valid blocks, a reader stops at the first broken one */
+static BOOL check_capture(const BYTE* data, size_t size, size_t* interfaces, size_t* packets)
+{
+	size_t offset = 0;
+
+	if ((size != TEST_RING_MIB * 1024 * 1024) || (winpr_Data_Get_UINT32(data) != 0x0A0D0D0A) ||
+	    (winpr_Data_Get_UINT32(&data[8]) != 0x1A2B3C4D))
+		return FALSE;
+
+	while (offset < size)
+	{
+		if (size - offset < 12)
+			return FALSE;
+
+		const UINT32 type = winpr_Data_Get_UINT32(&data[offset]);
+		const UINT32 length = winpr_Data_Get_UINT32(&data[offset + 4]);
+		if ((length < 12) || ((length % 4) != 0) || (length > size - offset) ||
+		    (winpr_Data_Get_UINT32(&data[offset + length - 4]) != length))
+		{
+			(void)fprintf(stderr, "invalid block at %" PRIuz "\n", offset);
+			return FALSE;
+		}
+
+		if (type == 1)
+			(*interfaces)++;
+		else if (type == 6)
+		{
+			const UINT32 id = winpr_Data_Get_UINT32(&data[offset + 8]);
+			const UINT32 captured = winpr_Data_Get_UINT32(&data[offset + 20]);
+			if ((id >= *interfaces) || (captured + 32 > length))
+				return FALSE;
+			(*packets)++;
+		}
+
+		offset += length;
+	}
+
+	return TRUE;
+}
+
+int TestWLogPcapRing(int argc, char* argv[])
+{
+	int rc = -1;
+	char* path = NULL;
+	char* name = NULL;
+	BYTE* capture = NULL;
+	size_t size = 0;
+	size_t interfaces = 0;
+	size_t packets = 0;
+	BYTE packet[4000] = { 0 };
+	char filename[64] = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	wLog* root = WLog_GetRoot();
+	wLog* log = WLog_Get("com.test.pcap");
+	if (!SetEnvironmentVariableA("WLOG_PCAP_RING", "1"))
+		goto fail;
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_CONSOLE) || !WLog_OpenAppender(root))
+		goto fail;
+	if (!WLog_SetLogLevel(log, WLOG_TRACE))
+		goto fail;
+
+	/* about three times the ring size, with sizes that do not line up with old packets */
+	for (size_t x = 0; x < 3 * 1024; x++)
+	{
+		const size_t length = 1 + (x * 7919) % sizeof(packet);
+		const DWORD flags = ((x % 2) ? WLOG_PACKET_INBOUND : WLOG_PACKET_OUTBOUND) |
+		                    WLOG_PACKET_SESSION(1 + x % TEST_SESSIONS);
+		WLog_Packet(log, WLOG_TRACE, packet, length, flags);
+	}
+
+	/* closes the capture */
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_CONSOLE))
+		goto fail;
+
+	(void)_snprintf(filename, sizeof(filename), "%" PRIu32 ".pcapng", GetCurrentProcessId());
+	path = GetKnownSubPath(KNOWN_PATH_TEMP, "wlog");
+	name = GetCombinedPath(path, filename);
+	if (!name)
+		goto fail;
+
+	capture = read_file(name, &size);
+	if (!capture || !check_capture(capture, size, &interfaces, &packets))
+		goto fail;
+
+	/* session 0 is always there */
+	if ((interfaces != TEST_SESSIONS + 1) || (packets < 100) || (packets >= 3 * 1024))
+	{
+		(void)fprintf(stderr, "%" PRIuz " interfaces, %" PRIuz " packets\n", interfaces,
+		              packets);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (name)
+		(void)winpr_DeleteFile(name);
+	free(capture);
+	free(name);
+	free(path);
+	return rc;
+}
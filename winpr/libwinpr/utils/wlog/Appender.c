@@ -26,6 +26,10 @@ void WLog_Appender_Free(wLog* log, wLogAppender* appender)
 	if (!appender)
 		return;
 
+	/* queued messages are written before the appender goes away */
+	WLog_AsyncQueue_Free(appender->AsyncQueue);
+	appender->AsyncQueue = NULL;
+
 	if (appender->Layout)
 	{
 		WLog_Layout_Free(log, appender->Layout);
@@ -164,6 +168,38 @@ BOOL WLog_SetLogAppenderType(wLog* log, DWORD logAppenderType)
 	return log->Appender != NULL;
 }
 
+BOOL WLog_SetAsync(wLog* log, size_t capacity)
+{
+	wLog* owner = log;
+
+	while (owner && !owner->Appender)
+		owner = owner->Parent;
+
+	if (!owner)
+		return FALSE;
+
+	wLogAppender* appender = owner->Appender;
+	WLog_AsyncQueue_Free(appender->AsyncQueue);
+	appender->AsyncQueue = NULL;
+
+	if (capacity == 0)
+		return TRUE;
+
+	appender->AsyncQueue = WLog_AsyncQueue_New(owner, appender, capacity);
+	return appender->AsyncQueue != NULL;
+}
+
+BOOL WLog_GetAsyncStats(wLog* log, UINT64* written, UINT64* dropped)
+{
+	wLogAppender* appender = WLog_GetLogAppender(log);
+
+	if (!appender || !appender->AsyncQueue)
+		return FALSE;
+
+	WLog_AsyncQueue_GetStats(appender->AsyncQueue, written, dropped);
+	return TRUE;
+}
+
 BOOL WLog_ConfigureAppender(wLogAppender* appender, const char* setting, void* value)
 {
 	/* Just check the settings string is not empty */
@@ -35,5 +35,6 @@ void WLog_Appender_Free(wLog* log, wLogAppender* appender);
 #include "SyslogAppender.h"
 #endif
 #include "UdpAppender.h"
+#include "AsyncQueue.h"
 
 #endif /* WINPR_WLOG_APPENDER_PRIVATE_H */
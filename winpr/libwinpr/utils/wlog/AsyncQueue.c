@@ -0,0 +1,345 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+#include "AsyncQueue.h"
+
+/* A queued message, the strings are stored in the same allocation right after it */
+typedef struct s_wLogAsyncRecord
+{
+	struct s_wLogAsyncRecord* next;
+	DWORD level;
+	size_t line;
+	const char* file;
+	const char* function;
+	const char* format;
+	const char* text;
+	const char* prefix;
+} wLogAsyncRecord;
+
+enum
+{
+	ASYNC_IDLE,
+	ASYNC_STARTING,
+	ASYNC_RUNNING,
+	ASYNC_FAILED
+};
+
+/* Producers push records onto a lock free stack, the writer thread takes the whole stack
+ * at once and writes it in the order the records were pushed. */
+struct s_wLogAsyncQueue
+{
+	wLog* owner;
+	wLogAppender* appender;
+	LONG capacity;
+
+	PVOID volatile head;
+	LONG volatile pending;
+	LONG volatile state;
+	LONG volatile stop;
+	LONG volatile starter;
+	LONGLONG volatile written;
+	LONGLONG volatile dropped;
+
+	HANDLE event;
+	HANDLE thread;
+};
+
+static void async_add64(LONGLONG volatile* value, LONGLONG add)
+{
+	LONGLONG current = *value;
+
+	for (;;)
+	{
+		const LONGLONG previous = InterlockedCompareExchange64(value, current + add, current);
+		if (previous == current)
+			break;
+		current = previous;
+	}
+}
+
+static wLogAsyncRecord* async_take(wLogAsyncQueue* queue)
+{
+	WINPR_ASSERT(queue);
+
+	PVOID head = queue->head;
+	for (;;)
+	{
+		PVOID previous = InterlockedCompareExchangePointer(&queue->head, NULL, head);
+		if (previous == head)
+			break;
+		head = previous;
+	}
+
+	/* the stack is newest first */
+	wLogAsyncRecord* list = NULL;
+	wLogAsyncRecord* record = head;
+	while (record)
+	{
+		wLogAsyncRecord* next = record->next;
+		record->next = list;
+		list = record;
+		record = next;
+	}
+
+	return list;
+}
+
+static void async_write(wLogAsyncQueue* queue, wLogAsyncRecord* list)
+{
+	WINPR_ASSERT(queue);
+
+	if (!list)
+		return;
+
+	wLogAppender* appender = queue->appender;
+	LONGLONG written = 0;
+
+	EnterCriticalSection(&appender->lock);
+
+	while (list)
+	{
+		wLogAsyncRecord* record = list;
+		char prefix[WLOG_MAX_PREFIX_SIZE] = { 0 };
+		wLogMessage message = { 0 };
+
+		list = record->next;
+		message.Type = WLOG_MESSAGE_TEXT;
+		message.Level = record->level;
+		message.LineNumber = record->line;
+		message.FileName = record->file;
+		message.FunctionName = record->function;
+		message.FormatString = record->format;
+		message.TextString = record->text;
+		message.PrefixString = prefix;
+
+		if (appender->WriteMessage)
+		{
+			/* the appenders format their prefix through the layout, hand them the one
+			 * captured when the message was logged */
+			appender->Layout->QueuedPrefix = record->prefix;
+			appender->recursive = TRUE;
+			if (appender->WriteMessage(queue->owner, appender, &message))
+				written++;
+			appender->recursive = FALSE;
+			appender->Layout->QueuedPrefix = NULL;
+		}
+
+		free(record);
+		(void)InterlockedDecrement(&queue->pending);
+	}
+
+	LeaveCriticalSection(&appender->lock);
+	async_add64(&queue->written, written);
+}
+
+static DWORD WINAPI async_writer(LPVOID arg)
+{
+	wLogAsyncQueue* queue = arg;
+	WINPR_ASSERT(queue);
+
+	for (;;)
+	{
+		if (WaitForSingleObject(queue->event, INFINITE) != WAIT_OBJECT_0)
+			break;
+
+		/* reset before taking the stack, a record pushed after that signals again */
+		(void)ResetEvent(queue->event);
+		async_write(queue, async_take(queue));
+
+		if (InterlockedCompareExchange(&queue->stop, 0, 0))
+			break;
+	}
+
+	return 0;
+}
+
+/* The writer thread is started with the first queued message and not when the queue is
+ * created, the queue might be set up while the root logger is being initialized.
+ * Messages logged by the starting thread while it creates the writer are written directly,
+ * other threads wait for the writer to not reorder their messages. */
+static BOOL async_start(wLogAsyncQueue* queue)
+{
+	WINPR_ASSERT(queue);
+
+	LONG state = InterlockedCompareExchange(&queue->state, ASYNC_STARTING, ASYNC_IDLE);
+	if (state == ASYNC_IDLE)
+	{
+		(void)InterlockedExchange(&queue->starter, (LONG)GetCurrentThreadId());
+		queue->thread = CreateThread(NULL, 0, async_writer, queue, 0, NULL);
+		state = queue->thread ? ASYNC_RUNNING : ASYNC_FAILED;
+		(void)InterlockedExchange(&queue->state, state);
+	}
+
+	while (state == ASYNC_STARTING)
+	{
+		if (InterlockedCompareExchange(&queue->starter, 0, 0) == (LONG)GetCurrentThreadId())
+			return FALSE;
+		(void)SwitchToThread();
+		state = InterlockedCompareExchange(&queue->state, 0, 0);
+	}
+
+	return state == ASYNC_RUNNING;
+}
+
+static size_t async_strlen(const char* str)
+{
+	if (!str)
+		return 0;
+	return strlen(str) + 1;
+}
+
+static const char* async_copy(char** data, const char* str, size_t len)
+{
+	if (!str)
+		return NULL;
+
+	char* dst = *data;
+	memcpy(dst, str, len);
+	*data += len;
+	return dst;
+}
+
+BOOL WLog_AsyncQueue_Push(wLogAsyncQueue* queue, wLog* log, const wLogMessage* message)
+{
+	WINPR_ASSERT(queue);
+	WINPR_ASSERT(message);
+
+	if ((queue->state != ASYNC_RUNNING) && !async_start(queue))
+		return FALSE;
+
+	if (InterlockedIncrement(&queue->pending) > queue->capacity)
+	{
+		(void)InterlockedDecrement(&queue->pending);
+		async_add64(&queue->dropped, 1);
+		return TRUE;
+	}
+
+	/* time, thread and context of the prefix are only valid right now */
+	char prefix[WLOG_MAX_PREFIX_SIZE] = { 0 };
+	wLogMessage copy = *message;
+	copy.PrefixString = prefix;
+	if (!WLog_Layout_FormatMessagePrefix(log, queue->appender->Layout, &copy))
+		goto fail;
+
+	const size_t fileLen = async_strlen(message->FileName);
+	const size_t functionLen = async_strlen(message->FunctionName);
+	const size_t textLen = async_strlen(message->TextString);
+	const size_t formatLen =
+	    (message->FormatString == message->TextString) ? 0 : async_strlen(message->FormatString);
+	const size_t prefixLen = async_strlen(prefix);
+
+	wLogAsyncRecord* record = malloc(sizeof(wLogAsyncRecord) + fileLen + functionLen + textLen +
+	                                 formatLen + prefixLen);
+	if (!record)
+		goto fail;
+
+	char* data = (char*)&record[1];
+	record->level = message->Level;
+	record->line = message->LineNumber;
+	record->file = async_copy(&data, message->FileName, fileLen);
+	record->function = async_copy(&data, message->FunctionName, functionLen);
+	record->text = async_copy(&data, message->TextString, textLen);
+	if (formatLen == 0)
+		record->format = record->text;
+	else
+		record->format = async_copy(&data, message->FormatString, formatLen);
+	record->prefix = async_copy(&data, prefix, prefixLen);
+
+	PVOID head = queue->head;
+	for (;;)
+	{
+		record->next = head;
+		PVOID previous = InterlockedCompareExchangePointer(&queue->head, record, head);
+		if (previous == head)
+			break;
+		head = previous;
+	}
+
+	/* the writer takes the whole stack, it only needs a wakeup for the first record */
+	if (!head)
+		(void)SetEvent(queue->event);
+	return TRUE;
+
+fail:
+	(void)InterlockedDecrement(&queue->pending);
+	return FALSE;
+}
+
+void WLog_AsyncQueue_GetStats(wLogAsyncQueue* queue, UINT64* written, UINT64* dropped)
+{
+	WINPR_ASSERT(queue);
+
+	if (written)
+		*written = (UINT64)InterlockedCompareExchange64(&queue->written, 0, 0);
+	if (dropped)
+		*dropped = (UINT64)InterlockedCompareExchange64(&queue->dropped, 0, 0);
+}
+
+void WLog_AsyncQueue_Free(wLogAsyncQueue* queue)
+{
+	if (!queue)
+		return;
+
+	if (queue->thread)
+	{
+		(void)InterlockedExchange(&queue->stop, TRUE);
+		(void)SetEvent(queue->event);
+		(void)WaitForSingleObject(queue->thread, INFINITE);
+		(void)CloseHandle(queue->thread);
+	}
+
+	async_write(queue, async_take(queue));
+
+	if (queue->event)
+		(void)CloseHandle(queue->event);
+	free(queue);
+}
+
+wLogAsyncQueue* WLog_AsyncQueue_New(wLog* owner, wLogAppender* appender, size_t capacity)
+{
+	WINPR_ASSERT(owner);
+	WINPR_ASSERT(appender);
+
+	if ((capacity == 0) || (capacity > INT32_MAX))
+		return NULL;
+
+	wLogAsyncQueue* queue = calloc(1, sizeof(wLogAsyncQueue));
+	if (!queue)
+		return NULL;
+
+	queue->owner = owner;
+	queue->appender = appender;
+	queue->capacity = (LONG)capacity;
+	queue->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!queue->event)
+	{
+		WLog_AsyncQueue_Free(queue);
+		return NULL;
+	}
+
+	return queue;
+}
@@ -0,0 +1,39 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H
+#define WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H
+
+#include "wlog.h"
+
+typedef struct s_wLogAsyncQueue wLogAsyncQueue;
+
+void WLog_AsyncQueue_Free(wLogAsyncQueue* queue);
+
+WINPR_ATTR_MALLOC(WLog_AsyncQueue_Free, 1)
+wLogAsyncQueue* WLog_AsyncQueue_New(wLog* owner, wLogAppender* appender, size_t capacity);
+
+/** Queues a text message for the writer thread.
+ *
+ *  Returns \b FALSE if the message was not consumed and must be written synchronously,
+ *  a message dropped because the queue is full counts as consumed.
+ */
+BOOL WLog_AsyncQueue_Push(wLogAsyncQueue* queue, wLog* log, const wLogMessage* message);
+
+void WLog_AsyncQueue_GetStats(wLogAsyncQueue* queue, UINT64* written, UINT64* dropped);
+
+#endif /* WINPR_WLOG_ASYNC_QUEUE_PRIVATE_H */
@@ -19,8 +19,14 @@
 
 #include <winpr/config.h>
 
+#include <errno.h>
+#include <stdlib.h>
+
+#include <winpr/environment.h>
+
 #include "ConsoleAppender.h"
 #include "Message.h"
+#include "PcapRing.h"
 
 #ifdef ANDROID
 #include <android/log.h>
@@ -36,6 +42,9 @@ typedef struct
 	WLOG_APPENDER_COMMON();
 
 	int outputStream;
+
+	size_t pcapRingSize;
+	wPcapRing* pcapRing;
 } wLogConsoleAppender;
 
 static BOOL WLog_ConsoleAppender_Open(WINPR_ATTR_UNUSED wLog* log,
@@ -194,9 +203,28 @@ static BOOL WLog_ConsoleAppender_WritePacketMessage(WINPR_ATTR_UNUSED wLog* log,
 	return FALSE;
 #else
 	char* FullFileName = NULL;
+	wLogConsoleAppender* consoleAppender = (wLogConsoleAppender*)appender;
 
 	g_PacketId++;
 
+	if (consoleAppender->pcapRingSize > 0)
+	{
+		if (!consoleAppender->pcapRing)
+		{
+			FullFileName = WLog_Message_GetOutputFileName(-1, "pcapng");
+			if (FullFileName)
+				consoleAppender->pcapRing =
+				    PcapRing_Open(FullFileName, consoleAppender->pcapRingSize);
+			free(FullFileName);
+		}
+
+		if (consoleAppender->pcapRing)
+			return PcapRing_Write(consoleAppender->pcapRing, message->PacketData,
+			                      message->PacketLength, message->PacketFlags);
+
+		return TRUE;
+	}
+
 	if (!appender->PacketMessageContext)
 	{
 		FullFileName = WLog_Message_GetOutputFileName(-1, "pcap");
@@ -240,15 +268,41 @@ static void WLog_ConsoleAppender_Free(wLogAppender* appender)
 {
 	if (appender)
 	{
+		wLogConsoleAppender* consoleAppender = (wLogConsoleAppender*)appender;
+
 		if (appender->PacketMessageContext)
 		{
 			Pcap_Close((wPcap*)appender->PacketMessageContext);
 		}
 
+		PcapRing_Close(consoleAppender->pcapRing);
+
 		free(appender);
 	}
 }
 
+/* WLOG_PCAP_RING=<MiB> captures packets into a pcapng ring file instead of a pcap file */
+static size_t WLog_ConsoleAppender_PcapRingSize(void)
+{
+	LPCSTR name = "WLOG_PCAP_RING";
+	char env[32] = { 0 };
+
+	const DWORD nSize = GetEnvironmentVariableA(name, env, ARRAYSIZE(env));
+	if ((nSize == 0) || (nSize >= ARRAYSIZE(env)))
+		return 0;
+
+	errno = 0;
+	char* end = NULL;
+	const unsigned long size = strtoul(env, &end, 0);
+	if ((errno != 0) || (end == env) || (*end != '\0') || (size > SIZE_MAX / 1024 / 1024))
+	{
+		(void)fprintf(stderr, "%s has invalid value '%s'\n", name, env);
+		return 0;
+	}
+
+	return size * 1024 * 1024;
+}
+
 wLogAppender* WLog_ConsoleAppender_New(WINPR_ATTR_UNUSED wLog* log)
 {
 	wLogConsoleAppender* ConsoleAppender = NULL;
@@ -270,6 +324,7 @@ wLogAppender* WLog_ConsoleAppender_New(WINPR_ATTR_UNUSED wLog* log)
 	ConsoleAppender->Free = WLog_ConsoleAppender_Free;
 
 	ConsoleAppender->outputStream = WLOG_CONSOLE_DEFAULT;
+	ConsoleAppender->pcapRingSize = WLog_ConsoleAppender_PcapRingSize();
 
 #ifdef _WIN32
 	if (IsDebuggerPresent())
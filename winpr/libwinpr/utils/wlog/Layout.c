@@ -232,6 +232,21 @@ static BOOL replace_format_string(const char* FormatString, struct format_option
 }
 
 BOOL WLog_Layout_GetMessagePrefix(wLog* log, wLogLayout* layout, wLogMessage* message)
+{
+	WINPR_ASSERT(layout);
+	WINPR_ASSERT(message);
+
+	if (layout->QueuedPrefix)
+	{
+		(void)_snprintf(message->PrefixString, WLOG_MAX_PREFIX_SIZE - 1, "%s",
+		                layout->QueuedPrefix);
+		return TRUE;
+	}
+
+	return WLog_Layout_FormatMessagePrefix(log, layout, message);
+}
+
+BOOL WLog_Layout_FormatMessagePrefix(wLog* log, wLogLayout* layout, wLogMessage* message)
 {
 	char format[WLOG_MAX_PREFIX_SIZE] = { 0 };
 
@@ -31,6 +31,9 @@ struct s_wLogLayout
 	DWORD Type;
 
 	LPSTR FormatString;
+
+	/* prefix formatted when an asynchronous message was queued, set while it is written */
+	LPCSTR QueuedPrefix;
 };
 
 void WLog_Layout_Free(wLog* log, wLogLayout* layout);
@@ -147,26 +147,14 @@ void Pcap_Close(wPcap* pcap)
 	free(pcap);
 }
 
-static BOOL WLog_PacketMessage_Write_EthernetHeader(wPcap* pcap, wEthernetHeader* ethernet)
+static void WLog_PacketMessage_Write_EthernetHeader(wStream* s, const wEthernetHeader* ethernet)
 {
-	wStream* s = NULL;
-	wStream sbuffer = { 0 };
-	BYTE buffer[14] = { 0 };
-	BOOL ret = TRUE;
-
-	if (!pcap || !pcap->fp || !ethernet)
-		return FALSE;
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(ethernet);
 
-	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
-	if (!s)
-		return FALSE;
 	Stream_Write(s, ethernet->Destination, 6);
 	Stream_Write(s, ethernet->Source, 6);
 	Stream_Write_UINT16_BE(s, ethernet->Type);
-	if (fwrite(buffer, sizeof(buffer), 1, pcap->fp) != 1)
-		ret = FALSE;
-
-	return ret;
 }
 
 static UINT16 IPv4Checksum(const BYTE* ipv4, int length)
@@ -190,19 +178,12 @@ static UINT16 IPv4Checksum(const BYTE* ipv4, int length)
 	return (UINT16)(~checksum);
 }
 
-static BOOL WLog_PacketMessage_Write_IPv4Header(wPcap* pcap, wIPv4Header* ipv4)
+static void WLog_PacketMessage_Write_IPv4Header(wStream* s, wIPv4Header* ipv4)
 {
-	wStream* s = NULL;
-	wStream sbuffer = { 0 };
-	BYTE buffer[20] = { 0 };
-	int ret = TRUE;
-
-	if (!pcap || !pcap->fp || !ipv4)
-		return FALSE;
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(ipv4);
 
-	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
-	if (!s)
-		return FALSE;
+	BYTE* buffer = Stream_Pointer(s);
 	Stream_Write_UINT8(s, (BYTE)((ipv4->Version << 4) | ipv4->InternetHeaderLength));
 	Stream_Write_UINT8(s, ipv4->TypeOfService);
 	Stream_Write_UINT16_BE(s, ipv4->TotalLength);
@@ -213,29 +194,17 @@ static BOOL WLog_PacketMessage_Write_IPv4Header(wPcap* pcap, wIPv4Header* ipv4)
 	Stream_Write_UINT16(s, ipv4->HeaderChecksum);
 	Stream_Write_UINT32_BE(s, ipv4->SourceAddress);
 	Stream_Write_UINT32_BE(s, ipv4->DestinationAddress);
-	ipv4->HeaderChecksum = IPv4Checksum((BYTE*)buffer, 20);
+	ipv4->HeaderChecksum = IPv4Checksum(buffer, 20);
 	Stream_Rewind(s, 10);
 	Stream_Write_UINT16(s, ipv4->HeaderChecksum);
-
-	if (fwrite(buffer, sizeof(buffer), 1, pcap->fp) != 1)
-		ret = FALSE;
-
-	return ret;
+	Stream_Seek(s, 8);
 }
 
-static BOOL WLog_PacketMessage_Write_TcpHeader(wPcap* pcap, wTcpHeader* tcp)
+static void WLog_PacketMessage_Write_TcpHeader(wStream* s, const wTcpHeader* tcp)
 {
-	wStream* s = NULL;
-	wStream sbuffer = { 0 };
-	BYTE buffer[20] = { 0 };
-	BOOL ret = TRUE;
-
-	if (!pcap || !pcap->fp || !tcp)
-		return FALSE;
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(tcp);
 
-	s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
-	if (!s)
-		return FALSE;
 	Stream_Write_UINT16_BE(s, tcp->SourcePort);
 	Stream_Write_UINT16_BE(s, tcp->DestinationPort);
 	Stream_Write_UINT32_BE(s, tcp->SequenceNumber);
@@ -245,28 +214,17 @@ static BOOL WLog_PacketMessage_Write_TcpHeader(wPcap* pcap, wTcpHeader* tcp)
 	Stream_Write_UINT16_BE(s, tcp->Window);
 	Stream_Write_UINT16_BE(s, tcp->Checksum);
 	Stream_Write_UINT16_BE(s, tcp->UrgentPointer);
-
-	if (pcap->fp)
-	{
-		if (fwrite(buffer, sizeof(buffer), 1, pcap->fp) != 1)
-			ret = FALSE;
-	}
-
-	return ret;
 }
 
-static UINT32 g_InboundSequenceNumber = 0;
-static UINT32 g_OutboundSequenceNumber = 0;
-
-BOOL WLog_PacketMessage_Write(wPcap* pcap, void* data, size_t length, DWORD flags)
+BOOL WLog_PacketMessage_Write_Headers(wStream* s, size_t length, DWORD flags, UINT32 seq,
+                                      UINT32 ack)
 {
 	wTcpHeader tcp;
 	wIPv4Header ipv4;
-	wPcapRecord record;
 	wEthernetHeader ethernet;
 	ethernet.Type = 0x0800;
 
-	if (!pcap || !pcap->fp)
+	if (!Stream_CheckAndLogRequiredCapacity(TAG, s, WLOG_PACKET_HEADER_SIZE))
 		return FALSE;
 
 	if (flags & WLOG_PACKET_OUTBOUND)
@@ -328,34 +286,60 @@ BOOL WLog_PacketMessage_Write(wPcap* pcap, void* data, size_t length, DWORD flag
 
 	tcp.SourcePort = 3389;
 	tcp.DestinationPort = 3389;
+	tcp.SequenceNumber = seq;
+	tcp.AcknowledgementNumber = ack;
+	tcp.Offset = 5;
+	tcp.Reserved = 0;
+	tcp.TcpFlags = 0x0018;
+	tcp.Window = 0x7FFF;
+	tcp.Checksum = 0;
+	tcp.UrgentPointer = 0;
+
+	WLog_PacketMessage_Write_EthernetHeader(s, &ethernet);
+	WLog_PacketMessage_Write_IPv4Header(s, &ipv4);
+	WLog_PacketMessage_Write_TcpHeader(s, &tcp);
+	return TRUE;
+}
+
+static UINT32 g_InboundSequenceNumber = 0;
+static UINT32 g_OutboundSequenceNumber = 0;
+
+BOOL WLog_PacketMessage_Write(wPcap* pcap, void* data, size_t length, DWORD flags)
+{
+	wPcapRecord record;
+	wStream sbuffer = { 0 };
+	BYTE buffer[WLOG_PACKET_HEADER_SIZE] = { 0 };
+	UINT32 seq = 0;
+	UINT32 ack = 0;
+
+	if (!pcap || !pcap->fp)
+		return FALSE;
 
 	if (flags & WLOG_PACKET_OUTBOUND)
 	{
-		tcp.SequenceNumber = g_OutboundSequenceNumber;
-		tcp.AcknowledgementNumber = g_InboundSequenceNumber;
+		seq = g_OutboundSequenceNumber;
+		ack = g_InboundSequenceNumber;
 		WINPR_ASSERT(length + g_OutboundSequenceNumber <= UINT32_MAX);
 		g_OutboundSequenceNumber += WINPR_ASSERTING_INT_CAST(uint32_t, length);
 	}
 	else
 	{
-		tcp.SequenceNumber = g_InboundSequenceNumber;
-		tcp.AcknowledgementNumber = g_OutboundSequenceNumber;
+		seq = g_InboundSequenceNumber;
+		ack = g_OutboundSequenceNumber;
 
 		WINPR_ASSERT(length + g_InboundSequenceNumber <= UINT32_MAX);
 		g_InboundSequenceNumber += WINPR_ASSERTING_INT_CAST(uint32_t, length);
 	}
 
-	tcp.Offset = 5;
-	tcp.Reserved = 0;
-	tcp.TcpFlags = 0x0018;
-	tcp.Window = 0x7FFF;
-	tcp.Checksum = 0;
-	tcp.UrgentPointer = 0;
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	if (!WLog_PacketMessage_Write_Headers(s, length, flags, seq, ack))
+		return FALSE;
+
 	record.data = data;
 	record.length = length;
-	const size_t offset = 14 + 20 + 20;
-	WINPR_ASSERT(record.length <= UINT32_MAX - offset);
-	const uint32_t rloff = WINPR_ASSERTING_INT_CAST(uint32_t, record.length + offset);
+	WINPR_ASSERT(record.length <= UINT32_MAX - WLOG_PACKET_HEADER_SIZE);
+	const uint32_t rloff =
+	    WINPR_ASSERTING_INT_CAST(uint32_t, record.length + WLOG_PACKET_HEADER_SIZE);
 	record.header.incl_len = rloff;
 	record.header.orig_len = rloff;
 	record.next = NULL;
@@ -365,9 +349,8 @@ BOOL WLog_PacketMessage_Write(wPcap* pcap, void* data, size_t length, DWORD flag
 	record.header.ts_usec = WINPR_TIME_NS_REM_US(ns);
 
 	if (!Pcap_Write_RecordHeader(pcap, &record.header) ||
-	    !WLog_PacketMessage_Write_EthernetHeader(pcap, &ethernet) ||
-	    !WLog_PacketMessage_Write_IPv4Header(pcap, &ipv4) ||
-	    !WLog_PacketMessage_Write_TcpHeader(pcap, &tcp) || !Pcap_Write_RecordContent(pcap, &record))
+	    (fwrite(buffer, sizeof(buffer), 1, pcap->fp) != 1) ||
+	    !Pcap_Write_RecordContent(pcap, &record))
 		return FALSE;
 	(void)fflush(pcap->fp);
 	return TRUE;
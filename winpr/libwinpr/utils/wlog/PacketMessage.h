@@ -20,6 +20,8 @@
 #ifndef WINPR_WLOG_PACKET_MESSAGE_PRIVATE_H
 #define WINPR_WLOG_PACKET_MESSAGE_PRIVATE_H
 
+#include <winpr/stream.h>
+
 #include "wlog.h"
 
 #define PCAP_MAGIC_NUMBER 0xA1B2C3D4
@@ -106,6 +108,11 @@ typedef struct
 	UINT16 UrgentPointer;
 } wTcpHeader;
 
+/* ethernet, IPv4 and TCP header in front of every captured packet */
+#define WLOG_PACKET_HEADER_SIZE (14 + 20 + 20)
+
+BOOL WLog_PacketMessage_Write_Headers(wStream* s, size_t length, DWORD flags, UINT32 seq,
+                                      UINT32 ack);
 BOOL WLog_PacketMessage_Write(wPcap* pcap, void* data, size_t length, DWORD flags);
 
 #endif /* WINPR_WLOG_PACKET_MESSAGE_PRIVATE_H */
@@ -0,0 +1,424 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/endian.h>
+#include <winpr/stream.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "PcapRing.h"
+#include "PacketMessage.h"
+
+#include "../../log.h"
+#define TAG WINPR_TAG("utils.wlog")
+
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+#define PCAPNG_BLOCK_SHB 0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB 0x00000001
+#define PCAPNG_BLOCK_EPB 0x00000006
+
+/* local use block type, readers skip it. Covers space not (or no longer) used by packets */
+#define PCAPNG_BLOCK_FILLER 0x80000001
+
+#define PCAPNG_SHB_SIZE 28
+#define PCAPNG_IDB_NAME_SIZE 16
+#define PCAPNG_IDB_SIZE (28 + PCAPNG_IDB_NAME_SIZE)
+#define PCAPNG_EPB_SIZE 32
+#define PCAPNG_MIN_BLOCK_SIZE 12
+
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_IF_NAME 2
+
+/* the section and interface blocks live in front of the packets */
+#define PCAP_RING_MAX_INTERFACES 64
+#define PCAP_RING_HEADER_SIZE \
+	(PCAPNG_SHB_SIZE + PCAP_RING_MAX_INTERFACES * PCAPNG_IDB_SIZE + PCAPNG_MIN_BLOCK_SIZE)
+#define PCAP_RING_MIN_SIZE (64ull * 1024ull)
+#define PCAP_RING_FLUSH_INTERVAL_MS 1000
+
+typedef struct
+{
+	UINT16 session;
+	UINT32 inbound;
+	UINT32 outbound;
+} wPcapRingInterface;
+
+struct s_wPcapRing
+{
+	BYTE* map;
+	size_t size;
+	size_t start;
+	size_t pos;
+	size_t idbEnd;
+
+	wPcapRingInterface interfaces[PCAP_RING_MAX_INTERFACES];
+	size_t interfaceCount;
+
+	HANDLE stopEvent;
+	HANDLE flushThread;
+
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+static size_t pcap_ring_align(size_t length)
+{
+	return (length + 3) & ~((size_t)3);
+}
+
+static UINT32 pcap_ring_block_size(const wPcapRing* ring, size_t offset)
+{
+	return winpr_Data_Get_UINT32(&ring->map[offset + 4]);
+}
+
+static void pcap_ring_write_filler(wPcapRing* ring, size_t offset, size_t length)
+{
+	WINPR_ASSERT(length >= PCAPNG_MIN_BLOCK_SIZE);
+	WINPR_ASSERT((length % 4) == 0);
+	WINPR_ASSERT(length <= UINT32_MAX);
+
+	BYTE* block = &ring->map[offset];
+	winpr_Data_Write_UINT32(&block[length - 4], (UINT32)length);
+	winpr_Data_Write_UINT32(&block[4], (UINT32)length);
+	winpr_Data_Write_UINT32(block, PCAPNG_BLOCK_FILLER);
+}
+
+static void pcap_ring_write_shb(wPcapRing* ring)
+{
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, ring->map, PCAPNG_SHB_SIZE);
+
+	Stream_Write_UINT32(s, PCAPNG_BLOCK_SHB);
+	Stream_Write_UINT32(s, PCAPNG_SHB_SIZE);
+	Stream_Write_UINT32(s, 0x1A2B3C4D); /* byte order magic */
+	Stream_Write_UINT16(s, 1);          /* major version */
+	Stream_Write_UINT16(s, 0);          /* minor version */
+	Stream_Write_INT64(s, -1);          /* section length, not specified */
+	Stream_Write_UINT32(s, PCAPNG_SHB_SIZE);
+}
+
+/* Appends an interface block, the unused rest of the header area stays a filler block */
+static BOOL pcap_ring_add_interface(wPcapRing* ring, UINT16 session, size_t* index)
+{
+	WINPR_ASSERT(ring);
+	WINPR_ASSERT(index);
+
+	if (ring->interfaceCount >= PCAP_RING_MAX_INTERFACES)
+		return FALSE;
+
+	/* fixed width, the padded option value always fills the name field */
+	char name[PCAPNG_IDB_NAME_SIZE] = { 0 };
+	(void)_snprintf(name, sizeof(name), "session %05" PRIu16, session);
+
+	wStream sbuffer = { 0 };
+	wStream* s = Stream_StaticInit(&sbuffer, &ring->map[ring->idbEnd], PCAPNG_IDB_SIZE);
+
+	pcap_ring_write_filler(ring, ring->idbEnd + PCAPNG_IDB_SIZE,
+	                       ring->start - ring->idbEnd - PCAPNG_IDB_SIZE);
+	Stream_Write_UINT32(s, PCAPNG_BLOCK_IDB);
+	Stream_Write_UINT32(s, PCAPNG_IDB_SIZE);
+	Stream_Write_UINT16(s, 1); /* LINKTYPE_ETHERNET */
+	Stream_Write_UINT16(s, 0); /* reserved */
+	Stream_Write_UINT32(s, 0); /* no snap length */
+	Stream_Write_UINT16(s, PCAPNG_OPT_IF_NAME);
+	Stream_Write_UINT16(s, (UINT16)strnlen(name, sizeof(name) - 1));
+	Stream_Write(s, name, sizeof(name));
+	Stream_Write_UINT16(s, PCAPNG_OPT_ENDOFOPT);
+	Stream_Write_UINT16(s, 0);
+	Stream_Write_UINT32(s, PCAPNG_IDB_SIZE);
+
+	wPcapRingInterface* iface = &ring->interfaces[ring->interfaceCount];
+	iface->session = session;
+	iface->inbound = 0;
+	iface->outbound = 0;
+
+	*index = ring->interfaceCount++;
+	ring->idbEnd += PCAPNG_IDB_SIZE;
+	return TRUE;
+}
+
+static size_t pcap_ring_get_interface(wPcapRing* ring, UINT16 session)
+{
+	for (size_t x = 0; x < ring->interfaceCount; x++)
+	{
+		if (ring->interfaces[x].session == session)
+			return x;
+	}
+
+	size_t index = 0;
+	if (!pcap_ring_add_interface(ring, session, &index))
+		return 0; /* out of interfaces, shared with untagged packets */
+	return index;
+}
+
+/* Returns the offset the packet block of the given size is written to.
+ * The packet area is always completely covered by valid blocks, space of older packets
+ * that is not filled with the new one becomes a filler block. */
+static size_t pcap_ring_reserve(wPcapRing* ring, size_t length)
+{
+	WINPR_ASSERT(length <= ring->size - ring->start);
+
+	const size_t available = ring->size - ring->pos;
+	if ((length > available) ||
+	    ((length < available) && (available - length < PCAPNG_MIN_BLOCK_SIZE)))
+	{
+		/* the tail of the file is too small, continue at the start of the packet area */
+		if (available > 0)
+			pcap_ring_write_filler(ring, ring->pos, available);
+		ring->pos = ring->start;
+	}
+
+	const size_t offset = ring->pos;
+	const size_t end = offset + length;
+
+	size_t next = offset;
+	while (next < end)
+		next += pcap_ring_block_size(ring, next);
+	while ((next < ring->size) && (next != end) && (next - end < PCAPNG_MIN_BLOCK_SIZE))
+		next += pcap_ring_block_size(ring, next);
+
+	if (next != end)
+	{
+		WINPR_ASSERT(next - end >= PCAPNG_MIN_BLOCK_SIZE);
+		pcap_ring_write_filler(ring, end, next - end);
+	}
+
+	ring->pos = (end == ring->size) ? ring->start : end;
+	return offset;
+}
+
+BOOL PcapRing_Write(wPcapRing* ring, const void* data, size_t length, DWORD flags)
+{
+	wStream sbuffer = { 0 };
+
+	if (!ring || !data)
+		return FALSE;
+
+	const size_t index = pcap_ring_get_interface(ring, (UINT16)(flags >> 16));
+	wPcapRingInterface* iface = &ring->interfaces[index];
+
+	/* keep every packet well below the ring size, longer ones are truncated */
+	const size_t maxCaptured = (ring->size - ring->start) / 4;
+	const size_t original = WLOG_PACKET_HEADER_SIZE + length;
+	const size_t captured = MIN(original, maxCaptured);
+	if (original > UINT32_MAX)
+		return FALSE;
+
+	UINT32 seq = 0;
+	UINT32 ack = 0;
+	if (flags & WLOG_PACKET_OUTBOUND)
+	{
+		seq = iface->outbound;
+		ack = iface->inbound;
+		iface->outbound += (UINT32)length;
+	}
+	else
+	{
+		seq = iface->inbound;
+		ack = iface->outbound;
+		iface->inbound += (UINT32)length;
+	}
+
+	const size_t blockSize = PCAPNG_EPB_SIZE + pcap_ring_align(captured);
+	const size_t offset = pcap_ring_reserve(ring, blockSize);
+	wStream* s = Stream_StaticInit(&sbuffer, &ring->map[offset], blockSize);
+
+	const UINT64 us = WINPR_TIME_NS_TO_US(winpr_GetUnixTimeNS());
+	Stream_Write_UINT32(s, PCAPNG_BLOCK_EPB);
+	Stream_Write_UINT32(s, (UINT32)blockSize);
+	Stream_Write_UINT32(s, (UINT32)index);
+	Stream_Write_UINT32(s, (UINT32)(us >> 32));
+	Stream_Write_UINT32(s, (UINT32)(us & UINT32_MAX));
+	Stream_Write_UINT32(s, (UINT32)captured);
+	Stream_Write_UINT32(s, (UINT32)original);
+
+	if (!WLog_PacketMessage_Write_Headers(s, length, flags, seq, ack))
+		return FALSE;
+
+	/* the only copy of the packet data, straight into the mapping */
+	Stream_Write(s, data, captured - WLOG_PACKET_HEADER_SIZE);
+	Stream_Zero(s, pcap_ring_align(captured) - captured);
+	Stream_Write_UINT32(s, (UINT32)blockSize);
+	return TRUE;
+}
+
+static BOOL pcap_ring_sync(wPcapRing* ring, BOOL wait)
+{
+#if defined(_WIN32)
+	WINPR_UNUSED(wait);
+	return FlushViewOfFile(ring->map, ring->size);
+#else
+	return msync(ring->map, ring->size, wait ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+}
+
+static DWORD WINAPI pcap_ring_flush_thread(LPVOID arg)
+{
+	wPcapRing* ring = arg;
+	WINPR_ASSERT(ring);
+
+	while (WaitForSingleObject(ring->stopEvent, PCAP_RING_FLUSH_INTERVAL_MS) == WAIT_TIMEOUT)
+		(void)pcap_ring_sync(ring, FALSE);
+
+	return 0;
+}
+
+static BOOL pcap_ring_map(wPcapRing* ring, const char* name)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER size = { .QuadPart = (LONGLONG)ring->size };
+
+	ring->file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+	                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (ring->file == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	ring->mapping =
+	    CreateFileMappingA(ring->file, NULL, PAGE_READWRITE, (DWORD)size.HighPart, size.LowPart, NULL);
+	if (!ring->mapping)
+		return FALSE;
+
+	ring->map = MapViewOfFile(ring->mapping, FILE_MAP_WRITE, 0, 0, ring->size);
+	return ring->map != NULL;
+#else
+	ring->fd = open(name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (ring->fd < 0)
+		return FALSE;
+
+	if (ftruncate(ring->fd, (off_t)ring->size) != 0)
+		return FALSE;
+
+	void* map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	ring->map = map;
+	return TRUE;
+#endif
+}
+
+static void pcap_ring_unmap(wPcapRing* ring)
+{
+#if defined(_WIN32)
+	if (ring->map)
+		(void)UnmapViewOfFile(ring->map);
+	if (ring->mapping)
+		(void)CloseHandle(ring->mapping);
+	if (ring->file && (ring->file != INVALID_HANDLE_VALUE))
+		(void)CloseHandle(ring->file);
+#else
+	if (ring->map)
+		(void)munmap(ring->map, ring->size);
+	if (ring->fd >= 0)
+		(void)close(ring->fd);
+#endif
+}
+
+void PcapRing_Close(wPcapRing* ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->flushThread)
+	{
+		(void)SetEvent(ring->stopEvent);
+		(void)WaitForSingleObject(ring->flushThread, INFINITE);
+		(void)CloseHandle(ring->flushThread);
+	}
+
+	if (ring->stopEvent)
+		(void)CloseHandle(ring->stopEvent);
+
+	if (ring->map)
+		(void)pcap_ring_sync(ring, TRUE);
+	pcap_ring_unmap(ring);
+	free(ring);
+}
+
+wPcapRing* PcapRing_Open(const char* name, size_t size)
+{
+	WINPR_ASSERT(name);
+
+	size = pcap_ring_align(MAX(size, PCAP_RING_MIN_SIZE));
+	if (size > UINT32_MAX)
+		size = UINT32_MAX & ~((size_t)3);
+
+	wPcapRing* ring = calloc(1, sizeof(wPcapRing));
+	if (!ring)
+		return NULL;
+
+#if !defined(_WIN32)
+	ring->fd = -1;
+#endif
+	ring->size = size;
+	ring->start = PCAP_RING_HEADER_SIZE;
+	ring->pos = ring->start;
+	ring->idbEnd = PCAPNG_SHB_SIZE;
+
+	if (!pcap_ring_map(ring, name))
+	{
+		WLog_ERR(TAG, "failed to map pcap ring file %s", name);
+		goto fail;
+	}
+
+	pcap_ring_write_shb(ring);
+	pcap_ring_write_filler(ring, ring->idbEnd, ring->start - ring->idbEnd);
+	pcap_ring_write_filler(ring, ring->start, ring->size - ring->start);
+
+	/* interface 0 is used for packets without a session */
+	size_t index = 0;
+	if (!pcap_ring_add_interface(ring, 0, &index))
+		goto fail;
+
+	ring->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!ring->stopEvent)
+		goto fail;
+
+	ring->flushThread = CreateThread(NULL, 0, pcap_ring_flush_thread, ring, 0, NULL);
+	if (!ring->flushThread)
+		goto fail;
+
+	return ring;
+
+fail:
+	PcapRing_Close(ring);
+	return NULL;
+}
@@ -0,0 +1,36 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * WinPR Logger
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WINPR_WLOG_PCAP_RING_PRIVATE_H
+#define WINPR_WLOG_PCAP_RING_PRIVATE_H
+
+#include "wlog.h"
+
+/**
+ * A pcapng capture in a pre-sized, memory mapped file. Once the file is full the oldest
+ * packets are overwritten, every session gets its own interface.
+ */
+typedef struct s_wPcapRing wPcapRing;
+
+void PcapRing_Close(wPcapRing* ring);
+
+WINPR_ATTR_MALLOC(PcapRing_Close, 1)
+wPcapRing* PcapRing_Open(const char* name, size_t size);
+
+BOOL PcapRing_Write(wPcapRing* ring, const void* data, size_t length, DWORD flags);
+
+#endif /* WINPR_WLOG_PCAP_RING_PRIVATE_H */
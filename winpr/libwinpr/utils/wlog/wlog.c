@@ -23,12 +23,15 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
+#include <stdlib.h>
 
 #include <winpr/crt.h>
 #include <winpr/assert.h>
 #include <winpr/print.h>
 #include <winpr/debug.h>
 #include <winpr/environment.h>
+#include <winpr/interlocked.h>
 #include <winpr/wlog.h>
 
 #if defined(ANDROID)
@@ -63,6 +66,7 @@ static INIT_ONCE g_WLogInitialized = INIT_ONCE_STATIC_INIT;
 static DWORD g_FilterCount = 0;
 static wLogFilter* g_Filters = NULL;
 static wLog* g_RootLog = NULL;
+static LONG volatile g_LevelGeneration = 0;
 
 static wLog* WLog_New(LPCSTR name, wLog* rootLogger);
 static void WLog_Free(wLog* log);
@@ -106,6 +110,27 @@ static void WLog_Unlock(wLog* log)
 	LeaveCriticalSection(&log->lock);
 }
 
+static BOOL WLog_ParseAsync(wLog* root)
+{
+	LPCSTR async = "WLOG_ASYNC";
+	char env[32] = { 0 };
+
+	const DWORD nSize = GetEnvironmentVariableA(async, env, ARRAYSIZE(env));
+	if ((nSize == 0) || (nSize >= ARRAYSIZE(env)))
+		return TRUE;
+
+	errno = 0;
+	char* end = NULL;
+	const unsigned long capacity = strtoul(env, &end, 0);
+	if ((errno != 0) || (end == env) || (*end != '\0'))
+	{
+		(void)fprintf(stderr, "%s has invalid value '%s'\n", async, env);
+		return TRUE;
+	}
+
+	return WLog_SetAsync(root, capacity);
+}
+
 static BOOL CALLBACK WLog_InitializeRoot(PINIT_ONCE InitOnce, PVOID Parameter, PVOID* Context)
 {
 	char* env = NULL;
@@ -164,6 +189,9 @@ static BOOL CALLBACK WLog_InitializeRoot(PINIT_ONCE InitOnce, PVOID Parameter, P
 	if (!WLog_SetLogAppenderType(g_RootLog, logAppenderType))
 		goto fail;
 
+	if (!WLog_ParseAsync(g_RootLog))
+		goto fail;
+
 	if (!WLog_ParseFilters(g_RootLog))
 		goto fail;
 
@@ -238,6 +266,9 @@ static BOOL WLog_Write(wLog* log, wLogMessage* message)
 		if (!WLog_OpenAppender(log))
 			return FALSE;
 
+	if (appender->AsyncQueue && WLog_AsyncQueue_Push(appender->AsyncQueue, log, message))
+		return TRUE;
+
 	EnterCriticalSection(&appender->lock);
 
 	if (appender->WriteMessage)
@@ -426,11 +457,8 @@ BOOL WLog_PrintMessage(wLog* log, DWORD type, DWORD level, size_t line, const ch
 	return status;
 }
 
-DWORD WLog_GetLogLevel(wLog* log)
+static DWORD WLog_GetLogLevel_int(wLog* log)
 {
-	if (!log)
-		return WLOG_OFF;
-
 	if (log->FilterLevel <= WLOG_FILTER_NOT_INITIALIZED)
 		log->FilterLevel = WLog_GetFilterLogLevel(log);
 
@@ -442,6 +470,27 @@ DWORD WLog_GetLogLevel(wLog* log)
 	return log->Level;
 }
 
+DWORD WLog_GetLogLevel(wLog* log)
+{
+	if (!log)
+		return WLOG_OFF;
+
+	/* resolving filters and inheritance is only done again after a level or filter changed */
+	const LONG generation = g_LevelGeneration;
+	if (log->LevelGeneration == generation)
+		return log->CachedLevel;
+
+	const DWORD level = WLog_GetLogLevel_int(log);
+	log->CachedLevel = level;
+	(void)InterlockedExchange(&log->LevelGeneration, generation);
+	return level;
+}
+
+const LONG volatile* WLog_GetLevelGeneration(void)
+{
+	return &g_LevelGeneration;
+}
+
 BOOL WLog_IsLevelActive(wLog* _log, DWORD _log_level)
 {
 	DWORD level = 0;
@@ -490,6 +539,15 @@ static BOOL WLog_reset_log_filters(wLog* log)
 	return TRUE;
 }
 
+static BOOL WLog_levels_changed(wLog* log)
+{
+	const BOOL rc = WLog_reset_log_filters(log);
+
+	/* invalidates the cached level of every logger, done after the change is visible */
+	(void)InterlockedIncrement(&g_LevelGeneration);
+	return rc;
+}
+
 static BOOL WLog_AddStringLogFilters_int(wLog* root, LPCSTR filter)
 {
 	LPSTR p = NULL;
@@ -550,7 +608,7 @@ static BOOL WLog_AddStringLogFilters_int(wLog* root, LPCSTR filter)
 
 	g_FilterCount = size;
 	free(cp);
-	return WLog_reset_log_filters(root);
+	return WLog_levels_changed(root);
 }
 
 BOOL WLog_AddStringLogFilters(LPCSTR filter)
@@ -600,7 +658,7 @@ BOOL WLog_SetLogLevel(wLog* log, DWORD logLevel)
 			return FALSE;
 	}
 
-	return WLog_reset_log_filters(log);
+	return WLog_levels_changed(log);
 }
 
 int WLog_ParseLogLevel(LPCSTR level)
@@ -850,6 +908,7 @@ wLog* WLog_New(LPCSTR name, wLog* rootLogger)
 	log->ChildrenCount = 0;
 	log->ChildrenSize = 16;
 	log->FilterLevel = WLOG_FILTER_NOT_INITIALIZED;
+	log->LevelGeneration = -1;
 
 	if (!(log->Children = (wLog**)calloc(log->ChildrenSize, sizeof(wLog*))))
 		goto out_fail;
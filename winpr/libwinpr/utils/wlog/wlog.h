@@ -44,6 +44,7 @@ typedef void (*WLOG_APPENDER_FREE)(wLogAppender* appender);
 	wLogLayout* Layout;                                       \
 	CRITICAL_SECTION lock;                                    \
 	BOOL recursive;                                           \
+	struct s_wLogAsyncQueue* AsyncQueue;                      \
 	void* TextMessageContext;                                 \
 	void* DataMessageContext;                                 \
 	void* ImageMessageContext;                                \
@@ -67,6 +68,8 @@ struct s_wLog
 	LPSTR Name;
 	LONG FilterLevel;
 	DWORD Level;
+	LONG LevelGeneration;
+	DWORD CachedLevel;
 
 	BOOL IsRoot;
 	BOOL inherit;
@@ -85,6 +88,7 @@ struct s_wLog
 
 extern const char* WLOG_LEVELS[7];
 BOOL WLog_Layout_GetMessagePrefix(wLog* log, wLogLayout* layout, wLogMessage* message);
+BOOL WLog_Layout_FormatMessagePrefix(wLog* log, wLogLayout* layout, wLogMessage* message);
 
 #include "Layout.h"
 #include "Appender.h"